@@ -130,6 +130,43 @@ int sys_write(int fd, const unsigned char *buffer, size_t size)
   return semihosting(SYS_WRITE, params);
 }
 
+static unsigned char sys_buffer[SYS_BUFSIZE];
+static size_t sys_buflen = 0;
+static int sys_buffd = STDOUT;
+
+int sys_flush(void)
+{
+  int result = 0;
+  if (sys_buflen > 0) {
+    result = sys_write(sys_buffd, sys_buffer, sys_buflen);
+    sys_buflen = 0;
+  }
+  return result;
+}
+
+int sys_bufwrite(int fd, const unsigned char *buffer, size_t size)
+{
+  int result = 0;
+  if (fd != sys_buffd) {
+    result = sys_flush();
+    sys_buffd = fd;
+  }
+  while (size > 0) {
+    if (sys_buflen == 0 && size >= SYS_BUFSIZE)
+      return sys_write(fd, buffer, size); /* large block, skip the buffer */
+    size_t count = SYS_BUFSIZE - sys_buflen;
+    if (count > size)
+      count = size;
+    memcpy(sys_buffer + sys_buflen, buffer, count);
+    sys_buflen += count;
+    buffer += count;
+    size -= count;
+    if (sys_buflen == SYS_BUFSIZE)
+      result = sys_flush();
+  }
+  return result;
+}
+
 int sys_read(int fd, char *buffer, size_t size)
 {
   uint32_t params[3] = { fd, (uint32_t)buffer, size };
@@ -214,12 +251,14 @@ void sys_heapinfo(struct heapinfo *info)
 
 void sys_exit(int trap)
 {
+  sys_flush();
   semihosting(SYS_EXIT, (void*)trap);
 }
 
 void sys_exit_extended(int trap, int subcode)
 {
   uint32_t params[2] = { trap, subcode };
+  sys_flush();
   semihosting(SYS_EXIT_EXTENDED, params);
 }
 
@@ -53,6 +53,10 @@
 #define STDOUT  1
 #define STDERR  2
 
+#if !defined SYS_BUFSIZE
+  #define SYS_BUFSIZE 256   /* buffer size for sys_bufwrite() */
+#endif
+
 struct heapinfo {
   void *heap_base;
   void *heap_limit;
@@ -95,6 +99,26 @@ void sys_write0(const char *text);
  */
 int sys_write(int fd, const unsigned char *buffer, size_t size);
 
+/** sys_bufwrite() collects data in a buffer, and writes it to the file with a
+ *  single SYS_WRITE call when the buffer is full, when data for a different
+ *  file handle is written, or on sys_flush(). Each semihosting call halts the
+ *  target while the debugger serves it, so combining many small writes into
+ *  a few large ones is much faster. The buffer size is set with SYS_BUFSIZE.
+ *
+ *  \return 0 on success, or the number of bytes *not* written in the
+ *          last flush of the buffer.
+ *
+ *  \note Data that is written with sys_write(), sys_write0() or sys_writec()
+ *        is not buffered; call sys_flush() first to keep the output in order.
+ */
+int sys_bufwrite(int fd, const unsigned char *buffer, size_t size);
+
+/** sys_flush() writes any pending data from sys_bufwrite() to the file.
+ *
+ *  \return The number of bytes *not* written; 0 on success.
+ */
+int sys_flush(void);
+
 /** sys_read() reads data from a file opened on the host.
  *
  *  \return The number of bytes *not* read. More specifically, the function
@@ -192,13 +216,14 @@ void sys_heapinfo(struct heapinfo *info);
 
 /** sys_exit() signals the host that the target has dropping into an exception
  *  trap (where areaching the end of the application, is also considered an
- *  exception).
+ *  exception). Pending data from sys_bufwrite() is flushed first.
  */
 void sys_exit(int trap);
 
 /** sys_exit_extended() signals the host that the target has dropping into an
  *  exception trap (where areaching the end of the application, is also
- *  considered an exception).
+ *  considered an exception). Pending data from sys_bufwrite() is flushed
+ *  first.
  */
 void sys_exit_extended(int trap, int subcode);
 
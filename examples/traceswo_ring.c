@@ -0,0 +1,362 @@
+/* Buffered transmission of trace data to a debug probe. Trace messages are
+ * stored in a lock-free ring buffer (one per core), which interrupt handlers
+ * can write to without blocking. The ring is drained in the background, to
+ * the ITM (with word-sized writes, from an idle hook), or to a DMA channel of
+ * a SPI or UART peripheral that emulates the SWO protocol.
+ *
+ * Each item in the ring holds 1 to 4 bytes of payload, which is transmitted
+ * as a single SWO packet. A producer first reserves all items for a message,
+ * then fills them in and marks them as valid. The drain routine stops at the
+ * first item that is not yet valid, so that an interrupt that preempts a
+ * producer (and also reserves items) does not corrupt the output.
+ *
+ * On Cortex M3/M4 and later, the reservation uses LDREX/STREX; on Cortex
+ * M0/M0+, which lack these instructions, interrupts are disabled for the few
+ * instructions of the reservation.
+ *
+ *
+ * Copyright 2026 CompuPhase
+ *
+ * This software is provided 'as-is', without any express or implied
+ * warranty. In no event will the authors be held liable for any damages
+ * arising from the use of this software.
+ *
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it
+ * freely, subject to the following restrictions:
+ *
+ * 1. The origin of this software must not be misrepresented; you must not
+ *    claim that you wrote the original software. If you use this software
+ *    in a product, an acknowledgment in the product documentation would be
+ *    appreciated but is not required.
+ * 2. Altered source versions must be plainly marked as such, and must not be
+ *    misrepresented as being the original software.
+ * 3. This notice may not be removed or altered from any source distribution.
+ */
+
+#include <stdint.h>
+#include <string.h>
+#include "traceswo_ring.h"
+
+#define RING_MASK       (TRACERING_SIZE - 1)
+#define ITEM_TAG(channel, length)   (uint8_t)(((length) << 5) | (channel))
+#define TAG_CHANNEL(tag)            ((tag) & 0x1f)
+#define TAG_LENGTH(tag)             ((tag) >> 5)
+
+typedef struct tagTRACERING {
+  volatile uint32_t head;     /* next item to reserve (producers) */
+  volatile uint32_t tail;     /* next item to transmit (drain routine) */
+  volatile uint32_t dropped;  /* total messages dropped (producers) */
+  uint32_t reported;          /* dropped messages reported (drain routine) */
+  uint32_t value[TRACERING_SIZE];
+  volatile uint8_t tag[TRACERING_SIZE]; /* 0 = free or not yet valid */
+} TRACERING;
+
+static TRACERING rings[TRACERING_CORES];
+
+#if TRACERING_LINK != TRACERING_ITM
+uint32_t TRACESWO_TER = 0;
+uint32_t TRACESWO_BPS = 0;
+
+uint32_t traceswo_enable(uint32_t channelmask, int enable)
+{
+  if (enable)
+    TRACESWO_TER |= channelmask;
+  else
+    TRACESWO_TER &= ~channelmask;
+  return TRACESWO_TER;
+}
+
+# define CHANNEL_ENABLED(channel) ((TRACESWO_TER & (1 << (channel))) != 0)
+#else
+# define CHANNEL_ENABLED(channel) ((ITM->TCR & ITM_TCR_ITMENA) != 0UL && (ITM->TER & (1 << (channel))) != 0UL)
+#endif
+
+/* atomic_add() adds a value to a counter that may also be updated from an
+   interrupt handler (on the same core) */
+static void atomic_add(volatile uint32_t *counter, uint32_t value)
+{
+#if defined __ARM_ARCH && __ARM_ARCH >= 7
+  uint32_t count;
+  do {
+    count = __LDREXW(counter);
+  } while (__STREXW(count + value, counter) != 0);
+#else
+  uint32_t primask = __get_PRIMASK();
+  __disable_irq();
+  *counter += value;
+  __set_PRIMASK(primask);
+#endif
+}
+
+/* ring_reserve() reserves a number of items in the ring, and returns the
+   index of the first item; it returns 0 with "ok" set to 0 if the ring is
+   full */
+static uint32_t ring_reserve(TRACERING *ring, unsigned count, int *ok)
+{
+  uint32_t head;
+#if defined __ARM_ARCH && __ARM_ARCH >= 7
+  do {
+    head = __LDREXW(&ring->head);
+    if (head - ring->tail + count > TRACERING_SIZE) {
+      __CLREX();
+      *ok = 0;
+      return 0;
+    }
+  } while (__STREXW(head + count, &ring->head) != 0);
+#else
+  uint32_t primask = __get_PRIMASK();
+  __disable_irq();
+  head = ring->head;
+  if (head - ring->tail + count > TRACERING_SIZE) {
+    __set_PRIMASK(primask);
+    *ok = 0;
+    return 0;
+  }
+  ring->head = head + count;
+  __set_PRIMASK(primask);
+#endif
+  *ok = 1;
+  return head;
+}
+
+/* ring_store() fills in a reserved item and marks it as valid */
+static void ring_store(TRACERING *ring, uint32_t index, int channel, uint32_t value, unsigned length)
+{
+  ring->value[index & RING_MASK] = value;
+  __DMB();  /* the value must be visible before the tag */
+  ring->tag[index & RING_MASK] = ITEM_TAG(channel, length);
+}
+
+int tracering_sz(int channel, const char *msg)
+{
+  return tracering_bin(channel, (const unsigned char*)msg, strlen(msg));
+}
+
+int tracering_bin(int channel, const unsigned char *data, unsigned size)
+{
+  if (!CHANNEL_ENABLED(channel) || size == 0)
+    return 1;
+
+  /* an SWO packet holds 1, 2 or 4 bytes, so 3 trailing bytes take 2 items */
+  static const uint8_t tail_items[4] = { 0, 1, 1, 2 };
+  unsigned count = size / 4 + tail_items[size % 4];
+  TRACERING *ring = &rings[TRACERING_CORE()];
+  int ok;
+  uint32_t index = ring_reserve(ring, count, &ok);
+  if (!ok) {
+    atomic_add(&ring->dropped, 1);
+    return 0;
+  }
+
+  uint32_t value;
+  while (size >= 4) {
+    memcpy(&value, data, 4);
+    ring_store(ring, index++, channel, value, 4);
+    data += 4;
+    size -= 4;
+  }
+  if (size >= 2) {
+    value = data[0] | ((uint32_t)data[1] << 8);
+    ring_store(ring, index++, channel, value, 2);
+    data += 2;
+    size -= 2;
+  }
+  if (size >= 1)
+    ring_store(ring, index, channel, data[0], 1);
+  return 1;
+}
+
+int tracering_u32(int channel, uint32_t value)
+{
+  if (!CHANNEL_ENABLED(channel))
+    return 1;
+  TRACERING *ring = &rings[TRACERING_CORE()];
+  int ok;
+  uint32_t index = ring_reserve(ring, 1, &ok);
+  if (!ok) {
+    atomic_add(&ring->dropped, 1);
+    return 0;
+  }
+  ring_store(ring, index, channel, value, 4);
+  return 1;
+}
+
+uint32_t tracering_dropped(void)
+{
+  uint32_t total = 0;
+  for (int core = 0; core < TRACERING_CORES; core++)
+    total += rings[core].dropped;
+  return total;
+}
+
+/* drop_message() formats the report on dropped messages; it returns the
+   length of the text */
+static unsigned drop_message(char *buffer, uint32_t count)
+{
+  static const char prefix[] = "[dropped ";
+  char digits[10];
+  unsigned len, ndigits = 0;
+  memcpy(buffer, prefix, sizeof prefix - 1);
+  len = sizeof prefix - 1;
+  do {
+    digits[ndigits++] = (char)('0' + count % 10);
+    count /= 10;
+  } while (count > 0);
+  while (ndigits > 0)
+    buffer[len++] = digits[--ndigits];
+  buffer[len++] = ']';
+  buffer[len++] = '\n';
+  return len;
+}
+
+#if TRACERING_LINK == TRACERING_ITM
+
+/* itm_put() writes an item to a stimulus port, with the access size set by
+   the length of the item; it returns 0 if the FIFO of the port is full */
+static int itm_put(int channel, uint32_t value, unsigned length)
+{
+  if (ITM->PORT[channel].u32 == 0UL)
+    return 0;
+  if (length == 1)
+    ITM->PORT[channel].u8 = (uint8_t)value;
+  else if (length == 2)
+    ITM->PORT[channel].u16 = (uint16_t)value;
+  else
+    ITM->PORT[channel].u32 = value;
+  return 1;
+}
+
+unsigned tracering_drain(void)
+{
+  unsigned count = 0;
+  for (int core = 0; core < TRACERING_CORES; core++) {
+    TRACERING *ring = &rings[core];
+    uint32_t tail = ring->tail;
+    uint8_t tag;
+    while ((tag = ring->tag[tail & RING_MASK]) != 0) {
+      __DMB();  /* read the value only after the tag */
+      if (!itm_put(TAG_CHANNEL(tag), ring->value[tail & RING_MASK], TAG_LENGTH(tag)))
+        break;
+      ring->tag[tail & RING_MASK] = 0;
+      tail++;
+      __DMB();  /* clear the tag before releasing the item */
+      ring->tail = tail;
+      count++;
+    }
+    /* the report on dropped messages is short, and it is sent rarely; it is
+       written with waits on the FIFO, so that it is not interleaved */
+    uint32_t dropped = ring->dropped;
+    if (dropped != ring->reported && CHANNEL_ENABLED(TRACERING_DROPCHANNEL)) {
+      char text[24];
+      unsigned len = drop_message(text, dropped - ring->reported);
+      ring->reported = dropped;
+      for (unsigned idx = 0; idx < len; idx += 4) {
+        uint32_t value = 0;
+        memcpy(&value, text + idx, (len - idx < 4) ? len - idx : 4);
+        while (ITM->PORT[TRACERING_DROPCHANNEL].u32 == 0UL)
+          __NOP();
+        ITM->PORT[TRACERING_DROPCHANNEL].u32 = value;
+      }
+    }
+  }
+  return count;
+}
+
+#else
+
+static uint8_t dma_buffer[TRACERING_DMABUF];
+
+#if TRACERING_LINK == TRACERING_SPI
+
+#define START   0x02  /* 0000 0010 (space for 3 periods, followed by a '1') */
+#define SPACE   0x00  /* space code for at the end of a transfer */
+
+static const uint8_t manchester_lookup[16] = {
+  0x55, 0x95, 0x65, 0xa5, 0x59, 0x99, 0x69, 0xa9,
+  0x56, 0x96, 0x66, 0xa6, 0x5a, 0x9a, 0x6a, 0xaa
+};
+
+#define PACKET_SIZE(length)   (1 + 2 * (1 + (length)))  /* START, header & payload */
+#define TAIL_SIZE             1                         /* SPACE */
+
+/* encode_packet() stores an SWO packet in Manchester encoding (for SPI) */
+static unsigned encode_packet(uint8_t *buffer, int channel, uint32_t value, unsigned length)
+{
+  uint8_t hdr = (uint8_t)((channel << 3) | ((length == 4) ? 3 : length));
+  unsigned pos = 0;
+  buffer[pos++] = START;
+  buffer[pos++] = manchester_lookup[hdr & 0x0f];
+  buffer[pos++] = manchester_lookup[hdr >> 4];
+  for (unsigned idx = 0; idx < length; idx++) {
+    uint8_t byte = (uint8_t)(value >> (8 * idx));
+    buffer[pos++] = manchester_lookup[byte & 0x0f];
+    buffer[pos++] = manchester_lookup[byte >> 4];
+  }
+  return pos;
+}
+
+#else
+
+#define PACKET_SIZE(length)   (1 + (length))  /* header & payload */
+#define TAIL_SIZE             0
+
+/* encode_packet() stores an SWO packet in NRZ encoding (for UART) */
+static unsigned encode_packet(uint8_t *buffer, int channel, uint32_t value, unsigned length)
+{
+  unsigned pos = 0;
+  buffer[pos++] = (uint8_t)((channel << 3) | ((length == 4) ? 3 : length));
+  for (unsigned idx = 0; idx < length; idx++)
+    buffer[pos++] = (uint8_t)(value >> (8 * idx));
+  return pos;
+}
+
+#endif
+
+unsigned tracering_drain(void)
+{
+  if (tracering_dma_busy())
+    return 0;
+
+  unsigned count = 0;
+  unsigned pos = 0;
+  for (int core = 0; core < TRACERING_CORES; core++) {
+    TRACERING *ring = &rings[core];
+    uint32_t tail = ring->tail;
+    uint8_t tag;
+    while ((tag = ring->tag[tail & RING_MASK]) != 0) {
+      if (pos + PACKET_SIZE(TAG_LENGTH(tag)) + TAIL_SIZE > TRACERING_DMABUF)
+        break;
+      __DMB();  /* read the value only after the tag */
+      pos += encode_packet(dma_buffer + pos, TAG_CHANNEL(tag), ring->value[tail & RING_MASK], TAG_LENGTH(tag));
+      ring->tag[tail & RING_MASK] = 0;
+      tail++;
+      __DMB();  /* clear the tag before releasing the item */
+      ring->tail = tail;
+      count++;
+    }
+    /* append the report on dropped messages only if it fits as a whole */
+    uint32_t dropped = ring->dropped;
+    if (dropped != ring->reported && CHANNEL_ENABLED(TRACERING_DROPCHANNEL)
+        && pos + 6 * PACKET_SIZE(4) + TAIL_SIZE <= TRACERING_DMABUF)
+    {
+      char text[24];
+      unsigned len = drop_message(text, dropped - ring->reported);
+      ring->reported = dropped;
+      for (unsigned idx = 0; idx < len; idx += 4) {
+        uint32_t value = 0;
+        memcpy(&value, text + idx, (len - idx < 4) ? len - idx : 4);
+        pos += encode_packet(dma_buffer + pos, TRACERING_DROPCHANNEL, value, 4);
+      }
+    }
+  }
+#if TRACERING_LINK == TRACERING_SPI
+  if (pos > 0)
+    dma_buffer[pos++] = SPACE;
+#endif
+  if (pos > 0)
+    tracering_dma_start(dma_buffer, pos);
+  return count;
+}
+
+#endif
@@ -0,0 +1,167 @@
+/* Buffered transmission of trace data to a debug probe. Trace messages are
+ * stored in a lock-free ring buffer (one per core), which interrupt handlers
+ * can write to without blocking. The ring is drained in the background, to
+ * the ITM (with word-sized writes, from an idle hook), or to a DMA channel of
+ * a SPI or UART peripheral that emulates the SWO protocol (see also
+ * traceswo_spi.c and traceswo_uart.c).
+ *
+ * When the ring is full, new messages are dropped. The number of dropped
+ * messages is reported in-band, as a text message on a dedicated channel, so
+ * that it shows up in the trace viewer.
+ *
+ * The configuration is set with macros, which must be defined before including
+ * this file (or on the command line of the compiler):
+ *    - TRACERING_LINK        TRACERING_ITM (default), TRACERING_SPI or
+ *                            TRACERING_UART.
+ *    - TRACERING_SIZE        The size of each ring, in 32-bit items; this must
+ *                            be a power of two (default 256).
+ *    - TRACERING_CORES       The number of cores (default 1).
+ *    - TRACERING_CORE()      An expression that returns the number of the core
+ *                            that runs the code (default 0).
+ *    - TRACERING_DROPCHANNEL The channel for reporting dropped messages
+ *                            (default 31).
+ *    - TRACERING_DMABUF      The size of the DMA buffer in bytes, for the SPI
+ *                            and UART links (default 256).
+ *
+ * For the SPI and UART links, the application must implement the functions
+ * tracering_dma_start() and tracering_dma_busy(). Routines for initializing
+ * the peripherals are not included, as these are dependend on the particular
+ * micro-controller.
+ *
+ *
+ * Copyright 2026 CompuPhase
+ *
+ * This software is provided 'as-is', without any express or implied
+ * warranty. In no event will the authors be held liable for any damages
+ * arising from the use of this software.
+ *
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it
+ * freely, subject to the following restrictions:
+ *
+ * 1. The origin of this software must not be misrepresented; you must not
+ *    claim that you wrote the original software. If you use this software
+ *    in a product, an acknowledgment in the product documentation would be
+ *    appreciated but is not required.
+ * 2. Altered source versions must be plainly marked as such, and must not be
+ *    misrepresented as being the original software.
+ * 3. This notice may not be removed or altered from any source distribution.
+ */
+
+#ifndef __TRACESWO_RING_H
+#define __TRACESWO_RING_H
+
+#include <stdint.h>
+
+#define TRACERING_ITM   0
+#define TRACERING_SPI   1
+#define TRACERING_UART  2
+
+#if !defined TRACERING_LINK
+  #define TRACERING_LINK  TRACERING_ITM
+#endif
+#if !defined TRACERING_SIZE
+  #define TRACERING_SIZE  256
+#endif
+#if !defined TRACERING_CORES
+  #define TRACERING_CORES 1
+#endif
+#if !defined TRACERING_CORE
+  #define TRACERING_CORE()  0
+#endif
+#if !defined TRACERING_DROPCHANNEL
+  #define TRACERING_DROPCHANNEL 31
+#endif
+#if !defined TRACERING_DMABUF
+  #define TRACERING_DMABUF  256
+#endif
+
+#if (TRACERING_SIZE & (TRACERING_SIZE - 1)) != 0
+  #error TRACERING_SIZE must be a power of 2
+#endif
+
+#if TRACERING_LINK != TRACERING_ITM
+/** traceswo_enable() allows you to enable or disable any of the 32 channels
+ *  (for the SPI and UART links; for the ITM, the channels are enabled in the
+ *  ITM registers).
+ *
+ *  \param channelmask  A bit mask. Set the bits for the channels that you wish
+ *                      to enabe or disable. Zero bits in the mask have no
+ *                      effect.
+ *  \param enable       If non-zero, the channels in the mask are enabled; if
+ *                      zero, the channels in the mask are disabled.
+ *
+ *  \return The updated channel mask.
+ */
+uint32_t traceswo_enable(uint32_t channelmask, int enable);
+#endif
+
+/** tracering_sz() stores a zero-terminated string in the ring. This function
+ *  is built upon tracering_bin().
+ *
+ *  \param channel  The channel number (0..31).
+ *  \param msg      A zero-terminated string.
+ *
+ *  \return 1 on success, 0 if the message was dropped.
+ */
+int tracering_sz(int channel, const char *msg);
+
+/** tracering_bin() stores a buffer of data (which may contain embedded zeros)
+ *  in the ring. The message is either stored completely, or it is dropped
+ *  completely (when the ring is full). This function may be called from
+ *  interrupt handlers; it does not block.
+ *
+ *  \param channel  The channel number (0..31).
+ *  \param data     The buffer to transmit.
+ *  \param size     The size of the data buffer.
+ *
+ *  \return 1 on success, 0 if the message was dropped.
+ */
+int tracering_bin(int channel, const unsigned char *data, unsigned size);
+
+/** tracering_u32() stores a single 32-bit value in the ring. This is the
+ *  fastest way to log an event from an interrupt handler.
+ *
+ *  \param channel  The channel number (0..31).
+ *  \param value    The value to transmit.
+ *
+ *  \return 1 on success, 0 if the value was dropped.
+ */
+int tracering_u32(int channel, uint32_t value);
+
+/** tracering_drain() transmits the data in the rings of all cores, for as far
+ *  as the link accepts data without waiting. It is typically called from the
+ *  idle hook of the application (or the RTOS). It should be called from a
+ *  single core only.
+ *
+ *  For the ITM link, the function writes the data to the stimulus ports,
+ *  until the FIFO of a port is full. For the SPI and UART links, it fills a
+ *  DMA buffer and starts the transfer, unless the previous transfer is still
+ *  busy.
+ *
+ *  \return The number of items transmitted.
+ */
+unsigned tracering_drain(void);
+
+/** tracering_dropped() returns the total number of messages that were dropped
+ *  because the ring was full, for all cores.
+ */
+uint32_t tracering_dropped(void);
+
+#if TRACERING_LINK != TRACERING_ITM
+/** tracering_dma_start() must be implemented by the application: it starts a
+ *  DMA transfer of the buffer to the SPI or UART peripheral.
+ *
+ *  \param buffer   The data to transmit. The buffer remains valid (and
+ *                  unchanged) until tracering_dma_busy() returns 0.
+ *  \param size     The number of bytes in the buffer.
+ */
+void tracering_dma_start(const uint8_t *buffer, unsigned size);
+
+/** tracering_dma_busy() must be implemented by the application: it returns
+ *  whether the DMA transfer that was started last is still busy.
+ */
+int tracering_dma_busy(void);
+#endif
+
+#endif /* __TRACESWO_RING_H */
@@ -18,9 +18,12 @@
 #include <assert.h>
 #include <ctype.h>
 #include <malloc.h>
+#include <stdarg.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 #include "armdisasm.h"
+#include "c11threads.h"
 
 #if defined FORTIFY
 # include <alloc/fortify.h>
@@ -55,6 +58,7 @@ enum {
 #define sizearray(a)                  (sizeof(a) / sizeof((a)[0]))
 
 static int get_symbol(ARMSTATE *state, uint32_t address);
+static int symbol_lowerbound(const ARMSTATE *state, uint32_t address);
 
 static char const *conditions[] = {
   "eq", "ne",   /* Z flag */
@@ -158,6 +162,115 @@ static char *tail(char *text)
   return text + strlen(text);
 }
 
+static const char hexdigits[] = "0123456789abcdef";
+
+/* fmt_hex() writes a value in hexadecimal, with at least "digits" digits (with
+   leading zeros); returns a pointer behind the last digit */
+static char *fmt_hex(char *pos, const char *end, uint32_t value, int digits)
+{
+  char buffer[8];
+  int count = 0;
+  do {
+    buffer[count++] = hexdigits[value & 0x0f];
+    value >>= 4;
+  } while (value != 0 && count < 8);
+  while (count < digits && count < 8)
+    buffer[count++] = '0';
+  while (count > 0 && pos < end)
+    *pos++ = buffer[--count];
+  return pos;
+}
+
+/* fmt_dec() writes a signed value in decimal; returns a pointer behind the
+   last digit */
+static char *fmt_dec(char *pos, const char *end, long value, bool is_signed)
+{
+  char buffer[24];
+  int count = 0;
+  unsigned long v = (unsigned long)value;
+  if (is_signed && value < 0) {
+    if (pos < end)
+      *pos++ = '-';
+    v = 0 - v;
+  }
+  do {
+    buffer[count++] = (char)('0' + v % 10);
+    v /= 10;
+  } while (v != 0);
+  while (count > 0 && pos < end)
+    *pos++ = buffer[--count];
+  return pos;
+}
+
+/* fmt_vappend() is a minimal replacement for vsprintf(), that handles only the
+   conversions that the disassembler uses: %s, %d, %ld, %u and %x (with an
+   optional width with leading zeros, like in %08x); the result is truncated
+   at the end of the buffer */
+static char *fmt_vappend(char *pos, char *end, const char *format, va_list args)
+{
+  assert(pos != NULL && end != NULL && pos < end);
+  end -= 1;   /* reserve space for the terminating zero */
+  while (*format != '\0' && pos < end) {
+    if (*format != '%') {
+      *pos++ = *format++;
+      continue;
+    }
+    format++;
+    int width = 0;
+    while (*format >= '0' && *format <= '9')
+      width = 10 * width + (*format++ - '0');
+    bool is_long = false;
+    if (*format == 'l') {
+      is_long = true;
+      format++;
+    }
+    switch (*format++) {
+    case 's': {
+      const char *str = va_arg(args, const char*);
+      if (str == NULL)
+        str = "(null)";
+      while (*str != '\0' && pos < end)
+        *pos++ = *str++;
+      break;
+    }
+    case 'd':
+      pos = fmt_dec(pos, end, is_long ? va_arg(args, long) : va_arg(args, int), true);
+      break;
+    case 'u':
+      pos = fmt_dec(pos, end, is_long ? (long)va_arg(args, unsigned long) : (long)va_arg(args, unsigned), false);
+      break;
+    case 'x':
+      pos = fmt_hex(pos, end, is_long ? (uint32_t)va_arg(args, unsigned long) : va_arg(args, unsigned), width);
+      break;
+    default:
+      assert(0);  /* conversion not supported */
+    }
+  }
+  *pos = '\0';
+  return pos;
+}
+
+/* fmt_print() formats a string in a buffer, see fmt_vappend() */
+static void fmt_print(char *buffer, size_t size, const char *format, ...)
+{
+  assert(buffer != NULL && size > 0);
+  va_list args;
+  va_start(args, format);
+  fmt_vappend(buffer, buffer + size, format, args);
+  va_end(args);
+}
+
+/* text_append() formats text behind the decoded instruction text (in
+   state->text), see fmt_vappend() */
+static void text_append(ARMSTATE *state, const char *format, ...)
+{
+  assert(state != NULL);
+  va_list args;
+  va_start(args, format);
+  fmt_vappend(tail(state->text), state->text + sizearray(state->text), format, args);
+  va_end(args);
+}
+
 static void padinstr(char *text)
 {
   assert(text != NULL);
@@ -222,27 +335,42 @@ static void add_insert_prefix(ARMSTATE *state, uint32_t instr)
 {
   assert(state != NULL);
 
-  char prefix[32] = "";
-  if (state->add_addr)
-    sprintf(prefix, "%08x    ", state->address);
+  char prefix[32];
+  char *pos = prefix;
+  char *end = prefix + sizearray(prefix);
+  if (state->add_addr) {
+    pos = fmt_hex(pos, end, state->address, 8);
+    memset(pos, ' ', 4);
+    pos += 4;
+  }
 
   if (state->add_bin) {
     if (state->arm_mode) {
-      sprintf(tail(prefix), "%08x    ", instr);
+      pos = fmt_hex(pos, end, instr, 8);
+      memset(pos, ' ', 4);
+      pos += 4;
     } else {
-      if (state->size == 4)
-        sprintf(tail(prefix), "%04x %04x   ", (instr >> 16) & 0xffff, instr & 0xffff);
-      else
-        sprintf(tail(prefix), "%04x        ", instr & 0xffff);
+      if (state->size == 4) {
+        pos = fmt_hex(pos, end, (instr >> 16) & 0xffff, 4);
+        *pos++ = ' ';
+        pos = fmt_hex(pos, end, instr & 0xffff, 4);
+        memset(pos, ' ', 3);
+        pos += 3;
+      } else {
+        pos = fmt_hex(pos, end, instr & 0xffff, 4);
+        memset(pos, ' ', 8);
+        pos += 8;
+      }
     }
   }
 
-  int len = strlen(prefix);
+  int len = (int)(pos - prefix);
   assert(len == 0|| len == 12 || len == 24);
   if (len > 0) {
-    assert(len + strlen(state->text) < sizearray(state->text));
-    memmove(state->text + len, state->text, strlen(state->text) + 1);
-    memmove(state->text, prefix, len);
+    size_t textlen = strlen(state->text);
+    assert(len + textlen < sizearray(state->text));
+    memmove(state->text + len, state->text, textlen + 1);
+    memcpy(state->text, prefix, len);
   }
 }
 
@@ -251,17 +379,19 @@ static void append_comment(ARMSTATE *state, const char *text, const char *separa
   assert(state != NULL);
   assert(state->add_cmt);
 
-  int len = strlen(state->text);
-  int padding = 24 - len;
-  if (padding < 2)
-    padding = 2;
+  size_t len = strlen(state->text);
+  size_t padding = (len < 22) ? 24 - len : 2;
 
   char prefix[40];
+  size_t prefixlen;
   if (separator == NULL) {
     memset(prefix, ' ', padding);
-    strcpy(prefix + padding, "; ");
+    memcpy(prefix + padding, "; ", 2);
+    prefixlen = padding + 2;
   } else {
-    strcpy(prefix, separator);
+    prefixlen = strlen(separator);
+    assert(prefixlen < sizearray(prefix));
+    memcpy(prefix, separator, prefixlen);
   }
 
   size_t size = sizearray(state->text);
@@ -269,9 +399,10 @@ static void append_comment(ARMSTATE *state, const char *text, const char *separa
     size -= 12;
   if (state->add_bin)
     size -= 12;
-  if (strlen(state->text) + strlen(prefix) + strlen(text) < size) {
-    strcat(state->text, prefix);
-    strcat(state->text, text);
+  size_t textlen = strlen(text);
+  if (len + prefixlen + textlen < size) {
+    memcpy(state->text + len, prefix, prefixlen);
+    memcpy(state->text + len + prefixlen, text, textlen + 1);
   }
 }
 
@@ -279,8 +410,8 @@ static void append_comment_hex(ARMSTATE *state, uint32_t value)
 {
   assert(state != NULL);
   if (state->add_cmt && value >= 10) {
-    char hex[40];
-    sprintf(hex, "0x%x", value);
+    char hex[16] = "0x";
+    *fmt_hex(hex + 2, hex + sizearray(hex), value, 1) = '\0';
     append_comment(state, hex, NULL);
   }
 }
@@ -295,13 +426,28 @@ static void append_comment_symbol(ARMSTATE *state, uint32_t address)
   }
 }
 
+/* pool_lowerbound() returns the index of the first entry in the codepool with
+   an address that is equal to or above the given address (or poolcount if
+   there is none) */
+static int pool_lowerbound(const ARMSTATE *state, uint32_t address)
+{
+  assert(state != NULL);
+  int low = 0, high = state->poolcount;
+  while (low < high) {
+    int mid = (low + high) / 2;
+    if (state->codepool[mid].address < address)
+      low = mid + 1;
+    else
+      high = mid;
+  }
+  return low;
+}
+
 static void mark_address_type(ARMSTATE *state, uint32_t address, int type)
 {
   assert(state != NULL);
   /* find the insertion point */
-  int pos;
-  for (pos = 0; pos < state->poolcount && state->codepool[pos].address < address; pos++)
-    {}
+  int pos = pool_lowerbound(state, address);
   if (pos >= state->poolcount || state->codepool[pos].address != address) {
     /* an entry must be added, first see whether there is space */
     assert(state->poolcount <= state->poolsize);
@@ -333,10 +479,13 @@ static int lookup_address_type(ARMSTATE *state, uint32_t address)
   assert(state != NULL);
   assert(state->poolcount == 0 || state->codepool != NULL);
   assert(state->poolcount <= state->poolsize);
-  int type = POOL_CODE;
-  for (int idx = 0; idx < state->poolcount && state->codepool[idx].address <= address; idx++)
-    type = state->codepool[idx].type;
-  return type;
+  /* the type is that of the last entry at or below the address */
+  int idx = pool_lowerbound(state, address);
+  if (idx < state->poolcount && state->codepool[idx].address == address)
+    return state->codepool[idx].type;
+  if (idx > 0)
+    return state->codepool[idx - 1].type;
+  return POOL_CODE;
 }
 
 static bool thumb_shift(ARMSTATE *state, unsigned instr, const char *opcode)
@@ -345,8 +494,8 @@ static bool thumb_shift(ARMSTATE *state, unsigned instr, const char *opcode)
   strcpy(state->text, opcode);
   add_it_cond(state, 1);
   padinstr(state->text);
-  sprintf(tail(state->text), "%s, %s, #%u", register_name(FIELD(instr, 0, 3)),
-          register_name(FIELD(instr, 3, 3)), FIELD(instr, 6, 5));
+  text_append(state, "%s, %s, #%u", register_name(FIELD(instr, 0, 3)),
+              register_name(FIELD(instr, 3, 3)), FIELD(instr, 6, 5));
   state->size = 2;
   return true;
 }
@@ -358,8 +507,8 @@ static bool thumb_lsl(ARMSTATE *state, uint32_t instr)
     assert(state->it_mask == 0); /* this instruction is not valid inside an IT block*/
     strcpy(state->text, "movs");
     padinstr(state->text);
-    sprintf(tail(state->text), "%s, %s", register_name(FIELD(instr, 0, 3)),
-            register_name(FIELD(instr, 3, 3)));
+    text_append(state, "%s, %s", register_name(FIELD(instr, 0, 3)),
+                register_name(FIELD(instr, 3, 3)));
     state->size = 2;
     return true;
   }
@@ -387,8 +536,8 @@ static bool thumb_addsub_reg(ARMSTATE *state, uint32_t instr)
     strcpy(state->text, "add");
   add_it_cond(state, 1);
   padinstr(state->text);
-  sprintf(tail(state->text), "%s, %s, %s", register_name(FIELD(instr, 0, 3)),
-          register_name(FIELD(instr, 3, 3)), register_name(FIELD(instr, 6, 3)));
+  text_append(state, "%s, %s, %s", register_name(FIELD(instr, 0, 3)),
+              register_name(FIELD(instr, 3, 3)), register_name(FIELD(instr, 6, 3)));
   state->size = 2;
   return true;
 }
@@ -403,8 +552,8 @@ static bool thumb_addsub_imm(ARMSTATE *state, uint32_t instr)
   add_it_cond(state, 1);
   padinstr(state->text);
   uint32_t imm = FIELD(instr, 6, 3);
-  sprintf(tail(state->text), "%s, %s, #%u", register_name(FIELD(instr, 0, 3)),
-          register_name(FIELD(instr, 3, 3)), imm);
+  text_append(state, "%s, %s, #%u", register_name(FIELD(instr, 0, 3)),
+              register_name(FIELD(instr, 3, 3)), imm);
   append_comment_hex(state, imm);
   state->size = 2;
   return true;
@@ -421,7 +570,7 @@ static bool thumb_immop(ARMSTATE *state, uint32_t instr)
     add_it_cond(state, 1);
   padinstr(state->text);
   uint32_t imm = FIELD(instr, 0, 8);
-  sprintf(tail(state->text), "%s, #%u", register_name(FIELD(instr, 8, 3)), imm);
+  text_append(state, "%s, #%u", register_name(FIELD(instr, 8, 3)), imm);
   append_comment_hex(state, imm);
   state->size = 2;
   return true;
@@ -439,8 +588,8 @@ static bool thumb_regop(ARMSTATE *state, uint32_t instr)
   strcpy(state->text, mnemonics[opc]);
   add_it_cond(state, (opc != 8 && opc != 10 && opc != 11));
   padinstr(state->text);
-  sprintf(tail(state->text), "%s, %s", register_name(FIELD(instr, 0, 3)),
-          register_name(FIELD(instr, 3, 3)));
+  text_append(state, "%s, %s", register_name(FIELD(instr, 0, 3)),
+              register_name(FIELD(instr, 3, 3)));
   state->size = 2;
   return true;
 }
@@ -472,9 +621,9 @@ static bool thumb_regop_hi(ARMSTATE *state, uint32_t instr)
     Rd += 8;
   int Rm = FIELD(instr, 3, 4);
   if (opc == 0 && Rm == 13)
-    sprintf(tail(state->text), "%s, sp, %s", register_name(Rd), register_name(Rd));
+    text_append(state, "%s, sp, %s", register_name(Rd), register_name(Rd));
   else
-    sprintf(tail(state->text), "%s, %s", register_name(Rd), register_name(Rm));
+    text_append(state, "%s, %s", register_name(Rd), register_name(Rm));
   state->size = 2;
   return true;
 }
@@ -499,7 +648,7 @@ static bool thumb_load_lit(ARMSTATE *state, uint32_t instr)
   add_it_cond(state, 0);
   padinstr(state->text);
   uint32_t offs = 4 * FIELD(instr, 0, 8);
-  sprintf(tail(state->text), "%s, [pc, #%u]", register_name(FIELD(instr, 8, 3)), offs);
+  text_append(state, "%s, [pc, #%u]", register_name(FIELD(instr, 8, 3)), offs);
   state->ldr_addr = ALIGN4(state->address + 4) + offs;
   append_comment_hex(state, state->ldr_addr);
   mark_address_type(state, state->ldr_addr, POOL_LITERAL);
@@ -518,8 +667,8 @@ static bool thumb_loadstor_reg(ARMSTATE *state, uint32_t instr)
   strcpy(state->text, mnemonics[opc]);
   add_it_cond(state, 0);
   padinstr(state->text);
-  sprintf(tail(state->text), "%s, [%s, %s]", register_name(FIELD(instr, 0, 3)),
-          register_name(FIELD(instr, 3, 3)), register_name(FIELD(instr, 6, 3)));
+  text_append(state, "%s, [%s, %s]", register_name(FIELD(instr, 0, 3)),
+              register_name(FIELD(instr, 3, 3)), register_name(FIELD(instr, 6, 3)));
   state->size = 2;
   return true;
 }
@@ -538,8 +687,8 @@ static bool thumb_loadstor_imm(ARMSTATE *state, uint32_t instr)
     offs *= 4;
   add_it_cond(state, 0);
   padinstr(state->text);
-  sprintf(tail(state->text), "%s, [%s, #%u]", register_name(FIELD(instr, 0, 3)),
-          register_name(FIELD(instr, 3, 3)), offs);
+  text_append(state, "%s, [%s, #%u]", register_name(FIELD(instr, 0, 3)),
+              register_name(FIELD(instr, 3, 3)), offs);
   append_comment_hex(state, offs);
   state->size = 2;
   return true;
@@ -555,8 +704,8 @@ static bool thumb_loadstor_hw(ARMSTATE *state, uint32_t instr)
   add_it_cond(state, 0);
   padinstr(state->text);
   uint32_t offs = 2 * FIELD(instr, 6, 5);
-  sprintf(tail(state->text), "%s, [%s, #%u]", register_name(FIELD(instr, 0, 3)),
-          register_name(FIELD(instr, 3, 3)), offs);
+  text_append(state, "%s, [%s, #%u]", register_name(FIELD(instr, 0, 3)),
+              register_name(FIELD(instr, 3, 3)), offs);
   append_comment_hex(state, offs);
   state->size = 2;
   return true;
@@ -572,7 +721,7 @@ static bool thumb_loadstor_stk(ARMSTATE *state, uint32_t instr)
   add_it_cond(state, 0);
   padinstr(state->text);
   uint32_t offs = 4 * FIELD(instr, 0, 7);
-  sprintf(tail(state->text), "%s, [sp, #%u]", register_name(FIELD(instr, 8, 3)), offs);
+  text_append(state, "%s, [sp, #%u]", register_name(FIELD(instr, 8, 3)), offs);
   append_comment_hex(state, offs);
   state->size = 2;
   return true;
@@ -588,7 +737,7 @@ static bool thumb_add_sp_pc_imm(ARMSTATE *state, uint32_t instr)
   add_it_cond(state, 0);
   padinstr(state->text);
   uint32_t imm = FIELD(instr, 0, 7);
-  sprintf(tail(state->text), "%s, sp, #%u", register_name(FIELD(instr, 8, 3)), imm);
+  text_append(state, "%s, sp, #%u", register_name(FIELD(instr, 8, 3)), imm);
   if (BIT_CLR(instr, 11))
     imm += ALIGN4(state->add_addr + 4); /* as it might be a code address, we cannot mark it as a literal pool */
   append_comment_hex(state, imm);
@@ -606,7 +755,7 @@ static bool thumb_adj_sp(ARMSTATE *state, uint32_t instr)
   add_it_cond(state, 0);
   padinstr(state->text);
   uint32_t imm = 4 * FIELD(instr, 0, 7);
-  sprintf(tail(state->text), "sp, #%u", imm);
+  text_append(state, "sp, #%u", imm);
   append_comment_hex(state, imm);
   state->size = 2;
   return true;
@@ -621,8 +770,8 @@ static bool thumb_sign_ext(ARMSTATE *state, uint32_t instr)
   strcpy(state->text, mnemonics[opc]);
   add_it_cond(state, 0);
   padinstr(state->text);
-  sprintf(tail(state->text), "%s, %s", register_name(FIELD(instr, 0, 3)),
-          register_name(FIELD(instr, 3, 3)));
+  text_append(state, "%s, %s", register_name(FIELD(instr, 0, 3)),
+              register_name(FIELD(instr, 3, 3)));
   state->size = 2;
   return true;
 }
@@ -639,7 +788,7 @@ static bool thumb_cmp_branch(ARMSTATE *state, uint32_t instr)
   if (BIT_SET(instr, 9))
     address += 32;
   address = state->address + 4 + 2 * address;
-  sprintf(tail(state->text), "%s, %07x", register_name(FIELD(instr, 0, 3)), address);
+  text_append(state, "%s, %07x", register_name(FIELD(instr, 0, 3)), address);
   mark_address_type(state, address, POOL_CODE);
   state->size = 2;
   return true;
@@ -726,7 +875,7 @@ static bool thumb_cpu_state(ARMSTATE *state, uint32_t instr)
   if (imod >= 2 && BIT_SET(instr, 8))
     strcat(state->text, ", ");  /* mode change follows */
   if (BIT_SET(instr, 8))
-    sprintf(tail(state->text), "#%u", FIELD(instr, 0, 5));
+    text_append(state, "#%u", FIELD(instr, 0, 5));
 #endif
 }
 
@@ -748,8 +897,8 @@ static bool thumb_reverse(ARMSTATE *state, uint32_t instr)
   }
   add_it_cond(state, 0);
   padinstr(state->text);
-  sprintf(tail(state->text), "%s, %s", register_name(FIELD(instr, 0, 3)),
-          register_name(FIELD(instr, 3, 3)));
+  text_append(state, "%s, %s", register_name(FIELD(instr, 0, 3)),
+              register_name(FIELD(instr, 3, 3)));
   state->size = 2;
   return true;
 }
@@ -759,7 +908,7 @@ static bool thumb_break(ARMSTATE *state, uint32_t instr)
   /* 1011 1110 xxxx xxxx - software breakpoint */
   strcpy(state->text, "bkpt");
   padinstr(state->text);
-  sprintf(tail(state->text), "#%u", FIELD(instr, 0, 8));
+  text_append(state, "#%u", FIELD(instr, 0, 8));
   state->size = 2;
   return true;
 }
@@ -852,7 +1001,7 @@ static bool thumb_condbranch(ARMSTATE *state, uint32_t instr)
   int32_t address = FIELD(instr, 0, 8);
   SIGN_EXT(address, 8);
   address = state->address + 4 + 2 * address;
-  sprintf(tail(state->text), "%07x", address);
+  text_append(state, "%07x", address);
   mark_address_type(state, address, POOL_CODE);
   state->size = 2;
   return true;
@@ -864,7 +1013,7 @@ static bool thumb_service(ARMSTATE *state, uint32_t instr)
   strcpy(state->text, "svc");
   add_it_cond(state, 0);
   padinstr(state->text);
-  sprintf(tail(state->text), "#%u", FIELD(instr, 0, 8));
+  text_append(state, "#%u", FIELD(instr, 0, 8));
   state->size = 2;
   return true;
 }
@@ -878,7 +1027,7 @@ static bool thumb_branch(ARMSTATE *state, uint32_t instr)
   int32_t offset = FIELD(instr, 0, 11);
   SIGN_EXT(offset, 11);
   int32_t address = state->address + 4 + 2 * offset;
-  sprintf(tail(state->text), "%07x", address);
+  text_append(state, "%07x", address);
   mark_address_type(state, address, POOL_CODE);
   state->size = 2;
   return true;
@@ -924,19 +1073,19 @@ static const char *decode_imm_shift(int type, int count)
     if (count == 0)
       field[0] = '\0';  /* LSL #0 is the default, so skip appending it */
     else
-      sprintf(field, "%s #%d", shift_type(type), count);
+      fmt_print(field, sizearray(field), "%s #%d", shift_type(type), count);
     break;
   case 1:
   case 2:
     if (count == 0)
       count = 32;
-    sprintf(field, "%s #%d", shift_type(type), count);
+    fmt_print(field, sizearray(field), "%s #%d", shift_type(type), count);
     break;
   case 3:
     if (count == 0)
-      sprintf(field, "rrx #1");
+      strcpy(field, "rrx #1");
     else
-      sprintf(field, "%s #%d", shift_type(type), count);
+      fmt_print(field, sizearray(field), "%s #%d", shift_type(type), count);
     break;
   }
   return field;
@@ -1048,17 +1197,17 @@ static bool thumb2_constshift(ARMSTATE *state, uint32_t instr)
   padinstr(state->text);
 
   if (Rd == 15)
-    sprintf(tail(state->text), "%s, %s", register_name(Rn), register_name(Rm));
+    text_append(state, "%s, %s", register_name(Rn), register_name(Rm));
   else if (Rn == 15)
-    sprintf(tail(state->text), "%s, %s", register_name(Rd), register_name(Rm));
+    text_append(state, "%s, %s", register_name(Rd), register_name(Rm));
   else
-    sprintf(tail(state->text), "%s, %s, %s", register_name(Rd), register_name(Rn),
-            register_name(Rm));
+    text_append(state, "%s, %s, %s", register_name(Rd), register_name(Rn),
+                register_name(Rm));
   if (opc == 2 && Rn == 15) {
     if ((shifttype != 0 && shifttype != 3) || imm != 0)
-      sprintf(tail(state->text), ", #%d", imm);
+      text_append(state, ", #%d", imm);
   } else if (shifttype != 0 || imm != 0) {
-      sprintf(tail(state->text), ", %s", decode_imm_shift(shifttype, imm));
+      text_append(state, ", %s", decode_imm_shift(shifttype, imm));
   }
 
   state->size = 4;
@@ -1123,12 +1272,12 @@ static bool thumb2_regshift_sx(ARMSTATE *state, uint32_t instr)
     add_it_cond(state, 0);
     padinstr(state->text);
     if (Rn == 15)
-      sprintf(tail(state->text), "%s, %s", register_name(Rd), register_name(Rm));
+      text_append(state, "%s, %s", register_name(Rd), register_name(Rm));
     else
-      sprintf(tail(state->text), "%s, %s, %s", register_name(Rd), register_name(Rn),
-              register_name(Rm));
+      text_append(state, "%s, %s, %s", register_name(Rd), register_name(Rn),
+                  register_name(Rm));
     if (rot != 0)
-      sprintf(tail(state->text), ", ror #%d", 8 * rot);
+      text_append(state, ", ror #%d", 8 * rot);
   } else {
     /* register-controlled shift */
     if ((instr & 0x00000070) != 0)
@@ -1138,8 +1287,8 @@ static bool thumb2_regshift_sx(ARMSTATE *state, uint32_t instr)
       strcat(state->text, "s");
     add_it_cond(state, 0);
     padinstr(state->text);
-    sprintf(tail(state->text), "%s, %s, %s", register_name(Rd), register_name(Rn),
-            register_name(Rm));
+    text_append(state, "%s, %s, %s", register_name(Rd), register_name(Rn),
+                register_name(Rm));
   }
   state->size = 4;
   return true;
@@ -1206,8 +1355,8 @@ static bool thumb2_simd_misc(ARMSTATE *state, uint32_t instr)
     }
     add_it_cond(state, 0);
     padinstr(state->text);
-    sprintf(tail(state->text), "%s, %s, %s", register_name(Rd), register_name(Rn),
-            register_name(Rm));
+    text_append(state, "%s, %s, %s", register_name(Rd), register_name(Rn),
+                register_name(Rm));
   } else {
     /* other three-register data processing */
     opc = (prefix << 4) | opc;  /* make single operation code (as BCD) from op & op2 */
@@ -1253,10 +1402,10 @@ static bool thumb2_simd_misc(ARMSTATE *state, uint32_t instr)
     add_it_cond(state, 0);
     padinstr(state->text);
     if (Rn == -1)
-      sprintf(tail(state->text), "%s, %s", register_name(Rd), register_name(Rm));
+      text_append(state, "%s, %s", register_name(Rd), register_name(Rm));
     else
-      sprintf(tail(state->text), "%s, %s, %s", register_name(Rd), register_name(Rn),
-              register_name(Rm));
+      text_append(state, "%s, %s, %s", register_name(Rd), register_name(Rn),
+                  register_name(Rm));
   }
   state->size = 4;
   return true;
@@ -1367,11 +1516,11 @@ static bool thumb2_mult32_acc(ARMSTATE *state, uint32_t instr)
   add_it_cond(state, 0);
   padinstr(state->text);
   if (Ra == 15)
-    sprintf(tail(state->text), "%s, %s, %s", register_name(Rd), register_name(Rn),
-            register_name(Rm));
+    text_append(state, "%s, %s, %s", register_name(Rd), register_name(Rn),
+                register_name(Rm));
   else
-    sprintf(tail(state->text), "%s, %s, %s, %s", register_name(Rd), register_name(Rn),
-            register_name(Rm), register_name(Ra));
+    text_append(state, "%s, %s, %s, %s", register_name(Rd), register_name(Rn),
+                register_name(Rm), register_name(Ra));
   state->size = 4;
   return true;
 }
@@ -1446,11 +1595,11 @@ static bool thumb2_mult64_acc(ARMSTATE *state, uint32_t instr)
   add_it_cond(state, 0);
   padinstr(state->text);
   if (RdLo == 15)
-    sprintf(tail(state->text), "%s, %s, %s", register_name(RdHi), register_name(Rn),
-            register_name(Rm));
+    text_append(state, "%s, %s, %s", register_name(RdHi), register_name(Rn),
+                register_name(Rm));
   else
-    sprintf(tail(state->text), "%s, %s, %s, %s", register_name(RdLo), register_name(RdHi),
-            register_name(Rn), register_name(Rm));
+    text_append(state, "%s, %s, %s, %s", register_name(RdLo), register_name(RdHi),
+                register_name(Rn), register_name(Rm));
   state->size = 4;
   return true;
 }
@@ -1494,7 +1643,7 @@ static bool thumb2_imm_br_misc(ARMSTATE *state, uint32_t instr)
       if (opc == 4)
         address = ALIGN4(state->address + 4); /* BLX target is aligned to 32-bit address */
       address += offset;
-      sprintf(tail(state->text), "%07x", address);
+      text_append(state, "%07x", address);
       append_comment_symbol(state, address);
       mark_address_type(state, address, POOL_CODE);
     } else if (FIELD(instr, 6+16, 4) < 14) {
@@ -1513,7 +1662,7 @@ static bool thumb2_imm_br_misc(ARMSTATE *state, uint32_t instr)
       strcat(state->text, conditions[c]);
       padinstr(state->text);
       int32_t address = state->address + 4 + offset;
-      sprintf(tail(state->text), "%07x", address);
+      text_append(state, "%07x", address);
       append_comment_symbol(state, address);
       mark_address_type(state, address, POOL_CODE);
     } else if (BIT_SET(instr, 26)) {
@@ -1524,7 +1673,7 @@ static bool thumb2_imm_br_misc(ARMSTATE *state, uint32_t instr)
       add_it_cond(state, 0);
       padinstr(state->text);
       uint32_t imm = FIELD(instr, 16, 4);
-      sprintf(tail(state->text), "#%u", imm);
+      text_append(state, "#%u", imm);
       append_comment_hex(state, imm);
     } else {
       /* others */
@@ -1534,8 +1683,8 @@ static bool thumb2_imm_br_misc(ARMSTATE *state, uint32_t instr)
         strcpy(state->text, "msr");
         add_it_cond(state, 0);
         padinstr(state->text);
-        sprintf(tail(state->text), "%s, %s", special_register(instr & 0xff, FIELD(instr, 8, 4)),
-                register_name(FIELD(instr, 16, 4)));
+        text_append(state, "%s, %s", special_register(instr & 0xff, FIELD(instr, 8, 4)),
+                    register_name(FIELD(instr, 16, 4)));
         break;
       case 1:
         if (FIELD(instr, 8, 3) == 0) {
@@ -1551,7 +1700,7 @@ static bool thumb2_imm_br_misc(ARMSTATE *state, uint32_t instr)
           add_it_cond(state, 0);
           if ((opc & 0xf0) == 0xf0) {
             padinstr(state->text);
-            sprintf(tail(state->text), "#%u", FIELD(instr, 0, 4));
+            text_append(state, "#%u", FIELD(instr, 0, 4));
           }
         } else {
           /* change processor state, special control operations */
@@ -1579,20 +1728,20 @@ static bool thumb2_imm_br_misc(ARMSTATE *state, uint32_t instr)
           strcpy(state->text, "subs");
           add_it_cond(state, 0);
           padinstr(state->text);
-          sprintf(tail(state->text), "pc, lr, #%u", FIELD(instr, 0, 8));
+          text_append(state, "pc, lr, #%u", FIELD(instr, 0, 8));
         } else {
           strcpy(state->text, "bxj");
           add_it_cond(state, 0);
           padinstr(state->text);
-          sprintf(tail(state->text), "%s", register_name(FIELD(instr, 16, 4)));
+          text_append(state, "%s", register_name(FIELD(instr, 16, 4)));
         }
         break;
       case 3:
         strcpy(state->text, "mrs");
         add_it_cond(state, 0);
         padinstr(state->text);
-        sprintf(tail(state->text), "%s, %s", register_name(FIELD(instr, 8, 4)),
-                special_register(instr & 0xff, FIELD(instr, 8, 4)));
+        text_append(state, "%s, %s", register_name(FIELD(instr, 8, 4)),
+                    special_register(instr & 0xff, FIELD(instr, 8, 4)));
         break;
       }
     }
@@ -1677,12 +1826,12 @@ static bool thumb2_imm_br_misc(ARMSTATE *state, uint32_t instr)
       add_it_cond(state, 0);
       padinstr(state->text);
       if (Rn >= 0 && Rd >= 0)
-        sprintf(tail(state->text), "%s, %s, #%ld", register_name(Rd),
-                register_name(Rn), imm);
+        text_append(state, "%s, %s, #%ld", register_name(Rd),
+                    register_name(Rn), imm);
       else if (Rn >= 0)
-        sprintf(tail(state->text), "%s, #%ld", register_name(Rn), imm);
+        text_append(state, "%s, #%ld", register_name(Rn), imm);
       else
-        sprintf(tail(state->text), "%s, #%ld", register_name(Rd), imm);
+        text_append(state, "%s, #%ld", register_name(Rd), imm);
       append_comment_hex(state, (uint32_t)imm);
     } else if ((instr & 0x03408000) == 0x02000000) {
       /* add/subtract, plain 12-bit immediate */
@@ -1705,11 +1854,11 @@ static bool thumb2_imm_br_misc(ARMSTATE *state, uint32_t instr)
       add_it_cond(state, 0);
       padinstr(state->text);
       if (opc == 0 || opc == 6) {
-        sprintf(tail(state->text), "%s, %s, #%u", register_name(Rd),
-                register_name(Rn), imm);
+        text_append(state, "%s, %s, #%u", register_name(Rd),
+                    register_name(Rn), imm);
         append_comment_hex(state, imm);
       } else {
-        sprintf(tail(state->text), "%s, %07x", register_name(Rd), imm);
+        text_append(state, "%s, %07x", register_name(Rd), imm);
         append_comment_symbol(state, imm);
       }
     } else if ((instr & 0x03408000) == 0x02400000) {
@@ -1718,7 +1867,7 @@ static bool thumb2_imm_br_misc(ARMSTATE *state, uint32_t instr)
       strcpy(state->text, "movw");
       add_it_cond(state, 0);
       padinstr(state->text);
-      sprintf(tail(state->text), "%s, #%u", register_name(Rd), imm);
+      text_append(state, "%s, #%u", register_name(Rd), imm);
       append_comment_hex(state, imm);
     } else if ((instr & 0x03108000) == 0x03000000) {
       /* bit-field operations, saturation with shift */
@@ -1760,24 +1909,24 @@ static bool thumb2_imm_br_misc(ARMSTATE *state, uint32_t instr)
       case 1:
       case 4:
       case 5:
-        sprintf(tail(state->text), "%s, #%d, %s", register_name(Rd), msb + 1,
-                register_name(Rn));
+        text_append(state, "%s, #%d, %s", register_name(Rd), msb + 1,
+                    register_name(Rn));
         int shifttype = BIT_SET(instr, 21) ? 2 : 0;
         if (shifttype != 0 || lsb != 0)
-          sprintf(tail(state->text), ", %s", decode_imm_shift(shifttype, lsb));
+          text_append(state, ", %s", decode_imm_shift(shifttype, lsb));
         break;
       case 2:
       case 6:
-        sprintf(tail(state->text), "%s, %s, #%d, #%d`", register_name(Rd),
-                register_name(Rn), lsb, msb + 1);
+        text_append(state, "%s, %s, #%d, #%d`", register_name(Rd),
+                    register_name(Rn), lsb, msb + 1);
         break;
       case 3:
         if (Rn == 15)
-          sprintf(tail(state->text), "%s, #%d, #%d", register_name(Rd),
-                  lsb, msb - lsb + 1);
+          text_append(state, "%s, #%d, #%d", register_name(Rd),
+                      lsb, msb - lsb + 1);
         else
-          sprintf(tail(state->text), "%s, %s, #%d, #%d", register_name(Rd),
-                  register_name(Rn), lsb, msb - lsb + 1);
+          text_append(state, "%s, %s, #%d, #%d", register_name(Rd),
+                      register_name(Rn), lsb, msb - lsb + 1);
         break;
       }
     } else {
@@ -1842,27 +1991,27 @@ static bool thumb2_loadstor(ARMSTATE *state, uint32_t instr)
   padinstr(state->text);
 
   if (!hint)
-    sprintf(tail(state->text), "%s, ", register_name(Rt));
+    text_append(state, "%s, ", register_name(Rt));
   if (Rn == 15) {
-    sprintf(tail(state->text), "[pc, #%ld]", imm);
+    text_append(state, "[pc, #%ld]", imm);
     state->ldr_addr = ALIGN4(state->address + 4) + imm;
     append_comment_hex(state, state->ldr_addr);
     mark_address_type(state, state->ldr_addr, POOL_LITERAL);
   } else {
     if (Rm >= 0 && shift >= 0) {
-      sprintf(tail(state->text), "[%s, %s, lsl #%d]", register_name(Rn),
-              register_name(Rm), shift);
+      text_append(state, "[%s, %s, lsl #%d]", register_name(Rn),
+                  register_name(Rm), shift);
 
     } else if (index == 1) {
-      sprintf(tail(state->text), "[%s, #%ld]", register_name(Rn), imm);
+      text_append(state, "[%s, #%ld]", register_name(Rn), imm);
       if (writeback == 1)
         strcat(state->text, "!");
       append_comment_hex(state, (uint32_t)imm);
     } else if (writeback == 1 || imm != 0) {
-      sprintf(tail(state->text), "[%s], #%ld", register_name(Rn), imm);
+      text_append(state, "[%s], #%ld", register_name(Rn), imm);
       append_comment_hex(state, (uint32_t)imm);
     } else {
-      sprintf(tail(state->text), "[%s]", register_name(Rn));
+      text_append(state, "[%s]", register_name(Rn));
     }
   }
   state->size = 4;
@@ -1893,19 +2042,19 @@ static bool thumb2_loadstor2(ARMSTATE *state, uint32_t instr)
     }
     if (BIT_SET(instr, 24) || BIT_CLR(instr, 21)) {
       if (BIT_CLR(instr, 24) || imm == 0) {
-        sprintf(tail(state->text), "%s, %s, [%s]", register_name(Rt),
-                register_name(Rt2), register_name(Rn));
+        text_append(state, "%s, %s, [%s]", register_name(Rt),
+                    register_name(Rt2), register_name(Rn));
       } else {
-        sprintf(tail(state->text), "%s, %s, [%s, #%d]", register_name(Rt),
-                register_name(Rt2), register_name(Rn), imm);
+        text_append(state, "%s, %s, [%s, #%d]", register_name(Rt),
+                    register_name(Rt2), register_name(Rn), imm);
         if (BIT_SET(instr, 21))
           strcat(state->text, "!");
         append_comment_hex(state, imm);
       }
     } else {
       assert(BIT_CLR(instr, 24) && BIT_SET(instr, 21));
-      sprintf(tail(state->text), "%s, %s, [%s], #%d", register_name(Rt),
-              register_name(Rt2), register_name(Rn), imm);
+      text_append(state, "%s, %s, [%s], #%d", register_name(Rt),
+                  register_name(Rt2), register_name(Rn), imm);
       append_comment_hex(state, (uint32_t)imm);
     }
   } else if (BIT_CLR(instr, 23)) {
@@ -1919,13 +2068,13 @@ static bool thumb2_loadstor2(ARMSTATE *state, uint32_t instr)
     imm *= 4;
     char imm_str[20] = "";
     if (imm != 0)
-      sprintf(imm_str, ", #%d]", imm);
+      fmt_print(imm_str, sizearray(imm_str), ", #%d]", imm);
     if (BIT_SET(instr, 20))
-      sprintf(tail(state->text), "%s, [%s%s]", register_name(Rt),
-              register_name(Rn), imm_str);
+      text_append(state, "%s, [%s%s]", register_name(Rt),
+                  register_name(Rn), imm_str);
     else
-      sprintf(tail(state->text), "%s, %s, [%s%s]", register_name(Rt2),
-              register_name(Rt), register_name(Rn), imm_str);
+      text_append(state, "%s, %s, [%s%s]", register_name(Rt2),
+                  register_name(Rt), register_name(Rn), imm_str);
     if (imm != 0)
       append_comment_hex(state, imm);
   } else {
@@ -1950,7 +2099,7 @@ static bool thumb2_loadstor2(ARMSTATE *state, uint32_t instr)
       padinstr(state->text);
       if (BIT_CLR(instr, 20))
         strcat(state->text, register_name(Rd));
-      sprintf(tail(state->text), ", %s [%s]", register_name(Rt), register_name(Rn));
+      text_append(state, ", %s [%s]", register_name(Rt), register_name(Rn));
       break;
     case 5:
       if (BIT_SET(instr, 20))
@@ -1961,7 +2110,7 @@ static bool thumb2_loadstor2(ARMSTATE *state, uint32_t instr)
       padinstr(state->text);
       if (BIT_CLR(instr, 20))
         strcat(state->text, register_name(Rd));
-      sprintf(tail(state->text), ", %s [%s]", register_name(Rt), register_name(Rn));
+      text_append(state, ", %s [%s]", register_name(Rt), register_name(Rn));
       break;
     case 7:
       if (BIT_SET(instr, 20))
@@ -1972,8 +2121,8 @@ static bool thumb2_loadstor2(ARMSTATE *state, uint32_t instr)
       padinstr(state->text);
       if (BIT_CLR(instr, 20))
         strcat(state->text, register_name(Rd));
-      sprintf(tail(state->text), ", %s, %s [%s]", register_name(Rt),
-              register_name(Rt2), register_name(Rn));
+      text_append(state, ", %s, %s [%s]", register_name(Rt),
+                  register_name(Rt2), register_name(Rn));
       break;
     default:
       return false;
@@ -2024,7 +2173,7 @@ static bool thumb2_loadstor_mul(ARMSTATE *state, uint32_t instr)
     strcat(state->text, (cat == 0) ? "db" : "ia");
     add_it_cond(state, 0);
     padinstr(state->text);
-    sprintf(tail(state->text), "#%u", FIELD(instr, 0, 5));
+    text_append(state, "#%u", FIELD(instr, 0, 5));
     if (BIT_CLR(instr, 21))
       strcat(state->text, "!");
   }
@@ -2049,21 +2198,21 @@ static bool thumb2_co_loadstor(ARMSTATE *state, uint32_t instr)
   add_it_cond(state, 0);
   padinstr(state->text);
   if (opc == 2) {
-    sprintf(tail(state->text), "%u, %u, %s, %s, cr%u", FIELD(instr, 8, 4),
-            FIELD(instr, 4, 4), register_name(FIELD(instr, 12, 4)),
-            register_name(FIELD(instr, 16, 4)), FIELD(instr, 0, 4));
+    text_append(state, "%u, %u, %s, %s, cr%u", FIELD(instr, 8, 4),
+                FIELD(instr, 4, 4), register_name(FIELD(instr, 12, 4)),
+                register_name(FIELD(instr, 16, 4)), FIELD(instr, 0, 4));
   } else {
     int imm = 4 * (int)FIELD(instr, 0, 8);
     if (BIT_CLR(instr, 23))
       imm = -imm;
     if (BIT_SET(instr, 24)) {
-      sprintf(tail(state->text), "%u, cr%u, [%s, #%d]", FIELD(instr, 8, 4),
-              FIELD(instr, 12, 4), register_name(FIELD(instr, 20, 4)), imm);
+      text_append(state, "%u, cr%u, [%s, #%d]", FIELD(instr, 8, 4),
+                  FIELD(instr, 12, 4), register_name(FIELD(instr, 20, 4)), imm);
       if (BIT_CLR(instr, 25))
         strcat(state->text, "!");
     } else {
-      sprintf(tail(state->text), "%u, cr%u, [%s], #%d", FIELD(instr, 8, 4),
-              FIELD(instr, 12, 4), register_name(FIELD(instr, 20, 4)), imm);
+      text_append(state, "%u, cr%u, [%s], #%d", FIELD(instr, 8, 4),
+                  FIELD(instr, 12, 4), register_name(FIELD(instr, 20, 4)), imm);
     }
   }
 
@@ -2080,9 +2229,9 @@ static bool thumb2_co_dataproc(ARMSTATE *state, uint32_t instr)
     strcat(state->text, "2");
   add_it_cond(state, 0);
   padinstr(state->text);
-  sprintf(tail(state->text), "%u, %u, cr%u, cr%u, cr%u, {%u}", FIELD(instr, 8, 4),
-          FIELD(instr, 20, 4), FIELD(instr, 12, 4), FIELD(instr, 16, 4),
-          FIELD(instr, 0, 4), FIELD(instr, 5, 3));
+  text_append(state, "%u, %u, cr%u, cr%u, cr%u, {%u}", FIELD(instr, 8, 4),
+              FIELD(instr, 20, 4), FIELD(instr, 12, 4), FIELD(instr, 16, 4),
+              FIELD(instr, 0, 4), FIELD(instr, 5, 3));
   state->size = 4;
   return true;
 }
@@ -2102,9 +2251,9 @@ static bool thumb2_co_trans(ARMSTATE *state, uint32_t instr)
 
   int Rt = FIELD(instr, 12, 4);
   const char *Rt_name = (Rt == 15) ? "APSR_nzcv" : register_name(Rt);
-  sprintf(tail(state->text), "%u, %u, %s, cr%u, cr%u, {%u}", FIELD(instr, 8, 4),
-          FIELD(instr, 21, 3), Rt_name, FIELD(instr, 16, 4),
-          FIELD(instr, 0, 4), FIELD(instr, 5, 3));
+  text_append(state, "%u, %u, %s, cr%u, cr%u, {%u}", FIELD(instr, 8, 4),
+              FIELD(instr, 21, 3), Rt_name, FIELD(instr, 16, 4),
+              FIELD(instr, 0, 4), FIELD(instr, 5, 3));
   state->size = 4;
   return true;
 }
@@ -2161,6 +2310,33 @@ static const ENCODEMASK16 thumb_table[] = {
   { 0xef10, 0xee10, thumb2_co_trans },  /* 32-bit Thumb2, co-processor register transfers */
 };
 
+/* The decode table maps the upper 8 bits of the first halfword to the entries
+   in thumb_table that may match (in the order of the table). For most values,
+   there is only a single candidate. */
+#define THUMB_MAXCANDIDATES 4
+static uint8_t thumb_decode[256][THUMB_MAXCANDIDATES];
+static uint8_t thumb_decode_count[256];
+static bool thumb_decode_valid = false;
+
+static void thumb_decode_init(void)
+{
+  assert(sizearray(thumb_table) < 256);
+  for (unsigned code = 0; code < 256; code++) {
+    uint16_t hw = (uint16_t)(code << 8);
+    thumb_decode_count[code] = 0;
+    for (size_t idx = 0; idx < sizearray(thumb_table); idx++) {
+      uint16_t mask = thumb_table[idx].mask & 0xff00;
+      if ((hw & mask) == (thumb_table[idx].match & mask)) {
+        assert(thumb_decode_count[code] < THUMB_MAXCANDIDATES);
+        thumb_decode[code][thumb_decode_count[code]++] = (uint8_t)idx;
+        if ((thumb_table[idx].mask & 0x00ff) == 0)
+          break;  /* this entry always matches, entries below it are never reached */
+      }
+    }
+  }
+  thumb_decode_valid = true;
+}
+
 static bool thumb_is_32bit(uint16_t w)
 {
   if ((w & 0xf800)== 0xe000)
@@ -2292,53 +2468,53 @@ static bool arm_dataproc_imsh(ARMSTATE *state, uint32_t instr)
     case 0: {
       const char *status = BIT_CLR(instr, 22) ? "CPSR" : "SPSR";
       if (BIT_CLR(instr, 21))
-        sprintf(tail(state->text), "%s, %s", register_name(FIELD(instr, 12, 4)), status);
+        text_append(state, "%s, %s", register_name(FIELD(instr, 12, 4)), status);
       else
-        sprintf(tail(state->text), "%s, %s", register_name(FIELD(instr, 0, 4)), status);
+        text_append(state, "%s, %s", register_name(FIELD(instr, 0, 4)), status);
       break;
     }
     case 1:
-      sprintf(tail(state->text), "%s", register_name(FIELD(instr, 0, 4)));
+      text_append(state, "%s", register_name(FIELD(instr, 0, 4)));
       break;
     default:
       switch (opc & 3) {
       case 0:
       case 1:
-        sprintf(tail(state->text), "%s, %s, %s, %s",
-                register_name(FIELD(instr, 16, 4)), register_name(FIELD(instr, 0, 4)),
-                register_name(FIELD(instr, 8, 4)), register_name(FIELD(instr, 12, 4)));
+        text_append(state, "%s, %s, %s, %s",
+                    register_name(FIELD(instr, 16, 4)), register_name(FIELD(instr, 0, 4)),
+                    register_name(FIELD(instr, 8, 4)), register_name(FIELD(instr, 12, 4)));
         break;
       case 2:
-        sprintf(tail(state->text), "%s, %s, %s, %s",
-                register_name(FIELD(instr, 12, 4)), register_name(FIELD(instr, 16, 4)),
-                register_name(FIELD(instr, 0, 4)), register_name(FIELD(instr, 8, 4)));
+        text_append(state, "%s, %s, %s, %s",
+                    register_name(FIELD(instr, 12, 4)), register_name(FIELD(instr, 16, 4)),
+                    register_name(FIELD(instr, 0, 4)), register_name(FIELD(instr, 8, 4)));
         break;
       case 3:
-        sprintf(tail(state->text), "%s, %s, %s", register_name(FIELD(instr, 16, 4)),
-                register_name(FIELD(instr, 0, 4)), register_name(FIELD(instr, 8, 4)));
+        text_append(state, "%s, %s, %s", register_name(FIELD(instr, 16, 4)),
+                    register_name(FIELD(instr, 0, 4)), register_name(FIELD(instr, 8, 4)));
         break;
       }
     }
   } else {
     switch (arm_opcode_form(opc)) {
     case 1:
-      sprintf(tail(state->text), "%s, %s", register_name(FIELD(instr, 16, 4)),
-              register_name(FIELD(instr, 0, 4)));
+      text_append(state, "%s, %s", register_name(FIELD(instr, 16, 4)),
+                  register_name(FIELD(instr, 0, 4)));
       break;
     case 2:
-      sprintf(tail(state->text), "%s, %s", register_name(FIELD(instr, 12, 4)),
-              register_name(FIELD(instr, 0, 4)));
+      text_append(state, "%s, %s", register_name(FIELD(instr, 12, 4)),
+                  register_name(FIELD(instr, 0, 4)));
       break;
     case 3:
-      sprintf(tail(state->text), "%s, %s, %s", register_name(FIELD(instr, 12, 4)),
-              register_name(FIELD(instr, 16, 4)), register_name(FIELD(instr, 0, 4)));
+      text_append(state, "%s, %s, %s", register_name(FIELD(instr, 12, 4)),
+                  register_name(FIELD(instr, 16, 4)), register_name(FIELD(instr, 0, 4)));
       break;
     }
     if (shifttype != 0 || shiftcount != 0) {
       if (opc == 13)
-        sprintf(tail(state->text), ", #%d", shiftcount);
+        text_append(state, ", #%d", shiftcount);
       else
-        sprintf(tail(state->text), ", %s", decode_imm_shift(shifttype, shiftcount));
+        text_append(state, ", %s", decode_imm_shift(shifttype, shiftcount));
     }
   }
 
@@ -2364,35 +2540,35 @@ static bool arm_dataproc_rxsh(ARMSTATE *state, uint32_t instr)
   if (opc >= 8 && opc < 12 && BIT_CLR(instr, 20)) {
     int opc2 = FIELD(instr, 5, 3);
     if ((opc & 0x03) == 1 && opc2 < 2) {
-      sprintf(tail(state->text), "%s", register_name(FIELD(instr, 0, 4)));  /* bx & blx */
+      text_append(state, "%s", register_name(FIELD(instr, 0, 4)));  /* bx & blx */
     } else if ((opc & 0x03) == 3 && opc2 == 0) {
-      sprintf(tail(state->text), "%s, %s", register_name(FIELD(instr, 12, 4)),
-              register_name(FIELD(instr, 0, 4)));  /* clz */
+      text_append(state, "%s, %s", register_name(FIELD(instr, 12, 4)),
+                  register_name(FIELD(instr, 0, 4)));  /* clz */
     } else if (opc2 == 2) {
-      sprintf(tail(state->text), "%s, %s, %s", register_name(FIELD(instr, 12, 4)),
-              register_name(FIELD(instr, 16, 4)), register_name(FIELD(instr, 0, 4)));
+      text_append(state, "%s, %s, %s", register_name(FIELD(instr, 12, 4)),
+                  register_name(FIELD(instr, 16, 4)), register_name(FIELD(instr, 0, 4)));
     } else if (opc2 == 3) {
       uint32_t imm = FIELD(instr, 0, 4) + (FIELD(instr, 8, 12) << 4);
-      sprintf(tail(state->text), "#%u", imm);
+      text_append(state, "#%u", imm);
       append_comment_hex(state, imm);
     }
   } else {
     switch (arm_opcode_form(opc)) {
     case 1:
-      sprintf(tail(state->text), "%s, %s", register_name(FIELD(instr, 16, 4)),
-              register_name(FIELD(instr, 0, 4)));
+      text_append(state, "%s, %s", register_name(FIELD(instr, 16, 4)),
+                  register_name(FIELD(instr, 0, 4)));
       break;
     case 2:
-      sprintf(tail(state->text), "%s, %s", register_name(FIELD(instr, 12, 4)),
-              register_name(FIELD(instr, 0, 4)));
+      text_append(state, "%s, %s", register_name(FIELD(instr, 12, 4)),
+                  register_name(FIELD(instr, 0, 4)));
       break;
     case 3:
-      sprintf(tail(state->text), "%s, %s, %s", register_name(FIELD(instr, 12, 4)),
-              register_name(FIELD(instr, 16, 4)), register_name(FIELD(instr, 0, 4)));
+      text_append(state, "%s, %s, %s", register_name(FIELD(instr, 12, 4)),
+                  register_name(FIELD(instr, 16, 4)), register_name(FIELD(instr, 0, 4)));
       break;
     }
-    sprintf(tail(state->text), ", %s %s", shift_type(FIELD(instr, 5, 2)),
-            register_name(FIELD(instr, 8, 4)));
+    text_append(state, ", %s %s", shift_type(FIELD(instr, 5, 2)),
+                register_name(FIELD(instr, 8, 4)));
   }
 
   return true;
@@ -2434,17 +2610,17 @@ static bool arm_mult_loadstor(ARMSTATE *state, uint32_t instr)
       strcat(state->text, "s");
     padinstr(state->text);
     if (opc >= 4)
-      sprintf(tail(state->text), "%s, %s, %s, %s",
-              register_name(FIELD(instr, 12, 4)), register_name(FIELD(instr, 16, 4)),
-              register_name(FIELD(instr, 0, 4)), register_name(FIELD(instr, 8, 4)));
+      text_append(state, "%s, %s, %s, %s",
+                  register_name(FIELD(instr, 12, 4)), register_name(FIELD(instr, 16, 4)),
+                  register_name(FIELD(instr, 0, 4)), register_name(FIELD(instr, 8, 4)));
     else if (BIT_SET(instr, 21))
-      sprintf(tail(state->text), "%s, %s, %s, %s",
-              register_name(FIELD(instr, 16, 4)), register_name(FIELD(instr, 0, 4)),
-              register_name(FIELD(instr, 8, 4)), register_name(FIELD(instr, 12, 4)));
+      text_append(state, "%s, %s, %s, %s",
+                  register_name(FIELD(instr, 16, 4)), register_name(FIELD(instr, 0, 4)),
+                  register_name(FIELD(instr, 8, 4)), register_name(FIELD(instr, 12, 4)));
     else
-      sprintf(tail(state->text), "%s, %s, %s",
-              register_name(FIELD(instr, 16, 4)), register_name(FIELD(instr, 0, 4)),
-              register_name(FIELD(instr, 8, 4)));
+      text_append(state, "%s, %s, %s",
+                  register_name(FIELD(instr, 16, 4)), register_name(FIELD(instr, 0, 4)),
+                  register_name(FIELD(instr, 8, 4)));
   } else {
     int format = 1;
     switch (opc2) {
@@ -2479,29 +2655,29 @@ static bool arm_mult_loadstor(ARMSTATE *state, uint32_t instr)
       if (BIT_SET(instr, 22)) {
         uint32_t imm = FIELD(instr, 0, 4) + (FIELD(instr, 8, 4) << 4);
         if (BIT_SET(instr, 24))
-          sprintf(tail(state->text), "%s, [%s, #%u]", register_name(FIELD(instr, 12, 4)),
-                  register_name(FIELD(instr, 16, 4)), imm);
+          text_append(state, "%s, [%s, #%u]", register_name(FIELD(instr, 12, 4)),
+                      register_name(FIELD(instr, 16, 4)), imm);
         else
-          sprintf(tail(state->text), "%s, [%s], #%u", register_name(FIELD(instr, 12, 4)),
-                  register_name(FIELD(instr, 16, 4)), imm);
+          text_append(state, "%s, [%s], #%u", register_name(FIELD(instr, 12, 4)),
+                      register_name(FIELD(instr, 16, 4)), imm);
       } else {
         if (BIT_SET(instr, 24))
-          sprintf(tail(state->text), "%s, [%s, %s]", register_name(FIELD(instr, 12, 4)),
-                  register_name(FIELD(instr, 16, 4)), register_name(FIELD(instr, 0, 4)));
+          text_append(state, "%s, [%s, %s]", register_name(FIELD(instr, 12, 4)),
+                      register_name(FIELD(instr, 16, 4)), register_name(FIELD(instr, 0, 4)));
         else
-          sprintf(tail(state->text), "%s, [%s], %s", register_name(FIELD(instr, 12, 4)),
-                  register_name(FIELD(instr, 16, 4)), register_name(FIELD(instr, 0, 4)));
+          text_append(state, "%s, [%s], %s", register_name(FIELD(instr, 12, 4)),
+                      register_name(FIELD(instr, 16, 4)), register_name(FIELD(instr, 0, 4)));
       }
       if (BIT_SET(instr, 21))
         strcat(state->text, "!");
       break;
     case 2:
-      sprintf(tail(state->text), "%s, %s", register_name(FIELD(instr, 12, 4)),
-              register_name(FIELD(instr, 16, 4)));
+      text_append(state, "%s, %s", register_name(FIELD(instr, 12, 4)),
+                  register_name(FIELD(instr, 16, 4)));
       break;
     case 3:
-      sprintf(tail(state->text), "%s, %s, [%s]", register_name(FIELD(instr, 12, 4)),
-              register_name(FIELD(instr, 0, 4)), register_name(FIELD(instr, 16, 4)));
+      text_append(state, "%s, %s, [%s]", register_name(FIELD(instr, 12, 4)),
+                  register_name(FIELD(instr, 0, 4)), register_name(FIELD(instr, 16, 4)));
       break;
     }
   }
@@ -2539,10 +2715,10 @@ static bool arm_dataproc_imm(ARMSTATE *state, uint32_t instr)
       strcat(state->text, "s");
     if (BIT_SET(instr, 19))
       strcat(state->text, "f");
-    sprintf(tail(state->text), ", #%u", imm);
+    text_append(state, ", #%u", imm);
   } else {
-    sprintf(tail(state->text), "%s, %s, #%u", register_name(FIELD(instr, 12, 4)),
-            register_name(FIELD(instr, 16, 4)), imm);
+    text_append(state, "%s, %s, #%u", register_name(FIELD(instr, 12, 4)),
+                register_name(FIELD(instr, 16, 4)), imm);
   }
 
   return true;
@@ -2568,12 +2744,12 @@ static bool arm_loadstor_imm(ARMSTATE *state, uint32_t instr)
   if (BIT_CLR(instr, 23))
     imm = -imm;
   if (cond != 15)
-    sprintf(tail(state->text), "%s, ", register_name(FIELD(instr, 12, 4)));
+    text_append(state, "%s, ", register_name(FIELD(instr, 12, 4)));
   int Rn = FIELD(instr, 16, 4);
   if (BIT_SET(instr, 24))
-    sprintf(tail(state->text), "[%s, #%d]", register_name(Rn), imm);
+    text_append(state, "[%s, #%d]", register_name(Rn), imm);
   else
-    sprintf(tail(state->text), "[%s], #%d", register_name(Rn), imm);
+    text_append(state, "[%s], #%d", register_name(Rn), imm);
   if (BIT_SET(instr, 21))
     strcat(state->text, "!");
   if (Rn == 15 && BIT_SET(instr, 24) && BIT_CLR(instr, 21)) {
@@ -2600,12 +2776,12 @@ static bool arm_loadstor_reg(ARMSTATE *state, uint32_t instr)
   padinstr(state->text);
 
   const char *sign = BIT_CLR(instr, 23) ? "-" : "";
-  sprintf(tail(state->text), "%s, [%s, %s%s", register_name(FIELD(instr, 12, 4)),
-          register_name(FIELD(instr, 16, 4)), sign, register_name(FIELD(instr, 0, 4)));
+  text_append(state, "%s, [%s, %s%s", register_name(FIELD(instr, 12, 4)),
+              register_name(FIELD(instr, 16, 4)), sign, register_name(FIELD(instr, 0, 4)));
   int shifttype = FIELD(instr, 5, 2);
   int shiftcount = FIELD(instr, 7, 5);
   if (shifttype != 0 || shiftcount != 0)
-    sprintf(tail(state->text), ", %s", decode_imm_shift(shifttype, shiftcount));
+    text_append(state, ", %s", decode_imm_shift(shifttype, shiftcount));
 
   strcat(state->text, "]");
   return true;
@@ -2671,8 +2847,8 @@ static bool arm_media(ARMSTATE *state, uint32_t instr)
     }
     add_condition(state, cond);
     padinstr(state->text);
-    sprintf(tail(state->text), "%s, %s, %s", register_name(Rd), register_name(Rn),
-            register_name(Rm));
+    text_append(state, "%s, %s, %s", register_name(Rd), register_name(Rn),
+                register_name(Rm));
   } else if (cat == 1) {
     /* halfword pack/saturate and others */
     int Rn = FIELD(instr, 16, 4);
@@ -2681,40 +2857,40 @@ static bool arm_media(ARMSTATE *state, uint32_t instr)
       strcpy(state->text, BIT_CLR(instr, 6) ? "pkhbt" : "pkhtb");
       add_condition(state, cond);
       padinstr(state->text);
-      sprintf(tail(state->text), "%s, %s, %s", register_name(Rd), register_name(Rn),
-              register_name(Rm));
+      text_append(state, "%s, %s, %s", register_name(Rd), register_name(Rn),
+                  register_name(Rm));
       int shift = FIELD(instr, 7, 5);
       if (BIT_CLR(instr, 6)) {
         if (shift != 0)
-          sprintf(tail(state->text), ", lsl #%d", shift);
+          text_append(state, ", lsl #%d", shift);
       } else {
         if (shift == 0)
           shift = 32;
-        sprintf(tail(state->text), ", asr #%d", shift);
+        text_append(state, ", asr #%d", shift);
       }
     } else if (BIT_CLR(instr, 5)) {
       /* word saturate */
       strcpy(state->text, BIT_CLR(instr, 22) ? "ssat" : "usat");
       add_condition(state, cond);
       padinstr(state->text);
-      sprintf(tail(state->text), "%s, #%u, %s", register_name(Rd),
-              FIELD(instr, 16, 5), register_name(Rm));
+      text_append(state, "%s, #%u, %s", register_name(Rd),
+                  FIELD(instr, 16, 5), register_name(Rm));
       int shift = FIELD(instr, 7, 5);
       if (shift == 0 && BIT_SET(instr, 6))
         shift = 32;
       if (shift != 0) {
         if (BIT_SET(instr, 6))
-          sprintf(tail(state->text), ", asr #%d", shift);
+          text_append(state, ", asr #%d", shift);
         else
-          sprintf(tail(state->text), ", lsl #%d", shift);
+          text_append(state, ", lsl #%d", shift);
       }
     } else if (FIELD(instr, 20, 2) == 2 && FIELD(instr, 4, 4) == 0x03) {
       /* parallel halfword saturate */
       strcpy(state->text, BIT_CLR(instr, 22) ? "ssat16" : "usat16");
       add_condition(state, cond);
       padinstr(state->text);
-      sprintf(tail(state->text), "%s, #%u, %s", register_name(Rd), FIELD(instr, 16, 4),
-              register_name(Rm));
+      text_append(state, "%s, #%u, %s", register_name(Rd), FIELD(instr, 16, 4),
+                  register_name(Rm));
     } else if (FIELD(instr, 20, 2) == 0x03 && FIELD(instr, 4, 3) == 0x03) {
       /* byte reverse word, packed halfword & signed halfword */
       strcpy(state->text, "rev");
@@ -2722,14 +2898,14 @@ static bool arm_media(ARMSTATE *state, uint32_t instr)
         strcat(state->text, BIT_CLR(instr, 22) ? "16" : "sh");
       add_condition(state, cond);
       padinstr(state->text);
-      sprintf(tail(state->text), "%s, %s", register_name(Rd), register_name(Rm));
+      text_append(state, "%s, %s", register_name(Rd), register_name(Rm));
     } else if (FIELD(instr, 20, 3) == 0 && FIELD(instr, 4, 4) == 0x0b) {
       /* select bytes */
       strcpy(state->text, "sel");
       add_condition(state, cond);
       padinstr(state->text);
-      sprintf(tail(state->text), "%s, %s, %s", register_name(Rd),
-              register_name(FIELD(instr, 16, 4)), register_name(Rm));
+      text_append(state, "%s, %s, %s", register_name(Rd),
+                  register_name(FIELD(instr, 16, 4)), register_name(Rm));
     } else if (FIELD(instr, 4, 4) == 0x07) {
       /* sign/zero extent */
       strcpy(state->text, BIT_CLR(instr, 22) ? "s" : "u");
@@ -2749,14 +2925,14 @@ static bool arm_media(ARMSTATE *state, uint32_t instr)
       add_condition(state, cond);
       padinstr(state->text);
       if (Rn == 15) {
-        sprintf(tail(state->text), "%s, %s", register_name(Rd), register_name(Rm));
+        text_append(state, "%s, %s", register_name(Rd), register_name(Rm));
       } else {
-        sprintf(tail(state->text), "%s, %s, %s", register_name(Rd),
-                register_name(Rn), register_name(Rm));
+        text_append(state, "%s, %s, %s", register_name(Rd),
+                    register_name(Rn), register_name(Rm));
       }
       int rot = FIELD(instr, 10, 2);
       if (rot != 0)
-        sprintf(tail(state->text), ", ror #%d", 8 * rot);
+        text_append(state, ", ror #%d", 8 * rot);
     } else {
       return false;   /* not a valid instruction pattern */
     }
@@ -2781,14 +2957,14 @@ static bool arm_media(ARMSTATE *state, uint32_t instr)
     add_condition(state, cond);
     padinstr(state->text);
     if (Rn == 15) {
-      sprintf(tail(state->text), "%s, %s, %s", register_name(Rd),
-              register_name(Rm), register_name(Rs));
+      text_append(state, "%s, %s, %s", register_name(Rd),
+                  register_name(Rm), register_name(Rs));
     } else if (opc1 == 4) {
-      sprintf(tail(state->text), "%s, %s, %s, %s", register_name(Rd),
-              register_name(Rn), register_name(Rm), register_name(Rs));
+      text_append(state, "%s, %s, %s, %s", register_name(Rd),
+                  register_name(Rn), register_name(Rm), register_name(Rs));
     } else {
-      sprintf(tail(state->text), "%s, %s, %s, %s", register_name(Rd),
-              register_name(Rm), register_name(Rs), register_name(Rn));
+      text_append(state, "%s, %s, %s, %s", register_name(Rd),
+                  register_name(Rm), register_name(Rs), register_name(Rn));
     }
   } else {
     /* unsigned sum of absolute differences / accumulate */
@@ -2799,11 +2975,11 @@ static bool arm_media(ARMSTATE *state, uint32_t instr)
     add_condition(state, cond);
     padinstr(state->text);
     if (Rn == 15)
-      sprintf(tail(state->text), "%s, %s, %s", register_name(Rd),
-              register_name(Rm), register_name(Rs));
+      text_append(state, "%s, %s, %s", register_name(Rd),
+                  register_name(Rm), register_name(Rs));
     else
-      sprintf(tail(state->text), "%s, %s, %s, %s", register_name(Rd),
-              register_name(Rm), register_name(Rs), register_name(Rn));
+      text_append(state, "%s, %s, %s, %s", register_name(Rd),
+                  register_name(Rm), register_name(Rs), register_name(Rn));
   }
 
   return true;
@@ -2862,7 +3038,7 @@ static bool arm_branch(ARMSTATE *state, uint32_t instr)
   int32_t address = FIELD(instr, 0, 24);
   SIGN_EXT(address, 24);
   address = state->address + 8 + 4 * address;
-  sprintf(tail(state->text), "%07x", address);
+  text_append(state, "%07x", address);
   append_comment_symbol(state, address);
   mark_address_type(state, address, POOL_CODE);
   return true;
@@ -2886,25 +3062,25 @@ static bool arm_co_loadstor(ARMSTATE *state, uint32_t instr)
     add_condition(state, cond);
   padinstr(state->text);
   if (prefix == 0xc4 || prefix == 0xc5) {
-    sprintf(tail(state->text), "%u, %u, %s, %s, cr%u", FIELD(instr, 8, 4),
-            FIELD(instr, 4, 4), register_name(FIELD(instr, 12, 4)),
-            register_name(FIELD(instr, 16, 4)), FIELD(instr, 0, 4));
+    text_append(state, "%u, %u, %s, %s, cr%u", FIELD(instr, 8, 4),
+                FIELD(instr, 4, 4), register_name(FIELD(instr, 12, 4)),
+                register_name(FIELD(instr, 16, 4)), FIELD(instr, 0, 4));
   } else {
     int imm = 4 * (int)FIELD(instr, 0, 8);
     if (BIT_CLR(instr, 23))
       imm = -imm;
     if (BIT_SET(instr, 24)) {
-      sprintf(tail(state->text), "%u, cr%u, [%s, #%d]", FIELD(instr, 8, 4),
-              FIELD(instr, 12, 4), register_name(FIELD(instr, 16, 4)), imm);
+      text_append(state, "%u, cr%u, [%s, #%d]", FIELD(instr, 8, 4),
+                  FIELD(instr, 12, 4), register_name(FIELD(instr, 16, 4)), imm);
       if (BIT_SET(instr, 21))
         strcat(state->text, "!");
     } else if (BIT_CLR(instr, 21)) {
-      sprintf(tail(state->text), "%u, cr%u, [%s], #%d", FIELD(instr, 8, 4),
-              FIELD(instr, 12, 4), register_name(FIELD(instr, 16, 4)), imm);
+      text_append(state, "%u, cr%u, [%s], #%d", FIELD(instr, 8, 4),
+                  FIELD(instr, 12, 4), register_name(FIELD(instr, 16, 4)), imm);
     } else {
-      sprintf(tail(state->text), "%u, cr%u, [%s], {%u}", FIELD(instr, 8, 4),
-              FIELD(instr, 12, 4), register_name(FIELD(instr, 16, 4)),
-              FIELD(instr, 0, 8));
+      text_append(state, "%u, cr%u, [%s], {%u}", FIELD(instr, 8, 4),
+                  FIELD(instr, 12, 4), register_name(FIELD(instr, 16, 4)),
+                  FIELD(instr, 0, 8));
     }
   }
 
@@ -2921,9 +3097,9 @@ static bool arm_co_dataproc(ARMSTATE *state, uint32_t instr)
   else
     add_condition(state, cond);
   padinstr(state->text);
-  sprintf(tail(state->text), "%u, %u, cr%u, cr%u, cr%u, {%u}", FIELD(instr, 8, 4),
-          FIELD(instr, 20, 4), FIELD(instr, 12, 4), FIELD(instr, 16, 4),
-          FIELD(instr, 0, 4), FIELD(instr, 5, 3));
+  text_append(state, "%u, %u, cr%u, cr%u, cr%u, {%u}", FIELD(instr, 8, 4),
+              FIELD(instr, 20, 4), FIELD(instr, 12, 4), FIELD(instr, 16, 4),
+              FIELD(instr, 0, 4), FIELD(instr, 5, 3));
   return true;
 }
 
@@ -2937,9 +3113,9 @@ static bool arm_co_trans(ARMSTATE *state, uint32_t instr)
   else
     add_condition(state, cond);
   padinstr(state->text);
-  sprintf(tail(state->text), "%u, %u, %s, cr%u, cr%u, {%u}", FIELD(instr, 8, 4),
-          FIELD(instr, 21, 3), register_name(FIELD(instr, 12, 4)),
-          FIELD(instr, 16, 4), FIELD(instr, 0, 4), FIELD(instr, 5, 3));
+  text_append(state, "%u, %u, %s, cr%u, cr%u, {%u}", FIELD(instr, 8, 4),
+              FIELD(instr, 21, 3), register_name(FIELD(instr, 12, 4)),
+              FIELD(instr, 16, 4), FIELD(instr, 0, 4), FIELD(instr, 5, 3));
   return true;
 }
 
@@ -2952,7 +3128,7 @@ static bool arm_softintr(ARMSTATE *state, uint32_t instr)
   strcpy(state->text, "svc");
   add_condition(state, cond);
   padinstr(state->text);
-  sprintf(tail(state->text), "0x%08x", FIELD(instr, 0, 24));
+  text_append(state, "0x%08x", FIELD(instr, 0, 24));
   return true;
 }
 
@@ -2972,14 +3148,29 @@ static const ENCODEMASK32 arm_table[] = {
   { 0x0f000000, 0x0f000000, arm_softintr },     /* software interrupt */
 };
 
+/* symbol_lowerbound() returns the index of the first symbol with an address
+   that is equal to or above the given address (or symbolcount if there is
+   none) */
+static int symbol_lowerbound(const ARMSTATE *state, uint32_t address)
+{
+  assert(state != NULL);
+  int low = 0, high = state->symbolcount;
+  while (low < high) {
+    int mid = (low + high) / 2;
+    if (state->symbols[mid].address < address)
+      low = mid + 1;
+    else
+      high = mid;
+  }
+  return low;
+}
+
 /** get_symbol() looks up a symbol; returns -1 if not found. The routine depends
  *  on the list being sorted (on address).
  */
 static int get_symbol(ARMSTATE *state, uint32_t address)
 {
-  int i;
-  for (i = 0; i < state->symbolcount && state->symbols[i].address < address; i++)
-    {}
+  int i = symbol_lowerbound(state, address);
   if (i < state->symbolcount && state->symbols[i].address == address)
     return i;
   return -1;
@@ -2991,11 +3182,11 @@ static void dump_word(ARMSTATE *state, uint32_t w)
   if (state->size == 4) {
     strcpy(state->text, ".word");
     padinstr(state->text);
-    sprintf(tail(state->text), "0x%08x", w);
+    text_append(state, "0x%08x", w);
   } else {
     strcpy(state->text, ".hword");
     padinstr(state->text);
-    sprintf(tail(state->text), "0x%04x", w & 0xffff);
+    text_append(state, "0x%04x", w & 0xffff);
   }
   if (state->add_cmt && state->size == 4) {
     if (get_symbol(state, w) >= 0) {
@@ -3070,7 +3261,11 @@ bool disasm_thumb(ARMSTATE *state, uint16_t hw, uint16_t hw2)
   }
 
   uint32_t instr = thumb_is_32bit(hw) ? ((uint32_t)hw << 16) | hw2 : hw;
-  for (size_t idx = 0; idx < sizearray(thumb_table); idx++) {
+  if (!thumb_decode_valid)
+    thumb_decode_init();
+  const uint8_t *candidates = thumb_decode[hw >> 8];
+  for (unsigned c = 0; c < thumb_decode_count[hw >> 8]; c++) {
+    size_t idx = candidates[c];
     if ((hw & thumb_table[idx].mask) == thumb_table[idx].match) {
       bool result = thumb_table[idx].func(state, instr);
       if (result) {
@@ -3145,6 +3340,8 @@ void disasm_init(ARMSTATE *state, int flags)
   assert(state != NULL);
   memset(state, 0, sizeof(ARMSTATE));
   state->ldr_addr = ~0;
+  if (!thumb_decode_valid)
+    thumb_decode_init();
 
   if (flags & DISASM_ADDRESS)
     state->add_addr = 1;
@@ -3180,9 +3377,7 @@ void disasm_compact_codepool(ARMSTATE *state, uint32_t address, uint32_t size)
   if (state->codepool == NULL)
     return;
   /* find start */
-  int idx;
-  for (idx = 0; idx < state->poolcount && state->codepool[idx].address < address; idx++)
-    {}
+  int idx = pool_lowerbound(state, address);
   if (idx == state->poolcount)
     return; /* all entries in the codepool are below the address, nothing to compact */
   /* run over the range compacting */
@@ -3250,9 +3445,7 @@ void disasm_symbol(ARMSTATE *state, const char *name, uint32_t address, int mode
   assert(state != NULL);
 
   /* find the insertion point */
-  int pos;
-  for (pos = 0; pos < state->symbolcount && state->symbols[pos].address < address; pos++)
-    {}
+  int pos = symbol_lowerbound(state, address);
   if (pos >= state->symbolcount || state->symbols[pos].address != address) {
     /* no entry yet at this address */
     char *namecopy = strdup(name);
@@ -3289,6 +3482,120 @@ void disasm_symbol(ARMSTATE *state, const char *name, uint32_t address, int mode
   }
 }
 
+typedef struct tagSYMBOLORDER {
+  ARMSYMBOL symbol;
+  int order;          /* position in the input list, for a stable sort */
+} SYMBOLORDER;
+
+static int symbolorder_cmp(const void *p1, const void *p2)
+{
+  const SYMBOLORDER *s1 = (const SYMBOLORDER*)p1;
+  const SYMBOLORDER *s2 = (const SYMBOLORDER*)p2;
+  if (s1->symbol.address != s2->symbol.address)
+    return (s1->symbol.address < s2->symbol.address) ? -1 : 1;
+  return s1->order - s2->order;
+}
+
+/** disasm_symbols() adds a list of symbols in one go. The result is the same
+ *  as calling disasm_symbol() for each symbol in the list, but the list is
+ *  sorted once, rather than inserting every symbol separately.
+ *
+ *  \param state    The decoder state.
+ *  \param list     An array with symbols; the names are copied.
+ *  \param count    The number of entries in the list.
+ *
+ *  \return true on success, false on a memory allocation failure (in which
+ *          case no symbols are added).
+ */
+bool disasm_symbols(ARMSTATE *state, const ARMSYMBOL *list, int count)
+{
+  assert(state != NULL);
+  assert(list != NULL || count == 0);
+  if (count <= 0)
+    return true;
+
+  /* sort the new symbols (for symbols at the same address, the first in the
+     list wins, like it does for disasm_symbol) */
+  SYMBOLORDER *sorted = malloc(count * sizeof(SYMBOLORDER));
+  if (sorted == NULL)
+    return false;
+  for (int i = 0; i < count; i++) {
+    sorted[i].symbol = list[i];
+    sorted[i].order = i;
+  }
+  qsort(sorted, count, sizeof(SYMBOLORDER), symbolorder_cmp);
+
+  /* merge the new symbols with the ones already in the list (which take
+     precedence); the same is done for the codepool */
+  ARMSYMBOL *symbols = malloc((state->symbolcount + count) * sizeof(ARMSYMBOL));
+  int poolsize = state->poolcount + count;
+  ARMPOOL *pool = malloc(poolsize * sizeof(ARMPOOL));
+  if (symbols == NULL || pool == NULL) {
+    free((void*)sorted);
+    free((void*)symbols);
+    free((void*)pool);
+    return false;
+  }
+  int numsymbols = 0, numpool = 0;
+  int src = 0, pos = 0, poolpos = 0;
+  bool ok = true;
+  while (src < count || pos < state->symbolcount) {
+    if (src < count && (pos >= state->symbolcount || sorted[src].symbol.address < state->symbols[pos].address)) {
+      const ARMSYMBOL *sym = &sorted[src].symbol;
+      symbols[numsymbols].name = strdup(sym->name);
+      if (symbols[numsymbols].name == NULL)
+        ok = false;
+      symbols[numsymbols].address = sym->address;
+      symbols[numsymbols].mode = sym->mode;
+      numsymbols++;
+      if (sym->mode == ARMMODE_ARM || sym->mode == ARMMODE_THUMB) {
+        while (poolpos < state->poolcount && state->codepool[poolpos].address < sym->address)
+          pool[numpool++] = state->codepool[poolpos++];
+        if ((poolpos >= state->poolcount || state->codepool[poolpos].address != sym->address)
+            && (numpool == 0 || pool[numpool - 1].address != sym->address))
+        {
+          memset(&pool[numpool], 0, sizeof(ARMPOOL));
+          pool[numpool].address = sym->address;
+          pool[numpool].type = POOL_CODE;
+          numpool++;
+        }
+      }
+      src++;
+    } else {
+      symbols[numsymbols++] = state->symbols[pos++];
+    }
+    /* skip new symbols at an address that is already in the list */
+    while (src < count && numsymbols > 0 && sorted[src].symbol.address == symbols[numsymbols - 1].address)
+      src++;
+  }
+  while (poolpos < state->poolcount)
+    pool[numpool++] = state->codepool[poolpos++];
+  free((void*)sorted);
+
+  if (!ok) {
+    /* undo on failure: free the copied names, keep the original lists */
+    for (int i = 0; i < numsymbols; i++) {
+      int j = symbol_lowerbound(state, symbols[i].address);
+      if (j >= state->symbolcount || state->symbols[j].name != symbols[i].name)
+        free((void*)symbols[i].name);
+    }
+    free((void*)symbols);
+    free((void*)pool);
+    return false;
+  }
+
+  if (state->symbols != NULL)
+    free((void*)state->symbols);
+  state->symbols = symbols;
+  state->symbolcount = state->symbolsize = numsymbols;
+  if (state->codepool != NULL)
+    free((void*)state->codepool);
+  state->codepool = pool;
+  state->poolcount = numpool;
+  state->poolsize = poolsize;
+  return true;
+}
+
 /** disarm_result() returns the text of the recently decoded instruction. You
  *  use this function when disassembling step-by-step with disasm_arm() and
  *  disasm_thumb().
@@ -3328,9 +3635,7 @@ bool disasm_buffer(ARMSTATE *state, const unsigned char *buffer, size_t buffersi
   assert(callback != NULL);
   /* find symbol for automatic mode switch, and set initial mode */
   int symbolindex = -1;
-  int i;
-  for (i = 0; i < state->symbolcount && state->symbols[i].address < state->address; i++)
-    {}
+  int i = symbol_lowerbound(state, state->address);
   if (i < state->symbolcount) {
     symbolindex = i;
     if (state->symbols[i].mode != ARMMODE_UNKNOWN)
@@ -3366,8 +3671,8 @@ bool disasm_buffer(ARMSTATE *state, const unsigned char *buffer, size_t buffersi
         if (sym_idx >= 0) {
           append_comment(state, state->symbols[sym_idx].name, " -> ");
         } else {
-          char hex[40];
-          sprintf(hex, "0x%x", address);
+          char hex[16] = "0x";
+          *fmt_hex(hex + 2, hex + sizearray(hex), address, 1) = '\0';
           append_comment(state, hex, " -> ");
         }
       }
@@ -3391,3 +3696,252 @@ bool disasm_buffer(ARMSTATE *state, const unsigned char *buffer, size_t buffersi
   return true;
 }
 
+#if !defined DISASM_THREADS
+# define DISASM_THREADS 4   /* set to 1 to disassemble all chunks in the calling thread */
+#endif
+
+typedef struct tagDISASMCHUNK {
+  uint32_t address;     /* start address of the chunk */
+  size_t offset;        /* offset in the buffer */
+  size_t length;        /* size in bytes */
+  const ARMSTATE *state;/* state of the worker that handles the chunk */
+  DISASM_LINE *lines;
+  unsigned count, size; /* number of lines used & allocated */
+  char *text;
+  size_t textlength, textsize;
+  bool result;
+} DISASMCHUNK;
+
+typedef struct tagDISASMQUEUE {
+  mtx_t lock;
+  int next;                     /* next chunk to process */
+  int count;                    /* total number of chunks */
+  DISASMCHUNK *chunks;
+  const ARMSTATE *state;        /* template for the state of each worker */
+  const unsigned char *buffer;
+  int mode;
+} DISASMQUEUE;
+
+static bool chunk_callback(uint32_t address, const char *text, void *user)
+{
+  DISASMCHUNK *chunk = (DISASMCHUNK*)user;
+  assert(chunk != NULL && chunk->state != NULL);
+  assert(text != NULL);
+  if (chunk->count >= chunk->size) {
+    unsigned newsize = (chunk->size == 0) ? 64 : 2 * chunk->size;
+    DISASM_LINE *list = realloc(chunk->lines, newsize * sizeof(DISASM_LINE));
+    if (list == NULL)
+      return false;
+    chunk->lines = list;
+    chunk->size = newsize;
+  }
+  size_t len = strlen(text) + 1;
+  if (chunk->textlength + len > chunk->textsize) {
+    size_t newsize = (chunk->textsize == 0) ? 1024 : 2 * chunk->textsize;
+    while (newsize < chunk->textlength + len)
+      newsize *= 2;
+    char *pool = realloc(chunk->text, newsize);
+    if (pool == NULL)
+      return false;
+    chunk->text = pool;
+    chunk->textsize = newsize;
+  }
+  memcpy(chunk->text + chunk->textlength, text, len);
+  chunk->lines[chunk->count].address = address;
+  chunk->lines[chunk->count].size = chunk->state->size;
+  chunk->lines[chunk->count].text = (uint32_t)chunk->textlength;
+  chunk->count += 1;
+  chunk->textlength += len;
+  return true;
+}
+
+static int disasm_worker(void *arg)
+{
+  DISASMQUEUE *queue = (DISASMQUEUE*)arg;
+  assert(queue != NULL && queue->state != NULL);
+
+  /* each worker has its own state, that shares the symbol list (which is not
+     modified during disassembly), but the codepool is copied */
+  ARMSTATE state = *queue->state;
+  state.codepool = NULL;
+  state.poolcount = state.poolsize = 0;
+  if (queue->state->poolcount > 0) {
+    state.codepool = malloc(queue->state->poolcount * sizeof(ARMPOOL));
+    if (state.codepool != NULL) {
+      memcpy(state.codepool, queue->state->codepool, queue->state->poolcount * sizeof(ARMPOOL));
+      state.poolcount = state.poolsize = queue->state->poolcount;
+    }
+  }
+
+  for ( ;; ) {
+    mtx_lock(&queue->lock);
+    int idx = queue->next++;
+    mtx_unlock(&queue->lock);
+    if (idx >= queue->count)
+      break;
+    DISASMCHUNK *chunk = &queue->chunks[idx];
+    chunk->state = &state;
+    disasm_address(&state, chunk->address);
+    chunk->result = disasm_buffer(&state, queue->buffer + chunk->offset, chunk->length,
+                                  queue->mode, chunk_callback, chunk);
+    chunk->state = NULL;
+  }
+
+  if (state.codepool != NULL)
+    free((void*)state.codepool);
+  return 0;
+}
+
+/** disasm_image() disassembles a complete code section. The section is split
+ *  at the addresses of the functions in the symbol list (see disasm_symbol()
+ *  and disasm_symbols()), and these chunks are disassembled in parallel.
+ *
+ *  \param state      The decoder state, with the options and the symbol list.
+ *                    The state is not modified (each worker thread uses a
+ *                    copy).
+ *  \param buffer     The buffer with machine code.
+ *  \param buffersize The size of the machine code buffer.
+ *  \param address    The address of the start of the buffer.
+ *  \param mode       ARMMODE_ARM or ARMMODE_THUMB, or ARMMODE_UNKNOWN to use
+ *                    the mode of the symbols.
+ *  \param image      [out] The disassembled lines, sorted on address. This
+ *                    structure must be freed with disasm_image_free().
+ *
+ *  \return true on success, false on failure (memory allocation error).
+ *
+ *  \note Literal pools are only detected inside the function whose code
+ *        refers to them.
+ */
+bool disasm_image(const ARMSTATE *state, const unsigned char *buffer, size_t buffersize,
+                  uint32_t address, int mode, DISASM_IMAGE *image)
+{
+  assert(state != NULL);
+  assert(buffer != NULL);
+  assert(image != NULL);
+  memset(image, 0, sizeof(DISASM_IMAGE));
+  if (!thumb_decode_valid)
+    thumb_decode_init();  /* make sure the decode table is built before starting threads */
+
+  /* split the buffer at the code symbols */
+  uint32_t top = address + (uint32_t)buffersize;
+  int first = symbol_lowerbound(state, address);
+  int numchunks = 1;
+  for (int i = first; i < state->symbolcount && state->symbols[i].address < top; i++)
+    if (state->symbols[i].address > address
+        && (state->symbols[i].mode == ARMMODE_ARM || state->symbols[i].mode == ARMMODE_THUMB))
+      numchunks++;
+  DISASMCHUNK *chunks = calloc(numchunks, sizeof(DISASMCHUNK));
+  if (chunks == NULL)
+    return false;
+  chunks[0].address = address;
+  numchunks = 1;
+  for (int i = first; i < state->symbolcount && state->symbols[i].address < top; i++) {
+    if (state->symbols[i].address > address
+        && (state->symbols[i].mode == ARMMODE_ARM || state->symbols[i].mode == ARMMODE_THUMB))
+    {
+      chunks[numchunks].address = state->symbols[i].address;
+      chunks[numchunks].offset = state->symbols[i].address - address;
+      chunks[numchunks - 1].length = chunks[numchunks].offset - chunks[numchunks - 1].offset;
+      numchunks++;
+    }
+  }
+  chunks[numchunks - 1].length = buffersize - chunks[numchunks - 1].offset;
+
+  /* disassemble the chunks, using DISASM_THREADS threads (including the
+     calling thread) */
+  DISASMQUEUE queue;
+  queue.next = 0;
+  queue.count = numchunks;
+  queue.chunks = chunks;
+  queue.state = state;
+  queue.buffer = buffer;
+  queue.mode = mode;
+  mtx_init(&queue.lock, mtx_plain);
+  thrd_t threads[DISASM_THREADS];
+  int numthreads = 0;
+  for (int idx = 1; idx < DISASM_THREADS && idx < numchunks; idx++)
+    if (thrd_create(&threads[numthreads], disasm_worker, &queue) == thrd_success)
+      numthreads++;
+  disasm_worker(&queue);
+  for (int idx = 0; idx < numthreads; idx++)
+    thrd_join(threads[idx], NULL);
+  mtx_destroy(&queue.lock);
+
+  /* concatenate the results */
+  bool result = true;
+  unsigned count = 0;
+  size_t textlength = 0;
+  for (int idx = 0; idx < numchunks; idx++) {
+    result = result && chunks[idx].result;
+    count += chunks[idx].count;
+    textlength += chunks[idx].textlength;
+  }
+  if (result && count > 0) {
+    image->lines = malloc(count * sizeof(DISASM_LINE));
+    image->text = malloc(textlength);
+    if (image->lines != NULL && image->text != NULL) {
+      for (int idx = 0; idx < numchunks; idx++) {
+        for (unsigned i = 0; i < chunks[idx].count; i++) {
+          image->lines[image->count] = chunks[idx].lines[i];
+          image->lines[image->count].text += (uint32_t)image->textsize;
+          image->count += 1;
+        }
+        if (chunks[idx].textlength > 0)
+          memcpy(image->text + image->textsize, chunks[idx].text, chunks[idx].textlength);
+        image->textsize += chunks[idx].textlength;
+      }
+    } else {
+      disasm_image_free(image);
+      result = false;
+    }
+  }
+  for (int idx = 0; idx < numchunks; idx++) {
+    free((void*)chunks[idx].lines);
+    free((void*)chunks[idx].text);
+  }
+  free((void*)chunks);
+  return result;
+}
+
+/** disasm_image_free() frees the memory allocated by disasm_image().
+ *
+ *  \param image    The disassembled image.
+ */
+void disasm_image_free(DISASM_IMAGE *image)
+{
+  assert(image != NULL);
+  if (image->lines != NULL)
+    free((void*)image->lines);
+  if (image->text != NULL)
+    free((void*)image->text);
+  memset(image, 0, sizeof(DISASM_IMAGE));
+}
+
+/** disasm_image_lookup() returns the line for the instruction that holds the
+ *  address.
+ *
+ *  \param image    The disassembled image.
+ *  \param address  The address to look up.
+ *
+ *  \return The line with the instruction, or NULL if the address is outside of
+ *          the image. The text of the line is at image->text + line->text.
+ */
+const DISASM_LINE *disasm_image_lookup(const DISASM_IMAGE *image, uint32_t address)
+{
+  assert(image != NULL);
+  unsigned low = 0, high = image->count;
+  while (low < high) {
+    unsigned mid = (low + high) / 2;
+    if (image->lines[mid].address <= address)
+      low = mid + 1;
+    else
+      high = mid;
+  }
+  if (low == 0)
+    return NULL;
+  const DISASM_LINE *line = &image->lines[low - 1];
+  if (address >= line->address + line->size)
+    return NULL;
+  return line;
+}
+
@@ -74,6 +74,7 @@ enum {
   ARMMODE_DATA,         /**< this symbol refers to a data object */
 };
 void disasm_symbol(ARMSTATE *state, const char *name, uint32_t address, int mode);
+bool disasm_symbols(ARMSTATE *state, const ARMSYMBOL *list, int count);
 void disasm_address(ARMSTATE *state, uint32_t address);
 
 bool disasm_thumb(ARMSTATE *state, uint16_t hw, uint16_t hw2);
@@ -84,5 +85,23 @@ typedef bool (*DISASM_CALLBACK)(uint32_t address, const char *text, void *user);
 bool disasm_buffer(ARMSTATE *state, const unsigned char *buffer, size_t buffersize,
                    int mode, DISASM_CALLBACK callback, void *user);
 
+typedef struct {
+  uint32_t address;   /**< address of the instruction */
+  uint16_t size;      /**< size of the instruction in bytes */
+  uint32_t text;      /**< offset of the text in the text buffer */
+} DISASM_LINE;
+
+typedef struct {
+  DISASM_LINE *lines; /**< disassembled lines, sorted on address */
+  unsigned count;     /**< number of entries in the lines array */
+  char *text;         /**< text of all lines (zero-terminated strings) */
+  size_t textsize;    /**< size of the text buffer */
+} DISASM_IMAGE;
+
+bool disasm_image(const ARMSTATE *state, const unsigned char *buffer, size_t buffersize,
+                  uint32_t address, int mode, DISASM_IMAGE *image);
+void disasm_image_free(DISASM_IMAGE *image);
+const DISASM_LINE *disasm_image_lookup(const DISASM_IMAGE *image, uint32_t address);
+
 #endif /* _ARMDISASM_H */
 
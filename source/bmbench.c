@@ -0,0 +1,401 @@
+/*
+ * Flash programming benchmark for the Black Magic Probe. It connects to a
+ * target, and measures the throughput of erasing, writing and verifying Flash
+ * memory with a synthetic image, plus the latency of RSP round trips. The
+ * results are printed in JSON format, for regression tracking.
+ *
+ * Copyright 2026 CompuPhase
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <assert.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#if defined _WIN32
+# define STRICT
+# define WIN32_LEAN_AND_MEAN
+# include <windows.h>
+#else
+# include <unistd.h>
+#endif
+#include "bmp-support.h"
+#include "gdb-rsp.h"
+#include "tcpip.h"
+#include "svnrev.h"
+
+#if defined FORTIFY
+# include <alloc/fortify.h>
+#endif
+
+#if defined WIN32 || defined _WIN32
+# define IS_OPTION(s)  ((s)[0] == '-' || (s)[0] == '/')
+#else
+# define IS_OPTION(s)  ((s)[0] == '-')
+#endif
+
+#if !defined sizearray
+# define sizearray(e)    (sizeof(e) / sizeof((e)[0]))
+#endif
+
+#define MAX_SAMPLES 10000
+
+
+static bool opt_verbose = false;
+
+static int bmp_callback(int code, const char *message)
+{
+  if (code < 0 || opt_verbose)
+    fprintf(stderr, "%s\n", message);
+  return 0;
+}
+
+static unsigned long long microseconds(void)
+{
+# if defined _WIN32
+    LARGE_INTEGER freq, count;
+    QueryPerformanceFrequency(&freq);
+    QueryPerformanceCounter(&count);
+    return (unsigned long long)(count.QuadPart / freq.QuadPart) * 1000000
+           + (unsigned long long)((count.QuadPart % freq.QuadPart) * 1000000 / freq.QuadPart);
+# else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (unsigned long long)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+# endif
+}
+
+/* prng() is a xorshift generator, so that the image is the same on every
+   platform for the same seed */
+static uint32_t random_state = 1;
+static uint32_t prng(void)
+{
+  random_state ^= random_state << 13;
+  random_state ^= random_state >> 17;
+  random_state ^= random_state << 5;
+  return random_state;
+}
+
+static void put16(unsigned char *buffer, unsigned value)
+{
+  buffer[0] = (unsigned char)(value & 0xff);
+  buffer[1] = (unsigned char)((value >> 8) & 0xff);
+}
+
+static void put32(unsigned char *buffer, unsigned long value)
+{
+  put16(buffer, (unsigned)(value & 0xffff));
+  put16(buffer + 2, (unsigned)((value >> 16) & 0xffff));
+}
+
+/* make_image() creates an ELF file with a single segment, at the start of
+   Flash memory; "entropy" is the percentage of bytes that are random, the
+   other bytes are zero */
+static FILE *make_image(unsigned long address, unsigned long size, int entropy)
+{
+  #define EHDR_SIZE 52
+  #define PHDR_SIZE 32
+  FILE *fp = tmpfile();
+  if (fp == NULL)
+    return NULL;
+
+  unsigned char header[EHDR_SIZE + PHDR_SIZE];
+  memset(header, 0, sizeof header);
+  memcpy(header, "\177ELF", 4);
+  header[4] = 1;                            /* 32-bit */
+  header[5] = 1;                            /* Little Endian */
+  header[6] = 1;                            /* ELF version */
+  put16(header + 16, 2);                    /* executable */
+  put16(header + 18, 40);                   /* ARM */
+  put32(header + 20, 1);                    /* ELF version */
+  put32(header + 24, address);              /* entry point */
+  put32(header + 28, EHDR_SIZE);            /* program header offset */
+  put32(header + 36, 0x05000000);           /* flags: EABI version 5 */
+  put16(header + 40, EHDR_SIZE);
+  put16(header + 42, PHDR_SIZE);
+  put16(header + 44, 1);                    /* number of program headers */
+  put16(header + 46, 40);                   /* section header entry size */
+  unsigned char *phdr = header + EHDR_SIZE;
+  put32(phdr, 1);                           /* PT_LOAD */
+  put32(phdr + 4, sizeof header);           /* file offset */
+  put32(phdr + 8, address);                 /* virtual address */
+  put32(phdr + 12, address);                /* physical address */
+  put32(phdr + 16, size);                   /* file size */
+  put32(phdr + 20, size);                   /* memory size */
+  put32(phdr + 24, 5);                      /* flags: read + execute */
+  put32(phdr + 28, 4);                      /* alignment */
+  fwrite(header, 1, sizeof header, fp);
+
+  for (unsigned long idx = 0; idx < size; idx++) {
+    unsigned char b = 0;
+    if ((int)(prng() % 100) < entropy)
+      b = (unsigned char)(prng() & 0xff);
+    fputc(b, fp);
+  }
+  fflush(fp);
+  return fp;
+}
+
+static int compare_ull(const void *a, const void *b)
+{
+  unsigned long long v1 = *(const unsigned long long*)a;
+  unsigned long long v2 = *(const unsigned long long*)b;
+  return (v1 < v2) ? -1 : (v1 > v2) ? 1 : 0;
+}
+
+/* measure_latency() times round trips of a small memory read; the samples
+   are returned sorted */
+static int measure_latency(unsigned long address, unsigned long long *samples, int count)
+{
+  char cmd[64], reply[64];
+  int num = 0;
+  for (int idx = 0; idx < count; idx++) {
+    sprintf(cmd, "m%lx,4", address);
+    unsigned long long tstamp = microseconds();
+    gdbrsp_xmit(cmd, -1);
+    size_t size = gdbrsp_recv(reply, sizearray(reply), 1000);
+    if (size == 0)
+      continue;
+    samples[num++] = microseconds() - tstamp;
+  }
+  qsort(samples, num, sizeof(unsigned long long), compare_ull);
+  return num;
+}
+
+static unsigned long long percentile(const unsigned long long *samples, int count, int pct)
+{
+  assert(count > 0);
+  assert(pct >= 0 && pct <= 100);
+  return samples[((count - 1) * pct + 50) / 100];
+}
+
+static void print_stage(const char *name, unsigned long bytes, unsigned long long usec, bool ok, bool last)
+{
+  unsigned long long rate = (usec > 0) ? (unsigned long long)bytes * 1000000 / usec : 0;
+  printf("  \"%s\": { \"ok\": %s, \"bytes\": %lu, \"ms\": %.3f, \"bytes_per_s\": %llu }%s\n",
+         name, ok ? "true" : "false", bytes, usec / 1000.0, rate, last ? "" : ",");
+}
+
+static void usage(const char *invalid_option)
+{
+  if (invalid_option != NULL)
+    fprintf(stderr, "Unknown option %s; use -h for help.\n\n", invalid_option);
+  else
+    printf("BMBench measures Flash programming throughput via a Black Magic Probe.\n\n");
+  printf("Usage: bmbench [options]\n\n"
+         "Options:\n"
+         "-entropy=n\tPercentage of random bytes in the image (the default is 100);\n"
+         "\t\tthe other bytes are zero.\n"
+         "-fast\t\tWith -replay, replay as fast as possible (instead of with the\n"
+         "\t\trecorded timing).\n"
+         "-ip=addr\tConnect to a ctxLink probe at this IP address.\n"
+         "-noerase\tSkip the full Flash erase before the download.\n"
+         "-overlap\tUse the overlapped erase/write/verify download.\n"
+         "-probe=n\tThe sequence number of the probe (starting at 1).\n"
+         "-record=file\tRecord the session with the probe to a file.\n"
+         "-replay=file\tReplay a recorded session, instead of using a probe. The\n"
+         "\t\tother options must be the same as for the recording.\n"
+         "-samples=n\tThe number of round trips to measure latency (default 200).\n"
+         "-seed=n\t\tThe seed for the random data in the image.\n"
+         "-size=n\t\tThe size of the image in bytes, may have suffix k (default 64k).\n"
+         "-v\t\tPrint status messages on stderr.\n"
+         "-window=n\tThe number of packets in flight (in no-ack mode).\n\n"
+         "The results are printed on stdout, in JSON format. The exit code is zero\n"
+         "if all stages succeed.\n");
+}
+
+static const char *option_value(const char *arg, const char *name)
+{
+  size_t len = strlen(name);
+  if (strncmp(arg + 1, name, len) != 0)
+    return NULL;
+  arg += len + 1;
+  if (*arg == '=' || *arg == ':')
+    return arg + 1;
+  return (*arg == '\0') ? arg : NULL;
+}
+
+int main(int argc, char *argv[])
+{
+  const char *ipaddr = NULL;
+  int probe = 0;
+  unsigned long size = 64 * 1024;
+  int entropy = 100;
+  int numsamples = 200;
+  int window = 0;
+  bool fullerase = true;
+  bool overlap = false;
+  unsigned long seed = 1;
+  const char *recordfile = NULL;
+  const char *replayfile = NULL;
+  bool realtime = true;
+
+  for (int idx = 1; idx < argc; idx++) {
+    const char *value;
+    if (!IS_OPTION(argv[idx])) {
+      usage(argv[idx]);
+      return EXIT_FAILURE;
+    }
+    if (strcmp(argv[idx] + 1, "h") == 0 || strcmp(argv[idx] + 1, "?") == 0) {
+      usage(NULL);
+      return EXIT_SUCCESS;
+    } else if ((value = option_value(argv[idx], "entropy")) != NULL) {
+      entropy = (int)strtol(value, NULL, 10);
+      if (entropy < 0)
+        entropy = 0;
+      else if (entropy > 100)
+        entropy = 100;
+    } else if (option_value(argv[idx], "fast") != NULL) {
+      realtime = false;
+    } else if ((value = option_value(argv[idx], "ip")) != NULL) {
+      ipaddr = value;
+    } else if (option_value(argv[idx], "noerase") != NULL) {
+      fullerase = false;
+    } else if (option_value(argv[idx], "overlap") != NULL) {
+      overlap = true;
+    } else if ((value = option_value(argv[idx], "probe")) != NULL) {
+      probe = (int)strtol(value, NULL, 10) - 1;
+      if (probe < 0)
+        probe = 0;
+    } else if ((value = option_value(argv[idx], "record")) != NULL && *value != '\0') {
+      recordfile = value;
+    } else if ((value = option_value(argv[idx], "replay")) != NULL && *value != '\0') {
+      replayfile = value;
+    } else if ((value = option_value(argv[idx], "samples")) != NULL) {
+      numsamples = (int)strtol(value, NULL, 10);
+      if (numsamples < 1)
+        numsamples = 1;
+      else if (numsamples > MAX_SAMPLES)
+        numsamples = MAX_SAMPLES;
+    } else if ((value = option_value(argv[idx], "seed")) != NULL) {
+      seed = strtoul(value, NULL, 10);
+      if (seed == 0)
+        seed = 1;   /* the generator gets stuck on zero */
+    } else if ((value = option_value(argv[idx], "size")) != NULL) {
+      char *ptr;
+      size = strtoul(value, &ptr, 10);
+      if (*ptr == 'k' || *ptr == 'K')
+        size *= 1024;
+    } else if (option_value(argv[idx], "v") != NULL) {
+      opt_verbose = true;
+    } else if ((value = option_value(argv[idx], "window")) != NULL) {
+      window = (int)strtol(value, NULL, 10);
+    } else {
+      usage(argv[idx]);
+      return EXIT_FAILURE;
+    }
+  }
+
+  if (recordfile != NULL && replayfile != NULL) {
+    fprintf(stderr, "Options -record and -replay cannot be combined\n");
+    return EXIT_FAILURE;
+  }
+  if (replayfile != NULL && !gdbrsp_replay(replayfile, realtime)) {
+    fprintf(stderr, "Cannot open recording %s\n", replayfile);
+    return EXIT_FAILURE;
+  }
+  if (recordfile != NULL && !gdbrsp_record(recordfile)) {
+    fprintf(stderr, "Cannot create %s\n", recordfile);
+    return EXIT_FAILURE;
+  }
+  if (ipaddr != NULL && replayfile == NULL && tcpip_init() != 0) {
+    fprintf(stderr, "Network initialization failure\n");
+    return EXIT_FAILURE;
+  }
+  bmp_setcallback(bmp_callback);
+  bmp_setflashwindow(window, window);
+  bmp_setflashoverlap(overlap);
+
+  /* connect & attach */
+  unsigned long long tstamp = microseconds();
+  if (!bmp_connect(probe, ipaddr) || !bmp_attach(false, NULL, 0, NULL, 0)) {
+    fprintf(stderr, "Failed to connect to the target\n");
+    bmp_disconnect();
+    return EXIT_FAILURE;
+  }
+  unsigned long long usec_attach = microseconds() - tstamp;
+  unsigned long address, rgnsize;
+  if (!bmp_flashregion(0, &address, &rgnsize, NULL)) {
+    fprintf(stderr, "No Flash memory on the target\n");
+    bmp_detach(false);
+    bmp_disconnect();
+    return EXIT_FAILURE;
+  }
+  if (size == 0 || size > rgnsize) {
+    fprintf(stderr, "Image size adjusted to the size of the Flash region (%lu bytes)\n", rgnsize);
+    size = rgnsize;
+  }
+
+  unsigned long flashtotal = bmp_flashtotal();
+  random_state = (uint32_t)seed;
+  FILE *fp = make_image(address, size, entropy);
+  unsigned long long *samples = malloc(numsamples * sizeof(unsigned long long));
+  if (fp == NULL || samples == NULL) {
+    fprintf(stderr, "Memory allocation failure\n");
+    bmp_detach(false);
+    bmp_disconnect();
+    return EXIT_FAILURE;
+  }
+
+  /* run the stages; a stage is skipped when an earlier one failed */
+  int count = measure_latency(address, samples, numsamples);
+  bool ok_erase = true, ok_write = false, ok_verify = false;
+  unsigned long long usec_erase = 0, usec_write = 0, usec_verify = 0;
+  if (fullerase) {
+    tstamp = microseconds();
+    ok_erase = bmp_fullerase();
+    usec_erase = microseconds() - tstamp;
+  }
+  if (ok_erase) {
+    tstamp = microseconds();
+    ok_write = bmp_download(fp, false);
+    usec_write = microseconds() - tstamp;
+  }
+  if (ok_write) {
+    tstamp = microseconds();
+    ok_verify = bmp_verify(fp);
+    usec_verify = microseconds() - tstamp;
+  }
+  bmp_detach(false);
+  bmp_disconnect();
+  fclose(fp);
+  unsigned long mismatch = gdbrsp_replay_mismatch();
+  gdbrsp_record(NULL);
+  gdbrsp_replay(NULL, false);
+
+  printf("{\n");
+  printf("  \"version\": \"%s\",\n", SVNREV_STR);
+  printf("  \"transport\": \"%s\",\n", (ipaddr != NULL) ? "tcp" : "usb");
+  if (replayfile != NULL)
+    printf("  \"replay\": { \"realtime\": %s, \"mismatch\": %lu },\n", realtime ? "true" : "false", mismatch);
+  printf("  \"image\": { \"address\": %lu, \"size\": %lu, \"entropy\": %d, \"seed\": %lu },\n",
+         address, size, entropy, seed);
+  printf("  \"overlap\": %s,\n", overlap ? "true" : "false");
+  printf("  \"attach_ms\": %.3f,\n", usec_attach / 1000.0);
+  if (count > 0)
+    printf("  \"rsp_latency_us\": { \"samples\": %d, \"min\": %llu, \"p50\": %llu, \"p90\": %llu, \"p99\": %llu, \"max\": %llu },\n",
+           count, samples[0], percentile(samples, count, 50), percentile(samples, count, 90),
+           percentile(samples, count, 99), samples[count - 1]);
+  else
+    printf("  \"rsp_latency_us\": { \"samples\": 0 },\n");
+  print_stage("erase", fullerase ? flashtotal : 0, usec_erase, ok_erase, false);
+  print_stage("write", ok_erase ? size : 0, usec_write, ok_write, false);
+  print_stage("verify", ok_write ? size : 0, usec_verify, ok_verify, true);
+  printf("}\n");
+  free(samples);
+
+  return (ok_erase && ok_write && ok_verify) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -17,6 +17,7 @@
  */
 #include <assert.h>
 #include <stdbool.h>
+#include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #if defined WIN32 || defined _WIN32
@@ -31,6 +32,7 @@
 #endif
 #include "bmcommon.h"
 #include "bmp-scan.h"
+#include "crc32.h"
 #include "specialfolder.h"
 
 #if defined FORTIFY
@@ -100,3 +102,47 @@ bool get_configfile(char *filename, size_t maxsize, const char *basename)
   return true;
 }
 
+static bool cachefile_name(char *filename, size_t maxsize, const char *srcfile, const char *ext)
+{
+  assert(srcfile != NULL);
+  assert(ext != NULL);
+  const char *base = srcfile;
+  const char *ptr;
+  if ((ptr = strrchr(base, '/')) != NULL)
+    base = ptr + 1;
+# if defined _WIN32
+    if ((ptr = strrchr(base, '\\')) != NULL)
+      base = ptr + 1;
+# endif
+  unsigned crc = gdb_crc32(0xffffffff, (const unsigned char*)srcfile, strlen(srcfile));
+  char name[128];
+  snprintf(name, sizeof(name), "%.100s-%08x.%s", base, crc, ext);
+  return get_configfile(filename, maxsize, name);
+}
+
+/** get_cachefile() returns the path to the file that holds the cached DWARF
+ *  tables for the ELF file. The name of the cache file is based on the name of
+ *  the ELF file plus a checksum on its full path (so that ELF files with the
+ *  same name in different directories get different cache files).
+ */
+bool get_cachefile(char *filename, size_t maxsize, const char *elffile)
+{
+  return cachefile_name(filename, maxsize, elffile, "dwc");
+}
+
+/** get_tsdlcachefile() returns the path to the file that holds the parsed
+ *  TSDL file, see get_cachefile() for the naming.
+ */
+bool get_tsdlcachefile(char *filename, size_t maxsize, const char *tsdlfile)
+{
+  return cachefile_name(filename, maxsize, tsdlfile, "tsc");
+}
+
+/** get_svdcachefile() returns the path to the file that holds the parsed
+ *  SVD file, see get_cachefile() for the naming.
+ */
+bool get_svdcachefile(char *filename, size_t maxsize, const char *svdfile)
+{
+  return cachefile_name(filename, maxsize, svdfile, "svc");
+}
+
@@ -22,5 +22,8 @@ const char **get_probelist(int *probe, int *netprobe);
 void clear_probelist(const char **probelist, int netprobe);
 
 bool get_configfile(char *filename, size_t maxsize, const char *basename);
+bool get_cachefile(char *filename, size_t maxsize, const char *elffile);
+bool get_tsdlcachefile(char *filename, size_t maxsize, const char *tsdlfile);
+bool get_svdcachefile(char *filename, size_t maxsize, const char *svdfile);
 
 #endif /* _BMCOMMON_H */
@@ -60,6 +60,7 @@
 #include "nuklear_guide.h"
 #include "nuklear_mousepointer.h"
 #include "nuklear_style.h"
+#include "nuklear_listview.h"
 #include "nuklear_tooltip.h"
 #include "bmcommon.h"
 #include "bmp-scan.h"
@@ -67,6 +68,7 @@
 #include "bmp-support.h"
 #include "c11threads.h"
 #include "cksum.h"
+#include "crc32.h"
 #include "elf.h"
 #include "gdb-rsp.h"
 #include "ident.h"
@@ -157,53 +159,87 @@ static char *log_addstring(const char *text)
   return logtext;
 }
 
+typedef struct tagLOGVIEW {
+  const char **lines;   /* start of each line in the log text */
+  int count;
+  int size;             /* allocated size of the "lines" array */
+  float rowheight;
+} LOGVIEW;
+
+/* log_index() collects the start of every line in the log text */
+static void log_index(LOGVIEW *view, const char *content)
+{
+  const char *head = content;
+  view->count = 0;
+  while (head != NULL && *head != '\0' && !(*head == '\n' && *(head + 1) == '\0')) {
+    if (view->count >= view->size) {
+      int newsize = (view->size > 0) ? 2 * view->size : 64;
+      const char **newlines = realloc((void*)view->lines, newsize * sizeof(const char*));
+      if (newlines == NULL)
+        break;
+      view->lines = newlines;
+      view->size = newsize;
+    }
+    view->lines[view->count++] = head;
+    if ((head = strchr(head, '\n')) != NULL)
+      head += 1;
+  }
+}
+
+/* log_row() is the list view callback that draws a line in the log window */
+static void log_row(struct nk_context *ctx, int row, void *userdata)
+{
+  LOGVIEW *view = (LOGVIEW*)userdata;
+  const char *head = view->lines[row];
+  const char *tail;
+  if ((tail = strchr(head, '\n')) == NULL)
+    tail = strchr(head, '\0');
+  assert(tail != NULL);
+  nk_layout_row_dynamic(ctx, view->rowheight, 1);
+  if (*head == '^' && isdigit(*(head + 1))) {
+    struct nk_color clr = COLOUR_TEXT;
+    switch (*(head + 1)) {
+    case '1': /* error (red) */
+      clr = COLOUR_FG_RED;
+      break;
+    case '2': /* ok (green) */
+      clr = COLOUR_FG_GREEN;
+      break;
+    case '3': /* warning (yellow) */
+      clr = COLOUR_FG_YELLOW;
+      break;
+    case '4': /* notice (highlighted) */
+      clr = COLOUR_HIGHLIGHT;
+      break;
+    }
+    nk_text_colored(ctx, head + 2, (int)(tail - head - 2), NK_TEXT_LEFT, clr);
+  } else {
+    nk_text(ctx, head, (int)(tail - head), NK_TEXT_LEFT);
+  }
+}
+
 /* log_widget() draws the text in the log window, with support for colour codes
    (color codes apply to a full line); if the "scrollpos" parameter is not NULL,
    the window scrolls to the most recent text */
 static int log_widget(struct nk_context *ctx, const char *id, const char *content, float rowheight, unsigned *scrollpos)
 {
+  static LOGVIEW view = { NULL, 0, 0, 0 };
   int lines = 0;
   struct nk_rect rcwidget = nk_layout_widget_bounds(ctx);
   struct nk_style_window *stwin = &ctx->style.window;
 
+  nk_uint xscroll, yscroll;
+  nk_group_get_scroll(ctx, id, &xscroll, &yscroll);
+
   /* black background on group */
   nk_style_push_color(ctx, &stwin->fixed_background.data.color, COLOUR_BG0);
   if (nk_group_begin(ctx, id, NK_WINDOW_BORDER)) {
-    float lineheight = 0;
-    const char *head = content;
-    while (head != NULL && *head != '\0' && !(*head == '\n' && *(head + 1) == '\0')) {
-      const char *tail;
-      if ((tail = strchr(head, '\n')) == NULL)
-        tail = strchr(head, '\0');
-      assert(tail != NULL);
-      nk_layout_row_dynamic(ctx, rowheight, 1);
-      if (lineheight <= 0.1) {
-        struct nk_rect rcline = nk_layout_widget_bounds(ctx);
-        lineheight = rcline.h;
-      }
-      if (*head == '^' && isdigit(*(head + 1))) {
-        struct nk_color clr = COLOUR_TEXT;
-        switch (*(head + 1)) {
-        case '1': /* error (red) */
-          clr = COLOUR_FG_RED;
-          break;
-        case '2': /* ok (green) */
-          clr = COLOUR_FG_GREEN;
-          break;
-        case '3': /* warning (yellow) */
-          clr = COLOUR_FG_YELLOW;
-          break;
-        case '4': /* notice (highlighted) */
-          clr = COLOUR_HIGHLIGHT;
-          break;
-        }
-        nk_text_colored(ctx, head + 2, (int)(tail - head - 2), NK_TEXT_LEFT, clr);
-      } else {
-        nk_text(ctx, head, (int)(tail - head), NK_TEXT_LEFT);
-      }
-      lines++;
-      head = (*tail != '\0') ? tail + 1 : tail;
-    }
+    /* only the lines in view are laid out */
+    float lineheight = rowheight;
+    log_index(&view, content);
+    view.rowheight = rowheight;
+    nk_listview_rows(ctx, rcwidget.h, yscroll, rowheight, view.count, log_row, &view);
+    lines = view.count;
     /* add an empty line to fill up any remaining space below */
     nk_layout_row_dynamic(ctx, rowheight, 1);
     nk_spacing(ctx, 1);
@@ -224,14 +260,20 @@ static int log_widget(struct nk_context *ctx, const char *id, const char *conten
   return lines;
 }
 
+/* in gang mode, each worker thread sets the number of its probe, so that the
+   messages can be attributed to the probe */
+static thread_local int gang_unit = -1;
+
 static int bmp_callback(int code, const char *message)
 {
-  char fullmsg[200] = "";
-  assert(strlen(message) < sizearray(fullmsg) - 4);  /* colour code and \n may be added */
+  char fullmsg[220] = "";
+  assert(strlen(message) < sizearray(fullmsg) - 24);  /* colour code, unit and \n may be added */
   if (code < 0)
     strcpy(fullmsg, "^1");  /* errors in red */
   else if (code > 0)
     strcpy(fullmsg, "^2");  /* success code in green */
+  if (gang_unit >= 0)
+    sprintf(fullmsg + strlen(fullmsg), "[%d] ", gang_unit + 1);
   strcat(fullmsg, message);
   if (strchr(message, '\n') == NULL)
     strcat(fullmsg, "\n");
@@ -548,19 +590,17 @@ static void serial_increment(char *field, int increment)
   }
 }
 
-static int writelog(const char *filename, const char *serial)
+static int writelog(const char *filename, const char *serial, time_t tstamp)
 {
   char txtLogFile[_MAX_PATH];
   FILE *fpLog, *fpElf;
   char substr[128], line[256];
-  time_t tstamp;
   struct stat fstat;
   int addheader;
 
   line[0] = '\0';
 
-  /* current date/time */
-  tstamp = time(NULL);
+  /* date/time of the download */
   strftime(substr, sizeof(substr), "%Y-%m-%d %H:%M:%S, ", localtime(&tstamp));
   strlcat(line, substr, sizearray(line));
 
@@ -627,6 +667,94 @@ static int writelog(const char *filename, const char *serial)
   return 1;
 }
 
+/* Log entries are written by a background thread, because calculating the
+   checksum of the ELF file (for each entry) takes time that would otherwise
+   add to the cycle time per unit. */
+#define LOGQUEUE_SIZE 32
+
+typedef struct tagLOGREQUEST {
+  char filename[_MAX_PATH];
+  char serial[32];              /**< serial number (empty if not serialized) */
+  time_t tstamp;                /**< time of the download */
+} LOGREQUEST;
+
+static LOGREQUEST logqueue[LOGQUEUE_SIZE];
+static int logqueue_head = 0;
+static int logqueue_count = 0;
+static bool logqueue_active = false;
+static bool logqueue_quit = false;
+static mtx_t logqueue_mutex;
+static cnd_t logqueue_cond;
+static thrd_t logqueue_thread;
+
+static int writelog_thread(void *arg)
+{
+  (void)arg;
+  mtx_lock(&logqueue_mutex);
+  for ( ;; ) {
+    while (logqueue_count == 0 && !logqueue_quit)
+      cnd_wait(&logqueue_cond, &logqueue_mutex);
+    if (logqueue_count == 0)
+      break;  /* quit was set, and the queue is empty */
+    LOGREQUEST req = logqueue[logqueue_head];
+    logqueue_head = (logqueue_head + 1) % LOGQUEUE_SIZE;
+    logqueue_count--;
+    cnd_broadcast(&logqueue_cond);
+    mtx_unlock(&logqueue_mutex);
+    if (!writelog(req.filename, (req.serial[0] != '\0') ? req.serial : NULL, req.tstamp))
+      log_addstring("^3Failed to write to log file\n");
+    mtx_lock(&logqueue_mutex);
+  }
+  mtx_unlock(&logqueue_mutex);
+  return 0;
+}
+
+/* writelog_post() queues a log entry; if the background thread cannot be
+   started, the entry is written immediately */
+static void writelog_post(const char *filename, const char *serial)
+{
+  assert(filename != NULL);
+  time_t tstamp = time(NULL);
+  if (!logqueue_active) {
+    mtx_init(&logqueue_mutex, mtx_plain);
+    cnd_init(&logqueue_cond);
+    logqueue_quit = false;
+    if (thrd_create(&logqueue_thread, writelog_thread, NULL) != thrd_success) {
+      cnd_destroy(&logqueue_cond);
+      mtx_destroy(&logqueue_mutex);
+      if (!writelog(filename, serial, tstamp))
+        log_addstring("^3Failed to write to log file\n");
+      return;
+    }
+    logqueue_active = true;
+  }
+  mtx_lock(&logqueue_mutex);
+  while (logqueue_count >= LOGQUEUE_SIZE)
+    cnd_wait(&logqueue_cond, &logqueue_mutex);
+  LOGREQUEST *req = &logqueue[(logqueue_head + logqueue_count) % LOGQUEUE_SIZE];
+  strlcpy(req->filename, filename, sizearray(req->filename));
+  strlcpy(req->serial, (serial != NULL) ? serial : "", sizearray(req->serial));
+  req->tstamp = tstamp;
+  logqueue_count++;
+  cnd_broadcast(&logqueue_cond);
+  mtx_unlock(&logqueue_mutex);
+}
+
+/* writelog_flush() writes any pending log entries and stops the thread */
+static void writelog_flush(void)
+{
+  if (!logqueue_active)
+    return;
+  mtx_lock(&logqueue_mutex);
+  logqueue_quit = true;
+  cnd_broadcast(&logqueue_cond);
+  mtx_unlock(&logqueue_mutex);
+  thrd_join(logqueue_thread, NULL);
+  cnd_destroy(&logqueue_cond);
+  mtx_destroy(&logqueue_mutex);
+  logqueue_active = false;
+}
+
 static void usage(const char *invalid_option)
 {
 # if defined _WIN32  /* fix console output on Windows */
@@ -821,9 +949,14 @@ static const char *rspreply_pop(void)
   return ptr;
 }
 
-static bool rspreply_semihosting(char *packet)
+/* rspreply_semihosting() serves a semihosting request; for the "system" and
+   "write" calls, it returns the text that is passed on to the script in
+   parameter "text" (this string must be freed) */
+static bool rspreply_semihosting(const char *packet, char **text)
 {
   assert(packet != NULL);
+  assert(text != NULL);
+  *text = NULL;
   if (*packet != 'F')
     return false;
   packet++; /* skip 'F' */
@@ -845,37 +978,36 @@ static bool rspreply_semihosting(char *packet)
   } else if (strncmp(packet, "system,", 7) == 0) {
     unsigned addr, size;
     sscanf(packet + 7, "%x/%x", &addr, &size);
-    char *buffer = malloc((2 * size + 1) * sizeof(char));
+    char *buffer = malloc((size + 1) * sizeof(char));
     if (buffer == NULL)
       return false;
-    char cmd[30];
-    sprintf(cmd, "m%08X,%X:", addr, size);
-    gdbrsp_xmit(cmd, -1);
-    size_t len = gdbrsp_recv(buffer, 2 * size, 1000);
-    buffer[len] = '\0';
-    gdbrsp_hex2array(buffer, (unsigned char*)buffer, 2 * size);
-    buffer[size] = '\0';
-    sprintf(packet, "%s", buffer);
-    free((void*)buffer);
+    if (!bmp_readmemory(addr, (unsigned char*)buffer, size)) {
+      free((void*)buffer);
+      gdbrsp_xmit("F-1,5", -1);   /* EIO */
+      return true;
+    }
     gdbrsp_xmit("F0", -1);
+    buffer[size] = '\0';
+    *text = buffer;
   } else if (strncmp(packet, "write,", 6) == 0) {
     packet += 6;
     unsigned handle, addr, size;
     sscanf(packet, "%x,%x,%x", &handle, &addr, &size);
-    char *buffer = malloc((2 * size + 1) * sizeof(char));
+    char *buffer = malloc((size + 16) * sizeof(char));
     if (buffer == NULL)
       return false;
+    int offs = sprintf(buffer, "%u,", handle);
+    if (!bmp_readmemory(addr, (unsigned char*)buffer + offs, size)) {
+      free((void*)buffer);
+      gdbrsp_xmit("F-1,5", -1);   /* EIO */
+      return true;
+    }
+    /* reply before passing the text on, so that the target resumes early */
     char cmd[30];
-    sprintf(cmd, "m%08X,%X:", addr, size);
-    gdbrsp_xmit(cmd, -1);
-    size_t len = gdbrsp_recv(buffer, 2 * size, 1000);
-    buffer[len] = '\0';
-    gdbrsp_hex2array(buffer, (unsigned char*)buffer, 2 * size);
-    buffer[size] = '\0';
-    sprintf(packet, "%u,%s", handle, buffer);
-    free((void*)buffer);
     sprintf(cmd, "F%X:", size);
     gdbrsp_xmit(cmd, -1);
+    buffer[offs + size] = '\0';
+    *text = buffer;
   }
   return true;
 }
@@ -883,15 +1015,62 @@ static bool rspreply_semihosting(char *packet)
 static void rspreply_poll(void)
 {
   char buffer[1024];
-  size_t size = gdbrsp_recv(buffer, sizearray(buffer) - 1, 50);
-  if (size > 0) {
+  unsigned long tstamp_start = timestamp();
+  unsigned long timeout = 50;
+  /* after the first packet, keep serving packets for as long as these follow
+     each other quickly, so that a burst of semihosting calls is not limited to
+     one call per pass of the main loop */
+  for (;;) {
+    size_t size = gdbrsp_recv(buffer, sizearray(buffer) - 1, timeout);
+    if (size == 0)
+      break;
+    if (size >= sizearray(buffer))
+      size = sizearray(buffer) - 1; /* packet was truncated */
     buffer[size] = '\0';
-    rspreply_semihosting(buffer); /* translate semihosting packets */
-    rspreply_push(buffer);
+    char *text;
+    rspreply_semihosting(buffer, &text);  /* serve semihosting packets */
+    rspreply_push((text != NULL) ? text : buffer);
+    if (text != NULL)
+      free((void*)text);
+    if (timestamp() - tstamp_start >= 50)
+      break;
+    timeout = 5;
   }
 }
 
 
+#define MAX_GANG  16
+
+enum {
+  GANG_IDLE,
+  GANG_CONNECT,
+  GANG_DOWNLOAD,
+  GANG_VERIFY,
+  GANG_SUCCESS,   /**< finished, all states >= GANG_SUCCESS are "done" */
+  GANG_FAILED,
+};
+
+#define MAX_PLAN  8   /* max. number of extra images in a flash plan */
+
+typedef struct tagPLANITEM {
+  char path[_MAX_PATH];         /**< ELF or binary file (relative to the target ELF file) */
+  bool binary;                  /**< binary file, loaded at "address" */
+  unsigned long address;
+} PLANITEM;
+
+typedef struct tagGANGUNIT {
+  struct tagAPPSTATE *state;    /**< application settings (read-only for the thread) */
+  int probe;                    /**< index of the USB probe */
+  BMP_CONTEXT *context;         /**< connection to the probe */
+  FILE *fpImage;                /**< image for this unit (serialized) */
+  char serial[32];              /**< serial number (empty if not serialized) */
+  thrd_t thread;                /**< worker thread */
+  bool started;                 /**< whether the thread was created */
+  volatile int status;          /**< GANG_xxx */
+  unsigned long progress_pos;   /**< progress, copied on completion (the context is deleted) */
+  unsigned long progress_range;
+} GANGUNIT;
+
 typedef struct tagAPPSTATE {
   int curstate;                 /**< current state */
   bool is_attached;             /**< is debug probe attached? */
@@ -905,6 +1084,11 @@ typedef struct tagAPPSTATE {
   nk_bool tpwr;                 /**< option: tpwr (target power) */
   nk_bool connect_srst;         /**< option: keep in reset during connect */
   nk_bool fullerase;            /**< option: erase entire flash before download */
+  nk_bool differential;         /**< option: only erase & write changed sectors */
+  nk_bool ramrun;               /**< option: download into RAM and run (no Flash erase/write) */
+  nk_bool autoerase;            /**< option: choose between mass erase and sector erase by speed */
+  const char *configfile;       /**< path to the configuration file (for the erase speed) */
+  nk_bool gang;                 /**< option: program all connected probes in parallel */
   nk_bool write_log;            /**< option: record downloads in log file */
   nk_bool print_time;           /**< option: print download time */
   int skip_download;            /**< do download+verify procedure without actually downloading */
@@ -923,8 +1107,16 @@ typedef struct tagAPPSTATE {
   char SerialFile[_MAX_PATH];   /**< optional file for serialization settings */
   char PostProcess[_MAX_PATH];  /**< path to post-process script */
   nk_bool PostProcessFailures;  /**< whether to execute the post-process script on failed uploads too */
+  char ExtraImages[4*_MAX_PATH];/**< flash plan: more files to program with the target, separated by ';' */
   FILE *fpTgt;                  /**< target file */
   FILE *fpWork;                 /**< intermediate work file */
+  BMP_IMAGE *image;             /**< image of the target, for download & verify */
+  char image_file[_MAX_PATH];   /**< path of the ELF file the image was built from */
+  time_t image_mtime;           /**< timestamp of the ELF file (for the image) */
+  long image_size;              /**< size of the ELF file (for the image) */
+  int image_arch;               /**< MCU architecture (for the image) */
+  char image_key[256];          /**< serialization options & flash plan (for the image) */
+  long serial_fileoffs;         /**< position of the serial number in the image (-1 if not yet known) */
   struct tcl tcl;               /**< Tcl context */
   char *tcl_script;             /**< Tcl script (loaded from file) */
   thrd_t thrd_download;         /**< thread id for downloading firmware */
@@ -933,6 +1125,8 @@ typedef struct tagAPPSTATE {
   int isrunning_download;       /**< running state of the download thread */
   bool download_success;        /**< success/failure state of most recent download */
   unsigned long tstamp_start;   /**< timestamp of start of download */
+  GANGUNIT gang_units[MAX_GANG];/**< probes in gang mode */
+  int gang_count;               /**< number of probes in gang mode (0 if not active) */
 } APPSTATE;
 
 enum {
@@ -976,6 +1170,8 @@ enum {
   STATE_ERASE_OPTBYTES,
   STATE_SET_CRP,
   STATE_FULLERASE,
+  STATE_GANG_PREPARE,
+  STATE_GANG_DOWNLOAD,
 };
 
 static int tcl_cmd_exec(struct tcl *tcl, struct tcl_value *args, void *arg)
@@ -1136,12 +1332,122 @@ static bool tcl_preparescript(APPSTATE *state)
   return true;
 }
 
+/* serialize_image() patches the serial number into the (work copy of) the ELF
+   file */
+static int serialize_image(FILE *fp, const APPSTATE *state, int serial)
+{
+  /* create replacement buffer, depending on format */
+  unsigned char data[50];
+  int datasize = (int)strtol(state->SerialSize, NULL, 10);
+  int result = 0;
+  serialize_fmtoutput(data, datasize, serial, state->SerialFmt);
+  //??? enhancement: run a script, because the serial number may include a check digit
+  if (state->serialize == SER_ADDRESS)
+    result = serialize_address(fp, state->Section, strtoul(state->Address,NULL,16), data, datasize);
+  else if (state->serialize == SER_MATCH)
+    result = serialize_match(fp, state->Match, state->Prefix, data, datasize);
+  if (result) {
+    char msg[100];
+    sprintf(msg, "^4Serial adjusted to %d\n", serial);
+    log_addstring(msg);
+  }
+  return result;
+}
+
+/* erasecost_get() reads the erase speed that was measured for the MCU family:
+   the time to erase 1 KiB with sector erase commands (in microseconds) and
+   the time for a mass erase (in milliseconds); each is 0 when not yet known */
+static void erasecost_get(const APPSTATE *state, const char *mcufamily, unsigned long *sector_us, unsigned long *mass_ms)
+{
+  assert(state != NULL && state->configfile != NULL);
+  assert(sector_us != NULL && mass_ms != NULL);
+  *sector_us = *mass_ms = 0;
+  if (mcufamily == NULL || *mcufamily == '\0')
+    return;
+  char field[64];
+  ini_gets("Erase cost", mcufamily, "", field, sizearray(field), state->configfile);
+  sscanf(field, "%lu,%lu", sector_us, mass_ms);
+}
+
+/* erasecost_update() stores new measurements as the average with the values
+   measured on earlier runs; a zero value leaves the stored value unchanged */
+static void erasecost_update(const APPSTATE *state, const char *mcufamily, unsigned long sector_us, unsigned long mass_ms)
+{
+  if (mcufamily == NULL || *mcufamily == '\0' || (sector_us == 0 && mass_ms == 0))
+    return;
+  unsigned long old_sector, old_mass;
+  erasecost_get(state, mcufamily, &old_sector, &old_mass);
+  if (sector_us == 0)
+    sector_us = old_sector;
+  else if (old_sector > 0)
+    sector_us = (sector_us + old_sector) / 2;
+  if (mass_ms == 0)
+    mass_ms = old_mass;
+  else if (old_mass > 0)
+    mass_ms = (mass_ms + old_mass) / 2;
+  char field[64];
+  sprintf(field, "%lu,%lu", sector_us, mass_ms);
+  ini_puts("Erase cost", mcufamily, field, state->configfile);
+}
+
+/* erasecost_record() stores the speed of the sector erases in the download
+   that just completed (too small an erase gives an unreliable measurement) */
+static void erasecost_record(const APPSTATE *state, const char *mcufamily)
+{
+  unsigned long bytes, ms;
+  bmp_erasestats(&bytes, &ms);
+  if (bytes >= 8192) {
+    unsigned long sector_us = (ms * 1000) / (bytes / 1024);
+    erasecost_update(state, mcufamily, (sector_us > 0) ? sector_us : 1, 0);
+  }
+}
+
+/* erase_plan() returns true if a mass erase is expected to be quicker than
+   erasing the sectors that the image occupies; the speed of a sector erase is
+   measured on the first download, and a mass erase is then tried once if the
+   image covers at least half of the Flash memory */
+static bool erase_plan(const APPSTATE *state, const char *mcufamily, BMP_IMAGE *image)
+{
+  if (image == NULL)
+    return false;
+  unsigned long sector_us, mass_ms;
+  erasecost_get(state, mcufamily, &sector_us, &mass_ms);
+  unsigned long erasesize = bmp_image_erasesize(image);
+  unsigned long flashsize = bmp_flashtotal();
+  if (sector_us == 0 || erasesize == 0 || flashsize == 0)
+    return false;
+  if (mass_ms == 0)
+    return (erasesize >= flashsize / 2);
+  unsigned long sector_ms = (erasesize / 1024) * sector_us / 1000;
+  char msg[128];
+  sprintf(msg, "Erase estimate: %lu ms by sector, %lu ms by mass erase\n", sector_ms, mass_ms);
+  log_addstring(msg);
+  return (mass_ms < sector_ms);
+}
+
+/* erase_mass() runs a mass erase and stores the time that it took (in gang
+   mode, the threads run the mass erase and lock only for the update) */
+static bool erase_mass(const APPSTATE *state, const char *mcufamily)
+{
+  unsigned long tstamp = timestamp();
+  if (!bmp_masserase())
+    return false;
+  erasecost_update(state, mcufamily, 0, timestamp() - tstamp);
+  return true;
+}
+
 static int download_thread(void *arg)
 {
   pointer_setstyle(CURSOR_WAIT);
   APPSTATE *state = (APPSTATE*)arg;
   assert(state != NULL);
-  bool result = bmp_download((state->fpWork != NULL) ? state->fpWork : state->fpTgt);
+  /* a differential download is pointless after a full erase */
+  assert(state->image != NULL);
+  bool result;
+  if (state->ramrun)
+    result = bmp_download_ram(state->image);
+  else
+    result = bmp_download_image(state->image, state->differential && !state->fullerase);
   state->isrunning_download = THRD_COMPLETED;
   return result;
 }
@@ -1166,10 +1472,243 @@ static char *getpath(char *path, size_t pathlength, const char *basename, const
   return path;
 }
 
+/* plan_parse() splits the list of extra images (the flash plan) into its
+   items; an item is the path of an ELF file, or the path of a binary file
+   followed by "@" and the load address in hexadecimal; it returns the number
+   of items */
+static int plan_parse(const APPSTATE *state, PLANITEM *items, int maxitems)
+{
+  assert(state != NULL);
+  assert(items != NULL && maxitems > 0);
+  int count = 0;
+  const char *head = skipwhite(state->ExtraImages);
+  while (*head != '\0' && count < maxitems) {
+    const char *tail = strchr(head, ';');
+    size_t len = (tail != NULL) ? (size_t)(tail - head) : strlen(head);
+    while (len > 0 && head[len - 1] <= ' ')
+      len--;
+    if (len > 0) {
+      PLANITEM *item = &items[count++];
+      char field[_MAX_PATH];
+      if (len >= sizearray(field))
+        len = sizearray(field) - 1;
+      memcpy(field, head, len);
+      field[len] = '\0';
+      char *sep = strrchr(field, '@');
+      item->binary = (sep != NULL);
+      item->address = 0;
+      if (sep != NULL) {
+        *sep++ = '\0';
+        item->address = strtoul(sep, NULL, 16);
+      }
+      getpath(item->path, sizearray(item->path), field, state->ELFfile);
+    }
+    if (tail == NULL)
+      break;
+    head = skipwhite(tail + 1);
+  }
+  return count;
+}
+
+/* plan_valid() returns true if all files in the flash plan exist */
+static bool plan_valid(const APPSTATE *state)
+{
+  PLANITEM items[MAX_PLAN];
+  int count = plan_parse(state, items, MAX_PLAN);
+  for (int idx = 0; idx < count; idx++)
+    if (access(items[idx].path, 0) != 0)
+      return false;
+  return true;
+}
+
+/* plan_checksum() returns a checksum on the items in the flash plan and the
+   timestamps and sizes of the files, so that target_image() detects any
+   change */
+static uint32_t plan_checksum(const APPSTATE *state)
+{
+  PLANITEM items[MAX_PLAN];
+  int count = plan_parse(state, items, MAX_PLAN);
+  uint32_t crc = ~0;
+  for (int idx = 0; idx < count; idx++) {
+    const PLANITEM *item = &items[idx];
+    char field[_MAX_PATH + 64];
+    struct stat fstat;
+    if (stat(item->path, &fstat) != 0)
+      memset(&fstat, 0, sizeof fstat);
+    int len = sprintf(field, "%s@%lx:%d:%ld:%ld", item->path, item->address, item->binary,
+                      (long)fstat.st_mtime, (long)fstat.st_size);
+    crc = gdb_crc32(crc, (const unsigned char*)field, len);
+  }
+  return crc;
+}
+
+/* plan_append() adds the extra images of the flash plan to the image of the
+   target, so that all files are erased, written and verified together */
+static bool plan_append(const APPSTATE *state, BMP_IMAGE *image)
+{
+  PLANITEM items[MAX_PLAN];
+  int count = plan_parse(state, items, MAX_PLAN);
+  for (int idx = 0; idx < count; idx++) {
+    const PLANITEM *item = &items[idx];
+    FILE *fp = fopen(item->path, "rb");
+    bool ok = (fp != NULL);
+    if (ok) {
+      ok = item->binary ? bmp_image_appendbinary(image, fp, item->address) : bmp_image_append(image, fp);
+      fclose(fp);
+    }
+    if (!ok) {
+      char msg[_MAX_PATH + 64];
+      sprintf(msg, "^1Failed to add %s to the image\n", item->path);
+      log_addstring(msg);
+      return false;
+    }
+  }
+  return true;
+}
+
 static const char *architectures[] = { "Standard", "LPC8xx", "LPC11xx", "LPC15xx",
                                        "LPC17xx", "LPC21xx", "LPC22xx", "LPC23xx",
                                        "LPC24xx", "LPC43xx" };
 
+/* target_image() builds the image of the target that is downloaded and
+   verified; when the ELF file and the options that affect the image are
+   unchanged since the previous download, the image is re-used (the serial
+   number is patched into the image on every download, see serialize_target()) */
+static bool target_image(APPSTATE *state)
+{
+  assert(state != NULL);
+  char key[256];
+  sprintf(key, "%d|%s|%s|%s|%s|%s|%08x", state->serialize, state->Section, state->Address,
+          state->Match, state->Prefix, state->SerialSize, (unsigned)plan_checksum(state));
+  struct stat fstat;
+  bool valid = (stat(state->ELFfile, &fstat) == 0);
+  if (valid && state->image != NULL
+      && strcmp(state->image_file, state->ELFfile) == 0 && state->image_mtime == fstat.st_mtime
+      && state->image_size == (long)fstat.st_size && state->image_arch == state->architecture
+      && strcmp(state->image_key, key) == 0)
+    return true;
+
+  if (state->image != NULL) {
+    bmp_image_delete(state->image);
+    state->image = NULL;
+  }
+  /* patch the vector table in a temporary copy of the ELF file */
+  assert(state->fpTgt != NULL);
+  if (state->architecture > 0) {
+    state->fpWork = tmpfile();
+    if (state->fpWork == NULL
+        || !copyfile(state->fpWork, state->fpTgt)
+        || !patch_vecttable(state->fpWork, architectures[state->architecture]))
+    {
+      log_addstring("^1Failed to process the target file\n");
+      return false;
+    }
+  }
+  state->image = bmp_image_create((state->fpWork != NULL) ? state->fpWork : state->fpTgt);
+  if (state->image == NULL) {
+    log_addstring("^1Failed to load the target file\n");
+    return false;
+  }
+  if (!plan_append(state, state->image)) {
+    bmp_image_delete(state->image);
+    state->image = NULL;
+    return false;
+  }
+  state->serial_fileoffs = -1;
+  if (valid) {
+    strlcpy(state->image_file, state->ELFfile, sizearray(state->image_file));
+    strlcpy(state->image_key, key, sizearray(state->image_key));
+    state->image_mtime = fstat.st_mtime;
+    state->image_size = (long)fstat.st_size;
+    state->image_arch = state->architecture;
+  } else {
+    state->image_file[0] = '\0'; /* do not re-use this image */
+  }
+  return true;
+}
+
+/* serialize_target() patches the serial number into the image of the target;
+   the position of the serial number is looked up only once per image, so
+   that for each next unit, only the bytes of the serial number change */
+static bool serialize_target(APPSTATE *state, int serial)
+{
+  assert(state != NULL && state->image != NULL);
+  int datasize = (int)strtol(state->SerialSize, NULL, 10);
+  if (datasize <= 0)
+    return false;
+  if (state->serial_fileoffs < 0) {
+    if (state->serialize == SER_ADDRESS) {
+      unsigned long offset = 0;
+      unsigned long address = strtoul(state->Address, NULL, 16);
+      if (strlen(state->Section) > 0) {
+        unsigned long length;
+        int err = elf_section_by_name(state->fpTgt, state->Section, &offset, NULL, &length);
+        if (err == ELFERR_NOMATCH) {
+          log_addstring("^1Serialization section not found\n");
+          return false;
+        } else if (address + datasize > length) {
+          log_addstring("^1Serialization address exceeds section\n");
+          return false;
+        }
+      }
+      state->serial_fileoffs = (long)(offset + address);
+    } else if (state->serialize == SER_MATCH) {
+      unsigned char matchbuf[100], prefixbuf[100];
+      size_t matchbuf_len = serialize_parsepattern(matchbuf, sizearray(matchbuf), state->Match, "match");
+      size_t prefixbuf_len = serialize_parsepattern(prefixbuf, sizearray(prefixbuf), state->Prefix, "prefix");
+      if (matchbuf_len == (size_t)~0 || prefixbuf_len == (size_t)~0)
+        return false; /* error message already given */
+      if (matchbuf_len == 0) {
+        log_addstring("^1Serialization match text is empty\n");
+        return false;
+      }
+      long offset = bmp_image_find(state->image, matchbuf, matchbuf_len);
+      if (offset < 0) {
+        log_addstring("^1Match string not found\n");
+        return false;
+      }
+      /* the prefix is the same for every unit, so it is patched only once */
+      if (prefixbuf_len > 0 && !bmp_image_patch(state->image, offset, prefixbuf, prefixbuf_len)) {
+        log_addstring("^1Memory allocation error\n");
+        return false;
+      }
+      state->serial_fileoffs = offset + (long)prefixbuf_len;
+    }
+  }
+
+  unsigned char data[50];
+  if (datasize > (int)sizearray(data))
+    datasize = sizearray(data);
+  serialize_fmtoutput(data, datasize, serial, state->SerialFmt);
+  if (!bmp_image_patch(state->image, state->serial_fileoffs, data, datasize)) {
+    log_addstring("^1Serialization address is outside the code & data\n");
+    return false;
+  }
+  char msg[100];
+  sprintf(msg, "^4Serial adjusted to %d\n", serial);
+  log_addstring(msg);
+  return true;
+}
+
+/* serial_advance() increments the serial number for the given number of
+   downloads */
+static void serial_advance(APPSTATE *state, int count)
+{
+  int incr = (int)strtol(state->SerialIncr, NULL, 10);
+  if (incr < 1)
+    incr = 1;
+  serial_increment(state->Serial, incr * count);
+  /* must update this in the cache file immediately (so that the cache is
+     up-to-date when the user aborts/quits the utility) */
+  char field[200];
+  sprintf(field, "%s:%s:%d:%s", state->Serial, state->SerialSize, state->SerialFmt, state->SerialIncr);
+  char serialfile[_MAX_PATH];
+  strlcpy(serialfile, state->ParamFile, sizearray(serialfile));
+  if (strlen(state->SerialFile) > 0)
+    getpath(serialfile, sizearray(serialfile), state->SerialFile, state->ParamFile);
+  ini_puts("Serialize", "serial", field, serialfile);
+}
+
 static bool load_targetparams(const char *filename, APPSTATE *state)
 {
   assert(filename != NULL);
@@ -1190,8 +1729,13 @@ static bool load_targetparams(const char *filename, APPSTATE *state)
     state->architecture = 0;
   state->tpwr = (nk_bool)ini_getl("Flash", "tpwr", 0, filename);
   state->fullerase = (nk_bool)ini_getl("Flash", "full-erase", 0, filename);
+  state->differential = (nk_bool)ini_getl("Flash", "differential", 0, filename);
+  state->ramrun = (nk_bool)ini_getl("Flash", "ram-run", 0, filename);
+  state->autoerase = (nk_bool)ini_getl("Flash", "auto-erase", 0, filename);
+  state->gang = (nk_bool)ini_getl("Flash", "gang", 0, filename);
   ini_gets("Flash", "postprocess", "", state->PostProcess, sizearray(state->PostProcess), filename);
   state->PostProcessFailures = (nk_bool)ini_getl("Flash", "postprocess-failures", 0, filename);
+  ini_gets("Flash", "extra-images", "", state->ExtraImages, sizearray(state->ExtraImages), filename);
 
   strlcpy(state->SerialFile, filename, sizearray(state->SerialFile));
   ini_gets("Serialize", "file", "", state->SerialFile, sizearray(state->SerialFile), filename);
@@ -1249,8 +1793,13 @@ static bool save_targetparams(const char *filename, const APPSTATE *state)
   ini_puts("Flash", "architecture", field, filename);
   ini_putl("Flash", "tpwr", state->tpwr, filename);
   ini_putl("Flash", "full-erase", state->fullerase, filename);
+  ini_putl("Flash", "differential", state->differential, filename);
+  ini_putl("Flash", "ram-run", state->ramrun, filename);
+  ini_putl("Flash", "auto-erase", state->autoerase, filename);
+  ini_putl("Flash", "gang", state->gang, filename);
   ini_puts("Flash", "postprocess", state->PostProcess, filename);
   ini_putl("Flash", "postprocess-failures", state->PostProcessFailures, filename);
+  ini_puts("Flash", "extra-images", state->ExtraImages, filename);
 
   ini_puts("Serialize", "file", state->SerialFile, filename);
   char serialfile[_MAX_PATH];
@@ -1268,37 +1817,214 @@ static bool save_targetparams(const char *filename, const APPSTATE *state)
   return true;
 }
 
+static bool probe_apply_options(const APPSTATE *state, const char *monitor_cmds)
+{
+  bool ok = true;
+  char cmd[100];
+  if (bmp_expand_monitor_cmd(cmd, sizearray(cmd), "connect", monitor_cmds)) {
+    strlcat(cmd, " ", sizearray(cmd));
+    strlcat(cmd, state->connect_srst ? "enable" : "disable", sizearray(cmd));
+    if (!bmp_monitor(cmd)) {
+      bmp_callback(BMPERR_MONITORCMD, "Setting connect-with-reset option failed");
+      ok = false;
+    }
+  }
+  strcpy(cmd, "tpwr ");
+  strlcat(cmd, state->tpwr ? "enable" : "disable", sizearray(cmd));
+  if (bmp_monitor(cmd)) {
+    /* give the micro-controller a bit of time to start up, after power-up */
+#   if defined _WIN32
+      Sleep(100);
+#   else
+      usleep(100 * 1000);
+#   endif
+  } else {
+    bmp_callback(BMPERR_MONITORCMD, "Power to target failed");
+    ok = false;
+  }
+  return ok;
+}
+
 static bool probe_set_options(APPSTATE *state)
 {
   bool ok = bmp_isopen();
   if (ok && state->set_probe_options) {
-    char cmd[100];
-    if (bmp_expand_monitor_cmd(cmd, sizearray(cmd), "connect", state->monitor_cmds)) {
-      strlcat(cmd, " ", sizearray(cmd));
-      strlcat(cmd, state->connect_srst ? "enable" : "disable", sizearray(cmd));
-      if (!bmp_monitor(cmd)) {
-        bmp_callback(BMPERR_MONITORCMD, "Setting connect-with-reset option failed");
-        ok = false;
-      }
+    ok = probe_apply_options(state, state->monitor_cmds);
+    state->set_probe_options = false;
+  }
+  return ok;
+}
+
+/* gang_mutex protects the parts of the probe support that are shared between
+   the connections: opening & closing the serial ports and running scripts */
+static mtx_t gang_mutex;
+
+static int gang_thread(void *arg)
+{
+  GANGUNIT *unit = (GANGUNIT*)arg;
+  assert(unit != NULL && unit->state != NULL);
+  const APPSTATE *state = unit->state;
+  const char *mcu = architectures[state->architecture];
+  gang_unit = (int)(unit - state->gang_units);
+  bmp_context_select(unit->context);
+
+  unit->status = GANG_CONNECT;
+  mtx_lock(&gang_mutex);
+  bool ok = bmp_connect(unit->probe, NULL);
+  mtx_unlock(&gang_mutex);
+  if (ok) {
+    const char *monitor_cmds = bmp_get_monitor_cmds();
+    ok = probe_apply_options(state, monitor_cmds);
+    if (monitor_cmds != NULL)
+      free((void*)monitor_cmds);
+  }
+  char mcufamily[32] = "";
+  if (ok)
+    ok = bmp_attach(false, mcufamily, sizearray(mcufamily), NULL, 0) && (state->ramrun || bmp_flashtotal() > 0);
+  /* the image is the same for download and verify */
+  BMP_IMAGE *image = NULL;
+  if (ok && (image = bmp_image_create(unit->fpImage)) == NULL)
+    ok = false;
+  if (ok)
+    ok = plan_append(state, image);
+  bool masserase = false;
+  if (ok && state->autoerase && !state->fullerase && !state->differential && !state->ramrun) {
+    mtx_lock(&gang_mutex);
+    masserase = erase_plan(state, mcufamily, image);
+    mtx_unlock(&gang_mutex);
+  }
+  if (ok && (state->fullerase || masserase) && !state->ramrun) {
+    if (state->architecture > 0) {
+      mtx_lock(&gang_mutex);
+      bmp_runscript("memremap", mcu, NULL, NULL, 0);
+      mtx_unlock(&gang_mutex);
     }
-    strcpy(cmd, "tpwr ");
-    strlcat(cmd, state->tpwr ? "enable" : "disable", sizearray(cmd));
-    if (bmp_monitor(cmd)) {
-      /* give the micro-controller a bit of time to start up, after power-up */
-#     if defined _WIN32
-        Sleep(100);
-#     else
-        usleep(100 * 1000);
-#     endif
+    if (masserase) {
+      unsigned long tstamp = timestamp();
+      ok = bmp_masserase();
+      if (ok) {
+        mtx_lock(&gang_mutex);
+        erasecost_update(state, mcufamily, 0, timestamp() - tstamp);
+        mtx_unlock(&gang_mutex);
+      }
     } else {
-      bmp_callback(BMPERR_MONITORCMD, "Power to target failed");
-      ok = false;
+      ok = bmp_fullerase();
     }
-    state->set_probe_options = false;
   }
+  for (int step = GANG_DOWNLOAD; ok && step <= GANG_VERIFY; step++) {
+    unit->status = step;
+    if (state->architecture > 0) {
+      mtx_lock(&gang_mutex);
+      bmp_runscript("memremap", mcu, NULL, NULL, 0);
+      mtx_unlock(&gang_mutex);
+    }
+    if (step == GANG_DOWNLOAD && state->ramrun)
+      ok = bmp_download_ram(image);
+    else if (step == GANG_DOWNLOAD)
+      ok = bmp_download_image(image, state->differential && !state->fullerase);
+    else if (!bmp_image_verified(image))
+      ok = bmp_verify_image(image);
+    if (ok && step == GANG_DOWNLOAD && state->autoerase && !state->ramrun) {
+      mtx_lock(&gang_mutex);
+      erasecost_record(state, mcufamily);
+      mtx_unlock(&gang_mutex);
+    }
+  }
+  bool running = false;
+  if (ok && state->ramrun)
+    ok = running = bmp_run_ram(image);  /* detaches on success */
+  if (image != NULL)
+    bmp_image_delete(image);
+  if (!running)
+    bmp_detach(true);
+  bmp_progress_get(&unit->progress_pos, &unit->progress_range);
+  mtx_lock(&gang_mutex);
+  bmp_disconnect();
+  mtx_unlock(&gang_mutex);
+
+  bmp_context_select(NULL);
+  unit->status = ok ? GANG_SUCCESS : GANG_FAILED;
   return ok;
 }
 
+static void gang_cleanup(APPSTATE *state)
+{
+  assert(state != NULL);
+  for (int idx = 0; idx < state->gang_count; idx++) {
+    GANGUNIT *unit = &state->gang_units[idx];
+    if (unit->fpImage != NULL) {
+      fclose(unit->fpImage);
+      unit->fpImage = NULL;
+    }
+    if (unit->context != NULL) {
+      bmp_context_delete(unit->context);
+      unit->context = NULL;
+    }
+  }
+}
+
+/* gang_prepare() creates the units for all probes on USB, with a copy of the
+   image for each unit (which is serialized, if applicable); the vector table
+   patching is done once, on the shared image */
+static bool gang_prepare(APPSTATE *state)
+{
+  assert(state != NULL);
+  gang_cleanup(state);
+  state->gang_count = 0;
+
+  int count = get_bmp_count();
+  if (count == 0) {
+    log_addstring("^1No debug probes found\n");
+    return false;
+  }
+  if (count > MAX_GANG)
+    count = MAX_GANG;
+
+  assert(state->fpTgt == NULL && state->fpWork == NULL);
+  state->fpTgt = fopen(state->ELFfile, "rb");
+  if (state->fpTgt == NULL) {
+    log_addstring("^1Failed to load the target file\n");
+    return false;
+  }
+  if (state->architecture > 0) {
+    state->fpWork = tmpfile();
+    if (state->fpWork == NULL
+        || !copyfile(state->fpWork, state->fpTgt)
+        || !patch_vecttable(state->fpWork, architectures[state->architecture]))
+    {
+      log_addstring("^1Failed to process the target file\n");
+      return false;
+    }
+  }
+  FILE *fpImage = (state->fpWork != NULL) ? state->fpWork : state->fpTgt;
+
+  int serial = serial_get(state->Serial);
+  int incr = (int)strtol(state->SerialIncr, NULL, 10);
+  if (incr < 1)
+    incr = 1;
+  for (int idx = 0; idx < count; idx++) {
+    GANGUNIT *unit = &state->gang_units[idx];
+    memset(unit, 0, sizeof(GANGUNIT));
+    unit->state = state;
+    unit->probe = idx;
+    unit->status = GANG_IDLE;
+    state->gang_count = idx + 1;  /* so that gang_cleanup() also frees this unit on failure */
+    unit->context = bmp_context_create();
+    unit->fpImage = tmpfile();
+    if (unit->context == NULL || unit->fpImage == NULL || !copyfile(unit->fpImage, fpImage)) {
+      log_addstring("^1Failed to process the target file\n");
+      return false;
+    }
+    if (state->serialize != SER_NONE) {
+      if (!serialize_image(unit->fpImage, state, serial))
+        return false;
+      sprintf(unit->serial, "%d", serial);
+      serial += incr;
+    }
+  }
+  return true;
+}
+
 static void panel_options(struct nk_context *ctx, APPSTATE *state,
                           enum nk_collapse_states tab_states[TAB_COUNT])
 {
@@ -1381,12 +2107,30 @@ static void panel_options(struct nk_context *ctx, APPSTATE *state,
     checkbox_tooltip(ctx, "Post-process on failed downloads", &state->PostProcessFailures, NK_TEXT_LEFT,
                      "Also run the post-process script after a failed download");
 
+    nk_layout_row(ctx, NK_DYNAMIC, ROW_HEIGHT, 2, nk_ratio(2, 0.45, 0.55));
+    nk_label(ctx, "Extra images", NK_TEXT_ALIGN_LEFT | NK_TEXT_ALIGN_MIDDLE);
+    error = editctrl_cond_color(ctx, !plan_valid(state), COLOUR_BG_DARKRED);
+    editctrl_tooltip(ctx, NK_EDIT_FIELD,
+                     state->ExtraImages, sizearray(state->ExtraImages), nk_filter_ascii,
+                     "ELF and binary files to program together with the target file, separated by ';'\n"
+                     "(e.g. a bootloader); for binary files, add '@' and the address in hex,\n"
+                     "as in \"calib.bin@800f800\"");
+    editctrl_reset_color(ctx, error);
+
     nk_layout_row_dynamic(ctx, ROW_HEIGHT, 1);
     if (checkbox_tooltip(ctx, "Power Target (3.3V)", &state->tpwr, NK_TEXT_LEFT,
                          "Let the debug probe provide power to the target"))
       state->set_probe_options = true;
     checkbox_tooltip(ctx, "Full Flash Erase before download", &state->fullerase, NK_TEXT_LEFT,
                      "Erase entire Flash memory, instead of only sectors that are overwritten");
+    checkbox_tooltip(ctx, "Differential download", &state->differential, NK_TEXT_LEFT,
+                     "Only erase and write the Flash sectors whose contents changed");
+    checkbox_tooltip(ctx, "Choose erase method by speed", &state->autoerase, NK_TEXT_LEFT,
+                     "Use a mass erase instead of erasing sectors, when the measured speed\nfor the MCU shows that this is quicker (not with a differential download)");
+    checkbox_tooltip(ctx, "Download to RAM & run", &state->ramrun, NK_TEXT_LEFT,
+                     "Write firmware that is linked for RAM directly into RAM, and start it\n(Flash memory is not erased or written)");
+    checkbox_tooltip(ctx, "Program all probes (gang)", &state->gang, NK_TEXT_LEFT,
+                     "Download to all debug probes on USB in parallel");
     if (checkbox_tooltip(ctx, "Reset Target during connect", &state->connect_srst, NK_TEXT_LEFT,
                          "Keep target MCU reset while debug probe attaches"))
       state->set_probe_options = true;
@@ -1501,7 +2245,8 @@ static bool handle_stateaction(APPSTATE *state, enum nk_collapse_states tab_stat
       strlcpy(state->ParamFile, state->ELFfile, sizearray(state->ParamFile));
       strlcat(state->ParamFile, ".bmcfg", sizearray(state->ParamFile));
       save_targetparams(state->ParamFile, state);
-      state->curstate = STATE_ATTACH;
+      state->curstate = (state->gang && !state->skip_download) ? STATE_GANG_PREPARE : STATE_ATTACH;
+      state->gang_count = 0;  /* remove the results of the previous gang download */
       state->tstamp_start = timestamp();
     } else {
       log_addstring("^1Failed to open the ELF file\n");
@@ -1543,7 +2288,7 @@ static bool handle_stateaction(APPSTATE *state, enum nk_collapse_states tab_stat
           log_addstring(msg);
         }
       }
-      if (bmp_flashtotal() == 0)
+      if (bmp_flashtotal() == 0 && !state->ramrun)
         result = 0; /* no use downloading firmware to a chip that has no Flash */
     }
     state->curstate = (result && state->is_attached) ? STATE_PRE_DOWNLOAD : STATE_IDLE;
@@ -1563,47 +2308,25 @@ static bool handle_stateaction(APPSTATE *state, enum nk_collapse_states tab_stat
     break;
 
   case STATE_PATCH_ELF:
-    /* verify whether to patch the ELF file (create a temporary file) */
-    if (state->architecture > 0 || state->serialize != SER_NONE) {
-      assert(state->fpTgt != NULL);
-      state->fpWork = tmpfile();
-      if (state->fpWork == NULL) {
-        log_addstring("^1Failed to process the target file\n");
-        state->curstate = STATE_IDLE;
-        waitidle = false;
-        break;
-      }
-      result = copyfile(state->fpWork, state->fpTgt);
-      if (result && state->architecture > 0)
-        result = patch_vecttable(state->fpWork, architectures[state->architecture]);
-      if (result && state->serialize != SER_NONE) {
-        /* create replacement buffer, depending on format */
-        unsigned char data[50];
-        int datasize = (int)strtol(state->SerialSize, NULL, 10);
-        serialize_fmtoutput(data, datasize, serial_get(state->Serial), state->SerialFmt);
-        //??? enhancement: run a script, because the serial number may include a check digit
-        if (state->serialize == SER_ADDRESS)
-          result = serialize_address(state->fpWork, state->Section, strtoul(state->Address,NULL,16), data, datasize);
-        else if (state->serialize == SER_MATCH)
-          result = serialize_match(state->fpWork, state->Match, state->Prefix, data, datasize);
-        if (result) {
-          char msg[100];
-          sprintf(msg, "^4Serial adjusted to %d\n", serial_get(state->Serial));
-          log_addstring(msg);
-        }
-      }
-      state->curstate = result ? STATE_CLEARFLASH : STATE_IDLE;
-    } else {
-      state->curstate = STATE_CLEARFLASH;
-    }
+    /* build the image (or re-use it), then patch the serial number in it */
+    result = target_image(state);
+    if (result && state->serialize != SER_NONE)
+      result = serialize_target(state, serial_get(state->Serial));
+    state->curstate = result ? STATE_CLEARFLASH : STATE_IDLE;
     waitidle = false;
     break;
 
   case STATE_CLEARFLASH:
-    if (!state->skip_download && state->fullerase) {
+    if (!state->skip_download && !state->ramrun
+        && (state->fullerase
+            || (state->autoerase && !state->differential && erase_plan(state, state->mcufamily, state->image))))
+    {
       if (state->architecture > 0)
         bmp_runscript("memremap", architectures[state->architecture], NULL, NULL, 0);
-      result = bmp_fullerase();
+      if (state->fullerase)
+        result = bmp_fullerase();
+      else
+        result = erase_mass(state, state->mcufamily);
       state->curstate = result ? STATE_DOWNLOAD : STATE_IDLE;
     } else {
       state->curstate = STATE_DOWNLOAD;
@@ -1632,6 +2355,8 @@ static bool handle_stateaction(APPSTATE *state, enum nk_collapse_states tab_stat
         thrd_join(state->thrd_download, &retcode);
         ok = (retcode > 0 && state->isrunning_download == THRD_COMPLETED);
         state->isrunning_download = THRD_IDLE;
+        if (ok && state->autoerase && !state->ramrun)
+          erasecost_record(state, state->mcufamily);
       }
       if (state->isrunning_download == THRD_IDLE)
         state->curstate = ok ? STATE_VERIFY : STATE_IDLE;
@@ -1644,9 +2369,8 @@ static bool handle_stateaction(APPSTATE *state, enum nk_collapse_states tab_stat
   case STATE_VERIFY:
     if (state->architecture > 0) {
       /* check whether CRP was set; if so, verification will always fail */
-      assert(state->fpWork != NULL);
       int crp;
-      result = elf_check_crp(state->fpWork, &crp);
+      result = elf_check_crp((state->fpWork != NULL) ? state->fpWork : state->fpTgt, &crp);
       if (result == ELFERR_NONE && crp > 0 && crp < 4) {
         /* CRP level set on the ELF file; it may still be that the code in
            the target does not have CRP set, but regardless, it won't match
@@ -1659,7 +2383,11 @@ static bool handle_stateaction(APPSTATE *state, enum nk_collapse_states tab_stat
     /* compare the checksum of Flash memory to the file */
     if (state->architecture > 0)
       bmp_runscript("memremap", architectures[state->architecture], NULL, NULL, 0);
-    state->download_success = bmp_verify((state->fpWork != NULL)? state->fpWork : state->fpTgt);
+    assert(state->image != NULL);
+    if (!state->skip_download && bmp_image_verified(state->image))
+      state->download_success = true;   /* verified during the download */
+    else
+      state->download_success = bmp_verify_image(state->image);
     if (state->download_success)
       state->curstate = STATE_FINISH;
     else if (strlen(state->PostProcess) > 0 && state->PostProcessFailures)
@@ -1676,25 +2404,15 @@ static bool handle_stateaction(APPSTATE *state, enum nk_collapse_states tab_stat
     break;
 
   case STATE_FINISH:
+    /* for a RAM download, start the code (this detaches from the target) */
+    if (state->ramrun && !state->skip_download && bmp_run_ram(state->image))
+      state->is_attached = false;
     /* optionally log the download */
-    if (state->write_log && !writelog(state->ELFfile, (state->serialize != SER_NONE) ? state->Serial : NULL))
-      log_addstring("^3Failed to write to log file\n");
+    if (state->write_log)
+      writelog_post(state->ELFfile, (state->serialize != SER_NONE) ? state->Serial : NULL);
     /* optionally increment the serial number */
-    if (state->serialize != SER_NONE && !state->skip_download) {
-      int incr = (int)strtol(state->SerialIncr, NULL, 10);
-      if (incr < 1)
-        incr = 1;
-      serial_increment(state->Serial, incr);
-      /* must update this in the cache file immediately (so that the cache is
-         up-to-date when the user aborts/quits the utility) */
-      char field[200];
-      sprintf(field, "%s:%s:%d:%s", state->Serial, state->SerialSize, state->SerialFmt, state->SerialIncr);
-      char serialfile[_MAX_PATH];
-      strlcpy(serialfile, state->ParamFile, sizearray(serialfile));
-      if (strlen(state->SerialFile) > 0)
-        getpath(serialfile, sizearray(serialfile), state->SerialFile, state->ParamFile);
-      ini_puts("Serialize", "serial", field, serialfile);
-    }
+    if (state->serialize != SER_NONE && !state->skip_download)
+      serial_advance(state, 1);
     state->curstate = STATE_POSTPROCESS;
     waitidle = false;
     break;
@@ -1740,6 +2458,70 @@ static bool handle_stateaction(APPSTATE *state, enum nk_collapse_states tab_stat
     }
     break;
 
+  case STATE_GANG_PREPARE:
+    /* close the connection of the main thread, so that each probe is free to
+       be opened by its worker thread */
+    bmp_disconnect();
+    state->curstate = gang_prepare(state) ? STATE_GANG_DOWNLOAD : STATE_IDLE;
+    if (state->curstate == STATE_IDLE)
+      gang_cleanup(state);
+    waitidle = false;
+    break;
+
+  case STATE_GANG_DOWNLOAD:
+    if (state->isrunning_download == THRD_IDLE) {
+      char msg[100];
+      sprintf(msg, "Programming %d probes\n", state->gang_count);
+      log_addstring(msg);
+      mtx_init(&gang_mutex, mtx_plain);
+      state->isrunning_download = THRD_RUNNING;
+      for (int idx = 0; idx < state->gang_count; idx++) {
+        GANGUNIT *unit = &state->gang_units[idx];
+        unit->started = (thrd_create(&unit->thread, gang_thread, unit) == thrd_success);
+        if (!unit->started)
+          unit->status = GANG_FAILED;
+      }
+    } else {
+      int idx, done = 0;
+      for (idx = 0; idx < state->gang_count; idx++)
+        if (state->gang_units[idx].status >= GANG_SUCCESS)
+          done++;
+      if (done < state->gang_count) {
+        waitidle = false;
+        break;  /* not all units are done yet */
+      }
+      if (state->isrunning_download == THRD_ABORT)
+        log_addstring("^1Aborted\n");
+      int success = 0;
+      for (idx = 0; idx < state->gang_count; idx++) {
+        GANGUNIT *unit = &state->gang_units[idx];
+        int retcode;
+        if (!unit->started || thrd_join(unit->thread, &retcode) != thrd_success || unit->status != GANG_SUCCESS)
+          continue;
+        success++;
+        if (state->write_log)
+          writelog_post(state->ELFfile, unit->serial);
+      }
+      mtx_destroy(&gang_mutex);
+      gang_cleanup(state);
+      state->isrunning_download = THRD_IDLE;
+      state->download_success = (success == state->gang_count);
+      char msg[100];
+      sprintf(msg, "%s%d of %d probes programmed\n",
+              state->download_success ? "^2" : "^1", success, state->gang_count);
+      log_addstring(msg);
+      if (state->print_time) {
+        sprintf(msg, "Completed in %.1f seconds\n", (timestamp() - state->tstamp_start) / 1000.0);
+        log_addstring(msg);
+      }
+      /* every unit took a serial number (also the ones that failed) */
+      if (state->serialize != SER_NONE)
+        serial_advance(state, state->gang_count);
+      state->curstate = STATE_IDLE;
+    }
+    waitidle = false;
+    break;
+
   case STATE_ERASE_OPTBYTES:
     bmp_progress_reset(0);
     if (bmp_connect(state->probe, (state->probe == state->netprobe) ? state->IPaddr : NULL)
@@ -1843,11 +2625,16 @@ int main(int argc, char *argv[])
 
   /* read defaults from the configuration file */
   get_configfile(txtConfigFile, sizearray(txtConfigFile), "bmflash.ini");
+  ini_cache_open(txtConfigFile);  /* read settings from memory, write back on exit */
+  appstate.configfile = txtConfigFile;
   appstate.probe = (int)ini_getl("Settings", "probe", 0, txtConfigFile);
   ini_gets("Settings", "ip-address", "127.0.0.1", appstate.IPaddr, sizearray(appstate.IPaddr), txtConfigFile);
   opt_fontsize = ini_getf("Settings", "fontsize", FONT_HEIGHT, txtConfigFile);
   ini_gets("Settings", "fontstd", "", opt_fontstd, sizearray(opt_fontstd), txtConfigFile);
   ini_gets("Settings", "fontmono", "", opt_fontmono, sizearray(opt_fontmono), txtConfigFile);
+  bmp_setflashwindow((int)ini_getl("Settings", "flash-window-usb", 0, txtConfigFile),
+                     (int)ini_getl("Settings", "flash-window-tcp", 0, txtConfigFile));
+  bmp_setflashoverlap(ini_getbool("Settings", "flash-overlap", 1, txtConfigFile));
 
   for (idx = 1; idx < argc; idx++) {
     if (IS_OPTION(argv[idx])) {
@@ -1973,11 +2760,39 @@ int main(int argc, char *argv[])
           nk_layout_row_dynamic(ctx, LOGVIEW_ROWS*ROW_HEIGHT, 1);
           log_widget(ctx, "status", logtext, opt_fontsize, &loglines);
 
-          nk_layout_row_dynamic(ctx, ROW_HEIGHT*0.4, 1);
-          unsigned long progress_pos, progress_range;
-          bmp_progress_get(&progress_pos, &progress_range);
-          nk_size progress = progress_pos;
-          nk_progress(ctx, &progress, progress_range, NK_FIXED);
+          if (appstate.gang_count > 0) {
+            static const char *gang_status[] = { "Waiting", "Connecting", "Downloading",
+                                                 "Verifying", "Done", "Failed" };
+            for (int unit_idx = 0; unit_idx < appstate.gang_count; unit_idx++) {
+              GANGUNIT *unit = &appstate.gang_units[unit_idx];
+              unsigned long progress_pos, progress_range;
+              if (unit->context != NULL && unit->status < GANG_SUCCESS) {
+                /* peek at the progress of the worker thread */
+                bmp_context_select(unit->context);
+                bmp_progress_get(&progress_pos, &progress_range);
+                bmp_context_select(NULL);
+              } else {
+                progress_pos = unit->progress_pos;
+                progress_range = unit->progress_range;
+              }
+              char label[64];
+              if (strlen(unit->serial) > 0)
+                sprintf(label, "Probe %d (serial %s)", unit_idx + 1, unit->serial);
+              else
+                sprintf(label, "Probe %d", unit_idx + 1);
+              nk_layout_row(ctx, NK_DYNAMIC, ROW_HEIGHT * 0.8, 3, nk_ratio(3, 0.4, 0.2, 0.4));
+              nk_label(ctx, label, NK_TEXT_ALIGN_LEFT | NK_TEXT_ALIGN_MIDDLE);
+              nk_label(ctx, gang_status[unit->status], NK_TEXT_ALIGN_LEFT | NK_TEXT_ALIGN_MIDDLE);
+              nk_size progress = progress_pos;
+              nk_progress(ctx, &progress, progress_range, NK_FIXED);
+            }
+          } else {
+            nk_layout_row_dynamic(ctx, ROW_HEIGHT*0.4, 1);
+            unsigned long progress_pos, progress_range;
+            bmp_progress_get(&progress_pos, &progress_range);
+            nk_size progress = progress_pos;
+            nk_progress(ctx, &progress, progress_range, NK_FIXED);
+          }
 
           nk_tree_state_pop(ctx);
         }
@@ -2089,8 +2904,12 @@ int main(int argc, char *argv[])
   if (bmp_is_ip_address(appstate.IPaddr))
     ini_puts("Settings", "ip-address", appstate.IPaddr, txtConfigFile);
   ini_putl("Settings", "appstate.probe", (appstate.probe == appstate.netprobe) ? 99 : appstate.probe, txtConfigFile);
+  ini_cache_close(txtConfigFile);
 
+  writelog_flush();
   clear_probelist(appstate.probelist, appstate.netprobe);
+  if (appstate.image != NULL)
+    bmp_image_delete(appstate.image);
   tcl_destroy(&appstate.tcl);
   rspreply_clear();
   guidriver_close();
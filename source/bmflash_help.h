@@ -59,6 +59,20 @@ const char bmflash_help[] = {
   " erased & overwritten. Note that you can also clear all Flash memory via the\n"
   " Tools button.\n"
   "\n"
+  "*Differential download*\n"
+  ": With this option, the Flash sectors are first compared (via a CRC) with the\n"
+  " data in the ELF file, and only the sectors whose contents differ get erased &\n"
+  " overwritten. This speeds up re-programming an image that differs only in a\n"
+  " few places (such as the serial number). It has no effect when the Full Flash\n"
+  " Erase option is set.\n"
+  "\n"
+  "*Program all probes (gang)*\n"
+  ": With this option, the firmware is downloaded to all debug probes that are\n"
+  " connected to USB, in parallel. Each probe gets its own serial number (if\n"
+  " serialization is active), and the Status view shows the progress for each\n"
+  " probe. The post-process script is not run in this mode. Network probes\n"
+  " (TCP/IP) are not included.\n"
+  "\n"
   "*Reset target during connect*\n"
   ": This option may be needed on some microcontrollers, especially if SWD pins get redefined.\n"
   "\n"
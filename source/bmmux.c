@@ -0,0 +1,534 @@
+/*
+ * Probe-sharing daemon for the Black Magic Probe. It owns the connection to
+ * the probe (the GDB serial port and the SWO trace endpoint), and it serves
+ * several local clients, so that the tools (or GDB) can be started and closed
+ * without re-opening the probe. The clients connect to 127.0.0.1, as if the
+ * probe were a ctxLink: GDB RSP on port 2159 and SWO on port 2161.
+ *
+ * RSP requests are arbitrated: one request is forwarded to the probe at a
+ * time, and the probe's replies go to the client that sent the request. The
+ * SWO data is passed on to every trace client.
+ *
+ * Copyright 2026 CompuPhase
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <assert.h>
+#include <signal.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#if defined _WIN32
+# define STRICT
+# define WIN32_LEAN_AND_MEAN
+# include <windows.h>
+# include <winsock2.h>
+#else
+# include <errno.h>
+# include <fcntl.h>
+# include <unistd.h>
+# include <arpa/inet.h>
+# include <netinet/in.h>
+# include <netinet/tcp.h>
+# include <sys/select.h>
+#endif
+#include "bmp-scan.h"
+#include "bmp-support.h"
+#include "gdb-rsp.h"
+#include "nuklear.h"
+#include "swotrace.h"
+#include "tcpip.h"
+#include "svnrev.h"
+
+#if defined FORTIFY
+# include <alloc/fortify.h>
+#endif
+
+#if defined WIN32 || defined _WIN32
+# define IS_OPTION(s)  ((s)[0] == '-' || (s)[0] == '/')
+#else
+# define IS_OPTION(s)  ((s)[0] == '-')
+#endif
+
+#if !defined sizearray
+# define sizearray(e)    (sizeof(e) / sizeof((e)[0]))
+#endif
+
+#define MAX_CLIENTS     8
+#define CLIENT_BUFSIZE  (16*1024)   /* must hold the largest request */
+#define REPLY_TIMEOUT   30          /* seconds, for requests that do not resume the target */
+#define TRACE_CHUNK     (16*1024)   /* SWO data passed on in one go */
+
+enum {
+  CLIENT_FREE,
+  CLIENT_GDB,
+  CLIENT_TRACE,
+};
+
+typedef struct tagCLIENT {
+  SOCKET sock;
+  int kind;
+  bool noack;             /* client has switched to no-ack mode */
+  size_t length;          /* number of bytes in the buffer */
+  size_t framesize;       /* size of the complete request at the start of the buffer (0 if none) */
+  unsigned char buffer[CLIENT_BUFSIZE];
+} CLIENT;
+
+static CLIENT clients[MAX_CLIENTS];
+static int owner = -1;              /* client whose request is being handled */
+static bool owner_running = false;  /* request of the owner resumed the target */
+static bool discard_reply = false;  /* owner went away, drop the reply to its request */
+static time_t request_time;
+static int next_client = 0;         /* round-robin index for arbitration */
+static volatile sig_atomic_t quit = 0;
+static bool opt_verbose = false;
+
+
+static int bmp_callback(int code, const char *message)
+{
+  if (code < 0 || opt_verbose)
+    fprintf(stderr, "%s\n", message);
+  return 0;
+}
+
+/* the CTF decoder is linked in with the SWO module, but it is not used (the
+   SWO data is passed on without decoding it) */
+int ctf_error_notify(int code, int linenr, const char *message)
+{
+  (void)code;
+  (void)linenr;
+  (void)message;
+  return 0;
+}
+
+static void sighandler(int sig)
+{
+  (void)sig;
+  quit = 1;
+}
+
+static void set_nonblocking(SOCKET sock)
+{
+# if defined WIN32 || defined _WIN32
+    unsigned long mode = 1;
+    ioctlsocket(sock, FIONBIO, &mode);
+# else
+    fcntl(sock, F_SETFL, O_NONBLOCK);
+# endif
+}
+
+/* open_listener() creates a socket that accepts connections on the loopback
+   interface only */
+static SOCKET open_listener(unsigned short port)
+{
+  SOCKET sock = socket(AF_INET, SOCK_STREAM, 0);
+  if (sock == INVALID_SOCKET)
+    return INVALID_SOCKET;
+  int reuse = 1;
+  setsockopt(sock, SOL_SOCKET, SO_REUSEADDR, (const char*)&reuse, sizeof reuse);
+  struct sockaddr_in address;
+  memset(&address, 0, sizeof address);
+  address.sin_family = AF_INET;
+  address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  address.sin_port = htons(port);
+  if (bind(sock, (struct sockaddr*)&address, sizeof address) != 0 || listen(sock, MAX_CLIENTS) != 0) {
+    closesocket(sock);
+    return INVALID_SOCKET;
+  }
+  return sock;
+}
+
+/* client_send() transmits the complete buffer to a client (GDB clients use
+   blocking sockets, so a partial send means that the connection failed) */
+static bool client_send(CLIENT *client, const unsigned char *data, size_t size)
+{
+  while (size > 0) {
+    int result = send(client->sock, (const char*)data, (int)size, 0);
+    if (result <= 0)
+      return false;
+    data += result;
+    size -= result;
+  }
+  return true;
+}
+
+static void client_accept(SOCKET listener, int kind)
+{
+  SOCKET sock = accept(listener, NULL, NULL);
+  if (sock == INVALID_SOCKET)
+    return;
+  int idx;
+  for (idx = 0; idx < MAX_CLIENTS && clients[idx].kind != CLIENT_FREE; idx++)
+    {}
+  if (idx >= MAX_CLIENTS) {
+    fprintf(stderr, "Too many clients, connection refused\n");
+    closesocket(sock);
+    return;
+  }
+  CLIENT *client = &clients[idx];
+  memset(client, 0, sizeof(CLIENT));
+  client->sock = sock;
+  client->kind = kind;
+  if (kind == CLIENT_TRACE) {
+    set_nonblocking(sock);  /* a slow trace client must not stall the others */
+  } else {
+    /* the acknowledge and the reply are sent separately, so without this
+       option, the reply waits for the acknowledge to be confirmed */
+    int nodelay = 1;
+    setsockopt(sock, IPPROTO_TCP, TCP_NODELAY, (const char*)&nodelay, sizeof nodelay);
+  }
+  if (opt_verbose)
+    fprintf(stderr, "Client %d connected (%s)\n", idx + 1, (kind == CLIENT_GDB) ? "RSP" : "SWO");
+}
+
+static void client_close(int idx)
+{
+  assert(idx >= 0 && idx < MAX_CLIENTS);
+  CLIENT *client = &clients[idx];
+  if (client->kind == CLIENT_FREE)
+    return;
+  closesocket(client->sock);
+  client->kind = CLIENT_FREE;
+  if (idx == owner) {
+    /* the reply to the pending request must still be read from the probe,
+       but it has nowhere to go; if the target was resumed, stop it, or else
+       the probe would not accept the next request */
+    if (owner_running)
+      bmp_break();
+    discard_reply = true;
+    request_time = time(NULL);
+    owner = -1;
+  }
+  if (opt_verbose)
+    fprintf(stderr, "Client %d disconnected\n", idx + 1);
+}
+
+/* reply_local() sends a reply to a client, for a request that the daemon
+   handles itself */
+static bool reply_local(CLIENT *client, const char *reply)
+{
+  unsigned char frame[64];
+  size_t size = gdbrsp_encode(reply, -1, frame, sizeof frame);
+  assert(size <= sizeof frame);
+  return client_send(client, frame, size);
+}
+
+static bool is_output(const unsigned char *frame, size_t size)
+{
+  /* console output is 'O' followed by hex digits (and "OK" is not output) */
+  return size > 4 && frame[1] == 'O' && frame[2] != 'K' && frame[2] != '#';
+}
+
+static bool is_resume(const unsigned char *payload, size_t size)
+{
+  return size > 0 && payload[0] != '\0' && (strchr("cCsS", payload[0]) != NULL
+                      || (size > 6 && memcmp(payload, "vCont;", 6) == 0));
+}
+
+/* client_parse() scans the data received from a GDB client for a complete
+   request; it handles acknowledgements and the Ctrl-C byte (interrupt) on the
+   fly; it returns false if the connection should be closed */
+static bool client_parse(int idx)
+{
+  CLIENT *client = &clients[idx];
+  while (client->framesize == 0 && client->length > 0) {
+    unsigned char *buf = client->buffer;
+    size_t skip = 1;
+    if (buf[0] == '$') {
+      size_t end;
+      for (end = 1; end < client->length && buf[end] != '#'; end++)
+        {}
+      if (end + 2 >= client->length) {
+        if (client->length == CLIENT_BUFSIZE)
+          return false;     /* request is bigger than the buffer */
+        return true;        /* request is incomplete */
+      }
+      unsigned sum = 0;
+      for (size_t i = 1; i < end; i++)
+        sum += buf[i];
+      char chksum[3] = { (char)buf[end + 1], (char)buf[end + 2], '\0' };
+      bool valid = (strtoul(chksum, NULL, 16) == (sum & 0xff));
+      if (!client->noack && !client_send(client, (const unsigned char*)(valid ? "+" : "-"), 1))
+        return false;
+      if (valid) {
+        client->framesize = end + 3;
+        return true;
+      }
+      skip = end + 3;       /* drop the invalid request (the client resends it) */
+    } else if (buf[0] == '\x03') {
+      if (idx == owner)
+        bmp_break();        /* only the client that resumed the target may interrupt it */
+    }
+    /* acknowledgements from the client are ignored: TCP/IP is reliable */
+    memmove(buf, buf + skip, client->length - skip);
+    client->length -= skip;
+  }
+  return true;
+}
+
+/* client_request() handles the request at the start of the client's buffer;
+   most requests are forwarded to the probe, a few are handled locally */
+static bool client_request(int idx)
+{
+  CLIENT *client = &clients[idx];
+  assert(client->framesize > 0 && owner < 0);
+  const unsigned char *payload = client->buffer + 1;
+  size_t paysize = client->framesize - 4;
+  bool result = true;
+  if (paysize == 15 && memcmp(payload, "QStartNoAckMode", paysize) == 0) {
+    /* the connection to the probe has its own ack mode, so this is local */
+    result = reply_local(client, "OK");
+    client->noack = true;
+  } else if (gdbrsp_xmit_frame(client->buffer, client->framesize)) {
+    owner = idx;
+    owner_running = is_resume(payload, paysize);
+    request_time = time(NULL);
+  } else {
+    result = false;
+    fprintf(stderr, "Failed to forward a request to the probe\n");
+  }
+  memmove(client->buffer, client->buffer + client->framesize, client->length - client->framesize);
+  client->length -= client->framesize;
+  client->framesize = 0;
+  return result;
+}
+
+/* probe_poll() checks for a reply from the probe, and passes it on to the
+   client that sent the request */
+static void probe_poll(void)
+{
+  static unsigned char frame[CLIENT_BUFSIZE];
+  size_t size;
+  while ((size = gdbrsp_recv_frame(frame, sizeof frame, (owner >= 0) ? 2 : 0)) > 0) {
+    if (size > sizeof frame)
+      continue;             /* truncated, the client must time out on it */
+    bool final = !is_output(frame, size);
+    if (owner >= 0) {
+      if (!client_send(&clients[owner], frame, size))
+        client_close(owner);  /* this may set discard_reply */
+    }
+    if (final) {
+      if (owner >= 0)
+        owner = -1;
+      else
+        discard_reply = false;
+    }
+  }
+  if (((owner >= 0 && !owner_running) || discard_reply) && time(NULL) - request_time > REPLY_TIMEOUT) {
+    fprintf(stderr, "No reply from the probe, request dropped\n");
+    owner = -1;
+    discard_reply = false;
+  }
+}
+
+static void trace_fanout(void)
+{
+  static unsigned char buffer[TRACE_CHUNK];
+  size_t size;
+  while ((size = trace_rawread(buffer, sizeof buffer)) > 0) {
+    for (int idx = 0; idx < MAX_CLIENTS; idx++) {
+      /* if the client does not keep up, the data is dropped for that
+         client (the decoder re-synchronizes on the ITM packet headers) */
+      if (clients[idx].kind == CLIENT_TRACE)
+        send(clients[idx].sock, (const char*)buffer, (int)size, 0);
+    }
+  }
+}
+
+static void usage(const char *invalid_option)
+{
+  if (invalid_option != NULL)
+    fprintf(stderr, "Unknown option %s; use -h for help.\n\n", invalid_option);
+  else
+    printf("BMMux shares a Black Magic Probe between several tools.\n\n");
+  printf("Usage: bmmux [options]\n\n"
+         "Options:\n"
+         "-ip=addr\tConnect to a ctxLink probe at this IP address.\n"
+         "-notrace\tDo not open the SWO trace interface.\n"
+         "-probe=n\tThe sequence number of the probe (starting at 1).\n"
+         "-v\t\tPrint status messages on stderr.\n\n"
+         "The tools connect to the probe via IP address 127.0.0.1, instead of a\n"
+         "USB port. Press Ctrl+C to quit.\n");
+}
+
+static const char *option_value(const char *arg, const char *name)
+{
+  size_t len = strlen(name);
+  if (strncmp(arg + 1, name, len) != 0)
+    return NULL;
+  arg += len + 1;
+  if (*arg == '=' || *arg == ':')
+    return arg + 1;
+  return (*arg == '\0') ? arg : NULL;
+}
+
+int main(int argc, char *argv[])
+{
+  const char *ipaddr = NULL;
+  int probe = 0;
+  bool swotrace = true;
+
+  for (int idx = 1; idx < argc; idx++) {
+    const char *value;
+    if (!IS_OPTION(argv[idx])) {
+      usage(argv[idx]);
+      return EXIT_FAILURE;
+    }
+    if (strcmp(argv[idx] + 1, "h") == 0 || strcmp(argv[idx] + 1, "?") == 0) {
+      usage(NULL);
+      return EXIT_SUCCESS;
+    } else if ((value = option_value(argv[idx], "ip")) != NULL) {
+      ipaddr = value;
+    } else if (option_value(argv[idx], "notrace") != NULL) {
+      swotrace = false;
+    } else if ((value = option_value(argv[idx], "probe")) != NULL) {
+      probe = (int)strtol(value, NULL, 10) - 1;
+      if (probe < 0)
+        probe = 0;
+    } else if (option_value(argv[idx], "v") != NULL) {
+      opt_verbose = true;
+    } else {
+      usage(argv[idx]);
+      return EXIT_FAILURE;
+    }
+  }
+
+  if (tcpip_init() != 0) {
+    fprintf(stderr, "Network initialization failure\n");
+    return EXIT_FAILURE;
+  }
+  bmp_setcallback(bmp_callback);
+  if (!bmp_connect(probe, ipaddr)) {
+    fprintf(stderr, "Failed to connect to the probe\n");
+    return EXIT_FAILURE;
+  }
+  SOCKET gdb_listener = open_listener(BMP_PORT_GDB);
+  if (gdb_listener == INVALID_SOCKET) {
+    fprintf(stderr, "Cannot open port %d (is another instance running?)\n", BMP_PORT_GDB);
+    bmp_disconnect();
+    return EXIT_FAILURE;
+  }
+  SOCKET trace_listener = INVALID_SOCKET;
+  if (swotrace) {
+    /* only the interface is opened here: the SWO protocol and bit rate are
+       set by the client that issues the "traceswo" monitor command */
+    int result = (ipaddr != NULL) ? trace_init(BMP_PORT_TRACE, ipaddr) : trace_init(BMP_EP_TRACE, NULL);
+    if (result == TRACESTAT_OK)
+      trace_listener = open_listener(BMP_PORT_TRACE);
+    if (trace_listener == INVALID_SOCKET)
+      fprintf(stderr, "SWO trace is not available\n");
+  }
+  printf("Sharing the probe on 127.0.0.1 (RSP port %d", BMP_PORT_GDB);
+  if (trace_listener != INVALID_SOCKET)
+    printf(", SWO port %d", BMP_PORT_TRACE);
+  printf(")\n");
+  fflush(stdout);
+
+  signal(SIGINT, sighandler);
+  signal(SIGTERM, sighandler);
+# if !defined _WIN32
+    signal(SIGPIPE, SIG_IGN); /* a client that went away is detected by send() */
+# endif
+  for (int idx = 0; idx < MAX_CLIENTS; idx++)
+    clients[idx].kind = CLIENT_FREE;
+
+  while (!quit && bmp_isopen()) {
+    fd_set readset;
+    FD_ZERO(&readset);
+    SOCKET maxsock = gdb_listener;
+    FD_SET(gdb_listener, &readset);
+    if (trace_listener != INVALID_SOCKET) {
+      FD_SET(trace_listener, &readset);
+      if (trace_listener > maxsock)
+        maxsock = trace_listener;
+    }
+    for (int idx = 0; idx < MAX_CLIENTS; idx++) {
+      if (clients[idx].kind != CLIENT_FREE) {
+        FD_SET(clients[idx].sock, &readset);
+        if (clients[idx].sock > maxsock)
+          maxsock = clients[idx].sock;
+      }
+    }
+    /* the probe cannot be included in the select() (a serial port on
+       Windows), so the timeout is short, and the probe is polled after it */
+    struct timeval tv;
+    tv.tv_sec = 0;
+    tv.tv_usec = (owner >= 0) ? 0 : 10*1000;
+    int ready = select((int)maxsock + 1, &readset, NULL, NULL, &tv);
+    if (ready < 0) {
+#     if !defined _WIN32
+        if (errno == EINTR)
+          continue;
+#     endif
+      break;
+    }
+
+    if (ready > 0) {
+      if (FD_ISSET(gdb_listener, &readset))
+        client_accept(gdb_listener, CLIENT_GDB);
+      if (trace_listener != INVALID_SOCKET && FD_ISSET(trace_listener, &readset))
+        client_accept(trace_listener, CLIENT_TRACE);
+      for (int idx = 0; idx < MAX_CLIENTS; idx++) {
+        CLIENT *client = &clients[idx];
+        if (client->kind == CLIENT_FREE || !FD_ISSET(client->sock, &readset))
+          continue;
+        if (client->kind == CLIENT_TRACE) {
+          unsigned char scratch[256]; /* trace clients send nothing, except on close */
+          if (recv(client->sock, (char*)scratch, sizeof scratch, 0) <= 0)
+            client_close(idx);
+          continue;
+        }
+        int count = recv(client->sock, (char*)client->buffer + client->length,
+                         (int)(CLIENT_BUFSIZE - client->length), 0);
+        if (count <= 0) {
+          client_close(idx);
+          continue;
+        }
+        client->length += count;
+        if (!client_parse(idx))
+          client_close(idx);
+      }
+    }
+
+    /* forward the next request, in round-robin order over the clients */
+    if (owner < 0 && !discard_reply) {
+      for (int i = 0; i < MAX_CLIENTS && owner < 0; i++) {
+        int idx = (next_client + i) % MAX_CLIENTS;
+        CLIENT *client = &clients[idx];
+        if (client->kind != CLIENT_GDB || client->framesize == 0)
+          continue;
+        if (!client_request(idx) || !client_parse(idx))
+          client_close(idx);
+        next_client = (idx + 1) % MAX_CLIENTS;
+      }
+    }
+    probe_poll();
+    if (trace_listener != INVALID_SOCKET)
+      trace_fanout();
+  }
+
+  if (!quit)
+    fprintf(stderr, "Connection to the probe was lost\n");
+  for (int idx = 0; idx < MAX_CLIENTS; idx++)
+    client_close(idx);
+  if (trace_listener != INVALID_SOCKET) {
+    closesocket(trace_listener);
+    trace_close();
+  }
+  closesocket(gdb_listener);
+  bmp_disconnect();
+  tcpip_cleanup();
+  return EXIT_SUCCESS;
+}
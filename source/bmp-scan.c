@@ -27,6 +27,7 @@
 #if defined WIN32 || defined _WIN32
 # define STRICT
 # define WIN32_LEAN_AND_MEAN
+# define FD_SETSIZE  256    /* must be at least SCAN_MAXSOCKETS */
 # include <windows.h>
 # include <tchar.h>
 # if defined __MINGW32__ || defined __MINGW64__
@@ -35,9 +36,21 @@
 # endif
 #else
 # include <dirent.h>
+# include <errno.h>
+# include <fcntl.h>
+# include <poll.h>
 # include <pthread.h>
+# include <strings.h>
+# include <time.h>
 # include <unistd.h>
+# include <arpa/inet.h>
+# include <netinet/in.h>
 # include <bsd/string.h>
+# if defined __linux__
+#   include <sys/inotify.h>
+# endif
+  typedef char TCHAR;
+# define _tcsicmp(s1,s2)  strcasecmp((s1),(s2))
 #endif
 
 #include "bmp-scan.h"
@@ -59,7 +72,7 @@
 
 #if defined WIN32 || defined _WIN32
 
-/** find_bmp() scans the system for the Black Magic Probe and a specific
+/* scan_bmp() scans the system for the Black Magic Probe and a specific
  *  interface. For a serial interface, it returns the COM port and for the
  *  trace or DFU interfaces, it returns the GUID (needed to open a WinUSB
  *  handle on it).
@@ -74,7 +87,7 @@
  *
  *  \return 1 on success, 0 on failure.
  */
-int find_bmp(int seqnr, int iface, TCHAR *name, size_t namelen)
+static int scan_bmp(int seqnr, int iface, TCHAR *name, size_t namelen)
 {
   HKEY hkeySection, hkeyItem;
   TCHAR regpath[128];
@@ -293,7 +306,7 @@ static int gethex(const char *ptr, int length)
   return (int)strtol(hexstr, NULL, 16);
 }
 
-/** find_bmp() scans the system for the Black Magic Probe and a specific
+/* scan_bmp() scans the system for the Black Magic Probe and a specific
  *  interface. For a serial interface, it returns the COM port and for the
  *  trace or DFU interfaces, it returns the GUID (needed to open a WinUSB
  *  handle on it).
@@ -304,7 +317,7 @@ static int gethex(const char *ptr, int length)
  *                  this parameter.
  *  \param namelen  The size of the "name" parameter (in characters).
  */
-int find_bmp(int seqnr, int iface, char *name, size_t namelen)
+static int scan_bmp(int seqnr, int iface, char *name, size_t namelen)
 {
   DIR *dsys;
   struct dirent *dir;
@@ -419,13 +432,228 @@ int find_bmp(int seqnr, int iface, char *name, size_t namelen)
 
 #endif
 
+/* The probe registry caches the results of scan_bmp(), so that the probe lists
+   in the user interface (which are refreshed often) and repeated look-ups of
+   the interfaces of a probe do not go through the registry or sysfs each time.
+   The cache is dropped when the operating system signals that devices were
+   added or removed: in Microsoft Windows, through a change notification on
+   the registry key with the serial ports; in Linux, through inotify on /dev
+   (where the tty devices of the probes appear). When the notification cannot
+   be set up, nothing is cached. */
+#define REG_MAXPROBES 16
+#define REG_NAMESIZE  128
+
+enum {
+  SLOT_GDB,
+  SLOT_UART,
+  SLOT_TRACE,
+  SLOT_SERIAL,
+  SLOT_COUNT
+};
+
+typedef struct tagPROBEENTRY {
+  unsigned char known[SLOT_COUNT];  /* whether the interface was looked up */
+  unsigned char found[SLOT_COUNT];  /* result of the look-up */
+  TCHAR name[SLOT_COUNT][REG_NAMESIZE];
+} PROBEENTRY;
+
+static PROBEENTRY registry[REG_MAXPROBES];
+static int registry_count = -1;     /* -1 if not yet counted */
+static mtx_t registry_lock;
+static once_flag registry_once = ONCE_FLAG_INIT;
+
+#if defined WIN32 || defined _WIN32
+  static HKEY registry_key = NULL;
+  static HANDLE registry_event = NULL;
+#elif defined __linux__
+  static int registry_notify = -1;
+#endif
+
+static void registry_init(void)
+{
+  mtx_init(&registry_lock, mtx_plain);
+}
+
+static int registry_slot(int iface)
+{
+  switch (iface) {
+  case BMP_IF_GDB:
+    return SLOT_GDB;
+  case BMP_IF_UART:
+    return SLOT_UART;
+  case BMP_IF_TRACE:
+    return SLOT_TRACE;
+  case BMP_IF_SERIAL:
+    return SLOT_SERIAL;
+  }
+  return -1;
+}
+
+/* registry_changed() returns whether devices may have been added or removed
+   since the previous call (it returns 1 on the first call, and on every call
+   if no notification could be set up) */
+static int registry_changed(void)
+{
+# if defined WIN32 || defined _WIN32
+    if (registry_event == NULL) {
+      if (RegOpenKeyEx(HKEY_LOCAL_MACHINE, _T("HARDWARE\\DEVICEMAP\\SERIALCOMM"), 0,
+                       KEY_NOTIFY, &registry_key) != ERROR_SUCCESS)
+        return 1;
+      registry_event = CreateEvent(NULL, TRUE, FALSE, NULL);
+      if (registry_event == NULL) {
+        RegCloseKey(registry_key);
+        return 1;
+      }
+    } else if (WaitForSingleObject(registry_event, 0) != WAIT_OBJECT_0) {
+      return 0;
+    }
+    /* (re-)arm the notification */
+    ResetEvent(registry_event);
+    if (RegNotifyChangeKeyValue(registry_key, FALSE, REG_NOTIFY_CHANGE_LAST_SET,
+                                registry_event, TRUE) != ERROR_SUCCESS) {
+      CloseHandle(registry_event);
+      RegCloseKey(registry_key);
+      registry_event = NULL;
+    }
+    return 1;
+# elif defined __linux__
+    char buffer[1024];
+    int changed = 0;
+    if (registry_notify < 0) {
+      registry_notify = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+      if (registry_notify < 0)
+        return 1;
+      if (inotify_add_watch(registry_notify, "/dev", IN_CREATE | IN_DELETE) < 0) {
+        close(registry_notify);
+        registry_notify = -1;
+      }
+      return 1;
+    }
+    while (read(registry_notify, buffer, sizeof buffer) > 0)
+      changed = 1;  /* drain all pending events */
+    return changed;
+# else
+    return 1;
+# endif
+}
+
+/* registry_check() drops all cached results if the devices changed; the
+   registry must be locked */
+static void registry_check(void)
+{
+  if (registry_changed()) {
+    memset(registry, 0, sizeof registry);
+    registry_count = -1;
+  }
+}
+
+/* lookup_bmp() returns the cached result for an interface, or scans for it;
+   the registry must be locked */
+static int lookup_bmp(int seqnr, int iface, TCHAR *name, size_t namelen)
+{
+  PROBEENTRY *entry;
+  int slot;
+  size_t len;
+
+  assert(seqnr >= 0);
+  slot = registry_slot(iface);
+  if (seqnr >= REG_MAXPROBES || slot < 0)
+    return scan_bmp(seqnr, iface, name, namelen);
+
+  entry = &registry[seqnr];
+  if (!entry->known[slot]) {
+    entry->found[slot] = (unsigned char)scan_bmp(seqnr, iface, entry->name[slot], REG_NAMESIZE);
+    entry->known[slot] = 1;
+  }
+  len = 0;
+  if (entry->found[slot]) {
+    while (len < namelen - 1 && entry->name[slot][len] != '\0') {
+      name[len] = entry->name[slot][len];
+      len++;
+    }
+  }
+  name[len] = '\0';
+  return entry->found[slot];
+}
+
+/** find_bmp() scans the system for the Black Magic Probe and a specific
+ *  interface. For a serial interface, it returns the COM port and for the
+ *  trace or DFU interfaces, it returns the GUID (needed to open a WinUSB
+ *  handle on it).
+ *  \param seqnr    [in] The sequence number, must be 0 to find the first
+ *                  connected device, 1 to find the second connected device, and
+ *                  so forth.
+ *  \param iface    [in] The interface number, e,g, BMP_IF_GDB for the GDB
+ *                  server.
+ *  \param name     [out] The COM-port name (or interface GUID) will be copied
+ *                  in this parameter.
+ *  \param namelen  [in] The size of the "name" parameter (in characters).
+ *
+ *  \return 1 on success, 0 on failure.
+ *
+ *  \note The results are cached, until the operating system signals a change
+ *        in the attached devices.
+ */
+int find_bmp(int seqnr, int iface, TCHAR *name, size_t namelen)
+{
+  int result;
+
+  assert(name != NULL);
+  assert(namelen > 0);
+  *name = '\0';
+  if (seqnr < 0)
+    return 0;
+  call_once(&registry_once, registry_init);
+  mtx_lock(&registry_lock);
+  registry_check();
+  result = lookup_bmp(seqnr, iface, name, namelen);
+  mtx_unlock(&registry_lock);
+  return result;
+}
+
+/** find_bmp_serial() looks up the sequence number of a Black Magic Probe with
+ *  the given serial number.
+ *
+ *  \param serial   [in] The serial number, the match is case-insensitive.
+ *
+ *  \return The sequence number of the probe, or -1 if no attached probe has
+ *          that serial number.
+ */
+int find_bmp_serial(const TCHAR *serial)
+{
+  TCHAR match[REG_NAMESIZE];
+  int idx, result;
+
+  assert(serial != NULL);
+  call_once(&registry_once, registry_init);
+  mtx_lock(&registry_lock);
+  registry_check();
+  result = -1;
+  for (idx = 0; result < 0 && lookup_bmp(idx, BMP_IF_SERIAL, match, sizearray(match)); idx++)
+    if (_tcsicmp(match, serial) == 0)
+      result = idx;
+  mtx_unlock(&registry_lock);
+  return result;
+}
+
+/** get_bmp_count() returns the number of detected probes (only probes on the
+ *  USB port are detected). The count is cached, like the results of
+ *  find_bmp().
+ */
 int get_bmp_count(void)
 {
-  int idx;
-  char portname[64];
-  for (idx = 0; find_bmp(idx, BMP_IF_GDB, portname, sizearray(portname)); idx++)
-    {}
-  return idx;
+  TCHAR portname[64];
+
+  call_once(&registry_once, registry_init);
+  mtx_lock(&registry_lock);
+  registry_check();
+  if (registry_count < 0) {
+    for (registry_count = 0; lookup_bmp(registry_count, BMP_IF_GDB, portname, sizearray(portname)); registry_count++)
+      {}
+  }
+  int count = registry_count;
+  mtx_unlock(&registry_lock);
+  return count;
 }
 
 /** check_versionstring() returns the hardware version of the debug probe.
@@ -460,95 +688,222 @@ int check_versionstring(const char *string)
    ctxLink networking code
    -------------------------------------------------------------------------- */
 
+#define SCAN_MAXSOCKETS 256         /* maximum number of simultaneous connection attempts */
+#define SCAN_SOCKETS    256         /* default number of simultaneous connection attempts */
+#define SCAN_TIMEOUT    250         /* default timeout for connection attempts, in ms */
+#define SCAN_MINNETMASK 0xffff0000  /* largest subnet that is scanned (/16) */
 
-typedef struct tagPORTRANGE {
-  const char *base;
-  short start, end;
-  unsigned long mask;
-} PORTRANGE;
 
-static volatile int running_threads = 0;
-static mtx_t running_mutex;
+/* scan_clock() returns a time stamp in milliseconds (for timeouts) */
+static unsigned long scan_clock(void)
+{
+# if defined WIN32 || defined _WIN32
+    return GetTickCount();
+# else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (unsigned long)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+# endif
+}
 
-static int scan_range(void *arg)
+/* scan_connect() starts a connection attempt on a non-blocking socket; it
+   returns the socket, or INVALID_SOCKET if the attempt failed immediately */
+static SOCKET scan_connect(unsigned long host, int *connected)
 {
-  short idx, start, end;
-  const char *base;
-  unsigned long mask = 0, bit = 1;
-
-  assert(arg != NULL);
-  base = ((PORTRANGE*)arg)->base;
-  start = ((PORTRANGE*)arg)->start;
-  end = ((PORTRANGE*)arg)->end;
-  assert(end-start < 8*sizeof(unsigned long));  /* bit mask with matches should be sufficiently big */
-
-  for (idx = start; idx <= end; idx++) {
-    SOCKET sock;
-    char addr[20];
-    sprintf(addr, "%s%d", base, idx);
-    if ((sock = socket(AF_INET , SOCK_STREAM , 0)) == INVALID_SOCKET)
-      break;  // could not create socket, check WSAGetLastError()
-    if (connect_timeout(sock, addr, BMP_PORT_GDB, 250) >= 0)
-      mask |= bit;
-    bit <<= 1;
-    closesocket(sock);
+  struct sockaddr_in address;
+  SOCKET sock;
+  int result;
+
+  assert(connected != NULL);
+  *connected = 0;
+  if ((sock = socket(AF_INET, SOCK_STREAM, 0)) == INVALID_SOCKET)
+    return INVALID_SOCKET;
+# if defined WIN32 || defined _WIN32
+    unsigned long mode = 1;
+    ioctlsocket(sock, FIONBIO, &mode);
+# else
+    fcntl(sock, F_SETFL, O_NONBLOCK);
+# endif
+  memset(&address, 0, sizeof address);
+  address.sin_family = AF_INET;
+  address.sin_addr.s_addr = htonl(host);
+  address.sin_port = htons(BMP_PORT_GDB);
+  result = connect(sock, (struct sockaddr*)&address, sizeof(address));
+  if (result == 0) {
+    *connected = 1;
+  } else {
+#   if defined WIN32 || defined _WIN32
+      int pending = (WSAGetLastError() == WSAEWOULDBLOCK);
+#   else
+      int pending = (errno == EINPROGRESS);
+#   endif
+    if (!pending) {
+      closesocket(sock);
+      sock = INVALID_SOCKET;
+    }
   }
+  return sock;
+}
 
-  ((PORTRANGE*)arg)->mask = mask;
-
-  mtx_lock(&running_mutex);
-  running_threads--;
-  mtx_unlock(&running_mutex);
-  return 0;
+/* scan_result() checks whether a connection attempt that was signalled as
+   ready, succeeded */
+static int scan_result(SOCKET sock)
+{
+  int so_error = -1;
+# if defined WIN32 || defined _WIN32
+    int len = sizeof so_error;
+# else
+    socklen_t len = sizeof so_error;
+# endif
+  getsockopt(sock, SOL_SOCKET, SO_ERROR, (char*)&so_error, &len);
+  return so_error == 0;
 }
 
-int scan_network(unsigned long *addresses, int address_count)
+/* scan_wait() waits for the pending connection attempts in a batch, until all
+   are complete or until the timeout expires; completed attempts are set to
+   INVALID_SOCKET, and their result is stored in "found" */
+static void scan_wait(SOCKET *socks, unsigned char *found, int count, int timeout)
 {
-# define NUM_THREADS 32
-
-  /* check local IP address, replace the last number by a wildcard (i.e., assume
-     that the netmask is 255.255.255.0) */
-  char local_ip[30], *ptr;
-  unsigned long local_ip_addr = getlocalip(local_ip);
-  if ((ptr = strrchr(local_ip, '.')) != NULL)
-    *(ptr + 1) = '\0';
-
-  int range = (254-1+NUM_THREADS/2) / NUM_THREADS;
-  PORTRANGE pr[NUM_THREADS];
-  for (int idx=0; idx<NUM_THREADS; idx++) {
-    pr[idx].base = local_ip;
-    pr[idx].start = (short)(1 + (idx*range));
-    pr[idx].end = (short)(1 + (idx*range) + (range-1));
+  unsigned long start = scan_clock();
+  int pending, idx;
+
+  for (pending = 0, idx = 0; idx < count; idx++)
+    if (socks[idx] != INVALID_SOCKET)
+      pending++;
+  while (pending > 0) {
+    unsigned long elapsed = scan_clock() - start;
+    if (elapsed >= (unsigned long)timeout)
+      break;
+#   if defined WIN32 || defined _WIN32
+      fd_set wset, eset;
+      struct timeval tv;
+      FD_ZERO(&wset);
+      FD_ZERO(&eset);
+      for (idx = 0; idx < count; idx++) {
+        if (socks[idx] != INVALID_SOCKET) {
+          FD_SET(socks[idx], &wset);
+          FD_SET(socks[idx], &eset);  /* a failed connect is signalled in the exception set */
+        }
+      }
+      tv.tv_sec = (timeout - elapsed) / 1000;
+      tv.tv_usec = ((timeout - elapsed) % 1000) * 1000;
+      if (select(0, NULL, &wset, &eset, &tv) <= 0)
+        break;
+      for (idx = 0; idx < count; idx++) {
+        SOCKET sock = socks[idx];
+        if (sock != INVALID_SOCKET && (FD_ISSET(sock, &wset) || FD_ISSET(sock, &eset))) {
+          found[idx] = (unsigned char)(FD_ISSET(sock, &wset) && scan_result(sock));
+          closesocket(sock);
+          socks[idx] = INVALID_SOCKET;
+          pending--;
+        }
+      }
+#   else
+      struct pollfd fds[SCAN_MAXSOCKETS];
+      int map[SCAN_MAXSOCKETS], num = 0;
+      for (idx = 0; idx < count; idx++) {
+        if (socks[idx] != INVALID_SOCKET) {
+          fds[num].fd = socks[idx];
+          fds[num].events = POLLOUT;
+          fds[num].revents = 0;
+          map[num++] = idx;
+        }
+      }
+      if (poll(fds, num, (int)(timeout - elapsed)) <= 0)
+        break;
+      for (int i = 0; i < num; i++) {
+        if (fds[i].revents != 0) {
+          idx = map[i];
+          found[idx] = (unsigned char)((fds[i].revents & (POLLERR | POLLHUP)) == 0 && scan_result(socks[idx]));
+          closesocket(socks[idx]);
+          socks[idx] = INVALID_SOCKET;
+          pending--;
+        }
+      }
+#   endif
   }
-  pr[NUM_THREADS-1].end = 254;
-
-  /* create threads to scan the network and wait for all these threads to
-     finish */
-  mtx_init(&running_mutex, mtx_plain);
-  thrd_t hThread[NUM_THREADS];
-  for (int idx=0; idx<NUM_THREADS; idx++) {
-    if (thrd_create(&hThread[idx], scan_range, &pr[idx]) == thrd_success) {
-      mtx_lock(&running_mutex);
-      running_threads++;
-      mtx_unlock(&running_mutex);
-      thrd_detach(hThread[idx]);
+
+  /* drop the attempts that timed out */
+  for (idx = 0; idx < count; idx++) {
+    if (socks[idx] != INVALID_SOCKET) {
+      closesocket(socks[idx]);
+      socks[idx] = INVALID_SOCKET;
     }
   }
-  while (running_threads > 0)
-    thrd_yield();
+}
+
+/** scan_network_batch() scans the local network for gdbservers (on the TCP/IP
+ *  port for GDB). It starts up to "sockets" connection attempts at the same
+ *  time, and waits for these with a single timeout.
+ *
+ *  \param addresses      [out] The IP addresses of the gdbservers that were
+ *                        found, in network byte order.
+ *  \param address_count  The maximum number of addresses to store.
+ *  \param sockets        The number of connection attempts that may be pending
+ *                        at the same time. This value is clamped to
+ *                        SCAN_MAXSOCKETS.
+ *  \param timeout        The time to wait for each group of connection
+ *                        attempts, in milliseconds.
+ *
+ *  \return The number of gdbservers found.
+ *
+ *  \note The range of addresses is taken from the netmask of the local network
+ *        interface, but it is limited to a /16 subnet.
+ */
+int scan_network_batch(unsigned long *addresses, int address_count, int sockets, int timeout)
+{
+  char local_ip[30];
+  unsigned long netmask;
+  unsigned long local_ip_addr = getlocalnet(local_ip, &netmask);
+  if (local_ip_addr == INADDR_NONE)
+    return 0;
+
+  /* get the range of host addresses in the subnet (in host byte order) */
+  unsigned long host = ntohl(local_ip_addr);
+  unsigned long mask = ntohl(netmask) & 0xffffffffUL;
+  if (mask < SCAN_MINNETMASK)
+    mask = SCAN_MINNETMASK;
+  if ((~mask & 0xffffffffUL) < 2)
+    return 0;   /* a /31 or /32 network has no other hosts */
+  unsigned long first = (host & mask) + 1;
+  unsigned long last = (host | ~mask) & 0xffffffffUL;
+  last -= 1;    /* skip the broadcast address */
+
+  if (sockets > SCAN_MAXSOCKETS)
+    sockets = SCAN_MAXSOCKETS;
+  if (sockets < 1)
+    sockets = 1;
 
-  /* construct the list of matching addresses */
   assert(addresses != NULL && address_count > 0);
+  SOCKET socks[SCAN_MAXSOCKETS];
+  unsigned char found[SCAN_MAXSOCKETS];
   int count = 0;
-  for (int idx=0; idx<NUM_THREADS; idx++) {
-    unsigned long bit = 1;
-    for (short j = pr[idx].start; j <= pr[idx].end; j++) {
-      if (count < address_count && (pr[idx].mask & bit) != 0)
-        addresses[count++] = (local_ip_addr & 0xffffff) | (j << 24);
-      bit <<= 1;
+  for (unsigned long base = first; base <= last && count < address_count; base += sockets) {
+    int num = (last - base + 1 < (unsigned long)sockets) ? (int)(last - base + 1) : sockets;
+    for (int idx = 0; idx < num; idx++) {
+      int connected;
+      socks[idx] = scan_connect(base + idx, &connected);
+      found[idx] = (unsigned char)connected;
+      if (connected) {
+        closesocket(socks[idx]);
+        socks[idx] = INVALID_SOCKET;
+      }
     }
+    scan_wait(socks, found, num, timeout);
+    for (int idx = 0; idx < num && count < address_count; idx++)
+      if (found[idx])
+        addresses[count++] = htonl(base + idx);
   }
 
   return count;
 }
 
+/** scan_network() scans the local network for gdbservers, with default
+ *  settings for the number of simultaneous connection attempts and the
+ *  timeout. See scan_network_batch().
+ */
+int scan_network(unsigned long *addresses, int address_count)
+{
+  return scan_network_batch(addresses, address_count, SCAN_SOCKETS, SCAN_TIMEOUT);
+}
+
@@ -57,6 +57,14 @@ enum {
   int find_bmp(int seqnr, int iface, char *name, size_t namelen);
 #endif
 
+/* find_bmp_serial() returns the sequence number of the probe with the given
+   serial number, or -1 if it is not found */
+#if defined WIN32 || defined _WIN32
+  int find_bmp_serial(const TCHAR *serial);
+#else
+  int find_bmp_serial(const char *serial);
+#endif
+
 /* get_bmp_count() returns the number of detected probes (only probes on the
    USB port are detected) */
 int get_bmp_count(void);
@@ -66,8 +74,11 @@ int get_bmp_count(void);
    "monitor version" command */
 int check_versionstring(const char *string);
 
-/* scan_network() scans the network for TCP/IP connected gdbservers */
+/* scan_network() scans the network for TCP/IP connected gdbservers;
+   scan_network_batch() does the same, but with a configurable number of
+   simultaneous connection attempts, and timeout (in ms) */
 int scan_network(unsigned long *addresses, int address_count);
+int scan_network_batch(unsigned long *addresses, int address_count, int sockets, int timeout);
 
 #if defined __cplusplus
   }
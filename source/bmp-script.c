@@ -79,7 +79,7 @@ typedef struct tagSCRIPTLINE {  /* interpreted script instruction */
 } SCRIPTLINE;
 
 typedef struct tagSCRIPT {
-  struct tagSCRIPT *next;
+  struct tagSCRIPT *next;   /* next script in the same hash bucket */
   const char *name;
   const SCRIPTLINE *lines;
   size_t count;     /* number of lines in the lines array */
@@ -139,6 +139,9 @@ static const REG_DEF register_defaults[] = {
 
   { "DWT_CTRL",             0xE0001000, 4, "*" },   /**< Control Register */
   { "DWT_CYCCNT",           0xE0001004, 4, "*" },   /**< Cycle Count Register */
+  { "DWT_COMP3",            0xE0001050, 4, "*" },   /**< Comparator Register 3 */
+  { "DWT_MASK3",            0xE0001054, 4, "*" },   /**< Comparator Mask Register 3 */
+  { "DWT_FUNCTION3",        0xE0001058, 4, "*" },   /**< Comparator Function Register 3 */
 
   { "ITM_TER",              0xE0000E00, 4, "*" },   /**< Trace Enable Register */
   { "ITM_TPR",              0xE0000E40, 4, "*" },   /**< Trace Privilege Register */
@@ -241,6 +244,28 @@ static const SCRIPT_DEF script_defaults[] = {
     "DWT_CTRL = $2<<1 | 0x1201 \n"  /* PCSAMPLENA (1 << 12) | CYCTAP (1 << 9) | POSTPRESET=15 (n << 1) | CYCCNTENA (1 << 0) */
   },
 
+  /* swo_profile_rate (generic), changes the sampling interval; PC sampling
+     is disabled while POSTPRESET and CYCTAP are changed
+     $0 = new DWT_CTRL value, with PCSAMPLENA and CYCCNTENA set */
+  { "swo_profile_rate", "*",
+    "DWT_CTRL = 0x1 \n"        /* CYCCNTENA only */
+    "DWT_CTRL = $0 \n"
+  },
+
+  /* swo_datawatch (ARMv7-M), uses the last DWT comparator, so that the
+     comparators for hardware watchpoints remain available
+     $0 = memory address of the variable
+     $1 = function: 0 = disabled, 2 = data value trace (on read & write) */
+  { "swo_datawatch", "*",
+    "SCB_DEMCR |= 0x1000000 \n" /* TRCENA (1 << 24) */
+    "ITM_LAR = 0xC5ACCE55 \n"   /* unlock access to ITM registers */
+    "ITM_TCR |= 0x08 \n"        /* DWTENA (1 << 3) */
+    "DWT_FUNCTION3 = 0 \n"      /* disable comparator while changing it */
+    "DWT_COMP3 = $0 \n"
+    "DWT_MASK3 = 0 \n"          /* match the address exactly */
+    "DWT_FUNCTION3 = $1 \n"
+  },
+
   /* swo_close (generic) */
   { "swo_close", "*",
     "SCB_DEMCR = 0 \n"
@@ -260,7 +285,12 @@ static const SCRIPT_DEF script_defaults[] = {
 };
 
 
-static SCRIPT script_root = { NULL, NULL, NULL, 0 };
+#define SCRIPT_HASHSIZE 32     /* number of buckets in the script index, must be a power of 2 */
+
+static SCRIPT *script_index[SCRIPT_HASHSIZE];
+static unsigned script_count = 0;
+static char *script_mcu = NULL;   /* MCU family that the scripts are loaded for */
+static char *script_arch = NULL;  /* architecture that the scripts are loaded for */
 static REG_CACHE cache = { NULL, NULL, 0, 0 };
 
 
@@ -363,6 +393,54 @@ static bool mcu_match(const char *mcufamily, const char *list)
   return false;
 }
 
+/* script_hash() returns the bucket in the script index for a script name; the
+   hash is case-insensitive, because script names are compared with stricmp() */
+static unsigned script_hash(const char *name)
+{
+  unsigned hash = 5381;
+  assert(name != NULL);
+  while (*name != '\0')
+    hash = hash * 33 + (unsigned)toupper((unsigned char)*name++);
+  return hash & (SCRIPT_HASHSIZE - 1);
+}
+
+/* script_add() copies the lines of a parsed script and adds the script to the
+   index; it is inserted in front of any script with the same name, so that
+   scripts that are added later overrule earlier ones */
+static void script_add(const char *name, const SCRIPTLINE *lines, size_t count)
+{
+  SCRIPT *script = (SCRIPT*)malloc(sizeof(SCRIPT));
+  if (script == NULL)
+    return;
+  script->name = strdup(name);
+  if (script->name == NULL) {
+    free(script);
+    return;
+  }
+  script->lines = NULL;
+  if (count > 0) {
+    script->lines = (SCRIPTLINE*)malloc(count * sizeof(SCRIPTLINE));
+    if (script->lines != NULL)
+      memcpy((void*)script->lines, lines, count * sizeof(SCRIPTLINE));
+    else
+      count = 0;
+  }
+  script->count = count;
+  unsigned bucket = script_hash(name);
+  script->next = script_index[bucket];
+  script_index[bucket] = script;
+  script_count += 1;
+}
+
+/* script_find() looks up a script by name in the index */
+static const SCRIPT *script_find(const char *name)
+{
+  const SCRIPT *script;
+  for (script = script_index[script_hash(name)]; script != NULL && stricmp(name, script->name) != 0; script = script->next)
+    {}
+  return script;
+}
+
 /** parseline() parses a script line, substituting registers and variable
  *  definitions.
  *
@@ -510,7 +588,9 @@ static const char *parseline(const char *line, const REG_DEF *registers, size_t
  *  support file. This way, additional scripts can be created (for new
  *  micro-controllers) and existing scripts can be overruled.
  *
- *  Scripts can be matched on MCU family name, or on architecture name.
+ *  Scripts can be matched on MCU family name, or on architecture name. The
+ *  scripts are matched and parsed only once: when called again for the same
+ *  MCU family and architecture, the function returns immediately.
  *
  *  \param mcu    The MCU family name. This parameter must be valid.
  *  \param arch   The Cortex architecture name (M0, M3, etc.). This parameter
@@ -522,16 +602,14 @@ int bmscript_load(const char *mcu, const char *arch)
 {
   assert(mcu != NULL);
 
-  /* the name in the root is set to the MCU name, to detect double loading of
-     the same script */
+  /* the MCU name and architecture are kept, to detect double loading of the
+     same scripts */
   unsigned idx;
-  SCRIPT *script;
-  if (script_root.name != NULL && strcmp(script_root.name, mcu) == 0) {
-    idx = 0;
-    for (script = script_root.next; script != NULL; script = script->next)
-      idx++;
-    return idx;
-  }
+  if (arch == NULL)
+    arch = "";
+  if (script_mcu != NULL && strcmp(script_mcu, mcu) == 0
+      && script_arch != NULL && strcmp(script_arch, arch) == 0)
+    return script_count;
   bmscript_clear();  /* unload any scripts loaded at this point */
 
   char path[_MAX_PATH];
@@ -631,7 +709,7 @@ int bmscript_load(const char *mcu, const char *arch)
   }
 
   char arch_name[50] = "";
-  if (arch != NULL && strlen(arch) > 0) {
+  if (strlen(arch) > 0) {
     assert(strlen(arch) < sizearray(arch_name) - 2);
     sprintf(arch_name, "[%s]", arch);
   }
@@ -664,23 +742,7 @@ int bmscript_load(const char *mcu, const char *arch)
           line_count += 1;
         }
       }
-      /* add the script to the list */
-      if ((script = (SCRIPT*)malloc(sizeof(SCRIPT))) != NULL) {
-        script->name = strdup(script_defaults[idx].name);
-        if (script->name != NULL) {
-          script->lines = NULL;
-          if (line_count > 0) {
-            script->lines = (SCRIPTLINE*)malloc(line_count * sizeof(SCRIPTLINE));
-            if (script->lines != NULL)
-              memcpy((void*)script->lines, lines, line_count * sizeof(SCRIPTLINE));
-            else
-              line_count = 0;
-          }
-          script->count = line_count;
-          script->next = script_root.next;
-          script_root.next = script;
-        }
-      }
+      script_add(script_defaults[idx].name, lines, line_count);
     }
   }
 
@@ -704,24 +766,9 @@ int bmscript_load(const char *mcu, const char *arch)
         inscript = 1;
         line_count = 0;
       } else if (inscript && strncmp(line, "end", 3) == 0 && line[3] <= ' ') {
-        /* end script (add it to the front of the list, so that scripts from the
-           file overrule the hard-coded scripts) */
-        if ((script = (SCRIPT*)malloc(sizeof(SCRIPT))) != NULL) {
-          script->name = strdup(scriptname);
-          if (script->name != NULL) {
-            script->lines = NULL;
-            if (line_count > 0) {
-              script->lines = (SCRIPTLINE*)malloc(line_count * sizeof(SCRIPTLINE));
-              if (script->lines != NULL)
-                memcpy((void*)script->lines, lines, line_count * sizeof(SCRIPTLINE));
-              else
-                line_count = 0;
-            }
-            script->count = line_count;
-            script->next = script_root.next;
-            script_root.next = script;
-          }
-        }
+        /* end script (scripts from the file are added after the hard-coded
+           scripts, so that they overrule these) */
+        script_add(scriptname, lines, line_count);
         inscript = 0;
       } else if (inscript) {
         /* add line to script, make space for a new entry in the line list */
@@ -757,29 +804,34 @@ int bmscript_load(const char *mcu, const char *arch)
   /* free the temporary lines list */
   free((void*)lines);
 
-  /* count the scripts, for the return value */
-  idx = 0;
-  for (script = script_root.next; script != NULL; script = script->next)
-    idx++;
-  return idx;
+  script_mcu = strdup(mcu);
+  script_arch = strdup(arch);
+  return script_count;
 }
 
 void bmscript_clear(void)
 {
   bmscript_clearcache();
-  while (script_root.next != NULL) {
-    SCRIPT *script = script_root.next;
-    script_root.next = script->next;
-    assert(script->name != NULL); /* the script is not added to the list if any pointers are invalid */
-    free((void*)script->name);
-    assert((script->count == 0 && script->lines == NULL) || (script->count > 0 && script->lines != NULL));
-    if (script->count >0)
-      free((void*)script->lines);
-    free(script);
+  for (unsigned bucket = 0; bucket < SCRIPT_HASHSIZE; bucket++) {
+    while (script_index[bucket] != NULL) {
+      SCRIPT *script = script_index[bucket];
+      script_index[bucket] = script->next;
+      assert(script->name != NULL); /* the script is not added to the index if any pointers are invalid */
+      free((void*)script->name);
+      assert((script->count == 0 && script->lines == NULL) || (script->count > 0 && script->lines != NULL));
+      if (script->count >0)
+        free((void*)script->lines);
+      free(script);
+    }
+  }
+  script_count = 0;
+  if (script_mcu != NULL) {
+    free(script_mcu);
+    script_mcu = NULL;
   }
-  if (script_root.name != NULL) {
-    free((void*)script_root.name);
-    script_root.name = NULL;
+  if (script_arch != NULL) {
+    free(script_arch);
+    script_arch = NULL;
   }
 }
 
@@ -833,11 +885,8 @@ bool bmscript_line(const char *name, uint16_t *oper, OPERAND *lvalue, OPERAND *r
   assert(name != NULL);
   assert(oper != NULL && lvalue != NULL && rvalue != NULL);
 
-  if (cache.name == NULL || strcmp(name, cache.name) != 0) {
-    const SCRIPT *script;
-    /* find a script with the given name */
-    for (script = script_root.next; script != NULL && stricmp(name, script->name) != 0; script = script->next)
-      {}
+  if (cache.name == NULL || stricmp(name, cache.name) != 0) {
+    const SCRIPT *script = script_find(name);
     if (script == NULL)
       return false;     /* no script with matching name is found */
 
@@ -25,6 +25,7 @@
 #else
 # include <unistd.h>
 # include <bsd/string.h>
+# include <sys/time.h>
 #endif
 #include <assert.h>
 #include <ctype.h>
@@ -37,6 +38,7 @@
 #include "bmp-scan.h"
 #include "bmp-script.h"
 #include "bmp-support.h"
+#include "c11threads.h"
 #include "crc32.h"
 #include "elf.h"
 #include "gdb-rsp.h"
@@ -55,6 +57,17 @@
 #  define sizearray(e)    (sizeof(e) / sizeof((e)[0]))
 #endif
 
+#define FLASH_WINDOW_MAX  16  /* max. vFlashWrite packets in flight */
+#define FLASH_WINDOW_USB  4   /* default number of packets in flight, USB */
+#define FLASH_WINDOW_TCP  8   /* default, TCP/IP (higher latency) */
+
+enum {
+  JOB_ERASE,
+  JOB_WRITE,
+  JOB_DONE,
+  JOB_CRC,
+};
+
 
 typedef struct tagMEMBLOCK {
   struct tagMEMBLOCK *next;
@@ -63,14 +76,105 @@ typedef struct tagMEMBLOCK {
   unsigned int blocksize; /* Flash sector size */
 } MEMBLOCK;
 
-static HCOM *hCom = NULL;
-static int CurrentProbe = -1;
-static int PacketSize = 0;
-static MEMBLOCK FlashRegions = { NULL };
+typedef struct tagIMGPACKET {
+  unsigned long address;  /* Flash address of the data in the packet */
+  size_t offset;          /* offset of the frame in the frame buffer */
+  unsigned framesize;     /* size of the encoded frame */
+  unsigned numbytes;      /* size of the (decoded) data in the packet */
+} IMGPACKET;
+
+typedef struct tagPACKETLIST {
+  unsigned char *frames;  /* encoded vFlashWrite packets, back to back */
+  size_t framesize;       /* used size of the frame buffer */
+  size_t framemax;        /* allocated size of the frame buffer */
+  IMGPACKET *packets;
+  unsigned count;
+  unsigned max;
+} PACKETLIST;
+
+typedef struct tagFLASHJOB {
+  int type;               /* JOB_xxx */
+  unsigned long address;
+  unsigned long size;
+  unsigned value;         /* packet index (JOB_WRITE) or expected CRC (JOB_CRC) */
+} FLASHJOB;
+
+typedef struct tagJOBLIST {
+  FLASHJOB *jobs;
+  unsigned count;
+  unsigned max;
+} JOBLIST;
+
+typedef struct tagIMGSPAN {
+  unsigned long address;
+  unsigned long size;
+} IMGSPAN;
+
+typedef struct tagIMGSEGMENT {
+  int index;              /* segment index in the ELF file */
+  int source;             /* input file (0 = the ELF file the image was created from) */
+  unsigned long fileoffs; /* offset of the segment data in the ELF file */
+  unsigned long address;  /* physical address */
+  unsigned long size;
+  bool isdata;            /* initialized data (copied to RAM), instead of code */
+  unsigned char *data;
+  unsigned crc;
+} IMGSEGMENT;
+
+typedef struct tagIMGREGION {
+  struct tagIMGREGION *next;
+  unsigned long address;  /* start address of the Flash region */
+  unsigned long rgnsize;  /* size of the Flash region */
+  unsigned int blocksize; /* Flash sector size */
+  unsigned long size;     /* size of the image (a multiple of the sector size) */
+  unsigned long loaded;   /* number of bytes of segment data in the region */
+  unsigned char *data;    /* image of the region, gaps are 0xff */
+  unsigned *blockcrc;     /* CRC of every sector */
+  IMGSPAN *spans;         /* merged address ranges of the segments */
+  unsigned spancount;
+  PACKETLIST packets;     /* encoded packets for all spans */
+} IMGREGION;
+
+struct tagBMP_IMAGE {
+  IMGSEGMENT *segments;
+  int segmentcount;
+  int sourcecount;        /* number of input files */
+  IMGREGION regions;      /* root of the list, prepared for the packet size below */
+  int pktsize;
+  bool verified;          /* whether the most recent download was verified */
+};
+
+struct tagBMP_CONTEXT {
+  HCOM *hCom;
+  int CurrentProbe;
+  int PacketSize;
+  MEMBLOCK FlashRegions;
+  bool NoAckMode;
+  bool BinaryUpload;              /* probe supports "x" (binary memory read) */
+  bool Replaying;                 /* connected to a replayed session */
+  unsigned long FlashBytes;       /* bytes written in the current download */
+  unsigned long EraseBytes;       /* bytes erased with range erase commands */
+  unsigned long EraseTime;        /* time taken by these erase commands (ms) */
+  bool FlashBlank;                /* all Flash erased, nothing written yet */
+  unsigned long download_numsteps;
+  unsigned long download_step;
+  GDBRSP_CONTEXT *rsp;            /* NULL for the default context */
+};
+
+static BMP_CONTEXT default_context = { NULL, -1, 0, { NULL }, false, false, false, 0, 0, 0, false, 0, 0, NULL };
+static thread_local BMP_CONTEXT *current_context = NULL;
+static int FlashWindowUSB = 0;      /* 0 = default */
+static int FlashWindowTCP = 0;
+static bool FlashOverlap = true;
 
 static BMP_STATCALLBACK stat_callback = NULL;
 
 
+static inline BMP_CONTEXT *context(void)
+{
+  return (current_context != NULL) ? current_context : &default_context;
+}
+
 static int notice(int code, const char *fmt, ...)
 {
   if (stat_callback != NULL) {
@@ -96,17 +200,46 @@ static void memblock_cleanup(MEMBLOCK *root)
 
 void bmp_flash_cleanup(void)
 {
-  memblock_cleanup(&FlashRegions);
+  BMP_CONTEXT *bmp = context();
+  memblock_cleanup(&bmp->FlashRegions);
 }
 
 unsigned long bmp_flashtotal(void)
 {
+  BMP_CONTEXT *bmp = context();
   long total = 0;
-  for (const MEMBLOCK *rgn = FlashRegions.next; rgn != NULL; rgn = rgn->next)
+  for (const MEMBLOCK *rgn = bmp->FlashRegions.next; rgn != NULL; rgn = rgn->next)
     total += rgn->size;
   return total;
 }
 
+/** bmp_flashregion() returns the address range and sector size of a Flash
+ *  region of the target, as reported by the gdbserver on bmp_attach().
+ *
+ *  \param index       The sequence number of the region, starting at 0.
+ *  \param address     [out] The base address of the region, may be NULL.
+ *  \param size        [out] The size of the region in bytes, may be NULL.
+ *  \param blocksize   [out] The sector size, may be NULL.
+ *
+ *  \return true on success, false if there is no region with this index.
+ */
+bool bmp_flashregion(int index, unsigned long *address, unsigned long *size, unsigned *blocksize)
+{
+  BMP_CONTEXT *bmp = context();
+  const MEMBLOCK *rgn;
+  for (rgn = bmp->FlashRegions.next; rgn != NULL && index > 0; rgn = rgn->next)
+    index--;
+  if (rgn == NULL)
+    return false;
+  if (address != NULL)
+    *address = rgn->address;
+  if (size != NULL)
+    *size = rgn->size;
+  if (blocksize != NULL)
+    *blocksize = rgn->blocksize;
+  return true;
+}
+
 /** bmp_setcallback() sets the callback function for detailed status
  *  messages. The callback receives status codes as well as a text message.
  *  All error codes are negative.
@@ -116,6 +249,55 @@ void bmp_setcallback(BMP_STATCALLBACK func)
   stat_callback = func;
 }
 
+/** bmp_context_create() allocates a context for a connection to a probe. All
+ *  functions in this module work on the context that is selected for the
+ *  calling thread; threads that have not selected a context share a default
+ *  context. Multiple probes can thus be driven in parallel, from separate
+ *  threads that each select a context of their own.
+ *
+ *  \return The new context, or NULL on failure.
+ *
+ *  \note Only connections via USB can run in parallel, there is a single
+ *        TCP/IP connection.
+ */
+BMP_CONTEXT *bmp_context_create(void)
+{
+  BMP_CONTEXT *ctx = malloc(sizeof(BMP_CONTEXT));
+  if (ctx == NULL)
+    return NULL;
+  memset(ctx, 0, sizeof(BMP_CONTEXT));
+  ctx->CurrentProbe = -1;
+  ctx->rsp = gdbrsp_context_create();
+  if (ctx->rsp == NULL) {
+    free(ctx);
+    return NULL;
+  }
+  return ctx;
+}
+
+/** bmp_context_delete() closes the connection of the context, if it is still
+ *  open, and frees it. The context may not be selected in any thread.
+ */
+void bmp_context_delete(BMP_CONTEXT *ctx)
+{
+  assert(ctx != NULL && ctx != current_context);
+  if (rs232_isopen(ctx->hCom))
+    rs232_close(ctx->hCom);
+  memblock_cleanup(&ctx->FlashRegions);
+  gdbrsp_context_delete(ctx->rsp);
+  free(ctx);
+}
+
+/** bmp_context_select() selects a context for the calling thread (this also
+ *  selects the matching context for the GDB-RSP layer). Pass NULL to return to
+ *  the default context.
+ */
+void bmp_context_select(BMP_CONTEXT *ctx)
+{
+  current_context = ctx;
+  gdbrsp_context_select((ctx != NULL) ? ctx->rsp : NULL);
+}
+
 /** bmp_connect() scans for the USB port of the Black Magic Probe and connects
  *  to it. It can also connect to a gdbserver via TCP/IP; in this case, the IP
  *  address must be passed, and the scanning phase is skipped.
@@ -132,72 +314,100 @@ void bmp_setcallback(BMP_STATCALLBACK func)
  *  \return true on success, false on failure. Status and error messages are
  *          passed via the callback.
  */
+/* handshake() checks that the gdbserver on a (virtual) serial port responds;
+   the port is closed by the caller on failure */
+static bool handshake(BMP_CONTEXT *bmp, const char *devname)
+{
+  char buffer[512];
+  size_t size;
+
+  /* check for reception of the handshake */
+  size = gdbrsp_recv(buffer, sizearray(buffer), 250);
+  if (size == 0) {
+    /* toggle DTR, to be sure */
+    if (rs232_isopen(bmp->hCom)) {
+      rs232_setstatus(bmp->hCom, LINESTAT_RTS, 0);
+      rs232_setstatus(bmp->hCom, LINESTAT_DTR, 0);
+#     if defined _WIN32
+        Sleep(200);
+#     else
+        usleep(200 * 1000);
+#     endif
+      rs232_setstatus(bmp->hCom, LINESTAT_RTS, 0);
+      rs232_setstatus(bmp->hCom, LINESTAT_DTR, 1);
+    }
+    size = gdbrsp_recv(buffer, sizearray(buffer), 250);
+  }
+  if (size != 2 || memcmp(buffer, "OK", size)!= 0) {
+    /* send "monitor version" command to check for a response (ignore the
+       text of the response, only check for the "OK" end code) */
+    if (rs232_isopen(bmp->hCom))
+      rs232_flush(bmp->hCom);
+    gdbrsp_xmit("qRcmd,version", -1);
+    do {
+      size=gdbrsp_recv(buffer, sizearray(buffer)-1, 250);
+    } while (size > 0 && size != 2);
+    if (size != 2 || memcmp(buffer, "OK", size)!= 0) {
+      notice(BMPERR_NORESPONSE, "No response on %s", devname);
+      return false;
+    }
+  }
+  return true;
+}
+
 bool bmp_connect(int probe, const char *ipaddress)
 {
+  BMP_CONTEXT *bmp = context();
   char devname[128], probename[64];
   bool initialize = false;
 
   /* if switching between probes, reconnect (so close the current connection) */
-  if ((probe != CurrentProbe && ipaddress == NULL) || (CurrentProbe >= 0 && ipaddress != NULL)) {
+  if ((probe != bmp->CurrentProbe && ipaddress == NULL) || (bmp->CurrentProbe >= 0 && ipaddress != NULL)) {
     bmp_disconnect();
-    CurrentProbe = (ipaddress == NULL) ? probe : -1;
+    bmp->CurrentProbe = (ipaddress == NULL) ? probe : -1;
   }
 
-  if (CurrentProbe >= 0) {
+  if (bmp->CurrentProbe >= 0) {
     strlcpy(probename, "Black Magic Probe", sizearray(probename));
   } else {
     strlcpy(probename, "ctxLink", sizearray(probename));
     strlcpy(devname, ipaddress, sizearray(devname));
   }
 
-  if (CurrentProbe >= 0 && !rs232_isopen(hCom)) {
+  if (gdbrsp_replaying()) {
+    /* a recorded session is replayed instead of using a probe; the recording
+       holds the handshake (for USB) and the initialization */
+    if (!bmp->Replaying) {
+      strlcpy(devname, "replay", sizearray(devname));
+      bmp_flash_cleanup();
+      bmp->Replaying = true;
+      if (ipaddress == NULL && !handshake(bmp, devname)) {
+        bmp->Replaying = false;
+        return false;
+      }
+      initialize = true;
+    }
+  } else if (bmp->CurrentProbe >= 0 && !rs232_isopen(bmp->hCom)) {
     /* serial port is selected, and it is currently not open */
     bmp_flash_cleanup();
     if (find_bmp(probe, BMP_IF_GDB, devname, sizearray(devname))) {
-      char buffer[512];
-      size_t size;
       /* connect to the port */
-      hCom = rs232_open(devname, 115200, 8, 1, PAR_NONE, FLOWCTRL_NONE);
-      if (!rs232_isopen(hCom)) {
+      bmp->hCom = rs232_open(devname, 115200, 8, 1, PAR_NONE, FLOWCTRL_NONE);
+      if (!rs232_isopen(bmp->hCom)) {
         notice(BMPERR_PORTACCESS, "Failure opening port %s", devname);
         return false;
       }
-      rs232_setstatus(hCom, LINESTAT_RTS, 1);
-      rs232_setstatus(hCom, LINESTAT_DTR, 1); /* required by GDB RSP */
-      /* check for reception of the handshake */
-      size = gdbrsp_recv(buffer, sizearray(buffer), 250);
-      if (size == 0) {
-        /* toggle DTR, to be sure */
-        rs232_setstatus(hCom, LINESTAT_RTS, 0);
-        rs232_setstatus(hCom, LINESTAT_DTR, 0);
-#       if defined _WIN32
-          Sleep(200);
-#       else
-          usleep(200 * 1000);
-#       endif
-        rs232_setstatus(hCom, LINESTAT_RTS, 0);
-        rs232_setstatus(hCom, LINESTAT_DTR, 1);
-        size = gdbrsp_recv(buffer, sizearray(buffer), 250);
-      }
-      if (size != 2 || memcmp(buffer, "OK", size)!= 0) {
-        /* send "monitor version" command to check for a response (ignore the
-           text of the response, only check for the "OK" end code) */
-        rs232_flush(hCom);
-        gdbrsp_xmit("qRcmd,version", -1);
-        do {
-          size=gdbrsp_recv(buffer, sizearray(buffer)-1, 250);
-        } while (size > 0 && size != 2);
-        if (size != 2 || memcmp(buffer, "OK", size)!= 0) {
-          notice(BMPERR_NORESPONSE, "No response on %s", devname);
-          hCom = rs232_close(hCom);
-          return false;
-        }
+      rs232_setstatus(bmp->hCom, LINESTAT_RTS, 1);
+      rs232_setstatus(bmp->hCom, LINESTAT_DTR, 1); /* required by GDB RSP */
+      if (!handshake(bmp, devname)) {
+        bmp->hCom = rs232_close(bmp->hCom);
+        return false;
       }
       initialize = true;
     }
   }
 
-  if (CurrentProbe < 0 && ipaddress != NULL && !tcpip_isopen()) {
+  if (!bmp->Replaying && bmp->CurrentProbe < 0 && ipaddress != NULL && !tcpip_isopen()) {
     /* network interface is selected, and it is currently not open */
     tcpip_open(ipaddress);
     if (!tcpip_isopen()) {
@@ -208,7 +418,9 @@ bool bmp_connect(int probe, const char *ipaddress)
   }
 
   /* check whether opening the communication interface succeeded */
-  if ((CurrentProbe >= 0 && !rs232_isopen(hCom)) || (CurrentProbe < 0 && !tcpip_isopen())) {
+  if (!bmp->Replaying
+      && ((bmp->CurrentProbe >= 0 && !rs232_isopen(bmp->hCom)) || (bmp->CurrentProbe < 0 && !tcpip_isopen())))
+  {
     /* initialization failed */
     notice(BMPERR_NODETECT, "%s not detected", probename);
     return false;
@@ -219,12 +431,23 @@ bool bmp_connect(int probe, const char *ipaddress)
     size_t size;
     int retry;
     /* query parameters */
-    gdbrsp_xmit("qSupported:multiprocess+", -1);
+    gdbrsp_xmit("qSupported:multiprocess+;binary-upload+", -1);
     size = gdbrsp_recv(buffer, sizearray(buffer), 1000);
     buffer[size] = '\0';
     if ((ptr = strstr(buffer, "PacketSize=")) != NULL)
-      PacketSize = (int)strtol(ptr + 11, NULL, 16);
-    gdbrsp_packetsize(PacketSize+16); /* allow for some margin */
+      bmp->PacketSize = (int)strtol(ptr + 11, NULL, 16);
+    gdbrsp_packetsize(bmp->PacketSize+16); /* allow for some margin */
+    bmp->BinaryUpload = (strstr(buffer, "binary-upload+") != NULL);
+    if (strstr(buffer, "QStartNoAckMode+") != NULL) {
+      /* the request and its reply are still acknowledged, no-ack mode starts
+         after the reply */
+      gdbrsp_xmit("QStartNoAckMode", -1);
+      size = gdbrsp_recv(buffer, sizearray(buffer), 1000);
+      if (size == 2 && memcmp(buffer, "OK", size) == 0) {
+        gdbrsp_noack(true);
+        bmp->NoAckMode = true;
+      }
+    }
     //??? check for "qXfer:memory-map:read+" as well
     /* connect to gdbserver */
     for (retry = 3; retry > 0; retry--) {
@@ -256,12 +479,20 @@ bool bmp_connect(int probe, const char *ipaddress)
  */
 bool bmp_disconnect(void)
 {
+  BMP_CONTEXT *bmp = context();
   bool result = false;
 
-  if (rs232_isopen(hCom)) {
-    rs232_setstatus(hCom, LINESTAT_RTS, 0);
-    rs232_setstatus(hCom, LINESTAT_DTR, 0);
-    hCom = rs232_close(hCom);
+  gdbrsp_noack(false);  /* a new connection starts with acknowledgements */
+  bmp->NoAckMode = false;
+  bmp->BinaryUpload = false;
+  if (bmp->Replaying) {
+    bmp->Replaying = false;
+    result = true;
+  }
+  if (rs232_isopen(bmp->hCom)) {
+    rs232_setstatus(bmp->hCom, LINESTAT_RTS, 0);
+    rs232_setstatus(bmp->hCom, LINESTAT_DTR, 0);
+    bmp->hCom = rs232_close(bmp->hCom);
     result = true;
   }
   if (tcpip_isopen()) {
@@ -277,7 +508,8 @@ bool bmp_disconnect(void)
  */
 void bmp_sethandle(HCOM *hcom)
 {
-  hCom = hcom;
+  BMP_CONTEXT *bmp = context();
+  bmp->hCom = hcom;
 }
 
 /** bmp_comport() returns the COM port handle for gdbserver. It returns NULL if
@@ -285,15 +517,18 @@ void bmp_sethandle(HCOM *hcom)
  */
 HCOM *bmp_comport(void)
 {
-  return rs232_isopen(hCom) ? hCom : NULL;
+  BMP_CONTEXT *bmp = context();
+  return rs232_isopen(bmp->hCom) ? bmp->hCom : NULL;
 }
 
 /** bmp_isopen() returns whether a connection to a Black Magic Probe or a
- *  ctxLink is open, via USB (virtual COM port) or TCP/IP.
+ *  ctxLink is open, via USB (virtual COM port) or TCP/IP, or to a replayed
+ *  session (see gdbrsp_replay()).
  */
 bool bmp_isopen(void)
 {
-  return rs232_isopen(hCom) || tcpip_isopen();
+  BMP_CONTEXT *bmp = context();
+  return rs232_isopen(bmp->hCom) || tcpip_isopen() || (bmp->Replaying && gdbrsp_replaying());
 }
 
 /** bmp_is_ip_address() returns 1 if the input string appears to contain a
@@ -337,6 +572,7 @@ int bmp_break(void)
  */
 bool bmp_attach(bool autopower, char *name, size_t namelength, char *arch, size_t archlength)
 {
+  BMP_CONTEXT *bmp = context();
   char buffer[512];
   size_t size;
   int ok;
@@ -345,6 +581,7 @@ bool bmp_attach(bool autopower, char *name, size_t namelength, char *arch, size_
     *name = '\0';
   if (arch != NULL && archlength > 0)
     *arch = '\0';
+  bmp->FlashBlank = false;
 
   if (!bmp_isopen()) {
     notice(BMPERR_ATTACHFAIL, "No connection to debug probe");
@@ -417,7 +654,7 @@ restart:
 
   /* check memory map and features of the target */
   bmp_flash_cleanup();
-  sprintf(buffer, "qXfer:memory-map:read::0,%x", PacketSize - 4);
+  sprintf(buffer, "qXfer:memory-map:read::0,%x", bmp->PacketSize - 4);
   gdbrsp_xmit(buffer, -1);
   size = gdbrsp_recv(buffer, sizearray(buffer), 1000);
   if (size > 10 && buffer[0] == 'm') {
@@ -440,7 +677,7 @@ restart:
                 && attrib->szvalue == 9 && strncmp(attrib->value, "blocksize", attrib->szvalue) == 0)
               rgn->blocksize = strtoul(prop->content, NULL, 0);
             /* append to list, sorted on address */
-            MEMBLOCK *pos = &FlashRegions;
+            MEMBLOCK *pos = &bmp->FlashRegions;
             while (pos->next != NULL && pos->next->address < rgn->address)
               pos = pos->next;
             rgn->next = pos->next;
@@ -723,6 +960,7 @@ int bmp_monitor(const char *command)
 
 int bmp_fullerase(void)
 {
+  BMP_CONTEXT *bmp = context();
   char *cmd;
   int rcvd, pktsize;
 
@@ -734,14 +972,15 @@ int bmp_fullerase(void)
     notice(BMPERR_NOFLASH, "No Flash memory record");
     return 0;
   }
-  pktsize = (PacketSize > 0) ? PacketSize : 64;
+  pktsize = (bmp->PacketSize > 0) ? bmp->PacketSize : 64;
   cmd = malloc((pktsize + 16) * sizeof(char));
   if (cmd == NULL) {
     notice(BMPERR_MEMALLOC, "Memory allocation error");
     return 0;
   }
 
-  for (const MEMBLOCK *rgn = FlashRegions.next; rgn != NULL; rgn = rgn->next) {
+  bool complete = true;
+  for (const MEMBLOCK *rgn = bmp->FlashRegions.next; rgn != NULL; rgn = rgn->next) {
     unsigned long size = rgn->size;
     int failed;
     do {
@@ -757,6 +996,8 @@ int bmp_fullerase(void)
       free(cmd);
       return 0;
     } else {
+      if (size < rgn->size)
+        complete = false;   /* only the first part of the region was erased */
       sprintf(cmd, "Erased Flash at 0x%08x, size %u KiB",
               (unsigned)rgn->address, (unsigned)size / 1024);
       notice(BMPSTAT_SUCCESS, cmd);
@@ -772,262 +1013,1582 @@ int bmp_fullerase(void)
   }
 
   free(cmd);
+  bmp->FlashBlank = complete;
+  return 1;
+}
+
+/** bmp_masserase() erases all Flash memory with the "erase_mass" command of
+ *  the target driver. On some micro-controllers, this is much quicker than
+ *  erasing the sectors (on others, it is slower). If the target driver does
+ *  not have the command, the function falls back on bmp_fullerase().
+ *
+ *  \return 1 on success, 0 on failure.
+ *
+ *  \note After a full erase or a mass erase, the next download skips erasing
+ *        the sectors.
+ */
+int bmp_masserase(void)
+{
+  BMP_CONTEXT *bmp = context();
+  if (!bmp_isopen()) {
+    notice(BMPERR_NOCONNECT, "Not connected to Black Magic Probe");
+    return 0;
+  }
+  const char *monitor_cmds = bmp_get_monitor_cmds();
+  bool supported = (monitor_cmds != NULL && bmp_expand_monitor_cmd(NULL, 0, "erase_mass", monitor_cmds));
+  if (monitor_cmds != NULL)
+    free((void*)monitor_cmds);
+  if (!supported)
+    return bmp_fullerase();
+
+  /* the probe sends console output while the mass erase is in progress, but
+     allow for a long timeout nevertheless */
+  char buffer[256];
+  size_t size;
+  gdbrsp_xmit("qRcmd,erase_mass", -1);
+  do {
+    size = gdbrsp_recv(buffer, sizearray(buffer), 10000);
+  } while (size > 0 && buffer[0] == 'o');
+  if (size != 2 || memcmp(buffer, "OK", size) != 0) {
+    notice(BMPERR_FLASHERASE, "Mass erase failed");
+    return 0;
+  }
+  notice(BMPSTAT_SUCCESS, "Mass erase completed");
+  bmp->FlashBlank = true;
   return 1;
 }
 
-static unsigned long download_numsteps = 0;
-static unsigned long download_step = 0;
+/** bmp_erasestats() returns the number of bytes that were erased with sector
+ *  (range) erase commands since the previous call, and the time that these
+ *  commands took. The counters are reset.
+ *
+ *  \param bytes    [out] The number of bytes erased.
+ *  \param ms       [out] The time needed, in milliseconds.
+ */
+void bmp_erasestats(unsigned long *bytes, unsigned long *ms)
+{
+  BMP_CONTEXT *bmp = context();
+  assert(bytes != NULL && ms != NULL);
+  *bytes = bmp->EraseBytes;
+  *ms = bmp->EraseTime;
+  bmp->EraseBytes = bmp->EraseTime = 0;
+}
+
 void bmp_progress_reset(unsigned long numsteps)
 {
-  download_step = 0;
-  download_numsteps = numsteps;
+  BMP_CONTEXT *bmp = context();
+  bmp->download_step = 0;
+  bmp->download_numsteps = numsteps;
 }
 void bmp_progress_step(unsigned long step)
 {
-  download_step += step;
-  if (download_step > download_numsteps)
-    download_step = download_numsteps;
+  BMP_CONTEXT *bmp = context();
+  bmp->download_step += step;
+  if (bmp->download_step > bmp->download_numsteps)
+    bmp->download_step = bmp->download_numsteps;
 }
 void bmp_progress_get(unsigned long *step, unsigned long *range)
 {
+  BMP_CONTEXT *bmp = context();
   if (step != NULL)
-    *step = download_step;
+    *step = bmp->download_step;
   if (range != NULL)
-    *range = download_numsteps;
+    *range = bmp->download_numsteps;
 }
 
-bool bmp_download(FILE *fp)
+/** bmp_setflashwindow() sets the maximum number of vFlashWrite packets that
+ *  are sent before waiting for the reply on the first, for downloads via USB
+ *  and via TCP/IP respectively. A value of 0 selects the default; a value of 1
+ *  disables pipelining.
+ *
+ *  \note Pipelining is only used when the gdbserver runs in no-ack mode.
+ */
+void bmp_setflashwindow(int usbwindow, int tcpwindow)
 {
-  bmp_progress_reset(0);
-  if (!bmp_isopen()) {
-    notice(BMPERR_NOCONNECT, "Not connected to Black Magic Probe");
-    return false;
-  }
-  if (bmp_flashtotal() == 0) {
-    notice(BMPERR_NOFLASH, "No Flash memory record");
+  FlashWindowUSB = (usbwindow < 0) ? 0 : (usbwindow > FLASH_WINDOW_MAX) ? FLASH_WINDOW_MAX : usbwindow;
+  FlashWindowTCP = (tcpwindow < 0) ? 0 : (tcpwindow > FLASH_WINDOW_MAX) ? FLASH_WINDOW_MAX : tcpwindow;
+}
+
+static int flash_window(void)
+{
+  BMP_CONTEXT *bmp = context();
+  if (bmp_comport() != NULL || (bmp->Replaying && bmp->CurrentProbe >= 0))
+    return (FlashWindowUSB > 0) ? FlashWindowUSB : FLASH_WINDOW_USB;
+  return (FlashWindowTCP > 0) ? FlashWindowTCP : FLASH_WINDOW_TCP;
+}
+
+static unsigned long timestamp(void)
+{
+# if defined _WIN32
+    return GetTickCount();
+# else
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return 1000 * tv.tv_sec + tv.tv_usec / 1000;
+# endif
+}
+
+/* flash_erase() erases a range of Flash memory, the range must be a multiple
+   of the sector size */
+static bool flash_erase(char *cmd, int pktsize, unsigned long address, unsigned long size)
+{
+  BMP_CONTEXT *bmp = context();
+  notice(BMPSTAT_NOTICE, "Erase Flash at 0x%x length 0x%x", (unsigned)address, (unsigned)size);
+  unsigned long tstamp = timestamp();
+  sprintf(cmd, "vFlashErase:%x,%x", (unsigned)address, (unsigned)size);
+  gdbrsp_xmit(cmd, -1);
+  int rcvd = gdbrsp_recv(cmd, pktsize, 500);
+  if (rcvd != 2 || memcmp(cmd, "OK", rcvd)!= 0) {
+    notice(BMPERR_FLASHERASE, "Flash erase failed");
     return false;
   }
-  int pktsize = (PacketSize > 0) ? PacketSize : 64;
-  char *cmd = malloc((pktsize + 16) * sizeof(char));
-  if (cmd == NULL) {
-    notice(BMPERR_MEMALLOC, "Memory allocation error");
-    return false;
+  bmp->EraseBytes += size;
+  bmp->EraseTime += timestamp() - tstamp;
+  return true;
+}
+
+/* sparse_size() returns the number of bytes that flash_sparse_erase() erases
+   in a region */
+static unsigned long sparse_size(const IMGREGION *rgn)
+{
+  assert(rgn != NULL && rgn->blocksize > 0);
+  unsigned long total = 0, runend = 0;
+  for (unsigned span = 0; span < rgn->spancount; span++) {
+    unsigned long low = rgn->spans[span].address - rgn->address;
+    unsigned long high = low + rgn->spans[span].size;
+    low = (low / rgn->blocksize) * rgn->blocksize;
+    high = ((high + rgn->blocksize - 1) / rgn->blocksize) * rgn->blocksize;
+    if (low < runend)
+      low = runend;   /* spans are sorted, skip the part erased already */
+    if (high > low)
+      total += high - low;
+    if (high > runend)
+      runend = high;
   }
+  return total;
+}
 
-  assert(fp != NULL);
-  unsigned long progress_range = 0;
-  for (const MEMBLOCK *rgn = FlashRegions.next; rgn != NULL; rgn = rgn->next) {
-    int segment, type, rcvd;
-    unsigned long topaddr, flashsectors, paddr, vaddr, fileoffs, filesize;
-    /* walk through all segments in the ELF file that fall into this region */
-    topaddr = 0;
-    for (segment = 0; elf_segment_by_index(fp, segment, &type, NULL, &fileoffs, &filesize, NULL, &paddr, NULL) == ELFERR_NONE; segment++) {
-      if (type == ELF_PT_LOAD && paddr >= rgn->address && paddr < rgn->address + rgn->size) {
-        topaddr = paddr + filesize;
-        progress_range += filesize;
-      }
+/* flash_sparse_erase() erases only the sectors that hold segment data, so
+   that gaps between the segments (for example, a data area for EEPROM
+   emulation) keep their contents; adjacent sectors are erased in a single
+   command */
+static bool flash_sparse_erase(char *cmd, int pktsize, const IMGREGION *rgn)
+{
+  assert(rgn != NULL && rgn->blocksize > 0);
+  unsigned long runstart = 0, runend = 0;
+  for (unsigned span = 0; span < rgn->spancount; span++) {
+    unsigned long low = rgn->spans[span].address - rgn->address;
+    unsigned long high = low + rgn->spans[span].size;
+    low = rgn->address + (low / rgn->blocksize) * rgn->blocksize;
+    high = rgn->address + ((high + rgn->blocksize - 1) / rgn->blocksize) * rgn->blocksize;
+    if (runend > runstart && low <= runend) {
+      /* spans are sorted, so this span touches or overlaps the current run */
+      if (high > runend)
+        runend = high;
+      continue;
     }
-    if (topaddr == 0)
-      continue; /* no segment fitting in this Flash sector */
-    bmp_progress_reset(progress_range+1);
-    /* erase the Flash memory */
-    assert(topaddr <= rgn->address + rgn->size);
-    assert(rgn->blocksize > 0);
-    flashsectors = ((topaddr - rgn->address + (rgn->blocksize - 1)) / rgn->blocksize);
-    assert(flashsectors * rgn->blocksize <= rgn->address + rgn->size);
-    notice(BMPSTAT_NOTICE, "Erase Flash at 0x%x length 0x%x",
-           (unsigned)rgn->address, (unsigned)(flashsectors * rgn->blocksize));
-    sprintf(cmd, "vFlashErase:%x,%x", (unsigned)rgn->address, (unsigned)(flashsectors * rgn->blocksize));
-    gdbrsp_xmit(cmd, -1);
-    rcvd = gdbrsp_recv(cmd, pktsize, 500);
-    if (rcvd != 2 || memcmp(cmd, "OK", rcvd)!= 0) {
-      notice(BMPERR_FLASHERASE, "Flash erase failed");
-      free(cmd);
+    if (runend > runstart && !flash_erase(cmd, pktsize, runstart, runend - runstart))
       return false;
+    runstart = low;
+    runend = high;
+  }
+  if (runend > runstart && !flash_erase(cmd, pktsize, runstart, runend - runstart))
+    return false;
+  return true;
+}
+
+/* packets_cleanup() frees a list of pre-encoded packets */
+static void packets_cleanup(PACKETLIST *list)
+{
+  assert(list != NULL);
+  if (list->frames != NULL)
+    free(list->frames);
+  if (list->packets != NULL)
+    free(list->packets);
+  memset(list, 0, sizeof(PACKETLIST));
+}
+
+/* packets_add() splits a block of data into vFlashWrite packets (or into
+   binary "X" packets, for RAM) that fit in the packet size, and appends the
+   encoded packets to the list */
+static bool packets_add(PACKETLIST *list, unsigned long address, const unsigned char *data, unsigned long size, int pktsize, bool ram)
+{
+  assert(list != NULL && data != NULL);
+  char *cmd = malloc(pktsize * sizeof(char));
+  if (cmd == NULL)
+    return false;
+  unsigned long pos;
+  unsigned numbytes, esccount, idx;
+  for (pos = numbytes = 0; pos < size; pos += numbytes) {
+    unsigned prefixlen;
+    if (ram)
+      sprintf(cmd, "X%x,%x:", (unsigned)(address + pos), (unsigned)(size - pos)); /* longest prefix */
+    else
+      sprintf(cmd, "vFlashWrite:%x:", (unsigned)(address + pos));
+    prefixlen = strlen(cmd) + 4;  /* +1 for '$', +3 for '#nn' checksum */
+    /* make blocks that are a multiple of 16 bytes (for guaranteed alignment)
+       that are less than (or equal to) PacketSize; start by subtracting the
+       prefix length */
+    numbytes = (pktsize - prefixlen) & ~0x0f;
+    if (pos + numbytes > size)
+      numbytes = size - pos;
+    /* check how many bytes in the packet must be escaped, then check
+       whether the packet would still fit (decrement the block length
+       otherwise) */
+    for ( ;; ) {
+      esccount = 0;
+      for (idx = 0; idx < numbytes; idx++)
+        if (data[pos + idx] == '$' || data[pos + idx] == '#' || data[pos + idx] == '}')
+          esccount += 1;
+      if (numbytes + esccount + prefixlen <= (unsigned)pktsize)
+        break;
+      numbytes -= 16;
     }
-    bmp_progress_step(1);
-    /* walk through all segments again, to download the payload */
-    for (segment = 0; elf_segment_by_index(fp, segment, &type, NULL, &fileoffs, &filesize, &vaddr, &paddr, NULL) == ELFERR_NONE; segment++) {
-      unsigned char *data;
-      unsigned pos, numbytes, esccount, idx;
-      if (type != ELF_PT_LOAD || filesize == 0 || paddr < rgn->address || paddr >= rgn->address + rgn->size)
-        continue;
-      notice(BMPSTAT_NOTICE, "%d: %s segment at 0x%x length 0x%x", segment, (vaddr == paddr) ? "Code" : "Data", (unsigned)paddr, (unsigned)filesize);
-      data = malloc(filesize);
-      if (data == NULL) {
-        notice(BMPERR_MEMALLOC, "Memory allocation failure");
+    if (ram) {
+      /* the "X" packet holds the length of the block, which may be shorter
+         than the one in the prefix above */
+      sprintf(cmd, "X%x,%x:", (unsigned)(address + pos), numbytes);
+      prefixlen = strlen(cmd) + 4;
+    }
+    /* make sure that there is room for the packet */
+    if (list->framesize + pktsize > list->framemax) {
+      size_t newsize = (list->framemax > 0) ? 2 * list->framemax : 16 * (size_t)pktsize;
+      unsigned char *frames = realloc(list->frames, newsize);
+      if (frames == NULL) {
         free(cmd);
         return false;
       }
-      fseek(fp, fileoffs, SEEK_SET);
-      fread(data, 1, filesize, fp);
-      for (pos = numbytes = 0; pos < filesize; pos += numbytes) {
-        unsigned prefixlen;
-        sprintf(cmd, "vFlashWrite:%x:", (unsigned)(paddr + pos));
-        prefixlen = strlen(cmd) + 4;  /* +1 for '$', +3 for '#nn' checksum */
-        /* make blocks that are a multiple of 16 bytes (for guaranteed alignment)
-           that are less than (or equal to) PacketSize; start by subtracting the
-           prefix length */
-        numbytes = (pktsize - prefixlen) & ~0x0f;
-        if (pos + numbytes > filesize)
-          numbytes = filesize - pos;
-        /* check how many bytes in the packet must be escaped, then check
-           whether the packet would still fit (decrement the block length
-           otherwise) */
-        for ( ;; ) {
-          esccount = 0;
-          for (idx = 0; idx < numbytes; idx++)
-            if (data[pos + idx] == '$' || data[pos + idx] == '#' || data[pos + idx] == '}')
-              esccount += 1;
-          if (numbytes + esccount + prefixlen <= (unsigned)pktsize)
-            break;
-          numbytes -= 16;
-        }
-        memmove(cmd + (prefixlen - 4), data + pos, numbytes);
-        gdbrsp_xmit(cmd, (prefixlen - 4) + numbytes);
-        rcvd = gdbrsp_recv(cmd, pktsize, 500);
-        if (rcvd != 2 || memcmp(cmd, "OK", rcvd)!= 0) {
-          notice(BMPERR_FLASHWRITE, "Flash write failed");
-          free(data);
-          free(cmd);
-          return false;
-        }
-        bmp_progress_step(numbytes);
-      }
-      free(data);
+      list->frames = frames;
+      list->framemax = newsize;
     }
-    gdbrsp_xmit("vFlashDone", -1);
-    rcvd = gdbrsp_recv(cmd, pktsize, 500);
-    if (rcvd != 2 || memcmp(cmd, "OK", rcvd)!= 0) {
-      notice(BMPERR_FLASHDONE, "Flash completion failed");
-      free(cmd);
-      return false;
+    if (list->count >= list->max) {
+      unsigned newcount = (list->max > 0) ? 2 * list->max : 16;
+      IMGPACKET *packets = realloc(list->packets, newcount * sizeof(IMGPACKET));
+      if (packets == NULL) {
+        free(cmd);
+        return false;
+      }
+      list->packets = packets;
+      list->max = newcount;
     }
+    memcpy(cmd + (prefixlen - 4), data + pos, numbytes);
+    size_t framesize = gdbrsp_encode(cmd, (prefixlen - 4) + numbytes, list->frames + list->framesize,
+                                     list->framemax - list->framesize);
+    assert(framesize == prefixlen + numbytes + esccount);
+    list->packets[list->count].address = address + pos;
+    list->packets[list->count].offset = list->framesize;
+    list->packets[list->count].framesize = (unsigned)framesize;
+    list->packets[list->count].numbytes = numbytes;
+    list->count += 1;
+    list->framesize += framesize;
   }
-
   free(cmd);
   return true;
 }
 
-bool bmp_verify(FILE *fp)
+static void image_cleanup_regions(BMP_IMAGE *image)
 {
-  if (!bmp_isopen()) {
-    notice(BMPERR_NOCONNECT, "Not connected to Black Magic Probe");
-    return 0;
+  assert(image != NULL);
+  while (image->regions.next != NULL) {
+    IMGREGION *rgn = image->regions.next;
+    image->regions.next = rgn->next;
+    if (rgn->data != NULL)
+      free(rgn->data);
+    if (rgn->blockcrc != NULL)
+      free(rgn->blockcrc);
+    if (rgn->spans != NULL)
+      free(rgn->spans);
+    packets_cleanup(&rgn->packets);
+    free(rgn);
   }
+  image->pktsize = 0;
+}
 
-  /* run over all segments in the ELF file */
-  bool allmatch = true;
-  assert(fp != NULL);
-  int type;
-  unsigned long offset, filesize, paddr;
-  for (int segment = 0;
-       elf_segment_by_index(fp, segment, &type, NULL, &offset, &filesize, NULL, &paddr, NULL) == ELFERR_NONE;
-       segment++)
-  {
-    unsigned char *data;
-    unsigned crc_src, crc_tgt;
-    size_t rcvd;
-
-    if (type != ELF_PT_LOAD || filesize == 0)
-      continue;   /* no loadable data */
-    /* also check that paddr falls within a Flash memory sector */
-    const MEMBLOCK *rgn;
-    for (rgn = FlashRegions.next; rgn != NULL; rgn = rgn->next)
-      if (paddr >= rgn->address && paddr < rgn->address + rgn->size)
-        break;
-    if (rgn == NULL)
-      continue; /* segment is outside of any Flash sector */
-    /* read entire segment, calc CRC */
-    data = malloc((size_t)filesize * sizeof (unsigned char));
-    if (data == NULL) {
-      notice(BMPERR_MEMALLOC, "Memory allocation failure");
-      return false;
-    }
-    fseek(fp, offset, SEEK_SET);
-    fread(data, 1, filesize, fp);
-    crc_src = (unsigned)gdb_crc32((uint32_t)~0, data, filesize);
-    free(data);
-    /* request CRC from Black Magic Probe */
-    char cmd[100];
-    sprintf(cmd, "qCRC:%lx,%lx",paddr,filesize);
-    gdbrsp_xmit(cmd, -1);
-    rcvd = gdbrsp_recv(cmd, sizearray(cmd), 3000);
-    cmd[rcvd] = '\0';
-    crc_tgt = (rcvd >= 2 && cmd[0] == 'C') ? strtoul(cmd + 1, NULL, 16) : 0;
-    if (crc_tgt != crc_src) {
-      notice(BMPERR_FLASHCRC, "Segment %d data mismatch", segment);
-      allmatch = false;
-    }
+/* image_overlaps() returns true if the address range overlaps a segment that
+   is already in the image */
+static bool image_overlaps(const BMP_IMAGE *image, unsigned long address, unsigned long size)
+{
+  assert(image != NULL);
+  for (int idx = 0; idx < image->segmentcount; idx++) {
+    const IMGSEGMENT *seg = &image->segments[idx];
+    if (address < seg->address + seg->size && seg->address < address + size)
+      return true;
   }
-  if (allmatch)
-    notice(BMPSTAT_SUCCESS, "Verification successful");
-
-  return allmatch;
+  return false;
 }
 
-/** bmp_enabletrace() code enables trace in the Black Magic Probe.
- *  \param async_bitrate  [IN] The bitrate for ASYNC mode; set to 0 for
- *                        manchester mode.
- *  \param endpoint       [OUT] The endpoint for the SWO trace is copied into
- *                        this parameter. This parameter may be NULL.
- *
- *  \return 1 on success, 0 on failure.
- */
-int bmp_enabletrace(int async_bitrate, unsigned char *endpoint)
+/* image_addsegment() appends a segment to the image, and reads its data from
+   the file */
+static bool image_addsegment(BMP_IMAGE *image, FILE *fp, int index, unsigned long fileoffs,
+                             unsigned long address, unsigned long size, bool isdata)
 {
-  char buffer[100], *ptr;
-  int rcvd, ok, retry;
+  assert(image != NULL && fp != NULL);
+  IMGSEGMENT *list = realloc(image->segments, (image->segmentcount + 1) * sizeof(IMGSEGMENT));
+  if (list == NULL)
+    return false;
+  image->segments = list;
+  IMGSEGMENT *seg = &list[image->segmentcount];
+  memset(seg, 0, sizeof(IMGSEGMENT));
+  seg->data = malloc(size);
+  if (seg->data == NULL)
+    return false;
+  image->segmentcount += 1;
+  seg->index = index;
+  seg->source = image->sourcecount;
+  seg->fileoffs = fileoffs;
+  seg->address = address;
+  seg->size = size;
+  seg->isdata = isdata;
+  fseek(fp, fileoffs, SEEK_SET);
+  if (fread(seg->data, 1, size, fp) != size)
+    return false;
+  seg->crc = (unsigned)gdb_crc32((uint32_t)~0, seg->data, size);
+  return true;
+}
 
-  if (!bmp_isopen()) {
-    notice(BMPERR_NOCONNECT, "Not connected to Black Magic Probe");
-    return 0;
+/* image_truncate() removes the segments that were added after the first
+   "count" segments (when appending a file fails halfway) */
+static void image_truncate(BMP_IMAGE *image, int count)
+{
+  assert(image != NULL && count <= image->segmentcount);
+  while (image->segmentcount > count) {
+    image->segmentcount -= 1;
+    free(image->segments[image->segmentcount].data);
   }
+}
 
-  for (retry = 3; retry > 0; retry--) {
-    if (async_bitrate > 0)  {
-      sprintf(buffer, "qRcmd,traceswo %d", async_bitrate);
-      gdbrsp_xmit(buffer, -1);
+/* image_readelf() adds the loadable segments of an ELF file to the image;
+   segments of an appended file may not overlap the segments already in the
+   image */
+static bool image_readelf(BMP_IMAGE *image, FILE *fp)
+{
+  assert(image != NULL && fp != NULL);
+  ELF_FILE *elf = elf_open(fp, NULL);
+  int segment, type;
+  unsigned long fileoffs, filesize, vaddr, paddr;
+  bool ok = true;
+  for (segment = 0; ok && elf_file_segment(elf, segment, &type, NULL, &fileoffs, &filesize, &vaddr, &paddr, NULL) == ELFERR_NONE; segment++) {
+    if (type != ELF_PT_LOAD || filesize == 0)
+      continue;
+    if (image->sourcecount > 0 && image_overlaps(image, paddr, filesize)) {
+      notice(BMPERR_GENERAL, "Segment at 0x%x overlaps an earlier image", (unsigned)paddr);
+      ok = false;
     } else {
-      gdbrsp_xmit("qRcmd,traceswo", -1);
+      ok = image_addsegment(image, fp, segment, fileoffs, paddr, filesize, (vaddr != paddr));
     }
-    rcvd = gdbrsp_recv(buffer, sizearray(buffer), 1000);
-    if (rcvd > 0)
-      break;
-  }
-  /* a correct answer starts with 'o' and contains a serial number, the
-     interface for trace capture (0x05) and the endpoint (0x85, on the original
-     Black Magic Probe) */
-  buffer[rcvd] = '\0';
-  ok = ((ptr = strchr(buffer, ':')) != NULL && strtol(ptr + 1, &ptr, 16) == BMP_IF_TRACE && *ptr == ':');
-  if (ok) {
-    long ep = strtol(ptr + 1, NULL, 16);
-    ok = (ep > 0x80); /* this must be an IN enpoint, so high bit must be set */
-    if (endpoint != NULL)
-      *endpoint = (unsigned char)ep;
-  }
-  if (!ok) {
-    notice(BMPERR_MONITORCMD, "Trace setup failed");
-    return 0;
   }
-  return 1;
+  elf_close(elf);
+  return ok;
 }
 
-int bmp_restart(void)
+/** bmp_image_create() reads the loadable segments of an ELF file into memory.
+ *  The image can then be downloaded and verified (repeatedly) without reading
+ *  the file again; the parts that depend on the Flash memory map of the target
+ *  and the packet size of the probe are built on first use, and re-used as
+ *  long as these do not change.
+ *
+ *  \param fp   The ELF file.
+ *
+ *  \return The image, or NULL on failure.
+ *
+ *  \note More files can be added to the image with bmp_image_append() and
+ *        bmp_image_appendbinary(), so that these are all programmed in a
+ *        single download.
+ */
+BMP_IMAGE *bmp_image_create(FILE *fp)
 {
-  char buffer[100];
-  int rcvd;
-
-  if (!bmp_isopen()) {
-    notice(BMPERR_NOCONNECT, "Not connected to Black Magic Probe");
-    return 0;
+  assert(fp != NULL);
+  BMP_IMAGE *image = malloc(sizeof(BMP_IMAGE));
+  if (image == NULL)
+    return NULL;
+  memset(image, 0, sizeof(BMP_IMAGE));
+  if (!image_readelf(image, fp)) {
+    bmp_image_delete(image);
+    return NULL;
   }
+  image->sourcecount = 1;
+  return image;
+}
 
-  gdbrsp_xmit("vRun;", -1);
-  rcvd = gdbrsp_recv(buffer, sizearray(buffer), 3000);
-  buffer[rcvd] = '\0';
-  if (buffer[0] == 'E')
-    return 0;
+/** bmp_image_append() adds the loadable segments of another ELF file to the
+ *  image, for example a bootloader that is programmed together with the
+ *  application. The Flash sectors of all files are then erased, written and
+ *  verified in one pass.
+ *
+ *  \param image  The image, created with bmp_image_create().
+ *  \param fp     The ELF file to add.
+ *
+ *  \return true on success, false on a read or memory allocation failure, or
+ *          if a segment overlaps a segment that is already in the image. On
+ *          failure, the image is unchanged.
+ */
+bool bmp_image_append(BMP_IMAGE *image, FILE *fp)
+{
+  assert(image != NULL && fp != NULL);
+  image_cleanup_regions(image);
+  image->verified = false;
+  int count = image->segmentcount;
+  if (!image_readelf(image, fp)) {
+    image_truncate(image, count);
+    return false;
+  }
+  image->sourcecount += 1;
+  return true;
+}
+
+/** bmp_image_appendbinary() adds the contents of a binary file (such as
+ *  calibration data) to the image, at the given address.
+ *
+ *  \param image    The image, created with bmp_image_create().
+ *  \param fp       The binary file.
+ *  \param address  The address in Flash memory where the data is written.
+ *
+ *  \return true on success, false on a read or memory allocation failure, or
+ *          if the data overlaps a segment that is already in the image. On
+ *          failure, the image is unchanged.
+ */
+bool bmp_image_appendbinary(BMP_IMAGE *image, FILE *fp, unsigned long address)
+{
+  assert(image != NULL && fp != NULL);
+  fseek(fp, 0, SEEK_END);
+  long size = ftell(fp);
+  if (size <= 0)
+    return false;
+  if (image_overlaps(image, address, (unsigned long)size)) {
+    notice(BMPERR_GENERAL, "Data at 0x%x overlaps an earlier image", (unsigned)address);
+    return false;
+  }
+  image_cleanup_regions(image);
+  image->verified = false;
+  int count = image->segmentcount;
+  if (!image_addsegment(image, fp, 0, 0, address, (unsigned long)size, false)) {
+    image_truncate(image, count);
+    return false;
+  }
+  image->sourcecount += 1;
+  return true;
+}
+
+/** bmp_image_delete() frees an image created with bmp_image_create().
+ */
+void bmp_image_delete(BMP_IMAGE *image)
+{
+  assert(image != NULL);
+  image_cleanup_regions(image);
+  for (int idx = 0; idx < image->segmentcount; idx++)
+    free(image->segments[idx].data);
+  if (image->segments != NULL)
+    free(image->segments);
+  free(image);
+}
+
+/* region_encode() builds the packets for all spans in a region */
+static bool region_encode(IMGREGION *rgn, int pktsize)
+{
+  assert(rgn != NULL && rgn->packets.count == 0);
+  for (unsigned span = 0; span < rgn->spancount; span++) {
+    const IMGSPAN *cur = &rgn->spans[span];
+    if (!packets_add(&rgn->packets, cur->address, rgn->data + (cur->address - rgn->address), cur->size, pktsize, false))
+      return false;
+  }
+  return true;
+}
+
+/** bmp_image_find() looks up a byte pattern in the segment data of an image.
+ *
+ *  \return The offset in the ELF file where the pattern is found, or -1 if it
+ *          is not found (patterns that cross segments are not found).
+ *
+ *  \note Only the segments of the ELF file that the image was created from
+ *        are searched, not those of appended files.
+ */
+long bmp_image_find(const BMP_IMAGE *image, const unsigned char *pattern, size_t size)
+{
+  assert(image != NULL);
+  assert(pattern != NULL && size > 0);
+  for (int idx = 0; idx < image->segmentcount; idx++) {
+    const IMGSEGMENT *seg = &image->segments[idx];
+    if (seg->source != 0)
+      continue;
+    for (unsigned long pos = 0; pos + size <= seg->size; pos++)
+      if (seg->data[pos] == pattern[0] && memcmp(seg->data + pos, pattern, size) == 0)
+        return (long)(seg->fileoffs + pos);
+  }
+  return -1;
+}
+
+/** bmp_image_patch() overwrites bytes in the image, for example to set a
+ *  serial number. The position is given as an offset in the ELF file that the
+ *  image was created from (appended files cannot be patched). The
+ *  sector CRCs and the encoded packets of the region are updated too, so that
+ *  a differential download only writes the sectors holding the patched data.
+ *
+ *  \return true on success, false if the range does not fall inside a segment
+ *          (or on a memory allocation failure).
+ */
+bool bmp_image_patch(BMP_IMAGE *image, unsigned long fileoffs, const unsigned char *data, size_t size)
+{
+  assert(image != NULL);
+  assert(data != NULL && size > 0);
+  IMGSEGMENT *seg = NULL;
+  for (int idx = 0; idx < image->segmentcount && seg == NULL; idx++)
+    if (image->segments[idx].source == 0 && fileoffs >= image->segments[idx].fileoffs && fileoffs + size <= image->segments[idx].fileoffs + image->segments[idx].size)
+      seg = &image->segments[idx];
+  if (seg == NULL)
+    return false;
+  unsigned long offset = fileoffs - seg->fileoffs;
+  if (memcmp(seg->data + offset, data, size) == 0)
+    return true;  /* nothing changes */
+  memcpy(seg->data + offset, data, size);
+  seg->crc = (unsigned)gdb_crc32((uint32_t)~0, seg->data, seg->size);
+
+  /* update the region that holds the segment (if the image was prepared) */
+  unsigned long address = seg->address + offset;
+  for (IMGREGION *rgn = image->regions.next; rgn != NULL; rgn = rgn->next) {
+    if (rgn->loaded == 0 || address < rgn->address || address >= rgn->address + rgn->size)
+      continue;
+    memcpy(rgn->data + (address - rgn->address), data, size);
+    unsigned long first = (address - rgn->address) / rgn->blocksize;
+    unsigned long last = (address + size - 1 - rgn->address) / rgn->blocksize;
+    for (unsigned long sector = first; sector <= last; sector++)
+      rgn->blockcrc[sector] = (unsigned)gdb_crc32((uint32_t)~0, rgn->data + sector * rgn->blocksize, rgn->blocksize);
+    /* the escapes in the patched packets may change, so re-encode the region */
+    packets_cleanup(&rgn->packets);
+    if (!region_encode(rgn, image->pktsize)) {
+      image_cleanup_regions(image);
+      return false;
+    }
+  }
+  return true;
+}
+
+static int span_compare(const void *a, const void *b)
+{
+  const IMGSPAN *s1 = (const IMGSPAN*)a;
+  const IMGSPAN *s2 = (const IMGSPAN*)b;
+  if (s1->address != s2->address)
+    return (s1->address < s2->address) ? -1 : 1;
+  return 0;
+}
+
+/* image_prepare() builds the images of the Flash regions of the target, with
+   the CRC of every sector and the encoded packets; it keeps the current data
+   if the image was already prepared for the same Flash map and packet size */
+static bool image_prepare(BMP_IMAGE *image, int pktsize)
+{
+  BMP_CONTEXT *bmp = context();
+  assert(image != NULL);
+
+  if (image->pktsize == pktsize) {
+    const MEMBLOCK *rgn = bmp->FlashRegions.next;
+    const IMGREGION *irgn = image->regions.next;
+    while (rgn != NULL && irgn != NULL
+           && rgn->address == irgn->address && rgn->size == irgn->rgnsize && rgn->blocksize == irgn->blocksize)
+    {
+      rgn = rgn->next;
+      irgn = irgn->next;
+    }
+    if (rgn == NULL && irgn == NULL)
+      return true;  /* the image is up-to-date */
+  }
+
+  image_cleanup_regions(image);
+  image->pktsize = pktsize;
+  IMGREGION *tail = &image->regions;
+  for (const MEMBLOCK *rgn = bmp->FlashRegions.next; rgn != NULL; rgn = rgn->next) {
+    IMGREGION *irgn = malloc(sizeof(IMGREGION));
+    if (irgn == NULL) {
+      image_cleanup_regions(image);
+      return false;
+    }
+    memset(irgn, 0, sizeof(IMGREGION));
+    irgn->address = rgn->address;
+    irgn->rgnsize = rgn->size;
+    irgn->blocksize = rgn->blocksize;
+    tail->next = irgn;
+    tail = irgn;
+
+    /* find the segments that fall into this region */
+    unsigned long topaddr = 0;
+    unsigned count = 0;
+    int idx;
+    for (idx = 0; idx < image->segmentcount; idx++) {
+      const IMGSEGMENT *seg = &image->segments[idx];
+      if (seg->address >= rgn->address && seg->address < rgn->address + rgn->size) {
+        if (seg->address + seg->size > topaddr)
+          topaddr = seg->address + seg->size;
+        count++;
+      }
+    }
+    if (topaddr == 0)
+      continue; /* no segment fitting in this Flash region */
+    assert(topaddr <= rgn->address + rgn->size);
+    assert(rgn->blocksize > 0);
+    unsigned long flashsectors = (topaddr - rgn->address + (rgn->blocksize - 1)) / rgn->blocksize;
+    irgn->size = flashsectors * rgn->blocksize;
+
+    /* build the image of the region, gaps between segments are in the erased
+       state (if the MCU erases to a different value, the affected sectors
+       never match in a differential download, and are always written) */
+    irgn->data = malloc(irgn->size);
+    irgn->blockcrc = malloc(flashsectors * sizeof(unsigned));
+    irgn->spans = malloc(count * sizeof(IMGSPAN));
+    if (irgn->data == NULL || irgn->blockcrc == NULL || irgn->spans == NULL) {
+      image_cleanup_regions(image);
+      return false;
+    }
+    memset(irgn->data, 0xff, irgn->size);
+    for (idx = 0; idx < image->segmentcount; idx++) {
+      const IMGSEGMENT *seg = &image->segments[idx];
+      if (seg->address >= rgn->address && seg->address < rgn->address + rgn->size) {
+        memcpy(irgn->data + (seg->address - rgn->address), seg->data, seg->size);
+        irgn->loaded += seg->size;
+        irgn->spans[irgn->spancount].address = seg->address;
+        irgn->spans[irgn->spancount].size = seg->size;
+        irgn->spancount += 1;
+      }
+    }
+    for (unsigned long sector = 0; sector < flashsectors; sector++)
+      irgn->blockcrc[sector] = (unsigned)gdb_crc32((uint32_t)~0, irgn->data + sector * rgn->blocksize, rgn->blocksize);
+
+    /* merge adjacent (or overlapping) segments into spans */
+    qsort(irgn->spans, irgn->spancount, sizeof(IMGSPAN), span_compare);
+    unsigned num = 0;
+    for (unsigned span = 1; span < irgn->spancount; span++) {
+      IMGSPAN *cur = &irgn->spans[num];
+      const IMGSPAN *next = &irgn->spans[span];
+      if (next->address <= cur->address + cur->size) {
+        if (next->address + next->size > cur->address + cur->size)
+          cur->size = next->address + next->size - cur->address;
+      } else {
+        irgn->spans[++num] = *next;
+      }
+    }
+    irgn->spancount = num + 1;
+
+    if (!region_encode(irgn, pktsize)) {
+      image_cleanup_regions(image);
+      return false;
+    }
+  }
+
+  return true;
+}
+
+/* packets_write() writes pre-encoded packets to (erased) Flash memory, or to
+   RAM; up to FlashWindow packets are sent before waiting for the reply on the
+   first (replies are matched in order) */
+static bool packets_write(char *cmd, int pktsize, const PACKETLIST *list, bool ram)
+{
+  BMP_CONTEXT *bmp = context();
+  unsigned inflight[FLASH_WINDOW_MAX];  /* indices of packets in flight */
+  int head = 0, count = 0;
+  unsigned next = 0;
+
+  /* packets can only be pipelined in no-ack mode, because in ack mode, the
+     transmit function waits for the acknowledge of each packet */
+  int window = bmp->NoAckMode ? flash_window() : 1;
+  assert(window >= 1 && window <= FLASH_WINDOW_MAX);
+  assert(list != NULL);
+
+  while (next < list->count || count > 0) {
+    /* fill the window (the packets go out in a single write) */
+    gdbrsp_batch(true);
+    while (next < list->count && count < window) {
+      const IMGPACKET *pkt = &list->packets[next];
+      gdbrsp_xmit_frame(list->frames + pkt->offset, pkt->framesize);
+      inflight[(head + count) % FLASH_WINDOW_MAX] = next++;
+      count++;
+    }
+    gdbrsp_batch(false);
+    /* check the reply on the oldest packet */
+    int rcvd = gdbrsp_recv(cmd, pktsize, 500);
+    if (rcvd == 2 && memcmp(cmd, "OK", rcvd) == 0) {
+      bmp->FlashBytes += list->packets[inflight[head]].numbytes;
+      bmp_progress_step(list->packets[inflight[head]].numbytes);
+      head = (head + 1) % FLASH_WINDOW_MAX;
+      count--;
+      continue;
+    }
+    if (window == 1) {
+      if (ram)
+        notice(BMPERR_RAMWRITE, "RAM write failed");
+      else
+        notice(BMPERR_FLASHWRITE, "Flash write failed");
+      return false;
+    }
+    /* fall back to sending one packet at a time: collect the replies on the
+       packets still in flight, then re-send the ones that failed */
+    notice(BMPSTAT_NOTICE, "Pipelined write failed, continuing without pipelining");
+    int failed = 1;   /* the packet at the head (just checked) */
+    for (int idx = 1; idx < count; idx++) {
+      unsigned pkt = inflight[(head + idx) % FLASH_WINDOW_MAX];
+      rcvd = gdbrsp_recv(cmd, pktsize, 500);
+      if (rcvd == 2 && memcmp(cmd, "OK", rcvd) == 0) {
+        bmp->FlashBytes += list->packets[pkt].numbytes;
+        bmp_progress_step(list->packets[pkt].numbytes);
+      } else {
+        inflight[(head + failed) % FLASH_WINDOW_MAX] = pkt;
+        failed++;
+      }
+    }
+    gdbrsp_clear();
+    window = 1;
+    for (int idx = 0; idx < failed; idx++) {
+      const IMGPACKET *pkt = &list->packets[inflight[(head + idx) % FLASH_WINDOW_MAX]];
+      gdbrsp_xmit_frame(list->frames + pkt->offset, pkt->framesize);
+      rcvd = gdbrsp_recv(cmd, pktsize, 500);
+      if (rcvd != 2 || memcmp(cmd, "OK", rcvd) != 0) {
+        if (ram)
+          notice(BMPERR_RAMWRITE, "RAM write failed");
+        else
+          notice(BMPERR_FLASHWRITE, "Flash write failed");
+        return false;
+      }
+      bmp->FlashBytes += pkt->numbytes;
+      bmp_progress_step(pkt->numbytes);
+    }
+    count = 0;
+  }
+  return true;
+}
+
+/* flash_difference() erases and writes only the sectors in the region whose
+   contents differ from the image; the sectors are compared with a CRC
+   (calculated locally & on the target) */
+static bool flash_difference(char *cmd, int pktsize, const IMGREGION *rgn)
+{
+  unsigned long flashsectors = rgn->size / rgn->blocksize;
+  unsigned char *dirty = malloc(flashsectors);
+  if (dirty == NULL) {
+    notice(BMPERR_MEMALLOC, "Memory allocation failure");
+    return false;
+  }
+
+  /* find the sectors that hold segment data; sectors in the gaps between
+     segments are left alone */
+  memset(dirty, 0, flashsectors);
+  for (unsigned span = 0; span < rgn->spancount; span++) {
+    unsigned long first = (rgn->spans[span].address - rgn->address) / rgn->blocksize;
+    unsigned long last = (rgn->spans[span].address + rgn->spans[span].size - 1 - rgn->address) / rgn->blocksize;
+    for (unsigned long sector = first; sector <= last; sector++)
+      dirty[sector] = 1;
+  }
+
+  /* compare the sectors */
+  unsigned long skipped = 0, used = 0;
+  for (unsigned long sector = 0; sector < flashsectors; sector++) {
+    if (!dirty[sector])
+      continue;
+    used++;
+    sprintf(cmd, "qCRC:%lx,%x", rgn->address + sector * rgn->blocksize, rgn->blocksize);
+    gdbrsp_xmit(cmd, -1);
+    size_t rcvd = gdbrsp_recv(cmd, pktsize, 3000);
+    if (rcvd >= (size_t)pktsize)
+      rcvd = pktsize - 1;
+    cmd[rcvd] = '\0';
+    dirty[sector] = (rcvd < 2 || cmd[0] != 'C' || strtoul(cmd + 1, NULL, 16) != rgn->blockcrc[sector]);
+    if (!dirty[sector])
+      skipped++;
+  }
+  bmp_progress_step(1);
+  notice(BMPSTAT_NOTICE, "%lu of %lu sectors unchanged", skipped, used);
+
+  /* the segment data in unchanged sectors counts as done */
+  for (unsigned span = 0; span < rgn->spancount; span++) {
+    unsigned long low = rgn->spans[span].address;
+    unsigned long high = low + rgn->spans[span].size;
+    for (unsigned long addr = low; addr < high; ) {
+      unsigned long sector = (addr - rgn->address) / rgn->blocksize;
+      unsigned long top = rgn->address + (sector + 1) * rgn->blocksize;
+      if (top > high)
+        top = high;
+      if (!dirty[sector])
+        bmp_progress_step(top - addr);
+      addr = top;
+    }
+  }
+
+  /* erase and write runs of changed sectors */
+  bool result = true;
+  bool erased = false;
+  for (unsigned long sector = 0; result && sector < flashsectors; ) {
+    if (!dirty[sector]) {
+      sector++;
+      continue;
+    }
+    unsigned long last = sector;
+    while (last + 1 < flashsectors && dirty[last + 1])
+      last++;
+    unsigned long runstart = rgn->address + sector * rgn->blocksize;
+    unsigned long runend = rgn->address + (last + 1) * rgn->blocksize;
+    result = flash_erase(cmd, pktsize, runstart, runend - runstart);
+    erased = true;
+    /* encode & write the parts of the spans that fall inside the run */
+    PACKETLIST list;
+    memset(&list, 0, sizeof list);
+    for (unsigned span = 0; result && span < rgn->spancount; span++) {
+      unsigned long low = rgn->spans[span].address;
+      unsigned long high = low + rgn->spans[span].size;
+      if (low < runstart)
+        low = runstart;
+      if (high > runend)
+        high = runend;
+      if (low < high && !packets_add(&list, low, rgn->data + (low - rgn->address), high - low, pktsize, false)) {
+        notice(BMPERR_MEMALLOC, "Memory allocation failure");
+        result = false;
+      }
+    }
+    if (result)
+      result = packets_write(cmd, pktsize, &list, false);
+    packets_cleanup(&list);
+    sector = last + 1;
+  }
+  free(dirty);
+
+  if (result && erased) {
+    gdbrsp_xmit("vFlashDone", -1);
+    int rcvd = gdbrsp_recv(cmd, pktsize, 500);
+    if (rcvd != 2 || memcmp(cmd, "OK", rcvd)!= 0) {
+      notice(BMPERR_FLASHDONE, "Flash completion failed");
+      result = false;
+    }
+  }
+  return result;
+}
+
+/** bmp_setflashoverlap() enables or disables the overlapped download, where
+ *  the sectors are erased, written and verified in stages, with the commands
+ *  for the next stage already sent while the probe works on the current one.
+ *  When enabled (the default), a separate verification after the download is
+ *  redundant, see bmp_image_verified().
+ *
+ *  \note The overlapped download is only used when the gdbserver runs in
+ *        no-ack mode, and not for a differential download.
+ */
+void bmp_setflashoverlap(bool enable)
+{
+  FlashOverlap = enable;
+}
+
+/* jobs_add() appends a command to the list for an overlapped download */
+static bool jobs_add(JOBLIST *list, int type, unsigned long address, unsigned long size, unsigned value)
+{
+  assert(list != NULL);
+  if (list->count >= list->max) {
+    unsigned newcount = (list->max > 0) ? 2 * list->max : 64;
+    FLASHJOB *jobs = realloc(list->jobs, newcount * sizeof(FLASHJOB));
+    if (jobs == NULL)
+      return false;
+    list->jobs = jobs;
+    list->max = newcount;
+  }
+  list->jobs[list->count].type = type;
+  list->jobs[list->count].address = address;
+  list->jobs[list->count].size = size;
+  list->jobs[list->count].value = value;
+  list->count += 1;
+  return true;
+}
+
+/* flash_stages() splits the download of a region into stages of (roughly) a
+   sector; each stage erases the sectors that it needs (unless the Flash is
+   blank), writes its packets, closes with vFlashDone, and then checks the CRC
+   of the data just written */
+static bool flash_stages(JOBLIST *list, const IMGREGION *rgn, bool erase)
+{
+  const PACKETLIST *packets = &rgn->packets;
+  unsigned long erased = rgn->address;  /* top of the erased area */
+  unsigned pkt = 0;
+  while (pkt < packets->count) {
+    /* a stage runs to the end of the sector in which it starts, or beyond that
+       if the last packet crosses the boundary */
+    unsigned long base = packets->packets[pkt].address;
+    unsigned long boundary = rgn->address + ((base - rgn->address) / rgn->blocksize + 1) * rgn->blocksize;
+    unsigned last = pkt;
+    while (last + 1 < packets->count && packets->packets[last + 1].address < boundary)
+      last++;
+    unsigned long top = packets->packets[last].address + packets->packets[last].numbytes;
+    top = rgn->address + ((top - rgn->address + rgn->blocksize - 1) / rgn->blocksize) * rgn->blocksize;
+    unsigned long low = rgn->address + ((base - rgn->address) / rgn->blocksize) * rgn->blocksize;
+    if (low < erased)
+      low = erased;
+    if (erase && top > low && !jobs_add(list, JOB_ERASE, low, top - low, 0))
+      return false;
+    if (top > erased)
+      erased = top;
+    unsigned idx;
+    for (idx = pkt; idx <= last; idx++)
+      if (!jobs_add(list, JOB_WRITE, packets->packets[idx].address, packets->packets[idx].numbytes, idx))
+        return false;
+    if (!jobs_add(list, JOB_DONE, 0, 0, 0))
+      return false;
+    /* check the CRC on every contiguous range in the stage (a stage may hold
+       the end of one segment and the start of the next) */
+    unsigned long start = packets->packets[pkt].address;
+    unsigned long end = start;
+    for (idx = pkt; idx <= last + 1; idx++) {
+      if (idx > last || packets->packets[idx].address != end) {
+        unsigned crc = (unsigned)gdb_crc32((uint32_t)~0, rgn->data + (start - rgn->address), end - start);
+        if (!jobs_add(list, JOB_CRC, start, end - start, crc))
+          return false;
+        if (idx <= last)
+          start = packets->packets[idx].address;
+      }
+      if (idx <= last)
+        end = packets->packets[idx].address + packets->packets[idx].numbytes;
+    }
+    pkt = last + 1;
+  }
+  return true;
+}
+
+/* list_segments() shows the segments that go into a region */
+static void list_segments(const BMP_IMAGE *image, const IMGREGION *rgn)
+{
+  for (int idx = 0; idx < image->segmentcount; idx++) {
+    const IMGSEGMENT *seg = &image->segments[idx];
+    if (seg->address >= rgn->address && seg->address < rgn->address + rgn->rgnsize)
+      notice(BMPSTAT_NOTICE, "%d: %s segment at 0x%x length 0x%x", seg->index, seg->isdata ? "Data" : "Code", (unsigned)seg->address, (unsigned)seg->size);
+  }
+}
+
+/* flash_overlapped() erases, writes and verifies a region in stages; the
+   commands are sent ahead (up to the size of the window) so that the probe
+   does not sit idle waiting for the next command, and the CRC checks run
+   behind the writes */
+static bool flash_overlapped(char *cmd, int pktsize, const IMGREGION *rgn, bool erase)
+{
+  BMP_CONTEXT *bmp = context();
+  JOBLIST list;
+  memset(&list, 0, sizeof list);
+  if (!flash_stages(&list, rgn, erase)) {
+    notice(BMPERR_MEMALLOC, "Memory allocation failure");
+    if (list.jobs != NULL)
+      free(list.jobs);
+    return false;
+  }
+  notice(BMPSTAT_NOTICE, "Erase, write & verify Flash at 0x%x length 0x%x", (unsigned)rgn->address, (unsigned)rgn->size);
+
+  int window = flash_window();
+  assert(window >= 1 && window <= FLASH_WINDOW_MAX);
+  unsigned inflight[FLASH_WINDOW_MAX];  /* indices of jobs in flight */
+  int head = 0, count = 0;
+  unsigned next = 0;
+  bool result = true;
+  /* the probe handles the commands in order, so the time between the replies
+     on two successive commands is the time that the second one took */
+  unsigned long tstamp_reply = timestamp();
+  while (next < list.count || count > 0) {
+    /* fill the window (the commands go out in a single write) */
+    gdbrsp_batch(true);
+    while (next < list.count && count < window) {
+      const FLASHJOB *job = &list.jobs[next];
+      char buffer[64];
+      switch (job->type) {
+      case JOB_ERASE:
+        sprintf(buffer, "vFlashErase:%x,%x", (unsigned)job->address, (unsigned)job->size);
+        gdbrsp_xmit(buffer, -1);
+        break;
+      case JOB_WRITE: {
+        const IMGPACKET *pkt = &rgn->packets.packets[job->value];
+        gdbrsp_xmit_frame(rgn->packets.frames + pkt->offset, pkt->framesize);
+        break;
+      }
+      case JOB_DONE:
+        gdbrsp_xmit("vFlashDone", -1);
+        break;
+      case JOB_CRC:
+        sprintf(buffer, "qCRC:%lx,%lx", job->address, job->size);
+        gdbrsp_xmit(buffer, -1);
+        break;
+      }
+      inflight[(head + count) % FLASH_WINDOW_MAX] = next++;
+      count++;
+    }
+    gdbrsp_batch(false);
+    /* check the reply on the oldest command */
+    const FLASHJOB *job = &list.jobs[inflight[head]];
+    int rcvd = gdbrsp_recv(cmd, pktsize, (job->type == JOB_CRC) ? 3000 : 500);
+    bool ok;
+    if (job->type == JOB_CRC) {
+      if (rcvd >= pktsize)
+        rcvd = pktsize - 1;
+      cmd[(rcvd > 0) ? rcvd : 0] = '\0';
+      ok = (rcvd >= 2 && cmd[0] == 'C' && strtoul(cmd + 1, NULL, 16) == job->value);
+    } else {
+      ok = (rcvd == 2 && memcmp(cmd, "OK", rcvd) == 0);
+    }
+    unsigned long tstamp = timestamp();
+    if (ok && job->type == JOB_ERASE) {
+      bmp->EraseBytes += job->size;
+      bmp->EraseTime += tstamp - tstamp_reply;
+    }
+    tstamp_reply = tstamp;
+    head = (head + 1) % FLASH_WINDOW_MAX;
+    count--;
+    if (!ok) {
+      switch (job->type) {
+      case JOB_ERASE:
+        notice(BMPERR_FLASHERASE, "Flash erase failed at 0x%x", (unsigned)job->address);
+        break;
+      case JOB_WRITE:
+        notice(BMPERR_FLASHWRITE, "Flash write failed at 0x%x", (unsigned)job->address);
+        break;
+      case JOB_DONE:
+        notice(BMPERR_FLASHDONE, "Flash completion failed");
+        break;
+      case JOB_CRC:
+        notice(BMPERR_FLASHCRC, "Verification failed at 0x%x length 0x%x", (unsigned)job->address, (unsigned)job->size);
+        break;
+      }
+      /* collect the replies on the commands still in flight */
+      while (count-- > 0)
+        gdbrsp_recv(cmd, pktsize, 3000);
+      gdbrsp_clear();
+      result = false;
+      break;
+    }
+    if (job->type == JOB_WRITE) {
+      bmp->FlashBytes += job->size;
+      bmp_progress_step(job->size);
+    }
+  }
+  if (result)
+    bmp_progress_step(1);
+  free(list.jobs);
+  return result;
+}
+
+/** bmp_download_image() downloads an image (see bmp_image_create()) into the
+ *  Flash memory of the target.
+ *
+ *  \param image        The image with the loadable segments of the ELF file.
+ *  \param differential If true, only the Flash sectors whose contents differ
+ *                      from the image are erased and written; otherwise, all
+ *                      sectors that hold segment data are erased.
+ *
+ *  \return true on success, false on failure. Status and error messages are
+ *          passed via the callback.
+ *
+ *  \note With an overlapped download (see bmp_setflashoverlap()), the written
+ *        data is verified as part of the download.
+ *  \note Directly after bmp_fullerase() or bmp_masserase(), no sectors are
+ *        erased, and the "differential" parameter is ignored.
+ */
+bool bmp_download_image(BMP_IMAGE *image, bool differential)
+{
+  BMP_CONTEXT *bmp = context();
+  bmp_progress_reset(0);
+  if (!bmp_isopen()) {
+    notice(BMPERR_NOCONNECT, "Not connected to Black Magic Probe");
+    return false;
+  }
+  if (bmp_flashtotal() == 0) {
+    notice(BMPERR_NOFLASH, "No Flash memory record");
+    return false;
+  }
+  int pktsize = (bmp->PacketSize > 0) ? bmp->PacketSize : 64;
+  char *cmd = malloc((pktsize + 16) * sizeof(char));
+  assert(image != NULL);
+  if (cmd == NULL || !image_prepare(image, pktsize)) {
+    notice(BMPERR_MEMALLOC, "Memory allocation error");
+    if (cmd != NULL)
+      free(cmd);
+    return false;
+  }
+
+  unsigned long progress_range = 0;
+  const IMGREGION *rgn;
+  for (rgn = image->regions.next; rgn != NULL; rgn = rgn->next)
+    if (rgn->loaded > 0)
+      progress_range += rgn->loaded + 1;
+  bmp_progress_reset(progress_range);
+  unsigned long tstamp_start = timestamp();
+  bmp->FlashBytes = 0;
+  image->verified = false;
+  if (bmp->FlashBlank)
+    differential = false; /* nothing to compare against */
+  bool overlapped = FlashOverlap && bmp->NoAckMode && !differential;
+  bool blank = bmp->FlashBlank;
+  bmp->FlashBlank = false;  /* no longer blank, whatever the result */
+
+  for (rgn = image->regions.next; rgn != NULL; rgn = rgn->next) {
+    if (rgn->loaded == 0)
+      continue; /* no segment fitting in this Flash region */
+    if (differential) {
+      if (!flash_difference(cmd, pktsize, rgn)) {
+        free(cmd);
+        return false;
+      }
+      continue;
+    }
+    if (overlapped) {
+      list_segments(image, rgn);
+      if (!flash_overlapped(cmd, pktsize, rgn, !blank)) {
+        free(cmd);
+        return false;
+      }
+      continue;
+    }
+    /* erase the Flash memory (if not done already) */
+    if (!blank && !flash_sparse_erase(cmd, pktsize, rgn)) {
+      free(cmd);
+      return false;
+    }
+    bmp_progress_step(1);
+    /* download the payload */
+    list_segments(image, rgn);
+    if (!packets_write(cmd, pktsize, &rgn->packets, false)) {
+      free(cmd);
+      return false;
+    }
+    gdbrsp_xmit("vFlashDone", -1);
+    int rcvd = gdbrsp_recv(cmd, pktsize, 500);
+    if (rcvd != 2 || memcmp(cmd, "OK", rcvd)!= 0) {
+      notice(BMPERR_FLASHDONE, "Flash completion failed");
+      free(cmd);
+      return false;
+    }
+  }
+
+  if (overlapped) {
+    image->verified = true;
+    notice(BMPSTAT_SUCCESS, "Verification successful");
+  }
+  if (bmp->FlashBytes > 0) {
+    unsigned long elapsed = timestamp() - tstamp_start;
+    if (elapsed == 0)
+      elapsed = 1;
+    notice(BMPSTAT_NOTICE, "Written %lu bytes in %lu ms (%lu bytes/s, window %d)",
+           bmp->FlashBytes, elapsed, (bmp->FlashBytes * 1000) / elapsed, bmp->NoAckMode ? flash_window() : 1);
+  }
+  free(cmd);
+  return true;
+}
+
+/** bmp_image_verified() returns whether the most recent download of the image
+ *  was verified as part of the download, so that a separate verification can
+ *  be skipped.
+ */
+bool bmp_image_verified(const BMP_IMAGE *image)
+{
+  assert(image != NULL);
+  return image->verified;
+}
+
+/** bmp_image_erasesize() returns the number of bytes that a (non-differential)
+ *  download of the image erases: the sum of the sectors that hold segment
+ *  data. The target must be attached, because the sector layout comes from
+ *  the memory map of the target.
+ *
+ *  \return The size in bytes, or 0 on failure.
+ */
+unsigned long bmp_image_erasesize(BMP_IMAGE *image)
+{
+  BMP_CONTEXT *bmp = context();
+  assert(image != NULL);
+  int pktsize = (bmp->PacketSize > 0) ? bmp->PacketSize : 64;
+  if (!image_prepare(image, pktsize))
+    return 0;
+  unsigned long total = 0;
+  for (const IMGREGION *rgn = image->regions.next; rgn != NULL; rgn = rgn->next)
+    if (rgn->loaded > 0)
+      total += sparse_size(rgn);
+  return total;
+}
+
+/** bmp_download() downloads the loadable segments of the ELF file into the
+ *  Flash memory of the target.
+ *
+ *  \param fp           The ELF file.
+ *  \param differential If true, only the Flash sectors whose contents differ
+ *                      from the ELF file are erased and written; otherwise, all
+ *                      sectors that hold segment data are erased.
+ *
+ *  \return true on success, false on failure. Status and error messages are
+ *          passed via the callback.
+ *
+ *  \note To download the same file repeatedly, it is more efficient to create
+ *        an image with bmp_image_create() and use bmp_download_image().
+ */
+bool bmp_download(FILE *fp, bool differential)
+{
+  assert(fp != NULL);
+  BMP_IMAGE *image = bmp_image_create(fp);
+  if (image == NULL) {
+    notice(BMPERR_MEMALLOC, "Memory allocation error");
+    return false;
+  }
+  bool result = bmp_download_image(image, differential);
+  bmp_image_delete(image);
+  return result;
+}
+
+/** bmp_verify_image() compares the CRC of each segment in the image that is
+ *  located in Flash memory, with the CRC that the target calculates over the
+ *  same range.
+ *
+ *  \return true if all segments match, false on a mismatch or an error.
+ */
+bool bmp_verify_image(const BMP_IMAGE *image)
+{
+  BMP_CONTEXT *bmp = context();
+  if (!bmp_isopen()) {
+    notice(BMPERR_NOCONNECT, "Not connected to Black Magic Probe");
+    return 0;
+  }
+
+  /* run over all segments in the image */
+  bool allmatch = true;
+  assert(image != NULL);
+  for (int idx = 0; idx < image->segmentcount; idx++) {
+    const IMGSEGMENT *seg = &image->segments[idx];
+    /* check that the segment falls within a Flash memory sector */
+    const MEMBLOCK *rgn;
+    for (rgn = bmp->FlashRegions.next; rgn != NULL; rgn = rgn->next)
+      if (seg->address >= rgn->address && seg->address < rgn->address + rgn->size)
+        break;
+    if (rgn == NULL)
+      continue; /* segment is outside of any Flash sector */
+    /* request CRC from Black Magic Probe */
+    char cmd[100];
+    sprintf(cmd, "qCRC:%lx,%lx", seg->address, seg->size);
+    gdbrsp_xmit(cmd, -1);
+    size_t rcvd = gdbrsp_recv(cmd, sizearray(cmd), 3000);
+    cmd[rcvd] = '\0';
+    unsigned crc_tgt = (rcvd >= 2 && cmd[0] == 'C') ? strtoul(cmd + 1, NULL, 16) : 0;
+    if (crc_tgt != seg->crc) {
+      notice(BMPERR_FLASHCRC, "Segment %d data mismatch", seg->index);
+      allmatch = false;
+    }
+  }
+  if (allmatch)
+    notice(BMPSTAT_SUCCESS, "Verification successful");
+
+  return allmatch;
+}
+
+/** bmp_verify() compares the CRC of each segment in the ELF file that is
+ *  located in Flash memory, with the CRC of the same range in the target.
+ *
+ *  \return true if all segments match, false on a mismatch or an error.
+ */
+bool bmp_verify(FILE *fp)
+{
+  assert(fp != NULL);
+  BMP_IMAGE *image = bmp_image_create(fp);
+  if (image == NULL) {
+    notice(BMPERR_MEMALLOC, "Memory allocation failure");
+    return false;
+  }
+  bool result = bmp_verify_image(image);
+  bmp_image_delete(image);
+  return result;
+}
+
+/** bmp_download_ram() writes the loadable segments of an image into the RAM
+ *  of the target, for firmware that is linked to run from RAM. There are no
+ *  erase cycles: the segments are written with binary "X" packets (pipelined
+ *  in no-ack mode, like a Flash download), and the CRC of each segment is
+ *  checked afterwards.
+ *
+ *  \param image    The image with the loadable segments of the ELF file.
+ *
+ *  \return true on success, false on failure (this includes an image with a
+ *          segment in Flash memory). Status and error messages are passed via
+ *          the callback.
+ *
+ *  \note On success, the image is marked as verified, see bmp_image_verified().
+ *        The code is started with bmp_run_ram().
+ */
+bool bmp_download_ram(BMP_IMAGE *image)
+{
+  BMP_CONTEXT *bmp = context();
+  bmp_progress_reset(0);
+  if (!bmp_isopen()) {
+    notice(BMPERR_NOCONNECT, "Not connected to Black Magic Probe");
+    return false;
+  }
+  assert(image != NULL);
+  image->verified = false;
+  if (image->segmentcount == 0) {
+    notice(BMPERR_RAMWRITE, "No loadable segments in the image");
+    return false;
+  }
+
+  /* none of the segments may overlap Flash memory */
+  unsigned long progress_range = 0;
+  int idx;
+  for (idx = 0; idx < image->segmentcount; idx++) {
+    const IMGSEGMENT *seg = &image->segments[idx];
+    for (const MEMBLOCK *rgn = bmp->FlashRegions.next; rgn != NULL; rgn = rgn->next) {
+      if (seg->address < rgn->address + rgn->size && seg->address + seg->size > rgn->address) {
+        notice(BMPERR_RAMWRITE, "Segment %d at 0x%x is in Flash memory (not linked for RAM)", seg->index, (unsigned)seg->address);
+        return false;
+      }
+    }
+    progress_range += seg->size;
+  }
+
+  int pktsize = (bmp->PacketSize > 0) ? bmp->PacketSize : 64;
+  char *cmd = malloc((pktsize + 16) * sizeof(char));
+  PACKETLIST list;
+  memset(&list, 0, sizeof list);
+  bool result = (cmd != NULL);
+  for (idx = 0; result && idx < image->segmentcount; idx++) {
+    const IMGSEGMENT *seg = &image->segments[idx];
+    result = packets_add(&list, seg->address, seg->data, seg->size, pktsize, true);
+  }
+  if (!result) {
+    notice(BMPERR_MEMALLOC, "Memory allocation error");
+    packets_cleanup(&list);
+    if (cmd != NULL)
+      free(cmd);
+    return false;
+  }
+
+  bmp_progress_reset(progress_range + 1);
+  unsigned long tstamp_start = timestamp();
+  bmp->FlashBytes = 0;
+  for (idx = 0; idx < image->segmentcount; idx++) {
+    const IMGSEGMENT *seg = &image->segments[idx];
+    notice(BMPSTAT_NOTICE, "%d: %s segment at 0x%x length 0x%x", seg->index, seg->isdata ? "Data" : "Code", (unsigned)seg->address, (unsigned)seg->size);
+  }
+  result = packets_write(cmd, pktsize, &list, true);
+  packets_cleanup(&list);
+
+  /* check the CRC of every segment */
+  for (idx = 0; result && idx < image->segmentcount; idx++) {
+    const IMGSEGMENT *seg = &image->segments[idx];
+    sprintf(cmd, "qCRC:%lx,%lx", seg->address, seg->size);
+    gdbrsp_xmit(cmd, -1);
+    size_t rcvd = gdbrsp_recv(cmd, pktsize, 3000);
+    if (rcvd >= (size_t)pktsize)
+      rcvd = pktsize - 1;
+    cmd[rcvd] = '\0';
+    if (rcvd < 2 || cmd[0] != 'C' || strtoul(cmd + 1, NULL, 16) != seg->crc) {
+      notice(BMPERR_RAMWRITE, "Segment %d data mismatch", seg->index);
+      result = false;
+    }
+  }
+  if (result) {
+    image->verified = true;
+    bmp_progress_step(1);
+    notice(BMPSTAT_SUCCESS, "Verification successful");
+    unsigned long elapsed = timestamp() - tstamp_start;
+    if (elapsed == 0)
+      elapsed = 1;
+    notice(BMPSTAT_NOTICE, "Written %lu bytes in %lu ms (%lu bytes/s, window %d)",
+           bmp->FlashBytes, elapsed, (bmp->FlashBytes * 1000) / elapsed, bmp->NoAckMode ? flash_window() : 1);
+  }
+  free(cmd);
+  return result;
+}
+
+/* register_write() sets a register of the (halted) target; the register
+   number is that of the target description (13 = SP, 15 = PC, 16 = xPSR) */
+static bool register_write(int reg, uint32_t value)
+{
+  char cmd[32];
+  sprintf(cmd, "P%x=%02x%02x%02x%02x", reg, (unsigned)(value & 0xff), (unsigned)((value >> 8) & 0xff),
+          (unsigned)((value >> 16) & 0xff), (unsigned)((value >> 24) & 0xff));
+  gdbrsp_xmit(cmd, -1);
+  size_t rcvd = gdbrsp_recv(cmd, sizearray(cmd), 500);
+  return (rcvd == 2 && memcmp(cmd, "OK", rcvd) == 0);
+}
+
+/** bmp_run_ram() starts the code of an image that was downloaded with
+ *  bmp_download_ram(). The initial stack pointer and the reset vector are
+ *  read from the vector table at the start of the image (the segment at the
+ *  lowest address), and the vector table offset register is set to point to
+ *  it. The debug probe then detaches from the target, so that the target
+ *  resumes at the reset vector.
+ *
+ *  \param image    The image that was downloaded.
+ *
+ *  \return true on success, false on failure. Status and error messages are
+ *          passed via the callback.
+ *
+ *  \note The target must be halted, preferably in its reset state (e.g. by
+ *        attaching with a reset), because only SP, PC and xPSR are set.
+ */
+bool bmp_run_ram(const BMP_IMAGE *image)
+{
+  if (!bmp_isopen()) {
+    notice(BMPERR_NOCONNECT, "Not connected to Black Magic Probe");
+    return false;
+  }
+  assert(image != NULL);
+  const IMGSEGMENT *vectors = NULL;
+  for (int idx = 0; idx < image->segmentcount; idx++)
+    if (vectors == NULL || image->segments[idx].address < vectors->address)
+      vectors = &image->segments[idx];
+  if (vectors == NULL || vectors->size < 8) {
+    notice(BMPERR_RAMWRITE, "No vector table in the image");
+    return false;
+  }
+  uint32_t sp = vectors->data[0] | (vectors->data[1] << 8) | (vectors->data[2] << 16) | ((uint32_t)vectors->data[3] << 24);
+  uint32_t pc = vectors->data[4] | (vectors->data[5] << 8) | (vectors->data[6] << 16) | ((uint32_t)vectors->data[7] << 24);
+  if ((pc & 1) == 0 || (sp & 3) != 0) {
+    notice(BMPERR_RAMWRITE, "Invalid vector table at 0x%x", (unsigned)vectors->address);
+    return false;
+  }
+
+  /* set VTOR, so that interrupts use the vector table in RAM; the register is
+     optional on ARMv6-M, so a failure is ignored */
+  char cmd[32];
+  sprintf(cmd, "X%x,4:", 0xE000ED08u);
+  size_t len = strlen(cmd);
+  for (int idx = 0; idx < 4; idx++)
+    cmd[len + idx] = (char)((vectors->address >> (8 * idx)) & 0xff);
+  gdbrsp_xmit(cmd, len + 4);
+  gdbrsp_recv(cmd, sizearray(cmd), 500);
+
+  if (!register_write(13, sp) || !register_write(15, pc & ~1) || !register_write(16, 0x01000000)) {
+    notice(BMPERR_RAMWRITE, "Failed to set the registers for the RAM image");
+    return false;
+  }
+  notice(BMPSTAT_NOTICE, "Starting at 0x%x, stack at 0x%x", (unsigned)(pc & ~1), (unsigned)sp);
+  return bmp_detach(false);
+}
+
+/** bmp_readmemory() reads a block of target memory. The block is split in
+ *  requests that fit in the packet size of the probe, and in no-ack mode,
+ *  these requests are pipelined. Binary "x" packets are used if the probe
+ *  supports these, and hexadecimal "m" packets otherwise.
+ *
+ *  \param address   The start address in target memory.
+ *  \param buffer    The buffer that receives the data.
+ *  \param size      The number of bytes to read.
+ *
+ *  \return true on success, false on failure.
+ */
+bool bmp_readmemory(unsigned long address, unsigned char *buffer, size_t size)
+{
+  BMP_CONTEXT *bmp = context();
+  assert(buffer != NULL || size == 0);
+  if (!bmp_isopen()) {
+    notice(BMPERR_NOCONNECT, "Not connected to Black Magic Probe");
+    return false;
+  }
+
+  /* the chunk size is chosen such that the reply fits in a packet, even if
+     every byte in a binary reply must be escaped */
+  int pktsize = (bmp->PacketSize > 0) ? bmp->PacketSize : 64;
+  size_t chunk = (pktsize - 16) / 2;
+  assert(chunk > 0);
+  char *reply = malloc((pktsize + 16) * sizeof(char));
+  if (reply == NULL) {
+    notice(BMPERR_MEMALLOC, "Memory allocation failure");
+    return false;
+  }
+
+  int window = bmp->NoAckMode ? flash_window() : 1;
+  assert(window >= 1 && window <= FLASH_WINDOW_MAX);
+  char cmd[32];
+  size_t sent = 0, rcvd = 0;
+  int count = 0;
+  bool result = true;
+  while (rcvd < size && result) {
+    /* fill the window (the requests go out in a single write) */
+    gdbrsp_batch(true);
+    while (sent < size && count < window) {
+      size_t numbytes = (size - sent < chunk) ? size - sent : chunk;
+      sprintf(cmd, "%c%08lX,%X", bmp->BinaryUpload ? 'x' : 'm', address + sent, (unsigned)numbytes);
+      gdbrsp_xmit(cmd, -1);
+      sent += numbytes;
+      count++;
+    }
+    gdbrsp_batch(false);
+    /* handle the reply on the oldest request */
+    size_t numbytes = (size - rcvd < chunk) ? size - rcvd : chunk;
+    size_t len = gdbrsp_recv(reply, pktsize + 16, 1000);
+    if (bmp->BinaryUpload) {
+      result = (len == numbytes + 1 && reply[0] == 'b');
+      if (result)
+        memcpy(buffer + rcvd, reply + 1, numbytes);
+    } else {
+      result = (len == 2 * numbytes);
+      if (result) {
+        reply[len] = '\0';
+        result = gdbrsp_hex2array(reply, buffer + rcvd, numbytes);
+      }
+    }
+    rcvd += numbytes;
+    count--;
+  }
+  /* on failure, drain the replies on the requests that are still in flight */
+  while (count-- > 0)
+    gdbrsp_recv(reply, pktsize + 16, 1000);
+  free((void*)reply);
+  if (!result)
+    notice(BMPERR_MEMREAD, "Memory read failed at 0x%lx", address + rcvd);
+  return result;
+}
+
+/** bmp_enabletrace() code enables trace in the Black Magic Probe.
+ *  \param async_bitrate  [IN] The bitrate for ASYNC mode; set to 0 for
+ *                        manchester mode.
+ *  \param endpoint       [OUT] The endpoint for the SWO trace is copied into
+ *                        this parameter. This parameter may be NULL.
+ *
+ *  \return 1 on success, 0 on failure.
+ */
+int bmp_enabletrace(int async_bitrate, unsigned char *endpoint)
+{
+  char buffer[100], *ptr;
+  int rcvd, ok, retry;
+
+  if (!bmp_isopen()) {
+    notice(BMPERR_NOCONNECT, "Not connected to Black Magic Probe");
+    return 0;
+  }
+
+  for (retry = 3; retry > 0; retry--) {
+    if (async_bitrate > 0)  {
+      sprintf(buffer, "qRcmd,traceswo %d", async_bitrate);
+      gdbrsp_xmit(buffer, -1);
+    } else {
+      gdbrsp_xmit("qRcmd,traceswo", -1);
+    }
+    rcvd = gdbrsp_recv(buffer, sizearray(buffer), 1000);
+    if (rcvd > 0)
+      break;
+  }
+  /* a correct answer starts with 'o' and contains a serial number, the
+     interface for trace capture (0x05) and the endpoint (0x85, on the original
+     Black Magic Probe) */
+  buffer[rcvd] = '\0';
+  ok = ((ptr = strchr(buffer, ':')) != NULL && strtol(ptr + 1, &ptr, 16) == BMP_IF_TRACE && *ptr == ':');
+  if (ok) {
+    long ep = strtol(ptr + 1, NULL, 16);
+    ok = (ep > 0x80); /* this must be an IN enpoint, so high bit must be set */
+    if (endpoint != NULL)
+      *endpoint = (unsigned char)ep;
+  }
+  if (!ok) {
+    notice(BMPERR_MONITORCMD, "Trace setup failed");
+    return 0;
+  }
+  return 1;
+}
+
+int bmp_restart(void)
+{
+  char buffer[100];
+  int rcvd;
+
+  if (!bmp_isopen()) {
+    notice(BMPERR_NOCONNECT, "Not connected to Black Magic Probe");
+    return 0;
+  }
+
+  gdbrsp_xmit("vRun;", -1);
+  rcvd = gdbrsp_recv(buffer, sizearray(buffer), 3000);
+  buffer[rcvd] = '\0';
+  if (buffer[0] == 'E')
+    return 0;
   gdbrsp_xmit("c", -1);
   return 1;
 }
@@ -1037,91 +2598,345 @@ int bmp_restart(void)
  it will return with the "stop code" T02 (including header and checksum).
 */
 
-/** bmp_runscript() executes a script with memory/register assignments, e.g.
- *  for device-specific initialization.
- *
- *  \param name     The name of the script.
- *  \param mcu      The name of the MCU driver (the MCU family name). This
- *                  parameter must be valid.
- *  \param arch     The name of the ARM Cortex architecture (M0, M3, etc.). This
- *                  parameter may be NULL.
- *  \param params   An optional array with parameters to the script, this number
- *                  of required parameters depends on the stript. This parameter
- *                  may be NULL if the script needs no parameters at all.
- *
- *  \return true on success, false on failure.
- *
- *  \note If the script returns a value, this is stored in params[0] on return.
- *        Thus, a script that has a result, should have a "params" parameter for
- *        at least one element.
- */
-bool bmp_runscript(const char *name, const char *mcu, const char *arch, unsigned long *params, size_t paramcount)
+#define SCRIPT_MAXSTEPS 32  /* number of script lines that are compiled & run in one batch */
+#define SCRIPT_MAXBLOCK 32  /* max. size of a combined read or write (in bytes) */
+
+typedef struct tagSCRIPTSTEP {  /* compiled script line */
+  uint32_t address;   /* destination address */
+  uint32_t source;    /* source address, for a value that is read from memory */
+  uint32_t andmask;   /* new value = (current & andmask) | ormask */
+  uint32_t ormask;
+  uint32_t current;   /* current value at the destination (for read-modify-write) */
+  uint32_t value;     /* value read from the source address */
+  uint16_t oper;      /* one of the OP_xxx values */
+  uint8_t size;       /* size of the destination in bytes */
+  uint8_t srcsize;    /* size of the source in bytes */
+  uint8_t flags;      /* STEP_xxx */
+} SCRIPTSTEP;
+
+#define STEP_READDEST   0x01  /* read-modify-write of the destination */
+#define STEP_READSOURCE 0x02  /* value must be read from the source address */
+#define STEP_RESULT     0x04  /* value is the script result (no write) */
+#define STEP_READY      0x08  /* values have been read */
+
+/* script_setmasks() converts an operation on a value to the masks for a
+   read-modify-write */
+static void script_setmasks(SCRIPTSTEP *step, uint16_t oper, uint32_t value)
+{
+  assert(step != NULL);
+  switch (oper) {
+  case OP_MOV:
+    step->andmask = 0;
+    step->ormask = value;
+    break;
+  case OP_ORR:
+    step->andmask = ~(uint32_t)0;
+    step->ormask = value;
+    break;
+  case OP_AND:
+    step->andmask = value;
+    step->ormask = 0;
+    break;
+  case OP_AND_INV:
+    step->andmask = ~value;
+    step->ormask = 0;
+    break;
+  default:
+    assert(0);
+  }
+}
+
+/* script_compile() translates the next lines of a script to steps, with the
+   parameters filled in; a read-modify-write that directly follows another one
+   on the same register is folded into it, so that the register is read and
+   written only once
+   returns the number of steps, which is zero at the end of the script */
+static size_t script_compile(const char *name, const unsigned long *params, size_t paramcount,
+                             SCRIPTSTEP *steps, size_t maxsteps)
 {
-  bmscript_clearcache();
-  bmscript_load(mcu, arch);  /* very quick if the scripts for the MCU are already in memory */
-  bool result = true;
   OPERAND lvalue, rvalue;
   uint16_t oper;
-  while (result && bmscript_line(name, &oper, &lvalue, &rvalue)) {
-    bool copyresult = false;
+  size_t count = 0;
+
+  assert(steps != NULL);
+  while (count < maxsteps && bmscript_line(name, &oper, &lvalue, &rvalue)) {
+    SCRIPTSTEP *step = &steps[count];
+    memset(step, 0, sizeof(SCRIPTSTEP));
     if (lvalue.type == OT_PARAM) {
       if (params == NULL)
         continue;
       if (lvalue.data < paramcount)
         lvalue.data = (uint32_t)params[lvalue.data];  /* replace address parameter */
       else if (lvalue.data == ~0)
-        copyresult = true;  /* special "$" parameter */
+        step->flags |= STEP_RESULT;                   /* special "$" parameter */
       else
         continue;           /* ignore row on invalid parameter */
     }
-    char cmd[100];
-    size_t len = 0;
-    if (oper == OP_ORR || oper == OP_AND || oper == OP_AND_INV) {
-      uint32_t cur = 0;
-      uint8_t bytes[4] = { 0, 0, 0, 0 };
-      sprintf(cmd, "m%08X,%X:", lvalue.data, lvalue.size);
-      gdbrsp_xmit(cmd, -1);
-      len = gdbrsp_recv(cmd, sizearray(cmd), 1000);
-      cmd[len] = '\0';
-      gdbrsp_hex2array(cmd, bytes, sizearray(bytes));
-      memmove(&cur, bytes, lvalue.size);
-      if (oper == OP_ORR)
-        rvalue.data |= cur;
-      else if (oper == OP_AND)
-        rvalue.data &= cur;
-      else if (oper == OP_AND_INV)
-        rvalue.data &= ~cur;
-    }
     if (rvalue.type == OT_PARAM) {
       if (params != NULL && rvalue.data < paramcount)
-        rvalue.data = (uint32_t)params[rvalue.data];  /* replace address parameter */
+        rvalue.data = (uint32_t)params[rvalue.data];  /* replace value parameter */
       else
         continue; /* ignore row on invalid parameter */
       if (rvalue.pshift > 0)
         rvalue.data <<= rvalue.pshift;
       rvalue.data |= rvalue.plit;
-    } else if (rvalue.type == OT_ADDRESS) {
-      uint8_t bytes[4] = { 0, 0, 0, 0 };
-      sprintf(cmd, "m%08X,%X:", rvalue.data, rvalue.size);
+    }
+    step->address = lvalue.data;
+    step->size = lvalue.size;
+    step->oper = oper;
+    if (rvalue.type == OT_ADDRESS) {
+      step->source = rvalue.data;
+      step->srcsize = rvalue.size;
+      step->flags |= STEP_READSOURCE;
+    } else {
+      script_setmasks(step, oper, rvalue.data);
+    }
+    if (oper != OP_MOV && !(step->flags & STEP_RESULT))
+      step->flags |= STEP_READDEST;
+
+    if (count > 0 && step->flags == STEP_READDEST) {
+      SCRIPTSTEP *prev = &steps[count - 1];
+      if (prev->flags == STEP_READDEST && prev->address == step->address && prev->size == step->size) {
+        /* ((cur & a1) | o1) & a2 | o2  ==  (cur & a1 & a2) | ((o1 & a2) | o2) */
+        prev->ormask = (prev->ormask & step->andmask) | step->ormask;
+        prev->andmask &= step->andmask;
+        continue;
+      }
+    }
+    count++;
+  }
+
+  return count;
+}
+
+/* script_recv_ok() checks the reply on a write (an "X" packet) */
+static bool script_recv_ok(char *cmd, size_t size)
+{
+  size_t len = gdbrsp_recv(cmd, size, 1000);
+  return (len == 2 && memcmp(cmd, "OK", len) == 0);
+}
+
+/* script_read() reads the values for a range of steps, where only the last
+   step may write; reads of adjacent registers are combined into a single "m"
+   packet; in no-ack mode, all packets are sent before waiting for a reply,
+   and the replies on any writes that are still in flight come first */
+static bool script_read(SCRIPTSTEP *steps, size_t count, unsigned *pending, bool pipeline)
+{
+  struct {
+    uint32_t address;
+    uint8_t size;
+    uint32_t *value;
+  } reads[2 * SCRIPT_MAXSTEPS];
+  struct {
+    uint32_t address;
+    size_t size;
+    unsigned first, last;   /* range of reads that this block covers */
+  } blocks[2 * SCRIPT_MAXSTEPS];
+  char cmd[2 * SCRIPT_MAXBLOCK + 32];
+  unsigned numreads = 0, numblocks = 0;
+  bool result = true;
+
+  assert(steps != NULL && count > 0 && count <= SCRIPT_MAXSTEPS);
+  assert(pending != NULL);
+  for (size_t idx = 0; idx < count; idx++) {
+    SCRIPTSTEP *step = &steps[idx];
+    step->current = step->value = 0;
+    if (step->flags & STEP_READDEST) {
+      reads[numreads].address = step->address;
+      reads[numreads].size = step->size;
+      reads[numreads].value = &step->current;
+      numreads++;
+    }
+    if (step->flags & STEP_READSOURCE) {
+      reads[numreads].address = step->source;
+      reads[numreads].size = step->srcsize;
+      reads[numreads].value = &step->value;
+      numreads++;
+    }
+  }
+
+  /* merge reads of adjacent (or overlapping) registers */
+  for (unsigned idx = 0; idx < numreads; idx++) {
+    uint32_t low = reads[idx].address;
+    uint32_t high = low + reads[idx].size;
+    if (numblocks > 0) {
+      uint32_t blk_low = blocks[numblocks - 1].address;
+      uint32_t blk_high = blk_low + (uint32_t)blocks[numblocks - 1].size;
+      if (low <= blk_high && high >= blk_low) {
+        if (blk_low < low)
+          low = blk_low;
+        if (blk_high > high)
+          high = blk_high;
+        if (high - low <= SCRIPT_MAXBLOCK) {
+          blocks[numblocks - 1].address = low;
+          blocks[numblocks - 1].size = high - low;
+          blocks[numblocks - 1].last = idx;
+          continue;
+        }
+        low = reads[idx].address;
+        high = low + reads[idx].size;
+      }
+    }
+    blocks[numblocks].address = low;
+    blocks[numblocks].size = high - low;
+    blocks[numblocks].first = blocks[numblocks].last = idx;
+    numblocks++;
+  }
+
+  unsigned blk = 0;
+  while (blk < numblocks) {
+    /* in ack mode, the transmit function waits for the acknowledge, so each
+       request must be handled before the next can be sent */
+    unsigned sent = blk;
+    do {
+      sprintf(cmd, "m%08X,%X:", blocks[sent].address, (unsigned)blocks[sent].size);
       gdbrsp_xmit(cmd, -1);
-      len = gdbrsp_recv(cmd, sizearray(cmd), 1000);
+      sent++;
+    } while (pipeline && sent < numblocks);
+    while (*pending > 0) {
+      if (!script_recv_ok(cmd, sizearray(cmd)))
+        result = false;
+      *pending -= 1;
+    }
+    for ( ; blk < sent; blk++) {
+      uint8_t bytes[SCRIPT_MAXBLOCK];
+      size_t len = gdbrsp_recv(cmd, sizearray(cmd), 1000);
+      if (len != 2 * blocks[blk].size) {
+        result = false;   /* error reply, or no reply at all */
+        continue;
+      }
       cmd[len] = '\0';
-      gdbrsp_hex2array(cmd, bytes, sizearray(bytes));
-      memmove(&rvalue.data, bytes, rvalue.size);
+      if (!gdbrsp_hex2array(cmd, bytes, sizearray(bytes))) {
+        result = false;
+        continue;
+      }
+      for (unsigned idx = blocks[blk].first; idx <= blocks[blk].last; idx++)
+        memmove(reads[idx].value, bytes + (reads[idx].address - blocks[blk].address), reads[idx].size);
+    }
+  }
+
+  for (size_t idx = 0; idx < count; idx++) {
+    SCRIPTSTEP *step = &steps[idx];
+    if (step->flags & STEP_READSOURCE)
+      script_setmasks(step, step->oper, step->value);
+    step->flags |= STEP_READY;
+  }
+  return result;
+}
+
+/* script_run() executes the compiled steps; in no-ack mode, writes are sent
+   without waiting for the reply (up to the same number of packets in flight
+   as for Flash programming), and writes to consecutive 32-bit registers are
+   combined in a single "X" packet
+   reads are never moved in front of a write that precedes them in the script,
+   because a write may change what the read returns (e.g. a clock enable) */
+static bool script_run(SCRIPTSTEP *steps, size_t count, unsigned long *params)
+{
+  BMP_CONTEXT *bmp = context();
+  bool pipeline = bmp->NoAckMode;
+  unsigned window = pipeline ? (unsigned)flash_window() : 1;
+  unsigned pending = 0;   /* number of writes in flight */
+  char cmd[2 * SCRIPT_MAXBLOCK + 32];
+  bool result = true;
+
+  assert(steps != NULL);
+  gdbrsp_batch(pipeline); /* pipelined writes are sent together, at the next read */
+  size_t idx = 0;
+  while (idx < count && result) {
+    SCRIPTSTEP *step = &steps[idx];
+    if ((step->flags & (STEP_READDEST | STEP_READSOURCE)) && !(step->flags & STEP_READY)) {
+      /* reads may be combined up to (and including) the first step that writes */
+      size_t end = idx;
+      do {
+        end++;
+      } while (end < count && (steps[end - 1].flags & STEP_RESULT)
+               && (steps[end].flags & (STEP_READDEST | STEP_READSOURCE)));
+      if (!script_read(step, end - idx, &pending, pipeline)) {
+        result = false;
+        break;
+      }
     }
-    if (copyresult) {
+
+    uint32_t value = (step->current & step->andmask) | step->ormask;
+    if (step->flags & STEP_RESULT) {
       assert(params != NULL);
-      params[0] = rvalue.data;
-      result = true;
-    } else {
-      sprintf(cmd, "X%08X,%X:", lvalue.data, lvalue.size);
-      len = strlen(cmd);
-      memmove(cmd + len, &rvalue.data, rvalue.size);
-      gdbrsp_xmit(cmd, len + rvalue.size);
-      len = gdbrsp_recv(cmd, sizearray(cmd), 1000);
-      result = (len == 2 && memcmp(cmd, "OK", len) == 0);
+      params[0] = value;
+      idx++;
+      continue;
+    }
+
+    uint8_t data[SCRIPT_MAXBLOCK];
+    size_t size = step->size;
+    assert(size <= sizeof(value));
+    memmove(data, &value, size);
+    for (idx++; idx < count; idx++) {
+      const SCRIPTSTEP *next = &steps[idx];
+      if (step->size != 4 || (step->address & 3) != 0 || size + 4 > SCRIPT_MAXBLOCK
+          || next->size != 4 || next->address != step->address + size
+          || (next->flags & (STEP_READDEST | STEP_READSOURCE | STEP_RESULT)) != 0)
+        break;
+      value = next->ormask;     /* plain assignment, so andmask is zero */
+      memmove(data + size, &value, 4);
+      size += 4;
+    }
+    if (pending >= window) {
+      if (!script_recv_ok(cmd, sizearray(cmd)))
+        result = false;
+      pending -= 1;
     }
+    sprintf(cmd, "X%08X,%X:", step->address, (unsigned)size);
+    size_t len = strlen(cmd);
+    memmove(cmd + len, data, size);
+    gdbrsp_xmit(cmd, len + size);
+    if (pipeline)
+      pending += 1;
+    else if (!script_recv_ok(cmd, sizearray(cmd)))
+      result = false;
+  }
+
+  while (pending > 0) {
+    if (!script_recv_ok(cmd, sizearray(cmd)))
+      result = false;
+    pending -= 1;
   }
+  gdbrsp_batch(false);
+  if (!result && pipeline)
+    gdbrsp_clear();   /* drop any replies that arrive late */
+  return result;
+}
+
+/** bmp_runscript() executes a script with memory/register assignments, e.g.
+ *  for device-specific initialization.
+ *
+ *  \param name     The name of the script.
+ *  \param mcu      The name of the MCU driver (the MCU family name). This
+ *                  parameter must be valid.
+ *  \param arch     The name of the ARM Cortex architecture (M0, M3, etc.). This
+ *                  parameter may be NULL.
+ *  \param params   An optional array with parameters to the script, this number
+ *                  of required parameters depends on the stript. This parameter
+ *                  may be NULL if the script needs no parameters at all.
+ *
+ *  \return true on success, false on failure.
+ *
+ *  \note If the script returns a value, this is stored in params[0] on return.
+ *        Thus, a script that has a result, should have a "params" parameter for
+ *        at least one element.
+ *
+ *  \note The script is compiled before it runs, so that a sequence of writes
+ *        can be sent without waiting for each reply when the connection is in
+ *        no-ack mode.
+ */
+bool bmp_runscript(const char *name, const char *mcu, const char *arch, unsigned long *params, size_t paramcount)
+{
+  SCRIPTSTEP steps[SCRIPT_MAXSTEPS];
+  size_t count;
+  bool result = true;
+
+  bmscript_clearcache();
+  bmscript_load(mcu, arch);  /* very quick if the scripts for the MCU are already in memory */
+  while (result && (count = script_compile(name, params, paramcount, steps, sizearray(steps))) > 0)
+    result = script_run(steps, count, params);
 
   return result;
 }
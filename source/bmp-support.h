@@ -43,14 +43,24 @@ enum {
   BMPERR_FLASHWRITE = -10,/* Flash write failed */
   BMPERR_FLASHDONE  = -11,/* Flash programming completion failed */
   BMPERR_FLASHCRC   = -12,/* Flash CRC verification failed */
-  BMPERR_GENERAL    = -14,
+  BMPERR_RAMWRITE   = -13,/* RAM write (or RAM image check) failed */
+  BMPERR_MEMREAD    = -14,/* memory read failed */
+  BMPERR_GENERAL    = -15,
 };
 
+typedef struct tagBMP_CONTEXT BMP_CONTEXT;
+typedef struct tagBMP_IMAGE BMP_IMAGE;
+
 unsigned long bmp_flashtotal(void);
+bool bmp_flashregion(int index, unsigned long *address, unsigned long *size, unsigned *blocksize);
 
 typedef int (*BMP_STATCALLBACK)(int code, const char *message);
 void bmp_setcallback(BMP_STATCALLBACK func);
 
+BMP_CONTEXT *bmp_context_create(void);
+void bmp_context_delete(BMP_CONTEXT *ctx);
+void bmp_context_select(BMP_CONTEXT *ctx);
+
 bool bmp_connect(int probe, const char *ipaddress);
 bool bmp_disconnect(void);
 bool bmp_isopen(void);
@@ -67,8 +77,26 @@ bool bmp_detach(bool powerdown);
 
 int bmp_monitor(const char *command);
 int bmp_fullerase(void);
-bool bmp_download(FILE *fp);
+int bmp_masserase(void);
+void bmp_erasestats(unsigned long *bytes, unsigned long *ms);
+bool bmp_download(FILE *fp, bool differential);
+bool bmp_download_image(BMP_IMAGE *image, bool differential);
+void bmp_setflashwindow(int usbwindow, int tcpwindow);
+void bmp_setflashoverlap(bool enable);
 bool bmp_verify(FILE *fp);
+bool bmp_verify_image(const BMP_IMAGE *image);
+bool bmp_download_ram(BMP_IMAGE *image);
+bool bmp_run_ram(const BMP_IMAGE *image);
+bool bmp_readmemory(unsigned long address, unsigned char *buffer, size_t size);
+
+BMP_IMAGE *bmp_image_create(FILE *fp);
+bool bmp_image_append(BMP_IMAGE *image, FILE *fp);
+bool bmp_image_appendbinary(BMP_IMAGE *image, FILE *fp, unsigned long address);
+void bmp_image_delete(BMP_IMAGE *image);
+bool bmp_image_verified(const BMP_IMAGE *image);
+unsigned long bmp_image_erasesize(BMP_IMAGE *image);
+long bmp_image_find(const BMP_IMAGE *image, const unsigned char *pattern, size_t size);
+bool bmp_image_patch(BMP_IMAGE *image, unsigned long fileoffs, const unsigned char *data, size_t size);
 
 void bmp_progress_reset(unsigned long numsteps);
 void bmp_progress_step(unsigned long step);
@@ -1,1639 +1,2974 @@
-/*
- * Statistical Profiler for the Black Magic Probe, using the PC sampler of the
- * DWT/ITM modules of the Cortex debug architecture. This utility is built with
- * Nuklear for a cross-platform GUI.
- *
- * Copyright 2022-2023 CompuPhase
- *
- * Licensed under the Apache License, Version 2.0 (the "License");
- * you may not use this file except in compliance with the License.
- * You may obtain a copy of the License at
- *
- *     http://www.apache.org/licenses/LICENSE-2.0
- *
- * Unless required by applicable law or agreed to in writing, software
- * distributed under the License is distributed on an "AS IS" BASIS,
- * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
- * See the License for the specific language governing permissions and
- * limitations under the License.
- */
-
-#if defined WIN32 || defined _WIN32
-# define STRICT
-# define WIN32_LEAN_AND_MEAN
-# define _WIN32_WINNT   0x0500 /* for AttachConsole() */
-# include <windows.h>
-# include <io.h>
-# include <malloc.h>
-# if defined __MINGW32__ || defined __MINGW64__
-#   include "strlcpy.h"
-# elif defined _MSC_VER
-#   include "strlcpy.h"
-#   define access(p,m)       _access((p),(m))
-# endif
-#elif defined __linux__
-# include <alloca.h>
-# include <pthread.h>
-# include <unistd.h>
-# include <bsd/string.h>
-# include <sys/stat.h>
-# include <sys/time.h>
-#endif
-#include <assert.h>
-#include <stdbool.h>
-#include <stdio.h>
-#include <stdlib.h>
-#include <string.h>
-
-#include "bmcommon.h"
-#include "bmp-script.h"
-#include "bmp-scan.h"
-#include "bmp-support.h"
-#include "demangle.h"
-#include "dwarf.h"
-#include "elf.h"
-#include "gdb-rsp.h"
-#include "guidriver.h"
-#include "mcu-info.h"
-#include "minIni.h"
-#include "noc_file_dialog.h"
-#include "nuklear_guide.h"
-#include "nuklear_mousepointer.h"
-#include "nuklear_splitter.h"
-#include "nuklear_style.h"
-#include "nuklear_tooltip.h"
-#include "swotrace.h"
-#include "tcpip.h"
-#include "svnrev.h"
-
-#if defined FORTIFY
-# include <alloc/fortify.h>
-#endif
-
-#if defined __linux__ || defined __unix__
-# include "res/icon_profile_64.h"
-#endif
-
-#if !defined _MAX_PATH
-# define _MAX_PATH 260
-#endif
-
-#if !defined sizearray
-# define sizearray(e)    (sizeof(e) / sizeof((e)[0]))
-#endif
-
-#if defined WIN32 || defined _WIN32
-# define DIRSEP_CHAR '\\'
-# define IS_OPTION(s)  ((s)[0] == '-' || (s)[0] == '/')
-#else
-# define DIRSEP_CHAR '/'
-# define IS_OPTION(s)  ((s)[0] == '-')
-#endif
-
-
-static DWARF_LINELOOKUP dwarf_linetable = { NULL };
-static DWARF_SYMBOLLIST dwarf_symboltable = { NULL};
-static DWARF_PATHLIST dwarf_filetable = { NULL};
-
-#define WINDOW_WIDTH    700     /* default window size (window is resizable) */
-#define WINDOW_HEIGHT   400
-#define FONT_HEIGHT     14      /* default font size */
-#define ROW_HEIGHT      (1.6 * opt_fontsize)
-#define COMBOROW_CY     (0.9 * opt_fontsize)
-#define BROWSEBTN_WIDTH (1.5 * opt_fontsize)
-static float opt_fontsize = FONT_HEIGHT;
-
-
-int ctf_error_notify(int code, int linenr, const char *message)
-{
-  /* This function is not used in the profiler, but required as a dependency
-     due to the "swotrace" module */
-  (void)code;
-  (void)linenr;
-  (void)message;
-  return 0;
-}
-
-static int bmp_callback(int code, const char *message)
-{
-  tracelog_statusmsg(TRACESTATMSG_BMP, message, code);
-  return code >= 0;
-}
-
-static void usage(const char *invalid_option)
-{
-# if defined _WIN32  /* fix console output on Windows */
-    if (AttachConsole(ATTACH_PARENT_PROCESS)) {
-      freopen("CONOUT$", "wb", stdout);
-      freopen("CONOUT$", "wb", stderr);
-    }
-    printf("\n");
-# endif
-
-  if (invalid_option != NULL)
-    fprintf(stderr, "Unknown option %s; use -h for help.\n\n", invalid_option);
-  else
-    printf("BMProfile - Statistical Profiler for the Black Magic Probe.\n\n");
-  printf("Usage: bmprofile [options] [filename]\n\n"
-         "Options:\n"
-         "-f=value  Font size to use (value must be 8 or larger).\n"
-         "-h        This help.\n\n"
-         "filename  Path to the ELF file to profile (must contain debug info).\n"
-         "-v        Show version information.\n");
-}
-
-static void version(void)
-{
-# if defined _WIN32  /* fix console output on Windows */
-    if (AttachConsole(ATTACH_PARENT_PROCESS)) {
-      freopen("CONOUT$", "wb", stdout);
-      freopen("CONOUT$", "wb", stderr);
-    }
-    printf("\n");
-# endif
-
-  printf("BMProfile version %s.\n", SVNREV_STR);
-  printf("Copyright 2022-2023 CompuPhase\nLicensed under the Apache License version 2.0\n");
-}
-
-#if defined FORTIFY
-  void Fortify_OutputFunc(const char *str, int type)
-  {
-#   if defined _WIN32  /* fix console output on Windows */
-      if (AttachConsole(ATTACH_PARENT_PROCESS)) {
-        freopen("CONOUT$", "wb", stdout);
-        freopen("CONOUT$", "wb", stderr);
-      }
-#   endif
-    printf("Fortify: [%d] %s\n", type, str);
-  }
-#endif
-
-enum {
-  TAB_CONFIGURATION,
-  TAB_PROFILE,
-  TAB_STATUS,
-  /* --- */
-  TAB_COUNT
-};
-
-enum {
-  MODE_MANCHESTER = 1,
-  MODE_ASYNC
-};
-
-enum {
-  VIEW_TOP,
-  VIEW_FUNCTION,
-};
-
-typedef struct tagFUNCTIONINFO {
-  const char *name;
-  uint32_t addr_low, addr_high;
-  int line_low, line_high;      /**< line number range in the source file */
-  short fileindex;              /**< file index in DWARF table */
-  unsigned count;               /**< sample count (for the function) */
-  double ratio;                 /**< scaling ratio (bar graph) */
-  char percentage[16];          /**< pre-formatted string */
-} FUNCTIONINFO;
-
-typedef struct tagLINEINFO {
-  const char *text;
-  unsigned linenr;
-  unsigned count;               /**< sample count (for the source line) */
-  double ratio;                 /**< scaling ratio (bar graph) */
-  char percentage[16];          /**< pre-formatted string */
-} LINEINFO;
-
-typedef struct tagAPPSTATE {
-  int curstate;                 /**< current state */
-  int probe;                    /**< selected debug probe (index) */
-  int netprobe;                 /**< index for the IP address (pseudo-probe) */
-  const char **probelist;       /**< list of detected probes */
-  char mcu_family[64];          /**< detected MCU family (on attach), also the "driver" name of BMP */
-  char mcu_architecture[32];    /**< detected ARM architecture (on attach) */
-  unsigned long mcu_partid;     /**< specific ID code (0 if unknown) */
-  const char *monitor_cmds;     /**< list of "monitor" commands (target & probe dependent) */
-  char IPaddr[64];              /**< IP address for network probe */
-  unsigned char trace_endpoint; /**< standard USB endpoint for tracing */
-  int probe_type;               /**< BMP or ctxLink (needed to select manchester/async mode) */
-  int swomode;                  /**< manchester or async */
-  int init_target;              /**< whether to configure the target MCU for tracing */
-  nk_bool init_bmp;             /**< whether to configure the debug probe for tracing */
-  int connect_srst;             /**< whether to force reset while attaching */
-  char mcuclock_str[16];        /**< edit buffer for CPU clock frequency */
-  unsigned long mcuclock;       /**< active CPU clock frequency */
-  char bitrate_str[16];         /**< edit buffer for bitrate */
-  unsigned long bitrate;        /**< active bitrate */
-  int trace_status;             /**< status of the USB or TCP/IP configuration for SWO tracing */
-  bool connected;               /**< connected to BMP? */
-  bool attached;                /**< attached to target? */
-  bool dwarf_loaded;            /**< whether DWARF information is valid */
-  bool init_done;               /**< whether target & BMP have been initialized (assuming init_target is set) */
-  bool firstrun;                /**< is this the first run after a connect? */
-  int view;                     /**< histogram or function list */
-  char refreshrate_str[16];     /**< edit buffer for refresh intreval */
-  double refreshrate;           /**< refresh interval */
-  double refresh_tstamp;        /**< timestamp of most recent refresh */
-  double capture_tstamp;        /**< time stamp of the start of collecting the samples */
-  char samplingfreq_str[16];    /**< edit buffer for sampling frequency */
-  unsigned long samplingfreq;   /**< set sampling frequency */
-  unsigned long actual_freq;    /**< calculated sampling frequency */
-  int accumulate;               /**< accumulate all samples since start of a run */
-  char ELFfile[_MAX_PATH];      /**< ELF file for symbol/address look-up */
-  char ParamFile[_MAX_PATH];    /**< debug parameters for the ELF file */
-  unsigned long code_base;      /**< low address of code range of the ELF file */
-  unsigned long code_top;       /**< top address */
-  unsigned *sample_map;         /**< array containing sample counts */
-  unsigned sample_unknown;      /**< samples that fall outside the ELF file address range */
-  unsigned total_samples;       /**< total number of samples collected */
-  unsigned overflow;            /**< number of overflow packets reported */
-  unsigned numfunctions;        /**< top view: number of functions in the function list */
-  FUNCTIONINFO *functionlist;   /**< top view: name + address range of al functions (sorted on address) */
-  unsigned *functionorder;      /**< top view: indices in the function list for ordering by hit count */
-  unsigned numlines;            /**< source view: number of source lines */
-  LINEINFO *sourcelines;        /**< source view: source text */
-  uint32_t source_addr_low;     /**< source view: lowest code address of interest */
-  uint32_t source_addr_high;    /**< source view: highest code address of interest */
-  unsigned *addr2line;          /**< source view: address-to-linenumber map */
-  bool help_popup;              /**< whether "help" popup is active */
-} APPSTATE;
-
-enum {
-  STATE_IDLE,
-  STATE_CONNECT,        /**< connect to BMP */
-  STATE_ATTACH,         /**< attach to target MCU */
-  STATE_INIT_USB,
-  STATE_LOAD_DWARF,
-  STATE_INIT_TARGET,
-  STATE_CONFIG_PROFILE,
-  STATE_RUN,            /**< start to run */
-  STATE_RUNNING,        /**< currently sampling */
-  STATE_STOP,           /**< stop running */
-  STATE_STOPPED,
-};
-
-static bool save_settings(const char *filename, const APPSTATE *state,
-                          const enum nk_collapse_states tab_states[],
-                          const SPLITTERBAR *splitter_hor)
-{
-  assert(filename != NULL);
-  assert(state != NULL);
-  assert(tab_states != NULL);
-  assert(splitter_hor != NULL);
-
-  if (strlen(filename) == 0)
-    return false;
-
-  ini_putl("Settings", "init-target", state->init_target, filename);
-  ini_putl("Settings", "init-bmp", state->init_bmp, filename);
-  ini_putf("Settings", "splitter", splitter_hor->ratio, filename);
-  for (int idx = 0; idx < TAB_COUNT; idx++) {
-    char key[40];
-    sprintf(key, "view%d", idx);
-    ini_putl("Settings", key, tab_states[idx], filename);
-  }
-
-  if (bmp_is_ip_address(state->IPaddr))
-    ini_puts("Settings", "ip-address", state->IPaddr, filename);
-  ini_putl("Settings", "probe", (state->probe == state->netprobe) ? 99 : state->probe, filename);
-
-  return access(filename, 0) == 0;
-}
-
-static bool load_settings(const char *filename, APPSTATE *state,
-                          enum nk_collapse_states tab_states[],
-                          SPLITTERBAR *splitter_hor)
-{
-  assert(filename != NULL);
-  assert(state != NULL);
-  assert(tab_states != NULL);
-  assert(splitter_hor != NULL);
-
-  state->init_target = (int)ini_getl("Settings", "init-target", 1, filename);
-  state->init_bmp = (nk_bool)ini_getl("Settings", "init-bmp", 1, filename);
-  state->probe = (int)ini_getl("Settings", "probe", 0, filename);
-  ini_gets("Settings", "ip-address", "127.0.0.1", state->IPaddr, sizearray(state->IPaddr), filename);
-
-  splitter_hor->ratio = ini_getf("Settings", "splitter", 0.0, filename);
-  if (splitter_hor->ratio < 0.05 || splitter_hor->ratio > 0.95)
-    splitter_hor->ratio = 0.70;
-
-  for (int idx = 0; idx < TAB_COUNT; idx++) {
-    char key[40], valstr[100];
-    int opened, result;
-    tab_states[idx] = NK_MAXIMIZED;
-    sprintf(key, "view%d", idx);
-    ini_gets("Settings", key, "", valstr, sizearray(valstr), filename);
-    result = sscanf(valstr, "%d", &opened);
-    if (result >= 1)
-      tab_states[idx] = opened;
-  }
-
-  return true;
-}
-
-static bool save_targetoptions(const char *filename, APPSTATE *state)
-{
-  assert(state != NULL);
-
-  if (filename == NULL || strlen(filename) == 0)
-    return false;
-
-  ini_putl("Settings", "connect-srst", state->connect_srst, filename);
-  ini_putl("SWO trace", "mode", state->swomode, filename);
-  ini_putl("SWO trace", "clock", state->mcuclock, filename);
-  ini_putl("SWO trace", "bitrate", state->bitrate, filename);
-
-  ini_putl("Profile", "sample-rate", state->samplingfreq, filename);
-  ini_putf("Profile", "refresh-rate", state->refreshrate, filename);
-  ini_putl("Profile", "accumulate", state->accumulate, filename);
-
-  return access(filename, 0) == 0;
-}
-
-static bool load_targetoptions(const char *filename, APPSTATE *state)
-{
-  assert(state != NULL);
-
-  if (filename == NULL || strlen(filename) == 0 || access(filename, 0) != 0)
-    return false;
-
-  state->connect_srst = (int)ini_getl("Settings", "connect-srst", 0, filename);
-  state->swomode = (int)ini_getl("SWO trace", "mode", MODE_MANCHESTER, filename);
-  state->mcuclock = ini_getl("SWO trace", "clock", 48000000, filename);
-  state->bitrate = ini_getl("SWO trace", "bitrate", 100000, filename);
-
-  state->samplingfreq = ini_getl("Profile", "sample-rate", 1000, filename);
-  state->refreshrate = ini_getf("Profile", "refresh-rate", 1.0, filename);
-  state->accumulate = (int)ini_getl("Profile", "accumulate", 0, filename);
-
-  if (state->samplingfreq == 0)
-    state->samplingfreq = 1000;
-  if (state->refreshrate < 0.1)
-    state->refreshrate = 1.0;
-
-  sprintf(state->mcuclock_str, "%lu", state->mcuclock);
-  sprintf(state->bitrate_str, "%lu", state->bitrate);
-  sprintf(state->samplingfreq_str, "%lu", state->samplingfreq);
-  sprintf(state->refreshrate_str, "%.1f", state->refreshrate);
-  return true;
-}
-
-static void probe_set_options(APPSTATE *state)
-{
-  if (bmp_isopen()) {
-    char cmd[100];
-    if (bmp_expand_monitor_cmd(cmd, sizearray(cmd), "connect", state->monitor_cmds)) {
-      strlcat(cmd, " ", sizearray(cmd));
-      strlcat(cmd, state->connect_srst ? "enable" : "disable", sizearray(cmd));
-      if (!bmp_monitor(cmd))
-        bmp_callback(BMPERR_MONITORCMD, "Setting connect-with-reset option failed");
-    }
-  }
-}
-
-static void profile_graph(struct nk_context *ctx, const char *id, APPSTATE *state, float rowheight, nk_flags widget_flags)
-{
-  assert(ctx != NULL);
-  struct nk_rect rcwidget = nk_layout_widget_bounds(ctx);
-  float graphwidth = rcwidget.w * 0.25;
-  float lineheight = 0.0;
-  int linecount = 0;
-
-  struct nk_window *win = ctx->current;
-  struct nk_user_font const *font = ctx->style.font;
-
-  struct nk_style_window *stwin = &ctx->style.window;
-  nk_style_push_color(ctx, &stwin->fixed_background.data.color, COLOUR_BG0);
-  if (nk_group_begin(ctx, id, widget_flags)) {
-    if (tracelog_getstatusmsg(0) != NULL) {
-      const char *text;
-      for (int idx = 0; (text = tracelog_getstatusmsg(idx)) != NULL; idx++) {
-        struct nk_color clr = COLOUR_FG_YELLOW;
-        nk_layout_row_dynamic(ctx, rowheight, 1);
-        nk_label_colored(ctx, text, NK_TEXT_LEFT, clr);
-      }
-    } else if (state->view == VIEW_TOP) {
-      for (unsigned idx = 0; idx < state->numfunctions; idx++) {
-        unsigned fidx = state->functionorder[idx];
-        assert(fidx < state->numfunctions);
-        nk_layout_row_begin(ctx, NK_STATIC, rowheight, 2);
-        if (lineheight < 0.1) {
-          struct nk_rect rcline = nk_layout_widget_bounds(ctx);
-          lineheight = rcline.h;
-        }
-        /* draw bar */
-        nk_layout_row_push(ctx, graphwidth);
-        struct nk_rect rc = nk_widget_bounds(ctx);
-        assert(state->functionlist[fidx].ratio >= 0.0 && state->functionlist[fidx].ratio <= 1.0);
-        rc.w *= state->functionlist[fidx].ratio;
-        nk_fill_rect(&win->buffer, rc, 0.0f, COLOUR_BG_YELLOW);
-        nk_label(ctx, state->functionlist[fidx].percentage, NK_TEXT_RIGHT);
-        /* print function name (get the width for the text first) */
-        const char *name = state->functionlist[fidx].name;
-        int len = strlen(name);
-        assert(font != NULL && font->width != NULL);
-        int textwidth = (int)font->width(font->userdata, font->height, name, len) + 10;
-        nk_layout_row_push(ctx, textwidth);
-        nk_text(ctx, name, len, NK_TEXT_LEFT);
-        nk_layout_row_end(ctx);
-        linecount += 1;
-      }
-    } else {
-      assert(state->view == VIEW_FUNCTION);
-      for (unsigned idx = 0; idx < state->numlines; idx++) {
-        nk_layout_row_begin(ctx, NK_STATIC, rowheight, 2);
-        if (lineheight < 0.1) {
-          struct nk_rect rcline = nk_layout_widget_bounds(ctx);
-          lineheight = rcline.h;
-        }
-        /* draw bar */
-        nk_layout_row_push(ctx, graphwidth);
-        struct nk_rect rc = nk_widget_bounds(ctx);
-        rc.w *= state->sourcelines[idx].ratio;
-        nk_fill_rect(&win->buffer, rc, 0.0f, COLOUR_BG_YELLOW);
-        nk_label(ctx, state->sourcelines[idx].percentage, NK_TEXT_RIGHT);
-        /* print source line (get the width for the text first) */
-        const char *text = state->sourcelines[idx].text;
-        int len = strlen(text);
-        assert(font != NULL && font->width != NULL);
-        int textwidth = (int)font->width(font->userdata, font->height, text, len) + 10;
-        nk_layout_row_push(ctx, textwidth);
-        nk_text(ctx, text, len, NK_TEXT_LEFT);
-        nk_layout_row_end(ctx);
-        linecount += 1;
-      }
-    }
-    nk_group_end(ctx);
-  }
-  nk_style_pop_color(ctx);
-
-  /* handle mouse input (reduce width & height of rcwidget, so that a click on
-     a scrollbar is not taken into account */
-  rcwidget.w -= 16;
-  rcwidget.h -= 16;
-  if (nk_input_is_mouse_hovering_rect(&ctx->input, rcwidget) && lineheight >= 0.1 && tracelog_getstatusmsg(0) == NULL) {
-    struct nk_mouse *mouse = &ctx->input.mouse;
-    assert(mouse != NULL);
-    assert(NK_INBOX(mouse->pos.x, mouse->pos.y, rcwidget.x, rcwidget.y, rcwidget.w, rcwidget.h));
-    unsigned xscroll, yscroll;
-    nk_group_get_scroll(ctx, id, &xscroll, &yscroll);
-    int row = (int)(((mouse->pos.y - rcwidget.y) + yscroll) / lineheight);
-    if (row < linecount) {
-      if (nk_input_mouse_clicked(&ctx->input, NK_BUTTON_LEFT, rcwidget)) {
-        /* clear source-code data (regardless of whether moving into the source
-           code view or returning to the function list */
-        if (state->sourcelines != NULL) {
-          for (unsigned idx = 0; idx < state->numlines; idx++) {
-            assert(state->sourcelines[idx].text != NULL);
-            if (state->sourcelines[idx].text != NULL)
-              free((void*)state->sourcelines[idx].text);
-          }
-          free((void*)state->sourcelines);
-          state->sourcelines = NULL;
-        }
-        if (state->addr2line != NULL) {
-          free((void*)state->addr2line);
-          state->addr2line = NULL;
-        }
-        state->numlines = 0;
-        state->source_addr_low = 0;
-        state->source_addr_high = 0;
-        /* toggle view */
-        state->view = (state->view == VIEW_TOP) ? VIEW_FUNCTION : VIEW_TOP;
-        if (state->view == VIEW_FUNCTION) {
-          assert(row < state->numfunctions);
-          unsigned fidx = state->functionorder[row];
-          assert(fidx < state->numfunctions);
-          state->source_addr_low = state->functionlist[fidx].addr_low;
-          state->source_addr_high = state->functionlist[fidx].addr_high;
-          /* create map to look up line number from address */
-          uint32_t addr_range = (state->source_addr_high - state->source_addr_low) / ADDRESS_ALIGN;
-          assert(addr_range > 0);
-          if (addr_range > 0)
-            state->addr2line = (unsigned*)malloc(addr_range * sizeof(unsigned));
-          if (state->addr2line != NULL) {
-            for (uint32_t addr = state->source_addr_low; addr < state->source_addr_high; addr += ADDRESS_ALIGN) {
-              const DWARF_LINELOOKUP *lineinfo = dwarf_line_from_address(&dwarf_linetable, addr);
-              if (lineinfo != NULL) {
-                unsigned idx = Address2Index(addr, state->source_addr_low);
-                assert(idx < addr_range);
-                state->addr2line[idx] = lineinfo->line;
-              }
-            }
-          }
-          /* load source code for the function */
-          FILE *fp = NULL;
-          const char *path = (addr_range > 0) ? dwarf_path_from_fileindex(&dwarf_filetable, state->functionlist[fidx].fileindex) : NULL;
-          if (path != NULL) {
-            fp = fopen(path, "rt");
-            if (fp == NULL) {
-              /* get directory of ELF file, append "path" and retry */
-              char fullpath[_MAX_PATH];
-              strlcpy(fullpath, state->ELFfile, sizearray(fullpath));
-              char *ptr = strrchr(fullpath, DIRSEP_CHAR);
-              if (ptr != NULL)
-                *(ptr + 1) = '\0';
-              strlcat(fullpath, path, sizearray(fullpath));
-              fp = fopen(fullpath, "rt");
-            }
-          }
-          if (fp != NULL) {
-            unsigned numlines = state->functionlist[fidx].line_high - state->functionlist[fidx].line_low;
-            state->sourcelines = (LINEINFO*)malloc(numlines * sizeof(LINEINFO));
-            if (state->sourcelines != NULL) {
-              memset(state->sourcelines, 0, numlines * sizeof(LINEINFO));
-              char text[200];
-              for (unsigned idx = 1; idx < state->functionlist[fidx].line_low; idx++)
-                fgets(text, sizeof text, fp); /* skip first lines */
-              numlines = 0;
-              for (unsigned idx = state->functionlist[fidx].line_low; idx < state->functionlist[fidx].line_high; idx++) {
-                if (fgets(text, sizeof text, fp) == NULL)
-                  break;  /* should not happen: source file is shorter than DWARF info indicates */
-                char *ptr = strchr(text, '\n');
-                if (ptr != NULL)
-                  *ptr = '\0';
-                state->sourcelines[numlines].text = strdup(text);
-                state->sourcelines[numlines].linenr = idx;
-                numlines += 1;
-              }
-              state->numlines = numlines;
-            }
-            fclose(fp);
-          } else {
-            /* add string "No source code for ***" */
-            unsigned numlines = 2;
-            state->sourcelines = (LINEINFO*)malloc(numlines * sizeof(LINEINFO));
-            if (state->sourcelines != NULL) {
-              memset(state->sourcelines, 0, numlines * sizeof(LINEINFO));
-              char text[200];
-              sprintf(text, "No source code for \"%s\"", state->functionlist[fidx].name);
-              state->sourcelines[0].text = strdup(text);
-              state->sourcelines[1].text = strdup("Click here to return to the function list");
-              state->numlines = numlines;
-            }
-          }
-        }
-      } else {
-        if (state->view == VIEW_FUNCTION)
-          nk_tooltip(ctx, "Click to return to the function list");
-        else
-          nk_tooltip(ctx, "Click for a detailed view");
-      }
-    }
-  }
-}
-
-static void profile_reset(APPSTATE *state, bool samples)
-{
-  if (samples && state->sample_map != NULL) {
-    unsigned count = (state->code_top - state->code_base) / ADDRESS_ALIGN + 1;
-    memset(state->sample_map, 0, count * sizeof(unsigned));
-  }
-
-  if (state->view == VIEW_TOP && state->functionlist != NULL) {
-    FUNCTIONINFO *functionlist = state->functionlist;
-    unsigned numfunctions = state->numfunctions;
-    for (unsigned idx = 0; idx < numfunctions; idx++) {
-      functionlist[idx].count = 0;
-      functionlist[idx].ratio = 0.0;
-    }
-  }
-
-  if (state->view == VIEW_FUNCTION && state->sourcelines != NULL) {
-    LINEINFO *sourcelines = state->sourcelines;
-    unsigned numlines = state->numlines;
-    for (unsigned idx = 0; idx < numlines; idx++) {
-      sourcelines[idx].count = 0;
-      sourcelines[idx].ratio = 0.0;
-    }
-  }
-}
-
-static bool profile_save(const char *filename, APPSTATE *state)
-{
-  FILE *fp = fopen(filename, "wt");
-  if (fp == NULL)
-    return false;
-  fprintf(fp, "Address,Samples,Function,Source,Line\n");
-  if (state->sample_map != NULL) {
-    unsigned *sample_map = state->sample_map;
-    unsigned count = (state->code_top - state->code_base) / ADDRESS_ALIGN;
-    uint32_t code_base = state->code_base;
-    for (unsigned idx = 0; idx < count; idx++) {
-      if (sample_map[idx] == 0)
-        continue;
-      uint32_t addr = Index2Address(idx, code_base);
-
-      /* get function (binary search) */
-      FUNCTIONINFO *functionlist = state->functionlist;
-      unsigned numfunctions = state->numfunctions;
-      unsigned func_idx;
-      unsigned low = 0;
-      unsigned high = numfunctions - 1;
-      while (low <= high) {
-        func_idx = low + (high - low) / 2;
-        if (functionlist[func_idx].addr_low <= addr && addr < functionlist[func_idx].addr_high)
-          break;
-        assert(functionlist[func_idx].addr_low < addr || functionlist[func_idx].addr_high >= addr);
-        if (functionlist[func_idx].addr_low < addr)
-          low = func_idx + 1;
-        else
-          high = func_idx - 1;
-      }
-
-      const char *name = "";
-      int linenr = 0;
-      const char *path = "";
-      if (addr >= functionlist[func_idx].addr_low && addr < functionlist[func_idx].addr_high) {
-        name = functionlist[func_idx].name;
-        /* get line number & file path */
-        const DWARF_LINELOOKUP *lineinfo = dwarf_line_from_address(&dwarf_linetable, addr);
-        if (lineinfo != NULL) {
-          linenr = lineinfo->line;
-          const char *p = dwarf_path_from_fileindex(&dwarf_filetable, lineinfo->fileindex);
-          if (p != NULL)
-            path = p;
-        }
-      }
-
-      fprintf(fp, "%lx,%u,\"%s\",\"%s\",%d\n", (unsigned long)addr, sample_map[idx], name, path, linenr);
-    }
-  }
-  fclose(fp);
-  return true;
-}
-
-static void profile_graph_top(APPSTATE *state)
-{
-  if (state->sample_map != NULL && state->functionlist != NULL && state->numfunctions > 0) {
-    /* clear functions counts */
-    FUNCTIONINFO *functionlist = state->functionlist;
-    unsigned numfunctions = state->numfunctions;
-    for (unsigned idx = 0; idx < numfunctions; idx++)
-      functionlist[idx].count = 0;
-    state->sample_unknown = 0;
-
-    /* accumulate function counts from sample map */
-    unsigned total_samples = 0;
-    unsigned *sample_map = state->sample_map;
-    unsigned count = (state->code_top - state->code_base) / ADDRESS_ALIGN;
-    uint32_t code_base = state->code_base;
-    unsigned func_idx = 0;
-    for (unsigned idx = 0; idx < count; idx++) {
-      if (sample_map[idx] == 0)
-        continue;
-      uint32_t addr = Index2Address(idx, code_base);
-      if (addr < functionlist[func_idx].addr_low || addr >= functionlist[func_idx].addr_high) {
-        /* use binary search to find the function */
-        unsigned low = 0;
-        unsigned high = numfunctions - 1;
-        while (low <= high) {
-          func_idx = low + (high - low) / 2;
-          if (functionlist[func_idx].addr_low <= addr && addr < functionlist[func_idx].addr_high)
-            break;
-          assert(functionlist[func_idx].addr_low < addr || functionlist[func_idx].addr_high >= addr);
-          if (functionlist[func_idx].addr_low < addr)
-            low = func_idx + 1;
-          else
-            high = func_idx - 1;
-        }
-      }
-      if (functionlist[func_idx].addr_low <= addr && addr < functionlist[func_idx].addr_high)
-        functionlist[func_idx].count += sample_map[idx];
-      else
-        state->sample_unknown += sample_map[idx];
-      total_samples += sample_map[idx];
-    }
-
-    /* all samples beyond the ELF file address range are collected in this slot */
-    state->sample_unknown += sample_map[count];
-    total_samples += sample_map[count];
-    state->total_samples = total_samples;
-
-    /* calculate scaling factors */
-    if (total_samples > 0) {
-      double peak = 0.0;
-      for (unsigned idx = 0; idx < numfunctions; idx++) {
-        functionlist[idx].ratio = (double)functionlist[idx].count / total_samples;
-        sprintf(functionlist[idx].percentage, "%5.1f%%  ", 100.0 * functionlist[idx].ratio);
-        if (functionlist[idx].ratio > peak)
-          peak = functionlist[idx].ratio;
-      }
-      /* equalize the scaling somewhat, so that the bar graph emphasizes the
-         differences */
-      if (peak < 0.1)
-        peak = 0.1;
-      double scale = 0.5 / peak + 0.5;
-      for (unsigned idx = 0; idx < numfunctions; idx++)
-        functionlist[idx].ratio *= scale;
-    } else {
-      for (unsigned idx = 0; idx < numfunctions; idx++) {
-        functionlist[idx].ratio = 0.0;
-        functionlist[idx].percentage[0] = '\0';
-      }
-    }
-
-    /* sort the functions using "insertion sort"; this is classified as an
-       inefficient sort, but it is quite efficient if the list is already
-       (nearly) sorted */
-    unsigned *functionorder = state->functionorder;
-    for (unsigned i = 1; i < numfunctions; i++) {
-      unsigned key = functionorder[i];
-      assert(key < numfunctions);
-      unsigned long key_samples = functionlist[key].count;
-      unsigned j;
-      for (j = i; j > 0 && functionlist[functionorder[j - 1]].count < key_samples; j--)
-        functionorder[j] = functionorder[j - 1];
-      functionorder[j] = key;
-    }
-  }
-}
-
-static void profile_graph_source(APPSTATE *state)
-{
-  if (state->sample_map != NULL && state->sourcelines != NULL && state->numlines > 0 && state->addr2line != NULL) {
-    /* clear line counts */
-    LINEINFO *sourcelines = state->sourcelines;
-    unsigned numlines = state->numlines;
-    for (unsigned idx = 0; idx < numlines; idx++)
-      sourcelines[idx].count = 0;
-
-    /* accumulate function counts from sample map */
-    unsigned total_samples = 0;
-    unsigned *sample_map = state->sample_map;
-    unsigned count = (state->code_top - state->code_base) / ADDRESS_ALIGN;
-    uint32_t code_base = state->code_base;
-    uint32_t addr_low = state->source_addr_low;
-    uint32_t addr_high = state->source_addr_high;
-    unsigned *addr2line = state->addr2line;
-    unsigned line_count = state->numlines;
-    unsigned first_line = sourcelines[0].linenr;
-    for (unsigned idx = 0; idx < count; idx++) {
-      if (sample_map[idx] == 0)
-        continue;
-      total_samples += sample_map[idx];
-      uint32_t addr = Index2Address(idx, code_base);
-      if (addr < addr_low || addr >= addr_high)
-        continue;
-      unsigned addr_idx = Address2Index(addr, addr_low);
-      unsigned line_idx = addr2line[addr_idx] - first_line;
-      if (line_idx < line_count)
-        sourcelines[line_idx].count += sample_map[idx];
-    }
-    state->total_samples = total_samples;
-    state->sample_unknown = sample_map[count];
-
-    /* calculate scaling factors */
-    if (total_samples > 0) {
-      double peak = 0.0;
-      for (unsigned idx = 0; idx < line_count; idx++) {
-        sourcelines[idx].ratio = (double)sourcelines[idx].count / total_samples;
-        sprintf(sourcelines[idx].percentage, "%5.1f%%  ", 100.0 * sourcelines[idx].ratio);
-        if (sourcelines[idx].ratio > peak)
-          peak = sourcelines[idx].ratio;
-      }
-      /* equalize the scaling somewhat, so that the bar graph emphasizes the
-         differences */
-      if (peak < 0.1)
-        peak = 0.1;
-      double scale = 0.5 / peak + 0.5;
-      for (unsigned idx = 0; idx < line_count; idx++)
-        sourcelines[idx].ratio *= scale;
-    } else {
-      for (unsigned idx = 0; idx < line_count; idx++) {
-        sourcelines[idx].ratio = 0.0;
-        sourcelines[idx].percentage[0] = '\0';
-      }
-    }
-  }
-}
-
-static void clear_functions(APPSTATE *state)
-{
-  assert(state != NULL);
-  if (state->functionlist != NULL) {
-    for (unsigned idx = 0; idx < state->numfunctions; idx++)
-      free((void*)state->functionlist[idx].name);
-    free((void*)state->functionlist);
-    state->functionlist = NULL;
-  }
-  if (state->functionorder != NULL) {
-    free((void*)state->functionorder);
-    state->functionorder = NULL;
-  }
-  state->numfunctions = 0;
-}
-
-static bool collect_functions(APPSTATE *state)
-{
-  assert(state != NULL);
-  clear_functions(state);
-
-  /* count & collect the function symbols from the DWARF info */
-  unsigned dwarf_count = dwarf_collect_functions_in_file(&dwarf_symboltable, -1, DWARF_SORT_ADDRESS, NULL, 0);
-  if (dwarf_count == 0)
-    return false;
-  const DWARF_SYMBOLLIST **dwarf_list = (const DWARF_SYMBOLLIST**)malloc(dwarf_count * sizeof(DWARF_SYMBOLLIST*));
-  if (dwarf_list != NULL)
-    dwarf_collect_functions_in_file(&dwarf_symboltable, -1, DWARF_SORT_ADDRESS, dwarf_list, dwarf_count);
-
-  /* count & collect the function symbols in the ELF symbol table */
-  unsigned elf_count = 0;
-  ELF_SYMBOL *elf_list = NULL;
-  FILE *fp_elf = fopen(state->ELFfile, "rb");
-  assert(fp_elf != NULL);
-  if (fp_elf != NULL) {
-    if (elf_load_symbols(fp_elf, NULL, &elf_count) == ELFERR_NONE && elf_count > 0) {
-      elf_list = (ELF_SYMBOL*)malloc(elf_count * sizeof(ELF_SYMBOL));
-      if (elf_list != NULL)
-        elf_load_symbols(fp_elf, elf_list, &elf_count);
-    }
-    fclose(fp_elf);
-  }
-
-  /* use the DWARF info as the primary table, but walk through the ELF symbols
-     to find any functions that are not present in the DWARF table */
-  state->numfunctions = dwarf_count;
-  if (elf_list != NULL) {
-    assert(elf_count > 0);
-    for (unsigned elf_idx = 0; elf_idx < elf_count; elf_idx++) {
-      if (!elf_list[elf_idx].is_func)
-        continue;
-      /* functions are always on even addresses, but the ELF symbol table uses
-         the low bit to indicate a Thumb function; this is irrelevant here, so
-         the low bit is cleared */
-      unsigned long addr = elf_list[elf_idx].address & ~1;
-      unsigned dwarf_idx;
-      for (dwarf_idx = 0; dwarf_idx < dwarf_count && dwarf_list[dwarf_idx]->code_addr != addr; dwarf_idx++)
-        {}
-      if (dwarf_idx >= dwarf_count)
-        state->numfunctions += 1; /* found a function in the ELF table that is not in the DWARF table */
-      else
-        elf_list[elf_idx].is_func = 0;  /* clear flag, to make the loop for inserting the symbols easier */
-    }
-  }
-
-  /* allocate memory for the merged tables from DWARF and ELF */
-  state->functionlist = (FUNCTIONINFO*)malloc(state->numfunctions * sizeof(FUNCTIONINFO));
-  state->functionorder = (unsigned*)malloc(state->numfunctions * sizeof(unsigned));
-
-  if (state->functionlist != NULL && state->functionorder != NULL) {
-    memset(state->functionlist, 0, state->numfunctions * sizeof(FUNCTIONINFO));
-    memset(state->functionorder, 0, state->numfunctions * sizeof(unsigned));
-    /* the DWARF list is already sorted on address, copy relevant fields */
-    for (unsigned idx = 0; idx < dwarf_count; idx++) {
-      state->functionlist[idx].name = strdup(dwarf_list[idx]->name);
-      state->functionlist[idx].addr_low = dwarf_list[idx]->code_addr;
-      state->functionlist[idx].addr_high = dwarf_list[idx]->code_addr + dwarf_list[idx]->code_range;
-      state->functionlist[idx].line_low = dwarf_list[idx]->line;
-      state->functionlist[idx].line_high = dwarf_list[idx]->line_limit;
-      state->functionlist[idx].fileindex = dwarf_list[idx]->fileindex;
-    }
-    /* add functions from the ELF symbol table */
-    if (elf_list != NULL) {
-      assert(elf_count > 0);
-      for (unsigned elf_idx = 0; elf_idx < elf_count; elf_idx++) {
-        if (!elf_list[elf_idx].is_func)
-          continue; /* all functions that are also in the DWARF table had this flag cleared, see above */
-        unsigned long addr = elf_list[elf_idx].address & ~1;
-        /* find insertion point */
-        unsigned pos;
-        for (pos = 0; state->functionlist[pos].name != NULL && state->functionlist[pos].addr_low < addr; pos++)
-          {}
-        assert(pos < state->numfunctions);
-        if (state->functionlist[pos].name != NULL) {
-          unsigned count = state->numfunctions - (pos + 1);
-          memmove(&state->functionlist[pos + 1], &state->functionlist[pos], count * sizeof(FUNCTIONINFO));
-        }
-        char plain[256];
-        if (!demangle(plain, sizearray(plain), elf_list[elf_idx].name))
-          strlcpy(plain, elf_list[elf_idx].name, sizearray(plain));
-        state->functionlist[pos].name = strdup(plain);
-        state->functionlist[pos].addr_low = elf_list[elf_idx].address;
-        state->functionlist[pos].addr_high = elf_list[elf_idx].address + elf_list[elf_idx].size;
-        state->functionlist[pos].line_low = 0;
-        state->functionlist[pos].line_high = 0;
-        state->functionlist[pos].fileindex = 0;
-      }
-    }
-    /* create an initial sort order */
-    for (unsigned idx = 0; idx < state->numfunctions; idx++)
-      state->functionorder[idx] = idx;
-  } else {
-    if (state->functionlist != NULL) {
-      free((void*)state->functionlist);
-      state->functionlist = NULL;
-    }
-    if (state->functionorder != NULL) {
-      free((void*)state->functionorder);
-      state->functionorder = NULL;
-    }
-  }
-  if (dwarf_list != NULL)
-    free((void*)dwarf_list);
-  if (elf_list != NULL) {
-    elf_clear_symbols(elf_list, elf_count);
-    free((void*)elf_list);
-  }
-
-  return state->functionlist != NULL && state->functionorder != NULL;
-}
-
-static void help_popup(struct nk_context *ctx, APPSTATE *state, float canvas_width, float canvas_height)
-{
-# include "bmprofile_help.h"
-
-  if (state->help_popup) {
-#   define MARGIN  10
-    float w = opt_fontsize * 40;
-    if (w > canvas_width - 2*MARGIN)  /* clip "ideal" help window size of canvas size */
-      w = canvas_width - 2*MARGIN;
-    float h = canvas_height * 0.75;
-    struct nk_rect rc = nk_rect((canvas_width - w) / 2, (canvas_height - h) / 2, w, h);
-#   undef MARGIN
-
-    state->help_popup = nk_guide(ctx, &rc, opt_fontsize, (const char*)bmprofile_help, NULL);
-  }
-}
-
-static void panel_options(struct nk_context *ctx, APPSTATE *state,
-                          enum nk_collapse_states tab_states[TAB_COUNT],
-                          float panel_width)
-{
-  static const char *mode_strings[] = { "Manchester", "NRZ/async." };
-
-# define LABEL_WIDTH (4.5 * opt_fontsize)
-# define VALUE_WIDTH (panel_width - LABEL_WIDTH - 26)
-
-  if (nk_tree_state_push(ctx, NK_TREE_TAB, "Configuration", &tab_states[TAB_CONFIGURATION])) {
-    int result;
-    nk_layout_row_begin(ctx, NK_STATIC, ROW_HEIGHT, 2);
-    nk_layout_row_push(ctx, LABEL_WIDTH);
-    nk_label(ctx, "Probe", NK_TEXT_ALIGN_LEFT | NK_TEXT_ALIGN_MIDDLE);
-    nk_layout_row_push(ctx, VALUE_WIDTH);
-    struct nk_rect bounds = nk_widget_bounds(ctx);
-    state->probe = nk_combo(ctx, state->probelist, state->netprobe+1, state->probe,
-                            (int)COMBOROW_CY, nk_vec2(bounds.w, 4.5*ROW_HEIGHT));
-    if (state->probe == state->netprobe) {
-      int reconnect = 0;
-      nk_layout_row_begin(ctx, NK_STATIC, ROW_HEIGHT, 3);
-      nk_layout_row_push(ctx, LABEL_WIDTH);
-      nk_label(ctx, "IP Addr", NK_TEXT_ALIGN_LEFT | NK_TEXT_ALIGN_MIDDLE);
-      nk_layout_row_push(ctx, VALUE_WIDTH - BROWSEBTN_WIDTH - 5);
-      result = editctrl_tooltip(ctx, NK_EDIT_FIELD|NK_EDIT_SIG_ENTER|NK_EDIT_CLIPBOARD,
-                                state->IPaddr, sizearray(state->IPaddr), nk_filter_ascii,
-                                "IP address of the ctxLink");
-      if ((result & NK_EDIT_COMMITED) != 0 && bmp_is_ip_address(state->IPaddr))
-        reconnect = 1;
-      nk_layout_row_push(ctx, BROWSEBTN_WIDTH);
-      if (button_symbol_tooltip(ctx, NK_SYMBOL_TRIPLE_DOT, NK_KEY_NONE, nk_true, "Scan network for ctxLink probes.")) {
-#       if defined WIN32 || defined _WIN32
-          HCURSOR hcur = SetCursor(LoadCursor(NULL, IDC_WAIT));
-#       endif
-        unsigned long addr;
-        int count = scan_network(&addr, 1);
-#       if defined WIN32 || defined _WIN32
-          SetCursor(hcur);
-#       endif
-        if (count == 1) {
-          sprintf(state->IPaddr, "%lu.%lu.%lu.%lu",
-                 addr & 0xff, (addr >> 8) & 0xff, (addr >> 16) & 0xff, (addr >> 24) & 0xff);
-          reconnect = 1;
-        } else {
-          strlcpy(state->IPaddr, "none found", sizearray(state->IPaddr));
-        }
-      }
-      nk_layout_row_end(ctx);
-      if (reconnect) {
-        bmp_disconnect();
-        state->curstate = STATE_CONNECT;
-      }
-    }
-    if (state->probe_type == PROBE_UNKNOWN) {
-      nk_layout_row_begin(ctx, NK_STATIC, ROW_HEIGHT, 2);
-      nk_layout_row_push(ctx, LABEL_WIDTH);
-      nk_label(ctx, "Mode", NK_TEXT_ALIGN_LEFT | NK_TEXT_ALIGN_MIDDLE);
-      nk_layout_row_push(ctx, VALUE_WIDTH);
-      result = state->swomode - MODE_MANCHESTER;
-      result = nk_combo(ctx, mode_strings, NK_LEN(mode_strings), result, opt_fontsize, nk_vec2(VALUE_WIDTH,4.5*opt_fontsize));
-      if (state->swomode != result + MODE_MANCHESTER) {
-        /* mode is 1-based, the result of nk_combo() is 0-based, which is
-           why MODE_MANCHESTER is added (MODE_MANCHESTER == 1) */
-        state->swomode = result + MODE_MANCHESTER;
-        state->curstate = STATE_CONNECT;
-      }
-      nk_layout_row_end(ctx);
-    }
-
-    nk_layout_row_dynamic(ctx, ROW_HEIGHT, 1);
-    if (checkbox_tooltip(ctx, "Configure Target", &state->init_target, NK_TEXT_LEFT, "Configure the target microcontroller for SWO"))
-      state->curstate = STATE_INIT_TARGET;
-    nk_layout_row_dynamic(ctx, ROW_HEIGHT, 1);
-    if (checkbox_tooltip(ctx, "Configure Debug Probe", &state->init_bmp, NK_TEXT_LEFT, "Activate SWO capture in the Black Magic Probe"))
-      state->curstate = STATE_ATTACH;
-    if (state->init_target || state->init_bmp) {
-      nk_layout_row_dynamic(ctx, ROW_HEIGHT, 1);
-      if (checkbox_tooltip(ctx, "Reset target during connect", &state->connect_srst, NK_TEXT_LEFT, "Keep the target in reset state while scanning and attaching"))
-        state->curstate = STATE_INIT_TARGET;
-    }
-
-    if (state->init_target) {
-      nk_layout_row_begin(ctx, NK_STATIC, ROW_HEIGHT, 2);
-      nk_layout_row_push(ctx, LABEL_WIDTH);
-      nk_label(ctx, "CPU clock", NK_TEXT_ALIGN_LEFT | NK_TEXT_ALIGN_MIDDLE);
-      nk_layout_row_push(ctx, VALUE_WIDTH);
-      result = editctrl_tooltip(ctx, NK_EDIT_FIELD|NK_EDIT_SIG_ENTER|NK_EDIT_CLIPBOARD,
-                                state->mcuclock_str, sizearray(state->mcuclock_str), nk_filter_decimal,
-                                "CPU clock of the target microcontroller");
-      if ((result & NK_EDIT_COMMITED) != 0 || ((result & NK_EDIT_DEACTIVATED) && strtoul(state->mcuclock_str, NULL, 10) != state->mcuclock))
-        state->curstate = STATE_INIT_TARGET;
-      nk_layout_row_end(ctx);
-    }
-
-    if (state->init_target || (state->init_bmp && state->swomode == MODE_ASYNC)) {
-      nk_layout_row_begin(ctx, NK_STATIC, ROW_HEIGHT, 2);
-      nk_layout_row_push(ctx, LABEL_WIDTH);
-      nk_label(ctx, "Bit rate", NK_TEXT_ALIGN_LEFT | NK_TEXT_ALIGN_MIDDLE);
-      nk_layout_row_push(ctx, VALUE_WIDTH);
-      result = editctrl_tooltip(ctx, NK_EDIT_FIELD|NK_EDIT_SIG_ENTER|NK_EDIT_CLIPBOARD,
-                                state->bitrate_str, sizearray(state->bitrate_str), nk_filter_decimal,
-                                "SWO bit rate (data rate)");
-      if ((result & NK_EDIT_COMMITED) != 0 || ((result & NK_EDIT_DEACTIVATED) && strtoul(state->bitrate_str, NULL, 10) != state->bitrate))
-        state->curstate = STATE_INIT_TARGET;
-      nk_layout_row_end(ctx);
-    }
-
-    nk_layout_row_begin(ctx, NK_STATIC, ROW_HEIGHT, 3);
-    nk_layout_row_push(ctx, LABEL_WIDTH);
-    nk_label(ctx, "ELF file", NK_TEXT_ALIGN_LEFT | NK_TEXT_ALIGN_MIDDLE);
-    nk_layout_row_push(ctx, VALUE_WIDTH - BROWSEBTN_WIDTH - 5);
-    bool error = editctrl_cond_color(ctx, !state->dwarf_loaded, COLOUR_BG_DARKRED);
-    result = editctrl_tooltip(ctx, NK_EDIT_FIELD|NK_EDIT_SIG_ENTER|NK_EDIT_CLIPBOARD,
-                              state->ELFfile, sizearray(state->ELFfile), nk_filter_ascii,
-                              "ELF file for symbol lookup");
-    editctrl_reset_color(ctx, error);
-    if (result & (NK_EDIT_COMMITED | NK_EDIT_DEACTIVATED)) {
-      state->dwarf_loaded = false;
-      state->curstate = STATE_LOAD_DWARF;
-    }
-    nk_layout_row_push(ctx, BROWSEBTN_WIDTH);
-    if (nk_button_symbol(ctx, NK_SYMBOL_TRIPLE_DOT)) {
-      nk_input_clear_mousebuttons(ctx);
-#     if defined _WIN32
-        const char *filter = "ELF Executables\0*.elf;*.\0All files\0*.*\0";
-#     else
-        const char *filter = "ELF Executables\0*.elf\0All files\0*\0";
-#     endif
-      int res = noc_file_dialog_open(state->ELFfile, sizearray(state->ELFfile),
-                                     NOC_FILE_DIALOG_OPEN, filter,
-                                     NULL, state->ELFfile, "Select ELF Executable",
-                                     guidriver_apphandle());
-      if (res) {
-        state->dwarf_loaded = false;
-        state->curstate = STATE_LOAD_DWARF;
-      }
-    }
-    nk_layout_row_end(ctx);
-    nk_tree_state_pop(ctx);
-  }
-# undef LABEL_WIDTH
-# undef VALUE_WIDTH
-}
-
-static void panel_profile(struct nk_context *ctx, APPSTATE *state,
-                          enum nk_collapse_states tab_states[TAB_COUNT],
-                          float panel_width)
-{
-# define LABEL_WIDTH(n) ((n) * opt_fontsize)
-# define VALUE_WIDTH(n) (panel_width - LABEL_WIDTH(n) - 26)
-
-  if (nk_tree_state_push(ctx, NK_TREE_TAB, "Profile options", &tab_states[TAB_PROFILE])) {
-    int result;
-    nk_layout_row_begin(ctx, NK_STATIC, ROW_HEIGHT, 2);
-    nk_layout_row_push(ctx, LABEL_WIDTH(7));
-    nk_label(ctx, "Sample rate", NK_TEXT_ALIGN_LEFT | NK_TEXT_ALIGN_MIDDLE);
-    nk_layout_row_push(ctx, VALUE_WIDTH(7));
-    result = editctrl_tooltip(ctx, NK_EDIT_FIELD|NK_EDIT_SIG_ENTER|NK_EDIT_CLIPBOARD,
-                              state->samplingfreq_str, sizearray(state->samplingfreq_str),
-                              nk_filter_decimal, "Frequency in Hz at which the PC is sampled\n(Approximate: real sampling rate may deviate)");
-    if ((result & NK_EDIT_COMMITED) != 0 || ((result & NK_EDIT_DEACTIVATED) && strtoul(state->samplingfreq_str, NULL, 10) != state->samplingfreq))
-      state->curstate = STATE_CONFIG_PROFILE;
-    nk_layout_row_end(ctx);
-
-    nk_layout_row_begin(ctx, NK_STATIC, ROW_HEIGHT, 2);
-    nk_layout_row_push(ctx, LABEL_WIDTH(7));
-    nk_label(ctx, "Refresh interval", NK_TEXT_ALIGN_LEFT | NK_TEXT_ALIGN_MIDDLE);
-    nk_layout_row_push(ctx, VALUE_WIDTH(7));
-    result = editctrl_tooltip(ctx, NK_EDIT_FIELD|NK_EDIT_SIG_ENTER|NK_EDIT_CLIPBOARD,
-                              state->refreshrate_str, sizearray(state->refreshrate_str),
-                              nk_filter_float, "Interval in seconds between refreshes of the graph\nA fractional value can be set");
-    if ((result & NK_EDIT_COMMITED) || (result & NK_EDIT_DEACTIVATED)) {
-      state->refreshrate = strtod(state->refreshrate_str, NULL);
-      if (state->refreshrate < 0.1)
-        state->refreshrate = 1.0;
-      else if (state->refreshrate > 600.0)
-        state->refreshrate = 600.0;
-    }
-    nk_layout_row_end(ctx);
-
-    nk_layout_row_dynamic(ctx, ROW_HEIGHT, 1);
-    checkbox_tooltip(ctx, "Accumulate samples", &state->accumulate, NK_TEXT_LEFT,
-                     "Accumulate all samples since starting a profiling run");
-
-    nk_tree_state_pop(ctx);
-  }
-# undef LABEL_WIDTH
-# undef VALUE_WIDTH
-}
-
-static void panel_status(struct nk_context *ctx, APPSTATE *state,
-                         enum nk_collapse_states tab_states[TAB_COUNT],
-                         float panel_width)
-{
-# define LABEL_WIDTH(n) ((n) * opt_fontsize)
-# define VALUE_WIDTH(n) (panel_width - LABEL_WIDTH(n) - 26)
-
-  if (nk_tree_state_push(ctx, NK_TREE_TAB, "Status", &tab_states[TAB_STATUS])) {
-    char valuestr[20];
-    nk_layout_row_begin(ctx, NK_STATIC, ROW_HEIGHT, 2);
-    nk_layout_row_push(ctx, LABEL_WIDTH(8));
-    nk_label(ctx, "Real sample rate", NK_TEXT_ALIGN_LEFT | NK_TEXT_ALIGN_MIDDLE);
-    nk_layout_row_push(ctx, VALUE_WIDTH(8));
-    if (state->curstate == STATE_RUNNING)
-      sprintf(valuestr, "%lu Hz", state->actual_freq);
-    else
-      sprintf(valuestr, "-");
-    label_tooltip(ctx, valuestr, NK_TEXT_ALIGN_LEFT | NK_TEXT_ALIGN_MIDDLE, "Measured sample rate");
-    nk_layout_row_end(ctx);
-
-    nk_layout_row_begin(ctx, NK_STATIC, ROW_HEIGHT, 2);
-    nk_layout_row_push(ctx, LABEL_WIDTH(8));
-    nk_label(ctx, "Overflow events", NK_TEXT_ALIGN_LEFT | NK_TEXT_ALIGN_MIDDLE);
-    nk_layout_row_push(ctx, VALUE_WIDTH(8));
-    sprintf(valuestr, "%u", state->overflow);
-    label_tooltip(ctx, valuestr, NK_TEXT_ALIGN_LEFT | NK_TEXT_ALIGN_MIDDLE, "Overflow event count (sample rate too high)");
-    nk_layout_row_end(ctx);
-
-    nk_layout_row_begin(ctx, NK_STATIC, ROW_HEIGHT, 2);
-    nk_layout_row_push(ctx, LABEL_WIDTH(8));
-    nk_label(ctx, "Overhead", NK_TEXT_ALIGN_LEFT | NK_TEXT_ALIGN_MIDDLE);
-    nk_layout_row_push(ctx, VALUE_WIDTH(8));
-    if (state->total_samples > 0)
-      sprintf(valuestr, "%.1f%%",(100.0 * state->sample_unknown)/(double)state->total_samples);
-    else
-      strcpy(valuestr, "-");
-    label_tooltip(ctx, valuestr, NK_TEXT_ALIGN_LEFT | NK_TEXT_ALIGN_MIDDLE, "Percentage of samples in unidentified code");
-    nk_layout_row_end(ctx);
-
-    nk_tree_state_pop(ctx);
-  }
-# undef LABEL_WIDTH
-# undef VALUE_WIDTH
-}
-
-static void button_bar(struct nk_context *ctx, APPSTATE *state)
-{
-  nk_layout_row(ctx, NK_DYNAMIC, ROW_HEIGHT, 4, nk_ratio(4, 0.25, 0.25, 0.25, 0.25));
-
-  const char *ptr = (state->curstate == STATE_RUNNING) ? "Stop" : "Start";
-  if (nk_button_label(ctx, ptr) || nk_input_is_key_pressed(&ctx->input, NK_KEY_F5)) {
-    if (state->curstate == STATE_RUNNING)
-      state->curstate = STATE_STOP;
-    else if (!state->connected)
-      state->curstate = STATE_CONNECT;
-    else if (!state->attached)
-      state->curstate = STATE_ATTACH;
-    else if (state->trace_status != TRACESTAT_OK)
-      state->curstate = STATE_INIT_USB;
-    else
-      state->curstate = STATE_RUN;
-  }
-
-  if (nk_button_label(ctx, "Clear")) {
-    profile_reset(state, true);
-    state->capture_tstamp = get_timestamp();
-  }
-
-  if (nk_button_label(ctx, "Save") || nk_input_is_key_pressed(&ctx->input, NK_KEY_SAVE)) {
-    char path[_MAX_PATH];
-    int res = noc_file_dialog_open(path, sizearray(path), NOC_FILE_DIALOG_SAVE,
-                                   "CSV files\0*.csv\0All files\0*.*\0",
-                                   NULL, NULL, NULL, guidriver_apphandle());
-    if (res) {
-      const char *ext;
-      if ((ext = strrchr(path, '.')) == NULL || strchr(ext, DIRSEP_CHAR) != NULL)
-        strlcat(path, ".csv", sizearray(path)); /* default extension .csv */
-      profile_save(path, state);
-    }
-  }
-
-  if (nk_button_label(ctx, "Help") || nk_input_is_key_pressed(&ctx->input, NK_KEY_F1))
-    state->help_popup = true;
-}
-
-static void handle_stateaction(APPSTATE *state)
-{
-  switch (state->curstate) {
-  case STATE_IDLE:
-    break;
-  case STATE_CONNECT:
-    trace_close();
-    bmp_disconnect();
-    dwarf_cleanup(&dwarf_linetable, &dwarf_symboltable, &dwarf_filetable);
-    tracelog_statusclear();
-    tracelog_statusmsg(TRACESTATMSG_BMP, "Initializing...", BMPSTAT_SUCCESS);
-    state->connected = bmp_connect(state->probe, (state->probe == state->netprobe) ? state->IPaddr : NULL);
-    state->firstrun = true;
-    state->dwarf_loaded = false;
-    state->attached = false;
-    state->curstate = (state->connected) ? STATE_ATTACH : STATE_IDLE;
-    if (state->connected && state->monitor_cmds == NULL)
-      state->monitor_cmds = bmp_get_monitor_cmds();
-    break;
-  case STATE_ATTACH:
-    if (state->init_bmp) {
-      probe_set_options(state);
-      state->attached = bmp_attach(true, state->mcu_family, sizearray(state->mcu_family),
-                                   state->mcu_architecture, sizearray(state->mcu_architecture));
-      if (state->attached) {
-        /* overrule any default protocol setting, if the debug probe can be
-           verified */
-        state->probe_type = bmp_checkversionstring();
-        if (state->probe_type == PROBE_BMPv21 || state->probe_type == PROBE_BMPv23)
-          state->swomode = MODE_MANCHESTER;
-        else if (state->probe_type == PROBE_CTXLINK)
-         state->swomode = MODE_ASYNC;
-        if (strncmp(state->mcu_architecture, "M0", 2) == 0)
-          tracelog_statusmsg(TRACESTATMSG_BMP, "Cortex M0/M0+ architecture does not support profiling.", BMPSTAT_NOTICE);
-      }
-      state->curstate = (state->attached) ? STATE_LOAD_DWARF : STATE_IDLE;
-    } else {
-      state->curstate = STATE_LOAD_DWARF;
-    }
-    break;
-  case STATE_LOAD_DWARF:
-    if (!state->attached) {
-      state->curstate = STATE_IDLE;
-      break;
-    }
-    if (strlen(state->ELFfile) == 0) {
-      tracelog_statusmsg(TRACESTATMSG_BMP, "No ELF file given.", BMPSTAT_NOTICE);
-    } else if (access(state->ELFfile, 0) != 0) {
-      tracelog_statusmsg(TRACESTATMSG_BMP, "Specified ELF cannot be opened.", BMPSTAT_NOTICE);
-    } else {
-      FILE *fp = fopen(state->ELFfile, "rb");
-      if (fp != NULL) {
-        /* get range of all code sections */
-        state->code_base = state->code_top = 0;
-        for (int segm = 0; ; segm++) {
-          unsigned long vaddr, memsize;
-          int type, flags;
-          int err = elf_segment_by_index(fp, segm, &type, &flags, NULL, NULL, &vaddr, NULL, &memsize);
-          if (err != ELFERR_NONE)
-            break;
-          if (type == ELF_PT_LOAD && (flags & ELF_PF_X) != 0) {
-            /* only handle loadable segments that are executable */
-            if (state->code_base == 0 && state->code_top == 0) {
-              state->code_base = vaddr;
-              state->code_top = vaddr + memsize;
-            } else {
-              unsigned long top = vaddr + memsize;
-              if (vaddr < state->code_base)
-                state->code_base = vaddr;
-              if (top > state->code_top)
-                state->code_top = vaddr;
-            }
-          }
-        }
-        /* allocate memory for sample map */
-        unsigned count = (state->code_top - state->code_base) / ADDRESS_ALIGN + 1;  /* +1 for out-of-range samples */
-        state->sample_map = (unsigned*)malloc(count * sizeof(unsigned));
-        if (state->sample_map != NULL)
-          memset(state->sample_map, 0, count * sizeof(unsigned));
-        else
-          tracelog_statusmsg(TRACESTATMSG_BMP, "Memory allocation error.", BMPSTAT_NOTICE);
-        /* load dwarf */
-        int address_size;
-        if (dwarf_read(fp, &dwarf_linetable, &dwarf_symboltable, &dwarf_filetable, &address_size))
-          state->dwarf_loaded = true;
-        else
-          tracelog_statusmsg(TRACESTATMSG_BMP, "No debug information in ELF file (DWARF format).", BMPSTAT_NOTICE);
-        fclose(fp);
-        if (state->dwarf_loaded)
-          collect_functions(state);
-      }
-    }
-    profile_reset(state, true);
-    state->curstate = state->dwarf_loaded ? STATE_INIT_TARGET : STATE_IDLE;
-    break;
-  case STATE_INIT_TARGET:
-    if (state->init_target) {
-      state->mcuclock = strtoul(state->mcuclock_str, NULL, 10);
-      state->bitrate = strtoul(state->bitrate_str, NULL, 10);
-      state->samplingfreq = strtoul(state->samplingfreq_str, NULL, 10);
-      state->refreshrate = strtod(state->refreshrate_str, NULL);
-      int errcount = 0;
-      if (state->mcuclock < 1000) {
-        tracelog_statusmsg(TRACESTATMSG_BMP, "CPU clock frequency not set (or invalid).", BMPSTAT_NOTICE);
-        errcount += 1;
-      }
-      if (state->bitrate < 100) {
-        tracelog_statusmsg(TRACESTATMSG_BMP, "Bit rate (SWO) not set (or invalid).", BMPSTAT_NOTICE);
-        errcount += 1;
-      }
-      if (state->samplingfreq < 10) {
-        tracelog_statusmsg(TRACESTATMSG_BMP, "Sampling rate not set (or invalid).", BMPSTAT_NOTICE);
-        errcount += 1;
-      }
-      if (state->refreshrate < 0.001) {
-        tracelog_statusmsg(TRACESTATMSG_BMP, "Refresh interval not set (or invalid).", BMPSTAT_NOTICE);
-        errcount += 1;
-      }
-      if (errcount > 0) {
-        state->curstate = STATE_IDLE;
-        break;
-      }
-      unsigned long params[4];
-      /* check to get more specific information on the MCU (specifically to
-         update the mcu_family name, so that the appropriate scripts can be
-         loaded) */
-      if (bmp_runscript("partid", state->mcu_family, state->mcu_architecture, params, 1)) {
-        state->mcu_partid = params[0];
-        const MCUINFO *info = mcuinfo_lookup(state->mcu_family, state->mcu_partid);
-        if (info != NULL && info->mcuname != NULL) {
-          strlcpy(state->mcu_family, info->mcuname, sizearray(state->mcu_family));
-          bmscript_clear();
-        }
-      }
-      /* initialize the target (target-specific configuration, generic
-         configuration and channels */
-      bmp_runscript("swo_device", state->mcu_family, state->mcu_architecture, NULL, 0);
-      assert(state->swomode == MODE_MANCHESTER || state->swomode == MODE_ASYNC);
-      unsigned long swvclock = (state->swomode == MODE_MANCHESTER) ? 2 * state->bitrate : state->bitrate;
-      assert(state->mcuclock > 0 && swvclock > 0);
-      double div_value = (double)state->mcuclock / (1024 * (double)state->samplingfreq);
-      unsigned long divider = (unsigned long)(div_value + 0.5);
-      if (divider < 1)
-        divider = 1;
-      else if (divider > 16)
-        divider = 16;
-      params[0]= state->swomode;
-      params[1] = state->mcuclock / swvclock - 1;
-      params[2] = divider - 1;
-      bmp_runscript("swo_profile", state->mcu_family, state->mcu_architecture, params, 3);
-      state->init_done = true;
-    }
-    tracelog_statusmsg(TRACESTATMSG_BMP, "Starting profiling run...", BMPSTAT_SUCCESS);
-    state->curstate = STATE_RUN;
-    break;
-  case STATE_RUN:
-    tracelog_statusclear();
-    if (state->init_target && !state->init_done) {
-      state->curstate = STATE_INIT_TARGET;
-      break;
-    }
-    profile_reset(state, true);
-    state->trace_status = trace_init(state->trace_endpoint, (state->probe == state->netprobe) ? state->IPaddr : NULL);
-    state->curstate = (state->trace_status == TRACESTAT_OK) ? STATE_RUNNING : STATE_IDLE;
-    if (state->firstrun) {
-      state->capture_tstamp = get_timestamp();
-      state->actual_freq = state->samplingfreq;
-      bmp_enabletrace((state->swomode == MODE_ASYNC) ? state->bitrate : 0, &state->trace_endpoint);
-      bmp_restart();
-      state->firstrun = false;
-    }
-    state->curstate = STATE_RUNNING;
-    break;
-  case STATE_RUNNING:
-    break;
-  case STATE_STOP:
-    trace_close();
-    state->curstate = STATE_STOPPED;
-    break;
-  case STATE_STOPPED:
-    break;
-  }
-}
-
-int main(int argc, char *argv[])
-{
-  /* global defaults */
-  APPSTATE appstate;
-  memset(&appstate, 0, sizeof appstate);
-  appstate.curstate = STATE_CONNECT;
-  appstate.swomode = MODE_MANCHESTER;
-  appstate.mcuclock = 48000000;
-  appstate.bitrate = 100000;
-  appstate.probe_type = PROBE_UNKNOWN;
-  appstate.trace_endpoint = BMP_EP_TRACE;
-  appstate.init_target = nk_true;
-  appstate.init_bmp = nk_true;
-  appstate.connect_srst = nk_false;
-  appstate.view = VIEW_TOP;
-
-# if defined FORTIFY
-    Fortify_SetOutputFunc(Fortify_OutputFunc);
-# endif
-
-  char txtConfigFile[_MAX_PATH];
-  get_configfile(txtConfigFile, sizearray(txtConfigFile), "bmprofile.ini");
-  enum nk_collapse_states tab_states[TAB_COUNT];
-  SPLITTERBAR splitter_hor;
-  load_settings(txtConfigFile, &appstate, tab_states, &splitter_hor);
-  /* other configuration */
-  opt_fontsize = ini_getf("Settings", "fontsize", FONT_HEIGHT, txtConfigFile);
-  char opt_fontstd[64] = "", opt_fontmono[64] = "";
-  ini_gets("Settings", "fontstd", "", opt_fontstd, sizearray(opt_fontstd), txtConfigFile);
-  ini_gets("Settings", "fontmono", "", opt_fontmono, sizearray(opt_fontmono), txtConfigFile);
-  char valstr[128];
-  int canvas_width, canvas_height;
-  ini_gets("Settings", "size", "", valstr, sizearray(valstr), txtConfigFile);
-  if (sscanf(valstr, "%d %d", &canvas_width, &canvas_height) != 2 || canvas_width < 100 || canvas_height < 50) {
-    canvas_width = WINDOW_WIDTH;
-    canvas_height = WINDOW_HEIGHT;
-  }
-
-# define SEPARATOR_HOR 4
-# define SPACING       4
-  nk_splitter_init(&splitter_hor, canvas_width - 3 * SPACING, SEPARATOR_HOR, splitter_hor.ratio);
-
-  for (int idx = 1; idx < argc; idx++) {
-    const char *ptr;
-    float h;
-    if (IS_OPTION(argv[idx])) {
-      switch (argv[idx][1]) {
-      case '?':
-      case 'h':
-        usage(NULL);
-        return EXIT_SUCCESS;
-      case 'f':
-        ptr = &argv[idx][2];
-        if (*ptr == '=' || *ptr == ':')
-          ptr++;
-        h = (float)strtod(ptr, (char**)&ptr);
-        if (h >= 8.0)
-          opt_fontsize = h;
-        if (*ptr == ',') {
-          char *mono;
-          ptr++;
-          if ((mono = strchr(ptr, ',')) != NULL)
-            *mono++ = '\0';
-          if (*ptr != '\0')
-            strlcpy(opt_fontstd, ptr, sizearray(opt_fontstd));
-          if (mono != NULL && *mono == '\0')
-            strlcpy(opt_fontmono, mono, sizearray(opt_fontmono));
-        }
-        break;
-      case 'v':
-        version();
-        return EXIT_SUCCESS;
-      default:
-        usage(argv[idx]);
-        return EXIT_FAILURE;
-      }
-    } else {
-      /* filename on the command line must be in native format (using backslashes
-         on Windows) */
-      if (access(argv[idx], 0) == 0)
-        strlcpy(appstate.ELFfile, argv[idx], sizearray(appstate.ELFfile));
-    }
-  }
-  if (strlen(appstate.ELFfile) == 0) {
-    ini_gets("Session", "recent", "", appstate.ELFfile, sizearray(appstate.ELFfile), txtConfigFile);
-    if (access(appstate.ELFfile, 0) != 0)
-      appstate.ELFfile[0] = '\0';
-  }
-
-  /* if a target filename is known, create the parameter filename from target
-     filename and read target-specific options */
-  if (strlen(appstate.ELFfile) > 0) {
-    strlcpy(appstate.ParamFile, appstate.ELFfile, sizearray(appstate.ParamFile));
-    strlcat(appstate.ParamFile, ".bmcfg", sizearray(appstate.ParamFile));
-    load_targetoptions(appstate.ParamFile, &appstate);
-  }
-
-  /* collect debug probes, initialize interface */
-  appstate.probelist = get_probelist(&appstate.probe, &appstate.netprobe);
-  tcpip_init();
-  bmp_setcallback(bmp_callback);
-
-  struct nk_context *ctx = guidriver_init("BlackMagic Profiler", canvas_width, canvas_height,
-                                          GUIDRV_RESIZEABLE | GUIDRV_TIMER,
-                                          opt_fontstd, opt_fontmono, opt_fontsize);
-  nuklear_style(ctx);
-
-  int waitidle = 1;
-  for ( ;; ) {
-    /* handle state */
-    handle_stateaction(&appstate);
-
-    /* Input */
-    nk_input_begin(ctx);
-    if (!guidriver_poll(waitidle))
-      break;
-    nk_input_end(ctx);
-
-    /* other events */
-    int dev_event = guidriver_monitor_usb(0x1d50, 0x6018);
-    if (dev_event != 0) {
-      if (dev_event == DEVICE_REMOVE)
-        bmp_disconnect();
-      appstate.curstate = STATE_CONNECT; /* BMP was inserted or removed */
-    }
-
-    /* GUI */
-    guidriver_appsize(&canvas_width, &canvas_height);
-    if (nk_begin(ctx, "MainPanel", nk_rect(0, 0, canvas_width, canvas_height), NK_WINDOW_NO_SCROLLBAR)) {
-      nk_splitter_resize(&splitter_hor, canvas_width - 3 * SPACING, RESIZE_TOPLEFT);
-      nk_hsplitter_layout(ctx, &splitter_hor, canvas_height - 2 * SPACING);
-      ctx->style.window.padding.x = 2;
-      ctx->style.window.padding.y = 2;
-      ctx->style.window.group_padding.x = 0;
-      ctx->style.window.group_padding.y = 0;
-
-      /* left column */
-      if (nk_group_begin(ctx, "left", NK_WINDOW_NO_SCROLLBAR)) {
-        /* buttons */
-        button_bar(ctx, &appstate);
-
-        /* profile graph */
-        int events = traceprofile_process(appstate.curstate == STATE_RUNNING, appstate.sample_map,
-                                          appstate.code_base, appstate.code_top,
-                                          &appstate.overflow);
-        waitidle = (events == 0);
-        /* if interval has passed, make copy of data for the graph */
-        double tstamp = get_timestamp();
-        if (tstamp - appstate.refresh_tstamp >= appstate.refreshrate && appstate.sample_map != NULL) {
-          appstate.refresh_tstamp = tstamp;
-          if (appstate.view == VIEW_TOP)
-            profile_graph_top(&appstate);
-          else
-            profile_graph_source(&appstate);
-          double freq = appstate.total_samples / (tstamp - appstate.capture_tstamp);
-          appstate.actual_freq = (appstate.actual_freq + (unsigned long)(freq + 0.5)) / 2;
-          if (appstate.curstate == STATE_RUNNING && !appstate.accumulate) {
-            unsigned count = (appstate.code_top - appstate.code_base) / ADDRESS_ALIGN + 1;
-            memset(appstate.sample_map, 0, count * sizeof(unsigned));
-            appstate.capture_tstamp = tstamp;
-          }
-        }
-        nk_layout_row_dynamic(ctx, canvas_height - ROW_HEIGHT - 3 * SPACING, 1);
-        profile_graph(ctx, "graph", &appstate, opt_fontsize, NK_WINDOW_BORDER);
-
-        nk_group_end(ctx);
-      }
-
-      /* column splitter */
-      nk_hsplitter(ctx, &splitter_hor);
-
-      /* right column */
-      if (nk_group_begin(ctx, "right", NK_WINDOW_BORDER)) {
-        panel_options(ctx, &appstate, tab_states, nk_hsplitter_colwidth(&splitter_hor, 1));
-        panel_profile(ctx, &appstate, tab_states, nk_hsplitter_colwidth(&splitter_hor, 1));
-        panel_status(ctx, &appstate, tab_states, nk_hsplitter_colwidth(&splitter_hor, 1));
-        nk_group_end(ctx);
-      }
-
-      /* popup dialogs */
-      help_popup(ctx, &appstate, canvas_width, canvas_height);
-
-      /* mouse cursor shape */
-      if (nk_is_popup_open(ctx))
-        pointer_setstyle(CURSOR_NORMAL);
-      else if (splitter_hor.hover)
-        pointer_setstyle(CURSOR_LEFTRIGHT);
-#if defined __linux__
-      else
-        pointer_setstyle(CURSOR_NORMAL);
-#endif
-    }
-
-    nk_end(ctx);
-
-    /* Draw */
-    guidriver_render(COLOUR_BG0_S);
-  }
-
-  save_settings(txtConfigFile, &appstate, tab_states, &splitter_hor);
-  save_targetoptions(appstate.ParamFile, &appstate);
-  sprintf(valstr, "%d %d", canvas_width, canvas_height);
-  ini_puts("Settings", "size", valstr, txtConfigFile);
-  ini_puts("Session", "recent", appstate.ELFfile, txtConfigFile);
-
-  clear_functions(&appstate);
-  clear_probelist(appstate.probelist, appstate.netprobe);
-  if (appstate.monitor_cmds != NULL)
-    free((void*)appstate.monitor_cmds);
-  trace_close();
-  guidriver_close();
-  tracestring_clear();
-  bmscript_clear();
-  gdbrsp_packetsize(0);
-  dwarf_cleanup(&dwarf_linetable, &dwarf_symboltable, &dwarf_filetable);
-  bmp_disconnect();
-  tcpip_cleanup();
-  return EXIT_SUCCESS;
-}
-
+/*
+ * Statistical Profiler for the Black Magic Probe, using the PC sampler of the
+ * DWT/ITM modules of the Cortex debug architecture. This utility is built with
+ * Nuklear for a cross-platform GUI.
+ *
+ * Copyright 2022-2023 CompuPhase
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#if defined WIN32 || defined _WIN32
+# define STRICT
+# define WIN32_LEAN_AND_MEAN
+# define _WIN32_WINNT   0x0500 /* for AttachConsole() */
+# include <windows.h>
+# include <io.h>
+# include <malloc.h>
+# if defined __MINGW32__ || defined __MINGW64__
+#   include "strlcpy.h"
+# elif defined _MSC_VER
+#   include "strlcpy.h"
+#   define access(p,m)       _access((p),(m))
+# endif
+#elif defined __linux__
+# include <alloca.h>
+# include <pthread.h>
+# include <unistd.h>
+# include <bsd/string.h>
+# include <sys/stat.h>
+# include <sys/time.h>
+#endif
+#include <assert.h>
+#include <limits.h>
+#include <signal.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "bmcommon.h"
+#include "bmp-script.h"
+#include "bmp-scan.h"
+#include "bmp-support.h"
+#include "coverage.h"
+#include "crc32.h"
+#include "demangle.h"
+#include "dwarf.h"
+#include "elf.h"
+#include "export.h"
+#include "gdb-rsp.h"
+#include "guidriver.h"
+#include "mcu-info.h"
+#include "minIni.h"
+#include "noc_file_dialog.h"
+#include "nuklear_guide.h"
+#include "nuklear_mousepointer.h"
+#include "nuklear_splitter.h"
+#include "nuklear_style.h"
+#include "nuklear_tooltip.h"
+#include "swotrace.h"
+#include "tcpip.h"
+#include "svnrev.h"
+
+#if defined FORTIFY
+# include <alloc/fortify.h>
+#endif
+
+#if defined __linux__ || defined __unix__
+# include "res/icon_profile_64.h"
+#endif
+
+#if !defined _MAX_PATH
+# define _MAX_PATH 260
+#endif
+
+#if !defined sizearray
+# define sizearray(e)    (sizeof(e) / sizeof((e)[0]))
+#endif
+
+#if defined WIN32 || defined _WIN32
+# define DIRSEP_CHAR '\\'
+# define IS_OPTION(s)  ((s)[0] == '-' || (s)[0] == '/')
+#else
+# define DIRSEP_CHAR '/'
+# define IS_OPTION(s)  ((s)[0] == '-')
+#endif
+
+
+static DWARF_LINELOOKUP dwarf_linetable = { NULL };
+static DWARF_SYMBOLLIST dwarf_symboltable = { NULL};
+static DWARF_PATHLIST dwarf_filetable = { NULL};
+
+#define WINDOW_WIDTH    700     /* default window size (window is resizable) */
+#define WINDOW_HEIGHT   400
+#define FONT_HEIGHT     14      /* default font size */
+#define ROW_HEIGHT      (1.6 * opt_fontsize)
+#define COMBOROW_CY     (0.9 * opt_fontsize)
+#define BROWSEBTN_WIDTH (1.5 * opt_fontsize)
+static float opt_fontsize = FONT_HEIGHT;
+
+
+int ctf_error_notify(int code, int linenr, const char *message)
+{
+  /* This function is not used in the profiler, but required as a dependency
+     due to the "swotrace" module */
+  (void)code;
+  (void)linenr;
+  (void)message;
+  return 0;
+}
+
+static int bmp_callback(int code, const char *message)
+{
+  tracelog_statusmsg(TRACESTATMSG_BMP, message, code);
+  return code >= 0;
+}
+
+static void usage(const char *invalid_option)
+{
+# if defined _WIN32  /* fix console output on Windows */
+    if (AttachConsole(ATTACH_PARENT_PROCESS)) {
+      freopen("CONOUT$", "wb", stdout);
+      freopen("CONOUT$", "wb", stderr);
+    }
+    printf("\n");
+# endif
+
+  if (invalid_option != NULL)
+    fprintf(stderr, "Unknown option %s; use -h for help.\n\n", invalid_option);
+  else
+    printf("BMProfile - Statistical Profiler for the Black Magic Probe.\n\n");
+  printf("Usage: bmprofile [options] [filename]\n\n"
+         "Options:\n"
+         "-a[=path] Accumulate the code coverage of the run into a database (the\n"
+         "          default path is the ELF file with extension .bmcov). This is\n"
+         "          statistical coverage: a line is only marked as covered if a\n"
+         "          sample hit one of its addresses.\n"
+         "-c[=path] Profile without GUI; the top functions and source lines are\n"
+         "          written to standard output (or to the file) at the end of the\n"
+         "          run, or when Ctrl-C is pressed.\n"
+         "-d=sec    Duration of a profiling run in capture mode (-c), default 10.\n"
+         "-f=value  Font size to use (value must be 8 or larger).\n"
+         "-h        This help.\n"
+         "-j        Write the report in capture mode (-c) or the coverage report\n"
+         "          (-r) as JSON, instead of CSV.\n"
+         "-m=path   Merge a coverage database (e.g. from another device) into the\n"
+         "          database set with -a; this option may be repeated.\n"
+         "-n=count  The number of functions and lines in the report of capture\n"
+         "          mode (-c), default 10.\n"
+         "-r[=path] Write a coverage report of the database set with -a, to standard\n"
+         "          output (or to the file); without -c, the report is written\n"
+         "          without connecting to the target.\n"
+         "-s=path   Stream the function counts to a file, in the \"folded stacks\"\n"
+         "          format for flame graphs (the data is appended to the file).\n\n"
+         "filename  Path to the ELF file to profile (must contain debug info).\n"
+         "-v        Show version information.\n");
+}
+
+static void version(void)
+{
+# if defined _WIN32  /* fix console output on Windows */
+    if (AttachConsole(ATTACH_PARENT_PROCESS)) {
+      freopen("CONOUT$", "wb", stdout);
+      freopen("CONOUT$", "wb", stderr);
+    }
+    printf("\n");
+# endif
+
+  printf("BMProfile version %s.\n", SVNREV_STR);
+  printf("Copyright 2022-2023 CompuPhase\nLicensed under the Apache License version 2.0\n");
+}
+
+#if defined FORTIFY
+  void Fortify_OutputFunc(const char *str, int type)
+  {
+#   if defined _WIN32  /* fix console output on Windows */
+      if (AttachConsole(ATTACH_PARENT_PROCESS)) {
+        freopen("CONOUT$", "wb", stdout);
+        freopen("CONOUT$", "wb", stderr);
+      }
+#   endif
+    printf("Fortify: [%d] %s\n", type, str);
+  }
+#endif
+
+#define SLICE_COUNT 600  /* number of time slices kept */
+#define TASK_COUNT  64   /* max. number of tasks with a histogram */
+#define LINEMAP_MAXRANGE  (4ul * 1024 * 1024)  /* max. code range for the address-to-line map */
+
+enum {
+  TAB_CONFIGURATION,
+  TAB_PROFILE,
+  TAB_STATUS,
+  /* --- */
+  TAB_COUNT
+};
+
+enum {
+  MODE_MANCHESTER = 1,
+  MODE_ASYNC
+};
+
+enum {
+  VIEW_TOP,
+  VIEW_FUNCTION,
+};
+
+typedef struct tagFUNCTIONINFO {
+  const char *name;
+  bool mangled;                 /**< name (from the ELF symbol table) is not yet demangled */
+  uint32_t addr_low, addr_high;
+  int line_low, line_high;      /**< line number range in the source file */
+  short fileindex;              /**< file index in DWARF table */
+  unsigned count;               /**< sample count (for the function) */
+  double ratio;                 /**< scaling ratio (bar graph) */
+  char percentage[16];          /**< formatted string (formatted when first displayed) */
+} FUNCTIONINFO;
+
+typedef struct tagADDRLINE {
+  int line;                     /**< line number, 0 if the address has no line info */
+  short fileindex;              /**< file index in DWARF table */
+} ADDRLINE;
+
+typedef struct tagLINESAMPLE {
+  int fileindex;
+  int line;
+  unsigned count;
+} LINESAMPLE;
+
+typedef struct tagLINEINFO {
+  const char *text;
+  unsigned linenr;
+  unsigned count;               /**< sample count (for the source line) */
+  double ratio;                 /**< scaling ratio (bar graph) */
+  char percentage[16];          /**< pre-formatted string */
+} LINEINFO;
+
+typedef struct tagAPPSTATE {
+  int curstate;                 /**< current state */
+  int probe;                    /**< selected debug probe (index) */
+  int netprobe;                 /**< index for the IP address (pseudo-probe) */
+  const char **probelist;       /**< list of detected probes */
+  char mcu_family[64];          /**< detected MCU family (on attach), also the "driver" name of BMP */
+  char mcu_architecture[32];    /**< detected ARM architecture (on attach) */
+  unsigned long mcu_partid;     /**< specific ID code (0 if unknown) */
+  const char *monitor_cmds;     /**< list of "monitor" commands (target & probe dependent) */
+  char IPaddr[64];              /**< IP address for network probe */
+  unsigned char trace_endpoint; /**< standard USB endpoint for tracing */
+  int probe_type;               /**< BMP or ctxLink (needed to select manchester/async mode) */
+  int swomode;                  /**< manchester or async */
+  int init_target;              /**< whether to configure the target MCU for tracing */
+  nk_bool init_bmp;             /**< whether to configure the debug probe for tracing */
+  int connect_srst;             /**< whether to force reset while attaching */
+  char mcuclock_str[16];        /**< edit buffer for CPU clock frequency */
+  unsigned long mcuclock;       /**< active CPU clock frequency */
+  char bitrate_str[16];         /**< edit buffer for bitrate */
+  unsigned long bitrate;        /**< active bitrate */
+  int trace_status;             /**< status of the USB or TCP/IP configuration for SWO tracing */
+  bool connected;               /**< connected to BMP? */
+  bool attached;                /**< attached to target? */
+  bool dwarf_loaded;            /**< whether DWARF information is valid */
+  bool init_done;               /**< whether target & BMP have been initialized (assuming init_target is set) */
+  bool firstrun;                /**< is this the first run after a connect? */
+  int view;                     /**< histogram or function list */
+  char refreshrate_str[16];     /**< edit buffer for refresh intreval */
+  double refreshrate;           /**< refresh interval */
+  double refresh_tstamp;        /**< timestamp of most recent refresh */
+  double capture_tstamp;        /**< time stamp of the start of collecting the samples */
+  char samplingfreq_str[16];    /**< edit buffer for sampling frequency */
+  unsigned long samplingfreq;   /**< set sampling frequency */
+  unsigned long actual_freq;    /**< calculated sampling frequency */
+  int adaptive;                 /**< adjust the sampling rate to the capacity of the SWO link */
+  int rate_level;               /**< adaptive rate: current sampling interval (index) */
+  int rate_ceiling;             /**< adaptive rate: fastest level that overflowed, -1 = none */
+  int rate_stable;              /**< adaptive rate: number of steps without overflow */
+  unsigned rate_overflow;       /**< adaptive rate: overflow count at the previous step */
+  double rate_tstamp;           /**< adaptive rate: timestamp of the previous step */
+  int accumulate;               /**< accumulate all samples since start of a run */
+  char timeslice_str[16];       /**< edit buffer for the time slice duration */
+  unsigned long timeslice;      /**< time slice duration in ms, 0 = no time slices */
+  int slice_view;               /**< top view: time slice on view (1-based), 0 = live histogram */
+  unsigned *slice_counts;       /**< top view: function counts of the time slice on view */
+  char taskchannel_str[8];      /**< edit buffer for the task-switch channel */
+  int task_channel;             /**< ITM channel for task switches, -1 = off */
+  int task_view;                /**< top view: task on view (1-based), 0 = all tasks */
+  unsigned *task_counts;        /**< top view: function counts of the task on view */
+  char ELFfile[_MAX_PATH];      /**< ELF file for symbol/address look-up */
+  char ParamFile[_MAX_PATH];    /**< debug parameters for the ELF file */
+  unsigned long code_base;      /**< low address of code range of the ELF file */
+  unsigned long code_top;       /**< top address */
+  SAMPLEMAP *sample_map;        /**< (sparse) histogram with the sample counts */
+  unsigned sample_unknown;      /**< samples that fall outside the ELF file address range */
+  unsigned total_samples;       /**< total number of samples collected */
+  unsigned overflow;            /**< number of overflow packets reported */
+  unsigned numfunctions;        /**< top view: number of functions in the function list */
+  FUNCTIONINFO *functionlist;   /**< top view: name + address range of al functions (sorted on address) */
+  unsigned *functionorder;      /**< top view: indices in the function list for ordering by hit count */
+  uint32_t *function_ranges;    /**< top view: address ranges of the functions, for the sample map */
+  unsigned *function_counts;    /**< top view: sample counts per function, plus one for unknown samples */
+  FILE *fpStream;               /**< file for the streaming export (folded stacks), or NULL */
+  unsigned *stream_counts;      /**< function counts at the most recent streaming export */
+  unsigned numlines;            /**< source view: number of source lines */
+  LINEINFO *sourcelines;        /**< source view: source text */
+  int source_fileindex;         /**< source view: file index of the source file */
+  ADDRLINE *line_map;           /**< file & line for every address in the code range (built on loading the ELF file) */
+  uint32_t elf_id;              /**< checksum of the code in the ELF file (identifies the build) */
+  char CoverageFile[_MAX_PATH]; /**< coverage database to accumulate into, empty if coverage is not collected */
+  COVERAGE *coverage;           /**< executed addresses (marked from the samples) */
+  bool help_popup;              /**< whether "help" popup is active */
+  int export_percent;           /**< progress of a background save (-1 if none is busy) */
+} APPSTATE;
+
+enum {
+  STATE_IDLE,
+  STATE_CONNECT,        /**< connect to BMP */
+  STATE_ATTACH,         /**< attach to target MCU */
+  STATE_INIT_USB,
+  STATE_LOAD_DWARF,
+  STATE_INIT_TARGET,
+  STATE_CONFIG_PROFILE,
+  STATE_RUN,            /**< start to run */
+  STATE_RUNNING,        /**< currently sampling */
+  STATE_STOP,           /**< stop running */
+  STATE_STOPPED,
+};
+
+static bool save_settings(const char *filename, const APPSTATE *state,
+                          const enum nk_collapse_states tab_states[],
+                          const SPLITTERBAR *splitter_hor)
+{
+  assert(filename != NULL);
+  assert(state != NULL);
+  assert(tab_states != NULL);
+  assert(splitter_hor != NULL);
+
+  if (strlen(filename) == 0)
+    return false;
+
+  ini_putl("Settings", "init-target", state->init_target, filename);
+  ini_putl("Settings", "init-bmp", state->init_bmp, filename);
+  ini_putf("Settings", "splitter", splitter_hor->ratio, filename);
+  for (int idx = 0; idx < TAB_COUNT; idx++) {
+    char key[40];
+    sprintf(key, "view%d", idx);
+    ini_putl("Settings", key, tab_states[idx], filename);
+  }
+
+  if (bmp_is_ip_address(state->IPaddr))
+    ini_puts("Settings", "ip-address", state->IPaddr, filename);
+  ini_putl("Settings", "probe", (state->probe == state->netprobe) ? 99 : state->probe, filename);
+
+  return access(filename, 0) == 0;
+}
+
+static bool load_settings(const char *filename, APPSTATE *state,
+                          enum nk_collapse_states tab_states[],
+                          SPLITTERBAR *splitter_hor)
+{
+  assert(filename != NULL);
+  assert(state != NULL);
+  assert(tab_states != NULL);
+  assert(splitter_hor != NULL);
+
+  state->init_target = (int)ini_getl("Settings", "init-target", 1, filename);
+  state->init_bmp = (nk_bool)ini_getl("Settings", "init-bmp", 1, filename);
+  state->probe = (int)ini_getl("Settings", "probe", 0, filename);
+  ini_gets("Settings", "ip-address", "127.0.0.1", state->IPaddr, sizearray(state->IPaddr), filename);
+
+  splitter_hor->ratio = ini_getf("Settings", "splitter", 0.0, filename);
+  if (splitter_hor->ratio < 0.05 || splitter_hor->ratio > 0.95)
+    splitter_hor->ratio = 0.70;
+
+  for (int idx = 0; idx < TAB_COUNT; idx++) {
+    char key[40], valstr[100];
+    int opened, result;
+    tab_states[idx] = NK_MAXIMIZED;
+    sprintf(key, "view%d", idx);
+    ini_gets("Settings", key, "", valstr, sizearray(valstr), filename);
+    result = sscanf(valstr, "%d", &opened);
+    if (result >= 1)
+      tab_states[idx] = opened;
+  }
+
+  return true;
+}
+
+static bool save_targetoptions(const char *filename, APPSTATE *state)
+{
+  assert(state != NULL);
+
+  if (filename == NULL || strlen(filename) == 0)
+    return false;
+
+  ini_putl("Settings", "connect-srst", state->connect_srst, filename);
+  ini_putl("SWO trace", "mode", state->swomode, filename);
+  ini_putl("SWO trace", "clock", state->mcuclock, filename);
+  ini_putl("SWO trace", "bitrate", state->bitrate, filename);
+
+  ini_putl("Profile", "sample-rate", state->samplingfreq, filename);
+  ini_putf("Profile", "refresh-rate", state->refreshrate, filename);
+  ini_putl("Profile", "accumulate", state->accumulate, filename);
+  ini_putl("Profile", "adaptive-rate", state->adaptive, filename);
+  ini_putl("Profile", "time-slice", state->timeslice, filename);
+  ini_putl("Profile", "task-channel", state->task_channel, filename);
+
+  return access(filename, 0) == 0;
+}
+
+static bool load_targetoptions(const char *filename, APPSTATE *state)
+{
+  assert(state != NULL);
+
+  if (filename == NULL || strlen(filename) == 0 || access(filename, 0) != 0)
+    return false;
+
+  state->connect_srst = (int)ini_getl("Settings", "connect-srst", 0, filename);
+  state->swomode = (int)ini_getl("SWO trace", "mode", MODE_MANCHESTER, filename);
+  state->mcuclock = ini_getl("SWO trace", "clock", 48000000, filename);
+  state->bitrate = ini_getl("SWO trace", "bitrate", 100000, filename);
+
+  state->samplingfreq = ini_getl("Profile", "sample-rate", 1000, filename);
+  state->refreshrate = ini_getf("Profile", "refresh-rate", 1.0, filename);
+  state->accumulate = (int)ini_getl("Profile", "accumulate", 0, filename);
+  state->adaptive = (int)ini_getl("Profile", "adaptive-rate", 0, filename);
+  state->timeslice = ini_getl("Profile", "time-slice", 0, filename);
+  state->task_channel = (int)ini_getl("Profile", "task-channel", -1, filename);
+
+  if (state->samplingfreq == 0)
+    state->samplingfreq = 1000;
+  if (state->refreshrate < 0.1)
+    state->refreshrate = 1.0;
+  if (state->task_channel < -1 || state->task_channel > 31)
+    state->task_channel = -1;
+
+  sprintf(state->mcuclock_str, "%lu", state->mcuclock);
+  sprintf(state->bitrate_str, "%lu", state->bitrate);
+  sprintf(state->samplingfreq_str, "%lu", state->samplingfreq);
+  sprintf(state->refreshrate_str, "%.1f", state->refreshrate);
+  sprintf(state->timeslice_str, "%lu", state->timeslice);
+  if (state->task_channel >= 0)
+    sprintf(state->taskchannel_str, "%d", state->task_channel);
+  else
+    state->taskchannel_str[0] = '\0';
+  return true;
+}
+
+static void probe_set_options(APPSTATE *state)
+{
+  if (bmp_isopen()) {
+    char cmd[100];
+    if (bmp_expand_monitor_cmd(cmd, sizearray(cmd), "connect", state->monitor_cmds)) {
+      strlcat(cmd, " ", sizearray(cmd));
+      strlcat(cmd, state->connect_srst ? "enable" : "disable", sizearray(cmd));
+      if (!bmp_monitor(cmd))
+        bmp_callback(BMPERR_MONITORCMD, "Setting connect-with-reset option failed");
+    }
+  }
+}
+
+/* function_name() returns the name of the function; names are demangled on
+   first use */
+static const char *function_name(FUNCTIONINFO *func)
+{
+  assert(func != NULL && func->name != NULL);
+  if (func->mangled) {
+    char plain[256];
+    if (demangle(plain, sizearray(plain), func->name)) {
+      char *name = strdup(plain);
+      if (name != NULL) {
+        free((void*)func->name);
+        func->name = name;
+      }
+    }
+    func->mangled = false;
+  }
+  return func->name;
+}
+
+static void profile_graph(struct nk_context *ctx, const char *id, APPSTATE *state, float rowheight, nk_flags widget_flags)
+{
+  assert(ctx != NULL);
+  struct nk_rect rcwidget = nk_layout_widget_bounds(ctx);
+  float graphwidth = rcwidget.w * 0.25;
+  float lineheight = 0.0;
+  int linecount = 0;
+
+  struct nk_window *win = ctx->current;
+  struct nk_user_font const *font = ctx->style.font;
+
+  struct nk_style_window *stwin = &ctx->style.window;
+  nk_style_push_color(ctx, &stwin->fixed_background.data.color, COLOUR_BG0);
+  if (nk_group_begin(ctx, id, widget_flags)) {
+    if (tracelog_getstatusmsg(0) != NULL) {
+      const char *text;
+      for (int idx = 0; (text = tracelog_getstatusmsg(idx)) != NULL; idx++) {
+        struct nk_color clr = COLOUR_FG_YELLOW;
+        nk_layout_row_dynamic(ctx, rowheight, 1);
+        nk_label_colored(ctx, text, NK_TEXT_LEFT, clr);
+      }
+    } else if (state->view == VIEW_TOP) {
+      for (unsigned idx = 0; idx < state->numfunctions; idx++) {
+        unsigned fidx = state->functionorder[idx];
+        assert(fidx < state->numfunctions);
+        nk_layout_row_begin(ctx, NK_STATIC, rowheight, 2);
+        if (lineheight < 0.1) {
+          struct nk_rect rcline = nk_layout_widget_bounds(ctx);
+          lineheight = rcline.h;
+        }
+        /* draw bar */
+        nk_layout_row_push(ctx, graphwidth);
+        struct nk_rect rc = nk_widget_bounds(ctx);
+        FUNCTIONINFO *func = &state->functionlist[fidx];
+        assert(func->ratio >= 0.0 && func->ratio <= 1.0);
+        struct nk_rect clip = win->layout->clip;
+        if (!NK_INTERSECT(rc.x, rc.y, rc.w, rc.h, clip.x, clip.y, clip.w, clip.h)) {
+          /* row is scrolled out of view, only reserve the space for it */
+          nk_label(ctx, "", NK_TEXT_RIGHT);
+          nk_layout_row_end(ctx);
+          linecount += 1;
+          continue;
+        }
+        rc.w *= func->ratio;
+        nk_fill_rect(&win->buffer, rc, 0.0f, COLOUR_BG_YELLOW);
+        if (func->percentage[0] == '\0' && state->total_samples > 0)
+          sprintf(func->percentage, "%5.1f%%  ", 100.0 * func->count / state->total_samples);
+        nk_label(ctx, func->percentage, NK_TEXT_RIGHT);
+        /* print function name (get the width for the text first) */
+        const char *name = function_name(func);
+        int len = strlen(name);
+        assert(font != NULL && font->width != NULL);
+        int textwidth = (int)font->width(font->userdata, font->height, name, len) + 10;
+        nk_layout_row_push(ctx, textwidth);
+        nk_text(ctx, name, len, NK_TEXT_LEFT);
+        nk_layout_row_end(ctx);
+        linecount += 1;
+      }
+    } else {
+      assert(state->view == VIEW_FUNCTION);
+      for (unsigned idx = 0; idx < state->numlines; idx++) {
+        nk_layout_row_begin(ctx, NK_STATIC, rowheight, 2);
+        if (lineheight < 0.1) {
+          struct nk_rect rcline = nk_layout_widget_bounds(ctx);
+          lineheight = rcline.h;
+        }
+        /* draw bar */
+        nk_layout_row_push(ctx, graphwidth);
+        struct nk_rect rc = nk_widget_bounds(ctx);
+        rc.w *= state->sourcelines[idx].ratio;
+        nk_fill_rect(&win->buffer, rc, 0.0f, COLOUR_BG_YELLOW);
+        nk_label(ctx, state->sourcelines[idx].percentage, NK_TEXT_RIGHT);
+        /* print source line (get the width for the text first) */
+        const char *text = state->sourcelines[idx].text;
+        int len = strlen(text);
+        assert(font != NULL && font->width != NULL);
+        int textwidth = (int)font->width(font->userdata, font->height, text, len) + 10;
+        nk_layout_row_push(ctx, textwidth);
+        nk_text(ctx, text, len, NK_TEXT_LEFT);
+        nk_layout_row_end(ctx);
+        linecount += 1;
+      }
+    }
+    nk_group_end(ctx);
+  }
+  nk_style_pop_color(ctx);
+
+  /* handle mouse input (reduce width & height of rcwidget, so that a click on
+     a scrollbar is not taken into account */
+  rcwidget.w -= 16;
+  rcwidget.h -= 16;
+  if (nk_input_is_mouse_hovering_rect(&ctx->input, rcwidget) && lineheight >= 0.1 && tracelog_getstatusmsg(0) == NULL) {
+    struct nk_mouse *mouse = &ctx->input.mouse;
+    assert(mouse != NULL);
+    assert(NK_INBOX(mouse->pos.x, mouse->pos.y, rcwidget.x, rcwidget.y, rcwidget.w, rcwidget.h));
+    unsigned xscroll, yscroll;
+    nk_group_get_scroll(ctx, id, &xscroll, &yscroll);
+    int row = (int)(((mouse->pos.y - rcwidget.y) + yscroll) / lineheight);
+    if (row < linecount) {
+      if (nk_input_mouse_clicked(&ctx->input, NK_BUTTON_LEFT, rcwidget)) {
+        /* clear source-code data (regardless of whether moving into the source
+           code view or returning to the function list */
+        if (state->sourcelines != NULL) {
+          for (unsigned idx = 0; idx < state->numlines; idx++) {
+            assert(state->sourcelines[idx].text != NULL);
+            if (state->sourcelines[idx].text != NULL)
+              free((void*)state->sourcelines[idx].text);
+          }
+          free((void*)state->sourcelines);
+          state->sourcelines = NULL;
+        }
+        state->numlines = 0;
+        state->source_fileindex = -1;
+        /* toggle view */
+        state->view = (state->view == VIEW_TOP) ? VIEW_FUNCTION : VIEW_TOP;
+        if (state->view == VIEW_FUNCTION) {
+          assert(row < state->numfunctions);
+          unsigned fidx = state->functionorder[row];
+          assert(fidx < state->numfunctions);
+          state->source_fileindex = state->functionlist[fidx].fileindex;
+          /* load source code for the function */
+          FILE *fp = NULL;
+          const char *path = (state->functionlist[fidx].line_low > 0) ? dwarf_path_from_fileindex(&dwarf_filetable, state->functionlist[fidx].fileindex) : NULL;
+          if (path != NULL) {
+            fp = fopen(path, "rt");
+            if (fp == NULL) {
+              /* get directory of ELF file, append "path" and retry */
+              char fullpath[_MAX_PATH];
+              strlcpy(fullpath, state->ELFfile, sizearray(fullpath));
+              char *ptr = strrchr(fullpath, DIRSEP_CHAR);
+              if (ptr != NULL)
+                *(ptr + 1) = '\0';
+              strlcat(fullpath, path, sizearray(fullpath));
+              fp = fopen(fullpath, "rt");
+            }
+          }
+          if (fp != NULL) {
+            unsigned numlines = state->functionlist[fidx].line_high - state->functionlist[fidx].line_low;
+            state->sourcelines = (LINEINFO*)malloc(numlines * sizeof(LINEINFO));
+            if (state->sourcelines != NULL) {
+              memset(state->sourcelines, 0, numlines * sizeof(LINEINFO));
+              char text[200];
+              for (unsigned idx = 1; idx < state->functionlist[fidx].line_low; idx++)
+                fgets(text, sizeof text, fp); /* skip first lines */
+              numlines = 0;
+              for (unsigned idx = state->functionlist[fidx].line_low; idx < state->functionlist[fidx].line_high; idx++) {
+                if (fgets(text, sizeof text, fp) == NULL)
+                  break;  /* should not happen: source file is shorter than DWARF info indicates */
+                char *ptr = strchr(text, '\n');
+                if (ptr != NULL)
+                  *ptr = '\0';
+                state->sourcelines[numlines].text = strdup(text);
+                state->sourcelines[numlines].linenr = idx;
+                numlines += 1;
+              }
+              state->numlines = numlines;
+            }
+            fclose(fp);
+          } else {
+            /* add string "No source code for ***" */
+            state->source_fileindex = -1;
+            unsigned numlines = 2;
+            state->sourcelines = (LINEINFO*)malloc(numlines * sizeof(LINEINFO));
+            if (state->sourcelines != NULL) {
+              memset(state->sourcelines, 0, numlines * sizeof(LINEINFO));
+              char text[200];
+              sprintf(text, "No source code for \"%s\"", function_name(&state->functionlist[fidx]));
+              state->sourcelines[0].text = strdup(text);
+              state->sourcelines[1].text = strdup("Click here to return to the function list");
+              state->numlines = numlines;
+            }
+          }
+        }
+      } else {
+        if (state->view == VIEW_FUNCTION)
+          nk_tooltip(ctx, "Click to return to the function list");
+        else
+          nk_tooltip(ctx, "Click for a detailed view");
+      }
+    }
+  }
+}
+
+/* profile_stream() appends the function counts since the previous call to the
+   stream file, in the "folded stacks" format of flame-graph tools: one line
+   per function, with the source file and the function name as the frames,
+   followed by the count. Each call appends a block of deltas; the tools add
+   up the counts of identical stacks. */
+static void profile_stream(APPSTATE *state)
+{
+  if (state->fpStream == NULL || state->function_counts == NULL)
+    return;
+  unsigned numfunctions = state->numfunctions;
+  if (state->stream_counts == NULL) {
+    state->stream_counts = (unsigned*)malloc((numfunctions + 1) * sizeof(unsigned));
+    if (state->stream_counts == NULL)
+      return;
+    memset(state->stream_counts, 0, (numfunctions + 1) * sizeof(unsigned));
+  }
+  bool written = false;
+  for (unsigned idx = 0; idx <= numfunctions; idx++) {
+    unsigned count = state->function_counts[idx];
+    unsigned delta = count - state->stream_counts[idx];
+    state->stream_counts[idx] = count;
+    if (delta == 0)
+      continue;
+    if (idx == numfunctions) {
+      fprintf(state->fpStream, "[unknown] %u\n", delta);
+    } else {
+      FUNCTIONINFO *func = &state->functionlist[idx];
+      const char *path = (func->line_low > 0) ? dwarf_path_from_fileindex(&dwarf_filetable, func->fileindex) : NULL;
+      if (path != NULL) {
+        const char *ptr = strrchr(path, DIRSEP_CHAR);
+        fprintf(state->fpStream, "%s;%s %u\n", (ptr != NULL) ? ptr + 1 : path, function_name(func), delta);
+      } else {
+        fprintf(state->fpStream, "%s %u\n", function_name(func), delta);
+      }
+    }
+    written = true;
+  }
+  if (written)
+    fflush(state->fpStream);
+}
+
+/* coverage_update() marks the addresses that have samples in the coverage
+   database */
+static void coverage_update(APPSTATE *state)
+{
+  if (state->coverage == NULL || state->sample_map == NULL)
+    return;
+  uint32_t addr = state->code_base;
+  unsigned samples;
+  for ( ; samplemap_next(state->sample_map, &addr, &samples); addr += ADDRESS_ALIGN)
+    coverage_mark(state->coverage, addr);
+}
+
+/* coverage_store() adds the coverage of the session to the database file,
+   and drops the in-memory database */
+static void coverage_store(APPSTATE *state)
+{
+  if (state->coverage == NULL)
+    return;
+  coverage_update(state);
+  if (coverage_count(state->coverage) > 0) {
+    int err = coverage_accumulate(state->coverage, state->CoverageFile);
+    if (err == COVERR_MISMATCH)
+      tracelog_statusmsg(TRACESTATMSG_BMP, "Coverage database is for a different build of the ELF file.", BMPSTAT_NOTICE);
+    else if (err != COVERR_NONE)
+      tracelog_statusmsg(TRACESTATMSG_BMP, "Failed to update the coverage database.", BMPSTAT_NOTICE);
+  }
+  coverage_delete(state->coverage);
+  state->coverage = NULL;
+}
+
+static void clear_samples(APPSTATE *state)
+{
+  profile_stream(state);  /* export the samples that are about to be cleared */
+  coverage_update(state);
+  if (state->stream_counts != NULL)
+    memset(state->stream_counts, 0, (state->numfunctions + 1) * sizeof(unsigned));
+  if (state->sample_map != NULL)
+    samplemap_clear(state->sample_map); /* also clears the function counts */
+}
+
+/* profile_setslices() (re-)starts the ring of time slices */
+static void profile_setslices(APPSTATE *state)
+{
+  state->slice_view = 0;
+  if (state->sample_map != NULL)
+    samplemap_setslices(state->sample_map, state->timeslice / 1000.0, SLICE_COUNT);
+}
+
+/* profile_settasks() (re-)starts the per-task histograms */
+static void profile_settasks(APPSTATE *state)
+{
+  state->task_view = 0;
+  if (state->sample_map != NULL)
+    samplemap_settasks(state->sample_map, state->task_channel, TASK_COUNT);
+}
+
+/* profile_taskport() enables the ITM stimulus port on which the task switches
+   are reported (or disables the stimulus ports if no channel is set) */
+static void profile_taskport(APPSTATE *state)
+{
+  const DWARF_SYMBOLLIST *symbol = dwarf_sym_from_name(&dwarf_symboltable, "TRACESWO_TER", -1, -1);
+  unsigned long params[2];
+  params[0] = (state->task_channel >= 0) ? 1ul << state->task_channel : 0;
+  params[1] = (symbol != NULL) ? (unsigned long)symbol->data_addr : ~0;
+  bmp_runscript("swo_channels", state->mcu_family, state->mcu_architecture, params, 2);
+}
+
+/* The sampling interval is set with CYCTAP (a tap at 64 or 1024 cycles of
+   CYCCNT) and POSTPRESET (which divides the tap by 1..16). The adaptive rate
+   control steps through "levels", from the shortest interval to the longest
+   (levels 0..15 use the 64-cycle tap, the others the 1024-cycle tap). */
+#define RATE_LEVELS     31
+#define RATE_STEP_TIME  1.0   /* time in seconds between adjustments */
+#define RATE_SPEEDUP    3     /* steps without overflow before raising the rate */
+#define RATE_RETRY      60    /* steps before retrying a rate that overflowed */
+#define PCSAMPLE_BYTES  5     /* size of a PC sample packet */
+
+static unsigned long rate_interval(int level)
+{
+  assert(level >= 0 && level < RATE_LEVELS);
+  return (level < 16) ? 64ul * (level + 1) : 1024ul * (level - 14);
+}
+
+/* rate_level() returns the level for the fastest rate that does not exceed
+   the requested frequency */
+static int rate_level(unsigned long mcuclock, unsigned long freq)
+{
+  int level;
+  for (level = 0; level < RATE_LEVELS - 1; level++)
+    if (mcuclock / rate_interval(level) <= freq)
+      break;
+  return level;
+}
+
+/* link_capacity() returns the number of bytes per second that the SWO link
+   carries (asynchronous mode adds a start and a stop bit to every byte) */
+static unsigned long link_capacity(const APPSTATE *state)
+{
+  return state->bitrate / ((state->swomode == MODE_ASYNC) ? 10 : 8);
+}
+
+/* profile_setrate() changes the sampling interval; a running target is halted
+   for the change, because the probe cannot access memory while the target
+   runs */
+static void profile_setrate(APPSTATE *state, int level, bool running)
+{
+  assert(level >= 0 && level < RATE_LEVELS);
+  if (running) {
+    char buffer[256];
+    bmp_break();
+    gdbrsp_recv(buffer, sizearray(buffer), 500);  /* wait for the stop reply */
+  }
+  unsigned long postpreset = (level < 16) ? level : level - 15;
+  unsigned long cyctap = (level < 16) ? 0 : 1;
+  unsigned long params[1];
+  params[0] = 0x1001 | (cyctap << 9) | (postpreset << 1);  /* PCSAMPLENA | CYCCNTENA */
+  bmp_runscript("swo_profile_rate", state->mcu_family, state->mcu_architecture, params, 1);
+  if (running)
+    gdbrsp_xmit("c", -1);
+  state->rate_level = level;
+}
+
+/* profile_adaptrate() adjusts the sampling rate to the SWO link: on overflow,
+   a filling queue, or a data rate close to the capacity of the link, the rate
+   is reduced by (at least) a third; after a few stable steps, it is raised by
+   one level, unless that level overflowed before (levels that overflowed are
+   retried after a longer period) */
+static void profile_adaptrate(APPSTATE *state)
+{
+  if (!state->adaptive || !state->init_target || state->curstate != STATE_RUNNING)
+    return;
+  double tstamp = get_timestamp();
+  if (tstamp - state->rate_tstamp < RATE_STEP_TIME)
+    return;
+  state->rate_tstamp = tstamp;
+
+  /* the overflow count is reset when the samples are cleared */
+  unsigned overflows = (state->overflow >= state->rate_overflow) ? state->overflow - state->rate_overflow : state->overflow;
+  state->rate_overflow = state->overflow;
+  overflows += trace_overflowerrors(true);
+  TRACESTATS stats;
+  trace_getstats(&stats, true);
+  double capacity = (double)link_capacity(state);
+
+  int level = state->rate_level;
+  if (overflows > 0
+      || (stats.queue_size > 0 && stats.queue_highwater > stats.queue_size / 2)
+      || (capacity > 0.0 && stats.bytes_per_sec > 0.9 * capacity))
+  {
+    state->rate_ceiling = level;
+    unsigned long interval = rate_interval(level) * 3 / 2;
+    while (level < RATE_LEVELS - 1 && rate_interval(level) < interval)
+      level++;
+    state->rate_stable = 0;
+  } else {
+    state->rate_stable += 1;
+    if (state->rate_stable >= RATE_RETRY)
+      state->rate_ceiling = -1;
+    if (state->rate_stable >= RATE_SPEEDUP && level > 0 && level - 1 > state->rate_ceiling
+        && (stats.queue_size == 0 || stats.queue_highwater < stats.queue_size / 4))
+    {
+      /* check that the data rate at the faster level still fits in the link */
+      double predicted = stats.bytes_per_sec * rate_interval(level) / rate_interval(level - 1);
+      if (capacity <= 0.0 || predicted < 0.8 * capacity) {
+        level -= 1;
+        state->rate_stable = 0;
+      }
+    }
+  }
+  if (level != state->rate_level)
+    profile_setrate(state, level, true);
+}
+
+/* task_name() formats the name of a task: the name of the variable at the
+   address (for an RTOS that uses the address of the task control block as
+   the ID), or the ID in hexadecimal */
+static const char *task_name(uint32_t id, char *buffer, size_t size)
+{
+  const DWARF_SYMBOLLIST *sym = dwarf_sym_from_address(&dwarf_symboltable, id, 1);
+  if (sym != NULL && sym->data_addr == id && sym->name != NULL)
+    strlcpy(buffer, dwarf_sym_name(sym), size);
+  else
+    snprintf(buffer, size, "0x%x", (unsigned)id);
+  return buffer;
+}
+
+static void profile_reset(APPSTATE *state, bool samples)
+{
+  if (samples) {
+    clear_samples(state);
+    profile_setslices(state);
+    profile_settasks(state);
+  }
+
+  if (state->view == VIEW_TOP && state->functionlist != NULL) {
+    FUNCTIONINFO *functionlist = state->functionlist;
+    unsigned numfunctions = state->numfunctions;
+    for (unsigned idx = 0; idx < numfunctions; idx++) {
+      functionlist[idx].count = 0;
+      functionlist[idx].ratio = 0.0;
+    }
+  }
+
+  if (state->view == VIEW_FUNCTION && state->sourcelines != NULL) {
+    LINEINFO *sourcelines = state->sourcelines;
+    unsigned numlines = state->numlines;
+    for (unsigned idx = 0; idx < numlines; idx++) {
+      sourcelines[idx].count = 0;
+      sourcelines[idx].ratio = 0.0;
+    }
+  }
+}
+
+/* For saving the profile in the background, the sample counts are copied
+   into a snapshot, together with the names of the functions that have
+   samples (the function list may be rebuilt while the export runs). The
+   look-up of the source file and line is done on the worker thread; the DWARF
+   tables must therefore stay valid until the export completes (see
+   export_wait()). */
+typedef struct tagPROFILEROW {
+  uint32_t addr;
+  unsigned samples;
+  size_t name;              /* offset in the name pool, or NO_FUNCTION */
+} PROFILEROW;
+
+typedef struct tagPROFILESNAPSHOT {
+  PROFILEROW *rows;
+  char *names;
+  int fileindex;            /* file index of the most recent row (cache of the path) */
+  const char *path;
+} PROFILESNAPSHOT;
+
+#define NO_FUNCTION   (~(size_t)0)
+
+static const EXPORTCOLUMN profile_columns[] = {
+  { "Address",  EXPCOL_HEX,    0 },
+  { "Samples",  EXPCOL_UINT,   0 },
+  { "Function", EXPCOL_STRING, 0 },
+  { "Source",   EXPCOL_STRING, 0 },
+  { "Line",     EXPCOL_INT,    0 },
+};
+
+static bool profile_exportrow(void *context, unsigned long row, EXPORTVALUE *values)
+{
+  PROFILESNAPSHOT *snapshot = (PROFILESNAPSHOT*)context;
+  const PROFILEROW *entry = &snapshot->rows[row];
+  const char *name = "";
+  const char *path = "";
+  int linenr = 0;
+  if (entry->name != NO_FUNCTION) {
+    name = snapshot->names + entry->name;
+    /* get line number & file path */
+    const DWARF_LINELOOKUP *lineinfo = dwarf_line_from_address(&dwarf_linetable, entry->addr);
+    if (lineinfo != NULL) {
+      linenr = lineinfo->line;
+      if (lineinfo->fileindex != snapshot->fileindex) {
+        snapshot->fileindex = lineinfo->fileindex;
+        snapshot->path = dwarf_path_from_fileindex(&dwarf_filetable, lineinfo->fileindex);
+      }
+      if (snapshot->path != NULL)
+        path = snapshot->path;
+    }
+  }
+
+  values[0].value.u = entry->addr;
+  values[1].value.u = entry->samples;
+  values[2].text = name;
+  values[2].length = strlen(name);
+  values[3].text = path;
+  values[3].length = strlen(path);
+  values[4].value.i = linenr;
+  return true;
+}
+
+static void profile_exportdone(void *context)
+{
+  PROFILESNAPSHOT *snapshot = (PROFILESNAPSHOT*)context;
+  free(snapshot->rows);
+  free(snapshot->names);
+  free(snapshot);
+}
+
+/* profile_save() makes a snapshot of the samples and starts saving it in the
+   background; it returns false if the export cannot be started (the result of
+   the export itself is checked with export_poll()) */
+static bool profile_save(const char *filename, int format, APPSTATE *state)
+{
+  unsigned count = 0;
+  size_t namesize = 0;
+  uint32_t addr;
+  unsigned samples;
+
+  /* count the rows and the size of the name pool (functions are sorted on
+     address, and so are the samples, so rows for the same function are
+     adjacent) */
+  FUNCTIONINFO *functionlist = state->functionlist;
+  unsigned numfunctions = (functionlist != NULL) ? state->numfunctions : 0;
+  unsigned func_idx = 0;
+  if (state->sample_map != NULL) {
+    addr = state->code_base;
+    unsigned prev_idx = UINT_MAX;
+    for ( ; samplemap_next(state->sample_map, &addr, &samples); addr += ADDRESS_ALIGN) {
+      count++;
+      while (func_idx < numfunctions && functionlist[func_idx].addr_high <= addr)
+        func_idx++;
+      if (func_idx < numfunctions && functionlist[func_idx].addr_low <= addr && func_idx != prev_idx) {
+        namesize += strlen(function_name(&functionlist[func_idx])) + 1;
+        prev_idx = func_idx;
+      }
+    }
+  }
+
+  PROFILESNAPSHOT *snapshot = malloc(sizeof(PROFILESNAPSHOT));
+  if (snapshot == NULL)
+    return false;
+  snapshot->rows = malloc((count > 0 ? count : 1) * sizeof(PROFILEROW));
+  snapshot->names = malloc((namesize > 0 ? namesize : 1) * sizeof(char));
+  snapshot->fileindex = -1;
+  snapshot->path = NULL;
+  if (snapshot->rows == NULL || snapshot->names == NULL) {
+    profile_exportdone(snapshot);
+    return false;
+  }
+  count = 0;
+  namesize = 0;
+  func_idx = 0;
+  if (state->sample_map != NULL) {
+    addr = state->code_base;
+    unsigned prev_idx = UINT_MAX;
+    size_t name = NO_FUNCTION;
+    for ( ; samplemap_next(state->sample_map, &addr, &samples); addr += ADDRESS_ALIGN) {
+      while (func_idx < numfunctions && functionlist[func_idx].addr_high <= addr)
+        func_idx++;
+      if (func_idx < numfunctions && functionlist[func_idx].addr_low <= addr) {
+        if (func_idx != prev_idx) {
+          const char *fname = function_name(&functionlist[func_idx]);
+          size_t len = strlen(fname) + 1;
+          memcpy(snapshot->names + namesize, fname, len);
+          name = namesize;
+          namesize += len;
+          prev_idx = func_idx;
+        }
+      } else {
+        name = NO_FUNCTION;
+        prev_idx = UINT_MAX;
+      }
+      PROFILEROW *row = &snapshot->rows[count++];
+      row->addr = addr;
+      row->samples = samples;
+      row->name = name;
+    }
+  }
+
+  if (!export_start(filename, format, profile_columns, sizearray(profile_columns), count,
+                    profile_exportrow, profile_exportdone, snapshot))
+  {
+    profile_exportdone(snapshot);
+    return false;
+  }
+  return true;
+}
+
+/* handle_export() checks the progress of saving the profile in the
+   background, and posts a message when it completes */
+static void handle_export(APPSTATE *state)
+{
+  unsigned percent;
+  unsigned long rows;
+  int result = export_poll(&percent, &rows);
+  if (result == EXPORT_BUSY) {
+    state->export_percent = (int)percent;
+  } else if (result != EXPORT_IDLE) {
+    if (result == EXPORT_DONE) {
+      char msg[100];
+      sprintf(msg, "Saved %lu addresses", rows);
+      tracelog_statusmsg(TRACESTATMSG_BMP, msg, BMPSTAT_SUCCESS);
+    } else {
+      tracelog_statusmsg(TRACESTATMSG_BMP, "Saving the profile failed or was cancelled", BMPERR_GENERAL);
+    }
+    state->export_percent = -1;
+  }
+}
+
+/* lookup_line() returns the file index and line number for an address; it
+   uses the address-to-line map (if available), and falls back to a look-up
+   in the DWARF table (for addresses outside the code range) */
+static bool lookup_line(const APPSTATE *state, uint32_t addr, int *fileindex, int *line)
+{
+  assert(fileindex != NULL && line != NULL);
+  if (state->line_map != NULL && addr >= state->code_base && addr < state->code_top) {
+    const ADDRLINE *entry = &state->line_map[Address2Index(addr, state->code_base)];
+    if (entry->line == 0)
+      return false;
+    *fileindex = entry->fileindex;
+    *line = entry->line;
+    return true;
+  }
+  const DWARF_LINELOOKUP *lineinfo = dwarf_line_from_address(&dwarf_linetable, addr);
+  if (lineinfo == NULL)
+    return false;
+  *fileindex = lineinfo->fileindex;
+  *line = lineinfo->line;
+  return true;
+}
+
+/* collect_linemap() builds the address-to-line map for the full code range,
+   in a single pass over the DWARF line table (which is sorted on address) */
+static bool collect_linemap(APPSTATE *state)
+{
+  assert(state != NULL);
+  assert(state->line_map == NULL);
+  if (state->code_top <= state->code_base || state->code_top - state->code_base > LINEMAP_MAXRANGE)
+    return false;
+  unsigned size = Address2Index(state->code_top, state->code_base);
+  state->line_map = (ADDRLINE*)calloc(size, sizeof(ADDRLINE));
+  if (state->line_map == NULL)
+    return false;
+  for (const DWARF_LINELOOKUP *lineinfo = dwarf_linetable.next; lineinfo != NULL; lineinfo = lineinfo->next) {
+    /* a line table entry covers the addresses up to the next entry */
+    uint32_t low = lineinfo->address;
+    uint32_t high = (lineinfo->next != NULL) ? lineinfo->next->address : state->code_top;
+    if (low < state->code_base)
+      low = state->code_base;
+    if (high > state->code_top)
+      high = state->code_top;
+    for (uint32_t addr = low; addr < high; addr += ADDRESS_ALIGN) {
+      ADDRLINE *entry = &state->line_map[Address2Index(addr, state->code_base)];
+      entry->line = lineinfo->line;
+      entry->fileindex = (short)lineinfo->fileindex;
+    }
+  }
+  return true;
+}
+
+/* linesample_compare_line() sorts on file index and line number; used for
+   merging the samples of all addresses of a source line */
+static int linesample_compare_line(const void *key1, const void *key2)
+{
+  const LINESAMPLE *p1 = (const LINESAMPLE*)key1;
+  const LINESAMPLE *p2 = (const LINESAMPLE*)key2;
+  if (p1->fileindex != p2->fileindex)
+    return (p1->fileindex < p2->fileindex) ? -1 : 1;
+  if (p1->line != p2->line)
+    return (p1->line < p2->line) ? -1 : 1;
+  return 0;
+}
+
+/* linesample_compare_count() sorts on sample count, highest first */
+static int linesample_compare_count(const void *key1, const void *key2)
+{
+  const LINESAMPLE *p1 = (const LINESAMPLE*)key1;
+  const LINESAMPLE *p2 = (const LINESAMPLE*)key2;
+  if (p1->count != p2->count)
+    return (p1->count > p2->count) ? -1 : 1;
+  return linesample_compare_line(key1, key2);
+}
+
+/* profile_collect_lines() returns an array with the sample counts per source
+   line, sorted on the sample count (highest first); the array must be freed
+   by the caller */
+static LINESAMPLE *profile_collect_lines(APPSTATE *state, unsigned *count)
+{
+  assert(count != NULL);
+  *count = 0;
+  if (state->sample_map == NULL)
+    return NULL;
+  unsigned size = 64;
+  LINESAMPLE *list = (LINESAMPLE*)malloc(size * sizeof(LINESAMPLE));
+  if (list == NULL)
+    return NULL;
+  unsigned numitems = 0;
+  uint32_t addr = state->code_base;
+  unsigned samples;
+  for ( ; samplemap_next(state->sample_map, &addr, &samples); addr += ADDRESS_ALIGN) {
+    int fileindex, line;
+    if (!lookup_line(state, addr, &fileindex, &line))
+      continue;
+    if (numitems >= size) {
+      LINESAMPLE *newlist = (LINESAMPLE*)realloc(list, 2 * size * sizeof(LINESAMPLE));
+      if (newlist == NULL)
+        break;
+      list = newlist;
+      size *= 2;
+    }
+    list[numitems].fileindex = fileindex;
+    list[numitems].line = line;
+    list[numitems].count = samples;
+    numitems++;
+  }
+  /* merge the entries for the same line, then sort on count */
+  if (numitems > 0) {
+    qsort(list, numitems, sizeof(LINESAMPLE), linesample_compare_line);
+    unsigned tail = 0;
+    for (unsigned idx = 1; idx < numitems; idx++) {
+      if (linesample_compare_line(&list[tail], &list[idx]) == 0)
+        list[tail].count += list[idx].count;
+      else
+        list[++tail] = list[idx];
+    }
+    numitems = tail + 1;
+    qsort(list, numitems, sizeof(LINESAMPLE), linesample_compare_count);
+  }
+  *count = numitems;
+  return list;
+}
+
+/* report_string() writes a quoted string, escaping quotes in JSON mode */
+static void report_string(FILE *fp, const char *text, bool json)
+{
+  fputc('"', fp);
+  for ( ; *text != '\0'; text++) {
+    if (json && (*text == '"' || *text == '\\'))
+      fputc('\\', fp);
+    else if (!json && *text == '"')
+      fputc('"', fp);   /* CSV: double the quote */
+    fputc(*text, fp);
+  }
+  fputc('"', fp);
+}
+
+static void profile_graph_top(APPSTATE *state);
+
+/* report_functions() writes the top functions (of all tasks, or of the task
+   on view), with their sample counts and percentages */
+static void report_functions(FILE *fp, APPSTATE *state, unsigned topcount, bool json,
+                             const char *type, const char *indent)
+{
+  unsigned total = state->total_samples;
+  unsigned numfunctions = (state->functionlist != NULL) ? state->numfunctions : 0;
+  for (unsigned idx = 0; idx < numfunctions && idx < topcount; idx++) {
+    FUNCTIONINFO *func = &state->functionlist[state->functionorder[idx]];
+    if (func->count == 0)
+      break;
+    const char *path = (func->line_low > 0) ? dwarf_path_from_fileindex(&dwarf_filetable, func->fileindex) : NULL;
+    double percentage = (total > 0) ? 100.0 * func->count / total : 0.0;
+    if (json) {
+      fprintf(fp, "%s\n%s{ \"name\": ", (idx > 0) ? "," : "", indent);
+      report_string(fp, function_name(func), json);
+      fprintf(fp, ", \"source\": ");
+      report_string(fp, (path != NULL) ? path : "", json);
+      fprintf(fp, ", \"line\": %d, \"samples\": %u, \"percentage\": %.2f }", func->line_low, func->count, percentage);
+    } else {
+      fprintf(fp, "%s,", type);
+      report_string(fp, function_name(func), json);
+      fprintf(fp, ",");
+      report_string(fp, (path != NULL) ? path : "", json);
+      fprintf(fp, ",%d,%u,%.2f\n", func->line_low, func->count, percentage);
+    }
+  }
+}
+
+/* profile_report() writes the top functions and the top source lines, with
+   their sample counts and percentages, in CSV or JSON format; the function
+   counts must be up to date (see profile_graph_top()); if the samples are
+   kept per task, the top functions of each task follow */
+static void profile_report(FILE *fp, APPSTATE *state, double duration, unsigned topcount, bool json)
+{
+  unsigned total = state->total_samples;
+  if (json)
+    fprintf(fp, "{\n  \"duration\": %.3f,\n  \"samples\": %u,\n  \"unknown\": %u,\n  \"overflow\": %u,\n  \"functions\": [",
+            duration, total, state->sample_unknown, state->overflow);
+  else
+    fprintf(fp, "Type,Name,Source,Line,Samples,Percentage\n");
+
+  report_functions(fp, state, topcount, json, "function", "    ");
+  if (json)
+    fprintf(fp, "\n  ],\n  \"lines\": [");
+
+  unsigned numlines;
+  LINESAMPLE *lines = profile_collect_lines(state, &numlines);
+  for (unsigned idx = 0; idx < numlines && idx < topcount; idx++) {
+    const char *path = dwarf_path_from_fileindex(&dwarf_filetable, lines[idx].fileindex);
+    double percentage = (total > 0) ? 100.0 * lines[idx].count / total : 0.0;
+    if (json) {
+      fprintf(fp, "%s\n    { \"source\": ", (idx > 0) ? "," : "");
+      report_string(fp, (path != NULL) ? path : "", json);
+      fprintf(fp, ", \"line\": %d, \"samples\": %u, \"percentage\": %.2f }", lines[idx].line, lines[idx].count, percentage);
+    } else {
+      fprintf(fp, "line,\"\",");
+      report_string(fp, (path != NULL) ? path : "", json);
+      fprintf(fp, ",%d,%u,%.2f\n", lines[idx].line, lines[idx].count, percentage);
+    }
+  }
+  if (lines != NULL)
+    free((void*)lines);
+
+  if (state->task_channel >= 0) {
+    if (json)
+      fprintf(fp, "\n  ],\n  \"tasks\": [");
+    unsigned numtasks = (state->sample_map != NULL && state->function_counts != NULL) ? samplemap_tasks(state->sample_map) : 0;
+    int task_view = state->task_view;
+    for (unsigned idx = 0; idx < numtasks; idx++) {
+      uint32_t id;
+      unsigned samples;
+      char name[64];
+      samplemap_taskinfo(state->sample_map, idx, &id, &samples);
+      task_name(id, name, sizearray(name));
+      double percentage = (total > 0) ? 100.0 * samples / total : 0.0;
+      if (json) {
+        fprintf(fp, "%s\n    { \"name\": ", (idx > 0) ? "," : "");
+        report_string(fp, name, json);
+        fprintf(fp, ", \"id\": %lu, \"samples\": %u, \"percentage\": %.2f, \"functions\": [",
+                (unsigned long)id, samples, percentage);
+      } else {
+        fprintf(fp, "task,");
+        report_string(fp, name, json);
+        fprintf(fp, ",\"\",0,%u,%.2f\n", samples, percentage);
+      }
+      /* the percentages of the functions are relative to the task */
+      state->task_view = idx + 1;
+      profile_graph_top(state);
+      report_functions(fp, state, topcount, json, "task-function", "        ");
+      if (json)
+        fprintf(fp, "\n      ] }");
+    }
+    if (numtasks > 0) {
+      state->task_view = task_view;
+      profile_graph_top(state);
+    }
+  }
+  if (json)
+    fprintf(fp, "\n  ]\n}\n");
+}
+
+/* coverage_report() writes the line coverage per source file, with the lines
+   that were never hit, in CSV or JSON format; a line is covered if any of its
+   addresses is marked in the database */
+static void coverage_report(FILE *fp, const APPSTATE *state, const COVERAGE *cov, bool json)
+{
+  /* collect the lines in the code range, from the DWARF line table */
+  unsigned size = 256;
+  LINESAMPLE *list = (LINESAMPLE*)malloc(size * sizeof(LINESAMPLE));
+  unsigned numitems = 0;
+  for (const DWARF_LINELOOKUP *lineinfo = dwarf_linetable.next; lineinfo != NULL && list != NULL; lineinfo = lineinfo->next) {
+    uint32_t low = lineinfo->address;
+    uint32_t high = (lineinfo->next != NULL) ? lineinfo->next->address : state->code_top;
+    if (lineinfo->line <= 0 || high <= low || low < state->code_base || low >= state->code_top)
+      continue;
+    if (numitems >= size) {
+      LINESAMPLE *newlist = (LINESAMPLE*)realloc(list, 2 * size * sizeof(LINESAMPLE));
+      if (newlist == NULL)
+        break;
+      list = newlist;
+      size *= 2;
+    }
+    list[numitems].fileindex = lineinfo->fileindex;
+    list[numitems].line = lineinfo->line;
+    list[numitems].count = coverage_test(cov, low, high) ? 1 : 0;
+    numitems++;
+  }
+  /* merge the entries for the same line (covered if any entry is covered) */
+  if (numitems > 0) {
+    qsort(list, numitems, sizeof(LINESAMPLE), linesample_compare_line);
+    unsigned tail = 0;
+    for (unsigned idx = 1; idx < numitems; idx++) {
+      if (linesample_compare_line(&list[tail], &list[idx]) == 0)
+        list[tail].count |= list[idx].count;
+      else
+        list[++tail] = list[idx];
+    }
+    numitems = tail + 1;
+  }
+
+  unsigned total = 0, covered = 0;
+  for (unsigned idx = 0; idx < numitems; idx++) {
+    total++;
+    if (list[idx].count > 0)
+      covered++;
+  }
+  if (json)
+    fprintf(fp, "{\n  \"build\": \"%08lx\",\n  \"sessions\": %u,\n  \"lines\": %u,\n  \"covered\": %u,\n  \"percentage\": %.2f,\n  \"files\": [",
+            (unsigned long)coverage_elf_id(cov), coverage_sessions(cov), total, covered,
+            (total > 0) ? 100.0 * covered / total : 0.0);
+  else
+    fprintf(fp, "Type,Source,Line,Lines,Covered,Percentage\ntotal,\"\",0,%u,%u,%.2f\n",
+            total, covered, (total > 0) ? 100.0 * covered / total : 0.0);
+
+  /* per file a summary, followed by the lines that were not covered */
+  unsigned filecount = 0;
+  for (unsigned first = 0; first < numitems; ) {
+    unsigned last = first;
+    unsigned lines = 0;
+    covered = 0;
+    while (last < numitems && list[last].fileindex == list[first].fileindex) {
+      lines++;
+      if (list[last].count > 0)
+        covered++;
+      last++;
+    }
+    const char *path = dwarf_path_from_fileindex(&dwarf_filetable, list[first].fileindex);
+    if (path == NULL)
+      path = "";
+    double percentage = 100.0 * covered / lines;
+    if (json) {
+      fprintf(fp, "%s\n    { \"source\": ", (filecount > 0) ? "," : "");
+      report_string(fp, path, json);
+      fprintf(fp, ", \"lines\": %u, \"covered\": %u, \"percentage\": %.2f, \"uncovered\": [", lines, covered, percentage);
+      bool sep = false;
+      for (unsigned idx = first; idx < last; idx++) {
+        if (list[idx].count == 0) {
+          fprintf(fp, "%s%d", sep ? ", " : "", list[idx].line);
+          sep = true;
+        }
+      }
+      fprintf(fp, "] }");
+    } else {
+      fprintf(fp, "file,");
+      report_string(fp, path, json);
+      fprintf(fp, ",0,%u,%u,%.2f\n", lines, covered, percentage);
+      for (unsigned idx = first; idx < last; idx++) {
+        if (list[idx].count == 0) {
+          fprintf(fp, "uncovered,");
+          report_string(fp, path, json);
+          fprintf(fp, ",%d,1,0,0.00\n", list[idx].line);
+        }
+      }
+    }
+    filecount++;
+    first = last;
+  }
+  if (json)
+    fprintf(fp, "\n  ]\n}\n");
+  if (list != NULL)
+    free((void*)list);
+}
+
+/* profile_scan_functions() accumulates the function counts from the sample
+   map; this is the fall-back for when no function map could be allocated (so
+   that samples are not attributed to functions while decoding) */
+static unsigned profile_scan_functions(APPSTATE *state)
+{
+  FUNCTIONINFO *functionlist = state->functionlist;
+  unsigned numfunctions = state->numfunctions;
+  for (unsigned idx = 0; idx < numfunctions; idx++)
+    functionlist[idx].count = 0;
+  state->sample_unknown = 0;
+
+  unsigned total_samples = 0;
+  unsigned func_idx = 0;
+  uint32_t addr = state->code_base;
+  unsigned samples;
+  for ( ; samplemap_next(state->sample_map, &addr, &samples); addr += ADDRESS_ALIGN) {
+    if (addr < functionlist[func_idx].addr_low || addr >= functionlist[func_idx].addr_high) {
+      /* use binary search to find the function */
+      unsigned low = 0;
+      unsigned high = numfunctions - 1;
+      while (low <= high) {
+        func_idx = low + (high - low) / 2;
+        if (functionlist[func_idx].addr_low <= addr && addr < functionlist[func_idx].addr_high)
+          break;
+        assert(functionlist[func_idx].addr_low < addr || functionlist[func_idx].addr_high >= addr);
+        if (functionlist[func_idx].addr_low < addr)
+          low = func_idx + 1;
+        else
+          high = func_idx - 1;
+      }
+    }
+    if (functionlist[func_idx].addr_low <= addr && addr < functionlist[func_idx].addr_high)
+      functionlist[func_idx].count += samples;
+    else
+      state->sample_unknown += samples;
+    total_samples += samples;
+  }
+
+  /* all samples beyond the ELF file address range are collected separately */
+  state->sample_unknown += samplemap_unknown(state->sample_map);
+  total_samples += samplemap_unknown(state->sample_map);
+  return total_samples;
+}
+
+static void profile_graph_top(APPSTATE *state)
+{
+  if (state->sample_map != NULL && state->functionlist != NULL && state->numfunctions > 0) {
+    FUNCTIONINFO *functionlist = state->functionlist;
+    unsigned numfunctions = state->numfunctions;
+    unsigned total_samples = 0;
+    const unsigned *counts = state->function_counts;
+    if (counts != NULL && state->slice_view > 0) {
+      /* show the histogram of a single time slice */
+      if (state->slice_counts == NULL)
+        state->slice_counts = (unsigned*)malloc((numfunctions + 1) * sizeof(unsigned));
+      if (state->slice_counts != NULL && samplemap_slicecounts(state->sample_map, state->slice_view - 1, state->slice_counts))
+        counts = state->slice_counts;
+      else
+        state->slice_view = 0;
+    } else if (counts != NULL && state->task_view > 0) {
+      /* show the histogram of a single task */
+      if (state->task_counts == NULL)
+        state->task_counts = (unsigned*)malloc((numfunctions + 1) * sizeof(unsigned));
+      if (state->task_counts != NULL && samplemap_taskcounts(state->sample_map, state->task_view - 1, state->task_counts))
+        counts = state->task_counts;
+      else
+        state->task_view = 0;
+    }
+    if (counts != NULL) {
+      /* samples were already attributed to functions while decoding */
+      for (unsigned idx = 0; idx < numfunctions; idx++) {
+        functionlist[idx].count = counts[idx];
+        total_samples += functionlist[idx].count;
+      }
+      state->sample_unknown = counts[numfunctions];
+      total_samples += state->sample_unknown;
+    } else {
+      total_samples = profile_scan_functions(state);
+    }
+    state->total_samples = total_samples;
+
+    /* calculate scaling factors (the percentages are formatted when the
+       function is displayed) */
+    for (unsigned idx = 0; idx < numfunctions; idx++)
+      functionlist[idx].percentage[0] = '\0';
+    if (total_samples > 0) {
+      double peak = 0.0;
+      for (unsigned idx = 0; idx < numfunctions; idx++) {
+        functionlist[idx].ratio = (double)functionlist[idx].count / total_samples;
+        if (functionlist[idx].ratio > peak)
+          peak = functionlist[idx].ratio;
+      }
+      /* equalize the scaling somewhat, so that the bar graph emphasizes the
+         differences */
+      if (peak < 0.1)
+        peak = 0.1;
+      double scale = 0.5 / peak + 0.5;
+      for (unsigned idx = 0; idx < numfunctions; idx++)
+        functionlist[idx].ratio *= scale;
+    } else {
+      for (unsigned idx = 0; idx < numfunctions; idx++)
+        functionlist[idx].ratio = 0.0;
+    }
+
+    /* sort the functions using "insertion sort"; this is classified as an
+       inefficient sort, but it is quite efficient if the list is already
+       (nearly) sorted */
+    unsigned *functionorder = state->functionorder;
+    for (unsigned i = 1; i < numfunctions; i++) {
+      unsigned key = functionorder[i];
+      assert(key < numfunctions);
+      unsigned long key_samples = functionlist[key].count;
+      unsigned j;
+      for (j = i; j > 0 && functionlist[functionorder[j - 1]].count < key_samples; j--)
+        functionorder[j] = functionorder[j - 1];
+      functionorder[j] = key;
+    }
+  }
+}
+
+static void profile_graph_source(APPSTATE *state)
+{
+  if (state->sample_map != NULL && state->sourcelines != NULL && state->numlines > 0 && state->source_fileindex >= 0) {
+    /* clear line counts */
+    LINEINFO *sourcelines = state->sourcelines;
+    unsigned numlines = state->numlines;
+    for (unsigned idx = 0; idx < numlines; idx++)
+      sourcelines[idx].count = 0;
+
+    /* accumulate line counts from sample map */
+    unsigned total_samples = 0;
+    int source_fileindex = state->source_fileindex;
+    unsigned line_count = state->numlines;
+    unsigned first_line = sourcelines[0].linenr;
+    uint32_t addr = state->code_base;
+    unsigned samples;
+    for ( ; samplemap_next(state->sample_map, &addr, &samples); addr += ADDRESS_ALIGN) {
+      total_samples += samples;
+      int fileindex, line;
+      if (!lookup_line(state, addr, &fileindex, &line) || fileindex != source_fileindex)
+        continue;
+      unsigned line_idx = line - first_line;
+      if (line_idx < line_count)
+        sourcelines[line_idx].count += samples;
+    }
+    state->total_samples = total_samples;
+    state->sample_unknown = samplemap_unknown(state->sample_map);
+
+    /* calculate scaling factors */
+    if (total_samples > 0) {
+      double peak = 0.0;
+      for (unsigned idx = 0; idx < line_count; idx++) {
+        sourcelines[idx].ratio = (double)sourcelines[idx].count / total_samples;
+        sprintf(sourcelines[idx].percentage, "%5.1f%%  ", 100.0 * sourcelines[idx].ratio);
+        if (sourcelines[idx].ratio > peak)
+          peak = sourcelines[idx].ratio;
+      }
+      /* equalize the scaling somewhat, so that the bar graph emphasizes the
+         differences */
+      if (peak < 0.1)
+        peak = 0.1;
+      double scale = 0.5 / peak + 0.5;
+      for (unsigned idx = 0; idx < line_count; idx++)
+        sourcelines[idx].ratio *= scale;
+    } else {
+      for (unsigned idx = 0; idx < line_count; idx++) {
+        sourcelines[idx].ratio = 0.0;
+        sourcelines[idx].percentage[0] = '\0';
+      }
+    }
+  }
+}
+
+static void clear_functions(APPSTATE *state)
+{
+  assert(state != NULL);
+  profile_stream(state);  /* export pending samples, while the function list is valid */
+  if (state->functionlist != NULL) {
+    for (unsigned idx = 0; idx < state->numfunctions; idx++)
+      free((void*)state->functionlist[idx].name);
+    free((void*)state->functionlist);
+    state->functionlist = NULL;
+  }
+  if (state->functionorder != NULL) {
+    free((void*)state->functionorder);
+    state->functionorder = NULL;
+  }
+  if (state->sample_map != NULL)
+    samplemap_setfunctions(state->sample_map, NULL, 0, NULL);
+  if (state->function_ranges != NULL) {
+    free((void*)state->function_ranges);
+    state->function_ranges = NULL;
+  }
+  if (state->function_counts != NULL) {
+    free((void*)state->function_counts);
+    state->function_counts = NULL;
+  }
+  if (state->stream_counts != NULL) {
+    free((void*)state->stream_counts);
+    state->stream_counts = NULL;
+  }
+  if (state->slice_counts != NULL) {
+    free((void*)state->slice_counts);
+    state->slice_counts = NULL;
+  }
+  if (state->task_counts != NULL) {
+    free((void*)state->task_counts);
+    state->task_counts = NULL;
+  }
+  if (state->line_map != NULL) {
+    free((void*)state->line_map);
+    state->line_map = NULL;
+  }
+  state->slice_view = 0;
+  state->task_view = 0;
+  state->numfunctions = 0;
+}
+
+static bool collect_functions(APPSTATE *state)
+{
+  assert(state != NULL);
+  clear_functions(state);
+
+  /* count & collect the function symbols from the DWARF info */
+  unsigned dwarf_count = dwarf_collect_functions_in_file(&dwarf_symboltable, -1, DWARF_SORT_ADDRESS, NULL, 0);
+  if (dwarf_count == 0)
+    return false;
+  const DWARF_SYMBOLLIST **dwarf_list = (const DWARF_SYMBOLLIST**)malloc(dwarf_count * sizeof(DWARF_SYMBOLLIST*));
+  if (dwarf_list == NULL)
+    return false;
+  dwarf_collect_functions_in_file(&dwarf_symboltable, -1, DWARF_SORT_ADDRESS, dwarf_list, dwarf_count);
+
+  /* load the ELF symbol table (it is sorted on address) */
+  ELF_SYMTAB elf_symtab = { NULL };
+  FILE *fp_elf = fopen(state->ELFfile, "rb");
+  assert(fp_elf != NULL);
+  if (fp_elf != NULL) {
+    elf_symtab_load(fp_elf, &elf_symtab);
+    fclose(fp_elf);
+  }
+
+  /* make a list of the function symbols in the ELF table */
+  unsigned elf_funcs = 0;
+  const ELF_SYMBOL **elf_sorted = NULL;
+  if (elf_symtab.count > 0) {
+    elf_sorted = (const ELF_SYMBOL**)malloc(elf_symtab.count * sizeof(ELF_SYMBOL*));
+    if (elf_sorted != NULL) {
+      for (unsigned elf_idx = 0; elf_idx < elf_symtab.count; elf_idx++)
+        if (elf_symtab.symbols[elf_idx].is_func)
+          elf_sorted[elf_funcs++] = &elf_symtab.symbols[elf_idx];
+    }
+  }
+
+  /* use the DWARF info as the primary table, but walk through the ELF symbols
+     to find any functions that are not present in the DWARF table; as both
+     lists are sorted on address, this takes a single pass */
+  state->numfunctions = dwarf_count;
+  unsigned dwarf_idx = 0;
+  for (unsigned elf_idx = 0; elf_idx < elf_funcs; elf_idx++) {
+    unsigned long addr = elf_sorted[elf_idx]->address & ~1;
+    while (dwarf_idx < dwarf_count && dwarf_list[dwarf_idx]->code_addr < addr)
+      dwarf_idx++;
+    if (dwarf_idx < dwarf_count && dwarf_list[dwarf_idx]->code_addr == addr)
+      elf_sorted[elf_idx] = NULL; /* also in the DWARF table, remove it from the list to merge */
+    else
+      state->numfunctions += 1; /* found a function in the ELF table that is not in the DWARF table */
+  }
+
+  /* allocate memory for the merged tables from DWARF and ELF */
+  state->functionlist = (FUNCTIONINFO*)malloc(state->numfunctions * sizeof(FUNCTIONINFO));
+  state->functionorder = (unsigned*)malloc(state->numfunctions * sizeof(unsigned));
+
+  if (state->functionlist != NULL && state->functionorder != NULL) {
+    memset(state->functionlist, 0, state->numfunctions * sizeof(FUNCTIONINFO));
+    memset(state->functionorder, 0, state->numfunctions * sizeof(unsigned));
+    /* merge the DWARF list and the remaining ELF functions (both sorted on
+       address); for the ELF functions, there is no line number information;
+       all names are demangled when first displayed */
+    unsigned elf_idx = 0;
+    dwarf_idx = 0;
+    for (unsigned pos = 0; pos < state->numfunctions; pos++) {
+      while (elf_idx < elf_funcs && elf_sorted[elf_idx] == NULL)
+        elf_idx++;
+      FUNCTIONINFO *func = &state->functionlist[pos];
+      if (elf_idx < elf_funcs && (dwarf_idx >= dwarf_count || (elf_sorted[elf_idx]->address & ~1) < dwarf_list[dwarf_idx]->code_addr)) {
+        const ELF_SYMBOL *sym = elf_sorted[elf_idx++];
+        func->name = strdup(sym->name);
+        func->mangled = true;
+        func->addr_low = sym->address & ~1;
+        func->addr_high = func->addr_low + sym->size;
+      } else {
+        assert(dwarf_idx < dwarf_count);
+        const DWARF_SYMBOLLIST *sym = dwarf_list[dwarf_idx++];
+        func->name = strdup(sym->name);
+        func->mangled = true;
+        func->addr_low = sym->code_addr;
+        func->addr_high = sym->code_addr + sym->code_range;
+        func->line_low = sym->line;
+        func->line_high = sym->line_limit;
+        func->fileindex = sym->fileindex;
+      }
+    }
+    /* create an initial sort order */
+    for (unsigned idx = 0; idx < state->numfunctions; idx++)
+      state->functionorder[idx] = idx;
+  } else {
+    if (state->functionlist != NULL) {
+      free((void*)state->functionlist);
+      state->functionlist = NULL;
+    }
+    if (state->functionorder != NULL) {
+      free((void*)state->functionorder);
+      state->functionorder = NULL;
+    }
+  }
+  free((void*)dwarf_list);
+  if (elf_sorted != NULL)
+    free((void*)elf_sorted);
+  elf_symtab_free(&elf_symtab);
+
+  return state->functionlist != NULL && state->functionorder != NULL;
+}
+
+/* collect_functionmap() passes the address ranges of the functions to the
+   sample map, so that samples are attributed to functions while they are
+   decoded */
+static bool collect_functionmap(APPSTATE *state)
+{
+  assert(state != NULL);
+  assert(state->function_ranges == NULL && state->function_counts == NULL);
+  if (state->sample_map == NULL || state->functionlist == NULL || state->numfunctions == 0)
+    return false;
+  state->function_ranges = (uint32_t*)malloc(2 * state->numfunctions * sizeof(uint32_t));
+  state->function_counts = (unsigned*)malloc((state->numfunctions + 1) * sizeof(unsigned));
+  if (state->function_ranges == NULL || state->function_counts == NULL) {
+    if (state->function_ranges != NULL) {
+      free((void*)state->function_ranges);
+      state->function_ranges = NULL;
+    }
+    if (state->function_counts != NULL) {
+      free((void*)state->function_counts);
+      state->function_counts = NULL;
+    }
+    return false;
+  }
+  for (unsigned idx = 0; idx < state->numfunctions; idx++) {
+    state->function_ranges[2 * idx] = state->functionlist[idx].addr_low;
+    state->function_ranges[2 * idx + 1] = state->functionlist[idx].addr_high;
+  }
+  samplemap_setfunctions(state->sample_map, state->function_ranges, state->numfunctions, state->function_counts);
+  return true;
+}
+
+static void help_popup(struct nk_context *ctx, APPSTATE *state, float canvas_width, float canvas_height)
+{
+# include "bmprofile_help.h"
+
+  if (state->help_popup) {
+#   define MARGIN  10
+    float w = opt_fontsize * 40;
+    if (w > canvas_width - 2*MARGIN)  /* clip "ideal" help window size of canvas size */
+      w = canvas_width - 2*MARGIN;
+    float h = canvas_height * 0.75;
+    struct nk_rect rc = nk_rect((canvas_width - w) / 2, (canvas_height - h) / 2, w, h);
+#   undef MARGIN
+
+    state->help_popup = nk_guide(ctx, &rc, opt_fontsize, (const char*)bmprofile_help, NULL);
+  }
+}
+
+static void panel_options(struct nk_context *ctx, APPSTATE *state,
+                          enum nk_collapse_states tab_states[TAB_COUNT],
+                          float panel_width)
+{
+  static const char *mode_strings[] = { "Manchester", "NRZ/async." };
+
+# define LABEL_WIDTH (4.5 * opt_fontsize)
+# define VALUE_WIDTH (panel_width - LABEL_WIDTH - 26)
+
+  if (nk_tree_state_push(ctx, NK_TREE_TAB, "Configuration", &tab_states[TAB_CONFIGURATION])) {
+    int result;
+    nk_layout_row_begin(ctx, NK_STATIC, ROW_HEIGHT, 2);
+    nk_layout_row_push(ctx, LABEL_WIDTH);
+    nk_label(ctx, "Probe", NK_TEXT_ALIGN_LEFT | NK_TEXT_ALIGN_MIDDLE);
+    nk_layout_row_push(ctx, VALUE_WIDTH);
+    struct nk_rect bounds = nk_widget_bounds(ctx);
+    state->probe = nk_combo(ctx, state->probelist, state->netprobe+1, state->probe,
+                            (int)COMBOROW_CY, nk_vec2(bounds.w, 4.5*ROW_HEIGHT));
+    if (state->probe == state->netprobe) {
+      int reconnect = 0;
+      nk_layout_row_begin(ctx, NK_STATIC, ROW_HEIGHT, 3);
+      nk_layout_row_push(ctx, LABEL_WIDTH);
+      nk_label(ctx, "IP Addr", NK_TEXT_ALIGN_LEFT | NK_TEXT_ALIGN_MIDDLE);
+      nk_layout_row_push(ctx, VALUE_WIDTH - BROWSEBTN_WIDTH - 5);
+      result = editctrl_tooltip(ctx, NK_EDIT_FIELD|NK_EDIT_SIG_ENTER|NK_EDIT_CLIPBOARD,
+                                state->IPaddr, sizearray(state->IPaddr), nk_filter_ascii,
+                                "IP address of the ctxLink");
+      if ((result & NK_EDIT_COMMITED) != 0 && bmp_is_ip_address(state->IPaddr))
+        reconnect = 1;
+      nk_layout_row_push(ctx, BROWSEBTN_WIDTH);
+      if (button_symbol_tooltip(ctx, NK_SYMBOL_TRIPLE_DOT, NK_KEY_NONE, nk_true, "Scan network for ctxLink probes.")) {
+#       if defined WIN32 || defined _WIN32
+          HCURSOR hcur = SetCursor(LoadCursor(NULL, IDC_WAIT));
+#       endif
+        unsigned long addr;
+        int count = scan_network(&addr, 1);
+#       if defined WIN32 || defined _WIN32
+          SetCursor(hcur);
+#       endif
+        if (count == 1) {
+          sprintf(state->IPaddr, "%lu.%lu.%lu.%lu",
+                 addr & 0xff, (addr >> 8) & 0xff, (addr >> 16) & 0xff, (addr >> 24) & 0xff);
+          reconnect = 1;
+        } else {
+          strlcpy(state->IPaddr, "none found", sizearray(state->IPaddr));
+        }
+      }
+      nk_layout_row_end(ctx);
+      if (reconnect) {
+        bmp_disconnect();
+        state->curstate = STATE_CONNECT;
+      }
+    }
+    if (state->probe_type == PROBE_UNKNOWN) {
+      nk_layout_row_begin(ctx, NK_STATIC, ROW_HEIGHT, 2);
+      nk_layout_row_push(ctx, LABEL_WIDTH);
+      nk_label(ctx, "Mode", NK_TEXT_ALIGN_LEFT | NK_TEXT_ALIGN_MIDDLE);
+      nk_layout_row_push(ctx, VALUE_WIDTH);
+      result = state->swomode - MODE_MANCHESTER;
+      result = nk_combo(ctx, mode_strings, NK_LEN(mode_strings), result, opt_fontsize, nk_vec2(VALUE_WIDTH,4.5*opt_fontsize));
+      if (state->swomode != result + MODE_MANCHESTER) {
+        /* mode is 1-based, the result of nk_combo() is 0-based, which is
+           why MODE_MANCHESTER is added (MODE_MANCHESTER == 1) */
+        state->swomode = result + MODE_MANCHESTER;
+        state->curstate = STATE_CONNECT;
+      }
+      nk_layout_row_end(ctx);
+    }
+
+    nk_layout_row_dynamic(ctx, ROW_HEIGHT, 1);
+    if (checkbox_tooltip(ctx, "Configure Target", &state->init_target, NK_TEXT_LEFT, "Configure the target microcontroller for SWO"))
+      state->curstate = STATE_INIT_TARGET;
+    nk_layout_row_dynamic(ctx, ROW_HEIGHT, 1);
+    if (checkbox_tooltip(ctx, "Configure Debug Probe", &state->init_bmp, NK_TEXT_LEFT, "Activate SWO capture in the Black Magic Probe"))
+      state->curstate = STATE_ATTACH;
+    if (state->init_target || state->init_bmp) {
+      nk_layout_row_dynamic(ctx, ROW_HEIGHT, 1);
+      if (checkbox_tooltip(ctx, "Reset target during connect", &state->connect_srst, NK_TEXT_LEFT, "Keep the target in reset state while scanning and attaching"))
+        state->curstate = STATE_INIT_TARGET;
+    }
+
+    if (state->init_target) {
+      nk_layout_row_begin(ctx, NK_STATIC, ROW_HEIGHT, 2);
+      nk_layout_row_push(ctx, LABEL_WIDTH);
+      nk_label(ctx, "CPU clock", NK_TEXT_ALIGN_LEFT | NK_TEXT_ALIGN_MIDDLE);
+      nk_layout_row_push(ctx, VALUE_WIDTH);
+      result = editctrl_tooltip(ctx, NK_EDIT_FIELD|NK_EDIT_SIG_ENTER|NK_EDIT_CLIPBOARD,
+                                state->mcuclock_str, sizearray(state->mcuclock_str), nk_filter_decimal,
+                                "CPU clock of the target microcontroller");
+      if ((result & NK_EDIT_COMMITED) != 0 || ((result & NK_EDIT_DEACTIVATED) && strtoul(state->mcuclock_str, NULL, 10) != state->mcuclock))
+        state->curstate = STATE_INIT_TARGET;
+      nk_layout_row_end(ctx);
+    }
+
+    if (state->init_target || (state->init_bmp && state->swomode == MODE_ASYNC)) {
+      nk_layout_row_begin(ctx, NK_STATIC, ROW_HEIGHT, 2);
+      nk_layout_row_push(ctx, LABEL_WIDTH);
+      nk_label(ctx, "Bit rate", NK_TEXT_ALIGN_LEFT | NK_TEXT_ALIGN_MIDDLE);
+      nk_layout_row_push(ctx, VALUE_WIDTH);
+      result = editctrl_tooltip(ctx, NK_EDIT_FIELD|NK_EDIT_SIG_ENTER|NK_EDIT_CLIPBOARD,
+                                state->bitrate_str, sizearray(state->bitrate_str), nk_filter_decimal,
+                                "SWO bit rate (data rate)");
+      if ((result & NK_EDIT_COMMITED) != 0 || ((result & NK_EDIT_DEACTIVATED) && strtoul(state->bitrate_str, NULL, 10) != state->bitrate))
+        state->curstate = STATE_INIT_TARGET;
+      nk_layout_row_end(ctx);
+    }
+
+    nk_layout_row_begin(ctx, NK_STATIC, ROW_HEIGHT, 3);
+    nk_layout_row_push(ctx, LABEL_WIDTH);
+    nk_label(ctx, "ELF file", NK_TEXT_ALIGN_LEFT | NK_TEXT_ALIGN_MIDDLE);
+    nk_layout_row_push(ctx, VALUE_WIDTH - BROWSEBTN_WIDTH - 5);
+    bool error = editctrl_cond_color(ctx, !state->dwarf_loaded, COLOUR_BG_DARKRED);
+    result = editctrl_tooltip(ctx, NK_EDIT_FIELD|NK_EDIT_SIG_ENTER|NK_EDIT_CLIPBOARD,
+                              state->ELFfile, sizearray(state->ELFfile), nk_filter_ascii,
+                              "ELF file for symbol lookup");
+    editctrl_reset_color(ctx, error);
+    if (result & (NK_EDIT_COMMITED | NK_EDIT_DEACTIVATED)) {
+      state->dwarf_loaded = false;
+      state->curstate = STATE_LOAD_DWARF;
+    }
+    nk_layout_row_push(ctx, BROWSEBTN_WIDTH);
+    if (nk_button_symbol(ctx, NK_SYMBOL_TRIPLE_DOT)) {
+      nk_input_clear_mousebuttons(ctx);
+#     if defined _WIN32
+        const char *filter = "ELF Executables\0*.elf;*.\0All files\0*.*\0";
+#     else
+        const char *filter = "ELF Executables\0*.elf\0All files\0*\0";
+#     endif
+      int res = noc_file_dialog_open(state->ELFfile, sizearray(state->ELFfile),
+                                     NOC_FILE_DIALOG_OPEN, filter,
+                                     NULL, state->ELFfile, "Select ELF Executable",
+                                     guidriver_apphandle());
+      if (res) {
+        state->dwarf_loaded = false;
+        state->curstate = STATE_LOAD_DWARF;
+      }
+    }
+    nk_layout_row_end(ctx);
+    nk_tree_state_pop(ctx);
+  }
+# undef LABEL_WIDTH
+# undef VALUE_WIDTH
+}
+
+static void panel_profile(struct nk_context *ctx, APPSTATE *state,
+                          enum nk_collapse_states tab_states[TAB_COUNT],
+                          float panel_width)
+{
+# define LABEL_WIDTH(n) ((n) * opt_fontsize)
+# define VALUE_WIDTH(n) (panel_width - LABEL_WIDTH(n) - 26)
+
+  if (nk_tree_state_push(ctx, NK_TREE_TAB, "Profile options", &tab_states[TAB_PROFILE])) {
+    int result;
+    nk_layout_row_begin(ctx, NK_STATIC, ROW_HEIGHT, 2);
+    nk_layout_row_push(ctx, LABEL_WIDTH(7));
+    nk_label(ctx, "Sample rate", NK_TEXT_ALIGN_LEFT | NK_TEXT_ALIGN_MIDDLE);
+    nk_layout_row_push(ctx, VALUE_WIDTH(7));
+    result = editctrl_tooltip(ctx, NK_EDIT_FIELD|NK_EDIT_SIG_ENTER|NK_EDIT_CLIPBOARD,
+                              state->samplingfreq_str, sizearray(state->samplingfreq_str),
+                              nk_filter_decimal, "Frequency in Hz at which the PC is sampled\n(Approximate: real sampling rate may deviate)");
+    if ((result & NK_EDIT_COMMITED) != 0 || ((result & NK_EDIT_DEACTIVATED) && strtoul(state->samplingfreq_str, NULL, 10) != state->samplingfreq))
+      state->curstate = STATE_CONFIG_PROFILE;
+    nk_layout_row_end(ctx);
+
+    nk_layout_row_begin(ctx, NK_STATIC, ROW_HEIGHT, 2);
+    nk_layout_row_push(ctx, LABEL_WIDTH(7));
+    nk_label(ctx, "Refresh interval", NK_TEXT_ALIGN_LEFT | NK_TEXT_ALIGN_MIDDLE);
+    nk_layout_row_push(ctx, VALUE_WIDTH(7));
+    result = editctrl_tooltip(ctx, NK_EDIT_FIELD|NK_EDIT_SIG_ENTER|NK_EDIT_CLIPBOARD,
+                              state->refreshrate_str, sizearray(state->refreshrate_str),
+                              nk_filter_float, "Interval in seconds between refreshes of the graph\nA fractional value can be set");
+    if ((result & NK_EDIT_COMMITED) || (result & NK_EDIT_DEACTIVATED)) {
+      state->refreshrate = strtod(state->refreshrate_str, NULL);
+      if (state->refreshrate < 0.1)
+        state->refreshrate = 1.0;
+      else if (state->refreshrate > 600.0)
+        state->refreshrate = 600.0;
+    }
+    nk_layout_row_end(ctx);
+
+    nk_layout_row_dynamic(ctx, ROW_HEIGHT, 1);
+    checkbox_tooltip(ctx, "Accumulate samples", &state->accumulate, NK_TEXT_LEFT,
+                     "Accumulate all samples since starting a profiling run");
+
+    if (state->init_target) {
+      nk_layout_row_dynamic(ctx, ROW_HEIGHT, 1);
+      if (checkbox_tooltip(ctx, "Adaptive sample rate", &state->adaptive, NK_TEXT_LEFT,
+                           "Adjust the sample rate to the highest rate that the SWO link carries without overflow"))
+        state->curstate = STATE_INIT_TARGET;
+    }
+
+    nk_layout_row_begin(ctx, NK_STATIC, ROW_HEIGHT, 2);
+    nk_layout_row_push(ctx, LABEL_WIDTH(7));
+    nk_label(ctx, "Time slice", NK_TEXT_ALIGN_LEFT | NK_TEXT_ALIGN_MIDDLE);
+    nk_layout_row_push(ctx, VALUE_WIDTH(7));
+    result = editctrl_tooltip(ctx, NK_EDIT_FIELD|NK_EDIT_SIG_ENTER|NK_EDIT_CLIPBOARD,
+                              state->timeslice_str, sizearray(state->timeslice_str),
+                              nk_filter_decimal, "Duration of a time slice in ms (0 = off)\nA histogram is kept for each time slice, so that short peaks can be found");
+    if ((result & NK_EDIT_COMMITED) || (result & NK_EDIT_DEACTIVATED)) {
+      unsigned long timeslice = strtoul(state->timeslice_str, NULL, 10);
+      if (timeslice > 0 && timeslice < 10)
+        timeslice = 10;
+      else if (timeslice > 60000)
+        timeslice = 60000;
+      sprintf(state->timeslice_str, "%lu", timeslice);
+      if (timeslice != state->timeslice) {
+        state->timeslice = timeslice;
+        profile_setslices(state);
+      }
+    }
+    nk_layout_row_end(ctx);
+
+    nk_layout_row_begin(ctx, NK_STATIC, ROW_HEIGHT, 2);
+    nk_layout_row_push(ctx, LABEL_WIDTH(7));
+    nk_label(ctx, "Task channel", NK_TEXT_ALIGN_LEFT | NK_TEXT_ALIGN_MIDDLE);
+    nk_layout_row_push(ctx, VALUE_WIDTH(7));
+    result = editctrl_tooltip(ctx, NK_EDIT_FIELD|NK_EDIT_SIG_ENTER|NK_EDIT_CLIPBOARD,
+                              state->taskchannel_str, sizearray(state->taskchannel_str),
+                              nk_filter_decimal, "ITM channel on which the RTOS reports task switches (empty = off)\nA histogram is kept for each task");
+    if ((result & NK_EDIT_COMMITED) || (result & NK_EDIT_DEACTIVATED)) {
+      int channel = (strlen(state->taskchannel_str) > 0) ? (int)strtol(state->taskchannel_str, NULL, 10) : -1;
+      if (channel > 31)
+        channel = 31;
+      if (channel >= 0)
+        sprintf(state->taskchannel_str, "%d", channel);
+      if (channel != state->task_channel) {
+        state->task_channel = channel;
+        profile_settasks(state);
+        if (state->init_target && state->init_done)
+          profile_taskport(state);
+      }
+    }
+    nk_layout_row_end(ctx);
+
+    unsigned numslices = (state->sample_map != NULL) ? samplemap_slices(state->sample_map) : 0;
+    if (numslices > 0 && state->view == VIEW_TOP) {
+      /* the chart shows the share of the hottest function in each slice, so
+         that peaks stand out; click on a column to view that slice */
+      int slice_view = state->slice_view;
+      nk_layout_row_dynamic(ctx, 3 * ROW_HEIGHT, 1);
+      if (nk_chart_begin(ctx, NK_CHART_COLUMN, numslices, 0.0f, 1.0f)) {
+        for (unsigned idx = 0; idx < numslices; idx++) {
+          unsigned total, peak;
+          samplemap_sliceinfo(state->sample_map, idx, NULL, &total, &peak);
+          if (nk_chart_push(ctx, (total > 0) ? (float)peak / total : 0.0f) & NK_CHART_CLICKED)
+            slice_view = idx + 1;
+        }
+        nk_chart_end(ctx);
+      }
+      nk_layout_row_begin(ctx, NK_STATIC, ROW_HEIGHT, 2);
+      nk_layout_row_push(ctx, LABEL_WIDTH(7));
+      char valuestr[40];
+      if (slice_view > 0) {
+        double start;
+        unsigned total;
+        samplemap_sliceinfo(state->sample_map, slice_view - 1, &start, &total, NULL);
+        sprintf(valuestr, "+%.2f s (%u)", start, total);
+      } else {
+        strcpy(valuestr, "Live");
+      }
+      label_tooltip(ctx, valuestr, NK_TEXT_ALIGN_LEFT | NK_TEXT_ALIGN_MIDDLE, "Time slice on view (start time & sample count)");
+      nk_layout_row_push(ctx, VALUE_WIDTH(7));
+      nk_slider_int(ctx, 0, &slice_view, numslices, 1);
+      nk_layout_row_end(ctx);
+      if (slice_view != state->slice_view) {
+        state->slice_view = slice_view;
+        state->task_view = 0;
+        profile_graph_top(state);
+      }
+    }
+
+    unsigned numtasks = (state->sample_map != NULL) ? samplemap_tasks(state->sample_map) : 0;
+    if (numtasks > 0 && state->view == VIEW_TOP) {
+      int task_view = state->task_view;
+      nk_layout_row_begin(ctx, NK_STATIC, ROW_HEIGHT, 2);
+      nk_layout_row_push(ctx, LABEL_WIDTH(7));
+      char valuestr[40];
+      if (task_view > 0) {
+        uint32_t id;
+        samplemap_taskinfo(state->sample_map, task_view - 1, &id, NULL);
+        task_name(id, valuestr, sizearray(valuestr));
+      } else {
+        strcpy(valuestr, "All tasks");
+      }
+      label_tooltip(ctx, valuestr, NK_TEXT_ALIGN_LEFT | NK_TEXT_ALIGN_MIDDLE, "Task on view");
+      nk_layout_row_push(ctx, VALUE_WIDTH(7));
+      nk_slider_int(ctx, 0, &task_view, numtasks, 1);
+      nk_layout_row_end(ctx);
+      if (task_view != state->task_view) {
+        state->task_view = task_view;
+        state->slice_view = 0;
+        profile_graph_top(state);
+      }
+    }
+
+    nk_tree_state_pop(ctx);
+  }
+# undef LABEL_WIDTH
+# undef VALUE_WIDTH
+}
+
+static void panel_status(struct nk_context *ctx, APPSTATE *state,
+                         enum nk_collapse_states tab_states[TAB_COUNT],
+                         float panel_width)
+{
+# define LABEL_WIDTH(n) ((n) * opt_fontsize)
+# define VALUE_WIDTH(n) (panel_width - LABEL_WIDTH(n) - 26)
+
+  if (nk_tree_state_push(ctx, NK_TREE_TAB, "Status", &tab_states[TAB_STATUS])) {
+    char valuestr[20];
+    nk_layout_row_begin(ctx, NK_STATIC, ROW_HEIGHT, 2);
+    nk_layout_row_push(ctx, LABEL_WIDTH(8));
+    nk_label(ctx, "Real sample rate", NK_TEXT_ALIGN_LEFT | NK_TEXT_ALIGN_MIDDLE);
+    nk_layout_row_push(ctx, VALUE_WIDTH(8));
+    if (state->curstate == STATE_RUNNING)
+      sprintf(valuestr, "%lu Hz", state->actual_freq);
+    else
+      sprintf(valuestr, "-");
+    label_tooltip(ctx, valuestr, NK_TEXT_ALIGN_LEFT | NK_TEXT_ALIGN_MIDDLE, "Measured sample rate");
+    nk_layout_row_end(ctx);
+
+    if (state->adaptive && state->init_target) {
+      nk_layout_row_begin(ctx, NK_STATIC, ROW_HEIGHT, 2);
+      nk_layout_row_push(ctx, LABEL_WIDTH(8));
+      nk_label(ctx, "Adaptive rate", NK_TEXT_ALIGN_LEFT | NK_TEXT_ALIGN_MIDDLE);
+      nk_layout_row_push(ctx, VALUE_WIDTH(8));
+      if (state->curstate == STATE_RUNNING && state->mcuclock > 0)
+        sprintf(valuestr, "%lu Hz", state->mcuclock / rate_interval(state->rate_level));
+      else
+        sprintf(valuestr, "-");
+      label_tooltip(ctx, valuestr, NK_TEXT_ALIGN_LEFT | NK_TEXT_ALIGN_MIDDLE, "Sample rate set by the adaptive rate control");
+      nk_layout_row_end(ctx);
+    }
+
+    nk_layout_row_begin(ctx, NK_STATIC, ROW_HEIGHT, 2);
+    nk_layout_row_push(ctx, LABEL_WIDTH(8));
+    nk_label(ctx, "Overflow events", NK_TEXT_ALIGN_LEFT | NK_TEXT_ALIGN_MIDDLE);
+    nk_layout_row_push(ctx, VALUE_WIDTH(8));
+    sprintf(valuestr, "%u", state->overflow);
+    label_tooltip(ctx, valuestr, NK_TEXT_ALIGN_LEFT | NK_TEXT_ALIGN_MIDDLE, "Overflow event count (sample rate too high)");
+    nk_layout_row_end(ctx);
+
+    nk_layout_row_begin(ctx, NK_STATIC, ROW_HEIGHT, 2);
+    nk_layout_row_push(ctx, LABEL_WIDTH(8));
+    nk_label(ctx, "Overhead", NK_TEXT_ALIGN_LEFT | NK_TEXT_ALIGN_MIDDLE);
+    nk_layout_row_push(ctx, VALUE_WIDTH(8));
+    if (state->total_samples > 0)
+      sprintf(valuestr, "%.1f%%",(100.0 * state->sample_unknown)/(double)state->total_samples);
+    else
+      strcpy(valuestr, "-");
+    label_tooltip(ctx, valuestr, NK_TEXT_ALIGN_LEFT | NK_TEXT_ALIGN_MIDDLE, "Percentage of samples in unidentified code");
+    nk_layout_row_end(ctx);
+
+    nk_tree_state_pop(ctx);
+  }
+# undef LABEL_WIDTH
+# undef VALUE_WIDTH
+}
+
+static void button_bar(struct nk_context *ctx, APPSTATE *state)
+{
+  nk_layout_row(ctx, NK_DYNAMIC, ROW_HEIGHT, 4, nk_ratio(4, 0.25, 0.25, 0.25, 0.25));
+
+  const char *ptr = (state->curstate == STATE_RUNNING) ? "Stop" : "Start";
+  if (nk_button_label(ctx, ptr) || nk_input_is_key_pressed(&ctx->input, NK_KEY_F5)) {
+    if (state->curstate == STATE_RUNNING)
+      state->curstate = STATE_STOP;
+    else if (!state->connected)
+      state->curstate = STATE_CONNECT;
+    else if (!state->attached)
+      state->curstate = STATE_ATTACH;
+    else if (state->trace_status != TRACESTAT_OK)
+      state->curstate = STATE_INIT_USB;
+    else
+      state->curstate = STATE_RUN;
+  }
+
+  if (nk_button_label(ctx, "Clear")) {
+    profile_reset(state, true);
+    state->capture_tstamp = get_timestamp();
+  }
+
+  if (state->export_percent >= 0) {
+    /* saving in the background, the button shows the progress and cancels */
+    char caption[32];
+    sprintf(caption, "Cancel (%d%%)", state->export_percent);
+    if (nk_button_label(ctx, caption))
+      export_cancel();
+  } else if (nk_button_label(ctx, "Save") || nk_input_is_key_pressed(&ctx->input, NK_KEY_SAVE)) {
+    char path[_MAX_PATH];
+    int res = noc_file_dialog_open(path, sizearray(path), NOC_FILE_DIALOG_SAVE,
+                                   "CSV files\0*.csv\0Binary files\0*.bin\0All files\0*.*\0",
+                                   NULL, NULL, NULL, guidriver_apphandle());
+    if (res) {
+      const char *ext;
+      if ((ext = strrchr(path, '.')) == NULL || strchr(ext, DIRSEP_CHAR) != NULL)
+        strlcat(path, ".csv", sizearray(path)); /* default extension .csv */
+      if (profile_save(path, export_format(path, EXPORT_CSV), state))
+        state->export_percent = 0;
+      else
+        tracelog_statusmsg(TRACESTATMSG_BMP, "Failed to save the profile", BMPERR_GENERAL);
+    }
+  }
+
+  if (nk_button_label(ctx, "Help") || nk_input_is_key_pressed(&ctx->input, NK_KEY_F1))
+    state->help_popup = true;
+}
+
+/* segment_checksum() updates the checksum with the contents of a segment in
+   the ELF file */
+static uint32_t segment_checksum(FILE *fp, unsigned long offset, unsigned long size, uint32_t crc)
+{
+  unsigned char buffer[512];
+  fseek(fp, offset, SEEK_SET);
+  while (size > 0) {
+    size_t count = (size < sizeof buffer) ? size : sizeof buffer;
+    if (fread(buffer, 1, count, fp) != count)
+      break;
+    crc = gdb_crc32(crc, buffer, (unsigned)count);
+    size -= count;
+  }
+  return crc;
+}
+
+/* load_elffile() gets the code range from the ELF file, and loads the DWARF
+   information; it sets "dwarf_loaded" on success */
+static bool load_elffile(APPSTATE *state)
+{
+  export_wait();          /* a background save uses the DWARF tables */
+  coverage_store(state);  /* store the coverage of the previously loaded file */
+  if (strlen(state->ELFfile) == 0) {
+    tracelog_statusmsg(TRACESTATMSG_BMP, "No ELF file given.", BMPSTAT_NOTICE);
+  } else if (access(state->ELFfile, 0) != 0) {
+    tracelog_statusmsg(TRACESTATMSG_BMP, "Specified ELF cannot be opened.", BMPSTAT_NOTICE);
+  } else {
+    FILE *fp = fopen(state->ELFfile, "rb");
+    if (fp != NULL) {
+      /* get range of all code sections */
+      state->code_base = state->code_top = 0;
+      state->elf_id = ~0;
+      ELF_FILE *elf = elf_open(fp, NULL);
+      for (int segm = 0; ; segm++) {
+        unsigned long offset, filesize, vaddr, memsize;
+        int type, flags;
+        int err = elf_file_segment(elf, segm, &type, &flags, &offset, &filesize, &vaddr, NULL, &memsize);
+        if (err != ELFERR_NONE)
+          break;
+        if (type == ELF_PT_LOAD && (flags & ELF_PF_X) != 0) {
+          /* only handle loadable segments that are executable */
+          if (state->code_base == 0 && state->code_top == 0) {
+            state->code_base = vaddr;
+            state->code_top = vaddr + memsize;
+          } else {
+            unsigned long top = vaddr + memsize;
+            if (vaddr < state->code_base)
+              state->code_base = vaddr;
+            if (top > state->code_top)
+              state->code_top = top;
+          }
+          state->elf_id = segment_checksum(fp, offset, filesize, state->elf_id);
+        }
+      }
+      elf_close(elf);
+      /* allocate memory for sample map (drop the function list first, because
+         it is linked to the previous sample map) */
+      clear_functions(state);
+      samplemap_delete(state->sample_map);
+      state->sample_map = samplemap_create(state->code_base, state->code_top);
+      if (state->sample_map == NULL)
+        tracelog_statusmsg(TRACESTATMSG_BMP, "Memory allocation error.", BMPSTAT_NOTICE);
+      if (strlen(state->CoverageFile) > 0)
+        state->coverage = coverage_create(state->code_base, state->code_top, state->elf_id);
+      /* load dwarf */
+      int address_size;
+      char cachefile[_MAX_PATH];
+      if (!get_cachefile(cachefile, sizearray(cachefile), state->ELFfile))
+        cachefile[0] = '\0';
+      if (dwarf_read_cached(fp, cachefile, &dwarf_linetable, &dwarf_symboltable, &dwarf_filetable, &address_size))
+        state->dwarf_loaded = true;
+      else
+        tracelog_statusmsg(TRACESTATMSG_BMP, "No debug information in ELF file (DWARF format).", BMPSTAT_NOTICE);
+      fclose(fp);
+      if (state->dwarf_loaded && collect_functions(state))
+        collect_functionmap(state);
+      if (state->dwarf_loaded)
+        collect_linemap(state);
+    }
+  }
+  return state->dwarf_loaded;
+}
+
+static void handle_stateaction(APPSTATE *state)
+{
+  switch (state->curstate) {
+  case STATE_IDLE:
+    break;
+  case STATE_CONNECT:
+    trace_close();
+    bmp_disconnect();
+    export_wait();
+    dwarf_cleanup(&dwarf_linetable, &dwarf_symboltable, &dwarf_filetable);
+    tracelog_statusclear();
+    tracelog_statusmsg(TRACESTATMSG_BMP, "Initializing...", BMPSTAT_SUCCESS);
+    state->connected = bmp_connect(state->probe, (state->probe == state->netprobe) ? state->IPaddr : NULL);
+    state->firstrun = true;
+    state->dwarf_loaded = false;
+    state->attached = false;
+    state->curstate = (state->connected) ? STATE_ATTACH : STATE_IDLE;
+    if (state->connected && state->monitor_cmds == NULL)
+      state->monitor_cmds = bmp_get_monitor_cmds();
+    break;
+  case STATE_ATTACH:
+    if (state->init_bmp) {
+      probe_set_options(state);
+      state->attached = bmp_attach(true, state->mcu_family, sizearray(state->mcu_family),
+                                   state->mcu_architecture, sizearray(state->mcu_architecture));
+      if (state->attached) {
+        /* overrule any default protocol setting, if the debug probe can be
+           verified */
+        state->probe_type = bmp_checkversionstring();
+        if (state->probe_type == PROBE_BMPv21 || state->probe_type == PROBE_BMPv23)
+          state->swomode = MODE_MANCHESTER;
+        else if (state->probe_type == PROBE_CTXLINK)
+         state->swomode = MODE_ASYNC;
+        if (strncmp(state->mcu_architecture, "M0", 2) == 0)
+          tracelog_statusmsg(TRACESTATMSG_BMP, "Cortex M0/M0+ architecture does not support profiling.", BMPSTAT_NOTICE);
+      }
+      state->curstate = (state->attached) ? STATE_LOAD_DWARF : STATE_IDLE;
+    } else {
+      state->curstate = STATE_LOAD_DWARF;
+    }
+    break;
+  case STATE_LOAD_DWARF:
+    if (!state->attached) {
+      state->curstate = STATE_IDLE;
+      break;
+    }
+    load_elffile(state);
+    profile_reset(state, true);
+    state->curstate = state->dwarf_loaded ? STATE_INIT_TARGET : STATE_IDLE;
+    break;
+  case STATE_INIT_TARGET:
+    if (state->init_target) {
+      state->mcuclock = strtoul(state->mcuclock_str, NULL, 10);
+      state->bitrate = strtoul(state->bitrate_str, NULL, 10);
+      state->samplingfreq = strtoul(state->samplingfreq_str, NULL, 10);
+      state->refreshrate = strtod(state->refreshrate_str, NULL);
+      int errcount = 0;
+      if (state->mcuclock < 1000) {
+        tracelog_statusmsg(TRACESTATMSG_BMP, "CPU clock frequency not set (or invalid).", BMPSTAT_NOTICE);
+        errcount += 1;
+      }
+      if (state->bitrate < 100) {
+        tracelog_statusmsg(TRACESTATMSG_BMP, "Bit rate (SWO) not set (or invalid).", BMPSTAT_NOTICE);
+        errcount += 1;
+      }
+      if (state->samplingfreq < 10) {
+        tracelog_statusmsg(TRACESTATMSG_BMP, "Sampling rate not set (or invalid).", BMPSTAT_NOTICE);
+        errcount += 1;
+      }
+      if (state->refreshrate < 0.001) {
+        tracelog_statusmsg(TRACESTATMSG_BMP, "Refresh interval not set (or invalid).", BMPSTAT_NOTICE);
+        errcount += 1;
+      }
+      if (errcount > 0) {
+        state->curstate = STATE_IDLE;
+        break;
+      }
+      unsigned long params[4];
+      /* check to get more specific information on the MCU (specifically to
+         update the mcu_family name, so that the appropriate scripts can be
+         loaded) */
+      if (bmp_runscript("partid", state->mcu_family, state->mcu_architecture, params, 1)) {
+        state->mcu_partid = params[0];
+        const MCUINFO *info = mcuinfo_lookup(state->mcu_family, state->mcu_partid);
+        if (info != NULL && info->mcuname != NULL) {
+          strlcpy(state->mcu_family, info->mcuname, sizearray(state->mcu_family));
+          bmscript_clear();
+        }
+      }
+      /* initialize the target (target-specific configuration, generic
+         configuration and channels */
+      bmp_runscript("swo_device", state->mcu_family, state->mcu_architecture, NULL, 0);
+      assert(state->swomode == MODE_MANCHESTER || state->swomode == MODE_ASYNC);
+      unsigned long swvclock = (state->swomode == MODE_MANCHESTER) ? 2 * state->bitrate : state->bitrate;
+      assert(state->mcuclock > 0 && swvclock > 0);
+      double div_value = (double)state->mcuclock / (1024 * (double)state->samplingfreq);
+      unsigned long divider = (unsigned long)(div_value + 0.5);
+      if (divider < 1)
+        divider = 1;
+      else if (divider > 16)
+        divider = 16;
+      params[0]= state->swomode;
+      params[1] = state->mcuclock / swvclock - 1;
+      params[2] = divider - 1;
+      bmp_runscript("swo_profile", state->mcu_family, state->mcu_architecture, params, 3);
+      if (state->adaptive) {
+        /* start at the configured rate, but not faster than what the link is
+           estimated to carry at 80% load */
+        int level = rate_level(state->mcuclock, state->samplingfreq);
+        int minlevel = rate_level(state->mcuclock, link_capacity(state) * 4 / (5 * PCSAMPLE_BYTES));
+        if (level < minlevel)
+          level = minlevel;
+        profile_setrate(state, level, !state->firstrun);
+        state->rate_ceiling = -1;
+        state->rate_stable = 0;
+        state->rate_overflow = state->overflow;
+        state->rate_tstamp = get_timestamp();
+      }
+      if (state->task_channel >= 0)
+        profile_taskport(state);
+      state->init_done = true;
+    }
+    tracelog_statusmsg(TRACESTATMSG_BMP, "Starting profiling run...", BMPSTAT_SUCCESS);
+    state->curstate = STATE_RUN;
+    break;
+  case STATE_RUN:
+    tracelog_statusclear();
+    if (state->init_target && !state->init_done) {
+      state->curstate = STATE_INIT_TARGET;
+      break;
+    }
+    profile_reset(state, true);
+    state->trace_status = trace_init(state->trace_endpoint, (state->probe == state->netprobe) ? state->IPaddr : NULL);
+    state->curstate = (state->trace_status == TRACESTAT_OK) ? STATE_RUNNING : STATE_IDLE;
+    if (state->firstrun) {
+      state->capture_tstamp = get_timestamp();
+      state->actual_freq = state->samplingfreq;
+      bmp_enabletrace((state->swomode == MODE_ASYNC) ? state->bitrate : 0, &state->trace_endpoint);
+      bmp_restart();
+      state->firstrun = false;
+    }
+    state->curstate = STATE_RUNNING;
+    break;
+  case STATE_RUNNING:
+    break;
+  case STATE_STOP:
+    trace_close();
+    state->curstate = STATE_STOPPED;
+    break;
+  case STATE_STOPPED:
+    break;
+  }
+}
+
+static volatile sig_atomic_t headless_stop = 0;
+
+static void headless_signal(int sig)
+{
+  (void)sig;
+  headless_stop = 1;
+}
+
+/* headless_statusmsg() copies the status messages to standard error (so that
+   errors are reported in capture mode) */
+static void headless_statusmsg(void)
+{
+  const char *msg;
+  for (int idx = 0; (msg = tracelog_getstatusmsg(idx)) != NULL; idx++)
+    fprintf(stderr, "%s\n", msg);
+  tracelog_statusclear();
+}
+
+/** profile_headless() connects to the probe and configures the target with
+ *  the settings in the state, collects samples for the given duration (or
+ *  until interrupted), and writes a report with the top functions and lines
+ *  to a file (or to stdout). There is no GUI in this mode.
+ *
+ *  \return EXIT_SUCCESS on success, EXIT_FAILURE if profiling could not be
+ *          started.
+ */
+static int profile_headless(APPSTATE *state, const char *outfile, double duration,
+                            unsigned topcount, bool json)
+{
+# if defined _WIN32  /* fix console output on Windows */
+    if (AttachConsole(ATTACH_PARENT_PROCESS)) {
+      freopen("CONOUT$", "wb", stdout);
+      freopen("CONOUT$", "wb", stderr);
+    }
+# endif
+
+  if (strlen(state->ELFfile) == 0) {
+    fprintf(stderr, "No ELF file given.\n");
+    return EXIT_FAILURE;
+  }
+  FILE *fp = stdout;
+  if (outfile != NULL && *outfile != '\0' && (fp = fopen(outfile, "wt")) == NULL) {
+    fprintf(stderr, "Failed to create output file %s\n", outfile);
+    return EXIT_FAILURE;
+  }
+
+  /* run the state machine up to the start of sampling */
+  state->view = VIEW_TOP;
+  state->accumulate = nk_true;
+  state->curstate = STATE_CONNECT;
+  while (state->curstate != STATE_RUNNING && state->curstate != STATE_IDLE) {
+    handle_stateaction(state);
+    headless_statusmsg();
+  }
+  if (state->curstate != STATE_RUNNING || state->trace_status != TRACESTAT_OK) {
+    if (state->trace_status != TRACESTAT_OK)
+      fprintf(stderr, "Failed to initialize SWO tracing (error %d)\n", state->trace_status);
+    if (fp != stdout)
+      fclose(fp);
+    return EXIT_FAILURE;
+  }
+
+  signal(SIGINT, headless_signal);
+  signal(SIGTERM, headless_signal);
+  double tstart = get_timestamp();
+  double tstamp = tstart;
+  while (!headless_stop && tstamp - tstart < duration) {
+    int events = traceprofile_process(true, state->sample_map, &state->overflow);
+    profile_adaptrate(state);
+    tstamp = get_timestamp();
+    if (tstamp - state->refresh_tstamp >= state->refreshrate) {
+      state->refresh_tstamp = tstamp;
+      profile_stream(state);
+    }
+    if (events == 0) {
+#     if defined _WIN32
+        Sleep(10);
+#     else
+        usleep(10 * 1000);
+#     endif
+    }
+  }
+  trace_close();
+  state->curstate = STATE_STOPPED;
+
+  profile_graph_top(state);
+  profile_report(fp, state, tstamp - tstart, topcount, json);
+  if (fp != stdout)
+    fclose(fp);
+  return EXIT_SUCCESS;
+}
+
+/** coverage_merge_file() merges a coverage database from a file into the
+ *  database file set for the session (or copies it, if that database does
+ *  not exist yet).
+ *
+ *  \return true on success, false on failure (an error message is printed).
+ */
+static bool coverage_merge_file(const char *dbfile, const char *mergefile)
+{
+  COVERAGE *cov;
+  int err = coverage_load(&cov, mergefile);
+  if (err == COVERR_NONE) {
+    err = coverage_accumulate(cov, dbfile);
+    coverage_delete(cov);
+  }
+  switch (err) {
+  case COVERR_NONE:
+    return true;
+  case COVERR_FILEOPEN:
+    fprintf(stderr, "Failed to merge %s into %s.\n", mergefile, dbfile);
+    break;
+  case COVERR_FORMAT:
+    fprintf(stderr, "Invalid coverage database: %s\n", mergefile);
+    break;
+  case COVERR_MISMATCH:
+    fprintf(stderr, "Coverage database %s is for a different build than %s.\n", mergefile, dbfile);
+    break;
+  default:
+    fprintf(stderr, "Memory allocation error.\n");
+    break;
+  }
+  return false;
+}
+
+/** profile_coverage() writes the report for a coverage database, to a file
+ *  (or to stdout). The ELF file is loaded for the address-to-line mapping, if
+ *  needed.
+ *
+ *  \return EXIT_SUCCESS on success, EXIT_FAILURE on failure.
+ */
+static int profile_coverage(APPSTATE *state, const char *dbfile, const char *outfile, bool json)
+{
+  if (!state->dwarf_loaded) {
+    load_elffile(state);
+    headless_statusmsg();
+    if (!state->dwarf_loaded)
+      return EXIT_FAILURE;
+  }
+  COVERAGE *cov;
+  int err = coverage_load(&cov, dbfile);
+  if (err != COVERR_NONE) {
+    fprintf(stderr, "Failed to read coverage database %s\n", dbfile);
+    return EXIT_FAILURE;
+  }
+  if (coverage_elf_id(cov) != state->elf_id) {
+    fprintf(stderr, "Coverage database %s is for a different build of %s.\n", dbfile, state->ELFfile);
+    coverage_delete(cov);
+    return EXIT_FAILURE;
+  }
+  FILE *fp = stdout;
+  if (outfile != NULL && *outfile != '\0' && (fp = fopen(outfile, "wt")) == NULL) {
+    fprintf(stderr, "Failed to create output file %s\n", outfile);
+    coverage_delete(cov);
+    return EXIT_FAILURE;
+  }
+  coverage_report(fp, state, cov, json);
+  if (fp != stdout)
+    fclose(fp);
+  coverage_delete(cov);
+  return EXIT_SUCCESS;
+}
+
+int main(int argc, char *argv[])
+{
+  /* global defaults */
+  APPSTATE appstate;
+  memset(&appstate, 0, sizeof appstate);
+  appstate.curstate = STATE_CONNECT;
+  appstate.swomode = MODE_MANCHESTER;
+  appstate.mcuclock = 48000000;
+  appstate.bitrate = 100000;
+  appstate.probe_type = PROBE_UNKNOWN;
+  appstate.trace_endpoint = BMP_EP_TRACE;
+  appstate.init_target = nk_true;
+  appstate.init_bmp = nk_true;
+  appstate.connect_srst = nk_false;
+  appstate.view = VIEW_TOP;
+  appstate.task_channel = -1;
+  appstate.export_percent = -1;
+
+# if defined FORTIFY
+    Fortify_SetOutputFunc(Fortify_OutputFunc);
+# endif
+
+  char txtConfigFile[_MAX_PATH];
+  get_configfile(txtConfigFile, sizearray(txtConfigFile), "bmprofile.ini");
+  ini_cache_open(txtConfigFile);  /* read settings from memory, write back on exit */
+  enum nk_collapse_states tab_states[TAB_COUNT];
+  SPLITTERBAR splitter_hor;
+  load_settings(txtConfigFile, &appstate, tab_states, &splitter_hor);
+  /* other configuration */
+  opt_fontsize = ini_getf("Settings", "fontsize", FONT_HEIGHT, txtConfigFile);
+  char opt_fontstd[64] = "", opt_fontmono[64] = "";
+  ini_gets("Settings", "fontstd", "", opt_fontstd, sizearray(opt_fontstd), txtConfigFile);
+  ini_gets("Settings", "fontmono", "", opt_fontmono, sizearray(opt_fontmono), txtConfigFile);
+  char valstr[128];
+  int canvas_width, canvas_height;
+  ini_gets("Settings", "size", "", valstr, sizearray(valstr), txtConfigFile);
+  if (sscanf(valstr, "%d %d", &canvas_width, &canvas_height) != 2 || canvas_width < 100 || canvas_height < 50) {
+    canvas_width = WINDOW_WIDTH;
+    canvas_height = WINDOW_HEIGHT;
+  }
+
+# define SEPARATOR_HOR 4
+# define SPACING       4
+  nk_splitter_init(&splitter_hor, canvas_width - 3 * SPACING, SEPARATOR_HOR, splitter_hor.ratio);
+
+  char opt_outputfile[_MAX_PATH] = "";
+  char opt_coveragefile[_MAX_PATH] = "";
+  char opt_reportfile[_MAX_PATH] = "";
+  const char *opt_merge[16];
+  unsigned opt_mergecount = 0;
+  bool opt_coverage = false;
+  bool opt_report = false;
+  bool opt_headless = false;
+  bool opt_json = false;
+  double opt_duration = 10.0;
+  unsigned opt_topcount = 10;
+  for (int idx = 1; idx < argc; idx++) {
+    const char *ptr;
+    float h;
+    if (IS_OPTION(argv[idx])) {
+      switch (argv[idx][1]) {
+      case '?':
+      case 'h':
+        usage(NULL);
+        return EXIT_SUCCESS;
+      case 'a':
+        ptr = &argv[idx][2];
+        if (*ptr == '=' || *ptr == ':')
+          ptr++;
+        strlcpy(opt_coveragefile, ptr, sizearray(opt_coveragefile));
+        opt_coverage = true;
+        break;
+      case 'c':
+        ptr = &argv[idx][2];
+        if (*ptr == '=' || *ptr == ':')
+          ptr++;
+        strlcpy(opt_outputfile, ptr, sizearray(opt_outputfile));
+        opt_headless = true;
+        break;
+      case 'd':
+        ptr = &argv[idx][2];
+        if (*ptr == '=' || *ptr == ':')
+          ptr++;
+        opt_duration = strtod(ptr, NULL);
+        if (opt_duration < 0.1)
+          opt_duration = 10.0;
+        break;
+      case 'f':
+        ptr = &argv[idx][2];
+        if (*ptr == '=' || *ptr == ':')
+          ptr++;
+        h = (float)strtod(ptr, (char**)&ptr);
+        if (h >= 8.0)
+          opt_fontsize = h;
+        if (*ptr == ',') {
+          char *mono;
+          ptr++;
+          if ((mono = strchr(ptr, ',')) != NULL)
+            *mono++ = '\0';
+          if (*ptr != '\0')
+            strlcpy(opt_fontstd, ptr, sizearray(opt_fontstd));
+          if (mono != NULL && *mono == '\0')
+            strlcpy(opt_fontmono, mono, sizearray(opt_fontmono));
+        }
+        break;
+      case 'j':
+        opt_json = true;
+        break;
+      case 'm':
+        ptr = &argv[idx][2];
+        if (*ptr == '=' || *ptr == ':')
+          ptr++;
+        if (opt_mergecount < sizearray(opt_merge))
+          opt_merge[opt_mergecount++] = ptr;
+        break;
+      case 'n':
+        ptr = &argv[idx][2];
+        if (*ptr == '=' || *ptr == ':')
+          ptr++;
+        opt_topcount = (unsigned)strtoul(ptr, NULL, 10);
+        if (opt_topcount == 0)
+          opt_topcount = 10;
+        break;
+      case 'r':
+        ptr = &argv[idx][2];
+        if (*ptr == '=' || *ptr == ':')
+          ptr++;
+        strlcpy(opt_reportfile, ptr, sizearray(opt_reportfile));
+        opt_report = true;
+        break;
+      case 's':
+        ptr = &argv[idx][2];
+        if (*ptr == '=' || *ptr == ':')
+          ptr++;
+        if (appstate.fpStream != NULL)
+          fclose(appstate.fpStream);
+        appstate.fpStream = fopen(ptr, "at");
+        if (appstate.fpStream == NULL) {
+          fprintf(stderr, "Cannot open \"%s\" for streaming.\n", ptr);
+          return EXIT_FAILURE;
+        }
+        break;
+      case 'v':
+        version();
+        return EXIT_SUCCESS;
+      default:
+        usage(argv[idx]);
+        return EXIT_FAILURE;
+      }
+    } else {
+      /* filename on the command line must be in native format (using backslashes
+         on Windows) */
+      if (access(argv[idx], 0) == 0)
+        strlcpy(appstate.ELFfile, argv[idx], sizearray(appstate.ELFfile));
+    }
+  }
+  if (strlen(appstate.ELFfile) == 0) {
+    ini_gets("Session", "recent", "", appstate.ELFfile, sizearray(appstate.ELFfile), txtConfigFile);
+    if (access(appstate.ELFfile, 0) != 0)
+      appstate.ELFfile[0] = '\0';
+  }
+
+  /* if a target filename is known, create the parameter filename from target
+     filename and read target-specific options */
+  if (strlen(appstate.ELFfile) > 0) {
+    strlcpy(appstate.ParamFile, appstate.ELFfile, sizearray(appstate.ParamFile));
+    strlcat(appstate.ParamFile, ".bmcfg", sizearray(appstate.ParamFile));
+    load_targetoptions(appstate.ParamFile, &appstate);
+  }
+
+  /* coverage database: merge other databases first, so that the report covers
+     all of them */
+  if (opt_coverage || opt_mergecount > 0 || opt_report) {
+#   if defined _WIN32  /* fix console output on Windows */
+      if (!opt_headless && AttachConsole(ATTACH_PARENT_PROCESS)) {
+        freopen("CONOUT$", "wb", stdout);
+        freopen("CONOUT$", "wb", stderr);
+      }
+#   endif
+    if (strlen(opt_coveragefile) == 0 && strlen(appstate.ELFfile) > 0) {
+      strlcpy(opt_coveragefile, appstate.ELFfile, sizearray(opt_coveragefile));
+      strlcat(opt_coveragefile, ".bmcov", sizearray(opt_coveragefile));
+    }
+    if (strlen(opt_coveragefile) == 0) {
+      fprintf(stderr, "No coverage database given (and no ELF file).\n");
+      return EXIT_FAILURE;
+    }
+    for (unsigned idx = 0; idx < opt_mergecount; idx++)
+      if (!coverage_merge_file(opt_coveragefile, opt_merge[idx]))
+        return EXIT_FAILURE;
+    if (opt_coverage)
+      strlcpy(appstate.CoverageFile, opt_coveragefile, sizearray(appstate.CoverageFile));
+    if (!opt_headless && (opt_mergecount > 0 || opt_report)) {
+      int result = opt_report ? profile_coverage(&appstate, opt_coveragefile, opt_reportfile, opt_json) : EXIT_SUCCESS;
+      clear_functions(&appstate);
+      samplemap_delete(appstate.sample_map);
+      coverage_delete(appstate.coverage);
+      dwarf_cleanup(&dwarf_linetable, &dwarf_symboltable, &dwarf_filetable);
+      return result;
+    }
+  }
+
+  /* collect debug probes, initialize interface */
+  appstate.probelist = get_probelist(&appstate.probe, &appstate.netprobe);
+  tcpip_init();
+  bmp_setcallback(bmp_callback);
+
+  if (opt_headless) {
+    int result = profile_headless(&appstate, opt_outputfile, opt_duration, opt_topcount, opt_json);
+    clear_samples(&appstate); /* flush pending samples to the stream file */
+    coverage_store(&appstate);
+    headless_statusmsg();
+    if (opt_report && result == EXIT_SUCCESS)
+      result = profile_coverage(&appstate, opt_coveragefile, opt_reportfile, opt_json);
+    clear_functions(&appstate);
+    samplemap_delete(appstate.sample_map);
+    if (appstate.fpStream != NULL)
+      fclose(appstate.fpStream);
+    clear_probelist(appstate.probelist, appstate.netprobe);
+    if (appstate.monitor_cmds != NULL)
+      free((void*)appstate.monitor_cmds);
+    trace_close();
+    tracestring_clear();
+    bmscript_clear();
+    gdbrsp_packetsize(0);
+    dwarf_cleanup(&dwarf_linetable, &dwarf_symboltable, &dwarf_filetable);
+    bmp_disconnect();
+    tcpip_cleanup();
+    return result;
+  }
+
+  struct nk_context *ctx = guidriver_init("BlackMagic Profiler", canvas_width, canvas_height,
+                                          GUIDRV_RESIZEABLE | GUIDRV_TIMER,
+                                          opt_fontstd, opt_fontmono, opt_fontsize);
+  nuklear_style(ctx);
+
+  int waitidle = 1;
+  for ( ;; ) {
+    /* handle state */
+    handle_stateaction(&appstate);
+    handle_export(&appstate);
+
+    /* Input */
+    nk_input_begin(ctx);
+    if (!guidriver_poll(waitidle))
+      break;
+    nk_input_end(ctx);
+
+    /* other events */
+    int dev_event = guidriver_monitor_usb(0x1d50, 0x6018);
+    if (dev_event != 0) {
+      if (dev_event == DEVICE_REMOVE)
+        bmp_disconnect();
+      appstate.curstate = STATE_CONNECT; /* BMP was inserted or removed */
+    }
+
+    /* GUI */
+    guidriver_appsize(&canvas_width, &canvas_height);
+    if (nk_begin(ctx, "MainPanel", nk_rect(0, 0, canvas_width, canvas_height), NK_WINDOW_NO_SCROLLBAR)) {
+      nk_splitter_resize(&splitter_hor, canvas_width - 3 * SPACING, RESIZE_TOPLEFT);
+      nk_hsplitter_layout(ctx, &splitter_hor, canvas_height - 2 * SPACING);
+      ctx->style.window.padding.x = 2;
+      ctx->style.window.padding.y = 2;
+      ctx->style.window.group_padding.x = 0;
+      ctx->style.window.group_padding.y = 0;
+
+      /* left column */
+      if (nk_group_begin(ctx, "left", NK_WINDOW_NO_SCROLLBAR)) {
+        /* buttons */
+        button_bar(ctx, &appstate);
+
+        /* profile graph */
+        int events = traceprofile_process(appstate.curstate == STATE_RUNNING, appstate.sample_map,
+                                          &appstate.overflow);
+        profile_adaptrate(&appstate);
+        waitidle = (events == 0 && appstate.export_percent < 0);
+        /* if interval has passed, make copy of data for the graph */
+        double tstamp = get_timestamp();
+        if (tstamp - appstate.refresh_tstamp >= appstate.refreshrate && appstate.sample_map != NULL) {
+          appstate.refresh_tstamp = tstamp;
+          profile_stream(&appstate);
+          if (appstate.view == VIEW_TOP)
+            profile_graph_top(&appstate);
+          else
+            profile_graph_source(&appstate);
+          double freq = appstate.total_samples / (tstamp - appstate.capture_tstamp);
+          appstate.actual_freq = (appstate.actual_freq + (unsigned long)(freq + 0.5)) / 2;
+          if (appstate.curstate == STATE_RUNNING && !appstate.accumulate) {
+            clear_samples(&appstate);
+            appstate.capture_tstamp = tstamp;
+          }
+        }
+        nk_layout_row_dynamic(ctx, canvas_height - ROW_HEIGHT - 3 * SPACING, 1);
+        profile_graph(ctx, "graph", &appstate, opt_fontsize, NK_WINDOW_BORDER);
+
+        nk_group_end(ctx);
+      }
+
+      /* column splitter */
+      nk_hsplitter(ctx, &splitter_hor);
+
+      /* right column */
+      if (nk_group_begin(ctx, "right", NK_WINDOW_BORDER)) {
+        panel_options(ctx, &appstate, tab_states, nk_hsplitter_colwidth(&splitter_hor, 1));
+        panel_profile(ctx, &appstate, tab_states, nk_hsplitter_colwidth(&splitter_hor, 1));
+        panel_status(ctx, &appstate, tab_states, nk_hsplitter_colwidth(&splitter_hor, 1));
+        nk_group_end(ctx);
+      }
+
+      /* popup dialogs */
+      help_popup(ctx, &appstate, canvas_width, canvas_height);
+
+      /* mouse cursor shape */
+      if (nk_is_popup_open(ctx))
+        pointer_setstyle(CURSOR_NORMAL);
+      else if (splitter_hor.hover)
+        pointer_setstyle(CURSOR_LEFTRIGHT);
+#if defined __linux__
+      else
+        pointer_setstyle(CURSOR_NORMAL);
+#endif
+    }
+
+    nk_end(ctx);
+
+    /* Draw */
+    guidriver_render(COLOUR_BG0_S);
+  }
+
+  save_settings(txtConfigFile, &appstate, tab_states, &splitter_hor);
+  save_targetoptions(appstate.ParamFile, &appstate);
+  sprintf(valstr, "%d %d", canvas_width, canvas_height);
+  ini_puts("Settings", "size", valstr, txtConfigFile);
+  ini_puts("Session", "recent", appstate.ELFfile, txtConfigFile);
+  ini_cache_close(txtConfigFile);
+
+  export_wait();
+  clear_samples(&appstate); /* flush pending samples to the stream file */
+  coverage_store(&appstate);
+  clear_functions(&appstate);
+  samplemap_delete(appstate.sample_map);
+  if (appstate.fpStream != NULL)
+    fclose(appstate.fpStream);
+  clear_probelist(appstate.probelist, appstate.netprobe);
+  if (appstate.monitor_cmds != NULL)
+    free((void*)appstate.monitor_cmds);
+  trace_close();
+  guidriver_close();
+  tracestring_clear();
+  bmscript_clear();
+  gdbrsp_packetsize(0);
+  dwarf_cleanup(&dwarf_linetable, &dwarf_symboltable, &dwarf_filetable);
+  dwarf_unitcache_clear();
+  bmp_disconnect();
+  tcpip_cleanup();
+  return EXIT_SUCCESS;
+}
+
@@ -214,12 +214,7 @@ int main(int argc, char *argv[])
 
   /* if a serial number was passed, look it up */
   if (strlen(serial) > 0) {
-    TCHAR match[64];
-    int idx;
-    seqnr = -1;
-    for (idx = 0; seqnr == -1 && find_bmp(idx, BMP_IF_SERIAL, match, sizearray(match)); idx++)
-      if (stricmp(match, serial) == 0)
-        seqnr = idx;
+    seqnr = find_bmp_serial(serial);
     if (seqnr == -1) {
       printf("\nBlack Magic Probe with serial number %s is not found.\n", serial);
       return EXIT_FAILURE;
@@ -52,11 +52,14 @@
 #include <string.h>
 #include <time.h>
 
+#include "c11threads.h"
+#include "export.h"
 #include "guidriver.h"
 #include "minIni.h"
 #include "noc_file_dialog.h"
 #include "nuklear_guide.h"
 #include "nuklear_mousepointer.h"
+#include "nuklear_listview.h"
 #include "nuklear_splitter.h"
 #include "nuklear_style.h"
 #include "nuklear_tooltip.h"
@@ -155,61 +158,616 @@ static void version(void)
 #define DFLAG_LOCAL   0x01    /* this data block is local input (transmitted text) */
 #define DFLAG_SCRIPT  0x02    /* this data block is script output */
 #define DFLAG_APPEND  0x04    /* force append, because a script was waiting for the data */
+#define DFLAG_PAGED   0x08    /* this data block was read back from the capture file */
+
+#define DATA_CHUNK    128     /* allocation granularity for data blocks */
+#define RECV_BUFSIZE  16384   /* maximum number of bytes handled per frame */
+#define DATA_MAXBLOCK 512     /* maximum size of a data block (when appending) */
+
+#define FMT_TEXT      0       /* index of the cached formatting for the text view */
+#define FMT_HEX       1       /* index of the cached formatting for the hex view */
+#define FORMAT_BUDGET (4*1024*1024) /* formatted text above this size is dropped for blocks out of view */
+
+typedef struct tagFORMAT {
+  int param;                  /* wrap width or bytes per line that this format is for (0 = invalid) */
+  int numlines;               /* number of lines (also valid when the text is not cached) */
+  char *text;                 /* formatted lines, stored consecutively, each zero-terminated (or NULL) */
+  unsigned *lines;            /* offset of each line in the text buffer */
+  size_t textsize;            /* size of the text buffer */
+  struct tagFILTER **match;   /* matching highlight filter for each line (or NULL) */
+  unsigned matchgen;          /* filter generation that the "match" array is valid for */
+} FORMAT;
 
 typedef struct tagDATALIST {
   struct tagDATALIST *next;
   unsigned char *data;        /* raw data, as received */
   size_t datasize;
-  char **text;                /* reformatted data */
-  int textlines;              /* the number of (valid) lines in the text array */
-  int maxlines;               /* the maximum size of the text array */
-  unsigned long timestamp;    /* timestamp of reception (milliseconds) */
+  size_t datacapacity;        /* allocated size of the data buffer */
+  FORMAT format[2];           /* formatted data, for the text view and the hex view */
+  unsigned long shown;        /* frame number in which the block was last drawn */
+  unsigned long long timestamp; /* timestamp of reception (microseconds) */
   int flags;                  /* data flags */
+  bool captured;              /* block is in the capture file */
+  unsigned capgen;            /* generation of the capture file */
+  long capoffset;             /* position of the first record of the block in the file */
+  long caplength;             /* size of all records of the block in the file */
 } DATALIST;
 
 static DATALIST datalist_root = { NULL };
+static DATALIST *datalist_tail = &datalist_root;
+static int datalist_count = 0;
+static size_t format_bytes = 0; /* total size of formatted text of all blocks */
 static time_t reception_timestamp;
 
+/* Capture to file: all data blocks are streamed to a file by a background
+   writer thread, as records with a header (timestamp, size and flags) plus
+   the raw data. When the file exceeds the maximum size, it is renamed with
+   the extension ".1" (replacing the previous one), and a new file is started;
+   each file is a "generation". The GUI thread computes the file position of
+   each record when it queues it, so that it knows the location of every
+   block without waiting for the writer.
+   Blocks that drop out of the window (the line limit) are added to an index
+   with their location in the file. These blocks can be paged back in; the
+   blocks that were read back form a contiguous run at the front of the list
+   (flagged with DFLAG_PAGED), and they do not count for the line limit. */
+#define CAPTURE_FILEHDR   16      /* signature (8 bytes) + reception time (8 bytes) */
+#define CAPTURE_RECHDR    16      /* timestamp (8) + size (4) + flags (1) + new block (1) + reserved (2) */
+#define CAPTURE_WINDOW    10000   /* default window (in blocks) while capturing, if there is no line limit */
+#define CAPTURE_PAGE      1000    /* number of blocks that are paged in at a time */
+#define CAPTURE_MAXPAGED  (4 * CAPTURE_PAGE)
+#define CAPTURE_DEFSIZE   64      /* default maximum size of a capture file, in MiB */
+
+typedef struct tagCAPCHUNK {
+  struct tagCAPCHUNK *next;
+  unsigned generation;        /* file that the record goes into */
+  size_t size;                /* size of the data (excluding the header) */
+  unsigned char header[CAPTURE_RECHDR];
+  unsigned char data[];
+} CAPCHUNK;
+
+typedef struct tagCAPINDEX {
+  unsigned generation;        /* file that holds the block */
+  long offset;                /* position of the first record of the block */
+  long length;                /* size of all records of the block in the file */
+  size_t datasize;            /* size of the data of the block */
+  unsigned long long timestamp;
+  int flags;
+} CAPINDEX;
+
+static mtx_t capture_lock;                /* protects the queue & the writer status */
+static cnd_t capture_signal;
+static thrd_t capture_thread;
+static bool capture_active = false;       /* writer thread is running */
+static bool capture_quit = false;         /* request for the writer to stop (locked) */
+static CAPCHUNK *capture_head = NULL, *capture_qtail = NULL;  /* queue (locked) */
+static char capture_path[_MAX_PATH];
+static long capture_maxsize;              /* maximum size of a file, in bytes */
+static unsigned capture_generation = 0;   /* generation of the file for the next record (GUI side) */
+static long capture_size = 0;             /* size of that file, including queued records (GUI side) */
+static unsigned capture_filegen = 0;      /* generation of the open file (locked, writer side) */
+static long capture_written = 0;          /* bytes of that file that are flushed to disk (locked) */
+static bool capture_error = false;        /* file could not be created (locked) */
+static bool capture_startfail = false;    /* writer thread could not be started */
+static CAPINDEX *capindex = NULL;         /* index of the blocks that dropped out of the window */
+static unsigned capindex_count = 0, capindex_size = 0;
+static unsigned datalist_paged = 0;       /* number of blocks at the front of the list that were paged in */
+static unsigned page_first = 0;           /* index entry of the first paged block */
+static DATALIST *datalist_pagedtail = &datalist_root; /* last paged block (or the root if there are none) */
+
+/* format_release() frees the formatted text, but keeps the line count */
+static void format_release(FORMAT *fmt)
+{
+  assert(fmt != NULL);
+  if (fmt->text != NULL) {
+    assert(format_bytes >= fmt->textsize);
+    format_bytes -= fmt->textsize;
+    free((void*)fmt->text);
+    fmt->text = NULL;
+    fmt->textsize = 0;
+  }
+  if (fmt->lines != NULL) {
+    free((void*)fmt->lines);
+    fmt->lines = NULL;
+  }
+  if (fmt->match != NULL) {
+    free((void*)fmt->match);
+    fmt->match = NULL;
+  }
+}
+
 static void datalist_freeitem(DATALIST *item)
 {
   assert(item != NULL);
   assert(item->data != NULL);
   free((void*)item->data);
-  if (item->text != NULL) {
-    for (int idx = 0; idx < item->textlines; idx++)
-      free((void*)item->text[idx]);
-    free((void*)item->text);
-  }
+  for (int idx = 0; idx < sizearray(item->format); idx++)
+    format_release(&item->format[idx]);
   free((void*)item);
 }
 
+/* datalist_dropfirst() removes the oldest block from the list */
+static void datalist_dropfirst(void)
+{
+  DATALIST *item = datalist_root.next;
+  assert(item != NULL);
+  datalist_root.next = item->next;
+  if (datalist_tail == item)
+    datalist_tail = &datalist_root;
+  if (item->flags & DFLAG_PAGED) {
+    assert(datalist_paged > 0);
+    datalist_paged -= 1;
+    page_first += 1;
+    if (datalist_pagedtail == item)
+      datalist_pagedtail = &datalist_root;
+  }
+  datalist_count -= 1;
+  assert(datalist_count >= 0);
+  datalist_freeitem(item);
+}
+
 static void datalist_clear(void)
 {
-  while (datalist_root.next != NULL) {
-    DATALIST *item = datalist_root.next;
-    datalist_root.next = item->next;
+  while (datalist_root.next != NULL)
+    datalist_dropfirst();
+  assert(datalist_tail == &datalist_root && datalist_count == 0);
+  assert(datalist_paged == 0 && datalist_pagedtail == &datalist_root);
+  capindex_count = 0;
+  page_first = 0;
+}
+
+static void put_le(unsigned char *buffer, unsigned long long value, int size)
+{
+  for (int idx = 0; idx < size; idx++)
+    buffer[idx] = (unsigned char)(value >> 8 * idx);
+}
+
+static unsigned long long get_le(const unsigned char *buffer, int size)
+{
+  unsigned long long value = 0;
+  for (int idx = size - 1; idx >= 0; idx--)
+    value = (value << 8) | buffer[idx];
+  return value;
+}
+
+/* capture_filename() returns the name of the file of a generation; it fails
+   if that file was already deleted (the lock must be held) */
+static bool capture_filename(unsigned generation, char *path, size_t size)
+{
+  strlcpy(path, capture_path, size);
+  if (generation == capture_filegen)
+    return true;
+  if (generation + 1 == capture_filegen) {
+    strlcat(path, ".1", size);
+    return true;
+  }
+  return false;
+}
+
+static int capture_writer(void *arg)
+{
+  (void)arg;
+  FILE *fp = NULL;
+  bool firstfile = true;
+  for ( ;; ) {
+    mtx_lock(&capture_lock);
+    while (capture_head == NULL && !capture_quit)
+      cnd_wait(&capture_signal, &capture_lock);
+    CAPCHUNK *chunk = capture_head;
+    capture_head = capture_qtail = NULL;
+    bool quit = capture_quit;
+    mtx_unlock(&capture_lock);
+
+    while (chunk != NULL) {
+      if (firstfile || chunk->generation != capture_filegen) {
+        /* start a new file (rotate the files, except for the first) */
+        char oldpath[_MAX_PATH + 4];
+        strlcpy(oldpath, capture_path, sizearray(oldpath));
+        strlcat(oldpath, ".1", sizearray(oldpath));
+        mtx_lock(&capture_lock);
+        if (fp != NULL)
+          fclose(fp);
+        remove(oldpath);
+        if (!firstfile)
+          rename(capture_path, oldpath);
+        fp = fopen(capture_path, "wb");
+        if (fp != NULL) {
+          unsigned char header[CAPTURE_FILEHDR];
+          memcpy(header, "BMSCAP1", 8);
+          put_le(header + 8, (unsigned long long)reception_timestamp, 8);
+          fwrite(header, 1, sizeof header, fp);
+        }
+        capture_filegen = chunk->generation;
+        capture_written = CAPTURE_FILEHDR;
+        capture_error = (fp == NULL);
+        mtx_unlock(&capture_lock);
+        firstfile = false;
+      }
+      if (fp != NULL) {
+        fwrite(chunk->header, 1, CAPTURE_RECHDR, fp);
+        fwrite(chunk->data, 1, chunk->size, fp);
+      }
+      CAPCHUNK *next = chunk->next;
+      free((void*)chunk);
+      chunk = next;
+    }
+    if (fp != NULL) {
+      fflush(fp);
+      long pos = ftell(fp);
+      mtx_lock(&capture_lock);
+      capture_written = pos;
+      mtx_unlock(&capture_lock);
+    }
+    if (quit)
+      break;
+  }
+  if (fp != NULL)
+    fclose(fp);
+  return 0;
+}
+
+/* capture_start() starts streaming all received data to the file; the file
+   is overwritten */
+static bool capture_start(const char *path, long maxsize)
+{
+  assert(path != NULL && *path != '\0');
+  assert(!capture_active);
+  strlcpy(capture_path, path, sizearray(capture_path));
+  capture_maxsize = maxsize;
+  capture_generation = 0;
+  capture_size = CAPTURE_FILEHDR;
+  capture_filegen = 0;
+  capture_written = 0;
+  capture_error = false;
+  capture_quit = false;
+  capture_startfail = true; /* preset, cleared on success */
+  /* blocks that are already in the list are not in the file */
+  for (DATALIST *item = datalist_root.next; item != NULL; item = item->next)
+    item->captured = false;
+  if (mtx_init(&capture_lock, mtx_plain) != thrd_success)
+    return false;
+  if (cnd_init(&capture_signal) != thrd_success) {
+    mtx_destroy(&capture_lock);
+    return false;
+  }
+  if (thrd_create(&capture_thread, capture_writer, NULL) != thrd_success) {
+    cnd_destroy(&capture_signal);
+    mtx_destroy(&capture_lock);
+    return false;
+  }
+  capture_active = true;
+  capture_startfail = false;
+  return true;
+}
+
+/* capture_failed() returns whether capturing was requested, but it failed
+   to start or the file could not be created */
+static bool capture_failed(void)
+{
+  if (!capture_active)
+    return capture_startfail;
+  mtx_lock(&capture_lock);
+  bool result = capture_error;
+  mtx_unlock(&capture_lock);
+  return result;
+}
+
+/* capture_stop() flushes all queued data to the file and stops the writer;
+   the index is dropped, and blocks that were paged in become regular blocks */
+static void capture_stop(void)
+{
+  capture_startfail = false;
+  if (!capture_active)
+    return;
+  mtx_lock(&capture_lock);
+  capture_quit = true;
+  cnd_signal(&capture_signal);
+  mtx_unlock(&capture_lock);
+  thrd_join(capture_thread, NULL);
+  cnd_destroy(&capture_signal);
+  mtx_destroy(&capture_lock);
+  capture_active = false;
+
+  for (DATALIST *item = datalist_root.next; item != NULL; item = item->next)
+    item->flags &= ~DFLAG_PAGED;
+  datalist_paged = 0;
+  datalist_pagedtail = &datalist_root;
+  capindex_count = 0;
+  page_first = 0;
+}
+
+/* capture_trimindex() removes the index entries for the files that were
+   deleted on rotation (and any blocks paged in from those) */
+static void capture_trimindex(void)
+{
+  unsigned count = 0;
+  while (count < capindex_count && capindex[count].generation + 1 < capture_generation)
+    count++;
+  if (count == 0)
+    return;
+  while (datalist_paged > 0 && page_first < count)
+    datalist_dropfirst();   /* this also increments page_first */
+  memmove(capindex, capindex + count, (capindex_count - count) * sizeof(CAPINDEX));
+  capindex_count -= count;
+  page_first = (page_first >= count) ? page_first - count : 0;
+}
+
+/* capture_append() queues a piece of data of a block for the capture file */
+static void capture_append(DATALIST *item, const unsigned char *buffer, size_t size,
+                           unsigned long long tstamp, bool newblock)
+{
+  assert(item != NULL);
+  if (!capture_active)
+    return;
+  if (newblock) {
+    /* rotate the files only at the start of a block, so that a block never
+       spans two files */
+    if (capture_size > CAPTURE_FILEHDR && capture_size + CAPTURE_RECHDR + (long)size > capture_maxsize) {
+      capture_generation += 1;
+      capture_size = CAPTURE_FILEHDR;
+      capture_trimindex();
+    }
+    item->captured = true;
+    item->capgen = capture_generation;
+    item->capoffset = capture_size;
+    item->caplength = 0;
+  } else if (!item->captured || item->capgen != capture_generation) {
+    item->captured = false;
+    return; /* block started before capturing was turned on */
+  }
+
+  CAPCHUNK *chunk = malloc(sizeof(CAPCHUNK) + size);
+  if (chunk == NULL) {
+    item->captured = false; /* block is incomplete in the file */
+    return;
+  }
+  chunk->next = NULL;
+  chunk->generation = capture_generation;
+  chunk->size = size;
+  put_le(chunk->header, tstamp, 8);
+  put_le(chunk->header + 8, size, 4);
+  chunk->header[12] = (unsigned char)item->flags;
+  chunk->header[13] = newblock;
+  chunk->header[14] = chunk->header[15] = 0;
+  memcpy(chunk->data, buffer, size);
+  capture_size += CAPTURE_RECHDR + (long)size;
+  item->caplength += CAPTURE_RECHDR + (long)size;
+
+  mtx_lock(&capture_lock);
+  if (capture_qtail != NULL)
+    capture_qtail->next = chunk;
+  else
+    capture_head = chunk;
+  capture_qtail = chunk;
+  cnd_signal(&capture_signal);
+  mtx_unlock(&capture_lock);
+}
+
+/* capture_load() reads the blocks for a range of index entries from the
+   capture file(s), and returns them as a chain; it returns false if any
+   block could not be read */
+static bool capture_load(unsigned first, unsigned count, DATALIST **head, DATALIST **last)
+{
+  assert(first + count <= capindex_count);
+  assert(head != NULL && last != NULL);
+  *head = *last = NULL;
+  if (!capture_active)
+    return false;
+
+  bool result = true;
+  FILE *fp = NULL;
+  unsigned fpgen = 0;
+  mtx_lock(&capture_lock);  /* block rotation of the files while reading */
+  for (unsigned idx = 0; result && idx < count; idx++) {
+    const CAPINDEX *entry = &capindex[first + idx];
+    if (entry->generation == capture_filegen && entry->offset + entry->length > capture_written) {
+      result = false; /* not yet written */
+      break;
+    }
+    if (fp == NULL || entry->generation != fpgen) {
+      char path[_MAX_PATH + 4];
+      if (fp != NULL)
+        fclose(fp);
+      fp = NULL;
+      if (capture_filename(entry->generation, path, sizearray(path)))
+        fp = fopen(path, "rb");
+      fpgen = entry->generation;
+      if (fp == NULL) {
+        result = false;
+        break;
+      }
+    }
+    DATALIST *item = malloc(sizeof(DATALIST));
+    if (item == NULL) {
+      result = false;
+      break;
+    }
+    memset(item, 0, sizeof(DATALIST));
+    item->data = malloc((entry->datasize > 0 ? entry->datasize : 1) * sizeof(unsigned char));
+    if (item->data == NULL) {
+      free((void*)item);
+      result = false;
+      break;
+    }
+    item->datacapacity = entry->datasize;
+    item->timestamp = entry->timestamp;
+    item->flags = entry->flags | DFLAG_PAGED;
+    /* link it in now, so that it is freed on failure */
+    if (*last != NULL)
+      (*last)->next = item;
+    else
+      *head = item;
+    *last = item;
+    fseek(fp, entry->offset, SEEK_SET);
+    while (item->datasize < entry->datasize) {
+      unsigned char header[CAPTURE_RECHDR];
+      if (fread(header, 1, CAPTURE_RECHDR, fp) != CAPTURE_RECHDR) {
+        result = false;
+        break;
+      }
+      size_t size = (size_t)get_le(header + 8, 4);
+      if (header[13] != (item->datasize == 0) || size > entry->datasize - item->datasize
+          || fread(item->data + item->datasize, 1, size, fp) != size)
+      {
+        result = false;
+        break;
+      }
+      item->datasize += size;
+    }
+  }
+  mtx_unlock(&capture_lock);
+  if (fp != NULL)
+    fclose(fp);
+
+  if (!result) {
+    while (*head != NULL) {
+      DATALIST *item = *head;
+      *head = item->next;
+      datalist_freeitem(item);
+    }
+    *last = NULL;
+  }
+  return result;
+}
+
+/* capture_earlier() returns the number of blocks in the index, before the
+   first block in memory */
+static unsigned capture_earlier(void)
+{
+  return (datalist_paged > 0) ? page_first : capindex_count;
+}
+
+/* capture_gap() returns the number of blocks in the index between the blocks
+   that were paged in and the window */
+static unsigned capture_gap(void)
+{
+  return (datalist_paged > 0) ? capindex_count - (page_first + datalist_paged) : 0;
+}
+
+/* capture_page() pages in blocks before the first block in memory (if
+   "earlier" is true) or blocks in the gap between the paged blocks and the
+   window */
+static bool capture_page(bool earlier)
+{
+  unsigned first, count;
+  if (earlier) {
+    count = capture_earlier();
+    if (count > CAPTURE_PAGE)
+      count = CAPTURE_PAGE;
+    first = capture_earlier() - count;
+  } else {
+    first = page_first + datalist_paged;
+    count = capture_gap();
+    if (count > CAPTURE_PAGE)
+      count = CAPTURE_PAGE;
+  }
+  if (count == 0)
+    return false;
+  DATALIST *head, *last;
+  if (!capture_load(first, count, &head, &last))
+    return false;
+
+  if (earlier) {
+    last->next = datalist_root.next;
+    datalist_root.next = head;
+    if (datalist_paged == 0)
+      datalist_pagedtail = last;
+    page_first = first;
+  } else {
+    last->next = datalist_pagedtail->next;
+    datalist_pagedtail->next = head;
+    datalist_pagedtail = last;
+  }
+  if (datalist_tail == &datalist_root || datalist_tail->next != NULL)
+    datalist_tail = last;   /* list was empty, or the chain was added after the tail */
+  datalist_count += count;
+  datalist_paged += count;
+
+  /* limit the number of blocks paged in, by dropping those at the other end */
+  if (earlier) {
+    while (datalist_paged > CAPTURE_MAXPAGED) {
+      DATALIST *pred = &datalist_root;
+      while (pred->next != datalist_pagedtail)
+        pred = pred->next;
+      pred->next = datalist_pagedtail->next;
+      if (datalist_tail == datalist_pagedtail)
+        datalist_tail = pred;
+      datalist_freeitem(datalist_pagedtail);
+      datalist_pagedtail = pred;
+      datalist_paged -= 1;
+      datalist_count -= 1;
+    }
+  } else {
+    while (datalist_paged > CAPTURE_MAXPAGED)
+      datalist_dropfirst();
+  }
+  return true;
+}
+
+/* datalist_trim() drops the oldest blocks from the window, when there are
+   more than "limit" blocks in it; these blocks are added to the index if they
+   are in the capture file */
+static void datalist_trim(int limit)
+{
+  while (datalist_count - (int)datalist_paged > limit) {
+    DATALIST *item = datalist_pagedtail->next;
+    assert(item != NULL);
+    if (item->captured && item->capgen + 1 >= capture_generation) {
+      if (capindex_count >= capindex_size) {
+        unsigned newsize = (capindex_size > 0) ? 2 * capindex_size : 1024;
+        CAPINDEX *list = realloc(capindex, newsize * sizeof(CAPINDEX));
+        if (list != NULL) {
+          capindex = list;
+          capindex_size = newsize;
+        }
+      }
+      if (capindex_count < capindex_size) {
+        CAPINDEX *entry = &capindex[capindex_count++];
+        entry->generation = item->capgen;
+        entry->offset = item->capoffset;
+        entry->length = item->caplength;
+        entry->datasize = item->datasize;
+        entry->timestamp = item->timestamp;
+        entry->flags = item->flags & ~DFLAG_PAGED;
+        if (datalist_paged > 0 && page_first + datalist_paged + 1 == capindex_count) {
+          /* the paged blocks connect to the window, so this block joins
+             them (instead of being dropped) */
+          item->flags |= DFLAG_PAGED;
+          datalist_pagedtail = item;
+          datalist_paged += 1;
+          if (datalist_paged > CAPTURE_MAXPAGED)
+            datalist_dropfirst();
+          continue;
+        }
+      }
+    }
+    datalist_pagedtail->next = item->next;
+    if (datalist_tail == item)
+      datalist_tail = datalist_pagedtail;
+    datalist_count -= 1;
     datalist_freeitem(item);
   }
 }
 
-static DATALIST *datalist_append(const unsigned char *buffer, size_t size, bool isascii, int flags)
+/* datalist_append() adds data to the list; "tstamp" is the time of the
+   reception, in microseconds (see rs232_timestamp()) */
+static DATALIST *datalist_append(const unsigned char *buffer, size_t size, bool isascii, int flags,
+                                 unsigned long long tstamp)
 {
   assert(buffer != NULL && size > 0);
 
-  /* get the time (in milliseconds) of this reception */
-  unsigned long tstamp = timestamp();
-
   /* for the very first data block, also get the local time, and store it in
      the root block */
   if (datalist_root.next == NULL) {
     reception_timestamp = time(NULL);
     datalist_root.timestamp = tstamp;
   }
+  /* make the timestamp relative to the first block (a local echo may be
+     handled before data that was received earlier) */
+  tstamp = (tstamp > datalist_root.timestamp) ? tstamp - datalist_root.timestamp : 0;
 
   /* check whether the buffer should be appended to the previous one */
-  DATALIST *last = &datalist_root;
-  while (last->next != NULL)
-    last = last->next;
+  DATALIST *last = datalist_tail;
+  assert(last != NULL && last->next == NULL);
 
   bool append;
   if (flags & DFLAG_APPEND) {
@@ -217,7 +775,7 @@ static DATALIST *datalist_append(const unsigned char *buffer, size_t size, bool
   } else {
     /* never append a local echo, and obviously don't append if the list is empty,
        but also don't append *to* a local echo */
-    append = (flags == 0 && datalist_root.next != NULL && !datalist_root.next->flags == 0);
+    append = (flags == 0 && last != &datalist_root && last->flags == 0);
     if (append) {
       /* if there is significant delay between the reception of the two blocks,
          assume separate receptions; but "significant" is different for blocks
@@ -225,11 +783,11 @@ static DATALIST *datalist_append(const unsigned char *buffer, size_t size, bool
          text or that end at some other character */
       assert(last->datasize > 0);
       unsigned char final = last->data[last->datasize - 1];
-      unsigned long max_gap = (isascii && (final == '\r' || final == '\n')) ? 5 : 50;
-      if (tstamp - last->timestamp > max_gap)
+      unsigned long max_gap = (isascii && (final == '\r' || final == '\n')) ? 5000 : 50000;
+      if (tstamp > last->timestamp && tstamp - last->timestamp > max_gap)
         append = false;
     }
-    if (append && last->datasize + size > 512) {
+    if (append && last->datasize + size > DATA_MAXBLOCK) {
       /* when blocks grow too large, assume a separate reception */
       append = false;
     }
@@ -237,13 +795,27 @@ static DATALIST *datalist_append(const unsigned char *buffer, size_t size, bool
 
   DATALIST *item;
   if (append) {
-    unsigned char *newbuf = malloc((last->datasize + size) * sizeof(unsigned char));
-    if (newbuf != NULL) {
-      memcpy(newbuf, last->data, last->datasize);
-      memcpy(newbuf + last->datasize, buffer, size);
-      free((void*)last->data);
-      last->data = newbuf;
+    /* grow the buffer in chunks (doubling its size), so that most appends are
+       just a copy */
+    if (last->datasize + size > last->datacapacity) {
+      size_t newsize = last->datacapacity;
+      while (newsize < last->datasize + size)
+        newsize *= 2;
+      unsigned char *newbuf = realloc(last->data, newsize * sizeof(unsigned char));
+      if (newbuf != NULL) {
+        last->data = newbuf;
+        last->datacapacity = newsize;
+      }
+    }
+    if (last->datasize + size <= last->datacapacity) {
+      memcpy(last->data + last->datasize, buffer, size);
       last->datasize += size;
+      capture_append(last, buffer, size, tstamp, false);
+      /* the block must be formatted anew, for any view */
+      for (int idx = 0; idx < sizearray(last->format); idx++) {
+        format_release(&last->format[idx]);
+        last->format[idx].param = 0;
+      }
     }
     item = last;
   } else {
@@ -252,17 +824,21 @@ static DATALIST *datalist_append(const unsigned char *buffer, size_t size, bool
     if (item == NULL)
       return NULL;
     memset(item, 0, sizeof(DATALIST));
-    item->data = malloc(size * sizeof(unsigned char));
+    size_t capacity = ((size + DATA_CHUNK - 1) / DATA_CHUNK) * DATA_CHUNK;
+    item->data = malloc(capacity * sizeof(unsigned char));
     if (item->data == NULL) {
       free((void*)item);
       return NULL;
     }
     memcpy(item->data, buffer, size);
     item->datasize = size;
+    item->datacapacity = capacity;
     item->flags = flags;
-    item->timestamp = tstamp - datalist_root.timestamp;
-    assert(last != NULL && last->next == NULL);
+    item->timestamp = tstamp;
     last->next = item;
+    datalist_tail = item;
+    datalist_count += 1;
+    capture_append(item, buffer, size, item->timestamp, true);
   }
 
   return item;
@@ -276,6 +852,25 @@ typedef struct tagFILTER {
   nk_bool enabled;
 } FILTER;
 
+/* The enabled filters are compiled into an Aho-Corasick automaton, so that a
+   line is classified in a single pass, regardless of the number of filters.
+   The trie uses child/sibling links; "output" is the lowest index (in list
+   order) of a filter that ends at this node or at any node on its fail chain,
+   so that the first matching filter in the list wins (as before). */
+typedef struct tagACNODE {
+  int child;                  /* first child node (or 0 for none) */
+  int sibling;                /* next node with the same parent (or 0) */
+  int fail;                   /* longest proper suffix that is also in the trie */
+  int output;                 /* index of the matching filter, or -1 */
+  unsigned char ch;           /* character on the edge to this node */
+} ACNODE;
+
+static ACNODE *filter_nodes = NULL;
+static int filter_nodecount = 0;
+static FILTER **filter_table = NULL;  /* filter for each automaton output index */
+static unsigned filter_generation = 1;/* incremented on every change in the filter list */
+static unsigned filter_compiled = 0;  /* generation of the current automaton */
+
 static FILTER *filter_add(FILTER *root, char *text, struct nk_color colour, nk_bool enabled)
 {
   assert(root != NULL);
@@ -289,6 +884,7 @@ static FILTER *filter_add(FILTER *root, char *text, struct nk_color colour, nk_b
     while (last->next != NULL)
       last = last->next;
     last->next = flt;
+    filter_generation += 1;
   }
   return flt;
 }
@@ -305,6 +901,7 @@ static bool filter_delete(FILTER *root, FILTER *flt)
     return false;
   pred->next = flt->next;
   free((void*)flt);
+  filter_generation += 1;
   return true;
 }
 
@@ -316,18 +913,165 @@ static void filter_clear(FILTER *root)
     root->next = flt->next;
     free((void*)flt);
   }
+  filter_generation += 1;
+  if (filter_nodes != NULL) {
+    free((void*)filter_nodes);
+    filter_nodes = NULL;
+  }
+  if (filter_table != NULL) {
+    free((void*)filter_table);
+    filter_table = NULL;
+  }
+  filter_nodecount = 0;
+  filter_compiled = 0;
+}
+
+/* filter_nextstate() returns the node reached from "node" on character "ch",
+   following the fail links; the root is node 0 */
+static int filter_nextstate(int node, unsigned char ch)
+{
+  for ( ;; ) {
+    int child;
+    for (child = filter_nodes[node].child; child != 0 && filter_nodes[child].ch != ch; child = filter_nodes[child].sibling)
+      {}
+    if (child != 0)
+      return child;
+    if (node == 0)
+      return 0;
+    node = filter_nodes[node].fail;
+  }
+}
+
+/* filter_compile() builds the automaton for all enabled filters; it returns
+   false on a memory allocation failure */
+static bool filter_compile(FILTER *root)
+{
+  assert(root != NULL);
+  if (filter_nodes != NULL)
+    free((void*)filter_nodes);
+  if (filter_table != NULL)
+    free((void*)filter_table);
+  filter_nodes = NULL;
+  filter_table = NULL;
+  filter_nodecount = 0;
+  filter_compiled = 0;
+
+  /* upper bound for the number of nodes: all characters of all patterns */
+  int maxnodes = 1, count = 0;
+  for (FILTER *flt = root->next; flt != NULL; flt = flt->next) {
+    if (flt->enabled && flt->text[0] != '\0') {
+      maxnodes += strlen(flt->text);
+      count += 1;
+    }
+  }
+  filter_nodes = malloc(maxnodes * sizeof(ACNODE));
+  filter_table = malloc((count > 0 ? count : 1) * sizeof(FILTER*));
+  int *queue = malloc(maxnodes * sizeof(int));
+  if (filter_nodes == NULL || filter_table == NULL || queue == NULL) {
+    free((void*)filter_nodes);
+    free((void*)filter_table);
+    free((void*)queue);
+    filter_nodes = NULL;
+    filter_table = NULL;
+    return false;
+  }
+
+  /* build the trie */
+  memset(&filter_nodes[0], 0, sizeof(ACNODE));
+  filter_nodes[0].output = -1;
+  filter_nodecount = 1;
+  count = 0;
+  for (FILTER *flt = root->next; flt != NULL; flt = flt->next) {
+    if (!flt->enabled || flt->text[0] == '\0')
+      continue;
+    filter_table[count] = flt;
+    int node = 0;
+    for (const unsigned char *ptr = (const unsigned char*)flt->text; *ptr != '\0'; ptr++) {
+      int child;
+      for (child = filter_nodes[node].child; child != 0 && filter_nodes[child].ch != *ptr; child = filter_nodes[child].sibling)
+        {}
+      if (child == 0) {
+        assert(filter_nodecount < maxnodes);
+        child = filter_nodecount++;
+        filter_nodes[child].child = 0;
+        filter_nodes[child].sibling = filter_nodes[node].child;
+        filter_nodes[child].fail = 0;
+        filter_nodes[child].output = -1;
+        filter_nodes[child].ch = *ptr;
+        filter_nodes[node].child = child;
+      }
+      node = child;
+    }
+    if (filter_nodes[node].output < 0)
+      filter_nodes[node].output = count; /* a duplicate filter never wins */
+    count += 1;
+  }
+
+  /* set the fail links in breadth-first order (so that the fail node of a
+     parent is complete before its children are handled) */
+  int head = 0, tail = 0;
+  for (int child = filter_nodes[0].child; child != 0; child = filter_nodes[child].sibling)
+    queue[tail++] = child;
+  while (head < tail) {
+    int node = queue[head++];
+    for (int child = filter_nodes[node].child; child != 0; child = filter_nodes[child].sibling) {
+      int fail = filter_nextstate(filter_nodes[node].fail, filter_nodes[child].ch);
+      filter_nodes[child].fail = fail;
+      int output = filter_nodes[fail].output;
+      if (output >= 0 && (filter_nodes[child].output < 0 || output < filter_nodes[child].output))
+        filter_nodes[child].output = output;
+      queue[tail++] = child;
+    }
+  }
+  free((void*)queue);
+
+  filter_compiled = filter_generation;
+  return true;
 }
 
+/* filter_match() returns the first enabled filter (in list order) whose text
+   occurs in the string, or NULL if there is none */
 static FILTER *filter_match(FILTER *root, const char *string)
 {
   assert(root != NULL);
   assert(string != NULL);
-  if (strlen(string) == 0)
+  if (filter_compiled != filter_generation && !filter_compile(root))
     return NULL;
-  for (FILTER *flt = root->next; flt != NULL; flt = flt->next)
-    if (flt->enabled && flt->text[0] != '\0' && strstr(string, flt->text) != NULL)
-      return flt;
-  return NULL;
+  if (filter_nodes[0].child == 0)
+    return NULL;  /* no (enabled) filters */
+  int best = -1;
+  int node = 0;
+  for (const unsigned char *ptr = (const unsigned char*)string; *ptr != '\0'; ptr++) {
+    node = filter_nextstate(node, *ptr);
+    int output = filter_nodes[node].output;
+    if (output >= 0 && (best < 0 || output < best)) {
+      best = output;
+      if (best == 0)
+        break;    /* cannot get a better match than the first filter */
+    }
+  }
+  return (best >= 0) ? filter_table[best] : NULL;
+}
+
+/* filter_classify() makes sure that the matching filters for all lines in
+   the formatted data are up to date; it returns false on memory failure */
+static bool filter_classify(FILTER *root, FORMAT *fmt)
+{
+  assert(fmt != NULL && fmt->text != NULL);
+  if (fmt->match != NULL && fmt->matchgen == filter_generation)
+    return true;
+  if (fmt->match != NULL)
+    free((void*)fmt->match);
+  fmt->match = NULL;
+  if (fmt->numlines == 0)
+    return true;
+  fmt->match = malloc(fmt->numlines * sizeof(FILTER*));
+  if (fmt->match == NULL)
+    return false;
+  for (int lineidx = 0; lineidx < fmt->numlines; lineidx++)
+    fmt->match[lineidx] = filter_match(root, fmt->text + fmt->lines[lineidx]);
+  fmt->matchgen = filter_generation;
+  return true;
 }
 
 static struct nk_color filter_defcolour(FILTER *root)
@@ -377,6 +1121,8 @@ enum {
   TAB_TRANSMITOPTIONS,
   TAB_FILTERS,
   TAB_SCRIPT,
+  TAB_CAPTURE,
+  TAB_STATISTICS,
   /* --- */
   TAB_COUNT
 };
@@ -399,6 +1145,21 @@ enum {
   EOL_CRLF,
 };
 
+#define STATS_INTERVAL  1000000 /* interval for the reception statistics (microseconds) */
+
+typedef struct tagRECVSTATS {
+  unsigned long long start;     /**< start of the current interval */
+  unsigned long long lastread;  /**< timestamp of the most recent read (0 = none yet) */
+  unsigned long bytes;          /**< bytes received in the current interval */
+  unsigned long lines;          /**< lines received in the current interval */
+  unsigned long long gap;       /**< largest gap between two reads in the current interval */
+  double bytes_sec;             /**< bytes per second, over the previous interval */
+  double lines_sec;             /**< lines per second, over the previous interval */
+  unsigned long long maxgap;    /**< largest gap between two reads in the previous interval */
+  unsigned long long total;     /**< total bytes received since the reset */
+  unsigned long overruns;       /**< number of times that data was lost, since the reset */
+} RECVSTATS;
+
 typedef struct tagAPPSTATE {
   char **portlist;              /**< list of detected serial ports/devices */
   int numports;                 /**< number of ports in the list */
@@ -430,18 +1191,16 @@ typedef struct tagAPPSTATE {
   FILTER filter_root;           /**< highlight filters */
   FILTER filter_edit;           /**< the filter being edited */
   char scriptfile[_MAX_PATH];   /**< path of the script file */
-  time_t scriptfiletime;        /**< "modified" timestamp of the loaded file */
-  char *script;                 /**< script loaded in memory */
   bool script_reload;           /**< whether the script must be reloaded */
-  bool script_block_run;        /**< block running the script (because errors were found) */
-  bool script_cache;            /**< whether data from a previous reception must be kept */
-  unsigned char *script_recv;   /**< data buffer for the script */
-  size_t script_recv_length;    /**< size of the data in the data buffer */
-  size_t script_recv_size;      /**< size of the memory block for the data buffer */
-  struct tcl tcl;               /**< Tcl context (for running the script) */
-  bool tcl_running;             /**< whether a Tcl script is active */
   bool help_popup;              /**< whether "help" popup is active */
   int viewport_width;           /**< width of the viewport in characters (excluding the width of a timestamp field) */
+  nk_bool capture_enabled;      /**< stream received data to a file */
+  char capture_file[_MAX_PATH]; /**< path of the capture file */
+  char capture_maxsize[16];     /**< max. size of the capture file in MiB, edit field */
+  int capture_maxsize_val;      /**< copied from the edit buffer when the edit field looses focus */
+  bool capture_restart;         /**< whether capturing must be (re-)started with new settings */
+  RECVSTATS stats;              /**< reception statistics */
+  int export_percent;           /**< progress of a background save (-1 if none is busy) */
 } APPSTATE;
 
 static bool get_configfile(char *filename, size_t maxsize, const char *basename)
@@ -512,6 +1271,10 @@ static bool save_settings(const char *filename, const APPSTATE *state,
 
   ini_puts("Script", "file", state->scriptfile, filename);
 
+  ini_putl("Capture", "enabled", state->capture_enabled, filename);
+  ini_puts("Capture", "file", state->capture_file, filename);
+  ini_putl("Capture", "maxsize", state->capture_maxsize_val, filename);
+
   return access(filename, 0) == 0;
 }
 
@@ -586,51 +1349,192 @@ static bool load_settings(const char *filename, APPSTATE *state,
 
   ini_gets("Script", "file", "", state->scriptfile, sizearray(state->scriptfile), filename);
 
+  state->capture_enabled = (nk_bool)ini_getl("Capture", "enabled", nk_false, filename);
+  ini_gets("Capture", "file", "", state->capture_file, sizearray(state->capture_file), filename);
+  state->capture_maxsize_val = ini_getl("Capture", "maxsize", CAPTURE_DEFSIZE, filename);
+  if (state->capture_maxsize_val <= 0)
+    state->capture_maxsize_val = CAPTURE_DEFSIZE;
+  sprintf(state->capture_maxsize, "%d", state->capture_maxsize_val);
+
   return true;
 }
 
-static int process_data(APPSTATE *state);
 static void reformat_data(APPSTATE *state, DATALIST *item);
 
 static void tcl_add_message(APPSTATE *state, const char *text, size_t length, bool isascii)
 {
-  DATALIST *item = datalist_append((const unsigned char*)text, length, isascii, DFLAG_SCRIPT);
+  DATALIST *item = datalist_append((const unsigned char*)text, length, isascii, DFLAG_SCRIPT, rs232_timestamp());
   if (item != NULL)
     reformat_data(state, item); /* format the block of data */
 }
 
-static bool tcl_set_recv(APPSTATE *state, const unsigned char *data, size_t size)
+/* The Tcl script runs on a worker thread, with its own interpreter, so that a
+   slow script (or one that waits or runs an external program) does not stall
+   the reception and the display. Received data is passed to the worker in a
+   queue with a size limit (data is dropped for the script if the queue is
+   full, but it is still displayed and captured). Commands that affect the GUI
+   or the serial port ("puts" and "serial send") are posted back to the GUI
+   thread in an outbox. */
+#define SCRIPT_QUEUESIZE  (256 * 1024)  /* max. bytes of data waiting for the script */
+
+#define SMSG_PUTS   0   /* text to add to the viewport */
+#define SMSG_SEND   1   /* data to transmit on the serial port */
+
+typedef struct tagSCRIPTCHUNK {
+  struct tagSCRIPTCHUNK *next;
+  int type;                     /* SMSG_xxx (only for messages in the outbox) */
+  size_t size;
+  unsigned char data[];
+} SCRIPTCHUNK;
+
+typedef struct tagSCRIPTCTX {   /* state owned by the worker thread */
+  struct tcl tcl;               /* Tcl context (for running the script) */
+  char scriptfile[_MAX_PATH];   /* path of the script file */
+  time_t scriptfiletime;        /* "modified" timestamp of the loaded file */
+  char *script;                 /* script loaded in memory */
+  bool script_block_run;        /* block running the script (because errors were found) */
+  bool script_cache;            /* whether data from a previous reception must be kept */
+  unsigned char *script_recv;   /* data buffer for the script */
+  size_t script_recv_length;    /* size of the data in the data buffer */
+  size_t script_recv_size;      /* size of the memory block for the data buffer */
+} SCRIPTCTX;
+
+static SCRIPTCTX script_ctx;
+static mtx_t script_lock;               /* protects all variables below */
+static cnd_t script_signal;
+static thrd_t script_thread;
+static bool script_active = false;      /* worker thread is running (not locked) */
+static bool script_quit = false;
+static bool script_reload = false;      /* script file must be (re-)loaded */
+static char script_path[_MAX_PATH];     /* script file set by the GUI */
+static bool script_waiting = false;     /* the script is in "wait serialrecv" */
+static SCRIPTCHUNK *script_inhead = NULL, *script_intail = NULL;   /* received data */
+static size_t script_inqueued = 0;      /* total size of the data in the queue */
+static bool script_overflow = false;    /* data was dropped since the last message */
+static SCRIPTCHUNK *script_outhead = NULL, *script_outtail = NULL; /* outbox */
+
+static void chunklist_free(SCRIPTCHUNK **head, SCRIPTCHUNK **tail)
 {
-  assert(state != NULL);
+  while (*head != NULL) {
+    SCRIPTCHUNK *chunk = *head;
+    *head = chunk->next;
+    free((void*)chunk);
+  }
+  *tail = NULL;
+}
+
+/* script_post() adds a message to the outbox, for the GUI thread */
+static void script_post(int type, const void *data, size_t size)
+{
+  SCRIPTCHUNK *chunk = malloc(sizeof(SCRIPTCHUNK) + size);
+  if (chunk == NULL)
+    return;
+  chunk->next = NULL;
+  chunk->type = type;
+  chunk->size = size;
+  memcpy(chunk->data, data, size);
+  mtx_lock(&script_lock);
+  if (script_outtail != NULL)
+    script_outtail->next = chunk;
+  else
+    script_outhead = chunk;
+  script_outtail = chunk;
+  mtx_unlock(&script_lock);
+  guidriver_wake();
+}
+
+static void script_message(const char *text)
+{
+  script_post(SMSG_PUTS, text, strlen(text));
+}
+
+/* script_sleep() waits for a number of milliseconds, or until the worker
+   must quit; it returns false in the latter case */
+static bool script_sleep(unsigned long ms)
+{
+  struct timespec ts;
+  timespec_get(&ts, TIME_UTC);
+  ts.tv_sec += ms / 1000;
+  ts.tv_nsec += (ms % 1000) * 1000000L;
+  if (ts.tv_nsec >= 1000000000L) {
+    ts.tv_sec += 1;
+    ts.tv_nsec -= 1000000000L;
+  }
+  mtx_lock(&script_lock);
+  while (!script_quit && cnd_timedwait(&script_signal, &script_lock, &ts) != thrd_timedout)
+    {}
+  bool quit = script_quit;
+  mtx_unlock(&script_lock);
+  return !quit;
+}
+
+/* script_get() takes the oldest block of received data from the queue; it
+   waits for at most "timeout_ms" milliseconds (ULONG_MAX = forever) and it
+   returns NULL on a time-out or when the worker must quit */
+static SCRIPTCHUNK *script_get(unsigned long timeout_ms)
+{
+  struct timespec ts;
+  if (timeout_ms != ULONG_MAX) {
+    timespec_get(&ts, TIME_UTC);
+    ts.tv_sec += timeout_ms / 1000;
+    ts.tv_nsec += (timeout_ms % 1000) * 1000000L;
+    if (ts.tv_nsec >= 1000000000L) {
+      ts.tv_sec += 1;
+      ts.tv_nsec -= 1000000000L;
+    }
+  }
+  mtx_lock(&script_lock);
+  while (script_inhead == NULL && !script_quit) {
+    if (timeout_ms == ULONG_MAX)
+      cnd_wait(&script_signal, &script_lock);
+    else if (cnd_timedwait(&script_signal, &script_lock, &ts) == thrd_timedout)
+      break;
+  }
+  SCRIPTCHUNK *chunk = NULL;
+  if (!script_quit && script_inhead != NULL) {
+    chunk = script_inhead;
+    script_inhead = chunk->next;
+    if (script_inhead == NULL)
+      script_intail = NULL;
+    assert(script_inqueued >= chunk->size);
+    script_inqueued -= chunk->size;
+  }
+  mtx_unlock(&script_lock);
+  return chunk;
+}
+
+static bool tcl_set_recv(SCRIPTCTX *ctx, const unsigned char *data, size_t size)
+{
+  assert(ctx != NULL);
   assert(data != NULL || size == 0);
   /* grow the buffer, if needed */
-  size_t total = state->script_recv_length + size;
-  if (total > state->script_recv_size) {
-    size_t newsize = state->script_recv_size;
+  size_t total = ctx->script_recv_length + size;
+  if (total > ctx->script_recv_size) {
+    size_t newsize = ctx->script_recv_size;
     if (newsize < 16)
       newsize = 16;
     while (total > newsize)
       newsize *= 2;
     unsigned char *buffer = malloc(newsize * sizeof(unsigned char));
     if (buffer != NULL) {
-      if (state->script_recv_length > 0) {
-        assert(state->script_recv != NULL);
-        memcpy(buffer, state->script_recv, state->script_recv_length);
+      if (ctx->script_recv_length > 0) {
+        assert(ctx->script_recv != NULL);
+        memcpy(buffer, ctx->script_recv, ctx->script_recv_length);
       }
-      if (state->script_recv != NULL)
-        free((void*)state->script_recv);
-      state->script_recv = buffer;
-      state->script_recv_size = newsize;
+      if (ctx->script_recv != NULL)
+        free((void*)ctx->script_recv);
+      ctx->script_recv = buffer;
+      ctx->script_recv_size = newsize;
     }
   }
   /* concatenate the data to the buffer (if there is new data) */
-  if (total <= state->script_recv_size && size > 0) {
-    memcpy(state->script_recv + state->script_recv_length, data, size);
-    state->script_recv_length = total;
+  if (total <= ctx->script_recv_size && size > 0) {
+    memcpy(ctx->script_recv + ctx->script_recv_length, data, size);
+    ctx->script_recv_length = total;
   }
-  if (state->script_recv == NULL)
+  if (ctx->script_recv == NULL)
     return false;
-  tcl_var(&state->tcl, "serialrecv", tcl_value((const char*)state->script_recv, state->script_recv_length));
+  tcl_var(&ctx->tcl, "serialrecv", tcl_value((const char*)ctx->script_recv, ctx->script_recv_length));
   return true;
 }
 
@@ -645,90 +1549,82 @@ static int tcl_cmd_exec(struct tcl *tcl, struct tcl_value *args, void *arg)
 
 static int tcl_cmd_puts(struct tcl *tcl, struct tcl_value *args, void *arg)
 {
-  APPSTATE *state = (APPSTATE*)arg;
-  assert(state != NULL);
+  (void)arg;
   struct tcl_value *text = tcl_list_item(args, 1);
-  tcl_add_message(state, tcl_data(text), tcl_length(text), false);
+  script_post(SMSG_PUTS, tcl_data(text), tcl_length(text));
   return tcl_result(tcl, true, text);
 }
 
 static int tcl_cmd_wait(struct tcl *tcl, struct tcl_value *args, void *arg)
 {
-  APPSTATE *state = (APPSTATE*)arg;
-  assert(state != NULL);
-  assert(tcl == &state->tcl);
+  SCRIPTCTX *ctx = (SCRIPTCTX*)arg;
+  assert(ctx != NULL);
+  assert(tcl == &ctx->tcl);
   int nargs = tcl_list_length(args);
   struct tcl_value *arg1 = tcl_list_item(args, 1);
   struct tcl_value *arg2 = (nargs >= 3) ? tcl_list_item(args, 2) : NULL;
   bool timeout = false;
+  bool abort = false;
   int body_arg = (nargs == 4 && tcl_isnumber(arg2)) ? 3 : 0;  /* common case, may be overruled */
   if (tcl_isnumber(arg1)) {
     /* scenario 1: wait <timeout> [body] -> simply delay */
-#   if defined _WIN32
-      Sleep((int)tcl_number(arg1));
-#   else
-      usleep((int)tcl_number(arg1));
-#   endif
+    abort = !script_sleep((unsigned long)tcl_number(arg1));
     timeout = true;
     body_arg = (nargs == 3) ? 2 : 0;
   } else if (strcmp(tcl_data(arg1), "serialrecv") != 0) {
     /* scenario 2: wait <var> [timeout] [body]  where var is not "serialrecv" -> the
                    variable will never change, so always timeout -> simply delay */
-    if (tcl_isnumber(arg2)) {
-#     if defined _WIN32
-        Sleep((int)tcl_number(arg2));
-#     else
-        usleep((int)tcl_number(arg2) * 1000);
-#     endif
-    }
+    if (tcl_isnumber(arg2))
+      abort = !script_sleep((unsigned long)tcl_number(arg2));
     timeout = true;
   } else {
     /* scenario 3: wait serialrecv [timeout] [body] */
     unsigned long timeout_ms = ULONG_MAX;
     if (nargs >= 3 && tcl_isnumber(arg2))
       timeout_ms = tcl_number(arg2);
-    state->tcl_running = true;
-    unsigned long tstamp_start = timestamp();
-    while (!timeout) {
-#     if defined _WIN32
-        Sleep(10);
-#     else
-        usleep(10 * 1000);
-#     endif
-      int count = process_data(state);
-      if (count > 0)
-        break;  /* the "serialrecv" variable is adjusted inside process_data() */
-      unsigned long tstamp = timestamp();
-      timeout = (tstamp - tstamp_start >= timeout_ms) ;
+    mtx_lock(&script_lock);
+    script_waiting = true;
+    mtx_unlock(&script_lock);
+    SCRIPTCHUNK *chunk = script_get(timeout_ms);
+    if (chunk != NULL) {
+      tcl_set_recv(ctx, chunk->data, chunk->size);
+      free((void*)chunk);
+    } else {
+      timeout = true;
     }
+    mtx_lock(&script_lock);
+    script_waiting = false;
+    abort = script_quit;
+    mtx_unlock(&script_lock);
   }
   tcl_free(arg1);
   if (arg2 != NULL)
     tcl_free(arg2);
-  /* check whether to run the block on timeout */
+  /* check whether to run the block on timeout (but when the worker must quit,
+     return an error, to abort the script) */
   long result;
-  if (timeout && body_arg > 0) {
+  if (abort) {
+    result = tcl_result(tcl, false, tcl_value("", 0));
+  } else if (timeout && body_arg > 0) {
     struct tcl_value *body = tcl_list_item(args, body_arg);
     result = tcl_eval(tcl, tcl_data(body), tcl_length(body) + 1);
     tcl_free(body);
   } else {
     result = tcl_result(tcl, true, tcl_value(timeout ? "0" : "1", 1));
   }
-  state->tcl_running = false;
   return result;
 }
 
 static int tcl_cmd_serial(struct tcl *tcl, struct tcl_value *args, void *arg)
 {
-  (void)arg;
-  APPSTATE *state = (APPSTATE*)arg;
-  assert(state);
+  SCRIPTCTX *ctx = (SCRIPTCTX*)arg;
+  assert(ctx != NULL);
   int nargs = tcl_list_length(args);
   struct tcl_value *subcmd = tcl_list_item(args, 1);
   if (strcmp(tcl_data(subcmd), "cache") == 0 || strcmp(tcl_data(subcmd), "gobble") == 0) {
     int gobble = INT_MAX; /* default for "serial gobble" is: gobble everything */
     if (strcmp(tcl_data(subcmd), "cache") == 0) {
-      state->script_cache = true;
+      ctx->script_cache = true;
       gobble = 0;         /* default for "serial cache" is: keep everything, gobble nothing */
     }
     if (nargs >= 3) {
@@ -736,302 +1632,691 @@ static int tcl_cmd_serial(struct tcl *tcl, struct tcl_value *args, void *arg)
       gobble = tcl_number(v_gobble);
       tcl_free(v_gobble);
     }
-    if (gobble > 0 && gobble < state->script_recv_length) {
-      state->script_recv_length -= gobble;
-      memmove(state->script_recv, state->script_recv + gobble, state->script_recv_length);
+    if (gobble > 0 && gobble < ctx->script_recv_length) {
+      ctx->script_recv_length -= gobble;
+      memmove(ctx->script_recv, ctx->script_recv + gobble, ctx->script_recv_length);
     } else if (gobble != 0) {
-      state->script_recv_length = 0;  /* gobble more than there is data -> nothing left */
+      ctx->script_recv_length = 0;  /* gobble more than there is data -> nothing left */
     }
     if (gobble != 0)
-      tcl_var(&state->tcl, "serialrecv", tcl_value((const char*)state->script_recv, state->script_recv_length));
+      tcl_var(&ctx->tcl, "serialrecv", tcl_value((const char*)ctx->script_recv, ctx->script_recv_length));
   } else if (strcmp(tcl_data(subcmd), "send") == 0) {
-    if (nargs >= 3 && rs232_isopen(state->hCom)) {
-      struct tcl_value *data = tcl_list_item(args, 1);
-      rs232_xmit(state->hCom, (const unsigned char*)tcl_data(data), tcl_length(data));
+    if (nargs >= 3) {
+      struct tcl_value *data = tcl_list_item(args, 2);
+      script_post(SMSG_SEND, tcl_data(data), tcl_length(data));
       tcl_free(data);
     }
   }
-  tcl_free(subcmd);
-  return tcl_result(tcl, 1, tcl_value("", 0));
+  tcl_free(subcmd);
+  return tcl_result(tcl, 1, tcl_value("", 0));
+}
+
+static void tcl_setup(SCRIPTCTX *ctx)
+{
+  assert(ctx != NULL);
+  tcl_init(&ctx->tcl);
+  tcl_register(&ctx->tcl, "exec", tcl_cmd_exec, 2, 2, ctx);
+  tcl_register(&ctx->tcl, "puts", tcl_cmd_puts, 2, 2, ctx);
+  tcl_register(&ctx->tcl, "serial", tcl_cmd_serial, 2, 3, ctx);
+  tcl_register(&ctx->tcl, "wait", tcl_cmd_wait, 2, 4, ctx);
+}
+
+static bool tcl_runscript(SCRIPTCTX *ctx, const unsigned char *data, size_t size, bool reload)
+{
+  /* (re-)load the script file */
+  assert(ctx != NULL);
+  /* check whether the file date/time changes; if so, also reload the script */
+  if (ctx->script != NULL && strlen(ctx->scriptfile) > 0) {
+    struct stat fstat;
+    if (stat(ctx->scriptfile, &fstat) == 0 && ctx->scriptfiletime != fstat.st_mtime) {
+      ctx->scriptfiletime =fstat.st_mtime;
+      reload = true;
+    }
+  }
+  if (reload) {
+    ctx->script_block_run = false;
+    if (ctx->script != NULL) {
+      free((void*)ctx->script);
+      ctx->script = NULL;
+      /* start with a fresh interpreter, because it may refer to the old script */
+      tcl_destroy(&ctx->tcl);
+      tcl_setup(ctx);
+    }
+    if (strlen(ctx->scriptfile) == 0)
+      return false;
+    FILE *fp = fopen(ctx->scriptfile, "rt");
+    if (fp == NULL) {
+      script_message("Tcl script file not found.");
+      return false;
+    }
+    fseek(fp, 0, SEEK_END);
+    size_t sz = ftell(fp) + 2;
+    ctx->script = malloc((sz)*sizeof(char));
+    if (ctx->script == NULL) {
+      script_message("Memory allocation failure (when loading Tcl script).");
+      fclose(fp);
+      return false;
+    }
+    fseek(fp, 0, SEEK_SET);
+    memset(ctx->script, 0, sz);
+    char *line = ctx->script;
+    while (fgets(line, sz, fp) != NULL)
+      line += strlen(line);
+    assert(line - ctx->script < sz);
+    fclose(fp);
+  }
+  if (ctx->script == NULL || ctx->script_block_run)
+    return false;
+  if (!tcl_set_recv(ctx, data, size))
+    return false;
+  /* now run it */
+  ctx->script_cache = false;
+  bool ok = tcl_eval(&ctx->tcl, ctx->script, strlen(ctx->script) + 1);
+  if (!ok) {
+    int line;
+    char symbol[64];
+    const char *err = tcl_errorinfo(&ctx->tcl, NULL, &line, symbol, sizearray(symbol));
+    char msg[256];
+    sprintf(msg, "Tcl script error: %s, on or after line %d", err, line);
+    if (strlen(symbol) > 0)
+      sprintf(msg + strlen(msg), ": %s", symbol);
+    script_message(msg);
+    ctx->script_block_run = true; /* block the script from running, until it is reloaded */
+  }
+  /* if data was marked to be cached, leave it in the buffer; otherwise, free it
+     (and always delete a buffer if every data has been gobbled) */
+  if ((!ctx->script_cache || ctx->script_recv_length == 0) && ctx->script_recv != NULL) {
+    free((void*)ctx->script_recv);
+    ctx->script_recv = NULL;
+    ctx->script_recv_length = 0;
+    ctx->script_recv_size = 0;
+    ctx->script_cache = false;
+  }
+  return ok;
+}
+
+static int script_worker(void *arg)
+{
+  SCRIPTCTX *ctx = (SCRIPTCTX*)arg;
+  tcl_setup(ctx);
+
+  SCRIPTCHUNK *chunk;
+  while ((chunk = script_get(ULONG_MAX)) != NULL) {
+    mtx_lock(&script_lock);
+    bool reload = script_reload;
+    script_reload = false;
+    if (reload)
+      strlcpy(ctx->scriptfile, script_path, sizearray(ctx->scriptfile));
+    bool overflow = script_overflow;
+    script_overflow = false;
+    mtx_unlock(&script_lock);
+    if (overflow)
+      script_message("Tcl script cannot keep up, received data was dropped for the script.");
+    tcl_runscript(ctx, chunk->data, chunk->size, reload);
+    free((void*)chunk);
+  }
+
+  tcl_destroy(&ctx->tcl);
+  if (ctx->script != NULL)
+    free((void*)ctx->script);
+  if (ctx->script_recv != NULL)
+    free((void*)ctx->script_recv);
+  memset(ctx, 0, sizeof(SCRIPTCTX));
+  return 0;
+}
+
+/* script_start() launches the worker thread for the Tcl script */
+static bool script_start(void)
+{
+  assert(!script_active);
+  memset(&script_ctx, 0, sizeof(SCRIPTCTX));
+  script_quit = false;
+  if (mtx_init(&script_lock, mtx_plain) != thrd_success)
+    return false;
+  if (cnd_init(&script_signal) != thrd_success) {
+    mtx_destroy(&script_lock);
+    return false;
+  }
+  if (thrd_create(&script_thread, script_worker, &script_ctx) != thrd_success) {
+    cnd_destroy(&script_signal);
+    mtx_destroy(&script_lock);
+    return false;
+  }
+  script_active = true;
+  return true;
+}
+
+/* script_stop() aborts a script that is waiting and stops the worker; a
+   script that runs an external program is only stopped when that program
+   finishes */
+static void script_stop(void)
+{
+  if (!script_active)
+    return;
+  mtx_lock(&script_lock);
+  script_quit = true;
+  cnd_broadcast(&script_signal);
+  mtx_unlock(&script_lock);
+  thrd_join(script_thread, NULL);
+  chunklist_free(&script_inhead, &script_intail);
+  chunklist_free(&script_outhead, &script_outtail);
+  script_inqueued = 0;
+  cnd_destroy(&script_signal);
+  mtx_destroy(&script_lock);
+  script_active = false;
+}
+
+/* script_setfile() sets the script file and forces a reload (this takes
+   effect on the next reception) */
+static void script_setfile(const char *path)
+{
+  assert(path != NULL);
+  if (!script_active)
+    return;
+  mtx_lock(&script_lock);
+  strlcpy(script_path, path, sizearray(script_path));
+  script_reload = true;
+  mtx_unlock(&script_lock);
+}
+
+/* script_feed() passes received data to the script */
+static void script_feed(const unsigned char *data, size_t size)
+{
+  if (!script_active || size == 0)
+    return;
+  mtx_lock(&script_lock);
+  if (script_inqueued + size > SCRIPT_QUEUESIZE) {
+    script_overflow = true;
+  } else {
+    SCRIPTCHUNK *chunk = malloc(sizeof(SCRIPTCHUNK) + size);
+    if (chunk != NULL) {
+      chunk->next = NULL;
+      chunk->type = 0;
+      chunk->size = size;
+      memcpy(chunk->data, data, size);
+      if (script_intail != NULL)
+        script_intail->next = chunk;
+      else
+        script_inhead = chunk;
+      script_intail = chunk;
+      script_inqueued += size;
+      cnd_signal(&script_signal);
+    }
+  }
+  mtx_unlock(&script_lock);
+}
+
+/* script_iswaiting() returns whether the script is waiting for new data */
+static bool script_iswaiting(void)
+{
+  if (!script_active)
+    return false;
+  mtx_lock(&script_lock);
+  bool result = script_waiting;
+  mtx_unlock(&script_lock);
+  return result;
+}
+
+/* script_poll() handles the messages that the script posted for the GUI;
+   it returns the number of messages handled */
+static int script_poll(APPSTATE *state)
+{
+  assert(state != NULL);
+  if (!script_active)
+    return 0;
+  mtx_lock(&script_lock);
+  SCRIPTCHUNK *chunk = script_outhead;
+  script_outhead = script_outtail = NULL;
+  mtx_unlock(&script_lock);
+
+  int count = 0;
+  while (chunk != NULL) {
+    if (chunk->type == SMSG_PUTS)
+      tcl_add_message(state, (const char*)chunk->data, chunk->size, false);
+    else if (chunk->type == SMSG_SEND && rs232_isopen(state->hCom))
+      rs232_xmit(state->hCom, chunk->data, chunk->size);
+    SCRIPTCHUNK *next = chunk->next;
+    free((void*)chunk);
+    chunk = next;
+    count++;
+  }
+  return count;
+}
+
+static char *format_time(char *buffer, size_t size, unsigned long long timestamp, time_t basetime, int format)
+{
+  assert(format == TIMESTAMP_RELATIVE || TIMESTAMP_ABSOLUTE);
+  assert(buffer != NULL);
+  assert(size >= 20);
+  if (format == TIMESTAMP_RELATIVE) {
+    sprintf(buffer, "%13.6f", timestamp / 1000000.0);
+  } else {
+    time_t tstamp = basetime + (time_t)((timestamp + 500000) / 1000000);
+    struct tm tm;   /* thread-safe variant of localtime(), for save_data() */
+#   if defined _WIN32
+      localtime_s(&tm, &tstamp);
+#   else
+      localtime_r(&tstamp, &tm);
+#   endif
+    strftime(buffer, size, "%Y-%m-%d %H:%M:%S", &tm);
+  }
+  return buffer;
+}
+
+/* format_index() returns the index of the formatting that applies to the
+   data block in the current view; script output is always shown as text */
+static int format_index(const APPSTATE *state, const DATALIST *item)
+{
+  assert(state != NULL);
+  assert(item != NULL);
+  return (state->view == VIEW_TEXT || (item->flags & DFLAG_SCRIPT)) ? FMT_TEXT : FMT_HEX;
+}
+
+/* format_param() returns the wrap width (for text) or the number of bytes per
+   line (for a hex dump) */
+static int format_param(const APPSTATE *state, int index)
+{
+  assert(state != NULL);
+  if (index == FMT_HEX) {
+    assert(state->bytesperline_val > 0);
+    return state->bytesperline_val;
+  }
+  return (state->wordwrap && state->viewport_width > 0) ? state->viewport_width : INT_MAX;
+}
+
+/* text_nextline() returns the start of the line that follows the line at
+   "start", when splitting lines on EOL characters and word-wrapping at
+   "maxchars" */
+static int text_nextline(const DATALIST *item, int start, int maxchars)
+{
+  assert(item != NULL);
+  assert(start < item->datasize);
+  int stop = start;
+  while (stop < item->datasize && (stop - start) < maxchars
+         && item->data[stop] != '\r' && item->data[stop] != '\n')
+    stop++;
+  if (stop + 1 < item->datasize && item->data[stop] == '\r' && item->data[stop + 1] == '\n') {
+    stop += 2;  /* skip \r\n */
+  } else if (stop < item->datasize && (item->data[stop] == '\r' || item->data[stop] == '\n')) {
+    stop += 1;  /* skip either \r or \n */
+  } else if (stop - start >= maxchars) {
+    if (stop < item->datasize && item->data[stop] == ' ') {
+      stop += 1;  /* gobble up one space at the end of a line */
+    } else {
+      int pos = stop;
+      while (pos > start && item->data[pos - 1] > ' ')
+        pos -= 1;
+      if (pos > start)
+        stop = pos;
+    }
+  }
+  assert(stop > start);
+  return stop;
+}
+
+/* text_convert() converts a line to UTF-8 and returns its length (excluding
+   the zero terminator); if "line" is NULL, only the length is returned */
+static int text_convert(const DATALIST *item, int start, int stop, char *line)
+{
+  assert(item != NULL);
+  int len = 0;
+  for (int idx = start; idx < stop; idx++) {
+    if (item->data[idx] == '\r' || item->data[idx] == '\n'
+        || (idx == stop - 1 && item->data[idx] == ' '))
+    {
+      /* ignore \r and \n in the formatted output, and also ignore a space
+         at the end of a string (or segment), because a space is a break
+         position in word-wrap */
+    } else if ((item->data[idx] < ' ')
+        || (item->data[idx] >= 0x80 && item->data[idx] < 0xa0)) {
+      if (line != NULL)
+        memcpy(line + len, "\xe2\x96\xab", 3); /* glyph for "unknown character" */
+      len += 3;
+    } else if (item->data[idx] >= 0xa0) {
+      if (line != NULL) {
+        line[len] = (char)(0xc0 | ((item->data[idx] >> 6) & 0x3));
+        line[len + 1] = (char)(0x80 | (item->data[idx] & 0x3f));
+      }
+      len += 2;
+    } else {
+      if (line != NULL)
+        line[len] = item->data[idx];
+      len += 1;
+    }
+  }
+  if (line != NULL)
+    line[len] = '\0';
+  return len;
+}
+
+static char hextable[256][3];
+static char asciitable[256];
+
+/* hex_inittables() fills in the look-up tables for hex_format(); it must have
+   run on the GUI thread before a worker thread calls hex_format() */
+static void hex_inittables(void)
+{
+  if (hextable[0][0] == '\0') {
+    static const char hexdigit[] = "0123456789ABCDEF";
+    for (int idx = 0; idx < 256; idx++) {
+      hextable[idx][0] = hexdigit[(idx >> 4) & 0x0f];
+      hextable[idx][1] = hexdigit[idx & 0x0f];
+      hextable[idx][2] = ' ';
+      asciitable[idx] = (idx >= ' ' && idx < 128) ? (char)idx : '.';
+    }
+  }
 }
 
-static bool tcl_runscript(APPSTATE *state, const unsigned char *data, size_t size)
+/* hex_format() creates a hex dump of the data in the buffer, with "bpl" bytes
+   per line; each line takes "4 * bpl + 3" characters plus a zero terminator */
+static void hex_format(const unsigned char *data, size_t size, int bpl, char *buffer, unsigned *lines)
 {
-  /* (re-)load the script file */
-  assert(state != NULL);
-  /* check whether the file date/time changes; if so, also reload the script */
-  if (state->script != NULL && strlen(state->scriptfile) > 0) {
-    struct stat fstat;
-    if (stat(state->scriptfile, &fstat) == 0 && state->scriptfiletime != fstat.st_mtime) {
-      state->scriptfiletime =fstat.st_mtime;
-      state->script_reload = true;
+  hex_inittables();
+
+  assert(data != NULL);
+  assert(bpl > 0);
+  assert(buffer != NULL && lines != NULL);
+  int len = 4 * bpl + 3;
+  char *line = buffer;
+  int lineidx = 0;
+  for (size_t start = 0; start < size; start += bpl) {
+    size_t count = (size - start < (size_t)bpl) ? size - start : (size_t)bpl;
+    memset(line, ' ', len);
+    char *hex = line;
+    char *ascii = line + 3 * bpl + 2;
+    for (size_t idx = 0; idx < count; idx++) {
+      memcpy(hex, hextable[data[start + idx]], 3);
+      hex += 3;
+      *ascii++ = asciitable[data[start + idx]];
     }
+    line[len] = '\0';
+    lines[lineidx++] = (unsigned)(line - buffer);
+    line += len + 1;
   }
-  if (state->script_reload) {
-    state->script_reload = false;
-    state->script_block_run = false;
-    if (state->script != NULL) {
-      free((void*)state->script);
-      state->script = NULL;
+}
+
+/* format_update() makes sure that the line count of the data block is valid
+   for the current view; the text is formatted on demand, see format_text() */
+static FORMAT *format_update(const APPSTATE *state, DATALIST *item)
+{
+  int index = format_index(state, item);
+  int param = format_param(state, index);
+  FORMAT *fmt = &item->format[index];
+  if (fmt->param != param) {
+    format_release(fmt);
+    fmt->param = param;
+    if (index == FMT_HEX) {
+      fmt->numlines = (item->datasize + param - 1) / param;
+    } else {
+      fmt->numlines = 0;
+      for (int start = 0; start < item->datasize; start = text_nextline(item, start, param))
+        fmt->numlines += 1;
     }
-    if (strlen(state->scriptfile) == 0)
-      return false;
-    FILE *fp = fopen(state->scriptfile, "rt");
-    if (fp == NULL) {
-      static const char *msg = "Tcl script file not found.";
-      tcl_add_message(state, msg, strlen(msg), false);
-      return false;
+  }
+  return fmt;
+}
+
+/* format_text() formats the data block for the current view, unless the text
+   is already cached; it returns NULL on a memory allocation failure */
+static FORMAT *format_text(const APPSTATE *state, DATALIST *item)
+{
+  FORMAT *fmt = format_update(state, item);
+  if (fmt->text != NULL)
+    return fmt;
+  assert(fmt->lines == NULL && fmt->match == NULL);
+
+  bool ishex = (fmt == &item->format[FMT_HEX]);
+  size_t size = 0;
+  if (ishex) {
+    size = (size_t)fmt->numlines * (4 * fmt->param + 4);
+  } else {
+    for (int start = 0, stop; start < item->datasize; start = stop) {
+      stop = text_nextline(item, start, fmt->param);
+      size += text_convert(item, start, stop, NULL) + 1;
     }
-    fseek(fp, 0, SEEK_END);
-    size_t sz = ftell(fp) + 2;
-    state->script = malloc((sz)*sizeof(char));
-    if (state->script == NULL) {
-      static const char *msg = "Memory allocation failure (when loading Tcl script).";
-      tcl_add_message(state, msg, strlen(msg), false);
-      fclose(fp);
-      return false;
+  }
+  fmt->text = malloc((size > 0 ? size : 1) * sizeof(char));
+  fmt->lines = malloc((fmt->numlines > 0 ? fmt->numlines : 1) * sizeof(unsigned));
+  if (fmt->text == NULL || fmt->lines == NULL) {
+    format_release(fmt);
+    return NULL;
+  }
+
+  if (ishex) {
+    hex_format(item->data, item->datasize, fmt->param, fmt->text, fmt->lines);
+  } else {
+    int lineidx = 0;
+    size_t pos = 0;
+    for (int start = 0, stop; start < item->datasize; start = stop) {
+      stop = text_nextline(item, start, fmt->param);
+      fmt->lines[lineidx++] = (unsigned)pos;
+      pos += text_convert(item, start, stop, fmt->text + pos) + 1;
     }
-    fseek(fp, 0, SEEK_SET);
-    memset(state->script, 0, sz);
-    char *line = state->script;
-    while (fgets(line, sz, fp) != NULL)
-      line += strlen(line);
-    assert(line - state->script < sz);
-    fclose(fp);
+    assert(lineidx == fmt->numlines && pos == size);
   }
-  if (state->script == NULL || state->script_block_run)
-    return false;
-  if (!tcl_set_recv(state, data, size))
+  fmt->textsize = size;
+  format_bytes += size;
+  return fmt;
+}
+
+/* For saving in the background, the raw data of the blocks in the list is
+   copied into a snapshot (the tail block grows and old blocks are dropped
+   while data is received). The worker thread formats the lines for the view
+   that was active when the snapshot was made. Rows are requested in sequence,
+   so the snapshot keeps a cursor to the next line. */
+typedef struct tagSAVEBLOCK {
+  struct tagSAVEBLOCK *next;
+  unsigned long long timestamp;
+  int index;                  /* FMT_TEXT or FMT_HEX */
+  int param;                  /* wrap width or bytes per line */
+  size_t datasize;
+  unsigned char data[];
+} SAVEBLOCK;
+
+typedef struct tagSAVESNAPSHOT {
+  SAVEBLOCK *first;
+  SAVEBLOCK *block;           /* cursor: current block */
+  int start;                  /* cursor: start of the next line in the block */
+  int timestamp;              /* TIMESTAMP_xxx */
+  time_t basetime;
+  bool textview;              /* timestamp on the same line (text view) or on a line of its own */
+  bool merged;                /* timestamp and text in a single field (plain text output) */
+  char stamp[40];
+  char *line;
+} SAVESNAPSHOT;
+
+static const EXPORTCOLUMN save_columns[] = {
+  { "Timestamp", EXPCOL_STRING, 0 },
+  { "Text",      EXPCOL_STRING, 0 },
+};
+
+static bool save_exportrow(void *context, unsigned long row, EXPORTVALUE *values)
+{
+  SAVESNAPSHOT *snapshot = (SAVESNAPSHOT*)context;
+  (void)row;
+  SAVEBLOCK *block = snapshot->block;
+  while (block != NULL && snapshot->start >= (int)block->datasize) {
+    block = block->next;
+    snapshot->start = 0;
+  }
+  snapshot->block = block;
+  if (block == NULL)
     return false;
-  /* now run it */
-  state->script_cache = false;
-  bool ok = tcl_eval(&state->tcl, state->script, strlen(state->script) + 1);
-  if (!ok) {
-    int line;
-    char symbol[64];
-    const char *err = tcl_errorinfo(&state->tcl, NULL, &line, symbol, sizearray(symbol));
-    char msg[256];
-    sprintf(msg, "Tcl script error: %s, on or after line %d", err, line);
-    if (strlen(symbol) > 0)
-      sprintf(msg + strlen(msg), ": %s", symbol);
-    tcl_add_message(state, msg, strlen(msg), false);
-    state->script_block_run = true; /* block the script from running, until it is reloaded */
+
+  char *line = snapshot->line;
+  if (snapshot->timestamp != TIMESTAMP_NONE) {
+    format_time(snapshot->stamp, sizearray(snapshot->stamp), block->timestamp, snapshot->basetime, snapshot->timestamp);
+    if (snapshot->merged)
+      line += sprintf(line, "[%s]%c", snapshot->stamp, snapshot->textview ? ' ' : '\n');
   }
-  /* if data was marked to be cached, leave it in the buffer; otherwise, free it
-     (and always delete a buffer if every data has been gobbled) */
-  if ((!state->script_cache || state->script_recv_length == 0) && state->script_recv != NULL) {
-    free((void*)state->script_recv);
-    state->script_recv = NULL;
-    state->script_recv_length = 0;
-    state->script_cache = false;
+  int start = snapshot->start;
+  int stop;
+  if (block->index == FMT_HEX) {
+    unsigned offset;
+    stop = ((int)block->datasize - start > block->param) ? start + block->param : (int)block->datasize;
+    hex_format(block->data + start, stop - start, block->param, line, &offset);
+  } else {
+    DATALIST item;
+    memset(&item, 0, sizeof item);
+    item.data = block->data;
+    item.datasize = block->datasize;
+    stop = text_nextline(&item, start, block->param);
+    text_convert(&item, start, stop, line);
   }
-  return ok;
+  snapshot->start = stop;
+
+  int col = 0;
+  if (snapshot->timestamp != TIMESTAMP_NONE && !snapshot->merged) {
+    values[col].text = snapshot->stamp;
+    values[col].length = strlen(snapshot->stamp);
+    col++;
+  }
+  values[col].text = snapshot->line;
+  values[col].length = strlen(snapshot->line);
+  return true;
 }
 
-static char *format_time(char *buffer, size_t size, unsigned long timestamp, time_t basetime, int format)
+static void save_exportdone(void *context)
 {
-  assert(format == TIMESTAMP_RELATIVE || TIMESTAMP_ABSOLUTE);
-  assert(buffer != NULL);
-  assert(size >= 20);
-  if (format == TIMESTAMP_RELATIVE) {
-    sprintf(buffer, "%9.3f", timestamp/1000.0);
-  } else {
-    time_t tstamp = basetime + (timestamp + 500) / 1000;
-    strftime(buffer, size, "%Y-%m-%d %H:%M:%S", localtime(&tstamp));
+  SAVESNAPSHOT *snapshot = (SAVESNAPSHOT*)context;
+  while (snapshot->first != NULL) {
+    SAVEBLOCK *next = snapshot->first->next;
+    free((void*)snapshot->first);
+    snapshot->first = next;
   }
-  return buffer;
+  if (snapshot->line != NULL)
+    free((void*)snapshot->line);
+  free((void*)snapshot);
 }
 
-static bool save_data(const char *filename, const APPSTATE *state)
+/* save_data() copies the received data and starts saving it in the
+   background, in the format of the current view; it returns false if the
+   export cannot be started (the result of the export itself is checked with
+   export_poll()) */
+static bool save_data(const char *filename, int format, const APPSTATE *state)
 {
-  FILE *fp = fopen(filename, "wt");
-  if (fp == NULL)
+  SAVESNAPSHOT *snapshot = malloc(sizeof(SAVESNAPSHOT));
+  if (snapshot == NULL)
     return false;
-
+  memset(snapshot, 0, sizeof(SAVESNAPSHOT));
+  snapshot->timestamp = state->recv_timestamp;
+  snapshot->basetime = reception_timestamp;
+  snapshot->textview = (state->view == VIEW_TEXT);
+  snapshot->merged = (format == EXPORT_TEXT);
+  hex_inittables();
+
+  unsigned long numrows = 0;
+  size_t linesize = 1;
+  SAVEBLOCK **tail = &snapshot->first;
   for (DATALIST *item = datalist_root.next; item != NULL; item = item->next) {
-    assert(item->text != NULL);
-    for (int lineidx = 0; lineidx < item->textlines; lineidx++) {
-      if (state->recv_timestamp != TIMESTAMP_NONE) {
-        char buffer[40];
-        format_time(buffer, sizearray(buffer), item->timestamp, reception_timestamp, state->recv_timestamp);
-        fprintf(fp, "[%s]", buffer);
-        fputc((state->view == VIEW_TEXT) ? ' ' : '\n', fp);
-      }
-      assert(item->text[lineidx] != NULL);
-      fputs(item->text[lineidx], fp);
-      fputc('\n', fp);
+    FORMAT *fmt = format_update(state, item);
+    SAVEBLOCK *block = malloc(sizeof(SAVEBLOCK) + item->datasize);
+    if (block == NULL) {
+      save_exportdone(snapshot);
+      return false;
     }
+    block->next = NULL;
+    block->timestamp = item->timestamp;
+    block->index = format_index(state, item);
+    block->param = fmt->param;
+    block->datasize = item->datasize;
+    memcpy(block->data, item->data, item->datasize);
+    *tail = block;
+    tail = &block->next;
+    numrows += fmt->numlines;
+    /* text is converted to UTF-8, up to 3 bytes per character */
+    size_t size = (block->index == FMT_HEX) ? (size_t)4 * block->param + 4 : 3 * item->datasize + 1;
+    if (size > linesize)
+      linesize = size;
+  }
+  snapshot->block = snapshot->first;
+  snapshot->line = malloc(linesize + sizearray(snapshot->stamp) + 4);
+  if (snapshot->line == NULL) {
+    save_exportdone(snapshot);
+    return false;
   }
 
-  fclose(fp);
+  const EXPORTCOLUMN *columns = save_columns;
+  int numcolumns = sizearray(save_columns);
+  if (snapshot->timestamp == TIMESTAMP_NONE || snapshot->merged) {
+    columns += 1; /* skip the timestamp column */
+    numcolumns -= 1;
+  }
+  if (!export_start(filename, format, columns, numcolumns, numrows,
+                    save_exportrow, save_exportdone, snapshot))
+  {
+    save_exportdone(snapshot);
+    return false;
+  }
   return true;
 }
 
+/* save_message() adds a message about saving to the viewport */
+static void save_message(APPSTATE *state, const char *text)
+{
+  tcl_add_message(state, text, strlen(text), true);
+}
+
+/* handle_export() checks the progress of saving the data in the background,
+   and reports a failure in the viewport */
+static void handle_export(APPSTATE *state)
+{
+  unsigned percent;
+  int result = export_poll(&percent, NULL);
+  if (result == EXPORT_BUSY) {
+    state->export_percent = (int)percent;
+  } else if (result != EXPORT_IDLE) {
+    if (result == EXPORT_FAILED)
+      save_message(state, "Saving the data failed or was cancelled.");
+    state->export_percent = -1;
+  }
+}
+
+/* reformat_data() updates the line count of the data block for the current
+   view; the text itself is formatted only when it scrolls into view */
 static void reformat_data(APPSTATE *state, DATALIST *item)
 {
   assert(state != NULL);
   assert(item != NULL);
+  if (format_index(state, item) == FMT_TEXT && state->wordwrap && state->viewport_width == 0)
+    state->reformat_view = true;  /* special case, viewport width is not yet calculated */
+  format_update(state, item);
+}
 
-  /* remove old formatting (if any) */
-  if (item->text != NULL) {
-    for (int idx = 0; idx < item->textlines; idx++)
-      free((void*)item->text[idx]);
-    free((void*)item->text);
-    item->text = NULL;
-    item->textlines = 0;
-    item->maxlines = 0;
-  }
-
-  if (state->view == VIEW_TEXT || (item->flags & DFLAG_SCRIPT)) {
-    /* split the data buffer into lines */
-    if (state->wordwrap && state->viewport_width == 0)
-      state->reformat_view = true;  /* special case, viewport width is not yet calculated */
-    int maxchars = (state->wordwrap && state->viewport_width > 0) ? state->viewport_width : INT_MAX;
-    int start = 0;
-    while (start < item->datasize) {
-      int stop = start;
-      while (stop < item->datasize && (stop - start) < maxchars
-             && item->data[stop] != '\r' && item->data[stop] != '\n')
-        stop++;
-      if (stop + 1 < item->datasize && item->data[stop] == '\r' && item->data[stop + 1] == '\n') {
-        stop += 2;  /* skip \r\n */
-      } else if (stop < item->datasize && (item->data[stop] == '\r' || item->data[stop] == '\n')) {
-        stop += 1;  /* skip either \r or \n */
-      } else if (stop - start >= maxchars) {
-        if (item->data[stop] == ' ') {
-          stop += 1;  /* gobble up one space at the end of a line */
-        } else {
-          int pos = stop;
-          while (pos > start && item->data[pos - 1] > ' ')
-            pos -= 1;
-          if (pos > start)
-            stop = pos;
-        }
-      }
-      /* convert each line to UTF-8 */
-      int len = 0;
-      for (int idx = start; idx < stop; idx++) {
-        if ((item->data[idx] < ' ' && item->data[idx] != '\r' && item->data[idx] != '\n')
-            || (item->data[idx] >= 0x80 && item->data[idx] < 0xa0))
-          len += 3; // 0xE2 0x96 0xAB for unknown character
-        else if (item->data[idx] >= 0xa0)
-          len += 2;
-        else
-          len += 1;
-      }
-      char *line = malloc((len + 1) * sizeof(char));
-      if (line != NULL) {
-        char *pos = line;
-        for (int idx = start; idx < stop; idx++) {
-          if (item->data[idx] == '\r' || item->data[idx] == '\n'
-              || (idx == stop - 1 && item->data[idx] == ' '))
-          {
-            /* ignore \r and \n in the formatted output, and also ignore a space
-               at the end of a string (or segment), because a space is a break
-               position in word-wrap */
-          } else if ((item->data[idx] < ' ')
-              || (item->data[idx] >= 0x80 && item->data[idx] < 0xa0)) {
-            memcpy(pos, "\xe2\x96\xab", 3); /* glyph for "unknown character" */
-            pos += 3;
-          } else if (item->data[idx] >= 0xa0) {
-            *pos++ = (char)(0xc0 | ((item->data[idx] >> 6) & 0x3));
-            *pos++ = (char)(0x80 | (item->data[idx] & 0x3f));
-          } else {
-            *pos++ = item->data[idx];
-          }
-        }
-        *pos = '\0';
-        /* append to the list */
-        if (item->textlines >= item->maxlines) {
-          int nummax = (item->maxlines > 0) ? 2 * item->maxlines : 1 + (stop < item->datasize);
-          char **text = malloc(nummax * sizeof(char*));
-          if (text != NULL) {
-            if (item->text != NULL)
-              memcpy(text, item->text, item->maxlines * sizeof(char*));
-            free((void*)item->text);
-            item->text = text;
-            item->maxlines = nummax;
-          }
-        }
-        if (item->textlines < item->maxlines) {
-          item->text[item->textlines] = strdup(line);
-          if (item->text[item->textlines] != NULL)
-            item->textlines += 1;
-        }
-        free(line);
-      }
-      start = stop;
-    }
-  } else {
-    static const char hexdigit[] = "0123456789ABCDEF";
-    /* we know exactly how many rows are needed */
-    assert(state->bytesperline_val > 0);
-    int numlines = (item->datasize + state->bytesperline_val - 1) / state->bytesperline_val;
-    item->text = malloc(numlines * sizeof(char*));
-    if (item->text != NULL) {
-      item->maxlines = numlines;
-      item->textlines = 0;
-      int len = 4 * state->bytesperline_val + 4;
-      char *line = malloc((len + 1) * sizeof(char));
-      if (line != NULL) {
-        int start = 0;
-        while (start < item->datasize) {
-          memset(line, ' ', len);
-          line[len - 1] = '\0';
-          int stop = start + state->bytesperline_val;
-          if (stop > item->datasize)
-            stop = item->datasize;
-          int pos = 0;
-          for (int idx = start; idx < stop; idx++) {
-            line[3*pos] = hexdigit[(item->data[idx] >> 4) & 0x0f];
-            line[3*pos + 1] = hexdigit[item->data[idx] & 0x0f];
-            line[3 * state->bytesperline_val + 2 + pos] = (item->data[idx] >= ' ' && item->data[idx] < 128) ? item->data[idx] : '.';
-            pos++;
-          }
-          item->text[item->textlines] = strdup(line);
-          if (item->text[item->textlines] != NULL)
-            item->textlines += 1;
-          start = stop;
-        }
-        free((void*)line);
-      }
-    }
-  }
+/* stats_addread() updates the reception statistics for a read */
+static void stats_addread(RECVSTATS *stats, size_t size, unsigned long long tstamp)
+{
+  assert(stats != NULL);
+  if (stats->lastread != 0 && tstamp > stats->lastread && tstamp - stats->lastread > stats->gap)
+    stats->gap = tstamp - stats->lastread;
+  stats->lastread = tstamp;
+  stats->bytes += size;
+  stats->total += size;
 }
 
-static int process_data(APPSTATE *state)
+/* stats_update() calculates the rates at the end of each interval */
+static void stats_update(RECVSTATS *stats)
 {
-  unsigned char buffer[256];
-  size_t count = rs232_recv(state->hCom, buffer, sizearray(buffer));
-  if (count == 0)
-    return 0;
+  assert(stats != NULL);
+  unsigned long long tstamp = rs232_timestamp();
+  if (stats->start == 0)
+    stats->start = tstamp;
+  if (tstamp - stats->start >= STATS_INTERVAL) {
+    double interval = (tstamp - stats->start) / 1000000.0;
+    stats->bytes_sec = stats->bytes / interval;
+    stats->lines_sec = stats->lines / interval;
+    stats->maxgap = stats->gap;
+    stats->bytes = stats->lines = 0;
+    stats->gap = 0;
+    stats->start = tstamp;
+  }
+}
 
-# if !defined _WIN32
-    /* In Linux (and similar), frame errors show up in the data stream as a
-       byte sequence FF 00, and breaks as the sequence FF 00 00.
-       However, such sequences might also occur in normal (binary) transfer,
-       and thus, any "normal" FF bytes are doubled. */
-    for (int idx = 0; idx < count - 1; idx++) {
-      if (buffer[idx] == 0xff) {
-        if (buffer[idx + 1] == 0) {
-          int remove = 2;
-          if (idx < count - 2 && buffer[idx + 2] == 0) {
-            state->linestatus |= LINESTAT_BREAK;
-            remove = 3;
-          } else {
-            state->linestatus |= LINESTAT_ERR;
-          }
-          state->breakdelay = 2;
-          memmove(buffer + idx, buffer + idx + remove, count - idx - remove);
-          count -= remove;
-        } else if (buffer[idx + 1] == 0xff) {
-          /* ff ff -> ff (just remove the first) */
-          memmove(buffer + idx, buffer + idx + 1, count - idx - 1);
-          count -= 1;
-        }
-      }
-    }
-# endif
+/* process_chunk() adds the data of a single read to the data list, and passes
+   it to the script */
+static void process_chunk(APPSTATE *state, const unsigned char *buffer, size_t count, unsigned long long tstamp)
+{
+  assert(buffer != NULL && count > 0);
 
   /* check whether the entirity of the block is ASCII */
   bool isascii = true;
@@ -1039,7 +2324,7 @@ static int process_data(APPSTATE *state)
     if (buffer[idx] >= 0x80)
       isascii = false;
 
-  int flags = state->tcl_running ? DFLAG_APPEND : 0;
+  int flags = script_iswaiting() ? DFLAG_APPEND : 0;
 
   /* for ASCII text, add lines (ending with \r and or \n) if possible */
   size_t start = 0;
@@ -1049,6 +2334,8 @@ static int process_data(APPSTATE *state)
       stop = start;
       while (stop < count && buffer[stop] != '\r' && buffer[stop] != '\n')
         stop++;
+      if (stop < count)
+        state->stats.lines += 1;
       if (stop + 1 < count && buffer[stop] == '\r' && buffer[stop + 1] == '\n')
         stop += 2;  /* skip \r\n */
       else if (stop < count)
@@ -1057,36 +2344,101 @@ static int process_data(APPSTATE *state)
       stop = count;
     }
 
-    DATALIST *item = datalist_append(buffer + start, stop - start, isascii, flags);
+    DATALIST *item = datalist_append(buffer + start, stop - start, isascii, flags, tstamp);
     if (item != NULL)
       reformat_data(state, item); /* format (or re-format) the block of data */
 
     start = stop;
   }
 
-  /* run script after handling raw data, except that if the script is already
-     running, update the variable (this reentry happens when the script called
-     "wait" for more data) */
-  if (state->tcl_running)
-    tcl_set_recv(state, buffer, count);
-  else
-    tcl_runscript(state, buffer, count);
+  /* pass the data to the script (which runs on the worker thread) */
+  script_feed(buffer, count);
+}
 
-  if (state->linelimit_val > 0) {
-    /* count number of blocks in the datalist, then decide how many lines to
-       drop */
-    int numlines = 0;
-    for (DATALIST *item = datalist_root.next; item != NULL; item = item->next)
-      numlines++;
-    int drop = numlines - state->linelimit_val;
-    while (drop-- > 0) {
-      DATALIST *item = datalist_root.next;
-      datalist_root.next = item->next;
-      datalist_freeitem(item);
-    }
+static int process_data(APPSTATE *state)
+{
+  /* the buffer is static, because it is large (at a high Baud rate, many
+     bytes arrive per frame); the bytes of an escape sequence that was split
+     across two reads are held back, and put in front of the next read */
+  static unsigned char buffer[RECV_BUFSIZE];
+  static unsigned char held[2];
+  static size_t heldcount = 0;
+  static unsigned long long heldtstamp;
+
+  /* handle the data per read (so that each part gets the timestamp of the
+     read), up to a maximum per frame */
+  size_t total = 0;
+  while (total < RECV_BUFSIZE) {
+    memcpy(buffer, held, heldcount);
+    unsigned long long tstamp = heldtstamp;
+    size_t received = rs232_reader_getchunk(state->hCom, buffer + heldcount, sizearray(buffer) - heldcount, &tstamp);
+    size_t count = heldcount + received;
+    heldcount = 0;
+    if (count == 0)
+      break;
+    if (received > 0)
+      stats_addread(&state->stats, received, tstamp);
+
+#   if !defined _WIN32
+      /* In Linux (and similar), frame errors show up in the data stream as a
+         byte sequence FF 00, and breaks as the sequence FF 00 00.
+         However, such sequences might also occur in normal (binary) transfer,
+         and thus, any "normal" FF bytes are doubled.
+         The sequences are removed in a single pass (copying bytes down in the
+         buffer). An incomplete sequence at the end of the buffer is held back
+         for the next read, except when no new data arrived (then it is resolved
+         as is). */
+      size_t rd = 0, wr = 0;
+      while (rd < count) {
+        if (buffer[rd] != 0xff) {
+          buffer[wr++] = buffer[rd++];
+          continue;
+        }
+        if (received > 0 && (rd + 1 >= count || (buffer[rd + 1] == 0 && rd + 2 >= count))) {
+          heldcount = count - rd;
+          assert(heldcount <= sizearray(held));
+          memcpy(held, buffer + rd, heldcount);
+          heldtstamp = tstamp;
+          break;
+        }
+        if (rd + 1 < count && buffer[rd + 1] == 0) {
+          if (rd + 2 < count && buffer[rd + 2] == 0) {
+            state->linestatus |= LINESTAT_BREAK;
+            rd += 3;
+          } else {
+            state->linestatus |= LINESTAT_ERR;
+            rd += 2;
+          }
+          state->breakdelay = 2;
+        } else if (rd + 1 < count && buffer[rd + 1] == 0xff) {
+          /* ff ff -> ff */
+          buffer[wr++] = 0xff;
+          rd += 2;
+        } else {
+          buffer[wr++] = buffer[rd++];
+        }
+      }
+      count = wr;
+#   endif
+
+    if (count > 0)
+      process_chunk(state, buffer, count, tstamp);
+    total += received;
+    if (received == 0)
+      break;
   }
 
-  return count;
+  /* drop the oldest blocks, beyond the limit (when capturing, these blocks
+     can be loaded back from the file, so that there is always a limit) */
+  if (total > 0) {
+    int limit = state->linelimit_val;
+    if (limit <= 0 && capture_active)
+      limit = CAPTURE_WINDOW;
+    if (limit > 0)
+      datalist_trim(limit);
+  }
+
+  return total;
 }
 
 static void free_portlist(APPSTATE *state)
@@ -1140,6 +2492,28 @@ static int value_listindex(long value, const char **list, int entries)
   return (idx < entries) ? idx : -1;
 }
 
+/* monitor_pagerow() adds a row with a button to load blocks from the capture
+   file into the viewport; the row is replaced by an empty row when it is out
+   of view */
+static bool monitor_pagerow(struct nk_context *ctx, float rowheight,
+                            unsigned count, const char *position,
+                            int firstline, int lastline, int *linecount, int *skiplines)
+{
+  bool clicked = false;
+  if (*linecount < firstline || *linecount > lastline) {
+    *skiplines += 1;
+  } else {
+    nk_listview_spacer(ctx, rowheight, *skiplines);
+    *skiplines = 0;
+    char text[80];
+    sprintf(text, "%u %s block%s in capture file (click to load)", count, position, (count == 1) ? "" : "s");
+    nk_layout_row_dynamic(ctx, rowheight, 1);
+    clicked = nk_button_label(ctx, text);
+  }
+  *linecount += 1;
+  return clicked;
+}
+
 static void widget_monitor(struct nk_context *ctx, const char *id, APPSTATE *state, float rowheight, nk_flags widget_flags)
 {
   assert(ctx != NULL);
@@ -1161,16 +2535,47 @@ static void widget_monitor(struct nk_context *ctx, const char *id, APPSTATE *sta
   }
   state->viewport_width = (int)((rcwidget.w - timefield_width - 2 * stwin->padding.x - 4) / charwidth);
 
+  /* get the range of lines that is in view (plus a margin), only data blocks
+     in this range are formatted; the lines of all other blocks are replaced
+     by a single empty row of the same height */
+  static unsigned long frame = 0;
+  frame += 1;
+  nk_uint scroll_x, scroll_y;
+  nk_group_get_scroll(ctx, id, &scroll_x, &scroll_y);
+  float rowpitch = nk_listview_pitch(ctx, rowheight);
+  int firstline = (int)(scroll_y / rowpitch) - 1;
+  int lastline = (int)((scroll_y + rcwidget.h) / rowpitch) + 1;
+
   nk_style_push_color(ctx, &stwin->fixed_background.data.color, COLOUR_BG0);
   if (nk_group_begin(ctx, id, widget_flags)) {
     float lineheight = 0.0;
     float vpwidth = 0.0;
     int cur_linecount = 0;
+    int skiplines = 0;
+    int pageaction = 0; /* 1 = load earlier blocks, 2 = load blocks in the gap */
+    unsigned pagecount;
+    if ((pagecount = capture_earlier()) > 0
+        && monitor_pagerow(ctx, rowheight, pagecount, "earlier", firstline, lastline, &cur_linecount, &skiplines))
+      pageaction = 1;
     for (DATALIST *item = datalist_root.next; item != NULL; item = item->next) {
-      assert(item->text != NULL);
-      for (int lineidx = 0; lineidx < item->textlines; lineidx++) {
+      if (datalist_paged > 0 && item == datalist_pagedtail->next && (pagecount = capture_gap()) > 0
+          && monitor_pagerow(ctx, rowheight, pagecount, "more", firstline, lastline, &cur_linecount, &skiplines))
+        pageaction = 2;
+      FORMAT *fmt = format_update(state, item);
+      if (cur_linecount + fmt->numlines <= firstline || cur_linecount > lastline
+          || format_text(state, item) == NULL)
+      {
+        cur_linecount += fmt->numlines;
+        skiplines += fmt->numlines;
+        continue;
+      }
+      nk_listview_spacer(ctx, rowheight, skiplines);
+      skiplines = 0;
+      item->shown = frame;
+      bool classified = filter_classify(&state->filter_root, fmt);
+      for (int lineidx = 0; lineidx < fmt->numlines; lineidx++) {
+        const char *text = fmt->text + fmt->lines[lineidx];
         cur_linecount++;
-        assert(item->text[lineidx] != NULL);
         nk_layout_row_begin(ctx, NK_STATIC, rowheight, 1 + (timefield_width > 1));
         if (lineheight <= 0.1) {
           struct nk_rect rcline = nk_layout_widget_bounds(ctx);
@@ -1180,11 +2585,8 @@ static void widget_monitor(struct nk_context *ctx, const char *id, APPSTATE *sta
         if (timefield_width > 1) {
           nk_layout_row_push(ctx, timefield_width);
           if (lineidx == 0) {
-            unsigned long tstamp = item->timestamp;
-            if (state->recv_timestamp == TIMESTAMP_ABSOLUTE)
-              tstamp += datalist_root.timestamp;
             char buffer[40];
-            format_time(buffer, sizearray(buffer), tstamp, reception_timestamp, state->recv_timestamp);
+            format_time(buffer, sizearray(buffer), item->timestamp, reception_timestamp, state->recv_timestamp);
             nk_text_colored(ctx, buffer, strlen(buffer), NK_TEXT_LEFT, COLOUR_FG_CYAN);
           } else {
             nk_spacing(ctx, 1);
@@ -1195,21 +2597,22 @@ static void widget_monitor(struct nk_context *ctx, const char *id, APPSTATE *sta
           fgcolour = COLOUR_FG_GREEN;
         else if (item->flags & DFLAG_LOCAL)
           fgcolour = COLOUR_FG_AQUA;
-        int len = strlen(item->text[lineidx]);
+        int len = strlen(text);
         float textwidth = len * charwidth + 8;
         if (textwidth < vpwidth - timefield_width)
           textwidth = vpwidth - timefield_width;
         nk_layout_row_push(ctx, textwidth);
-        FILTER* flt = filter_match(&state->filter_root, item->text[lineidx]);
+        FILTER* flt = classified ? fmt->match[lineidx] : filter_match(&state->filter_root, text);
         if (flt != NULL) {
           struct nk_rect rcline = nk_widget_bounds(ctx);
           nk_fill_rect(&ctx->current->buffer, rcline, 0, flt->colour);
           fgcolour = CONTRAST_COLOUR(flt->colour);
         }
-        nk_text_colored(ctx, item->text[lineidx], len, NK_TEXT_LEFT, fgcolour);
+        nk_text_colored(ctx, text, len, NK_TEXT_LEFT, fgcolour);
         nk_layout_row_end(ctx);
       }
     }
+    nk_listview_spacer(ctx, rowheight, skiplines);
     nk_layout_row_dynamic(ctx, rowheight, 1);
     if (cur_linecount == 0 && !rs232_isopen(state->hCom)) {
       nk_label_colored(ctx, "No Connection", NK_TEXT_CENTERED, COLOUR_FG_RED);
@@ -1219,6 +2622,18 @@ static void widget_monitor(struct nk_context *ctx, const char *id, APPSTATE *sta
       nk_spacing(ctx, 1);
     }
     nk_group_end(ctx);
+    if (pageaction != 0 && capture_page(pageaction == 1) && pageaction == 1)
+      state->scrolltolast = nk_false; /* keep the loaded blocks in view */
+    /* drop the formatted text of blocks that are out of view, when the cache
+       grows too big (the line counts remain valid) */
+    if (format_bytes > FORMAT_BUDGET) {
+      for (DATALIST *item = datalist_root.next; item != NULL; item = item->next) {
+        if (item->shown != frame) {
+          for (int idx = 0; idx < sizearray(item->format); idx++)
+            format_release(&item->format[idx]);
+        }
+      }
+    }
     /* calculate scrolling: if number of lines change, scroll to the last line */
     if (state->scrolltolast) {
       static int prev_linecount = 0;
@@ -1314,7 +2729,7 @@ static void widget_lineinput(struct nk_context *ctx, APPSTATE *state)
           memcpy(buffer + pos, "\r\n", 2);
         rs232_xmit(state->hCom, buffer, size);
         if (state->localecho) {
-          DATALIST *item = datalist_append(buffer, size, false, DFLAG_LOCAL);
+          DATALIST *item = datalist_append(buffer, size, false, DFLAG_LOCAL, rs232_timestamp());
           if (item != NULL)
             reformat_data(state, item);
         }
@@ -1477,6 +2892,46 @@ static int nk_ledbutton(struct nk_context *ctx, const char *label, const char *t
   return result;
 }
 
+/* linestatus_update() polls the line/modem status roughly every 0.1 second
+   (also when the panel is closed, because the statistics count overruns) */
+static void linestatus_update(APPSTATE *state)
+{
+  unsigned long tstamp = timestamp();
+  if (tstamp - state->linestat_tstamp >= 100) {
+    if (rs232_isopen(state->hCom)) {
+      unsigned delayedstat = 0;
+      if (state->breakdelay > 0) {
+        delayedstat = state->linestatus & (LINESTAT_LBREAK | LINESTAT_BREAK | LINESTAT_ERR);
+        state->breakdelay -= 1;
+        /* local break must be toggled of manually in Windows (it does not
+           need so in Linx, but it does no harm either) */
+        if (state->breakdelay == 0 && (delayedstat & LINESTAT_LBREAK) != 0)
+          rs232_setstatus(state->hCom, LINESTAT_LBREAK, 0);
+      }
+#     if defined _WIN32
+        /* Windows does not return the status that the host sets itself, so
+           these must be saved, and merged back in */
+        unsigned localstat = state->linestatus & (LINESTAT_RTS | LINESTAT_DTR);
+        delayedstat |= localstat;
+#     endif
+      state->linestatus = rs232_getstatus(state->hCom);
+      if (state->linestatus & LINESTAT_OVERRUN)
+        state->stats.overruns += 1;
+      /* if a break or frame error are detected in the active states (as opposed
+         to the delayed status), make sure it stays "on" for long enough to
+         be visible */
+      if (state->linestatus & (LINESTAT_BREAK | LINESTAT_ERR))
+        state->breakdelay = 2;
+      state->linestatus |= delayedstat;
+    } else {
+      state->linestatus = 0;
+      state->breakdelay = 0;
+      state->hCom = NULL;
+    }
+    state->linestat_tstamp = tstamp;
+  }
+}
+
 static void panel_linestatus(struct nk_context *ctx, APPSTATE *state,
                              enum nk_collapse_states tab_states[TAB_COUNT],
                              float panel_width)
@@ -1485,6 +2940,7 @@ static void panel_linestatus(struct nk_context *ctx, APPSTATE *state,
 # define BUTTON_WIDTH  ((panel_width - LABEL_WIDTH) / 3 - 12)
 # define BUTTON_HEIGHT (ROW_HEIGHT * 0.6)
 
+  linestatus_update(state);
   const char *caption = "Line status";
   if (!rs232_isopen(state->hCom)) {
     nk_style_push_color(ctx, &ctx->style.tab.text, COLOUR_FG_RED);
@@ -1493,39 +2949,6 @@ static void panel_linestatus(struct nk_context *ctx, APPSTATE *state,
     caption = "No connection";
   }
   if (nk_tree_state_push(ctx, NK_TREE_TAB, caption, &tab_states[TAB_LINESTATUS])) {
-    /* update the status roughly every 0.1 second */
-    unsigned long tstamp = timestamp();
-    if (tstamp - state->linestat_tstamp >= 100) {
-      if (rs232_isopen(state->hCom)) {
-        unsigned delayedstat = 0;
-        if (state->breakdelay > 0) {
-          delayedstat = state->linestatus & (LINESTAT_LBREAK | LINESTAT_BREAK | LINESTAT_ERR);
-          state->breakdelay -= 1;
-          /* local break must be toggled of manually in Windows (it does not
-             need so in Linx, but it does no harm either) */
-          if (state->breakdelay == 0 && (delayedstat & LINESTAT_LBREAK) != 0)
-            rs232_setstatus(state->hCom, LINESTAT_LBREAK, 0);
-        }
-#       if defined _WIN32
-          /* Windows does not return the status that the host sets itself, so
-             these must be saved, and merged back in */
-          unsigned localstat = state->linestatus & (LINESTAT_RTS | LINESTAT_DTR);
-          delayedstat |= localstat;
-#       endif
-        state->linestatus = rs232_getstatus(state->hCom);
-        /* if a break or frame error are detected in the active states (as opposed
-           to the delayed status), make sure it stays "on" for long enough to
-           be visible */
-        if (state->linestatus & (LINESTAT_BREAK | LINESTAT_ERR))
-          state->breakdelay = 2;
-        state->linestatus |= delayedstat;
-      } else {
-        state->linestatus = 0;
-        state->breakdelay = 0;
-        state->hCom = NULL;
-      }
-      state->linestat_tstamp = tstamp;
-    }
 
     struct nk_color clr_on = COLOUR_BG_RED;
     struct nk_color clr_off = COLOUR_BG0;
@@ -1723,11 +3146,144 @@ static void panel_displayoptions(struct nk_context *ctx, APPSTATE *state,
 # undef SPACING
 
   if (state->reformat_view) {
+    state->reformat_view = false;
     for (DATALIST *item = datalist_root.next; item != NULL; item = item->next)
       reformat_data(state, item); /* re-format the block of data */
   }
 }
 
+static void panel_capture(struct nk_context *ctx, APPSTATE *state,
+                          enum nk_collapse_states tab_states[TAB_COUNT],
+                          float panel_width)
+{
+# define SPACING     4
+# define LABEL_WIDTH (5.5 * opt_fontsize)
+# define BROWSEBTN_WIDTH (1.5 * opt_fontsize)
+# define VALUE_WIDTH (panel_width - LABEL_WIDTH - (2 * SPACING + 18))
+
+  if (nk_tree_state_push(ctx, NK_TREE_TAB, "Capture", &tab_states[TAB_CAPTURE])) {
+    nk_layout_row_dynamic(ctx, ROW_HEIGHT, 1);
+    if (checkbox_tooltip(ctx, "Capture to file", &state->capture_enabled, NK_TEXT_LEFT,
+                         "Stream all received data to a file; data that drops out of the viewport can be loaded back from it"))
+      state->capture_restart = true;
+
+    nk_layout_row_begin(ctx, NK_STATIC, ROW_HEIGHT, 3);
+    nk_layout_row_push(ctx, LABEL_WIDTH);
+    nk_label(ctx, "File", NK_TEXT_ALIGN_LEFT | NK_TEXT_ALIGN_MIDDLE);
+    nk_layout_row_push(ctx, VALUE_WIDTH - BROWSEBTN_WIDTH - SPACING);
+    bool patherror = capture_failed();
+    if (patherror)
+      nk_style_push_color(ctx, &ctx->style.edit.text_normal, COLOUR_FG_RED);
+    int result = editctrl_tooltip(ctx, NK_EDIT_FIELD|NK_EDIT_SIG_ENTER,
+                                  state->capture_file, sizearray(state->capture_file),
+                                  nk_filter_ascii, "Capture file (it is overwritten)");
+    if (result & (NK_EDIT_COMMITED | NK_EDIT_DEACTIVATED))
+      state->capture_restart = true;
+    else if (result & NK_EDIT_ACTIVATED)
+      state->console_activate = 0;
+    if (patherror)
+      nk_style_pop_color(ctx);
+    nk_layout_row_push(ctx, BROWSEBTN_WIDTH);
+    if (nk_button_symbol(ctx, NK_SYMBOL_TRIPLE_DOT)) {
+      const char *filter = "Capture files\0*.cap\0All files\0*\0";
+      int res = noc_file_dialog_open(state->capture_file, sizearray(state->capture_file),
+                                     NOC_FILE_DIALOG_SAVE, filter, NULL,
+                                     state->capture_file, "Select capture file",
+                                     guidriver_apphandle());
+      if (res)
+        state->capture_restart = true;
+    }
+    nk_layout_row_end(ctx);
+
+    nk_layout_row_begin(ctx, NK_STATIC, ROW_HEIGHT, 2);
+    nk_layout_row_push(ctx, LABEL_WIDTH);
+    nk_label(ctx, "Max. size", NK_TEXT_ALIGN_LEFT | NK_TEXT_ALIGN_MIDDLE);
+    nk_layout_row_push(ctx, VALUE_WIDTH);
+    result = editctrl_tooltip(ctx, NK_EDIT_FIELD|NK_EDIT_SIG_ENTER,
+                              state->capture_maxsize, sizearray(state->capture_maxsize), nk_filter_decimal,
+                              "The maximum size of the capture file in MiB (the previous file is kept as a backup)");
+    nk_layout_row_end(ctx);
+    if ((result & (NK_EDIT_DEACTIVATED | NK_EDIT_COMMITED)) != 0) {
+      int size = strtol(state->capture_maxsize, NULL, 10);
+      if (size <= 0)
+        size = CAPTURE_DEFSIZE;
+      sprintf(state->capture_maxsize, "%d", size);
+      if (size != state->capture_maxsize_val) {
+        state->capture_maxsize_val = size;
+        state->capture_restart = true;
+      }
+    } else if (result & NK_EDIT_ACTIVATED) {
+      state->console_activate = 0;
+    }
+
+    nk_tree_state_pop(ctx);
+  }
+# undef LABEL_WIDTH
+# undef BROWSEBTN_WIDTH
+# undef VALUE_WIDTH
+# undef SPACING
+
+  if (state->capture_restart) {
+    state->capture_restart = false;
+    capture_stop();
+    if (state->capture_enabled && strlen(state->capture_file) > 0)
+      capture_start(state->capture_file, (long)state->capture_maxsize_val * 1024 * 1024);
+  }
+}
+
+static void panel_statistics(struct nk_context *ctx, APPSTATE *state,
+                             enum nk_collapse_states tab_states[TAB_COUNT],
+                             float panel_width)
+{
+# define LABEL_WIDTH (5.5 * opt_fontsize)
+# define VALUE_WIDTH (panel_width - LABEL_WIDTH - 18)
+
+  stats_update(&state->stats);
+  if (nk_tree_state_push(ctx, NK_TREE_TAB, "Statistics", &tab_states[TAB_STATISTICS])) {
+    char text[64];
+    const RECVSTATS *stats = &state->stats;
+    nk_layout_row_begin(ctx, NK_STATIC, ROW_HEIGHT, 2);
+    nk_layout_row_push(ctx, LABEL_WIDTH);
+    nk_label(ctx, "Bytes/s", NK_TEXT_ALIGN_LEFT | NK_TEXT_ALIGN_MIDDLE);
+    nk_layout_row_push(ctx, VALUE_WIDTH);
+    sprintf(text, "%.0f", stats->bytes_sec);
+    nk_label(ctx, text, NK_TEXT_ALIGN_LEFT | NK_TEXT_ALIGN_MIDDLE);
+    nk_layout_row_push(ctx, LABEL_WIDTH);
+    nk_label(ctx, "Lines/s", NK_TEXT_ALIGN_LEFT | NK_TEXT_ALIGN_MIDDLE);
+    nk_layout_row_push(ctx, VALUE_WIDTH);
+    sprintf(text, "%.0f", stats->lines_sec);
+    nk_label(ctx, text, NK_TEXT_ALIGN_LEFT | NK_TEXT_ALIGN_MIDDLE);
+    nk_layout_row_push(ctx, LABEL_WIDTH);
+    label_tooltip(ctx, "Max. gap", NK_TEXT_ALIGN_LEFT | NK_TEXT_ALIGN_MIDDLE,
+                  "Largest time between two reads from the port, in the last second");
+    nk_layout_row_push(ctx, VALUE_WIDTH);
+    sprintf(text, "%.3f ms", stats->maxgap / 1000.0);
+    nk_label(ctx, text, NK_TEXT_ALIGN_LEFT | NK_TEXT_ALIGN_MIDDLE);
+    nk_layout_row_push(ctx, LABEL_WIDTH);
+    nk_label(ctx, "Received", NK_TEXT_ALIGN_LEFT | NK_TEXT_ALIGN_MIDDLE);
+    nk_layout_row_push(ctx, VALUE_WIDTH);
+    sprintf(text, "%llu bytes", stats->total);
+    nk_label(ctx, text, NK_TEXT_ALIGN_LEFT | NK_TEXT_ALIGN_MIDDLE);
+    nk_layout_row_push(ctx, LABEL_WIDTH);
+    label_tooltip(ctx, "Overruns", NK_TEXT_ALIGN_LEFT | NK_TEXT_ALIGN_MIDDLE,
+                  "Number of times that the OS or the UART reported lost data");
+    nk_layout_row_push(ctx, VALUE_WIDTH);
+    sprintf(text, "%lu", stats->overruns);
+    nk_label_colored(ctx, text, NK_TEXT_ALIGN_LEFT | NK_TEXT_ALIGN_MIDDLE,
+                     (stats->overruns > 0) ? COLOUR_FG_RED : COLOUR_TEXT);
+    nk_layout_row_end(ctx);
+
+    nk_layout_row_dynamic(ctx, ROW_HEIGHT, 2);
+    nk_spacing(ctx, 1);
+    if (button_tooltip(ctx, "Reset", NK_KEY_NONE, nk_true, "Reset the totals"))
+      memset(&state->stats, 0, sizeof(RECVSTATS));
+
+    nk_tree_state_pop(ctx);
+  }
+# undef LABEL_WIDTH
+# undef VALUE_WIDTH
+}
+
 static void panel_transmitoptions(struct nk_context *ctx, APPSTATE *state,
                                   enum nk_collapse_states tab_states[TAB_COUNT],
                                   float panel_width)
@@ -1788,7 +3344,8 @@ static void panel_filters(struct nk_context *ctx, APPSTATE *state,
       next = flt->next; /* save pointer to next filter, for the case the current filter is delected */
       nk_layout_row_begin(ctx, NK_STATIC, ROW_HEIGHT, 4);
       nk_layout_row_push(ctx, ENABLED_WIDTH);
-      checkbox_tooltip(ctx, "", &flt->enabled, NK_TEXT_LEFT, "Enable / disable filter");
+      if (checkbox_tooltip(ctx, "", &flt->enabled, NK_TEXT_LEFT, "Enable / disable filter"))
+        filter_generation += 1;
       nk_layout_row_push(ctx, LABEL_WIDTH);
       struct nk_rect bounds = nk_widget_bounds(ctx);
       bounds.x -= SPACING;
@@ -1903,6 +3460,11 @@ static void panel_script(struct nk_context *ctx, APPSTATE *state,
 # undef BROWSEBTN_WIDTH
 # undef VALUE_WIDTH
 # undef SPACING
+
+  if (state->script_reload) {
+    state->script_reload = false;
+    script_setfile(state->scriptfile);
+  }
 }
 
 static void button_bar(struct nk_context *ctx, APPSTATE *state)
@@ -1921,16 +3483,25 @@ static void button_bar(struct nk_context *ctx, APPSTATE *state)
     datalist_clear();
   }
 
-  if (nk_button_label(ctx, "Save") || nk_input_is_key_pressed(&ctx->input, NK_KEY_SAVE)) {
+  if (state->export_percent >= 0) {
+    /* saving in the background, the button shows the progress and cancels */
+    char caption[32];
+    sprintf(caption, "Cancel (%d%%)", state->export_percent);
+    if (nk_button_label(ctx, caption))
+      export_cancel();
+  } else if (nk_button_label(ctx, "Save") || nk_input_is_key_pressed(&ctx->input, NK_KEY_SAVE)) {
     char path[_MAX_PATH];
     int res = noc_file_dialog_open(path, sizearray(path), NOC_FILE_DIALOG_SAVE,
-                                   "Text files\0*.txt\0All files\0*.*\0",
+                                   "Text files\0*.txt\0CSV files\0*.csv\0Binary files\0*.bin\0All files\0*.*\0",
                                    NULL, NULL, NULL, guidriver_apphandle());
     if (res) {
       const char *ext;
       if ((ext = strrchr(path, '.')) == NULL || strchr(ext, DIRSEP_CHAR) != NULL)
         strlcat(path, ".txt", sizearray(path)); /* default extension .txt */
-      save_data(path, state);
+      if (save_data(path, export_format(path, EXPORT_TEXT), state))
+        state->export_percent = 0;
+      else
+        save_message(state, "Failed to save the data.");
     }
   }
 
@@ -1947,8 +3518,10 @@ static void handle_stateaction(APPSTATE *state)
       const char* port = state->portlist[state->curport];
       state->hCom = rs232_open(port, state->baudrate, state->databits,
                                state->stopbits, state->parity, state->flowctrl);
-      if (state->hCom != NULL)
+      if (state->hCom != NULL) {
         rs232_framecheck(state->hCom, 1);
+        rs232_reader_start(state->hCom, guidriver_wake);
+      }
     }
     state->reconnect = false;
   }
@@ -1960,6 +3533,7 @@ int main(int argc, char *argv[])
   APPSTATE appstate;
   memset(&appstate, 0, sizeof appstate);
   appstate.reconnect = true;
+  appstate.export_percent = -1;
   appstate.baudrate = 9600;
   appstate.view = VIEW_TEXT;
   appstate.scrolltolast = nk_true;
@@ -1973,9 +3547,11 @@ int main(int argc, char *argv[])
   collect_portlist(&appstate);
   char txtConfigFile[_MAX_PATH];
   get_configfile(txtConfigFile, sizearray(txtConfigFile), "bmserial.ini");
+  ini_cache_open(txtConfigFile);  /* read settings from memory, write back on exit */
   enum nk_collapse_states tab_states[TAB_COUNT];
   SPLITTERBAR splitter_hor;
   load_settings(txtConfigFile, &appstate, tab_states, &splitter_hor);
+  appstate.capture_restart = true;
   /* other configuration */
   opt_fontsize = ini_getf("Settings", "fontsize", FONT_HEIGHT, txtConfigFile);
   char opt_fontstd[64] = "", opt_fontmono[64] = "";
@@ -2031,11 +3607,7 @@ int main(int argc, char *argv[])
     }
   }
 
-  tcl_init(&appstate.tcl);
-  tcl_register(&appstate.tcl, "exec", tcl_cmd_exec, 2, 2, &appstate);
-  tcl_register(&appstate.tcl, "puts", tcl_cmd_puts, 2, 2, &appstate);
-  tcl_register(&appstate.tcl, "serial", tcl_cmd_serial, 2, 3, &appstate);
-  tcl_register(&appstate.tcl, "wait", tcl_cmd_wait, 2, 4, &appstate);
+  script_start();
 
   struct nk_context *ctx = guidriver_init("BlackMagic Serial Monitor", canvas_width, canvas_height,
                                           GUIDRV_RESIZEABLE | GUIDRV_TIMER,
@@ -2047,6 +3619,7 @@ int main(int argc, char *argv[])
   for ( ;; ) {
     /* handle state */
     handle_stateaction(&appstate);
+    handle_export(&appstate);
 
     /* Input */
     nk_input_begin(ctx);
@@ -2082,7 +3655,8 @@ int main(int argc, char *argv[])
 
         /* monitor contents + input field */
         size_t received = process_data(&appstate);
-        waitidle = (received == 0);
+        received += script_poll(&appstate);
+        waitidle = (received == 0 && appstate.export_percent < 0);
         nk_layout_row_dynamic(ctx, canvas_height - 2 * ROW_HEIGHT - 4 * SPACING, 1);
         widget_monitor(ctx, "monitor", &appstate, opt_fontsize, NK_WINDOW_BORDER);
         widget_lineinput(ctx, &appstate);
@@ -2098,6 +3672,8 @@ int main(int argc, char *argv[])
         panel_portconfig(ctx, &appstate, tab_states, nk_hsplitter_colwidth(&splitter_hor, 1));
         panel_linestatus(ctx, &appstate, tab_states, nk_hsplitter_colwidth(&splitter_hor, 1));
         panel_displayoptions(ctx, &appstate, tab_states, nk_hsplitter_colwidth(&splitter_hor, 1));
+        panel_capture(ctx, &appstate, tab_states, nk_hsplitter_colwidth(&splitter_hor, 1));
+        panel_statistics(ctx, &appstate, tab_states, nk_hsplitter_colwidth(&splitter_hor, 1));
         panel_transmitoptions(ctx, &appstate, tab_states, nk_hsplitter_colwidth(&splitter_hor, 1));
         panel_filters(ctx, &appstate, tab_states, nk_hsplitter_colwidth(&splitter_hor, 1));
         panel_script(ctx, &appstate, tab_states, nk_hsplitter_colwidth(&splitter_hor, 1));
@@ -2133,13 +3709,12 @@ int main(int argc, char *argv[])
   save_settings(txtConfigFile, &appstate, tab_states, &splitter_hor);
   sprintf(valstr, "%d %d", canvas_width, canvas_height);
   ini_puts("Settings", "size", valstr, txtConfigFile);
+  ini_cache_close(txtConfigFile);
 
-  tcl_destroy(&appstate.tcl);
-  if (appstate.script != NULL)
-    free((void*)appstate.script);
-  if (appstate.script_recv != NULL)
-    free((void*)appstate.script_recv);
+  export_wait();
+  script_stop();
   filter_clear(&appstate.filter_root);
+  capture_stop();
   datalist_clear();
   free_portlist(&appstate);
   guidriver_close();
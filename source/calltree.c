@@ -51,13 +51,32 @@
 # define IS_OPTION(s)  ((s)[0] == '-')
 #endif
 
+typedef struct tagFUNCNAME {
+  struct tagFUNCNAME *next;     /* next name in the same hash bucket */
+  struct tagFUNCNAME *order;    /* reverse graph: next name, in order of first appearance */
+  struct tagFUNCDEF *nodes;     /* reverse graph: all call-tree nodes for this function */
+  struct tagFUNCDEF *lastnode;
+  char name[];
+} FUNCNAME;
+
+#define HIST_BINS     20        /* latency histogram: <1us, <2us, <4us, ... >=262ms */
+
 typedef struct tagFUNCDEF {
-  struct tagFUNCDEF *next;
-  char *name;
+  struct tagFUNCDEF *next;      /* next callee of the same caller */
+  FUNCNAME *func;
   int count;
-  bool skip;
+  int timed;                    /* number of calls that also have an exit timestamp */
+  double inclusive;             /* total duration of the calls (seconds) */
+  double exclusive;             /* duration minus the time spent in callees */
+  double mintime, maxtime;
+  double entertime;             /* timestamp of the active call */
+  double childtime;             /* time spent in callees during the active call */
+  unsigned histogram[HIST_BINS];
   struct tagFUNCDEF *caller;
-  struct tagFUNCDEF *callees;
+  struct tagFUNCDEF *callees;   /* list head (only "next" and "last" are used) */
+  struct tagFUNCDEF *last;      /* (list head only) last callee in the list */
+  struct tagFUNCDEF *hashnext;  /* next node in the same hash bucket */
+  struct tagFUNCDEF *samename;  /* reverse graph: next node for the same function */
 } FUNCDEF;
 
 enum {
@@ -66,8 +85,21 @@ enum {
   TYPE_EXIT,
 };
 
+enum {
+  OUTPUT_TREE,
+  OUTPUT_REVERSE,
+  OUTPUT_HOTPATHS,
+  OUTPUT_FOLDED,
+};
+
+#define NAME_BUCKETS  4096      /* must be a power of 2 */
+
 static FUNCDEF calltree = { NULL };
 static FUNCDEF *current = NULL;
+static FUNCNAME *nametable[NAME_BUCKETS];
+static FUNCDEF **nodetable = NULL;  /* hash table on (caller, function) */
+static size_t nodetable_size = 0;   /* number of buckets, a power of 2 */
+static size_t nodetable_count = 0;  /* number of nodes in the table */
 
 
 static const char *skipwhite(const char *text)
@@ -87,7 +119,7 @@ static const char *skiptodelim(const char *text, char delimiter)
 }
 
 static int match_function(const char *line, int channel, char *name, size_t namesize,
-                          const char *func_enter, const char *func_exit)
+                          double *timestamp, const char *func_enter, const char *func_exit)
 {
   assert(func_enter != NULL && strlen(func_enter) > 0);
   assert(func_exit != NULL && strlen(func_exit) > 0);
@@ -111,7 +143,10 @@ static int match_function(const char *line, int channel, char *name, size_t name
   ptr = skiptodelim(ptr, ',');
   if (*ptr == ',')
     ptr++;
-  /* skip timestamp */
+  /* get timestamp (in seconds) */
+  ptr = skipwhite(ptr);
+  if (timestamp != NULL)
+    *timestamp = strtod((*ptr == '"') ? ptr + 1 : ptr, NULL);
   ptr = skiptodelim(ptr, ',');
   if (*ptr == ',')
     ptr++;
@@ -137,125 +172,360 @@ static int match_function(const char *line, int channel, char *name, size_t name
   return result;
 }
 
-static void enter_function(const char *name)
+/* name_hash() returns the FNV-1a hash of a string */
+static unsigned name_hash(const char *name)
+{
+  assert(name != NULL);
+  unsigned hash = 2166136261u;
+  while (*name != '\0')
+    hash = (hash ^ (unsigned char)*name++) * 16777619u;
+  return hash;
+}
+
+/* intern_name() returns the unique record for the function name, so that
+   every node that refers to the same function shares the string (and names
+   can be compared on their pointers). */
+static FUNCNAME *intern_name(const char *name)
+{
+  assert(name != NULL);
+  unsigned bucket = name_hash(name) & (NAME_BUCKETS - 1);
+  FUNCNAME *func;
+  for (func = nametable[bucket]; func != NULL; func = func->next)
+    if (strcmp(func->name, name) == 0)
+      return func;
+
+  size_t len = strlen(name);
+  func = malloc(sizeof(FUNCNAME) + len + 1);
+  if (func != NULL) {
+    memset(func, 0, sizeof(FUNCNAME));
+    memcpy(func->name, name, len + 1);
+    func->next = nametable[bucket];
+    nametable[bucket] = func;
+  }
+  return func;
+}
+
+static void delete_names(void)
+{
+  for (int idx = 0; idx < NAME_BUCKETS; idx++) {
+    while (nametable[idx] != NULL) {
+      FUNCNAME *func = nametable[idx];
+      nametable[idx] = func->next;
+      free((void*)func);
+    }
+  }
+}
+
+/* node_bucket() returns the hash bucket for a callee of a caller; the caller
+   is NULL for the functions at the root level. */
+static size_t node_bucket(const FUNCDEF *caller, const FUNCNAME *func)
+{
+  assert(nodetable_size > 0);
+  size_t key = ((size_t)caller >> 3) * 31 + ((size_t)func >> 3);
+  key *= (size_t)0x9e3779b97f4a7c15ull;
+  return (key >> 16) & (nodetable_size - 1);
+}
+
+static bool node_grow(void)
+{
+  size_t newsize = (nodetable_size == 0) ? 1024 : 2 * nodetable_size;
+  FUNCDEF **newtable = calloc(newsize, sizeof(FUNCDEF*));
+  if (newtable == NULL)
+    return false;
+  FUNCDEF **oldtable = nodetable;
+  size_t oldsize = nodetable_size;
+  nodetable = newtable;
+  nodetable_size = newsize;
+  for (size_t idx = 0; idx < oldsize; idx++) {
+    while (oldtable[idx] != NULL) {
+      FUNCDEF *entry = oldtable[idx];
+      oldtable[idx] = entry->hashnext;
+      size_t bucket = node_bucket(entry->caller, entry->func);
+      entry->hashnext = nodetable[bucket];
+      nodetable[bucket] = entry;
+    }
+  }
+  if (oldtable != NULL)
+    free((void*)oldtable);
+  return true;
+}
+
+static void enter_function(const char *name, double timestamp)
 {
   assert(name != NULL);
+  FUNCNAME *func = intern_name(name);
+  if (func == NULL)
+    return;
 
   /* check whether this function is already among the callees of the current
      function */
-  FUNCDEF *localroot = (current != NULL) ? current->callees : &calltree;
-  assert(localroot != NULL);
+  if (nodetable_size == 0 && !node_grow())
+    return;
   FUNCDEF *entry;
-  for (entry = localroot->next; entry != NULL && strcmp(entry->name, name) != 0; entry = entry->next)
-    {}
+  for (entry = nodetable[node_bucket(current, func)]; entry != NULL; entry = entry->hashnext)
+    if (entry->caller == current && entry->func == func)
+      break;
   if (entry != NULL) {
     entry->count += 1;  /* this function was already called at this level -> just increment count */
+    entry->entertime = timestamp;
+    entry->childtime = 0.0;
     current = entry;
     return;
   }
 
   /* add entry */
+  if (nodetable_count >= nodetable_size)
+    node_grow();        /* on failure, just continue with longer hash chains */
   entry = malloc(sizeof(FUNCDEF));
   if (entry != NULL) {
     memset(entry, 0, sizeof(FUNCDEF));
     entry->callees = malloc(sizeof(FUNCDEF));
-    entry->name = strdup(name);
-    if (entry->callees != NULL && entry->name != NULL) {
+    if (entry->callees != NULL) {
+      entry->func = func;
       entry->count = 1;
+      entry->entertime = timestamp;
       entry->caller = current;
       memset(entry->callees, 0, sizeof(FUNCDEF));
-      FUNCDEF *pos = (current != NULL) ? current->callees : &calltree;
-      while (pos->next != NULL)
-        pos = pos->next;
-      pos->next = entry;
+      FUNCDEF *root = (current != NULL) ? current->callees : &calltree;
+      if (root->last != NULL)
+        root->last->next = entry;
+      else
+        root->next = entry;
+      root->last = entry;
+      size_t bucket = node_bucket(current, func);
+      entry->hashnext = nodetable[bucket];
+      nodetable[bucket] = entry;
+      nodetable_count += 1;
       current = entry;
     } else {
-      if (entry->callees != NULL)
-        free((void*)entry->callees);
-      if (entry->name != NULL)
-        free((void*)entry->name);
       free((void*)entry);
     }
   }
 }
 
-static void exit_function(const char *name)
+static void exit_function(const char *name, double timestamp)
 {
   if (current != NULL) {
-    assert(current->name != NULL);
-    if (strcmp(current->name, name) != 0)
-      fprintf(stderr, "Warning: exit function '%s' does not match entry for '%s'.\n", name, current->name);
+    assert(current->func != NULL);
+    if (strcmp(current->func->name, name) != 0)
+      fprintf(stderr, "Warning: exit function '%s' does not match entry for '%s'.\n", name, current->func->name);
+    double duration = timestamp - current->entertime;
+    if (duration < 0.0)
+      duration = 0.0;   /* timestamps are not monotonic (e.g. wrap-around) */
+    current->inclusive += duration;
+    current->exclusive += (duration > current->childtime) ? duration - current->childtime : 0.0;
+    if (current->timed == 0 || duration < current->mintime)
+      current->mintime = duration;
+    if (current->timed == 0 || duration > current->maxtime)
+      current->maxtime = duration;
+    current->timed += 1;
+    int bin = 0;
+    for (double limit = 1e-6; bin < HIST_BINS - 1 && duration >= limit; limit *= 2)
+      bin++;
+    current->histogram[bin] += 1;
     current = current->caller;
+    if (current != NULL)
+      current->childtime += duration;
   } else {
     fprintf(stderr, "Warning: exit function '%s' at call stack level 0.\n", name);
   }
 }
 
-static void print_graph(FUNCDEF *root, int level)
+/* format_time() formats a duration in seconds with a suitable unit */
+static const char *format_time(double seconds, char *buffer, size_t size)
+{
+  assert(buffer != NULL && size > 0);
+  if (seconds >= 1.0)
+    snprintf(buffer, size, "%.3f s", seconds);
+  else if (seconds >= 1e-3)
+    snprintf(buffer, size, "%.3f ms", seconds * 1e3);
+  else
+    snprintf(buffer, size, "%.1f us", seconds * 1e6);
+  return buffer;
+}
+
+static void print_timing(const FUNCDEF *entry)
+{
+  assert(entry != NULL);
+  if (entry->timed == 0)
+    return;
+  char field1[32], field2[32];
+  printf(" (total %s, self %s", format_time(entry->inclusive, field1, sizeof field1),
+         format_time(entry->exclusive, field2, sizeof field2));
+  if (entry->timed > 1)
+    printf(", min %s, max %s", format_time(entry->mintime, field1, sizeof field1),
+           format_time(entry->maxtime, field2, sizeof field2));
+  printf(")");
+}
+
+static void print_graph(FUNCDEF *root, int level, bool timing)
 {
   for (FUNCDEF *entry = root->next; entry != NULL; entry = entry->next) {
     for (int indent = 0; indent < level; indent++)
       printf("    ");
-    assert(entry->name != NULL);
-    printf("%s", entry->name);
+    assert(entry->func != NULL);
+    printf("%s", entry->func->name);
     if (entry->count > 1)
       printf(" [%dx]", entry->count);
+    if (timing)
+      print_timing(entry);
     printf("\n");
-    print_graph(entry->callees, level + 1);
+    print_graph(entry->callees, level + 1, timing);
   }
 }
 
-static FUNCDEF *findnext(FUNCDEF *root, const char *name)
+/* index_reverse() links all nodes of the same function together, in the
+   order of a post-order walk through the tree (callees before callers), and
+   links the function names in the order that they are first seen in that
+   walk. */
+static void index_reverse(FUNCDEF *root, FUNCNAME **lastname)
 {
-  if (root == NULL)
-    return NULL;
   for (FUNCDEF *entry = root->next; entry != NULL; entry = entry->next) {
-    FUNCDEF *sub = findnext(entry->callees, name);
-    assert(sub == NULL || sub->skip);
-    if (sub != NULL)
-      return sub;
-    if (!entry->skip && (name == NULL || strcmp(entry->name, name) == 0)) {
-      entry->skip = true;
-      return entry;
+    index_reverse(entry->callees, lastname);
+    FUNCNAME *func = entry->func;
+    assert(func != NULL);
+    if (func->nodes == NULL) {
+      func->nodes = entry;
+      (*lastname)->order = func;
+      *lastname = func;
+    } else {
+      func->lastnode->samename = entry;
     }
+    func->lastnode = entry;
   }
-  return NULL;
 }
 
 static void print_graph_reverse(FUNCDEF *root)
 {
-  FUNCDEF *entry;
-  while ((entry = findnext(root, NULL)) != NULL) {
-    entry->skip = true; /* don't find it again */
-    assert(entry->name != NULL);
-    printf("%s:\n", entry->name);
-    while (entry != NULL) {
+  FUNCNAME head = { NULL };
+  FUNCNAME *last = &head;
+  index_reverse(root, &last);
+  for (FUNCNAME *func = head.order; func != NULL; func = func->order) {
+    printf("%s:\n", func->name);
+    for (FUNCDEF *entry = func->nodes; entry != NULL; entry = entry->samename) {
       FUNCDEF *parent = entry->caller;
       int level = 1;
       while (parent != NULL) {
         for (int indent = 0; indent < level; indent++)
           printf("    ");
-        printf("%s", parent->name);
+        printf("%s", parent->func->name);
         if (parent->count > 1)
           printf(" [%dx]", parent->count);
         printf("\n");
         level += 1;
         parent = parent->caller;
       }
-      entry = findnext(root, entry->name);
     }
   }
 }
 
+/* print_path() prints the call path from the root to the node */
+static void print_path(const FUNCDEF *entry, const char *separator)
+{
+  assert(entry != NULL && entry->func != NULL);
+  if (entry->caller != NULL) {
+    print_path(entry->caller, separator);
+    printf("%s", separator);
+  }
+  printf("%s", entry->func->name);
+}
+
+static size_t collect_nodes(FUNCDEF *root, FUNCDEF **list, size_t count)
+{
+  for (FUNCDEF *entry = root->next; entry != NULL; entry = entry->next) {
+    list[count++] = entry;
+    count = collect_nodes(entry->callees, list, count);
+  }
+  return count;
+}
+
+static int compare_exclusive(const void *a, const void *b)
+{
+  const FUNCDEF *node1 = *(const FUNCDEF**)a;
+  const FUNCDEF *node2 = *(const FUNCDEF**)b;
+  if (node1->exclusive > node2->exclusive)
+    return -1;
+  if (node1->exclusive < node2->exclusive)
+    return 1;
+  return node2->count - node1->count;
+}
+
+/* print_hotpaths() lists the call paths with the highest exclusive time (i.e.
+   the time spent in the function itself), with the call statistics and the
+   latency histogram for each path. */
+static void print_hotpaths(FUNCDEF *root, int maxpaths)
+{
+  if (nodetable_count == 0)
+    return;
+  FUNCDEF **list = malloc(nodetable_count * sizeof(FUNCDEF*));
+  if (list == NULL) {
+    fprintf(stderr, "Memory allocation error.\n");
+    return;
+  }
+  size_t count = collect_nodes(root, list, 0);
+  assert(count == nodetable_count);
+  qsort(list, count, sizeof(FUNCDEF*), compare_exclusive);
+
+  double total = 0.0;
+  for (size_t idx = 0; idx < count; idx++)
+    total += list[idx]->exclusive;
+  if (maxpaths > 0 && (size_t)maxpaths < count)
+    count = maxpaths;
+  for (size_t idx = 0; idx < count; idx++) {
+    const FUNCDEF *entry = list[idx];
+    char field1[32], field2[32], field3[32];
+    printf("%5.1f%%  ", (total > 0.0) ? 100.0 * entry->exclusive / total : 0.0);
+    print_path(entry, " > ");
+    printf("\n        calls %d, self %s, total %s", entry->count,
+           format_time(entry->exclusive, field1, sizeof field1),
+           format_time(entry->inclusive, field2, sizeof field2));
+    if (entry->timed > 0)
+      printf(", min %s, max %s, avg %s", format_time(entry->mintime, field1, sizeof field1),
+             format_time(entry->maxtime, field2, sizeof field2),
+             format_time(entry->inclusive / entry->timed, field3, sizeof field3));
+    printf("\n");
+    if (entry->timed > 0) {
+      printf("        latency");
+      for (int bin = 0; bin < HIST_BINS; bin++) {
+        if (entry->histogram[bin] == 0)
+          continue;
+        unsigned long limit = 1ul << bin;
+        if (bin < HIST_BINS - 1)
+          printf(" <%luus:%u", limit, entry->histogram[bin]);
+        else
+          printf(" >=%luus:%u", limit >> 1, entry->histogram[bin]);
+      }
+      printf("\n");
+    }
+  }
+  free((void*)list);
+}
+
+/* print_folded() writes the call tree in the "folded stacks" format (one
+   line per call path, with the exclusive time in microseconds), as used by
+   flame graph tools. */
+static void print_folded(FUNCDEF *root)
+{
+  for (FUNCDEF *entry = root->next; entry != NULL; entry = entry->next) {
+    long usec = (long)(entry->exclusive * 1e6 + 0.5);
+    if (usec > 0) {
+      print_path(entry, ";");
+      printf(" %ld\n", usec);
+    }
+    print_folded(entry->callees);
+  }
+}
+
 static void delete_graph(FUNCDEF *root)
 {
   while (root->next != NULL) {
     FUNCDEF *entry = root->next;
     root->next = entry->next; /* unlink first */
-    free((void*)entry->name);
     delete_graph(entry->callees);
+    free((void*)entry->callees);
     free((void*)entry);
   }
+  root->last = NULL;
 }
 
 static void usage(int status)
@@ -268,6 +538,13 @@ static void usage(int status)
          "-c value        The channel number that contains the function entry/exit\n"
          "                traces. The default channel is 31.\n"
          "-r, --reverse   Create a reverse tree.\n"
+         "-t, --timing    Add the total & exclusive time and the minimum & maximum\n"
+         "                duration of each function to the tree.\n"
+         "--hot[=count]   List the call paths with the most exclusive time, with a\n"
+         "                latency histogram per path. The default count is 20 (use 0\n"
+         "                for all paths).\n"
+         "--folded        Output the exclusive time per call path as folded stacks\n"
+         "                (for flame graph tools).\n"
          "--enter=name    The name for the \"__cyg_profile_func_enter\" function in the\n"
          "                TSDL file. The default name is \"enter\".\n"
          "--exit=name     The name for the \"__cyg_profile_func_exit\" function in the TSDL\n"
@@ -295,7 +572,9 @@ int main(int argc, char *argv[])
     usage(EXIT_SUCCESS);
 
   int channel = 31;
-  bool reverse = false;
+  int output = OUTPUT_TREE;
+  bool timing = false;
+  int maxpaths = 20;
   char func_enter[64] = "enter";
   char func_exit[64] = "exit";
   char infile[_MAX_PATH] = "";
@@ -320,14 +599,26 @@ int main(int argc, char *argv[])
         }
         break;
       case 'r':
-        reverse = true;
+        output = OUTPUT_REVERSE;
+        break;
+      case 't':
+        timing = true;
         break;
       case 'v':
         version(EXIT_SUCCESS);
         break;
       case '-': /* long options, starting with double hyphen */
         if (strcmp(argv[idx] + 2, "reverse") == 0)
-          reverse = true;
+          output = OUTPUT_REVERSE;
+        else if (strcmp(argv[idx] + 2, "timing") == 0)
+          timing = true;
+        else if (strcmp(argv[idx] + 2, "hot") == 0)
+          output = OUTPUT_HOTPATHS;
+        else if (strncmp(argv[idx] + 2, "hot=", 4) == 0 && isdigit(argv[idx][6])) {
+          output = OUTPUT_HOTPATHS;
+          maxpaths = (int)strtol(argv[idx] + 6, NULL, 10);
+        } else if (strcmp(argv[idx] + 2, "folded") == 0)
+          output = OUTPUT_FOLDED;
         else if (strncmp(argv[idx] + 2, "enter=", 6) == 0 && strlen(argv[idx] + 8) > 0)
           strlcpy(func_enter, argv[idx] + 8, sizearray(func_enter));
         else if (strncmp(argv[idx] + 2, "exit=", 5) == 0 && strlen(argv[idx] + 7) > 0)
@@ -358,23 +649,37 @@ int main(int argc, char *argv[])
   char line[512];
   while (fgets(line, sizearray(line), fp) != NULL) {
     char name[256];
-    int type = match_function(line, channel, name, sizearray(name), func_enter, func_exit);
+    double timestamp = 0.0;
+    int type = match_function(line, channel, name, sizearray(name), &timestamp, func_enter, func_exit);
     switch (type) {
     case TYPE_ENTER:
-      enter_function(name);
+      enter_function(name, timestamp);
       break;
     case TYPE_EXIT:
-      exit_function(name);
+      exit_function(name, timestamp);
       break;
     }
   }
   fclose(fp);
 
-  if (reverse)
+  switch (output) {
+  case OUTPUT_TREE:
+    print_graph(&calltree, 0, timing);
+    break;
+  case OUTPUT_REVERSE:
     print_graph_reverse(&calltree);
-  else
-    print_graph(&calltree, 0);
+    break;
+  case OUTPUT_HOTPATHS:
+    print_hotpaths(&calltree, maxpaths);
+    break;
+  case OUTPUT_FOLDED:
+    print_folded(&calltree);
+    break;
+  }
   delete_graph(&calltree);
+  delete_names();
+  if (nodetable != NULL)
+    free((void*)nodetable);
   return EXIT_SUCCESS;
 }
 
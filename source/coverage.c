@@ -0,0 +1,382 @@
+/*
+ * Code coverage database, accumulated from PC samples. The database holds a
+ * bitmap with one bit per (16-bit aligned) code address; it is kept per ELF
+ * file, and databases of multiple sessions (or multiple devices running the
+ * same firmware) can be merged.
+ *
+ * Copyright 2026 CompuPhase
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "coverage.h"
+
+/* The bitmap is sparse: the code range is divided into pages, and a page is
+   only allocated when the first address in it is marked. Merging two
+   databases is a word-wise OR of the pages that are present in the source;
+   this is fast, even for databases that span a large code range. */
+#define COVERAGE_ALIGN  2   /* alignment of an address in bytes (16-bit Thumb) */
+#define PAGE_SHIFT      12  /* slots per page (as a power of 2) */
+#define PAGE_SLOTS      (1u << PAGE_SHIFT)
+#define PAGE_WORDS      (PAGE_SLOTS / 64)
+
+#define COVERAGE_MAGIC  "BMCOV\x1a\x01\x00"  /* signature + version */
+
+typedef struct tagCOVPAGE {
+  uint64_t bits[PAGE_WORDS];
+} COVPAGE;
+
+struct tagCOVERAGE {
+  uint32_t code_base, code_top;
+  uint32_t elf_id;              /* identification of the ELF file (checksum of the code) */
+  unsigned sessions;            /* number of sessions merged into the database */
+  unsigned numslots;
+  unsigned numpages;
+  COVPAGE **pages;              /* page table, NULL for pages without marked addresses */
+};
+
+static int popcount64(uint64_t value)
+{
+# if defined __GNUC__
+    return __builtin_popcountll(value);
+# else
+    int count = 0;
+    while (value != 0) {
+      value &= value - 1;   /* clear the lowest set bit */
+      count++;
+    }
+    return count;
+# endif
+}
+
+/** coverage_create() allocates an (empty) coverage database for a code range.
+ *
+ *  \param code_base    The lowest address of the code range.
+ *  \param code_top     The address just above the code range.
+ *  \param elf_id       An identification of the ELF file, such as a checksum
+ *                      of the code; only databases with the same ID can be
+ *                      merged.
+ *
+ *  \return The database, or NULL on a memory allocation failure.
+ *
+ *  \note The session count of a new database is 1.
+ */
+COVERAGE *coverage_create(uint32_t code_base, uint32_t code_top, uint32_t elf_id)
+{
+  assert(code_top >= code_base);
+  COVERAGE *cov = malloc(sizeof(COVERAGE));
+  if (cov == NULL)
+    return NULL;
+  memset(cov, 0, sizeof(COVERAGE));
+  cov->code_base = code_base;
+  cov->code_top = code_top;
+  cov->elf_id = elf_id;
+  cov->sessions = 1;
+  cov->numslots = (code_top - code_base) / COVERAGE_ALIGN;
+  cov->numpages = (cov->numslots + PAGE_SLOTS - 1) >> PAGE_SHIFT;
+  cov->pages = malloc((cov->numpages + 1) * sizeof(COVPAGE*));
+  if (cov->pages == NULL) {
+    free(cov);
+    return NULL;
+  }
+  memset(cov->pages, 0, (cov->numpages + 1) * sizeof(COVPAGE*));
+  return cov;
+}
+
+/** coverage_delete() frees a coverage database and all of its pages.
+ */
+void coverage_delete(COVERAGE *cov)
+{
+  if (cov != NULL) {
+    for (unsigned idx = 0; idx < cov->numpages; idx++)
+      if (cov->pages[idx] != NULL)
+        free(cov->pages[idx]);
+    free(cov->pages);
+    free(cov);
+  }
+}
+
+static COVPAGE *coverage_page(COVERAGE *cov, unsigned pageidx)
+{
+  assert(pageidx < cov->numpages);
+  if (cov->pages[pageidx] == NULL) {
+    cov->pages[pageidx] = malloc(sizeof(COVPAGE));
+    if (cov->pages[pageidx] != NULL)
+      memset(cov->pages[pageidx], 0, sizeof(COVPAGE));
+  }
+  return cov->pages[pageidx];
+}
+
+/** coverage_mark() marks an address as executed. Addresses outside the code
+ *  range are ignored.
+ */
+void coverage_mark(COVERAGE *cov, uint32_t address)
+{
+  assert(cov != NULL);
+  if (address < cov->code_base || address >= cov->code_top)
+    return;
+  unsigned slot = (address - cov->code_base) / COVERAGE_ALIGN;
+  COVPAGE *page = coverage_page(cov, slot >> PAGE_SHIFT);
+  if (page != NULL) {
+    slot &= PAGE_SLOTS - 1;
+    page->bits[slot / 64] |= (uint64_t)1 << (slot % 64);
+  }
+}
+
+/** coverage_test() returns whether any address in a range is marked.
+ *
+ *  \param cov      The coverage database.
+ *  \param low      The lowest address of the range.
+ *  \param high     The address just above the range.
+ *
+ *  \return true if at least one address in the range is marked.
+ */
+bool coverage_test(const COVERAGE *cov, uint32_t low, uint32_t high)
+{
+  assert(cov != NULL);
+  if (low < cov->code_base)
+    low = cov->code_base;
+  if (high > cov->code_top)
+    high = cov->code_top;
+  if (low >= high)
+    return false;
+  unsigned first = (low - cov->code_base) / COVERAGE_ALIGN;
+  unsigned last = (high - cov->code_base + COVERAGE_ALIGN - 1) / COVERAGE_ALIGN;  /* exclusive */
+  while (first < last) {
+    const COVPAGE *page = cov->pages[first >> PAGE_SHIFT];
+    unsigned pagetop = ((first >> PAGE_SHIFT) + 1) << PAGE_SHIFT;
+    unsigned stop = (last < pagetop) ? last : pagetop;
+    if (page != NULL) {
+      for (unsigned slot = first; slot < stop; ) {
+        unsigned bit = slot & 63;
+        unsigned span = 64 - bit;
+        if (span > stop - slot)
+          span = stop - slot;
+        uint64_t mask = (span == 64) ? ~(uint64_t)0 : (((uint64_t)1 << span) - 1) << bit;
+        if ((page->bits[(slot & (PAGE_SLOTS - 1)) / 64] & mask) != 0)
+          return true;
+        slot += span;
+      }
+    }
+    first = stop;
+  }
+  return false;
+}
+
+/** coverage_count() returns the number of marked addresses (each address is
+ *  a 16-bit slot).
+ */
+unsigned coverage_count(const COVERAGE *cov)
+{
+  assert(cov != NULL);
+  unsigned count = 0;
+  for (unsigned idx = 0; idx < cov->numpages; idx++) {
+    const COVPAGE *page = cov->pages[idx];
+    if (page != NULL)
+      for (unsigned w = 0; w < PAGE_WORDS; w++)
+        count += popcount64(page->bits[w]);
+  }
+  return count;
+}
+
+/** coverage_merge() adds the marked addresses of a database into another
+ *  (the union of both), and adds the session counts.
+ *
+ *  \param cov      The database that is updated.
+ *  \param src      The database that is merged into "cov".
+ *
+ *  \return COVERR_NONE on success, COVERR_MISMATCH if the databases are for
+ *          different ELF files, or COVERR_MEMORY on an allocation failure.
+ */
+int coverage_merge(COVERAGE *cov, const COVERAGE *src)
+{
+  assert(cov != NULL && src != NULL);
+  if (cov->elf_id != src->elf_id || cov->code_base != src->code_base || cov->code_top != src->code_top)
+    return COVERR_MISMATCH;
+  for (unsigned idx = 0; idx < src->numpages; idx++) {
+    const COVPAGE *srcpage = src->pages[idx];
+    if (srcpage == NULL)
+      continue;
+    if (cov->pages[idx] == NULL) {
+      cov->pages[idx] = malloc(sizeof(COVPAGE));
+      if (cov->pages[idx] == NULL)
+        return COVERR_MEMORY;
+      memcpy(cov->pages[idx], srcpage, sizeof(COVPAGE));
+    } else {
+      COVPAGE *page = cov->pages[idx];
+      for (unsigned w = 0; w < PAGE_WORDS; w++)
+        page->bits[w] |= srcpage->bits[w];
+    }
+  }
+  cov->sessions += src->sessions;
+  return COVERR_NONE;
+}
+
+/* the file holds all values in Little Endian, so that a database can be
+   merged with one that was collected on a host with a different byte order */
+static bool write_u32(FILE *fp, uint32_t value)
+{
+  unsigned char buffer[4];
+  for (int i = 0; i < 4; i++)
+    buffer[i] = (unsigned char)(value >> (8 * i));
+  return fwrite(buffer, 1, sizeof buffer, fp) == sizeof buffer;
+}
+
+static bool read_u32(FILE *fp, uint32_t *value)
+{
+  unsigned char buffer[4];
+  if (fread(buffer, 1, sizeof buffer, fp) != sizeof buffer)
+    return false;
+  *value = buffer[0] | ((uint32_t)buffer[1] << 8) | ((uint32_t)buffer[2] << 16) | ((uint32_t)buffer[3] << 24);
+  return true;
+}
+
+/** coverage_load() reads a coverage database from a file.
+ *
+ *  \param cov        Will be set to the database that is read (or to NULL on
+ *                    failure). It must be freed with coverage_delete().
+ *  \param filename   The path to the file.
+ *
+ *  \return COVERR_NONE on success, or an error code on failure.
+ */
+int coverage_load(COVERAGE **cov, const char *filename)
+{
+  assert(cov != NULL && filename != NULL);
+  *cov = NULL;
+  FILE *fp = fopen(filename, "rb");
+  if (fp == NULL)
+    return COVERR_FILEOPEN;
+
+  char magic[8];
+  uint32_t code_base, code_top, elf_id, sessions, count;
+  if (fread(magic, 1, sizeof magic, fp) != sizeof magic || memcmp(magic, COVERAGE_MAGIC, sizeof magic) != 0
+      || !read_u32(fp, &elf_id) || !read_u32(fp, &code_base) || !read_u32(fp, &code_top)
+      || !read_u32(fp, &sessions) || !read_u32(fp, &count) || code_top < code_base) {
+    fclose(fp);
+    return COVERR_FORMAT;
+  }
+  COVERAGE *db = coverage_create(code_base, code_top, elf_id);
+  if (db == NULL) {
+    fclose(fp);
+    return COVERR_MEMORY;
+  }
+  db->sessions = sessions;
+  int result = COVERR_NONE;
+  while (count-- > 0 && result == COVERR_NONE) {
+    uint32_t pageidx;
+    if (!read_u32(fp, &pageidx) || pageidx >= db->numpages) {
+      result = COVERR_FORMAT;
+      break;
+    }
+    COVPAGE *page = coverage_page(db, pageidx);
+    if (page == NULL) {
+      result = COVERR_MEMORY;
+      break;
+    }
+    for (unsigned w = 0; w < PAGE_WORDS && result == COVERR_NONE; w++) {
+      uint32_t lo, hi;
+      if (read_u32(fp, &lo) && read_u32(fp, &hi))
+        page->bits[w] = ((uint64_t)hi << 32) | lo;
+      else
+        result = COVERR_FORMAT;
+    }
+  }
+  fclose(fp);
+  if (result != COVERR_NONE)
+    coverage_delete(db);
+  else
+    *cov = db;
+  return result;
+}
+
+/** coverage_save() writes a coverage database to a file (replacing the file,
+ *  if it exists). Only the pages with marked addresses are stored.
+ *
+ *  \return true on success, false on failure.
+ */
+bool coverage_save(const COVERAGE *cov, const char *filename)
+{
+  assert(cov != NULL && filename != NULL);
+  FILE *fp = fopen(filename, "wb");
+  if (fp == NULL)
+    return false;
+  uint32_t count = 0;
+  for (unsigned idx = 0; idx < cov->numpages; idx++)
+    if (cov->pages[idx] != NULL)
+      count++;
+  bool ok = fwrite(COVERAGE_MAGIC, 1, 8, fp) == 8
+            && write_u32(fp, cov->elf_id) && write_u32(fp, cov->code_base) && write_u32(fp, cov->code_top)
+            && write_u32(fp, cov->sessions) && write_u32(fp, count);
+  for (unsigned idx = 0; idx < cov->numpages && ok; idx++) {
+    const COVPAGE *page = cov->pages[idx];
+    if (page == NULL)
+      continue;
+    ok = write_u32(fp, idx);
+    for (unsigned w = 0; w < PAGE_WORDS && ok; w++)
+      ok = write_u32(fp, (uint32_t)page->bits[w]) && write_u32(fp, (uint32_t)(page->bits[w] >> 32));
+  }
+  if (fclose(fp) != 0)
+    ok = false;
+  return ok;
+}
+
+/** coverage_accumulate() merges a database into the database in a file, and
+ *  writes the result back to the file. If the file does not exist yet, it is
+ *  created.
+ *
+ *  \param cov        The database to add to the file.
+ *  \param filename   The path to the file.
+ *
+ *  \return COVERR_NONE on success, or an error code on failure.
+ *
+ *  \note If the file holds a database for a different ELF file (or a
+ *        different build of the ELF file), the file is left unchanged and
+ *        COVERR_MISMATCH is returned.
+ */
+int coverage_accumulate(const COVERAGE *cov, const char *filename)
+{
+  assert(cov != NULL && filename != NULL);
+  COVERAGE *db;
+  int result = coverage_load(&db, filename);
+  if (result == COVERR_FILEOPEN)
+    return coverage_save(cov, filename) ? COVERR_NONE : COVERR_FILEOPEN;
+  if (result != COVERR_NONE)
+    return result;
+  result = coverage_merge(db, cov);
+  if (result == COVERR_NONE && !coverage_save(db, filename))
+    result = COVERR_FILEOPEN;
+  coverage_delete(db);
+  return result;
+}
+
+/** coverage_elf_id() returns the identification of the ELF file that the
+ *  database was created for.
+ */
+uint32_t coverage_elf_id(const COVERAGE *cov)
+{
+  assert(cov != NULL);
+  return cov->elf_id;
+}
+
+/** coverage_sessions() returns the number of sessions that were merged into
+ *  the database.
+ */
+unsigned coverage_sessions(const COVERAGE *cov)
+{
+  assert(cov != NULL);
+  return cov->sessions;
+}
@@ -0,0 +1,60 @@
+/*
+ * Code coverage database, accumulated from PC samples. The database holds a
+ * bitmap with one bit per (16-bit aligned) code address; it is kept per ELF
+ * file, and databases of multiple sessions (or multiple devices running the
+ * same firmware) can be merged.
+ *
+ * Copyright 2026 CompuPhase
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef _COVERAGE_H
+#define _COVERAGE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#if defined __cplusplus
+  extern "C" {
+#endif
+
+typedef struct tagCOVERAGE COVERAGE;
+
+enum {
+  COVERR_NONE,
+  COVERR_FILEOPEN,    /* file cannot be opened */
+  COVERR_FORMAT,      /* not a coverage database (or corrupted) */
+  COVERR_MISMATCH,    /* database is for a different ELF file */
+  COVERR_MEMORY,      /* memory allocation error */
+};
+
+COVERAGE *coverage_create(uint32_t code_base, uint32_t code_top, uint32_t elf_id);
+void coverage_delete(COVERAGE *cov);
+
+void coverage_mark(COVERAGE *cov, uint32_t address);
+bool coverage_test(const COVERAGE *cov, uint32_t low, uint32_t high);
+unsigned coverage_count(const COVERAGE *cov);
+
+int coverage_merge(COVERAGE *cov, const COVERAGE *src);
+int coverage_load(COVERAGE **cov, const char *filename);
+bool coverage_save(const COVERAGE *cov, const char *filename);
+int coverage_accumulate(const COVERAGE *cov, const char *filename);
+
+uint32_t coverage_elf_id(const COVERAGE *cov);
+unsigned coverage_sessions(const COVERAGE *cov);
+
+#if defined __cplusplus
+  }
+#endif
+
+#endif /* _COVERAGE_H */
@@ -73,6 +73,26 @@ static const unsigned long crc_table[256] =
   0xbcb4666d, 0xb8757bda, 0xb5365d03, 0xb1f740b4
 };
 
+/* Tables for "slicing-by-8": crc_slice[k][i] is the CRC contribution of byte
+   value i followed by k zero bytes. Table 0 is equal to crc_table. The tables
+   are built on first use. */
+static uint32_t crc_slice[8][256];
+static int crc_slice_init = 0;
+
+static void crc_slice_build(void)
+{
+  int i, k;
+  for (i = 0; i < 256; i++)
+    crc_slice[0][i] = (uint32_t)crc_table[i];
+  for (k = 1; k < 8; k++) {
+    for (i = 0; i < 256; i++) {
+      uint32_t c = crc_slice[k - 1][i];
+      crc_slice[k][i] = (c << 8) ^ crc_slice[0][c >> 24];
+    }
+  }
+  crc_slice_init = 1;
+}
+
 /** gdb_crc32()
  *  \param crc    The initial CRC, set to ~0 on the first call.
  *  \param data   The data block to calculate the CRC on.
@@ -87,8 +107,49 @@ static const unsigned long crc_table[256] =
  */
 uint32_t gdb_crc32(uint32_t crc, const unsigned char *data, unsigned size)
 {
+  if (size >= 16) {
+    if (!crc_slice_init)
+      crc_slice_build();
+    /* handle 8 bytes per iteration; the bytes are assembled in big-endian
+       order (the CRC is not reflected), which is independent of the byte
+       order of the host */
+    while (size >= 8) {
+      uint32_t hi = crc ^ (((uint32_t)data[0] << 24) | ((uint32_t)data[1] << 16)
+                           | ((uint32_t)data[2] << 8) | (uint32_t)data[3]);
+      uint32_t lo = ((uint32_t)data[4] << 24) | ((uint32_t)data[5] << 16)
+                    | ((uint32_t)data[6] << 8) | (uint32_t)data[7];
+      crc = crc_slice[7][hi >> 24] ^ crc_slice[6][(hi >> 16) & 0xff]
+            ^ crc_slice[5][(hi >> 8) & 0xff] ^ crc_slice[4][hi & 0xff]
+            ^ crc_slice[3][lo >> 24] ^ crc_slice[2][(lo >> 16) & 0xff]
+            ^ crc_slice[1][(lo >> 8) & 0xff] ^ crc_slice[0][lo & 0xff];
+      data += 8;
+      size -= 8;
+    }
+  }
   while (size--)
     crc = (crc << 8) ^ crc_table[((crc >> 24) ^ *data++) & 0xff];
   return crc;
 }
 
+
+/* CRC32 as used by zlib, Ethernet and many serial protocols (the reflected
+   variant of the same polynomial). Unlike gdb_crc32(), the pre- and
+   post-conditioning is done inside the function, so the initial value is 0
+   and the function can be called again on the next block of data. A nibble
+   table is used, because the function is not used for bulk data. */
+uint32_t crc32_ieee(uint32_t crc, const unsigned char *data, unsigned size)
+{
+  static const uint32_t crc_nibble[16] = {
+    0x00000000, 0x1db71064, 0x3b6e20c8, 0x26d930ac,
+    0x76dc4190, 0x6b6b51f4, 0x4db26158, 0x5005713c,
+    0xedb88320, 0xf00f9344, 0xd6d6a3e8, 0xcb61b38c,
+    0x9b64c2b0, 0x86d3d2d4, 0xa00ae278, 0xbdbdf21c
+  };
+  crc = ~crc;
+  while (size--) {
+    crc ^= *data++;
+    crc = (crc >> 4) ^ crc_nibble[crc & 0x0f];
+    crc = (crc >> 4) ^ crc_nibble[crc & 0x0f];
+  }
+  return ~crc;
+}
@@ -4,4 +4,8 @@
   extern "C"
 #endif
 uint32_t gdb_crc32(uint32_t crc, const unsigned char *data, unsigned size);
+#if defined __cplusplus
+  extern "C"
+#endif
+uint32_t crc32_ieee(uint32_t crc, const unsigned char *data, unsigned size);
 
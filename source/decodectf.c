@@ -36,8 +36,14 @@
 # define strdup(s)   _strdup(s)
 # define alloca(a)   _alloca(a)
 #endif
+#if defined _WIN32
+# include <direct.h>
+#else
+# include <sys/stat.h>
+# include <sys/types.h>
+#endif
 
-#include "demangle.h"
+#include "c11threads.h"
 #include "parsetsdl.h"
 #include "decodectf.h"
 
@@ -50,12 +56,65 @@
 # define sizearray(a)  (sizeof(a) / sizeof((a)[0]))
 #endif
 
+/* header of a message in the message stack; the message text (with a
+   terminating zero byte) follows the header */
 typedef struct tagTRACEMSG {
-  uint16_t streamid;
   double timestamp;
-  const char *message;
+  uint16_t streamid;
+  uint16_t flags;
+  uint32_t length;      /* length of the text, excluding the zero byte */
 } TRACEMSG;
 
+#define MSGSTACK_INITIAL  16384
+#define MSGSTACK_WRAP     0x01    /* record is a marker for the end of the buffer */
+#define MSGSTACK_RECSIZE(len) \
+          ((sizeof(TRACEMSG) + (len) + 1 + sizeof(double) - 1) & ~(sizeof(double) - 1))
+
+/* operations in a compiled event decoder; each operation appends its literal
+   text and then formats a value (except OP_TEXT, which has no value) */
+enum {
+  OP_TEXT,
+  OP_UINT32,
+  OP_INT32,
+  OP_UINT64,
+  OP_INT64,
+  OP_SYMBOL,    /* 32-bit address, looked up in the symbol table */
+  OP_FLOAT,
+  OP_DOUBLE,
+  OP_ENUM,
+  OP_STRING,
+};
+
+typedef struct tagDECODEOP {
+  uint8_t opcode;
+  uint8_t base;         /* numeric base, for integers */
+  uint8_t size;         /* size of the value in bytes */
+  uint8_t bits;         /* size of the value in bits (for sign extension) */
+  uint8_t swap;         /* value is stored in Big Endian */
+  uint32_t offset;      /* offset of the value in the field data */
+  uint32_t text;        /* offset of the literal text in the text pool */
+  uint32_t textlength;  /* length of the literal text */
+  const CTF_KEYVALUE *keys; /* list of names, for enum */
+} DECODEOP;
+
+typedef struct tagDECODEUNIT {
+  uint32_t size;        /* size of the field in bytes, 0 for a string */
+  unsigned first;       /* index of the first operation for the field */
+  unsigned count;       /* number of operations for the field */
+} DECODEUNIT;
+
+typedef struct tagDECODEPROG {
+  struct tagDECODEPROG *next;
+  const CTF_EVENT *event;
+  DECODEUNIT *units;    /* top-level fields, each read from the stream as a whole */
+  unsigned numunits;
+  DECODEOP *ops;
+  unsigned numops;
+  char *text;           /* pool for the literal text of all operations */
+} DECODEPROG;
+
+#define PROGRAM_MAXID 0xffff  /* event id's above this are not in the index */
+
 static const unsigned char magic[] = { 0xc1, 0x1f, 0xfc, 0xc1 };
 
 enum {
@@ -66,175 +125,255 @@ enum {
   STATE_GET_TIMESTAMP,
   STATE_GET_FIELDS,
 };
-static int state = STATE_SCAN_MAGIC;                /* current state */
-static const CTF_PACKET_HEADER *pkt_header = NULL;  /* general packet header definition */
-static const CTF_EVENT_HEADER *evt_header = NULL;   /* event header definition for "current" stream */
-static const CTF_EVENT *event = NULL;               /* event currently being parsed */
-static const CTF_EVENT_FIELD *field = NULL;         /* field currently being parsed */
-static const CTF_CLOCK *clock;                      /* clock set for the stream */
-static double timestamp = 0.0;                      /* timestamp in the event header */
+/* recording of the events to a CTF trace directory */
+#define RECORD_MAXSTREAMS 32    /* stream id's are limited to 0..31 (see stream_isactive()) */
+#define RECORD_BUFSIZE    65536
+
+/* direct-mapped cache of symbol look-ups (including failed look-ups), with
+   the names already demangled */
+#define SYMCACHE_BITS     8
+#define SYMCACHE_NAMESIZE 128
+typedef struct tagSYMCACHE {
+  uint32_t address;
+  uint8_t valid;
+  uint8_t found;
+  char name[SYMCACHE_NAMESIZE];
+} SYMCACHE;
+
+/* all state of a decoder; a thread decodes with the default decoder, unless it
+   has selected one of its own (so that streams can be decoded concurrently) */
+struct tagCTF_DECODER {
+  CTF_MODEL *model;                   /* parsed TSDL (NULL for the default model) */
+  int state;                          /* current state */
+  const CTF_PACKET_HEADER *pkt_header;/* general packet header definition */
+  const CTF_EVENT_HEADER *evt_header; /* event header definition for "current" stream */
+  const CTF_EVENT *event;             /* event currently being parsed */
+  const DECODEPROG *program;          /* compiled decoder for the event */
+  unsigned unit;                      /* field currently being parsed */
+  const CTF_CLOCK *clock;             /* clock set for the stream */
+  double timestamp;                   /* timestamp in the event header */
+
+  unsigned char *cache;
+  size_t cache_size;
+  size_t cache_filled;
 
-static unsigned char *cache = NULL;
-static size_t cache_size = 0;
-static size_t cache_filled = 0;
+  char *msgbuffer;
+  size_t msgbuffer_size;
+  size_t msgbuffer_filled;
 
-static char *msgbuffer = NULL;
-static size_t msgbuffer_size = 0;
-static size_t msgbuffer_filled = 0;
+  unsigned char *msgstack;            /* circular buffer with variable-length records */
+  size_t msgstack_size;
+  size_t msgstack_head;
+  size_t msgstack_tail;
+  unsigned msgstack_count;
 
-static TRACEMSG *msgstack = NULL;
-static size_t msgstack_size = 0;
-static size_t msgstack_head = 0;
-static size_t msgstack_tail = 0;
+  DECODEPROG program_root;
+  DECODEPROG **program_index;         /* compiled decoders, by event id */
+  int program_indexsize;
 
-static const DWARF_SYMBOLLIST *symboltable = NULL;
+  const DWARF_SYMBOLLIST *symboltable;
+
+  char *record_path;
+  FILE *record_files[RECORD_MAXSTREAMS];
+  bool record_notext;                 /* skip text formatting */
+  bool record_capturing;              /* bytes of the current event are collected */
+  size_t record_from;                 /* start of the event in the current input buffer */
+  unsigned char *record_buffer;       /* bytes of the event from earlier input buffers */
+  size_t record_size;
+  size_t record_filled;
+
+  bool watch;                         /* scan for a single event (no text) */
+  int watch_id;                       /* event that is scanned for */
+
+  SYMCACHE symcache[1 << SYMCACHE_BITS];
+};
+
+static CTF_DECODER default_decoder = { NULL, STATE_SCAN_MAGIC };
+static thread_local CTF_DECODER *current_decoder = NULL;
+
+static inline CTF_DECODER *decoder(void)
+{
+  return (current_decoder != NULL) ? current_decoder : &default_decoder;
+}
 
 
 static void cache_grow(size_t extra)
 {
-  if (cache_filled + extra > cache_size) {
-    if (cache_size == 0)
-      cache_size = 32;
-    while (cache_size < cache_filled + extra)
-      cache_size *= 2;
-    if (cache == NULL) {
-      cache = (unsigned char*)malloc(cache_size);
+  CTF_DECODER *dec = decoder();
+  if (dec->cache_filled + extra > dec->cache_size) {
+    if (dec->cache_size == 0)
+      dec->cache_size = 32;
+    while (dec->cache_size < dec->cache_filled + extra)
+      dec->cache_size *= 2;
+    if (dec->cache == NULL) {
+      dec->cache = (unsigned char*)malloc(dec->cache_size);
     } else {
-      unsigned char *newcache = (unsigned char*)realloc(cache, cache_size);
+      unsigned char *newcache = (unsigned char*)realloc(dec->cache, dec->cache_size);
       if (newcache == NULL)
-        free((void*)cache);
-      cache = newcache;
+        free((void*)dec->cache);
+      dec->cache = newcache;
     }
-    assert(cache != NULL);  /* should be handled as a run-time error */
+    assert(dec->cache != NULL);  /* should be handled as a run-time error */
   }
 }
 
 static void cache_clear(void)
 {
-  if (cache != NULL) {
-    free((void*)cache);
-    cache = NULL;
+  CTF_DECODER *dec = decoder();
+  if (dec->cache != NULL) {
+    free((void*)dec->cache);
+    dec->cache = NULL;
   }
-  cache_size = 0;
-  cache_filled = 0;
+  dec->cache_size = 0;
+  dec->cache_filled = 0;
 }
 
 static void cache_reset(void)
 {
-  cache_filled = 0;
+  CTF_DECODER *dec = decoder();
+  dec->cache_filled = 0;
 }
 
 static void msgbuffer_grow(size_t extra)
 {
-  if (msgbuffer_filled + extra > msgbuffer_size) {
-    if (msgbuffer_size == 0)
-      msgbuffer_size = 32;
-    while (msgbuffer_size < msgbuffer_filled + extra)
-      msgbuffer_size *= 2;
-    if (msgbuffer == NULL) {
-      msgbuffer = (char*)malloc(msgbuffer_size);
+  CTF_DECODER *dec = decoder();
+  if (dec->msgbuffer_filled + extra > dec->msgbuffer_size) {
+    if (dec->msgbuffer_size == 0)
+      dec->msgbuffer_size = 32;
+    while (dec->msgbuffer_size < dec->msgbuffer_filled + extra)
+      dec->msgbuffer_size *= 2;
+    if (dec->msgbuffer == NULL) {
+      dec->msgbuffer = (char*)malloc(dec->msgbuffer_size);
     } else {
-      char *newbuffer = (char*)realloc(msgbuffer, msgbuffer_size);
+      char *newbuffer = (char*)realloc(dec->msgbuffer, dec->msgbuffer_size);
       if (newbuffer == NULL)
-        free((void*)msgbuffer);
-      msgbuffer = newbuffer;
+        free((void*)dec->msgbuffer);
+      dec->msgbuffer = newbuffer;
     }
-    assert(msgbuffer != NULL);
+    assert(dec->msgbuffer != NULL);
   }
 }
 
 static void msgbuffer_clear(void)
 {
-  if (msgbuffer != NULL) {
-    free((void*)msgbuffer);
-    msgbuffer = NULL;
+  CTF_DECODER *dec = decoder();
+  if (dec->msgbuffer != NULL) {
+    free((void*)dec->msgbuffer);
+    dec->msgbuffer = NULL;
   }
-  msgbuffer_size = 0;
-  msgbuffer_filled = 0;
+  dec->msgbuffer_size = 0;
+  dec->msgbuffer_filled = 0;
 }
 
 static void msgbuffer_reset(void)
 {
-  msgbuffer_filled = 0;
+  CTF_DECODER *dec = decoder();
+  dec->msgbuffer_filled = 0;
 }
 
 static void msgbuffer_append(const char *data, int length)
 {
+  CTF_DECODER *dec = decoder();
   assert(data != NULL);
   if (length < 0)
     length = strlen(data);
   msgbuffer_grow(length);
-  memcpy(msgbuffer + msgbuffer_filled, data, length);
-  msgbuffer_filled += length;
-}
-
-static void msgstack_grow(void)
-{
-  /* always grows by one entry, so no parameter required
-     it is a circular buffer, so one extra (unused) entry is needed */
-  size_t filled;
-
-  if (msgstack_tail >= msgstack_head)
-    filled = msgstack_tail - msgstack_head;
-  else
-    filled = msgstack_size - (msgstack_head - msgstack_tail);
-  assert(filled <= msgstack_size);
-
-  if (filled + 2 > msgstack_size) {
-    TRACEMSG *curstack = msgstack;
-    size_t cursize = msgstack_size;
-    size_t idx;
-    if (msgstack_size == 0)
-      msgstack_size = 16;
-    msgstack_size *= 2;
-    assert(msgstack_size > filled + 2);
-    msgstack = (TRACEMSG*)malloc(msgstack_size * sizeof(TRACEMSG));
-    assert(msgstack != NULL);
-    /* copy existing entries from the old stack to the new one */
-    assert(msgstack_head == msgstack_tail || curstack != NULL);
-    idx = 0;
-    while (msgstack_head != msgstack_tail) {
-      msgstack[idx++] = curstack[msgstack_head];
-      if (++msgstack_head > cursize)
-        msgstack_head = 0;
-    }
-    msgstack_head = 0;
-    msgstack_tail = idx;
-    if (curstack != NULL)
-      free((void*)curstack);
-    /* clear the new entries */
-    while (idx < msgstack_size) {
-      memset(msgstack + idx, 0, sizeof(TRACEMSG));
-      idx++;
-    }
+  memcpy(dec->msgbuffer + dec->msgbuffer_filled, data, length);
+  dec->msgbuffer_filled += length;
+}
+
+static void msgstack_skipwrap(const unsigned char *stack, size_t size)
+{
+  CTF_DECODER *dec = decoder();
+  /* a record never wraps around the end of the buffer; if the record at the
+     head does not fit in the remaining space, it is at the start */
+  if (dec->msgstack_head >= size || size - dec->msgstack_head < sizeof(TRACEMSG)
+      || (((const TRACEMSG*)(stack + dec->msgstack_head))->flags & MSGSTACK_WRAP) != 0)
+    dec->msgstack_head = 0;
+}
+
+static void msgstack_grow(size_t size)
+{
+  CTF_DECODER *dec = decoder();
+  /* the stack is only reallocated when it overflows, the records are moved
+     to the start of the new buffer (in order) */
+  unsigned char *curstack = dec->msgstack;
+  size_t newsize = (dec->msgstack_size == 0) ? MSGSTACK_INITIAL : dec->msgstack_size;
+  size_t filled = 0;
+  unsigned count;
+
+  while (newsize < dec->msgstack_size + size)
+    newsize *= 2;
+  dec->msgstack = (unsigned char*)malloc(newsize);
+  assert(dec->msgstack != NULL);   /* should be handled as a run-time error */
+  for (count = 0; count < dec->msgstack_count; count++) {
+    const TRACEMSG *msg;
+    size_t recsize;
+    msgstack_skipwrap(curstack, dec->msgstack_size);
+    msg = (const TRACEMSG*)(curstack + dec->msgstack_head);
+    recsize = MSGSTACK_RECSIZE(msg->length);
+    memcpy(dec->msgstack + filled, msg, recsize);
+    filled += recsize;
+    dec->msgstack_head += recsize;
   }
+  if (curstack != NULL)
+    free((void*)curstack);
+  dec->msgstack_size = newsize;
+  dec->msgstack_head = 0;
+  dec->msgstack_tail = filled;
 }
 
 static void msgstack_clear(void)
 {
-  if (msgstack != NULL) {
-    while (msgstack_head != msgstack_tail) {
-      free((void*)(msgstack[msgstack_head].message));
-      if (++msgstack_head >= msgstack_size)
-        msgstack_head = 0;
-    }
-    free((void*)msgstack);
-    msgstack = NULL;
+  CTF_DECODER *dec = decoder();
+  if (dec->msgstack != NULL) {
+    free((void*)dec->msgstack);
+    dec->msgstack = NULL;
   }
-  msgstack_size = 0;
-  msgstack_head = 0;
-  msgstack_tail = 0;
+  dec->msgstack_size = 0;
+  dec->msgstack_head = 0;
+  dec->msgstack_tail = 0;
+  dec->msgstack_count = 0;
 }
 
-static void msgstack_push(uint16_t streamid, double timestamp, const char *message)
+static void msgstack_push(uint16_t streamid, double timestamp, const char *message, size_t length)
 {
-  msgstack_grow();
-  assert(msgstack_tail < msgstack_size);
-  msgstack[msgstack_tail].streamid = streamid;
-  msgstack[msgstack_tail].timestamp = timestamp;
-  msgstack[msgstack_tail].message = strdup(message);
-  if (++msgstack_tail >= msgstack_size)
-    msgstack_tail = 0;
+  CTF_DECODER *dec = decoder();
+  size_t recsize = MSGSTACK_RECSIZE(length);
+  TRACEMSG *msg;
+
+  assert(message != NULL);
+  if (dec->msgstack_count == 0)
+    dec->msgstack_head = dec->msgstack_tail = 0;
+  for ( ;; ) {
+    if (dec->msgstack_count == 0 || dec->msgstack_tail > dec->msgstack_head) {
+      /* free space is at the end of the buffer and before the head */
+      if (dec->msgstack_size - dec->msgstack_tail >= recsize)
+        break;
+      if (dec->msgstack_head >= recsize) {
+        /* mark the end of the buffer as unused and wrap around */
+        if (dec->msgstack_size - dec->msgstack_tail >= sizeof(TRACEMSG))
+          ((TRACEMSG*)(dec->msgstack + dec->msgstack_tail))->flags = MSGSTACK_WRAP;
+        dec->msgstack_tail = 0;
+        break;
+      }
+    } else if (dec->msgstack_head - dec->msgstack_tail >= recsize) {
+      break;  /* space between the tail and the head */
+    }
+    msgstack_grow(recsize);
+  }
+
+  msg = (TRACEMSG*)(dec->msgstack + dec->msgstack_tail);
+  msg->timestamp = timestamp;
+  msg->streamid = streamid;
+  msg->flags = 0;
+  msg->length = (uint32_t)length;
+  memcpy((char*)(msg + 1), message, length);
+  ((char*)(msg + 1))[length] = '\0';
+  dec->msgstack_tail += recsize;
+  if (dec->msgstack_tail >= dec->msgstack_size)
+    dec->msgstack_tail = 0;
+  dec->msgstack_count++;
 }
 
 /** msgstack_pop() gets a message from a FIFO stack/queue. It returns 0 if the
@@ -244,242 +383,680 @@ static void msgstack_push(uint16_t streamid, double timestamp, const char *messa
  */
 int msgstack_pop(uint16_t *streamid, double *timestamp, char *message, size_t size)
 {
-  if (msgstack_head == msgstack_tail)
+  CTF_DECODER *dec = decoder();
+  const TRACEMSG *msg;
+
+  if (dec->msgstack_count == 0)
     return 0;
+  msgstack_skipwrap(dec->msgstack, dec->msgstack_size);
+  msg = (const TRACEMSG*)(dec->msgstack + dec->msgstack_head);
   if (streamid != NULL)
-    *streamid = msgstack[msgstack_head].streamid;
+    *streamid = msg->streamid;
   if (timestamp != NULL)
-    *timestamp = msgstack[msgstack_head].timestamp;
-  assert(msgstack[msgstack_head].message != NULL);
+    *timestamp = msg->timestamp;
   if (message != NULL && size > 0)
-    strlcpy(message, msgstack[msgstack_head].message, size);
-  free((void*)(msgstack[msgstack_head].message));
-  if (++msgstack_head >= msgstack_size)
-    msgstack_head = 0;
+    strlcpy(message, (const char*)(msg + 1), size);
+  dec->msgstack_head += MSGSTACK_RECSIZE(msg->length);
+  if (dec->msgstack_head >= dec->msgstack_size)
+    dec->msgstack_head = 0;
+  dec->msgstack_count--;
   return 1;
 }
 
 /** msgstack_peek() returns information on the message at the head, but
  *  without popping if from the list. The message pointer is returned as a
- *  pointer into the list.
+ *  pointer into the list, and it stays valid until the message is popped.
  *  \return 1 on success, 0 on failure.
  */
-int msgstack_peek(uint16_t *streamid, double *timestamp, const char **message)
+int msgstack_peek(uint16_t *streamid, double *timestamp, const char **message, size_t *length)
 {
-  if (msgstack_head == msgstack_tail)
+  CTF_DECODER *dec = decoder();
+  const TRACEMSG *msg;
+
+  if (dec->msgstack_count == 0)
     return 0;
+  msgstack_skipwrap(dec->msgstack, dec->msgstack_size);
+  msg = (const TRACEMSG*)(dec->msgstack + dec->msgstack_head);
   if (streamid != NULL)
-    *streamid = msgstack[msgstack_head].streamid;
+    *streamid = msg->streamid;
   if (timestamp != NULL)
-    *timestamp = msgstack[msgstack_head].timestamp;
+    *timestamp = msg->timestamp;
   if (message != NULL)
-    *message = msgstack[msgstack_head].message;
+    *message = (const char*)(msg + 1);
+  if (length != NULL)
+    *length = msg->length;
   return 1;
 }
 
+static void symcache_clear(void)
+{
+  CTF_DECODER *dec = decoder();
+  memset(dec->symcache, 0, sizeof dec->symcache);
+}
+
+/** ctf_set_symtable() sets the symbol table for addresses in the trace data.
+ *  It must also be called after the symbol table is reloaded (even if the
+ *  pointer is the same), because it clears the cache of symbol look-ups.
+ */
 void ctf_set_symtable(const DWARF_SYMBOLLIST *symtable)
 {
-  symboltable = symtable;
+  CTF_DECODER *dec = decoder();
+  dec->symboltable = symtable;
+  symcache_clear();
 }
 
 static int lookup_symbol(uint32_t address, char *symname, size_t maxlength)
 {
-  if (symboltable == NULL)
+  CTF_DECODER *dec = decoder();
+  if (dec->symboltable == NULL)
     return 0;
-  const DWARF_SYMBOLLIST *sym = dwarf_sym_from_address(symboltable, address & ~1, 1);
-  if (sym == NULL)
+  SYMCACHE *entry = &dec->symcache[(uint32_t)(address * 2654435761u) >> (32 - SYMCACHE_BITS)];
+  if (!entry->valid || entry->address != address) {
+    const DWARF_SYMBOLLIST *sym = dwarf_sym_from_address(dec->symboltable, address & ~1, 1);
+    entry->address = address;
+    entry->valid = 1;
+    entry->found = (sym != NULL);
+    if (sym != NULL) {
+      strlcpy(entry->name, dwarf_sym_name(sym), sizearray(entry->name));
+    }
+  }
+  if (!entry->found)
     return 0;
-  assert(sym->name != NULL);
-  char *buffer = alloca(maxlength * sizeof(char));
-  if (demangle(buffer, maxlength, sym->name))
-    strlcpy(symname, buffer, maxlength);
-  else
-    strlcpy(symname, sym->name, maxlength);
+  strlcpy(symname, entry->name, maxlength);
   return 1;
 }
 
-static void str_reverse(char *str, int length)
-{
-  assert(str != NULL);
-  assert(length >= 0);
-  char *tail = str + length - 1;
-  while (tail > str) {
-    char temp = *str;
-    *str++ = *tail;
-    *tail-- = temp;
-  }
-}
+static const char digit_pairs[] =
+  "0001020304050607080910111213141516171819"
+  "2021222324252627282930313233343536373839"
+  "4041424344454647484950515253545556575859"
+  "6061626364656667686970717273747576777879"
+  "8081828384858687888990919293949596979899";
+static const char hex_digits[] = "0123456789abcdef";
+static const uint64_t powers10[] = {
+  1ull, 10ull, 100ull, 1000ull,
+  10000ull, 100000ull, 1000000ull, 10000000ull,
+  100000000ull, 1000000000ull, 10000000000ull, 100000000000ull,
+  1000000000000ull, 10000000000000ull, 100000000000000ull, 1000000000000000ull,
+  10000000000000000ull, 100000000000000000ull, 1000000000000000000ull, 10000000000000000000ull
+};
 
-static char *fmt_uint32(uint32_t num, char *str, int base)
-{
-  int i = 0;
+#define FMT_MAXLENGTH 66  /* sign plus 64 binary digits (plus a spare byte) */
 
-  /* handle 0 explicitely, otherwise empty string is printed for 0 */
-  if (num == 0) {
-    str[i++]= '0';
-    str[i]= '\0';
-    return str;
-  }
+/** fmt_uint() writes the number in the given base (2..16) at "str", filling
+ *  in the digits from the end, so that no reverse pass is needed. Decimal
+ *  numbers are converted two digits at a time. It returns the number of
+ *  characters written; the string is not zero-terminated.
+ */
+static int fmt_uint(uint64_t num, int base, char *str)
+{
+  int length, i;
 
-  while (num != 0) {
-    int rem = num % base;
-    str[i++] = (char)((rem > 9) ? (rem - 10) + 'a' : rem + '0');
-    num = num / base;
+  assert(base >= 2 && base <= 16);
+  if (base == 10) {
+    uint32_t v;
+    for (length = 1; length < (int)sizearray(powers10) && num >= powers10[length]; length++)
+      {}
+    i = length;
+    while (num > UINT32_MAX) {
+      unsigned rem = (unsigned)(num % 100);
+      num /= 100;
+      i -= 2;
+      memcpy(str + i, digit_pairs + 2 * rem, 2);
+    }
+    v = (uint32_t)num;  /* continue with (faster) 32-bit divisions */
+    while (v >= 100) {
+      unsigned rem = v % 100;
+      v /= 100;
+      i -= 2;
+      memcpy(str + i, digit_pairs + 2 * rem, 2);
+    }
+    if (v >= 10) {
+      i -= 2;
+      memcpy(str + i, digit_pairs + 2 * v, 2);
+    } else {
+      str[--i] = (char)('0' + v);
+    }
+    assert(i == 0);
+  } else if (base == 16) {
+    for (length = 1; length < 16 && (num >> (4 * length)) != 0; length++)
+      {}
+    for (i = length; i > 0; num >>= 4)
+      str[--i] = hex_digits[num & 0x0f];
+  } else {
+    uint64_t v;
+    for (length = 1, v = num / base; v != 0; v /= base)
+      length++;
+    for (i = length; i > 0; num /= base)
+      str[--i] = hex_digits[num % base];
   }
-  str[i]= '\0';         /* append string terminator */
+  return length;
+}
 
-  str_reverse(str, i);  /* reverse the string */
-  return str;
+/** msgbuffer_append_uint() formats a number directly into the message
+ *  buffer.
+ */
+static void msgbuffer_append_uint(uint64_t num, int base)
+{
+  CTF_DECODER *dec = decoder();
+  msgbuffer_grow(FMT_MAXLENGTH);
+  dec->msgbuffer_filled += fmt_uint(num, base, dec->msgbuffer + dec->msgbuffer_filled);
 }
 
-static char *fmt_int32(int32_t num, char *str, int base)
+/** msgbuffer_append_int() formats a signed decimal number directly into the
+ *  message buffer.
+ */
+static void msgbuffer_append_int(int64_t num)
 {
-  /* negative numbers are handled only with base 10 */
-  if (num < 0 && base == 10) {
-    str[0] = '-';
-    fmt_uint32((uint32_t)-num, str + 1, base);
+  CTF_DECODER *dec = decoder();
+  msgbuffer_grow(FMT_MAXLENGTH);
+  if (num < 0) {
+    dec->msgbuffer[dec->msgbuffer_filled++] = '-';
+    dec->msgbuffer_filled += fmt_uint(0 - (uint64_t)num, 10, dec->msgbuffer + dec->msgbuffer_filled);
   } else {
-    fmt_uint32((uint32_t)num, str, base);
+    dec->msgbuffer_filled += fmt_uint((uint64_t)num, 10, dec->msgbuffer + dec->msgbuffer_filled);
   }
-  return str;
 }
 
-static char *fmt_uint64(uint64_t num, char *str, int base)
-{
-  int i = 0;
-
-  /* handle 0 explicitely, otherwise empty string is printed for 0 */
-  if (num == 0) {
-    str[i++]= '0';
-    str[i]= '\0';
-    return str;
-  }
+typedef struct tagPROGBUILDER {
+  DECODEPROG *prog;
+  size_t unitsize, opsize;
+  size_t textsize, textfilled;
+  size_t textmark;      /* start of the literal text not yet assigned to an operation */
+  bool swap;
+} PROGBUILDER;
 
-  while (num != 0) {
-    int rem = num % base;
-    str[i++] = (char)((rem > 9) ? (rem - 10) + 'a' : rem + '0');
-    num = num / base;
+static void *block_grow(void *block, size_t *size, size_t needed, size_t itemsize)
+{
+  if (needed > *size) {
+    if (*size == 0)
+      *size = 8;
+    while (*size < needed)
+      *size *= 2;
+    void *newblock = realloc(block, *size * itemsize);
+    if (newblock == NULL)
+      free(block);
+    block = newblock;
+    assert(block != NULL);  /* should be handled as a run-time error */
   }
-  str[i]= '\0';         /* append string terminator */
+  return block;
+}
 
-  str_reverse(str, i);  /* reverse the string */
-  return str;
+static void program_text(PROGBUILDER *b, const char *text)
+{
+  size_t length = strlen(text);
+  b->prog->text = (char*)block_grow(b->prog->text, &b->textsize, b->textfilled + length + 1, sizeof(char));
+  memcpy(b->prog->text + b->textfilled, text, length + 1);
+  b->textfilled += length;
 }
 
-static char *fmt_int64(int64_t num, char *str, int base)
+static void program_op(PROGBUILDER *b, DECODEOP *op)
 {
-  /* negative numbers are handled only with base 10 */
-  if (num < 0 && base == 10) {
-    str[0] = '-';
-    fmt_uint64((uint64_t)-num, str + 1, base);
-  } else {
-    fmt_uint64((uint64_t)num, str, base);
-  }
-  return str;
+  DECODEPROG *prog = b->prog;
+  op->text = (uint32_t)b->textmark;
+  op->textlength = (uint32_t)(b->textfilled - b->textmark);
+  b->textmark = b->textfilled;
+  prog->ops = (DECODEOP*)block_grow(prog->ops, &b->opsize, prog->numops + 1, sizeof(DECODEOP));
+  prog->ops[prog->numops++] = *op;
 }
 
-static void format_field(const char *fieldname, const CTF_TYPE *type, const unsigned char *data)
+static void program_type(PROGBUILDER *b, const CTF_TYPE *type, uint32_t offset)
 {
-  msgbuffer_append(fieldname, -1);
-  msgbuffer_append(" = ", 3);
+  DECODEOP op;
+  memset(&op, 0, sizeof op);
+  op.offset = offset;
+  op.size = (uint8_t)(type->size / 8);
+  op.bits = (uint8_t)type->size;
+  op.swap = b->swap && op.size > 1;
 
   switch (type->typeclass) {
-  case CLASS_INTEGER: {
-    char txt[128];
-    uint8_t base = type->base;
-    if ((base < 2 || base > 16) && base != CTF_BASE_ADDR)
-      base = 10;
+  case CLASS_INTEGER:
+    assert(op.size <= 8);
+    op.base = type->base;
+    if ((op.base < 2 || op.base > 16) && op.base != CTF_BASE_ADDR)
+      op.base = 10;
     if (type->size > 32) {
-      uint64_t v = 0;
-      memcpy(&v, data, type->size / 8);
-      if (type->flags & TYPEFLAG_SIGNED)
-        fmt_int64((int64_t)v, txt, base);
-      else
-        fmt_uint64(v, txt, base);
+      if (op.base == CTF_BASE_ADDR)
+        op.base = 16;   /* symbol look-up is for 32-bit addresses only */
+      op.opcode = (type->flags & TYPEFLAG_SIGNED) ? OP_INT64 : OP_UINT64;
+    } else if (op.base == CTF_BASE_ADDR) {
+      op.opcode = OP_SYMBOL;
     } else {
-      uint32_t v = 0;
-      memcpy(&v, data, type->size / 8);
-      if (base == CTF_BASE_ADDR) {
-        if (!lookup_symbol(v, txt, sizearray(txt)))
-          fmt_uint32(v, txt, 16);
-      } else if (type->flags & TYPEFLAG_SIGNED) {
-        if (type->size < 32 && (v & (1 << (type->size - 1))) != 0)
-          v |= ~0u << type->size;  /* sign-extend 8-bit & 16-bit values */
-        fmt_int32((int32_t)v, txt, base);
-      } else {
-        fmt_uint32(v, txt, base);
-      }
+      op.opcode = (type->flags & TYPEFLAG_SIGNED) ? OP_INT32 : OP_UINT32;
     }
-    msgbuffer_append(txt, -1);
     break;
-  } /* case */
-
-  case CLASS_FLOAT: {
-    char txt[32];
-    if (type->size > 32) {
-      double v = 0;
-      memcpy(&v, data, type->size / 8);
-      sprintf(txt, "%f", v);
-    } else {
-      float v = 0;
-      memcpy(&v, data, type->size / 8);
-      sprintf(txt, "%f", v);
-    }
-    msgbuffer_append(txt, -1);
+  case CLASS_FLOAT:
+    assert(op.size <= 8);
+    op.opcode = (type->size > 32) ? OP_DOUBLE : OP_FLOAT;
     break;
-  } /* case */
-
-  case CLASS_ENUM: {
-    const CTF_KEYVALUE *kv;
-    int32_t v = 0;
-    memcpy(&v, data, type->size / 8);
-    for (kv = type->keys->next; kv != NULL && kv->value != v; kv = kv->next)
-      /* nothing */;
-    if (kv != NULL) {
-      msgbuffer_append(kv->name, -1);
-    } else {
-      char txt[32];
-      sprintf(txt, "(%d)", (int)v);
-      msgbuffer_append(txt, -1);
-    }
+  case CLASS_ENUM:
+    assert(op.size <= 4);
+    assert(type->keys != NULL);
+    op.opcode = OP_ENUM;
+    op.keys = type->keys->next;
     break;
-  } /* case */
-
   case CLASS_STRING:
-    msgbuffer_append("\"", 1);
-    msgbuffer_append((const char*)data, -1);
-    msgbuffer_append("\"", 1);
-    break;
-
+    op.opcode = OP_STRING;
+    program_text(b, "\"");
+    program_op(b, &op);
+    program_text(b, "\"");
+    return;
   case CLASS_STRUCT:
-    msgbuffer_append("{ ", 2);
+    /* a struct is flattened into the operations for its members */
+    program_text(b, "{ ");
     if (type->fields != NULL) {
       const CTF_TYPE *subtype;
       for (subtype = type->fields->next; subtype != NULL; subtype = subtype->next) {
         if (subtype->size / 8 == 0)
           break;
         if (subtype != type->fields->next)
-          msgbuffer_append(", ", 2);
-        format_field(subtype->identifier, subtype, data);
-        data += (subtype->size / 8);
+          program_text(b, ", ");
+        assert(subtype->identifier != NULL);
+        program_text(b, subtype->identifier);
+        program_text(b, " = ");
+        program_type(b, subtype, offset);
+        offset += subtype->size / 8;
       }
     }
-    msgbuffer_append(" }", 2);
-    break;
-
+    program_text(b, " }");
+    return;
   default:
     assert(0);
-  } /* switch (typeclass) */
+  }
+  program_op(b, &op);
 }
 
-int ctf_decode(const unsigned char *stream, size_t size, long channel)
+/** program_compile() converts the field list of an event to a flat list of
+ *  operations, with the offsets, sizes and formats of all values resolved.
+ *  Each top-level field is a "unit" that is read from the stream as a whole.
+ */
+static DECODEPROG *program_compile(const CTF_EVENT *evt)
+{
+  PROGBUILDER b;
+  const CTF_EVENT_FIELD *fld;
+  size_t unitsize;
+
+  assert(evt != NULL);
+  memset(&b, 0, sizeof b);
+  b.prog = (DECODEPROG*)malloc(sizeof(DECODEPROG));
+  assert(b.prog != NULL);
+  memset(b.prog, 0, sizeof(DECODEPROG));
+  b.prog->event = evt;
+  b.swap = (trace_global()->byte_order == BYTEORDER_BE);
+  program_text(&b, "");   /* make sure the text pool exists */
+
+  unitsize = 0;
+  for (fld = evt->field_root.next; fld != NULL; fld = fld->next) {
+    DECODEUNIT *u;
+    assert(fld->type.typeclass == CLASS_STRING || fld->type.size / 8 > 0);
+    b.prog->units = (DECODEUNIT*)block_grow(b.prog->units, &unitsize, b.prog->numunits + 1, sizeof(DECODEUNIT));
+    u = &b.prog->units[b.prog->numunits++];
+    u->size = (fld->type.typeclass == CLASS_STRING) ? 0 : fld->type.size / 8;
+    u->first = b.prog->numops;
+    program_text(&b, (fld == evt->field_root.next) ? ": " : ", ");
+    program_text(&b, fld->name);
+    program_text(&b, " = ");
+    program_type(&b, &fld->type, 0);
+    if (b.textfilled > b.textmark) {
+      /* trailing text of the field (closing quote or brace) */
+      DECODEOP op;
+      memset(&op, 0, sizeof op);
+      op.opcode = OP_TEXT;
+      program_op(&b, &op);
+    }
+    u->count = b.prog->numops - u->first;
+  }
+  return b.prog;
+}
+
+/** program_get() returns the compiled decoder for an event, compiling it on
+ *  first use. Compiled decoders stay valid until ctf_decode_cleanup().
+ */
+static const DECODEPROG *program_get(const CTF_EVENT *evt)
+{
+  CTF_DECODER *dec = decoder();
+  DECODEPROG *prog;
+
+  assert(evt != NULL);
+  if (evt->id >= 0 && evt->id < dec->program_indexsize && dec->program_index[evt->id] != NULL)
+    return dec->program_index[evt->id];
+  for (prog = dec->program_root.next; prog != NULL && prog->event != evt; prog = prog->next)
+    {}
+  if (prog == NULL) {
+    prog = program_compile(evt);
+    prog->next = dec->program_root.next;
+    dec->program_root.next = prog;
+  }
+  if (evt->id >= 0 && evt->id <= PROGRAM_MAXID) {
+    if (evt->id >= dec->program_indexsize) {
+      int newsize = (dec->program_indexsize == 0) ? 16 : dec->program_indexsize;
+      while (newsize <= evt->id)
+        newsize *= 2;
+      DECODEPROG **newindex = (DECODEPROG**)realloc(dec->program_index, newsize * sizeof(DECODEPROG*));
+      if (newindex == NULL)
+        free((void*)dec->program_index);
+      dec->program_index = newindex;
+      assert(dec->program_index != NULL);
+      memset(dec->program_index + dec->program_indexsize, 0, (newsize - dec->program_indexsize) * sizeof(DECODEPROG*));
+      dec->program_indexsize = newsize;
+    }
+    dec->program_index[evt->id] = prog;
+  }
+  return prog;
+}
+
+static const DECODEPROG *program_by_id(int event_id)
+{
+  CTF_DECODER *dec = decoder();
+  if (event_id >= 0 && event_id < dec->program_indexsize && dec->program_index[event_id] != NULL)
+    return dec->program_index[event_id];
+  const CTF_EVENT *evt = event_by_id(event_id);
+  return (evt != NULL) ? program_get(evt) : NULL;
+}
+
+static void program_clear(void)
+{
+  CTF_DECODER *dec = decoder();
+  while (dec->program_root.next != NULL) {
+    DECODEPROG *prog = dec->program_root.next;
+    dec->program_root.next = prog->next;
+    if (prog->units != NULL)
+      free((void*)prog->units);
+    if (prog->ops != NULL)
+      free((void*)prog->ops);
+    if (prog->text != NULL)
+      free((void*)prog->text);
+    free((void*)prog);
+  }
+  if (dec->program_index != NULL) {
+    free((void*)dec->program_index);
+    dec->program_index = NULL;
+  }
+  dec->program_indexsize = 0;
+}
+
+static uint64_t load_value(const unsigned char *data, const DECODEOP *op)
+{
+  uint64_t v = 0;
+  if (op->swap) {
+    for (int i = 0; i < op->size; i++)
+      v = (v << 8) | data[i];
+  } else {
+    memcpy(&v, data, op->size);   /* this code assumes a Little Endian host */
+  }
+  return v;
+}
+
+/** program_run() formats a single field (unit) of an event. Parameter "data"
+ *  points to the complete field.
+ */
+static void program_run(const DECODEPROG *prog, const DECODEUNIT *u, const unsigned char *data)
 {
+  const DECODEOP *op = prog->ops + u->first;
+  const DECODEOP *end = op + u->count;
+  char txt[128];
+
+  for ( ; op < end; op++) {
+    const unsigned char *ptr = data + op->offset;
+    if (op->textlength > 0)
+      msgbuffer_append(prog->text + op->text, op->textlength);
+    switch (op->opcode) {
+    case OP_TEXT:
+      break;
+    case OP_UINT32:
+      msgbuffer_append_uint((uint32_t)load_value(ptr, op), op->base);
+      break;
+    case OP_INT32: {
+      uint32_t v = (uint32_t)load_value(ptr, op);
+      if (op->bits < 32 && (v & (1u << (op->bits - 1))) != 0)
+        v |= ~0u << op->bits;   /* sign-extend 8-bit & 16-bit values */
+      if (op->base == 10)
+        msgbuffer_append_int((int32_t)v);
+      else
+        msgbuffer_append_uint(v, op->base);   /* negative numbers are handled only with base 10 */
+      break;
+    } /* case */
+    case OP_UINT64:
+      msgbuffer_append_uint(load_value(ptr, op), op->base);
+      break;
+    case OP_INT64:
+      if (op->base == 10)
+        msgbuffer_append_int((int64_t)load_value(ptr, op));
+      else
+        msgbuffer_append_uint(load_value(ptr, op), op->base);
+      break;
+    case OP_SYMBOL: {
+      uint32_t v = (uint32_t)load_value(ptr, op);
+      if (lookup_symbol(v, txt, sizearray(txt)))
+        msgbuffer_append(txt, -1);
+      else
+        msgbuffer_append_uint(v, 16);
+      break;
+    } /* case */
+    case OP_FLOAT: {
+      uint32_t v = (uint32_t)load_value(ptr, op);
+      float f;
+      memcpy(&f, &v, sizeof f);
+      snprintf(txt, sizearray(txt), "%f", f);
+      msgbuffer_append(txt, -1);
+      break;
+    } /* case */
+    case OP_DOUBLE: {
+      uint64_t v = load_value(ptr, op);
+      double f;
+      memcpy(&f, &v, sizeof f);
+      snprintf(txt, sizearray(txt), "%f", f);
+      msgbuffer_append(txt, -1);
+      break;
+    } /* case */
+    case OP_ENUM: {
+      const CTF_KEYVALUE *kv;
+      int32_t v = (int32_t)(uint32_t)load_value(ptr, op);
+      for (kv = op->keys; kv != NULL && kv->value != v; kv = kv->next)
+        /* nothing */;
+      if (kv != NULL) {
+        msgbuffer_append(kv->name, -1);
+      } else {
+        sprintf(txt, "(%d)", (int)v);
+        msgbuffer_append(txt, -1);
+      }
+      break;
+    } /* case */
+    case OP_STRING:
+      msgbuffer_append((const char*)ptr, -1);
+      break;
+    default:
+      assert(0);
+    } /* switch (opcode) */
+  }
+}
+
+/** record_streamfile() returns the file for a stream in the CTF trace
+ *  directory, creating it (with a packet header) on first use.
+ */
+static FILE *record_streamfile(int stream_id)
+{
+  CTF_DECODER *dec = decoder();
+  if (stream_id < 0 || stream_id >= RECORD_MAXSTREAMS)
+    return NULL;
+  if (dec->record_files[stream_id] == NULL) {
+    size_t len = strlen(dec->record_path) + 32;
+    char *filename = alloca(len * sizeof(char));
+    sprintf(filename, "%s/stream_%d", dec->record_path, stream_id);
+    FILE *fp = fopen(filename, "wb");
+    if (fp == NULL)
+      return NULL;
+    setvbuf(fp, NULL, _IOFBF, RECORD_BUFSIZE);
+    /* a single packet header at the start of the file; all events follow it
+       (there is no packet context, so the packet spans the whole file) */
+    const CTF_PACKET_HEADER *hdr = packet_header();
+    const CTF_TRACE_GLOBAL *trace = trace_global();
+    uint8_t id[8];
+    assert(hdr->header.magic_size / 8 <= sizeof magic);
+    fwrite(magic, 1, hdr->header.magic_size / 8, fp);
+    assert(hdr->header.uuid_size / 8 <= CTF_UUID_LENGTH);
+    fwrite(trace->uuid, 1, hdr->header.uuid_size / 8, fp);
+    memset(id, 0, sizeof id);
+    id[0] = (uint8_t)stream_id;   /* Little Endian, stream_id < RECORD_MAXSTREAMS */
+    assert(hdr->header.streamid_size / 8 <= sizeof id);
+    fwrite(id, 1, hdr->header.streamid_size / 8, fp);
+    dec->record_files[stream_id] = fp;
+  }
+  return dec->record_files[stream_id];
+}
+
+static void record_begin(size_t idx)
+{
+  CTF_DECODER *dec = decoder();
+  dec->record_capturing = true;
+  dec->record_from = idx;
+  dec->record_filled = 0;
+}
+
+static void record_append(const unsigned char *data, size_t size)
+{
+  CTF_DECODER *dec = decoder();
+  dec->record_buffer = (unsigned char*)block_grow(dec->record_buffer, &dec->record_size, dec->record_filled + size, sizeof(unsigned char));
+  memcpy(dec->record_buffer + dec->record_filled, data, size);
+  dec->record_filled += size;
+}
+
+/** record_end() writes the event (event header and fields) to the stream
+ *  file; the bytes were collected from the input, so they are stored in the
+ *  same layout as the target sent them.
+ */
+static void record_end(const CTF_EVENT *evt, const unsigned char *stream, size_t idx)
+{
+  CTF_DECODER *dec = decoder();
+  assert(dec->record_capturing);
+  FILE *fp = record_streamfile(evt->stream_id);
+  if (fp != NULL) {
+    if (dec->record_filled > 0)
+      fwrite(dec->record_buffer, 1, dec->record_filled, fp);
+    assert(idx >= dec->record_from);
+    fwrite(stream + dec->record_from, 1, idx - dec->record_from, fp);
+  }
+  dec->record_capturing = false;
+  dec->record_filled = 0;
+}
+
+static void record_cancel(void)
+{
+  CTF_DECODER *dec = decoder();
+  dec->record_capturing = false;
+  dec->record_filled = 0;
+}
+
+/** ctf_record_open() starts writing the decoded CTF events to a CTF trace
+ *  directory (for analysis in tools like Babeltrace or Trace Compass). The
+ *  directory gets a copy of the TSDL file as "metadata", plus a file for each
+ *  stream.
+ *
+ *  \param path     The directory; it is created if it does not exist.
+ *  \param metadata The TSDL file.
+ *  \param notext   If true, the events are not formatted as text (and no
+ *                  messages are put on the message stack).
+ *
+ *  \return 1 on success, 0 on failure.
+ */
+int ctf_record_open(const char *path, const char *metadata, int notext)
+{
+  CTF_DECODER *dec = decoder();
+  assert(path != NULL && metadata != NULL);
+  ctf_record_close();
+
+# if defined _MSC_VER
+    _mkdir(path);
+# elif defined _WIN32
+    mkdir(path);
+# else
+    mkdir(path, S_IRWXU | S_IRWXG | S_IROTH | S_IXOTH);
+# endif
+
+  /* copy the TSDL file, with the signature that marks it as plain-text
+     metadata */
+  FILE *fin = fopen(metadata, "rb");
+  if (fin == NULL)
+    return 0;
+  size_t len = strlen(path) + 16;
+  char *filename = alloca(len * sizeof(char));
+  sprintf(filename, "%s/metadata", path);
+  FILE *fout = fopen(filename, "wb");
+  if (fout == NULL) {
+    fclose(fin);
+    return 0;
+  }
+  char buffer[1024];
+  static const char signature[] = "/* CTF 1.8 */";
+  size_t count = fread(buffer, 1, sizeof buffer, fin);
+  if (count < strlen(signature) || memcmp(buffer, signature, strlen(signature)) != 0)
+    fprintf(fout, "%s\n", signature);
+  while (count > 0) {
+    fwrite(buffer, 1, count, fout);
+    count = fread(buffer, 1, sizeof buffer, fin);
+  }
+  fclose(fin);
+  fclose(fout);
+
+  dec->record_path = strdup(path);
+  if (dec->record_path == NULL)
+    return 0;
+  dec->record_notext = (notext != 0);
+  dec->record_capturing = false;
+  return 1;
+}
+
+void ctf_record_close(void)
+{
+  CTF_DECODER *dec = decoder();
+  for (int i = 0; i < RECORD_MAXSTREAMS; i++) {
+    if (dec->record_files[i] != NULL) {
+      fclose(dec->record_files[i]);
+      dec->record_files[i] = NULL;
+    }
+  }
+  if (dec->record_path != NULL) {
+    free((void*)dec->record_path);
+    dec->record_path = NULL;
+  }
+  if (dec->record_buffer != NULL) {
+    free((void*)dec->record_buffer);
+    dec->record_buffer = NULL;
+  }
+  dec->record_size = dec->record_filled = 0;
+  dec->record_capturing = false;
+  dec->record_notext = false;
+}
+
+/* event_complete() finishes the decoding of an event; it returns the count
+   of messages that this adds to the result of ctf_decode() */
+static int event_complete(const unsigned char *stream, size_t idx)
+{
+  CTF_DECODER *dec = decoder();
+  if (dec->watch) {
+    msgbuffer_reset();
+    return (dec->event->id == dec->watch_id) ? 1 : 0;
+  }
+  if (!dec->record_notext) {
+    msgbuffer_append("", 1);  /* force zero-terminate msgbuffer */
+    msgstack_push((uint16_t)dec->event->stream_id, dec->timestamp, dec->msgbuffer, dec->msgbuffer_filled - 1);
+  }
+  msgbuffer_reset();
+  if (dec->record_capturing)
+    record_end(dec->event, stream, idx);
+  return 1;
+}
+
+static int decode_run(const unsigned char *stream, size_t size, long channel)
+{
+  CTF_DECODER *dec = decoder();
   size_t idx, len, result;
 
   if (event_count(-1) == 0)     /* no events defined, nothing to do */
     return 0;
 
-  cache_reset();
+  /* the cache holds a partial field from the previous buffer, so it must not
+     be reset here */
   result = 0;
   idx = 0;
 
@@ -487,32 +1064,32 @@ restart:
   if (idx >= size)
     return result;
 
-  switch (state) {
+  switch (dec->state) {
   case STATE_SCAN_MAGIC:
-    if (pkt_header == NULL)
-      pkt_header = packet_header();
-    assert(pkt_header != NULL);
-    if (pkt_header->header.magic_size == 0) {
+    if (dec->pkt_header == NULL)
+      dec->pkt_header = packet_header();
+    assert(dec->pkt_header != NULL);
+    if (dec->pkt_header->header.magic_size == 0) {
       /* advance state and restart */
-      state++;
+      dec->state++;
       goto restart;
     }
-    if (cache_filled > 0) {
+    if (dec->cache_filled > 0) {
       /* the first bytes in cache already matched, check the remaining bytes */
-      len = (pkt_header->header.magic_size / 8) - cache_filled;
+      len = (dec->pkt_header->header.magic_size / 8) - dec->cache_filled;
       assert(len > 0);
       assert(idx == 0);
       if (len > size)
         len = size;
-      if (memcmp(stream, magic + cache_filled, len) == 0) {
+      if (memcmp(stream, magic + dec->cache_filled, len) == 0) {
         /* match, check whether this is still a patial match */
-        if (cache_filled + len == (pkt_header->header.magic_size / 8u)) {
-          state++;
+        if (dec->cache_filled + len == (dec->pkt_header->header.magic_size / 8u)) {
+          dec->state++;
           idx += len;
           cache_reset();
           goto restart;
         } else {
-          cache_filled += len;
+          dec->cache_filled += len;
           return result; /* nothing to do further, wait for more bytes */
         }
       } else {
@@ -520,25 +1097,25 @@ restart:
         cache_reset();
       }
     }
-    if (state == STATE_SCAN_MAGIC) {
+    if (dec->state == STATE_SCAN_MAGIC) {
       while (idx < size) {
         while (idx < size && stream[idx] != magic[0])
           idx++;  /* find first byte of the magic */
         if (idx < size) {
           /* potential start of magic found */
-          len = pkt_header->header.magic_size / 8;
+          len = dec->pkt_header->header.magic_size / 8;
           if (idx + len > size)
             len = size - idx;
-          if (memcmp(stream, magic + cache_filled, len) == 0) {
+          if (memcmp(stream + idx, magic, len) == 0) {
             /* match, check whether this is still a patial match */
-            if (len == pkt_header->header.magic_size / 8u) {
-              state++;  /* full match -> advance state & restart */
+            if (len == dec->pkt_header->header.magic_size / 8u) {
+              dec->state++;  /* full match -> advance state & restart */
               idx += len;
               cache_reset();
               goto restart;
             } else {
-              assert(cache_filled == 0);
-              cache_filled = len;
+              assert(dec->cache_filled == 0);
+              dec->cache_filled = len;
               return result; /* nothing to do further, wait for more bytes */
             }
           } else {
@@ -550,217 +1127,215 @@ restart:
     break;
 
   case STATE_SKIP_UID:
-    len = (pkt_header->header.uuid_size / 8) - cache_filled;
+    len = (dec->pkt_header->header.uuid_size / 8) - dec->cache_filled;
     if (idx + len <= size) {
       /* UUID fully skipped (or uuid_size == 0) */
-      state++;
+      dec->state++;
       idx += len;
       cache_reset();
       goto restart;
     } else {
-      cache_filled += size - idx;
+      dec->cache_filled += size - idx;
       /* no data is truly stored in the cache, because we are skipping
          this field */
     }
     break;
 
   case STATE_GET_STREAMID:
-    if (pkt_header->header.streamid_size == 0) {
-      state++;
-      assert(cache_filled == 0);
+    if (dec->pkt_header->header.streamid_size == 0) {
+      dec->state++;
+      assert(dec->cache_filled == 0);
       goto restart;
     }
-    len = (pkt_header->header.streamid_size / 8) - cache_filled;
+    len = (dec->pkt_header->header.streamid_size / 8) - dec->cache_filled;
     if (idx + len <= size) {
       /* get the stream.id; this code assumes Little Endian */
       unsigned long streamid = 0;
-      if (cache_filled > 0) {
-        assert(cache_filled < pkt_header->header.streamid_size / 8u);
-        memcpy((unsigned char*)&streamid, cache, cache_filled);
+      if (dec->cache_filled > 0) {
+        assert(dec->cache_filled < dec->pkt_header->header.streamid_size / 8u);
+        memcpy((unsigned char*)&streamid, dec->cache, dec->cache_filled);
       }
-      assert(len > 0 && len <= pkt_header->header.streamid_size / 8u);
-      memcpy((unsigned char*)&streamid + cache_filled, stream + idx, len);
+      assert(len > 0 && len <= dec->pkt_header->header.streamid_size / 8u);
+      memcpy((unsigned char*)&streamid + dec->cache_filled, stream + idx, len);
       channel = (long)streamid; /* stream id in the header overrules the parameter */
-      state++;
+      dec->state++;
       idx += len;
       cache_reset();
       goto restart;
     } else {
       len = size - idx;
       cache_grow(len);
-      memcpy(cache + cache_filled, stream + idx, len);
-      cache_filled += len;
+      memcpy(dec->cache + dec->cache_filled, stream + idx, len);
+      dec->cache_filled += len;
     }
     break;
 
   case STATE_GET_EVENTID:
+    if (dec->record_path != NULL && !dec->record_capturing)
+      record_begin(idx);  /* event header and fields are written to the trace directory */
     /* get the event header from the stream.id or the passed-in channel */
     { /* local block */
       const CTF_STREAM *s = stream_by_id(channel);
       if (s != NULL) {
-        evt_header = &s->event;
-        clock = (s->clock != NULL) ? clock_by_name(s->clock->selector) : NULL;
+        dec->evt_header = &s->event;
+        dec->clock = s->clock_map;
       } else if (stream_count() == 0) {
         /* stream not found, because there isn't one
            meaning that there is only a single event */
-        evt_header = NULL;
-        event = event_next(NULL);
-        if (event == NULL) {
-          state = STATE_SCAN_MAGIC;
-          assert(cache_filled == 0);
+        dec->evt_header = NULL;
+        dec->event = event_next(NULL);
+        if (dec->event == NULL) {
+          dec->state = STATE_SCAN_MAGIC;
+          record_cancel();
+          assert(dec->cache_filled == 0);
           goto restart;
         }
-        assert(msgbuffer_filled == 0);
-        msgbuffer_append(event->name, -1);
-        field = event->field_root.next;
-        if (field == NULL) {
+        dec->program = program_get(dec->event);
+        assert(dec->msgbuffer_filled == 0);
+        msgbuffer_append(dec->event->name, -1);
+        dec->unit = 0;
+        if (dec->program->numunits == 0) {
           /* this event has no fields */
-          msgbuffer_append("", 1);  /* force zero-terminate msgbuffer */
-          msgstack_push((uint16_t)event->stream_id, timestamp, msgbuffer);
-          msgbuffer_reset();
-          result += 1;  /* flag: one more trace message completed */
-          state = STATE_SCAN_MAGIC;
+          result += event_complete(stream, idx);
+          dec->state = STATE_SCAN_MAGIC;
         } else {
-          state = STATE_GET_FIELDS;
+          dec->state = STATE_GET_FIELDS;
         }
         goto restart;
       } else {
         /* stream not found, drop the decoding */
-        state = STATE_SCAN_MAGIC;
-        assert(cache_filled == 0);
+        dec->state = STATE_SCAN_MAGIC;
+        record_cancel();
+        assert(dec->cache_filled == 0);
         goto restart;
       }
     }
-    assert(evt_header != NULL);
-    if (evt_header->header.id_size == 0) {
-      state++;
-      assert(cache_filled == 0);
+    assert(dec->evt_header != NULL);
+    if (dec->evt_header->header.id_size == 0) {
+      dec->state++;
+      assert(dec->cache_filled == 0);
       goto restart;
     }
-    len = (evt_header->header.id_size / 8) - cache_filled;
+    len = (dec->evt_header->header.id_size / 8) - dec->cache_filled;
     if (idx + len <= size) {
       /* get the event.id; this code assumes Little Endian */
       unsigned long id = 0;
-      assert(cache_filled + len < sizeof id);
-      if (cache_filled > 0) {
-        assert(cache_filled < evt_header->header.id_size / 8u);
-        memcpy((unsigned char*)&id, cache, cache_filled);
+      assert(dec->cache_filled + len < sizeof id);
+      if (dec->cache_filled > 0) {
+        assert(dec->cache_filled < dec->evt_header->header.id_size / 8u);
+        memcpy((unsigned char*)&id, dec->cache, dec->cache_filled);
       }
-      assert(len > 0 && len <= evt_header->header.id_size / 8u);
-      memcpy((unsigned char*)&id + cache_filled, stream + idx, len);
-      /* get the event from the id */
-      event = event_by_id(id);
-      if (event != NULL) {
-        assert(msgbuffer_filled == 0);
-        msgbuffer_append(event->name, -1);
-        state++;
+      assert(len > 0 && len <= dec->evt_header->header.id_size / 8u);
+      memcpy((unsigned char*)&id + dec->cache_filled, stream + idx, len);
+      /* get the event (and its compiled decoder) from the id */
+      dec->program = program_by_id((int)id);
+      if (dec->program != NULL) {
+        dec->event = dec->program->event;
+        assert(dec->msgbuffer_filled == 0);
+        msgbuffer_append(dec->event->name, -1);
+        dec->state++;
         idx += len;
-        field = event->field_root.next;
-        if (field == NULL) {
+        dec->unit = 0;
+        if (dec->program->numunits == 0) {
           /* this event has no fields */
-          msgbuffer_append("", 1);  /* force zero-terminate msgbuffer */
-          msgstack_push((uint16_t)event->stream_id, timestamp, msgbuffer);
-          msgbuffer_reset();
-          result += 1;  /* flag: one more trace message completed */
-          state = STATE_SCAN_MAGIC;
+          result += event_complete(stream, idx);
+          dec->state = STATE_SCAN_MAGIC;
         }
       } else {
         /* event not found, drop the decoding */
-        state = STATE_SCAN_MAGIC;
+        dec->state = STATE_SCAN_MAGIC;
+        record_cancel();
       }
       cache_reset();
       goto restart;
     } else {
       len = size - idx;
       cache_grow(len);
-      memcpy(cache + cache_filled, stream + idx, len);
-      cache_filled += len;
+      memcpy(dec->cache + dec->cache_filled, stream + idx, len);
+      dec->cache_filled += len;
     }
     break;
 
   case STATE_GET_TIMESTAMP:
-    assert(evt_header != NULL);
-    if (evt_header->header.timestamp_size == 0) {
-      state++;
-      assert(cache_filled == 0);
+    assert(dec->evt_header != NULL);
+    if (dec->evt_header->header.timestamp_size == 0) {
+      dec->state++;
+      assert(dec->cache_filled == 0);
       goto restart;
     }
-    len = (evt_header->header.timestamp_size / 8) - cache_filled;
+    len = (dec->evt_header->header.timestamp_size / 8) - dec->cache_filled;
     if (idx + len <= size) {
       /* get the timestamp; this code assumes Little Endian */
       uint64_t tstamp = 0;
-      assert(cache_filled + len < sizeof tstamp);
-      if (cache_filled > 0)
-        memcpy((unsigned char*)&tstamp, cache, cache_filled);
-      memcpy((unsigned char*)&tstamp + cache_filled, stream + idx, len);
+      assert(dec->cache_filled + len < sizeof tstamp);
+      if (dec->cache_filled > 0)
+        memcpy((unsigned char*)&tstamp, dec->cache, dec->cache_filled);
+      memcpy((unsigned char*)&tstamp + dec->cache_filled, stream + idx, len);
       /* convert timestamp to seconds */
-      if (clock != NULL)
-        timestamp = (double)(tstamp + clock->offset) / (double)clock->frequeny + clock->offset_s;
-      state++;
+      if (dec->clock != NULL)
+        dec->timestamp = (double)(tstamp + dec->clock->offset) / (double)dec->clock->frequeny + dec->clock->offset_s;
+      dec->state++;
       idx += len;
       cache_reset();
       goto restart;
     } else {
       len = size - idx;
       cache_grow(len);
-      memcpy(cache + cache_filled, stream + idx, len);
-      cache_filled += len;
+      memcpy(dec->cache + dec->cache_filled, stream + idx, len);
+      dec->cache_filled += len;
     }
     break;
 
   case STATE_GET_FIELDS:
-    assert(field != NULL);
-    switch (field->type.typeclass) {
-    case CLASS_INTEGER:
-    case CLASS_FLOAT:
-    case CLASS_ENUM:
-    case CLASS_STRUCT:
-      assert(field->type.size / 8 > 0);
-      len = (field->type.size / 8) - cache_filled;
-      if (idx + len > size)
-        len = size - idx;
-      cache_grow(len);
-      memcpy(cache + cache_filled, stream + idx, len);
-      idx += len;
-      cache_filled += len;
-      if (cache_filled < (field->type.size / 8))
-        return result;  /* full field not yet in the buffer, wait for more incoming bytes */
-      break;
-    case CLASS_STRING:
-      /* store the string (temporarily) in the cache */
-      while (idx < size && stream[idx] != 0) {
-        cache_grow(1);
-        cache[cache_filled++] = stream[idx++];
-      }
-      if (idx < size) {
-        assert(stream[idx] == 0);
-        cache_grow(1);
-        cache[cache_filled++] = 0;
-        idx++;
+    assert(dec->program != NULL && dec->unit < dec->program->numunits);
+    { /* local block */
+      const DECODEUNIT *u = &dec->program->units[dec->unit];
+      const unsigned char *data;
+      if (u->size > 0) {
+        if (dec->cache_filled == 0 && idx + u->size <= size) {
+          /* full field is in the buffer, decode it in place */
+          data = stream + idx;
+          idx += u->size;
+        } else {
+          len = u->size - dec->cache_filled;
+          if (idx + len > size)
+            len = size - idx;
+          cache_grow(len);
+          memcpy(dec->cache + dec->cache_filled, stream + idx, len);
+          idx += len;
+          dec->cache_filled += len;
+          if (dec->cache_filled < u->size)
+            return result;  /* full field not yet in the buffer, wait for more incoming bytes */
+          data = dec->cache;
+        }
       } else {
-        /* zero terminating byte not found, wait for more incoming bytes */
-        return result;
+        const unsigned char *term = (const unsigned char*)memchr(stream + idx, 0, size - idx);
+        if (dec->cache_filled == 0 && term != NULL) {
+          /* full string is in the buffer, decode it in place */
+          data = stream + idx;
+          idx = (term - stream) + 1;
+        } else {
+          /* store the string (temporarily) in the cache */
+          len = (term != NULL) ? (size_t)(term - (stream + idx)) + 1 : size - idx;
+          cache_grow(len);
+          memcpy(dec->cache + dec->cache_filled, stream + idx, len);
+          idx += len;
+          dec->cache_filled += len;
+          if (term == NULL)
+            return result;  /* zero terminating byte not found, wait for more incoming bytes */
+          data = dec->cache;
+        }
       }
-      break;
-    default:
-      assert(0);
+      /* format the field */
+      if (!dec->record_notext && !dec->watch)
+        program_run(dec->program, u, data);
+      cache_reset();
     }
-    /* format the field */
-    if (field == event->field_root.next)
-      msgbuffer_append(": ", 2);  /* first field */
-    else
-      msgbuffer_append(", ", 2);  /* next field */
-    format_field(field->name, &field->type, cache);
-    cache_reset();
     /* move to the next field (stay in the current state unless this was the
        last parameter) */
-    field = field->next;
-    if (field == NULL) {
-      msgbuffer_append("", 1);  /* force zero-terminate msgbuffer */
-      msgstack_push((uint16_t)event->stream_id, timestamp, msgbuffer);
-      msgbuffer_reset();
-      result += 1;  /* flag: one more trace message completed */
-      state = STATE_SCAN_MAGIC;
+    if (++dec->unit >= dec->program->numunits) {
+      result += event_complete(stream, idx);
+      dec->state = STATE_SCAN_MAGIC;
     }
     goto restart;
   }
@@ -768,8 +1343,26 @@ restart:
   return result;
 }
 
+int ctf_decode(const unsigned char *stream, size_t size, long channel)
+{
+  CTF_DECODER *dec = decoder();
+  int result;
+
+  dec->record_from = 0;
+  result = decode_run(stream, size, channel);
+  if (dec->record_capturing && dec->record_from < size)
+    record_append(stream + dec->record_from, size - dec->record_from);  /* event continues in the next buffer */
+  return result;
+}
+
 void ctf_decode_cleanup(void)
 {
+  CTF_DECODER *dec = decoder();
+  program_clear();
+  symcache_clear();
+  dec->program = NULL;
+  dec->event = NULL;
+  dec->state = STATE_SCAN_MAGIC;
   cache_clear();
   msgbuffer_clear();
   msgstack_clear();
@@ -777,7 +1370,72 @@ void ctf_decode_cleanup(void)
 
 void ctf_decode_reset(void)
 {
+  CTF_DECODER *dec = decoder();
   cache_reset();
   msgbuffer_reset();
-  state = STATE_SCAN_MAGIC;
+  record_cancel();
+  dec->state = STATE_SCAN_MAGIC;
+}
+
+/** ctf_decoder_create() allocates a decoder for a trace stream, bound to a
+ *  parsed TSDL file. The functions in this module work on the default decoder,
+ *  but a thread can switch to a different decoder with ctf_decoder_select(),
+ *  so that independent streams can be decoded concurrently.
+ *
+ *  \param tsdl    The model with the parsed TSDL file, or NULL for the default
+ *                 model.
+ *
+ *  \return The new decoder, or NULL on failure.
+ */
+CTF_DECODER *ctf_decoder_create(CTF_MODEL *tsdl)
+{
+  CTF_DECODER *dec = (CTF_DECODER*)malloc(sizeof(CTF_DECODER));
+  if (dec != NULL) {
+    memset(dec, 0, sizeof(CTF_DECODER));
+    dec->model = tsdl;
+    dec->state = STATE_SCAN_MAGIC;
+  }
+  return dec;
+}
+
+/** ctf_decoder_delete() closes the recording of a decoder (if any) and frees
+ *  it. The model that it is bound to is not deleted. The decoder may not be
+ *  selected in another thread.
+ */
+void ctf_decoder_delete(CTF_DECODER *dec)
+{
+  CTF_DECODER *prev = current_decoder;
+  assert(dec != NULL && dec != &default_decoder);
+  current_decoder = dec;
+  ctf_record_close();
+  ctf_decode_cleanup();
+  current_decoder = (prev != dec) ? prev : NULL;
+  free((void*)dec);
+}
+
+/** ctf_decoder_select() selects the decoder for the calling thread, and the
+ *  model that the decoder is bound to. Pass NULL to return to the default
+ *  decoder and model.
+ */
+void ctf_decoder_select(CTF_DECODER *dec)
+{
+  current_decoder = dec;
+  ctf_model_select((dec != NULL) ? dec->model : NULL);
+}
+
+/** ctf_decoder_watch() makes a decoder scan the stream for a single event,
+ *  instead of decoding all events to text. The events are still parsed, but
+ *  the fields are not formatted and no messages go on the message stack.
+ *  While the watch is set, ctf_decode() returns the number of times that the
+ *  event was found.
+ *
+ *  \param dec       A decoder made with ctf_decoder_create().
+ *  \param event_id  The id of the event to watch for, or -1 to return to
+ *                   normal decoding.
+ */
+void ctf_decoder_watch(CTF_DECODER *dec, int event_id)
+{
+  assert(dec != NULL && dec != &default_decoder);
+  dec->watch = (event_id >= 0);
+  dec->watch_id = event_id;
 }
@@ -20,13 +20,24 @@
 #define _DECODECTF_H
 
 #include "dwarf.h"
+#include "parsetsdl.h"
+
+typedef struct tagCTF_DECODER CTF_DECODER;
 
 int ctf_decode(const unsigned char *stream, size_t size, long channel);
 void ctf_decode_reset(void);
 void ctf_decode_cleanup(void);
 void ctf_set_symtable(const DWARF_SYMBOLLIST *symtable);
 int msgstack_pop(uint16_t *streamid, double *timestamp, char *message, size_t size);
-int msgstack_peek(uint16_t *streamid, double *timestamp, const char **message);
+int msgstack_peek(uint16_t *streamid, double *timestamp, const char **message, size_t *length);
+
+int ctf_record_open(const char *path, const char *metadata, int notext);
+void ctf_record_close(void);
+
+CTF_DECODER *ctf_decoder_create(CTF_MODEL *tsdl);
+void ctf_decoder_delete(CTF_DECODER *dec);
+void ctf_decoder_select(CTF_DECODER *dec);
+void ctf_decoder_watch(CTF_DECODER *dec, int event_id);
 
 #endif /* _DECODECTF_H */
 
@@ -18,9 +18,11 @@
 #include <assert.h>
 #include <ctype.h>
 #include <stdbool.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include "c11threads.h"
 #include "demangle.h"
 
 #if defined __POCC__ || defined __MINGW32__ || defined __MINGW64__
@@ -1655,18 +1657,8 @@ static void _encoding(struct mangle *mangle)
   }
 }
 
-int demangle(char *plain, size_t size, const char *mangled)
+static int demangle_run(char *plain, size_t size, const char *mangled)
 {
-  assert(plain != NULL);
-  assert(size > 0);
-  assert(mangled != NULL);
-
-  /* <mangled-name> := _Z <encoding>
-                       _Z <encoding> . <vendor-specific suffix>   #not currently handled
-   */
-  if (mangled[0] != '_' || mangled[1] != 'Z')
-    return 0;
-
   struct mangle mangle;
   mangle.plain = plain;
   mangle.size = size;
@@ -1699,3 +1691,265 @@ int demangle(char *plain, size_t size, const char *mangled)
   return mangle.valid;
 }
 
+/* The demangle cache holds the results of earlier calls, keyed on the hash of
+   the mangled name (and the size of the output buffer, because a result may
+   be truncated). The strings are stored in an arena, which is only freed as a
+   whole. */
+#define DMG_BLOCKSIZE   (64 * 1024)
+#define DMG_MAXENTRIES  (64 * 1024)
+#define DMG_MAGIC       "DMC1"
+
+typedef struct tagDMGBLOCK {
+  struct tagDMGBLOCK *next;
+  size_t used, size;
+  char data[];          /* flexible array member */
+} DMGBLOCK;
+
+typedef struct tagDMGENTRY {
+  uint32_t hash;
+  uint16_t size;        /* size of the output buffer that was used */
+  bool valid;           /* result of demangle() */
+  const char *mangled;  /* NULL for an empty slot */
+  const char *plain;
+} DMGENTRY;
+
+static DMGENTRY *dmg_table = NULL;
+static unsigned dmg_tablesize = 0;  /* always a power of 2 */
+static unsigned dmg_count = 0;
+static DMGBLOCK *dmg_arena = NULL;
+static mtx_t dmg_lock;
+static once_flag dmg_once = ONCE_FLAG_INIT;
+
+static void dmg_init(void)
+{
+  mtx_init(&dmg_lock, mtx_plain);
+}
+
+static uint32_t dmg_hash(const char *name)
+{
+  uint32_t h = 2166136261u; /* FNV-1a */
+  while (*name != '\0')
+    h = (h ^ (unsigned char)*name++) * 16777619u;
+  return h;
+}
+
+/* dmg_strdup() copies a string into the arena */
+static const char *dmg_strdup(const char *text)
+{
+  assert(text != NULL);
+  size_t len = strlen(text) + 1;
+  if (dmg_arena == NULL || dmg_arena->used + len > dmg_arena->size) {
+    size_t size = (len > DMG_BLOCKSIZE) ? len : DMG_BLOCKSIZE;
+    DMGBLOCK *block = malloc(sizeof(DMGBLOCK) + size);
+    if (block == NULL)
+      return NULL;
+    block->next = dmg_arena;
+    block->used = 0;
+    block->size = size;
+    dmg_arena = block;
+  }
+  char *str = dmg_arena->data + dmg_arena->used;
+  memcpy(str, text, len);
+  dmg_arena->used += len;
+  return str;
+}
+
+/* dmg_lookup() returns the slot for the name & size; this is either the slot
+   that holds the entry, or the empty slot where it should be inserted */
+static DMGENTRY *dmg_lookup(const char *mangled, uint32_t hash, size_t size)
+{
+  assert(dmg_table != NULL && dmg_tablesize > 0);
+  unsigned idx = hash & (dmg_tablesize - 1);
+  while (dmg_table[idx].mangled != NULL) {
+    const DMGENTRY *entry = &dmg_table[idx];
+    if (entry->hash == hash && entry->size == size && strcmp(entry->mangled, mangled) == 0)
+      break;
+    idx = (idx + 1) & (dmg_tablesize - 1);
+  }
+  return &dmg_table[idx];
+}
+
+/* dmg_insert() adds an entry to the cache (the lock must be held) */
+static void dmg_insert(const char *mangled, uint32_t hash, size_t size,
+                       const char *plain, bool valid)
+{
+  if (dmg_count >= DMG_MAXENTRIES || size > UINT16_MAX)
+    return;
+  if (2 * (dmg_count + 1) > dmg_tablesize) {
+    /* grow the table, keep it at most half full */
+    unsigned newsize = (dmg_tablesize == 0) ? 1024 : 2 * dmg_tablesize;
+    DMGENTRY *table = calloc(newsize, sizeof(DMGENTRY));
+    if (table == NULL)
+      return;
+    DMGENTRY *oldtable = dmg_table;
+    unsigned oldsize = dmg_tablesize;
+    dmg_table = table;
+    dmg_tablesize = newsize;
+    for (unsigned i = 0; i < oldsize; i++)
+      if (oldtable[i].mangled != NULL)
+        *dmg_lookup(oldtable[i].mangled, oldtable[i].hash, oldtable[i].size) = oldtable[i];
+    free((void*)oldtable);
+  }
+  DMGENTRY *entry = dmg_lookup(mangled, hash, size);
+  if (entry->mangled != NULL)
+    return;   /* already present */
+  const char *m = dmg_strdup(mangled);
+  const char *p = valid ? dmg_strdup(plain) : "";
+  if (m == NULL || p == NULL)
+    return;
+  entry->hash = hash;
+  entry->size = (uint16_t)size;
+  entry->valid = valid;
+  entry->mangled = m;
+  entry->plain = p;
+  dmg_count += 1;
+}
+
+/** demangle() converts a mangled C++ name to the human-readable form. The
+ *  results are cached, so that demangling the same name again is quick.
+ *
+ *  \param plain    [out] The demangled name.
+ *  \param size     The size of the plain buffer, in characters.
+ *  \param mangled  The mangled name.
+ *
+ *  \return 1 on success, 0 if the name is not a mangled name (or it could not
+ *          be demangled). On failure, the contents of "plain" is undefined.
+ */
+int demangle(char *plain, size_t size, const char *mangled)
+{
+  assert(plain != NULL);
+  assert(size > 0);
+  assert(mangled != NULL);
+
+  /* <mangled-name> := _Z <encoding>
+                       _Z <encoding> . <vendor-specific suffix>   #not currently handled
+   */
+  if (mangled[0] != '_' || mangled[1] != 'Z')
+    return 0;
+
+  call_once(&dmg_once, dmg_init);
+  uint32_t hash = dmg_hash(mangled);
+  mtx_lock(&dmg_lock);
+  if (dmg_table != NULL) {
+    const DMGENTRY *entry = dmg_lookup(mangled, hash, size);
+    if (entry->mangled != NULL) {
+      int valid = entry->valid;
+      if (valid)
+        strcpy(plain, entry->plain);  /* length was checked on insertion */
+      mtx_unlock(&dmg_lock);
+      return valid;
+    }
+  }
+  mtx_unlock(&dmg_lock);
+
+  int result = demangle_run(plain, size, mangled);
+
+  mtx_lock(&dmg_lock);
+  dmg_insert(mangled, hash, size, plain, result != 0);
+  mtx_unlock(&dmg_lock);
+  return result;
+}
+
+/** demangle_cache_clear() removes all entries from the demangle cache.
+ */
+void demangle_cache_clear(void)
+{
+  call_once(&dmg_once, dmg_init);
+  mtx_lock(&dmg_lock);
+  if (dmg_table != NULL) {
+    free((void*)dmg_table);
+    dmg_table = NULL;
+  }
+  dmg_tablesize = 0;
+  dmg_count = 0;
+  while (dmg_arena != NULL) {
+    DMGBLOCK *block = dmg_arena;
+    dmg_arena = block->next;
+    free((void*)block);
+  }
+  mtx_unlock(&dmg_lock);
+}
+
+/** demangle_cache_load() adds the entries of a file (previously written with
+ *  demangle_cache_save()) to the cache.
+ *
+ *  \param filename   The full path of the file.
+ *
+ *  \return true on success, false if the file is absent or invalid.
+ */
+bool demangle_cache_load(const char *filename)
+{
+  assert(filename != NULL);
+  FILE *fp = fopen(filename, "rb");
+  if (fp == NULL)
+    return false;
+  char magic[4];
+  bool result = (fread(magic, 1, sizeof magic, fp) == sizeof magic
+                 && memcmp(magic, DMG_MAGIC, sizeof magic) == 0);
+  call_once(&dmg_once, dmg_init);
+  mtx_lock(&dmg_lock);
+  /* each record is: size (2 bytes, little endian), valid flag (1 byte),
+     mangled name, demangled name (both zero-terminated) */
+  char mangled[1024], plain[1024];
+  while (result) {
+    int c0 = fgetc(fp);
+    if (c0 == EOF)
+      break;
+    int c1 = fgetc(fp);
+    int flag = fgetc(fp);
+    if (c1 == EOF || flag == EOF) {
+      result = false;
+      break;
+    }
+    size_t size = (size_t)c0 | ((size_t)c1 << 8);
+    char *fields[2] = { mangled, plain };
+    for (int f = 0; f < 2 && result; f++) {
+      size_t len = 0;
+      int c;
+      while ((c = fgetc(fp)) != EOF && c != '\0' && len + 1 < sizeof mangled)
+        fields[f][len++] = (char)c;
+      fields[f][len] = '\0';
+      if (c != '\0')
+        result = false;
+    }
+    if (result && size > 0 && (flag == 0 || strlen(plain) < size)
+        && mangled[0] == '_' && mangled[1] == 'Z')
+      dmg_insert(mangled, dmg_hash(mangled), size, plain, flag != 0);
+  }
+  mtx_unlock(&dmg_lock);
+  fclose(fp);
+  return result;
+}
+
+/** demangle_cache_save() writes all entries in the cache to a file.
+ *
+ *  \param filename   The full path of the file.
+ *
+ *  \return true on success, false on failure.
+ */
+bool demangle_cache_save(const char *filename)
+{
+  assert(filename != NULL);
+  FILE *fp = fopen(filename, "wb");
+  if (fp == NULL)
+    return false;
+  bool result = (fwrite(DMG_MAGIC, 1, 4, fp) == 4);
+  call_once(&dmg_once, dmg_init);
+  mtx_lock(&dmg_lock);
+  for (unsigned i = 0; i < dmg_tablesize && result; i++) {
+    const DMGENTRY *entry = &dmg_table[i];
+    if (entry->mangled == NULL)
+      continue;
+    fputc(entry->size & 0xff, fp);
+    fputc((entry->size >> 8) & 0xff, fp);
+    fputc(entry->valid ? 1 : 0, fp);
+    fwrite(entry->mangled, 1, strlen(entry->mangled) + 1, fp);
+    result = (fwrite(entry->plain, 1, strlen(entry->plain) + 1, fp) == strlen(entry->plain) + 1);
+  }
+  mtx_unlock(&dmg_lock);
+  if (fclose(fp) != 0)
+    result = false;
+  if (!result)
+    remove(filename);
+  return result;
+}
@@ -17,6 +17,13 @@
 #ifndef _DEMANGLE_H
 #define _DEMANGLE_H
 
-int demangle(char *plain, size_t size, const char *mangled);
+#include <stdbool.h>
+#include <stddef.h>
+
+int  demangle(char *plain, size_t size, const char *mangled);
+
+void demangle_cache_clear(void);
+bool demangle_cache_load(const char *filename);
+bool demangle_cache_save(const char *filename);
 
 #endif /* _DEMANGLE_H */
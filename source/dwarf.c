@@ -1,1939 +1,3543 @@
-/* Routines to get the line number and symbol tables from the DWARF debug
- * information (in an ELF file). For the symbol table, only the function and
- * variable symbols are stored.
- * For the moment, only 32-bit Little-Endian executables are supported.
- *
- * Copyright (c) 2015,2019-2022 CompuPhase
- *
- * Licensed under the Apache License, Version 2.0 (the "License");
- * you may not use this file except in compliance with the License.
- * You may obtain a copy of the License at
- *
- *     http://www.apache.org/licenses/LICENSE-2.0
- *
- * Unless required by applicable law or agreed to in writing, software
- * distributed under the License is distributed on an "AS IS" BASIS,
- * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
- * See the License for the specific language governing permissions and
- * limitations under the License.
- */
-#include <assert.h>
-#include <stdio.h>
-#include <stdbool.h>
-#include <stdint.h>
-#include <stdlib.h>
-#include <string.h>
-#include "demangle.h"
-#include "elf.h"
-#include "dwarf.h"
-
-#if defined FORTIFY
-# include <alloc/fortify.h>
-#endif
-
-#if defined __GNUC__
-# define PACKED        __attribute__((packed))
-#else
-# define PACKED
-#endif
-
-#if defined __LINUX__ || defined __FreeBSD__ || defined __APPLE__
-# pragma pack(1)       /* structures must be packed (byte-aligned) */
-#elif defined MACOS && defined __MWERKS__
-# pragma options align=mac68k
-#else
-# pragma pack(push)
-# pragma pack(1)       /* structures must be packed (byte-aligned) */
-# if defined __TURBOC__
-#   pragma option -a-  /* "pack" pragma for older Borland compilers */
-# endif
-#endif
-#if defined _MSC_VER
-# define strdup(s)   _strdup(s)
-#endif
-
-#if !defined _MAX_PATH
-# define _MAX_PATH 260
-#endif
-
-typedef struct tagDWARFTABLE {
-  unsigned long offset;
-  unsigned long size;
-} DWARFTABLE;
-
-enum {
-  TABLE_INFO,
-  TABLE_ABBREV,
-  TABLE_STR,
-  TABLE_LINE,
-  TABLE_PUBNAME,
-  TABLE_LINE_STR,
-  /* ----- */
-  TABLE_COUNT
-};
-
-typedef struct tagUNIT_HDR32 {
-  uint32_t unit_length;     /* total length of this block, excluding this field */
-  uint16_t version;         /* table format version */
-  uint8_t  unit_type;       /* DWARF 5+, type of the compilation unit */
-  uint8_t  address_size;    /* size in bytes of an address */
-  uint32_t abbrev_offs;     /* offset into the .debug_abbrev table */
-  /* more fields may follow, depending on unit_type */
-} PACKED UNIT_HDR32;
-
-typedef struct tagUNIT_HDR64 {
-  uint32_t reserved;        /* must be 0xffffffff */
-  uint64_t unit_length;     /* total length of this block, excluding this field */
-  uint16_t version;         /* table format version */
-  uint8_t  unit_type;       /* DWARF 5+, type of the compilation unit */
-  uint8_t  address_size;    /* size in bytes of an address */
-  uint64_t abbrev_offs;     /* offset into the .debug_abbrev table */
-  /* more fields may follow, depending on unit_type */
-} PACKED UNIT_HDR64;
-
-typedef struct tagDWARF_PROLOGUE32 {  /* fixed part of the header */
-  uint32_t total_length;    /* length of the line number table, minus the 4 bytes for this total_length field */
-  uint16_t version;         /* prologue format version */
-  uint8_t  address_size;    /* DWARF 5+, size in bytes of an address */
-  uint8_t  segment_sel_size;/* DWARF 5+, size in bytes of a segment selector on the target system */
-  uint32_t prologue_length; /* offset to the first opcode of the line number program (relative to this prologue_length field) */
-  uint8_t  min_instruction_size;
-  uint8_t  max_oper_per_instruction;  /* DWARF 4+, for VLIW architectures */
-  uint8_t  default_is_stmt; /* default value to initialize the state machine with */
-  int8_t   line_base;
-  uint8_t  line_range;
-  uint8_t  opcode_base;     /* number of the first special opcode */
-  /* standard opcode lengths (array of length "opcode_base" - 1) */
-
-  /* DWARF 2..4, include directories, a sequence of zero-terminated strings (and
-     the sequence itself ends with a zero-byte) */
-  /* DWARF 2..4, file names: base name, location, modification date, size */
-
-  /* DWARF 5+, directory entry formats (length-prefixed array of ULEB128 pairs) */
-  /* DWARF 5+, include directories, a length-prefixed sequence of entries in a format described in the earier table */
-  /* DWARF 5+, filename entry formats (length-prefixed array of ULEB128 pairs) */
-  /* DWARF 5+, filenames, a length-prefixed sequence of entries in a format described in the earier table */
-} PACKED DWARF_PROLOGUE32;
-
-typedef struct tagSTATE {
-  uint32_t address;
-  int file;
-  int line;
-  int column;
-  int is_stmt;          /* whether the address is the start of a statement */
-  int basic_block;      /* whether the address is the start of a basic block */
-  int end_seq;
-  int prologue_end;     /* DWARF 3+, function prologue end */
-  int epiloge_begin;    /* DWARF 3+, function epilogue start */
-  int isa;              /* DWARF 3+, instruction set architecture */
-  unsigned op_index;    /* DWARF 4+, index within a "Very-Long-Instruction-Word" (VLIW) */
-  int discriminator;    /* DWARF 4+, compiler-assigned id for a "block" to which the instruction belongs */
-} STATE;
-
-typedef struct tagPUBNAME_HDR32 {
-  uint32_t totallength; /* total length of this block, excluding this field */
-  uint16_t version;
-  uint32_t info_offs;   /* offset into the comprehensive debug table */
-  uint32_t info_size;   /* size of this symbol in the comprehensive debug table */
-} PACKED PUBNAME_HDR32;
-
-/* unit headers (DWARF 5+) */
-#define DW_UT_compile                 0x01
-#define DW_UT_type                    0x02
-#define DW_UT_partial                 0x03
-#define DW_UT_skeleton                0x04
-#define DW_UT_split_compile           0x05
-#define DW_UT_split_type              0x06
-#define DW_UT_lo_user                 0x80
-#define DW_UT_hi_user                 0xff
-
-/* tags */
-#define DW_TAG_array_type             0x01
-#define DW_TAG_class_type             0x02
-#define DW_TAG_entry_point            0x03
-#define DW_TAG_enumeration_type       0x04
-#define DW_TAG_formal_parameter       0x05
-#define DW_TAG_imported_declaration   0x08
-#define DW_TAG_label                  0x0a
-#define DW_TAG_lexical_block          0x0b
-#define DW_TAG_member                 0x0d
-#define DW_TAG_pointer_type           0x0f
-#define DW_TAG_reference_type         0x10
-#define DW_TAG_compile_unit           0x11
-#define DW_TAG_string_type            0x12
-#define DW_TAG_structure_type         0x13
-#define DW_TAG_subroutine_type        0x15
-#define DW_TAG_typedef                0x16
-#define DW_TAG_union_type             0x17
-#define DW_TAG_unspecified_parameters 0x18
-#define DW_TAG_variant                0x19
-#define DW_TAG_common_block           0x1a
-#define DW_TAG_common_inclusion       0x1b
-#define DW_TAG_inheritance            0x1c
-#define DW_TAG_inlined_subroutine     0x1d
-#define DW_TAG_module                 0x1e
-#define DW_TAG_ptr_to_member_type     0x1f
-#define DW_TAG_set_type               0x20
-#define DW_TAG_subrange_type          0x21
-#define DW_TAG_with_stmt              0x22
-#define DW_TAG_access_declaration     0x23
-#define DW_TAG_base_type              0x24
-#define DW_TAG_catch_block            0x25
-#define DW_TAG_const_type             0x26
-#define DW_TAG_constant               0x27
-#define DW_TAG_enumerator             0x28
-#define DW_TAG_file_type              0x29
-#define DW_TAG_friend                 0x2a
-#define DW_TAG_namelist               0x2b
-#define DW_TAG_namelist_item          0x2c
-#define DW_TAG_packed_type            0x2d
-#define DW_TAG_subprogram             0x2e
-#define DW_TAG_template_type_param    0x2f
-#define DW_TAG_template_value_param   0x30
-#define DW_TAG_thrown_type            0x31
-#define DW_TAG_try_block              0x32
-#define DW_TAG_variant_part           0x33
-#define DW_TAG_variable               0x34
-#define DW_TAG_volatile_type          0x35
-#define DW_TAG_dwarf_procedure        0x36
-#define DW_TAG_restrict_type          0x37
-#define DW_TAG_interface_type         0x38
-#define DW_TAG_namespace              0x39
-#define DW_TAG_imported_module        0x3a
-#define DW_TAG_unspecified_type       0x3b
-#define DW_TAG_partial_unit           0x3c
-#define DW_TAG_imported_unit          0x3d
-#define DW_TAG_condition              0x3f
-#define DW_TAG_shared_type            0x40
-#define DW_TAG_type_unit              0x41
-#define DW_TAG_rvalue_reference_type  0x42
-#define DW_TAG_template_alias         0x43
-    /* DWARF 5+ */
-#define DW_TAG_coarray_type           0x44
-#define DW_TAG_generic_subrange       0x45
-#define DW_TAG_dynamic_type           0x46
-#define DW_TAG_atomic_type            0x47
-#define DW_TAG_call_site              0x48
-#define DW_TAG_call_site_parameter    0x49
-#define DW_TAG_skeleton_unit          0x4a
-#define DW_TAG_immutable_type         0x4b
-#define DW_TAG_lo_user                0x4080
-#define DW_TAG_hi_user                0xffff
-
-#define DW_AT_sibling                 0x01  /* reference */
-#define DW_AT_location                0x02  /* block, constant */
-#define DW_AT_name                    0x03  /* string */
-#define DW_AT_ordering                0x09  /* constant */
-#define DW_AT_byte_size               0x0b  /* constant */
-#define DW_AT_bit_offset              0x0c  /* constant */
-#define DW_AT_bit_size                0x0d  /* constant */
-#define DW_AT_stmt_list               0x10  /* constant */
-#define DW_AT_low_pc                  0x11  /* address */
-#define DW_AT_high_pc                 0x12  /* address */
-#define DW_AT_language                0x13  /* constant */
-#define DW_AT_discr                   0x15  /* reference */
-#define DW_AT_discr_value             0x16  /* constant */
-#define DW_AT_visibility              0x17  /* constant */
-#define DW_AT_import                  0x18  /* reference */
-#define DW_AT_string_length           0x19  /* block, constant */
-#define DW_AT_common_reference        0x1a  /* reference */
-#define DW_AT_comp_dir                0x1b  /* string */
-#define DW_AT_const_value             0x1c  /* string, constant, block */
-#define DW_AT_containing_type         0x1d  /* reference */
-#define DW_AT_default_value           0x1e  /* reference */
-#define DW_AT_inline                  0x20  /* constant */
-#define DW_AT_is_optional             0x21  /* flag */
-#define DW_AT_lower_bound             0x22  /* constant, reference */
-#define DW_AT_producer                0x25  /* string */
-#define DW_AT_prototyped              0x27  /* flag */
-#define DW_AT_return_addr             0x2a  /* block, constant */
-#define DW_AT_start_scope             0x2c  /* constant */
-#define DW_AT_stride_size             0x2e  /* constant */
-#define DW_AT_upper_bound             0x2f  /* constant, reference */
-#define DW_AT_abstract_origin         0x31  /* reference */
-#define DW_AT_accessibility           0x32  /* constant */
-#define DW_AT_address_class           0x33  /* constant */
-#define DW_AT_artificial              0x34  /* flag */
-#define DW_AT_base_types              0x35  /* reference */
-#define DW_AT_calling_convention      0x36  /* constant */
-#define DW_AT_count                   0x37  /* constant, reference */
-#define DW_AT_data_member_location    0x38  /* block, reference */
-#define DW_AT_decl_column             0x39  /* constant */
-#define DW_AT_decl_file               0x3a  /* constant */
-#define DW_AT_decl_line               0x3b  /* constant */
-#define DW_AT_declaration             0x3c  /* flag */
-#define DW_AT_discr_list              0x3d  /* block */
-#define DW_AT_encoding                0x3e  /* constant */
-#define DW_AT_external                0x3f  /* flag */
-#define DW_AT_frame_base              0x40  /* block, constant */
-#define DW_AT_friend                  0x41  /* reference */
-#define DW_AT_identifier_case         0x42  /* constant */
-#define DW_AT_macro_info              0x43  /* constant */
-#define DW_AT_namelist_item           0x44  /* block */
-#define DW_AT_priority                0x45  /* reference */
-#define DW_AT_segment                 0x46  /* block, constant */
-#define DW_AT_specification           0x47  /* reference */
-#define DW_AT_static_link             0x48  /* block, constant */
-#define DW_AT_type                    0x49  /* reference */
-#define DW_AT_use_location            0x4a  /* block, constant */
-#define DW_AT_variable_parameter      0x4b  /* flag */
-#define DW_AT_virtuality              0x4c  /* constant */
-#define DW_AT_vtable_elem_location    0x4d  /* exprloc, loclist */
-#define DW_AT_allocated               0x4e  /* constant, exprloc, reference */
-#define DW_AT_associated              0x4f  /* constant, exprloc, reference */
-#define DW_AT_data_location           0x50  /* exprloc */
-#define DW_AT_byte_stride             0x51  /* constant, exprloc, reference */
-#define DW_AT_entry_pc                0x52  /* address, constant */
-#define DW_AT_use_UTF8                0x53  /* flag */
-#define DW_AT_extension               0x54  /* reference */
-#define DW_AT_ranges                  0x55  /* rnglist */
-#define DW_AT_trampoline              0x56  /* address, flag, reference, string */
-#define DW_AT_call_column             0x57  /* constant */
-#define DW_AT_call_file               0x58  /* constant */
-#define DW_AT_call_line               0x59  /* constant */
-#define DW_AT_description             0x5a  /* string */
-#define DW_AT_binary_scale            0x5b  /* constant */
-#define DW_AT_decimal_scale           0x5c  /* constant */
-#define DW_AT_small                   0x5d  /* reference */
-#define DW_AT_decimal_sign            0x5e  /* constant */
-#define DW_AT_digit_count             0x5f  /* constant */
-#define DW_AT_picture_string          0x60  /* string */
-#define DW_AT_mutable                 0x61  /* flag */
-#define DW_AT_threads_scaled          0x62  /* flag */
-#define DW_AT_explicit                0x63  /* flag */
-#define DW_AT_object_pointer          0x64  /* reference */
-#define DW_AT_endianity               0x65  /* constant */
-#define DW_AT_elemental               0x66  /* flag */
-#define DW_AT_pure                    0x67  /* flag */
-#define DW_AT_recursive               0x68  /* flag */
-#define DW_AT_signature               0x69  /* reference */
-#define DW_AT_main_subprogram         0x6a  /* flag */
-#define DW_AT_data_bit_offset         0x6b  /* constant */
-#define DW_AT_const_expr              0x6c  /* flag */
-#define DW_AT_enum_class              0x6d  /* flag */
-#define DW_AT_linkage_name            0x6e  /* string */
-    /* DWARF 5+ */
-#define DW_AT_string_length_bit_size  0x6f  /* constant */
-#define DW_AT_string_length_byte_size 0x70  /* constant */
-#define DW_AT_rank                    0x71  /* constant, exprloc */
-#define DW_AT_str_offsets_base        0x72  /* stroffsetsptr */
-#define DW_AT_addr_base               0x73  /* addrptr */
-#define DW_AT_rnglists_base           0x74  /* rnglistsptr */
-#define DW_AT_dwo_name                0x76  /* string */
-#define DW_AT_reference               0x77  /* flag */
-#define DW_AT_rvalue_reference        0x78  /* flag */
-#define DW_AT_macros                  0x79  /* macptr */
-#define DW_AT_call_all_calls          0x7a  /* flag */
-#define DW_AT_call_all_source_calls   0x7b  /* flag */
-#define DW_AT_call_all_tail_calls     0x7c  /* flag */
-#define DW_AT_call_return_pc          0x7d  /* address */
-#define DW_AT_call_value              0x7e  /* exprloc */
-#define DW_AT_call_origin             0x7f  /* exprloc */
-#define DW_AT_call_parameter          0x80  /* reference */
-#define DW_AT_call_pc                 0x81  /* address */
-#define DW_AT_call_tail_call          0x82  /* flag */
-#define DW_AT_call_target             0x83  /* exprloc */
-#define DW_AT_call_target_clobbered   0x84  /* exprloc */
-#define DW_AT_call_data_location      0x85  /* exprloc */
-#define DW_AT_call_data_value         0x86  /* exprloc */
-#define DW_AT_noreturn                0x87  /* flag */
-#define DW_AT_alignment               0x88  /* constant */
-#define DW_AT_export_symbols          0x89  /* flag */
-#define DW_AT_deleted                 0x8a  /* flag */
-#define DW_AT_defaulted               0x8b  /* constant */
-#define DW_AT_loclists_base           0x8c  /* loclistsptr */
-#define DW_AT_lo_user                 0x2000
-#define DW_AT_hi_user                 0x3fff
-
-#define DW_FORM_addr                  0x01  /* address, 4 bytes for 32-bit, 8 bytes for 64-bit */
-#define DW_FORM_block2                0x03  /* block, 2-byte length + up to 64K data bytes */
-#define DW_FORM_block4                0x04  /* block, 4-byte length + up to 4G data bytes */
-#define DW_FORM_data2                 0x05  /* constant, 2 bytes */
-#define DW_FORM_data4                 0x06  /* constant, 4 bytes */
-#define DW_FORM_data8                 0x07  /* constant, 8 bytes */
-#define DW_FORM_string                0x08  /* string, zero-terminated */
-#define DW_FORM_block                 0x09  /* block, unsigned LEB128-encoded length + data bytes */
-#define DW_FORM_block1                0x0a  /* block, 1-byte length + up to 255 data bytes */
-#define DW_FORM_data1                 0x0b  /* constant, 1 bytes */
-#define DW_FORM_flag                  0x0c  /* flag, 1 byte (0=false, any non-zero=true) */
-#define DW_FORM_sdata                 0x0d  /* constant, signed LEB128 */
-#define DW_FORM_strp                  0x0e  /* string, 4-byte offset into the .debug_str section */
-#define DW_FORM_udata                 0x0f  /* constant, unsigned LEB128 */
-#define DW_FORM_ref_addr              0x10  /* reference, address size (4 bytes on 32-bit, 8 bytes on 64-bit) */
-#define DW_FORM_ref1                  0x11  /* reference, 1 bytes */
-#define DW_FORM_ref2                  0x12  /* reference, 2 bytes */
-#define DW_FORM_ref4                  0x13  /* reference, 4 bytes */
-#define DW_FORM_ref8                  0x14  /* reference, 8 bytes */
-#define DW_FORM_ref_udata             0x15  /* reference, unsigned LEB128 */
-#define DW_FORM_indirect              0x16  /* format is specified in the .debug_info data (not in the abbreviation) */
-    /* DWARF 4+ */
-#define DW_FORM_sec_offset            0x17  /* offset into the .debug_line section (4 bytes on 32-bit, 8 bytes on 64-bit) */
-#define DW_FORM_exprloc               0x18  /* block for expression/location, unsigned LEB128-encoded length + data bytes */
-#define DW_FORM_flag_present          0x19  /* implicit flag (no data) */
-    /* DWARF 5+ */
-#define DW_FORM_strx                  0x1a  /* string */
-#define DW_FORM_addrx                 0x1b  /* address */
-#define DW_FORM_ref_sup4              0x1c  /* reference relative to .debug_info of a supplementaty object file, 4 bytes */
-#define DW_FORM_strp_sup              0x1d  /* string, 4-byte offset into the .debug_str section of a supplementary object file */
-#define DW_FORM_data16                0x1e  /* constant, 16 bytes (MD5) */
-#define DW_FORM_line_strp             0x1f  /* string, 4-byte offset into the .debug_line_str section */
-#define DW_FORM_ref_sig8              0x20  /* 64-bit signature for a type defined in a different unit (already present in DWARF 4) */
-#define DW_FORM_implicit_const        0x21  /* constant whose value is in the abbreviation's attribute, not in the .debug_info data */
-#define DW_FORM_loclistx              0x22  /* loclist */
-#define DW_FORM_rnglistx              0x23  /* rnglist */
-#define DW_FORM_ref_sup8              0x24  /* reference relative to .debug_info of a supplementaty object file, 8 bytes */
-#define DW_FORM_strx1                 0x25  /* string */
-#define DW_FORM_strx2                 0x26  /* string */
-#define DW_FORM_strx3                 0x27  /* string */
-#define DW_FORM_strx4                 0x28  /* string */
-#define DW_FORM_addrx1                0x29  /* address */
-#define DW_FORM_addrx2                0x2a  /* address */
-#define DW_FORM_addrx3                0x2b  /* address */
-#define DW_FORM_addrx4                0x2c  /* address */
-
-/* line number opcodes */
-#define DW_LNS_extended_op            0     /* version 2+ */
-#define DW_LNS_copy                   1
-#define DW_LNS_advance_pc             2
-#define DW_LNS_advance_line           3
-#define DW_LNS_set_file               4
-#define DW_LNS_set_column             5
-#define DW_LNS_negate_stmt            6
-#define DW_LNS_set_basic_block        7
-#define DW_LNS_const_add_pc           8
-#define DW_LNS_fixed_advance_pc       9
-#define DW_LNS_set_prologue_end       10    /* version 3+ */
-#define DW_LNS_set_epilogue_begin     11
-#define DW_LNS_set_isa                12
-/* line number extended opcodes */
-#define DW_LNE_end_sequence           1     /* version 2+ */
-#define DW_LNE_set_address            2
-#define DW_LNE_define_file            3     /* deprecated in version 5+ */
-#define DW_LNE_set_discriminator      4     /* version 4+ */
-#define DW_LNE_lo_user                0x80
-#define DW_LNE_hi_user                0xff
-
-/* location expression opcodes */
-#define DW_OP_addr                    0x03  /* constant address (32-bit or 64-bit) */
-#define DW_OP_deref                   0x06
-#define DW_OP_const1u                 0x08  /* 1-byte constant */
-#define DW_OP_const1s                 0x09  /* 1-byte constant */
-#define DW_OP_const2u                 0x0a  /* 2-byte constant */
-#define DW_OP_const2s                 0x0b  /* 2-byte constant */
-#define DW_OP_const4u                 0x0c  /* 4-byte constant */
-#define DW_OP_const4s                 0x0d  /* 4-byte constant */
-#define DW_OP_const8u                 0x0e  /* 8-byte constant */
-#define DW_OP_const8s                 0x0f  /* 8-byte constant */
-#define DW_OP_constu                  0x10  /* ULEB128 constant */
-#define DW_OP_consts                  0x11  /* SLEB128 constant */
-#define DW_OP_dup                     0x12
-#define DW_OP_drop                    0x13
-#define DW_OP_over                    0x14
-#define DW_OP_pick                    0x15  /* 1-byte stack index */
-#define DW_OP_swap                    0x16
-#define DW_OP_rot                     0x17
-#define DW_OP_xderef                  0x18
-#define DW_OP_abs                     0x19
-#define DW_OP_and                     0x1a
-#define DW_OP_div                     0x1b
-#define DW_OP_minus                   0x1c
-#define DW_OP_mod                     0x1d
-#define DW_OP_mul                     0x1e
-#define DW_OP_neg                     0x1f
-#define DW_OP_not                     0x20
-#define DW_OP_or                      0x21
-#define DW_OP_plus                    0x22
-#define DW_OP_plus_uconst             0x23  /* ULEB128 addend */
-#define DW_OP_shl                     0x24
-#define DW_OP_shr                     0x25
-#define DW_OP_shra                    0x26
-#define DW_OP_xor                     0x27
-#define DW_OP_bra                     0x28  /* signed 2-byte constant */
-#define DW_OP_eq                      0x29
-#define DW_OP_ge                      0x2a
-#define DW_OP_gt                      0x2b
-#define DW_OP_le                      0x2c
-#define DW_OP_lt                      0x2d
-#define DW_OP_ne                      0x2e
-#define DW_OP_skip                    0x2f  /* signed 2-byte constant */
-#define DW_OP_lit0                    0x30  /* literals 0..31 = DW_OP_lit0 + literal */
-#define DW_OP_reg0                    0x50  /* registers 0..31 = DW_OP_reg0 + regnum */
-#define DW_OP_breg0                   0x70  /* SLEB128 offset, base registers 0..31 = DW_OP_breg0 + regnum */
-#define DW_OP_regx                    0x90  /* ULEB128 register */
-#define DW_OP_fbreg                   0x91  /* SLEB128 offset */
-#define DW_OP_bregx                   0x92  /* ULEB128 register, SLEB128 offset */
-#define DW_OP_piece                   0x93  /* ULEB128 size of piece */
-#define DW_OP_deref_size              0x94  /* 1-byte size of data retrieved */
-#define DW_OP_xderef_size             0x95  /* 1-byte size of data retrieved */
-#define DW_OP_nop                     0x96
-#define DW_OP_push_object_address     0x97
-#define DW_OP_call2                   0x98  /* 2-byte offset of DIE */
-#define DW_OP_call4                   0x99  /* 4-byte offset of DIE */
-#define DW_OP_call_ref                0x9a  /* 4- or 8-byte offset of DIE */
-#define DW_OP_form_tls_address        0x9b
-#define DW_OP_call_frame_cfa          0x9c
-#define DW_OP_bit_piece               0x9d  /* ULEB128 size, ULEB128 offset */
-#define DW_OP_implicit_value          0x9e  /* ULEB128 size, block of that size */
-#define DW_OP_stack_value             0x9f
-    /* DWARF 5+ */
-#define DW_OP_implicit_pointer        0xa0  /* 4- or 8-byte offset of DIE, SLEB128 constant offset */
-#define DW_OP_addrx                   0xa1  /* ULEB128 indirect address */
-#define DW_OP_constx                  0xa2  /* ULEB128 indirect constant */
-#define DW_OP_entry_value             0xa3  /* ULEB128 size, block of that size */
-#define DW_OP_const_type              0xa4  /* ULEB128 type entry offset, 1-byte size, constant value */
-#define DW_OP_regval_type             0xa5  /* ULEB128 register number, ULEB128 constant offset */
-#define DW_OP_deref_type              0xa6  /* 1-byte size, ULEB128 type entry offset */
-#define DW_OP_xderef_type             0xa7  /* 1-byte size, ULEB128 type entry offset */
-#define DW_OP_convert                 0xa8  /* ULEB128 type entry offset */
-#define DW_OP_reinterpret             0xa9  /* ULEB128 type entry offset */
-#define DW_OP_lo_user                 0xe0
-#define DW_OP_hi_user                 0xff
-
-#if defined __LINUX__ || defined __FreeBSD__ || defined __APPLE__
-# pragma pack()      /* reset default packing */
-#elif defined MACOS && defined __MWERKS__
-# pragma options align=reset
-#else
-# pragma pack(pop)   /* reset previous packing */
-#endif
-
-
-#define SWAP16(v)     ((((v) >> 8) & 0xff) | (((v) & 0xff) << 8))
-#define SWAP32(v)     ((((v) >> 24) & 0xff) | (((v) & 0xff0000) >> 8) | (((v) & 0xff00) << 8)  | (((v) & 0xff) << 24))
-
-
-typedef struct tagATTRIBUTE {
-  int tag;
-  int format;
-  long value;   /* value for implicit constant */
-} ATTRIBUTE;
-
-typedef struct tagABBREVLIST {
-  struct tagABBREVLIST *next;
-  int unit;     /* the compilation unit */
-  int id;
-  int tag;
-  int has_children;
-  int count;    /* number of attributes */
-  ATTRIBUTE *attributes;
-} ABBREVLIST;
-
-typedef struct tagPATHXREF {
-  struct tagPATHXREF *next;
-  int unit, file; /* input pair */
-  int index;      /* index in DWARF_PATHLIST */
-} PATHXREF;
-
-static ABBREVLIST *abbrev_insert(ABBREVLIST *root,int unit,int id,int tag,int has_children,
-                                 int num_attributes,const ATTRIBUTE attributes[])
-{
-  ABBREVLIST *cur;
-
-  assert(root!=NULL);
-  assert(attributes!=NULL || num_attributes==0);
-  if ((cur=(ABBREVLIST*)malloc(sizeof(ABBREVLIST)))==NULL)
-    return NULL;      /* insufficient memory */
-  cur->unit=unit;
-  cur->id=id;
-  cur->tag=tag;
-  cur->has_children=has_children;
-  cur->count=num_attributes;
-  if (num_attributes>0) {
-    int idx;
-    if ((cur->attributes=malloc(num_attributes*sizeof(ATTRIBUTE)))==NULL) {
-      free(cur);
-      return NULL;      /* insufficient memory */
-    }
-    for (idx=0; idx<num_attributes; idx++) {
-      cur->attributes[idx].tag=attributes[idx].tag;
-      cur->attributes[idx].format=attributes[idx].format;
-      cur->attributes[idx].value=attributes[idx].value;
-    }
-  } else {
-    cur->attributes=NULL;
-  }
-  /* insert as "last" (append mode) */
-  assert(root!=NULL);
-  while (root->next!=NULL)
-    root=root->next;
-  cur->next=root->next;
-  root->next=cur;
-  return cur;
-}
-
-static void abbrev_deletetable(ABBREVLIST *root)
-{
-  ABBREVLIST *cur,*next;
-
-  assert(root!=NULL);
-  cur=root->next;
-  while (cur!=NULL) {
-    next=cur->next;
-    assert(cur->attributes!=NULL || cur->count==0);
-    if (cur->attributes!=NULL)
-      free(cur->attributes);
-    free(cur);
-    cur=next;
-  } /* while */
-  memset(root,0,sizeof(ABBREVLIST));
-}
-
-static ABBREVLIST *abbrev_find(const ABBREVLIST *root,int unit,int id)
-{
-  ABBREVLIST *cur;
-  int index;
-
-  assert(root!=NULL);
-  index=0;
-  for (cur=root->next; cur!=NULL && (cur->unit!=unit || cur->id!=id); cur=cur->next)
-    index++;
-  return cur;
-}
-
-
-static PATHXREF *pathxref_insert(PATHXREF *root,int unit,int file,int index)
-{
-  PATHXREF *cur;
-
-  if ((cur=(PATHXREF*)malloc(sizeof(PATHXREF)))==NULL)
-    return NULL;      /* insufficient memory */
-  cur->unit=unit;
-  cur->file=file;
-  cur->index=index;
-  /* insert as "last" (append mode) */
-  assert(root!=NULL);
-  while (root->next!=NULL)
-    root=root->next;
-  cur->next=root->next;
-  root->next=cur;
-  return cur;
-}
-
-static void pathxref_deletetable(PATHXREF *root)
-{
-  PATHXREF *cur,*next;
-
-  assert(root!=NULL);
-  cur=root->next;
-  while (cur!=NULL) {
-    next=cur->next;
-    free(cur);
-    cur=next;
-  } /* while */
-  memset(root,0,sizeof(PATHXREF));
-}
-
-static int pathxref_find(const PATHXREF *root,int unit,int file)
-{
-  PATHXREF *cur;
-
-  assert(root!=NULL);
-  for (cur=root->next; cur!=NULL && (cur->unit!=unit || cur->file!=file); cur=cur->next)
-    {}
-  return (cur!=NULL) ? cur->index : -1;
-}
-
-
-static DWARF_PATHLIST *path_insert(DWARF_PATHLIST *root,const char *string)
-{
-  DWARF_PATHLIST *cur;
-
-  assert(string!=NULL);
-  if ((cur=(DWARF_PATHLIST*)malloc(sizeof(DWARF_PATHLIST)))==NULL)
-    return NULL;      /* insufficient memory */
-  if ((cur->name=strdup(string))==NULL) {
-    free(cur);
-    return NULL;      /* insufficient memory */
-  }
-  /* insert as "last" (append mode) */
-  assert(root!=NULL);
-  while (root->next!=NULL)
-    root=root->next;
-  cur->next=root->next;
-  root->next=cur;
-  return cur;
-}
-
-static void path_deletetable(DWARF_PATHLIST *root)
-{
-  DWARF_PATHLIST *cur,*next;
-
-  assert(root!=NULL);
-  cur=root->next;
-  while (cur!=NULL) {
-    next=cur->next;
-    assert(cur->name!=NULL);
-    free(cur->name);
-    free(cur);
-    cur=next;
-  }
-  memset(root,0,sizeof(DWARF_PATHLIST));
-}
-
-static char *path_get(const DWARF_PATHLIST *root,int index)
-{
-  DWARF_PATHLIST *cur;
-
-  assert(root!=NULL);
-  for (cur=root->next; cur!=NULL && index-->0; cur=cur->next)
-    {}
-  if (cur!=NULL) {
-    assert(cur->name!=NULL);
-    return cur->name;
-  }
-  return NULL;
-}
-
-static int path_find(const DWARF_PATHLIST *root,const char *name)
-{
-  DWARF_PATHLIST *cur;
-  int index;
-
-  assert(root!=NULL);
-  assert(name!=NULL);
-  index=0;
-  for (cur=root->next; cur!=NULL && strcmp(name,cur->name)!=0; cur=cur->next)
-    index++;
-  return (cur!=NULL) ? index : -1;
-}
-
-
-static DWARF_LINELOOKUP *line_findline(const DWARF_LINELOOKUP *root,int line,int fileindex)
-{
-  DWARF_LINELOOKUP *cur;
-
-  assert(root!=NULL);
-  for (cur=root->next; cur!=NULL && (cur->line!=line || cur->fileindex!=fileindex); cur=cur->next)
-    {}
-  return cur;
-}
-
-static DWARF_LINELOOKUP *line_findaddress(const DWARF_LINELOOKUP *root,unsigned address,int fileindex)
-{
-  DWARF_LINELOOKUP *cur;
-
-  assert(root!=NULL);
-  for (cur=root->next; cur!=NULL && (cur->address!=address || cur->fileindex!=fileindex); cur=cur->next)
-    {}
-  return cur;
-}
-
-static DWARF_LINELOOKUP *line_insert(DWARF_LINELOOKUP *root,int line,unsigned address,int fileindex)
-{
-  DWARF_LINELOOKUP *cur;
-
-  assert(root!=NULL);
-  /* first try to find an item with that line number, if it exists, keep the
-     lowest address in the item;
-     then try to find an item with the same address, if it exists, keep the
-     highest line number */
-  if ((cur=line_findline(root,line,fileindex))!=NULL) {
-    if (address<cur->address)
-      cur->address=address;
-  } else if ((cur=line_findaddress(root,address,fileindex))!=NULL) {
-    if (line>cur->line)
-      cur->line=line;
-    assert(fileindex==cur->fileindex);
-  } else {
-    DWARF_LINELOOKUP *pred;
-    if ((cur=(DWARF_LINELOOKUP*)malloc(sizeof(DWARF_LINELOOKUP)))==NULL)
-      return NULL;      /* insufficient memory */
-    cur->line=line;
-    cur->address=address;
-    cur->fileindex=fileindex;
-    /* find insertion position (keep the list sorted on address) */
-    for (pred=root; pred->next!=NULL && pred->next->address<address; pred=pred->next)
-      {}
-    /* insert */
-    assert(pred!=NULL);
-    cur->next=pred->next;
-    pred->next=cur;
-  }
-  return cur;
-}
-
-static void line_deletetable(DWARF_LINELOOKUP *root)
-{
-  DWARF_LINELOOKUP *cur,*next;
-
-  assert(root!=NULL);
-  cur=root->next;
-  while (cur!=NULL) {
-    next=cur->next;
-    free(cur);
-    cur=next;
-  } /* while */
-  memset(root,0,sizeof(DWARF_LINELOOKUP));
-}
-
-static DWARF_SYMBOLLIST *symname_insert(DWARF_SYMBOLLIST *root,const char *name,
-                                        unsigned code_addr,unsigned code_range,
-                                        unsigned data_addr,int fileindex,int line,
-                                        int external)
-{
-  DWARF_SYMBOLLIST *cur,*pred;
-  char demangled[256];
-
-  assert(root!=NULL);
-  assert(name!=NULL);
-
-  if ((cur=(DWARF_SYMBOLLIST*)malloc(sizeof(DWARF_SYMBOLLIST)))==NULL)
-    return NULL;      /* insufficient memory */
-
-  if (demangle(demangled, sizeof(demangled), name))
-    cur->name=strdup(demangled);
-  else
-    cur->name=strdup(name);
-  if (cur->name==NULL) {
-    free(cur);
-    return NULL;      /* insufficient memory */
-  }
-
-  cur->code_addr=code_addr;
-  cur->code_range=code_range;
-  cur->data_addr=data_addr;
-  cur->fileindex=fileindex;
-  cur->line=line;
-  cur->line_limit=0;  /* updated later */
-  if (external)
-    cur->scope=SCOPE_EXTERNAL;
-  else if (code_range>0)
-    cur->scope=SCOPE_UNIT;
-  else
-    cur->scope=SCOPE_UNKNOWN;
-  /* insert sorted on name */
-  for (pred=root; pred->next!=NULL && strcmp(name,pred->next->name)>0; pred=pred->next)
-    {}
-  /* insert */
-  assert(pred!=NULL);
-  cur->next=pred->next;
-  pred->next=cur;
-  return cur;
-}
-
-static void symname_deletetable(DWARF_SYMBOLLIST *root)
-{
-  DWARF_SYMBOLLIST *cur,*next;
-
-  assert(root!=NULL);
-  cur=root->next;
-  while (cur!=NULL) {
-    next=cur->next;
-    assert(cur->name!=NULL);
-    free(cur->name);
-    free(cur);
-    cur=next;
-  } /* while */
-  memset(root,0,sizeof(DWARF_SYMBOLLIST));
-}
-
-
-static char *strins(char *string,const char *sub)
-{
-  int offs=strlen(sub);
-  int len=strlen(string);
-  memmove(string+offs,string,len+1);
-  memmove(string,sub,offs);
-  return string;
-}
-
-static long read_leb128(FILE *fp,int sign,int *size)
-{
-  long value=0;
-  int shift=0;
-  int byte;
-
-  if (size!=NULL)
-    *size=0;
-  while ((byte=fgetc(fp))!=EOF) {
-    if (size!=NULL)
-      *size+=1;
-    value |= (long)(byte & 0x7f) << shift;
-    shift+=7;
-    if ((byte & 0x80)==0)
-      break;  /* no continuation, so done */
-  }
-  /* sign-extend; since bit 7 in the last byte read is the continuation bit,
-     bit 6 is the sign bit */
-  if (sign && (byte & 0x40)!=0 && shift < (sizeof(long)*8))
-    value |= ~0u << shift;
-
-  return value;
-}
-
-/* read_value() reads numeric data in various formats. It does not read address
-   data or other fields where the data size depends on the bit size of the ELF
-   file rather than on the format of the field. */
-static int64_t read_value(FILE *fp,int format,int *size)
-{
-  int64_t value=0;
-  int sz=0;
-
-  switch (format) {
-  case DW_FORM_flag_present:      /* implicit "present" flag (no data) */
-    value=1;
-    sz=0;
-    break;
-  case DW_FORM_data1:             /* constant, 1 byte */
-  case DW_FORM_ref1:              /* reference, 1 bytes */
-  case DW_FORM_flag:              /* flag, 1 byte (0=false, any non-zero=true) */
-    fread(&value,1,1,fp);
-    sz=1;
-    break;
-  case DW_FORM_data2:             /* constant, 2 bytes */
-  case DW_FORM_ref2:              /* reference, 2 bytes */
-    fread(&value,2,1,fp);
-    sz=2;
-    break;
-  case DW_FORM_data4:             /* constant, 4 bytes */
-  case DW_FORM_ref4:              /* reference, 4 bytes */
-    fread(&value,4,1,fp);
-    sz=4;
-    break;
-  case DW_FORM_data8:             /* constant, 8 bytes */
-  case DW_FORM_ref8:              /* reference, 8 bytes */
-  case DW_FORM_ref_sig8:          /* type signature, 8 bytes */
-    fread(&value,8,1,fp);
-    sz=8;
-    break;
-  case DW_FORM_data16:            /* constant, 16 bytes */
-    fread(&value,8,1,fp);
-    fread(&value,8,1,fp);
-    sz=16;
-    break;
-  case DW_FORM_ref_sup4:          /* reference relative to .debug_info of a supplementaty object file, 4 bytes */
-    fread(&value,4,1,fp);
-    sz=4;
-    break;
-  case DW_FORM_ref_sup8:          /* reference relative to .debug_info of a supplementaty object file, 8 bytes */
-    fread(&value,8,1,fp);
-    sz=8;
-    break;
-  case DW_FORM_sdata:             /* constant, signed LEB128 */
-    value=read_leb128(fp,1,&sz);
-    break;
-  case DW_FORM_udata:             /* constant, unsigned LEB128 */
-  case DW_FORM_ref_udata:         /* reference, unsigned LEB128 */
-    value=read_leb128(fp,0,&sz);
-    break;
-  case DW_FORM_exprloc: {         /* block, unsigned LEB128-encoded length + data bytes */
-    int datasz=(int)read_leb128(fp,0,&sz);
-    int opc=0;
-    sz+=datasz;
-    if (datasz>=1) {
-      fread(&opc,1,1,fp);
-      datasz-=1;
-    }
-    if (opc==DW_OP_addr && datasz>0 && datasz<=sizeof value) {
-      fread(&value,datasz,1,fp);
-    } else {
-      /* register/stack-relative location expressions are currently not supported */
-      while (datasz-->0)
-        fgetc(fp);
-    }
-    break;
-  } /* DW_FORM_exprloc */
-  default:
-    assert(0);
-  }
-  if (size!=NULL)
-    *size=sz;
-  return value;
-}
-
-static void read_string(FILE *fp,int format,int stringtable,char *string,int max,int *size)
-{
-  int sz=0;
-  int idx,count,byte;
-  int32_t offs;
-  long pos;
-
-  assert(fp!=NULL);
-  assert(string!=NULL);
-  assert(max>0);
-
-  idx=0;
-  switch (format) {
-  case DW_FORM_string:            /* string, zero-terminated */
-    while ((byte=fgetc(fp))!=EOF) {
-      if (idx<max)
-        string[idx]=(char)byte;
-      idx++;
-      if (byte==0)
-        break;
-    }
-    sz=idx;
-    break;
-  case DW_FORM_strp:              /* string, 4-byte offset into the .debug_str section */
-  case DW_FORM_strp_sup:          /* string, 4-byte offset into the .debug_str section of a supplementary object file */
-  case DW_FORM_line_strp:         /* string, 4-byte offset into the .debug_line_str section */
-    fread(&offs,4,1,fp);
-    sz=4;
-    /* look up the string */
-    assert(stringtable!=0);
-    pos=ftell(fp);
-    fseek(fp,stringtable+offs,SEEK_SET);
-    while ((byte=fgetc(fp))!=EOF) {
-      if (idx<max)
-        string[idx]=(char)byte;
-      idx++;
-      if (byte==0)
-        break;
-    }
-    fseek(fp,pos,SEEK_SET);
-    break;
-  case DW_FORM_block:             /* block, unsigned LEB128-encoded length + data bytes */
-  case DW_FORM_block1:            /* block, 1-byte length + up to 255 data bytes */
-  case DW_FORM_block2:            /* block, 2-byte length + up to 64K data bytes */
-  case DW_FORM_block4:            /* block, 4-byte length + up to 4G data bytes */
-    count=0;
-    switch (format) {
-    case DW_FORM_block:
-      count=read_leb128(fp,0,&sz);
-      break;
-    case DW_FORM_block1:
-      fread(&count,1,1,fp);
-      sz=1;
-      break;
-    case DW_FORM_block2:
-      fread(&count,2,1,fp);
-      sz=2;
-      break;
-    case DW_FORM_block4:
-      fread(&count,4,1,fp);
-      sz=4;
-      break;
-    }
-    sz+=count;
-    while (idx<count && (byte=fgetc(fp))!=EOF) {
-      if (idx<max)
-        string[idx]=(char)byte;
-      idx++;
-    }
-    break;
-  default:
-    assert(0);
-  }
-  string[max-1]='\0'; /* force the string to be zero-terminated */
-  if (size!=NULL)
-    *size=sz;
-}
-
-static void dwarf_abbrev(FILE *fp,const DWARFTABLE tables[],ABBREVLIST *abbrevlist)
-{
-# define MAX_ATTRIBUTES  50  /* max. number of attributes for a single tag */
-  int unit,tag,attrib,format;
-  int size,count;
-  unsigned char flag;
-  unsigned long tablesize;
-  ATTRIBUTE attributes[MAX_ATTRIBUTES];
-
-  assert(fp!=NULL);
-  assert(tables!=NULL);
-  assert(abbrevlist!=NULL);
-  assert(abbrevlist->next==NULL); /* abbrevlist should be empty */
-
-  fseek(fp,tables[TABLE_ABBREV].offset,SEEK_SET);
-  tablesize=tables[TABLE_ABBREV].size;
-  assert(tablesize>0); /* debug information should have been found */
-
-  unit=0;
-  while (tablesize > 0) {
-    /* get and check the abbreviation id (a sequence number relative to its unit) */
-    int idx=(int)read_leb128(fp,0,&size);
-    tablesize-=size;
-    if (idx==0) {
-      unit+=1;  /* an id that is zero, indicates the end of a unit */
-      continue;
-    }
-    /* get the tag and the "has-children" flag */
-    tag=(int)read_leb128(fp,0,&size);
-    tablesize-=size;
-    fread(&flag,1,1,fp);
-    tablesize-=1;
-    /* get the list of attributes */
-    count=0;
-    for ( ;; ) {
-      long value=0;
-      attrib=(int)read_leb128(fp,0,&size);
-      tablesize-=size;
-      format=(int)read_leb128(fp,0,&size);
-      tablesize-=size;
-      if (attrib==0 && format==0)
-        break;
-      if (format==DW_FORM_implicit_const) {
-        value=read_leb128(fp,0,&size);
-        tablesize-=size;
-      }
-      assert(count<MAX_ATTRIBUTES);
-      attributes[count].tag=attrib;
-      attributes[count].format=format;
-      attributes[count].value=value;
-      count++;
-    }
-    /* store the abbreviation */
-    abbrev_insert(abbrevlist,unit,idx,tag,flag,count,attributes);
-  }
-}
-
-static int read_unitheader(FILE *fp,UNIT_HDR32 *header,int *size)
-{
-  long mark;
-
-  assert(fp!=NULL);
-  assert(header!=NULL);
-  assert(size!=NULL);
-  mark=ftell(fp); /* may need to "un-read" */
-  if (fread(header,sizeof(UNIT_HDR32),1,fp)==0)
-    return 0;     /* read failed */
-  assert(header->unit_length!=0xffffffff);  /* otherwise, should read 64-bit header */
-  //??? on big_endian, swap version field before testing it
-  if (header->version>=5) {
-    *size=sizeof(UNIT_HDR32);
-  } else {
-    /* un-read v5 structure, then read & copy the v2..v4 structure
-        uint32_t unit_length;    total length of this block, excluding this field
-        uint16_t version;        DWARF version, up to version 4
-        uint32_t abbrev_offs;    offset into the .debug_abbrev table
-        uint8_t  address_size;   size in bytes of an address
-     */
-#   define HDRSIZE 11
-    unsigned char hdr[HDRSIZE];
-    fseek(fp,mark,SEEK_SET);
-    fread(&hdr,1,HDRSIZE,fp);
-    memcpy(&header->unit_length,hdr+0,4); /* redundant, identical to v5 */
-    memcpy(&header->version,hdr+4,2);     /* redundant, identical to v5 */
-    memcpy(&header->abbrev_offs,hdr+6,4);
-    memcpy(&header->address_size,hdr+10,1);
-    header->unit_type=DW_UT_compile;
-    *size=HDRSIZE;
-#   undef HDRSIZE
-  }
-  //??? on big_endian, swap fields
-  return 1;
-}
-
-static int read_prologue(FILE *fp,DWARF_PROLOGUE32 *prologue,int *size)
-{
-  long mark;
-
-  assert(fp!=NULL);
-  assert(prologue!=NULL);
-  assert(size!=NULL);
-  mark=ftell(fp); /* may need to "un-read" */
-  if (fread(prologue,sizeof(DWARF_PROLOGUE32),1,fp)==0)
-    return 0;     /* read failed */
-  assert(prologue->total_length!=0xffffffff);  /* otherwise, should read 64-bit prologue */
-  //??? on big_endian, swap version field before testing it
-  if (prologue->version>=5) {
-    *size=sizeof(DWARF_PROLOGUE32);
-  } else if (prologue->version==2 || prologue->version==3) {
-    /* un-read v5 structure, then read & copy the v2/3 structure
-        uint32_t total_length;     length of the line number table, minus the 4 bytes for this total_length field
-        uint16_t version;          this prologue is for versions 2 & 3
-        uint32_t prologue_length;  offset to the first opcode of the line number program (relative to this prologue_length field)
-        uint8_t  min_instruction_size;
-        uint8_t  default_is_stmt;  default value to initialize the state machine with
-        int8_t   line_base;
-        uint8_t  line_range;
-        uint8_t  opcode_base;      number of the first special opcode
-        standard opcode lengths (array of length "opcode_base" - 1)
-        include directories, a sequence of zero-terminated strings (and the
-           sequence itself ends with a zero-byte)
-        file names: base name, location, modification date, size
-     */
-#   define HDRSIZE 15
-    unsigned char hdr[HDRSIZE];
-    fseek(fp,mark,SEEK_SET);
-    fread(&hdr,1,HDRSIZE,fp);
-    memcpy(&prologue->total_length,hdr+0,4);  /* redundant, identical to v5 */
-    memcpy(&prologue->version,hdr+4,2);       /* redundant, identical to v5 */
-    memcpy(&prologue->prologue_length,hdr+6,4);
-    memcpy(&prologue->min_instruction_size,hdr+10,1);
-    memcpy(&prologue->default_is_stmt,hdr+11,1);
-    memcpy(&prologue->line_base,hdr+12,1);
-    memcpy(&prologue->line_range,hdr+13,1);
-    memcpy(&prologue->opcode_base,hdr+14,1);
-    prologue->address_size=4; /* assume 32-bit, 64-bit not yet supported */
-    prologue->segment_sel_size=0;
-    prologue->max_oper_per_instruction=1;
-    *size=HDRSIZE;
-#   undef HDRSIZE
-  } else if (prologue->version==4) {
-    /* un-read v5 structure, then read & copy the v4 structure
-        uint32_t total_length;     length of the line number table, minus the 4 bytes for this total_length field
-        uint16_t version;          this prologue is for versions 2 & 3
-        uint32_t prologue_length;  offset to the first opcode of the line number program (relative to this prologue_length field)
-        uint8_t  min_instruction_size;
-        uint8_t  max_oper_per_instruction;
-        uint8_t  default_is_stmt;  default value to initialize the state machine with
-        int8_t   line_base;
-        uint8_t  line_range;
-        uint8_t  opcode_base;      number of the first special opcode
-        standard opcode lengths (array of length "opcode_base" - 1)
-        include directories, a sequence of zero-terminated strings (and the
-           sequence itself ends with a zero-byte)
-        file names: base name, location, modification date, size
-     */
-#   define HDRSIZE 16
-    unsigned char hdr[HDRSIZE];
-    fseek(fp,mark,SEEK_SET);
-    fread(&hdr,sizeof(hdr),1,fp);
-    memcpy(&prologue->total_length,hdr+0,4);  /* redundant, identical to v5 */
-    memcpy(&prologue->version,hdr+4,2);       /* redundant, identical to v5 */
-    memcpy(&prologue->prologue_length,hdr+6,4);
-    memcpy(&prologue->min_instruction_size,hdr+10,1);
-    memcpy(&prologue->max_oper_per_instruction,hdr+11,1);
-    memcpy(&prologue->default_is_stmt,hdr+12,1);
-    memcpy(&prologue->line_base,hdr+13,1);
-    memcpy(&prologue->line_range,hdr+14,1);
-    memcpy(&prologue->opcode_base,hdr+15,1);
-    prologue->address_size=4; /* assume 32-bit, 64-bit not yet supported */
-    prologue->segment_sel_size=0;
-    *size=HDRSIZE;
-#   undef HDRSIZE
-  } else {
-    assert(0);  /* DWARF 1 is not supported */
-    return 0;
-  }
-  //??? on big_endian, swap fields
-  return 1;
-}
-
-static void clear_state(STATE *state,int default_is_stmt)
-{
-  /* set default state (see DWARF documentation, DWARF 2.0 pp. 52 / DWARF 3.0 pp. 94) */
-  state->address=0;
-  state->op_index=0;
-  state->file=1;
-  state->line=1;
-  state->column=0;
-  state->is_stmt=default_is_stmt;
-  state->basic_block=0;
-  state->end_seq=0;
-  state->prologue_end=0;
-  state->epiloge_begin=0;
-  state->isa=0;
-  state->discriminator=0;
-}
-
-/* dwarf_linetable() parses the .debug_line table and retrieves the
-   line-number/code-address tupples. DWARF implements the table as a state
-   machine with pseudo-instructions to set/clear state fields. There may be
-   several of such state programs in the section.
-   The output of this function is a list with line information structures and
-   a list of filenames. The each element of the line number structure includes
-   an index into the file list. The line number list is sorted on the code
-   address */
-static bool dwarf_linetable(FILE *fp,const DWARFTABLE tables[],
-                            DWARF_LINELOOKUP *linetable,DWARF_PATHLIST *filetable,
-                            PATHXREF *xreftable)
-{
-  DWARF_PROLOGUE32 prologue;
-  STATE state;
-  int dirpos,opcode,lebsize,prologue_size;
-  int unit,idx;
-  long value;
-  unsigned tableoffset,tablesize;
-  char path[_MAX_PATH];
-  DWARF_PATHLIST include_list = { NULL };
-  DWARF_PATHLIST file_list = { NULL };
-  DWARF_LINELOOKUP line_list = { NULL };
-  DWARF_PATHLIST *fileitem;
-  DWARF_LINELOOKUP *lineitem;
-
-  assert(fp!=NULL);
-  assert(tables!=NULL);
-  assert(linetable!=NULL);
-  assert(linetable->next==NULL);  /* linetable should be empty */
-  assert(filetable!=NULL);
-  assert(filetable->next==NULL);  /* filetable should be empty */
-  assert(xreftable!=NULL);
-  assert(xreftable->next==NULL);  /* path cross-reference should be empty */
-
-  tableoffset=tables[TABLE_LINE].offset;
-  tablesize=tables[TABLE_LINE].size;
-  assert(tableoffset>0 && tablesize>0); /* debug information should have been found */
-  fseek(fp,tableoffset,SEEK_SET);
-
-  unit=0;
-  prologue_size=sizeof(prologue); /* initial assumption */
-  while (tablesize>prologue_size) {
-    uint8_t *std_argcnt;  /* array with argument counts for standard opcodes */
-    long count;
-    int byte;
-    /* check the prologue */
-    read_prologue(fp,&prologue,&prologue_size);
-    /* read the argument counts for the standard opcodes */
-    std_argcnt=(uint8_t*)malloc(prologue.opcode_base-1*sizeof(uint8_t));
-    if (std_argcnt==NULL)
-      return false;
-    fread(std_argcnt,1,prologue.opcode_base-1,fp);
-    assert(prologue.version<5); //??? for DWARF 5+, the format for the include-paths and filenames tables is different
-    /* read the include-paths table */
-    while ((byte=fgetc(fp))!=EOF && byte!='\0') {
-      for (idx=0; byte!=EOF && byte!='\0'; idx++) {
-        path[idx]=(char)byte;
-        byte=fgetc(fp);
-      }
-      path[idx]='\0';
-      path_insert(&include_list,path);
-    }
-    /* read the filenames table */
-    while ((byte=fgetc(fp))!=EOF && byte!='\0') {
-      for (idx=0; byte!=EOF && byte!='\0'; idx++) {
-        path[idx]=(char)byte;
-        byte=fgetc(fp);
-      }
-      path[idx]='\0';
-      dirpos=read_leb128(fp,0,NULL);  /* read directory index */
-      read_leb128(fp,0,NULL);         /* skip modification time (GCC sets this to 0) */
-      read_leb128(fp,0,NULL);         /* skip source file size (GCC sets this to 0) */
-      if (dirpos>0 && strpbrk(path,"\\/")==NULL) {
-        char *dir=path_get(&include_list,dirpos-1);
-        strins(path,"/");
-        strins(path,dir);
-      }
-      path_insert(&file_list,path);
-    }
-    path_deletetable(&include_list);
-
-    /* jump to the start of the program, then start running */
-    clear_state(&state,prologue.default_is_stmt);
-    fseek(fp,tableoffset+prologue.prologue_length+10,SEEK_SET);  /* +10 because the offset is relative to the field position */
-    count=prologue.total_length-prologue.prologue_length-6;
-    while (count>0) {
-      opcode=fgetc(fp);
-      count--;
-      if (opcode==EOF)
-        break;
-      if (opcode<prologue.opcode_base) {
-        /* standard (or extended) opcode */
-        switch (opcode) {
-        case DW_LNS_extended_op:
-          value=read_leb128(fp,0,&lebsize);
-          count-=lebsize+value;
-          opcode=fgetc(fp);
-          switch (opcode) {
-          case DW_LNE_end_sequence:
-            state.end_seq=1;
-            line_insert(&line_list,state.line,state.address,state.file-1);
-            clear_state(&state,prologue.default_is_stmt);  /* reset to default values */
-            break;
-          case DW_LNE_set_address:
-            value=fgetc(fp);
-            value|=(long)fgetc(fp) << 8;
-            value|=(long)fgetc(fp) << 16;
-            value|=(long)fgetc(fp) << 24;
-            state.address=value;
-            break;
-          case DW_LNE_define_file:
-            for (idx=0; (byte=fgetc(fp))!=EOF && byte!='\0'; idx++) {
-              path[idx]=(char)byte;
-              byte=fgetc(fp);
-            }
-            path[idx]='\0';
-            dirpos=read_leb128(fp,0,NULL);  /* read directory index */
-            read_leb128(fp,0,NULL);         /* skip modification time (GCC sets this to 0) */
-            read_leb128(fp,0,NULL);         /* skip source file size (GCC sets this to 0) */
-            if (dirpos>0 && strpbrk(path,"\\/")==NULL) {
-              char *dir=path_get(&include_list,dirpos-1);
-              strins(path,"/");
-              strins(path,dir);
-            }
-            path_insert(&file_list,path);
-            break;
-          case DW_LNE_set_discriminator:
-            state.discriminator=read_leb128(fp,0,NULL);
-            break;
-          default:
-            while (value-->0) /* skip any unrecognized extended opcode */
-              fgetc(fp);
-          }
-          break;
-        case DW_LNS_copy:
-          line_insert(&line_list,state.line,state.address,state.file-1);
-          state.basic_block=0;
-          break;
-        case DW_LNS_advance_pc:
-          value=read_leb128(fp,0,&lebsize);
-          count-=lebsize;
-          state.address+=value*prologue.min_instruction_size;
-          break;
-        case DW_LNS_advance_line:
-          value=read_leb128(fp,1,&lebsize);
-          count-=lebsize;
-          state.line+=value;
-          break;
-        case DW_LNS_set_file:
-          value=read_leb128(fp,0,&lebsize);
-          count-=lebsize;
-          state.file=value;
-          break;
-        case DW_LNS_set_column:
-          value=read_leb128(fp,0,&lebsize);
-          count-=lebsize;
-          state.column=value;
-          break;
-        case DW_LNS_negate_stmt:
-          state.is_stmt=!state.is_stmt;
-          break;
-        case DW_LNS_set_basic_block:
-          state.basic_block=1;
-          break;
-        case DW_LNS_const_add_pc:
-          state.address+=((255-prologue.opcode_base)/prologue.line_range)*prologue.min_instruction_size;
-          break;
-        case DW_LNS_fixed_advance_pc:
-          value=fgetc(fp);
-          value|=fgetc(fp) << 8;
-          state.address+=value;
-          count-=2;
-          break;
-        case DW_LNS_set_prologue_end:
-          state.prologue_end=1;
-          break;
-        case DW_LNS_set_epilogue_begin:
-          state.epiloge_begin=1;
-          break;
-        case DW_LNS_set_isa:
-          value=read_leb128(fp,0,&lebsize);
-          count-=lebsize;
-          state.isa=value;
-          break;
-        default:
-          /* skip opcode and any parameters */
-          for (idx=0; idx<std_argcnt[opcode-1]; idx++) {
-            read_leb128(fp,0,&lebsize);
-            count-=lebsize;
-          }
-        }
-      } else {
-        /* special opcode */
-        opcode-=prologue.opcode_base;
-        assert(prologue.max_oper_per_instruction==1); /* for VLIW architecture, the calculation below must be adjusted */
-        state.address+=(opcode/prologue.line_range)*prologue.min_instruction_size;
-        state.line+=prologue.line_base+opcode%prologue.line_range;
-        line_insert(&line_list,state.line,state.address,state.file-1);
-        state.basic_block=0;
-        state.prologue_end=0;
-        state.epiloge_begin=0;
-        state.discriminator=0;
-      }
-    }
-
-    free(std_argcnt);
-
-    /* merge the local file table with the global one */
-    idx=0;
-    for (fileitem=file_list.next; fileitem!=NULL; fileitem=fileitem->next) {
-      /* check whether this file is referenced at all */
-      for (lineitem=line_list.next; lineitem!=NULL && lineitem->fileindex!=idx; lineitem=lineitem->next)
-        {}
-      if (lineitem!=NULL) {
-        /* so this file is referenced, now see whether it is already in the global
-           file table */
-        const char *name=path_get(&file_list,idx);
-        assert(name!=NULL);
-        if (path_find(filetable,name)<0) {
-          int tgt;
-          path_insert(filetable,name);
-          tgt=path_find(filetable,name);  /* find it back, to add a cross-reference */
-          assert(tgt>=0);
-          pathxref_insert(xreftable,unit,idx,tgt);
-        }
-      }
-      idx++;
-    }
-
-    /* append the local line table to the global table (and translate the index
-       in the local file table to the index in the global file table) */
-    for (lineitem=line_list.next; lineitem!=NULL; lineitem=lineitem->next) {
-      int fileidx=pathxref_find(xreftable,unit,lineitem->fileindex);
-      line_insert(linetable,lineitem->line,lineitem->address,fileidx);
-    }
-    path_deletetable(&file_list);
-    line_deletetable(&line_list);
-
-    /* prepare for a next "line program" (if any) */
-    value=ftell(fp);
-    tablesize-=value-tableoffset;
-    tableoffset=value;
-    unit+=1;
-  } /* while (tablesize) */
-
-  return true;
-}
-
-/* dwarf_infotable() parses the .debug_info table and collects the functions.
- */
-static bool dwarf_infotable(FILE *fp,const DWARFTABLE tables[],
-                            DWARF_SYMBOLLIST *symboltable,int *address_size,
-                            const PATHXREF *xreftable)
-{
-  UNIT_HDR32 header;
-  ABBREVLIST abbrev_root = { NULL };
-  const ABBREVLIST *abbrev;
-  int unit,idx,size;
-  unsigned long tablesize;
-  char name[256],str[256];
-  int64_t value;
-  int file,line;
-
-  assert(fp!=NULL);
-  assert(tables!=NULL);
-  assert(symboltable!=NULL);
-  assert(symboltable->next==NULL);/* symboltable should be empty */
-  assert(address_size!=NULL);
-  assert(xreftable!=NULL);
-
-  assert(tables[TABLE_ABBREV].offset>0);/* required table */
-  dwarf_abbrev(fp,tables,&abbrev_root);
-
-  assert(tables[TABLE_INFO].offset>0);  /* debug information should have been found */
-  fseek(fp,tables[TABLE_INFO].offset,SEEK_SET);
-
-  unit=0;
-  tablesize=tables[TABLE_INFO].size;
-  while (tablesize>sizeof(header)) {
-    unsigned long unitsize;
-    uint32_t code_addr=0, code_addr_end=0;
-    uint32_t data_addr=0;
-    int external=0;
-    int declaration=0;
-    int level=0;
-    int hdrsize;
-    read_unitheader(fp,&header,&hdrsize);
-    unitsize=header.unit_length-(hdrsize-4);
-    assert(unitsize<0xfffffff0);  /* if larger, should read the 64-bit version of the structure */
-    *address_size=header.address_size;
-    tablesize-=unitsize+hdrsize;
-    name[0]='\0';
-    level=0;
-    /* browse through the tags */
-    while (unitsize>0) {
-      /* read the abbreviation code */
-      idx=(int)read_leb128(fp,0,&size);
-      unitsize-=size;
-      if (idx==0) {
-        level-=1;
-        continue;
-      }
-      abbrev=abbrev_find(&abbrev_root,unit,idx);
-      assert(abbrev!=NULL);
-      /* run through the attributes */
-      for (idx=0; idx<abbrev->count; idx++) {
-        int format=abbrev->attributes[idx].format;
-        if (format==DW_FORM_indirect) {
-          /* format is specified in the .debug_info data (not in the abbreviation) */
-          format=read_leb128(fp,1,&size);
-          unitsize-=size;
-        }
-        switch (format) {
-        case DW_FORM_data1:             /* constant, 1 byte */
-        case DW_FORM_data2:             /* constant, 2 bytes */
-        case DW_FORM_data4:             /* constant, 4 bytes */
-        case DW_FORM_data8:             /* constant, 8 bytes */
-        case DW_FORM_sdata:             /* constant, signed LEB128 */
-        case DW_FORM_udata:             /* constant, unsigned LEB128 */
-        case DW_FORM_ref1:              /* reference, 1 bytes */
-        case DW_FORM_ref2:              /* reference, 2 bytes */
-        case DW_FORM_ref4:              /* reference, 4 bytes */
-        case DW_FORM_ref8:              /* reference, 8 bytes */
-        case DW_FORM_ref_udata:         /* reference, unsigned LEB128 */
-        case DW_FORM_flag:              /* flag, 1 byte (0=false, any non-zero=true) */
-        case DW_FORM_flag_present:      /* flag, no data */
-        case DW_FORM_ref_sig8:          /* type signature, 8 bytes */
-        case DW_FORM_exprloc:           /* block, unsigned LEB128-encoded length + data bytes */
-        case DW_FORM_ref_sup4:
-        case DW_FORM_ref_sup8:
-          value=read_value(fp,abbrev->attributes[idx].format,&size);
-          break;
-        case DW_FORM_addr:              /* address, 4 bytes for 32-bit, 8 bytes for 64-bit */
-        case DW_FORM_ref_addr:          /* reference, address size (4 bytes on 32-bit, 8 bytes on 64-bit) */
-        case DW_FORM_sec_offset:        /* offset to line number data (4 bytes on 32-bit, 8 bytes on 64-bit) */
-          value=0;
-          fread(&value,1,header.address_size,fp);
-          size=header.address_size;
-          break;
-        case DW_FORM_string:            /* string, zero-terminated */
-        case DW_FORM_strp:              /* string, 4-byte offset into the .debug_str section */
-        case DW_FORM_strp_sup:
-        case DW_FORM_block:             /* block, unsigned LEB128-encoded length + data bytes */
-        case DW_FORM_block1:            /* block, 1-byte length + up to 255 data bytes */
-        case DW_FORM_block2:            /* block, 2-byte length + up to 64K data bytes */
-        case DW_FORM_block4:            /* block, 4-byte length + up to 4G data bytes */
-          read_string(fp,abbrev->attributes[idx].format,tables[TABLE_STR].offset,str,sizeof(str),&size);
-          break;
-        case DW_FORM_line_strp:
-          read_string(fp,abbrev->attributes[idx].format,tables[TABLE_LINE_STR].offset,str,sizeof(str),&size);
-          break;
-        case DW_FORM_implicit_const:
-          value=abbrev->attributes[idx].value;
-          size=0;
-          break;
-        default:
-          assert(0);
-        }
-        unitsize-=size;
-        if (abbrev->tag==DW_TAG_subprogram || abbrev->tag==DW_TAG_variable || abbrev->tag==DW_TAG_formal_parameter) {
-          //??? also handle DW_TAG_lexical_block for the scope of local variables
-          /* store selected fields */
-          switch (abbrev->attributes[idx].tag) {
-          case DW_AT_name:
-            strcpy(name,str);
-            break;
-          case DW_AT_low_pc:
-            if (abbrev->tag==DW_TAG_subprogram)
-              code_addr=(uint32_t)value;
-            break;
-          case DW_AT_high_pc:
-            if (abbrev->tag==DW_TAG_subprogram) {
-              code_addr_end=(uint32_t)value;
-              /* depending on the format, the "high pc" value is an offset
-                 instead of an address */
-              if (abbrev->attributes[idx].format!=DW_FORM_addr)
-                code_addr_end+=code_addr;
-            }
-            break;
-          case DW_AT_decl_file:
-            file=pathxref_find(xreftable,unit,(int)value-1);
-            break;
-          case DW_AT_decl_line:
-            line=(int)value;
-            break;
-          case DW_AT_location:
-            if (abbrev->tag==DW_TAG_variable)
-              data_addr=(uint32_t)value;  /* global / static variable */
-            break;
-          case DW_AT_external:
-            if (abbrev->tag==DW_TAG_variable)
-              external=(int)value;
-            break;
-          case DW_AT_declaration:
-            declaration=(int)value;
-            break;
-          }
-        }
-      } /* for (idx<abbrev->count) */
-      if ((abbrev->tag==DW_TAG_subprogram && code_addr_end>code_addr)
-          || (abbrev->tag==DW_TAG_variable && data_addr!=0))
-        declaration=0;
-      if ((abbrev->tag==DW_TAG_subprogram || abbrev->tag==DW_TAG_variable || abbrev->tag==DW_TAG_formal_parameter)
-          && !declaration) {
-        /* inlined functions are added as if they have address 0; when inline
-           functions get instantiated, these are added as "references" to
-           functions; these are not handled */
-        assert(code_addr_end>=code_addr);
-        if (name[0]!='\0' && file>=0)
-          symname_insert(symboltable,name,code_addr,code_addr_end-code_addr,
-                         data_addr,file,line,external);
-        name[0]='\0';
-        code_addr=code_addr_end=0;
-        data_addr=0;
-        external=0;
-        declaration=0;
-        file=-1;
-      }
-      if (abbrev->has_children)
-        level+=1;
-    }
-    unit+=1;
-  }
-  abbrev_deletetable(&abbrev_root);
-  return true;
-}
-
-static void dwarf_postprocess(DWARF_SYMBOLLIST *symboltable,const DWARF_LINELOOKUP *linetable)
-{
-  DWARF_SYMBOLLIST *sym;
-
-  assert(symboltable!=NULL);
-  for (sym=symboltable->next; sym!=NULL; sym=sym->next) {
-    if (DWARF_IS_FUNCTION(sym)) {
-      /* go through the line table to find the line range for the function */
-      uint32_t addr=sym->code_addr+sym->code_range;
-      const DWARF_LINELOOKUP *line;
-      DWARF_SYMBOLLIST *lcl;
-      assert(linetable!=NULL);
-      for (line=linetable->next; line!=NULL && sym->line_limit==0; line=line->next) {
-        if (line->address<addr && (line->next==NULL || line->next->address>=addr)
-            && line->line>=sym->line_limit)
-          sym->line_limit=line->line+1; /* +1 for consistency with DWARF address range */
-      }
-      /* collect all local variables that are declared within this line range */
-      for (lcl=symboltable->next; lcl!=NULL; lcl=lcl->next) {
-        if (lcl->fileindex==sym->fileindex
-            && lcl->line>=sym->line && lcl->line<sym->line_limit
-            && lcl->scope==SCOPE_UNKNOWN)
-        {
-          assert(lcl->code_addr==0);  /* nested functions don't occur */
-          lcl->scope=SCOPE_FUNCTION;
-          lcl->line_limit=sym->line_limit;
-          assert(lcl->line_limit>lcl->line);
-        }
-      }
-    }
-  }
-}
-
-/** dwarf_read() returns three lists: a list with source code line numbers,
- *  a list with functions and a list with the file paths (referred to by the
- *  other two lists)
- */
-bool dwarf_read(FILE *fp,DWARF_LINELOOKUP *linetable,DWARF_SYMBOLLIST *symboltable,
-                DWARF_PATHLIST *filetable,int *address_size)
-{
-  assert(fp!=NULL);
-  assert(linetable!=NULL);        /* tables must be valid, but empty */
-  assert(linetable->next==NULL);
-  assert(symboltable!=NULL);
-  assert(symboltable->next==NULL);
-  assert(filetable!=NULL);
-  assert(filetable->next==NULL);
-  assert(address_size!=NULL);
-
-  int wordsize;
-  int err=elf_info(fp,&wordsize,NULL,NULL,NULL);
-  if (err!=ELFERR_NONE || wordsize!=32) {
-    /* only 32-bit architectures at this time */
-    fclose(fp);
-    return false;
-  }
-
-  /* get offsets to various debug tables */
-  DWARFTABLE tables[TABLE_COUNT];
-  elf_section_by_name(fp,".debug_info",&tables[TABLE_INFO].offset,NULL,&tables[TABLE_INFO].size);
-  elf_section_by_name(fp,".debug_abbrev",&tables[TABLE_ABBREV].offset,NULL,&tables[TABLE_ABBREV].size);
-  elf_section_by_name(fp,".debug_str",&tables[TABLE_STR].offset,NULL,&tables[TABLE_STR].size);
-  elf_section_by_name(fp,".debug_line",&tables[TABLE_LINE].offset,NULL,&tables[TABLE_LINE].size);
-  elf_section_by_name(fp,".debug_pubnames",&tables[TABLE_PUBNAME].offset,NULL,&tables[TABLE_PUBNAME].size);
-  elf_section_by_name(fp,".debug_line_str",&tables[TABLE_LINE_STR].offset,NULL,&tables[TABLE_LINE_STR].size);
-
-  PATHXREF xreftable = { NULL };
-  bool result=true;
-  /* the line table also holds information for the file path table and the path
-     cross-reference; the table is therefore mandatory in the DWARF format and
-     it is the first one to parse */
-  if (tables[TABLE_LINE].offset!=0)
-    result=dwarf_linetable(fp,tables,linetable,filetable,&xreftable);
-  /* the information table implicitly parses the abbreviations table, but it
-     discards that table before returning */
-  if (result && tables[TABLE_INFO].offset!=0)
-    result=dwarf_infotable(fp,tables,symboltable,address_size,&xreftable);
-
-  pathxref_deletetable(&xreftable);
-
-  /* now that we have seen all functions, we can update the scope of local
-     variables */
-  dwarf_postprocess(symboltable,linetable);
-
-  return result;
-}
-
-void dwarf_cleanup(DWARF_LINELOOKUP *linetable,DWARF_SYMBOLLIST *symboltable,DWARF_PATHLIST *filetable)
-{
-  line_deletetable(linetable);
-  symname_deletetable(symboltable);
-  path_deletetable(filetable);
-}
-
-/** dwarf_sym_from_name() returns a function or variable that matches the name,
- *  and that is in scope.
- *  - Functions and variables with function scope (locals & arguments) are
- *    matched if the fileindex matches and the lineindex is in range. This test
- *    is skipped in fileindex or lineindex is -1.
- *  - Functions and variables with unit scope are found if the fileindex
- *    matches. This test is skipped if fileindex is -1.
- *  - External functions and variables are always matched, but are matched last.
- */
-const DWARF_SYMBOLLIST *dwarf_sym_from_name(const DWARF_SYMBOLLIST *symboltable,
-                                            const char *name,int fileindex,int lineindex)
-{
-  const DWARF_SYMBOLLIST *sym;
-
-  assert(symboltable!=NULL);
-  assert(name!=NULL);
-  /* check local variables */
-  if (fileindex>=0 && lineindex>=0) {
-    for (sym=symboltable->next; sym!=NULL; sym=sym->next) {
-      assert(sym->name!=NULL);
-      if (sym->scope==SCOPE_FUNCTION
-          && sym->fileindex==fileindex
-          && sym->line<=lineindex && lineindex<sym->line_limit
-          && strcmp(sym->name,name)==0)
-        return sym;
-    }
-  }
-  /* check static globals */
-  if (fileindex>=0) {
-    for (sym=symboltable->next; sym!=NULL; sym=sym->next) {
-      assert(sym->name!=NULL);
-      if (sym->scope==SCOPE_UNIT
-          && sym->fileindex==fileindex
-          && strcmp(sym->name,name)==0)
-        return sym;
-    }
-  }
-  /* check external symbols */
-  for (sym=symboltable->next; sym!=NULL; sym=sym->next) {
-    assert(sym->name!=NULL);
-    if (sym->scope==SCOPE_EXTERNAL
-        && strcmp(sym->name,name)==0)
-      return sym;
-  }
-  return NULL;
-}
-
-const DWARF_SYMBOLLIST *dwarf_sym_from_address(const DWARF_SYMBOLLIST *symboltable,unsigned address,int exact)
-{
-  const DWARF_SYMBOLLIST *sym, *select = NULL;
-
-  assert(symboltable!=NULL);
-  for (sym=symboltable->next; sym!=NULL; sym=sym->next) {
-    if (sym->code_range==0) {
-      /* check variable */
-      if (sym->data_addr==address)
-        return sym;   /* always return the variable on an exact address match */
-    } else {
-      /* check function */
-      if (sym->code_addr==address)
-        return sym;   /* always return the function on an exact address match */
-      if (!exact && sym->code_addr<address)
-        select=sym;   /* optionally return the closest function at a lower address */
-    }
-  }
-  return select;
-}
-
-const DWARF_SYMBOLLIST *dwarf_sym_from_index(const DWARF_SYMBOLLIST *symboltable,unsigned index)
-{
-  const DWARF_SYMBOLLIST *sym;
-
-  assert(symboltable!=NULL);
-  for (sym=symboltable->next; sym!=NULL; sym=sym->next) {
-    if (index--==0)
-      return sym;
-  }
-  return NULL;
-}
-
-/** dwarf_collect_functions_in_file() stores the pointers to all "code" symbols
- *  that appear in a file into a list.
- *
- *  \param symboltable  [in] The table returned by dwarf_read().
- *  \param fileindex    The index of the source file to return the functions
- *                      for, or -1 to return all functions (in all source
- *                      files).
- *  \param sort         One of DWARF_SORT_NAME or DWARF_SORT_ADDRESS.
- *  \param list         [out] An array that will be filled with pointers to the
- *                      function information. This parameter may be NULL, in
- *                      order to query the number of functions in the file.
- *  \param numentries   The size of the "list" array.
- *
- *  \return The number of functions collected.
- *
- *  \note   To check the size of the list, call this function with parameter
- *          "list" set to NULL. The number of entries to allocate is returned.
- *          Then allocate a buffer of sufficient size, and call this function
- *          again with that buffer.
- *
- *  \note   Note that the returned list holds pointers to symbols, not the
- *          symbols themselves. The list can be sorted on function names or
- *          function addresses.
- */
-unsigned dwarf_collect_functions_in_file(const DWARF_SYMBOLLIST *symboltable,int fileindex,
-                                         int sort,const DWARF_SYMBOLLIST *list[],int numentries)
-{
-  assert(symboltable!=NULL);
-  assert(fileindex==-1 || fileindex>=0);
-  assert(sort==DWARF_SORT_NAME || sort==DWARF_SORT_ADDRESS);
-  if (list==NULL)
-    numentries=0;
-
-  unsigned count=0;
-  for (const DWARF_SYMBOLLIST *sym=symboltable->next; sym!=NULL; sym=sym->next) {
-    if (DWARF_IS_FUNCTION(sym) && (fileindex==-1 || sym->fileindex==fileindex)) {
-      if (count<numentries) {
-        int pos;
-        if (sort==DWARF_SORT_ADDRESS) {
-          for (pos=0; pos<count && list[pos]->code_addr<sym->code_addr; pos++)
-            {}
-        } else {
-          for (pos=0; pos<count && strcmp(list[pos]->name,sym->name)<0; pos++)
-            {}
-        }
-        assert(list!=NULL);
-        if (pos<count)
-          memmove(&list[pos+1],&list[pos],(count-pos)*sizeof(DWARF_SYMBOLLIST*));
-        list[pos]=sym;
-      }
-      count+=1;
-    }
-  }
-  return count;
-}
-
-/** dwarf_path_from_fileindex() returns the path of the source file (or NULL
- *  if parameter "fileindex" is invalid)
- */
-const char *dwarf_path_from_fileindex(const DWARF_PATHLIST *filetable,int fileindex)
-{
-  const DWARF_PATHLIST *file;
-
-  assert(filetable!=NULL);
-  assert(fileindex>=0);
-  for (file=filetable->next; file!=NULL && fileindex>0; file=file->next)
-    fileindex--;
-  return (file!=NULL) ? file->name : NULL;
-}
-
-/** dwarf_fileindex_from_path() looks up the path in the file table and
- *  returns the index in the table (if found). The function first tries a
- *  full path, but also compares the base names of the files (if a full path
- *  match fails).
- *
- *  \return The file index, or -1 on failure.
- */
-int dwarf_fileindex_from_path(const DWARF_PATHLIST *filetable,const char *path)
-{
-  const DWARF_PATHLIST *file;
-  int fileindex=0;
-
-  assert(filetable!=NULL);
-  assert(path!=NULL);
-  /* try full path first */
-  for (file=filetable->next; file!=NULL; file=file->next) {
-    if (strcmp(path,file->name)==0)
-      return fileindex;
-    fileindex++;
-  }
-  /* re-try, comparing only base names */
-  fileindex=0;
-  for (file=filetable->next; file!=NULL; file=file->next) {
-    const char *filename=file->name;
-    const char *base;
-    if ((base = strrchr(filename, '/')) != NULL)
-      filename = base + 1;
-#   if defined _WIN32
-      if ((base = strrchr(filename, '\\')) != NULL)
-        filename = base + 1;
-#   endif
-    if (strcmp(path,filename)==0)
-      return fileindex;
-    fileindex++;
-  }
-  return -1;
-}
-
-const DWARF_LINELOOKUP *dwarf_line_from_address(const DWARF_LINELOOKUP *linetable,unsigned address)
-{
-  const DWARF_LINELOOKUP *line;
-
-  assert(linetable!=NULL);
-  for (line=linetable->next; line!=NULL; line=line->next)
-    if (line->address<=address && (line->next==NULL || line->next->address>address))
-      return line;
-  return NULL;
-}
-
+/* Routines to get the line number and symbol tables from the DWARF debug
+ * information (in an ELF file). For the symbol table, only the function and
+ * variable symbols are stored.
+ * For the moment, only 32-bit Little-Endian executables are supported.
+ *
+ * Copyright (c) 2015,2019-2022 CompuPhase
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <assert.h>
+#include <stdio.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include "c11threads.h"
+#include "crc32.h"
+#include "demangle.h"
+#include "elf.h"
+#include "dwarf.h"
+
+#if defined FORTIFY
+# include <alloc/fortify.h>
+#endif
+
+#if defined __GNUC__
+# define PACKED        __attribute__((packed))
+#else
+# define PACKED
+#endif
+
+#if defined __LINUX__ || defined __FreeBSD__ || defined __APPLE__
+# pragma pack(1)       /* structures must be packed (byte-aligned) */
+#elif defined MACOS && defined __MWERKS__
+# pragma options align=mac68k
+#else
+# pragma pack(push)
+# pragma pack(1)       /* structures must be packed (byte-aligned) */
+# if defined __TURBOC__
+#   pragma option -a-  /* "pack" pragma for older Borland compilers */
+# endif
+#endif
+#if defined _MSC_VER
+# define strdup(s)   _strdup(s)
+#endif
+
+#if !defined _MAX_PATH
+# define _MAX_PATH 260
+#endif
+
+typedef struct tagDWARFTABLE {
+  unsigned long offset;
+  unsigned long size;
+} DWARFTABLE;
+
+enum {
+  TABLE_INFO,
+  TABLE_ABBREV,
+  TABLE_STR,
+  TABLE_LINE,
+  TABLE_PUBNAME,
+  TABLE_LINE_STR,
+  /* ----- */
+  TABLE_COUNT
+};
+
+typedef struct tagUNIT_HDR32 {
+  uint32_t unit_length;     /* total length of this block, excluding this field */
+  uint16_t version;         /* table format version */
+  uint8_t  unit_type;       /* DWARF 5+, type of the compilation unit */
+  uint8_t  address_size;    /* size in bytes of an address */
+  uint32_t abbrev_offs;     /* offset into the .debug_abbrev table */
+  /* more fields may follow, depending on unit_type */
+} PACKED UNIT_HDR32;
+
+typedef struct tagUNIT_HDR64 {
+  uint32_t reserved;        /* must be 0xffffffff */
+  uint64_t unit_length;     /* total length of this block, excluding this field */
+  uint16_t version;         /* table format version */
+  uint8_t  unit_type;       /* DWARF 5+, type of the compilation unit */
+  uint8_t  address_size;    /* size in bytes of an address */
+  uint64_t abbrev_offs;     /* offset into the .debug_abbrev table */
+  /* more fields may follow, depending on unit_type */
+} PACKED UNIT_HDR64;
+
+typedef struct tagDWARF_PROLOGUE32 {  /* fixed part of the header */
+  uint32_t total_length;    /* length of the line number table, minus the 4 bytes for this total_length field */
+  uint16_t version;         /* prologue format version */
+  uint8_t  address_size;    /* DWARF 5+, size in bytes of an address */
+  uint8_t  segment_sel_size;/* DWARF 5+, size in bytes of a segment selector on the target system */
+  uint32_t prologue_length; /* offset to the first opcode of the line number program (relative to this prologue_length field) */
+  uint8_t  min_instruction_size;
+  uint8_t  max_oper_per_instruction;  /* DWARF 4+, for VLIW architectures */
+  uint8_t  default_is_stmt; /* default value to initialize the state machine with */
+  int8_t   line_base;
+  uint8_t  line_range;
+  uint8_t  opcode_base;     /* number of the first special opcode */
+  /* standard opcode lengths (array of length "opcode_base" - 1) */
+
+  /* DWARF 2..4, include directories, a sequence of zero-terminated strings (and
+     the sequence itself ends with a zero-byte) */
+  /* DWARF 2..4, file names: base name, location, modification date, size */
+
+  /* DWARF 5+, directory entry formats (length-prefixed array of ULEB128 pairs) */
+  /* DWARF 5+, include directories, a length-prefixed sequence of entries in a format described in the earier table */
+  /* DWARF 5+, filename entry formats (length-prefixed array of ULEB128 pairs) */
+  /* DWARF 5+, filenames, a length-prefixed sequence of entries in a format described in the earier table */
+} PACKED DWARF_PROLOGUE32;
+
+typedef struct tagSTATE {
+  uint32_t address;
+  int file;
+  int line;
+  int column;
+  int is_stmt;          /* whether the address is the start of a statement */
+  int basic_block;      /* whether the address is the start of a basic block */
+  int end_seq;
+  int prologue_end;     /* DWARF 3+, function prologue end */
+  int epiloge_begin;    /* DWARF 3+, function epilogue start */
+  int isa;              /* DWARF 3+, instruction set architecture */
+  unsigned op_index;    /* DWARF 4+, index within a "Very-Long-Instruction-Word" (VLIW) */
+  int discriminator;    /* DWARF 4+, compiler-assigned id for a "block" to which the instruction belongs */
+} STATE;
+
+typedef struct tagPUBNAME_HDR32 {
+  uint32_t totallength; /* total length of this block, excluding this field */
+  uint16_t version;
+  uint32_t info_offs;   /* offset into the comprehensive debug table */
+  uint32_t info_size;   /* size of this symbol in the comprehensive debug table */
+} PACKED PUBNAME_HDR32;
+
+/* unit headers (DWARF 5+) */
+#define DW_UT_compile                 0x01
+#define DW_UT_type                    0x02
+#define DW_UT_partial                 0x03
+#define DW_UT_skeleton                0x04
+#define DW_UT_split_compile           0x05
+#define DW_UT_split_type              0x06
+#define DW_UT_lo_user                 0x80
+#define DW_UT_hi_user                 0xff
+
+/* tags */
+#define DW_TAG_array_type             0x01
+#define DW_TAG_class_type             0x02
+#define DW_TAG_entry_point            0x03
+#define DW_TAG_enumeration_type       0x04
+#define DW_TAG_formal_parameter       0x05
+#define DW_TAG_imported_declaration   0x08
+#define DW_TAG_label                  0x0a
+#define DW_TAG_lexical_block          0x0b
+#define DW_TAG_member                 0x0d
+#define DW_TAG_pointer_type           0x0f
+#define DW_TAG_reference_type         0x10
+#define DW_TAG_compile_unit           0x11
+#define DW_TAG_string_type            0x12
+#define DW_TAG_structure_type         0x13
+#define DW_TAG_subroutine_type        0x15
+#define DW_TAG_typedef                0x16
+#define DW_TAG_union_type             0x17
+#define DW_TAG_unspecified_parameters 0x18
+#define DW_TAG_variant                0x19
+#define DW_TAG_common_block           0x1a
+#define DW_TAG_common_inclusion       0x1b
+#define DW_TAG_inheritance            0x1c
+#define DW_TAG_inlined_subroutine     0x1d
+#define DW_TAG_module                 0x1e
+#define DW_TAG_ptr_to_member_type     0x1f
+#define DW_TAG_set_type               0x20
+#define DW_TAG_subrange_type          0x21
+#define DW_TAG_with_stmt              0x22
+#define DW_TAG_access_declaration     0x23
+#define DW_TAG_base_type              0x24
+#define DW_TAG_catch_block            0x25
+#define DW_TAG_const_type             0x26
+#define DW_TAG_constant               0x27
+#define DW_TAG_enumerator             0x28
+#define DW_TAG_file_type              0x29
+#define DW_TAG_friend                 0x2a
+#define DW_TAG_namelist               0x2b
+#define DW_TAG_namelist_item          0x2c
+#define DW_TAG_packed_type            0x2d
+#define DW_TAG_subprogram             0x2e
+#define DW_TAG_template_type_param    0x2f
+#define DW_TAG_template_value_param   0x30
+#define DW_TAG_thrown_type            0x31
+#define DW_TAG_try_block              0x32
+#define DW_TAG_variant_part           0x33
+#define DW_TAG_variable               0x34
+#define DW_TAG_volatile_type          0x35
+#define DW_TAG_dwarf_procedure        0x36
+#define DW_TAG_restrict_type          0x37
+#define DW_TAG_interface_type         0x38
+#define DW_TAG_namespace              0x39
+#define DW_TAG_imported_module        0x3a
+#define DW_TAG_unspecified_type       0x3b
+#define DW_TAG_partial_unit           0x3c
+#define DW_TAG_imported_unit          0x3d
+#define DW_TAG_condition              0x3f
+#define DW_TAG_shared_type            0x40
+#define DW_TAG_type_unit              0x41
+#define DW_TAG_rvalue_reference_type  0x42
+#define DW_TAG_template_alias         0x43
+    /* DWARF 5+ */
+#define DW_TAG_coarray_type           0x44
+#define DW_TAG_generic_subrange       0x45
+#define DW_TAG_dynamic_type           0x46
+#define DW_TAG_atomic_type            0x47
+#define DW_TAG_call_site              0x48
+#define DW_TAG_call_site_parameter    0x49
+#define DW_TAG_skeleton_unit          0x4a
+#define DW_TAG_immutable_type         0x4b
+#define DW_TAG_lo_user                0x4080
+#define DW_TAG_hi_user                0xffff
+
+#define DW_AT_sibling                 0x01  /* reference */
+#define DW_AT_location                0x02  /* block, constant */
+#define DW_AT_name                    0x03  /* string */
+#define DW_AT_ordering                0x09  /* constant */
+#define DW_AT_byte_size               0x0b  /* constant */
+#define DW_AT_bit_offset              0x0c  /* constant */
+#define DW_AT_bit_size                0x0d  /* constant */
+#define DW_AT_stmt_list               0x10  /* constant */
+#define DW_AT_low_pc                  0x11  /* address */
+#define DW_AT_high_pc                 0x12  /* address */
+#define DW_AT_language                0x13  /* constant */
+#define DW_AT_discr                   0x15  /* reference */
+#define DW_AT_discr_value             0x16  /* constant */
+#define DW_AT_visibility              0x17  /* constant */
+#define DW_AT_import                  0x18  /* reference */
+#define DW_AT_string_length           0x19  /* block, constant */
+#define DW_AT_common_reference        0x1a  /* reference */
+#define DW_AT_comp_dir                0x1b  /* string */
+#define DW_AT_const_value             0x1c  /* string, constant, block */
+#define DW_AT_containing_type         0x1d  /* reference */
+#define DW_AT_default_value           0x1e  /* reference */
+#define DW_AT_inline                  0x20  /* constant */
+#define DW_AT_is_optional             0x21  /* flag */
+#define DW_AT_lower_bound             0x22  /* constant, reference */
+#define DW_AT_producer                0x25  /* string */
+#define DW_AT_prototyped              0x27  /* flag */
+#define DW_AT_return_addr             0x2a  /* block, constant */
+#define DW_AT_start_scope             0x2c  /* constant */
+#define DW_AT_stride_size             0x2e  /* constant */
+#define DW_AT_upper_bound             0x2f  /* constant, reference */
+#define DW_AT_abstract_origin         0x31  /* reference */
+#define DW_AT_accessibility           0x32  /* constant */
+#define DW_AT_address_class           0x33  /* constant */
+#define DW_AT_artificial              0x34  /* flag */
+#define DW_AT_base_types              0x35  /* reference */
+#define DW_AT_calling_convention      0x36  /* constant */
+#define DW_AT_count                   0x37  /* constant, reference */
+#define DW_AT_data_member_location    0x38  /* block, reference */
+#define DW_AT_decl_column             0x39  /* constant */
+#define DW_AT_decl_file               0x3a  /* constant */
+#define DW_AT_decl_line               0x3b  /* constant */
+#define DW_AT_declaration             0x3c  /* flag */
+#define DW_AT_discr_list              0x3d  /* block */
+#define DW_AT_encoding                0x3e  /* constant */
+#define DW_AT_external                0x3f  /* flag */
+#define DW_AT_frame_base              0x40  /* block, constant */
+#define DW_AT_friend                  0x41  /* reference */
+#define DW_AT_identifier_case         0x42  /* constant */
+#define DW_AT_macro_info              0x43  /* constant */
+#define DW_AT_namelist_item           0x44  /* block */
+#define DW_AT_priority                0x45  /* reference */
+#define DW_AT_segment                 0x46  /* block, constant */
+#define DW_AT_specification           0x47  /* reference */
+#define DW_AT_static_link             0x48  /* block, constant */
+#define DW_AT_type                    0x49  /* reference */
+#define DW_AT_use_location            0x4a  /* block, constant */
+#define DW_AT_variable_parameter      0x4b  /* flag */
+#define DW_AT_virtuality              0x4c  /* constant */
+#define DW_AT_vtable_elem_location    0x4d  /* exprloc, loclist */
+#define DW_AT_allocated               0x4e  /* constant, exprloc, reference */
+#define DW_AT_associated              0x4f  /* constant, exprloc, reference */
+#define DW_AT_data_location           0x50  /* exprloc */
+#define DW_AT_byte_stride             0x51  /* constant, exprloc, reference */
+#define DW_AT_entry_pc                0x52  /* address, constant */
+#define DW_AT_use_UTF8                0x53  /* flag */
+#define DW_AT_extension               0x54  /* reference */
+#define DW_AT_ranges                  0x55  /* rnglist */
+#define DW_AT_trampoline              0x56  /* address, flag, reference, string */
+#define DW_AT_call_column             0x57  /* constant */
+#define DW_AT_call_file               0x58  /* constant */
+#define DW_AT_call_line               0x59  /* constant */
+#define DW_AT_description             0x5a  /* string */
+#define DW_AT_binary_scale            0x5b  /* constant */
+#define DW_AT_decimal_scale           0x5c  /* constant */
+#define DW_AT_small                   0x5d  /* reference */
+#define DW_AT_decimal_sign            0x5e  /* constant */
+#define DW_AT_digit_count             0x5f  /* constant */
+#define DW_AT_picture_string          0x60  /* string */
+#define DW_AT_mutable                 0x61  /* flag */
+#define DW_AT_threads_scaled          0x62  /* flag */
+#define DW_AT_explicit                0x63  /* flag */
+#define DW_AT_object_pointer          0x64  /* reference */
+#define DW_AT_endianity               0x65  /* constant */
+#define DW_AT_elemental               0x66  /* flag */
+#define DW_AT_pure                    0x67  /* flag */
+#define DW_AT_recursive               0x68  /* flag */
+#define DW_AT_signature               0x69  /* reference */
+#define DW_AT_main_subprogram         0x6a  /* flag */
+#define DW_AT_data_bit_offset         0x6b  /* constant */
+#define DW_AT_const_expr              0x6c  /* flag */
+#define DW_AT_enum_class              0x6d  /* flag */
+#define DW_AT_linkage_name            0x6e  /* string */
+    /* DWARF 5+ */
+#define DW_AT_string_length_bit_size  0x6f  /* constant */
+#define DW_AT_string_length_byte_size 0x70  /* constant */
+#define DW_AT_rank                    0x71  /* constant, exprloc */
+#define DW_AT_str_offsets_base        0x72  /* stroffsetsptr */
+#define DW_AT_addr_base               0x73  /* addrptr */
+#define DW_AT_rnglists_base           0x74  /* rnglistsptr */
+#define DW_AT_dwo_name                0x76  /* string */
+#define DW_AT_reference               0x77  /* flag */
+#define DW_AT_rvalue_reference        0x78  /* flag */
+#define DW_AT_macros                  0x79  /* macptr */
+#define DW_AT_call_all_calls          0x7a  /* flag */
+#define DW_AT_call_all_source_calls   0x7b  /* flag */
+#define DW_AT_call_all_tail_calls     0x7c  /* flag */
+#define DW_AT_call_return_pc          0x7d  /* address */
+#define DW_AT_call_value              0x7e  /* exprloc */
+#define DW_AT_call_origin             0x7f  /* exprloc */
+#define DW_AT_call_parameter          0x80  /* reference */
+#define DW_AT_call_pc                 0x81  /* address */
+#define DW_AT_call_tail_call          0x82  /* flag */
+#define DW_AT_call_target             0x83  /* exprloc */
+#define DW_AT_call_target_clobbered   0x84  /* exprloc */
+#define DW_AT_call_data_location      0x85  /* exprloc */
+#define DW_AT_call_data_value         0x86  /* exprloc */
+#define DW_AT_noreturn                0x87  /* flag */
+#define DW_AT_alignment               0x88  /* constant */
+#define DW_AT_export_symbols          0x89  /* flag */
+#define DW_AT_deleted                 0x8a  /* flag */
+#define DW_AT_defaulted               0x8b  /* constant */
+#define DW_AT_loclists_base           0x8c  /* loclistsptr */
+#define DW_AT_lo_user                 0x2000
+#define DW_AT_hi_user                 0x3fff
+
+#define DW_FORM_addr                  0x01  /* address, 4 bytes for 32-bit, 8 bytes for 64-bit */
+#define DW_FORM_block2                0x03  /* block, 2-byte length + up to 64K data bytes */
+#define DW_FORM_block4                0x04  /* block, 4-byte length + up to 4G data bytes */
+#define DW_FORM_data2                 0x05  /* constant, 2 bytes */
+#define DW_FORM_data4                 0x06  /* constant, 4 bytes */
+#define DW_FORM_data8                 0x07  /* constant, 8 bytes */
+#define DW_FORM_string                0x08  /* string, zero-terminated */
+#define DW_FORM_block                 0x09  /* block, unsigned LEB128-encoded length + data bytes */
+#define DW_FORM_block1                0x0a  /* block, 1-byte length + up to 255 data bytes */
+#define DW_FORM_data1                 0x0b  /* constant, 1 bytes */
+#define DW_FORM_flag                  0x0c  /* flag, 1 byte (0=false, any non-zero=true) */
+#define DW_FORM_sdata                 0x0d  /* constant, signed LEB128 */
+#define DW_FORM_strp                  0x0e  /* string, 4-byte offset into the .debug_str section */
+#define DW_FORM_udata                 0x0f  /* constant, unsigned LEB128 */
+#define DW_FORM_ref_addr              0x10  /* reference, address size (4 bytes on 32-bit, 8 bytes on 64-bit) */
+#define DW_FORM_ref1                  0x11  /* reference, 1 bytes */
+#define DW_FORM_ref2                  0x12  /* reference, 2 bytes */
+#define DW_FORM_ref4                  0x13  /* reference, 4 bytes */
+#define DW_FORM_ref8                  0x14  /* reference, 8 bytes */
+#define DW_FORM_ref_udata             0x15  /* reference, unsigned LEB128 */
+#define DW_FORM_indirect              0x16  /* format is specified in the .debug_info data (not in the abbreviation) */
+    /* DWARF 4+ */
+#define DW_FORM_sec_offset            0x17  /* offset into the .debug_line section (4 bytes on 32-bit, 8 bytes on 64-bit) */
+#define DW_FORM_exprloc               0x18  /* block for expression/location, unsigned LEB128-encoded length + data bytes */
+#define DW_FORM_flag_present          0x19  /* implicit flag (no data) */
+    /* DWARF 5+ */
+#define DW_FORM_strx                  0x1a  /* string */
+#define DW_FORM_addrx                 0x1b  /* address */
+#define DW_FORM_ref_sup4              0x1c  /* reference relative to .debug_info of a supplementaty object file, 4 bytes */
+#define DW_FORM_strp_sup              0x1d  /* string, 4-byte offset into the .debug_str section of a supplementary object file */
+#define DW_FORM_data16                0x1e  /* constant, 16 bytes (MD5) */
+#define DW_FORM_line_strp             0x1f  /* string, 4-byte offset into the .debug_line_str section */
+#define DW_FORM_ref_sig8              0x20  /* 64-bit signature for a type defined in a different unit (already present in DWARF 4) */
+#define DW_FORM_implicit_const        0x21  /* constant whose value is in the abbreviation's attribute, not in the .debug_info data */
+#define DW_FORM_loclistx              0x22  /* loclist */
+#define DW_FORM_rnglistx              0x23  /* rnglist */
+#define DW_FORM_ref_sup8              0x24  /* reference relative to .debug_info of a supplementaty object file, 8 bytes */
+#define DW_FORM_strx1                 0x25  /* string */
+#define DW_FORM_strx2                 0x26  /* string */
+#define DW_FORM_strx3                 0x27  /* string */
+#define DW_FORM_strx4                 0x28  /* string */
+#define DW_FORM_addrx1                0x29  /* address */
+#define DW_FORM_addrx2                0x2a  /* address */
+#define DW_FORM_addrx3                0x2b  /* address */
+#define DW_FORM_addrx4                0x2c  /* address */
+
+/* line number opcodes */
+#define DW_LNS_extended_op            0     /* version 2+ */
+#define DW_LNS_copy                   1
+#define DW_LNS_advance_pc             2
+#define DW_LNS_advance_line           3
+#define DW_LNS_set_file               4
+#define DW_LNS_set_column             5
+#define DW_LNS_negate_stmt            6
+#define DW_LNS_set_basic_block        7
+#define DW_LNS_const_add_pc           8
+#define DW_LNS_fixed_advance_pc       9
+#define DW_LNS_set_prologue_end       10    /* version 3+ */
+#define DW_LNS_set_epilogue_begin     11
+#define DW_LNS_set_isa                12
+/* line number extended opcodes */
+#define DW_LNE_end_sequence           1     /* version 2+ */
+#define DW_LNE_set_address            2
+#define DW_LNE_define_file            3     /* deprecated in version 5+ */
+#define DW_LNE_set_discriminator      4     /* version 4+ */
+#define DW_LNE_lo_user                0x80
+#define DW_LNE_hi_user                0xff
+
+/* location expression opcodes */
+#define DW_OP_addr                    0x03  /* constant address (32-bit or 64-bit) */
+#define DW_OP_deref                   0x06
+#define DW_OP_const1u                 0x08  /* 1-byte constant */
+#define DW_OP_const1s                 0x09  /* 1-byte constant */
+#define DW_OP_const2u                 0x0a  /* 2-byte constant */
+#define DW_OP_const2s                 0x0b  /* 2-byte constant */
+#define DW_OP_const4u                 0x0c  /* 4-byte constant */
+#define DW_OP_const4s                 0x0d  /* 4-byte constant */
+#define DW_OP_const8u                 0x0e  /* 8-byte constant */
+#define DW_OP_const8s                 0x0f  /* 8-byte constant */
+#define DW_OP_constu                  0x10  /* ULEB128 constant */
+#define DW_OP_consts                  0x11  /* SLEB128 constant */
+#define DW_OP_dup                     0x12
+#define DW_OP_drop                    0x13
+#define DW_OP_over                    0x14
+#define DW_OP_pick                    0x15  /* 1-byte stack index */
+#define DW_OP_swap                    0x16
+#define DW_OP_rot                     0x17
+#define DW_OP_xderef                  0x18
+#define DW_OP_abs                     0x19
+#define DW_OP_and                     0x1a
+#define DW_OP_div                     0x1b
+#define DW_OP_minus                   0x1c
+#define DW_OP_mod                     0x1d
+#define DW_OP_mul                     0x1e
+#define DW_OP_neg                     0x1f
+#define DW_OP_not                     0x20
+#define DW_OP_or                      0x21
+#define DW_OP_plus                    0x22
+#define DW_OP_plus_uconst             0x23  /* ULEB128 addend */
+#define DW_OP_shl                     0x24
+#define DW_OP_shr                     0x25
+#define DW_OP_shra                    0x26
+#define DW_OP_xor                     0x27
+#define DW_OP_bra                     0x28  /* signed 2-byte constant */
+#define DW_OP_eq                      0x29
+#define DW_OP_ge                      0x2a
+#define DW_OP_gt                      0x2b
+#define DW_OP_le                      0x2c
+#define DW_OP_lt                      0x2d
+#define DW_OP_ne                      0x2e
+#define DW_OP_skip                    0x2f  /* signed 2-byte constant */
+#define DW_OP_lit0                    0x30  /* literals 0..31 = DW_OP_lit0 + literal */
+#define DW_OP_reg0                    0x50  /* registers 0..31 = DW_OP_reg0 + regnum */
+#define DW_OP_breg0                   0x70  /* SLEB128 offset, base registers 0..31 = DW_OP_breg0 + regnum */
+#define DW_OP_regx                    0x90  /* ULEB128 register */
+#define DW_OP_fbreg                   0x91  /* SLEB128 offset */
+#define DW_OP_bregx                   0x92  /* ULEB128 register, SLEB128 offset */
+#define DW_OP_piece                   0x93  /* ULEB128 size of piece */
+#define DW_OP_deref_size              0x94  /* 1-byte size of data retrieved */
+#define DW_OP_xderef_size             0x95  /* 1-byte size of data retrieved */
+#define DW_OP_nop                     0x96
+#define DW_OP_push_object_address     0x97
+#define DW_OP_call2                   0x98  /* 2-byte offset of DIE */
+#define DW_OP_call4                   0x99  /* 4-byte offset of DIE */
+#define DW_OP_call_ref                0x9a  /* 4- or 8-byte offset of DIE */
+#define DW_OP_form_tls_address        0x9b
+#define DW_OP_call_frame_cfa          0x9c
+#define DW_OP_bit_piece               0x9d  /* ULEB128 size, ULEB128 offset */
+#define DW_OP_implicit_value          0x9e  /* ULEB128 size, block of that size */
+#define DW_OP_stack_value             0x9f
+    /* DWARF 5+ */
+#define DW_OP_implicit_pointer        0xa0  /* 4- or 8-byte offset of DIE, SLEB128 constant offset */
+#define DW_OP_addrx                   0xa1  /* ULEB128 indirect address */
+#define DW_OP_constx                  0xa2  /* ULEB128 indirect constant */
+#define DW_OP_entry_value             0xa3  /* ULEB128 size, block of that size */
+#define DW_OP_const_type              0xa4  /* ULEB128 type entry offset, 1-byte size, constant value */
+#define DW_OP_regval_type             0xa5  /* ULEB128 register number, ULEB128 constant offset */
+#define DW_OP_deref_type              0xa6  /* 1-byte size, ULEB128 type entry offset */
+#define DW_OP_xderef_type             0xa7  /* 1-byte size, ULEB128 type entry offset */
+#define DW_OP_convert                 0xa8  /* ULEB128 type entry offset */
+#define DW_OP_reinterpret             0xa9  /* ULEB128 type entry offset */
+#define DW_OP_lo_user                 0xe0
+#define DW_OP_hi_user                 0xff
+
+#if defined __LINUX__ || defined __FreeBSD__ || defined __APPLE__
+# pragma pack()      /* reset default packing */
+#elif defined MACOS && defined __MWERKS__
+# pragma options align=reset
+#else
+# pragma pack(pop)   /* reset previous packing */
+#endif
+
+
+#define SWAP16(v)     ((((v) >> 8) & 0xff) | (((v) & 0xff) << 8))
+#define SWAP32(v)     ((((v) >> 24) & 0xff) | (((v) & 0xff0000) >> 8) | (((v) & 0xff00) << 8)  | (((v) & 0xff) << 24))
+
+
+typedef struct tagATTRIBUTE {
+  int tag;
+  int format;
+  long value;   /* value for implicit constant */
+} ATTRIBUTE;
+
+typedef struct tagABBREVLIST {
+  struct tagABBREVLIST *next;
+  int unit;     /* the compilation unit */
+  int id;
+  int tag;
+  int has_children;
+  int count;    /* number of attributes */
+  ATTRIBUTE *attributes;
+} ABBREVLIST;
+
+typedef struct tagABBREVUNIT {
+  ABBREVLIST **codes;   /* abbreviations indexed on id (NULL for unused ids) */
+  int numcodes;         /* size of the "codes" array */
+  ABBREVLIST *first;    /* first abbreviation of the unit in the list */
+} ABBREVUNIT;
+
+typedef struct tagABBREVTABLE {
+  ABBREVLIST root;      /* all abbreviations, in the order of the table */
+  ABBREVLIST *tail;     /* last entry in the list (for appending) */
+  ABBREVUNIT *units;    /* per unit lookup, built after the table is read */
+  int numunits;
+} ABBREVTABLE;
+
+typedef struct tagPATHXREF {
+  int **filemap;  /* per unit: the index in DWARF_PATHLIST for each unit-relative file */
+  int *numfiles;  /* per unit: number of entries in "filemap" */
+  int numunits;
+} PATHXREF;
+
+static ABBREVLIST *abbrev_insert(ABBREVTABLE *table,int unit,int id,int tag,int has_children,
+                                 int num_attributes,const ATTRIBUTE attributes[])
+{
+  ABBREVLIST *cur;
+
+  assert(table!=NULL);
+  assert(attributes!=NULL || num_attributes==0);
+  if ((cur=(ABBREVLIST*)malloc(sizeof(ABBREVLIST)))==NULL)
+    return NULL;      /* insufficient memory */
+  cur->unit=unit;
+  cur->id=id;
+  cur->tag=tag;
+  cur->has_children=has_children;
+  cur->count=num_attributes;
+  if (num_attributes>0) {
+    int idx;
+    if ((cur->attributes=malloc(num_attributes*sizeof(ATTRIBUTE)))==NULL) {
+      free(cur);
+      return NULL;      /* insufficient memory */
+    }
+    for (idx=0; idx<num_attributes; idx++) {
+      cur->attributes[idx].tag=attributes[idx].tag;
+      cur->attributes[idx].format=attributes[idx].format;
+      cur->attributes[idx].value=attributes[idx].value;
+    }
+  } else {
+    cur->attributes=NULL;
+  }
+  /* insert as "last" (append mode) */
+  if (table->tail==NULL)
+    table->tail=&table->root;
+  assert(table->tail->next==NULL);
+  cur->next=NULL;
+  table->tail->next=cur;
+  table->tail=cur;
+  return cur;
+}
+
+static void abbrev_deletetable(ABBREVTABLE *table)
+{
+  ABBREVLIST *cur,*next;
+  int unit;
+
+  assert(table!=NULL);
+  cur=table->root.next;
+  while (cur!=NULL) {
+    next=cur->next;
+    assert(cur->attributes!=NULL || cur->count==0);
+    if (cur->attributes!=NULL)
+      free(cur->attributes);
+    free(cur);
+    cur=next;
+  } /* while */
+  if (table->units!=NULL) {
+    for (unit=0; unit<table->numunits; unit++)
+      if (table->units[unit].codes!=NULL)
+        free(table->units[unit].codes);
+    free(table->units);
+  }
+  memset(table,0,sizeof(ABBREVTABLE));
+}
+
+/* abbrev_buildindex() creates a lookup table per unit that is indexed on the
+   abbreviation id; the ids are normally small and dense, but when they are
+   sparse, the lookup for that unit walks through the entries of that unit
+   only */
+static bool abbrev_buildindex(ABBREVTABLE *table)
+{
+  ABBREVLIST *cur;
+  int unit,count;
+
+  assert(table!=NULL);
+  assert(table->units==NULL);
+  table->numunits=0;
+  for (cur=table->root.next; cur!=NULL; cur=cur->next)
+    if (cur->unit>=table->numunits)
+      table->numunits=cur->unit+1;
+  if (table->numunits==0)
+    return true;
+  table->units=(ABBREVUNIT*)malloc(table->numunits*sizeof(ABBREVUNIT));
+  if (table->units==NULL) {
+    table->numunits=0;
+    return false;     /* insufficient memory */
+  }
+  memset(table->units,0,table->numunits*sizeof(ABBREVUNIT));
+
+  cur=table->root.next;
+  while (cur!=NULL) {
+    ABBREVLIST *first=cur;
+    int maxid=0;
+    unit=cur->unit;
+    assert(unit>=0 && unit<table->numunits);
+    for (count=0; cur!=NULL && cur->unit==unit; cur=cur->next) {
+      if (cur->id>maxid)
+        maxid=cur->id;
+      count++;
+    }
+    ABBREVUNIT *u=&table->units[unit];
+    u->first=first;
+    if (maxid<=4*count+16 && (u->codes=(ABBREVLIST**)malloc((maxid+1)*sizeof(ABBREVLIST*)))!=NULL) {
+      ABBREVLIST *item;
+      u->numcodes=maxid+1;
+      memset(u->codes,0,u->numcodes*sizeof(ABBREVLIST*));
+      for (item=first; item!=cur; item=item->next)
+        if (item->id>=0 && u->codes[item->id]==NULL)
+          u->codes[item->id]=item;  /* on duplicate ids, the first one wins */
+    }
+  }
+  return true;
+}
+
+static ABBREVLIST *abbrev_find(const ABBREVTABLE *table,int unit,int id)
+{
+  ABBREVLIST *cur;
+
+  assert(table!=NULL);
+  if (table->units==NULL) {
+    /* no index, search through the complete list */
+    for (cur=table->root.next; cur!=NULL && (cur->unit!=unit || cur->id!=id); cur=cur->next)
+      {}
+    return cur;
+  }
+  if (unit<0 || unit>=table->numunits)
+    return NULL;
+  const ABBREVUNIT *u=&table->units[unit];
+  if (u->codes!=NULL)
+    return (id>=0 && id<u->numcodes) ? u->codes[id] : NULL;
+  for (cur=u->first; cur!=NULL && cur->unit==unit; cur=cur->next)
+    if (cur->id==id)
+      return cur;
+  return NULL;
+}
+
+
+/* pathxref_init() allocates the per-unit file maps (which are all empty) */
+static bool pathxref_init(PATHXREF *xref,int numunits)
+{
+  assert(xref!=NULL);
+  assert(xref->filemap==NULL && xref->numfiles==NULL);
+  if (numunits<=0)
+    return true;
+  xref->filemap=(int**)malloc(numunits*sizeof(int*));
+  xref->numfiles=(int*)malloc(numunits*sizeof(int));
+  if (xref->filemap==NULL || xref->numfiles==NULL) {
+    if (xref->filemap!=NULL)
+      free(xref->filemap);
+    if (xref->numfiles!=NULL)
+      free(xref->numfiles);
+    memset(xref,0,sizeof(PATHXREF));
+    return false;   /* insufficient memory */
+  }
+  memset(xref->filemap,0,numunits*sizeof(int*));
+  memset(xref->numfiles,0,numunits*sizeof(int));
+  xref->numunits=numunits;
+  return true;
+}
+
+/* pathxref_set() stores the file map of a unit; the cross-reference takes
+   ownership of the (allocated) map */
+static void pathxref_set(PATHXREF *xref,int unit,int *filemap,int numfiles)
+{
+  assert(xref!=NULL);
+  assert(unit>=0 && unit<xref->numunits);
+  assert(xref->filemap[unit]==NULL);
+  xref->filemap[unit]=filemap;
+  xref->numfiles[unit]=numfiles;
+}
+
+static void pathxref_deletetable(PATHXREF *xref)
+{
+  int unit;
+
+  assert(xref!=NULL);
+  if (xref->filemap!=NULL) {
+    for (unit=0; unit<xref->numunits; unit++)
+      if (xref->filemap[unit]!=NULL)
+        free(xref->filemap[unit]);
+    free(xref->filemap);
+  }
+  if (xref->numfiles!=NULL)
+    free(xref->numfiles);
+  memset(xref,0,sizeof(PATHXREF));
+}
+
+static int pathxref_find(const PATHXREF *xref,int unit,int file)
+{
+  assert(xref!=NULL);
+  if (unit<0 || unit>=xref->numunits || xref->filemap[unit]==NULL)
+    return -1;
+  if (file<0 || file>=xref->numfiles[unit])
+    return -1;
+  return xref->filemap[unit][file];
+}
+
+
+static DWARF_PATHLIST *path_insert(DWARF_PATHLIST *root,const char *string)
+{
+  DWARF_PATHLIST *cur;
+
+  assert(string!=NULL);
+  if ((cur=(DWARF_PATHLIST*)malloc(sizeof(DWARF_PATHLIST)))==NULL)
+    return NULL;      /* insufficient memory */
+  if ((cur->name=strdup(string))==NULL) {
+    free(cur);
+    return NULL;      /* insufficient memory */
+  }
+  /* insert as "last" (append mode) */
+  assert(root!=NULL);
+  while (root->next!=NULL)
+    root=root->next;
+  cur->next=root->next;
+  root->next=cur;
+  return cur;
+}
+
+static void path_deletetable(DWARF_PATHLIST *root)
+{
+  DWARF_PATHLIST *cur,*next;
+
+  assert(root!=NULL);
+  cur=root->next;
+  while (cur!=NULL) {
+    next=cur->next;
+    assert(cur->name!=NULL);
+    free(cur->name);
+    free(cur);
+    cur=next;
+  }
+  memset(root,0,sizeof(DWARF_PATHLIST));
+}
+
+static char *path_get(const DWARF_PATHLIST *root,int index)
+{
+  DWARF_PATHLIST *cur;
+
+  assert(root!=NULL);
+  for (cur=root->next; cur!=NULL && index-->0; cur=cur->next)
+    {}
+  if (cur!=NULL) {
+    assert(cur->name!=NULL);
+    return cur->name;
+  }
+  return NULL;
+}
+
+static int path_find(const DWARF_PATHLIST *root,const char *name)
+{
+  DWARF_PATHLIST *cur;
+  int index;
+
+  assert(root!=NULL);
+  assert(name!=NULL);
+  index=0;
+  for (cur=root->next; cur!=NULL && strcmp(name,cur->name)!=0; cur=cur->next)
+    index++;
+  return (cur!=NULL) ? index : -1;
+}
+
+
+/* The line table is collected in a growable array while parsing (adding an
+   entry is then amortized O(1)). At the end, the array is sorted and stripped
+   of duplicates, after which it is linked into a list (for compatibility with
+   the list-based API). The array itself remains the primary store, so that
+   lookups can use a binary search. */
+typedef struct tagLINEVECTOR {
+  DWARF_LINELOOKUP *items;
+  unsigned count;
+  unsigned size;
+} LINEVECTOR;
+
+typedef struct tagLINEINDEX {
+  struct tagLINEINDEX *next;
+  const DWARF_LINELOOKUP *root; /* the line table that this index belongs to */
+  DWARF_LINELOOKUP *lines;      /* packed array, sorted on address (also linked as a list) */
+  unsigned count;               /* number of entries in "lines" */
+  unsigned *byline;             /* indices into "lines", sorted on file index & line number */
+  unsigned linecount;           /* number of entries in "byline" (unique file/line pairs) */
+} LINEINDEX;
+
+static LINEINDEX lineindex_root = { NULL };
+
+static bool line_append(LINEVECTOR *vector,int line,unsigned address,int fileindex)
+{
+  assert(vector!=NULL);
+  if (vector->count>=vector->size) {
+    unsigned newsize=(vector->size==0) ? 256 : 2*vector->size;
+    DWARF_LINELOOKUP *list=(DWARF_LINELOOKUP*)realloc(vector->items,newsize*sizeof(DWARF_LINELOOKUP));
+    if (list==NULL)
+      return false;     /* insufficient memory */
+    vector->items=list;
+    vector->size=newsize;
+  }
+  DWARF_LINELOOKUP *cur=&vector->items[vector->count++];
+  cur->next=NULL;
+  cur->line=line;
+  cur->address=address;
+  cur->fileindex=fileindex;
+  return true;
+}
+
+static void line_clearvector(LINEVECTOR *vector)
+{
+  assert(vector!=NULL);
+  if (vector->items!=NULL)
+    free(vector->items);
+  memset(vector,0,sizeof(LINEVECTOR));
+}
+
+static int line_cmp_fileline(const void *p1,const void *p2)
+{
+  const DWARF_LINELOOKUP *l1=(const DWARF_LINELOOKUP*)p1;
+  const DWARF_LINELOOKUP *l2=(const DWARF_LINELOOKUP*)p2;
+  if (l1->fileindex!=l2->fileindex)
+    return (l1->fileindex<l2->fileindex) ? -1 : 1;
+  if (l1->line!=l2->line)
+    return (l1->line<l2->line) ? -1 : 1;
+  if (l1->address!=l2->address)
+    return (l1->address<l2->address) ? -1 : 1;
+  return 0;
+}
+
+static int line_cmp_fileaddr(const void *p1,const void *p2)
+{
+  const DWARF_LINELOOKUP *l1=(const DWARF_LINELOOKUP*)p1;
+  const DWARF_LINELOOKUP *l2=(const DWARF_LINELOOKUP*)p2;
+  if (l1->fileindex!=l2->fileindex)
+    return (l1->fileindex<l2->fileindex) ? -1 : 1;
+  if (l1->address!=l2->address)
+    return (l1->address<l2->address) ? -1 : 1;
+  if (l1->line!=l2->line)
+    return (l1->line>l2->line) ? -1 : 1;  /* highest line first */
+  return 0;
+}
+
+static int line_cmp_address(const void *p1,const void *p2)
+{
+  const DWARF_LINELOOKUP *l1=(const DWARF_LINELOOKUP*)p1;
+  const DWARF_LINELOOKUP *l2=(const DWARF_LINELOOKUP*)p2;
+  if (l1->address!=l2->address)
+    return (l1->address<l2->address) ? -1 : 1;
+  if (l1->fileindex!=l2->fileindex)
+    return (l1->fileindex<l2->fileindex) ? -1 : 1;
+  if (l1->line!=l2->line)
+    return (l1->line<l2->line) ? -1 : 1;
+  return 0;
+}
+
+static const DWARF_LINELOOKUP *line_sortbase = NULL;  /* used by line_cmp_index() */
+
+static int line_cmp_index(const void *p1,const void *p2)
+{
+  assert(line_sortbase!=NULL);
+  return line_cmp_fileline(&line_sortbase[*(const unsigned*)p1],&line_sortbase[*(const unsigned*)p2]);
+}
+
+/* line_buildindex() removes duplicate addresses from the collected lines,
+   sorts them on address and links them into the list of the root; the vector
+   is moved into the index (and reset to empty) */
+static bool line_buildindex(DWARF_LINELOOKUP *root,LINEVECTOR *vector)
+{
+  unsigned idx,count;
+
+  assert(root!=NULL && root->next==NULL);
+  assert(vector!=NULL);
+  if (vector->count==0)
+    return true;
+
+  /* for each address in a file, keep the highest line number */
+  qsort(vector->items,vector->count,sizeof(DWARF_LINELOOKUP),line_cmp_fileaddr);
+  for (count=idx=1; idx<vector->count; idx++) {
+    const DWARF_LINELOOKUP *prev=&vector->items[count-1];
+    const DWARF_LINELOOKUP *cur=&vector->items[idx];
+    if (cur->fileindex!=prev->fileindex || cur->address!=prev->address)
+      vector->items[count++]=*cur;
+  }
+  vector->count=count;
+  qsort(vector->items,vector->count,sizeof(DWARF_LINELOOKUP),line_cmp_address);
+
+  LINEINDEX *index=(LINEINDEX*)malloc(sizeof(LINEINDEX));
+  if (index==NULL)
+    return false;       /* insufficient memory */
+  index->byline=(unsigned*)malloc(vector->count*sizeof(unsigned));
+  if (index->byline==NULL) {
+    free(index);
+    return false;       /* insufficient memory */
+  }
+  index->root=root;
+  index->lines=vector->items;
+  index->count=vector->count;
+  for (idx=0; idx<index->count; idx++) {
+    index->lines[idx].next=(idx+1<index->count) ? &index->lines[idx+1] : NULL;
+    index->byline[idx]=idx;
+  }
+  line_sortbase=index->lines;
+  qsort(index->byline,index->count,sizeof(unsigned),line_cmp_index);
+  line_sortbase=NULL;
+  /* a line may map to multiple addresses, only keep the lowest address for
+     the line-to-address index */
+  for (count=idx=1; idx<index->count; idx++) {
+    const DWARF_LINELOOKUP *prev=&index->lines[index->byline[count-1]];
+    const DWARF_LINELOOKUP *cur=&index->lines[index->byline[idx]];
+    if (cur->fileindex!=prev->fileindex || cur->line!=prev->line)
+      index->byline[count++]=index->byline[idx];
+  }
+  index->linecount=count;
+
+  root->next=index->lines;
+  index->next=lineindex_root.next;
+  lineindex_root.next=index;
+  memset(vector,0,sizeof(LINEVECTOR));  /* array is now owned by the index */
+  return true;
+}
+
+static const LINEINDEX *line_findindex(const DWARF_LINELOOKUP *root)
+{
+  const LINEINDEX *index;
+
+  assert(root!=NULL);
+  for (index=lineindex_root.next; index!=NULL && index->root!=root; index=index->next)
+    {}
+  /* verify that the table was not modified since the index was built */
+  if (index!=NULL && root->next!=index->lines)
+    index=NULL;
+  return index;
+}
+
+/* line_lowerbound() returns the index of the first entry in the sorted line
+   table whose address is equal to or above the given address */
+static unsigned line_lowerbound(const LINEINDEX *index,unsigned address)
+{
+  unsigned low=0,high=index->count;
+  while (low<high) {
+    unsigned mid=low+(high-low)/2;
+    if (index->lines[mid].address<address)
+      low=mid+1;
+    else
+      high=mid;
+  }
+  return low;
+}
+
+static void line_deletetable(DWARF_LINELOOKUP *root)
+{
+  DWARF_LINELOOKUP *cur,*next;
+  LINEINDEX *pred;
+
+  assert(root!=NULL);
+  for (pred=&lineindex_root; pred->next!=NULL && pred->next->root!=root; pred=pred->next)
+    {}
+  if (pred->next!=NULL) {
+    LINEINDEX *index=pred->next;
+    pred->next=index->next;
+    assert(root->next==index->lines);
+    free(index->lines);
+    free(index->byline);
+    free(index);
+  } else {
+    cur=root->next;
+    while (cur!=NULL) {
+      next=cur->next;
+      free(cur);
+      cur=next;
+    } /* while */
+  }
+  memset(root,0,sizeof(DWARF_LINELOOKUP));
+}
+
+static DWARF_SYMBOLLIST *symname_insert(DWARF_SYMBOLLIST *pred,const char *name,
+                                        unsigned code_addr,unsigned code_range,
+                                        unsigned data_addr,int fileindex,int line,
+                                        int external)
+{
+  DWARF_SYMBOLLIST *cur;
+
+  assert(pred!=NULL);
+  assert(name!=NULL);
+
+  if ((cur=(DWARF_SYMBOLLIST*)malloc(sizeof(DWARF_SYMBOLLIST)))==NULL)
+    return NULL;      /* insufficient memory */
+
+  /* the name is stored as is; it is demangled on first use, see dwarf_sym_name() */
+  if ((cur->name=strdup(name))==NULL) {
+    free(cur);
+    return NULL;      /* insufficient memory */
+  }
+  cur->plain=NULL;
+
+  cur->code_addr=code_addr;
+  cur->code_range=code_range;
+  cur->data_addr=data_addr;
+  cur->fileindex=fileindex;
+  cur->line=line;
+  cur->line_limit=0;  /* updated later */
+  if (external)
+    cur->scope=SCOPE_EXTERNAL;
+  else if (code_range>0)
+    cur->scope=SCOPE_UNIT;
+  else
+    cur->scope=SCOPE_UNKNOWN;
+  /* insert after the predecessor (which is normally the tail of the list); the
+     list is sorted on name after all symbols are collected */
+  assert(pred!=NULL);
+  cur->next=pred->next;
+  pred->next=cur;
+  return cur;
+}
+
+typedef struct tagSYMSORT {
+  DWARF_SYMBOLLIST *sym;
+  unsigned seq;         /* insertion order */
+} SYMSORT;
+
+static int symname_cmp(const void *p1,const void *p2)
+{
+  const SYMSORT *s1=(const SYMSORT*)p1;
+  const SYMSORT *s2=(const SYMSORT*)p2;
+  int result=strcmp(s1->sym->name,s2->sym->name);
+  if (result==0)
+    result=(s1->seq>s2->seq) ? -1 : (s1->seq<s2->seq) ? 1 : 0;  /* most recent first */
+  return result;
+}
+
+/* symname_sort() sorts the symbol list on name (symbols with the same name
+   are in reverse order of insertion) */
+static bool symname_sort(DWARF_SYMBOLLIST *root)
+{
+  DWARF_SYMBOLLIST *cur;
+  unsigned count,idx;
+
+  assert(root!=NULL);
+  count=0;
+  for (cur=root->next; cur!=NULL; cur=cur->next)
+    count++;
+  if (count<2)
+    return true;
+  SYMSORT *list=(SYMSORT*)malloc(count*sizeof(SYMSORT));
+  if (list==NULL)
+    return false;       /* insufficient memory */
+  idx=0;
+  for (cur=root->next; cur!=NULL; cur=cur->next) {
+    list[idx].sym=cur;
+    list[idx].seq=idx;
+    idx++;
+  }
+  qsort(list,count,sizeof(SYMSORT),symname_cmp);
+  cur=root;
+  for (idx=0; idx<count; idx++) {
+    cur->next=list[idx].sym;
+    cur=cur->next;
+  }
+  cur->next=NULL;
+  free(list);
+  return true;
+}
+
+/* The symbol index holds an array with all symbols (in the order of the list),
+   a hash table on the symbol names (with separate chains for each scope), an
+   array with all symbols sorted on name (for prefix look-ups) and an array
+   with all functions and global/static variables, sorted on address.
+   The address array is built right away; the tables on name are built on a
+   background thread, because all names must be demangled for these (and
+   until the thread is done, look-ups on name use a sequential search). */
+#define SYM_NONE      (~0u)
+#define SYM_SCOPES    4   /* SCOPE_UNKNOWN .. SCOPE_FUNCTION */
+
+typedef struct tagSYMINDEX {
+  struct tagSYMINDEX *next;
+  const DWARF_SYMBOLLIST *root;     /* the symbol table that this index belongs to */
+  const DWARF_SYMBOLLIST **symbols; /* all symbols, in the order of the list */
+  unsigned count;                   /* number of entries in "symbols" */
+  unsigned *buckets;                /* heads of the chains, SYM_SCOPES per bucket */
+  unsigned *chain;                  /* next symbol in the same bucket and scope */
+  unsigned numbuckets;              /* always a power of 2 */
+  unsigned *byaddr;                 /* functions, then variables (indices into "symbols"), each sorted on address */
+  unsigned numfunc;                 /* number of functions in "byaddr" */
+  unsigned numaddr;                 /* total number of entries in "byaddr" */
+  unsigned *byname;                 /* all symbols (indices into "symbols"), sorted on name */
+  bool names_ready;                 /* whether "buckets", "chain" and "byname" are valid (protected by sym_lock) */
+  bool thread_active;               /* whether the thread must still be joined */
+  thrd_t thread;
+} SYMINDEX;
+
+static SYMINDEX symindex_root = { NULL };
+static mtx_t sym_lock;              /* for lazy demangling and the index state */
+static once_flag sym_once = ONCE_FLAG_INIT;
+
+static void sym_lockinit(void)
+{
+  mtx_init(&sym_lock,mtx_plain);
+}
+
+/** dwarf_sym_name() returns the (demangled) name of a symbol. Names are kept
+ *  as they appear in the DWARF information, and they are only demangled when
+ *  they are needed.
+ */
+const char *dwarf_sym_name(const DWARF_SYMBOLLIST *sym)
+{
+  const char *name;
+
+  assert(sym!=NULL && sym->name!=NULL);
+  if (sym->name[0]!='_' || sym->name[1]!='Z')
+    return sym->name;   /* not a mangled name */
+  call_once(&sym_once,sym_lockinit);
+  mtx_lock(&sym_lock);
+  if (sym->plain==NULL) {
+    char demangled[256];
+    char *plain=NULL;
+    if (demangle(demangled,sizeof(demangled),sym->name))
+      plain=strdup(demangled);
+    ((DWARF_SYMBOLLIST*)sym)->plain=(plain!=NULL) ? plain : sym->name;
+  }
+  name=sym->plain;
+  mtx_unlock(&sym_lock);
+  return name;
+}
+
+static unsigned symname_hash(const char *name)
+{
+  /* FNV-1a */
+  unsigned hash=2166136261u;
+  assert(name!=NULL);
+  while (*name!='\0') {
+    hash^=(unsigned char)*name++;
+    hash*=16777619u;
+  }
+  return hash;
+}
+
+static unsigned symindex_address(const DWARF_SYMBOLLIST *sym)
+{
+  return DWARF_IS_FUNCTION(sym) ? sym->code_addr : sym->data_addr;
+}
+
+static const DWARF_SYMBOLLIST **symindex_sortbase = NULL; /* used by symindex_cmp_address() */
+
+static int symindex_cmp_address(const void *p1,const void *p2)
+{
+  unsigned i1=*(const unsigned*)p1;
+  unsigned i2=*(const unsigned*)p2;
+  unsigned a1,a2;
+  assert(symindex_sortbase!=NULL);
+  a1=symindex_address(symindex_sortbase[i1]);
+  a2=symindex_address(symindex_sortbase[i2]);
+  if (a1!=a2)
+    return (a1<a2) ? -1 : 1;
+  /* keep the order of the list for symbols at the same address */
+  return (i1<i2) ? -1 : (i1>i2) ? 1 : 0;
+}
+
+typedef struct tagSYMNAME {
+  const char *name;     /* demangled name */
+  unsigned idx;         /* index in the "symbols" array */
+} SYMNAME;
+
+static int symindex_cmp_name(const void *p1,const void *p2)
+{
+  const SYMNAME *s1=(const SYMNAME*)p1;
+  const SYMNAME *s2=(const SYMNAME*)p2;
+  int result;
+  if ((result=strcmp(s1->name,s2->name))!=0)
+    return result;
+  return (s1->idx<s2->idx) ? -1 : (s1->idx>s2->idx) ? 1 : 0;
+}
+
+/* symindex_names() builds the hash table and the sorted array on the names;
+   it runs on a background thread */
+static int symindex_names(void *arg)
+{
+  SYMINDEX *index=(SYMINDEX*)arg;
+  SYMNAME *names;
+  unsigned idx;
+
+  assert(index!=NULL);
+  if ((names=(SYMNAME*)malloc((index->count+1)*sizeof(SYMNAME)))==NULL)
+    return 0;           /* look-ups keep using the sequential search */
+  for (idx=0; idx<index->count; idx++) {
+    names[idx].name=dwarf_sym_name(index->symbols[idx]);
+    names[idx].idx=idx;
+  }
+  for (idx=0; idx<index->numbuckets*SYM_SCOPES; idx++)
+    index->buckets[idx]=SYM_NONE;
+  /* add to the chains in reverse order, so that each chain is in the order of
+     the list */
+  for (idx=index->count; idx>0; idx--) {
+    const DWARF_SYMBOLLIST *sym=index->symbols[idx-1];
+    unsigned bucket=(symname_hash(names[idx-1].name) & (index->numbuckets-1))*SYM_SCOPES+sym->scope;
+    assert(sym->scope>=0 && sym->scope<SYM_SCOPES);
+    index->chain[idx-1]=index->buckets[bucket];
+    index->buckets[bucket]=idx-1;
+  }
+  qsort(names,index->count,sizeof(SYMNAME),symindex_cmp_name);
+  for (idx=0; idx<index->count; idx++)
+    index->byname[idx]=names[idx].idx;
+  free(names);
+
+  mtx_lock(&sym_lock);
+  index->names_ready=true;
+  mtx_unlock(&sym_lock);
+  return 0;
+}
+
+static void symindex_delete(const DWARF_SYMBOLLIST *root)
+{
+  SYMINDEX *pred;
+
+  assert(root!=NULL);
+  for (pred=&symindex_root; pred->next!=NULL && pred->next->root!=root; pred=pred->next)
+    {}
+  if (pred->next!=NULL) {
+    SYMINDEX *index=pred->next;
+    pred->next=index->next;
+    if (index->thread_active)
+      thrd_join(index->thread,NULL);
+    free((void*)index->symbols);
+    free(index->buckets);
+    free(index->chain);
+    free(index->byaddr);
+    free(index->byname);
+    free(index);
+  }
+}
+
+static bool symindex_build(const DWARF_SYMBOLLIST *root)
+{
+  const DWARF_SYMBOLLIST *cur;
+  SYMINDEX *index;
+  unsigned idx;
+
+  assert(root!=NULL);
+  call_once(&sym_once,sym_lockinit);
+  symindex_delete(root);  /* drop any earlier index for this table */
+  if ((index=(SYMINDEX*)malloc(sizeof(SYMINDEX)))==NULL)
+    return false;
+  memset(index,0,sizeof(SYMINDEX));
+  index->root=root;
+  for (cur=root->next; cur!=NULL; cur=cur->next)
+    index->count++;
+  for (index->numbuckets=16; index->numbuckets<index->count; index->numbuckets*=2)
+    {}
+  index->symbols=(const DWARF_SYMBOLLIST**)malloc((index->count+1)*sizeof(DWARF_SYMBOLLIST*));
+  index->byaddr=(unsigned*)malloc((index->count+1)*sizeof(unsigned));
+  index->chain=(unsigned*)malloc((index->count+1)*sizeof(unsigned));
+  index->buckets=(unsigned*)malloc(index->numbuckets*SYM_SCOPES*sizeof(unsigned));
+  index->byname=(unsigned*)malloc((index->count+1)*sizeof(unsigned));
+  if (index->symbols==NULL || index->byaddr==NULL || index->chain==NULL || index->buckets==NULL || index->byname==NULL) {
+    if (index->symbols!=NULL)
+      free((void*)index->symbols);
+    if (index->byaddr!=NULL)
+      free(index->byaddr);
+    if (index->chain!=NULL)
+      free(index->chain);
+    if (index->buckets!=NULL)
+      free(index->buckets);
+    if (index->byname!=NULL)
+      free(index->byname);
+    free(index);
+    return false;       /* insufficient memory */
+  }
+  idx=0;
+  for (cur=root->next; cur!=NULL; cur=cur->next)
+    index->symbols[idx++]=cur;
+  /* functions and variables with a fixed address, in two separate ranges */
+  for (idx=0; idx<index->count; idx++)
+    if (DWARF_IS_FUNCTION(index->symbols[idx]))
+      index->byaddr[index->numfunc++]=idx;
+  index->numaddr=index->numfunc;
+  for (idx=0; idx<index->count; idx++)
+    if (DWARF_IS_VARIABLE(index->symbols[idx]) && index->symbols[idx]->data_addr!=0)
+      index->byaddr[index->numaddr++]=idx;
+  symindex_sortbase=index->symbols;
+  qsort(index->byaddr,index->numfunc,sizeof(unsigned),symindex_cmp_address);
+  qsort(index->byaddr+index->numfunc,index->numaddr-index->numfunc,sizeof(unsigned),symindex_cmp_address);
+  symindex_sortbase=NULL;
+
+  /* the tables on name are built in the background (or right away, if no
+     thread can be created) */
+  if (thrd_create(&index->thread,symindex_names,index)==thrd_success)
+    index->thread_active=true;
+  else
+    symindex_names(index);
+
+  index->next=symindex_root.next;
+  symindex_root.next=index;
+  return true;
+}
+
+/* symindex_lowerbound() returns the position of the first symbol at or above
+   the address, in a range in the "byaddr" array */
+static unsigned symindex_lowerbound(const SYMINDEX *index,unsigned low,unsigned high,unsigned address)
+{
+  while (low<high) {
+    unsigned mid=low+(high-low)/2;
+    if (symindex_address(index->symbols[index->byaddr[mid]])<address)
+      low=mid+1;
+    else
+      high=mid;
+  }
+  return low;
+}
+
+static const SYMINDEX *symindex_find(const DWARF_SYMBOLLIST *root)
+{
+  const SYMINDEX *index;
+
+  assert(root!=NULL);
+  for (index=symindex_root.next; index!=NULL && index->root!=root; index=index->next)
+    {}
+  /* verify that the table was not modified since the index was built */
+  if (index!=NULL && (index->count==0 || root->next!=index->symbols[0]))
+    index=NULL;
+  return index;
+}
+
+/* symindex_find_names() returns the index only if the tables on name are
+   complete */
+static const SYMINDEX *symindex_find_names(const DWARF_SYMBOLLIST *root)
+{
+  const SYMINDEX *index=symindex_find(root);
+  if (index!=NULL) {
+    bool ready;
+    mtx_lock(&sym_lock);
+    ready=index->names_ready;
+    mtx_unlock(&sym_lock);
+    if (!ready)
+      index=NULL;
+  }
+  return index;
+}
+
+static const DWARF_SYMBOLLIST *symindex_lookup(const SYMINDEX *index,const char *name,int scope,
+                                               int fileindex,int lineindex)
+{
+  unsigned pos;
+
+  assert(index!=NULL && index->names_ready);
+  assert(name!=NULL);
+  assert(scope>=0 && scope<SYM_SCOPES);
+  pos=index->buckets[(symname_hash(name) & (index->numbuckets-1))*SYM_SCOPES+scope];
+  while (pos!=SYM_NONE) {
+    const DWARF_SYMBOLLIST *sym=index->symbols[pos];
+    if ((fileindex<0 || sym->fileindex==fileindex)
+        && (lineindex<0 || (sym->line<=lineindex && lineindex<sym->line_limit))
+        && strcmp(dwarf_sym_name(sym),name)==0)
+      return sym;
+    pos=index->chain[pos];
+  }
+  return NULL;
+}
+
+static void symname_deletetable(DWARF_SYMBOLLIST *root)
+{
+  DWARF_SYMBOLLIST *cur,*next;
+
+  assert(root!=NULL);
+  symindex_delete(root);  /* first stop the thread that may still use the list */
+  cur=root->next;
+  while (cur!=NULL) {
+    next=cur->next;
+    assert(cur->name!=NULL);
+    if (cur->plain!=NULL && cur->plain!=cur->name)
+      free(cur->plain);
+    free(cur->name);
+    free(cur);
+    cur=next;
+  } /* while */
+  memset(root,0,sizeof(DWARF_SYMBOLLIST));
+}
+
+
+static char *strins(char *string,const char *sub)
+{
+  int offs=strlen(sub);
+  int len=strlen(string);
+  memmove(string+offs,string,len+1);
+  memmove(string,sub,offs);
+  return string;
+}
+
+/* The debug sections are read into memory in one go, and then decoded from
+   memory. The interface resembles that of stdio, and the positions are file
+   offsets, so that the offsets in the ELF and DWARF headers can be used
+   as is. */
+typedef struct tagMEMSECTION {
+  unsigned long offset; /* offset of the section in the file */
+  unsigned long size;
+  unsigned char *data;
+} MEMSECTION;
+
+typedef struct tagMEMSTREAM {
+  MEMSECTION sections[TABLE_COUNT];
+  const unsigned char *base;  /* start of the current section */
+  const unsigned char *pos;   /* current read position */
+  const unsigned char *end;   /* end of the current section */
+  unsigned long baseoffset;   /* file offset of the current section */
+} MEMSTREAM;
+
+static bool ms_open(MEMSTREAM *ms,FILE *fp,const DWARFTABLE tables[])
+{
+  int idx;
+
+  assert(ms!=NULL);
+  assert(fp!=NULL);
+  assert(tables!=NULL);
+  memset(ms,0,sizeof(MEMSTREAM));
+  for (idx=0; idx<TABLE_COUNT; idx++) {
+    MEMSECTION *section=&ms->sections[idx];
+    if (tables[idx].offset==0 || tables[idx].size==0)
+      continue;
+    section->data=(unsigned char*)malloc(tables[idx].size);
+    if (section->data==NULL)
+      return false;     /* insufficient memory */
+    section->offset=tables[idx].offset;
+    section->size=tables[idx].size;
+    fseek(fp,section->offset,SEEK_SET);
+    if (fread(section->data,1,section->size,fp)!=section->size)
+      return false;     /* section truncated */
+  }
+  return true;
+}
+
+static void ms_close(MEMSTREAM *ms)
+{
+  int idx;
+
+  assert(ms!=NULL);
+  for (idx=0; idx<TABLE_COUNT; idx++)
+    if (ms->sections[idx].data!=NULL)
+      free(ms->sections[idx].data);
+  memset(ms,0,sizeof(MEMSTREAM));
+}
+
+static int ms_seek(MEMSTREAM *ms,unsigned long offset,int origin)
+{
+  int idx,pass;
+
+  assert(ms!=NULL);
+  assert(origin==SEEK_SET); /* only absolute positioning is supported */
+  (void)origin;
+  /* sections may be adjacent, so prefer a section that the offset is inside
+     of, over a section that the offset is just at the end of */
+  for (pass=0; pass<2; pass++) {
+    for (idx=0; idx<TABLE_COUNT; idx++) {
+      const MEMSECTION *section=&ms->sections[idx];
+      if (section->data!=NULL && offset>=section->offset
+          && (offset<section->offset+section->size || (pass==1 && offset==section->offset+section->size)))
+      {
+        ms->base=section->data;
+        ms->pos=section->data+(offset-section->offset);
+        ms->end=section->data+section->size;
+        ms->baseoffset=section->offset;
+        return 0;
+      }
+    }
+  }
+  ms->base=ms->pos=ms->end=NULL;  /* seek outside any loaded section; reads fail */
+  ms->baseoffset=offset;
+  return -1;
+}
+
+static long ms_tell(const MEMSTREAM *ms)
+{
+  assert(ms!=NULL);
+  return (long)(ms->baseoffset+(ms->pos-ms->base));
+}
+
+static inline int ms_getc(MEMSTREAM *ms)
+{
+  return (ms->pos<ms->end) ? *ms->pos++ : EOF;
+}
+
+static size_t ms_read(void *buffer,size_t size,size_t count,MEMSTREAM *ms)
+{
+  size_t avail,total;
+
+  assert(buffer!=NULL);
+  assert(ms!=NULL);
+  if (size==0)
+    return 0;
+  avail=(size_t)(ms->end-ms->pos);
+  total=size*count;
+  if (total>avail) {
+    count=avail/size;   /* only return complete items, like fread() */
+    total=count*size;
+  }
+  if (total>0) {
+    memcpy(buffer,ms->pos,total);
+    ms->pos+=total;
+  }
+  return count;
+}
+
+static long read_leb128(MEMSTREAM *ms,int sign,int *size)
+{
+  long value=0;
+  int shift=0;
+  int byte;
+
+  if (size!=NULL)
+    *size=0;
+  while ((byte=ms_getc(ms))!=EOF) {
+    if (size!=NULL)
+      *size+=1;
+    value |= (long)(byte & 0x7f) << shift;
+    shift+=7;
+    if ((byte & 0x80)==0)
+      break;  /* no continuation, so done */
+  }
+  /* sign-extend; since bit 7 in the last byte read is the continuation bit,
+     bit 6 is the sign bit */
+  if (sign && (byte & 0x40)!=0 && shift < (sizeof(long)*8))
+    value |= ~0u << shift;
+
+  return value;
+}
+
+/* read_value() reads numeric data in various formats. It does not read address
+   data or other fields where the data size depends on the bit size of the ELF
+   file rather than on the format of the field. */
+static int64_t read_value(MEMSTREAM *ms,int format,int *size)
+{
+  int64_t value=0;
+  int sz=0;
+
+  switch (format) {
+  case DW_FORM_flag_present:      /* implicit "present" flag (no data) */
+    value=1;
+    sz=0;
+    break;
+  case DW_FORM_data1:             /* constant, 1 byte */
+  case DW_FORM_ref1:              /* reference, 1 bytes */
+  case DW_FORM_flag:              /* flag, 1 byte (0=false, any non-zero=true) */
+    ms_read(&value,1,1,ms);
+    sz=1;
+    break;
+  case DW_FORM_data2:             /* constant, 2 bytes */
+  case DW_FORM_ref2:              /* reference, 2 bytes */
+    ms_read(&value,2,1,ms);
+    sz=2;
+    break;
+  case DW_FORM_data4:             /* constant, 4 bytes */
+  case DW_FORM_ref4:              /* reference, 4 bytes */
+    ms_read(&value,4,1,ms);
+    sz=4;
+    break;
+  case DW_FORM_data8:             /* constant, 8 bytes */
+  case DW_FORM_ref8:              /* reference, 8 bytes */
+  case DW_FORM_ref_sig8:          /* type signature, 8 bytes */
+    ms_read(&value,8,1,ms);
+    sz=8;
+    break;
+  case DW_FORM_data16:            /* constant, 16 bytes */
+    ms_read(&value,8,1,ms);
+    ms_read(&value,8,1,ms);
+    sz=16;
+    break;
+  case DW_FORM_ref_sup4:          /* reference relative to .debug_info of a supplementaty object file, 4 bytes */
+    ms_read(&value,4,1,ms);
+    sz=4;
+    break;
+  case DW_FORM_ref_sup8:          /* reference relative to .debug_info of a supplementaty object file, 8 bytes */
+    ms_read(&value,8,1,ms);
+    sz=8;
+    break;
+  case DW_FORM_sdata:             /* constant, signed LEB128 */
+    value=read_leb128(ms,1,&sz);
+    break;
+  case DW_FORM_udata:             /* constant, unsigned LEB128 */
+  case DW_FORM_ref_udata:         /* reference, unsigned LEB128 */
+    value=read_leb128(ms,0,&sz);
+    break;
+  case DW_FORM_exprloc: {         /* block, unsigned LEB128-encoded length + data bytes */
+    int datasz=(int)read_leb128(ms,0,&sz);
+    int opc=0;
+    sz+=datasz;
+    if (datasz>=1) {
+      ms_read(&opc,1,1,ms);
+      datasz-=1;
+    }
+    if (opc==DW_OP_addr && datasz>0 && datasz<=sizeof value) {
+      ms_read(&value,datasz,1,ms);
+    } else {
+      /* register/stack-relative location expressions are currently not supported */
+      while (datasz-->0)
+        ms_getc(ms);
+    }
+    break;
+  } /* DW_FORM_exprloc */
+  default:
+    assert(0);
+  }
+  if (size!=NULL)
+    *size=sz;
+  return value;
+}
+
+static void read_string(MEMSTREAM *ms,int format,int stringtable,char *string,int max,int *size)
+{
+  int sz=0;
+  int idx,count,byte;
+  int32_t offs;
+  long pos;
+
+  assert(ms!=NULL);
+  assert(string!=NULL);
+  assert(max>0);
+
+  idx=0;
+  switch (format) {
+  case DW_FORM_string:            /* string, zero-terminated */
+    while ((byte=ms_getc(ms))!=EOF) {
+      if (idx<max)
+        string[idx]=(char)byte;
+      idx++;
+      if (byte==0)
+        break;
+    }
+    sz=idx;
+    break;
+  case DW_FORM_strp:              /* string, 4-byte offset into the .debug_str section */
+  case DW_FORM_strp_sup:          /* string, 4-byte offset into the .debug_str section of a supplementary object file */
+  case DW_FORM_line_strp:         /* string, 4-byte offset into the .debug_line_str section */
+    ms_read(&offs,4,1,ms);
+    sz=4;
+    /* look up the string */
+    assert(stringtable!=0);
+    pos=ms_tell(ms);
+    ms_seek(ms,stringtable+offs,SEEK_SET);
+    while ((byte=ms_getc(ms))!=EOF) {
+      if (idx<max)
+        string[idx]=(char)byte;
+      idx++;
+      if (byte==0)
+        break;
+    }
+    ms_seek(ms,pos,SEEK_SET);
+    break;
+  case DW_FORM_block:             /* block, unsigned LEB128-encoded length + data bytes */
+  case DW_FORM_block1:            /* block, 1-byte length + up to 255 data bytes */
+  case DW_FORM_block2:            /* block, 2-byte length + up to 64K data bytes */
+  case DW_FORM_block4:            /* block, 4-byte length + up to 4G data bytes */
+    count=0;
+    switch (format) {
+    case DW_FORM_block:
+      count=read_leb128(ms,0,&sz);
+      break;
+    case DW_FORM_block1:
+      ms_read(&count,1,1,ms);
+      sz=1;
+      break;
+    case DW_FORM_block2:
+      ms_read(&count,2,1,ms);
+      sz=2;
+      break;
+    case DW_FORM_block4:
+      ms_read(&count,4,1,ms);
+      sz=4;
+      break;
+    }
+    sz+=count;
+    while (idx<count && (byte=ms_getc(ms))!=EOF) {
+      if (idx<max)
+        string[idx]=(char)byte;
+      idx++;
+    }
+    break;
+  default:
+    assert(0);
+  }
+  string[max-1]='\0'; /* force the string to be zero-terminated */
+  if (size!=NULL)
+    *size=sz;
+}
+
+static void dwarf_abbrev(MEMSTREAM *ms,const DWARFTABLE tables[],ABBREVTABLE *abbrevlist)
+{
+# define MAX_ATTRIBUTES  50  /* max. number of attributes for a single tag */
+  int unit,tag,attrib,format;
+  int size,count;
+  unsigned char flag;
+  unsigned long tablesize;
+  ATTRIBUTE attributes[MAX_ATTRIBUTES];
+
+  assert(ms!=NULL);
+  assert(tables!=NULL);
+  assert(abbrevlist!=NULL);
+  assert(abbrevlist->root.next==NULL); /* abbrevlist should be empty */
+
+  ms_seek(ms,tables[TABLE_ABBREV].offset,SEEK_SET);
+  tablesize=tables[TABLE_ABBREV].size;
+  assert(tablesize>0); /* debug information should have been found */
+
+  unit=0;
+  while (tablesize > 0) {
+    /* get and check the abbreviation id (a sequence number relative to its unit) */
+    int idx=(int)read_leb128(ms,0,&size);
+    tablesize-=size;
+    if (idx==0) {
+      unit+=1;  /* an id that is zero, indicates the end of a unit */
+      continue;
+    }
+    /* get the tag and the "has-children" flag */
+    tag=(int)read_leb128(ms,0,&size);
+    tablesize-=size;
+    ms_read(&flag,1,1,ms);
+    tablesize-=1;
+    /* get the list of attributes */
+    count=0;
+    for ( ;; ) {
+      long value=0;
+      attrib=(int)read_leb128(ms,0,&size);
+      tablesize-=size;
+      format=(int)read_leb128(ms,0,&size);
+      tablesize-=size;
+      if (attrib==0 && format==0)
+        break;
+      if (format==DW_FORM_implicit_const) {
+        value=read_leb128(ms,0,&size);
+        tablesize-=size;
+      }
+      assert(count<MAX_ATTRIBUTES);
+      attributes[count].tag=attrib;
+      attributes[count].format=format;
+      attributes[count].value=value;
+      count++;
+    }
+    /* store the abbreviation */
+    abbrev_insert(abbrevlist,unit,idx,tag,flag,count,attributes);
+  }
+  /* build the index on unit & id (lookups fall back to a sequential search
+     if this fails) */
+  abbrev_buildindex(abbrevlist);
+}
+
+static int read_unitheader(MEMSTREAM *ms,UNIT_HDR32 *header,int *size)
+{
+  long mark;
+
+  assert(ms!=NULL);
+  assert(header!=NULL);
+  assert(size!=NULL);
+  mark=ms_tell(ms); /* may need to "un-read" */
+  if (ms_read(header,sizeof(UNIT_HDR32),1,ms)==0)
+    return 0;     /* read failed */
+  assert(header->unit_length!=0xffffffff);  /* otherwise, should read 64-bit header */
+  //??? on big_endian, swap version field before testing it
+  if (header->version>=5) {
+    *size=sizeof(UNIT_HDR32);
+  } else {
+    /* un-read v5 structure, then read & copy the v2..v4 structure
+        uint32_t unit_length;    total length of this block, excluding this field
+        uint16_t version;        DWARF version, up to version 4
+        uint32_t abbrev_offs;    offset into the .debug_abbrev table
+        uint8_t  address_size;   size in bytes of an address
+     */
+#   define HDRSIZE 11
+    unsigned char hdr[HDRSIZE];
+    ms_seek(ms,mark,SEEK_SET);
+    ms_read(&hdr,1,HDRSIZE,ms);
+    memcpy(&header->unit_length,hdr+0,4); /* redundant, identical to v5 */
+    memcpy(&header->version,hdr+4,2);     /* redundant, identical to v5 */
+    memcpy(&header->abbrev_offs,hdr+6,4);
+    memcpy(&header->address_size,hdr+10,1);
+    header->unit_type=DW_UT_compile;
+    *size=HDRSIZE;
+#   undef HDRSIZE
+  }
+  //??? on big_endian, swap fields
+  return 1;
+}
+
+static int read_prologue(MEMSTREAM *ms,DWARF_PROLOGUE32 *prologue,int *size)
+{
+  long mark;
+
+  assert(ms!=NULL);
+  assert(prologue!=NULL);
+  assert(size!=NULL);
+  mark=ms_tell(ms); /* may need to "un-read" */
+  if (ms_read(prologue,sizeof(DWARF_PROLOGUE32),1,ms)==0)
+    return 0;     /* read failed */
+  assert(prologue->total_length!=0xffffffff);  /* otherwise, should read 64-bit prologue */
+  //??? on big_endian, swap version field before testing it
+  if (prologue->version>=5) {
+    *size=sizeof(DWARF_PROLOGUE32);
+  } else if (prologue->version==2 || prologue->version==3) {
+    /* un-read v5 structure, then read & copy the v2/3 structure
+        uint32_t total_length;     length of the line number table, minus the 4 bytes for this total_length field
+        uint16_t version;          this prologue is for versions 2 & 3
+        uint32_t prologue_length;  offset to the first opcode of the line number program (relative to this prologue_length field)
+        uint8_t  min_instruction_size;
+        uint8_t  default_is_stmt;  default value to initialize the state machine with
+        int8_t   line_base;
+        uint8_t  line_range;
+        uint8_t  opcode_base;      number of the first special opcode
+        standard opcode lengths (array of length "opcode_base" - 1)
+        include directories, a sequence of zero-terminated strings (and the
+           sequence itself ends with a zero-byte)
+        file names: base name, location, modification date, size
+     */
+#   define HDRSIZE 15
+    unsigned char hdr[HDRSIZE];
+    ms_seek(ms,mark,SEEK_SET);
+    ms_read(&hdr,1,HDRSIZE,ms);
+    memcpy(&prologue->total_length,hdr+0,4);  /* redundant, identical to v5 */
+    memcpy(&prologue->version,hdr+4,2);       /* redundant, identical to v5 */
+    memcpy(&prologue->prologue_length,hdr+6,4);
+    memcpy(&prologue->min_instruction_size,hdr+10,1);
+    memcpy(&prologue->default_is_stmt,hdr+11,1);
+    memcpy(&prologue->line_base,hdr+12,1);
+    memcpy(&prologue->line_range,hdr+13,1);
+    memcpy(&prologue->opcode_base,hdr+14,1);
+    prologue->address_size=4; /* assume 32-bit, 64-bit not yet supported */
+    prologue->segment_sel_size=0;
+    prologue->max_oper_per_instruction=1;
+    *size=HDRSIZE;
+#   undef HDRSIZE
+  } else if (prologue->version==4) {
+    /* un-read v5 structure, then read & copy the v4 structure
+        uint32_t total_length;     length of the line number table, minus the 4 bytes for this total_length field
+        uint16_t version;          this prologue is for versions 2 & 3
+        uint32_t prologue_length;  offset to the first opcode of the line number program (relative to this prologue_length field)
+        uint8_t  min_instruction_size;
+        uint8_t  max_oper_per_instruction;
+        uint8_t  default_is_stmt;  default value to initialize the state machine with
+        int8_t   line_base;
+        uint8_t  line_range;
+        uint8_t  opcode_base;      number of the first special opcode
+        standard opcode lengths (array of length "opcode_base" - 1)
+        include directories, a sequence of zero-terminated strings (and the
+           sequence itself ends with a zero-byte)
+        file names: base name, location, modification date, size
+     */
+#   define HDRSIZE 16
+    unsigned char hdr[HDRSIZE];
+    ms_seek(ms,mark,SEEK_SET);
+    ms_read(&hdr,sizeof(hdr),1,ms);
+    memcpy(&prologue->total_length,hdr+0,4);  /* redundant, identical to v5 */
+    memcpy(&prologue->version,hdr+4,2);       /* redundant, identical to v5 */
+    memcpy(&prologue->prologue_length,hdr+6,4);
+    memcpy(&prologue->min_instruction_size,hdr+10,1);
+    memcpy(&prologue->max_oper_per_instruction,hdr+11,1);
+    memcpy(&prologue->default_is_stmt,hdr+12,1);
+    memcpy(&prologue->line_base,hdr+13,1);
+    memcpy(&prologue->line_range,hdr+14,1);
+    memcpy(&prologue->opcode_base,hdr+15,1);
+    prologue->address_size=4; /* assume 32-bit, 64-bit not yet supported */
+    prologue->segment_sel_size=0;
+    *size=HDRSIZE;
+#   undef HDRSIZE
+  } else {
+    assert(0);  /* DWARF 1 is not supported */
+    return 0;
+  }
+  //??? on big_endian, swap fields
+  return 1;
+}
+
+static void clear_state(STATE *state,int default_is_stmt)
+{
+  /* set default state (see DWARF documentation, DWARF 2.0 pp. 52 / DWARF 3.0 pp. 94) */
+  state->address=0;
+  state->op_index=0;
+  state->file=1;
+  state->line=1;
+  state->column=0;
+  state->is_stmt=default_is_stmt;
+  state->basic_block=0;
+  state->end_seq=0;
+  state->prologue_end=0;
+  state->epiloge_begin=0;
+  state->isa=0;
+  state->discriminator=0;
+}
+
+typedef struct tagLINEUNIT {
+  unsigned long offset;       /* file offset of the line program */
+  uint32_t size;              /* size of the raw data of the unit (fingerprint) */
+  uint32_t crc;               /* CRC32 of the raw data of the unit (fingerprint) */
+  DWARF_PATHLIST file_list;   /* files, as indexed by the line program */
+  LINEVECTOR line_list;       /* lines, with indices in the local file list */
+  bool result;
+  bool reused;                /* taken from the unit cache, not parsed */
+} LINEUNIT;
+
+typedef struct tagINFOUNIT {
+  unsigned long offset;       /* file offset of the unit header */
+  uint32_t size;              /* size of the raw data of the unit (fingerprint) */
+  uint32_t crc;               /* CRC32 of the raw data of the unit (fingerprint) */
+  DWARF_SYMBOLLIST symbols;   /* symbols in this unit, in order of appearance, with indices in the local file list */
+  int address_size;
+  bool result;
+  bool reused;                /* taken from the unit cache, not parsed */
+} INFOUNIT;
+
+/* line_program() runs the state machine for a single line program (of a
+   single compilation unit). The file indices in the line table are relative
+   to the local file table of the unit. */
+static bool line_program(MEMSTREAM *ms,unsigned long offset,LINEUNIT *result)
+{
+  DWARF_PROLOGUE32 prologue;
+  STATE state;
+  int dirpos,opcode,lebsize,prologue_size;
+  int idx;
+  long value;
+  char path[_MAX_PATH];
+  DWARF_PATHLIST include_list = { NULL };
+  uint8_t *std_argcnt;  /* array with argument counts for standard opcodes */
+  long count;
+  int byte;
+
+  assert(ms!=NULL);
+  assert(result!=NULL);
+  ms_seek(ms,offset,SEEK_SET);
+  /* check the prologue */
+  read_prologue(ms,&prologue,&prologue_size);
+  /* read the argument counts for the standard opcodes */
+  std_argcnt=(uint8_t*)malloc(prologue.opcode_base-1*sizeof(uint8_t));
+  if (std_argcnt==NULL)
+    return false;
+  ms_read(std_argcnt,1,prologue.opcode_base-1,ms);
+  assert(prologue.version<5); //??? for DWARF 5+, the format for the include-paths and filenames tables is different
+  /* read the include-paths table */
+  while ((byte=ms_getc(ms))!=EOF && byte!='\0') {
+    for (idx=0; byte!=EOF && byte!='\0'; idx++) {
+      path[idx]=(char)byte;
+      byte=ms_getc(ms);
+    }
+    path[idx]='\0';
+    path_insert(&include_list,path);
+  }
+  /* read the filenames table */
+  while ((byte=ms_getc(ms))!=EOF && byte!='\0') {
+    for (idx=0; byte!=EOF && byte!='\0'; idx++) {
+      path[idx]=(char)byte;
+      byte=ms_getc(ms);
+    }
+    path[idx]='\0';
+    dirpos=read_leb128(ms,0,NULL);  /* read directory index */
+    read_leb128(ms,0,NULL);         /* skip modification time (GCC sets this to 0) */
+    read_leb128(ms,0,NULL);         /* skip source file size (GCC sets this to 0) */
+    if (dirpos>0 && strpbrk(path,"\\/")==NULL) {
+      char *dir=path_get(&include_list,dirpos-1);
+      strins(path,"/");
+      strins(path,dir);
+    }
+    path_insert(&result->file_list,path);
+  }
+
+  /* jump to the start of the program, then start running */
+  clear_state(&state,prologue.default_is_stmt);
+  ms_seek(ms,offset+prologue.prologue_length+10,SEEK_SET);  /* +10 because the offset is relative to the field position */
+  count=prologue.total_length-prologue.prologue_length-6;
+  while (count>0) {
+    opcode=ms_getc(ms);
+    count--;
+    if (opcode==EOF)
+      break;
+    if (opcode<prologue.opcode_base) {
+      /* standard (or extended) opcode */
+      switch (opcode) {
+      case DW_LNS_extended_op:
+        value=read_leb128(ms,0,&lebsize);
+        count-=lebsize+value;
+        opcode=ms_getc(ms);
+        switch (opcode) {
+        case DW_LNE_end_sequence:
+          state.end_seq=1;
+          line_append(&result->line_list,state.line,state.address,state.file-1);
+          clear_state(&state,prologue.default_is_stmt);  /* reset to default values */
+          break;
+        case DW_LNE_set_address:
+          value=ms_getc(ms);
+          value|=(long)ms_getc(ms) << 8;
+          value|=(long)ms_getc(ms) << 16;
+          value|=(long)ms_getc(ms) << 24;
+          state.address=value;
+          break;
+        case DW_LNE_define_file:
+          for (idx=0; (byte=ms_getc(ms))!=EOF && byte!='\0'; idx++) {
+            path[idx]=(char)byte;
+            byte=ms_getc(ms);
+          }
+          path[idx]='\0';
+          dirpos=read_leb128(ms,0,NULL);  /* read directory index */
+          read_leb128(ms,0,NULL);         /* skip modification time (GCC sets this to 0) */
+          read_leb128(ms,0,NULL);         /* skip source file size (GCC sets this to 0) */
+          if (dirpos>0 && strpbrk(path,"\\/")==NULL) {
+            char *dir=path_get(&include_list,dirpos-1);
+            strins(path,"/");
+            strins(path,dir);
+          }
+          path_insert(&result->file_list,path);
+          break;
+        case DW_LNE_set_discriminator:
+          state.discriminator=read_leb128(ms,0,NULL);
+          break;
+        default:
+          while (value-->0) /* skip any unrecognized extended opcode */
+            ms_getc(ms);
+        }
+        break;
+      case DW_LNS_copy:
+        line_append(&result->line_list,state.line,state.address,state.file-1);
+        state.basic_block=0;
+        break;
+      case DW_LNS_advance_pc:
+        value=read_leb128(ms,0,&lebsize);
+        count-=lebsize;
+        state.address+=value*prologue.min_instruction_size;
+        break;
+      case DW_LNS_advance_line:
+        value=read_leb128(ms,1,&lebsize);
+        count-=lebsize;
+        state.line+=value;
+        break;
+      case DW_LNS_set_file:
+        value=read_leb128(ms,0,&lebsize);
+        count-=lebsize;
+        state.file=value;
+        break;
+      case DW_LNS_set_column:
+        value=read_leb128(ms,0,&lebsize);
+        count-=lebsize;
+        state.column=value;
+        break;
+      case DW_LNS_negate_stmt:
+        state.is_stmt=!state.is_stmt;
+        break;
+      case DW_LNS_set_basic_block:
+        state.basic_block=1;
+        break;
+      case DW_LNS_const_add_pc:
+        state.address+=((255-prologue.opcode_base)/prologue.line_range)*prologue.min_instruction_size;
+        break;
+      case DW_LNS_fixed_advance_pc:
+        value=ms_getc(ms);
+        value|=ms_getc(ms) << 8;
+        state.address+=value;
+        count-=2;
+        break;
+      case DW_LNS_set_prologue_end:
+        state.prologue_end=1;
+        break;
+      case DW_LNS_set_epilogue_begin:
+        state.epiloge_begin=1;
+        break;
+      case DW_LNS_set_isa:
+        value=read_leb128(ms,0,&lebsize);
+        count-=lebsize;
+        state.isa=value;
+        break;
+      default:
+        /* skip opcode and any parameters */
+        for (idx=0; idx<std_argcnt[opcode-1]; idx++) {
+          read_leb128(ms,0,&lebsize);
+          count-=lebsize;
+        }
+      }
+    } else {
+      /* special opcode */
+      opcode-=prologue.opcode_base;
+      assert(prologue.max_oper_per_instruction==1); /* for VLIW architecture, the calculation below must be adjusted */
+      state.address+=(opcode/prologue.line_range)*prologue.min_instruction_size;
+      state.line+=prologue.line_base+opcode%prologue.line_range;
+      line_append(&result->line_list,state.line,state.address,state.file-1);
+      state.basic_block=0;
+      state.prologue_end=0;
+      state.epiloge_begin=0;
+      state.discriminator=0;
+    }
+  }
+
+  path_deletetable(&include_list);
+  free(std_argcnt);
+  return true;
+}
+
+/* info_unit() collects the functions and variables in a single compilation
+   unit of the .debug_info table */
+static bool info_unit(MEMSTREAM *ms,const DWARFTABLE tables[],int unit,
+                      const ABBREVTABLE *abbrev_root,INFOUNIT *result)
+{
+  UNIT_HDR32 header;
+  const ABBREVLIST *abbrev;
+  int idx,size;
+  char name[256],str[256];
+  int64_t value;
+  int file=-1,line=0;
+  unsigned long unitsize;
+  uint32_t code_addr=0, code_addr_end=0;
+  uint32_t data_addr=0;
+  int external=0;
+  int declaration=0;
+  int level=0;
+  int hdrsize;
+  DWARF_SYMBOLLIST *symtail=&result->symbols;
+
+  assert(ms!=NULL);
+  assert(tables!=NULL);
+  assert(abbrev_root!=NULL);
+  assert(result!=NULL);
+  ms_seek(ms,result->offset,SEEK_SET);
+  read_unitheader(ms,&header,&hdrsize);
+  unitsize=header.unit_length-(hdrsize-4);
+  assert(unitsize<0xfffffff0);  /* if larger, should read the 64-bit version of the structure */
+  result->address_size=header.address_size;
+  name[0]='\0';
+  level=0;
+  /* browse through the tags */
+  while (unitsize>0) {
+    /* read the abbreviation code */
+    idx=(int)read_leb128(ms,0,&size);
+    unitsize-=size;
+    if (idx==0) {
+      level-=1;
+      continue;
+    }
+    abbrev=abbrev_find(abbrev_root,unit,idx);
+    assert(abbrev!=NULL);
+    /* run through the attributes */
+    for (idx=0; idx<abbrev->count; idx++) {
+      int format=abbrev->attributes[idx].format;
+      if (format==DW_FORM_indirect) {
+        /* format is specified in the .debug_info data (not in the abbreviation) */
+        format=read_leb128(ms,1,&size);
+        unitsize-=size;
+      }
+      switch (format) {
+      case DW_FORM_data1:             /* constant, 1 byte */
+      case DW_FORM_data2:             /* constant, 2 bytes */
+      case DW_FORM_data4:             /* constant, 4 bytes */
+      case DW_FORM_data8:             /* constant, 8 bytes */
+      case DW_FORM_sdata:             /* constant, signed LEB128 */
+      case DW_FORM_udata:             /* constant, unsigned LEB128 */
+      case DW_FORM_ref1:              /* reference, 1 bytes */
+      case DW_FORM_ref2:              /* reference, 2 bytes */
+      case DW_FORM_ref4:              /* reference, 4 bytes */
+      case DW_FORM_ref8:              /* reference, 8 bytes */
+      case DW_FORM_ref_udata:         /* reference, unsigned LEB128 */
+      case DW_FORM_flag:              /* flag, 1 byte (0=false, any non-zero=true) */
+      case DW_FORM_flag_present:      /* flag, no data */
+      case DW_FORM_ref_sig8:          /* type signature, 8 bytes */
+      case DW_FORM_exprloc:           /* block, unsigned LEB128-encoded length + data bytes */
+      case DW_FORM_ref_sup4:
+      case DW_FORM_ref_sup8:
+        value=read_value(ms,abbrev->attributes[idx].format,&size);
+        break;
+      case DW_FORM_addr:              /* address, 4 bytes for 32-bit, 8 bytes for 64-bit */
+      case DW_FORM_ref_addr:          /* reference, address size (4 bytes on 32-bit, 8 bytes on 64-bit) */
+      case DW_FORM_sec_offset:        /* offset to line number data (4 bytes on 32-bit, 8 bytes on 64-bit) */
+        value=0;
+        ms_read(&value,1,header.address_size,ms);
+        size=header.address_size;
+        break;
+      case DW_FORM_string:            /* string, zero-terminated */
+      case DW_FORM_strp:              /* string, 4-byte offset into the .debug_str section */
+      case DW_FORM_strp_sup:
+      case DW_FORM_block:             /* block, unsigned LEB128-encoded length + data bytes */
+      case DW_FORM_block1:            /* block, 1-byte length + up to 255 data bytes */
+      case DW_FORM_block2:            /* block, 2-byte length + up to 64K data bytes */
+      case DW_FORM_block4:            /* block, 4-byte length + up to 4G data bytes */
+        read_string(ms,abbrev->attributes[idx].format,tables[TABLE_STR].offset,str,sizeof(str),&size);
+        break;
+      case DW_FORM_line_strp:
+        read_string(ms,abbrev->attributes[idx].format,tables[TABLE_LINE_STR].offset,str,sizeof(str),&size);
+        break;
+      case DW_FORM_implicit_const:
+        value=abbrev->attributes[idx].value;
+        size=0;
+        break;
+      default:
+        assert(0);
+      }
+      unitsize-=size;
+      if (abbrev->tag==DW_TAG_subprogram || abbrev->tag==DW_TAG_variable || abbrev->tag==DW_TAG_formal_parameter) {
+        //??? also handle DW_TAG_lexical_block for the scope of local variables
+        /* store selected fields */
+        switch (abbrev->attributes[idx].tag) {
+        case DW_AT_name:
+          strcpy(name,str);
+          break;
+        case DW_AT_low_pc:
+          if (abbrev->tag==DW_TAG_subprogram)
+            code_addr=(uint32_t)value;
+          break;
+        case DW_AT_high_pc:
+          if (abbrev->tag==DW_TAG_subprogram) {
+            code_addr_end=(uint32_t)value;
+            /* depending on the format, the "high pc" value is an offset
+               instead of an address */
+            if (abbrev->attributes[idx].format!=DW_FORM_addr)
+              code_addr_end+=code_addr;
+          }
+          break;
+        case DW_AT_decl_file:
+          file=(int)value-1;  /* index in the local file list */
+          break;
+        case DW_AT_decl_line:
+          line=(int)value;
+          break;
+        case DW_AT_location:
+          if (abbrev->tag==DW_TAG_variable)
+            data_addr=(uint32_t)value;  /* global / static variable */
+          break;
+        case DW_AT_external:
+          if (abbrev->tag==DW_TAG_variable)
+            external=(int)value;
+          break;
+        case DW_AT_declaration:
+          declaration=(int)value;
+          break;
+        }
+      }
+    } /* for (idx<abbrev->count) */
+    if ((abbrev->tag==DW_TAG_subprogram && code_addr_end>code_addr)
+        || (abbrev->tag==DW_TAG_variable && data_addr!=0))
+      declaration=0;
+    if ((abbrev->tag==DW_TAG_subprogram || abbrev->tag==DW_TAG_variable || abbrev->tag==DW_TAG_formal_parameter)
+        && !declaration) {
+      /* inlined functions are added as if they have address 0; when inline
+         functions get instantiated, these are added as "references" to
+         functions; these are not handled */
+      assert(code_addr_end>=code_addr);
+      if (name[0]!='\0' && file>=0) {
+        DWARF_SYMBOLLIST *item=symname_insert(symtail,name,code_addr,code_addr_end-code_addr,
+                                              data_addr,file,line,external);
+        if (item!=NULL)
+          symtail=item;
+      }
+      name[0]='\0';
+      code_addr=code_addr_end=0;
+      data_addr=0;
+      external=0;
+      declaration=0;
+      file=-1;
+    }
+    if (abbrev->has_children)
+      level+=1;
+  }
+  return true;
+}
+
+/* Compilation units are parsed by a pool of threads. Each thread picks the
+   next unit from a shared counter, so that the load is balanced even if the
+   units vary a lot in size. The results are stored per unit, and merged by
+   the main thread, in the order of the units. */
+#if !defined DWARF_THREADS
+# define DWARF_THREADS  4   /* set to 1 to parse all units in the main thread */
+#endif
+
+typedef struct tagWORKQUEUE {
+  mtx_t lock;
+  int next;           /* next unit to process */
+  int count;          /* total number of units */
+  const MEMSTREAM *ms;/* memory stream to copy (each thread has its own read position) */
+  const DWARFTABLE *tables;
+  const ABBREVTABLE *abbrev_root;
+  LINEUNIT *lineunits;
+  INFOUNIT *infounits;
+} WORKQUEUE;
+
+static int dwarf_worker(void *arg)
+{
+  WORKQUEUE *queue=(WORKQUEUE*)arg;
+  MEMSTREAM ms;
+  int unit;
+
+  assert(queue!=NULL);
+  ms=*queue->ms;      /* shares the section data, but not the read position */
+  for ( ;; ) {
+    mtx_lock(&queue->lock);
+    unit=queue->next++;
+    mtx_unlock(&queue->lock);
+    if (unit>=queue->count)
+      break;
+    if (queue->lineunits!=NULL) {
+      LINEUNIT *lu=&queue->lineunits[unit];
+      if (!lu->reused)
+        lu->result=line_program(&ms,lu->offset,lu);
+    } else {
+      INFOUNIT *iu=&queue->infounits[unit];
+      assert(queue->infounits!=NULL);
+      if (!iu->reused)
+        iu->result=info_unit(&ms,queue->tables,unit,queue->abbrev_root,iu);
+    }
+  }
+  return 0;
+}
+
+/* dwarf_runqueue() processes all units in the queue, using DWARF_THREADS
+   threads (including the calling thread) */
+static void dwarf_runqueue(WORKQUEUE *queue)
+{
+  thrd_t threads[DWARF_THREADS];
+  int idx,numthreads;
+
+  assert(queue!=NULL);
+  queue->next=0;
+  mtx_init(&queue->lock,mtx_plain);
+  numthreads=0;
+  for (idx=1; idx<DWARF_THREADS && idx<queue->count; idx++)
+    if (thrd_create(&threads[numthreads],dwarf_worker,queue)==thrd_success)
+      numthreads++;
+  dwarf_worker(queue);  /* the calling thread participates too */
+  for (idx=0; idx<numthreads; idx++)
+    thrd_join(threads[idx],NULL);
+  mtx_destroy(&queue->lock);
+}
+
+/* dwarf_unitoffsets() walks over the unit headers in a table (.debug_line or
+   .debug_info), and returns an array with the file offsets of each unit. The
+   element size of the array is passed in, because the offset is the first
+   field of LINEUNIT and INFOUNIT. */
+static void *dwarf_unitoffsets(MEMSTREAM *ms,const DWARFTABLE *table,size_t itemsize,int *count)
+{
+  unsigned long offset,end;
+  unsigned char *list=NULL;
+  int size=0;
+
+  assert(ms!=NULL);
+  assert(table!=NULL);
+  assert(itemsize>=sizeof(unsigned long));
+  assert(count!=NULL);
+  *count=0;
+  offset=table->offset;
+  end=table->offset+table->size;
+  while (offset+sizeof(uint32_t)<end) {
+    uint32_t length;
+    ms_seek(ms,offset,SEEK_SET);
+    if (ms_read(&length,sizeof length,1,ms)==0 || length==0 || length>=0xfffffff0)
+      break;            /* 64-bit DWARF is not supported */
+    if (*count>=size) {
+      int newsize=(size==0) ? 64 : 2*size;
+      unsigned char *newlist=(unsigned char*)realloc(list,newsize*itemsize);
+      if (newlist==NULL)
+        break;
+      list=newlist;
+      size=newsize;
+    }
+    memset(list+*count*itemsize,0,itemsize);
+    *(unsigned long*)(list+*count*itemsize)=offset;
+    *count+=1;
+    offset+=length+sizeof(uint32_t);
+  }
+  return list;
+}
+
+/* The per-unit results of the most recent dwarf_read() are kept, so that a
+   reload of a rebuilt ELF file only needs to parse the units that changed. A
+   unit is matched on the size and the CRC of its raw data in .debug_line or
+   .debug_info. That data holds the code addresses and the offsets into the
+   string tables, so a matching unit is valid as is (no relocation needed);
+   units that moved in memory are parsed again. The file indices in the cached
+   results are local to the unit, because the global file table is rebuilt on
+   every load. */
+static struct {
+  LINEUNIT *lineunits;
+  int numlineunits;
+  INFOUNIT *infounits;
+  int numinfounits;
+} unitcache = { NULL, 0, NULL, 0 };
+
+/* unit_fingerprint() calculates the CRC32 over the raw data of the unit at the
+   offset (including the unit header), and returns the size of the data */
+static uint32_t unit_fingerprint(MEMSTREAM *ms,unsigned long offset,uint32_t *crc)
+{
+  uint32_t length;
+
+  assert(ms!=NULL);
+  assert(crc!=NULL);
+  *crc=0;
+  ms_seek(ms,offset,SEEK_SET);
+  if (ms_read(&length,sizeof length,1,ms)==0)
+    return 0;
+  ms_seek(ms,offset,SEEK_SET);
+  length+=sizeof(uint32_t);
+  if (length>(uint32_t)(ms->end-ms->pos))
+    length=(uint32_t)(ms->end-ms->pos);
+  *crc=gdb_crc32(0xffffffff,ms->pos,length);
+  return length;
+}
+
+/* symname_copy() appends copies of the symbols in a list to another list (the
+   demangled names are not copied) */
+static bool symname_copy(DWARF_SYMBOLLIST *dest,const DWARF_SYMBOLLIST *src)
+{
+  DWARF_SYMBOLLIST *tail,*cur;
+
+  assert(dest!=NULL);
+  assert(src!=NULL);
+  for (tail=dest; tail->next!=NULL; tail=tail->next)
+    {}
+  for (src=src->next; src!=NULL; src=src->next) {
+    if ((cur=(DWARF_SYMBOLLIST*)malloc(sizeof(DWARF_SYMBOLLIST)))==NULL)
+      return false;   /* insufficient memory */
+    *cur=*src;
+    cur->plain=NULL;
+    cur->next=NULL;
+    if ((cur->name=strdup(src->name))==NULL) {
+      free(cur);
+      return false;   /* insufficient memory */
+    }
+    tail->next=cur;
+    tail=cur;
+  }
+  return true;
+}
+
+/* unitcache_findline() and unitcache_findinfo() return the index of a cached
+   unit with the given fingerprint, or -1 if there is none; the unit at the
+   same position as in the earlier load is checked first */
+static int unitcache_findline(int hint,uint32_t size,uint32_t crc)
+{
+  const LINEUNIT *units=unitcache.lineunits;
+  int idx;
+
+  if (hint<unitcache.numlineunits && units[hint].result && units[hint].size==size && units[hint].crc==crc)
+    return hint;
+  for (idx=0; idx<unitcache.numlineunits; idx++)
+    if (units[idx].result && units[idx].size==size && units[idx].crc==crc)
+      return idx;
+  return -1;
+}
+
+static int unitcache_findinfo(int hint,uint32_t size,uint32_t crc)
+{
+  const INFOUNIT *units=unitcache.infounits;
+  int idx;
+
+  if (hint<unitcache.numinfounits && units[hint].result && units[hint].size==size && units[hint].crc==crc)
+    return hint;
+  for (idx=0; idx<unitcache.numinfounits; idx++)
+    if (units[idx].result && units[idx].size==size && units[idx].crc==crc)
+      return idx;
+  return -1;
+}
+
+/* unitcache_setlines() and unitcache_setinfo() replace the cached units by
+   the ones passed in (the cache takes ownership of the array) */
+static void unitcache_setlines(LINEUNIT *units,int count)
+{
+  int idx;
+
+  for (idx=0; idx<unitcache.numlineunits; idx++) {
+    path_deletetable(&unitcache.lineunits[idx].file_list);
+    line_clearvector(&unitcache.lineunits[idx].line_list);
+  }
+  if (unitcache.lineunits!=NULL)
+    free(unitcache.lineunits);
+  unitcache.lineunits=units;
+  unitcache.numlineunits=(units!=NULL) ? count : 0;
+}
+
+static void unitcache_setinfo(INFOUNIT *units,int count)
+{
+  int idx;
+
+  for (idx=0; idx<unitcache.numinfounits; idx++)
+    symname_deletetable(&unitcache.infounits[idx].symbols);
+  if (unitcache.infounits!=NULL)
+    free(unitcache.infounits);
+  unitcache.infounits=units;
+  unitcache.numinfounits=(units!=NULL) ? count : 0;
+}
+
+/** dwarf_unitcache_clear() frees the results of the compilation units that
+ *  are kept from the most recent dwarf_read(). After this call, the next
+ *  dwarf_read() parses all units.
+ */
+void dwarf_unitcache_clear(void)
+{
+  unitcache_setlines(NULL,0);
+  unitcache_setinfo(NULL,0);
+}
+
+/* dwarf_linetable() parses the .debug_line table and retrieves the
+   line-number/code-address tupples. DWARF implements the table as a state
+   machine with pseudo-instructions to set/clear state fields. There may be
+   several of such state programs in the section.
+   The output of this function is a list with line information structures and
+   a list of filenames. The each element of the line number structure includes
+   an index into the file list. The line number list is sorted on the code
+   address */
+static bool dwarf_linetable(MEMSTREAM *ms,const DWARFTABLE tables[],
+                            DWARF_LINELOOKUP *linetable,DWARF_PATHLIST *filetable,
+                            PATHXREF *xreftable)
+{
+  LINEUNIT *units;
+  LINEVECTOR line_all = { NULL };   /* lines of all units */
+  DWARF_PATHLIST *fileitem;
+  int *filemap;
+  int unit,numunits,idx,numfiles;
+  long count;
+  bool result;
+
+  assert(ms!=NULL);
+  assert(tables!=NULL);
+  assert(linetable!=NULL);
+  assert(linetable->next==NULL);  /* linetable should be empty */
+  assert(filetable!=NULL);
+  assert(filetable->next==NULL);  /* filetable should be empty */
+  assert(xreftable!=NULL);
+  assert(xreftable->filemap==NULL);  /* path cross-reference should be empty */
+  assert(tables[TABLE_LINE].offset>0 && tables[TABLE_LINE].size>0); /* debug information should have been found */
+
+  /* find the line programs, then run these in parallel */
+  units=(LINEUNIT*)dwarf_unitoffsets(ms,&tables[TABLE_LINE],sizeof(LINEUNIT),&numunits);
+  if (units==NULL)
+    return (numunits==0);
+  if (!pathxref_init(xreftable,numunits)) {
+    free(units);
+    return false;
+  }
+  /* take the units that did not change from the cache (the cache entry is
+     emptied, as the data moves to the new unit) */
+  for (unit=0; unit<numunits; unit++) {
+    LINEUNIT *lu=&units[unit];
+    lu->size=unit_fingerprint(ms,lu->offset,&lu->crc);
+    int match=unitcache_findline(unit,lu->size,lu->crc);
+    if (match>=0) {
+      LINEUNIT *cu=&unitcache.lineunits[match];
+      lu->file_list=cu->file_list;
+      lu->line_list=cu->line_list;
+      lu->result=lu->reused=true;
+      memset(&cu->file_list,0,sizeof(DWARF_PATHLIST));
+      memset(&cu->line_list,0,sizeof(LINEVECTOR));
+      cu->result=false;
+    }
+  }
+  WORKQUEUE queue;
+  memset(&queue,0,sizeof queue);
+  queue.count=numunits;
+  queue.ms=ms;
+  queue.tables=tables;
+  queue.lineunits=units;
+  dwarf_runqueue(&queue);
+
+  result=true;
+  for (unit=0; unit<numunits; unit++) {
+    if (!units[unit].result) {
+      result=false;
+      break;
+    }
+    /* merge the local file table with the global one; first check which
+       files are referenced at all */
+    numfiles=0;
+    for (fileitem=units[unit].file_list.next; fileitem!=NULL; fileitem=fileitem->next)
+      numfiles++;
+    filemap=(int*)malloc((numfiles+1)*sizeof(int));  /* +1 to avoid a zero-size allocation */
+    if (filemap==NULL) {
+      result=false;
+      break;
+    }
+    for (idx=0; idx<numfiles; idx++)
+      filemap[idx]=-1;
+    for (count=0; count<units[unit].line_list.count; count++) {
+      int fileidx=units[unit].line_list.items[count].fileindex;
+      if (fileidx>=0 && fileidx<numfiles)
+        filemap[fileidx]=0;   /* mark as referenced (index is set below) */
+    }
+    idx=0;
+    for (fileitem=units[unit].file_list.next; fileitem!=NULL; fileitem=fileitem->next) {
+      if (filemap[idx]==0) {
+        /* so this file is referenced, now see whether it is already in the
+           global file table */
+        int tgt=path_find(filetable,fileitem->name);
+        if (tgt<0) {
+          path_insert(filetable,fileitem->name);
+          tgt=path_find(filetable,fileitem->name);  /* find it back, to add a cross-reference */
+          assert(tgt>=0);
+        }
+        filemap[idx]=tgt;
+      }
+      idx++;
+    }
+
+    /* append the local line table to the global table (and translate the index
+       in the local file table to the index in the global file table) */
+    for (count=0; count<units[unit].line_list.count; count++) {
+      const DWARF_LINELOOKUP *lineitem=&units[unit].line_list.items[count];
+      int fileidx=(lineitem->fileindex>=0 && lineitem->fileindex<numfiles) ? filemap[lineitem->fileindex] : -1;
+      line_append(&line_all,lineitem->line,lineitem->address,fileidx);
+    }
+    /* the file map is also the cross-reference for the info table */
+    pathxref_set(xreftable,unit,filemap,numfiles);
+  }
+
+  /* the units replace the ones in the cache, for the next reload */
+  for (unit=0; unit<numunits; unit++)
+    units[unit].reused=false;
+  unitcache_setlines(units,numunits);
+
+  /* sort the collected lines, remove duplicates and build the index */
+  if (result)
+    result=line_buildindex(linetable,&line_all);
+  line_clearvector(&line_all);
+  return result;
+}
+
+/* dwarf_infotable() parses the .debug_info table and collects the functions.
+ */
+static bool dwarf_infotable(MEMSTREAM *ms,const DWARFTABLE tables[],
+                            DWARF_SYMBOLLIST *symboltable,int *address_size,
+                            const PATHXREF *xreftable)
+{
+  ABBREVTABLE abbrev_root;
+  INFOUNIT *units,*cache;
+  DWARF_SYMBOLLIST *symtail,*sym;
+  int unit,numunits;
+  bool result;
+
+  assert(ms!=NULL);
+  assert(tables!=NULL);
+  assert(symboltable!=NULL);
+  assert(symboltable->next==NULL);/* symboltable should be empty */
+  assert(address_size!=NULL);
+  assert(xreftable!=NULL);
+
+  assert(tables[TABLE_ABBREV].offset>0);/* required table */
+  memset(&abbrev_root,0,sizeof abbrev_root);
+  dwarf_abbrev(ms,tables,&abbrev_root);
+
+  assert(tables[TABLE_INFO].offset>0);  /* debug information should have been found */
+  units=(INFOUNIT*)dwarf_unitoffsets(ms,&tables[TABLE_INFO],sizeof(INFOUNIT),&numunits);
+  if (units==NULL) {
+    abbrev_deletetable(&abbrev_root);
+    return (numunits==0);
+  }
+  /* the symbol lists are moved into the symbol table, so the new cache holds
+     copies of these lists */
+  if ((cache=(INFOUNIT*)calloc(numunits,sizeof(INFOUNIT)))==NULL) {
+    abbrev_deletetable(&abbrev_root);
+    free(units);
+    return false;
+  }
+  for (unit=0; unit<numunits; unit++) {
+    INFOUNIT *iu=&units[unit];
+    iu->size=unit_fingerprint(ms,iu->offset,&iu->crc);
+    int match=unitcache_findinfo(unit,iu->size,iu->crc);
+    if (match>=0 && symname_copy(&iu->symbols,&unitcache.infounits[match].symbols)) {
+      INFOUNIT *cu=&unitcache.infounits[match];
+      iu->address_size=cu->address_size;
+      iu->result=iu->reused=true;
+      cache[unit]=*cu;
+      memset(&cu->symbols,0,sizeof(DWARF_SYMBOLLIST));
+      cu->result=false;
+    } else {
+      symname_deletetable(&iu->symbols);  /* in case the copy failed half-way */
+    }
+  }
+  WORKQUEUE queue;
+  memset(&queue,0,sizeof queue);
+  queue.count=numunits;
+  queue.ms=ms;
+  queue.tables=tables;
+  queue.abbrev_root=&abbrev_root;
+  queue.infounits=units;
+  dwarf_runqueue(&queue);
+  abbrev_deletetable(&abbrev_root);
+
+  /* concatenate the symbol lists of all units, and translate the file indices
+     to the global file table (symbols in a file without line information are
+     dropped) */
+  result=true;
+  symtail=symboltable;
+  for (unit=0; unit<numunits; unit++) {
+    INFOUNIT *iu=&units[unit];
+    if (!iu->result)
+      result=false;
+    if (!iu->reused) {
+      cache[unit]=*iu;
+      memset(&cache[unit].symbols,0,sizeof(DWARF_SYMBOLLIST));
+      if (iu->result && !symname_copy(&cache[unit].symbols,&iu->symbols)) {
+        symname_deletetable(&cache[unit].symbols);
+        cache[unit].result=false;
+      }
+    }
+    cache[unit].reused=false;
+    while ((sym=iu->symbols.next)!=NULL) {
+      iu->symbols.next=sym->next;
+      sym->next=NULL;
+      sym->fileindex=(short)pathxref_find(xreftable,unit,sym->fileindex);
+      if (sym->fileindex<0) {
+        free(sym->name);
+        free(sym);
+      } else {
+        symtail->next=sym;
+        symtail=sym;
+      }
+    }
+    *address_size=iu->address_size;
+  }
+  free(units);
+  unitcache_setinfo(cache,numunits);
+
+  if (result)
+    result=symname_sort(symboltable);
+  return result;
+}
+
+static int symfile_cmp(const void *p1,const void *p2)
+{
+  const DWARF_SYMBOLLIST *s1=*(const DWARF_SYMBOLLIST**)p1;
+  const DWARF_SYMBOLLIST *s2=*(const DWARF_SYMBOLLIST**)p2;
+  if (s1->fileindex!=s2->fileindex)
+    return (s1->fileindex<s2->fileindex) ? -1 : 1;
+  if (s1->line!=s2->line)
+    return (s1->line<s2->line) ? -1 : 1;
+  return 0;
+}
+
+static void dwarf_postprocess(DWARF_SYMBOLLIST *symboltable,const DWARF_LINELOOKUP *linetable)
+{
+  DWARF_SYMBOLLIST *sym;
+  DWARF_SYMBOLLIST **locals;
+  unsigned numlocals;
+  const LINEINDEX *index=line_findindex(linetable);
+
+  assert(symboltable!=NULL);
+  /* make a list of all symbols whose scope must still be determined, sorted
+     on file and line (if this fails, fall back to a sequential search) */
+  numlocals=0;
+  for (sym=symboltable->next; sym!=NULL; sym=sym->next)
+    if (sym->scope==SCOPE_UNKNOWN)
+      numlocals++;
+  locals=(DWARF_SYMBOLLIST**)malloc((numlocals+1)*sizeof(DWARF_SYMBOLLIST*));
+  if (locals!=NULL) {
+    numlocals=0;
+    for (sym=symboltable->next; sym!=NULL; sym=sym->next)
+      if (sym->scope==SCOPE_UNKNOWN)
+        locals[numlocals++]=sym;
+    qsort(locals,numlocals,sizeof(DWARF_SYMBOLLIST*),symfile_cmp);
+  }
+  for (sym=symboltable->next; sym!=NULL; sym=sym->next) {
+    if (DWARF_IS_FUNCTION(sym)) {
+      /* go through the line table to find the line range for the function */
+      uint32_t addr=sym->code_addr+sym->code_range;
+      const DWARF_LINELOOKUP *line;
+      DWARF_SYMBOLLIST *lcl;
+      assert(linetable!=NULL);
+      if (index!=NULL) {
+        /* of all lines in the function's address range, take the line whose
+           first address is the highest (code for a line may be split over
+           multiple address ranges, only the first range is considered) */
+        unsigned pos;
+        for (pos=line_lowerbound(index,sym->code_addr); pos<index->count && index->lines[pos].address<addr; pos++) {
+          line=&index->lines[pos];
+          if (line->fileindex==sym->fileindex && dwarf_line_from_fileline(linetable,line->fileindex,line->line)==line)
+            sym->line_limit=line->line+1; /* +1 for consistency with DWARF address range */
+        }
+      } else {
+        for (line=linetable->next; line!=NULL && sym->line_limit==0; line=line->next) {
+          if (line->address<addr && (line->next==NULL || line->next->address>=addr)
+              && line->line>=sym->line_limit)
+            sym->line_limit=line->line+1; /* +1 for consistency with DWARF address range */
+        }
+      }
+      /* collect all local variables that are declared within this line range */
+      if (locals!=NULL) {
+        unsigned low=0,high=numlocals;
+        while (low<high) {
+          unsigned mid=low+(high-low)/2;
+          lcl=locals[mid];
+          if (lcl->fileindex<sym->fileindex || (lcl->fileindex==sym->fileindex && lcl->line<sym->line))
+            low=mid+1;
+          else
+            high=mid;
+        }
+        for ( ; low<numlocals && locals[low]->fileindex==sym->fileindex && locals[low]->line<sym->line_limit; low++) {
+          lcl=locals[low];
+          if (lcl->scope==SCOPE_UNKNOWN) {
+            assert(lcl->code_addr==0);  /* nested functions don't occur */
+            lcl->scope=SCOPE_FUNCTION;
+            lcl->line_limit=sym->line_limit;
+            assert(lcl->line_limit>lcl->line);
+          }
+        }
+      } else {
+        for (lcl=symboltable->next; lcl!=NULL; lcl=lcl->next) {
+          if (lcl->fileindex==sym->fileindex
+              && lcl->line>=sym->line && lcl->line<sym->line_limit
+              && lcl->scope==SCOPE_UNKNOWN)
+          {
+            assert(lcl->code_addr==0);  /* nested functions don't occur */
+            lcl->scope=SCOPE_FUNCTION;
+            lcl->line_limit=sym->line_limit;
+            assert(lcl->line_limit>lcl->line);
+          }
+        }
+      }
+    }
+  }
+  if (locals!=NULL)
+    free(locals);
+}
+
+/** dwarf_read() returns three lists: a list with source code line numbers,
+ *  a list with functions and a list with the file paths (referred to by the
+ *  other two lists)
+ */
+bool dwarf_read(FILE *fp,DWARF_LINELOOKUP *linetable,DWARF_SYMBOLLIST *symboltable,
+                DWARF_PATHLIST *filetable,int *address_size)
+{
+  assert(fp!=NULL);
+  assert(linetable!=NULL);        /* tables must be valid, but empty */
+  assert(linetable->next==NULL);
+  assert(symboltable!=NULL);
+  assert(symboltable->next==NULL);
+  assert(filetable!=NULL);
+  assert(filetable->next==NULL);
+  assert(address_size!=NULL);
+
+  int wordsize;
+  ELF_FILE *elf=elf_open(fp,NULL);
+  int err=elf_file_info(elf,&wordsize,NULL,NULL,NULL);
+  if (err!=ELFERR_NONE || wordsize!=32) {
+    /* only 32-bit architectures at this time */
+    elf_close(elf);
+    return false;
+  }
+
+  /* get offsets to various debug tables */
+  DWARFTABLE tables[TABLE_COUNT];
+  elf_file_section_by_name(elf,".debug_info",&tables[TABLE_INFO].offset,NULL,&tables[TABLE_INFO].size);
+  elf_file_section_by_name(elf,".debug_abbrev",&tables[TABLE_ABBREV].offset,NULL,&tables[TABLE_ABBREV].size);
+  elf_file_section_by_name(elf,".debug_str",&tables[TABLE_STR].offset,NULL,&tables[TABLE_STR].size);
+  elf_file_section_by_name(elf,".debug_line",&tables[TABLE_LINE].offset,NULL,&tables[TABLE_LINE].size);
+  elf_file_section_by_name(elf,".debug_pubnames",&tables[TABLE_PUBNAME].offset,NULL,&tables[TABLE_PUBNAME].size);
+  elf_file_section_by_name(elf,".debug_line_str",&tables[TABLE_LINE_STR].offset,NULL,&tables[TABLE_LINE_STR].size);
+  elf_close(elf);
+
+  /* read the debug tables in memory, then decode from memory */
+  MEMSTREAM ms;
+  if (!ms_open(&ms,fp,tables)) {
+    ms_close(&ms);
+    return false;
+  }
+
+  PATHXREF xreftable = { NULL, NULL, 0 };
+  bool result=true;
+  /* the line table also holds information for the file path table and the path
+     cross-reference; the table is therefore mandatory in the DWARF format and
+     it is the first one to parse */
+  if (tables[TABLE_LINE].offset!=0)
+    result=dwarf_linetable(&ms,tables,linetable,filetable,&xreftable);
+  /* the information table implicitly parses the abbreviations table, but it
+     discards that table before returning */
+  if (result && tables[TABLE_INFO].offset!=0)
+    result=dwarf_infotable(&ms,tables,symboltable,address_size,&xreftable);
+
+  pathxref_deletetable(&xreftable);
+  ms_close(&ms);
+
+  /* now that we have seen all functions, we can update the scope of local
+     variables */
+  dwarf_postprocess(symboltable,linetable);
+
+  /* build the index on name and address (lookups fall back to a sequential
+     search if this fails) */
+  symindex_build(symboltable);
+
+  return result;
+}
+
+void dwarf_cleanup(DWARF_LINELOOKUP *linetable,DWARF_SYMBOLLIST *symboltable,DWARF_PATHLIST *filetable)
+{
+  line_deletetable(linetable);
+  symname_deletetable(symboltable);
+  path_deletetable(filetable);
+}
+
+/* The cache file holds the three tables in a flat format: a header, followed
+   by the array of path offsets, the array of lines, the array of symbols and
+   finally a pool with the strings (the path names and the symbol names). It
+   is matched to the ELF file on the file size, the time stamp and the CRC. */
+#define DWARF_CACHE_MAGIC    "BMDW"
+#define DWARF_CACHE_VERSION  1
+
+typedef struct tagCACHEHDR {
+  char magic[4];
+  uint32_t version;
+  int64_t elf_time;     /* modification time of the ELF file */
+  uint32_t elf_size;    /* size of the ELF file */
+  uint32_t elf_crc;     /* CRC32 of the ELF file */
+  int32_t address_size;
+  uint32_t numpaths;
+  uint32_t numlines;
+  uint32_t numsymbols;
+  uint32_t poolsize;    /* size of the string pool in bytes */
+  uint32_t reserved;
+} CACHEHDR;
+
+typedef struct tagCACHELINE {
+  uint32_t address;
+  int32_t line;
+  int32_t fileindex;
+} CACHELINE;
+
+typedef struct tagCACHESYM {
+  uint32_t name;        /* offset in the string pool */
+  uint32_t code_addr;
+  uint32_t code_range;
+  uint32_t data_addr;
+  int32_t line;
+  int32_t line_limit;
+  int16_t fileindex;
+  int16_t scope;
+} CACHESYM;
+
+/* cache_key() fills in the fields in the header that identify the ELF file;
+   the file position is restored on return */
+static bool cache_key(FILE *fp,CACHEHDR *hdr)
+{
+  struct stat st;
+  unsigned char buffer[4096];
+  size_t count;
+
+  assert(fp!=NULL);
+  assert(hdr!=NULL);
+  memset(hdr,0,sizeof(CACHEHDR));
+  memcpy(hdr->magic,DWARF_CACHE_MAGIC,sizeof hdr->magic);
+  hdr->version=DWARF_CACHE_VERSION;
+  if (fstat(fileno(fp),&st)!=0)
+    return false;
+  hdr->elf_time=(int64_t)st.st_mtime;
+  hdr->elf_size=(uint32_t)st.st_size;
+
+  long pos=ftell(fp);
+  uint32_t crc=0xffffffff;
+  fseek(fp,0,SEEK_SET);
+  while ((count=fread(buffer,1,sizeof buffer,fp))>0)
+    crc=gdb_crc32(crc,buffer,(unsigned)count);
+  fseek(fp,pos,SEEK_SET);
+  hdr->elf_crc=crc;
+  return true;
+}
+
+/* cache_load() reads the cache file and rebuilds the tables from it; it
+   returns false if the file does not exist, if it is invalid, or if it does
+   not match the ELF file */
+static bool cache_load(const char *cachefile,const CACHEHDR *key,
+                       DWARF_LINELOOKUP *linetable,DWARF_SYMBOLLIST *symboltable,
+                       DWARF_PATHLIST *filetable,int *address_size)
+{
+  FILE *fp;
+  unsigned char *data;
+  long size;
+  unsigned idx;
+
+  assert(cachefile!=NULL);
+  assert(key!=NULL);
+  if ((fp=fopen(cachefile,"rb"))==NULL)
+    return false;
+  fseek(fp,0,SEEK_END);
+  size=ftell(fp);
+  fseek(fp,0,SEEK_SET);
+  if (size<(long)sizeof(CACHEHDR) || (data=(unsigned char*)malloc(size))==NULL) {
+    fclose(fp);
+    return false;
+  }
+  bool ok=(fread(data,1,size,fp)==(size_t)size);
+  fclose(fp);
+
+  /* check the header against the ELF file, and check the size of the cache
+     file against the counts in the header */
+  CACHEHDR hdr;
+  memcpy(&hdr,data,sizeof(CACHEHDR));
+  if (ok)
+    ok=memcmp(hdr.magic,key->magic,sizeof hdr.magic)==0 && hdr.version==key->version
+       && hdr.elf_time==key->elf_time && hdr.elf_size==key->elf_size && hdr.elf_crc==key->elf_crc;
+  uint64_t expected=sizeof(CACHEHDR) + (uint64_t)hdr.numpaths*sizeof(uint32_t)
+                    + (uint64_t)hdr.numlines*sizeof(CACHELINE)
+                    + (uint64_t)hdr.numsymbols*sizeof(CACHESYM) + hdr.poolsize;
+  if (ok)
+    ok=(expected==(uint64_t)size && hdr.poolsize>0 && data[size-1]=='\0');
+  if (!ok) {
+    free(data);
+    return false;
+  }
+  const uint32_t *paths=(const uint32_t*)(data+sizeof(CACHEHDR));
+  const CACHELINE *lines=(const CACHELINE*)(paths+hdr.numpaths);
+  const CACHESYM *symbols=(const CACHESYM*)(lines+hdr.numlines);
+  const char *pool=(const char*)(symbols+hdr.numsymbols);
+
+  /* path table (the "path_insert" function is not used, because it walks
+     through the list to find the tail) */
+  DWARF_PATHLIST *ptail=filetable;
+  for (idx=0; ok && idx<hdr.numpaths; idx++) {
+    DWARF_PATHLIST *cur;
+    if (paths[idx]>=hdr.poolsize || (cur=(DWARF_PATHLIST*)malloc(sizeof(DWARF_PATHLIST)))==NULL) {
+      ok=false;
+    } else if ((cur->name=strdup(pool+paths[idx]))==NULL) {
+      free(cur);
+      ok=false;
+    } else {
+      cur->next=NULL;
+      ptail->next=cur;
+      ptail=cur;
+    }
+  }
+
+  /* line table */
+  LINEVECTOR vector = { NULL, 0, 0 };
+  for (idx=0; ok && idx<hdr.numlines; idx++)
+    ok=line_append(&vector,lines[idx].line,lines[idx].address,lines[idx].fileindex);
+  if (ok)
+    ok=line_buildindex(linetable,&vector);
+  line_clearvector(&vector);
+
+  /* symbol table (stored in sorted order) */
+  DWARF_SYMBOLLIST *stail=symboltable;
+  for (idx=0; ok && idx<hdr.numsymbols; idx++) {
+    DWARF_SYMBOLLIST *cur;
+    if (symbols[idx].name>=hdr.poolsize || (cur=(DWARF_SYMBOLLIST*)malloc(sizeof(DWARF_SYMBOLLIST)))==NULL) {
+      ok=false;
+    } else if ((cur->name=strdup(pool+symbols[idx].name))==NULL) {
+      free(cur);
+      ok=false;
+    } else {
+      cur->plain=NULL;
+      cur->code_addr=symbols[idx].code_addr;
+      cur->code_range=symbols[idx].code_range;
+      cur->data_addr=symbols[idx].data_addr;
+      cur->line=symbols[idx].line;
+      cur->line_limit=symbols[idx].line_limit;
+      cur->fileindex=symbols[idx].fileindex;
+      cur->scope=symbols[idx].scope;
+      cur->next=NULL;
+      stail->next=cur;
+      stail=cur;
+    }
+  }
+
+  free(data);
+  if (!ok) {
+    dwarf_cleanup(linetable,symboltable,filetable);
+    return false;
+  }
+  symindex_build(symboltable);
+  *address_size=hdr.address_size;
+  return true;
+}
+
+static bool cache_save(const char *cachefile,const CACHEHDR *key,
+                       const DWARF_LINELOOKUP *linetable,const DWARF_SYMBOLLIST *symboltable,
+                       const DWARF_PATHLIST *filetable,int address_size)
+{
+  const DWARF_PATHLIST *path;
+  const DWARF_LINELOOKUP *line;
+  const DWARF_SYMBOLLIST *sym;
+  CACHEHDR hdr;
+
+  assert(cachefile!=NULL);
+  assert(key!=NULL);
+  hdr=*key;
+  hdr.address_size=address_size;
+  for (path=filetable->next; path!=NULL; path=path->next) {
+    hdr.numpaths++;
+    hdr.poolsize+=strlen(path->name)+1;
+  }
+  for (line=linetable->next; line!=NULL; line=line->next)
+    hdr.numlines++;
+  for (sym=symboltable->next; sym!=NULL; sym=sym->next) {
+    hdr.numsymbols++;
+    hdr.poolsize+=strlen(sym->name)+1;
+  }
+  if (hdr.poolsize==0)
+    hdr.poolsize=1;     /* pool is never empty, so that it can be validated */
+
+  size_t size=sizeof(CACHEHDR) + hdr.numpaths*sizeof(uint32_t) + hdr.numlines*sizeof(CACHELINE)
+              + hdr.numsymbols*sizeof(CACHESYM) + hdr.poolsize;
+  unsigned char *data=(unsigned char*)malloc(size);
+  if (data==NULL)
+    return false;
+  memset(data,0,size);
+  memcpy(data,&hdr,sizeof(CACHEHDR));
+  uint32_t *paths=(uint32_t*)(data+sizeof(CACHEHDR));
+  CACHELINE *lines=(CACHELINE*)(paths+hdr.numpaths);
+  CACHESYM *symbols=(CACHESYM*)(lines+hdr.numlines);
+  char *pool=(char*)(symbols+hdr.numsymbols);
+  uint32_t poolpos=0;
+
+  for (path=filetable->next; path!=NULL; path=path->next) {
+    *paths++=poolpos;
+    strcpy(pool+poolpos,path->name);
+    poolpos+=strlen(path->name)+1;
+  }
+  for (line=linetable->next; line!=NULL; line=line->next) {
+    lines->address=line->address;
+    lines->line=line->line;
+    lines->fileindex=line->fileindex;
+    lines++;
+  }
+  for (sym=symboltable->next; sym!=NULL; sym=sym->next) {
+    symbols->name=poolpos;
+    strcpy(pool+poolpos,sym->name);
+    poolpos+=strlen(sym->name)+1;
+    symbols->code_addr=sym->code_addr;
+    symbols->code_range=sym->code_range;
+    symbols->data_addr=sym->data_addr;
+    symbols->line=sym->line;
+    symbols->line_limit=sym->line_limit;
+    symbols->fileindex=sym->fileindex;
+    symbols->scope=sym->scope;
+    symbols++;
+  }
+
+  FILE *fp=fopen(cachefile,"wb");
+  bool result=false;
+  if (fp!=NULL) {
+    result=(fwrite(data,1,size,fp)==size);
+    fclose(fp);
+    if (!result)
+      remove(cachefile);  /* do not leave a truncated cache behind */
+  }
+  free(data);
+  return result;
+}
+
+/* demangle_cachefile() builds the name of the file for the demangle cache,
+   from the name of the DWARF cache file (the extension is replaced) */
+static bool demangle_cachefile(char *filename,size_t size,const char *cachefile)
+{
+  const char *ext=strrchr(cachefile,'.');
+  size_t len=(ext!=NULL && strpbrk(ext,"/\\")==NULL) ? (size_t)(ext-cachefile) : strlen(cachefile);
+  if (len+5>=size)
+    return false;
+  memcpy(filename,cachefile,len);
+  strcpy(filename+len,".dmc");
+  return true;
+}
+
+/** dwarf_read_cached() returns the same tables as dwarf_read(), but it first
+ *  tries to load these from a cache file; if the cache file is absent or
+ *  outdated, the DWARF information is parsed and the cache file is created
+ *  (or refreshed). When the DWARF information must be parsed, the demangled
+ *  names from an earlier run are reloaded as well, and saved afterwards.
+ *
+ *  \param fp           The ELF file, opened in binary mode.
+ *  \param cachefile    The full path to the cache file. This parameter may be
+ *                      NULL, in which case this function is equivalent to
+ *                      dwarf_read().
+ *
+ *  \note The other parameters are the same as for dwarf_read().
+ */
+bool dwarf_read_cached(FILE *fp,const char *cachefile,DWARF_LINELOOKUP *linetable,
+                       DWARF_SYMBOLLIST *symboltable,DWARF_PATHLIST *filetable,
+                       int *address_size)
+{
+  CACHEHDR key;
+
+  assert(fp!=NULL);
+  assert(linetable!=NULL && linetable->next==NULL);
+  assert(symboltable!=NULL && symboltable->next==NULL);
+  assert(filetable!=NULL && filetable->next==NULL);
+  assert(address_size!=NULL);
+
+  if (cachefile==NULL || *cachefile=='\0' || !cache_key(fp,&key))
+    return dwarf_read(fp,linetable,symboltable,filetable,address_size);
+  if (cache_load(cachefile,&key,linetable,symboltable,filetable,address_size))
+    return true;
+  char dmcfile[512];
+  bool dmc=demangle_cachefile(dmcfile,sizeof dmcfile,cachefile);
+  if (dmc)
+    demangle_cache_load(dmcfile);
+  if (!dwarf_read(fp,linetable,symboltable,filetable,address_size))
+    return false;
+  cache_save(cachefile,&key,linetable,symboltable,filetable,*address_size);
+  if (dmc)
+    demangle_cache_save(dmcfile);
+  return true;
+}
+
+/** dwarf_sym_from_name() returns a function or variable that matches the name,
+ *  and that is in scope.
+ *  - Functions and variables with function scope (locals & arguments) are
+ *    matched if the fileindex matches and the lineindex is in range. This test
+ *    is skipped in fileindex or lineindex is -1.
+ *  - Functions and variables with unit scope are found if the fileindex
+ *    matches. This test is skipped if fileindex is -1.
+ *  - External functions and variables are always matched, but are matched last.
+ */
+const DWARF_SYMBOLLIST *dwarf_sym_from_name(const DWARF_SYMBOLLIST *symboltable,
+                                            const char *name,int fileindex,int lineindex)
+{
+  const DWARF_SYMBOLLIST *sym;
+
+  const SYMINDEX *index;
+
+  assert(symboltable!=NULL);
+  assert(name!=NULL);
+  if ((index=symindex_find_names(symboltable))!=NULL) {
+    sym=NULL;
+    if (fileindex>=0 && lineindex>=0)
+      sym=symindex_lookup(index,name,SCOPE_FUNCTION,fileindex,lineindex);
+    if (sym==NULL && fileindex>=0)
+      sym=symindex_lookup(index,name,SCOPE_UNIT,fileindex,-1);
+    if (sym==NULL)
+      sym=symindex_lookup(index,name,SCOPE_EXTERNAL,-1,-1);
+    return sym;
+  }
+  /* check local variables */
+  if (fileindex>=0 && lineindex>=0) {
+    for (sym=symboltable->next; sym!=NULL; sym=sym->next) {
+      assert(sym->name!=NULL);
+      if (sym->scope==SCOPE_FUNCTION
+          && sym->fileindex==fileindex
+          && sym->line<=lineindex && lineindex<sym->line_limit
+          && strcmp(dwarf_sym_name(sym),name)==0)
+        return sym;
+    }
+  }
+  /* check static globals */
+  if (fileindex>=0) {
+    for (sym=symboltable->next; sym!=NULL; sym=sym->next) {
+      assert(sym->name!=NULL);
+      if (sym->scope==SCOPE_UNIT
+          && sym->fileindex==fileindex
+          && strcmp(dwarf_sym_name(sym),name)==0)
+        return sym;
+    }
+  }
+  /* check external symbols */
+  for (sym=symboltable->next; sym!=NULL; sym=sym->next) {
+    assert(sym->name!=NULL);
+    if (sym->scope==SCOPE_EXTERNAL
+        && strcmp(dwarf_sym_name(sym),name)==0)
+      return sym;
+  }
+  return NULL;
+}
+
+const DWARF_SYMBOLLIST *dwarf_sym_from_address(const DWARF_SYMBOLLIST *symboltable,unsigned address,int exact)
+{
+  const DWARF_SYMBOLLIST *sym, *select = NULL;
+  const SYMINDEX *index;
+
+  assert(symboltable!=NULL);
+  if ((index=symindex_find(symboltable))!=NULL) {
+    /* look up the address in the functions and in the variables; on an exact
+       match on both, return the one that comes first in the list */
+    unsigned func=symindex_lowerbound(index,0,index->numfunc,address);
+    unsigned var=symindex_lowerbound(index,index->numfunc,index->numaddr,address);
+    bool func_match=(func<index->numfunc && symindex_address(index->symbols[index->byaddr[func]])==address);
+    bool var_match=(var<index->numaddr && symindex_address(index->symbols[index->byaddr[var]])==address);
+    if (func_match && (!var_match || index->byaddr[func]<index->byaddr[var]))
+      return index->symbols[index->byaddr[func]];
+    if (var_match)
+      return index->symbols[index->byaddr[var]];
+    /* optionally return the closest function at a lower address */
+    if (!exact && func>0)
+      return index->symbols[index->byaddr[func-1]];
+    return NULL;
+  }
+  for (sym=symboltable->next; sym!=NULL; sym=sym->next) {
+    if (sym->code_range==0) {
+      /* check variable */
+      if (sym->data_addr==address)
+        return sym;   /* always return the variable on an exact address match */
+    } else {
+      /* check function */
+      if (sym->code_addr==address)
+        return sym;   /* always return the function on an exact address match */
+      if (!exact && sym->code_addr<address)
+        select=sym;   /* optionally return the closest function at a lower address */
+    }
+  }
+  return select;
+}
+
+/* dwarf_sym_from_prefix() returns the n-th symbol whose name starts with the
+   prefix, or NULL if there are fewer matches; with the index, the matches are
+   in alphabetical order, and each look-up is a binary search */
+const DWARF_SYMBOLLIST *dwarf_sym_from_prefix(const DWARF_SYMBOLLIST *symboltable,const char *prefix,unsigned index)
+{
+  const DWARF_SYMBOLLIST *sym;
+  const SYMINDEX *symindex;
+  size_t len;
+
+  assert(symboltable!=NULL);
+  assert(prefix!=NULL);
+  len=strlen(prefix);
+  if ((symindex=symindex_find_names(symboltable))!=NULL) {
+    unsigned low=0,high=symindex->count;
+    while (low<high) {
+      unsigned mid=low+(high-low)/2;
+      if (strcmp(dwarf_sym_name(symindex->symbols[symindex->byname[mid]]),prefix)<0)
+        low=mid+1;
+      else
+        high=mid;
+    }
+    if (low+index>=symindex->count)
+      return NULL;
+    sym=symindex->symbols[symindex->byname[low+index]];
+    return (strncmp(dwarf_sym_name(sym),prefix,len)==0) ? sym : NULL;
+  }
+  for (sym=symboltable->next; sym!=NULL; sym=sym->next) {
+    if (strncmp(dwarf_sym_name(sym),prefix,len)==0 && index--==0)
+      return sym;
+  }
+  return NULL;
+}
+
+const DWARF_SYMBOLLIST *dwarf_sym_from_index(const DWARF_SYMBOLLIST *symboltable,unsigned index)
+{
+  const DWARF_SYMBOLLIST *sym;
+  const SYMINDEX *symindex;
+
+  assert(symboltable!=NULL);
+  if ((symindex=symindex_find(symboltable))!=NULL)
+    return (index<symindex->count) ? symindex->symbols[index] : NULL;
+  for (sym=symboltable->next; sym!=NULL; sym=sym->next) {
+    if (index--==0)
+      return sym;
+  }
+  return NULL;
+}
+
+/** dwarf_collect_functions_in_file() stores the pointers to all "code" symbols
+ *  that appear in a file into a list.
+ *
+ *  \param symboltable  [in] The table returned by dwarf_read().
+ *  \param fileindex    The index of the source file to return the functions
+ *                      for, or -1 to return all functions (in all source
+ *                      files).
+ *  \param sort         One of DWARF_SORT_NAME or DWARF_SORT_ADDRESS.
+ *  \param list         [out] An array that will be filled with pointers to the
+ *                      function information. This parameter may be NULL, in
+ *                      order to query the number of functions in the file.
+ *  \param numentries   The size of the "list" array.
+ *
+ *  \return The number of functions collected.
+ *
+ *  \note   To check the size of the list, call this function with parameter
+ *          "list" set to NULL. The number of entries to allocate is returned.
+ *          Then allocate a buffer of sufficient size, and call this function
+ *          again with that buffer.
+ *
+ *  \note   Note that the returned list holds pointers to symbols, not the
+ *          symbols themselves. The list can be sorted on function names or
+ *          function addresses.
+ */
+static int symaddr_cmp(const void *p1,const void *p2)
+{
+  const DWARF_SYMBOLLIST *s1=*(const DWARF_SYMBOLLIST**)p1;
+  const DWARF_SYMBOLLIST *s2=*(const DWARF_SYMBOLLIST**)p2;
+  if (s1->code_addr!=s2->code_addr)
+    return (s1->code_addr<s2->code_addr) ? -1 : 1;
+  return 0;
+}
+
+static int symlistname_cmp(const void *p1,const void *p2)
+{
+  const DWARF_SYMBOLLIST *s1=*(const DWARF_SYMBOLLIST**)p1;
+  const DWARF_SYMBOLLIST *s2=*(const DWARF_SYMBOLLIST**)p2;
+  return strcmp(dwarf_sym_name(s1),dwarf_sym_name(s2));
+}
+
+unsigned dwarf_collect_functions_in_file(const DWARF_SYMBOLLIST *symboltable,int fileindex,
+                                         int sort,const DWARF_SYMBOLLIST *list[],int numentries)
+{
+  assert(symboltable!=NULL);
+  assert(fileindex==-1 || fileindex>=0);
+  assert(sort==DWARF_SORT_NAME || sort==DWARF_SORT_ADDRESS);
+  if (list==NULL)
+    numentries=0;
+
+  unsigned count=0;
+  for (const DWARF_SYMBOLLIST *sym=symboltable->next; sym!=NULL; sym=sym->next) {
+    if (DWARF_IS_FUNCTION(sym) && (fileindex==-1 || sym->fileindex==fileindex)) {
+      if (count<numentries) {
+        assert(list!=NULL);
+        list[count]=sym;
+      }
+      count+=1;
+    }
+  }
+  if (list!=NULL) {
+    unsigned stored=(count<numentries) ? count : numentries;
+    qsort(list,stored,sizeof(DWARF_SYMBOLLIST*),(sort==DWARF_SORT_ADDRESS) ? symaddr_cmp : symlistname_cmp);
+  }
+  return count;
+}
+
+/** dwarf_path_from_fileindex() returns the path of the source file (or NULL
+ *  if parameter "fileindex" is invalid)
+ */
+const char *dwarf_path_from_fileindex(const DWARF_PATHLIST *filetable,int fileindex)
+{
+  const DWARF_PATHLIST *file;
+
+  assert(filetable!=NULL);
+  assert(fileindex>=0);
+  for (file=filetable->next; file!=NULL && fileindex>0; file=file->next)
+    fileindex--;
+  return (file!=NULL) ? file->name : NULL;
+}
+
+/** dwarf_fileindex_from_path() looks up the path in the file table and
+ *  returns the index in the table (if found). The function first tries a
+ *  full path, but also compares the base names of the files (if a full path
+ *  match fails).
+ *
+ *  \return The file index, or -1 on failure.
+ */
+int dwarf_fileindex_from_path(const DWARF_PATHLIST *filetable,const char *path)
+{
+  const DWARF_PATHLIST *file;
+  int fileindex=0;
+
+  assert(filetable!=NULL);
+  assert(path!=NULL);
+  /* try full path first */
+  for (file=filetable->next; file!=NULL; file=file->next) {
+    if (strcmp(path,file->name)==0)
+      return fileindex;
+    fileindex++;
+  }
+  /* re-try, comparing only base names */
+  fileindex=0;
+  for (file=filetable->next; file!=NULL; file=file->next) {
+    const char *filename=file->name;
+    const char *base;
+    if ((base = strrchr(filename, '/')) != NULL)
+      filename = base + 1;
+#   if defined _WIN32
+      if ((base = strrchr(filename, '\\')) != NULL)
+        filename = base + 1;
+#   endif
+    if (strcmp(path,filename)==0)
+      return fileindex;
+    fileindex++;
+  }
+  return -1;
+}
+
+/** dwarf_line_from_address() returns the line table entry that covers the
+ *  address; this is the entry with the highest address that is equal to, or
+ *  below, the requested address.
+ *
+ *  \return A pointer to the entry, or NULL if the address is below the lowest
+ *          address in the line table.
+ */
+const DWARF_LINELOOKUP *dwarf_line_from_address(const DWARF_LINELOOKUP *linetable,unsigned address)
+{
+  const DWARF_LINELOOKUP *line;
+  const LINEINDEX *index;
+
+  assert(linetable!=NULL);
+  if ((index=line_findindex(linetable))!=NULL) {
+    /* find the first entry above the address, then step back one */
+    unsigned low=0,high=index->count;
+    while (low<high) {
+      unsigned mid=low+(high-low)/2;
+      if (index->lines[mid].address<=address)
+        low=mid+1;
+      else
+        high=mid;
+    }
+    return (low>0) ? &index->lines[low-1] : NULL;
+  }
+  for (line=linetable->next; line!=NULL; line=line->next)
+    if (line->address<=address && (line->next==NULL || line->next->address>address))
+      return line;
+  return NULL;
+}
+
+/** dwarf_line_from_fileline() returns the line table entry for a specific line
+ *  in a source file.
+ *
+ *  \return A pointer to the entry, or NULL if no code is generated for that
+ *          line.
+ */
+const DWARF_LINELOOKUP *dwarf_line_from_fileline(const DWARF_LINELOOKUP *linetable,int fileindex,int line)
+{
+  const DWARF_LINELOOKUP *item;
+  const LINEINDEX *index;
+
+  assert(linetable!=NULL);
+  if ((index=line_findindex(linetable))!=NULL) {
+    unsigned low=0,high=index->linecount;
+    while (low<high) {
+      unsigned mid=low+(high-low)/2;
+      item=&index->lines[index->byline[mid]];
+      if (item->fileindex<fileindex || (item->fileindex==fileindex && item->line<line))
+        low=mid+1;
+      else
+        high=mid;
+    }
+    if (low<index->linecount) {
+      item=&index->lines[index->byline[low]];
+      if (item->fileindex==fileindex && item->line==line)
+        return item;
+    }
+    return NULL;
+  }
+  for (item=linetable->next; item!=NULL; item=item->next)
+    if (item->fileindex==fileindex && item->line==line)
+      return item;
+  return NULL;
+}
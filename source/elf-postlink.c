@@ -23,6 +23,7 @@
 #include <stdint.h>
 #include <stdlib.h>
 #include <string.h>
+#include "cksum.h"
 #include "elf.h"
 #include "svnrev.h"
 
@@ -31,11 +32,20 @@
 #define FLAG_MCU_LIST 0x02
 #define FLAG_ALLINFO  0xff
 
+#define OPT_CRP       0x01  /* report the code-read-protection level */
+#define OPT_CRC       0x02  /* report the CRC of the patched file */
+
 static void usage(int flags)
 {
   if (flags & FLAG_HEADER)
     printf("\nPostprocess an ELF file for requirements of specific micro-controllers.\n\n"
-           "Usage: elf-postlink [mcu] [elf-file]\n\n");
+           "Usage: elf-postlink [options] [mcu] [elf-file] [...]\n\n"
+           "Options:\n"
+           "\t-crp     - report the code-read-protection level of each file\n"
+           "\t-crc     - report the CRC checksum & size of each file (after\n"
+           "\t           patching), like the POSIX cksum utility\n"
+           "\t-v       - show version information\n\n"
+           "Multiple ELF files may be given; each is patched for the same MCU.\n\n");
   if (flags & FLAG_MCU_LIST)
     printf("MCU types:\n"
            "\tlpc8xx  - NXP LPC800, LPC810, LPC820, LPC830 and LPC840 Cortex-M0/M0+\n"
@@ -56,40 +66,24 @@ static void version(void)
   printf("Copyright 2019-2023 CompuPhase\nLicensed under the Apache License version 2.0\n");
 }
 
-int main(int argc, char *argv[])
+/* postlink() patches a single file and prints the result; it returns 0 on
+   success, or the usage information to show on failure */
+static int postlink(const char *filename, const char *mcu, int options, int multiple)
 {
   uint32_t chksum;
-  int result, idx_file, idx_type;
+  int result, crp;
   FILE *fp;
 
-  if (argc == 2 && strcmp(argv[1], "-v") == 0) {
-    version();
-    return EXIT_SUCCESS;
-  }
-  if (argc != 3) {
-    usage(FLAG_ALLINFO);
-    return EXIT_SUCCESS;
-  }
-
-  idx_type = 1; /* assume correct order of command-line options */
-  idx_file = 2;
-  fp = fopen(argv[idx_file], "rb+");
+  /* the file is opened once, for all operations */
+  fp = fopen(filename, "rb+");
   if (fp == NULL) {
-    /* test for inverted order of options */
-    fp = fopen(argv[idx_type], "rb+");
-    if (fp == NULL) {
-      /* failed too, this must be some error */
-      printf("File \"%s\" could not be opened.\n\n", argv[idx_file]);
-      usage(FLAG_ALLINFO);
-      return 0;
-    }
-    /* file open worked at inverted order, assume inverted order then */
-    idx_type = 2;
-    idx_file = 1;
+    printf("File \"%s\" could not be opened.\n\n", filename);
+    return FLAG_ALLINFO;
   }
+  if (multiple)
+    printf("%s: ", filename);
 
-  result = elf_patch_vecttable(fp, argv[idx_type], &chksum);
-  fclose(fp);
+  result = elf_patch_vecttable(fp, mcu, &chksum);
   switch (result) {
   case ELFERR_NONE:
     printf("Checksum set to 0x%08x\n", chksum);
@@ -98,15 +92,86 @@ int main(int argc, char *argv[])
     printf("Checksum already correct (0x%08x)\n", chksum);
     break;
   case ELFERR_UNKNOWNDRIVER:
-    printf("Unsupported MCU type \"%s\".\n", argv[idx_type]);
-    usage(FLAG_MCU_LIST);
-    break;
+    printf("Unsupported MCU type \"%s\".\n", mcu);
+    fclose(fp);
+    return FLAG_MCU_LIST;
   case ELFERR_FILEFORMAT:
-    printf("File \"%s\" has an unsupported format. A 32-bit ELF file is required\n", argv[idx_file]);
-    usage(FLAG_HEADER);
-    break;
+    printf("File \"%s\" has an unsupported format. A 32-bit ELF file is required\n", filename);
+    fclose(fp);
+    return FLAG_HEADER;
   }
 
-  return EXIT_SUCCESS;
+  if ((options & OPT_CRP) != 0) {
+    if (multiple)
+      printf("%s: ", filename);
+    if (elf_check_crp(fp, &crp) == ELFERR_NONE) {
+      if (crp == 0)
+        printf("No code-read-protection\n");
+      else if (crp == 4)
+        printf("Code-read-protection: NO_ISP\n");
+      else
+        printf("Code-read-protection: CRP%d\n", crp);
+    } else {
+      printf("Code-read-protection cannot be determined\n");
+    }
+  }
+
+  if ((options & OPT_CRC) != 0) {
+    uint32_t crc;
+    fflush(fp);   /* make sure that the patched vector table is included */
+    crc = cksum(fp);
+    printf("%10lu %10lu   %s\n", (unsigned long)crc, (unsigned long)ftell(fp), filename);
+  }
+
+  fclose(fp);
+  return 0;
 }
 
+int main(int argc, char *argv[])
+{
+  int idx, idx_type, options, multiple, flags;
+  FILE *fp;
+
+  options = 0;
+  for (idx = 1; idx < argc && argv[idx][0] == '-'; idx++) {
+    if (strcmp(argv[idx], "-v") == 0) {
+      version();
+      return EXIT_SUCCESS;
+    } else if (strcmp(argv[idx], "-crp") == 0) {
+      options |= OPT_CRP;
+    } else if (strcmp(argv[idx], "-crc") == 0) {
+      options |= OPT_CRC;
+    } else {
+      usage(FLAG_ALLINFO);
+      return EXIT_SUCCESS;
+    }
+  }
+  if (argc - idx < 2) {
+    usage(FLAG_ALLINFO);
+    return EXIT_SUCCESS;
+  }
+
+  /* the MCU type comes before the ELF files, but for compatibility the
+     inverted order is accepted too (MCU type last) */
+  idx_type = idx;
+  fp = fopen(argv[idx_type], "rb");
+  if (fp != NULL) {
+    fclose(fp);
+    idx_type = argc - 1;
+  }
+
+  multiple = (argc - idx > 2);
+  for ( ; idx < argc; idx++) {
+    if (idx == idx_type)
+      continue;
+    flags = postlink(argv[idx], argv[idx_type], options, multiple);
+    if (flags == FLAG_MCU_LIST) {
+      usage(flags);
+      break;  /* no use trying the other files */
+    } else if (flags != 0 && !multiple) {
+      usage(flags);
+    }
+  }
+
+  return EXIT_SUCCESS;
+}
@@ -230,10 +230,212 @@ typedef struct tagELF32SYMBOL {
 #define SWAP32(v)     ((((v) >> 24) & 0xff) | (((v) & 0xff0000) >> 8) | (((v) & 0xff00) << 8)  | (((v) & 0xff) << 24))
 
 
-/** elf_info() verifies that the file is an ELF executable and returns important
- *  fields from the header.
+/* The ELF_FILE structure holds the file header, the program header table and
+   the section header table of an ELF file, plus the section names, all in
+   native byte order. Only the fields that are needed are kept. */
+typedef struct tagELF_SEGMENTINFO {
+  uint32_t type;
+  uint32_t flags;
+  uint32_t offset;
+  uint32_t filesz;
+  uint32_t vaddr;
+  uint32_t paddr;
+  uint32_t memsz;
+} ELF_SEGMENTINFO;
+
+typedef struct tagELF_SECTIONINFO {
+  uint32_t name;        /* index in the section name table */
+  uint32_t type;
+  uint32_t addr;
+  uint32_t offset;
+  uint32_t size;
+} ELF_SECTIONINFO;
+
+struct tagELF_FILE {
+  int wordsize;         /* 32 or 64 */
+  int bigendian;
+  int machine;
+  unsigned long entry;
+  int has_phdr;         /* whether the file has a program header table */
+  int has_shdr;         /* whether the file has a section header table */
+  ELF_SEGMENTINFO *segments;
+  int numsegments;
+  ELF_SECTIONINFO *sections;
+  int numsections;
+  char *names;          /* section names (shstrtab), always zero-terminated */
+  uint32_t namesize;
+};
+
+static uint16_t elf_get16(uint16_t v,int bigendian)
+{
+  return bigendian ? (uint16_t)SWAP16(v) : v;
+}
+
+static uint32_t elf_get32(uint32_t v,int bigendian)
+{
+  return bigendian ? (uint32_t)SWAP32(v) : v;
+}
+
+/** elf_open() reads the headers of an ELF file, so that queries for segments
+ *  and sections can be answered without further access to the file.
  *
  *  \param fp           [in] File handle to the ELF file.
+ *  \param error        [out] Set to an error code. This parameter may be NULL.
+ *
+ *  \return A handle to the ELF information, or NULL on failure. The handle must
+ *          be freed with elf_close().
+ *
+ *  \note   Only the headers are read, so the file must stay open for reading
+ *          section or segment data. The handle becomes invalid when the file
+ *          is modified.
+ */
+ELF_FILE *elf_open(FILE *fp,int *error)
+{
+  ELF32HDR hdr;
+  ELF_FILE *elf;
+  int err=ELFERR_NONE;
+
+  assert(fp!=NULL);
+  memset(&hdr,0,sizeof(hdr));
+  fseek(fp,0,SEEK_SET);
+  fread(&hdr,sizeof(hdr),1,fp);
+  if (memcmp(hdr.magic,"\177ELF",4)!=0) {
+    if (error!=NULL)
+      *error=ELFERR_FILEFORMAT; /* magic not found, not a valid ELF file */
+    return NULL;
+  }
+  if ((elf=(ELF_FILE*)malloc(sizeof(ELF_FILE)))==NULL) {
+    if (error!=NULL)
+      *error=ELFERR_MEMORY;
+    return NULL;
+  }
+  memset(elf,0,sizeof(ELF_FILE));
+  elf->wordsize=(hdr.wordsize==1) ? 32 : 64;
+  elf->bigendian=(hdr.endian==2);
+  elf->machine=elf_get16(hdr.machine,elf->bigendian);
+  elf->has_phdr=(hdr.phoff!=0);
+  elf->has_shdr=(hdr.shoff!=0);
+
+  if (hdr.wordsize!=1) {
+    /* for 64-bit files, only the file header is used */
+    ELF64HDR hdr64;
+    fseek(fp,0,SEEK_SET);
+    fread(&hdr64,sizeof(hdr64),1,fp);
+    elf->entry=(unsigned long)hdr64.entry;
+    if (error!=NULL)
+      *error=ELFERR_NONE;
+    return elf;
+  }
+  elf->entry=elf_get32(hdr.entry,elf->bigendian);
+
+  /* the program header table, read in a single block */
+  if (elf->has_phdr) {
+    uint32_t offs=elf_get32(hdr.phoff,elf->bigendian);
+    int num=elf_get16(hdr.phnum,elf->bigendian);
+    ELF32PROGRAM *table;
+    if (elf_get16(hdr.phentsize,elf->bigendian)!=sizeof(ELF32PROGRAM)) {
+      err=ELFERR_FILEFORMAT;
+    } else if (num>0) {
+      if ((table=(ELF32PROGRAM*)malloc(num*sizeof(ELF32PROGRAM)))!=NULL
+          && (elf->segments=(ELF_SEGMENTINFO*)malloc(num*sizeof(ELF_SEGMENTINFO)))!=NULL)
+      {
+        int idx;
+        memset(table,0,num*sizeof(ELF32PROGRAM));
+        fseek(fp,offs,SEEK_SET);
+        fread(table,sizeof(ELF32PROGRAM),num,fp);
+        for (idx=0; idx<num; idx++) {
+          ELF_SEGMENTINFO *seg=&elf->segments[idx];
+          seg->type=elf_get32(table[idx].type,elf->bigendian);
+          seg->flags=elf_get32(table[idx].flags,elf->bigendian);
+          seg->offset=elf_get32(table[idx].offset,elf->bigendian);
+          seg->filesz=elf_get32(table[idx].filesz,elf->bigendian);
+          seg->vaddr=elf_get32(table[idx].vaddr,elf->bigendian);
+          seg->paddr=elf_get32(table[idx].paddr,elf->bigendian);
+          seg->memsz=elf_get32(table[idx].memsz,elf->bigendian);
+        }
+        elf->numsegments=num;
+      } else {
+        err=ELFERR_MEMORY;
+      }
+      if (table!=NULL)
+        free(table);
+    }
+  }
+
+  /* the section header table, also in a single block, and the section names */
+  if (elf->has_shdr && err==ELFERR_NONE) {
+    uint32_t offs=elf_get32(hdr.shoff,elf->bigendian);
+    int num=elf_get16(hdr.shnum,elf->bigendian);
+    int strindex=elf_get16(hdr.shtrndx,elf->bigendian);
+    ELF32SECTION *table;
+    if (elf_get16(hdr.shentsize,elf->bigendian)!=sizeof(ELF32SECTION)) {
+      err=ELFERR_FILEFORMAT;
+    } else if (num>0) {
+      if ((table=(ELF32SECTION*)malloc(num*sizeof(ELF32SECTION)))!=NULL
+          && (elf->sections=(ELF_SECTIONINFO*)malloc(num*sizeof(ELF_SECTIONINFO)))!=NULL)
+      {
+        int idx;
+        memset(table,0,num*sizeof(ELF32SECTION));
+        fseek(fp,offs,SEEK_SET);
+        fread(table,sizeof(ELF32SECTION),num,fp);
+        for (idx=0; idx<num; idx++) {
+          ELF_SECTIONINFO *sect=&elf->sections[idx];
+          sect->name=elf_get32(table[idx].name,elf->bigendian);
+          sect->type=elf_get32(table[idx].type,elf->bigendian);
+          sect->addr=elf_get32(table[idx].addr,elf->bigendian);
+          sect->offset=elf_get32(table[idx].offset,elf->bigendian);
+          sect->size=elf_get32(table[idx].size,elf->bigendian);
+        }
+        elf->numsections=num;
+      } else {
+        err=ELFERR_MEMORY;
+      }
+      if (table!=NULL)
+        free(table);
+    }
+    if (err==ELFERR_NONE && strindex<elf->numsections) {
+      const ELF_SECTIONINFO *strtab=&elf->sections[strindex];
+      if ((elf->names=(char*)malloc(strtab->size+1))!=NULL) {
+        memset(elf->names,0,strtab->size+1);
+        fseek(fp,strtab->offset,SEEK_SET);
+        fread(elf->names,1,strtab->size,fp);
+        elf->namesize=strtab->size;
+      } else {
+        err=ELFERR_MEMORY;
+      }
+    }
+  }
+
+  if (err!=ELFERR_NONE) {
+    elf_close(elf);
+    elf=NULL;
+  }
+  if (error!=NULL)
+    *error=err;
+  return elf;
+}
+
+/** elf_close() frees the handle returned by elf_open(). The file itself is
+ *  not closed.
+ *
+ *  \param elf          The handle; this parameter may be NULL.
+ */
+void elf_close(ELF_FILE *elf)
+{
+  if (elf!=NULL) {
+    if (elf->segments!=NULL)
+      free(elf->segments);
+    if (elf->sections!=NULL)
+      free(elf->sections);
+    if (elf->names!=NULL)
+      free(elf->names);
+    free(elf);
+  }
+}
+
+/** elf_file_info() returns important fields from the header of an ELF file.
+ *
+ *  \param elf          [in] The handle returned by elf_open().
  *  \param wordsize     [out] Set to the size of a "word" in bits, either 32 or
  *                      64. This parameter may be NULL.
  *  \param bigendian    [out] Set to 1 if the ELF file uses Big Endian byte
@@ -245,10 +447,8 @@ typedef struct tagELF32SYMBOL {
  *
  *  \return An error code.
  */
-int elf_info(FILE *fp,int *wordsize,int *bigendian,int *machine,unsigned long *entry_addr)
+int elf_file_info(const ELF_FILE *elf,int *wordsize,int *bigendian,int *machine,unsigned long *entry_addr)
 {
-  ELF32HDR hdr;
-
   if (wordsize!=NULL)
     *wordsize=0;
   if (bigendian!=NULL)
@@ -256,86 +456,199 @@ int elf_info(FILE *fp,int *wordsize,int *bigendian,int *machine,unsigned long *e
   if (machine!=NULL)
     *machine=0;
 
-  memset(&hdr,0,sizeof(hdr));
-  fseek(fp,0,SEEK_SET);
-  fread(&hdr,sizeof(hdr),1,fp);
-  if (memcmp(hdr.magic,"\177ELF",4)!=0)
-    return ELFERR_FILEFORMAT; /* magic not found, not a valid ELF file */
-  if (hdr.shoff==0)
+  if (elf==NULL)
+    return ELFERR_FILEFORMAT;
+  if (!elf->has_shdr)
     return ELFERR_FILEFORMAT; /* we consider an ELF file without section header table as invalid */
 
   if (wordsize!=NULL)
-    *wordsize=(hdr.wordsize==1) ? 32 : 64;
-
+    *wordsize=elf->wordsize;
   if (bigendian!=NULL)
-    *bigendian=(hdr.endian==2);
-
+    *bigendian=elf->bigendian;
   if (machine!=NULL)
-    *machine=(hdr.endian==2) ? SWAP16(hdr.machine) : hdr.machine;
+    *machine=elf->machine;
+  if (entry_addr!=NULL)
+    *entry_addr=elf->entry;
 
-  if (entry_addr!=NULL) {
-    if (hdr.wordsize==1) {
-      *entry_addr=hdr.entry;
-    } else {
-      ELF64HDR hdr64;
-      fseek(fp,0,SEEK_SET);
-      fread(&hdr64,sizeof(hdr64),1,fp);
-      *entry_addr=(unsigned long)hdr64.entry;
+  return ELFERR_NONE;
+}
+
+/** elf_file_segment() returns information on a segment ("program" in ELF
+ *  jargon). See elf_segment_by_index() for a description of the parameters;
+ *  the difference is that this function takes a handle returned by
+ *  elf_open().
+ *
+ *  \return An error code.
+ */
+int elf_file_segment(const ELF_FILE *elf,int index,
+                     int *type, int *flags,
+                     unsigned long *offset,unsigned long *filesize,
+                     unsigned long *vaddr,unsigned long *paddr,
+                     unsigned long *memsize)
+{
+  const ELF_SEGMENTINFO *segment;
+
+  assert(index>=0);
+  if (type!=NULL)
+    *type=-1;
+  if (offset!=NULL)
+    *offset=0;
+  if (filesize!=NULL)
+    *filesize=0;
+  if (vaddr!=NULL)
+    *vaddr=0;
+  if (paddr!=NULL)
+    *paddr=0;
+  if (memsize!=NULL)
+    *memsize=0;
+
+  if (elf==NULL || elf->wordsize!=32)
+    return ELFERR_FILEFORMAT; /* 64-bit is not yet supported */
+  if (!elf->has_phdr)
+    return ELFERR_FILEFORMAT; /* consider an ELF file without program header table as invalid */
+  if (index>=elf->numsegments)
+    return ELFERR_NOMATCH;    /* requested segment not present */
+
+  segment=&elf->segments[index];
+  if (type!=NULL)
+    *type=segment->type;
+  if (flags!=NULL)
+    *flags=segment->flags;
+  if (offset!=NULL)
+    *offset=segment->offset;
+  if (filesize!=NULL)
+    *filesize=segment->filesz;
+  if (vaddr!=NULL)
+    *vaddr=segment->vaddr;
+  if (paddr!=NULL)
+    *paddr=segment->paddr;
+  if (memsize!=NULL)
+    *memsize=segment->memsz;
+
+  return ELFERR_NONE;
+}
+
+/** elf_file_section_by_name() retrieves the file offset to requested section
+ *  plus its length. See elf_section_by_name() for a description of the
+ *  parameters; the difference is that this function takes a handle returned
+ *  by elf_open().
+ *
+ *  \return An error code.
+ */
+int elf_file_section_by_name(const ELF_FILE *elf,const char *sectionname,unsigned long *offset,
+                             unsigned long *address,unsigned long *length)
+{
+  int idx;
+
+  assert(sectionname!=NULL && strlen(sectionname)>0);
+  if (offset!=NULL)
+    *offset=0;
+  if (address!=NULL)
+    *address=0;
+  if (length!=NULL)
+    *length=0;
+
+  if (elf==NULL || elf->wordsize!=32)
+    return ELFERR_FILEFORMAT; /* 64-bit is not yet supported */
+  if (!elf->has_shdr)
+    return ELFERR_FILEFORMAT; /* consider an ELF file without section header table as invalid */
+
+  for (idx=0; idx<elf->numsections; idx++) {
+    const ELF_SECTIONINFO *section=&elf->sections[idx];
+    if (section->name<elf->namesize && strcmp(elf->names+section->name,sectionname)==0) {
+      if (offset!=NULL)
+        *offset=section->offset;
+      if (address!=NULL)
+        *address=section->addr;
+      if (length!=NULL)
+        *length=section->size;
+      return ELFERR_NONE;
     }
   }
 
-  return ELFERR_NONE;
+  return ELFERR_NOMATCH;
 }
 
-static int seek_shstrtab(FILE *fp,uint32_t *offset,uint32_t *size)
+/** elf_file_section_by_address() finds the first section at or after a given
+ *  address. See elf_section_by_address() for a description of the parameters;
+ *  the difference is that this function takes a handle returned by
+ *  elf_open().
+ *
+ *  \return An error code.
+ */
+int elf_file_section_by_address(const ELF_FILE *elf,unsigned long baseaddr,
+                                char *sectionname,size_t namelength,unsigned long *offset,
+                                unsigned long *address,unsigned long *length)
 {
-  ELF32HDR hdr;
-  ELF32SECTION section;
-  uint32_t offs;
-  uint16_t idx,entrysize;
+  const ELF_SECTIONINFO *nearest;
+  int idx;
 
-  assert(fp!=NULL);
-  assert(offset!=NULL);
-  assert(size!=NULL);
+  if (sectionname!=NULL && namelength>0)
+    *sectionname='\0';
+  if (offset!=NULL)
+    *offset=0;
+  if (address!=NULL)
+    *address=0;
+  if (length!=NULL)
+    *length=0;
 
-  memset(&hdr,0,sizeof(hdr));
-  fseek(fp,0,SEEK_SET);
-  fread(&hdr,sizeof(hdr),1,fp);
-  if (memcmp(hdr.magic,"\177ELF",4)!=0)
-    return ELFERR_FILEFORMAT; /* magic not found, not a valid ELF file */
-  assert(hdr.wordsize==1);    /* not yet implemented for 64-bit */
-  assert(hdr.shoff!=0);
-
-  offs=hdr.shoff;
-  idx=hdr.shtrndx;
-  entrysize=hdr.shentsize;
-  if (hdr.endian==2) {
-    offs=SWAP32(offs);
-    idx=SWAP16(idx);
-    entrysize=SWAP16(entrysize);
+  if (elf==NULL || !elf->has_shdr)
+    return ELFERR_FILEFORMAT; /* we consider an ELF file without section header table as invalid */
+  if (elf->wordsize!=32)
+    return ELFERR_FILEFORMAT; /* 64-bit is not yet supported */
+
+  /* find the section nearest (but not below) the base address */
+  nearest=NULL;
+  for (idx=0; idx<elf->numsections; idx++) {
+    const ELF_SECTIONINFO *section=&elf->sections[idx];
+    if (section->type!=SHT_PROGBITS || section->size==0)
+      continue;
+    if (section->addr>=baseaddr && (nearest==NULL || section->addr<nearest->addr))
+      nearest=section;
   }
-  assert(entrysize==sizeof(section));
-  fseek(fp,offs+idx*entrysize,SEEK_SET);
-  fread(&section,sizeof(section),1,fp);
-  *offset=(hdr.endian==2) ? SWAP32(section.offset) : section.offset;
-  *size=(hdr.endian==2) ? SWAP32(section.size) : section.size;
-  fseek(fp,*offset,SEEK_SET);
+  if (nearest==NULL)
+    return ELFERR_NOMATCH;
+
+  if (offset!=NULL)
+    *offset=nearest->offset;
+  if (address!=NULL)
+    *address=nearest->addr;
+  if (length!=NULL)
+    *length=nearest->size;
+  if (sectionname!=NULL && namelength>0 && nearest->name<elf->namesize)
+    strlcpy(sectionname,elf->names+nearest->name,namelength);
+
   return ELFERR_NONE;
 }
 
-static const char *read_sectionnames(FILE *fp,uint32_t *size)
+/** elf_info() verifies that the file is an ELF executable and returns important
+ *  fields from the header.
+ *
+ *  \param fp           [in] File handle to the ELF file.
+ *  \param wordsize     [out] Set to the size of a "word" in bits, either 32 or
+ *                      64. This parameter may be NULL.
+ *  \param bigendian    [out] Set to 1 if the ELF file uses Big Endian byte
+ *                      order. This parameter may be NULL.
+ *  \param machine      [out] Set to an identifier for the processor
+ *                      architecture. This parameter may be NULL.
+ *  \param entry_addr   [out] Set to the address of the entry point. This
+ *                      parameter may be set to NULL.
+ *
+ *  \return An error code.
+ *
+ *  \note   When looking up several sections or segments, it is more efficient
+ *          to open the file with elf_open() and to use the elf_file_...()
+ *          functions.
+ */
+int elf_info(FILE *fp,int *wordsize,int *bigendian,int *machine,unsigned long *entry_addr)
 {
-  char *stringtable;
-  uint32_t offset;
-  int err=seek_shstrtab(fp,&offset,size);
-  if (err!=ELFERR_NONE)
-    return NULL;
-
-  stringtable=malloc(*size);
-  if (stringtable==NULL)
-    return NULL;
-  fread(stringtable,1,*size,fp);
-  return stringtable;
+  int err;
+  ELF_FILE *elf=elf_open(fp,&err);
+  int result=elf_file_info(elf,wordsize,bigendian,machine,entry_addr);
+  if (elf==NULL)
+    return err;
+  elf_close(elf);
+  return result;
 }
 
 /** elf_segment_by_index() returns information on a segment ("program" in ELF
@@ -368,66 +681,13 @@ int elf_segment_by_index(FILE *fp,int index,
                          unsigned long *vaddr,unsigned long *paddr,
                          unsigned long *memsize)
 {
-  ELF32HDR hdr;
-
-  assert(index>=0);
-  if (type!=NULL)
-    *type=-1;
-  if (offset!=NULL)
-    *offset=0;
-  if (filesize!=NULL)
-    *filesize=0;
-  if (vaddr!=NULL)
-    *vaddr=0;
-  if (paddr!=NULL)
-    *paddr=0;
-  if (memsize!=NULL)
-    *memsize=0;
-
-  memset(&hdr,0,sizeof(hdr));
-  fseek(fp,0,SEEK_SET);
-  fread(&hdr,sizeof(hdr),1,fp);
-  if (memcmp(hdr.magic,"\177ELF",4)!=0)
-    return ELFERR_FILEFORMAT;  /* magic not found, not a valid ELF file */
-
-  if (hdr.wordsize==1) {
-    ELF32PROGRAM segment;
-    uint32_t offs=hdr.phoff;
-    int num=hdr.phnum;
-    int size=hdr.phentsize;
-
-    if (hdr.endian==2) {
-      offs=SWAP32(offs);
-      num=SWAP16(num);
-      size=SWAP16(size);
-    }
-    if (offs==0)
-      return ELFERR_FILEFORMAT;/* consider an ELF file without program header table as invalid */
-    if (index>=num)
-      return ELFERR_NOMATCH;   /* requested segment not present */
-    assert(size==sizeof(segment));
-    fseek(fp,offs+index*size,SEEK_SET);
-    fread(&segment,sizeof(segment),1,fp);
-    if (type!=NULL)
-      *type=(hdr.endian==2) ? SWAP32(segment.type) : segment.type;
-    if (flags!=NULL)
-      *flags=(hdr.endian==2) ? SWAP32(segment.flags) : segment.flags;
-    if (offset!=NULL)
-      *offset=(hdr.endian==2) ? SWAP32(segment.offset) : segment.offset;
-    if (filesize!=NULL)
-      *filesize=(hdr.endian==2) ? SWAP32(segment.filesz) : segment.filesz;
-    if (vaddr!=NULL)
-      *vaddr=(hdr.endian==2) ? SWAP32(segment.vaddr) : segment.vaddr;
-    if (paddr!=NULL)
-      *paddr=(hdr.endian==2) ? SWAP32(segment.paddr) : segment.paddr;
-    if (memsize!=NULL)
-      *memsize=(hdr.endian==2) ? SWAP32(segment.memsz) : segment.memsz;
-  } else {
-    //??? re-read the header, but now using the 64-bit structure
-    return ELFERR_FILEFORMAT;
-  }
-
-  return ELFERR_NONE;
+  int err;
+  ELF_FILE *elf=elf_open(fp,&err);
+  int result=elf_file_segment(elf,index,type,flags,offset,filesize,vaddr,paddr,memsize);
+  if (elf==NULL)
+    return err;
+  elf_close(elf);
+  return result;
 }
 
 /** elf_section_by_name() verifies that the file is an ELF executable and
@@ -442,82 +702,18 @@ int elf_segment_by_index(FILE *fp,int index,
  *  \param length       [out] Set to the length of the section in the ELF file.
  *                      This parameter may be NULL.
  *
- *  \return An error code.
+ *  \return An error code; ELFERR_NOMATCH if the section is not present.
  */
 int elf_section_by_name(FILE *fp,const char *sectionname,unsigned long *offset,
                         unsigned long *address,unsigned long *length)
 {
-  ELF32HDR hdr;
-
-  assert(sectionname!=NULL && strlen(sectionname)>0);
-  if (offset!=NULL)
-    *offset=0;
-  if (address!=NULL)
-    *address=0;
-  if (length!=NULL)
-    *length=0;
-
-  memset(&hdr,0,sizeof(hdr));
-  fseek(fp,0,SEEK_SET);
-  fread(&hdr,sizeof(hdr),1,fp);
-  if (memcmp(hdr.magic,"\177ELF",4)!=0)
-    return ELFERR_FILEFORMAT; /* magic not found, not a valid ELF file */
-
-  if (hdr.wordsize==1) {
-    ELF32SECTION section;
-    uint32_t offs=hdr.shoff;
-    int num=hdr.shnum;
-    int size=hdr.shentsize;
-    int idx=hdr.shtrndx;
-    const char *stringtable;
-    int idx_section=-1;
-
-    if (hdr.endian==2) {
-      offs=SWAP32(offs);
-      num=SWAP16(num);
-      size=SWAP16(size);
-      idx=SWAP16(idx);
-    }
-    if (offs==0)
-      return ELFERR_FILEFORMAT; /* consider an ELF file without section header table as invalid */
-    assert(size==sizeof(section));
-    /* get the string table first, to find the index of the requested section */
-    stringtable=read_sectionnames(fp,(uint32_t*)&size);
-    if (stringtable!=NULL) {
-      const char *ptr=stringtable;
-      while (ptr-stringtable<size && idx_section==-1) {
-        if (strcmp(ptr,sectionname)==0)
-          idx_section=(int)(ptr-stringtable);  /* this is the index in the string table */
-        ptr+=strlen(ptr)+1;
-      }
-      free((void*)stringtable);
-    }
-    /* now find the section that has the index that is found */
-    offs=hdr.shoff;
-    if (hdr.endian==2)
-      offs=SWAP32(offs);
-    fseek(fp,offs,SEEK_SET);
-    for (idx=0; idx<num; idx++) {
-      int nidx;
-      fread(&section,sizeof(section),1,fp);
-      nidx= (hdr.endian==2) ? SWAP32(section.name) : section.name;
-      if (nidx==idx_section) {
-        if (offset!=NULL)
-          *offset=(hdr.endian==2) ? SWAP32(section.offset) : section.offset;
-        if (address!=NULL)
-          *address=(hdr.endian==2) ? SWAP32(section.addr) : section.addr;
-        if (length!=NULL)
-          *length=(hdr.endian==2) ? SWAP32(section.size) : section.size;
-        break;  /* no need to search further */
-      }
-    }
-
-  } else {
-    //??? re-read the header, but now using the 64-bit structure
-    return ELFERR_FILEFORMAT;
-  }
-
-  return ELFERR_NONE;
+  int err;
+  ELF_FILE *elf=elf_open(fp,&err);
+  int result=elf_file_section_by_name(elf,sectionname,offset,address,length);
+  if (elf==NULL)
+    return err;
+  elf_close(elf);
+  return result;
 }
 
 /** elf_section_by_address() finds the first section at or after a given
@@ -544,86 +740,230 @@ int elf_section_by_address(FILE *fp,unsigned long baseaddr,
                            char *sectionname,size_t namelength,unsigned long *offset,
                            unsigned long *address,unsigned long *length)
 {
-  ELF32HDR hdr;
+  int err;
+  ELF_FILE *elf=elf_open(fp,&err);
+  int result=elf_file_section_by_address(elf,baseaddr,sectionname,namelength,offset,address,length);
+  if (elf==NULL)
+    return err;
+  elf_close(elf);
+  return result;
+}
 
-  if (sectionname!=NULL && namelength>0)
-    *sectionname='\0';
-  if (offset!=NULL)
-    *offset=0;
-  if (address!=NULL)
-    *address=0;
-  if (length!=NULL)
-    *length=0;
+/* the sort key for symbols; on ARM, the low bit of the address is set for Thumb
+   functions (and is irrelevant for the sort order) */
+static unsigned long symtab_key(const ELF_SYMTAB *table,const ELF_SYMBOL *sym)
+{
+  return (table->thumbbit && sym->is_func) ? (sym->address & ~1ul) : sym->address;
+}
 
-  memset(&hdr,0,sizeof(hdr));
-  fseek(fp,0,SEEK_SET);
-  fread(&hdr,sizeof(hdr),1,fp);
-  if (memcmp(hdr.magic,"\177ELF",4)!=0)
-    return ELFERR_FILEFORMAT; /* magic not found, not a valid ELF file */
-  if (hdr.shoff==0)
-    return ELFERR_FILEFORMAT; /* we consider an ELF file without section header table as invalid */
+static const ELF_SYMTAB *symtab_sortbase = NULL;  /* used by the sort callbacks */
 
-  if (hdr.wordsize==1) {
-    ELF32SECTION section;
-    uint32_t offs=hdr.shoff;
-    int num=hdr.shnum;
-    int size=hdr.shentsize;
-    int idx,nearest_idx;
-    uint32_t nearest_addr;
-    int idx_section;
-
-    if (hdr.endian==2) {
-      offs=SWAP32(offs);
-      num=SWAP16(num);
-      size=SWAP16(size);
-    }
-    assert(size==sizeof(section));
-
-    /* find the section index nearest (but not below) the base address */
-    idx_section=0;
-    nearest_idx=-1;
-    nearest_addr=UINT_MAX;
-    fseek(fp,offs,SEEK_SET);
-    for (idx=0; idx<num; idx++) {
-      uint32_t addr;
-      fread(&section,sizeof(section),1,fp);
-      if (section.type!=SHT_PROGBITS || section.size==0)
-        continue;
-      addr=(hdr.endian==2) ? SWAP32(section.addr) : section.addr;
-      if (addr>=baseaddr && addr<nearest_addr) {
-        nearest_addr=addr;
-        nearest_idx=idx;
-        idx_section=(hdr.endian==2) ? SWAP32(section.name) : section.name;
-        if (offset!=NULL)
-          *offset=(hdr.endian==2) ? SWAP32(section.offset) : section.offset;
-        if (address!=NULL)
-          *address=(hdr.endian==2) ? SWAP32(section.addr) : section.addr;
-        if (length!=NULL)
-          *length=(hdr.endian==2) ? SWAP32(section.size) : section.size;
-      }
-    }
-    if (nearest_idx<0)
-      return ELFERR_NOMATCH;
-
-    /* look up the section name in the string table */
-    if (sectionname!=NULL && namelength>0) {
-      uint32_t tblsize;
-      const char *stringtable=read_sectionnames(fp,&tblsize);
-      if (stringtable!=NULL) {
-        const char *ptr=stringtable+idx_section;
-        strlcpy(sectionname,ptr,namelength);
-        free((void*)stringtable);
-      }
-    }
+static int symtab_cmp_address(const void *p1,const void *p2)
+{
+  unsigned i1=*(const unsigned*)p1;
+  unsigned i2=*(const unsigned*)p2;
+  unsigned long a1,a2;
+  assert(symtab_sortbase!=NULL);
+  a1=symtab_key(symtab_sortbase,&symtab_sortbase->symbols[i1]);
+  a2=symtab_key(symtab_sortbase,&symtab_sortbase->symbols[i2]);
+  if (a1!=a2)
+    return (a1<a2) ? -1 : 1;
+  /* keep the order of the symbol table for symbols at the same address */
+  return (i1<i2) ? -1 : (i1>i2) ? 1 : 0;
+}
 
-  } else {
-    //??? re-read the header, but now using the 64-bit structure
-    return ELFERR_FILEFORMAT;
+static int symtab_cmp_name(const void *p1,const void *p2)
+{
+  unsigned i1=*(const unsigned*)p1;
+  unsigned i2=*(const unsigned*)p2;
+  int result;
+  assert(symtab_sortbase!=NULL);
+  if ((result=strcmp(symtab_sortbase->symbols[i1].name,symtab_sortbase->symbols[i2].name))!=0)
+    return result;
+  return (i1<i2) ? -1 : (i1>i2) ? 1 : 0;
+}
+
+/** elf_symtab_load() loads the symbol table from an ELF file (if one is
+ *  present). Only functions and variables are loaded. The symbol table and
+ *  its string table are read in one block each, and the symbol names point
+ *  into the string table (they are not copied).
+ *
+ *  \param fp         [in] The file poiner to the ELF file.
+ *  \param table      [out] Will hold the symbols, sorted on address. The table
+ *                    must be freed with elf_symtab_free().
+ *
+ *  \return An error value.
+ */
+int elf_symtab_load(FILE *fp,ELF_SYMTAB *table)
+{
+  unsigned long stroffset,strlength,symoffset,symlength;
+  ELF32SYMBOL *rawtable;
+  ELF_SYMBOL *sorted;
+  ELF_FILE *elf;
+  int bigendian,machine,err;
+  unsigned idx,total;
+
+  assert(table!=NULL);
+  memset(table,0,sizeof(ELF_SYMTAB));
+
+  /* locate the symbol string table and the symbol table */
+  assert(fp!=NULL);
+  if ((elf=elf_open(fp,&err))==NULL)
+    return err;
+  err=elf_file_info(elf,NULL,&bigendian,&machine,NULL);
+  if (err==ELFERR_NONE)
+    err=elf_file_section_by_name(elf,".strtab",&stroffset,NULL,&strlength);
+  if (err==ELFERR_NONE)
+    err=elf_file_section_by_name(elf,".symtab",&symoffset,NULL,&symlength);
+  elf_close(elf);
+  if (err!=ELFERR_NONE)
+    return err;
+  table->thumbbit=(machine==EM_ARM);
+
+  /* read both tables (add a terminating zero to the string table, to be sure
+     that all names are terminated) */
+  total=symlength/sizeof(ELF32SYMBOL);
+  table->strings=(char*)malloc(strlength+1);
+  rawtable=(ELF32SYMBOL*)malloc((total+1)*sizeof(ELF32SYMBOL));
+  table->symbols=(ELF_SYMBOL*)malloc((total+1)*sizeof(ELF_SYMBOL));
+  table->byname=(unsigned*)malloc((total+1)*sizeof(unsigned));
+  if (table->strings==NULL || rawtable==NULL || table->symbols==NULL || table->byname==NULL) {
+    if (rawtable!=NULL)
+      free(rawtable);
+    elf_symtab_free(table);
+    return ELFERR_MEMORY;
   }
+  memset(table->strings,0,strlength+1);
+  fseek(fp,stroffset,SEEK_SET);
+  fread(table->strings,1,strlength,fp);
+  memset(rawtable,0,total*sizeof(ELF32SYMBOL));
+  fseek(fp,symoffset,SEEK_SET);
+  fread(rawtable,sizeof(ELF32SYMBOL),total,fp);
+
+  for (idx=0; idx<total; idx++) {
+    const ELF32SYMBOL *sym=&rawtable[idx];
+    uint32_t name=elf_get32(sym->name,bigendian);
+    int type=sym->info & 0x0f;
+    ELF_SYMBOL *entry;
+    if (name==0 || name>=strlength)
+      continue; /* ignore anonymous symbols */
+    if (type!=STT_OBJECT && type!=STT_FUNC && type!=STT_COMMON)
+      continue; /* collect only functions & variables */
+    entry=&table->symbols[table->count++];
+    entry->name=table->strings+name;
+    entry->address=elf_get32(sym->addr,bigendian);
+    entry->size=elf_get32(sym->size,bigendian);
+    entry->is_func=(type==STT_FUNC);
+    entry->is_ext=(((sym->info >> 4) & 1)!=0);
+  }
+  free(rawtable);
+
+  /* sort on address (via an index array, because qsort() is not stable), then
+     make the index on name */
+  if ((sorted=(ELF_SYMBOL*)malloc((table->count+1)*sizeof(ELF_SYMBOL)))==NULL) {
+    elf_symtab_free(table);
+    return ELFERR_MEMORY;
+  }
+  symtab_sortbase=table;
+  for (idx=0; idx<table->count; idx++)
+    table->byname[idx]=idx;
+  qsort(table->byname,table->count,sizeof(unsigned),symtab_cmp_address);
+  for (idx=0; idx<table->count; idx++)
+    sorted[idx]=table->symbols[table->byname[idx]];
+  free(table->symbols);
+  table->symbols=sorted;
+  for (idx=0; idx<table->count; idx++)
+    table->byname[idx]=idx;
+  qsort(table->byname,table->count,sizeof(unsigned),symtab_cmp_name);
+  symtab_sortbase=NULL;
 
   return ELFERR_NONE;
 }
 
+/** elf_symtab_free() frees the memory of a table loaded with
+ *  elf_symtab_load().
+ */
+void elf_symtab_free(ELF_SYMTAB *table)
+{
+  assert(table!=NULL);
+  if (table->symbols!=NULL)
+    free(table->symbols);
+  if (table->byname!=NULL)
+    free(table->byname);
+  if (table->strings!=NULL)
+    free(table->strings);
+  memset(table,0,sizeof(ELF_SYMTAB));
+}
+
+/** elf_symtab_by_address() looks up a symbol on its address.
+ *
+ *  \param table      [in] The table loaded with elf_symtab_load().
+ *  \param address    The address to look up; for ARM, the low bit of the
+ *                    address of a function is ignored.
+ *  \param exact      If zero, the symbol with the highest address below the
+ *                    requested address is returned if there is no exact match.
+ *
+ *  \return A pointer to the symbol, or NULL if no symbol matches. On more
+ *          symbols at the same address, the first one in the ELF symbol table
+ *          is returned.
+ */
+const ELF_SYMBOL *elf_symtab_by_address(const ELF_SYMTAB *table,unsigned long address,int exact)
+{
+  unsigned low,high;
+
+  assert(table!=NULL);
+  if (table->thumbbit)
+    address&=~1ul;
+  low=0;
+  high=table->count;
+  while (low<high) {
+    unsigned mid=low+(high-low)/2;
+    if (symtab_key(table,&table->symbols[mid])<address)
+      low=mid+1;
+    else
+      high=mid;
+  }
+  if (low<table->count && symtab_key(table,&table->symbols[low])==address)
+    return &table->symbols[low];
+  if (exact || low==0)
+    return NULL;
+  /* return the first symbol at the closest lower address */
+  address=symtab_key(table,&table->symbols[low-1]);
+  while (low>1 && symtab_key(table,&table->symbols[low-2])==address)
+    low--;
+  return &table->symbols[low-1];
+}
+
+/** elf_symtab_by_name() looks up a symbol on its name (which is matched
+ *  exactly; names of C++ symbols are mangled).
+ *
+ *  \param table      [in] The table loaded with elf_symtab_load().
+ *  \param name       [in] The name of the symbol.
+ *
+ *  \return A pointer to the symbol, or NULL if no symbol matches. On more
+ *          symbols with the same name, the first one in the ELF symbol table
+ *          is returned.
+ */
+const ELF_SYMBOL *elf_symtab_by_name(const ELF_SYMTAB *table,const char *name)
+{
+  unsigned low,high;
+
+  assert(table!=NULL);
+  assert(name!=NULL);
+  low=0;
+  high=table->count;
+  while (low<high) {
+    unsigned mid=low+(high-low)/2;
+    if (strcmp(table->symbols[table->byname[mid]].name,name)<0)
+      low=mid+1;
+    else
+      high=mid;
+  }
+  if (low<table->count && strcmp(table->symbols[table->byname[low]].name,name)==0)
+    return &table->symbols[table->byname[low]];
+  return NULL;
+}
+
 /** elf_load_symbols() loads the symbol table from an ELF file (if one is
  *  present).
  *
@@ -642,14 +982,16 @@ int elf_section_by_address(FILE *fp,unsigned long baseaddr,
  *                    parameter will be set to the required number of entries.
  *
  *  \return An error value.
+ *
+ *  \note   The symbols are sorted on address. Each name is allocated
+ *          separately; use elf_clear_symbols() to free them. A single call to
+ *          elf_symtab_load() is more efficient.
  */
 int elf_load_symbols(FILE *fp,ELF_SYMBOL *symbols,unsigned *number)
 {
-  unsigned long offset,length;
-  char *stringtable;
-  ELF32SYMBOL sym;
-  int i,total,err;
-  unsigned size;
+  ELF_SYMTAB table;
+  unsigned idx,size;
+  int err;
 
   assert(number!=NULL);
   size=(symbols!=NULL) ? *number : 0;
@@ -657,52 +999,19 @@ int elf_load_symbols(FILE *fp,ELF_SYMBOL *symbols,unsigned *number)
     memset(symbols,0,*number*sizeof(ELF_SYMBOL));
   *number=0;
 
-  /* first read the symbol string table */
-  assert(fp!=NULL);
-  err=elf_section_by_name(fp,".strtab",&offset,NULL,&length);
-  if (err!=ELFERR_NONE)
+  if ((err=elf_symtab_load(fp,&table))!=ELFERR_NONE)
     return err;
-  stringtable=malloc(length);
-  if (stringtable==NULL)
-    return ELFERR_MEMORY;
-  fseek(fp,offset,SEEK_SET);
-  fread(stringtable,1,length,fp);
-
-  /* now get the symbol table */
-  err=elf_section_by_name(fp,".symtab",&offset,NULL,&length);
-  if (err!=ELFERR_NONE) {
-    free((void*)stringtable);
-    return err;
-  }
-
-  assert(length % sizeof(ELF32SYMBOL)==0);
-  total=length/sizeof(ELF32SYMBOL);
-  fseek(fp,offset,SEEK_SET);
-  for (i=0; i<total; i++) {
-    int type;
-    fread(&sym,sizeof(ELF32SYMBOL),1,fp);
-    if (sym.name==0)
-      continue; /* ignore anonymous symbols */
-    type=sym.info & 0x0f;
-    if (type!=STT_OBJECT && type!=STT_FUNC && type!=STT_COMMON)
-      continue; /* collect only functions & variables */
-    if (*number<size) {
-      const char *ptr=stringtable+sym.name;
-      assert(symbols!=NULL);  /* otherwise "size" would be zero (and this "if" never entered) */
-      symbols[*number].name=strdup(ptr);
-      symbols[*number].address=sym.addr;
-      symbols[*number].size=sym.size;
-      symbols[*number].is_func=(type==STT_FUNC);
-      symbols[*number].is_ext=(((sym.info >> 4) & 1)!=0);
-      if (symbols[*number].name==NULL) {
-        elf_clear_symbols(symbols,*number);
-        return ELFERR_MEMORY;
-      }
+  for (idx=0; idx<table.count && idx<size; idx++) {
+    assert(symbols!=NULL);  /* otherwise "size" would be zero (and this loop never entered) */
+    symbols[idx]=table.symbols[idx];
+    if ((symbols[idx].name=strdup(table.symbols[idx].name))==NULL) {
+      elf_clear_symbols(symbols,idx);
+      elf_symtab_free(&table);
+      return ELFERR_MEMORY;
     }
-    *number+=1;
   }
-
-  free((void*)stringtable);
+  *number=table.count;
+  elf_symtab_free(&table);
   return ELFERR_NONE;
 }
 
@@ -729,17 +1038,23 @@ int elf_patch_vecttable(FILE *fp,const char *driver,unsigned int *checksum)
 {
   unsigned long offset,address,length;
   int wordsize,bigendian,machine,result;
+  ELF_FILE *elf;
 
   assert(checksum!=NULL);
   *checksum=0;
 
+  /* read the headers once, for both the file information and the section */
   assert(fp!=NULL);
-  result=elf_info(fp,&wordsize,&bigendian,&machine,NULL);
-  if (result!=ELFERR_NONE || wordsize!=32 || machine!=EM_ARM)
+  elf=elf_open(fp,NULL);
+  result=elf_file_info(elf,&wordsize,&bigendian,&machine,NULL);
+  if (result!=ELFERR_NONE || wordsize!=32 || machine!=EM_ARM) {
+    elf_close(elf);
     return ELFERR_FILEFORMAT; /* only 32-bit ARM architecture */
+  }
 
   /* find the section at memory address 0 (the vector table) */
-  result=elf_section_by_address(fp,0,NULL,0,&offset,&address,&length);
+  result=elf_file_section_by_address(elf,0,NULL,0,&offset,&address,&length);
+  elf_close(elf);
   if (result!=ELFERR_NONE || address!=0 || length<8*sizeof(uint32_t))
     return ELFERR_FILEFORMAT;
 
@@ -828,25 +1143,32 @@ int elf_check_crp(FILE *fp,int *crp)
   unsigned long offset,base,address,length;
   uint32_t magic;
   int wordsize,bigendian,machine,result;
+  ELF_FILE *elf;
 
   assert(crp!=NULL);
   *crp=0;
 
   assert(fp!=NULL);
-  result=elf_info(fp,&wordsize,&bigendian,&machine,NULL);
-  if (result!=ELFERR_NONE || wordsize!=32 || machine!=EM_ARM)
+  elf=elf_open(fp,NULL);
+  result=elf_file_info(elf,&wordsize,&bigendian,&machine,NULL);
+  if (result!=ELFERR_NONE || wordsize!=32 || machine!=EM_ARM) {
+    elf_close(elf);
     return ELFERR_FILEFORMAT;   /* only 32-bit ARM architecture */
+  }
 
   /* find the section where the CRP "magic" may be stored */
   base=0;
   for ( ;; ) {
-    result=elf_section_by_address(fp,base,NULL,0,&offset,&address,&length);
-    if (result!=ELFERR_NONE || address>CRP_ADDRESS)
+    result=elf_file_section_by_address(elf,base,NULL,0,&offset,&address,&length);
+    if (result!=ELFERR_NONE || address>CRP_ADDRESS) {
+      elf_close(elf);
       return ELFERR_FILEFORMAT;
+    }
     if (address<=CRP_ADDRESS && address+length>CRP_ADDRESS+4)
       break;
     base+=length;
   }
+  elf_close(elf);
 
   result=ELFERR_NONE;
 
@@ -56,6 +56,31 @@ typedef struct tagELF_SYMBOL {
   unsigned char is_ext; /* 1 for external scope, 0 for file local scope */
 } ELF_SYMBOL;
 
+typedef struct tagELF_SYMTAB {
+  ELF_SYMBOL *symbols;  /* functions and variables, sorted on address */
+  unsigned count;       /* number of entries in "symbols" */
+  unsigned *byname;     /* indices into "symbols", sorted on name */
+  char *strings;        /* string table, the symbol names point into this table */
+  int thumbbit;         /* 1 if the low bit of function addresses must be ignored (ARM) */
+} ELF_SYMTAB;
+
+typedef struct tagELF_FILE ELF_FILE;
+
+ELF_FILE *elf_open(FILE *fp,int *error);
+void elf_close(ELF_FILE *elf);
+
+int elf_file_info(const ELF_FILE *elf,int *wordsize,int *bigendian,int *machine,unsigned long *entry_addr);
+int elf_file_segment(const ELF_FILE *elf,int index,
+                     int *type, int *flags,
+                     unsigned long *offset,unsigned long *filesize,
+                     unsigned long *vaddr,unsigned long *paddr,
+                     unsigned long *memsize);
+int elf_file_section_by_name(const ELF_FILE *elf,const char *sectionname,unsigned long *offset,
+                             unsigned long *address,unsigned long *length);
+int elf_file_section_by_address(const ELF_FILE *elf,unsigned long baseaddr,
+                                char *sectionname,size_t namelength,unsigned long *offset,
+                                unsigned long *address,unsigned long *length);
+
 int elf_info(FILE *fp,int *wordsize,int *bigendian,int *machine,unsigned long *entry_addr);
 
 int elf_segment_by_index(FILE *fp,int index,
@@ -71,6 +96,11 @@ int elf_section_by_address(FILE *fp,unsigned long baseaddr,
                            char *sectionname,size_t namelength,unsigned long *offset,
                            unsigned long *address,unsigned long *length);
 
+int elf_symtab_load(FILE *fp,ELF_SYMTAB *table);
+void elf_symtab_free(ELF_SYMTAB *table);
+const ELF_SYMBOL *elf_symtab_by_address(const ELF_SYMTAB *table,unsigned long address,int exact);
+const ELF_SYMBOL *elf_symtab_by_name(const ELF_SYMTAB *table,const char *name);
+
 int elf_load_symbols(FILE *fp,ELF_SYMBOL *symbols,unsigned *number);
 void elf_clear_symbols(ELF_SYMBOL *symbols,unsigned number);
 
@@ -0,0 +1,409 @@
+/*
+ * Background export of captured data to a file, in CSV, plain text or binary
+ * format. Only a single export runs at a time.
+ *
+ * Copyright 2026 CompuPhase
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <assert.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined WIN32 || defined _WIN32
+# define stricmp(s1,s2)  _stricmp((s1),(s2))
+#else
+# include <strings.h>
+# define stricmp(s1,s2)  strcasecmp((s1),(s2))
+#endif
+
+#include "c11threads.h"
+#include "export.h"
+
+#if defined FORTIFY
+# include <alloc/fortify.h>
+#endif
+
+#define EXPORT_BUFSIZE    (1024 * 1024)   /* write buffer */
+#define EXPORT_MAXFIELD   64              /* max. size of a formatted number */
+#define EXPORT_PROGRESS   1024            /* rows between updates of the progress counter */
+#define EXPORT_VERSION    1               /* version of the binary format */
+
+typedef struct tagEXPORTJOB {
+  FILE *fp;
+  char *filename;
+  int format;
+  const EXPORTCOLUMN *columns;
+  int numcolumns;
+  unsigned long numrows;
+  EXPORT_ROWFUNC rowfunc;
+  EXPORT_DONEFUNC donefunc;
+  void *context;
+  unsigned char *buffer;
+  size_t bufpos;
+  bool error;
+} EXPORTJOB;
+
+static EXPORTJOB job;
+static thrd_t job_thread;
+static bool job_joined = true;  /* whether the worker thread was joined */
+static int job_state = EXPORT_IDLE;
+static unsigned long job_done = 0;  /* rows processed, for the progress */
+static unsigned long job_written = 0;
+static volatile bool job_cancel = false;
+static mtx_t job_lock;
+static once_flag job_once = ONCE_FLAG_INIT;
+
+static void job_lockinit(void)
+{
+  mtx_init(&job_lock, mtx_plain);
+}
+
+static void buf_flush(EXPORTJOB *ejob)
+{
+  if (ejob->bufpos > 0 && !ejob->error) {
+    if (fwrite(ejob->buffer, 1, ejob->bufpos, ejob->fp) != ejob->bufpos)
+      ejob->error = true;
+  }
+  ejob->bufpos = 0;
+}
+
+static void buf_write(EXPORTJOB *ejob, const void *data, size_t size)
+{
+  const unsigned char *ptr = (const unsigned char*)data;
+  while (size > 0) {
+    if (ejob->bufpos == EXPORT_BUFSIZE)
+      buf_flush(ejob);
+    size_t count = EXPORT_BUFSIZE - ejob->bufpos;
+    if (count > size)
+      count = size;
+    memcpy(ejob->buffer + ejob->bufpos, ptr, count);
+    ejob->bufpos += count;
+    ptr += count;
+    size -= count;
+  }
+}
+
+static void buf_putc(EXPORTJOB *ejob, char c)
+{
+  if (ejob->bufpos == EXPORT_BUFSIZE)
+    buf_flush(ejob);
+  ejob->buffer[ejob->bufpos++] = (unsigned char)c;
+}
+
+/* buf_le() writes a value in Little Endian, in the given number of bytes */
+static void buf_le(EXPORTJOB *ejob, uint64_t value, int size)
+{
+  unsigned char bytes[8];
+  assert(size <= (int)sizeof bytes);
+  for (int idx = 0; idx < size; idx++)
+    bytes[idx] = (unsigned char)(value >> (8 * idx));
+  buf_write(ejob, bytes, size);
+}
+
+/* buf_quoted() writes a string for CSV, between double quotes (and with any
+   double quotes in the string doubled) */
+static void buf_quoted(EXPORTJOB *ejob, const char *text, size_t length)
+{
+  buf_putc(ejob, '"');
+  for (;;) {
+    const char *quote = memchr(text, '"', length);
+    if (quote == NULL)
+      break;
+    size_t count = quote - text + 1;
+    buf_write(ejob, text, count);
+    buf_putc(ejob, '"');
+    text += count;
+    length -= count;
+  }
+  buf_write(ejob, text, length);
+  buf_putc(ejob, '"');
+}
+
+static void write_header(EXPORTJOB *ejob)
+{
+  int col;
+  switch (ejob->format) {
+  case EXPORT_CSV:
+    for (col = 0; col < ejob->numcolumns; col++) {
+      if (col > 0)
+        buf_putc(ejob, ',');
+      buf_write(ejob, ejob->columns[col].name, strlen(ejob->columns[col].name));
+    }
+    buf_putc(ejob, '\n');
+    break;
+  case EXPORT_BINARY:
+    buf_write(ejob, "BMEX", 4);
+    buf_le(ejob, EXPORT_VERSION, 2);
+    buf_le(ejob, ejob->numcolumns, 2);
+    for (col = 0; col < ejob->numcolumns; col++) {
+      size_t len = strlen(ejob->columns[col].name);
+      buf_le(ejob, ejob->columns[col].type, 1);
+      buf_le(ejob, len, 2);
+      buf_write(ejob, ejob->columns[col].name, len);
+    }
+    break;
+  }
+}
+
+static void write_row(EXPORTJOB *ejob, const EXPORTVALUE *values)
+{
+  char field[EXPORT_MAXFIELD];
+  int len;
+
+  for (int col = 0; col < ejob->numcolumns; col++) {
+    const EXPORTCOLUMN *column = &ejob->columns[col];
+    const EXPORTVALUE *value = &values[col];
+    if (ejob->format == EXPORT_BINARY) {
+      switch (column->type) {
+      case EXPCOL_INT:
+        buf_le(ejob, (uint64_t)value->value.i, 8);
+        break;
+      case EXPCOL_UINT:
+      case EXPCOL_HEX:
+        buf_le(ejob, value->value.u, 8);
+        break;
+      case EXPCOL_REAL: {
+        uint64_t bits;
+        assert(sizeof bits == sizeof value->value.r);
+        memcpy(&bits, &value->value.r, sizeof bits);
+        buf_le(ejob, bits, 8);
+        break;
+      }
+      case EXPCOL_STRING:
+        buf_le(ejob, value->length, 4);
+        buf_write(ejob, value->text, value->length);
+        break;
+      }
+      continue;
+    }
+
+    if (col > 0)
+      buf_putc(ejob, (ejob->format == EXPORT_CSV) ? ',' : ' ');
+    len = 0;
+    switch (column->type) {
+    case EXPCOL_INT:
+      len = snprintf(field, sizeof field, "%lld", value->value.i);
+      break;
+    case EXPCOL_UINT:
+      len = snprintf(field, sizeof field, "%llu", value->value.u);
+      break;
+    case EXPCOL_HEX:
+      len = snprintf(field, sizeof field, "%llx", value->value.u);
+      break;
+    case EXPCOL_REAL:
+      len = snprintf(field, sizeof field, "%.*f", column->precision, value->value.r);
+      break;
+    case EXPCOL_STRING:
+      if (ejob->format == EXPORT_CSV)
+        buf_quoted(ejob, value->text, value->length);
+      else
+        buf_write(ejob, value->text, value->length);
+      break;
+    }
+    if (len > 0)
+      buf_write(ejob, field, ((size_t)len < sizeof field) ? (size_t)len : sizeof field - 1);
+  }
+  if (ejob->format != EXPORT_BINARY)
+    buf_putc(ejob, '\n');
+}
+
+static int export_worker(void *arg)
+{
+  EXPORTJOB *ejob = (EXPORTJOB*)arg;
+  EXPORTVALUE *values = malloc(ejob->numcolumns * sizeof(EXPORTVALUE));
+  unsigned long written = 0;
+
+  if (values == NULL)
+    ejob->error = true;
+  if (!ejob->error)
+    write_header(ejob);
+  for (unsigned long row = 0; row < ejob->numrows && !ejob->error && !job_cancel; row++) {
+    memset(values, 0, ejob->numcolumns * sizeof(EXPORTVALUE));
+    if (ejob->rowfunc(ejob->context, row, values)) {
+      write_row(ejob, values);
+      written++;
+    }
+    if ((row + 1) % EXPORT_PROGRESS == 0) {
+      mtx_lock(&job_lock);
+      job_done = row + 1;
+      mtx_unlock(&job_lock);
+    }
+  }
+  buf_flush(ejob);
+  if (fclose(ejob->fp) != 0)
+    ejob->error = true;
+  if (ejob->error || job_cancel)
+    remove(ejob->filename); /* do not leave a partial file behind */
+  if (ejob->donefunc != NULL)
+    ejob->donefunc(ejob->context);
+  if (values != NULL)
+    free(values);
+  free(ejob->buffer);
+  free(ejob->filename);
+
+  mtx_lock(&job_lock);
+  job_done = ejob->numrows;
+  job_written = written;
+  job_state = (ejob->error || job_cancel) ? EXPORT_FAILED : EXPORT_DONE;
+  mtx_unlock(&job_lock);
+  return 0;
+}
+
+/** export_format() returns the format that matches the extension of the
+ *  filename: ".csv" for CSV, ".txt" for plain text and ".bin" for binary.
+ *
+ *  \param filename       The name of the output file.
+ *  \param defaultformat  The format to return if the extension is not one of
+ *                        the above.
+ */
+int export_format(const char *filename, int defaultformat)
+{
+  assert(filename != NULL);
+  const char *ext = strrchr(filename, '.');
+  if (ext == NULL || strpbrk(ext, "/\\") != NULL)
+    return defaultformat;
+  if (stricmp(ext, ".csv") == 0)
+    return EXPORT_CSV;
+  if (stricmp(ext, ".txt") == 0)
+    return EXPORT_TEXT;
+  if (stricmp(ext, ".bin") == 0)
+    return EXPORT_BINARY;
+  return defaultformat;
+}
+
+/** export_start() creates the file and starts the worker thread that writes
+ *  the rows to it.
+ *
+ *  \param filename   The name of the output file.
+ *  \param format     EXPORT_CSV, EXPORT_TEXT or EXPORT_BINARY.
+ *  \param columns    The column definitions; this array must stay valid until
+ *                    the export finishes.
+ *  \param numcolumns The number of entries in the columns array.
+ *  \param numrows    The number of rows in the snapshot.
+ *  \param rowfunc    Called (on the worker thread) for each row.
+ *  \param donefunc   Called (on the worker thread) when the export finishes,
+ *                    also when it fails or when it is cancelled. This
+ *                    parameter may be NULL.
+ *  \param context    Passed to rowfunc and donefunc.
+ *
+ *  \return true on success, false if another export is still running or if
+ *          the file cannot be created. On failure, donefunc is not called.
+ *
+ *  \note The progress and the result are retrieved with export_poll(). The
+ *        result of an earlier export that was not yet retrieved, is
+ *        discarded.
+ */
+bool export_start(const char *filename, int format, const EXPORTCOLUMN *columns, int numcolumns,
+                  unsigned long numrows, EXPORT_ROWFUNC rowfunc, EXPORT_DONEFUNC donefunc, void *context)
+{
+  assert(filename != NULL);
+  assert(format == EXPORT_CSV || format == EXPORT_TEXT || format == EXPORT_BINARY);
+  assert(columns != NULL && numcolumns > 0);
+  assert(rowfunc != NULL);
+
+  call_once(&job_once, job_lockinit);
+  mtx_lock(&job_lock);
+  int state = job_state;
+  mtx_unlock(&job_lock);
+  if (state == EXPORT_BUSY)
+    return false;
+  if (!job_joined) {
+    thrd_join(job_thread, NULL);
+    job_joined = true;
+  }
+
+  memset(&job, 0, sizeof job);
+  job.filename = strdup(filename);
+  job.buffer = malloc(EXPORT_BUFSIZE);
+  if (job.filename == NULL || job.buffer == NULL
+      || (job.fp = fopen(filename, (format == EXPORT_BINARY) ? "wb" : "wt")) == NULL)
+  {
+    if (job.filename != NULL)
+      free(job.filename);
+    if (job.buffer != NULL)
+      free(job.buffer);
+    return false;
+  }
+  job.format = format;
+  job.columns = columns;
+  job.numcolumns = numcolumns;
+  job.numrows = numrows;
+  job.rowfunc = rowfunc;
+  job.donefunc = donefunc;
+  job.context = context;
+
+  job_done = job_written = 0;
+  job_cancel = false;
+  job_state = EXPORT_BUSY;
+  if (thrd_create(&job_thread, export_worker, &job) != thrd_success) {
+    /* fall back to writing the file synchronously */
+    export_worker(&job);
+  } else {
+    job_joined = false;
+  }
+  return true;
+}
+
+/** export_poll() returns the state of the export, and the progress.
+ *
+ *  \param percent  Set to the percentage of the rows that were processed.
+ *                  This parameter may be NULL.
+ *  \param rows     Set to the number of rows that were written, when the
+ *                  export finished. This parameter may be NULL.
+ *
+ *  \return EXPORT_IDLE, EXPORT_BUSY, EXPORT_DONE or EXPORT_FAILED. The state
+ *          EXPORT_DONE or EXPORT_FAILED is returned only once; the state is
+ *          reset to EXPORT_IDLE after that.
+ */
+int export_poll(unsigned *percent, unsigned long *rows)
+{
+  call_once(&job_once, job_lockinit);
+  mtx_lock(&job_lock);
+  int state = job_state;
+  if (percent != NULL)
+    *percent = (job.numrows > 0) ? (unsigned)((job_done * 100ull) / job.numrows) : 100;
+  if (rows != NULL)
+    *rows = job_written;
+  if (state == EXPORT_DONE || state == EXPORT_FAILED)
+    job_state = EXPORT_IDLE;
+  mtx_unlock(&job_lock);
+  if (state != EXPORT_BUSY && !job_joined) {
+    thrd_join(job_thread, NULL);
+    job_joined = true;
+  }
+  return state;
+}
+
+/** export_cancel() aborts a running export, and waits for the worker thread
+ *  to finish. The partial file is removed.
+ */
+void export_cancel(void)
+{
+  job_cancel = true;
+  export_wait();
+}
+
+/** export_wait() waits for a running export to complete. This must be called
+ *  before any data that the row callback uses (and that is not part of the
+ *  snapshot) is freed.
+ */
+void export_wait(void)
+{
+  if (!job_joined) {
+    thrd_join(job_thread, NULL);
+    job_joined = true;
+  }
+}
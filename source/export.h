@@ -0,0 +1,97 @@
+/*
+ * Background export of captured data to a file. The tool takes a snapshot of
+ * the data on the GUI thread (which should be a quick copy), and the rows are
+ * then formatted and written to the file on a worker thread, through a large
+ * write buffer. The rows are produced by a callback, as an array of typed
+ * values (one per column), so that the same snapshot can be written in any
+ * of the supported formats:
+ * - CSV: a header line with the column names, then one line per row; strings
+ *   are quoted.
+ * - plain text: the values of a row separated by a space, no header and no
+ *   quoting.
+ * - binary: a header with the signature "BMEX", a version (16-bit), the number
+ *   of columns (16-bit) and per column the type (8-bit) and the name (a 16-bit
+ *   length, then the characters); then the rows, where integers and reals are
+ *   8 bytes each and strings are a 32-bit length followed by the characters.
+ *   All multi-byte values are in Little Endian.
+ *
+ * Copyright 2026 CompuPhase
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef _EXPORT_H
+#define _EXPORT_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#if defined __cplusplus
+  extern "C" {
+#endif
+
+enum {
+  EXPORT_CSV,
+  EXPORT_TEXT,
+  EXPORT_BINARY,
+};
+
+enum {
+  EXPCOL_INT,     /* signed integer, "value.i" */
+  EXPCOL_UINT,    /* unsigned integer, "value.u" */
+  EXPCOL_HEX,     /* unsigned integer, written in hexadecimal in CSV and text */
+  EXPCOL_REAL,    /* floating point, "value.r" */
+  EXPCOL_STRING,  /* "text" and "length" */
+};
+
+enum {
+  EXPORT_IDLE,
+  EXPORT_BUSY,
+  EXPORT_DONE,
+  EXPORT_FAILED,
+};
+
+typedef struct tagEXPORTCOLUMN {
+  const char *name;
+  int type;
+  int precision;        /* number of decimals, for EXPCOL_REAL */
+} EXPORTCOLUMN;
+
+typedef struct tagEXPORTVALUE {
+  union {
+    long long i;
+    unsigned long long u;
+    double r;
+  } value;
+  const char *text;     /* for EXPCOL_STRING (need not be zero-terminated) */
+  size_t length;
+} EXPORTVALUE;
+
+/* the row callback fills in the values for the row; it returns false to skip
+   the row (rows are requested in ascending order, from 0 to numrows - 1); the "done" callback is called when the export finishes (on the
+   worker thread), typically to free the snapshot */
+typedef bool (*EXPORT_ROWFUNC)(void *context, unsigned long row, EXPORTVALUE *values);
+typedef void (*EXPORT_DONEFUNC)(void *context);
+
+int  export_format(const char *filename, int defaultformat);
+
+bool export_start(const char *filename, int format, const EXPORTCOLUMN *columns, int numcolumns,
+                  unsigned long numrows, EXPORT_ROWFUNC rowfunc, EXPORT_DONEFUNC donefunc, void *context);
+int  export_poll(unsigned *percent, unsigned long *rows);
+void export_cancel(void);
+void export_wait(void);
+
+#if defined __cplusplus
+  }
+#endif
+
+#endif /* _EXPORT_H */
@@ -0,0 +1,458 @@
+/*
+ * Change notifications for files, so that a front-end can detect that source
+ * files or an ELF file were modified, without checking the timestamp of every
+ * file. The directories of the watched files are monitored through inotify
+ * (Linux) or ReadDirectoryChangesW (Microsoft Windows); notifications are
+ * collected by polling (without blocking), from the loop of the user
+ * interface.
+ *
+ * A change is reported only after the file has been quiet for a short while,
+ * so that a file that is being written (by a linker, for example) is not
+ * picked up half-way.
+ *
+ * Copyright 2026 CompuPhase
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined WIN32 || defined _WIN32
+# define STRICT
+# define WIN32_LEAN_AND_MEAN
+# include <windows.h>
+# if defined __MINGW32__ || defined __MINGW64__ || defined _MSC_VER
+#   include "strlcpy.h"
+# endif
+# define stricmp(s1,s2)  _stricmp((s1),(s2))
+#else
+# include <time.h>
+# include <unistd.h>
+# include <strings.h>
+# include <bsd/string.h>
+# if defined __linux__
+#   include <sys/inotify.h>
+# endif
+# define stricmp(s1,s2)  strcasecmp((s1),(s2))
+#endif
+
+#include "filewatch.h"
+
+#if defined FORTIFY
+# include <alloc/fortify.h>
+#endif
+
+#if !defined _MAX_PATH
+# define _MAX_PATH  260
+#endif
+
+#define FILEWATCH_SETTLE  250   /* time (in ms) that a file must be quiet, before a change is reported */
+
+typedef struct tagWATCHDIR {
+  char *path;
+  int refcount;         /* number of watched files in this directory */
+  bool valid;           /* false if the directory can no longer be watched */
+#if defined WIN32 || defined _WIN32
+  HANDLE handle;
+  OVERLAPPED overlapped;
+  DWORD buffer[2048];   /* notification records (must be DWORD-aligned) */
+#elif defined __linux__
+  int wd;               /* inotify watch descriptor */
+#endif
+} WATCHDIR;
+
+typedef struct tagWATCHFILE {
+  char *name;           /* filename without the path (NULL for a free slot) */
+#if defined WIN32 || defined _WIN32
+  WCHAR *wname;         /* same, in the encoding of the notification records */
+#endif
+  int dir;              /* index in the directory list */
+  bool changed;         /* whether a notification arrived */
+  unsigned long tstamp; /* time of the most recent notification */
+} WATCHFILE;
+
+/* the directories are allocated individually, because (in Microsoft Windows)
+   the notification buffer must stay in place while a request is pending */
+static WATCHDIR **watchdirs = NULL;
+static int watchdir_count = 0;
+static WATCHFILE *watchfiles = NULL;
+static int watchfile_count = 0;
+#if defined __linux__
+  static int notify_fd = -1;
+#endif
+
+static unsigned long watch_clock(void)
+{
+# if defined WIN32 || defined _WIN32
+    return GetTickCount();
+# else
+    struct timespec time;
+    clock_gettime(CLOCK_MONOTONIC, &time);
+    return time.tv_sec * 1000 + time.tv_nsec / 1000000;
+# endif
+}
+
+/* split_path() copies the directory part of the path into "dir", and returns
+   a pointer to the filename part (in the path) */
+static const char *split_path(const char *path, char *dir, size_t size)
+{
+  const char *sep = strrchr(path, '/');
+# if defined WIN32 || defined _WIN32
+    const char *bs = strrchr(path, '\\');
+    if (bs != NULL && (sep == NULL || bs > sep))
+      sep = bs;
+# endif
+  if (sep == NULL) {
+    strlcpy(dir, ".", size);
+    return path;
+  }
+  size_t len = sep - path;
+  if (len == 0 || path[len - 1] == ':')
+    len += 1;   /* keep the separator for the root directory */
+  if (len >= size)
+    len = size - 1;
+  memcpy(dir, path, len);
+  dir[len] = '\0';
+  return sep + 1;
+}
+
+/* mark_files() flags the files in a directory as changed; if name is NULL,
+   all files in the directory are flagged */
+static void mark_files(int dir, const char *name)
+{
+  unsigned long tstamp = watch_clock();
+  for (int idx = 0; idx < watchfile_count; idx++) {
+    WATCHFILE *file = &watchfiles[idx];
+    if (file->name != NULL && file->dir == dir && (name == NULL || strcmp(file->name, name) == 0)) {
+      file->changed = true;
+      file->tstamp = tstamp;
+    }
+  }
+}
+
+#if defined WIN32 || defined _WIN32
+/* mark_files_w() is the same as mark_files(), but for a name in the encoding
+   (and length) of a notification record */
+static void mark_files_w(int dir, const WCHAR *name, size_t length)
+{
+  unsigned long tstamp = watch_clock();
+  for (int idx = 0; idx < watchfile_count; idx++) {
+    WATCHFILE *file = &watchfiles[idx];
+    if (file->name != NULL && file->dir == dir && file->wname != NULL
+        && wcslen(file->wname) == length && _wcsnicmp(file->wname, name, length) == 0)
+    {
+      file->changed = true;
+      file->tstamp = tstamp;
+    }
+  }
+}
+
+/* dir_arm() issues an (asynchronous) request for change notifications */
+static bool dir_arm(WATCHDIR *dir)
+{
+  ResetEvent(dir->overlapped.hEvent);
+  return ReadDirectoryChangesW(dir->handle, dir->buffer, sizeof dir->buffer, FALSE,
+                               FILE_NOTIFY_CHANGE_FILE_NAME | FILE_NOTIFY_CHANGE_LAST_WRITE | FILE_NOTIFY_CHANGE_SIZE,
+                               NULL, &dir->overlapped, NULL);
+}
+#endif
+
+/* dir_open() returns the index of the directory in the list, after adding it
+   if needed; it returns -1 if the directory cannot be watched */
+static int dir_open(const char *path)
+{
+  int idx;
+  for (idx = 0; idx < watchdir_count; idx++) {
+    WATCHDIR *dir = watchdirs[idx];
+    if (dir != NULL && dir->valid && stricmp(dir->path, path) == 0) {
+      dir->refcount += 1;
+      return idx;
+    }
+  }
+
+  /* find a free slot, or grow the list */
+  int slot;
+  for (slot = 0; slot < watchdir_count && watchdirs[slot] != NULL; slot++)
+    {}
+  if (slot == watchdir_count) {
+    WATCHDIR **list = realloc(watchdirs, (watchdir_count + 1) * sizeof(WATCHDIR*));
+    if (list == NULL)
+      return -1;
+    watchdirs = list;
+    watchdirs[watchdir_count++] = NULL;
+  }
+
+  WATCHDIR *dir = malloc(sizeof(WATCHDIR));
+  if (dir == NULL)
+    return -1;
+  memset(dir, 0, sizeof(WATCHDIR));
+  if ((dir->path = strdup(path)) == NULL) {
+    free(dir);
+    return -1;
+  }
+# if defined WIN32 || defined _WIN32
+    dir->handle = CreateFileA(path, FILE_LIST_DIRECTORY,
+                              FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, NULL,
+                              OPEN_EXISTING, FILE_FLAG_BACKUP_SEMANTICS | FILE_FLAG_OVERLAPPED, NULL);
+    if (dir->handle != INVALID_HANDLE_VALUE) {
+      dir->overlapped.hEvent = CreateEvent(NULL, TRUE, FALSE, NULL);
+      if (dir->overlapped.hEvent != NULL && dir_arm(dir)) {
+        dir->valid = true;
+      } else {
+        if (dir->overlapped.hEvent != NULL)
+          CloseHandle(dir->overlapped.hEvent);
+        CloseHandle(dir->handle);
+      }
+    }
+# elif defined __linux__
+    if (notify_fd < 0)
+      notify_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (notify_fd >= 0) {
+      dir->wd = inotify_add_watch(notify_fd, path, IN_CLOSE_WRITE | IN_MODIFY | IN_ATTRIB
+                                  | IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO);
+      if (dir->wd >= 0) {
+        /* the same directory may be reached through different paths, but
+           inotify returns the same descriptor for it */
+        for (idx = 0; idx < watchdir_count; idx++) {
+          if (watchdirs[idx] != NULL && watchdirs[idx]->valid && watchdirs[idx]->wd == dir->wd) {
+            watchdirs[idx]->refcount += 1;
+            free(dir->path);
+            free(dir);
+            return idx;
+          }
+        }
+        dir->valid = true;
+      }
+    }
+# endif
+  if (!dir->valid) {
+    free(dir->path);
+    free(dir);
+    return -1;
+  }
+  dir->refcount = 1;
+  watchdirs[slot] = dir;
+  return slot;
+}
+
+static void dir_close(int idx)
+{
+  assert(idx >= 0 && idx < watchdir_count);
+  WATCHDIR *dir = watchdirs[idx];
+  assert(dir != NULL && dir->refcount > 0);
+  if (--dir->refcount > 0)
+    return;
+# if defined WIN32 || defined _WIN32
+    if (dir->valid) {
+      /* the pending request must have completed before the buffer is freed */
+      DWORD bytes;
+      CancelIo(dir->handle);
+      GetOverlappedResult(dir->handle, &dir->overlapped, &bytes, TRUE);
+    }
+    CloseHandle(dir->overlapped.hEvent);
+    CloseHandle(dir->handle);
+# elif defined __linux__
+    if (dir->valid)
+      inotify_rm_watch(notify_fd, dir->wd);
+# endif
+  free(dir->path);
+  free(dir);
+  watchdirs[idx] = NULL;
+}
+
+/** filewatch_add() starts monitoring a file for changes.
+ *
+ *  \param path   The path to the file (which should exist). The directory of
+ *                the file is monitored, so that the file is still tracked
+ *                after an editor or a linker replaced it by a new file.
+ *
+ *  \return An identifier for the file, for filewatch_changed() and
+ *          filewatch_remove(). It is -1 if the file cannot be monitored; the
+ *          caller must then fall back to checking the timestamp of the file.
+ */
+int filewatch_add(const char *path)
+{
+  assert(path != NULL);
+  char dirpath[_MAX_PATH];
+  const char *name = split_path(path, dirpath, sizeof dirpath);
+  if (*name == '\0')
+    return -1;
+  int dir = dir_open(dirpath);
+  if (dir < 0)
+    return -1;
+
+  int idx;
+  for (idx = 0; idx < watchfile_count && watchfiles[idx].name != NULL; idx++)
+    {}
+  if (idx == watchfile_count) {
+    WATCHFILE *list = realloc(watchfiles, (watchfile_count + 1) * sizeof(WATCHFILE));
+    if (list == NULL) {
+      dir_close(dir);
+      return -1;
+    }
+    watchfiles = list;
+    watchfile_count += 1;
+  }
+  WATCHFILE *file = &watchfiles[idx];
+  memset(file, 0, sizeof(WATCHFILE));
+  if ((file->name = strdup(name)) == NULL) {
+    dir_close(dir);
+    return -1;
+  }
+# if defined WIN32 || defined _WIN32
+    int len = MultiByteToWideChar(CP_ACP, 0, name, -1, NULL, 0);
+    if (len > 0 && (file->wname = malloc(len * sizeof(WCHAR))) != NULL)
+      MultiByteToWideChar(CP_ACP, 0, name, -1, file->wname, len);
+# endif
+  file->dir = dir;
+  return idx;
+}
+
+/** filewatch_remove() stops monitoring a file.
+ *
+ *  \param id     The identifier returned by filewatch_add(); if -1, this
+ *                function does nothing.
+ */
+void filewatch_remove(int id)
+{
+  if (id < 0 || id >= watchfile_count || watchfiles[id].name == NULL)
+    return;
+  WATCHFILE *file = &watchfiles[id];
+  dir_close(file->dir);
+  free(file->name);
+# if defined WIN32 || defined _WIN32
+    if (file->wname != NULL)
+      free(file->wname);
+# endif
+  memset(file, 0, sizeof(WATCHFILE));
+}
+
+/** filewatch_cleanup() stops monitoring all files, and frees all resources.
+ */
+void filewatch_cleanup(void)
+{
+  for (int idx = 0; idx < watchfile_count; idx++)
+    filewatch_remove(idx);
+  if (watchfiles != NULL)
+    free(watchfiles);
+  watchfiles = NULL;
+  watchfile_count = 0;
+  if (watchdirs != NULL)
+    free(watchdirs);
+  watchdirs = NULL;
+  watchdir_count = 0;
+# if defined __linux__
+    if (notify_fd >= 0)
+      close(notify_fd);
+    notify_fd = -1;
+# endif
+}
+
+/** filewatch_poll() collects the change notifications that arrived since the
+ *  previous call. It does not block.
+ *
+ *  \return true if any notification arrived, false otherwise.
+ *
+ *  \note This function must be called before filewatch_changed(), typically
+ *        once per iteration of the main loop.
+ */
+bool filewatch_poll(void)
+{
+  bool result = false;
+# if defined WIN32 || defined _WIN32
+    for (int idx = 0; idx < watchdir_count; idx++) {
+      WATCHDIR *dir = watchdirs[idx];
+      if (dir == NULL || !dir->valid || WaitForSingleObject(dir->overlapped.hEvent, 0) != WAIT_OBJECT_0)
+        continue;
+      DWORD bytes;
+      if (GetOverlappedResult(dir->handle, &dir->overlapped, &bytes, FALSE) && bytes > 0) {
+        const unsigned char *ptr = (const unsigned char*)dir->buffer;
+        for ( ;; ) {
+          const FILE_NOTIFY_INFORMATION *info = (const FILE_NOTIFY_INFORMATION*)ptr;
+          mark_files_w(idx, info->FileName, info->FileNameLength / sizeof(WCHAR));
+          if (info->NextEntryOffset == 0)
+            break;
+          ptr += info->NextEntryOffset;
+        }
+      } else {
+        mark_files(idx, NULL);  /* buffer overflow, assume all files changed */
+      }
+      result = true;
+      if (!dir_arm(dir)) {
+        dir->valid = false;
+        mark_files(idx, NULL);
+      }
+    }
+# elif defined __linux__
+    union {
+      struct inotify_event event; /* for alignment */
+      char bytes[4096];
+    } buffer;
+    ssize_t count;
+    if (notify_fd < 0)
+      return false;
+    while ((count = read(notify_fd, buffer.bytes, sizeof buffer.bytes)) > 0) {
+      for (ssize_t pos = 0; pos + (ssize_t)sizeof(struct inotify_event) <= count; ) {
+        const struct inotify_event *event = (const struct inotify_event*)(buffer.bytes + pos);
+        if (event->mask & IN_Q_OVERFLOW) {
+          for (int idx = 0; idx < watchdir_count; idx++)
+            if (watchdirs[idx] != NULL)
+              mark_files(idx, NULL);
+        } else {
+          int idx;
+          for (idx = 0; idx < watchdir_count; idx++)
+            if (watchdirs[idx] != NULL && watchdirs[idx]->valid && watchdirs[idx]->wd == event->wd)
+              break;
+          if (idx < watchdir_count) {
+            if (event->mask & IN_IGNORED) {
+              watchdirs[idx]->valid = false;  /* directory was removed (or unmounted) */
+              mark_files(idx, NULL);
+            } else if (event->len > 0) {
+              mark_files(idx, event->name);
+            }
+          }
+        }
+        pos += sizeof(struct inotify_event) + event->len;
+      }
+      result = true;
+    }
+# endif
+  return result;
+}
+
+/** filewatch_changed() returns whether the file has changed since the
+ *  previous call (for this file). This call resets the state of the file.
+ *
+ *  \param id     The identifier returned by filewatch_add().
+ *
+ *  \return true if a change notification arrived for the file, false if not
+ *          (or if id is -1). It also returns true (on every call) if the
+ *          directory of the file can no longer be monitored.
+ *
+ *  \note A change is only reported after the file has been quiet for a short
+ *        time; while a file is being written, this function returns false.
+ */
+bool filewatch_changed(int id)
+{
+  if (id < 0 || id >= watchfile_count || watchfiles[id].name == NULL)
+    return false;
+  WATCHFILE *file = &watchfiles[id];
+  assert(file->dir >= 0 && file->dir < watchdir_count && watchdirs[file->dir] != NULL);
+  if (!watchdirs[file->dir]->valid)
+    return true;
+  if (!file->changed || watch_clock() - file->tstamp < FILEWATCH_SETTLE)
+    return false;
+  file->changed = false;
+  return true;
+}
@@ -0,0 +1,41 @@
+/*
+ * Change notifications for files, so that a front-end can detect that source
+ * files or an ELF file were modified, without checking the timestamp of every
+ * file. The directories of the watched files are monitored through inotify
+ * (Linux) or ReadDirectoryChangesW (Microsoft Windows).
+ *
+ * Copyright 2026 CompuPhase
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef _FILEWATCH_H
+#define _FILEWATCH_H
+
+#include <stdbool.h>
+
+#if defined __cplusplus
+  extern "C" {
+#endif
+
+int  filewatch_add(const char *path);
+void filewatch_remove(int id);
+void filewatch_cleanup(void);
+
+bool filewatch_poll(void);
+bool filewatch_changed(int id);
+
+#if defined __cplusplus
+  }
+#endif
+
+#endif /* _FILEWATCH_H */
@@ -26,7 +26,7 @@ int font_locate(char *path, size_t maxlength, const char *family, const char *st
   FcPattern *pat;
   FcFontSet *fs;
   FcObjectSet *os;
-  FcChar8 *s, *ptr;
+  FcChar8 *ptr;
   FcConfig *config;
   int i, match;
   char *style_copy;
@@ -46,18 +46,23 @@ int font_locate(char *path, size_t maxlength, const char *family, const char *st
   for (i = 1; i < MAX_STYLES && style_fields[i - 1] != NULL; i++)
     style_fields[i] = strtok(NULL, " ");
 
-  if (!FcInit())
+  if (!FcInit()) {
+    free(style_copy);
     return 0;
+  }
   config = FcConfigGetCurrent();
   FcConfigSetRescanInterval(config, 0);
 
+  /* let fontconfig pre-select on the family, so that only a handful of
+     fonts need to be checked (instead of every installed font) */
   pat = FcPatternCreate();
+  if (pat != NULL)
+    FcPatternAddString(pat, FC_FAMILY, (const FcChar8*)family);
   os = FcObjectSetBuild(FC_FAMILY, FC_STYLE, FC_FILE, (char *) 0);
   fs = FcFontList(config, pat, os);
   match = 0;
   for (i=0; fs && i < fs->nfont && !match; i++) {
     FcPattern *font = fs->fonts[i];
-    s = FcNameUnparse(font);
     match = 1;
     if (FcPatternGetString(font, FC_FAMILY, 0, &ptr) == FcResultMatch) {
       if (strcasecmp((const char*)ptr, family) != 0)
@@ -85,7 +90,7 @@ int font_locate(char *path, size_t maxlength, const char *family, const char *st
             if (strcasecmp(token, style_fields[idx]) == 0)
               break;
           if (idx < MAX_STYLES && style_fields[idx] != NULL)
-            styles_to_match &= ~(1 << match); /* font style found in styles to match */
+            styles_to_match &= ~(1 << idx); /* font style found in styles to match */
           else
             match = 0;  /* font style not found in styles to match, this font has a different style */
         }
@@ -102,7 +107,6 @@ int font_locate(char *path, size_t maxlength, const char *family, const char *st
     } else {
       match = 0;
     }
-    free(s);
   }
   free(style_copy);
   if (fs)
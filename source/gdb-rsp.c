@@ -25,11 +25,15 @@
 #include <assert.h>
 #include <ctype.h>
 #include <stdbool.h>
+#include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
 #include "bmp-support.h"
+#include "c11threads.h"
 #include "gdb-rsp.h"
+#include "hexcodec.h"
+#include "perfstats.h"
 #include "rs232.h"
 #include "tcpip.h"
 
@@ -39,13 +43,60 @@
 
 
 #define TIMEOUT       500
-#define POLL_INTERVAL 50
 #define RETRIES       3
 
+/* A session recording starts with a signature, followed by records. Each
+   record has a 9-byte header: the direction ('>' for transmitted data, '<'
+   for received data), the timestamp in microseconds since the start of the
+   recording, and the data length (both 32-bit Little Endian). */
+#define BATCH_MAX         16384       /* max. transmit data collected in a batch */
 
-static unsigned char *cache = NULL; /* cache for received data */
-static size_t cache_size = 0;       /* maximum size of the cache */
-static size_t cache_idx = 0;        /* index to the free area of the cache */
+#define RECORD_SIGNATURE  "BMRSP01"   /* 8 bytes, including the zero byte */
+#define RECORD_HDRSIZE    9
+
+
+enum {
+  FRAME_IDLE,       /* waiting for '$' */
+  FRAME_PAYLOAD,    /* collecting the payload */
+  FRAME_CHKSUM1,    /* '#' seen, waiting for the first checksum digit */
+  FRAME_CHKSUM2,    /* waiting for the second checksum digit */
+};
+
+struct tagGDBRSP_CONTEXT {
+  unsigned char *cache; /* ring buffer for received data */
+  size_t cache_size;    /* size of the ring buffer (a power of 2) */
+  size_t cache_head;    /* write index (free running) */
+  size_t cache_tail;    /* read index, start of unconsumed data */
+  size_t cache_scan;    /* next byte to be scanned by the parser */
+  int frame_state;
+  size_t frame_start;   /* index of the first payload byte */
+  size_t frame_end;     /* index of the '#' */
+  unsigned frame_sum;   /* running checksum over the payload */
+  unsigned frame_chksum;/* checksum in the packet */
+  bool noack_mode;      /* set after QStartNoAckMode is accepted */
+  bool batching;        /* collect transmitted frames (in no-ack mode) */
+  unsigned char *batch; /* frames collected for a single transmission */
+  size_t batch_size;
+  FILE *record;         /* session recording (NULL if not recording) */
+  unsigned long long record_start;
+  FILE *replay;         /* session recording being replayed (or NULL) */
+  bool replay_realtime; /* replay with the recorded timing */
+  long long replay_base;/* host time that matches time 0 of the recording */
+  int replay_type;      /* direction of the current record (0 at end of file) */
+  unsigned long replay_stamp;   /* timestamp of the current record */
+  unsigned long replay_left;    /* bytes not yet consumed in the current record */
+  unsigned long replay_mismatch;/* transmitted bytes that differ from the recording */
+};
+
+static GDBRSP_CONTEXT default_context = { NULL, 0, 0, 0, 0, FRAME_IDLE, 0, 0, 0, 0, false,
+                                          false, NULL, 0,
+                                          NULL, 0, NULL, false, 0, 0, 0, 0, 0 };
+static thread_local GDBRSP_CONTEXT *current_context = NULL;
+
+static inline GDBRSP_CONTEXT *context(void)
+{
+  return (current_context != NULL) ? current_context : &default_context;
+}
 
 
 static inline int hex2int(char ch)
@@ -84,16 +135,183 @@ static inline char int2hex(int v)
 bool gdbrsp_hex2array(const char *hex, unsigned char *byte, size_t size)
 {
   assert(hex != NULL && byte != NULL);
-  while (hex[0] != '\0' && hex[1] != '\0' && size > 0) {
-    int h = hex2int(hex[0]);
-    int l = hex2int(hex[1]);
-    if (h == -1 || l == -1)
-      return false;
-    *byte++ = (unsigned char)((h << 4) | l);
-    hex += 2;
-    size -= 1;
+  size_t count = strlen(hex) / 2;
+  if (count > size)
+    count = size;
+  if (hexcodec_decode(hex, 2 * count, byte) < count)
+    return false;
+  return hex[2 * count] == '\0';
+}
+
+/* timestamp() and microseconds() are on the shared monotonic time base of
+   perf_timestamp(), so that RSP traffic can be related to SWO and serial data */
+static unsigned long timestamp(void)
+{
+  return (unsigned long)(perf_timestamp() / 1000000);
+}
+
+/* remaining() returns the time left until the timeout, relative to the start
+   time, or -1 for "no timeout" */
+static int remaining(unsigned long start, int timeout)
+{
+  if (timeout < 0)
+    return -1;
+  unsigned long elapsed = timestamp() - start;
+  return (elapsed < (unsigned long)timeout) ? (int)(timeout - elapsed) : 0;
+}
+
+static unsigned long long microseconds(void)
+{
+  return perf_timestamp() / 1000;
+}
+
+static void sleep_us(unsigned long long usec)
+{
+# if defined _WIN32
+    Sleep((DWORD)((usec + 999) / 1000));
+# else
+    usleep((useconds_t)usec);
+# endif
+}
+
+static void record_write(GDBRSP_CONTEXT *rsp, int type, const unsigned char *data, size_t size)
+{
+  unsigned long stamp = (unsigned long)(microseconds() - rsp->record_start);
+  unsigned char hdr[RECORD_HDRSIZE];
+  hdr[0] = (unsigned char)type;
+  for (int i = 0; i < 4; i++) {
+    hdr[1 + i] = (unsigned char)(stamp >> 8 * i);
+    hdr[5 + i] = (unsigned char)(size >> 8 * i);
+  }
+  fwrite(hdr, 1, RECORD_HDRSIZE, rsp->record);
+  fwrite(data, 1, size, rsp->record);
+}
+
+/* replay_next() reads the header of the next record; at the end of the file,
+   the record type is set to zero */
+static void replay_next(GDBRSP_CONTEXT *rsp)
+{
+  unsigned char hdr[RECORD_HDRSIZE];
+  if (rsp->replay_left > 0)
+    fseek(rsp->replay, rsp->replay_left, SEEK_CUR);  /* skip unused data */
+  rsp->replay_left = 0;
+  if (fread(hdr, 1, RECORD_HDRSIZE, rsp->replay) != RECORD_HDRSIZE || (hdr[0] != '<' && hdr[0] != '>')) {
+    rsp->replay_type = 0;
+    return;
+  }
+  rsp->replay_type = hdr[0];
+  rsp->replay_stamp = 0;
+  for (int i = 3; i >= 0; i--) {
+    rsp->replay_stamp = (rsp->replay_stamp << 8) | hdr[1 + i];
+    rsp->replay_left = (rsp->replay_left << 8) | hdr[5 + i];
+  }
+}
+
+/* replay_xmit() compares the transmitted data to the data in the recording;
+   it also synchronizes the replay clock to the transmission, so that replies
+   come with the recorded delay (in real-time replay) */
+static void replay_xmit(GDBRSP_CONTEXT *rsp, const unsigned char *data, size_t size)
+{
+  while (size > 0) {
+    while (rsp->replay_type != 0 && rsp->replay_left == 0)
+      replay_next(rsp);
+    if (rsp->replay_type != '>') {
+      rsp->replay_mismatch += size;   /* more data than in the recording */
+      break;
+    }
+    int ch = fgetc(rsp->replay);
+    rsp->replay_left -= 1;
+    if (ch != *data)
+      rsp->replay_mismatch += 1;
+    data++;
+    size--;
+  }
+  rsp->replay_base = (long long)microseconds() - rsp->replay_stamp;
+}
+
+/* replay_recv() returns received data from the recording */
+static size_t replay_recv(GDBRSP_CONTEXT *rsp, unsigned char *buffer, size_t size, int timeout)
+{
+  while (rsp->replay_type != 0 && rsp->replay_left == 0)
+    replay_next(rsp);
+  if (rsp->replay_type != '<') {
+    /* in the recording, no data arrived before the host transmitted again,
+       so the host timed out */
+    if (rsp->replay_realtime && timeout > 0)
+      sleep_us(1000ull * timeout);
+    return 0;
+  }
+  if (rsp->replay_realtime) {
+    long long delay = rsp->replay_base + rsp->replay_stamp - (long long)microseconds();
+    if (delay > 0) {
+      if (timeout == 0)
+        return 0;   /* only polled, and the data has not "arrived" yet */
+      sleep_us(delay);
+    }
+  }
+  if (size > rsp->replay_left)
+    size = rsp->replay_left;
+  size = fread(buffer, 1, size, rsp->replay);
+  rsp->replay_left -= size;
+  return size;
+}
+
+static void transport_send(GDBRSP_CONTEXT *rsp, const unsigned char *data, size_t size)
+{
+  if (rsp->replay != NULL) {
+    replay_xmit(rsp, data, size);
+    return;
+  }
+  if (bmp_comport() != NULL)
+    rs232_xmit(bmp_comport(), data, size);
+  else
+    tcpip_xmit(data, size);
+  if (rsp->record != NULL)
+    record_write(rsp, '>', data, size);
+}
+
+static void batch_flush(GDBRSP_CONTEXT *rsp)
+{
+  if (rsp->batch_size > 0) {
+    transport_send(rsp, rsp->batch, rsp->batch_size);
+    rsp->batch_size = 0;
+  }
+}
+
+/* transport_xmit() sends the data, or appends it to the batch; a batch is
+   sent before the next receive (or when it is full) */
+static void transport_xmit(const unsigned char *data, size_t size)
+{
+  GDBRSP_CONTEXT *rsp = context();
+  if (rsp->batching && rsp->noack_mode && size <= BATCH_MAX) {
+    if (rsp->batch == NULL)
+      rsp->batch = malloc(BATCH_MAX);
+    if (rsp->batch != NULL) {
+      if (rsp->batch_size + size > BATCH_MAX)
+        batch_flush(rsp);
+      memcpy(rsp->batch + rsp->batch_size, data, size);
+      rsp->batch_size += size;
+      return;
+    }
   }
-  return *hex == '\0';
+  batch_flush(rsp);   /* keep the order */
+  transport_send(rsp, data, size);
+}
+
+static size_t recvwait(unsigned char *buffer, size_t size, int timeout)
+{
+  GDBRSP_CONTEXT *rsp = context();
+  batch_flush(rsp);
+  if (rsp->replay != NULL)
+    return replay_recv(rsp, buffer, size, timeout);
+  size_t count;
+  if (bmp_comport() != NULL)
+    count = rs232_recvwait(bmp_comport(), buffer, size, timeout);
+  else
+    count = tcpip_recvwait(buffer, size, timeout);
+  if (rsp->record != NULL && count > 0)
+    record_write(rsp, '<', buffer, count);
+  return count;
 }
 
 /** gdbrsp_packetsize() sets the maximum size of incoming packets. It uses
@@ -103,23 +321,205 @@ bool gdbrsp_hex2array(const char *hex, unsigned char *byte, size_t size)
  */
 void gdbrsp_packetsize(size_t size)
 {
+  GDBRSP_CONTEXT *rsp = context();
   if (size == 0) {
-    if (cache != NULL) {
-      free(cache);
-      cache = NULL;
+    if (rsp->cache != NULL) {
+      free(rsp->cache);
+      rsp->cache = NULL;
+    }
+    if (rsp->batch != NULL) {
+      batch_flush(rsp);
+      free(rsp->batch);
+      rsp->batch = NULL;
     }
-    cache_size = size;
-    cache_idx = 0;
-  } else if (size > cache_size) {
-    unsigned char *buf = malloc(size * sizeof(char));
+    rsp->cache_size = 0;
+    rsp->cache_head = rsp->cache_tail = rsp->cache_scan = 0;
+    rsp->frame_state = FRAME_IDLE;
+  } else if (size > rsp->cache_size) {
+    /* the ring buffer size is a power of 2 */
+    size_t newsize = 256;
+    while (newsize < size)
+      newsize <<= 1;
+    unsigned char *buf = malloc(newsize * sizeof(char));
     if (buf != NULL) {
-      if (cache != NULL) {
-        memcpy(buf, cache, cache_idx * sizeof(char));
-        free(cache);
+      /* copy the pending data, so that it starts at index 0 */
+      size_t count = rsp->cache_head - rsp->cache_tail;
+      for (size_t idx = 0; idx < count; idx++)
+        buf[idx] = rsp->cache[(rsp->cache_tail + idx) & (rsp->cache_size - 1)];
+      rsp->cache_scan -= rsp->cache_tail;
+      rsp->frame_start -= rsp->cache_tail;
+      rsp->frame_end -= rsp->cache_tail;
+      rsp->cache_tail = 0;
+      rsp->cache_head = count;
+      if (rsp->cache != NULL)
+        free(rsp->cache);
+      rsp->cache = buf;
+      rsp->cache_size = newsize;
+    }
+  }
+}
+
+static void send_ack(const char *code)
+{
+  GDBRSP_CONTEXT *rsp = context();
+  if (rsp->noack_mode)
+    return;
+  transport_xmit((const unsigned char*)code, 1);
+}
+
+/* decode_frame() copies the payload of the received packet into the buffer,
+   decoding it on the fly; it returns the decoded size (which may exceed the
+   buffer size) */
+static size_t decode_frame(char *buffer, size_t size)
+{
+  GDBRSP_CONTEXT *rsp = context();
+  size_t mask = rsp->cache_size - 1;
+  size_t idx = rsp->frame_start;
+  size_t count = 0;
+  if (rsp->frame_end - rsp->frame_start >= 3 && rsp->cache[idx & mask] == 'O'
+      && isxdigit(rsp->cache[(idx + 1) & mask]) && isxdigit(rsp->cache[(idx + 2) & mask]))
+  {
+    /* convert the first letter to a lower-case 'o', so that an output
+       message of the single letter 'K' won't be mis-interpreted as 'OK' */
+    if (count < size)
+      buffer[count] = 'o';
+    count++;
+    /* decode the runs that are contiguous in the ring buffer in bulk; the
+       output is truncated at an invalid hex digit */
+    for (idx += 1; idx + 1 < rsp->frame_end && count < size; ) {
+      size_t pos = idx & mask;
+      size_t span = rsp->frame_end - idx;
+      if (span > rsp->cache_size - pos)
+        span = rsp->cache_size - pos;
+      span /= 2;
+      if (span > size - count)
+        span = size - count;
+      if (span == 0) {
+        /* the pair of digits wraps around the end of the ring buffer */
+        int h = hex2int(rsp->cache[pos]);
+        int l = hex2int(rsp->cache[(idx + 1) & mask]);
+        if (h < 0 || l < 0)
+          return count;
+        buffer[count++] = (char)((h << 4) | l);
+        idx += 2;
+        continue;
+      }
+      size_t decoded = hexcodec_decode((const char*)rsp->cache + pos, 2 * span, (unsigned char*)buffer + count);
+      count += decoded;
+      idx += 2 * decoded;
+      if (decoded < span)
+        return count;
+    }
+    if (idx + 1 < rsp->frame_end)
+      count += (rsp->frame_end - idx) / 2;  /* data that did not fit in the buffer */
+  } else {
+    while (idx < rsp->frame_end) {
+      char ch = rsp->cache[idx++ & mask];
+      if (ch == '}' && idx < rsp->frame_end)
+        ch = rsp->cache[idx++ & mask] ^ 0x20;  /* escaped binary encoding */
+      /* the Black Magic Probe does currently not support run-length
+         encoding, so we currently do not check for it */
+      if (count < size)
+        buffer[count] = ch;
+      count++;
+    }
+  }
+  return count;
+}
+
+/* copy_frame() copies the received packet into the buffer as is, including
+   the '$' prefix and the '#nn' suffix; it returns the frame size (which may
+   exceed the buffer size) */
+static size_t copy_frame(char *buffer, size_t size)
+{
+  GDBRSP_CONTEXT *rsp = context();
+  size_t mask = rsp->cache_size - 1;
+  size_t count = 0;
+  for (size_t idx = rsp->frame_start - 1; idx != rsp->cache_scan; idx++) {
+    if (count < size)
+      buffer[count] = (char)rsp->cache[idx & mask];
+    count++;
+  }
+  return count;
+}
+
+/* receive() waits for a packet; the packet is either decoded (see
+   gdbrsp_recv()) or copied verbatim (see gdbrsp_recv_frame()) */
+static size_t receive(char *buffer, size_t size, int timeout, bool raw)
+{
+  GDBRSP_CONTEXT *rsp = context();
+  if (!bmp_isopen())
+    return 0;
+  if (rsp->cache == NULL) {
+    gdbrsp_packetsize(256);
+    if (rsp->cache == NULL)
+      return 0;
+  }
+
+  unsigned long start = timestamp();
+  for ( ;; ) {
+    /* scan the data that was not yet scanned */
+    size_t mask = rsp->cache_size - 1;
+    while (rsp->cache_scan != rsp->cache_head) {
+      unsigned char ch = rsp->cache[rsp->cache_scan++ & mask];
+      switch (rsp->frame_state) {
+      case FRAME_IDLE:
+        /* throw away everything before the start character */
+        if (ch == '$') {
+          rsp->frame_state = FRAME_PAYLOAD;
+          rsp->frame_start = rsp->cache_scan;
+          rsp->frame_sum = 0;
+        }
+        rsp->cache_tail = rsp->cache_scan - ((ch == '$') ? 1 : 0);  /* keep the '$' for copy_frame() */
+        break;
+      case FRAME_PAYLOAD:
+        if (ch == '#') {
+          rsp->frame_end = rsp->cache_scan - 1;
+          rsp->frame_state = FRAME_CHKSUM1;
+        } else {
+          rsp->frame_sum += ch;
+        }
+        break;
+      case FRAME_CHKSUM1:
+        rsp->frame_chksum = hex2int(ch) << 4;
+        rsp->frame_state = FRAME_CHKSUM2;
+        break;
+      case FRAME_CHKSUM2:
+        rsp->frame_chksum |= hex2int(ch);
+        rsp->frame_state = FRAME_IDLE;
+        if ((rsp->frame_sum & 0xff) == rsp->frame_chksum) {
+          /* confirm reception and copy to the buffer */
+          send_ack("+");
+          size_t count = raw ? copy_frame(buffer, size) : decode_frame(buffer, size);
+          rsp->cache_tail = rsp->cache_scan;  /* remove the packet from the cache */
+          return count;             /* return payload size (or frame size) */
+        }
+        send_ack("-");  /* in no-ack mode, the packet is just dropped */
+        rsp->cache_tail = rsp->cache_scan;
+        break;
       }
-      cache = buf;
-      cache_size = size;
     }
+
+    /* if the cache is full without holding a complete packet, the packet is
+       bigger than the cache size (this should never happen), drop it */
+    if (rsp->cache_head - rsp->cache_tail == rsp->cache_size) {
+      rsp->cache_tail = rsp->cache_head;
+      rsp->frame_state = FRAME_IDLE;
+    }
+
+    /* block until data arrives, read up to the end of the ring buffer (the
+       remainder is read on the next iteration) */
+    int wait = remaining(start, timeout);
+    size_t offs = rsp->cache_head & mask;
+    size_t room = rsp->cache_size - (rsp->cache_head - rsp->cache_tail);
+    if (room > rsp->cache_size - offs)
+      room = rsp->cache_size - offs;
+    size_t count = recvwait(rsp->cache + offs, room, wait);
+    rsp->cache_head += count;
+    if (count == 0 && (remaining(start, timeout) == 0 || rsp->replay != NULL))
+      return 0;       /* nothing received within timeout period */
+    if (!bmp_isopen())
+      return 0;       /* connection was lost while waiting */
   }
 }
 
@@ -128,11 +528,10 @@ void gdbrsp_packetsize(size_t size)
  *  \param buffer   Will hold the received data, but the payload only (so the
  *                  '$' at the start and the checksum at the end are stripped
  *                  off).
- *  \param size     The maximum number of bytes that the buffer can hold. Note
- *                  that the checksum bytes are stored in this buffer before
- *                  analysis, so the buffer must be 3 bytes larger than the
- *                  largest expected response).
- *  \param timeout  Time to wait for a response, in ms.
+ *  \param size     The maximum number of bytes that the buffer can hold.
+ *  \param timeout  Time to wait for a response, in ms. If zero, only the data
+ *                  that was already received is checked; if negative, the
+ *                  function waits indefinitely.
  *
  *  \return The number of bytes received, or zero on time-out (or error). The
  *          return value can be bigger than parameter size, which indicates that
@@ -142,236 +541,340 @@ void gdbrsp_packetsize(size_t size)
  *  \note Console output messages by the target will have a lower case 'o' at
  *        the start of the output buffer (not an upper case letter). The message
  *        has already been translated from hex encoding to ASCII.
+ *
+ *  \note The received data is kept in a ring buffer, and the framing state is
+ *        kept between calls, so that each received byte is scanned only once.
  */
 size_t gdbrsp_recv(char *buffer, size_t size, int timeout)
 {
-  if (!bmp_isopen())
-    return 0;
-  if (cache == NULL) {
-    gdbrsp_packetsize(256);
-    if (cache == NULL)
-      return 0;
-  }
-
-  int cycles = (timeout < 0) ? -1 : (timeout + POLL_INTERVAL - 1) / POLL_INTERVAL;
-  int chk_cache = (cache_idx > 0);  /* analyse data in the cache even if no new data is received */
-  size_t head = 0;
-  while (cache_idx < cache_size) {
-    size_t count;
-    if (bmp_comport() != NULL)
-      count = rs232_recv(bmp_comport(), cache + cache_idx, cache_size - cache_idx);
-    else
-      count = tcpip_recv(cache + cache_idx, cache_size - cache_idx);
-    cache_idx += count;
-    if (count > 0 || chk_cache) {
-      chk_cache = 0;
-      /* check start character (throw away everything before this) */
-      if (head == 0) {
-        size_t idx;
-        for (idx = 0; idx < cache_idx && cache[idx] != '$'; idx++)
-          /* nothing */;
-        if (idx == cache_idx) {
-          cache_idx = 0;        /* throw away all received data */
-        } else {
-          assert(idx < cache_idx && cache[idx] == '$');
-          head = idx + 1;       /* also skip '$' */
-        }
-      }
-      /* check whether we have an end mark and a checksum */
-      size_t tail;
-      for (tail = head; tail < cache_idx && cache[tail] != '#'; tail++)
-        /* nothing */;
-      if (tail + 2 < cache_idx) {
-        /* '#' found and 2 characters follow, verify the checksum */
-        int chksum = (hex2int(cache[tail + 1]) << 4) | hex2int(cache[tail + 2]);
-        int sum = 0;
-        for (size_t idx = head; idx < tail; idx++)
-          sum += cache[idx];
-        sum &= 0xff;
-        if (sum == chksum) {
-          /* confirm reception and copy to the buffer */
-          if (bmp_comport() != NULL)
-            rs232_xmit(bmp_comport(), (const unsigned char*)"+", 1);
-          else
-            tcpip_xmit((const unsigned char*)"+", 1);
-          count = tail - head;  /* number of payload bytes */
-          if (count >= 3 && cache[head] == 'O' && isxdigit(cache[head + 1]) && isxdigit(cache[head + 2])) {
-            /* convert the first letter to a lower-case 'o', so that an output
-               message of the single letter 'K' won't be mis-interpreted as 'OK' */
-            buffer[0] = 'o';
-            count = (count + 1) / 2;
-            unsigned c;
-            size_t idx;
-            for (c = 1, idx = head + 1; c < count && c < size; c += 1, idx += 2)
-              buffer[c] = (char)((hex2int(cache[idx]) << 4) | hex2int(cache[idx + 1]));
-          } else {
-            unsigned c;
-            size_t idx;
-            for (c = 0, idx = head; c < count && c < size; c += 1, idx += 1) {
-              if (cache[idx] == '}') {
-                /* escaped binary encoding */
-                idx += 1;
-                buffer[c] = cache[idx] ^ 0x20;
-              } else {
-                buffer[c] = cache[idx];
-                /* the Black Magic Probe does currently not support run-length
-                   encoding, so we currently do not check for it */
-              }
-            }
-          }
-          /* remove the packet from the cache */
-          tail += 3;
-          assert(tail <= cache_idx);
-          if (tail < cache_idx)
-            memmove(cache, cache + tail, cache_idx - tail);
-          cache_idx -= tail;
-          return count; /* return payload size (excluding checksum) */
-        } else {
-          /* send NAK */
-          if (bmp_comport() != NULL)
-            rs232_xmit(bmp_comport(), (const unsigned char*)"-", 1);
-          else
-            tcpip_xmit((const unsigned char*)"-", 1);
-        }
-        /* remove the packet from the cache */
-        tail += 3;
-        assert(tail <= cache_idx);
-        if (tail < cache_idx)
-          memmove(cache, cache + tail, cache_idx - tail);
-        cache_idx -= tail;
-        head = 0;
-      }
-    }
-    if (cycles > 0 && --cycles == 0)
-      return 0;       /* nothing received within timeout period */
-#   if defined _WIN32
-      Sleep(POLL_INTERVAL);
-#   else
-      usleep(POLL_INTERVAL * 1000);
-#   endif
-  }
+  return receive(buffer, size, timeout, false);
+}
 
-  /* when arrived here, tail == size (so the buffer is filled to its maximum),
-     but no end mark with checksum was yet received, meaning that the buffer was
-     too small; this should never happen */
-  assert(0);
-  return 0;
+/** gdbrsp_recv_frame() returns a received packet (from the gdbserver) as it
+ *  was received: with the '$' prefix and the '#nn' suffix, and without
+ *  decoding the payload. This is for passing the packet on to another RSP
+ *  client.
+ *
+ *  \param frame    Will hold the received frame.
+ *  \param size     The maximum number of bytes that the buffer can hold.
+ *  \param timeout  Time to wait for a response, in ms (see gdbrsp_recv()).
+ *
+ *  \return The size of the frame, or zero on time-out (or error). If the
+ *          return value is bigger than parameter size, the buffer contains
+ *          a truncated frame.
+ */
+size_t gdbrsp_recv_frame(unsigned char *frame, size_t size, int timeout)
+{
+  return receive((char*)frame, size, timeout, true);
 }
 
-/** gdbrsp_xmit() transmits a packet to the gdbserver.
+/** gdbrsp_encode() builds the complete frame for a packet: it adds the '$'
+ *  prefix and the '#nn' suffix, and escapes (or hex-encodes) the payload.
  *
- *  \param buffer   The buffer. It must contain a complete command, but without
- *                  the '$' prefix and the '#nn' suffix (where 'nn' is the
- *                  checksum).
- *  \param size     The number of characters/bytes in the buffer. If set to -1,
- *                  the buffer is assumed to contain a zero-terminated string.
+ *  \param buffer     The buffer. It must contain a complete command, but
+ *                    without the '$' prefix and the '#nn' suffix.
+ *  \param size       The number of characters/bytes in the buffer. If set to
+ *                    -1, the buffer is assumed to contain a zero-terminated
+ *                    string.
+ *  \param frame      Will hold the encoded frame. This parameter may be NULL,
+ *                    to only get the required size.
+ *  \param framesize  The size of the "frame" buffer.
  *
- *  \return true on success, false on timeout or error.
+ *  \return The size of the frame. If this is bigger than parameter
+ *          "framesize", the frame buffer is not filled in.
  */
-bool gdbrsp_xmit(const char *buffer, int size)
+size_t gdbrsp_encode(const char *buffer, int size, unsigned char *frame, size_t framesize)
 {
   assert(buffer != NULL);
-  if (!bmp_isopen())
-    return false;
-
-  size_t buflen = (size == -1) ? strlen(buffer) : size;
+  size_t buflen = (size == -1) ? strlen(buffer) : (size_t)size;
   size_t payload_offs = 0;
+  size_t fullsize = 0;
   if (buflen > 6 && memcmp(buffer, "qRcmd,", 6) == 0) {
     payload_offs = 6;
   } else if (buflen > 5 && memcmp(buffer, "vRun;", 5) == 0) {
     payload_offs = 5;
   } else {
-    size = 0;
     for (size_t idx = 0; idx < buflen; idx++) {
-      size += 1;
+      fullsize += 1;
       if (buffer[idx] == '$' || buffer[idx] == '#' || buffer[idx] == '}')
-        size += 1;      /* these characters must be escaped */
+        fullsize += 1;  /* these characters must be escaped */
     }
   }
   if (payload_offs > 0)
-    size = ((buflen - payload_offs) * 2) + payload_offs;  /* payload is hex-encoded */
-  size += 4;            /* add '$' prefix and '#nn' suffix */
-
-  unsigned char *fullbuffer = malloc(size);
-  if (fullbuffer == NULL)
-    return false;
+    fullsize = ((buflen - payload_offs) * 2) + payload_offs;  /* payload is hex-encoded */
+  fullsize += 4;        /* add '$' prefix and '#nn' suffix */
+  if (frame == NULL || framesize < fullsize)
+    return fullsize;
 
   /* add prefix, handle payload */
-  *fullbuffer = '$';
+  *frame = '$';
   if (payload_offs > 0) {
-    const char *src = buffer + payload_offs;
-    unsigned char *dest = fullbuffer + payload_offs + 1;
-    size_t count = buflen - payload_offs;
-    memcpy(fullbuffer + 1, buffer, payload_offs); /* copy qRcmd or vRun */
-    while (count > 0) {
-      *dest++ = int2hex((*src >> 4) & 0x0f);
-      *dest++ = int2hex(*src & 0x0f);
-      src++;
-      count--;
-    }
+    memcpy(frame + 1, buffer, payload_offs); /* copy qRcmd or vRun */
+    hexcodec_encode((const unsigned char*)buffer + payload_offs, buflen - payload_offs,
+                    (char*)frame + payload_offs + 1);
   } else {
     const char *src = buffer;
-    unsigned char *dest = fullbuffer + 1;
+    unsigned char *dest = frame + 1;
     for (size_t idx = 0; idx < buflen; idx++) {
-      for (idx = 0; idx < buflen; idx++) {
-        if (*src == '$' || *src == '#' || *src == '}') {
-          *dest++ = '}';        /* these characters must be escaped */
-          *dest++ = *src++ ^ 0x20;
-        } else {
-          *dest++ = *src++;
-        }
+      if (*src == '$' || *src == '#' || *src == '}') {
+        *dest++ = '}';        /* these characters must be escaped */
+        *dest++ = *src++ ^ 0x20;
+      } else {
+        *dest++ = *src++;
       }
     }
   }
   /* add checksum */
   int sum = 0;
-  for (int idx = 1; idx < size - 3; idx++)
-    sum += fullbuffer[idx];     /* run over fullbuffer, so that the checksum is over the translated buffer */
-  *(fullbuffer + size - 3) = '#';
-  *(fullbuffer + size - 2) = int2hex((sum >> 4) & 0x0f);
-  *(fullbuffer + size - 1) = int2hex(sum & 0x0f);
+  for (size_t idx = 1; idx < fullsize - 3; idx++)
+    sum += frame[idx];    /* run over frame, so that the checksum is over the translated buffer */
+  *(frame + fullsize - 3) = '#';
+  *(frame + fullsize - 2) = int2hex((sum >> 4) & 0x0f);
+  *(frame + fullsize - 1) = int2hex(sum & 0x0f);
+  return fullsize;
+}
 
+/** gdbrsp_xmit_frame() transmits a frame that was built with gdbrsp_encode()
+ *  to the gdbserver.
+ *
+ *  \return true on success, false on timeout or error.
+ */
+bool gdbrsp_xmit_frame(const unsigned char *frame, size_t size)
+{
+  GDBRSP_CONTEXT *rsp = context();
+  assert(frame != NULL);
+  if (!bmp_isopen())
+    return false;
+
+  PERF_TIMER_BEGIN(tstart);
   for (int retry = 0; retry < RETRIES; retry++) {
-    if (bmp_comport() != NULL)
-      rs232_xmit(bmp_comport(), fullbuffer, size);
-    else
-      tcpip_xmit(fullbuffer, size);
-    for (int cycle = 0; cycle < TIMEOUT / POLL_INTERVAL; cycle++) {
-      size_t count;
-      do {
-        unsigned char buf[10];
-        if (bmp_comport() != NULL)
-          count = rs232_recv(bmp_comport(), buf, 1);
-        else
-          count = tcpip_recv(buf, 1);
-        if (count == 1) {
-          if (buf[0] == '+') {
-            free(fullbuffer);
-            return true;
-          }
-          if (buf[0] == '-') {
-            cycle = TIMEOUT / POLL_INTERVAL;  /* retransmit without timeout */
-            break;
-          }
+    if (retry > 0)
+      PERF_COUNT("rsp.retransmit", 1);
+    transport_xmit(frame, size);
+    if (rsp->noack_mode)
+      return true;      /* no acknowledge to wait for */
+    unsigned long start = timestamp();
+    int wait;
+    while ((wait = remaining(start, TIMEOUT)) > 0 && bmp_isopen()) {
+      unsigned char buf[1];
+      if (recvwait(buf, 1, wait) == 1) {
+        if (buf[0] == '+') {
+          PERF_TIMER_END(tstart, "rsp.ack");
+          return true;
         }
-      } while (count == 1);
-      #if defined _WIN32
-        Sleep(POLL_INTERVAL);
-      #else
-        usleep(POLL_INTERVAL * 1000);
-      #endif
+        if (buf[0] == '-')
+          break;        /* retransmit without timeout */
+      } else if (rsp->replay != NULL) {
+        break;          /* the recording has no acknowledge, so it timed out */
+      }
     }
   }
 
-  free(fullbuffer);
+  PERF_COUNT("rsp.failed", 1);
   return false;
 }
 
+/** gdbrsp_xmit() transmits a packet to the gdbserver.
+ *
+ *  \param buffer   The buffer. It must contain a complete command, but without
+ *                  the '$' prefix and the '#nn' suffix (where 'nn' is the
+ *                  checksum).
+ *  \param size     The number of characters/bytes in the buffer. If set to -1,
+ *                  the buffer is assumed to contain a zero-terminated string.
+ *
+ *  \return true on success, false on timeout or error.
+ */
+bool gdbrsp_xmit(const char *buffer, int size)
+{
+  assert(buffer != NULL);
+  if (!bmp_isopen())
+    return false;
+
+  size_t framesize = gdbrsp_encode(buffer, size, NULL, 0);
+  unsigned char *frame = malloc(framesize);
+  if (frame == NULL)
+    return false;
+  gdbrsp_encode(buffer, size, frame, framesize);
+  bool result = gdbrsp_xmit_frame(frame, framesize);
+  free(frame);
+  return result;
+}
+
+/** gdbrsp_noack() sets or clears "no-ack" mode. Enable this mode after the
+ *  gdbserver has accepted the QStartNoAckMode packet; then the packets are no
+ *  longer acknowledged (in either direction). Clear it when the connection is
+ *  closed.
+ */
+void gdbrsp_noack(bool enable)
+{
+  GDBRSP_CONTEXT *rsp = context();
+  batch_flush(rsp);
+  rsp->noack_mode = enable;
+}
+
+/** gdbrsp_batch() starts or ends a batch of commands. In no-ack mode, the
+ *  frames that are transmitted during a batch are collected and sent in a
+ *  single write, when the batch ends or just before the next receive.
+ *  This cuts the per-packet overhead of the transport for pipelined
+ *  commands (and the number of TCP segments over a network connection). In
+ *  ack mode, every packet waits for its acknowledge, so there is nothing
+ *  to batch and this function has no effect.
+ */
+void gdbrsp_batch(bool enable)
+{
+  GDBRSP_CONTEXT *rsp = context();
+  if (!enable)
+    batch_flush(rsp);
+  rsp->batching = enable;
+}
+
 /** gdbrsp_clear() clears the cache, to remove any superfluous OK or error
  *  codes that GDB sent.
  */
 void gdbrsp_clear(void)
 {
-  cache_idx = 0;
+  GDBRSP_CONTEXT *rsp = context();
+  rsp->cache_tail = rsp->cache_scan = rsp->cache_head;
+  rsp->frame_state = FRAME_IDLE;
+}
+
+/** gdbrsp_record() starts or stops recording the session: all data that is
+ *  transmitted to and received from the gdbserver is written to a file, with
+ *  timestamps. The recording can be played back with gdbrsp_replay().
+ *
+ *  \param filename  The name of the file to record to, or NULL to stop
+ *                    recording (and close the file).
+ *
+ *  \return true on success, false on failure (the file cannot be created, or
+ *          a recording is being replayed).
+ *
+ *  \note For a recording over USB that can be replayed with bmp_connect(), the
+ *        recording must start before the connection is made, so that it holds
+ *        the handshake.
+ */
+bool gdbrsp_record(const char *filename)
+{
+  GDBRSP_CONTEXT *rsp = context();
+  if (rsp->record != NULL) {
+    fclose(rsp->record);
+    rsp->record = NULL;
+  }
+  if (filename == NULL)
+    return true;
+  if (rsp->replay != NULL)
+    return false;
+  rsp->record = fopen(filename, "wb");
+  if (rsp->record == NULL)
+    return false;
+  fwrite(RECORD_SIGNATURE, 1, sizeof RECORD_SIGNATURE, rsp->record);
+  rsp->record_start = microseconds();
+  return true;
+}
+
+/** gdbrsp_replay() starts or stops the replay of a recorded session. While a
+ *  replay is active, no data goes to the debug probe: transmitted data is
+ *  compared to the recording, and received data comes from the recording. The
+ *  host must therefore issue the same commands that were recorded.
+ *
+ *  \param filename  The name of a file made with gdbrsp_record(), or NULL to
+ *                    stop the replay.
+ *  \param realtime  If true, received data is delayed to match the timing
+ *                    in the recording (relative to the transmissions by the
+ *                    host); if false, the replay runs as fast as possible, so
+ *                    that only the host-side cost remains.
+ *
+ *  \return true on success, false on failure (the file cannot be opened or
+ *          is not a recording, or a session is being recorded).
+ */
+bool gdbrsp_replay(const char *filename, bool realtime)
+{
+  GDBRSP_CONTEXT *rsp = context();
+  if (rsp->replay != NULL) {
+    fclose(rsp->replay);
+    rsp->replay = NULL;
+  }
+  if (filename == NULL)
+    return true;
+  if (rsp->record != NULL)
+    return false;
+  rsp->replay = fopen(filename, "rb");
+  if (rsp->replay == NULL)
+    return false;
+  char signature[sizeof RECORD_SIGNATURE];
+  if (fread(signature, 1, sizeof signature, rsp->replay) != sizeof signature
+      || memcmp(signature, RECORD_SIGNATURE, sizeof signature) != 0)
+  {
+    fclose(rsp->replay);
+    rsp->replay = NULL;
+    return false;
+  }
+  rsp->replay_realtime = realtime;
+  rsp->replay_type = '>';
+  rsp->replay_left = 0;
+  rsp->replay_stamp = 0;
+  rsp->replay_mismatch = 0;
+  rsp->replay_base = (long long)microseconds();
+  replay_next(rsp);
+  return true;
+}
+
+/** gdbrsp_replaying() returns whether a recorded session is being replayed.
+ */
+bool gdbrsp_replaying(void)
+{
+  return context()->replay != NULL;
+}
+
+/** gdbrsp_replay_mismatch() returns the number of bytes that the host
+ *  transmitted during the replay, that differ from the recording (or that the
+ *  recording does not have). A non-zero value means that the replay diverged
+ *  from the recorded session.
+ */
+unsigned long gdbrsp_replay_mismatch(void)
+{
+  return context()->replay_mismatch;
+}
+
+/** gdbrsp_context_create() allocates a new (empty) context for a connection
+ *  to a gdbserver. Functions in this module work on the default context, but
+ *  a thread can switch to a different context with gdbrsp_context_select(),
+ *  for example to drive several probes from separate threads.
+ *
+ *  \return The new context, or NULL on failure.
+ */
+GDBRSP_CONTEXT *gdbrsp_context_create(void)
+{
+  GDBRSP_CONTEXT *ctx = malloc(sizeof(GDBRSP_CONTEXT));
+  if (ctx != NULL) {
+    memset(ctx, 0, sizeof(GDBRSP_CONTEXT));
+    ctx->frame_state = FRAME_IDLE;
+  }
+  return ctx;
+}
+
+/** gdbrsp_context_delete() frees a context (and its receive buffer). The
+ *  context may not be selected in any thread.
+ */
+void gdbrsp_context_delete(GDBRSP_CONTEXT *ctx)
+{
+  assert(ctx != NULL && ctx != current_context);
+  if (ctx->cache != NULL)
+    free(ctx->cache);
+  if (ctx->batch != NULL)
+    free(ctx->batch);
+  if (ctx->record != NULL)
+    fclose(ctx->record);
+  if (ctx->replay != NULL)
+    fclose(ctx->replay);
+  free(ctx);
+}
+
+/** gdbrsp_context_select() selects the context for the calling thread. Pass
+ *  NULL to return to the default context (which is shared by all threads that
+ *  have not selected a context of their own).
+ */
+void gdbrsp_context_select(GDBRSP_CONTEXT *ctx)
+{
+  current_context = ctx;
 }
 
@@ -22,11 +22,27 @@
   extern "C" {
 #endif
 
+typedef struct tagGDBRSP_CONTEXT GDBRSP_CONTEXT;
+
 bool   gdbrsp_hex2array(const char *hex, unsigned char *byte, size_t size);
 void   gdbrsp_packetsize(size_t size);
 size_t gdbrsp_recv(char *buffer, size_t size, int timeout);
+size_t gdbrsp_recv_frame(unsigned char *frame, size_t size, int timeout);
 bool   gdbrsp_xmit(const char *buffer, int size);
+size_t gdbrsp_encode(const char *buffer, int size, unsigned char *frame, size_t framesize);
+bool   gdbrsp_xmit_frame(const unsigned char *frame, size_t size);
 void   gdbrsp_clear(void);
+void   gdbrsp_noack(bool enable);
+void   gdbrsp_batch(bool enable);
+
+bool   gdbrsp_record(const char *filename);
+bool   gdbrsp_replay(const char *filename, bool realtime);
+bool   gdbrsp_replaying(void);
+unsigned long gdbrsp_replay_mismatch(void);
+
+GDBRSP_CONTEXT *gdbrsp_context_create(void);
+void   gdbrsp_context_delete(GDBRSP_CONTEXT *ctx);
+void   gdbrsp_context_select(GDBRSP_CONTEXT *ctx);
 
 #if defined __cplusplus
   }
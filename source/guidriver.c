@@ -30,8 +30,10 @@
 #include <assert.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include "guidriver.h"
 #include "nuklear_mousepointer.h"
+#include "perfstats.h"
 
 #if defined _WIN32
 # include "nuklear_gdip.h"
@@ -45,6 +47,153 @@
 # include <alloc/fortify.h>
 #endif
 
+static struct nk_context *nkctx = NULL;
+static bool ForceRedraw = true;
+
+/* frame_unchanged() returns whether the frame that is about to be rendered is
+   identical to the previous one, by comparing a hash over the Nuklear command
+   buffer (plus the window size and the background colour); the command memory
+   is zeroed (NK_ZERO_COMMAND_MEMORY), so padding bytes do not cause false
+   differences */
+static bool frame_unchanged(int width, int height, struct nk_color clear)
+{
+  static unsigned long long prev_hash = 0;
+  const unsigned char *cmds;
+  unsigned long long hash;
+  size_t size, idx;
+
+  if (nkctx == NULL)
+    return false;
+  cmds = (const unsigned char*)nk_buffer_memory_const(&nkctx->memory);
+  size = nkctx->memory.allocated;
+  hash = 14695981039346656037ull;   /* FNV-1a */
+  for (idx = 0; idx < size; idx++)
+    hash = (hash ^ cmds[idx]) * 1099511628211ull;
+  hash = (hash ^ (unsigned)width) * 1099511628211ull;
+  hash = (hash ^ (unsigned)height) * 1099511628211ull;
+  hash = (hash ^ (((unsigned)clear.r << 24) | ((unsigned)clear.g << 16) | ((unsigned)clear.b << 8) | clear.a)) * 1099511628211ull;
+  if (hash == prev_hash && !ForceRedraw)
+    return true;
+  prev_hash = hash;
+  ForceRedraw = false;
+  return false;
+}
+
+#define PERF_OVERLAY_NAME "perfstats"
+#define PERF_OVERLAY_ROWS 32
+#define PERF_OVERLAY_INTERVAL 500000000ull /* refresh the values every 0.5 s */
+
+static bool PerfOverlay = false;
+
+/* format_duration() prints a time in nanoseconds in a suitable unit */
+static void format_duration(char *buffer, size_t size, double ns)
+{
+  if (ns < 1000.0)
+    snprintf(buffer, size, "%.0f ns", ns);
+  else if (ns < 1000000.0)
+    snprintf(buffer, size, "%.1f us", ns / 1000.0);
+  else
+    snprintf(buffer, size, "%.2f ms", ns / 1000000.0);
+}
+
+/* perf_overlay() adds a window with the metrics from the perfstats module (the
+   overlay is toggled with F12); it returns the overlay window, or NULL if the
+   overlay is off. Counters show the total and the rate, timers show the mean
+   over the last interval plus the overall maximum. The window is a background
+   window without input, so that it never takes the focus from the windows of
+   the application; perf_overlay_move() brings it to the top for drawing. */
+static struct nk_window *perf_overlay(int width)
+{
+  static PERF_SNAPSHOT list[PERF_OVERLAY_ROWS], prev[PERF_OVERLAY_ROWS];
+  static int count = 0, prevcount = 0;
+  static unsigned long long stamp = 0, interval = 0;
+
+  if (!PerfOverlay || nkctx == NULL)
+    return NULL;
+  unsigned long long now = perf_timestamp();
+  if (stamp == 0 || now - stamp >= PERF_OVERLAY_INTERVAL) {
+    memcpy(prev, list, count * sizeof(PERF_SNAPSHOT));
+    prevcount = count;
+    count = perf_snapshot(list, PERF_OVERLAY_ROWS);
+    interval = (stamp != 0) ? now - stamp : 0;
+    stamp = now;
+  }
+
+  float rowheight = nkctx->style.font->height + 2;
+  float winwidth = 22 * nkctx->style.font->height;
+  float winheight = (count > 0 ? count : 1) * (rowheight + nkctx->style.window.spacing.y)
+                    + 2 * nkctx->style.window.padding.y + 4;
+  if (nk_begin(nkctx, PERF_OVERLAY_NAME, nk_rect(width - winwidth, 0, winwidth, winheight),
+               NK_WINDOW_BACKGROUND | NK_WINDOW_NO_INPUT | NK_WINDOW_NO_SCROLLBAR | NK_WINDOW_BORDER)) {
+    nk_layout_row_dynamic(nkctx, rowheight, 2);
+    if (count == 0)
+      nk_label(nkctx, "(no metrics)", NK_TEXT_LEFT);
+    for (int idx = 0; idx < count; idx++) {
+      const PERF_SNAPSHOT *item = &list[idx];
+      const PERF_SNAPSHOT *last = (idx < prevcount) ? &prev[idx] : NULL;
+      char value[64], field[32];
+      nk_label(nkctx, item->name, NK_TEXT_LEFT);
+      switch (item->type) {
+      case PERF_COUNTER:
+        if (last != NULL && interval > 0)
+          snprintf(value, sizeof value, "%lld (%.0f/s)", item->value,
+                   (item->value - last->value) * 1e9 / interval);
+        else
+          snprintf(value, sizeof value, "%lld", item->value);
+        break;
+      case PERF_GAUGE:
+        snprintf(value, sizeof value, "%lld", item->value);
+        break;
+      case PERF_TIMER:
+        if (last != NULL && item->count > last->count)
+          format_duration(field, sizeof field,
+                          (double)(item->value - last->value) / (item->count - last->count));
+        else
+          strcpy(field, "-");
+        snprintf(value, sizeof value, "%s", field);
+        format_duration(field, sizeof field, (double)item->maximum);
+        snprintf(value + strlen(value), sizeof value - strlen(value), " / %s", field);
+        break;
+      default:
+        value[0] = '\0';
+      }
+      nk_label(nkctx, value, NK_TEXT_RIGHT);
+    }
+  }
+  nk_end(nkctx);
+  return nk_window_find(nkctx, PERF_OVERLAY_NAME);
+}
+
+/* perf_overlay_move() moves the overlay window to the back of the window list,
+   so that it is drawn on top of all other windows, or back to the front, so
+   that Nuklear does not give it the focus on the next frame */
+static void perf_overlay_move(struct nk_window *win, bool top)
+{
+  if (win == NULL || (top ? nkctx->end : nkctx->begin) == win)
+    return;
+  /* unlink, the window is not at the end that it moves to, so there are at
+     least two windows in the list */
+  if (win->prev != NULL)
+    win->prev->next = win->next;
+  else
+    nkctx->begin = win->next;
+  if (win->next != NULL)
+    win->next->prev = win->prev;
+  else
+    nkctx->end = win->prev;
+  if (top) {
+    win->prev = nkctx->end;
+    win->next = NULL;
+    nkctx->end->next = win;
+    nkctx->end = win;
+  } else {
+    win->next = nkctx->begin;
+    win->prev = NULL;
+    nkctx->begin->prev = win;
+    nkctx->begin = win;
+  }
+}
+
 #if defined _WIN32
 
 static int fontType = 0;
@@ -63,6 +212,12 @@ static LRESULT CALLBACK WindowProc(HWND wnd, UINT msg, WPARAM wparam, LPARAM lpa
   case WM_DESTROY:
     PostQuitMessage(0);
     return 0;
+  case WM_KEYDOWN:
+    if (wparam == VK_F12 && (lparam & (1 << 30)) == 0) {
+      PerfOverlay = !PerfOverlay;
+      ForceRedraw = true;
+    }
+    break;
   case WM_DEVICECHANGE:
     if (wparam == DBT_DEVICEARRIVAL || wparam == DBT_DEVICEREMOVECOMPLETE) {
       DEV_BROADCAST_DEVICEINTERFACE *hdr = (DEV_BROADCAST_DEVICEINTERFACE*)lparam;
@@ -242,6 +397,8 @@ struct nk_context* guidriver_init(const char *caption, int width, int height, in
   nk_gdip_set_font(fontStd);
 
   pointer_init((void*)hwndApp);
+  nkctx = ctx;
+  ForceRedraw = true;
 
   return ctx;
 }
@@ -330,9 +487,27 @@ bool guidriver_appsize(int *width, int *height)
   return false;
 }
 
+/** guidriver_render() draws the frame, but only if it differs from the
+ *  previous frame; the window itself is repainted from the back buffer on
+ *  WM_PAINT.
+ *
+ *  \param clear   The background colour.
+ */
 void guidriver_render(struct nk_color clear)
 {
+  int width = 0, height = 0;
+  guidriver_appsize(&width, &height);
+  struct nk_window *overlay = perf_overlay(width);
+  if (frame_unchanged(width, height, clear)) {
+    nk_clear(nkctx);
+    PERF_COUNT("gui.frames.skipped", 1);
+    return;
+  }
+  PERF_TIMER_BEGIN(tstart);
+  perf_overlay_move(overlay, true);
   nk_gdip_render(NK_ANTI_ALIASING_ON, clear);
+  perf_overlay_move(overlay, false);
+  PERF_TIMER_END(tstart, "gui.render");
 }
 
 bool guidriver_poll(bool waitidle)
@@ -357,6 +532,15 @@ bool guidriver_poll(bool waitidle)
   return true;
 }
 
+/** guidriver_wake() makes a pending guidriver_poll() return, so that the GUI
+ *  is refreshed. This function may be called from any thread.
+ */
+void guidriver_wake(void)
+{
+  if (hwndApp != NULL)
+    PostMessage(hwndApp, WM_NULL, 0, 0);
+}
+
 int guidriver_monitor_usb(unsigned short vid, unsigned short pid)
 {
   if (UsbVid != vid || UsbPid != pid) {
@@ -390,6 +574,7 @@ struct nk_image guidriver_image_from_memory(const unsigned char *data, unsigned
 #elif defined __linux__
 
 static GLFWwindow *winApp;
+static bool UseTimer = false;
 static int fontType = 0;
 static struct nk_font *fontStd = NULL;
 static struct nk_font *fontMono = NULL;
@@ -404,6 +589,14 @@ static void error_callback(int e, const char *d)
   fprintf(stderr, "Error %d: %s\n", e, d);
 }
 
+/* refresh_callback() is called when the window contents are damaged (and the
+   frame must be redrawn, even if the GUI did not change) */
+static void refresh_callback(GLFWwindow *window)
+{
+  (void)window;
+  ForceRedraw = true;
+}
+
 struct nk_context* guidriver_init(const char *caption, int width, int height, int flags,
                                   const char *fontsystem, const char *fontmono, float fontsize)
 {
@@ -422,8 +615,10 @@ struct nk_context* guidriver_init(const char *caption, int width, int height, in
     return NULL;
   }
   glfwWindowHint(GLFW_RESIZABLE, (flags & GUIDRV_RESIZEABLE) != 0);
+  UseTimer = (flags & GUIDRV_TIMER) != 0;
   winApp = glfwCreateWindow(width, height, caption, NULL, NULL);
   glfwMakeContextCurrent(winApp);
+  glfwSetWindowRefreshCallback(winApp, refresh_callback);
 
   /* add window icon */
 # if GLFW_VERSION_MAJOR >= 3 && GLFW_VERSION_MINOR >= 2
@@ -493,6 +688,8 @@ struct nk_context* guidriver_init(const char *caption, int width, int height, in
   }
 
   pointer_init(winApp);
+  nkctx = ctx;
+  ForceRedraw = true;
 
   return ctx;
 }
@@ -555,11 +752,24 @@ bool guidriver_appsize(int *width, int *height)
   return true;
 }
 
+/** guidriver_render() draws the frame, but only if it differs from the
+ *  previous frame (or if the window contents were damaged).
+ *
+ *  \param clear   The background colour.
+ */
 void guidriver_render(struct nk_color clear)
 {
   int width = 0, height = 0;
 
   glfwGetWindowSize(winApp, &width, &height);
+  struct nk_window *overlay = perf_overlay(width);
+  if (frame_unchanged(width, height, clear)) {
+    nk_clear(nkctx);
+    PERF_COUNT("gui.frames.skipped", 1);
+    return;
+  }
+  PERF_TIMER_BEGIN(tstart);
+  perf_overlay_move(overlay, true);
   glViewport(0, 0, width, height);
   glClear(GL_COLOR_BUFFER_BIT);
   glClearColor(clear.r/255.0, clear.g/255.0, clear.b/255.0, clear.a/255.0);
@@ -568,19 +778,42 @@ void guidriver_render(struct nk_color clear)
    * back into a default state. Make sure to either save and restore or
    * reset your own state after drawing rendering the UI. */
   nk_glfw3_render(NK_ANTI_ALIASING_ON);
+  perf_overlay_move(overlay, false);
   glfwSwapBuffers(winApp);
+  PERF_TIMER_END(tstart, "gui.render");
 }
 
 bool guidriver_poll(bool waitidle)
 {
-  (void)waitidle;
   if (glfwWindowShouldClose(winApp))
     return false;
+# if GLFW_VERSION_MAJOR >= 3 && GLFW_VERSION_MINOR >= 2
+  if (waitidle && UseTimer)
+    glfwWaitEventsTimeout(0.1); /* same interval as the timer in the Win32 driver */
+  else if (waitidle)
+    glfwWaitEvents();           /* worker threads use guidriver_wake() */
+  else
+    glfwPollEvents();
+# else
+  (void)waitidle;
   glfwPollEvents();
+# endif
+  static bool f12_down = false; /* F12 toggles the performance overlay */
+  bool down = (glfwGetKey(winApp, GLFW_KEY_F12) == GLFW_PRESS);
+  if (down && !f12_down) {
+    PerfOverlay = !PerfOverlay;
+    ForceRedraw = true;
+  }
+  f12_down = down;
   nk_glfw3_new_frame();
   return true;
 }
 
+void guidriver_wake(void)
+{
+  glfwPostEmptyEvent();
+}
+
 static int hotplug_callback(libusb_context *ctx, libusb_device *device,
                             libusb_hotplug_event event, void *user_data)
 {
@@ -588,6 +821,7 @@ static int hotplug_callback(libusb_context *ctx, libusb_device *device,
   (void)device;
   (void)user_data;
   UsbEvent = (event == LIBUSB_HOTPLUG_EVENT_DEVICE_ARRIVED) ? DEVICE_INSERT : DEVICE_REMOVE;
+  glfwPostEmptyEvent();
   return 0;
 }
 
@@ -53,6 +53,7 @@ void  guidriver_close(void);
 bool  guidriver_appsize(int *width, int *height);
 void  guidriver_render(struct nk_color clear);
 bool  guidriver_poll(bool waitidle);
+void  guidriver_wake(void);
 void *guidriver_apphandle(void);
 
 int   guidriver_setfont(struct nk_context *ctx, int type);
@@ -0,0 +1,212 @@
+/*
+ * Bulk conversion between binary data and hexadecimal text, as used in the
+ * GDB RSP protocol. Blocks of 16 bytes (32 hex digits) are converted with
+ * SSE2 or NEON, where available, and the remainder byte by byte.
+ *
+ * Copyright 2026 CompuPhase
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <assert.h>
+#include <stdbool.h>
+
+#include "hexcodec.h"
+
+#if defined __SSE2__ || defined _M_X64 || (defined _M_IX86_FP && _M_IX86_FP >= 2)
+# include <emmintrin.h>
+# define HEX_SSE2
+#elif defined __ARM_NEON || defined __ARM_NEON__
+# include <arm_neon.h>
+# define HEX_NEON
+#endif
+
+#if defined FORTIFY
+# include <alloc/fortify.h>
+#endif
+
+
+static const char hexdigits[] = "0123456789abcdef";
+
+/* hexvalue() returns the nibble value of a hex digit, or -1 if the
+   character is not a hex digit */
+static inline int hexvalue(unsigned char ch)
+{
+  if ((unsigned)(ch - '0') < 10)
+    return ch - '0';
+  ch |= 0x20;   /* upper case to lower case */
+  if ((unsigned)(ch - 'a') < 6)
+    return ch - 'a' + 10;
+  return -1;
+}
+
+#if defined HEX_SSE2
+
+/* encode_block() converts 16 bytes to 32 hex digits */
+static inline void encode_block(const unsigned char *data, char *hex)
+{
+  const __m128i mask = _mm_set1_epi8(0x0f);
+  __m128i x = _mm_loadu_si128((const __m128i*)data);
+  __m128i hi = _mm_and_si128(_mm_srli_epi16(x, 4), mask);
+  __m128i lo = _mm_and_si128(x, mask);
+  /* digit = nibble + '0', plus 'a' - '0' - 10 for nibbles above 9 */
+  const __m128i nine = _mm_set1_epi8(9);
+  const __m128i zero = _mm_set1_epi8('0');
+  const __m128i alpha = _mm_set1_epi8('a' - '0' - 10);
+  hi = _mm_add_epi8(_mm_add_epi8(hi, zero), _mm_and_si128(_mm_cmpgt_epi8(hi, nine), alpha));
+  lo = _mm_add_epi8(_mm_add_epi8(lo, zero), _mm_and_si128(_mm_cmpgt_epi8(lo, nine), alpha));
+  _mm_storeu_si128((__m128i*)hex, _mm_unpacklo_epi8(hi, lo));
+  _mm_storeu_si128((__m128i*)(hex + 16), _mm_unpackhi_epi8(hi, lo));
+}
+
+/* decode_digits() converts 16 hex digits to their nibble values; it returns
+   false if any of the characters is not a hex digit (characters above 127 are
+   negative in the signed comparisons, so they fail both ranges) */
+static inline bool decode_digits(__m128i c, __m128i *value)
+{
+  __m128i digitmask = _mm_and_si128(_mm_cmpgt_epi8(c, _mm_set1_epi8('0' - 1)),
+                                    _mm_cmplt_epi8(c, _mm_set1_epi8('9' + 1)));
+  __m128i l = _mm_or_si128(c, _mm_set1_epi8(0x20));
+  __m128i alphamask = _mm_and_si128(_mm_cmpgt_epi8(l, _mm_set1_epi8('a' - 1)),
+                                    _mm_cmplt_epi8(l, _mm_set1_epi8('f' + 1)));
+  if (_mm_movemask_epi8(_mm_or_si128(digitmask, alphamask)) != 0xffff)
+    return false;
+  *value = _mm_or_si128(_mm_and_si128(digitmask, _mm_sub_epi8(c, _mm_set1_epi8('0'))),
+                        _mm_and_si128(alphamask, _mm_sub_epi8(l, _mm_set1_epi8('a' - 10))));
+  return true;
+}
+
+/* decode_block() converts 32 hex digits to 16 bytes; it returns false (and
+   stores nothing) if any of the characters is not a hex digit */
+static inline bool decode_block(const char *hex, unsigned char *data)
+{
+  __m128i a, b;
+  if (!decode_digits(_mm_loadu_si128((const __m128i*)hex), &a)
+      || !decode_digits(_mm_loadu_si128((const __m128i*)(hex + 16)), &b))
+    return false;
+  /* in each 16-bit lane, the low byte has the high nibble and vice versa */
+  const __m128i himask = _mm_set1_epi16(0x00f0);
+  a = _mm_or_si128(_mm_and_si128(_mm_slli_epi16(a, 4), himask), _mm_srli_epi16(a, 8));
+  b = _mm_or_si128(_mm_and_si128(_mm_slli_epi16(b, 4), himask), _mm_srli_epi16(b, 8));
+  _mm_storeu_si128((__m128i*)data, _mm_packus_epi16(a, b));
+  return true;
+}
+
+#elif defined HEX_NEON
+
+static inline void encode_block(const unsigned char *data, char *hex)
+{
+  uint8x16_t x = vld1q_u8(data);
+  uint8x16_t nibbles[2] = { vshrq_n_u8(x, 4), vandq_u8(x, vdupq_n_u8(0x0f)) };
+  uint8x16x2_t digits;
+  for (int idx = 0; idx < 2; idx++) {
+    uint8x16_t alpha = vandq_u8(vcgtq_u8(nibbles[idx], vdupq_n_u8(9)), vdupq_n_u8('a' - '0' - 10));
+    digits.val[idx] = vaddq_u8(vaddq_u8(nibbles[idx], vdupq_n_u8('0')), alpha);
+  }
+  vst2q_u8((uint8_t*)hex, digits);  /* interleaves the high & low digits */
+}
+
+static inline bool decode_digits(uint8x16_t c, uint8x16_t *value)
+{
+  uint8x16_t digit = vsubq_u8(c, vdupq_n_u8('0'));
+  uint8x16_t digitmask = vcltq_u8(digit, vdupq_n_u8(10));
+  uint8x16_t alpha = vsubq_u8(vorrq_u8(c, vdupq_n_u8(0x20)), vdupq_n_u8('a'));
+  uint8x16_t alphamask = vcltq_u8(alpha, vdupq_n_u8(6));
+  uint8x16_t valid = vorrq_u8(digitmask, alphamask);
+  uint8x8_t fold = vand_u8(vget_low_u8(valid), vget_high_u8(valid));
+  if (vget_lane_u64(vreinterpret_u64_u8(fold), 0) != ~(uint64_t)0)
+    return false;
+  *value = vbslq_u8(digitmask, digit, vaddq_u8(alpha, vdupq_n_u8(10)));
+  return true;
+}
+
+static inline bool decode_block(const char *hex, unsigned char *data)
+{
+  uint8x16x2_t c = vld2q_u8((const uint8_t*)hex);  /* splits high & low digits */
+  uint8x16_t hi, lo;
+  if (!decode_digits(c.val[0], &hi) || !decode_digits(c.val[1], &lo))
+    return false;
+  vst1q_u8(data, vorrq_u8(vshlq_n_u8(hi, 4), lo));
+  return true;
+}
+
+#endif
+
+/** hexcodec_encode() converts binary data to hexadecimal text, two lower-case
+ *  digits per byte, with the high nibble first.
+ *
+ *  \param data   [in] The data to convert.
+ *  \param size   The number of bytes in "data".
+ *  \param hex    [out] The hex digits; this buffer must have room for 2*size
+ *                characters. The text is not zero-terminated.
+ */
+void hexcodec_encode(const unsigned char *data, size_t size, char *hex)
+{
+  assert(data != NULL || size == 0);
+  assert(hex != NULL || size == 0);
+# if defined HEX_SSE2 || defined HEX_NEON
+    while (size >= 16) {
+      encode_block(data, hex);
+      data += 16;
+      hex += 32;
+      size -= 16;
+    }
+# endif
+  while (size > 0) {
+    *hex++ = hexdigits[(*data >> 4) & 0x0f];
+    *hex++ = hexdigits[*data & 0x0f];
+    data++;
+    size--;
+  }
+}
+
+/** hexcodec_decode() converts hexadecimal text to binary data. Both upper and
+ *  lower case digits are accepted. Decoding stops at the first pair of
+ *  characters that is not a valid hex number.
+ *
+ *  \param hex    [in] The hex digits.
+ *  \param length The number of characters in "hex"; an odd last character is
+ *                ignored. The function does not read beyond this length.
+ *  \param data   [out] The decoded data; this buffer must have room for
+ *                length/2 bytes.
+ *
+ *  \return The number of bytes stored in "data".
+ *
+ *  \note In-place conversion is allowed ("hex" and "data" may point to the
+ *        same buffer).
+ */
+size_t hexcodec_decode(const char *hex, size_t length, unsigned char *data)
+{
+  assert(hex != NULL || length < 2);
+  assert(data != NULL || length < 2);
+
+  size_t count = 0;
+  size_t pairs = length / 2;
+# if defined HEX_SSE2 || defined HEX_NEON
+    /* a block with an invalid digit is left for the loop below, which finds
+       where decoding must stop */
+    while (pairs - count >= 16 && decode_block(hex, data + count)) {
+      hex += 32;
+      count += 16;
+    }
+# endif
+  const unsigned char *ptr = (const unsigned char*)hex;
+  while (count < pairs) {
+    int h = hexvalue(ptr[0]);
+    int l = hexvalue(ptr[1]);
+    if (h < 0 || l < 0)
+      break;
+    data[count++] = (unsigned char)((h << 4) | l);
+    ptr += 2;
+  }
+  return count;
+}
@@ -0,0 +1,37 @@
+/*
+ * Bulk conversion between binary data and hexadecimal text, as used in the
+ * GDB RSP protocol (memory reads, monitor commands, console output). Blocks
+ * of 16 bytes are converted with SSE2 or NEON, where available, and the
+ * remainder byte by byte.
+ *
+ * Copyright 2026 CompuPhase
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef _HEXCODEC_H
+#define _HEXCODEC_H
+
+#include <stddef.h>
+
+#if defined __cplusplus
+  extern "C" {
+#endif
+
+void   hexcodec_encode(const unsigned char *data, size_t size, char *hex);
+size_t hexcodec_decode(const char *hex, size_t length, unsigned char *data);
+
+#if defined __cplusplus
+  }
+#endif
+
+#endif /* _HEXCODEC_H */
@@ -0,0 +1,634 @@
+/*
+ * A library interface to the Black Magic Probe support, with a session handle
+ * per probe and non-blocking operations. Every session has a worker thread,
+ * which selects the probe context of the session (see bmp_context_create())
+ * and then runs the queued operations in order. SWO trace data is passed on
+ * in raw form, from a trace thread.
+ *
+ * Copyright 2026 CompuPhase
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#include "bmp-scan.h"
+#include "bmp-support.h"
+#include "c11threads.h"
+#include "libbmp.h"
+#include "swotrace.h"
+
+#if defined FORTIFY
+# include <alloc/fortify.h>
+#endif
+
+#define TRACE_CHUNK   4096    /* buffer for a single callback on trace data */
+#define TRACE_IDLE    2       /* delay (ms) when there is no trace data */
+
+typedef struct tagLIBBMP_OP {
+  struct tagLIBBMP_OP *next;
+  int operation;
+  int param;                  /* probe number, flag or bit rate */
+  char *text;                 /* IP address, filename or command (or NULL) */
+  LIBBMP_TRACEFUNC tracefunc;
+  LIBBMP_DONEFUNC donefunc;
+  void *userdata;
+} LIBBMP_OP;
+
+struct tagLIBBMP_SESSION {
+  BMP_CONTEXT *context;
+  LIBBMP_MSGFUNC msgfunc;
+  void *userdata;
+  thrd_t worker;
+  mtx_t lock;                 /* protects the fields up to "tracing" */
+  cnd_t signal;               /* signalled on a change in the queue */
+  LIBBMP_OP *queue;
+  bool busy;                  /* operations queued or running */
+  bool quit;
+  char targetname[64];
+  bool tracing;               /* the trace thread must keep running */
+  /* the fields below are only accessed from the worker thread */
+  bool attached;
+  char *ipaddress;            /* NULL for a USB connection */
+  BMP_IMAGE *image;           /* cached image of the last file */
+  char *imagefile;
+  time_t imagetime;
+  long imagesize;
+  thrd_t tracethread;
+  LIBBMP_TRACEFUNC tracefunc;
+  void *traceuserdata;
+};
+
+/* connect_lock protects the parts of the probe support that are shared
+   between the sessions: opening & closing the serial ports; the trace
+   interface is a single instance too, so only one session can trace */
+static once_flag init_flag = ONCE_FLAG_INIT;
+static mtx_t connect_lock;
+static LIBBMP_SESSION *trace_session = NULL;
+
+static thread_local LIBBMP_SESSION *current_session = NULL;
+
+
+static int session_notice(int code, const char *message)
+{
+  LIBBMP_SESSION *session = current_session;
+  if (session != NULL && session->msgfunc != NULL)
+    session->msgfunc(session, code, message, session->userdata);
+  return code >= 0;
+}
+
+static void library_init(void)
+{
+  mtx_init(&connect_lock, mtx_plain);
+  bmp_setcallback(session_notice);
+}
+
+/* session_image() returns the image for the file, reusing the image of the
+   previous operation if the file has not changed since */
+static BMP_IMAGE *session_image(LIBBMP_SESSION *session, const char *filename)
+{
+  assert(session != NULL && filename != NULL);
+  struct stat fstat;
+  if (stat(filename, &fstat) != 0) {
+    session_notice(BMPERR_GENERAL, "File not found");
+    return NULL;
+  }
+  if (session->image != NULL && session->imagefile != NULL && strcmp(session->imagefile, filename) == 0
+      && session->imagetime == fstat.st_mtime && session->imagesize == (long)fstat.st_size)
+    return session->image;
+
+  if (session->image != NULL) {
+    bmp_image_delete(session->image);
+    session->image = NULL;
+  }
+  if (session->imagefile != NULL) {
+    free((void*)session->imagefile);
+    session->imagefile = NULL;
+  }
+  FILE *fp = fopen(filename, "rb");
+  if (fp == NULL) {
+    session_notice(BMPERR_GENERAL, "File could not be opened");
+    return NULL;
+  }
+  session->image = bmp_image_create(fp);
+  fclose(fp);
+  if (session->image != NULL) {
+    session->imagefile = strdup(filename);
+    session->imagetime = fstat.st_mtime;
+    session->imagesize = (long)fstat.st_size;
+  }
+  return session->image;
+}
+
+static int trace_worker(void *arg)
+{
+  LIBBMP_SESSION *session = (LIBBMP_SESSION*)arg;
+  assert(session != NULL && session->tracefunc != NULL);
+  static unsigned char buffer[TRACE_CHUNK];  /* only one trace thread runs */
+  for ( ;; ) {
+    mtx_lock(&session->lock);
+    bool running = session->tracing;
+    mtx_unlock(&session->lock);
+    if (!running)
+      break;
+    size_t size = trace_rawread(buffer, sizeof buffer);
+    if (size > 0) {
+      session->tracefunc(session, buffer, size, session->traceuserdata);
+    } else {
+      struct timespec delay = { 0, TRACE_IDLE * 1000000L };
+      thrd_sleep(&delay, NULL);
+    }
+  }
+  return 0;
+}
+
+static bool trace_begin(LIBBMP_SESSION *session, int async_bitrate, LIBBMP_TRACEFUNC tracefunc, void *userdata)
+{
+  assert(session != NULL && tracefunc != NULL);
+  mtx_lock(&connect_lock);
+  bool busy = (trace_session != NULL);
+  if (!busy)
+    trace_session = session;
+  mtx_unlock(&connect_lock);
+  if (busy) {
+    session_notice(BMPERR_GENERAL, "SWO trace is already in use by another session");
+    return false;
+  }
+
+  unsigned char endpoint = BMP_EP_TRACE;
+  bool ok = bmp_enabletrace(async_bitrate, &endpoint);
+  if (ok) {
+    int result = (session->ipaddress != NULL) ? trace_init(BMP_PORT_TRACE, session->ipaddress) : trace_init(endpoint, NULL);
+    ok = (result == TRACESTAT_OK);
+    if (!ok)
+      session_notice(BMPERR_GENERAL, "SWO trace interface could not be opened");
+  }
+  if (ok) {
+    session->tracefunc = tracefunc;
+    session->traceuserdata = userdata;
+    mtx_lock(&session->lock);
+    session->tracing = true;
+    mtx_unlock(&session->lock);
+    if (thrd_create(&session->tracethread, trace_worker, session) != thrd_success) {
+      mtx_lock(&session->lock);
+      session->tracing = false;
+      mtx_unlock(&session->lock);
+      trace_close();
+      ok = false;
+    }
+  }
+  if (!ok) {
+    mtx_lock(&connect_lock);
+    trace_session = NULL;
+    mtx_unlock(&connect_lock);
+  }
+  return ok;
+}
+
+static void trace_end(LIBBMP_SESSION *session)
+{
+  assert(session != NULL);
+  mtx_lock(&connect_lock);
+  bool owner = (trace_session == session);
+  mtx_unlock(&connect_lock);
+  if (!owner)
+    return;
+  mtx_lock(&session->lock);
+  session->tracing = false;
+  mtx_unlock(&session->lock);
+  thrd_join(session->tracethread, NULL);
+  trace_close();
+  mtx_lock(&connect_lock);
+  trace_session = NULL;
+  mtx_unlock(&connect_lock);
+}
+
+static bool session_run(LIBBMP_SESSION *session, const LIBBMP_OP *op)
+{
+  assert(session != NULL && op != NULL);
+  if (op->operation != LIBBMP_CONNECT && !bmp_isopen()) {
+    session_notice(BMPERR_NOCONNECT, "Not connected to a probe");
+    return false;
+  }
+
+  bool ok = false;
+  BMP_IMAGE *image;
+  switch (op->operation) {
+  case LIBBMP_CONNECT:
+    trace_end(session);
+    mtx_lock(&connect_lock);
+    if (bmp_isopen())
+      bmp_disconnect();
+    ok = bmp_connect(op->param, op->text);
+    mtx_unlock(&connect_lock);
+    session->attached = false;
+    if (session->ipaddress != NULL)
+      free((void*)session->ipaddress);
+    session->ipaddress = (op->text != NULL) ? strdup(op->text) : NULL;
+    break;
+  case LIBBMP_ATTACH: {
+    char name[64] = "";
+    ok = bmp_attach(op->param != 0, name, sizeof name, NULL, 0);
+    session->attached = ok;
+    mtx_lock(&session->lock);
+    strcpy(session->targetname, name);
+    mtx_unlock(&session->lock);
+    break;
+  }
+  case LIBBMP_DETACH:
+    ok = bmp_detach(op->param != 0);
+    session->attached = false;
+    break;
+  case LIBBMP_FLASH:
+    if ((image = session_image(session, op->text)) != NULL)
+      ok = bmp_download_image(image, op->param != 0) && (bmp_image_verified(image) || bmp_verify_image(image));
+    break;
+  case LIBBMP_VERIFY:
+    if ((image = session_image(session, op->text)) != NULL)
+      ok = bmp_verify_image(image);
+    break;
+  case LIBBMP_MONITOR:
+    ok = bmp_monitor(op->text) != 0;
+    break;
+  case LIBBMP_RESTART:
+    ok = bmp_restart() != 0;
+    break;
+  case LIBBMP_TRACE:
+    ok = trace_begin(session, op->param, op->tracefunc, op->userdata);
+    break;
+  default:
+    assert(0);
+  }
+  return ok;
+}
+
+static int session_worker(void *arg)
+{
+  LIBBMP_SESSION *session = (LIBBMP_SESSION*)arg;
+  assert(session != NULL);
+  current_session = session;
+  bmp_context_select(session->context);
+
+  mtx_lock(&session->lock);
+  for ( ;; ) {
+    while (session->queue == NULL && !session->quit)
+      cnd_wait(&session->signal, &session->lock);
+    LIBBMP_OP *op = session->queue;
+    if (op == NULL)
+      break;  /* quit was set and all operations are done */
+    session->queue = op->next;
+    mtx_unlock(&session->lock);
+
+    bool result = session_run(session, op);
+    if (op->donefunc != NULL)
+      op->donefunc(session, op->operation, result, op->userdata);
+    if (op->text != NULL)
+      free((void*)op->text);
+    free((void*)op);
+
+    mtx_lock(&session->lock);
+    if (session->queue == NULL)
+      session->busy = false;
+    cnd_broadcast(&session->signal);
+  }
+  mtx_unlock(&session->lock);
+
+  trace_end(session);
+  if (session->attached)
+    bmp_detach(true);
+  mtx_lock(&connect_lock);
+  bmp_disconnect();
+  mtx_unlock(&connect_lock);
+  bmp_context_select(NULL);
+  current_session = NULL;
+  return 0;
+}
+
+static LIBBMP_OP *op_create(int operation, int param, const char *text, LIBBMP_DONEFUNC donefunc, void *userdata)
+{
+  LIBBMP_OP *op = malloc(sizeof(LIBBMP_OP));
+  if (op == NULL)
+    return NULL;
+  memset(op, 0, sizeof(LIBBMP_OP));
+  op->operation = operation;
+  op->param = param;
+  if (text != NULL && (op->text = strdup(text)) == NULL) {
+    free((void*)op);
+    return NULL;
+  }
+  op->donefunc = donefunc;
+  op->userdata = userdata;
+  return op;
+}
+
+/* session_queue() appends the operation to the queue; it returns false if op
+   is NULL (which is the case if op_create() failed) */
+static bool session_queue(LIBBMP_SESSION *session, LIBBMP_OP *op)
+{
+  assert(session != NULL);
+  if (op == NULL)
+    return false;
+  mtx_lock(&session->lock);
+  LIBBMP_OP **tail = &session->queue;
+  while (*tail != NULL)
+    tail = &(*tail)->next;
+  *tail = op;
+  session->busy = true;
+  cnd_broadcast(&session->signal);
+  mtx_unlock(&session->lock);
+  return true;
+}
+
+/** libbmp_open() creates a session. The session is not yet connected to a
+ *  probe; see libbmp_connect().
+ *
+ *  \param msgfunc    [optional] The function that receives the status and
+ *                    error messages that the operations of the session
+ *                    produce.
+ *  \param userdata   [optional] A value that is passed to msgfunc.
+ *
+ *  \return The session handle, or NULL on failure (out of memory).
+ */
+LIBBMP_SESSION *libbmp_open(LIBBMP_MSGFUNC msgfunc, void *userdata)
+{
+  call_once(&init_flag, library_init);
+
+  LIBBMP_SESSION *session = malloc(sizeof(LIBBMP_SESSION));
+  if (session == NULL)
+    return NULL;
+  memset(session, 0, sizeof(LIBBMP_SESSION));
+  session->msgfunc = msgfunc;
+  session->userdata = userdata;
+  if ((session->context = bmp_context_create()) == NULL) {
+    free((void*)session);
+    return NULL;
+  }
+  mtx_init(&session->lock, mtx_plain);
+  cnd_init(&session->signal);
+  if (thrd_create(&session->worker, session_worker, session) != thrd_success) {
+    cnd_destroy(&session->signal);
+    mtx_destroy(&session->lock);
+    bmp_context_delete(session->context);
+    free((void*)session);
+    return NULL;
+  }
+  return session;
+}
+
+/** libbmp_close() finishes the operations that are still queued, stops trace
+ *  capture, detaches from the target (if attached) and closes the connection
+ *  to the probe. The session handle is invalid after this call.
+ *
+ *  \note This function must not be called from a callback of the session.
+ */
+void libbmp_close(LIBBMP_SESSION *session)
+{
+  if (session == NULL)
+    return;
+  mtx_lock(&session->lock);
+  session->quit = true;
+  cnd_broadcast(&session->signal);
+  mtx_unlock(&session->lock);
+  thrd_join(session->worker, NULL);
+
+  if (session->image != NULL)
+    bmp_image_delete(session->image);
+  if (session->imagefile != NULL)
+    free((void*)session->imagefile);
+  if (session->ipaddress != NULL)
+    free((void*)session->ipaddress);
+  cnd_destroy(&session->signal);
+  mtx_destroy(&session->lock);
+  bmp_context_delete(session->context);
+  free((void*)session);
+}
+
+/** libbmp_connect() queues a connection to a probe, via USB or TCP/IP. If the
+ *  session was already connected, that connection is closed first.
+ *
+ *  \param session    The session handle.
+ *  \param probe      The probe sequence number, 0 if only a single probe is
+ *                    connected. This parameter is ignored if ipaddress is
+ *                    not NULL.
+ *  \param ipaddress  [optional] The IP address of a ctxLink probe.
+ *  \param donefunc   [optional] The completion callback.
+ *  \param userdata   [optional] A value that is passed to donefunc.
+ *
+ *  \return true if the operation was queued, false on failure (out of
+ *          memory).
+ */
+bool libbmp_connect(LIBBMP_SESSION *session, int probe, const char *ipaddress, LIBBMP_DONEFUNC donefunc, void *userdata)
+{
+  return session_queue(session, op_create(LIBBMP_CONNECT, probe, ipaddress, donefunc, userdata));
+}
+
+/** libbmp_attach() queues an attach to the target. On completion, the name
+ *  of the target is available through libbmp_targetname().
+ *
+ *  \param session    The session handle.
+ *  \param autopower  Whether to power the target from the probe, if the
+ *                    target does not respond.
+ *  \param donefunc   [optional] The completion callback.
+ *  \param userdata   [optional] A value that is passed to donefunc.
+ *
+ *  \return true if the operation was queued, false on failure.
+ */
+bool libbmp_attach(LIBBMP_SESSION *session, bool autopower, LIBBMP_DONEFUNC donefunc, void *userdata)
+{
+  return session_queue(session, op_create(LIBBMP_ATTACH, autopower, NULL, donefunc, userdata));
+}
+
+/** libbmp_detach() queues a detach from the target.
+ *
+ *  \param session    The session handle.
+ *  \param powerdown  Whether to switch off the power that the probe provides
+ *                    to the target.
+ *  \param donefunc   [optional] The completion callback.
+ *  \param userdata   [optional] A value that is passed to donefunc.
+ *
+ *  \return true if the operation was queued, false on failure.
+ */
+bool libbmp_detach(LIBBMP_SESSION *session, bool powerdown, LIBBMP_DONEFUNC donefunc, void *userdata)
+{
+  return session_queue(session, op_create(LIBBMP_DETACH, powerdown, NULL, donefunc, userdata));
+}
+
+/** libbmp_flash() queues the download of an ELF file into the Flash memory of
+ *  the target, followed by a verification. The target must be attached.
+ *
+ *  \param session      The session handle.
+ *  \param filename     The path to the ELF file.
+ *  \param differential Whether to only write the sectors that differ from
+ *                      the Flash contents.
+ *  \param donefunc     [optional] The completion callback.
+ *  \param userdata     [optional] A value that is passed to donefunc.
+ *
+ *  \return true if the operation was queued, false on failure.
+ *
+ *  \note The session keeps the image of the file that was last flashed or
+ *        verified; as long as the file does not change, it is not read and
+ *        parsed again.
+ */
+bool libbmp_flash(LIBBMP_SESSION *session, const char *filename, bool differential, LIBBMP_DONEFUNC donefunc, void *userdata)
+{
+  assert(filename != NULL);
+  return session_queue(session, op_create(LIBBMP_FLASH, differential, filename, donefunc, userdata));
+}
+
+/** libbmp_verify() queues a comparison of the Flash memory of the target with
+ *  an ELF file. The target must be attached.
+ *
+ *  \param session    The session handle.
+ *  \param filename   The path to the ELF file.
+ *  \param donefunc   [optional] The completion callback.
+ *  \param userdata   [optional] A value that is passed to donefunc.
+ *
+ *  \return true if the operation was queued, false on failure.
+ */
+bool libbmp_verify(LIBBMP_SESSION *session, const char *filename, LIBBMP_DONEFUNC donefunc, void *userdata)
+{
+  assert(filename != NULL);
+  return session_queue(session, op_create(LIBBMP_VERIFY, 0, filename, donefunc, userdata));
+}
+
+/** libbmp_monitor() queues a "monitor" command for the probe.
+ *
+ *  \param session    The session handle.
+ *  \param command    The command, without the "monitor" prefix.
+ *  \param donefunc   [optional] The completion callback.
+ *  \param userdata   [optional] A value that is passed to donefunc.
+ *
+ *  \return true if the operation was queued, false on failure.
+ */
+bool libbmp_monitor(LIBBMP_SESSION *session, const char *command, LIBBMP_DONEFUNC donefunc, void *userdata)
+{
+  assert(command != NULL);
+  return session_queue(session, op_create(LIBBMP_MONITOR, 0, command, donefunc, userdata));
+}
+
+/** libbmp_restart() queues a reset of the target, after which it runs.
+ *
+ *  \param session    The session handle.
+ *  \param donefunc   [optional] The completion callback.
+ *  \param userdata   [optional] A value that is passed to donefunc.
+ *
+ *  \return true if the operation was queued, false on failure.
+ */
+bool libbmp_restart(LIBBMP_SESSION *session, LIBBMP_DONEFUNC donefunc, void *userdata)
+{
+  return session_queue(session, op_create(LIBBMP_RESTART, 0, NULL, donefunc, userdata));
+}
+
+/** libbmp_busy() returns whether operations are queued or running for the
+ *  session.
+ */
+bool libbmp_busy(LIBBMP_SESSION *session)
+{
+  assert(session != NULL);
+  mtx_lock(&session->lock);
+  bool busy = session->busy;
+  mtx_unlock(&session->lock);
+  return busy;
+}
+
+/** libbmp_wait() waits until all queued operations of the session are done.
+ *
+ *  \note This function must not be called from a callback of the session.
+ */
+void libbmp_wait(LIBBMP_SESSION *session)
+{
+  assert(session != NULL);
+  mtx_lock(&session->lock);
+  while (session->busy)
+    cnd_wait(&session->signal, &session->lock);
+  mtx_unlock(&session->lock);
+}
+
+/** libbmp_progress() returns the progress of a download or verification that
+ *  is running.
+ *
+ *  \param session    The session handle.
+ *  \param step       [out] The current step.
+ *  \param range      [out] The total number of steps.
+ *
+ *  \note This function selects the probe context of the session on the
+ *        calling thread, and resets it to the default context afterwards.
+ */
+void libbmp_progress(LIBBMP_SESSION *session, unsigned long *step, unsigned long *range)
+{
+  assert(session != NULL);
+  bmp_context_select(session->context);
+  bmp_progress_get(step, range);
+  bmp_context_select(NULL);
+}
+
+/** libbmp_targetname() returns the name of the target that the session is
+ *  attached to (an empty string before the attach completes).
+ *
+ *  \note The returned string remains valid until the next attach of the
+ *        session.
+ */
+const char *libbmp_targetname(LIBBMP_SESSION *session)
+{
+  assert(session != NULL);
+  mtx_lock(&session->lock);
+  const char *name = session->targetname;
+  mtx_unlock(&session->lock);
+  return name;
+}
+
+/** libbmp_trace_start() queues the start of SWO trace capture. The probe is
+ *  set up for SWO and the trace interface is opened; the raw trace data is
+ *  then passed to the trace callback, in chunks, until libbmp_trace_stop()
+ *  is called.
+ *
+ *  \param session        The session handle.
+ *  \param async_bitrate  The bit rate for NRZ (asynchronous) mode; set to 0
+ *                        for Manchester mode.
+ *  \param tracefunc      The function that receives the trace data.
+ *  \param donefunc       [optional] The completion callback, called after
+ *                        the trace interface is opened.
+ *  \param userdata       [optional] A value that is passed to donefunc and
+ *                        tracefunc.
+ *
+ *  \return true if the operation was queued, false on failure.
+ *
+ *  \note Only one session can capture trace data at a time, because there is
+ *        a single trace interface. The TPIU & ITM of the target must be set
+ *        up separately, for example with bmp_runscript() or by the target
+ *        firmware.
+ */
+bool libbmp_trace_start(LIBBMP_SESSION *session, int async_bitrate, LIBBMP_TRACEFUNC tracefunc,
+                        LIBBMP_DONEFUNC donefunc, void *userdata)
+{
+  assert(session != NULL && tracefunc != NULL);
+  LIBBMP_OP *op = op_create(LIBBMP_TRACE, async_bitrate, NULL, donefunc, userdata);
+  if (op != NULL)
+    op->tracefunc = tracefunc;
+  return session_queue(session, op);
+}
+
+/** libbmp_trace_stop() waits until the queued operations of the session are
+ *  done, and then stops trace capture, if the session was capturing.
+ *
+ *  \note This function must not be called from a callback of the session.
+ */
+void libbmp_trace_stop(LIBBMP_SESSION *session)
+{
+  assert(session != NULL);
+  libbmp_wait(session);
+  trace_end(session);
+}
@@ -0,0 +1,83 @@
+/*
+ * A library interface to the Black Magic Probe support. Each probe is accessed
+ * through a session handle; the operations on a session run on a worker thread
+ * that is private to the session, and they are queued, so that the calling
+ * application is not blocked. Each operation may have a completion callback,
+ * which is called on the worker thread. SWO trace data is delivered as a
+ * stream of raw chunks, through a callback on a trace thread.
+ *
+ * The library is built from the same modules as the utilities (bmp-support,
+ * gdb-rsp, swotrace, decodectf & parsetsdl, elf & dwarf), so an application
+ * that links it may also call the functions of these modules directly.
+ *
+ * Copyright 2026 CompuPhase
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef _LIBBMP_H
+#define _LIBBMP_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#if defined __cplusplus
+  extern "C" {
+#endif
+
+enum {
+  LIBBMP_CONNECT,
+  LIBBMP_ATTACH,
+  LIBBMP_DETACH,
+  LIBBMP_FLASH,
+  LIBBMP_VERIFY,
+  LIBBMP_MONITOR,
+  LIBBMP_RESTART,
+  LIBBMP_TRACE,
+};
+
+typedef struct tagLIBBMP_SESSION LIBBMP_SESSION;
+
+/* the completion callback receives the operation code (LIBBMP_xxx) and the
+   result; the message callback receives the status messages of the probe
+   support (the "code" is one of the BMPSTAT_xxx or BMPERR_xxx values) and
+   the trace callback receives the raw SWO data; all callbacks run on a
+   thread of the library, not on the thread of the caller */
+typedef void (*LIBBMP_DONEFUNC)(LIBBMP_SESSION *session, int operation, bool result, void *userdata);
+typedef void (*LIBBMP_MSGFUNC)(LIBBMP_SESSION *session, int code, const char *message, void *userdata);
+typedef void (*LIBBMP_TRACEFUNC)(LIBBMP_SESSION *session, const unsigned char *data, size_t size, void *userdata);
+
+LIBBMP_SESSION *libbmp_open(LIBBMP_MSGFUNC msgfunc, void *userdata);
+void libbmp_close(LIBBMP_SESSION *session);
+
+bool libbmp_connect(LIBBMP_SESSION *session, int probe, const char *ipaddress, LIBBMP_DONEFUNC donefunc, void *userdata);
+bool libbmp_attach(LIBBMP_SESSION *session, bool autopower, LIBBMP_DONEFUNC donefunc, void *userdata);
+bool libbmp_detach(LIBBMP_SESSION *session, bool powerdown, LIBBMP_DONEFUNC donefunc, void *userdata);
+bool libbmp_flash(LIBBMP_SESSION *session, const char *filename, bool differential, LIBBMP_DONEFUNC donefunc, void *userdata);
+bool libbmp_verify(LIBBMP_SESSION *session, const char *filename, LIBBMP_DONEFUNC donefunc, void *userdata);
+bool libbmp_monitor(LIBBMP_SESSION *session, const char *command, LIBBMP_DONEFUNC donefunc, void *userdata);
+bool libbmp_restart(LIBBMP_SESSION *session, LIBBMP_DONEFUNC donefunc, void *userdata);
+
+bool libbmp_busy(LIBBMP_SESSION *session);
+void libbmp_wait(LIBBMP_SESSION *session);
+void libbmp_progress(LIBBMP_SESSION *session, unsigned long *step, unsigned long *range);
+const char *libbmp_targetname(LIBBMP_SESSION *session);
+
+bool libbmp_trace_start(LIBBMP_SESSION *session, int async_bitrate, LIBBMP_TRACEFUNC tracefunc,
+                        LIBBMP_DONEFUNC donefunc, void *userdata);
+void libbmp_trace_stop(LIBBMP_SESSION *session);
+
+#if defined __cplusplus
+  }
+#endif
+
+#endif /* _LIBBMP_H */
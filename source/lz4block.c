@@ -0,0 +1,210 @@
+/*
+ * Compression and decompression of memory blocks in the LZ4 block format.
+ * This is a compact implementation, for compressing history buffers that are
+ * no longer modified; it favours speed over compression ratio.
+ *
+ * Copyright 2026 CompuPhase
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <assert.h>
+#include <stdint.h>
+#include <string.h>
+#include "lz4block.h"
+
+#define HASH_BITS     12
+#define MINMATCH      4
+#define LASTLITERALS  5     /* the last 5 bytes are always literals */
+#define MFLIMIT       12    /* the last match must start 12 bytes before the end */
+#define MAX_OFFSET    65535
+#define SKIP_TRIGGER  6     /* speed up on incompressible data after 2^6 misses */
+
+static inline uint32_t read32(const unsigned char *ptr)
+{
+  uint32_t value;
+  memcpy(&value, ptr, sizeof value);
+  return value;
+}
+
+static inline unsigned hash4(uint32_t value)
+{
+  return (value * 2654435761u) >> (32 - HASH_BITS);
+}
+
+/* put_length() stores the part of a length that does not fit in the token */
+static unsigned char *put_length(unsigned char *ptr, size_t length)
+{
+  assert(length >= 15);
+  length -= 15;
+  while (length >= 255) {
+    *ptr++ = 255;
+    length -= 255;
+  }
+  *ptr++ = (unsigned char)length;
+  return ptr;
+}
+
+/* put_sequence() stores the literals from "anchor" to "ip", followed by a
+   match (if "matchlen" is non-zero) */
+static unsigned char *put_sequence(unsigned char *op, const unsigned char *anchor, const unsigned char *ip,
+                                   size_t offset, size_t matchlen)
+{
+  size_t litlen = ip - anchor;
+  unsigned char *token = op++;
+  *token = (unsigned char)(((litlen >= 15) ? 15 : litlen) << 4);
+  if (litlen >= 15)
+    op = put_length(op, litlen);
+  memcpy(op, anchor, litlen);
+  op += litlen;
+  if (matchlen > 0) {
+    assert(offset > 0 && offset <= MAX_OFFSET);
+    *op++ = (unsigned char)(offset & 0xff);
+    *op++ = (unsigned char)(offset >> 8);
+    matchlen -= MINMATCH;
+    *token |= (unsigned char)((matchlen >= 15) ? 15 : matchlen);
+    if (matchlen >= 15)
+      op = put_length(op, matchlen);
+  }
+  return op;
+}
+
+/** lz4_compress() compresses a block of memory.
+ *
+ *  \param src      The data to compress.
+ *  \param srcsize  The size of the data in bytes.
+ *  \param dst      The buffer for the compressed data.
+ *  \param dstsize  The size of the buffer; this must be at least
+ *                  LZ4_BOUND(srcsize).
+ *
+ *  \return The size of the compressed data, or 0 if the buffer is too small.
+ */
+size_t lz4_compress(const unsigned char *src, size_t srcsize, unsigned char *dst, size_t dstsize)
+{
+  uint32_t table[1 << HASH_BITS];   /* most recent position of each hash */
+
+  assert(src != NULL && dst != NULL);
+  if (dstsize < LZ4_BOUND(srcsize))
+    return 0;
+
+  const unsigned char *ip = src;
+  const unsigned char *anchor = src;
+  const unsigned char *iend = src + srcsize;
+  unsigned char *op = dst;
+  if (srcsize > MFLIMIT) {
+    const unsigned char *mflimit = iend - MFLIMIT;
+    const unsigned char *matchlimit = iend - LASTLITERALS;
+    unsigned misses = 0;
+    memset(table, 0, sizeof table);
+    while (ip < mflimit) {
+      uint32_t seq = read32(ip);
+      unsigned h = hash4(seq);
+      const unsigned char *ref = src + table[h];
+      table[h] = (uint32_t)(ip - src);
+      if (ref >= ip || ip - ref > MAX_OFFSET || read32(ref) != seq) {
+        ip += 1 + (misses++ >> SKIP_TRIGGER);
+        continue;
+      }
+      misses = 0;
+      /* extend the match backwards (into the pending literals) and forwards */
+      while (ip > anchor && ref > src && ip[-1] == ref[-1]) {
+        ip--;
+        ref--;
+      }
+      const unsigned char *mp = ip + MINMATCH;
+      const unsigned char *rp = ref + MINMATCH;
+      while (mp < matchlimit && *mp == *rp) {
+        mp++;
+        rp++;
+      }
+      op = put_sequence(op, anchor, ip, ip - ref, mp - ip);
+      ip = anchor = mp;
+      if (ip < mflimit)
+        table[hash4(read32(ip - 2))] = (uint32_t)(ip - 2 - src);
+    }
+  }
+  op = put_sequence(op, anchor, iend, 0, 0);  /* last literals */
+  assert((size_t)(op - dst) <= dstsize);
+  return op - dst;
+}
+
+/** lz4_decompress() decompresses a block of memory that was compressed with
+ *  lz4_compress() (or another encoder for the LZ4 block format). Malformed
+ *  input is detected; it never causes reads or writes outside the buffers.
+ *
+ *  \param src      The compressed data.
+ *  \param srcsize  The size of the compressed data in bytes.
+ *  \param dst      The buffer for the decompressed data.
+ *  \param dstsize  The size of the buffer.
+ *
+ *  \return The size of the decompressed data, or 0 on error (malformed input,
+ *          or the buffer is too small).
+ */
+size_t lz4_decompress(const unsigned char *src, size_t srcsize, unsigned char *dst, size_t dstsize)
+{
+  assert(src != NULL && dst != NULL);
+  const unsigned char *ip = src;
+  const unsigned char *iend = src + srcsize;
+  unsigned char *op = dst;
+  unsigned char *oend = dst + dstsize;
+
+  while (ip < iend) {
+    unsigned token = *ip++;
+    size_t length = token >> 4;
+    if (length == 15) {
+      unsigned char b;
+      do {
+        if (ip >= iend)
+          return 0;
+        b = *ip++;
+        length += b;
+      } while (b == 255);
+    }
+    if ((size_t)(iend - ip) < length || (size_t)(oend - op) < length)
+      return 0;
+    memcpy(op, ip, length);
+    op += length;
+    ip += length;
+    if (ip == iend)
+      break;          /* the last sequence has no match */
+
+    if (iend - ip < 2)
+      return 0;
+    size_t offset = ip[0] | ((size_t)ip[1] << 8);
+    ip += 2;
+    if (offset == 0 || offset > (size_t)(op - dst))
+      return 0;
+    length = token & 0x0f;
+    if (length == 15) {
+      unsigned char b;
+      do {
+        if (ip >= iend)
+          return 0;
+        b = *ip++;
+        length += b;
+      } while (b == 255);
+    }
+    length += MINMATCH;
+    if ((size_t)(oend - op) < length)
+      return 0;
+    const unsigned char *ref = op - offset;
+    if (offset >= length) {
+      memcpy(op, ref, length);
+      op += length;
+    } else {
+      while (length-- > 0)
+        *op++ = *ref++;   /* overlapping copy (repeating pattern) */
+    }
+  }
+  return op - dst;
+}
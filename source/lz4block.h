@@ -0,0 +1,40 @@
+/*
+ * Compression and decompression of memory blocks in the LZ4 block format.
+ * This is a compact implementation, for compressing history buffers that are
+ * no longer modified; it favours speed over compression ratio.
+ *
+ * Copyright 2026 CompuPhase
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef _LZ4BLOCK_H
+#define _LZ4BLOCK_H
+
+#include <stddef.h>
+
+#if defined __cplusplus
+  extern "C" {
+#endif
+
+/* worst-case size of the compressed data, for "size" bytes of input */
+#define LZ4_BOUND(size)   ((size) + (size) / 255 + 16)
+
+size_t lz4_compress(const unsigned char *src, size_t srcsize, unsigned char *dst, size_t dstsize);
+size_t lz4_decompress(const unsigned char *src, size_t srcsize, unsigned char *dst, size_t dstsize);
+
+#if defined __cplusplus
+  }
+#endif
+
+#endif /* _LZ4BLOCK_H */
@@ -18,10 +18,12 @@
  */
 #include <assert.h>
 #include <ctype.h>
+#include <stdbool.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include "guidriver.h"
+#include "hexcodec.h"
 #include "memdump.h"
 #include "nuklear_style.h"
 
@@ -78,6 +80,13 @@ static const char *fieldvalue(const char *field, size_t *len)
   return ptr + 1;
 }
 
+/* is_rawformat() returns whether the memory is read as raw bytes and
+   formatted locally, or whether GDB formats it */
+static bool is_rawformat(char fmt)
+{
+  return fmt != '\0' && strchr("xduotacf", fmt) != NULL;
+}
+
 void memdump_init(MEMDUMP *memdump)
 {
   assert(memdump != NULL);
@@ -96,6 +105,15 @@ void memdump_cleanup(MEMDUMP *memdump)
     free(memdump->prev);
     memdump->prev = NULL;
   }
+  if (memdump->bytes != NULL) {
+    free(memdump->bytes);
+    memdump->bytes = NULL;
+  }
+  if (memdump->prevbytes != NULL) {
+    free(memdump->prevbytes);
+    memdump->prevbytes = NULL;
+  }
+  memdump->length = memdump->prevlength = 0;
   if (memdump->message != NULL) {
     free(memdump->message);
     memdump->message = NULL;
@@ -113,8 +131,8 @@ int memdump_validate(MEMDUMP *memdump)
     memdump->size = 1;
   if (memdump->count == 0)
     memdump->count = (memdump->size == 1) ? 16 : 8;
-  if (memdump->fmt == 'f' && memdump->size != 32 && memdump->size != 64)
-    memdump->size = 32; /* size must be 32 or 64 for floating point type -> default to 32 */
+  if (memdump->fmt == 'f' && memdump->size != 4 && memdump->size != 8)
+    memdump->size = 4;  /* size must be 4 or 8 for floating point type -> default to 4 */
 
   /* reset everything if no valid address expression is present */
   if (memdump->expr == NULL || strlen(memdump->expr) == 0) {
@@ -125,6 +143,69 @@ int memdump_validate(MEMDUMP *memdump)
   return (memdump->count * memdump->size) > 0;
 }
 
+/** memdump_hasdata() returns whether there is memory data to display.
+ */
+bool memdump_hasdata(const MEMDUMP *memdump)
+{
+  assert(memdump != NULL);
+  return memdump->data != NULL || memdump->bytes != NULL;
+}
+
+/** memdump_command() creates the GDB command to read the memory for the
+ *  memory view. For most formats, the memory is read as a block of bytes,
+ *  which is decoded and formatted locally.
+ *
+ *  \param memdump    [in] the address expression, format and count.
+ *  \param buffer     [out] the command.
+ *  \param size       The size of the buffer in characters.
+ *
+ *  
+eturn The length of the command.
+ */
+int memdump_command(const MEMDUMP *memdump, char *buffer, size_t size)
+{
+  assert(memdump != NULL);
+  assert(memdump->expr != NULL);
+  assert(buffer != NULL && size > 0);
+  if (is_rawformat(memdump->fmt))
+    return snprintf(buffer, size, "-data-read-memory-bytes \"%s\" %d\n",
+                    memdump->expr, memdump->count * memdump->size);
+  return snprintf(buffer, size, "-data-read-memory \"%s\" %c %d 1 %d\n",
+                  memdump->expr, memdump->fmt, memdump->size, memdump->count);
+}
+
+/* parse_bytes() handles the result of -data-read-memory-bytes; only the
+   first block is used */
+static int parse_bytes(const char *gdbresult, MEMDUMP *memdump)
+{
+  const char *start, *ptr;
+  unsigned long begin, offset;
+  size_t count;
+
+  if ((start = strstr(gdbresult, "memory=")) == NULL)
+    return 0;
+  if ((ptr = strstr(start, "begin=")) == NULL || (ptr = fieldvalue(ptr, NULL)) == NULL)
+    return 0;
+  begin = strtoul(ptr, NULL, 0);
+  offset = 0;
+  if ((ptr = strstr(start, "offset=")) != NULL && (ptr = fieldvalue(ptr, NULL)) != NULL)
+    offset = strtoul(ptr, NULL, 0);
+  if ((ptr = strstr(start, "contents=")) == NULL || (ptr = fieldvalue(ptr, &count)) == NULL)
+    return 0;
+  count /= 2;
+
+  /* keep the previous block, for highlighting changes */
+  if (memdump->prevbytes != NULL)
+    free(memdump->prevbytes);
+  memdump->prevbytes = memdump->bytes;
+  memdump->prevlength = memdump->length;
+  memdump->prevaddress = memdump->address;
+  memdump->address = begin + offset;
+  memdump->bytes = malloc((count > 0) ? count : 1);
+  memdump->length = (memdump->bytes != NULL) ? hexcodec_decode(ptr, 2 * count, memdump->bytes) : 0;
+  return 1;
+}
+
 int memdump_parse(const char *gdbresult, MEMDUMP *memdump)
 {
   const char *start, *ptr;
@@ -150,6 +231,18 @@ int memdump_parse(const char *gdbresult, MEMDUMP *memdump)
     return 1; /* return 1 because the packet was successfully parsed */
   }
 
+  if (strstr(gdbresult, "contents=") != NULL) {
+    if (!parse_bytes(gdbresult, memdump))
+      return 0;
+    memdump->stale = false;
+    memdump->columns = 0;
+    if (memdump->message != NULL) {
+      free(memdump->message);
+      memdump->message = NULL;
+    }
+    return 1;
+  }
+
   /* get the start address */
   if ((start = strstr(gdbresult, "addr=")) == NULL)
     return 0;
@@ -250,6 +343,7 @@ int memdump_parse(const char *gdbresult, MEMDUMP *memdump)
     *tgt = '\0';
   }
 
+  memdump->stale = false;
   memdump->columns = 0;             /* force recalculation of the field sizes and number of columns */
   if (memdump->message != NULL) {   /* clear old error message, if any */
     free(memdump->message);
@@ -259,6 +353,53 @@ int memdump_parse(const char *gdbresult, MEMDUMP *memdump)
   return 1;
 }
 
+/* format_item() formats a single item from the raw memory block (in the
+   format and size of the memory view), returns the length of the text */
+static int format_item(const MEMDUMP *memdump, const unsigned char *bytes, char *text, size_t size)
+{
+  unsigned long long value = 0;
+  int idx;
+
+  for (idx = memdump->size - 1; idx >= 0; idx--)
+    value = (value << 8) | bytes[idx];  /* target is Little Endian */
+  switch (memdump->fmt) {
+  case 'd':
+    if (memdump->size < 8 && (value & (1ull << (8 * memdump->size - 1))) != 0)
+      value |= ~0ull << (8 * memdump->size);  /* sign-extend */
+    return snprintf(text, size, "%lld", (long long)value);
+  case 'u':
+    return snprintf(text, size, "%llu", value);
+  case 'o':
+    return snprintf(text, size, (value == 0) ? "0" : "0%llo", value);
+  case 't':
+    for (idx = 0; idx < 8 * memdump->size && idx < (int)size - 1; idx++)
+      text[idx] = (value & (1ull << (8 * memdump->size - 1 - idx))) ? '1' : '0';
+    text[idx] = '\0';
+    return idx;
+  case 'a':
+    return snprintf(text, size, "0x%llx", value);
+  case 'c':
+    value &= 0xff;
+    if (value == '\'' || value == '\\')
+      return snprintf(text, size, "'\\%c'", (int)value);
+    if (isprint((int)value))
+      return snprintf(text, size, "'%c'", (int)value);
+    return snprintf(text, size, "'\\x%02x'", (int)value);
+  case 'f':
+    if (memdump->size == 8) {
+      double d;
+      memcpy(&d, bytes, sizeof d);
+      return snprintf(text, size, "%g", d);
+    } else {
+      float f;
+      memcpy(&f, bytes, sizeof f);
+      return snprintf(text, size, "%g", (double)f);
+    }
+  default:
+    return snprintf(text, size, "0x%0*llx", 2 * memdump->size, value);
+  }
+}
+
 static void calc_layout(struct nk_context *ctx, struct nk_user_font const *font,
                         float widget_width, MEMDUMP *memdump)
 {
@@ -268,22 +409,32 @@ static void calc_layout(struct nk_context *ctx, struct nk_user_font const *font,
   memdump->addr_width = (8 + 1) * char_width;
 
   unsigned maxlen = 0;
-  const char *head = memdump->data;
-  while (*head != '\0') {
-    const char *tail;
-    if (*head == '"') {
-      tail = skipstring(head);
-    } else {
-      tail = strchr(head, ',');
-      if (tail == NULL)
-        tail = strchr(head, '\0');
+  if (memdump->bytes != NULL) {
+    size_t idx;
+    for (idx = 0; idx + memdump->size <= memdump->length; idx += memdump->size) {
+      char field[80];
+      unsigned len = format_item(memdump, memdump->bytes + idx, field, sizeof field);
+      if (len >= maxlen)
+        maxlen = len;
+    }
+  } else {
+    const char *head = memdump->data;
+    while (*head != '\0') {
+      const char *tail;
+      if (*head == '"') {
+        tail = skipstring(head);
+      } else {
+        tail = strchr(head, ',');
+        if (tail == NULL)
+          tail = strchr(head, '\0');
+      }
+      unsigned len = (tail - head);
+      if (len >= maxlen)
+        maxlen = len;
+      head = tail;
+      if (*head == ',')
+        head += 1;
     }
-    unsigned len = (tail - head);
-    if (len >= maxlen)
-      maxlen = len;
-    head = tail;
-    if (*head == ',')
-      head += 1;
   }
   memdump->item_width = (maxlen + 0.5) * char_width;
 
@@ -296,14 +447,67 @@ static void calc_layout(struct nk_context *ctx, struct nk_user_font const *font,
   }
 }
 
+/* raw_rows() lays out the rows of a raw memory block; only the rows that are
+   in view are filled in, the others are replaced by spacers */
+static void raw_rows(struct nk_context *ctx, MEMDUMP *memdump, float viewheight, int rowheight, unsigned yscroll)
+{
+  float spacing = ctx->style.window.spacing.y;
+  float pitch = rowheight + spacing;
+  int items = memdump->length / memdump->size;
+  int total = (items + memdump->columns - 1) / memdump->columns;
+  int visible = (int)(viewheight / pitch) + 2;
+  int first = (int)(yscroll / pitch) - 1;
+  if (first > total - visible)
+    first = total - visible;
+  if (first < 0)
+    first = 0;
+  int last = (first + visible < total) ? first + visible : total;
+
+  if (first > 0) {
+    nk_layout_row_dynamic(ctx, first * pitch - spacing, 1);
+    nk_spacing(ctx, 1);
+  }
+  for (int row = first; row < last; row++) {
+    char field[80];
+    unsigned long addr = memdump->address + row * memdump->columns * memdump->size;
+    nk_layout_row_begin(ctx, NK_STATIC, rowheight, memdump->columns + 1);
+    nk_layout_row_push(ctx, memdump->addr_width);
+    sprintf(field, "%08lx", addr);
+    nk_label(ctx, field, NK_TEXT_LEFT);
+    for (int col = 0; col < memdump->columns; col++) {
+      size_t offs = (row * memdump->columns + col) * memdump->size;
+      if (offs + memdump->size > memdump->length)
+        break;
+      format_item(memdump, memdump->bytes + offs, field, sizeof field);
+      /* compare with the same address in the previous block */
+      bool modified = false;
+      if (memdump->prevbytes != NULL && addr >= memdump->prevaddress
+          && addr + memdump->size <= memdump->prevaddress + memdump->prevlength)
+        modified = memcmp(memdump->bytes + offs, memdump->prevbytes + (addr - memdump->prevaddress), memdump->size) != 0;
+      nk_layout_row_push(ctx, memdump->item_width);
+      if (modified)
+        nk_label_colored(ctx, field, NK_TEXT_LEFT, COLOUR_FG_RED);
+      else
+        nk_label(ctx, field, NK_TEXT_LEFT);
+      addr += memdump->size;
+    }
+    nk_layout_row_end(ctx);
+  }
+  if (last < total) {
+    nk_layout_row_dynamic(ctx, (total - last) * pitch - spacing, 1);
+    nk_spacing(ctx, 1);
+  }
+}
+
 void memdump_widget(struct nk_context *ctx, MEMDUMP *memdump, int widgetheight, int rowheight)
 {
   int fonttype;
   struct nk_user_font const *font;
+  nk_uint xscroll, yscroll;
 
   assert(ctx != NULL);
   assert(memdump != NULL);
-  assert(memdump->data != NULL);
+  assert(memdump_hasdata(memdump));
 
   nk_layout_row_dynamic(ctx, rowheight, 2);
   nk_label(ctx, "Address", NK_TEXT_ALIGN_LEFT | NK_TEXT_ALIGN_MIDDLE);
@@ -314,6 +518,7 @@ void memdump_widget(struct nk_context *ctx, MEMDUMP *memdump, int widgetheight,
   font = ctx->style.font;
 
   nk_layout_row_dynamic(ctx, widgetheight, 1);
+  nk_group_get_scroll(ctx, "memory", &xscroll, &yscroll);
   nk_style_push_color(ctx, &ctx->style.window.fixed_background.data.color, COLOUR_BG0);
   if (nk_group_begin(ctx, "memory", 0)) {
     struct nk_rect rcwidget = nk_layout_widget_bounds(ctx);
@@ -327,56 +532,60 @@ void memdump_widget(struct nk_context *ctx, MEMDUMP *memdump, int widgetheight,
       assert(memdump->columns > 0);
     }
 
-    head = memdump->data;
-    prev_head = memdump->prev;
-    while (*head != '\0') {
-      char field[128];
-      unsigned len;
-      int modified = 0;
-      /* check for a new row */
-      if (col == 0) {
-        nk_layout_row_begin(ctx, NK_STATIC, rowheight, memdump->columns + 1);
-        nk_layout_row_push(ctx, memdump->addr_width);
-        sprintf(field, "%08lx", addr);
-        nk_label(ctx, field, NK_TEXT_LEFT);
-      }
-      /* extract the field */
-      if (*head == '"') {
-        tail = skipstring(head);
-      } else {
-        tail = strchr(head, ',');
-        if (tail == NULL)
-          tail = strchr(head, '\0');
-      }
-      len = (tail - head);
-      /* extract field in back-up data and compare */
-      if (prev_head != NULL) {
-        const char *prev_tail;
-        if (*prev_head == '"') {
-          prev_tail = skipstring(prev_head);
+    if (memdump->bytes != NULL) {
+      raw_rows(ctx, memdump, widgetheight, rowheight, yscroll);
+    } else {
+      head = memdump->data;
+      prev_head = memdump->prev;
+      while (*head != '\0') {
+        char field[128];
+        unsigned len;
+        int modified = 0;
+        /* check for a new row */
+        if (col == 0) {
+          nk_layout_row_begin(ctx, NK_STATIC, rowheight, memdump->columns + 1);
+          nk_layout_row_push(ctx, memdump->addr_width);
+          sprintf(field, "%08lx", addr);
+          nk_label(ctx, field, NK_TEXT_LEFT);
+        }
+        /* extract the field */
+        if (*head == '"') {
+          tail = skipstring(head);
         } else {
-          prev_tail = strchr(prev_head, ',');
-          if (prev_tail == NULL)
-            prev_tail = strchr(prev_head, '\0');
+          tail = strchr(head, ',');
+          if (tail == NULL)
+            tail = strchr(head, '\0');
         }
-        modified = memcmp(head, prev_head, len + 1);
-        prev_head = (*prev_tail == ',') ? prev_tail + 1 : prev_tail;
+        len = (tail - head);
+        /* extract field in back-up data and compare */
+        if (prev_head != NULL) {
+          const char *prev_tail;
+          if (*prev_head == '"') {
+            prev_tail = skipstring(prev_head);
+          } else {
+            prev_tail = strchr(prev_head, ',');
+            if (prev_tail == NULL)
+              prev_tail = strchr(prev_head, '\0');
+          }
+          modified = memcmp(head, prev_head, len + 1);
+          prev_head = (*prev_tail == ',') ? prev_tail + 1 : prev_tail;
+        }
+        if (len >= sizearray(field))
+          len = sizearray(field) - 1;
+        strncpy(field, head, len);
+        field[len] = '\0';
+        nk_layout_row_push(ctx, memdump->item_width);
+        if (modified)
+          nk_label_colored(ctx, field, NK_TEXT_LEFT, COLOUR_FG_RED);
+        else
+          nk_label(ctx, field, NK_TEXT_LEFT);
+        /* advance to next field */
+        col = (col + 1) % memdump->columns;
+        addr += memdump->size;
+        head = tail;
+        if (*head == ',')
+          head += 1;
       }
-      if (len >= sizearray(field))
-        len = sizearray(field) - 1;
-      strncpy(field, head, len);
-      field[len] = '\0';
-      nk_layout_row_push(ctx, memdump->item_width);
-      if (modified)
-        nk_label_colored(ctx, field, NK_TEXT_LEFT, COLOUR_FG_RED);
-      else
-        nk_label(ctx, field, NK_TEXT_LEFT);
-      /* advance to next field */
-      col = (col + 1) % memdump->columns;
-      addr += memdump->size;
-      head = tail;
-      if (*head == ',')
-        head += 1;
     }
 
     nk_group_end(ctx);
@@ -19,6 +19,7 @@
 #ifndef _MEMDUMP_H
 #define _MEMDUMP_H
 
+#include <stdbool.h>
 #include "nuklear.h"
 
 typedef struct tagMEMDUMP {
@@ -28,8 +29,13 @@ typedef struct tagMEMDUMP {
   unsigned char size;           /* default = 1 (byte) */
   unsigned long address;        /* returned address */
   char *message;                /* error message (or NULL) */
-  char *data;                   /* current data */
+  char *data;                   /* current data (formatted by GDB) */
   char *prev;                   /* old data (for checking changes) */
+  unsigned char *bytes;         /* current data (raw bytes, formatted locally) */
+  unsigned char *prevbytes;     /* old raw data */
+  size_t length, prevlength;    /* sizes of the raw data buffers */
+  unsigned long prevaddress;    /* start address of the old raw data */
+  bool stale;                   /* target ran since the data was read */
   int columns;                  /* reset to 0 on parsing a new memory block */
   float addr_width, item_width;
 } MEMDUMP;
@@ -37,6 +43,8 @@ typedef struct tagMEMDUMP {
 void memdump_init(MEMDUMP *memdump);
 void memdump_cleanup(MEMDUMP *memdump);
 int memdump_validate(MEMDUMP *memdump);
+bool memdump_hasdata(const MEMDUMP *memdump);
+int memdump_command(const MEMDUMP *memdump, char *buffer, size_t size);
 int memdump_parse(const char *gdbresult, MEMDUMP *memdump);
 void memdump_widget(struct nk_context *ctx, MEMDUMP *memdump, int widgetheight, int rowheight);
 
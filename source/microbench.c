@@ -0,0 +1,784 @@
+/*
+ * Micro-benchmarks for the decoding and parsing code that is shared by the
+ * BlackMagic utilities. Each benchmark runs on fixed synthetic data (or on a
+ * file passed on the command line), and reports the time and the number of
+ * heap allocations per operation. The results are printed in JSON format,
+ * for regression tracking.
+ *
+ * Copyright 2026 CompuPhase
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <assert.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#if defined _WIN32
+# define STRICT
+# define WIN32_LEAN_AND_MEAN
+# include <windows.h>
+#endif
+#include "guidriver.h"
+#include "armdisasm.h"
+#include "crc32.h"
+#include "dwarf.h"
+#include "hexcodec.h"
+#include "parsetsdl.h"
+#include "decodectf.h"
+#include "svd-support.h"
+#include "swotrace.h"
+#include "tcl.h"
+#include "svnrev.h"
+
+#if defined FORTIFY
+# include <alloc/fortify.h>
+#endif
+
+#if defined WIN32 || defined _WIN32
+# define IS_OPTION(s)  ((s)[0] == '-' || (s)[0] == '/')
+#else
+# define IS_OPTION(s)  ((s)[0] == '-')
+#endif
+
+#if !defined sizearray
+# define sizearray(e)    (sizeof(e) / sizeof((e)[0]))
+#endif
+
+#if !defined _MAX_PATH
+# define _MAX_PATH 260
+#endif
+
+
+/* With BENCH_WRAPMALLOC, the program must be linked with the GNU linker
+   options --wrap=malloc, --wrap=calloc and --wrap=realloc; the allocations
+   made in the C library itself (e.g. by strdup() or fopen()) are not
+   counted. Without it, the allocation counts are reported as -1. */
+#if defined BENCH_WRAPMALLOC
+  static unsigned long alloc_count = 0;
+  void *__real_malloc(size_t size);
+  void *__real_calloc(size_t num, size_t size);
+  void *__real_realloc(void *ptr, size_t size);
+  void *__wrap_malloc(size_t size)
+  {
+    __atomic_fetch_add(&alloc_count, 1, __ATOMIC_RELAXED);
+    return __real_malloc(size);
+  }
+  void *__wrap_calloc(size_t num, size_t size)
+  {
+    __atomic_fetch_add(&alloc_count, 1, __ATOMIC_RELAXED);
+    return __real_calloc(num, size);
+  }
+  void *__wrap_realloc(void *ptr, size_t size)
+  {
+    __atomic_fetch_add(&alloc_count, 1, __ATOMIC_RELAXED);
+    return __real_realloc(ptr, size);
+  }
+# define ALLOC_COUNT()  __atomic_load_n(&alloc_count, __ATOMIC_RELAXED)
+#else
+# define ALLOC_COUNT()  0
+#endif
+
+static unsigned long long nanoseconds(void)
+{
+# if defined _WIN32
+    LARGE_INTEGER freq, count;
+    QueryPerformanceFrequency(&freq);
+    QueryPerformanceCounter(&count);
+    return (unsigned long long)(count.QuadPart / freq.QuadPart) * 1000000000
+           + (unsigned long long)((count.QuadPart % freq.QuadPart) * 1000000000 / freq.QuadPart);
+# else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (unsigned long long)ts.tv_sec * 1000000000 + ts.tv_nsec;
+# endif
+}
+
+/* prng() is a xorshift generator, so that the synthetic data is the same on
+   every platform */
+static uint32_t random_state = 1;
+static uint32_t prng(void)
+{
+  random_state ^= random_state << 13;
+  random_state ^= random_state >> 17;
+  random_state ^= random_state << 5;
+  return random_state;
+}
+
+/* temp_path() creates a path for a scratch file in the temporary directory */
+static const char *temp_path(const char *basename, char *path, size_t size)
+{
+  const char *dir = getenv("TMPDIR");
+# if defined _WIN32
+    if (dir == NULL)
+      dir = getenv("TEMP");
+    if (dir == NULL)
+      dir = ".";
+    snprintf(path, size, "%s\\%s", dir, basename);
+# else
+    if (dir == NULL)
+      dir = "/tmp";
+    snprintf(path, size, "%s/%s", dir, basename);
+# endif
+  return path;
+}
+
+int ctf_error_notify(int code, int linenr, const char *message)
+{
+  (void)linenr;
+  if (code > CTFERR_NONE)
+    fprintf(stderr, "TSDL error: %s\n", message);
+  return 0;
+}
+
+
+/* ----- options ----- */
+
+static const char *opt_elffile = NULL;
+static const char *opt_svdfile = NULL;
+static const char *opt_swofile = NULL;
+
+
+/* ----- gdb_crc32() ----- */
+
+#define CRC_BLOCKSIZE (64*1024)
+static unsigned char *crc_block = NULL;
+
+static bool crc_setup(void)
+{
+  if ((crc_block = malloc(CRC_BLOCKSIZE)) == NULL)
+    return false;
+  for (unsigned idx = 0; idx < CRC_BLOCKSIZE; idx++)
+    crc_block[idx] = (unsigned char)prng();
+  return true;
+}
+
+static volatile uint32_t crc_result;  /* volatile, so that the call is not optimized away */
+
+static unsigned long crc_run(void)
+{
+  crc_result = gdb_crc32(0xffffffff, crc_block, CRC_BLOCKSIZE);
+  return CRC_BLOCKSIZE / 1024;
+}
+
+static void crc_cleanup(void)
+{
+  free(crc_block);
+  crc_block = NULL;
+}
+
+
+/* ----- hexcodec_encode() & hexcodec_decode() ----- */
+
+#define HEX_BLOCKSIZE (64*1024)
+static unsigned char *hex_block = NULL;
+static char *hex_text = NULL;
+
+static bool hex_setup(void)
+{
+  hex_block = malloc(HEX_BLOCKSIZE);
+  hex_text = malloc(2 * HEX_BLOCKSIZE);
+  if (hex_block == NULL || hex_text == NULL)
+    return false;
+  for (unsigned idx = 0; idx < HEX_BLOCKSIZE; idx++)
+    hex_block[idx] = (unsigned char)prng();
+  hexcodec_encode(hex_block, HEX_BLOCKSIZE, hex_text);
+  return true;
+}
+
+static unsigned long hexenc_run(void)
+{
+  hexcodec_encode(hex_block, HEX_BLOCKSIZE, hex_text);
+  return HEX_BLOCKSIZE / 1024;
+}
+
+static unsigned long hexdec_run(void)
+{
+  if (hexcodec_decode(hex_text, 2 * HEX_BLOCKSIZE, hex_block) != HEX_BLOCKSIZE)
+    return 0;
+  return HEX_BLOCKSIZE / 1024;
+}
+
+static void hex_cleanup(void)
+{
+  free(hex_block);
+  free(hex_text);
+  hex_block = NULL;
+  hex_text = NULL;
+}
+
+
+/* ----- disasm_buffer() ----- */
+
+#define DISASM_BLOCKSIZE  (16*1024)
+static unsigned char *disasm_block = NULL;
+static unsigned long disasm_lines = 0;
+static ARMSTATE disasm_state;
+
+/* typical compiler output: 16-bit instructions, and 32-bit instructions as
+   pairs of half-words */
+static const uint16_t disasm_opcodes[][2] = {
+  { 0xb580, 0 },      { 0xaf00, 0 },      { 0xb082, 0 },      { 0x4b03, 0 },
+  { 0x681b, 0 },      { 0x2b00, 0 },      { 0xd001, 0 },      { 0x3301, 0 },
+  { 0x6013, 0 },      { 0x9301, 0 },      { 0x9b01, 0 },      { 0x4618, 0 },
+  { 0x46bd, 0 },      { 0xbd80, 0 },      { 0x4770, 0 },      { 0xe7fe, 0 },
+  { 0xf000, 0xf800 }, { 0xf8d3, 0x3000 }, { 0xe92d, 0x4ff0 }, { 0xf04f, 0x0300 },
+  { 0xfb02, 0xf303 }, { 0xe8bd, 0x8ff0 }, { 0xf8c2, 0x3004 }, { 0xea4f, 0x0343 },
+};
+
+static bool disasm_setup(void)
+{
+  if ((disasm_block = calloc(DISASM_BLOCKSIZE, 1)) == NULL)
+    return false;
+  for (unsigned idx = 0; idx + 4 <= DISASM_BLOCKSIZE; ) {
+    const uint16_t *op = disasm_opcodes[prng() % sizearray(disasm_opcodes)];
+    disasm_block[idx++] = (unsigned char)(op[0] & 0xff);
+    disasm_block[idx++] = (unsigned char)(op[0] >> 8);
+    if (op[1] != 0) {
+      disasm_block[idx++] = (unsigned char)(op[1] & 0xff);
+      disasm_block[idx++] = (unsigned char)(op[1] >> 8);
+    }
+  }
+  disasm_init(&disasm_state, DISASM_ADDRESS | DISASM_INSTR | DISASM_COMMENT);
+  return true;
+}
+
+static bool disasm_line(uint32_t address, const char *text, void *user)
+{
+  (void)address;
+  (void)text;
+  (void)user;
+  disasm_lines += 1;
+  return true;
+}
+
+static unsigned long disasm_run(void)
+{
+  disasm_lines = 0;
+  disasm_address(&disasm_state, 0x08000000);
+  disasm_buffer(&disasm_state, disasm_block, DISASM_BLOCKSIZE, ARMMODE_THUMB, disasm_line, NULL);
+  return disasm_lines;
+}
+
+static void disasm_done(void)
+{
+  disasm_cleanup(&disasm_state);
+  free(disasm_block);
+  disasm_block = NULL;
+}
+
+
+/* ----- tcl_eval() ----- */
+
+static const char tcl_script[] =
+  "proc fib {n} {\n"
+  "  if {$n < 2} { return $n }\n"
+  "  return [expr [fib [expr $n - 1]] + [fib [expr $n - 2]]]\n"
+  "}\n"
+  "set total 0\n"
+  "for {set i 0} {$i < 200} {incr i} {\n"
+  "  set total [expr $total + $i * 3]\n"
+  "  lappend items [format \"%04x\" $i]\n"
+  "}\n"
+  "set n [llength $items]\n"
+  "fib 10\n";
+
+static bool tcl_setup(void)
+{
+  return true;
+}
+
+static unsigned long tcl_run(void)
+{
+  struct tcl tcl;
+  tcl_init(&tcl);
+  if (!tcl_eval(&tcl, tcl_script, strlen(tcl_script)))
+    fprintf(stderr, "Tcl script failed\n");
+  tcl_destroy(&tcl);
+  return 1;
+}
+
+static void tcl_cleanup(void)
+{
+}
+
+
+/* ----- svd_load() ----- */
+
+static char svd_path[_MAX_PATH];
+static unsigned long svd_registers = 0;
+
+static bool svd_setup(void)
+{
+  if (opt_svdfile != NULL) {
+    strncpy(svd_path, opt_svdfile, sizearray(svd_path));
+    svd_path[sizearray(svd_path) - 1] = '\0';
+    return true;
+  }
+  /* synthetic device with 64 peripherals, 32 registers each, 8 fields per
+     register */
+  temp_path("microbench.svd", svd_path, sizearray(svd_path));
+  FILE *fp = fopen(svd_path, "wt");
+  if (fp == NULL)
+    return false;
+  fprintf(fp, "<?xml version=\"1.0\" encoding=\"utf-8\"?>\n"
+              "<device schemaVersion=\"1.1\">\n"
+              "  <name>BENCH</name>\n"
+              "  <width>32</width>\n"
+              "  <peripherals>\n");
+  for (int per = 0; per < 64; per++) {
+    fprintf(fp, "    <peripheral>\n"
+                "      <name>PER%d</name>\n"
+                "      <description>Peripheral %d</description>\n"
+                "      <baseAddress>0x%08x</baseAddress>\n"
+                "      <registers>\n", per, per, 0x40000000 + per * 0x400);
+    for (int reg = 0; reg < 32; reg++) {
+      fprintf(fp, "        <register>\n"
+                  "          <name>REG%d</name>\n"
+                  "          <description>Register %d of peripheral %d</description>\n"
+                  "          <addressOffset>0x%x</addressOffset>\n"
+                  "          <size>32</size>\n"
+                  "          <fields>\n", reg, reg, per, reg * 4);
+      for (int fld = 0; fld < 8; fld++)
+        fprintf(fp, "            <field><name>F%d</name><description>Field %d</description><bitRange>[%d:%d]</bitRange></field>\n",
+                fld, fld, fld * 4 + 3, fld * 4);
+      fprintf(fp, "          </fields>\n"
+                  "        </register>\n");
+    }
+    fprintf(fp, "      </registers>\n"
+                "    </peripheral>\n");
+  }
+  fprintf(fp, "  </peripherals>\n"
+              "</device>\n");
+  fclose(fp);
+  svd_registers = 64 * 32;
+  return true;
+}
+
+static unsigned long svd_run(void)
+{
+  if (!svd_load(svd_path))
+    fprintf(stderr, "Failed to load %s\n", svd_path);
+  return 1;
+}
+
+static void svd_cleanup(void)
+{
+  svd_clear();
+  if (opt_svdfile == NULL)
+    remove(svd_path);
+}
+
+
+/* ----- dwarf_read() ----- */
+
+static FILE *dwarf_fp = NULL;
+
+static bool dwarf_setup(void)
+{
+  if (opt_elffile == NULL)
+    return false;   /* there is no synthetic alternative */
+  dwarf_fp = fopen(opt_elffile, "rb");
+  return (dwarf_fp != NULL);
+}
+
+static unsigned long dwarf_run(void)
+{
+  DWARF_LINELOOKUP linetable = { NULL };
+  DWARF_SYMBOLLIST symboltable = { NULL };
+  DWARF_PATHLIST filetable = { NULL };
+  int address_size;
+  rewind(dwarf_fp);
+  dwarf_unitcache_clear();  /* measure a full parse, not a reload */
+  if (!dwarf_read(dwarf_fp, &linetable, &symboltable, &filetable, &address_size))
+    fprintf(stderr, "No DWARF information in %s\n", opt_elffile);
+  dwarf_cleanup(&linetable, &symboltable, &filetable);
+  return 1;
+}
+
+static void dwarf_done(void)
+{
+  if (dwarf_fp != NULL)
+    fclose(dwarf_fp);
+  dwarf_fp = NULL;
+  dwarf_unitcache_clear();
+}
+
+
+/* ----- ctf_decode() ----- */
+
+static const char ctf_tsdl[] =
+  "trace {\n"
+  "  major = 1;\n"
+  "  minor = 8;\n"
+  "  packet.header := struct {\n"
+  "    uint16_t magic;\n"
+  "  };\n"
+  "};\n"
+  "stream function_profile {\n"
+  "  id = 31;\n"
+  "  event.header := struct {\n"
+  "    uint16_t id;\n"
+  "  };\n"
+  "};\n"
+  "event function_profile::enter {\n"
+  "  id = 0;\n"
+  "  fields := struct {\n"
+  "    uint32_t symbol;\n"
+  "    int16_t depth;\n"
+  "  };\n"
+  "};\n"
+  "event function_profile::exit {\n"
+  "  id = 1;\n"
+  "  fields := struct {\n"
+  "    uint32_t symbol;\n"
+  "    int16_t depth;\n"
+  "  };\n"
+  "};\n";
+
+#define CTF_EVENTS      4096
+#define CTF_EVENTSIZE   10  /* magic (2), event id (2), symbol (4), depth (2) */
+static unsigned char *ctf_stream = NULL;
+
+static bool ctf_setup(void)
+{
+  char path[_MAX_PATH];
+  temp_path("microbench.tsdl", path, sizearray(path));
+  FILE *fp = fopen(path, "wt");
+  if (fp == NULL)
+    return false;
+  fputs(ctf_tsdl, fp);
+  fclose(fp);
+  bool ok = ctf_parse_init(path) && ctf_parse_run();
+  remove(path);
+  if (!ok)
+    return false;
+  if ((ctf_stream = malloc(CTF_EVENTS * CTF_EVENTSIZE)) == NULL)
+    return false;
+  unsigned char *ptr = ctf_stream;
+  for (int idx = 0; idx < CTF_EVENTS; idx++) {
+    uint32_t symbol = 0x08000000 + (prng() & 0xfffc);
+    ptr[0] = 0xc1;
+    ptr[1] = 0x1f;
+    ptr[2] = (unsigned char)(idx & 1);
+    ptr[3] = 0;
+    ptr[4] = (unsigned char)(symbol & 0xff);
+    ptr[5] = (unsigned char)((symbol >> 8) & 0xff);
+    ptr[6] = (unsigned char)((symbol >> 16) & 0xff);
+    ptr[7] = (unsigned char)((symbol >> 24) & 0xff);
+    ptr[8] = (unsigned char)(idx % 10);
+    ptr[9] = 0;
+    ptr += CTF_EVENTSIZE;
+  }
+  return true;
+}
+
+static unsigned long ctf_run(void)
+{
+  /* feed the stream in chunks of 4 bytes, like the ITM packets that it
+     arrives in */
+  unsigned long count = 0;
+  for (size_t idx = 0; idx < CTF_EVENTS * CTF_EVENTSIZE; idx += 4) {
+    size_t len = CTF_EVENTS * CTF_EVENTSIZE - idx;
+    if (len > 4)
+      len = 4;
+    if (ctf_decode(ctf_stream + idx, len, 31) > 0) {
+      char message[256];
+      while (msgstack_pop(NULL, NULL, message, sizearray(message)))
+        count++;
+    }
+  }
+  return count;
+}
+
+static void ctf_cleanup(void)
+{
+  ctf_decode_cleanup();
+  ctf_parse_cleanup();
+  free(ctf_stream);
+  ctf_stream = NULL;
+}
+
+
+/* ----- tracestring_process() & traceprofile_process() ----- */
+
+/* write_recording() creates a file in the format of trace_record_start(),
+   with 64-byte packets that are filled by a callback */
+typedef size_t (*FILLPACKET)(unsigned char *packet, size_t size, unsigned long seqnr);
+static bool write_recording(const char *path, unsigned long numpackets, FILLPACKET fill)
+{
+  FILE *fp = fopen(path, "wb");
+  if (fp == NULL)
+    return false;
+  unsigned char header[8] = { 'B', 'M', 'S', 'W', 1, 0, 0, 0 };
+  fwrite(header, 1, sizeof header, fp);
+  for (unsigned long seqnr = 0; seqnr < numpackets; seqnr++) {
+    unsigned char packet[64];
+    unsigned char length = (unsigned char)fill(packet, sizeof packet, seqnr);
+    double timestamp = seqnr * 0.0001;
+    fwrite(&length, 1, 1, fp);
+    fwrite(&timestamp, sizeof(double), 1, fp);
+    fwrite(packet, 1, length, fp);
+  }
+  fclose(fp);
+  return true;
+}
+
+#define SWO_PACKETS   20000
+static char swo_path[_MAX_PATH];
+static unsigned long swo_lines = 0;  /* number of lines in the synthetic recording */
+
+/* text on channel 0, one character per ITM packet; a line is 40 characters
+   (so that lines span the USB packets) */
+static size_t fill_text(unsigned char *packet, size_t size, unsigned long seqnr)
+{
+  size_t len = 0;
+  unsigned long pos = seqnr * (size / 2);
+  while (len + 2 <= size) {
+    int column = (int)(pos % 40);
+    packet[len++] = 0x01;   /* channel 0, 1 byte */
+    packet[len++] = (column == 39) ? '\n' : (unsigned char)('a' + (pos / 40 + column) % 26);
+    if (column == 39)
+      swo_lines += 1;
+    pos++;
+  }
+  return len;
+}
+
+static bool swotext_setup(void)
+{
+  swo_lines = 0;
+  if (opt_swofile != NULL) {
+    strncpy(swo_path, opt_swofile, sizearray(swo_path));
+    swo_path[sizearray(swo_path) - 1] = '\0';
+  } else {
+    temp_path("microbench-text.swo", swo_path, sizearray(swo_path));
+    if (!write_recording(swo_path, SWO_PACKETS, fill_text))
+      return false;
+  }
+  for (int idx = 0; idx < NUM_CHANNELS; idx++)
+    channel_set(idx, true, NULL, nk_rgb(255, 255, 255));
+  trace_setdatasize(0);   /* auto-detect */
+  return true;
+}
+
+static unsigned long swotext_run(void)
+{
+  tracestring_clear();
+  if (trace_replay(swo_path) != TRACESTAT_OK)
+    return 0;
+  int count;
+  do {
+    count = tracestring_process(true);
+  } while (trace_replay_active() || count > 0);
+  trace_close();
+  return (opt_swofile != NULL) ? tracestring_count() : swo_lines;
+}
+
+static void swotext_cleanup(void)
+{
+  tracestring_clear();
+  if (opt_swofile == NULL)
+    remove(swo_path);
+}
+
+#define PCSAMPLE_BASE 0x08000000
+#define PCSAMPLE_TOP  0x08010000
+static SAMPLEMAP *sample_map = NULL;
+
+/* 12 PC samples (of 5 bytes) per packet */
+static size_t fill_pcsamples(unsigned char *packet, size_t size, unsigned long seqnr)
+{
+  (void)seqnr;
+  size_t len = 0;
+  while (len + 5 <= size) {
+    uint32_t pc = PCSAMPLE_BASE + (prng() & (PCSAMPLE_TOP - PCSAMPLE_BASE - 2) & ~1u);
+    packet[len++] = 0x17;
+    memcpy(packet + len, &pc, 4);
+    len += 4;
+  }
+  return len;
+}
+
+static bool profile_setup(void)
+{
+  temp_path("microbench-pc.swo", swo_path, sizearray(swo_path));
+  if (!write_recording(swo_path, SWO_PACKETS, fill_pcsamples))
+    return false;
+  sample_map = samplemap_create(PCSAMPLE_BASE, PCSAMPLE_TOP);
+  return (sample_map != NULL);
+}
+
+static unsigned long profile_run(void)
+{
+  samplemap_clear(sample_map);
+  if (trace_replay(swo_path) != TRACESTAT_OK)
+    return 0;
+  unsigned long count = 0;
+  int result;
+  do {
+    unsigned overflow;
+    result = traceprofile_process(true, sample_map, &overflow);
+    count += result;
+  } while (trace_replay_active() || result > 0);
+  trace_close();
+  return count;
+}
+
+static void profile_cleanup(void)
+{
+  samplemap_delete(sample_map);
+  sample_map = NULL;
+  remove(swo_path);
+}
+
+
+/* ----- harness ----- */
+
+typedef struct tagBENCHMARK {
+  const char *name;
+  const char *unit;     /* what a single "op" is */
+  bool (*setup)(void);
+  unsigned long (*run)(void);   /* returns the number of ops */
+  void (*cleanup)(void);
+} BENCHMARK;
+
+static const BENCHMARK benchmarks[] = {
+  { "gdb_crc32",            "KiB",         crc_setup,     crc_run,     crc_cleanup },
+  { "hexcodec_encode",      "KiB",         hex_setup,     hexenc_run,  hex_cleanup },
+  { "hexcodec_decode",      "KiB",         hex_setup,     hexdec_run,  hex_cleanup },
+  { "disasm_buffer",        "instruction", disasm_setup,  disasm_run,  disasm_done },
+  { "tcl_eval",             "script",      tcl_setup,     tcl_run,     tcl_cleanup },
+  { "svd_load",             "file",        svd_setup,     svd_run,     svd_cleanup },
+  { "dwarf_read",           "file",        dwarf_setup,   dwarf_run,   dwarf_done },
+  { "ctf_decode",           "event",       ctf_setup,     ctf_run,     ctf_cleanup },
+  { "tracestring_process",  "line",        swotext_setup, swotext_run, swotext_cleanup },
+  { "traceprofile_process", "sample",      profile_setup, profile_run, profile_cleanup },
+};
+
+static void usage(const char *invalid_option)
+{
+  if (invalid_option != NULL)
+    fprintf(stderr, "Unknown option %s; use -h for help.\n\n", invalid_option);
+  else
+    printf("MicroBench measures the performance of the decoders and parsers in the\n"
+           "BlackMagic utilities.\n\n");
+  printf("Usage: microbench [options] [name ...]\n\n"
+         "Options:\n"
+         "-elf=path\tThe ELF file for the dwarf_read benchmark (this benchmark is\n"
+         "\t\tskipped if no file is given).\n"
+         "-svd=path\tAn SVD file to use instead of the synthetic one.\n"
+         "-swo=path\tA raw SWO recording (from bmtrace) to use instead of the\n"
+         "\t\tsynthetic one, for the tracestring_process benchmark.\n"
+         "-time=n\t\tThe minimum run time of each benchmark, in ms (default 500).\n\n"
+         "When names are given, only the benchmarks whose name contains one of these\n"
+         "strings are run. The results are printed on stdout, in JSON format.\n");
+}
+
+static const char *option_value(const char *arg, const char *name)
+{
+  size_t len = strlen(name);
+  if (strncmp(arg + 1, name, len) != 0)
+    return NULL;
+  arg += len + 1;
+  if (*arg == '=' || *arg == ':')
+    return arg + 1;
+  return (*arg == '\0') ? arg : NULL;
+}
+
+static bool name_selected(const char *name, int argc, char *argv[])
+{
+  bool filtered = false;
+  for (int idx = 1; idx < argc; idx++) {
+    if (IS_OPTION(argv[idx]))
+      continue;
+    filtered = true;
+    if (strstr(name, argv[idx]) != NULL)
+      return true;
+  }
+  return !filtered;
+}
+
+int main(int argc, char *argv[])
+{
+  unsigned long mintime = 500;
+
+  for (int idx = 1; idx < argc; idx++) {
+    const char *value;
+    if (!IS_OPTION(argv[idx]))
+      continue;   /* benchmark name */
+    if (strcmp(argv[idx] + 1, "h") == 0 || strcmp(argv[idx] + 1, "?") == 0) {
+      usage(NULL);
+      return EXIT_SUCCESS;
+    } else if ((value = option_value(argv[idx], "elf")) != NULL && *value != '\0') {
+      opt_elffile = value;
+    } else if ((value = option_value(argv[idx], "svd")) != NULL && *value != '\0') {
+      opt_svdfile = value;
+    } else if ((value = option_value(argv[idx], "swo")) != NULL && *value != '\0') {
+      opt_swofile = value;
+    } else if ((value = option_value(argv[idx], "time")) != NULL) {
+      mintime = strtoul(value, NULL, 10);
+      if (mintime < 1)
+        mintime = 1;
+    } else {
+      usage(argv[idx]);
+      return EXIT_FAILURE;
+    }
+  }
+
+  printf("{\n");
+  printf("  \"version\": \"%s\",\n", SVNREV_STR);
+  printf("  \"benchmarks\": {\n");
+  bool first = true;
+  for (unsigned idx = 0; idx < sizearray(benchmarks); idx++) {
+    const BENCHMARK *bench = &benchmarks[idx];
+    if (!name_selected(bench->name, argc, argv))
+      continue;
+    if (!first)
+      printf(",\n");
+    first = false;
+    random_state = 1;   /* same data for every run */
+    if (!bench->setup()) {
+      printf("    \"%s\": { \"skipped\": true }", bench->name);
+      bench->cleanup();
+      continue;
+    }
+    bench->run();       /* warm-up (caches, lazily built tables) */
+    unsigned long long ops = 0, rounds = 0, elapsed = 0, allocs = 0;
+    do {
+      unsigned long long tstamp = nanoseconds();
+      unsigned long long acount = ALLOC_COUNT();
+      ops += bench->run();
+      allocs += ALLOC_COUNT() - acount;
+      elapsed += nanoseconds() - tstamp;
+      rounds += 1;
+    } while (elapsed < mintime * 1000000ull);
+    bench->cleanup();
+    if (ops == 0)
+      ops = 1;
+    printf("    \"%s\": { \"unit\": \"%s\", \"rounds\": %llu, \"ops\": %llu, \"ns_per_op\": %.1f, ",
+           bench->name, bench->unit, rounds, ops, (double)elapsed / ops);
+#   if defined BENCH_WRAPMALLOC
+      printf("\"allocs_per_op\": %.3f }", (double)allocs / ops);
+#   else
+      (void)allocs;
+      printf("\"allocs_per_op\": -1 }");
+#   endif
+  }
+  printf("\n  }\n");
+  printf("}\n");
+
+  return EXIT_SUCCESS;
+}
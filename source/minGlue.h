@@ -11,19 +11,64 @@
 /* map required file I/O types and functions to the standard C library */
 #include <stdio.h>
 
-#define INI_FILETYPE                    FILE*
-#define ini_openread(filename,file)     ((*(file) = fopen((filename),"rb")) != NULL)
-#define ini_openwrite(filename,file)    ((*(file) = fopen((filename),"wb")) != NULL)
-#define ini_openrewrite(filename,file)  ((*(file) = fopen((filename),"r+b")) != NULL)
-#define ini_close(file)                 (fclose(*(file)) == 0)
-#define ini_read(buffer,size,file)      (fgets((buffer),(size),*(file)) != NULL)
-#define ini_write(buffer,file)          (fputs((buffer),*(file)) >= 0)
-#define ini_rename(source,dest)         (rename((source), (dest)) == 0)
-#define ini_remove(filename)            (remove(filename) == 0)
-
-#define INI_FILEPOS                     long int
-#define ini_tell(file,pos)              (*(pos) = ftell(*(file)))
-#define ini_seek(file,pos)              (fseek(*(file), *(pos), SEEK_SET) == 0)
+/* In cached mode, an INI file that is registered with ini_cache_open() is read
+ * into memory once; all reads and writes on that file are then handled in
+ * memory, and the file is written back by ini_cache_flush() or
+ * ini_cache_close() (or on exit). Other INI files are accessed directly.
+ */
+#define INI_CACHED
+
+#if defined INI_CACHED
+  typedef struct tagINI_FILE {
+    FILE *fp;                     /* file handle, for a file that is not cached */
+    struct tagINI_MEMFILE *mem;   /* contents, for a cached file */
+    long pos;                     /* read/write position in the cached file */
+    int temp;                     /* whether this is the temporary file of the cached file */
+  } INI_FILE;
+
+  int  ini_file_openread(const char *filename, INI_FILE *file);
+  int  ini_file_openwrite(const char *filename, INI_FILE *file);
+  int  ini_file_openrewrite(const char *filename, INI_FILE *file);
+  int  ini_file_close(INI_FILE *file);
+  int  ini_file_read(char *buffer, int size, INI_FILE *file);
+  int  ini_file_write(const char *buffer, INI_FILE *file);
+  int  ini_file_rename(const char *source, const char *dest);
+  int  ini_file_remove(const char *filename);
+  long ini_file_tell(const INI_FILE *file);
+  int  ini_file_seek(INI_FILE *file, long pos);
+
+  int  ini_cache_open(const char *filename);
+  int  ini_cache_flush(const char *filename);
+  int  ini_cache_close(const char *filename);
+
+  #define INI_FILETYPE                    INI_FILE
+  #define ini_openread(filename,file)     ini_file_openread((filename),(file))
+  #define ini_openwrite(filename,file)    ini_file_openwrite((filename),(file))
+  #define ini_openrewrite(filename,file)  ini_file_openrewrite((filename),(file))
+  #define ini_close(file)                 ini_file_close(file)
+  #define ini_read(buffer,size,file)      ini_file_read((buffer),(size),(file))
+  #define ini_write(buffer,file)          ini_file_write((buffer),(file))
+  #define ini_rename(source,dest)         ini_file_rename((source),(dest))
+  #define ini_remove(filename)            ini_file_remove(filename)
+
+  #define INI_FILEPOS                     long int
+  #define ini_tell(file,pos)              (*(pos) = ini_file_tell(file))
+  #define ini_seek(file,pos)              ini_file_seek((file),*(pos))
+#else
+  #define INI_FILETYPE                    FILE*
+  #define ini_openread(filename,file)     ((*(file) = fopen((filename),"rb")) != NULL)
+  #define ini_openwrite(filename,file)    ((*(file) = fopen((filename),"wb")) != NULL)
+  #define ini_openrewrite(filename,file)  ((*(file) = fopen((filename),"r+b")) != NULL)
+  #define ini_close(file)                 (fclose(*(file)) == 0)
+  #define ini_read(buffer,size,file)      (fgets((buffer),(size),*(file)) != NULL)
+  #define ini_write(buffer,file)          (fputs((buffer),*(file)) >= 0)
+  #define ini_rename(source,dest)         (rename((source), (dest)) == 0)
+  #define ini_remove(filename)            (remove(filename) == 0)
+
+  #define INI_FILEPOS                     long int
+  #define ini_tell(file,pos)              (*(pos) = ftell(*(file)))
+  #define ini_seek(file,pos)              (fseek(*(file), *(pos), SEEK_SET) == 0)
+#endif
 
 /* for floating-point support, define additional types and functions */
 #define INI_REAL                        float
@@ -950,3 +950,412 @@ int ini_putf(const TCHAR *Section, const TCHAR *Key, INI_REAL Value, const TCHAR
 }
 #endif /* INI_REAL */
 #endif /* !INI_READONLY */
+
+#if defined INI_CACHED
+/* Cached INI files: the contents of a registered file are kept in memory and
+ * all reads and writes operate on that copy. The temporary file that
+ * ini_puts() creates (the filename with the last character replaced by '~')
+ * is kept in memory as well, so that rewriting a setting does not touch the
+ * disk. The file is written back only when it is flushed.
+ */
+typedef struct tagINI_MEMFILE {
+  struct tagINI_MEMFILE *next;
+  char *name;           /* full path of the INI file */
+  char *tempname;       /* name of the temporary file for rewrites */
+  char *data;           /* contents of the INI file (not zero-terminated) */
+  long size;
+  long maxsize;
+  char *tempdata;       /* contents of the temporary file */
+  long tempsize;
+  long tempmax;
+  int exists;           /* whether the INI file exists (in memory) */
+  int tempexists;       /* whether the temporary file exists (in memory) */
+  int dirty;            /* whether the memory copy differs from the disk copy */
+} INI_MEMFILE;
+
+static INI_MEMFILE *ini_cache_root = NULL;
+static int ini_cache_registered = 0;
+
+static INI_MEMFILE *memfile_find(const char *filename, int *istemp)
+{
+  INI_MEMFILE *mem;
+  assert(filename != NULL);
+  for (mem = ini_cache_root; mem != NULL; mem = mem->next) {
+    if (strcmp(mem->name, filename) == 0) {
+      if (istemp != NULL)
+        *istemp = 0;
+      return mem;
+    }
+    if (strcmp(mem->tempname, filename) == 0) {
+      if (istemp != NULL)
+        *istemp = 1;
+      return mem;
+    }
+  }
+  return NULL;
+}
+
+static int memfile_open(const char *filename, INI_FILE *file, int truncate)
+{
+  int istemp;
+  INI_MEMFILE *mem = memfile_find(filename, &istemp);
+  if (mem == NULL)
+    return -1;  /* not cached */
+  if (istemp) {
+    if (!mem->tempexists && !truncate)
+      return 0;
+    mem->tempexists = 1;
+    if (truncate)
+      mem->tempsize = 0;
+  } else {
+    if (!mem->exists && !truncate)
+      return 0;
+    if (truncate) {
+      mem->exists = 1;
+      mem->size = 0;
+      mem->dirty = 1;
+    }
+  }
+  file->fp = NULL;
+  file->mem = mem;
+  file->pos = 0;
+  file->temp = istemp;
+  return 1;
+}
+
+int ini_file_openread(const char *filename, INI_FILE *file)
+{
+  int result = memfile_open(filename, file, 0);
+  if (result >= 0)
+    return result;
+  file->mem = NULL;
+  file->fp = fopen(filename, "rb");
+  return file->fp != NULL;
+}
+
+int ini_file_openwrite(const char *filename, INI_FILE *file)
+{
+  int result = memfile_open(filename, file, 1);
+  if (result >= 0)
+    return result;
+  file->mem = NULL;
+  file->fp = fopen(filename, "wb");
+  return file->fp != NULL;
+}
+
+int ini_file_openrewrite(const char *filename, INI_FILE *file)
+{
+  int result = memfile_open(filename, file, 0);
+  if (result >= 0)
+    return result;
+  file->mem = NULL;
+  file->fp = fopen(filename, "r+b");
+  return file->fp != NULL;
+}
+
+int ini_file_close(INI_FILE *file)
+{
+  assert(file != NULL);
+  if (file->mem != NULL) {
+    file->mem = NULL;
+    return 1;
+  }
+  return fclose(file->fp) == 0;
+}
+
+int ini_file_read(char *buffer, int size, INI_FILE *file)
+{
+  const char *data;
+  long length;
+  int count;
+
+  assert(file != NULL);
+  if (file->mem == NULL)
+    return fgets(buffer, size, file->fp) != NULL;
+
+  /* same semantics as fgets(): read up to and including the newline */
+  data = file->temp ? file->mem->tempdata : file->mem->data;
+  length = file->temp ? file->mem->tempsize : file->mem->size;
+  if (size <= 0 || file->pos >= length)
+    return 0;
+  for (count = 0; count < size - 1 && file->pos < length; ) {
+    char c = data[file->pos++];
+    buffer[count++] = c;
+    if (c == '\n')
+      break;
+  }
+  buffer[count] = '\0';
+  return 1;
+}
+
+int ini_file_write(const char *buffer, INI_FILE *file)
+{
+  char **data;
+  long *length, *maxsize;
+  long count;
+
+  assert(file != NULL);
+  assert(buffer != NULL);
+  if (file->mem == NULL)
+    return fputs(buffer, file->fp) >= 0;
+
+  if (file->temp) {
+    data = &file->mem->tempdata;
+    length = &file->mem->tempsize;
+    maxsize = &file->mem->tempmax;
+  } else {
+    data = &file->mem->data;
+    length = &file->mem->size;
+    maxsize = &file->mem->maxsize;
+    file->mem->dirty = 1;
+  }
+  count = (long)strlen(buffer);
+  if (file->pos + count > *maxsize) {
+    long newsize = (*maxsize > 0) ? *maxsize : 256;
+    char *newdata;
+    while (file->pos + count > newsize)
+      newsize *= 2;
+    newdata = realloc(*data, newsize);
+    if (newdata == NULL)
+      return 0;
+    *data = newdata;
+    *maxsize = newsize;
+  }
+  memcpy(*data + file->pos, buffer, count);
+  file->pos += count;
+  if (file->pos > *length)
+    *length = file->pos;
+  return 1;
+}
+
+int ini_file_rename(const char *source, const char *dest)
+{
+  int istemp;
+  INI_MEMFILE *mem = memfile_find(dest, &istemp);
+  if (mem != NULL && !istemp && strcmp(mem->tempname, source) == 0) {
+    /* swap the buffers, so that the old buffer can be re-used for the next
+       rewrite */
+    char *data = mem->data;
+    long maxsize = mem->maxsize;
+    if (!mem->tempexists)
+      return 0;
+    mem->data = mem->tempdata;
+    mem->size = mem->tempsize;
+    mem->maxsize = mem->tempmax;
+    mem->tempdata = data;
+    mem->tempsize = 0;
+    mem->tempmax = maxsize;
+    mem->tempexists = 0;
+    mem->exists = 1;
+    mem->dirty = 1;
+    return 1;
+  }
+  return rename(source, dest) == 0;
+}
+
+int ini_file_remove(const char *filename)
+{
+  int istemp;
+  INI_MEMFILE *mem = memfile_find(filename, &istemp);
+  if (mem == NULL)
+    return remove(filename) == 0;
+  if (istemp) {
+    if (!mem->tempexists)
+      return 0;
+    mem->tempexists = 0;
+    mem->tempsize = 0;
+  } else {
+    if (!mem->exists)
+      return 0;
+    mem->exists = 0;
+    mem->size = 0;
+    mem->dirty = 1;
+  }
+  return 1;
+}
+
+long ini_file_tell(const INI_FILE *file)
+{
+  assert(file != NULL);
+  if (file->mem != NULL)
+    return file->pos;
+  return ftell(file->fp);
+}
+
+int ini_file_seek(INI_FILE *file, long pos)
+{
+  assert(file != NULL);
+  if (file->mem != NULL) {
+    long length = file->temp ? file->mem->tempsize : file->mem->size;
+    if (pos < 0 || pos > length)
+      return 0;
+    file->pos = pos;
+    return 1;
+  }
+  return fseek(file->fp, pos, SEEK_SET) == 0;
+}
+
+static int memfile_flush(INI_MEMFILE *mem)
+{
+  FILE *fp;
+  int result;
+
+  assert(mem != NULL);
+  if (!mem->dirty)
+    return 1;
+  if (!mem->exists) {
+    remove(mem->name);
+    mem->dirty = 0;
+    return 1;
+  }
+  /* write to the temporary file first, then replace the original in one go,
+     so that an interrupted write does not leave a truncated INI file */
+  fp = fopen(mem->tempname, "wb");
+  if (fp == NULL)
+    return 0;
+  result = (mem->size == 0 || fwrite(mem->data, 1, mem->size, fp) == (size_t)mem->size);
+  if (fclose(fp) != 0)
+    result = 0;
+  if (!result) {
+    remove(mem->tempname);
+    return 0;
+  }
+  if (rename(mem->tempname, mem->name) != 0) {
+    /* on Windows, rename() fails if the destination exists */
+    remove(mem->name);
+    if (rename(mem->tempname, mem->name) != 0)
+      return 0;
+  }
+  mem->dirty = 0;
+  return 1;
+}
+
+static void memfile_free(INI_MEMFILE *mem)
+{
+  assert(mem != NULL);
+  free(mem->name);
+  free(mem->tempname);
+  free(mem->data);
+  free(mem->tempdata);
+  free(mem);
+}
+
+static void ini_cache_atexit(void)
+{
+  INI_MEMFILE *mem;
+  while (ini_cache_root != NULL) {
+    mem = ini_cache_root;
+    ini_cache_root = mem->next;
+    (void)memfile_flush(mem);
+    memfile_free(mem);
+  }
+}
+
+/** ini_cache_open()
+ * Reads the INI file into memory, after which all reads and writes on the file
+ * are handled from the memory copy. Changes are written back to disk by
+ * ini_cache_flush() or ini_cache_close(), or when the program exits.
+ * \param Filename    the name and full path of the .ini file; the file need not
+ *                    exist yet
+ *
+ * \return            1 if successful, otherwise 0
+ */
+int ini_cache_open(const char *Filename)
+{
+  INI_MEMFILE *mem;
+  FILE *fp;
+  size_t len;
+
+  assert(Filename != NULL);
+  if (memfile_find(Filename, NULL) != NULL)
+    return 1;   /* already cached */
+  if ((len = strlen(Filename)) == 0)
+    return 0;
+
+  mem = calloc(1, sizeof(INI_MEMFILE));
+  if (mem == NULL)
+    return 0;
+  mem->name = strdup(Filename);
+  mem->tempname = malloc((len + 1) * sizeof(char));
+  if (mem->name == NULL || mem->tempname == NULL) {
+    memfile_free(mem);
+    return 0;
+  }
+  ini_tempname(mem->tempname, Filename, (int)(len + 1));
+
+  fp = fopen(Filename, "rb");
+  if (fp != NULL) {
+    mem->exists = 1;
+    for ( ;; ) {
+      size_t count;
+      if (mem->size == mem->maxsize) {
+        long newsize = (mem->maxsize > 0) ? 2 * mem->maxsize : 4096;
+        char *newdata = realloc(mem->data, newsize);
+        if (newdata == NULL) {
+          fclose(fp);
+          memfile_free(mem);
+          return 0;
+        }
+        mem->data = newdata;
+        mem->maxsize = newsize;
+      }
+      count = fread(mem->data + mem->size, 1, mem->maxsize - mem->size, fp);
+      if (count == 0)
+        break;
+      mem->size += (long)count;
+    }
+    fclose(fp);
+  }
+
+  mem->next = ini_cache_root;
+  ini_cache_root = mem;
+  if (!ini_cache_registered) {
+    atexit(ini_cache_atexit);
+    ini_cache_registered = 1;
+  }
+  return 1;
+}
+
+/** ini_cache_flush()
+ * Writes the memory copy of a cached INI file back to disk, if it was modified.
+ * \param Filename    the name and full path of the .ini file
+ *
+ * \return            1 if successful (or if there was nothing to write),
+ *                    otherwise 0
+ */
+int ini_cache_flush(const char *Filename)
+{
+  int istemp;
+  INI_MEMFILE *mem = memfile_find(Filename, &istemp);
+  if (mem == NULL || istemp)
+    return 1;
+  return memfile_flush(mem);
+}
+
+/** ini_cache_close()
+ * Writes the memory copy of a cached INI file back to disk (if it was
+ * modified) and drops the file from the cache. Subsequent access to the file
+ * goes to disk directly.
+ * \param Filename    the name and full path of the .ini file
+ *
+ * \return            1 if successful, otherwise 0
+ */
+int ini_cache_close(const char *Filename)
+{
+  INI_MEMFILE *mem, *prev;
+  int result;
+
+  assert(Filename != NULL);
+  for (prev = NULL, mem = ini_cache_root; mem != NULL && strcmp(mem->name, Filename) != 0; prev = mem, mem = mem->next)
+    /* nothing */;
+  if (mem == NULL)
+    return 1;
+  result = memfile_flush(mem);
+  if (prev != NULL)
+    prev->next = mem->next;
+  else
+    ini_cache_root = mem->next;
+  memfile_free(mem);
+  return result;
+}
+#endif /* INI_CACHED */
@@ -3,6 +3,7 @@
 #define NK_INCLUDE_STANDARD_VARARGS
 #define NK_INCLUDE_DEFAULT_ALLOCATOR
 #define NK_INCLUDE_STRING
+#define NK_ZERO_COMMAND_MEMORY      // for comparing frames, see guidriver_render()
 
 #if defined _WIN32
   #define NK_SIN
@@ -12,6 +13,7 @@
 #if defined __linux__ || defined __FreeBSD__ || defined __APPLE__
   #define NK_INCLUDE_STANDARD_IO
   #define NK_INCLUDE_VERTEX_BUFFER_OUTPUT
+  #define NK_UINT_DRAW_INDEX        // busy views may exceed 65536 vertices
   #define NK_INCLUDE_FONT_BAKING
   #define NK_KEYSTATE_BASED_INPUT
 #endif
@@ -8,6 +8,7 @@
 
 #include <stdlib.h>
 #include <malloc.h>
+#include <math.h>
 #include "nuklear.h"
 #include "nuklear_gdip.h"
 
@@ -346,11 +347,26 @@ GdipSetTextRenderingHint(GpGraphics *graphics, TextRenderingHint mode);
 #endif
 LWSTDAPI_(IStream *) SHCreateMemStream(const BYTE *pInit, UINT cbInit);
 
+/* GdipMeasureString() is slow, so the widths of measured strings are kept in
+   a small hash table per font (direct-mapped, a new string overwrites the
+   entry with the same hash slot) */
+#define GDIP_WIDTHCACHE 512
+
+typedef struct GdipTextWidth
+{
+    unsigned long long hash;
+    int len;
+    float width;
+} GdipTextWidth;
+
 struct GdipFont
 {
     struct nk_user_font nk;
     GpFont* handle;
     int voffset;    /* vertical offset in pixels, for improved alignment */
+    float advance;  /* character width for fixed-pitch fonts (for ASCII text),
+                       -1 for proportional fonts, 0 if not yet determined */
+    GdipTextWidth cache[GDIP_WIDTHCACHE];
 };
 
 static struct {
@@ -708,18 +724,16 @@ nk_gdipfont_create_from_file(const WCHAR* filename, float size, int style)
 }
 
 static float
-nk_gdipfont_get_text_width(nk_handle handle, float height, const char *text, int len)
+nk_gdipfont_measure(GdipFont *font, const char *text, int len)
 {
-    GdipFont *font = (GdipFont *)handle.ptr;
     RectF layout = { 0.0f, 0.0f, 65536.0f, 65536.0f };
     RectF bbox;
     int wsize;
     WCHAR* wstr;
-    if (!font || !text)
-        return 0;
 
-    (void)height;
     wsize = MultiByteToWideChar(CP_UTF8, 0, text, len, NULL, 0);
+    if (wsize <= 0)
+        return 0;
     wstr = (WCHAR*)_alloca(wsize * sizeof(wchar_t));
     MultiByteToWideChar(CP_UTF8, 0, text, len, wstr, wsize);
 
@@ -727,6 +741,55 @@ nk_gdipfont_get_text_width(nk_handle handle, float height, const char *text, int
     return bbox.Width;
 }
 
+/* nk_gdipfont_check_pitch() checks whether the font is fixed-pitch (for the
+   ASCII range), in which case the width of a string is simply its length
+   times the character width */
+static void
+nk_gdipfont_check_pitch(GdipFont *font)
+{
+    float w_narrow = nk_gdipfont_measure(font, "iiiiiiiiii", 10);
+    float w_wide = nk_gdipfont_measure(font, "WWWWWWWWWW", 10);
+    float w_space = nk_gdipfont_measure(font, "          ", 10);
+    float w_single = nk_gdipfont_measure(font, "W", 1);
+    font->advance = -1;
+    if (w_wide > 0 && fabsf(w_narrow - w_wide) < 0.01f && fabsf(w_space - w_wide) < 0.01f
+        && fabsf(10 * w_single - w_wide) < 0.05f)
+        font->advance = w_wide / 10;
+}
+
+static float
+nk_gdipfont_get_text_width(nk_handle handle, float height, const char *text, int len)
+{
+    GdipFont *font = (GdipFont *)handle.ptr;
+    GdipTextWidth *entry;
+    unsigned long long hash;
+    int i;
+    if (!font || !text || len <= 0)
+        return 0;
+
+    (void)height;
+    if (font->advance == 0)
+        nk_gdipfont_check_pitch(font);
+    if (font->advance > 0) {
+        for (i = 0; i < len && (unsigned char)text[i] >= ' ' && (unsigned char)text[i] < 0x7f; i++)
+            {}
+        if (i == len)
+            return len * font->advance;
+    }
+
+    /* FNV-1a hash on the string, look up the width in the cache */
+    hash = 14695981039346656037ull;
+    for (i = 0; i < len; i++)
+        hash = (hash ^ (unsigned char)text[i]) * 1099511628211ull;
+    entry = &font->cache[hash % GDIP_WIDTHCACHE];
+    if (entry->hash != hash || entry->len != len) {
+        entry->hash = hash;
+        entry->len = len;
+        entry->width = nk_gdipfont_measure(font, text, len);
+    }
+    return entry->width;
+}
+
 void
 nk_gdipfont_del(GdipFont *font)
 {
@@ -31,6 +31,8 @@
 
 struct nk_glfw_device {
     struct nk_buffer cmds;
+    struct nk_buffer vbuf;  /* vertex & element buffers are kept across frames, */
+    struct nk_buffer ebuf;  /* so that their memory is re-used */
     struct nk_draw_null_texture tex_null;
     GLuint font_tex;
 };
@@ -69,6 +71,25 @@ nk_glfw3_device_upload_atlas(const void *image, int width, int height)
                 GL_RGBA, GL_UNSIGNED_BYTE, image);
 }
 
+NK_INTERN void
+nk_glfw3_draw_batch(int tex, struct nk_rect clip, int *bound_tex, struct nk_rect *bound_clip,
+                    const nk_draw_index *offset, unsigned int count, GLenum index_type)
+{
+    if (tex != *bound_tex) {
+        glBindTexture(GL_TEXTURE_2D, (GLuint)tex);
+        *bound_tex = tex;
+    }
+    if (memcmp(&clip, bound_clip, sizeof clip) != 0) {
+        glScissor(
+            (GLint)(clip.x * glfw.fb_scale.x),
+            (GLint)((glfw.height - (GLint)(clip.y + clip.h)) * glfw.fb_scale.y),
+            (GLint)(clip.w * glfw.fb_scale.x),
+            (GLint)(clip.h * glfw.fb_scale.y));
+        *bound_clip = clip;
+    }
+    glDrawElements(GL_TRIANGLES, (GLsizei)count, index_type, offset);
+}
+
 NK_API void
 nk_glfw3_render(enum nk_anti_aliasing AA)
 {
@@ -104,7 +125,7 @@ nk_glfw3_render(enum nk_anti_aliasing AA)
         /* convert from command queue into draw list and draw to screen */
         const struct nk_draw_command *cmd;
         const nk_draw_index *offset = NULL;
-        struct nk_buffer vbuf, ebuf;
+        const GLenum index_type = (sizeof(nk_draw_index) == 4) ? GL_UNSIGNED_INT : GL_UNSIGNED_SHORT;
 
         /* fill convert configuration */
         struct nk_convert_config config;
@@ -126,34 +147,55 @@ nk_glfw3_render(enum nk_anti_aliasing AA)
         config.shape_AA = AA;
         config.line_AA = AA;
 
-        /* convert shapes into vertexes */
-        nk_buffer_init_default(&vbuf);
-        nk_buffer_init_default(&ebuf);
-        nk_convert(&glfw.ctx, &dev->cmds, &vbuf, &ebuf, &config);
+        /* convert shapes into vertexes (the buffers are cleared, but their
+           memory is kept from the previous frame) */
+        nk_buffer_clear(&dev->vbuf);
+        nk_buffer_clear(&dev->ebuf);
+        nk_convert(&glfw.ctx, &dev->cmds, &dev->vbuf, &dev->ebuf, &config);
 
         /* setup vertex buffer pointer */
-        {const void *vertices = nk_buffer_memory_const(&vbuf);
+        {const void *vertices = nk_buffer_memory_const(&dev->vbuf);
         glVertexPointer(2, GL_FLOAT, vs, (const void*)((const nk_byte*)vertices + vp));
         glTexCoordPointer(2, GL_FLOAT, vs, (const void*)((const nk_byte*)vertices + vt));
         glColorPointer(4, GL_UNSIGNED_BYTE, vs, (const void*)((const nk_byte*)vertices + vc));}
 
-        /* iterate over and execute each draw command */
-        offset = (const nk_draw_index*)nk_buffer_memory_const(&ebuf);
-        nk_draw_foreach(cmd, &glfw.ctx, &dev->cmds)
+        /* iterate over and execute each draw command; consecutive commands
+           with the same texture and clipping rectangle are merged into a
+           single draw call (their elements are adjacent in the buffer), and
+           the texture and scissor are only set when they change */
+        offset = (const nk_draw_index*)nk_buffer_memory_const(&dev->ebuf);
         {
-            if (!cmd->elem_count) continue;
-            glBindTexture(GL_TEXTURE_2D, (GLuint)cmd->texture.id);
-            glScissor(
-                (GLint)(cmd->clip_rect.x * glfw.fb_scale.x),
-                (GLint)((glfw.height - (GLint)(cmd->clip_rect.y + cmd->clip_rect.h)) * glfw.fb_scale.y),
-                (GLint)(cmd->clip_rect.w * glfw.fb_scale.x),
-                (GLint)(cmd->clip_rect.h * glfw.fb_scale.y));
-            glDrawElements(GL_TRIANGLES, (GLsizei)cmd->elem_count, GL_UNSIGNED_SHORT, offset);
-            offset += cmd->elem_count;
+            const nk_draw_index *batch_offset = offset;
+            unsigned int batch_count = 0;
+            int batch_tex = 0;
+            struct nk_rect batch_clip = {0, 0, 0, 0};
+            int bound_tex = -1;
+            struct nk_rect bound_clip = {-1, -1, -1, -1};
+            nk_draw_foreach(cmd, &glfw.ctx, &dev->cmds)
+            {
+                if (!cmd->elem_count) continue;
+                if (batch_count > 0 && cmd->texture.id == batch_tex
+                    && memcmp(&cmd->clip_rect, &batch_clip, sizeof batch_clip) == 0) {
+                    batch_count += cmd->elem_count;
+                    offset += cmd->elem_count;
+                    continue;
+                }
+                if (batch_count > 0) {
+                    nk_glfw3_draw_batch(batch_tex, batch_clip, &bound_tex, &bound_clip,
+                                        batch_offset, batch_count, index_type);
+                }
+                batch_offset = offset;
+                batch_count = cmd->elem_count;
+                batch_tex = cmd->texture.id;
+                batch_clip = cmd->clip_rect;
+                offset += cmd->elem_count;
+            }
+            if (batch_count > 0) {
+                nk_glfw3_draw_batch(batch_tex, batch_clip, &bound_tex, &bound_clip,
+                                    batch_offset, batch_count, index_type);
+            }
         }
         nk_clear(&glfw.ctx);
-        nk_buffer_free(&vbuf);
-        nk_buffer_free(&ebuf);
     }
 
     /* default OpenGL state */
@@ -243,6 +285,8 @@ nk_glfw3_init(GLFWwindow *win, enum nk_glfw_init_state init_state)
     glfw.ctx.clip.paste = nk_glfw3_clipboard_paste;
     glfw.ctx.clip.userdata = nk_handle_ptr(0);
     nk_buffer_init_default(&glfw.ogl.cmds);
+    nk_buffer_init_default(&glfw.ogl.vbuf);
+    nk_buffer_init_default(&glfw.ogl.ebuf);
 
     glfw.is_double_click_down = nk_false;
     glfw.double_click_pos = nk_vec2(0, 0);
@@ -404,6 +448,8 @@ void nk_glfw3_shutdown(void)
     nk_free(&glfw.ctx);
     glDeleteTextures(1, &dev->font_tex);
     nk_buffer_free(&dev->cmds);
+    nk_buffer_free(&dev->vbuf);
+    nk_buffer_free(&dev->ebuf);
     memset(&glfw, 0, sizeof(glfw));
 }
 
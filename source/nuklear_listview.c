@@ -0,0 +1,114 @@
+/*
+ * Virtualized list view for the Nuklear GUI: only the rows that are in view
+ * are laid out and drawn, the others are replaced by spacers. The frame time
+ * therefore does not depend on the number of rows in the list.
+ *
+ * Copyright 2026 CompuPhase
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <assert.h>
+#include <stdlib.h>
+#include "nuklear_listview.h"
+
+/** nk_listview_pitch() returns the vertical distance between the tops of two
+ *  consecutive rows.
+ *
+ *  \param ctx        The Nuklear context.
+ *  \param rowheight  The height of a row (without spacing).
+ *
+ *  \return The row height plus the vertical spacing between rows.
+ */
+float nk_listview_pitch(struct nk_context *ctx, float rowheight)
+{
+  assert(ctx != NULL);
+  return rowheight + ctx->style.window.spacing.y;
+}
+
+/** nk_listview_range() calculates the range of rows that is (or may be) in
+ *  view. A margin of one row is included at each end.
+ *
+ *  \param ctx        The Nuklear context.
+ *  \param viewheight The height of the list (the group) in pixels.
+ *  \param yscroll    The vertical scroll position of the group.
+ *  \param rowheight  The height of a row (without spacing).
+ *  \param rowcount   The total number of rows in the list.
+ *  \param first      [out] Set to the first row to draw.
+ *  \param last       [out] Set to one beyond the last row to draw.
+ */
+void nk_listview_range(struct nk_context *ctx, float viewheight, nk_uint yscroll,
+                       float rowheight, int rowcount, int *first, int *last)
+{
+  float pitch = nk_listview_pitch(ctx, rowheight);
+  int visible, top;
+
+  assert(first != NULL && last != NULL);
+  assert(pitch > 0.1);
+  visible = (int)(viewheight / pitch) + 2;
+  top = (int)(yscroll / pitch) - 1;
+  if (top > rowcount - visible)
+    top = rowcount - visible;   /* when the list shrinks, keep the tail in view */
+  if (top < 0)
+    top = 0;
+  *first = top;
+  *last = (top + visible < rowcount) ? top + visible : rowcount;
+}
+
+/** nk_listview_spacer() adds a single empty row that takes the space of a
+ *  number of rows (that are not drawn, because they are out of view).
+ *
+ *  \param ctx        The Nuklear context.
+ *  \param rowheight  The height of a row (without spacing).
+ *  \param count      The number of rows to skip; if zero, nothing is added.
+ */
+void nk_listview_spacer(struct nk_context *ctx, float rowheight, int count)
+{
+  if (count > 0) {
+    nk_layout_row_dynamic(ctx, count * nk_listview_pitch(ctx, rowheight) - ctx->style.window.spacing.y, 1);
+    nk_spacing(ctx, 1);
+  }
+}
+
+/** nk_listview_rows() lays out the rows of a list inside a group, calling a
+ *  function to draw each row that is in view. The rows above and below the
+ *  view are replaced by spacers, so that the scroll bar stays correct. This
+ *  function must be called between nk_group_begin() and nk_group_end().
+ *
+ *  \param ctx        The Nuklear context.
+ *  \param viewheight The height of the list (the group) in pixels.
+ *  \param yscroll    The vertical scroll position of the group, see
+ *                    nk_group_get_scroll().
+ *  \param rowheight  The height of a row (without spacing); all rows have the
+ *                    same height.
+ *  \param rowcount   The total number of rows in the list.
+ *  \param drawrow    The function that lays out and draws a row; it must add
+ *                    exactly one layout row of height "rowheight".
+ *  \param userdata   A parameter that is passed to "drawrow" unmodified.
+ *
+ *  \return The index of the first row that was drawn.
+ */
+int nk_listview_rows(struct nk_context *ctx, float viewheight, nk_uint yscroll,
+                     float rowheight, int rowcount,
+                     NK_LISTVIEW_ROW drawrow, void *userdata)
+{
+  int first, last, row;
+
+  assert(ctx != NULL);
+  assert(drawrow != NULL);
+  nk_listview_range(ctx, viewheight, yscroll, rowheight, rowcount, &first, &last);
+  nk_listview_spacer(ctx, rowheight, first);
+  for (row = first; row < last; row++)
+    drawrow(ctx, row, userdata);
+  nk_listview_spacer(ctx, rowheight, rowcount - last);
+  return first;
+}
@@ -0,0 +1,37 @@
+/*
+ * Virtualized list view for the Nuklear GUI: only the rows that are in view
+ * are laid out and drawn, the others are replaced by spacers.
+ *
+ * Copyright 2026 CompuPhase
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef _NK_LISTVIEW_H
+#define _NK_LISTVIEW_H
+
+#include "nuklear.h"
+
+/* callback to lay out and draw a single row, with the row height that was
+   passed to nk_listview_rows() */
+typedef void (*NK_LISTVIEW_ROW)(struct nk_context *ctx, int row, void *userdata);
+
+float nk_listview_pitch(struct nk_context *ctx, float rowheight);
+void  nk_listview_range(struct nk_context *ctx, float viewheight, nk_uint yscroll,
+                        float rowheight, int rowcount, int *first, int *last);
+void  nk_listview_spacer(struct nk_context *ctx, float rowheight, int count);
+int   nk_listview_rows(struct nk_context *ctx, float viewheight, nk_uint yscroll,
+                       float rowheight, int rowcount,
+                       NK_LISTVIEW_ROW drawrow, void *userdata);
+
+#endif /* _NK_LISTVIEW_H */
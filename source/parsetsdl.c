@@ -41,6 +41,7 @@
 # endif
 #endif
 
+#include "c11threads.h"
 #include "parsetsdl.h"
 
 #if defined __linux__ || defined __FreeBSD__ || defined __APPLE__
@@ -113,21 +114,51 @@ typedef struct tagINCLUDEFILE {
 } INCLUDEFILE;
 #define INCLUDE_NESTING 8
 
-static FILE *inputfile = NULL;
-static INCLUDEFILE includestack[INCLUDE_NESTING] = { NULL };
-static char *linebuffer = NULL;
-static int linebuffer_index = 0;
-static int linenumber = 0;
-static int comment_block_start = 0;
-static int error_count = 0;
-static CTF_TYPE type_root = { NULL };
-static TOKEN recent_token = { TOK_NONE, NULL, 0, 0.0 };
+/* all state of a parsed TSDL file (plus the state of the parser); a thread
+   works on the default model, unless it has selected one of its own */
+struct tagCTF_MODEL {
+  TOKEN recent_token;
+  int recent_error;
+  FILE *inputfile;
+  INCLUDEFILE includestack[INCLUDE_NESTING];
+  char **include_names;   /* all files included (for the cache) */
+  int include_count;
+  char *linebuffer;
+  int linebuffer_index;
+  int linenumber;
+  int comment_block_start;
+  int error_count;
+  CTF_TYPE type_root;
+
+  CTF_TRACE_GLOBAL ctf_trace;
+  CTF_PACKET_HEADER ctf_packet;
+  CTF_CLOCK ctf_clock_root;
+  CTF_STREAM ctf_stream_root;
+  CTF_EVENT ctf_event_root;
+
+  /* look-up tables, built after parsing the TSDL file (the "valid" flags are
+     false while parsing, or when the id's are too sparse to index) */
+  const CTF_EVENT **event_index;    /* events by id */
+  int event_indexsize;
+  int event_indexvalid;
+  int event_total;
+  const CTF_STREAM **stream_index;  /* streams by id */
+  int stream_indexsize;
+  int stream_indexvalid;
+  int stream_total;
+  const CTF_CLOCK **clock_index;    /* clocks by sequence number */
+  int clock_total;
+  int clock_indexvalid;
+};
+#define INDEX_MAXID 0xffff
+
+static CTF_MODEL default_model = { { TOK_NONE, NULL, 0, 0.0 }, -1 };
+static thread_local CTF_MODEL *current_model = NULL;
 
-static CTF_TRACE_GLOBAL ctf_trace;
-static CTF_PACKET_HEADER ctf_packet;
-static CTF_CLOCK ctf_clock_root = { NULL };
-static CTF_STREAM ctf_stream_root = { NULL };
-static CTF_EVENT ctf_event_root = { NULL };
+static inline CTF_MODEL *model(void)
+{
+  return (current_model != NULL) ? current_model : &default_model;
+}
 
 
 static const char *token_description(int token);
@@ -136,14 +167,14 @@ static void parse_declaration(CTF_TYPE *type, char *identifier, int size);
 
 int ctf_error(int code, ...)
 {
-static int recent_error = -1;
+  CTF_MODEL *tsdl = model();
   char message[256];
   va_list args;
 
-  if (recent_error == linenumber)
+  if (tsdl->recent_error == tsdl->linenumber)
     return 0;
-  recent_error = linenumber;
-  error_count++;
+  tsdl->recent_error = tsdl->linenumber;
+  tsdl->error_count++;
   va_start(args, code);
 
   switch (code) {
@@ -223,85 +254,95 @@ static int recent_error = -1;
     break;
   }
   va_end(args);
-  ctf_error_notify(code, linenumber, message);  /* external function */
+  ctf_error_notify(code, tsdl->linenumber, message);  /* external function */
   return 0;
 }
 
 
 static int readline_init(const char *filename)
 {
-  linenumber = 0;
-  comment_block_start = 0;
+  CTF_MODEL *tsdl = model();
+  tsdl->linenumber = 0;
+  tsdl->comment_block_start = 0;
   for (int idx = 0; idx < INCLUDE_NESTING; idx++) {
-    includestack[idx].file = NULL;
-    includestack[idx].linenr = 0;
+    tsdl->includestack[idx].file = NULL;
+    tsdl->includestack[idx].linenr = 0;
   }
 
-  inputfile = fopen(filename, "rt");
-  if (inputfile == NULL)
+  tsdl->inputfile = fopen(filename, "rt");
+  if (tsdl->inputfile == NULL)
     return ctf_error(CTFERR_FILEOPEN, filename);
 
-  linebuffer = (char*)malloc(MAX_LINE_LENGTH * sizeof(char));
-  if (linebuffer == NULL) {
-    fclose(inputfile);
+  tsdl->linebuffer = (char*)malloc(MAX_LINE_LENGTH * sizeof(char));
+  if (tsdl->linebuffer == NULL) {
+    fclose(tsdl->inputfile);
     return ctf_error(CTFERR_MEMORY);
   }
-  linebuffer[0] = '\0';
+  tsdl->linebuffer[0] = '\0';
   return 1;
 }
 
 static void readline_cleanup(void)
 {
-  if (inputfile != NULL) {
-    fclose(inputfile);
-    inputfile = NULL;
+  CTF_MODEL *tsdl = model();
+  if (tsdl->inputfile != NULL) {
+    fclose(tsdl->inputfile);
+    tsdl->inputfile = NULL;
   }
-  if (linebuffer != NULL) {
-    free((void*)linebuffer);
-    linebuffer = NULL;
+  if (tsdl->linebuffer != NULL) {
+    free((void*)tsdl->linebuffer);
+    tsdl->linebuffer = NULL;
   }
   for (int idx = 0; idx < INCLUDE_NESTING; idx++)
-    if (includestack[idx].file != NULL) {
-      fclose(includestack[idx].file);
-      includestack[idx].file = NULL;
+    if (tsdl->includestack[idx].file != NULL) {
+      fclose(tsdl->includestack[idx].file);
+      tsdl->includestack[idx].file = NULL;
     }
+  if (tsdl->include_names != NULL) {
+    for (int idx = 0; idx < tsdl->include_count; idx++)
+      free((void*)tsdl->include_names[idx]);
+    free((void*)tsdl->include_names);
+    tsdl->include_names = NULL;
+  }
+  tsdl->include_count = 0;
 }
 
 static int readline_next(void)
 {
-  assert(inputfile != NULL);
-  assert(linebuffer != NULL);
+  CTF_MODEL *tsdl = model();
+  assert(tsdl->inputfile != NULL);
+  assert(tsdl->linebuffer != NULL);
   for ( ;; ) {
     char *ptr;
     char in_quotes;
-    if (fgets(linebuffer, MAX_LINE_LENGTH - 1, inputfile) == NULL) {
-      if (comment_block_start > 0)
-        ctf_error(CTFERR_BLOCKCOMMENT, comment_block_start);
+    if (fgets(tsdl->linebuffer, MAX_LINE_LENGTH - 1, tsdl->inputfile) == NULL) {
+      if (tsdl->comment_block_start > 0)
+        ctf_error(CTFERR_BLOCKCOMMENT, tsdl->comment_block_start);
       /* no more data in the file, try to pop a file from the include stack */
       int top;
-      for (top = INCLUDE_NESTING - 1; top >= 0 && includestack[top].file == NULL; top--)
+      for (top = INCLUDE_NESTING - 1; top >= 0 && tsdl->includestack[top].file == NULL; top--)
         {}
       if (top < 0)
         return 0; /* no more files -> done */
-      fclose(inputfile);
-      inputfile = includestack[top].file;
-      linenumber = includestack[top].linenr;
-      includestack[top].file = NULL;
+      fclose(tsdl->inputfile);
+      tsdl->inputfile = tsdl->includestack[top].file;
+      tsdl->linenumber = tsdl->includestack[top].linenr;
+      tsdl->includestack[top].file = NULL;
       continue;
     }
 
-    linenumber += 1;
-    ptr = strchr(linebuffer, '\n');
-    if (ptr == NULL && !feof(inputfile))
+    tsdl->linenumber += 1;
+    ptr = strchr(tsdl->linebuffer, '\n');
+    if (ptr == NULL && !feof(tsdl->inputfile))
       ctf_error(CTFERR_LONGLINE);
     if (ptr != NULL)
       *ptr = '\0';
     /* preprocess the line (remove comments) */
     in_quotes = '\0';
-    for (ptr = linebuffer; *ptr != '\0'; ptr++) {
-      if (comment_block_start > 0) {
+    for (ptr = tsdl->linebuffer; *ptr != '\0'; ptr++) {
+      if (tsdl->comment_block_start > 0) {
         if (*ptr == '*' && *(ptr + 1) == '/') {
-          comment_block_start = 0;
+          tsdl->comment_block_start = 0;
           *ptr = ' '; /* replace the comment by white-space */
           ptr++;      /* skip '*', the '/' is skipped in the for loop (after "continue") */
         }
@@ -317,7 +358,7 @@ static int readline_next(void)
         *ptr = '\0';    /* terminate line at the start of a single-line comment */
         break;          /* exit the for loop */
       } else if (*ptr == '/' && *(ptr + 1) == '*') {
-        comment_block_start = linenumber;
+        tsdl->comment_block_start = tsdl->linenumber;
         *ptr = ' ';     /* replace the comment by white-space */
       } else if (*ptr == '"' || *ptr == '\'') {
         in_quotes = *ptr;
@@ -326,12 +367,12 @@ static int readline_next(void)
       }
     }
     /* strip trailing white-space */
-    ptr = strchr(linebuffer, '\0');
-    while (ptr > linebuffer && *(ptr - 1) <= ' ')
+    ptr = strchr(tsdl->linebuffer, '\0');
+    while (ptr > tsdl->linebuffer && *(ptr - 1) <= ' ')
       ptr--;
     *ptr = '\0';
     /* continue until there is something in the line */
-    if (strlen(linebuffer) > 0)
+    if (strlen(tsdl->linebuffer) > 0)
       break;
   }
   return 1;
@@ -439,7 +480,8 @@ static CTF_TYPE *type_lookup(CTF_TYPE *root, const char *name)
 
 static void type_default_int(CTF_TYPE *type)
 {
-  CTF_TYPE *basetype = type_lookup(&type_root, "int");
+  CTF_MODEL *tsdl = model();
+  CTF_TYPE *basetype = type_lookup(&tsdl->type_root, "int");
   assert(type != NULL);
   if (basetype != NULL) {
     /* "int" type has been defined, so use it */
@@ -474,23 +516,25 @@ static int hexdigit(char c)
 
 static int token_init(void)
 {
-  memset(&recent_token, 0, sizeof(TOKEN));
-  recent_token.id = TOK_NONE;
-  recent_token.pushed = 0;
-  recent_token.text = (char*)malloc(MAX_TOKEN_LENGTH * sizeof(char));
-  if (recent_token.text == NULL)
+  CTF_MODEL *tsdl = model();
+  memset(&tsdl->recent_token, 0, sizeof(TOKEN));
+  tsdl->recent_token.id = TOK_NONE;
+  tsdl->recent_token.pushed = 0;
+  tsdl->recent_token.text = (char*)malloc(MAX_TOKEN_LENGTH * sizeof(char));
+  if (tsdl->recent_token.text == NULL)
     return ctf_error(CTFERR_MEMORY);
-  recent_token.text[0] = '\0';
-  linebuffer_index = MAX_LINE_LENGTH;  /* force to read a line on the first call */
+  tsdl->recent_token.text[0] = '\0';
+  tsdl->linebuffer_index = MAX_LINE_LENGTH;  /* force to read a line on the first call */
   return 1;
 }
 
 static void token_cleanup(void)
 {
-  if (recent_token.text != NULL)
-    free((void*)recent_token.text);
-  memset(&recent_token, 0, sizeof(TOKEN));
-  recent_token.id = TOK_EOF;
+  CTF_MODEL *tsdl = model();
+  if (tsdl->recent_token.text != NULL)
+    free((void*)tsdl->recent_token.text);
+  memset(&tsdl->recent_token, 0, sizeof(TOKEN));
+  tsdl->recent_token.id = TOK_EOF;
 }
 
 /* name array must run parallel with TOK_xxx enum */
@@ -509,7 +553,7 @@ static const char *token_generic[] = {
 static const char *token_description(int token)
 {
   if (token < 0x100) {
-    static char name[10];
+    static thread_local char name[10];
     sprintf(name, "'%c'", token);
     return name;
   }
@@ -532,163 +576,168 @@ static const char *token_description(int token)
 
 static int token_next(void)
 {
-  if (recent_token.pushed) {
-    recent_token.pushed = 0;
-    return recent_token.id;
+  CTF_MODEL *tsdl = model();
+  if (tsdl->recent_token.pushed) {
+    tsdl->recent_token.pushed = 0;
+    return tsdl->recent_token.id;
   }
 
-  assert(linebuffer != NULL);
-  if ((unsigned)linebuffer_index >= strlen(linebuffer)) {
+  assert(tsdl->linebuffer != NULL);
+  if ((unsigned)tsdl->linebuffer_index >= strlen(tsdl->linebuffer)) {
     if (!readline_next()) {
-      recent_token.id = TOK_EOF;
-      return recent_token.id;
+      tsdl->recent_token.id = TOK_EOF;
+      return tsdl->recent_token.id;
     }
-    linebuffer_index = 0;
+    tsdl->linebuffer_index = 0;
   }
 
-  while (linebuffer[linebuffer_index] == ' ')
-    linebuffer_index++; /* skip white-space */
-  if (isdigit(linebuffer[linebuffer_index])) {
+  while (tsdl->linebuffer[tsdl->linebuffer_index] == ' ')
+    tsdl->linebuffer_index++; /* skip white-space */
+  if (isdigit(tsdl->linebuffer[tsdl->linebuffer_index])) {
     /* literal number (decimal, hexadecimal or floating point) */
-    recent_token.id = TOK_LINTEGER; /* may be overruled later */
-    recent_token.number = 0;
-    recent_token.real = 0.0;
-    if (linebuffer[linebuffer_index] == '0' && (linebuffer[linebuffer_index + 1] == 'x' || linebuffer[linebuffer_index + 1] == 'X')) {
+    tsdl->recent_token.id = TOK_LINTEGER; /* may be overruled later */
+    tsdl->recent_token.number = 0;
+    tsdl->recent_token.real = 0.0;
+    if (tsdl->linebuffer[tsdl->linebuffer_index] == '0' && (tsdl->linebuffer[tsdl->linebuffer_index + 1] == 'x' || tsdl->linebuffer[tsdl->linebuffer_index + 1] == 'X')) {
       /* hexadecimal */
-      linebuffer_index += 2;
-      while (isxdigit(linebuffer[linebuffer_index])) {
-        recent_token.number = (recent_token.number << 4) | hexdigit(linebuffer[linebuffer_index]);
-        linebuffer_index++;
+      tsdl->linebuffer_index += 2;
+      while (isxdigit(tsdl->linebuffer[tsdl->linebuffer_index])) {
+        tsdl->recent_token.number = (tsdl->recent_token.number << 4) | hexdigit(tsdl->linebuffer[tsdl->linebuffer_index]);
+        tsdl->linebuffer_index++;
       }
     } else {
       /* decimal or floating point */
-      while (isdigit(linebuffer[linebuffer_index])) {
-        recent_token.number = (recent_token.number * 10) + (linebuffer[linebuffer_index] - '0');
-        linebuffer_index++;
+      while (isdigit(tsdl->linebuffer[tsdl->linebuffer_index])) {
+        tsdl->recent_token.number = (tsdl->recent_token.number * 10) + (tsdl->linebuffer[tsdl->linebuffer_index] - '0');
+        tsdl->linebuffer_index++;
       }
-      if (linebuffer[linebuffer_index] == '.') {
+      if (tsdl->linebuffer[tsdl->linebuffer_index] == '.') {
         double mult = 0.1;
-        recent_token.id = TOK_LFLOAT;
-        recent_token.real = recent_token.number;
-        linebuffer_index++;
-        while (isdigit(linebuffer[linebuffer_index])) {
-          recent_token.real += (linebuffer[linebuffer_index] - '0') * mult;
+        tsdl->recent_token.id = TOK_LFLOAT;
+        tsdl->recent_token.real = tsdl->recent_token.number;
+        tsdl->linebuffer_index++;
+        while (isdigit(tsdl->linebuffer[tsdl->linebuffer_index])) {
+          tsdl->recent_token.real += (tsdl->linebuffer[tsdl->linebuffer_index] - '0') * mult;
           mult /= 10.0;
-          linebuffer_index++;
+          tsdl->linebuffer_index++;
         }
       }
     }
-  } else if (linebuffer[linebuffer_index] == '\'') {
+  } else if (tsdl->linebuffer[tsdl->linebuffer_index] == '\'') {
     /* literal character */
     int idx = 0;
-    recent_token.id = TOK_LCHAR;
-    linebuffer_index++;
-    while (linebuffer[linebuffer_index] != '\'' && linebuffer[linebuffer_index] != '\0') {
-      if (linebuffer[linebuffer_index] == '\\' && linebuffer[linebuffer_index + 1] != '\0')
-        recent_token.text[idx++] = linebuffer[linebuffer_index++];
-      recent_token.text[idx++] = linebuffer[linebuffer_index++];
+    tsdl->recent_token.id = TOK_LCHAR;
+    tsdl->linebuffer_index++;
+    while (tsdl->linebuffer[tsdl->linebuffer_index] != '\'' && tsdl->linebuffer[tsdl->linebuffer_index] != '\0') {
+      if (tsdl->linebuffer[tsdl->linebuffer_index] == '\\' && tsdl->linebuffer[tsdl->linebuffer_index + 1] != '\0')
+        tsdl->recent_token.text[idx++] = tsdl->linebuffer[tsdl->linebuffer_index++];
+      tsdl->recent_token.text[idx++] = tsdl->linebuffer[tsdl->linebuffer_index++];
       if (idx >= MAX_TOKEN_LENGTH)
         break;
     }
-    recent_token.text[idx] = '\0';
-    if (linebuffer[linebuffer_index] == '\'')
-      linebuffer_index++;
+    tsdl->recent_token.text[idx] = '\0';
+    if (tsdl->linebuffer[tsdl->linebuffer_index] == '\'')
+      tsdl->linebuffer_index++;
     else
       ctf_error(CTFERR_STRING);
-  } else if (linebuffer[linebuffer_index] == '"') {
+  } else if (tsdl->linebuffer[tsdl->linebuffer_index] == '"') {
     /* literal string */
     int idx = 0;
-    recent_token.id = TOK_LSTRING;
-    linebuffer_index++;
-    while (linebuffer[linebuffer_index] != '"' && linebuffer[linebuffer_index] != '\0') {
-      if (linebuffer[linebuffer_index] == '\\' && linebuffer[linebuffer_index + 1] != '\0')
-        recent_token.text[idx++] = linebuffer[linebuffer_index++];
-      recent_token.text[idx++] = linebuffer[linebuffer_index++];
+    tsdl->recent_token.id = TOK_LSTRING;
+    tsdl->linebuffer_index++;
+    while (tsdl->linebuffer[tsdl->linebuffer_index] != '"' && tsdl->linebuffer[tsdl->linebuffer_index] != '\0') {
+      if (tsdl->linebuffer[tsdl->linebuffer_index] == '\\' && tsdl->linebuffer[tsdl->linebuffer_index + 1] != '\0')
+        tsdl->recent_token.text[idx++] = tsdl->linebuffer[tsdl->linebuffer_index++];
+      tsdl->recent_token.text[idx++] = tsdl->linebuffer[tsdl->linebuffer_index++];
       if (idx >= MAX_TOKEN_LENGTH)
         break;
     }
-    recent_token.text[idx] = '\0';
-    if (linebuffer[linebuffer_index] == '"')
-      linebuffer_index++;
+    tsdl->recent_token.text[idx] = '\0';
+    if (tsdl->linebuffer[tsdl->linebuffer_index] == '"')
+      tsdl->linebuffer_index++;
     else
       ctf_error(CTFERR_STRING);
-  } else if (isalpha(linebuffer[linebuffer_index]) || linebuffer[linebuffer_index] == '_') {
+  } else if (isalpha(tsdl->linebuffer[tsdl->linebuffer_index]) || tsdl->linebuffer[tsdl->linebuffer_index] == '_') {
     /* identifier or keyword */
     int idx = 0;
-    recent_token.id = TOK_IDENTIFIER; /* may be reset later */
-    while (isalnum(linebuffer[linebuffer_index]) || linebuffer[linebuffer_index] == '_') {
-      recent_token.text[idx++] = linebuffer[linebuffer_index++];
+    tsdl->recent_token.id = TOK_IDENTIFIER; /* may be reset later */
+    while (isalnum(tsdl->linebuffer[tsdl->linebuffer_index]) || tsdl->linebuffer[tsdl->linebuffer_index] == '_') {
+      tsdl->recent_token.text[idx++] = tsdl->linebuffer[tsdl->linebuffer_index++];
       if (idx >= MAX_TOKEN_LENGTH)
         break;
     }
-    recent_token.text[idx] = '\0';
-    if (isalnum(linebuffer[linebuffer_index]))
-      ctf_error(CTFERR_INVALIDTOKEN, linebuffer_index + 1);
+    tsdl->recent_token.text[idx] = '\0';
+    if (isalnum(tsdl->linebuffer[tsdl->linebuffer_index]))
+      ctf_error(CTFERR_INVALIDTOKEN, tsdl->linebuffer_index + 1);
     /* now check whether this is a keyword */
     for (idx = 0; idx < sizearray(token_keywords); idx++)
-      if (strcmp(recent_token.text, token_keywords[idx]) == 0)
+      if (strcmp(tsdl->recent_token.text, token_keywords[idx]) == 0)
         break;
     if (idx < sizearray(token_keywords)) {
-      recent_token.id = TOK_NONE + idx + 1;
+      tsdl->recent_token.id = TOK_NONE + idx + 1;
     } else {
       /* also check for "boolean" values */
-      if (strcmp(recent_token.text, "false") == 0 || strcmp(recent_token.text, "FALSE") == 0) {
-        recent_token.id = TOK_LINTEGER;
-        recent_token.number = 0;
-      } else if (strcmp(recent_token.text, "true") == 0 || strcmp(recent_token.text, "TRUE") == 0) {
-        recent_token.id = TOK_LINTEGER;
-        recent_token.number = 1;
+      if (strcmp(tsdl->recent_token.text, "false") == 0 || strcmp(tsdl->recent_token.text, "FALSE") == 0) {
+        tsdl->recent_token.id = TOK_LINTEGER;
+        tsdl->recent_token.number = 0;
+      } else if (strcmp(tsdl->recent_token.text, "true") == 0 || strcmp(tsdl->recent_token.text, "TRUE") == 0) {
+        tsdl->recent_token.id = TOK_LINTEGER;
+        tsdl->recent_token.number = 1;
       }
     }
   } else {
     /* operator */
-    if (linebuffer[linebuffer_index] == ':') {
-      recent_token.id = linebuffer[linebuffer_index];
-      linebuffer_index += 1;
-      if (linebuffer[linebuffer_index] == '=') {
-        recent_token.id = TOK_OP_TYPE_ASSIGN; /* := */
-        linebuffer_index += 1;
-      } else if (linebuffer[linebuffer_index] == ':') {
-        recent_token.id = TOK_OP_NAMESPACE;   /* :: */
-        linebuffer_index += 1;
+    if (tsdl->linebuffer[tsdl->linebuffer_index] == ':') {
+      tsdl->recent_token.id = tsdl->linebuffer[tsdl->linebuffer_index];
+      tsdl->linebuffer_index += 1;
+      if (tsdl->linebuffer[tsdl->linebuffer_index] == '=') {
+        tsdl->recent_token.id = TOK_OP_TYPE_ASSIGN; /* := */
+        tsdl->linebuffer_index += 1;
+      } else if (tsdl->linebuffer[tsdl->linebuffer_index] == ':') {
+        tsdl->recent_token.id = TOK_OP_NAMESPACE;   /* :: */
+        tsdl->linebuffer_index += 1;
       }
-    } else if (linebuffer[linebuffer_index] == '-' && linebuffer[linebuffer_index + 1] == '>') {
-      recent_token.id = TOK_OP_ARROW;
-      linebuffer_index += 2;
-    } else if (linebuffer[linebuffer_index] == '.' && linebuffer[linebuffer_index + 1] == '.' && linebuffer[linebuffer_index + 2] == '.') {
-      recent_token.id = TOK_OP_ELLIPSIS;
-      linebuffer_index += 3;
-    } else if (strchr("[](){}.*+-<>;=,", linebuffer[linebuffer_index]) != NULL) {
-      recent_token.id = linebuffer[linebuffer_index];
-      linebuffer_index += 1;
+    } else if (tsdl->linebuffer[tsdl->linebuffer_index] == '-' && tsdl->linebuffer[tsdl->linebuffer_index + 1] == '>') {
+      tsdl->recent_token.id = TOK_OP_ARROW;
+      tsdl->linebuffer_index += 2;
+    } else if (tsdl->linebuffer[tsdl->linebuffer_index] == '.' && tsdl->linebuffer[tsdl->linebuffer_index + 1] == '.' && tsdl->linebuffer[tsdl->linebuffer_index + 2] == '.') {
+      tsdl->recent_token.id = TOK_OP_ELLIPSIS;
+      tsdl->linebuffer_index += 3;
+    } else if (strchr("[](){}.*+-<>;=,", tsdl->linebuffer[tsdl->linebuffer_index]) != NULL) {
+      tsdl->recent_token.id = tsdl->linebuffer[tsdl->linebuffer_index];
+      tsdl->linebuffer_index += 1;
     } else {
-      recent_token.id = TOK_NONE;
-      ctf_error(CTFERR_INVALIDTOKEN, linebuffer_index + 1);
+      tsdl->recent_token.id = TOK_NONE;
+      ctf_error(CTFERR_INVALIDTOKEN, tsdl->linebuffer_index + 1);
     }
   }
 
-  return recent_token.id;
+  return tsdl->recent_token.id;
 }
 
 static void token_pushback(void)
 {
-  assert(!recent_token.pushed);
-  recent_token.pushed = 1;
+  CTF_MODEL *tsdl = model();
+  assert(!tsdl->recent_token.pushed);
+  tsdl->recent_token.pushed = 1;
 }
 
 static const char *token_gettext(void)
 {
-  return recent_token.text;
+  CTF_MODEL *tsdl = model();
+  return tsdl->recent_token.text;
 }
 
 static long token_getlong(void)
 {
-  return recent_token.number;
+  CTF_MODEL *tsdl = model();
+  return tsdl->recent_token.number;
 }
 
 static double token_getreal(void)
 {
-  return recent_token.real;
+  CTF_MODEL *tsdl = model();
+  return tsdl->recent_token.real;
 }
 
 static int token_match(int token)
@@ -714,22 +763,31 @@ static int token_need(int token)
 
 const CTF_PACKET_HEADER *packet_header(void)
 {
-  return &ctf_packet;
+  CTF_MODEL *tsdl = model();
+  return &tsdl->ctf_packet;
+}
+
+const CTF_TRACE_GLOBAL *trace_global(void)
+{
+  CTF_MODEL *tsdl = model();
+  return &tsdl->ctf_trace;
 }
 
 static void clock_cleanup(void)
 {
-  while (ctf_clock_root.next != NULL) {
-    CTF_CLOCK *iter = ctf_clock_root.next;
-    ctf_clock_root.next = iter->next;
+  CTF_MODEL *tsdl = model();
+  while (tsdl->ctf_clock_root.next != NULL) {
+    CTF_CLOCK *iter = tsdl->ctf_clock_root.next;
+    tsdl->ctf_clock_root.next = iter->next;
     free((void*)iter);
   }
 }
 
 const CTF_CLOCK *clock_by_name(const char *name)
 {
+  CTF_MODEL *tsdl = model();
   CTF_CLOCK *clock;
-  for (clock = ctf_clock_root.next; clock != NULL; clock = clock->next)
+  for (clock = tsdl->ctf_clock_root.next; clock != NULL; clock = clock->next)
     if (strcmp(clock->name, name) == 0)
       return clock;
   return NULL;
@@ -737,39 +795,48 @@ const CTF_CLOCK *clock_by_name(const char *name)
 
 const CTF_CLOCK *clock_by_seqnr(int seqnr)
 {
+  CTF_MODEL *tsdl = model();
   CTF_CLOCK *clock;
-  for (clock = ctf_clock_root.next; clock != NULL && seqnr > 0; clock = clock->next)
+  if (tsdl->clock_indexvalid)
+    return (seqnr >= 0 && seqnr < tsdl->clock_total) ? tsdl->clock_index[seqnr] : NULL;
+  for (clock = tsdl->ctf_clock_root.next; clock != NULL && seqnr > 0; clock = clock->next)
     seqnr -= 1;
   return clock;
 }
 
 static void stream_cleanup(void)
 {
-  while (ctf_stream_root.next != NULL) {
-    CTF_STREAM *iter = ctf_stream_root.next;
-    ctf_stream_root.next = iter->next;
+  CTF_MODEL *tsdl = model();
+  while (tsdl->ctf_stream_root.next != NULL) {
+    CTF_STREAM *iter = tsdl->ctf_stream_root.next;
+    tsdl->ctf_stream_root.next = iter->next;
     free((void*)iter);
   }
 }
 
 int stream_isactive(int stream_id)
 {
-  return (ctf_trace.stream_mask & (1 << stream_id)) != 0;
+  CTF_MODEL *tsdl = model();
+  return (tsdl->ctf_trace.stream_mask & (1 << stream_id)) != 0;
 }
 
 int stream_count(void)
 {
+  CTF_MODEL *tsdl = model();
   int count = 0;
   CTF_STREAM *stream;
-  for (stream = ctf_stream_root.next; stream != NULL; stream = stream->next)
+  if (tsdl->stream_indexvalid)
+    return tsdl->stream_total;
+  for (stream = tsdl->ctf_stream_root.next; stream != NULL; stream = stream->next)
     count++;
   return count;
 }
 
 const CTF_STREAM *stream_by_name(const char *name)
 {
+  CTF_MODEL *tsdl = model();
   CTF_STREAM *stream;
-  for (stream = ctf_stream_root.next; stream != NULL; stream = stream->next)
+  for (stream = tsdl->ctf_stream_root.next; stream != NULL; stream = stream->next)
     if (strcmp(stream->name, name) == 0)
       return stream;
   return NULL;
@@ -777,8 +844,11 @@ const CTF_STREAM *stream_by_name(const char *name)
 
 const CTF_STREAM *stream_by_id(int stream_id)
 {
+  CTF_MODEL *tsdl = model();
   CTF_STREAM *stream;
-  for (stream = ctf_stream_root.next; stream != NULL; stream = stream->next)
+  if (tsdl->stream_indexvalid)
+    return (stream_id >= 0 && stream_id < tsdl->stream_indexsize) ? tsdl->stream_index[stream_id] : NULL;
+  for (stream = tsdl->ctf_stream_root.next; stream != NULL; stream = stream->next)
     if (stream->stream_id == stream_id)
       return stream;
   return NULL;
@@ -786,17 +856,19 @@ const CTF_STREAM *stream_by_id(int stream_id)
 
 const CTF_STREAM *stream_by_seqnr(int seqnr)
 {
+  CTF_MODEL *tsdl = model();
   CTF_STREAM *stream;
-  for (stream = ctf_stream_root.next; stream != NULL && seqnr > 0; stream = stream->next)
+  for (stream = tsdl->ctf_stream_root.next; stream != NULL && seqnr > 0; stream = stream->next)
     seqnr -= 1;
   return stream;
 }
 
 static void event_cleanup(void)
 {
-  while (ctf_event_root.next != NULL) {
-    CTF_EVENT *iter = ctf_event_root.next;
-    ctf_event_root.next = iter->next;
+  CTF_MODEL *tsdl = model();
+  while (tsdl->ctf_event_root.next != NULL) {
+    CTF_EVENT *iter = tsdl->ctf_event_root.next;
+    tsdl->ctf_event_root.next = iter->next;
     while (iter->field_root.next != NULL) {
       CTF_EVENT_FIELD *fld = iter->field_root.next;
       iter->field_root.next = fld->next;
@@ -813,9 +885,12 @@ static void event_cleanup(void)
  */
 int event_count(int stream_id)
 {
+  CTF_MODEL *tsdl = model();
   int count = 0;
   CTF_EVENT *event;
-  for (event = ctf_event_root.next; event != NULL; event = event->next)
+  if (stream_id == -1 && tsdl->event_indexvalid)
+    return tsdl->event_total;
+  for (event = tsdl->ctf_event_root.next; event != NULL; event = event->next)
     if (stream_id == -1 || event->stream_id == stream_id)
       count++;
   return count;
@@ -826,20 +901,120 @@ int event_count(int stream_id)
  */
 const CTF_EVENT *event_next(const CTF_EVENT *event)
 {
+  CTF_MODEL *tsdl = model();
   if (event == NULL)
-    return ctf_event_root.next;
+    return tsdl->ctf_event_root.next;
   return event->next;
 }
 
 const CTF_EVENT *event_by_id(int event_id)
 {
+  CTF_MODEL *tsdl = model();
   CTF_EVENT *event;
-  for (event = ctf_event_root.next; event != NULL; event = event->next)
+  if (tsdl->event_indexvalid)
+    return (event_id >= 0 && event_id < tsdl->event_indexsize) ? tsdl->event_index[event_id] : NULL;
+  for (event = tsdl->ctf_event_root.next; event != NULL; event = event->next)
     if (event->id == event_id)
       return event;
   return NULL;
 }
 
+static void index_cleanup(void)
+{
+  CTF_MODEL *tsdl = model();
+  if (tsdl->event_index != NULL) {
+    free((void*)tsdl->event_index);
+    tsdl->event_index = NULL;
+  }
+  if (tsdl->stream_index != NULL) {
+    free((void*)tsdl->stream_index);
+    tsdl->stream_index = NULL;
+  }
+  if (tsdl->clock_index != NULL) {
+    free((void*)tsdl->clock_index);
+    tsdl->clock_index = NULL;
+  }
+  tsdl->event_indexsize = tsdl->stream_indexsize = 0;
+  tsdl->event_total = tsdl->stream_total = tsdl->clock_total = 0;
+  tsdl->event_indexvalid = tsdl->stream_indexvalid = tsdl->clock_indexvalid = 0;
+}
+
+/** index_build() creates the tables for looking up events and streams by id
+ *  and clocks by sequence number. A table is not built if the id's are out of
+ *  range, and look-ups then fall back to a linear search. On duplicate id's,
+ *  the table holds the entry that the linear search would find.
+ */
+static void index_build(void)
+{
+  CTF_MODEL *tsdl = model();
+  CTF_EVENT *event;
+  CTF_STREAM *stream;
+  CTF_CLOCK *clock;
+  int maxid;
+
+  index_cleanup();
+
+  /* resolve the clock of each stream */
+  for (stream = tsdl->ctf_stream_root.next; stream != NULL; stream = stream->next)
+    stream->clock_map = (stream->clock != NULL && stream->clock->selector != NULL)
+                        ? clock_by_name(stream->clock->selector) : NULL;
+
+  maxid = -1;
+  for (event = tsdl->ctf_event_root.next; event != NULL; event = event->next) {
+    if (event->id < 0 || event->id > INDEX_MAXID)
+      break;
+    if (event->id > maxid)
+      maxid = event->id;
+    tsdl->event_total++;
+  }
+  if (event == NULL) {
+    tsdl->event_indexsize = maxid + 1;
+    if (tsdl->event_indexsize == 0 || (tsdl->event_index = (const CTF_EVENT**)calloc(tsdl->event_indexsize, sizeof(CTF_EVENT*))) != NULL) {
+      for (event = tsdl->ctf_event_root.next; event != NULL; event = event->next)
+        if (tsdl->event_index[event->id] == NULL)
+          tsdl->event_index[event->id] = event;
+      tsdl->event_indexvalid = 1;
+    }
+  }
+  if (!tsdl->event_indexvalid) {
+    tsdl->event_indexsize = 0;
+    tsdl->event_total = 0;
+  }
+
+  maxid = -1;
+  for (stream = tsdl->ctf_stream_root.next; stream != NULL; stream = stream->next) {
+    if (stream->stream_id < 0 || stream->stream_id > INDEX_MAXID)
+      break;
+    if (stream->stream_id > maxid)
+      maxid = stream->stream_id;
+    tsdl->stream_total++;
+  }
+  if (stream == NULL) {
+    tsdl->stream_indexsize = maxid + 1;
+    if (tsdl->stream_indexsize == 0 || (tsdl->stream_index = (const CTF_STREAM**)calloc(tsdl->stream_indexsize, sizeof(CTF_STREAM*))) != NULL) {
+      for (stream = tsdl->ctf_stream_root.next; stream != NULL; stream = stream->next)
+        if (tsdl->stream_index[stream->stream_id] == NULL)
+          tsdl->stream_index[stream->stream_id] = stream;
+      tsdl->stream_indexvalid = 1;
+    }
+  }
+  if (!tsdl->stream_indexvalid) {
+    tsdl->stream_indexsize = 0;
+    tsdl->stream_total = 0;
+  }
+
+  for (clock = tsdl->ctf_clock_root.next; clock != NULL; clock = clock->next)
+    tsdl->clock_total++;
+  if (tsdl->clock_total == 0 || (tsdl->clock_index = (const CTF_CLOCK**)malloc(tsdl->clock_total * sizeof(CTF_CLOCK*))) != NULL) {
+    int seqnr = 0;
+    for (clock = tsdl->ctf_clock_root.next; clock != NULL; clock = clock->next)
+      tsdl->clock_index[seqnr++] = clock;
+    tsdl->clock_indexvalid = 1;
+  } else {
+    tsdl->clock_total = 0;
+  }
+}
+
 /** close_declaration() frees all memory for a single type declaration, but does
  *  not free the type structure itself. This function is used to clean-up a
  *  temporary declaration in an automatic variable (one obtained with
@@ -1058,6 +1233,7 @@ static void parse_typealias_fields(CTF_TYPE *type)
  */
 static void parse_declaration(CTF_TYPE *type, char *identifier, int size)
 {
+  CTF_MODEL *tsdl = model();
   int token;
 
   /* get type */
@@ -1066,7 +1242,7 @@ static void parse_declaration(CTF_TYPE *type, char *identifier, int size)
   token = token_next();
   if (token == TOK_IDENTIFIER) {
     /* look up user type */
-    CTF_TYPE *usertype = type_lookup(&type_root, token_gettext());
+    CTF_TYPE *usertype = type_lookup(&tsdl->type_root, token_gettext());
     if (usertype != NULL)
       type_duplicate(type, usertype);
   } else if (token == TOK_INTEGER) {
@@ -1097,7 +1273,7 @@ static void parse_declaration(CTF_TYPE *type, char *identifier, int size)
     CTF_TYPE *usertype = NULL;
     if (token_match(TOK_IDENTIFIER)) {
       strlcpy(type->name, token_gettext(), sizearray(type->name));  /* a name is redundant if fields follow */
-      usertype = type_lookup(&type_root, token_gettext());
+      usertype = type_lookup(&tsdl->type_root, token_gettext());
     }
     type->typeclass = CLASS_STRUCT;
     if (usertype != NULL && usertype->typeclass == CLASS_STRUCT) {
@@ -1191,12 +1367,13 @@ static void parse_declaration(CTF_TYPE *type, char *identifier, int size)
 
 static void parse_packet_header(void)
 {
+  CTF_MODEL *tsdl = model();
   CTF_TYPE *knowntype = NULL;
   char identifier[CTF_NAME_LENGTH] = "";
 
   if (token_match(TOK_IDENTIFIER)) {
     /* typedef'ed type */
-    knowntype = type_lookup(&type_root, token_gettext());
+    knowntype = type_lookup(&tsdl->type_root, token_gettext());
     if (knowntype == NULL)
       ctf_error(CTFERR_UNKNOWNTYPE, token_gettext());
   } else {
@@ -1204,7 +1381,7 @@ static void parse_packet_header(void)
     if (token_match(TOK_IDENTIFIER)) {
       /* defined struct */
       strlcpy(identifier, token_gettext(), sizearray(identifier));
-      knowntype = type_lookup(&type_root, identifier);
+      knowntype = type_lookup(&tsdl->type_root, identifier);
     }
     if (token_match('{')) {
       knowntype = NULL; /* ignore the struct name if a definition follows */
@@ -1223,15 +1400,15 @@ static void parse_packet_header(void)
       if (strcmp(identifier, "magic") == 0) {
         if (type.typeclass != CLASS_INTEGER || type.length != 0)
           ctf_error(CTFERR_WRONGTYPE);
-        ctf_packet.header.magic_size = (uint8_t)type.size;
+        tsdl->ctf_packet.header.magic_size = (uint8_t)type.size;
       } else if (strcmp(identifier, "stream.id") == 0 || strcmp(identifier, "stream_id") == 0) {
         if (type.typeclass != CLASS_INTEGER || type.length != 0)
           ctf_error(CTFERR_WRONGTYPE);
-        ctf_packet.header.streamid_size = (uint8_t)type.size;
+        tsdl->ctf_packet.header.streamid_size = (uint8_t)type.size;
       } else if (strcmp(identifier, "uuid") == 0) {
         if (type.typeclass != CLASS_INTEGER || type.size != 8 || type.length == 0)
         ctf_error(CTFERR_WRONGTYPE);
-        ctf_packet.header.uuid_size = (uint8_t)(type.length * type.size);
+        tsdl->ctf_packet.header.uuid_size = (uint8_t)(type.length * type.size);
       } else {
         ctf_error(CTFERR_INVALIDFIELD, identifier);
       }
@@ -1250,15 +1427,15 @@ static void parse_packet_header(void)
         if (strcmp(field->identifier, "magic")== 0) {
           if (field->typeclass != CLASS_INTEGER || field->length != 0)
             ctf_error(CTFERR_WRONGTYPE);
-          ctf_packet.header.magic_size = (uint8_t)field->size;
+          tsdl->ctf_packet.header.magic_size = (uint8_t)field->size;
         } else if (strcmp(field->identifier, "stream.id") == 0 || strcmp(field->identifier, "stream_id") == 0) {
           if (field->typeclass != CLASS_INTEGER || field->length != 0)
             ctf_error(CTFERR_WRONGTYPE);
-          ctf_packet.header.streamid_size = (uint8_t)field->size;
+          tsdl->ctf_packet.header.streamid_size = (uint8_t)field->size;
         } else if (strcmp(field->identifier, "uuid") == 0) {
           if (field->typeclass != CLASS_INTEGER || field->size != 8 || field->length == 0)
           ctf_error(CTFERR_WRONGTYPE);
-          ctf_packet.header.uuid_size = (uint8_t)(field->length * field->size);
+          tsdl->ctf_packet.header.uuid_size = (uint8_t)(field->length * field->size);
         } else {
           ctf_error(CTFERR_INVALIDFIELD, field->identifier);
         }
@@ -1270,13 +1447,14 @@ static void parse_packet_header(void)
 
 static void parse_event_header(CTF_EVENT_HEADER *evthdr, CTF_TYPE **clock)
 {
+  CTF_MODEL *tsdl = model();
   CTF_TYPE *knowntype = NULL;
   char identifier[CTF_NAME_LENGTH] = "";
 
   assert(evthdr != NULL);
   if (token_match(TOK_IDENTIFIER)) {
     /* typedef'ed type */
-    knowntype = type_lookup(&type_root, token_gettext());
+    knowntype = type_lookup(&tsdl->type_root, token_gettext());
     if (knowntype == NULL)
       ctf_error(CTFERR_UNKNOWNTYPE, token_gettext());
   } else {
@@ -1284,7 +1462,7 @@ static void parse_event_header(CTF_EVENT_HEADER *evthdr, CTF_TYPE **clock)
     if (token_match(TOK_IDENTIFIER)) {
       /* defined struct */
       strlcpy(identifier, token_gettext(), sizearray(identifier));
-      knowntype = type_lookup(&type_root, identifier);
+      knowntype = type_lookup(&tsdl->type_root, identifier);
     }
     if (token_match('{')) {
       knowntype = NULL; /* ignore the struct name if a definition follows */
@@ -1312,7 +1490,7 @@ static void parse_event_header(CTF_EVENT_HEADER *evthdr, CTF_TYPE **clock)
            with typealias, because of the "map" attribute, so the type always
            has a name) */
         if (clock != NULL && strlen(type.name) > 0)
-          *clock = type_lookup(&type_root, type.name);
+          *clock = type_lookup(&tsdl->type_root, type.name);
       } else {
         ctf_error(CTFERR_INVALIDFIELD, identifier);
       }
@@ -1340,7 +1518,7 @@ static void parse_event_header(CTF_EVENT_HEADER *evthdr, CTF_TYPE **clock)
              with typealias, because of the "map" attribute, so the type always
              has a name) */
           if (clock != NULL && strlen(field->name) > 0)
-            *clock = type_lookup(&type_root, field->name);
+            *clock = type_lookup(&tsdl->type_root, field->name);
         } else {
           ctf_error(CTFERR_INVALIDFIELD, field->identifier);
         }
@@ -1352,12 +1530,13 @@ static void parse_event_header(CTF_EVENT_HEADER *evthdr, CTF_TYPE **clock)
 
 static void parse_event_fields(CTF_EVENT_FIELD *fieldroot)
 {
+  CTF_MODEL *tsdl = model();
   CTF_TYPE *knowntype = NULL;
 
   assert(fieldroot != NULL);
   if (token_match(TOK_IDENTIFIER)) {
     /* typedef'ed type */
-    knowntype = type_lookup(&type_root, token_gettext());
+    knowntype = type_lookup(&tsdl->type_root, token_gettext());
     if (knowntype == NULL)
       ctf_error(CTFERR_UNKNOWNTYPE, token_gettext());
   } else {
@@ -1366,7 +1545,7 @@ static void parse_event_fields(CTF_EVENT_FIELD *fieldroot)
     if (token_match(TOK_IDENTIFIER)) {
       /* defined struct */
       strlcpy(identifier, token_gettext(), sizearray(identifier));
-      knowntype = type_lookup(&type_root, identifier);
+      knowntype = type_lookup(&tsdl->type_root, identifier);
     }
     if (token_match('{')) {
       knowntype = NULL; /* ignore the struct name if a definition follows */
@@ -1435,6 +1614,7 @@ static void parse_event_fields(CTF_EVENT_FIELD *fieldroot)
  */
 static void parse_enum(void)
 {
+  CTF_MODEL *tsdl = model();
   CTF_TYPE basetype;
   CTF_TYPE *type;
 
@@ -1444,8 +1624,8 @@ static void parse_enum(void)
     return;
   }
   memset(type, 0, sizeof(CTF_TYPE));
-  type->next = type_root.next;
-  type_root.next = type;
+  type->next = tsdl->type_root.next;
+  tsdl->type_root.next = type;
 
   token_need(TOK_IDENTIFIER);
   strlcpy(type->name, token_gettext(), sizearray(type->name));
@@ -1477,12 +1657,13 @@ static void parse_enum(void)
  */
 static void parse_struct(void)
 {
+  CTF_MODEL *tsdl = model();
   char identifier[CTF_NAME_LENGTH];
   CTF_TYPE *type;
 
   token_need(TOK_IDENTIFIER);
   strlcpy(identifier, token_gettext(), sizearray(identifier));
-  if ((type = type_lookup(&type_root, identifier)) != NULL && (type->flags & TYPEFLAG_WEAK) == 0)
+  if ((type = type_lookup(&tsdl->type_root, identifier)) != NULL && (type->flags & TYPEFLAG_WEAK) == 0)
     ctf_error(CTFERR_TYPE_REDEFINE, identifier);
 
   type = (CTF_TYPE*)malloc(sizeof(CTF_TYPE));
@@ -1491,8 +1672,8 @@ static void parse_struct(void)
     return;
   }
   memset(type, 0, sizeof(CTF_TYPE));
-  type->next = type_root.next;
-  type_root.next = type;
+  type->next = tsdl->type_root.next;
+  tsdl->type_root.next = type;
   strlcpy(type->name, identifier, sizearray(type->name));
   type->typeclass = CLASS_STRUCT;
 
@@ -1502,6 +1683,7 @@ static void parse_struct(void)
 
 static void parse_typedef(void)
 {
+  CTF_MODEL *tsdl = model();
   CTF_TYPE type;
   char identifier[CTF_NAME_LENGTH];
 
@@ -1509,7 +1691,7 @@ static void parse_typedef(void)
   token_need(';');
 
   if (type.size > 0 && strlen(identifier) > 0) {
-    CTF_TYPE *newtype = type_lookup(&type_root, identifier);
+    CTF_TYPE *newtype = type_lookup(&tsdl->type_root, identifier);
     if (newtype != NULL && (newtype->flags & TYPEFLAG_WEAK) == 0)
       ctf_error(CTFERR_TYPE_REDEFINE, identifier);
     else if (newtype == NULL)
@@ -1518,8 +1700,8 @@ static void parse_typedef(void)
       memcpy(newtype, &type, sizeof(CTF_TYPE));
       newtype->flags |= TYPEFLAG_STRONG;
       strlcpy(newtype->name, identifier, sizearray(newtype->name));
-      newtype->next = type_root.next;
-      type_root.next = newtype;
+      newtype->next = tsdl->type_root.next;
+      tsdl->type_root.next = newtype;
     }
   }
   /* do not call close_declaration(&type) because the parsed type was copied */
@@ -1527,6 +1709,7 @@ static void parse_typedef(void)
 
 static void parse_typealias(void)
 {
+  CTF_MODEL *tsdl = model();
   CTF_TYPE *type;
   int token;
 
@@ -1536,8 +1719,8 @@ static void parse_typealias(void)
     return;
   }
   memset(type, 0, sizeof(CTF_TYPE));
-  type->next = type_root.next;
-  type_root.next = type;
+  type->next = tsdl->type_root.next;
+  tsdl->type_root.next = type;
 
   token = token_next();
   switch (token) {
@@ -1571,6 +1754,7 @@ static void parse_typealias(void)
 
 static void parse_trace(void)
 {
+  CTF_MODEL *tsdl = model();
   token_need('{');
   while (!token_match('}')) {
     int tok = token_next();
@@ -1580,28 +1764,28 @@ static void parse_trace(void)
       token_need('=');
       if (strcmp(identifier, "major") == 0) {
         token_need(TOK_LINTEGER);
-        ctf_trace.major = (uint8_t)token_getlong();
+        tsdl->ctf_trace.major = (uint8_t)token_getlong();
       } else if (strcmp(identifier, "minor") == 0) {
         token_need(TOK_LINTEGER);
-        ctf_trace.minor = (uint8_t)token_getlong();
+        tsdl->ctf_trace.minor = (uint8_t)token_getlong();
       } else if (strcmp(identifier, "version") == 0) {
         token_need(TOK_LFLOAT);
-        ctf_trace.major = (uint8_t)token_getreal();
-        ctf_trace.minor = (uint8_t)(token_getreal() - ctf_trace.major) * 10;
+        tsdl->ctf_trace.major = (uint8_t)token_getreal();
+        tsdl->ctf_trace.minor = (uint8_t)(token_getreal() - tsdl->ctf_trace.major) * 10;
       } else if (strcmp(identifier, "byte_order") == 0) {
         token_need(TOK_IDENTIFIER);
-        ctf_trace.byte_order = (strcmp(token_gettext(), "be") == 0) ? BYTEORDER_BE : BYTEORDER_LE;
+        tsdl->ctf_trace.byte_order = (strcmp(token_gettext(), "be") == 0) ? BYTEORDER_BE : BYTEORDER_LE;
       } else if (strcmp(identifier, "uuid") == 0) {
         token_need(TOK_LSTRING);
         /* convert string to byte array */
-        memset(ctf_trace.uuid, 0, sizearray(ctf_trace.uuid));
+        memset(tsdl->ctf_trace.uuid, 0, sizearray(tsdl->ctf_trace.uuid));
         const char *ptr = token_gettext();
-        for (int idx = 0; idx < sizearray(ctf_trace.uuid); idx++) {
+        for (int idx = 0; idx < sizearray(tsdl->ctf_trace.uuid); idx++) {
           if (*ptr == '-')
             ptr++;
           if (!isxdigit(ptr[0]) || !isxdigit(ptr[1]))
             break;
-          ctf_trace.uuid[idx] = (uint8_t)((hexdigit(ptr[0]) << 4) | hexdigit(ptr[1]));
+          tsdl->ctf_trace.uuid[idx] = (uint8_t)((hexdigit(ptr[0]) << 4) | hexdigit(ptr[1]));
         }
       }
       token_need(';');
@@ -1625,6 +1809,7 @@ static void parse_trace(void)
 
 static void parse_clock(void)
 {
+  CTF_MODEL *tsdl = model();
   CTF_CLOCK *clock;
 
   /* add a clock */
@@ -1634,8 +1819,8 @@ static void parse_clock(void)
     return;
   }
   memset(clock, 0, sizeof(CTF_CLOCK));
-  clock->next = ctf_clock_root.next;
-  ctf_clock_root.next = clock;
+  clock->next = tsdl->ctf_clock_root.next;
+  tsdl->ctf_clock_root.next = clock;
 
   if (token_match(TOK_IDENTIFIER))
     strlcpy(clock->name, token_gettext(), sizearray(clock->name));
@@ -1696,7 +1881,7 @@ static void parse_clock(void)
     ctf_error(CTFERR_NAMEREQUIRED, "clock");
   } else {
     CTF_CLOCK *iter;
-    for (iter = ctf_clock_root.next; iter != NULL; iter = iter->next)
+    for (iter = tsdl->ctf_clock_root.next; iter != NULL; iter = iter->next)
       if (iter != clock && strcmp(iter->name, clock->name) == 0)
         ctf_error(CTFERR_DUPLICATE_NAME, clock->name);
   }
@@ -1704,6 +1889,7 @@ static void parse_clock(void)
 
 static void parse_stream(void)
 {
+  CTF_MODEL *tsdl = model();
   CTF_STREAM *stream, *iter;
   int streamid_set = 0;
 
@@ -1714,8 +1900,8 @@ static void parse_stream(void)
     return;
   }
   memset(stream, 0, sizeof(CTF_STREAM));
-  stream->next = ctf_stream_root.next;
-  ctf_stream_root.next = stream;
+  stream->next = tsdl->ctf_stream_root.next;
+  tsdl->ctf_stream_root.next = stream;
 
   if (token_match(TOK_IDENTIFIER))
     strlcpy(stream->name, token_gettext(), sizearray(stream->name));
@@ -1754,12 +1940,12 @@ static void parse_stream(void)
 
   if (streamid_set) {
     /* check whether the id is unique */
-    for (iter = ctf_stream_root.next; iter != NULL; iter = iter->next)
+    for (iter = tsdl->ctf_stream_root.next; iter != NULL; iter = iter->next)
       if (iter != stream && iter->stream_id == stream->stream_id)
         ctf_error(CTFERR_DUPLICATE_ID);
   } else {
     /* assign stream_id to be 1 higher than the current highest */
-    for (iter = ctf_stream_root.next; iter != NULL; iter = iter->next)
+    for (iter = tsdl->ctf_stream_root.next; iter != NULL; iter = iter->next)
       if (iter != stream && stream->stream_id >= iter->stream_id)
         stream->stream_id = iter->stream_id + 1;
   }
@@ -1767,6 +1953,7 @@ static void parse_stream(void)
 
 static void parse_event(void)
 {
+  CTF_MODEL *tsdl = model();
   CTF_EVENT *event, *iter;
   const CTF_STREAM *stream;
   int id_set = 0;
@@ -1781,7 +1968,7 @@ static void parse_event(void)
   memset(event, 0, sizeof(CTF_EVENT));
   /* append to the tail, so the order in the generated header file is the same
      as in the trace specification */
-  for (iter = &ctf_event_root; iter->next != NULL; iter = iter->next)
+  for (iter = &tsdl->ctf_event_root; iter->next != NULL; iter = iter->next)
     /* nothing */;
   iter->next = event;
   event->next = NULL;
@@ -1877,19 +2064,19 @@ static void parse_event(void)
   if (strlen(event->name) == 0) {
     ctf_error(CTFERR_NAMEREQUIRED, "event");
   } else {
-    for (iter = ctf_event_root.next; iter != NULL; iter = iter->next)
+    for (iter = tsdl->ctf_event_root.next; iter != NULL; iter = iter->next)
       if (iter != event && strcmp(iter->name, event->name) == 0)
         ctf_error(CTFERR_DUPLICATE_NAME, event->name);
   }
 
   if (id_set) {
     /* check whether the id is unique */
-    for (iter = ctf_event_root.next; iter != NULL; iter = iter->next)
+    for (iter = tsdl->ctf_event_root.next; iter != NULL; iter = iter->next)
       if (iter != event && event->id == iter->id)
         ctf_error(CTFERR_DUPLICATE_ID);
   } else {
     /* assign the id to be 1 higher than the current highest */
-    for (iter = ctf_event_root.next; iter != NULL; iter = iter->next)
+    for (iter = tsdl->ctf_event_root.next; iter != NULL; iter = iter->next)
       if (iter != event && event->id >= iter->id)
         event->id = iter->id + 1;
   }
@@ -1900,7 +2087,7 @@ static void parse_event(void)
        stream is defined with id 0 */
     int count = stream_count();
     if (count == 1) {
-      stream = ctf_stream_root.next;
+      stream = tsdl->ctf_stream_root.next;
       if (stream->stream_id != 0)
         ctf_error(CTFERR_STREAM_NOTSET, event->name);
     } else if (count > 0) {
@@ -1912,13 +2099,14 @@ static void parse_event(void)
   if (stream_by_id(event->stream_id) == NULL
       && event_count(event->stream_id) == 2) /* warn for the 2nd event in this stream, but not for the 3rd, 4th, etc, */
     ctf_error(CTFERR_STREAM_NO_DEF, event->stream_id);
-  ctf_trace.stream_mask |= (1 << event->stream_id);
+  tsdl->ctf_trace.stream_mask |= (1 << event->stream_id);
 }
 
 static void do_include(void)
 {
+  CTF_MODEL *tsdl = model();
   int top;
-  for (top = INCLUDE_NESTING - 1; top >= 0 && includestack[top].file == NULL; top--)
+  for (top = INCLUDE_NESTING - 1; top >= 0 && tsdl->includestack[top].file == NULL; top--)
     {}
   top += 1; /* undo overrun of the loop */
   if (top >= INCLUDE_NESTING) {
@@ -1928,9 +2116,15 @@ static void do_include(void)
       const char *name = token_gettext();
       FILE *fp = fopen(name, "rt");
       if (fp != NULL) {
-        includestack[top].file = inputfile;
-        includestack[top].linenr = 0;
-        inputfile = fp;
+        tsdl->includestack[top].file = tsdl->inputfile;
+        tsdl->includestack[top].linenr = 0;
+        tsdl->inputfile = fp;
+        char **list = (char**)realloc(tsdl->include_names, (tsdl->include_count + 1) * sizeof(char*));
+        if (list != NULL) {
+          tsdl->include_names = list;
+          if ((tsdl->include_names[tsdl->include_count] = strdup(name)) != NULL)
+            tsdl->include_count++;
+        }
       } else {
         ctf_error(CTFERR_FILEOPEN, name);
       }
@@ -1944,37 +2138,40 @@ static void do_include(void)
  */
 int ctf_parse_init(const char *filename)
 {
+  CTF_MODEL *tsdl = model();
   if (!readline_init(filename))
     return 0; /* error message already set via ctf_error() */
   if (!token_init())
     return 0; /* error message already set via ctf_error() */
-  memset(&ctf_trace, 0, sizeof ctf_trace);
-  memset(&ctf_packet, 0, sizeof ctf_packet);
+  memset(&tsdl->ctf_trace, 0, sizeof tsdl->ctf_trace);
+  memset(&tsdl->ctf_packet, 0, sizeof tsdl->ctf_packet);
 
   /* add default types */
-  type_init(&type_root, "int8_t", CLASS_INTEGER, 8, TYPEFLAG_WEAK | TYPEFLAG_SIGNED);
-  type_init(&type_root, "uint8_t", CLASS_INTEGER, 8, TYPEFLAG_WEAK);
-  type_init(&type_root, "int16_t", CLASS_INTEGER, 16, TYPEFLAG_WEAK | TYPEFLAG_SIGNED);
-  type_init(&type_root, "uint16_t", CLASS_INTEGER, 16, TYPEFLAG_WEAK);
-  type_init(&type_root, "int32_t", CLASS_INTEGER, 32, TYPEFLAG_WEAK | TYPEFLAG_SIGNED);
-  type_init(&type_root, "uint32_t", CLASS_INTEGER, 32, TYPEFLAG_WEAK);
-  type_init(&type_root, "int64_t", CLASS_INTEGER, 64, TYPEFLAG_WEAK | TYPEFLAG_SIGNED);
-  type_init(&type_root, "uint64_t", CLASS_INTEGER, 64, TYPEFLAG_WEAK);
+  type_init(&tsdl->type_root, "int8_t", CLASS_INTEGER, 8, TYPEFLAG_WEAK | TYPEFLAG_SIGNED);
+  type_init(&tsdl->type_root, "uint8_t", CLASS_INTEGER, 8, TYPEFLAG_WEAK);
+  type_init(&tsdl->type_root, "int16_t", CLASS_INTEGER, 16, TYPEFLAG_WEAK | TYPEFLAG_SIGNED);
+  type_init(&tsdl->type_root, "uint16_t", CLASS_INTEGER, 16, TYPEFLAG_WEAK);
+  type_init(&tsdl->type_root, "int32_t", CLASS_INTEGER, 32, TYPEFLAG_WEAK | TYPEFLAG_SIGNED);
+  type_init(&tsdl->type_root, "uint32_t", CLASS_INTEGER, 32, TYPEFLAG_WEAK);
+  type_init(&tsdl->type_root, "int64_t", CLASS_INTEGER, 64, TYPEFLAG_WEAK | TYPEFLAG_SIGNED);
+  type_init(&tsdl->type_root, "uint64_t", CLASS_INTEGER, 64, TYPEFLAG_WEAK);
 
-  error_count = 0;
+  tsdl->error_count = 0;
 
   return 1;
 }
 
 void ctf_parse_cleanup(void)
 {
+  CTF_MODEL *tsdl = model();
   readline_cleanup();
   token_cleanup();
   clock_cleanup();
   stream_cleanup();
   event_cleanup();
-  type_cleanup(&type_root);
-  memset(&ctf_trace, 0, sizeof ctf_trace); /* to reset the active streams mask */
+  type_cleanup(&tsdl->type_root);
+  index_cleanup();
+  memset(&tsdl->ctf_trace, 0, sizeof tsdl->ctf_trace); /* to reset the active streams mask */
 }
 
 /** ctf_parse_run() runs the TSDL parser. It returns 1 on success and 0 if one
@@ -1983,6 +2180,7 @@ void ctf_parse_cleanup(void)
  */
 int ctf_parse_run(void)
 {
+  CTF_MODEL *tsdl = model();
   int tok;
 
   while ((tok = token_next()) != TOK_EOF) {
@@ -2024,6 +2222,567 @@ int ctf_parse_run(void)
       ctf_error(CTFERR_SYNTAX_MAIN);
     }
   }
-  return error_count == 0;
+  index_build();
+  return tsdl->error_count == 0;
+}
+
+
+/* The cache file holds the parsed TSDL file in serialized form: a header
+   with the key of the TSDL file, the keys of all included files, followed by
+   the trace and packet header settings and the lists of clocks, types,
+   streams and events. A file is matched on its size and a hash of its
+   contents. */
+#define TSDL_CACHE_MAGIC    "BMTS"
+#define TSDL_CACHE_VERSION  1
+
+typedef struct tagCACHEBUF {
+  unsigned char *data;
+  size_t size;          /* allocated size (writing) or total size (reading) */
+  size_t pos;
+  int ok;
+} CACHEBUF;
+
+static void cb_write(CACHEBUF *cb, const void *data, size_t size)
+{
+  if (!cb->ok)
+    return;
+  if (cb->pos + size > cb->size) {
+    size_t newsize = (cb->size == 0) ? 4096 : cb->size;
+    while (newsize < cb->pos + size)
+      newsize *= 2;
+    unsigned char *newdata = (unsigned char*)realloc(cb->data, newsize);
+    if (newdata == NULL) {
+      cb->ok = 0;
+      return;
+    }
+    cb->data = newdata;
+    cb->size = newsize;
+  }
+  memcpy(cb->data + cb->pos, data, size);
+  cb->pos += size;
+}
+
+static void cb_read(CACHEBUF *cb, void *data, size_t size)
+{
+  if (!cb->ok || cb->pos + size > cb->size) {
+    cb->ok = 0;
+    memset(data, 0, size);
+    return;
+  }
+  memcpy(data, cb->data + cb->pos, size);
+  cb->pos += size;
+}
+
+static void cb_wint(CACHEBUF *cb, int64_t value)
+{
+  cb_write(cb, &value, sizeof value);
+}
+
+static int64_t cb_rint(CACHEBUF *cb)
+{
+  int64_t value;
+  cb_read(cb, &value, sizeof value);
+  return value;
+}
+
+/* cb_rcount() reads a count of items, which is checked against the remaining
+   size (each item takes at least one byte); it returns -1 for "no list" */
+static int cb_rcount(CACHEBUF *cb)
+{
+  int64_t count = cb_rint(cb);
+  if (count < -1 || (count > 0 && (uint64_t)count > cb->size - cb->pos)) {
+    cb->ok = 0;
+    return 0;
+  }
+  return (int)count;
+}
+
+static void cb_wstr(CACHEBUF *cb, const char *str)
+{
+  if (str == NULL) {
+    cb_wint(cb, -1);
+  } else {
+    size_t len = strlen(str);
+    cb_wint(cb, (int64_t)len);
+    cb_write(cb, str, len);
+  }
+}
+
+static char *cb_rstr(CACHEBUF *cb)
+{
+  int len = cb_rcount(cb);
+  if (!cb->ok || len < 0)
+    return NULL;
+  char *str = (char*)malloc((len + 1) * sizeof(char));
+  if (str == NULL) {
+    cb->ok = 0;
+    return NULL;
+  }
+  cb_read(cb, str, len);
+  str[len] = '\0';
+  return str;
+}
+
+static void cache_wtype(CACHEBUF *cb, const CTF_TYPE *type)
+{
+  cb_write(cb, type->name, sizeof type->name);
+  cb_wint(cb, type->size);
+  cb_wint(cb, type->typeclass);
+  cb_wint(cb, type->align);
+  cb_wint(cb, type->flags);
+  cb_wint(cb, type->base);
+  cb_wint(cb, type->scale);
+  cb_wint(cb, type->length);
+  cb_wstr(cb, type->identifier);
+  cb_wstr(cb, type->selector);
+  if (type->fields == NULL) {
+    cb_wint(cb, -1);
+  } else {
+    const CTF_TYPE *sub;
+    int count = 0;
+    for (sub = type->fields->next; sub != NULL; sub = sub->next)
+      count++;
+    cb_wint(cb, count);
+    for (sub = type->fields->next; sub != NULL; sub = sub->next)
+      cache_wtype(cb, sub);
+  }
+  if (type->keys == NULL) {
+    cb_wint(cb, -1);
+  } else {
+    const CTF_KEYVALUE *kv;
+    int count = 0;
+    for (kv = type->keys->next; kv != NULL; kv = kv->next)
+      count++;
+    cb_wint(cb, count);
+    for (kv = type->keys->next; kv != NULL; kv = kv->next) {
+      cb_write(cb, kv->name, sizeof kv->name);
+      cb_wint(cb, kv->value);
+    }
+  }
 }
 
+/* cache_rtype() reads a type into the structure that the caller provides;
+   the sub-types and the keys are allocated (and they are released with
+   type_cleanup()) */
+static void cache_rtype(CACHEBUF *cb, CTF_TYPE *type)
+{
+  int count;
+
+  memset(type, 0, sizeof(CTF_TYPE));
+  cb_read(cb, type->name, sizeof type->name);
+  type->name[sizearray(type->name) - 1] = '\0';
+  type->size = (uint32_t)cb_rint(cb);
+  type->typeclass = (uint8_t)cb_rint(cb);
+  type->align = (uint8_t)cb_rint(cb);
+  type->flags = (uint8_t)cb_rint(cb);
+  type->base = (uint8_t)cb_rint(cb);
+  type->scale = (int)cb_rint(cb);
+  type->length = (int)cb_rint(cb);
+  type->identifier = cb_rstr(cb);
+  type->selector = cb_rstr(cb);
+
+  count = cb_rcount(cb);
+  if (cb->ok && count >= 0) {
+    CTF_TYPE *tail;
+    if ((type->fields = (CTF_TYPE*)malloc(sizeof(CTF_TYPE))) == NULL) {
+      cb->ok = 0;
+      return;
+    }
+    memset(type->fields, 0, sizeof(CTF_TYPE));
+    tail = type->fields;
+    while (cb->ok && count-- > 0) {
+      CTF_TYPE *sub = (CTF_TYPE*)malloc(sizeof(CTF_TYPE));
+      if (sub == NULL) {
+        cb->ok = 0;
+        return;
+      }
+      cache_rtype(cb, sub);
+      tail->next = sub;
+      tail = sub;
+    }
+  }
+
+  count = cb_rcount(cb);
+  if (cb->ok && count >= 0) {
+    CTF_KEYVALUE *tail;
+    if ((type->keys = (CTF_KEYVALUE*)malloc(sizeof(CTF_KEYVALUE))) == NULL) {
+      cb->ok = 0;
+      return;
+    }
+    memset(type->keys, 0, sizeof(CTF_KEYVALUE));
+    tail = type->keys;
+    while (cb->ok && count-- > 0) {
+      CTF_KEYVALUE *kv = (CTF_KEYVALUE*)malloc(sizeof(CTF_KEYVALUE));
+      if (kv == NULL) {
+        cb->ok = 0;
+        return;
+      }
+      memset(kv, 0, sizeof(CTF_KEYVALUE));
+      cb_read(cb, kv->name, sizeof kv->name);
+      kv->name[sizearray(kv->name) - 1] = '\0';
+      kv->value = (long)cb_rint(cb);
+      tail->next = kv;
+      tail = kv;
+    }
+  }
+}
+
+/* cache_filekey() gets the size and a hash (FNV-1a) of the file contents */
+static int cache_filekey(const char *filename, uint32_t *size, uint64_t *hash)
+{
+  unsigned char buffer[4096];
+  size_t count;
+  FILE *fp = fopen(filename, "rb");
+  if (fp == NULL)
+    return 0;
+  *size = 0;
+  *hash = 0xcbf29ce484222325ull;
+  while ((count = fread(buffer, 1, sizeof buffer, fp)) > 0) {
+    for (size_t idx = 0; idx < count; idx++)
+      *hash = (*hash ^ buffer[idx]) * 0x100000001b3ull;
+    *size += (uint32_t)count;
+  }
+  fclose(fp);
+  return 1;
+}
+
+static void cache_save(const char *cachefile, uint32_t size, uint64_t hash)
+{
+  CTF_MODEL *tsdl = model();
+  CACHEBUF cb = { NULL, 0, 0, 1 };
+  const CTF_CLOCK *clock;
+  const CTF_TYPE *type;
+  const CTF_STREAM *stream;
+  const CTF_EVENT *event;
+  int count;
+
+  cb_write(&cb, TSDL_CACHE_MAGIC, 4);
+  cb_wint(&cb, TSDL_CACHE_VERSION);
+  cb_wint(&cb, size);
+  cb_write(&cb, &hash, sizeof hash);
+  cb_wint(&cb, tsdl->include_count);
+  for (int idx = 0; idx < tsdl->include_count; idx++) {
+    uint32_t incsize;
+    uint64_t inchash;
+    if (!cache_filekey(tsdl->include_names[idx], &incsize, &inchash))
+      return;
+    cb_wstr(&cb, tsdl->include_names[idx]);
+    cb_wint(&cb, incsize);
+    cb_write(&cb, &inchash, sizeof inchash);
+  }
+
+  cb_wint(&cb, tsdl->ctf_trace.major);
+  cb_wint(&cb, tsdl->ctf_trace.minor);
+  cb_wint(&cb, tsdl->ctf_trace.byte_order);
+  cb_write(&cb, tsdl->ctf_trace.uuid, sizeof tsdl->ctf_trace.uuid);
+  cb_wint(&cb, tsdl->ctf_trace.stream_mask);
+  cb_wint(&cb, tsdl->ctf_packet.header.magic_size);
+  cb_wint(&cb, tsdl->ctf_packet.header.uuid_size);
+  cb_wint(&cb, tsdl->ctf_packet.header.streamid_size);
+
+  for (count = 0, clock = tsdl->ctf_clock_root.next; clock != NULL; clock = clock->next)
+    count++;
+  cb_wint(&cb, count);
+  for (clock = tsdl->ctf_clock_root.next; clock != NULL; clock = clock->next) {
+    cb_write(&cb, clock->name, sizeof clock->name);
+    cb_write(&cb, clock->description, sizeof clock->description);
+    cb_write(&cb, clock->uuid, sizeof clock->uuid);
+    cb_wint(&cb, clock->frequeny);
+    cb_wint(&cb, clock->precision);
+    cb_wint(&cb, clock->offset_s);
+    cb_wint(&cb, clock->offset);
+    cb_wint(&cb, clock->absolute);
+  }
+
+  for (count = 0, type = tsdl->type_root.next; type != NULL; type = type->next)
+    count++;
+  cb_wint(&cb, count);
+  for (type = tsdl->type_root.next; type != NULL; type = type->next)
+    cache_wtype(&cb, type);
+
+  for (count = 0, stream = tsdl->ctf_stream_root.next; stream != NULL; stream = stream->next)
+    count++;
+  cb_wint(&cb, count);
+  for (stream = tsdl->ctf_stream_root.next; stream != NULL; stream = stream->next) {
+    int clockidx = -1;
+    if (stream->clock != NULL) {
+      int idx = 0;
+      for (type = tsdl->type_root.next; type != NULL && type != stream->clock; type = type->next)
+        idx++;
+      if (type != NULL)
+        clockidx = idx;
+    }
+    cb_wint(&cb, stream->stream_id);
+    cb_write(&cb, stream->name, sizeof stream->name);
+    cb_wint(&cb, stream->event.header.id_size);
+    cb_wint(&cb, stream->event.header.timestamp_size);
+    cb_wint(&cb, clockidx);
+  }
+
+  for (count = 0, event = tsdl->ctf_event_root.next; event != NULL; event = event->next)
+    count++;
+  cb_wint(&cb, count);
+  for (event = tsdl->ctf_event_root.next; event != NULL; event = event->next) {
+    const CTF_EVENT_FIELD *field;
+    cb_wint(&cb, event->id);
+    cb_wint(&cb, event->stream_id);
+    cb_write(&cb, event->name, sizeof event->name);
+    cb_wstr(&cb, event->attribute);
+    for (count = 0, field = event->field_root.next; field != NULL; field = field->next)
+      count++;
+    cb_wint(&cb, count);
+    for (field = event->field_root.next; field != NULL; field = field->next) {
+      cb_write(&cb, field->name, sizeof field->name);
+      cache_wtype(&cb, &field->type);
+    }
+  }
+
+  if (cb.ok) {
+    FILE *fp = fopen(cachefile, "wb");
+    if (fp != NULL) {
+      int result = (fwrite(cb.data, 1, cb.pos, fp) == cb.pos);
+      fclose(fp);
+      if (!result)
+        remove(cachefile);  /* do not leave a truncated cache behind */
+    }
+  }
+  if (cb.data != NULL)
+    free((void*)cb.data);
+}
+
+/* cache_load() rebuilds the clocks, types, streams and events from the cache
+   file; it returns 0 if the file does not exist, if it is invalid, or if it
+   does not match the TSDL file (or one of the files that it includes) */
+static int cache_load(const char *cachefile, uint32_t size, uint64_t hash)
+{
+  CTF_MODEL *tsdl = model();
+  CACHEBUF cb = { NULL, 0, 0, 1 };
+  FILE *fp;
+  long filesize;
+  char magic[4];
+  uint64_t key;
+  int count, idx;
+
+  if ((fp = fopen(cachefile, "rb")) == NULL)
+    return 0;
+  fseek(fp, 0, SEEK_END);
+  filesize = ftell(fp);
+  fseek(fp, 0, SEEK_SET);
+  if (filesize <= 0 || (cb.data = (unsigned char*)malloc(filesize)) == NULL) {
+    fclose(fp);
+    return 0;
+  }
+  cb.size = filesize;
+  cb.ok = (fread(cb.data, 1, filesize, fp) == (size_t)filesize);
+  fclose(fp);
+
+  cb_read(&cb, magic, sizeof magic);
+  if (memcmp(magic, TSDL_CACHE_MAGIC, 4) != 0 || cb_rint(&cb) != TSDL_CACHE_VERSION)
+    cb.ok = 0;
+  if (cb_rint(&cb) != size)
+    cb.ok = 0;
+  cb_read(&cb, &key, sizeof key);
+  if (key != hash)
+    cb.ok = 0;
+  count = cb_rcount(&cb);
+  for (idx = 0; cb.ok && idx < count; idx++) {
+    uint32_t incsize;
+    uint64_t inchash;
+    char *name = cb_rstr(&cb);
+    cb.ok = cb.ok && name != NULL && cache_filekey(name, &incsize, &inchash)
+            && cb_rint(&cb) == incsize;
+    cb_read(&cb, &key, sizeof key);
+    if (key != inchash)
+      cb.ok = 0;
+    if (name != NULL)
+      free((void*)name);
+  }
+  if (!cb.ok) {
+    free((void*)cb.data);
+    return 0;
+  }
+
+  memset(&tsdl->ctf_trace, 0, sizeof tsdl->ctf_trace);
+  memset(&tsdl->ctf_packet, 0, sizeof tsdl->ctf_packet);
+  tsdl->ctf_trace.major = (uint8_t)cb_rint(&cb);
+  tsdl->ctf_trace.minor = (uint8_t)cb_rint(&cb);
+  tsdl->ctf_trace.byte_order = (uint8_t)cb_rint(&cb);
+  cb_read(&cb, tsdl->ctf_trace.uuid, sizeof tsdl->ctf_trace.uuid);
+  tsdl->ctf_trace.stream_mask = (uint32_t)cb_rint(&cb);
+  tsdl->ctf_packet.header.magic_size = (uint8_t)cb_rint(&cb);
+  tsdl->ctf_packet.header.uuid_size = (uint8_t)cb_rint(&cb);
+  tsdl->ctf_packet.header.streamid_size = (uint8_t)cb_rint(&cb);
+
+  CTF_CLOCK *clocktail = &tsdl->ctf_clock_root;
+  count = cb_rcount(&cb);
+  while (cb.ok && count-- > 0) {
+    CTF_CLOCK *clock = (CTF_CLOCK*)malloc(sizeof(CTF_CLOCK));
+    if (clock == NULL) {
+      cb.ok = 0;
+      break;
+    }
+    memset(clock, 0, sizeof(CTF_CLOCK));
+    cb_read(&cb, clock->name, sizeof clock->name);
+    clock->name[sizearray(clock->name) - 1] = '\0';
+    cb_read(&cb, clock->description, sizeof clock->description);
+    clock->description[sizearray(clock->description) - 1] = '\0';
+    cb_read(&cb, clock->uuid, sizeof clock->uuid);
+    clock->frequeny = (uint32_t)cb_rint(&cb);
+    clock->precision = (uint32_t)cb_rint(&cb);
+    clock->offset_s = (uint32_t)cb_rint(&cb);
+    clock->offset = (uint32_t)cb_rint(&cb);
+    clock->absolute = (int)cb_rint(&cb);
+    clocktail->next = clock;
+    clocktail = clock;
+  }
+
+  CTF_TYPE *typetail = &tsdl->type_root;
+  count = cb_rcount(&cb);
+  while (cb.ok && count-- > 0) {
+    CTF_TYPE *type = (CTF_TYPE*)malloc(sizeof(CTF_TYPE));
+    if (type == NULL) {
+      cb.ok = 0;
+      break;
+    }
+    cache_rtype(&cb, type);
+    typetail->next = type;
+    typetail = type;
+  }
+
+  CTF_STREAM *streamtail = &tsdl->ctf_stream_root;
+  count = cb_rcount(&cb);
+  while (cb.ok && count-- > 0) {
+    CTF_STREAM *stream = (CTF_STREAM*)malloc(sizeof(CTF_STREAM));
+    if (stream == NULL) {
+      cb.ok = 0;
+      break;
+    }
+    memset(stream, 0, sizeof(CTF_STREAM));
+    stream->stream_id = (int)cb_rint(&cb);
+    cb_read(&cb, stream->name, sizeof stream->name);
+    stream->name[sizearray(stream->name) - 1] = '\0';
+    stream->event.header.id_size = (uint8_t)cb_rint(&cb);
+    stream->event.header.timestamp_size = (uint8_t)cb_rint(&cb);
+    int64_t clockidx = cb_rint(&cb);
+    if (clockidx >= 0) {
+      CTF_TYPE *type;
+      for (type = tsdl->type_root.next; type != NULL && clockidx > 0; type = type->next)
+        clockidx--;
+      stream->clock = type;
+    }
+    streamtail->next = stream;
+    streamtail = stream;
+  }
+
+  CTF_EVENT *eventtail = &tsdl->ctf_event_root;
+  count = cb_rcount(&cb);
+  while (cb.ok && count-- > 0) {
+    CTF_EVENT *event = (CTF_EVENT*)malloc(sizeof(CTF_EVENT));
+    if (event == NULL) {
+      cb.ok = 0;
+      break;
+    }
+    memset(event, 0, sizeof(CTF_EVENT));
+    eventtail->next = event;
+    eventtail = event;
+    event->id = (int)cb_rint(&cb);
+    event->stream_id = (int)cb_rint(&cb);
+    cb_read(&cb, event->name, sizeof event->name);
+    event->name[sizearray(event->name) - 1] = '\0';
+    event->attribute = cb_rstr(&cb);
+    CTF_EVENT_FIELD *fieldtail = &event->field_root;
+    int numfields = cb_rcount(&cb);
+    while (cb.ok && numfields-- > 0) {
+      CTF_EVENT_FIELD *field = (CTF_EVENT_FIELD*)malloc(sizeof(CTF_EVENT_FIELD));
+      if (field == NULL) {
+        cb.ok = 0;
+        break;
+      }
+      memset(field, 0, sizeof(CTF_EVENT_FIELD));
+      cb_read(&cb, field->name, sizeof field->name);
+      field->name[sizearray(field->name) - 1] = '\0';
+      cache_rtype(&cb, &field->type);
+      fieldtail->next = field;
+      fieldtail = field;
+    }
+  }
+
+  if (cb.ok && cb.pos != cb.size)
+    cb.ok = 0;  /* trailing data, the file is corrupt */
+  free((void*)cb.data);
+  if (!cb.ok) {
+    ctf_parse_cleanup();
+    return 0;
+  }
+  tsdl->error_count = 0;
+  index_build();
+  return 1;
+}
+
+/** ctf_parse_cached() parses the TSDL file like ctf_parse_init() followed by
+ *  ctf_parse_run(), but it first tries to load the parsed data from a cache
+ *  file. If the cache file is absent or outdated, the TSDL file is parsed and
+ *  the cache file is created (or refreshed). On failure, ctf_parse_cleanup()
+ *  must still be called.
+ *
+ *  \param filename   The TSDL file.
+ *  \param cachefile  The full path to the cache file. This parameter may be
+ *                    NULL, in which case the TSDL file is always parsed.
+ *
+ *  \return 1 on success, 0 if one or more errors were found.
+ */
+int ctf_parse_cached(const char *filename, const char *cachefile)
+{
+  uint32_t size;
+  uint64_t hash;
+
+  assert(filename != NULL);
+  if (cachefile == NULL || *cachefile == '\0' || !cache_filekey(filename, &size, &hash))
+    return ctf_parse_init(filename) && ctf_parse_run();
+  if (cache_load(cachefile, size, hash))
+    return 1;
+  if (!ctf_parse_init(filename) || !ctf_parse_run())
+    return 0;
+  cache_save(cachefile, size, hash);
+  return 1;
+}
+
+/** ctf_model_create() allocates a new (empty) model for a TSDL file. The
+ *  functions in this module work on the default model, but a thread can switch
+ *  to a different model with ctf_model_select(), for example to parse and
+ *  decode several trace streams from separate threads.
+ *
+ *  \return The new model, or NULL on failure.
+ */
+CTF_MODEL *ctf_model_create(void)
+{
+  CTF_MODEL *tsdl = (CTF_MODEL*)malloc(sizeof(CTF_MODEL));
+  if (tsdl != NULL) {
+    memset(tsdl, 0, sizeof(CTF_MODEL));
+    tsdl->recent_token.id = TOK_NONE;
+    tsdl->recent_error = -1;
+  }
+  return tsdl;
+}
+
+/** ctf_model_delete() frees a model, including all parsed definitions in it.
+ *  The model may not be selected in another thread.
+ */
+void ctf_model_delete(CTF_MODEL *tsdl)
+{
+  CTF_MODEL *prev = current_model;
+  assert(tsdl != NULL && tsdl != &default_model);
+  current_model = tsdl;
+  ctf_parse_cleanup();
+  current_model = (prev != tsdl) ? prev : NULL;
+  free((void*)tsdl);
+}
+
+/** ctf_model_select() selects the model for the calling thread. Pass NULL to
+ *  return to the default model (which is shared by all threads that have not
+ *  selected a model of their own).
+ */
+void ctf_model_select(CTF_MODEL *tsdl)
+{
+  current_model = tsdl;
+}
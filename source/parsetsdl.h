@@ -133,6 +133,7 @@ typedef struct tagCTF_STREAM {
   char name[CTF_NAME_LENGTH];
   CTF_EVENT_HEADER event;
   CTF_TYPE *clock;
+  const CTF_CLOCK *clock_map; /* clock that "clock" is mapped to (set after parsing) */
 } CTF_STREAM;
 
 typedef struct tagCTF_EVENT_FIELD {
@@ -150,10 +151,12 @@ typedef struct tagCTF_EVENT {
   CTF_EVENT_FIELD field_root;
 } CTF_EVENT;
 
+typedef struct tagCTF_MODEL CTF_MODEL;
 
 int ctf_error_notify(int code, int linenr, const char *message); /* must be implemented in the calling application */
 
 const CTF_PACKET_HEADER *packet_header(void);
+const CTF_TRACE_GLOBAL *trace_global(void);
 
 const CTF_CLOCK *clock_by_name(const char *name);
 const CTF_CLOCK *clock_by_seqnr(int seqnr);
@@ -171,6 +174,11 @@ const CTF_EVENT *event_by_id(int event_id);
 int ctf_parse_init(const char *filename);
 void ctf_parse_cleanup(void);
 int ctf_parse_run(void);
+int ctf_parse_cached(const char *filename, const char *cachefile);
+
+CTF_MODEL *ctf_model_create(void);
+void ctf_model_delete(CTF_MODEL *tsdl);
+void ctf_model_select(CTF_MODEL *tsdl);
 
 #endif /* _PARSETSDL_H */
 
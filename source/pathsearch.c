@@ -1,5 +1,5 @@
 /*
- * Searching the path for a filename.
+ * Searching the path for a filename, with a cache of resolved paths.
  *
  * Copyright 2023 CompuPhase
  *
@@ -58,6 +58,38 @@
 # define DIRSEP_STR "/"
 #endif
 
+typedef struct tagPATHCACHE {
+  struct tagPATHCACHE *next;
+  int kind;
+  char *name;
+  char *path;         /* empty if the file was not found */
+} PATHCACHE;
+
+static PATHCACHE cache_root = { NULL };
+
+static PATHCACHE *cache_find(int kind, const char *name)
+{
+  assert(name != NULL);
+  for (PATHCACHE *item = cache_root.next; item != NULL; item = item->next)
+    if (item->kind == kind && strcmp(item->name, name) == 0)
+      return item;
+  return NULL;
+}
+
+static void cache_remove(int kind, const char *name)
+{
+  for (PATHCACHE *prev = &cache_root; prev->next != NULL; prev = prev->next) {
+    PATHCACHE *item = prev->next;
+    if (item->kind == kind && strcmp(item->name, name) == 0) {
+      prev->next = item->next;
+      free((void*)item->name);
+      free((void*)item->path);
+      free((void*)item);
+      return;
+    }
+  }
+}
+
 /** pathsearch() locates a file in the path.
  *  \param buffer   [out] Contains the full path of the file on return, if the
  *                  file is found.
@@ -76,28 +108,160 @@ bool pathsearch(char *buffer, size_t bufsize, const char *filename)
   if (strlen(filename) == 0)
     return false;
 
+  /* a cached result needs only a single check (and a file that was not
+     found before is not searched for again in this session) */
+  const PATHCACHE *item = cache_find(PATHCACHE_TOOL, filename);
+  if (item != NULL) {
+    if (strlen(item->path) == 0)
+      return false;
+    if (access(item->path, 0) == 0) {
+      if (strlen(item->path) >= bufsize)
+        return false;
+      strlcpy(buffer, item->path, bufsize);
+      return true;
+    }
+    cache_remove(PATHCACHE_TOOL, filename);
+  }
+
   char *temp_env = getenv("PATH");
   if (temp_env == NULL)
     return false;
   char *env = strdup(temp_env);
+  if (env == NULL)
+    return false;
 
   bool result = false;
+  char path[_MAX_PATH] = "";
   for (char *tok = strtok(env, SEPARATOR); tok != NULL; tok = strtok(NULL, SEPARATOR)) {
-    char path[_MAX_PATH];
     strlcpy(path, tok, sizearray(path));
     size_t len = strlen(path);
     assert(len < sizearray(path));
     if (len > 0 && path[len - 1] != DIRSEP_CHR)
       strlcat(path, DIRSEP_STR, sizearray(path));
     strlcat(path, filename, sizearray(path));
-    if (access(path, 0) == 0 && strlen(path) < bufsize) {
-      strlcpy(buffer, path, bufsize);
+    if (access(path, 0) == 0) {
       result = true;
       break;
     }
   }
-
   free(env);
-  return result;
+
+  pathcache_store(PATHCACHE_TOOL, filename, result ? path : "");
+  if (!result || strlen(path) >= bufsize)
+    return false;
+  strlcpy(buffer, path, bufsize);
+  return true;
+}
+
+/** pathcache_lookup() returns a path from the cache, after checking that the
+ *  file still exists.
+ *  \param kind     PATHCACHE_TOOL or PATHCACHE_FILE.
+ *  \param name     [in] The name under which the path was stored.
+ *  \param buffer   [out] Contains the path on return, if found.
+ *  \param bufsize  The size in characters of the buffer.
+ *  \return true on success, false if the name is not in the cache, or if the
+ *          file no longer exists (in which case the entry is removed).
+ */
+bool pathcache_lookup(int kind, const char *name, char *buffer, size_t bufsize)
+{
+  assert(name != NULL);
+  assert(buffer != NULL && bufsize > 0);
+  const PATHCACHE *item = cache_find(kind, name);
+  if (item == NULL || strlen(item->path) == 0)
+    return false;
+  if (access(item->path, 0) != 0) {
+    cache_remove(kind, name);
+    return false;
+  }
+  if (strlen(item->path) >= bufsize)
+    return false;
+  strlcpy(buffer, item->path, bufsize);
+  return true;
+}
+
+/** pathcache_store() adds a name & path to the cache, or replaces the path of
+ *  an existing entry.
+ *  \param kind     PATHCACHE_TOOL or PATHCACHE_FILE.
+ *  \param name     [in] The name to store the path under.
+ *  \param path     [in] The resolved path; an empty string records that the
+ *                  file was not found.
+ */
+void pathcache_store(int kind, const char *name, const char *path)
+{
+  assert(name != NULL && path != NULL);
+  char *newpath = strdup(path);
+  if (newpath == NULL)
+    return;
+  PATHCACHE *item = cache_find(kind, name);
+  if (item != NULL) {
+    free((void*)item->path);
+    item->path = newpath;
+    return;
+  }
+  if ((item = malloc(sizeof(PATHCACHE))) == NULL || (item->name = strdup(name)) == NULL) {
+    if (item != NULL)
+      free((void*)item);
+    free((void*)newpath);
+    return;
+  }
+  item->kind = kind;
+  item->path = newpath;
+  item->next = cache_root.next;
+  cache_root.next = item;
+}
+
+/** pathcache_entry() returns an entry from the cache, for storing the cache in
+ *  a configuration file. Entries for files that were not found are skipped.
+ *  \param kind     PATHCACHE_TOOL or PATHCACHE_FILE.
+ *  \param index    The sequence number of the entry, starting at 0.
+ *  \param name     [out] The name of the entry.
+ *  \param path     [out] The path of the entry.
+ *  \return true on success, false if the index is out of range.
+ */
+bool pathcache_entry(int kind, unsigned index, const char **name, const char **path)
+{
+  assert(name != NULL && path != NULL);
+  for (const PATHCACHE *item = cache_root.next; item != NULL; item = item->next) {
+    if (item->kind != kind || strlen(item->path) == 0)
+      continue;
+    if (index == 0) {
+      *name = item->name;
+      *path = item->path;
+      return true;
+    }
+    index--;
+  }
+  return false;
+}
+
+/** pathcache_signature() returns a hash of the PATH environment variable.
+ *  \note A cache of tool locations that is restored from a configuration file
+ *        is only valid if the PATH is still the same; the signature should be
+ *        stored with the cache and compared on loading it.
+ */
+unsigned long pathcache_signature(void)
+{
+  const char *env = getenv("PATH");
+  unsigned long hash = 2166136261uL;  /* FNV-1a */
+  if (env != NULL) {
+    while (*env != '\0') {
+      hash = (hash ^ (unsigned char)*env++) * 16777619uL;
+      hash &= 0xffffffffuL;
+    }
+  }
+  return hash;
+}
+
+/** pathcache_clear() removes all entries from the cache.
+ */
+void pathcache_clear(void)
+{
+  while (cache_root.next != NULL) {
+    PATHCACHE *item = cache_root.next;
+    cache_root.next = item->next;
+    free((void*)item->name);
+    free((void*)item->path);
+    free((void*)item);
+  }
 }
 
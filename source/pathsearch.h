@@ -1,5 +1,5 @@
 /*
- * Searching the path for a filename.
+ * Searching the path for a filename, with a cache of resolved paths.
  *
  * Copyright 2023 CompuPhase
  *
@@ -20,6 +20,17 @@
 
 #include <stdbool.h>
 
+enum {
+  PATHCACHE_TOOL,   /* executables found in the PATH (see pathsearch()) */
+  PATHCACHE_FILE,   /* other files, located by the application */
+};
+
 bool pathsearch(char *buffer, size_t bufsize, const char *filename);
 
+bool pathcache_lookup(int kind, const char *name, char *buffer, size_t bufsize);
+void pathcache_store(int kind, const char *name, const char *path);
+bool pathcache_entry(int kind, unsigned index, const char **name, const char **path);
+unsigned long pathcache_signature(void);
+void pathcache_clear(void);
+
 #endif /* _PATHSEARCH_H */
@@ -0,0 +1,247 @@
+/*
+ * Lightweight instrumentation: named counters, gauges and timers, that can
+ * be updated from any thread at low cost, plus a snapshot of all values.
+ *
+ * Every thread updates its own block of slots (the blocks are a multiple of
+ * the cache line size, so that threads do not contend for cache lines). A
+ * thread claims a block on its first update; when there are more threads
+ * than blocks, threads share a block, which is why all updates are atomic
+ * (without contention, an atomic add costs little more than a plain add).
+ * The snapshot sums the blocks.
+ *
+ * Copyright 2026 CompuPhase
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <assert.h>
+#include <string.h>
+#include <time.h>
+#if defined _WIN32
+# define STRICT
+# define WIN32_LEAN_AND_MEAN
+# include <windows.h>
+#endif
+#include "perfstats.h"
+
+#if defined FORTIFY
+# include <alloc/fortify.h>
+#endif
+
+#define PERF_MAXMETRICS 64
+#define PERF_MAXTHREADS 16
+#define PERF_CACHELINE  64
+
+#if defined __GNUC__
+# define PERF_ADD(v,x)        __atomic_fetch_add(&(v), (x), __ATOMIC_RELAXED)
+# define PERF_LOAD(v)         __atomic_load_n(&(v), __ATOMIC_RELAXED)
+# define PERF_STORE(v,x)      __atomic_store_n(&(v), (x), __ATOMIC_RELAXED)
+# define PERF_CAS(v,old,x)    __atomic_compare_exchange_n(&(v), &(old), (x), 1, __ATOMIC_RELAXED, __ATOMIC_RELAXED)
+# define PERF_LOCK(v)         while (__atomic_exchange_n(&(v), 1, __ATOMIC_ACQUIRE)) {}
+# define PERF_UNLOCK(v)       __atomic_store_n(&(v), 0, __ATOMIC_RELEASE)
+# define PERF_ALIGNED         __attribute__((aligned(PERF_CACHELINE)))
+# define PERF_THREADLOCAL     __thread
+#elif defined _MSC_VER
+# define PERF_ADD(v,x)        InterlockedExchangeAdd64((volatile LONG64*)&(v), (LONG64)(x))
+# define PERF_LOAD(v)         InterlockedCompareExchange64((volatile LONG64*)&(v), 0, 0)
+# define PERF_STORE(v,x)      InterlockedExchange64((volatile LONG64*)&(v), (LONG64)(x))
+  static int perf_cas64(volatile LONG64 *v, unsigned long long *old, unsigned long long x)
+  {
+    LONG64 prev = InterlockedCompareExchange64(v, (LONG64)x, (LONG64)*old);
+    if (prev == (LONG64)*old)
+      return 1;
+    *old = (unsigned long long)prev;
+    return 0;
+  }
+# define PERF_CAS(v,old,x)    perf_cas64((volatile LONG64*)&(v), &(old), (x))
+# define PERF_LOCK(v)         while (InterlockedExchange((volatile LONG*)&(v), 1)) {}
+# define PERF_UNLOCK(v)       InterlockedExchange((volatile LONG*)&(v), 0)
+# define PERF_ALIGNED         __declspec(align(PERF_CACHELINE))
+# define PERF_THREADLOCAL     __declspec(thread)
+#endif
+
+typedef struct tagPERF_SLOT {
+  long long value;              /* sum (counters and timers) */
+  unsigned long long count;
+  unsigned long long inv_min;   /* bitwise inverse of the minimum, so that 0 means "not set" */
+  unsigned long long maximum;
+} PERF_SLOT;
+
+typedef struct tagPERF_BLOCK {
+  PERF_SLOT slots[PERF_MAXMETRICS];
+} PERF_BLOCK;
+
+typedef struct tagPERF_METRIC {
+  const char *name;
+  int type;
+  long long gauge;              /* gauges are not per thread */
+} PERF_METRIC;
+
+static PERF_ALIGNED PERF_BLOCK perf_blocks[PERF_MAXTHREADS];
+static PERF_METRIC perf_metrics[PERF_MAXMETRICS];
+static long long perf_metriccount = 0;
+static int perf_lock = 0;
+static long long perf_threadcount = 0;
+static PERF_THREADLOCAL PERF_BLOCK *perf_threadblock = NULL;
+
+/* perf_block() returns the block of slots for the calling thread */
+static PERF_BLOCK *perf_block(void)
+{
+  if (perf_threadblock == NULL) {
+    int idx = (int)PERF_ADD(perf_threadcount, 1);
+    perf_threadblock = &perf_blocks[idx % PERF_MAXTHREADS];
+  }
+  return perf_threadblock;
+}
+
+/** perf_register() returns the identifier for a named metric, and creates it
+ *  if it does not exist yet.
+ *
+ *  \param name   The name of the metric. This string must remain valid for
+ *                the lifetime of the program (a string literal), because no
+ *                copy is made.
+ *  \param type   PERF_COUNTER, PERF_GAUGE or PERF_TIMER.
+ *
+ *  \return The identifier, or -1 if the table is full (in which case the
+ *          update functions silently ignore the identifier).
+ */
+int perf_register(const char *name, int type)
+{
+  assert(name != NULL);
+  assert(type == PERF_COUNTER || type == PERF_GAUGE || type == PERF_TIMER);
+  int id;
+  PERF_LOCK(perf_lock);
+  for (id = 0; id < perf_metriccount && strcmp(perf_metrics[id].name, name) != 0; id++)
+    {}
+  if (id == perf_metriccount) {
+    if (id < PERF_MAXMETRICS) {
+      perf_metrics[id].name = name;
+      perf_metrics[id].type = type;
+      PERF_STORE(perf_metriccount, id + 1);
+    } else {
+      id = -1;
+    }
+  }
+  PERF_UNLOCK(perf_lock);
+  return id;
+}
+
+/** perf_count() adds a value to a counter.
+ */
+void perf_count(int id, long delta)
+{
+  if (id < 0)
+    return;
+  assert(id < PERF_MAXMETRICS);
+  PERF_SLOT *slot = &perf_block()->slots[id];
+  PERF_ADD(slot->value, delta);
+  PERF_ADD(slot->count, 1);
+}
+
+/** perf_gauge() sets the value of a gauge.
+ */
+void perf_gauge(int id, long long value)
+{
+  if (id < 0)
+    return;
+  assert(id < PERF_MAXMETRICS);
+  PERF_STORE(perf_metrics[id].gauge, value);
+}
+
+/** perf_timestamp() returns a timestamp in nanoseconds, for use with
+ *  perf_timer(). This is also the common time base for captured data:
+ *  get_timestamp() (SWO trace) and rs232_timestamp() (serial ports) are
+ *  derived from it, so their timestamps can be compared directly.
+ */
+unsigned long long perf_timestamp(void)
+{
+# if defined _WIN32
+    static LARGE_INTEGER freq;
+    LARGE_INTEGER count;
+    if (freq.QuadPart == 0)
+      QueryPerformanceFrequency(&freq);
+    QueryPerformanceCounter(&count);
+    return (unsigned long long)(count.QuadPart / freq.QuadPart) * 1000000000
+           + (unsigned long long)((count.QuadPart % freq.QuadPart) * 1000000000 / freq.QuadPart);
+# else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (unsigned long long)ts.tv_sec * 1000000000 + ts.tv_nsec;
+# endif
+}
+
+/** perf_timer() adds the time elapsed since "start" to a timer.
+ *
+ *  \param id     The metric identifier.
+ *  \param start  The value that perf_timestamp() returned at the start of
+ *                the interval.
+ */
+void perf_timer(int id, unsigned long long start)
+{
+  if (id < 0)
+    return;
+  assert(id < PERF_MAXMETRICS);
+  unsigned long long elapsed = perf_timestamp() - start;
+  PERF_SLOT *slot = &perf_block()->slots[id];
+  PERF_ADD(slot->value, (long long)elapsed);
+  PERF_ADD(slot->count, 1);
+  unsigned long long cur = PERF_LOAD(slot->maximum);
+  while (elapsed > cur && !PERF_CAS(slot->maximum, cur, elapsed))
+    {}
+  cur = PERF_LOAD(slot->inv_min);
+  while (~elapsed > cur && !PERF_CAS(slot->inv_min, cur, ~elapsed))
+    {}
+}
+
+/** perf_snapshot() collects the current values of all metrics, in the order
+ *  of registration. The values are read while other threads may update
+ *  them, so a snapshot is not an atomic capture of all metrics together.
+ *
+ *  \param list      [out] Filled with the values.
+ *  \param maxcount  The number of entries that "list" can hold.
+ *
+ *  \return The number of entries stored in "list".
+ */
+int perf_snapshot(PERF_SNAPSHOT *list, int maxcount)
+{
+  assert(list != NULL || maxcount == 0);
+  int count = (int)PERF_LOAD(perf_metriccount);
+  if (count > maxcount)
+    count = maxcount;
+  int blocks = (int)PERF_LOAD(perf_threadcount);
+  if (blocks > PERF_MAXTHREADS)
+    blocks = PERF_MAXTHREADS;
+  for (int id = 0; id < count; id++) {
+    PERF_SNAPSHOT *item = &list[id];
+    memset(item, 0, sizeof(PERF_SNAPSHOT));
+    item->name = perf_metrics[id].name;
+    item->type = perf_metrics[id].type;
+    if (item->type == PERF_GAUGE) {
+      item->value = PERF_LOAD(perf_metrics[id].gauge);
+      continue;
+    }
+    unsigned long long inv_min = 0;
+    for (int b = 0; b < blocks; b++) {
+      PERF_SLOT *slot = &perf_blocks[b].slots[id];
+      item->value += PERF_LOAD(slot->value);
+      item->count += PERF_LOAD(slot->count);
+      unsigned long long v = PERF_LOAD(slot->maximum);
+      if (v > item->maximum)
+        item->maximum = v;
+      v = PERF_LOAD(slot->inv_min);
+      if (v > inv_min)
+        inv_min = v;
+    }
+    item->minimum = (inv_min != 0) ? ~inv_min : 0;
+  }
+  return count;
+}
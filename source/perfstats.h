@@ -0,0 +1,72 @@
+/*
+ * Lightweight instrumentation: named counters, gauges and timers, that can
+ * be updated from any thread at low cost, plus a snapshot of all values.
+ *
+ * Copyright 2026 CompuPhase
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef _PERFSTATS_H
+#define _PERFSTATS_H
+
+#if defined __cplusplus
+  extern "C" {
+#endif
+
+enum {
+  PERF_COUNTER,     /* sum of all increments */
+  PERF_GAUGE,       /* most recently set value */
+  PERF_TIMER,       /* number of samples, total, minimum & maximum duration (ns) */
+};
+
+typedef struct tagPERF_SNAPSHOT {
+  const char *name;
+  int type;
+  long long value;              /* counter sum, gauge value or total time (ns) */
+  unsigned long long count;     /* number of updates (counters & timers) */
+  unsigned long long minimum;   /* timers only (ns) */
+  unsigned long long maximum;   /* timers only (ns) */
+} PERF_SNAPSHOT;
+
+int  perf_register(const char *name, int type);
+void perf_count(int id, long delta);
+void perf_gauge(int id, long long value);
+unsigned long long perf_timestamp(void);
+void perf_timer(int id, unsigned long long start);
+int  perf_snapshot(PERF_SNAPSHOT *list, int maxcount);
+
+/* The macros cache the identifier for the name in a static variable at the
+   call site, so that the name is only looked up on the first call. */
+#define PERF_COUNT(name, delta) \
+  do { static int perf_id_ = -1; \
+       if (perf_id_ < 0) perf_id_ = perf_register((name), PERF_COUNTER); \
+       perf_count(perf_id_, (delta)); } while (0)
+#define PERF_GAUGE(name, val) \
+  do { static int perf_id_ = -1; \
+       if (perf_id_ < 0) perf_id_ = perf_register((name), PERF_GAUGE); \
+       perf_gauge(perf_id_, (val)); } while (0)
+
+/* PERF_TIMER_BEGIN() and PERF_TIMER_END() must appear in the same scope */
+#define PERF_TIMER_BEGIN(var) \
+  unsigned long long var = perf_timestamp()
+#define PERF_TIMER_END(var, name) \
+  do { static int perf_id_ = -1; \
+       if (perf_id_ < 0) perf_id_ = perf_register((name), PERF_TIMER); \
+       perf_timer(perf_id_, (var)); } while (0)
+
+#if defined __cplusplus
+  }
+#endif
+
+#endif /* _PERFSTATS_H */
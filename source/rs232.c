@@ -19,6 +19,7 @@
 #include <errno.h>
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
 #if defined _WIN32
 # include <windows.h>
 #else
@@ -27,10 +28,16 @@
 # include <fcntl.h>
 # include <stdio.h>
 # include <string.h>
+# include <poll.h>
 # include <termios.h>
 # include <unistd.h>
 # include <sys/ioctl.h>
+# if defined __linux__
+#   include <linux/serial.h>
+# endif
 #endif
+#include "c11threads.h"
+#include "perfstats.h"
 #include "rs232.h"
 
 
@@ -39,7 +46,32 @@
 #endif
 #define MAX_COMPORTS  4
 
+#define READER_BUFSIZE  (64*1024) /* size of the queue for received data */
+#define READER_TIMEOUT  50        /* time-out on a read (ms), also the worst-case delay for stopping */
+#define READER_CHUNKS   1024      /* max. number of reads (with their timestamp) in the queue */
+
+typedef struct tagREADCHUNK {
+  size_t size;                  /* number of bytes read in a single call */
+  unsigned long long tstamp;    /* time of the read, in microseconds */
+} READCHUNK;
+
+typedef struct tagREADER {
+  thrd_t thread;
+  mtx_t lock;
+  bool active;                  /* thread was created (and must be joined) */
+  bool quit;                    /* set to stop the thread (protected by the lock) */
+  unsigned char *queue;         /* circular buffer with received data */
+  size_t head;                  /* index of the oldest byte in the queue */
+  size_t length;                /* number of bytes in the queue */
+  READCHUNK chunk[READER_CHUNKS]; /* circular list of the reads that make up the queue */
+  size_t chunkhead;             /* index of the oldest read in the list */
+  size_t chunkcount;            /* number of reads in the list */
+  void (*notify)(void);         /* called when data arrives in an empty queue */
+} READER;
+
 static HCOM comport[MAX_COMPORTS];
+static READER reader[MAX_COMPORTS];
+static long overrun_base[MAX_COMPORTS]; /* last overrun count of the driver (-1 = not yet read) */
 static int initialized = 0;
 
 #if !defined _WIN32
@@ -54,10 +86,42 @@ static void check_init(void)
     int i;
     for (i = 0; i < MAX_COMPORTS; i++)
       comport[i] = INVALID_HANDLE_VALUE;
+    memset(reader, 0, sizeof reader);
     initialized = 1;
   }
 }
 
+/* port_index() returns the index of the port handle in the table, or -1 if
+   the handle is not valid */
+static int port_index(const HCOM *hCom)
+{
+  check_init();
+  for (int i = 0; i < MAX_COMPORTS; i++)
+    if (&comport[i] == hCom)
+      return i;
+  return -1;
+}
+
+/* reader_join() waits for the receive thread to finish, and frees the queue */
+static void reader_join(READER *rd)
+{
+  assert(rd != NULL);
+  if (rd->active) {
+    mtx_lock(&rd->lock);
+    rd->quit = true;
+    mtx_unlock(&rd->lock);
+    thrd_join(rd->thread, NULL);
+    mtx_destroy(&rd->lock);
+    rd->active = false;
+  }
+  if (rd->queue != NULL) {
+    free((void*)rd->queue);
+    rd->queue = NULL;
+  }
+  rd->head = rd->length = 0;
+  rd->chunkhead = rd->chunkcount = 0;
+}
+
 /** rs232_open() opens the RS232 port and sets the initial parameters.
  *
  *  \param port     Must be set to COM* (where * is a number) in Windows and a
@@ -238,11 +302,24 @@ HCOM* rs232_open(const char *port, unsigned baud, int databits, int stopbits, in
     fcntl(*hCom, F_SETFL,FNDELAY);
 # endif /* _WIN32 */
 
+  overrun_base[hCom - comport] = -1;
   return hCom;
 }
 
 HCOM *rs232_close(HCOM *hCom)
 {
+  int idx = port_index(hCom);
+  if (idx >= 0 && reader[idx].active) {
+    /* when the port is closed from the receive thread itself (on an error),
+       the thread only gets the request to stop; it is joined later */
+    if (thrd_equal(thrd_current(), reader[idx].thread)) {
+      mtx_lock(&reader[idx].lock);
+      reader[idx].quit = true;
+      mtx_unlock(&reader[idx].lock);
+    } else {
+      reader_join(&reader[idx]);
+    }
+  }
   if (rs232_isopen(hCom)) {
 #   if defined _WIN32
       BOOL result = FlushFileBuffers(*hCom);
@@ -319,6 +396,234 @@ size_t rs232_recv(HCOM *hCom, unsigned char *buffer, size_t size)
   return 0;
 }
 
+/** rs232_recvwait() reads from the serial port, but unlike rs232_recv(), it
+ *  waits for data to arrive (up to the timeout). It returns as soon as any data
+ *  is received.
+ *
+ *  \param timeout   The maximum time to wait, in ms. If zero, the function does
+ *                   not wait; if negative, it waits indefinitely.
+ *
+ *  \return The number of bytes received and stored in the buffer.
+ */
+size_t rs232_recvwait(HCOM *hCom, unsigned char *buffer, size_t size, int timeout)
+{
+  if (timeout == 0 || !rs232_isopen(hCom))
+    return rs232_recv(hCom, buffer, size);
+# if defined _WIN32
+    /* with these settings,  ReadFile() returns immediately if there is data in
+       the queue, and otherwise as soon as the first byte arrives (or on
+       time-out) */
+    COMMTIMEOUTS commtimeouts, waittimeouts;
+    GetCommTimeouts(*hCom, &commtimeouts);
+    waittimeouts = commtimeouts;
+    waittimeouts.ReadIntervalTimeout = MAXDWORD;
+    waittimeouts.ReadTotalTimeoutMultiplier = MAXDWORD;
+    waittimeouts.ReadTotalTimeoutConstant = (timeout > 0) ? (DWORD)timeout : MAXDWORD - 1;
+    SetCommTimeouts(*hCom, &waittimeouts);
+    size_t count = rs232_recv(hCom, buffer, size);
+    if (rs232_isopen(hCom))
+      SetCommTimeouts(*hCom, &commtimeouts);
+    return count;
+# else
+    struct pollfd fds;
+    fds.fd = *hCom;
+    fds.events = POLLIN;
+    fds.revents = 0;
+    if (poll(&fds, 1, timeout) <= 0)
+      return 0;
+    return rs232_recv(hCom, buffer, size);
+# endif
+}
+
+static int reader_thread(void *arg)
+{
+  READER *rd = (READER*)arg;
+  assert(rd != NULL);
+  int idx = (int)(rd - reader);
+  assert(idx >= 0 && idx < MAX_COMPORTS);
+  HCOM *hCom = &comport[idx];
+
+  unsigned char buffer[1024];
+  while (rs232_isopen(hCom)) {
+    /* only read as much as fits in the queue */
+    mtx_lock(&rd->lock);
+    bool quit = rd->quit;
+    size_t room = READER_BUFSIZE - rd->length;
+    mtx_unlock(&rd->lock);
+    if (quit)
+      break;
+    if (room == 0) {
+      struct timespec delay = { 0, READER_TIMEOUT * 1000000L };
+      thrd_sleep(&delay, NULL);
+      continue;
+    }
+    if (room > sizeof buffer)
+      room = sizeof buffer;
+    size_t count = rs232_recvwait(hCom, buffer, room, READER_TIMEOUT);
+    if (count == 0)
+      continue;
+    unsigned long long tstamp = rs232_timestamp();
+    mtx_lock(&rd->lock);
+    bool wasempty = (rd->length == 0);
+    assert(rd->length + count <= READER_BUFSIZE);
+    size_t tail = (rd->head + rd->length) % READER_BUFSIZE;
+    size_t part = READER_BUFSIZE - tail;
+    if (part > count)
+      part = count;
+    memcpy(rd->queue + tail, buffer, part);
+    memcpy(rd->queue, buffer + part, count - part);
+    rd->length += count;
+    /* record the read with its timestamp; if the list of reads is full (the
+       receiver lags behind), merge it with the most recent read */
+    if (rd->chunkcount < READER_CHUNKS) {
+      READCHUNK *chunk = &rd->chunk[(rd->chunkhead + rd->chunkcount) % READER_CHUNKS];
+      chunk->size = count;
+      chunk->tstamp = tstamp;
+      rd->chunkcount += 1;
+    } else {
+      rd->chunk[(rd->chunkhead + rd->chunkcount - 1) % READER_CHUNKS].size += count;
+    }
+    mtx_unlock(&rd->lock);
+    /* only signal when data arrives in an empty queue: when the queue was
+       not empty, the receiver has not yet collected the previous batch */
+    if (wasempty && rd->notify != NULL)
+      rd->notify();
+  }
+  return 0;
+}
+
+/** rs232_reader_start() creates a thread that receives data from the port,
+ *  and stores it in a queue; the data is read from this queue with
+ *  rs232_reader_get(). The thread is stopped when the port is closed.
+ *
+ *  \param hCom     Port handle.
+ *  \param notify   Optional function that is called (from the receive thread)
+ *                  when new data arrives, while the queue was empty.
+ *
+ *  \return true on success, false on failure.
+ */
+bool rs232_reader_start(HCOM *hCom, void (*notify)(void))
+{
+  if (!rs232_isopen(hCom))
+    return false;
+  int idx = port_index(hCom);
+  assert(idx >= 0);
+  READER *rd = &reader[idx];
+  reader_join(rd);  /* clean up any previous thread that stopped on an error */
+  rd->queue = malloc(READER_BUFSIZE * sizeof(unsigned char));
+  if (rd->queue == NULL)
+    return false;
+  rd->head = rd->length = 0;
+  rd->chunkhead = rd->chunkcount = 0;
+  rd->notify = notify;
+  rd->quit = false;
+  if (mtx_init(&rd->lock, mtx_plain) != thrd_success) {
+    reader_join(rd);
+    return false;
+  }
+  if (thrd_create(&rd->thread, reader_thread, rd) != thrd_success) {
+    mtx_destroy(&rd->lock);
+    reader_join(rd);
+    return false;
+  }
+  rd->active = true;
+  return true;
+}
+
+/** rs232_reader_stop() stops the receive thread (if one is active), and
+ *  drops any data that was not yet collected.
+ */
+void rs232_reader_stop(HCOM *hCom)
+{
+  int idx = port_index(hCom);
+  if (idx >= 0)
+    reader_join(&reader[idx]);
+}
+
+/** rs232_reader_get() copies received data from the queue of the receive
+ *  thread and removes it from the queue. If no receive thread is active for
+ *  the port, the function reads from the port directly, like rs232_recv().
+ *
+ *  \return The number of bytes stored in the buffer.
+ */
+size_t rs232_reader_get(HCOM *hCom, unsigned char *buffer, size_t size)
+{
+  int idx = port_index(hCom);
+  if (idx < 0 || !reader[idx].active)
+    return rs232_recv(hCom, buffer, size);
+  READER *rd = &reader[idx];
+  mtx_lock(&rd->lock);
+  size_t count = (size < rd->length) ? size : rd->length;
+  size_t part = READER_BUFSIZE - rd->head;
+  if (part > count)
+    part = count;
+  memcpy(buffer, rd->queue + rd->head, part);
+  memcpy(buffer + part, rd->queue, count - part);
+  rd->head = (rd->head + count) % READER_BUFSIZE;
+  rd->length -= count;
+  /* drop the reads that were fully copied, and shrink a partially copied one */
+  size_t remaining = count;
+  while (remaining > 0) {
+    assert(rd->chunkcount > 0);
+    READCHUNK *chunk = &rd->chunk[rd->chunkhead];
+    if (chunk->size > remaining) {
+      chunk->size -= remaining;
+      break;
+    }
+    remaining -= chunk->size;
+    rd->chunkhead = (rd->chunkhead + 1) % READER_CHUNKS;
+    rd->chunkcount -= 1;
+  }
+  mtx_unlock(&rd->lock);
+  return count;
+}
+
+/** rs232_reader_getchunk() copies the data of the oldest read in the queue of
+ *  the receive thread, and removes it from the queue. If the buffer is too
+ *  small, the remainder of the read stays in the queue. If no receive thread
+ *  is active for the port, the function reads from the port directly.
+ *
+ *  \param hCom     Port handle.
+ *  \param buffer   The buffer for the data.
+ *  \param size     The size of the buffer in bytes.
+ *  \param tstamp   Set to the time of the read (in microseconds, see
+ *                  rs232_timestamp()).
+ *
+ *  \return The number of bytes stored in the buffer.
+ */
+size_t rs232_reader_getchunk(HCOM *hCom, unsigned char *buffer, size_t size, unsigned long long *tstamp)
+{
+  assert(tstamp != NULL);
+  int idx = port_index(hCom);
+  if (idx < 0 || !reader[idx].active) {
+    *tstamp = rs232_timestamp();
+    return rs232_recv(hCom, buffer, size);
+  }
+  READER *rd = &reader[idx];
+  mtx_lock(&rd->lock);
+  size_t count = 0;
+  if (rd->chunkcount > 0) {
+    count = rd->chunk[rd->chunkhead].size;
+    *tstamp = rd->chunk[rd->chunkhead].tstamp;
+  }
+  mtx_unlock(&rd->lock);
+  if (count > size)
+    count = size;
+  /* only the receive thread adds data, so the chunk cannot shrink meanwhile */
+  return (count > 0) ? rs232_reader_get(hCom, buffer, count) : 0;
+}
+
+/** rs232_timestamp() returns the value of a monotonic clock, in microseconds.
+ *  This is the clock that the receive thread uses for the timestamps of the
+ *  reads. It is the shared time base of perf_timestamp() (which is also the
+ *  clock of the SWO trace), so that serial data can be put on one timeline
+ *  with other captured data.
+ */
+unsigned long long rs232_timestamp(void)
+{
+  return perf_timestamp() / 1000;
+}
+
 void rs232_flush(HCOM *hCom)
 {
   if (rs232_isopen(hCom)) {
@@ -420,6 +725,9 @@ unsigned rs232_getstatus(HCOM *hCom)
         result |= LINESTAT_RI;
       if (flags & MS_RLSD_ON)
         result |= LINESTAT_CD;
+      DWORD errflags = 0;
+      if (ClearCommError(*hCom, &errflags, NULL) && (errflags & (CE_OVERRUN | CE_RXOVER)) != 0)
+        result |= LINESTAT_OVERRUN;
 #   else /* _WIN32 */
       int flags;
       ioctl(*hCom,TIOCMGET,&flags);
@@ -435,6 +743,19 @@ unsigned rs232_getstatus(HCOM *hCom)
         result |= LINESTAT_RI;
       if (flags & TIOCM_CD)
         result |= LINESTAT_CD;
+#     if defined TIOCGICOUNT
+        /* the driver counts overruns (of the UART and of its buffer) since it
+           was loaded, so compare the count against the previous call */
+        struct serial_icounter_struct icount;
+        if (ioctl(*hCom, TIOCGICOUNT, &icount) == 0) {
+          int idx = port_index(hCom);
+          assert(idx >= 0);
+          long overruns = (long)icount.overrun + icount.buf_overrun;
+          if (overrun_base[idx] >= 0 && overruns != overrun_base[idx])
+            result |= LINESTAT_OVERRUN;
+          overrun_base[idx] = overruns;
+        }
+#     endif
 #   endif /* _WIN32 */
   }
   return result;
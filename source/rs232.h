@@ -53,12 +53,19 @@ enum {
 #define LINESTAT_ERR    0x0040
 #define LINESTAT_BREAK  0x0080  /* remote host sent break */
 #define LINESTAT_LBREAK 0x0100  /* local host sent break */
+#define LINESTAT_OVERRUN 0x0200 /* data was lost (OS or UART buffer overrun) since the previous check */
 
 HCOM*    rs232_open(const char *port, unsigned baud, int databits, int stopbits, int parity, int flowctrl);
 HCOM*    rs232_close(HCOM *hCom);
 bool     rs232_isopen(const HCOM *hCom);
 size_t   rs232_xmit(HCOM *hCom, const unsigned char *buffer, size_t size);
 size_t   rs232_recv(HCOM *hCom, unsigned char *buffer, size_t size);
+size_t   rs232_recvwait(HCOM *hCom, unsigned char *buffer, size_t size, int timeout);
+bool     rs232_reader_start(HCOM *hCom, void (*notify)(void));
+void     rs232_reader_stop(HCOM *hCom);
+size_t   rs232_reader_get(HCOM *hCom, unsigned char *buffer, size_t size);
+size_t   rs232_reader_getchunk(HCOM *hCom, unsigned char *buffer, size_t size, unsigned long long *tstamp);
+unsigned long long rs232_timestamp(void);
 void     rs232_flush(HCOM *hCom);
 size_t   rs232_peek(HCOM *hCom);
 void     rs232_setstatus(HCOM *hCom, int code, int status);
@@ -45,6 +45,7 @@
 #include "bmp-scan.h"
 #include "c11threads.h"
 #include "guidriver.h"
+#include "lz4block.h"
 #include "rs232.h"
 #include "serialmon.h"
 #include "parsetsdl.h"
@@ -63,18 +64,57 @@
 # define sizearray(e)    (sizeof(e) / sizeof((e)[0]))
 #endif
 
+/* The lines are stored in an append-only arena: the text of all lines is
+   stored consecutively in large text blocks, and the line records (with a
+   pointer to the text) are stored in blocks of records. The table with the
+   record blocks has a fixed size, so that records never move: the index of a
+   line directly gives its record. The most recent line is always at the end
+   of the current text block, and it is extended in place.
+   Optionally, a text block is compressed when it is full (it is "sealed"),
+   and the uncompressed text is then dropped. The GUI thread decompresses
+   blocks on demand; the blocks that it reads are "pinned" (in a small LRU
+   set), and the text of a pinned block is not dropped. Pinning and dropping
+   happen under the lock. */
 typedef struct tagSERIALSTRING {
-  struct tagSERIALSTRING *next;
-  char *text;
+  struct tagTEXTBLOCK *block;   /* text block that holds the line */
+  unsigned offset;        /* position of the text in the block */
   unsigned short length;
-  unsigned short flags; /* used to keep state while decoding plain trace messages */
+  double timestamp;       /* time of the read that started the line (seconds) */
 } SERIALSTRING;
 
-
 #define SERIALSTRING_MAXLENGTH 256
-static SERIALSTRING sermon_root = { NULL, NULL };
-static SERIALSTRING *sermon_tail = NULL;
-static SERIALSTRING *sermon_head = NULL;
+#define SERMON_BLOCKLINES     1024
+#define SERMON_MAXBLOCKS      4096
+#define SERMON_BLOCKTEXT      (64*1024)
+
+typedef struct tagLINEBLOCK {
+  SERIALSTRING lines[SERMON_BLOCKLINES];
+} LINEBLOCK;
+
+typedef struct tagTEXTBLOCK {
+  struct tagTEXTBLOCK *next;
+  size_t used;            /* number of bytes in use (or reserved for the most recent line) */
+  char *data;             /* SERMON_BLOCKTEXT bytes, NULL if only the compressed text is kept */
+  unsigned char *packed;  /* compressed text of a sealed block (or NULL) */
+  size_t packedsize;
+  bool pinned;            /* text is in use by the GUI thread */
+} TEXTBLOCK;
+
+#define SERMON_LINE(n)  (&sermon_blocks[(n) / SERMON_BLOCKLINES]->lines[(n) % SERMON_BLOCKLINES])
+#define SERMON_TEXT(item) ((item)->block->data + (item)->offset)
+#define SERMON_PINNED   4     /* number of uncompressed blocks that the GUI keeps */
+
+static LINEBLOCK *sermon_blocks[SERMON_MAXBLOCKS];
+static TEXTBLOCK *textblock_root = NULL, *textblock_cur = NULL;
+static unsigned sermon_count = 0;     /* number of lines, including the most recent (incomplete) line */
+static bool sermon_linedone = true;   /* the next character starts a new line */
+static unsigned sermon_head = 0;      /* index of the next line for sermon_next() */
+static bool sermon_compress = false;  /* compress sealed text blocks */
+static TEXTBLOCK *pinned[SERMON_PINNED];  /* uncompressed blocks in use (GUI side, locked) */
+static unsigned pinned_next = 0;      /* slot in the set that is replaced next */
+static TEXTBLOCK *pinned_recent = NULL; /* block of the most recent look-up (GUI side) */
+static mtx_t sermon_lock;             /* adding lines versus clearing the list */
+static once_flag sermon_lockinit = ONCE_FLAG_INIT;
 static HCOM* hCom;
 static char comport[64] = "";
 static int baudrate = 0;
@@ -84,106 +124,204 @@ static thrd_t serial_thread;
 static bool serial_thread_valid = false;
 
 
-static void sermon_addstring(const unsigned char *buffer, size_t length)
+static void sermon_initlock(void)
+{
+  mtx_init(&sermon_lock, mtx_plain);
+}
+
+/* textblock_seal() compresses a full text block, and drops the uncompressed
+   text unless the GUI thread uses it (called with the lock held) */
+static void textblock_seal(TEXTBLOCK *block)
+{
+  static unsigned char scratch[LZ4_BOUND(SERMON_BLOCKTEXT)];
+  assert(block != NULL && block->data != NULL && block->packed == NULL);
+  size_t size = lz4_compress((const unsigned char*)block->data, block->used, scratch, sizeof scratch);
+  if (size == 0 || size > block->used - block->used / 8)
+    return;   /* not worth it */
+  if ((block->packed = malloc(size)) == NULL)
+    return;
+  memcpy(block->packed, scratch, size);
+  block->packedsize = size;
+  if (!block->pinned) {
+    free((void*)block->data);
+    block->data = NULL;
+  }
+}
+
+/* textblock_pin() makes sure that the text of a block is available for the
+   GUI thread; it returns false on failure */
+static bool textblock_pin(TEXTBLOCK *block)
+{
+  assert(block != NULL);
+  bool result = true;
+  call_once(&sermon_lockinit, sermon_initlock);
+  mtx_lock(&sermon_lock);
+  if (!block->pinned) {
+    TEXTBLOCK *old = pinned[pinned_next];
+    if (old != NULL) {
+      old->pinned = false;
+      if (old->packed != NULL && old != textblock_cur) {
+        free((void*)old->data);
+        old->data = NULL;
+      }
+    }
+    pinned[pinned_next] = block;
+    pinned_next = (pinned_next + 1) % SERMON_PINNED;
+    block->pinned = true;
+  }
+  if (block->data == NULL) {
+    assert(block->packed != NULL);
+    block->data = malloc(SERMON_BLOCKTEXT);
+    if (block->data == NULL
+        || lz4_decompress(block->packed, block->packedsize, (unsigned char*)block->data, SERMON_BLOCKTEXT) != block->used)
+    {
+      free((void*)block->data);
+      block->data = NULL;
+      result = false;
+    }
+  }
+  mtx_unlock(&sermon_lock);
+  return result;
+}
+
+/* sermon_text() returns the text of a line (GUI side) */
+static const char *sermon_text(const SERIALSTRING *item)
+{
+  assert(item != NULL && item->block != NULL);
+  if (item->block != pinned_recent) {
+    if (!textblock_pin(item->block))
+      return "";
+    pinned_recent = item->block;
+  }
+  return SERMON_TEXT(item);
+}
+
+/* sermon_newline() adds a line with room for "size" characters (plus the
+   zero terminator); it returns NULL on failure */
+static SERIALSTRING *sermon_newline(size_t size, double timestamp)
+{
+  assert(size < SERMON_BLOCKTEXT);
+  if (sermon_count >= SERMON_BLOCKLINES * SERMON_MAXBLOCKS)
+    return NULL;
+
+  /* the previous line is complete, release the space that it did not use */
+  if (sermon_count > 0) {
+    const SERIALSTRING *prev = SERMON_LINE(sermon_count - 1);
+    assert(textblock_cur != NULL && prev->block == textblock_cur);
+    assert(prev->offset < SERMON_BLOCKTEXT);
+    textblock_cur->used = prev->offset + prev->length + 1;
+  }
+
+  unsigned slot = sermon_count / SERMON_BLOCKLINES;
+  if (sermon_blocks[slot] == NULL && (sermon_blocks[slot] = malloc(sizeof(LINEBLOCK))) == NULL)
+    return NULL;
+
+  size += 1;  /* for the zero terminator */
+  if (textblock_cur == NULL || textblock_cur->used + size > SERMON_BLOCKTEXT) {
+    TEXTBLOCK *block = malloc(sizeof(TEXTBLOCK));
+    if (block == NULL)
+      return NULL;
+    if ((block->data = malloc(SERMON_BLOCKTEXT)) == NULL) {
+      free((void*)block);
+      return NULL;
+    }
+    block->next = NULL;
+    block->used = 0;
+    block->packed = NULL;
+    block->packedsize = 0;
+    block->pinned = false;
+    if (textblock_cur != NULL) {
+      textblock_cur->next = block;
+      if (sermon_compress)
+        textblock_seal(textblock_cur);
+    } else {
+      textblock_root = block;
+    }
+    textblock_cur = block;
+  }
+
+  SERIALSTRING *item = SERMON_LINE(sermon_count);
+  item->block = textblock_cur;
+  item->offset = (unsigned)textblock_cur->used;
+  SERMON_TEXT(item)[0] = '\0';
+  item->length = 0;
+  item->timestamp = timestamp;
+  textblock_cur->used += size;
+  sermon_count += 1;
+  return item;
+}
+
+static void sermon_addstring(const unsigned char *buffer, size_t length, double timestamp)
 {
   assert(buffer != NULL);
   assert(length > 0);
 
+  call_once(&sermon_lockinit, sermon_initlock);
+  mtx_lock(&sermon_lock);
   if (tdsl_metadata[0] != '\0') {
     /* CTF mode */
     int count = ctf_decode(buffer, length, 0);
     if (count > 0) {
       const char *message;
-      while (msgstack_peek(NULL, NULL, &message)) {
-        SERIALSTRING *item = malloc(sizeof(SERIALSTRING));
+      size_t length;
+      while (msgstack_peek(NULL, NULL, &message, &length)) {
+        if (length >= SERMON_BLOCKTEXT)
+          length = SERMON_BLOCKTEXT - 1;
+        SERIALSTRING *item = sermon_newline(length, timestamp);
         if (item != NULL) {
-          memset(item, 0, sizeof(SERIALSTRING));
-          item->length = (unsigned short)strlen(message);
-          item->text = malloc((item->length + 1) * sizeof(unsigned char));
-          if (item->text != NULL) {
-            strcpy(item->text, message);
-            /* append to tail */
-            if (sermon_tail != NULL)
-              sermon_tail->next = item;
-            else
-              sermon_root.next = item;
-            sermon_tail = item;
-          } else {
-            free((void*)item);
-          }
+          memcpy(SERMON_TEXT(item), message, length);
+          SERMON_TEXT(item)[length] = '\0';
+          item->length = (unsigned short)length;
         }
+        sermon_linedone = true;
         msgstack_pop(NULL, NULL, NULL, 0);
       }
     }
   } else {
     /* plain text mode */
-    unsigned idx;
-    for (idx = 0; idx < length; idx++) {
+    SERIALSTRING *tail = (sermon_count > 0) ? SERMON_LINE(sermon_count - 1) : NULL;
+    for (unsigned idx = 0; idx < length; idx++) {
       unsigned ch = buffer[idx];
       if (ch == '\0')
         ch = '\1';
-      /* see whether to append to the recent string, or to add a new string */
-      if (sermon_tail != NULL) {
-        if (ch == '\r' || ch == '\n') {
-          sermon_tail->flags |= 0x01;  /* on newline, create a new string */
-          continue;
-        } else if (sermon_tail->length >= (SERIALSTRING_MAXLENGTH-1)) {
-          sermon_tail->flags |= 0x01;  /* line length limit */
-        }
+      if (ch == '\r' || ch == '\n') {
+        sermon_linedone = true;  /* on newline, create a new string (but not an empty one) */
+        continue;
       }
-
-      if (sermon_tail != NULL && (sermon_tail->flags & 0x01) == 0) {
-        /* append text to the current string */
-        assert(sermon_tail->length < SERIALSTRING_MAXLENGTH);
-        sermon_tail->text[sermon_tail->length++] = ch;
-      } else {
-        /* truncate the buffer to the size needed, then create a new string item */
-        SERIALSTRING *item;
-        if (sermon_tail == NULL && (ch == '\r' || ch == '\n'))
-          continue; /* don't create an empty first string */
-        if (sermon_tail != NULL && sermon_tail->length < (SERIALSTRING_MAXLENGTH-1)) {
-          sermon_tail->text = realloc(sermon_tail->text, (sermon_tail->length + 1) * sizeof(char));
-          assert(sermon_tail->text != NULL);              /* shrinking memory should always succeed */
-          sermon_tail->text[sermon_tail->length] = '\0';  /* zero-terminate */
-        }
-        item = malloc(sizeof(SERIALSTRING));
-        if (item != NULL) {
-          memset(item, 0, sizeof(SERIALSTRING));
-          item->text = malloc(SERIALSTRING_MAXLENGTH * sizeof(unsigned char));
-          if (item->text != NULL) {
-            /* append to tail */
-            if (sermon_tail != NULL)
-              sermon_tail->next = item;
-            else
-              sermon_root.next = item;
-            sermon_tail = item;
-            sermon_tail->text[sermon_tail->length++] = ch;
-          } else {
-            free(item); /* adding a new string failed */
-          }
-        }
+      if (!sermon_linedone && tail->length >= (SERIALSTRING_MAXLENGTH-1))
+        sermon_linedone = true;   /* line length limit */
+      if (sermon_linedone) {
+        SERIALSTRING *item = sermon_newline(SERIALSTRING_MAXLENGTH - 1, timestamp);
+        if (item == NULL)
+          continue;   /* adding a new string failed */
+        tail = item;
+        sermon_linedone = false;
       }
-    }
-    if (sermon_tail != NULL) {
-      assert(sermon_tail->length < SERIALSTRING_MAXLENGTH);
-      sermon_tail->text[sermon_tail->length] = '\0';  /* also zero-terminate any intermediate result */
+      /* append text to the current string (set the new terminator before the
+         character, so that the string is valid at any time) */
+      assert(tail != NULL && tail->length < SERIALSTRING_MAXLENGTH - 1);
+      char *text = SERMON_TEXT(tail);
+      text[tail->length + 1] = '\0';
+      text[tail->length] = (char)ch;
+      tail->length += 1;
     }
   }
+  mtx_unlock(&sermon_lock);
 }
 
 static int sermon_process(void *arg)
 {
   (void)arg;
   while (rs232_isopen(hCom)) {
+    /* block until data arrives (with a time-out, so that the loop notices
+       when the port is closed) */
     unsigned char buffer[256];
-    size_t count = rs232_recv(hCom, buffer, sizearray(buffer));
+    size_t count = rs232_recvwait(hCom, buffer, sizearray(buffer), 50);
     if (count > 0) {
-      sermon_addstring(buffer, count);
-#     if defined WIN32 || defined _WIN32
-        PostMessage((HWND)guidriver_apphandle(), WM_USER, 0, 0L); /* just a flag to wake up the GUI */
-#     endif
-    } else {
-      thrd_yield();
+      /* stamp the data at the time of the read, on the same time base as the
+         SWO trace (see get_timestamp()) */
+      sermon_addstring(buffer, count, rs232_timestamp() / 1000000.0);
+      guidriver_wake();
     }
   }
   return 0;
@@ -256,38 +394,58 @@ bool sermon_isopen(void)
 
 void sermon_clear(void)
 {
-  SERIALSTRING *item;
-  while (sermon_root.next != NULL) {
-    item = sermon_root.next;
-    sermon_root.next = item->next;
-    assert(item->text!=NULL);
-    free((void*)item->text);
-    free((void*)item);
+  call_once(&sermon_lockinit, sermon_initlock);
+  mtx_lock(&sermon_lock);
+  while (textblock_root != NULL) {
+    TEXTBLOCK *block = textblock_root;
+    textblock_root = block->next;
+    free((void*)block->data);
+    free((void*)block->packed);
+    free((void*)block);
+  }
+  textblock_cur = NULL;
+  memset(pinned, 0, sizeof pinned);
+  pinned_next = 0;
+  pinned_recent = NULL;
+  for (unsigned slot = 0; slot < SERMON_MAXBLOCKS && sermon_blocks[slot] != NULL; slot++) {
+    free((void*)sermon_blocks[slot]);
+    sermon_blocks[slot] = NULL;
   }
-  sermon_tail = NULL;
+  sermon_count = 0;
+  sermon_head = 0;
+  sermon_linedone = true;
+  mtx_unlock(&sermon_lock);
 }
 
 int sermon_countlines(void)
 {
-  int count = 0;
-  SERIALSTRING *item = sermon_root.next;
-  while (item != NULL) {
-    count = 1;
-    item = item->next;
-  }
-  return count;
+  return (int)sermon_count;
 }
 
 void sermon_rewind(void)
 {
-  sermon_head = &sermon_root;
+  sermon_head = 0;
 }
 
-const char *sermon_next(void)
+/* sermon_next() returns the next line, and optionally the time at which it
+   was received (in seconds, on the time base of get_timestamp()); the text
+   stays valid until the next call */
+const char *sermon_next(double *timestamp)
 {
-  if (sermon_head != NULL)
-    sermon_head = sermon_head->next;
-  return (sermon_head == NULL) ? NULL : sermon_head->text;
+  if (sermon_head >= sermon_count)
+    return NULL;
+  const SERIALSTRING *item = SERMON_LINE(sermon_head);
+  sermon_head += 1;
+  if (timestamp != NULL)
+    *timestamp = item->timestamp;
+  return sermon_text(item);
+}
+
+/* sermon_setcompress() sets whether text blocks are compressed when they are
+   full; this applies to blocks that are completed after the call */
+void sermon_setcompress(bool enable)
+{
+  sermon_compress = enable;
 }
 
 const char *sermon_getport(int translated)
@@ -316,16 +474,11 @@ int sermon_save(const char *filename)
 {
   FILE *fp = fopen(filename, "wt");
   if (fp != NULL) {
-    int count = 0;
-    SERIALSTRING *item = sermon_root.next;
-    while (item != NULL) {
-      assert(item->text != NULL);
-      fprintf(fp, "%s\n", item->text);
-      item = item->next;
-      count++;
-    }
+    unsigned count;
+    for (count = 0; count < sermon_count; count++)
+      fprintf(fp, "%s\n", sermon_text(SERMON_LINE(count)));
     fclose(fp);
-    return count;
+    return (int)count;
   }
 
   return -1;
@@ -25,7 +25,7 @@ bool   sermon_isopen(void);
 void   sermon_clear(void);
 int    sermon_countlines(void);
 void   sermon_rewind(void);
-const char *sermon_next(void);
+const char *sermon_next(double *timestamp);
 
 const char *sermon_getport(int translated);
 int    sermon_getbaud(void);
@@ -35,4 +35,6 @@ const char *sermon_getmetadata(void);
 
 int sermon_save(const char *filename);
 
+void sermon_setcompress(bool enable);
+
 #endif /* _SERIALMON_H */
@@ -0,0 +1,429 @@
+/*
+ * Trigram index for a full-text search over the source files of a project,
+ * for the Black Magic Debugger front-end.
+ *
+ * Every source file is reduced to the set of (case-folded) three-character
+ * sequences that occur in it. A search only needs to read the files whose set
+ * contains all trigrams of the pattern; for a typical identifier, that is a
+ * small fraction of the project. The sets are built on a background thread,
+ * and rebuilt for files whose timestamp changes.
+ *
+ * Copyright 2026 CompuPhase
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <assert.h>
+#include <ctype.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <sys/stat.h>
+
+#if defined WIN32 || defined _WIN32
+# if defined __MINGW32__ || defined __MINGW64__ || defined _MSC_VER
+#   include "strlcpy.h"
+# endif
+#else
+# include <bsd/string.h>
+#endif
+
+#include "c11threads.h"
+#include "srcindex.h"
+
+#if defined FORTIFY
+# include <alloc/fortify.h>
+#endif
+
+typedef struct tagFILEINDEX {
+  char *path;
+  time_t timestamp;     /* timestamp of the file when the index was built */
+  uint32_t *trigrams;   /* sorted list of unique trigrams */
+  unsigned count;       /* number of entries in the trigrams array */
+  bool dirty;           /* index must be (re-)built */
+  bool indexed;         /* "trigrams" is valid */
+} FILEINDEX;
+
+static FILEINDEX *fileindex = NULL;
+static unsigned fileindex_count = 0;
+static mtx_t fileindex_lock;
+static bool fileindex_lockvalid = false;
+static thrd_t worker_thread;
+static bool worker_active = false;  /* thread was created (and must be joined) */
+static bool worker_running = false; /* thread is still working (protected by lock) */
+static bool worker_abort = false;   /* request to stop (protected by lock) */
+
+#define TRIGRAM(a,b,c)  (((uint32_t)(a) << 16) | ((uint32_t)(b) << 8) | (uint32_t)(c))
+
+static time_t file_timestamp(const char *path)
+{
+  assert(path != NULL);
+  struct stat buf;
+  if (stat(path, &buf) != 0)
+    return 0;
+  time_t tstamp = buf.st_ctime;
+  if (tstamp < buf.st_mtime)
+    tstamp = buf.st_mtime;
+  return tstamp;
+}
+
+/* file_load() reads a complete file in memory and zero-terminates it; the
+   returned buffer must be freed by the caller */
+static char *file_load(const char *path, size_t *size)
+{
+  assert(path != NULL);
+  FILE *fp = fopen(path, "rb");
+  if (fp == NULL)
+    return NULL;
+  fseek(fp, 0, SEEK_END);
+  long length = ftell(fp);
+  fseek(fp, 0, SEEK_SET);
+  char *buffer = (length >= 0) ? malloc((size_t)length + 1) : NULL;
+  if (buffer != NULL) {
+    length = (long)fread(buffer, 1, (size_t)length, fp);
+    buffer[length] = '\0';
+    if (size != NULL)
+      *size = (size_t)length;
+  }
+  fclose(fp);
+  return buffer;
+}
+
+static int trigram_cmp(const void *p1, const void *p2)
+{
+  uint32_t t1 = *(const uint32_t*)p1;
+  uint32_t t2 = *(const uint32_t*)p2;
+  return (t1 < t2) ? -1 : (t1 > t2) ? 1 : 0;
+}
+
+/* trigrams_make() collects the trigrams of a text (case-folded), sorts these
+   and removes duplicates; trigrams do not span lines */
+static uint32_t *trigrams_make(const char *text, size_t length, unsigned *count)
+{
+  assert(text != NULL && count != NULL);
+  *count = 0;
+  if (length < 3)
+    return NULL;
+  uint32_t *list = malloc((length - 2) * sizeof(uint32_t));
+  if (list == NULL)
+    return NULL;
+  unsigned num = 0;
+  for (size_t idx = 0; idx + 2 < length; idx++) {
+    unsigned char a = (unsigned char)tolower((unsigned char)text[idx]);
+    unsigned char b = (unsigned char)tolower((unsigned char)text[idx + 1]);
+    unsigned char c = (unsigned char)tolower((unsigned char)text[idx + 2]);
+    if (a == '\n' || b == '\n' || c == '\n' || a == '\r' || b == '\r' || c == '\r')
+      continue;
+    list[num++] = TRIGRAM(a, b, c);
+  }
+  if (num == 0) {
+    free(list);
+    return NULL;
+  }
+  qsort(list, num, sizeof(uint32_t), trigram_cmp);
+  unsigned unique = 1;
+  for (unsigned idx = 1; idx < num; idx++)
+    if (list[idx] != list[unique - 1])
+      list[unique++] = list[idx];
+  uint32_t *shrunk = realloc(list, unique * sizeof(uint32_t));
+  *count = unique;
+  return (shrunk != NULL) ? shrunk : list;
+}
+
+static bool trigrams_contain(const uint32_t *list, unsigned count, uint32_t trigram)
+{
+  unsigned low = 0, high = count;
+  while (low < high) {
+    unsigned mid = (low + high) / 2;
+    if (list[mid] < trigram)
+      low = mid + 1;
+    else
+      high = mid;
+  }
+  return (low < count && list[low] == trigram);
+}
+
+static int worker(void *arg)
+{
+  (void)arg;
+  for ( ;; ) {
+    /* find the next file to index, copy its name, so that it can be loaded
+       without holding the lock */
+    char path[512];
+    unsigned idx;
+    mtx_lock(&fileindex_lock);
+    for (idx = 0; idx < fileindex_count && !fileindex[idx].dirty; idx++)
+      {}
+    if (worker_abort || idx >= fileindex_count) {
+      worker_running = false;
+      mtx_unlock(&fileindex_lock);
+      return 0;
+    }
+    fileindex[idx].dirty = false;
+    strlcpy(path, fileindex[idx].path, sizeof path);
+    mtx_unlock(&fileindex_lock);
+
+    time_t tstamp = file_timestamp(path);
+    size_t size = 0;
+    char *text = file_load(path, &size);
+    unsigned count = 0;
+    bool loaded = (text != NULL);
+    uint32_t *list = loaded ? trigrams_make(text, size, &count) : NULL;
+    free(text);
+
+    mtx_lock(&fileindex_lock);
+    /* the file may have been marked dirty again while being indexed, but the
+       index of the previous version is still better than none */
+    free(fileindex[idx].trigrams);
+    fileindex[idx].trigrams = list;
+    fileindex[idx].count = count;
+    fileindex[idx].timestamp = tstamp;
+    fileindex[idx].indexed = loaded;
+    mtx_unlock(&fileindex_lock);
+  }
+}
+
+static void worker_stop(void)
+{
+  if (worker_active) {
+    mtx_lock(&fileindex_lock);
+    worker_abort = true;
+    mtx_unlock(&fileindex_lock);
+    thrd_join(worker_thread, NULL);
+    worker_active = false;
+    worker_abort = false;
+  }
+}
+
+static void worker_start(void)
+{
+  mtx_lock(&fileindex_lock);
+  bool running = worker_running;
+  mtx_unlock(&fileindex_lock);
+  if (running)
+    return;   /* the thread picks up the newly dirty files */
+  if (worker_active) {
+    thrd_join(worker_thread, NULL);   /* thread has finished, clean it up */
+    worker_active = false;
+  }
+  worker_running = true;
+  if (thrd_create(&worker_thread, worker, NULL) == thrd_success)
+    worker_active = true;
+  else
+    worker_running = false;
+}
+
+/** srcindex_clear() stops the indexing thread (if active) and removes the
+ *  index of all files.
+ */
+void srcindex_clear(void)
+{
+  worker_stop();
+  if (fileindex != NULL) {
+    for (unsigned idx = 0; idx < fileindex_count; idx++) {
+      free(fileindex[idx].path);
+      free(fileindex[idx].trigrams);
+    }
+    free(fileindex);
+    fileindex = NULL;
+  }
+  fileindex_count = 0;
+}
+
+/** srcindex_build() starts building an index for the files in the list. The
+ *  index is built on a background thread, so this function returns
+ *  immediately.
+ *
+ *  \param paths    An array with the full paths of the source files.
+ *  \param count    The number of entries in the paths array.
+ *
+ *  \return true on success, false on failure (memory allocation error).
+ *
+ *  \note A search on files that are not yet indexed falls back to reading the
+ *        file.
+ */
+bool srcindex_build(const char **paths, unsigned count)
+{
+  assert(paths != NULL || count == 0);
+  if (!fileindex_lockvalid) {
+    mtx_init(&fileindex_lock, mtx_plain);
+    fileindex_lockvalid = true;
+  }
+  srcindex_clear();
+  if (count == 0)
+    return true;
+  fileindex = calloc(count, sizeof(FILEINDEX));
+  if (fileindex == NULL)
+    return false;
+  for (unsigned idx = 0; idx < count; idx++) {
+    assert(paths[idx] != NULL);
+    fileindex[idx].path = strdup(paths[idx]);
+    if (fileindex[idx].path == NULL) {
+      fileindex_count = idx;
+      srcindex_clear();
+      return false;
+    }
+    fileindex[idx].dirty = true;
+  }
+  fileindex_count = count;
+  worker_start();
+  return true;
+}
+
+/** srcindex_update() checks the timestamps of the files, and re-indexes the
+ *  files that were modified.
+ *
+ *  \return The number of files that are scheduled for re-indexing.
+ */
+unsigned srcindex_update(void)
+{
+  if (fileindex_count == 0)
+    return 0;
+  unsigned changed = 0;
+  mtx_lock(&fileindex_lock);
+  for (unsigned idx = 0; idx < fileindex_count; idx++) {
+    FILEINDEX *fi = &fileindex[idx];
+    if (!fi->dirty && file_timestamp(fi->path) != fi->timestamp) {
+      fi->dirty = true;
+      changed += 1;
+    }
+  }
+  mtx_unlock(&fileindex_lock);
+  if (changed > 0)
+    worker_start();
+  return changed;
+}
+
+/** srcindex_pending() returns the number of files that are not yet indexed
+ *  (or that must be re-indexed).
+ */
+unsigned srcindex_pending(void)
+{
+  if (fileindex_count == 0)
+    return 0;
+  unsigned count = 0;
+  mtx_lock(&fileindex_lock);
+  for (unsigned idx = 0; idx < fileindex_count; idx++)
+    if (fileindex[idx].dirty || !fileindex[idx].indexed)
+      count += 1;
+  mtx_unlock(&fileindex_lock);
+  return count;
+}
+
+/* search_file() scans a file for the pattern (case-insensitive) and stores
+   the matches; it returns the number of matching lines (which may exceed the
+   number stored) */
+static unsigned search_file(const char *path, unsigned fileidx, const char *pattern,
+                            SRCMATCH *matches, unsigned maxmatches)
+{
+  char *text = file_load(path, NULL);
+  if (text == NULL)
+    return 0;
+  size_t patlen = strlen(pattern);
+  unsigned found = 0;
+  int linenr = 1;
+  for (char *line = text; *line != '\0'; linenr++) {
+    char *eol = strchr(line, '\n');
+    if (eol == NULL)
+      eol = line + strlen(line);
+    for (char *ptr = line; ptr + patlen <= eol; ptr++) {
+      size_t idx;
+      for (idx = 0; idx < patlen && tolower((unsigned char)ptr[idx]) == tolower((unsigned char)pattern[idx]); idx++)
+        {}
+      if (idx == patlen) {
+        if (found < maxmatches) {
+          assert(matches != NULL);
+          matches[found].file = fileidx;
+          matches[found].line = linenr;
+          size_t len = eol - line;
+          if (len > 0 && line[len - 1] == '\r')
+            len--;
+          if (len >= SRCMATCH_TEXT)
+            len = SRCMATCH_TEXT - 1;
+          memcpy(matches[found].text, line, len);
+          matches[found].text[len] = '\0';
+        }
+        found++;
+        break;  /* report each line only once */
+      }
+    }
+    line = (*eol == '\n') ? eol + 1 : eol;
+  }
+  free(text);
+  return found;
+}
+
+/** srcindex_find() searches all indexed files for a text (case-insensitive).
+ *  Only the files whose index holds all trigrams of the pattern are read (as
+ *  well as files that are not yet indexed).
+ *
+ *  \param pattern    The text to search for.
+ *  \param matches    [out] An array that is filled with the matching lines.
+ *                    This parameter may be NULL if maxmatches is 0.
+ *  \param maxmatches The size of the matches array.
+ *
+ *  \return The total number of matching lines, which may be higher than
+ *          maxmatches.
+ */
+unsigned srcindex_find(const char *pattern, SRCMATCH *matches, unsigned maxmatches)
+{
+  assert(pattern != NULL);
+  assert(matches != NULL || maxmatches == 0);
+  size_t patlen = strlen(pattern);
+  if (patlen == 0 || fileindex_count == 0)
+    return 0;
+
+  unsigned patcount;
+  uint32_t *patgrams = trigrams_make(pattern, patlen, &patcount);
+
+  /* collect the candidate files under the lock, then search the files
+     without holding it */
+  char **candidates = calloc(fileindex_count, sizeof(char*));
+  unsigned *fileidx = calloc(fileindex_count, sizeof(unsigned));
+  unsigned numcandidates = 0;
+  if (candidates == NULL || fileidx == NULL) {
+    free(candidates);
+    free(fileidx);
+    free(patgrams);
+    return 0;
+  }
+  mtx_lock(&fileindex_lock);
+  for (unsigned idx = 0; idx < fileindex_count; idx++) {
+    FILEINDEX *fi = &fileindex[idx];
+    bool match = true;
+    if (fi->indexed) {
+      for (unsigned p = 0; p < patcount && match; p++)
+        match = trigrams_contain(fi->trigrams, fi->count, patgrams[p]);
+    }
+    if (match) {
+      candidates[numcandidates] = strdup(fi->path);
+      fileidx[numcandidates] = idx;
+      if (candidates[numcandidates] != NULL)
+        numcandidates++;
+    }
+  }
+  mtx_unlock(&fileindex_lock);
+  free(patgrams);
+
+  unsigned found = 0;
+  for (unsigned idx = 0; idx < numcandidates; idx++) {
+    unsigned stored = (found < maxmatches) ? found : maxmatches;
+    found += search_file(candidates[idx], fileidx[idx], pattern,
+                         (matches != NULL) ? matches + stored : NULL, maxmatches - stored);
+    free(candidates[idx]);
+  }
+  free(candidates);
+  free(fileidx);
+  return found;
+}
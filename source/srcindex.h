@@ -0,0 +1,47 @@
+/*
+ * Trigram index for a full-text search over the source files of a project,
+ * for the Black Magic Debugger front-end.
+ *
+ * Copyright 2026 CompuPhase
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef _SRCINDEX_H
+#define _SRCINDEX_H
+
+#include <stdbool.h>
+
+#define SRCMATCH_TEXT 100
+
+typedef struct tagSRCMATCH {
+  unsigned file;        /* index in the list passed to srcindex_build() */
+  int line;             /* line number (1-based) */
+  char text[SRCMATCH_TEXT]; /* text on the line (truncated if too long) */
+} SRCMATCH;
+
+#if defined __cplusplus
+  extern "C" {
+#endif
+
+bool     srcindex_build(const char **paths, unsigned count);
+void     srcindex_clear(void);
+unsigned srcindex_update(void);
+unsigned srcindex_pending(void);
+
+unsigned srcindex_find(const char *pattern, SRCMATCH *matches, unsigned maxmatches);
+
+#if defined __cplusplus
+  }
+#endif
+
+#endif /* _SRCINDEX_H */
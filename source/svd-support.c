@@ -17,6 +17,8 @@
  * limitations under the License.
  */
 #include <assert.h>
+#include <stdbool.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -79,6 +81,90 @@ static PERIPHERAL *peripheral = NULL;
 static int peripheral_count = 0;
 static int peripheral_size = 0;
 
+/* hash table on peripheral names and on "peripheral->register" pairs, built
+   after the SVD file is loaded (while loading, the lists are still growing,
+   and look-ups fall back to a linear search) */
+typedef struct tagSVDHASH {
+  PERIPHERAL *per;
+  REGISTER *reg;                /* NULL for the entry of the peripheral itself */
+} SVDHASH;
+static SVDHASH *svd_hash = NULL;
+static unsigned svd_hashsize = 0;  /* always a power of 2 */
+
+/* when the tables are loaded from a cache file, all names and descriptions
+   point into the data block of that file */
+static unsigned char *svd_cachedata = NULL;
+
+
+static unsigned hash_name(const char *periph, const char *reg)
+{
+  unsigned h = 2166136261u; /* FNV-1a */
+  assert(periph != NULL);
+  while (*periph != '\0')
+    h = (h ^ (unsigned char)*periph++) * 16777619u;
+  if (reg != NULL) {
+    h = (h ^ (unsigned char)'>') * 16777619u;
+    while (*reg != '\0')
+      h = (h ^ (unsigned char)*reg++) * 16777619u;
+  }
+  return h;
+}
+
+static SVDHASH *hash_lookup(const char *periph, const char *reg)
+{
+  unsigned idx;
+
+  assert(svd_hash != NULL && svd_hashsize > 0);
+  idx = hash_name(periph, reg) & (svd_hashsize - 1);
+  while (svd_hash[idx].per != NULL) {
+    const SVDHASH *entry = &svd_hash[idx];
+    if (strcmp(entry->per->name, periph) == 0) {
+      if (reg == NULL && entry->reg == NULL)
+        return &svd_hash[idx];
+      if (reg != NULL && entry->reg != NULL && strcmp(entry->reg->name, reg) == 0)
+        return &svd_hash[idx];
+    }
+    idx = (idx + 1) & (svd_hashsize - 1);
+  }
+  return NULL;
+}
+
+static void hash_insert(PERIPHERAL *per, REGISTER *reg)
+{
+  unsigned idx;
+
+  assert(svd_hash != NULL && svd_hashsize > 0);
+  assert(per != NULL);
+  idx = hash_name(per->name, (reg != NULL) ? reg->name : NULL) & (svd_hashsize - 1);
+  while (svd_hash[idx].per != NULL)
+    idx = (idx + 1) & (svd_hashsize - 1);
+  svd_hash[idx].per = per;
+  svd_hash[idx].reg = reg;
+}
+
+/* hash_build() creates the hash table for all peripherals and registers;
+   it is filled to half its size at most */
+static void hash_build(void)
+{
+  unsigned count = 0;
+  int p, r;
+
+  for (p = 0; p < peripheral_count; p++)
+    count += 1 + peripheral[p].reg_count;
+  svd_hashsize = 16;
+  while (svd_hashsize < 2 * count)
+    svd_hashsize *= 2;
+  svd_hash = calloc(svd_hashsize, sizeof(SVDHASH));
+  if (svd_hash == NULL) {
+    svd_hashsize = 0;
+    return;   /* look-ups fall back to a linear search */
+  }
+  for (p = 0; p < peripheral_count; p++) {
+    hash_insert(&peripheral[p], NULL);
+    for (r = 0; r < peripheral[p].reg_count; r++)
+      hash_insert(&peripheral[p], &peripheral[p].reg[r]);
+  }
+}
 
 static PERIPHERAL *peripheral_find(const char *name)
 {
@@ -86,6 +172,11 @@ static PERIPHERAL *peripheral_find(const char *name)
 
   assert(name != NULL);
 
+  if (svd_hash != NULL) {
+    SVDHASH *entry = hash_lookup(name, NULL);
+    return (entry != NULL) ? entry->per : NULL;
+  }
+
   for (idx = 0; idx < peripheral_count; idx++) {
     assert(peripheral != NULL && peripheral[idx].name != NULL);
     if (strcmp(peripheral[idx].name, name) == 0)
@@ -151,6 +242,11 @@ static REGISTER *register_find(const PERIPHERAL *per, const char *name)
   assert(per != NULL);
   assert(name != NULL);
 
+  if (svd_hash != NULL) {
+    SVDHASH *entry = hash_lookup(per->name, name);
+    return (entry != NULL) ? entry->reg : NULL;
+  }
+
   for (idx = 0; idx < per->reg_count; idx++) {
     assert(per->reg != NULL && per->reg[idx].name != NULL);
     if (strcmp(per->reg[idx].name, name) == 0)
@@ -335,21 +431,33 @@ static void reformat_description(char *string)
 
 void svd_clear(void)
 {
+  if (svd_hash != NULL) {
+    free((void*)svd_hash);
+    svd_hash = NULL;
+  }
+  svd_hashsize = 0;
+  bool owned = (svd_cachedata == NULL); /* strings in the cache block are not allocated */
   for (int p = 0; p < peripheral_count; p++) {
     assert(peripheral != NULL && peripheral[p].name != NULL);
-    free((void*)peripheral[p].name);
-    if (peripheral[p].description != NULL)
-      free((void*)peripheral[p].description);
+    if (owned) {
+      free((void*)peripheral[p].name);
+      if (peripheral[p].description != NULL)
+        free((void*)peripheral[p].description);
+    }
     for (int r = 0; r < peripheral[p].reg_count; r++) {
       assert(peripheral[p].reg != NULL && peripheral[p].reg[r].name != NULL);
-      free((void*)peripheral[p].reg[r].name);
-      if (peripheral[p].reg[r].description)
-        free((void*)peripheral[p].reg[r].description);
+      if (owned) {
+        free((void*)peripheral[p].reg[r].name);
+        if (peripheral[p].reg[r].description)
+          free((void*)peripheral[p].reg[r].description);
+      }
       for (int b = 0; b < peripheral[p].reg[r].field_count; b++) {
         assert(peripheral[p].reg[r].field != NULL && peripheral[p].reg[r].field[b].name != NULL);
-        free((void*)peripheral[p].reg[r].field[b].name);
-        if (peripheral[p].reg[r].field[b].description)
-          free((void*)peripheral[p].reg[r].field[b].description);
+        if (owned) {
+          free((void*)peripheral[p].reg[r].field[b].name);
+          if (peripheral[p].reg[r].field[b].description)
+            free((void*)peripheral[p].reg[r].field[b].description);
+        }
       }
       if (peripheral[p].reg[r].field != NULL)
         free((void*)peripheral[p].reg[r].field);
@@ -363,10 +471,317 @@ void svd_clear(void)
   }
   peripheral_count = 0;
   peripheral_size = 0;
+  if (svd_cachedata != NULL) {
+    free((void*)svd_cachedata);
+    svd_cachedata = NULL;
+  }
   svd_prefix[0] = '\0';
   svd_regsize = 0;
 }
 
+/* link_registers() sets the "back-links" of the register definitions to the
+   peripheral definitions, and builds the hash table for look-ups */
+static void link_registers(void)
+{
+  for (int idx = 0; idx < peripheral_count; idx++)
+    for (int ridx = 0; ridx < peripheral[idx].reg_count; ridx++)
+      peripheral[idx].reg[ridx].peripheral = &peripheral[idx];
+  hash_build();
+}
+
+/* The SVD file is parsed in a single pass with callbacks, instead of building
+   an XML tree first. The context keeps the nesting of the elements (only the
+   levels that matter are recognized) plus the fields of the peripheral,
+   register or bit field that is being collected. A peripheral (or register)
+   is added as soon as its <registers> (or <fields>) element starts, or at its
+   end tag if it has none; the pointer remains valid until the next one is
+   added at the same level. */
+enum {
+  SVDTAG_OTHER,
+  SVDTAG_DEVICE,
+  SVDTAG_PERIPHERALS,
+  SVDTAG_PERIPHERAL,
+  SVDTAG_REGISTERS,
+  SVDTAG_REGISTER,
+  SVDTAG_FIELDS,
+  SVDTAG_FIELD,
+  SVDTAG_NAME,
+  SVDTAG_DESCRIPTION,
+  SVDTAG_BASEADDRESS,
+  SVDTAG_ADDRESSOFFSET,
+  SVDTAG_DIM,
+  SVDTAG_DIMINCREMENT,
+  SVDTAG_BITRANGE,
+  SVDTAG_SIZE,
+  SVDTAG_WIDTH,
+  SVDTAG_PREFIX,
+};
+
+#define SVD_MAXDEPTH  8   /* deeper levels are not interesting */
+
+typedef struct tagDERIVED {
+  char *name;
+  char *base;
+} DERIVED;
+
+typedef struct tagSVDPARSE {
+  unsigned char tag[SVD_MAXDEPTH];
+  int depth;                    /* may exceed SVD_MAXDEPTH */
+  int match;                    /* number of levels that are on the path to a bit field */
+  bool valid;                   /* root element is <device> */
+  bool size_set;                /* <size> has priority over <width> */
+  PERIPHERAL *per;
+  bool per_added;
+  REGISTER *reg;
+  bool reg_added;
+  char periph_name[100];
+  char periph_descr[256];
+  char periph_base[100];        /* "derivedFrom" attribute */
+  unsigned long base_addr;
+  char reg_name[100];
+  char reg_descr[256];
+  unsigned long offset;
+  unsigned short dim;
+  unsigned short increment;
+  char bitf_name[100];
+  char bitf_descr[256];
+  char bitf_range[256];
+  DERIVED *derived;
+  int derived_count;
+  int derived_size;
+} SVDPARSE;
+
+static const struct {
+  const char *name;
+  unsigned char tag;
+} svd_tags[] = {
+  { "device", SVDTAG_DEVICE },
+  { "peripherals", SVDTAG_PERIPHERALS },
+  { "peripheral", SVDTAG_PERIPHERAL },
+  { "registers", SVDTAG_REGISTERS },
+  { "register", SVDTAG_REGISTER },
+  { "fields", SVDTAG_FIELDS },
+  { "field", SVDTAG_FIELD },
+  { "name", SVDTAG_NAME },
+  { "description", SVDTAG_DESCRIPTION },
+  { "baseAddress", SVDTAG_BASEADDRESS },
+  { "addressOffset", SVDTAG_ADDRESSOFFSET },
+  { "dim", SVDTAG_DIM },
+  { "dimIncrement", SVDTAG_DIMINCREMENT },
+  { "bitRange", SVDTAG_BITRANGE },
+  { "size", SVDTAG_SIZE },
+  { "width", SVDTAG_WIDTH },
+  { "headerDefinitionsPrefix", SVDTAG_PREFIX },
+};
+
+/* the path from the root to a bit field: each tag at its level */
+static const unsigned char svd_path[] = { SVDTAG_DEVICE, SVDTAG_PERIPHERALS, SVDTAG_PERIPHERAL,
+                                          SVDTAG_REGISTERS, SVDTAG_REGISTER, SVDTAG_FIELDS,
+                                          SVDTAG_FIELD };
+
+static int svd_tag(const char *name, int szname)
+{
+  for (int idx = 0; idx < (int)sizearray(svd_tags); idx++)
+    if (strncmp(svd_tags[idx].name, name, szname) == 0 && svd_tags[idx].name[szname] == '\0')
+      return svd_tags[idx].tag;
+  return SVDTAG_OTHER;
+}
+
+/* copy_content() copies the text of an element, but only if it fits */
+static void copy_content(char *dest, size_t size, const char *content, int szcontent)
+{
+  if (content != NULL && (size_t)szcontent < size) {
+    memcpy(dest, content, szcontent);
+    dest[szcontent] = '\0';
+  }
+}
+
+static void derived_add(SVDPARSE *ctx, const char *name, const char *base)
+{
+  if (ctx->derived_count >= ctx->derived_size) {
+    int newsize = (ctx->derived_size == 0) ? 8 : 2 * ctx->derived_size;
+    DERIVED *newlist = realloc(ctx->derived, newsize * sizeof(DERIVED));
+    if (newlist == NULL)
+      return;
+    ctx->derived = newlist;
+    ctx->derived_size = newsize;
+  }
+  char *n = strdup(name);
+  char *b = strdup(base);
+  if (n == NULL || b == NULL) {
+    free(n);
+    free(b);
+    return;
+  }
+  ctx->derived[ctx->derived_count].name = n;
+  ctx->derived[ctx->derived_count].base = b;
+  ctx->derived_count += 1;
+}
+
+static void derived_clear(SVDPARSE *ctx)
+{
+  for (int idx = 0; idx < ctx->derived_count; idx++) {
+    free(ctx->derived[idx].name);
+    free(ctx->derived[idx].base);
+  }
+  free(ctx->derived);
+  ctx->derived = NULL;
+  ctx->derived_count = ctx->derived_size = 0;
+}
+
+/* registers_copy() adds copies of all registers and bit fields of the base
+   peripheral to the derived peripheral */
+static void registers_copy(PERIPHERAL *per, const PERIPHERAL *base)
+{
+  for (int ridx = 0; ridx < base->reg_count; ridx++) {
+    const REGISTER *src = &base->reg[ridx];
+    REGISTER *reg = register_add(per, src->name, src->description, src->offset, src->range, src->increment);
+    if (reg == NULL)
+      continue;
+    for (int fidx = 0; fidx < src->field_count; fidx++) {
+      const BITFIELD *field = &src->field[fidx];
+      char range[20] = "";
+      if (field->low_bit >= 0)
+        snprintf(range, sizearray(range), "%d:%d", field->low_bit, field->high_bit);
+      bitfield_add(reg, field->name, field->description, range);
+    }
+  }
+}
+
+static void peripheral_flush(SVDPARSE *ctx)
+{
+  if (!ctx->per_added) {
+    reformat_description(ctx->periph_descr);
+    ctx->per = peripheral_add(ctx->periph_name, ctx->periph_descr, ctx->base_addr);
+    ctx->per_added = true;
+    if (ctx->per != NULL && strlen(ctx->periph_base) > 0)
+      derived_add(ctx, ctx->periph_name, ctx->periph_base);
+  }
+}
+
+static void register_flush(SVDPARSE *ctx)
+{
+  if (!ctx->reg_added) {
+    reformat_description(ctx->reg_descr);
+    ctx->reg = (ctx->per != NULL)
+               ? register_add(ctx->per, ctx->reg_name, ctx->reg_descr, ctx->offset, ctx->dim, ctx->increment)
+               : NULL;
+    ctx->reg_added = true;
+  }
+}
+
+static void svd_element_start(void *userdata, const char *name, int szname,
+                              const xt_Attrib *attribs, int numattribs)
+{
+  SVDPARSE *ctx = (SVDPARSE*)userdata;
+  int level = ctx->depth++;
+  if (level >= SVD_MAXDEPTH)
+    return;
+  int tag = svd_tag(name, szname);
+  ctx->tag[level] = (unsigned char)tag;
+  if (level == 0)
+    ctx->valid = (tag == SVDTAG_DEVICE);
+  if (ctx->match < level || level >= (int)sizearray(svd_path) || tag != svd_path[level])
+    return;
+  ctx->match = level + 1;
+
+  switch (tag) {
+  case SVDTAG_PERIPHERAL:
+    ctx->per = NULL;
+    ctx->per_added = false;
+    ctx->periph_name[0] = ctx->periph_descr[0] = ctx->periph_base[0] = '\0';
+    ctx->base_addr = 0;
+    for (int idx = 0; idx < numattribs; idx++)
+      if (attribs[idx].szname == 11 && strncmp(attribs[idx].name, "derivedFrom", 11) == 0)
+        copy_content(ctx->periph_base, sizearray(ctx->periph_base), attribs[idx].value, attribs[idx].szvalue);
+    break;
+  case SVDTAG_REGISTERS:
+    peripheral_flush(ctx);
+    break;
+  case SVDTAG_REGISTER:
+    ctx->reg = NULL;
+    ctx->reg_added = false;
+    ctx->reg_name[0] = ctx->reg_descr[0] = '\0';
+    ctx->offset = 0;
+    ctx->dim = 1;
+    ctx->increment = (unsigned short)(svd_regsize / 8);
+    break;
+  case SVDTAG_FIELDS:
+    register_flush(ctx);
+    break;
+  case SVDTAG_FIELD:
+    ctx->bitf_name[0] = ctx->bitf_descr[0] = ctx->bitf_range[0] = '\0';
+    break;
+  }
+}
+
+static void svd_element_end(void *userdata, const char *name, int szname,
+                            const char *content, int szcontent)
+{
+  SVDPARSE *ctx = (SVDPARSE*)userdata;
+  (void)name;
+  (void)szname;
+  int level = --ctx->depth;
+  assert(level >= 0);
+  if (level >= SVD_MAXDEPTH)
+    return;
+  int tag = ctx->tag[level];
+
+  if (ctx->match == level + 1) {
+    /* end of an element on the path */
+    ctx->match = level;
+    if (tag == SVDTAG_PERIPHERAL)
+      peripheral_flush(ctx);
+    else if (tag == SVDTAG_REGISTER)
+      register_flush(ctx);
+    else if (tag == SVDTAG_FIELD && ctx->reg != NULL)
+      bitfield_add(ctx->reg, ctx->bitf_name, ctx->bitf_descr, ctx->bitf_range);
+    return;
+  }
+  if (ctx->match != level || level == 0 || content == NULL)
+    return;
+
+  /* a child of an element on the path */
+  switch (svd_path[level - 1]) {
+  case SVDTAG_DEVICE:
+    if (tag == SVDTAG_SIZE || (tag == SVDTAG_WIDTH && !ctx->size_set)) {
+      svd_regsize = (int)strtol(content, NULL, 0);
+      ctx->size_set = (tag == SVDTAG_SIZE);
+    } else if (tag == SVDTAG_PREFIX) {
+      copy_content(svd_prefix, sizearray(svd_prefix), content, szcontent);
+    }
+    break;
+  case SVDTAG_PERIPHERAL:
+    if (tag == SVDTAG_NAME)
+      copy_content(ctx->periph_name, sizearray(ctx->periph_name), content, szcontent);
+    else if (tag == SVDTAG_DESCRIPTION)
+      copy_content(ctx->periph_descr, sizearray(ctx->periph_descr), content, szcontent);
+    else if (tag == SVDTAG_BASEADDRESS)
+      ctx->base_addr = strtoul(content, NULL, 0);
+    break;
+  case SVDTAG_REGISTER:
+    if (tag == SVDTAG_NAME)
+      copy_content(ctx->reg_name, sizearray(ctx->reg_name), content, szcontent);
+    else if (tag == SVDTAG_DESCRIPTION)
+      copy_content(ctx->reg_descr, sizearray(ctx->reg_descr), content, szcontent);
+    else if (tag == SVDTAG_ADDRESSOFFSET)
+      ctx->offset = strtoul(content, NULL, 0);
+    else if (tag == SVDTAG_DIM)
+      ctx->dim = (unsigned short)strtoul(content, NULL, 0);
+    else if (tag == SVDTAG_DIMINCREMENT)
+      ctx->increment = (unsigned short)strtoul(content, NULL, 0);
+    break;
+  case SVDTAG_FIELD:
+    if (tag == SVDTAG_NAME)
+      copy_content(ctx->bitf_name, sizearray(ctx->bitf_name), content, szcontent);
+    else if (tag == SVDTAG_DESCRIPTION)
+      copy_content(ctx->bitf_descr, sizearray(ctx->bitf_descr), content, szcontent);
+    else if (tag == SVDTAG_BITRANGE)
+      copy_content(ctx->bitf_range, sizearray(ctx->bitf_range), content, szcontent);
+    break;
+  }
+}
+
 int svd_load(const char *filename)
 {
   FILE *fp;
@@ -396,113 +811,31 @@ int svd_load(const char *filename)
   fclose(fp);
 
   /* parse the information */
-  xt_Node *xmlroot = xt_parse(buffer);
-  if (xmlroot == NULL || xmlroot->szname != 6 || strncmp(xmlroot->name, "device", 6) != 0) {
+  SVDPARSE ctx;
+  memset(&ctx, 0, sizeof ctx);
+  svd_regsize = 32; /* default register width for (ARM Cortex) */
+  xt_parse_callback(buffer, svd_element_start, svd_element_end, &ctx);
+  if (!ctx.valid) {
     /* not an XML file, or not in the correct format */
+    derived_clear(&ctx);
     free(buffer);
     return 0;
   }
 
-  svd_regsize = 32; /* default register width for (ARM Cortex) */
-  xt_Node *xmlfield = xt_find_child(xmlroot, "size");
-  if (xmlfield == NULL)
-    xmlfield = xt_find_child(xmlroot, "width");
-  if (xmlfield != NULL)
-    svd_regsize = (int)strtol(xmlfield->content, NULL, 0);
-
-  xmlfield = xt_find_child(xmlroot, "headerDefinitionsPrefix");
-  if (xmlfield != NULL && xmlfield->szcontent < sizearray(svd_prefix)) {
-    strncpy(svd_prefix, xmlfield->content, xmlfield->szcontent);
-    svd_prefix[xmlfield->szcontent] = '\0';
-  }
-
-  xmlroot = xt_find_child(xmlroot, "peripherals");
-  if (xmlroot != NULL) {
-    xmlroot = xt_find_child(xmlroot, "peripheral");
-    while (xmlroot != NULL) {
-      char periph_name[100] = "";
-      xmlfield = xt_find_child(xmlroot, "name");
-      if (xmlfield != NULL && xmlfield->szcontent < sizearray(periph_name)) {
-        strncpy(periph_name, xmlfield->content, xmlfield->szcontent);
-        periph_name[xmlfield->szcontent] = '\0';
-      }
-      char periph_descr[256] = "";
-      xmlfield = xt_find_child(xmlroot, "description");
-      if (xmlfield != NULL && xmlfield->szcontent < sizearray(periph_descr)) {
-        strncpy(periph_descr, xmlfield->content, xmlfield->szcontent);
-        periph_descr[xmlfield->szcontent] = '\0';
-        reformat_description(periph_descr);
-      }
-      xmlfield = xt_find_child(xmlroot, "baseAddress");
-      unsigned long base_addr = (xmlfield != NULL) ? strtoul(xmlfield->content, NULL, 0) : 0;
-
-      PERIPHERAL *per = peripheral_add(periph_name, periph_descr, base_addr);
-      xt_Node *xmlreg = xt_find_child(xmlroot, "registers");
-      if (xmlreg != NULL && per != NULL) {
-        xmlreg = xt_find_child(xmlreg, "register");
-        while (xmlreg != NULL) {
-          char reg_name[100] = "";
-          xmlfield = xt_find_child(xmlreg, "name");
-          if (xmlfield != NULL && xmlfield->szcontent < sizearray(reg_name)) {
-            strncpy(reg_name, xmlfield->content, xmlfield->szcontent);
-            reg_name[xmlfield->szcontent] = '\0';
-          }
-          char reg_descr[256] = "";
-          xmlfield = xt_find_child(xmlreg, "description");
-          if (xmlfield != NULL && xmlfield->szcontent < sizearray(reg_descr)) {
-            strncpy(reg_descr, xmlfield->content, xmlfield->szcontent);
-            reg_descr[xmlfield->szcontent] = '\0';
-            reformat_description(reg_descr);
-          }
-          xmlfield = xt_find_child(xmlreg, "addressOffset");
-          unsigned long offset = (xmlfield != NULL) ? strtoul(xmlfield->content, NULL, 0) : 0;
-          xmlfield = xt_find_child(xmlreg, "dim");
-          unsigned short dim = (xmlfield != NULL) ? (unsigned)strtoul(xmlfield->content, NULL, 0) : 1;
-          xmlfield = xt_find_child(xmlreg, "dimIncrement");
-          unsigned short increment = (xmlfield != NULL) ? (unsigned)strtoul(xmlfield->content, NULL, 0) : (unsigned short)(svd_regsize / 8);
-          /* add the register information to the list */
-          REGISTER *reg = register_add(per, reg_name, reg_descr, offset, dim, increment);
-          /* check for bit fields, add these too if present */
-          xt_Node *xmlbitf = xt_find_child(xmlreg, "fields");
-          if (xmlbitf != NULL && reg != NULL) {
-            xmlbitf = xt_find_child(xmlbitf, "field");
-            while (xmlbitf != NULL) {
-              char bitf_name[100]= "";
-              xmlfield = xt_find_child(xmlbitf, "name");
-              if (xmlfield != NULL && xmlfield->szcontent < sizearray(bitf_name)) {
-                strncpy(bitf_name, xmlfield->content, xmlfield->szcontent);
-                bitf_name[xmlfield->szcontent] = '\0';
-              }
-              char bitf_descr[256] = "";
-              xmlfield = xt_find_child(xmlbitf, "description");
-              if (xmlfield != NULL && xmlfield->szcontent < sizearray(bitf_descr)) {
-                strncpy(bitf_descr, xmlfield->content, xmlfield->szcontent);
-                bitf_descr[xmlfield->szcontent] = '\0';
-                reformat_description(bitf_descr);
-              }
-              char bitf_range[256] = "";
-              xmlfield = xt_find_child(xmlbitf, "bitRange");
-              if (xmlfield != NULL && xmlfield->szcontent < sizearray(bitf_range)) {
-                strncpy(bitf_range, xmlfield->content, xmlfield->szcontent);
-                bitf_range[xmlfield->szcontent] = '\0';
-              }
-              bitfield_add(reg, bitf_name, bitf_descr, bitf_range);
-              xmlbitf = xt_find_sibling(xmlbitf, "field");
-            }
-          }
-          xmlreg = xt_find_sibling(xmlreg, "register");
-        }
-      }
-
-      xmlroot = xt_find_sibling(xmlroot, "peripheral");
-    }
+  /* peripherals that are "derived from" another, and that do not define
+     registers of their own, get copies of the registers of the base */
+  for (idx = 0; idx < ctx.derived_count; idx++) {
+    PERIPHERAL *per = peripheral_find(ctx.derived[idx].name);
+    const PERIPHERAL *base = peripheral_find(ctx.derived[idx].base);
+    if (per != NULL && base != NULL && per != base && per->reg_count == 0)
+      registers_copy(per, base);
   }
+  derived_clear(&ctx);
 
   /* no longer need the allocated buffer */
   free(buffer);
 
-  /* set the "back-links" of the register definitions to the peripheral
-     definitions; set the address range of each peripheral */
+  /* set the address range of each peripheral */
   for (idx = 0; idx < peripheral_count; idx++) {
     int ridx;
     unsigned long top = 0;
@@ -510,7 +843,6 @@ int svd_load(const char *filename)
       continue;
     assert(peripheral[idx].reg != NULL);
     for (ridx = 0; ridx < peripheral[idx].reg_count; ridx++) {
-      peripheral[idx].reg[ridx].peripheral = &peripheral[idx];
       assert(peripheral[idx].reg[ridx].range > 0);
       assert(peripheral[idx].reg[ridx].increment > 0);
       if (peripheral[idx].reg[ridx].offset > top)
@@ -520,6 +852,306 @@ int svd_load(const char *filename)
     peripheral[idx].range = top;
   }
 
+  link_registers();
+  return 1;
+}
+
+
+/* The cache file holds the tables of a parsed SVD file: a header with the
+   size and a hash (FNV-1a) of the SVD file, a pool with all names and
+   descriptions (zero-terminated), followed by the peripherals, registers
+   and bit fields. On loading, the strings are used in place in the pool, so
+   descriptions cost nothing until they are displayed. */
+#define SVD_CACHE_MAGIC   "BMSV"
+#define SVD_CACHE_VERSION 1
+#define SVD_NOSTRING      0xffffffffu
+
+typedef struct tagCACHEBUF {
+  unsigned char *data;
+  size_t size;          /* allocated size (writing) or total size (reading) */
+  size_t pos;
+  bool ok;
+} CACHEBUF;
+
+static void cb_write(CACHEBUF *cb, const void *data, size_t size)
+{
+  if (!cb->ok)
+    return;
+  if (cb->pos + size > cb->size) {
+    size_t newsize = (cb->size == 0) ? 4096 : cb->size;
+    while (newsize < cb->pos + size)
+      newsize *= 2;
+    unsigned char *newdata = (unsigned char*)realloc(cb->data, newsize);
+    if (newdata == NULL) {
+      cb->ok = false;
+      return;
+    }
+    cb->data = newdata;
+    cb->size = newsize;
+  }
+  memcpy(cb->data + cb->pos, data, size);
+  cb->pos += size;
+}
+
+static void cb_wint(CACHEBUF *cb, uint32_t value)
+{
+  cb_write(cb, &value, sizeof value);
+}
+
+static uint32_t cb_rint(CACHEBUF *cb)
+{
+  uint32_t value = 0;
+  if (!cb->ok || cb->pos + sizeof value > cb->size)
+    cb->ok = false;
+  else
+    memcpy(&value, cb->data + cb->pos, sizeof value);
+  cb->pos += sizeof value;
+  return value;
+}
+
+/* cb_rcount() reads a count of items, which is checked against the remaining
+   size (each item takes at least "itemsize" bytes) */
+static uint32_t cb_rcount(CACHEBUF *cb, size_t itemsize)
+{
+  uint32_t count = cb_rint(cb);
+  if (cb->ok && count > (cb->size - cb->pos) / itemsize)
+    cb->ok = false;
+  return cb->ok ? count : 0;
+}
+
+/* cb_wstr() stores the string in the pool and its offset in the records */
+static void cb_wstr(CACHEBUF *cb, CACHEBUF *pool, const char *str)
+{
+  if (str == NULL) {
+    cb_wint(cb, SVD_NOSTRING);
+  } else {
+    cb_wint(cb, (uint32_t)pool->pos);
+    cb_write(pool, str, strlen(str) + 1);
+  }
+}
+
+static const char *cb_rstr(CACHEBUF *cb, const char *pool, size_t poolsize)
+{
+  uint32_t offset = cb_rint(cb);
+  if (!cb->ok || offset == SVD_NOSTRING)
+    return NULL;
+  if (offset >= poolsize) {
+    cb->ok = false;
+    return NULL;
+  }
+  return pool + offset;
+}
+
+/* cache_filekey() gets the size and a hash (FNV-1a) of the file contents */
+static bool cache_filekey(const char *filename, uint32_t *size, uint64_t *hash)
+{
+  unsigned char buffer[4096];
+  size_t count;
+  FILE *fp = fopen(filename, "rb");
+  if (fp == NULL)
+    return false;
+  *size = 0;
+  *hash = 0xcbf29ce484222325ull;
+  while ((count = fread(buffer, 1, sizeof buffer, fp)) > 0) {
+    for (size_t idx = 0; idx < count; idx++)
+      *hash = (*hash ^ buffer[idx]) * 0x100000001b3ull;
+    *size += (uint32_t)count;
+  }
+  fclose(fp);
+  return true;
+}
+
+static void cache_save(const char *cachefile, uint32_t size, uint64_t hash)
+{
+  CACHEBUF rec = { NULL, 0, 0, true };
+  CACHEBUF pool = { NULL, 0, 0, true };
+
+  cb_wstr(&rec, &pool, svd_prefix);
+  cb_wint(&rec, (uint32_t)svd_regsize);
+  cb_wint(&rec, (uint32_t)peripheral_count);
+  for (int p = 0; p < peripheral_count; p++) {
+    const PERIPHERAL *per = &peripheral[p];
+    cb_wstr(&rec, &pool, per->name);
+    cb_wstr(&rec, &pool, per->description);
+    cb_wint(&rec, (uint32_t)per->address);
+    cb_wint(&rec, per->range);
+    cb_wint(&rec, (uint32_t)per->reg_count);
+    for (int r = 0; r < per->reg_count; r++) {
+      const REGISTER *reg = &per->reg[r];
+      cb_wstr(&rec, &pool, reg->name);
+      cb_wstr(&rec, &pool, reg->description);
+      cb_wint(&rec, (uint32_t)reg->offset);
+      cb_wint(&rec, reg->range);
+      cb_wint(&rec, reg->increment);
+      cb_wint(&rec, (uint32_t)reg->field_count);
+      for (int b = 0; b < reg->field_count; b++) {
+        const BITFIELD *field = &reg->field[b];
+        cb_wstr(&rec, &pool, field->name);
+        cb_wstr(&rec, &pool, field->description);
+        cb_wint(&rec, (uint32_t)field->low_bit);
+        cb_wint(&rec, (uint32_t)field->high_bit);
+      }
+    }
+  }
+
+  if (rec.ok && pool.ok) {
+    FILE *fp = fopen(cachefile, "wb");
+    if (fp != NULL) {
+      uint32_t value;
+      bool result = (fwrite(SVD_CACHE_MAGIC, 1, 4, fp) == 4);
+      value = SVD_CACHE_VERSION;
+      result = result && fwrite(&value, sizeof value, 1, fp) == 1;
+      result = result && fwrite(&size, sizeof size, 1, fp) == 1;
+      result = result && fwrite(&hash, sizeof hash, 1, fp) == 1;
+      value = (uint32_t)pool.pos;
+      result = result && fwrite(&value, sizeof value, 1, fp) == 1;
+      result = result && fwrite(pool.data, 1, pool.pos, fp) == pool.pos;
+      result = result && fwrite(rec.data, 1, rec.pos, fp) == rec.pos;
+      fclose(fp);
+      if (!result)
+        remove(cachefile);  /* do not leave a truncated cache behind */
+    }
+  }
+  if (rec.data != NULL)
+    free((void*)rec.data);
+  if (pool.data != NULL)
+    free((void*)pool.data);
+}
+
+/* cache_load() rebuilds the tables from the cache file; it returns false if
+   the file does not exist, if it is invalid, or if it does not match the SVD
+   file */
+static bool cache_load(const char *cachefile, uint32_t size, uint64_t hash)
+{
+  CACHEBUF cb = { NULL, 0, 0, true };
+  FILE *fp;
+  long filesize;
+  uint64_t key;
+  const char *pool, *str;
+  size_t poolsize;
+  uint32_t count;
+
+  if ((fp = fopen(cachefile, "rb")) == NULL)
+    return false;
+  fseek(fp, 0, SEEK_END);
+  filesize = ftell(fp);
+  fseek(fp, 0, SEEK_SET);
+  if (filesize <= 0 || (cb.data = (unsigned char*)malloc(filesize)) == NULL) {
+    fclose(fp);
+    return false;
+  }
+  cb.size = filesize;
+  cb.ok = (fread(cb.data, 1, filesize, fp) == (size_t)filesize);
+  fclose(fp);
+
+  /* check the header */
+  if (!cb.ok || cb.size < 4 || memcmp(cb.data, SVD_CACHE_MAGIC, 4) != 0)
+    cb.ok = false;
+  cb.pos = 4;
+  if (cb_rint(&cb) != SVD_CACHE_VERSION || cb_rint(&cb) != size)
+    cb.ok = false;
+  if (cb.ok && cb.pos + sizeof key <= cb.size) {
+    memcpy(&key, cb.data + cb.pos, sizeof key);
+    cb.pos += sizeof key;
+    if (key != hash)
+      cb.ok = false;
+  } else {
+    cb.ok = false;
+  }
+  poolsize = cb_rcount(&cb, 1);
+  pool = (const char*)cb.data + cb.pos;
+  if (poolsize == 0 || pool[poolsize - 1] != '\0')
+    cb.ok = false;  /* all strings must be terminated */
+  cb.pos += poolsize;
+  if (!cb.ok) {
+    free((void*)cb.data);
+    return false;
+  }
+
+  /* from here on, svd_clear() cleans up on failure */
+  svd_cachedata = cb.data;
+  str = cb_rstr(&cb, pool, poolsize);
+  strlcpy(svd_prefix, (str != NULL) ? str : "", sizearray(svd_prefix));
+  svd_regsize = (int)cb_rint(&cb);
+  count = cb_rcount(&cb, 5 * sizeof(uint32_t));
+  if (count > 0 && (peripheral = calloc(count, sizeof(PERIPHERAL))) == NULL)
+    cb.ok = false;
+  peripheral_size = count;
+  for (uint32_t p = 0; cb.ok && p < count; p++) {
+    PERIPHERAL *per = &peripheral[p];
+    if ((per->name = cb_rstr(&cb, pool, poolsize)) == NULL)
+      break;
+    peripheral_count = p + 1;
+    per->description = cb_rstr(&cb, pool, poolsize);
+    per->address = cb_rint(&cb);
+    per->range = cb_rint(&cb);
+    uint32_t regs = cb_rcount(&cb, 6 * sizeof(uint32_t));
+    if (regs > 0 && (per->reg = calloc(regs, sizeof(REGISTER))) == NULL)
+      cb.ok = false;
+    per->reg_size = regs;
+    for (uint32_t r = 0; cb.ok && r < regs; r++) {
+      REGISTER *reg = &per->reg[r];
+      if ((reg->name = cb_rstr(&cb, pool, poolsize)) == NULL)
+        break;
+      per->reg_count = r + 1;
+      reg->description = cb_rstr(&cb, pool, poolsize);
+      reg->offset = cb_rint(&cb);
+      reg->range = (unsigned short)cb_rint(&cb);
+      reg->increment = (unsigned short)cb_rint(&cb);
+      uint32_t fields = cb_rcount(&cb, 4 * sizeof(uint32_t));
+      if (fields > 0 && (reg->field = calloc(fields, sizeof(BITFIELD))) == NULL)
+        cb.ok = false;
+      reg->field_size = fields;
+      for (uint32_t b = 0; cb.ok && b < fields; b++) {
+        BITFIELD *field = &reg->field[b];
+        if ((field->name = cb_rstr(&cb, pool, poolsize)) == NULL)
+          break;
+        reg->field_count = b + 1;
+        field->description = cb_rstr(&cb, pool, poolsize);
+        field->low_bit = (short)cb_rint(&cb);
+        field->high_bit = (short)cb_rint(&cb);
+      }
+      if (reg->field_count != (int)fields)
+        cb.ok = false;
+    }
+    if (per->reg_count != (int)regs)
+      cb.ok = false;
+  }
+  if (peripheral_count != (int)count || cb.pos != cb.size)
+    cb.ok = false;  /* missing or trailing data, the file is corrupt */
+  if (!cb.ok) {
+    svd_clear();
+    return false;
+  }
+  link_registers();
+  return true;
+}
+
+/** svd_load_cached() loads the SVD file like svd_load(), but it first tries
+ *  to load the tables from a cache file. If the cache file is absent or
+ *  outdated, the SVD file is parsed and the cache file is created (or
+ *  refreshed).
+ *
+ *  \param filename   The SVD file.
+ *  \param cachefile  The full path to the cache file. This parameter may be
+ *                    NULL, in which case the SVD file is always parsed.
+ *
+ *  \return 1 on success, 0 on failure.
+ */
+int svd_load_cached(const char *filename, const char *cachefile)
+{
+  uint32_t size;
+  uint64_t hash;
+
+  assert(filename != NULL);
+  if (cachefile == NULL || *cachefile == '\0' || !cache_filekey(filename, &size, &hash))
+    return svd_load(filename);
+  svd_clear();
+  if (cache_load(cachefile, size, hash))
+    return 1;
+  if (!svd_load(filename))
+    return 0;
+  cache_save(cachefile, size, hash);
   return 1;
 }
 
@@ -528,6 +1160,57 @@ const char *svd_mcu_prefix(void)
   return svd_prefix;
 }
 
+/** svd_peripheral_first() returns the index of the first peripheral whose
+ *  name starts with the prefix (the peripherals are sorted on name, so all
+ *  matches follow this one).
+ *  \param prefix       The start of the name.
+ *
+ *  \return The index of the first match, or an index for which the name does
+ *          not match if there is no match (this may be past the end of the
+ *          list).
+ */
+unsigned svd_peripheral_first(const char *prefix)
+{
+  assert(prefix != NULL);
+  unsigned low = 0, high = peripheral_count;
+  while (low < high) {
+    unsigned mid = low + (high - low) / 2;
+    if (strcmp(peripheral[mid].name, prefix) < 0)
+      low = mid + 1;
+    else
+      high = mid;
+  }
+  return low;
+}
+
+/** svd_register_first() returns the index of the first register in the
+ *  peripheral whose name starts with the prefix (the registers are sorted on
+ *  name, so all matches follow this one).
+ *  \param peripheral   The name of the peripheral.
+ *  \param prefix       The start of the register name.
+ *
+ *  \return The index of the first match, or an index for which the name does
+ *          not match if there is no match (this may be past the end of the
+ *          list).
+ */
+unsigned svd_register_first(const char *peripheral, const char *prefix)
+{
+  assert(peripheral != NULL);
+  assert(prefix != NULL);
+  const PERIPHERAL *per = peripheral_find(peripheral);
+  if (per == NULL)
+    return 0;
+  unsigned low = 0, high = per->reg_count;
+  while (low < high) {
+    unsigned mid = low + (high - low) / 2;
+    if (strcmp(per->reg[mid].name, prefix) < 0)
+      low = mid + 1;
+    else
+      high = mid;
+  }
+  return low;
+}
+
 /** svd_peripheral() returns the peripheral at the given index.
  *  \param index        The index of the peripheral to return, starting from 0.
  *  \param address      The base address of the peripheral registers. This
@@ -597,6 +1280,8 @@ static const REGISTER *register_parse(const char *symbol, const char **suffix)
   const REGISTER *reg;
 
   assert(symbol != NULL);
+  if (peripheral_count == 0)
+    return NULL;  /* quick exit */
 
   /* check whether the symbol starts with the prefix, if so, skip the prefix */
   size_t len = strlen(svd_prefix);
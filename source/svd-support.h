@@ -21,11 +21,14 @@
 
 void svd_clear(void);
 int  svd_load(const char *filename);
+int  svd_load_cached(const char *filename, const char *cachefile);
 int  svd_xlate_name(const char *symbol, char *alias, size_t alias_size);
 int  svd_xlate_all_names(char *text, size_t maxsize);
 
 const char *svd_mcu_prefix(void);
 const char *svd_peripheral(unsigned index, unsigned long *address, const char **description);
+unsigned svd_peripheral_first(const char *prefix);
+unsigned svd_register_first(const char *peripheral, const char *prefix);
 const char *svd_register(const char *peripheral, unsigned index, unsigned long *offset,
                          int *range, const char **description);
 const char *svd_bitfield(const char *peripheral, const char *regname, unsigned index,
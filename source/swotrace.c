@@ -1,1812 +1,4847 @@
-/*
- * Shared code for SWO Trace for the bmtrace and bmdebug utilities. It uses
- * WinUSB or libusbK on Microsoft Windows, and libusb 1.0 on Linux.
- *
- * Copyright 2019-2022 CompuPhase
- *
- * Licensed under the Apache License, Version 2.0 (the "License");
- * you may not use this file except in compliance with the License.
- * You may obtain a copy of the License at
- *
- *     http://www.apache.org/licenses/LICENSE-2.0
- *
- * Unless required by applicable law or agreed to in writing, software
- * distributed under the License is distributed on an "AS IS" BASIS,
- * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
- * See the License for the specific language governing permissions and
- * limitations under the License.
- */
-
-#include <assert.h>
-#include <ctype.h>
-#include <stdbool.h>
-#include <stdio.h>
-#include <stdlib.h>
-#include <string.h>
-
-#if defined WIN32 || defined _WIN32
-# define STRICT
-# define WIN32_LEAN_AND_MEAN
-# include <windows.h>
-# include <winsock2.h>
-# include <tchar.h>
-# include <initguid.h>
-# include <setupapi.h>
-# include <malloc.h>
-# include "usb-support.h"
-# if defined __MINGW32__ || defined __MINGW64__ || defined _MSC_VER
-#   include "strlcpy.h"
-# endif
-# if defined _MSC_VER
-#   define memicmp(p1,p2,c)  _memicmp((p1),(p2),(c))
-# endif
-#elif defined __linux__
-# include <alloca.h>
-# include <errno.h>
-# include <pthread.h>
-# include <unistd.h>
-# include <bsd/string.h>
-# include <sys/stat.h>
-# include <sys/socket.h>
-# include <arpa/inet.h>
-# include <libusb-1.0/libusb.h>
-  typedef int SOCKET;
-# define INVALID_SOCKET (-1)
-#endif
-
-#include "bmp-scan.h"
-#include "guidriver.h"
-#include "nuklear_style.h"
-#include "parsetsdl.h"
-#include "decodectf.h"
-#include "swotrace.h"
-
-#if defined FORTIFY
-# include <alloc/fortify.h>
-#endif
-
-
-#if defined __linux__ || defined __FreeBSD__ || defined __APPLE__
-# define stricmp(s1,s2)    strcasecmp((s1),(s2))
-  static int memicmp(const unsigned char *p1, const unsigned char *p2, size_t count);
-#elif defined _MSC_VER
-# define stricmp(a,b)      _stricmp((a),(b))
-#endif
-
-#if !defined sizearray
-# define sizearray(e)    (sizeof(e) / sizeof((e)[0]))
-#endif
-
-
-#define CHANNEL_NAMELENGTH  30
-typedef struct tagCHANNELINFO {
-  bool enabled;
-  struct nk_color color;
-  char name[CHANNEL_NAMELENGTH];
-} CHANNELINFO;
-static CHANNELINFO channels[NUM_CHANNELS];
-
-void channel_set(int index, bool enabled, const char *name, struct nk_color color)
-{
-  assert(index >= 0 && index < NUM_CHANNELS);
-  channels[index].enabled = enabled;
-  channels[index].color = color;
-  if (name == NULL)
-    sprintf(channels[index].name, "%d", index);
-  else
-    strlcpy(channels[index].name, name, sizearray(channels[index].name));
-}
-
-bool channel_getenabled(int index)
-{
-  assert(index >= 0 && index < NUM_CHANNELS);
-  return channels[index].enabled;
-}
-
-void channel_setenabled(int index, bool enabled)
-{
-  assert(index >= 0 && index < NUM_CHANNELS);
-  channels[index].enabled = enabled;
-}
-
-/** channel_getname() returns the name of the channel and optionally copies
- *  it into the parameter.
- *  \param index    The channel index, 0 to 32
- *  \param name     The channel name is copied into this parameter, unless
- *                  this parameter is NULL.
- *  \param size     The buffer size reserved for parameter name.
- *  \return A pointer to the name in the channel structure. If parameter "name"
- *          is NULL, one can use this pointer. If parameter "name" is not NULL,
- *          note that the returned pointer to the name in the channel structure
- *          (so, not to the "name" parameter).
- */
-const char *channel_getname(int index, char *name, size_t size)
-{
-  assert(index >= 0 && index < NUM_CHANNELS);
-  if (name != NULL && size > 0)
-    strlcpy(name, channels[index].name, size);
-  return channels[index].name;
-}
-
-void channel_setname(int index, const char *name)
-{
-  assert(index >= 0 && index < NUM_CHANNELS);
-  if (name == NULL)
-    sprintf(channels[index].name, "%d", index);
-  else
-    strlcpy(channels[index].name, name, sizearray(channels[index].name));
-}
-
-struct nk_color channel_getcolor(int index)
-{
-  assert(index >= 0 && index < NUM_CHANNELS);
-  return channels[index].color;
-}
-
-void channel_setcolor(int index, struct nk_color color)
-{
-  assert(index >= 0 && index < NUM_CHANNELS);
-  channels[index].color = color;
-}
-
-
-#define PACKET_SIZE 64
-#define PACKET_NUM  128
-typedef struct tagPACKET {
-  unsigned char data[PACKET_SIZE];
-  size_t length;
-  double timestamp;
-} PACKET;
-static PACKET trace_queue[PACKET_NUM];
-static int tracequeue_head = 0, tracequeue_tail = 0;
-static int tracequeue_overflow = 0;
-
-typedef struct tagTRACESTRING {
-  struct tagTRACESTRING *next;
-  char *text;
-  double timestamp;       /* in seconds */
-  char timefmt[15];       /* formatted string with time stamp */
-  unsigned short timefmt_len;
-  unsigned short length, size;  /* text length & text buffer size (length <= size) */
-  unsigned char channel;
-  short flags;            /* used to keep state while decoding plain trace messages */
-} TRACESTRING;
-
-static SOCKET TraceSocket = INVALID_SOCKET;
-
-#define TRACESTRING_MAXLENGTH 256
-#define TRACESTRING_INITSIZE  32
-static TRACESTRING tracestring_root = { NULL, NULL };
-static TRACESTRING *tracestring_tail = NULL;
-
-static unsigned char itm_cache[5]; /**< we may need to cache an ITM data packet that does
-                                        not fit completely in an USB packet; ITM data
-                                        packets are 5 bytes max. */
-static size_t itm_cachefilled = 0;
-static unsigned short itm_datasize = 1;    /* size in bytes (not bits) */
-static short itm_datasz_auto = 0;
-static unsigned itm_packet_errors = 0;
-
-#define ITM_VALIDHDR(b)   (((b) & 0x07) >= 1 && ((b) & 0x07) <= 3)
-#define ITM_CHANNEL(b)    (unsigned)(((b) >> 3) & 0x1f) /* get channel number from ITM packet header */
-#define ITM_LENGTH(b)     (unsigned)(((b) & 0x07) == 3 ? 4 : (b) & 0x07)
-
-static void tracestring_add(unsigned channel, const unsigned char *buffer, size_t length, double timestamp)
-{
-  assert(channel < NUM_CHANNELS);
-  assert(buffer != NULL);
-  assert(length > 0);
-
-  /* check whether the channel is enabled (in passive mode, the target that
-     sends the trace messages is oblivious of the settings in this viewer,
-     so it may send trace messages for disabled channels) */
-  if (!channels[channel].enabled)
-    return;
-
-  if (stream_isactive(channel)) {
-    /* CTF mode */
-    int count = ctf_decode(buffer, length, channel);
-    if (count > 0) {
-      uint16_t streamid;
-      double tstamp, tstamp_relative;
-      const char *message;
-      while (msgstack_peek(&streamid, &tstamp, &message)) {
-        TRACESTRING *item = malloc(sizeof(TRACESTRING));
-        if (item != NULL) {
-          memset(item, 0, sizeof(TRACESTRING));
-          item->length = (unsigned short)strlen(message);
-          item->size = item->length + 1;
-          item->text = malloc(item->size * sizeof(unsigned char));
-          if (item->text != NULL) {
-            strcpy(item->text, message);
-            item->length = item->size - 1;
-            item->channel = (unsigned char)streamid;
-            if (tstamp > 0.001)
-              timestamp = tstamp; /* use precision timestamp from remote host */
-            item->timestamp = timestamp;
-            /* create formatted timestamp */
-            if (tracestring_root.next != NULL)
-              tstamp_relative = timestamp - tracestring_root.next->timestamp;
-            else
-              tstamp_relative = 0.0;
-            if (tstamp > 0.001)
-              sprintf(item->timefmt, "%.6f", tstamp_relative);
-            else
-              sprintf(item->timefmt, "%.3f", tstamp_relative);
-            item->timefmt_len = (unsigned short)strlen(item->timefmt);
-            assert(item->timefmt_len < sizearray(item->timefmt));
-            /* append to tail */
-            if (tracestring_tail != NULL)
-              tracestring_tail->next = item;
-            else
-              tracestring_root.next = item;
-            tracestring_tail = item;
-          } else {
-            free((void*)item);
-          }
-        }
-        msgstack_pop(NULL, NULL, NULL, 0);
-      }
-    }
-  } else {
-    /* plain text mode */
-    double tstamp_relative;
-    unsigned idx;
-    while (length > 0 && buffer[length - 1] == '\0')
-      length--; /* this can happen with expansion from zero-compression */
-    for (idx = 0; idx < length; idx++) {
-      /* see whether to append to the recent string, or to add a new string */
-      if (tracestring_tail != NULL) {
-        if (buffer[idx] == '\r' || buffer[idx] == '\n') {
-          tracestring_tail->flags |= 0x01;  /* on newline, create a new string */
-          continue;
-        } else if (tracestring_tail->channel != channel) {
-          tracestring_tail->flags |= 0x01;  /* different channel, terminate previous string */
-        } else if (tracestring_tail->length >= TRACESTRING_MAXLENGTH) {
-          tracestring_tail->flags |= 0x01;  /* line length limit */
-        }
-        /* time criterion: there should not be more that 0.1 seconds between
-           parts of a continued string */
-        if (tracestring_tail != NULL && timestamp - tracestring_tail->timestamp > 0.1)
-          tracestring_tail->flags |= 0x01;  /* interval limit */
-      }
-
-      if (tracestring_tail != NULL && (tracestring_tail->flags & 0x01) == 0) {
-        /* append text to the current string */
-        if (tracestring_tail->length >= tracestring_tail->size) {
-          int newsize = tracestring_tail->size * 2;
-          char *ptr = malloc(newsize * sizeof(unsigned char));
-          if (ptr != NULL) {
-            memcpy(ptr, tracestring_tail->text, tracestring_tail->length);
-            free((void*)tracestring_tail->text);
-            tracestring_tail->text = ptr;
-            tracestring_tail->size = (unsigned short)newsize;
-          }
-        }
-        if (tracestring_tail->length < tracestring_tail->size)
-          tracestring_tail->text[tracestring_tail->length++] = buffer[idx];
-      } else {
-        /* create a new string */
-        TRACESTRING *item;
-        if (tracestring_tail == NULL && (buffer[idx] == '\r' || buffer[idx] == '\n'))
-          continue; /* don't create an empty first string */
-        item = malloc(sizeof(TRACESTRING));
-        if (item != NULL) {
-          memset(item, 0, sizeof(TRACESTRING));
-          item->size = TRACESTRING_INITSIZE;
-          item->text = malloc(item->size * sizeof(unsigned char));
-          if (item->text != NULL) {
-            item->channel = (unsigned char)channel;
-            item->timestamp = timestamp;
-            /* create formatted timestamp */
-            if (tracestring_root.next != NULL)
-              tstamp_relative = timestamp - tracestring_root.next->timestamp;
-            else
-              tstamp_relative = 0.0;
-            sprintf(item->timefmt, "%.3f", tstamp_relative);
-            item->timefmt_len = (unsigned short)strlen(item->timefmt);
-            assert(item->timefmt_len < sizearray(item->timefmt));
-            /* append to tail */
-            if (tracestring_tail != NULL)
-              tracestring_tail->next = item;
-            else
-              tracestring_root.next = item;
-            tracestring_tail = item;
-            tracestring_tail->text[tracestring_tail->length++] = buffer[idx];
-          } else {
-            free(item); /* adding a new string failed */
-          }
-        }
-      }
-    }
-  }
-}
-
-void tracestring_clear(void)
-{
-  TRACESTRING *item;
-  while (tracestring_root.next != NULL) {
-    item = tracestring_root.next;
-    tracestring_root.next = item->next;
-    assert(item->text!=NULL);
-    free((void*)item->text);
-    free((void*)item);
-  }
-  tracestring_tail = NULL;
-}
-
-int tracestring_isempty(void)
-{
-  return (tracestring_root.next == NULL);
-}
-
-unsigned tracestring_count(void)
-{
-  TRACESTRING *item;
-  unsigned count = 0;
-  for (item = tracestring_root.next; item != NULL; item = item->next)
-    count++;
-  return count;
-}
-
-int tracestring_process(bool enabled)
-{
-  int count = 0;
-  while (tracequeue_head != tracequeue_tail) {
-    if (enabled) {
-      const unsigned char *pktdata = trace_queue[tracequeue_head].data;
-      size_t pktlen = trace_queue[tracequeue_head].length;
-      unsigned chan = ~0u;
-      unsigned char buffer[PACKET_SIZE];
-      size_t buflen = 0;
-      unsigned len;
-
-      if (itm_cachefilled>0) {
-        int skip = 0;
-        chan = ITM_CHANNEL(itm_cache[0]);
-        len = ITM_LENGTH(itm_cache[0]);
-        if (len > itm_datasize) {
-          if (itm_datasz_auto) {
-            itm_datasize = len; /* if larger data word is found, datasize must be adjusted */
-          } else {
-            ctf_decode_reset();
-            itm_packet_errors += 1;
-            goto skip_packet;   /* not a valid ITM packet, ignore it */
-          }
-        }
-        assert(itm_cachefilled <= 4);
-        if (itm_cachefilled > 1) {
-          /* copy data bytes still in the cache */
-          memcpy(buffer + buflen, itm_cache + 1, itm_cachefilled - 1);
-          buflen += itm_cachefilled - 1;
-        }
-        skip = len - (itm_cachefilled - 1);
-        assert(skip > 0);       /* there must be data left to copy (otherwise nothing would be cached) */
-        memcpy(buffer + buflen, pktdata, skip);
-        buflen += skip;
-        pktdata += skip;
-        pktlen -= skip;
-        itm_cachefilled = 0;
-      } else {
-        assert(pktlen > 0);
-        chan = ITM_CHANNEL(*pktdata);
-      }
-
-      while (pktlen > 0) {
-        if (*pktdata == 0x17) {
-          /* profile packet (PC address) */
-          pktdata += 5;
-          pktlen = (pktlen > 5) ? pktlen - 5 : 0;
-          continue;
-        } else if (!ITM_VALIDHDR(*pktdata)) {
-          ctf_decode_reset();
-          itm_packet_errors += 1;
-          goto skip_packet;     /* not a valid ITM packet, ignore it */
-        }
-        /* if the channel changes in the middle of a packet, add a string and
-           restart */
-        if (chan != ITM_CHANNEL(*pktdata)) {
-          if (chan < NUM_CHANNELS && buflen > 0)
-            tracestring_add(chan, buffer, buflen, trace_queue[tracequeue_head].timestamp);
-          chan = ITM_CHANNEL(*pktdata);
-          buflen = 0;
-        }
-        len = ITM_LENGTH(*pktdata);
-        if (pktlen < len + 1) {
-          /* store remaining data in the packet in the cache and quit */
-          memcpy(itm_cache, pktdata, pktlen);
-          itm_cachefilled = pktlen;
-          break;
-        }
-        if (len > itm_datasize) {
-          if (itm_datasz_auto) {
-            itm_datasize = len; /* if larger data word is found, datasize must be adjusted */
-          } else {
-            ctf_decode_reset();
-            itm_packet_errors += 1;
-            goto skip_packet;   /* not a valid ITM packet, ignore it */
-          }
-        }
-        memcpy(buffer + buflen, pktdata + 1, len);
-        buflen += len;
-        pktdata += len + 1;
-        pktlen -= len + 1;
-      }
-      if (chan < NUM_CHANNELS && buflen > 0) {
-        tracestring_add(chan, buffer, buflen, trace_queue[tracequeue_head].timestamp);
-        count++;
-      }
-    }
-  skip_packet:
-    tracequeue_head = (tracequeue_head + 1) % PACKET_NUM;
-  }
-
-  if (!enabled)
-    tracequeue_overflow = 0;  /* ignore overflow events if not running/decoding */
-  return count;
-}
-
-int tracestring_find(const char *text, int curline)
-{
-  TRACESTRING *item;
-  int line, cur_mark, len;
-
-  assert(curline >= 0 || curline == -1);
-  assert(text != NULL);
-  len = strlen(text);
-
-  cur_mark = curline + 1;
-  item = tracestring_root.next;
-  line = 0;
-  while (item != NULL && line < cur_mark) {
-    line++;
-    item = item->next;
-  }
-  if (item == NULL || curline < 0) {
-    item = tracestring_root.next;
-    line = 0;
-  } else {
-    item = item->next;
-    line++;
-  }
-  while ((line != cur_mark || curline < 0) && item != NULL) {
-    int idx;
-    curline = cur_mark;
-    idx = 0;
-    while (idx < item->length) {
-      while (idx < item->length && toupper(item->text[idx]) != toupper(text[0]))
-        idx++;
-      if (idx + len > item->length)
-        break;      /* not found on this line */
-      if (memicmp((const unsigned char*)item->text + idx, (const unsigned char*)text, len) == 0)
-        break;      /* found on this line */
-      idx++;
-    }
-    if (idx + len <= item->length)
-      return line;  /* found, stop search */
-    item = item->next;
-    line++;
-    if (item == NULL) {
-      item = tracestring_root.next;
-      line = 0;
-    }
-  } /* while (line != cur_mark) */
-
-  return -1;  /* not found */
-}
-
-/** tracestring_findtimestamp() finds the line closest to the given
- *  timestamp. Note that it can return -1 when there are not strings in the
- *  list.
- */
-int tracestring_findtimestamp(double timestamp)
-{
-  TRACESTRING *item;
-  int line = 0;
-  for (item = tracestring_root.next; item != NULL && item->timestamp < timestamp; item = item->next)
-    line += 1;
-  return line - 1;
-}
-
-int tracestring_save(const char *filename)
-{
-  FILE *fp;
-  TRACESTRING *item;
-  char *buffer;
-  size_t bufsize;
-
-  fp = fopen(filename, "wt");
-  if (fp == NULL)
-    return 0;
-
-  bufsize = 0;
-  for (item = tracestring_root.next; item != NULL; item = item->next)
-    if (item->length > bufsize)
-      bufsize = item->length;
-
-  buffer = malloc((bufsize + 1) * sizeof(char));
-  if (buffer == NULL) {
-    fclose(fp);
-    return 0;
-  }
-
-  fprintf(fp, "Number,Name,Timestamp,Text\n");
-  for (item = tracestring_root.next; item != NULL; item = item->next) {
-    memcpy(buffer, item->text, item->length);
-    buffer[item->length] = '\0';
-    fprintf(fp, "%d,\"%s\",%.6f,\"%s\"\n", item->channel, channels[item->channel].name,
-            item->timestamp, buffer);
-  }
-
-  free((void*)buffer);
-  fclose(fp);
-  return 1;
-}
-
-
-/** trace_setdatasize() sets the data size in an ITM packet, in bytes. Valid
- *  values are 1, 2 and 4. For automatic detection, set "size" to 0.
- */
-void trace_setdatasize(short size)
-{
-  assert(size == 0 || size == 1 || size == 2 || size == 4);
-  itm_datasize = (size == 0) ? 1 : size;
-  itm_datasz_auto = (size == 0);
-  itm_packet_errors = 0;
-}
-
-/** trace_getdatasize() returns the datasize currently set. */
-short trace_getdatasize(void)
-{
-  return itm_datasize;
-}
-
-int trace_getpacketerrors(bool reset)
-{
-  int result = itm_packet_errors;
-  if (reset)
-    itm_packet_errors = 0;
-  return result;
-}
-
-int trace_overflowerrors(bool reset)
-{
-  int result = tracequeue_overflow;
-  if (reset)
-    tracequeue_overflow = 0;
-  return result;
-}
-
-static void addsample(uint32_t pc, unsigned *sample_map, uint32_t code_base, uint32_t code_top)
-{
-  assert(sample_map != NULL);
-  if (pc < code_base || pc >= code_top)
-    pc = code_top;
-  unsigned idx = Address2Index(pc, code_base);
-  sample_map[idx] += 1;
-}
-
-int traceprofile_process(bool enabled, unsigned *sample_map, uint32_t code_base, uint32_t code_top,
-                         unsigned *overflow)
-{
-  int count = 0;
-  int overflow_count = 0;
-  while (tracequeue_head != tracequeue_tail) {
-    if (enabled && sample_map != NULL) {
-      const unsigned char *pktdata = trace_queue[tracequeue_head].data;
-      size_t pktlen = trace_queue[tracequeue_head].length;
-
-      /* first handle cached data (that crosses USB packets) */
-      if (itm_cachefilled > 0) {
-        unsigned char buffer[5];
-        memcpy(buffer, itm_cache, itm_cachefilled);
-        size_t needed = ITM_VALIDHDR(itm_cache[0]) ? ITM_LENGTH(itm_cache[0]) + 1 : 5;
-        assert(itm_cachefilled < needed);
-        needed -= itm_cachefilled;
-        if (needed > pktlen) {
-          /* cached data plus new data block *still* do not make a complete packet */
-          memcpy(itm_cache + itm_cachefilled, pktdata, pktlen);
-          itm_cachefilled += pktlen;
-          pktlen = 0; /* avoid dropping into the "while" below */
-        } else {
-          memcpy(buffer + itm_cachefilled, pktdata, needed);
-          pktdata += needed;
-          pktlen -= needed;
-          /* handling the packet is simpler now, because we know that we have
-             a full packet (plus: we don't care about unsupported packets,
-             because we can simply drop the cache, and we don't handle the
-             overflow packet because it is only one byte, so it can never
-             overflow */
-          if (buffer[0] == 0x17) {
-            uint32_t pc;
-            memcpy(&pc, buffer + 1, 4);
-            addsample(pc, sample_map, code_base, code_top);
-            count += 1;
-          }
-          itm_cachefilled = 0;
-        }
-      }
-
-      while (pktlen > 0) {
-        if (*pktdata == 0x17) {
-          /* PC sample packet */
-          if (pktlen >= 5) {
-            uint32_t pc;
-            memcpy(&pc, pktdata + 1, 4);
-            addsample(pc, sample_map, code_base, code_top);
-            pktlen -= 5;
-            pktdata += 5;
-            count += 1;
-          } else {
-            memcpy(itm_cache, pktdata, pktlen);
-            itm_cachefilled = pktlen;
-            pktlen = 0;
-          }
-        } else if (*pktdata == 0x70) {
-          /* overflow packet */
-          pktlen -= 1;
-          pktdata += 1;
-          overflow_count += 1;
-        } else {
-          /* unknown/unsupported packet */
-          unsigned len = ITM_VALIDHDR(*pktdata) ? ITM_LENGTH(*pktdata) : 4;
-          len += 1; /* include packet header */
-          if (pktlen >= len) {
-            pktlen -= len;
-            pktdata += len;
-          } else {
-            memcpy(itm_cache, pktdata, pktlen);
-            itm_cachefilled = pktlen;
-            pktlen = 0;
-          }
-        }
-      }
-    }
-    tracequeue_head = (tracequeue_head + 1) % PACKET_NUM;
-  }
-
-  if (overflow != NULL)
-    *overflow = overflow_count;
-  return count;
-}
-
-#if defined WIN32 || defined _WIN32
-
-static unsigned long win_errno = 0;
-static int loc_errno = 0;
-static HANDLE hThread = NULL;
-static HANDLE hUSBdev = INVALID_HANDLE_VALUE;
-static USB_INTERFACE_HANDLE hUSBiface = INVALID_HANDLE_VALUE;
-static KLST_DEVINFO *usbk_Device = NULL;
-static unsigned char usbTraceEP = BMP_EP_TRACE;
-static LARGE_INTEGER pcfreq;
-
-
-static BOOL MakeGUID(const char *label, GUID *guid)
-{
-  unsigned i;
-  char b[5];
-
-  /* check whether the string has a valid format &*/
-  if (strlen(label) != 38)
-    return FALSE;
-  for (i=0; i<strlen(label); i++) {
-    char c = label[i];
-    if (i == 0) {
-      if (c != '{')
-        return FALSE;
-    } else if (i == 37) {
-      if (c != '}')
-        return FALSE;
-    } else if (i == 9 || i == 14 || i == 19 || i == 24) {
-      if (c != '-')
-        return FALSE;
-    } else {
-      if (!(c >= '0' && c <= '9') && !(c >= 'A' && c <= 'F') && !(c >= 'a' && c <= 'f'))
-        return FALSE;
-    }
-  }
-
-  guid->Data1 = strtoul(label+1, NULL, 16);
-  guid->Data2 = (unsigned short)strtoul(label+10, NULL, 16);
-  guid->Data3 = (unsigned short)strtoul(label+15, NULL, 16);
-  memset(b, 0, sizeof b);
-  for (i = 0; i < 2; i++) {
-    memcpy(&b[0], label+20+i*2, 2*sizeof(b[0]));
-    guid->Data4[i] = (unsigned char)strtoul(&b[0], NULL, 16);
-  }
-  for (i = 0; i < 6; i++) {
-    memcpy(&b[0], label+25+i*2, 2*sizeof(b[0]));
-    guid->Data4[2+i] = (unsigned char)strtoul(&b[0], NULL, 16);
-  }
-
-  return TRUE;
-}
-
-static BOOL usb_GetDevicePath(const TCHAR *guid, TCHAR *path, size_t pathsize)
-{
-  GUID ClsId;
-  HDEVINFO hDevInfo;
-  DWORD dwSize;
-  BOOL result = FALSE;
-
-  /* convert the string to a GUID */
-  MakeGUID(guid, &ClsId);
-
-  /* get the device information set for all USB devices that have a device
-     interface and are currently present on the system (plugged in). */
-  hDevInfo = SetupDiGetClassDevs(&ClsId, NULL, 0, DIGCF_DEVICEINTERFACE | DIGCF_PRESENT);
-  if (hDevInfo != INVALID_HANDLE_VALUE) {
-    SP_DEVICE_INTERFACE_DATA DevIntfData;
-    /* keep calling SetupDiEnumDeviceInterfaces(..) until it fails with code
-       ERROR_NO_MORE_ITEMS (with call the dwMemberIdx value needs to be
-       incremented to retrieve the next device interface information */
-    DevIntfData.cbSize = sizeof(SP_DEVICE_INTERFACE_DATA);
-    loc_errno = 1;
-    result = SetupDiEnumDeviceInterfaces(hDevInfo, NULL, &ClsId, 0, &DevIntfData);
-
-    if (result) {
-      SP_DEVINFO_DATA DevData;
-      PSP_DEVICE_INTERFACE_DETAIL_DATA DevIntfDetailData;
-      /* get more details for each of the interfaces, including the device path
-         (which contains the device's VID/PID */
-      DevData.cbSize = sizeof(DevData);
-
-      /* get the required buffer size, then allocate the memory for it and
-         initialize the cbSize field */
-      SetupDiGetDeviceInterfaceDetail(hDevInfo, &DevIntfData, NULL, 0,&dwSize, NULL);
-      DevIntfDetailData = HeapAlloc(GetProcessHeap(), HEAP_ZERO_MEMORY, dwSize);
-#     if defined _UNICODE
-        DevIntfDetailData->cbSize = sizeof(SP_INTERFACE_DEVICE_DETAIL_DATA);
-#     elif defined _WIN64
-        DevIntfDetailData->cbSize = 8; // sizeof(SP_INTERFACE_DEVICE_DETAIL_DATA);
-#     else
-        DevIntfDetailData->cbSize = 5; // sizeof(SP_INTERFACE_DEVICE_DETAIL_DATA);
-#     endif
-
-      loc_errno = 2;
-      if (SetupDiGetDeviceInterfaceDetail(hDevInfo, &DevIntfData, DevIntfDetailData, dwSize, &dwSize, &DevData)) {
-        assert(path!=NULL);
-        assert(pathsize>0);
-#       if defined _UNICODE
-          memset(path, 0, pathsize*sizeof(TCHAR));
-          _tcsncpy(path, (TCHAR*)DevIntfDetailData->DevicePath, pathsize-1);
-#       else
-          strlcpy(path, DevIntfDetailData->DevicePath, pathsize);
-#       endif
-      } else {
-        result = FALSE;
-      }
-
-      HeapFree(GetProcessHeap(), 0, DevIntfDetailData);
-    }
-
-    SetupDiDestroyDeviceInfoList(hDevInfo);
-  }
-
-  if (!result)
-    win_errno = GetLastError();
-  return result;
-}
-
-static BOOL __stdcall USBK_Enumerate(KLST_HANDLE DeviceList, KLST_DEVINFO *DeviceInfo, PVOID Context)
-{
-  (void)DeviceList;
-  assert(DeviceInfo != NULL);
-  assert(Context != NULL);
-  if (DeviceInfo->DevicePath != NULL && stricmp(DeviceInfo->DevicePath, (TCHAR*)Context) == 0) {
-    usbk_Device = DeviceInfo;
-    return FALSE; /* no need to look further */
-  }
-  return TRUE;
-}
-
-static BOOL usb_OpenDevice(const TCHAR *path, HANDLE *hdevUSB, USB_INTERFACE_HANDLE *hifaceUSB)
-{
-  BOOL result = FALSE;
-
-  assert(hdevUSB != NULL);
-  assert(hifaceUSB != NULL);
-  *hdevUSB = *hifaceUSB = INVALID_HANDLE_VALUE;  /* preset, in case initialization fails */
-
-  /* try WinUSB first */
-  if (WinUsb_Load()) {
-    loc_errno = 3;
-    *hdevUSB = CreateFile(path, GENERIC_WRITE | GENERIC_READ,
-                          FILE_SHARE_WRITE | FILE_SHARE_READ,
-                          NULL, OPEN_EXISTING,
-                          FILE_ATTRIBUTE_NORMAL | FILE_FLAG_OVERLAPPED, NULL);
-    if (*hdevUSB != INVALID_HANDLE_VALUE) {
-      assert(WinUsb_IsActive());
-      loc_errno = 4;
-      result = _WinUsb_Initialize(*hdevUSB, hifaceUSB);
-      if (!result) {
-        win_errno = GetLastError();
-        CloseHandle(*hdevUSB);
-        WinUsb_Unload();
-        *hdevUSB = *hifaceUSB = INVALID_HANDLE_VALUE;
-      }
-    } else {
-      win_errno = GetLastError();
-    }
-  }
-
-  /* try libusbK next */
-  if (!result && UsbK_Load()) {
-    KLST_DEVINFO *DeviceList;
-    uint32_t count;
-    loc_errno = 5;
-    if (_LstK_Init(&DeviceList, 0) && _LstK_Count(DeviceList, &count) && count > 0) {
-      usbk_Device = NULL;
-      _LstK_Enumerate(DeviceList, USBK_Enumerate, (void*)path);
-      if (usbk_Device != NULL) {
-        *hdevUSB = usbk_Device;
-        loc_errno = 6;
-        result = _UsbK_Init(hifaceUSB, usbk_Device);
-        if (!result) {
-          win_errno = GetLastError();
-          _LstK_Free(DeviceList);
-          UsbK_Unload();
-          *hdevUSB = *hifaceUSB = INVALID_HANDLE_VALUE;
-        }
-      }
-      _LstK_Free(DeviceList);
-    }
-  }
-
-  return result;
-}
-
-/* endpoint: use 0x85 for input endpoint #5
- */
-static BOOL usb_ConfigEndpoint(USB_INTERFACE_HANDLE hUSB, unsigned char endpoint)
-{
-  BOOL result;
-  USB_INTERFACE_DESCRIPTOR ifaceDescriptor;
-
-  assert(hUSB != INVALID_HANDLE_VALUE);
-  usbTraceEP = endpoint;
-
-  if (WinUsb_IsActive()) {
-    loc_errno = 7;
-    if (_WinUsb_QueryInterfaceSettings(hUSB, 0, &ifaceDescriptor)) {
-      USB_PIPE_INFORMATION pipeInfo;
-      int idx;
-      for (idx=0; idx<ifaceDescriptor.bNumEndpoints; idx++) {
-        memset(&pipeInfo, 0, sizeof(pipeInfo));
-        loc_errno = 8;
-        result = _WinUsb_QueryPipe(hUSB, 0, (unsigned char)idx, &pipeInfo);
-        if (result && pipeInfo.PipeId == endpoint)
-          return TRUE;
-      }
-    }
-  } else if (UsbK_IsActive()) {
-    loc_errno = 9;
-    if (_UsbK_QueryInterfaceSettings(hUSB, 0, &ifaceDescriptor)) {
-      USB_PIPE_INFORMATION pipeInfo;
-      int idx;
-      for (idx=0; idx<ifaceDescriptor.bNumEndpoints; idx++) {
-        memset(&pipeInfo, 0, sizeof(pipeInfo));
-        loc_errno = 10;
-        result = _UsbK_QueryPipe(hUSB, 0, (unsigned char)idx, &pipeInfo);
-        if (result && pipeInfo.PipeId == endpoint)
-          return TRUE;
-      }
-    }
-  }
-
-  win_errno = GetLastError();
-  return FALSE;
-}
-
-/** get_timestamp() returns a precision timestamp; the returned value is in
- *  seconds, but the fractional part has a precision of at least milliseconds.
- */
-double get_timestamp(void)
-{
-  LARGE_INTEGER t;
-
-  if (pcfreq.LowPart == 0 && pcfreq.HighPart == 0)
-    QueryPerformanceFrequency(&pcfreq);
-  QueryPerformanceCounter(&t);
-  return (double)t.QuadPart / (double)pcfreq.QuadPart;
-}
-
-static DWORD __stdcall trace_read(LPVOID arg)
-{
-  unsigned char buffer[PACKET_SIZE];
-
-  (void)arg;
-
-  if (TraceSocket != INVALID_SOCKET) {
-    for ( ;; ) {
-      int result = recv(TraceSocket, (char*)buffer, sizearray(buffer), 0);
-      if (result > 0) {
-        int next = (tracequeue_tail + 1) % PACKET_NUM;
-        if (next != tracequeue_head) {
-          memcpy(trace_queue[tracequeue_tail].data, buffer, result);
-          trace_queue[tracequeue_tail].length = result;
-          trace_queue[tracequeue_tail].timestamp = get_timestamp();
-          tracequeue_tail = next;
-          PostMessage((HWND)guidriver_apphandle(), WM_USER, 0, 0L); /* just a flag to wake up the GUI */
-        } else {
-          tracequeue_overflow += 1; /* notify packet queue overflow */
-        }
-      } else if (result < 0) {
-        break;
-      }
-    }
-  } else if (WinUsb_IsActive()) {
-    for ( ;; ) {
-      uint32_t numread = 0;
-      if (_WinUsb_ReadPipe(hUSBiface, usbTraceEP, buffer, sizearray(buffer), &numread, NULL)) {
-        /* add the packet to the queue */
-        if (numread > 0) {
-          int next = (tracequeue_tail + 1) % PACKET_NUM;
-          if (next != tracequeue_head) {
-            memcpy(trace_queue[tracequeue_tail].data, buffer, numread);
-            trace_queue[tracequeue_tail].length = numread;
-            trace_queue[tracequeue_tail].timestamp = get_timestamp();
-            tracequeue_tail = next;
-            PostMessage((HWND)guidriver_apphandle(), WM_USER, 0, 0L); /* just a flag to wake up the GUI */
-          } else {
-            tracequeue_overflow += 1; /* notify packet queue overflow */
-          }
-        }
-      } else {
-        Sleep(50);
-      }
-    }
-  } else if (UsbK_IsActive()) {
-    for ( ;; ) {
-      uint32_t numread = 0;
-      if (_UsbK_ReadPipe(hUSBiface, usbTraceEP, buffer, sizearray(buffer), &numread, NULL)) {
-        /* add the packet to the queue */
-        if (numread > 0) {
-          int next = (tracequeue_tail + 1) % PACKET_NUM;
-          if (next != tracequeue_head) {
-            memcpy(trace_queue[tracequeue_tail].data, buffer, numread);
-            trace_queue[tracequeue_tail].length = numread;
-            trace_queue[tracequeue_tail].timestamp = get_timestamp();
-            tracequeue_tail = next;
-            PostMessage((HWND)guidriver_apphandle(), WM_USER, 0, 0L); /* just a flag to wake up the GUI */
-          } else {
-            tracequeue_overflow += 1; /* notify packet queue overflow */
-          }
-        }
-      } else {
-        Sleep(50);
-      }
-    }
-  }
-
-  return 0;
-}
-
-/** trace_init() opens the SWO tracing channel. If ipaddress is NULL, the USB
- *  channel is opened and endpoint is the USB endpoint. If ipaddress is a valid
- *  IP address, endpoint is the port number.
- */
-int trace_init(unsigned short endpoint, const char *ipaddress)
-{
-  loc_errno = 0;
-  win_errno = 0;
-  tracequeue_overflow = 0;
-  if (hThread != NULL && hUSBiface != INVALID_HANDLE_VALUE)
-    return TRACESTAT_OK;            /* double initialization */
-
-  /* if a previous initialization did not succeed completely, clean up before
-     retrying */
-  trace_close();
-
-  if (ipaddress != NULL) {
-    struct sockaddr_in server;
-    if ((TraceSocket = socket(AF_INET, SOCK_STREAM, 0)) == INVALID_SOCKET) {
-      win_errno = WSAGetLastError();
-      return TRACESTAT_NO_INTERFACE;
-    }
-    server.sin_addr.s_addr = inet_addr(ipaddress);
-    server.sin_family = AF_INET;
-    server.sin_port = htons(endpoint);
-    if (connect(TraceSocket, (struct sockaddr*)&server, sizeof(server)) != 0) {
-      win_errno = WSAGetLastError();
-      closesocket(TraceSocket);
-      TraceSocket = INVALID_SOCKET;
-      return TRACESTAT_NO_PIPE;
-    }
-  } else {
-    TCHAR guid[100], path[_MAX_PATH];
-    if (!find_bmp(0, BMP_IF_TRACE, guid, sizearray(guid)))
-      return TRACESTAT_NO_INTERFACE;  /* Black Magic Probe not found (trace interface not found) */
-    if (!usb_GetDevicePath(guid, path, sizearray(path)))
-      return TRACESTAT_NO_DEVPATH;    /* device path to trace interface not found (should not occur) */
-
-    if (!usb_OpenDevice(path, &hUSBdev, &hUSBiface))
-      return TRACESTAT_NO_ACCESS;     /* failure opening the device interface */
-    if (!usb_ConfigEndpoint(hUSBiface, endpoint))
-      return TRACESTAT_NO_PIPE;       /* endpoint pipe could not be found -> not a Black Magic Probe? */
-  }
-
-  hThread = CreateThread(NULL, 0, trace_read, NULL, 0, NULL);
-  if (hThread == NULL) {
-    loc_errno = 11;
-    win_errno = GetLastError();
-    return TRACESTAT_NO_THREAD;
-  }
-  SetThreadPriority(hThread, THREAD_PRIORITY_HIGHEST);
-
-  return TRACESTAT_OK;
-}
-
-void trace_close(void)
-{
-  loc_errno = 0;
-  win_errno = 0;
-  if (hThread != NULL) {
-    TerminateThread(hThread, 0);
-    hThread = NULL;
-  }
-  if (hUSBiface != INVALID_HANDLE_VALUE) {
-    assert(hUSBdev != INVALID_HANDLE_VALUE);  /* if hUSBiface is valid, hUSBdev must be too */
-    if (WinUsb_IsActive()) {
-      CloseHandle(hUSBdev);
-      _WinUsb_Free(hUSBiface);
-      WinUsb_Unload();
-    } else if (UsbK_IsActive()) {
-      _UsbK_Free(hUSBiface);
-      UsbK_Unload();
-    }
-    hUSBdev = hUSBiface = INVALID_HANDLE_VALUE;
-  }
-  if (TraceSocket != INVALID_SOCKET) {
-    closesocket(TraceSocket);
-    TraceSocket = INVALID_SOCKET;
-  }
-}
-
-unsigned long trace_errno(int *loc)
-{
-  if (loc != NULL)
-    *loc = loc_errno;
-  return win_errno;
-}
-
-#else
-
-static pthread_t hThread;
-static libusb_device_handle *hUSBiface;
-static unsigned char usbTraceEP = BMP_EP_TRACE;
-static volatile int force_exit;
-
-static int memicmp(const unsigned char *p1, const unsigned char *p2, size_t count)
-{
-  int diff = 0;
-  while (count-- > 0 && diff == 0)
-    diff = toupper(*p1++) - toupper(*p2++);
-  return diff;
-}
-
-/** get_timestamp() returns a precision timestamp; the returned value is in
- *  seconds, but the fractional part has a precision of at least milliseconds.
- */
-double get_timestamp(void)
-{
-  struct timeval tv;
-  gettimeofday(&tv,NULL);
-  return tv.tv_sec + tv.tv_usec / 1000000.0;
-}
-
-static void *trace_read(void *arg)
-{
-  unsigned char buffer[PACKET_SIZE];
-  int numread = 0;
-
-  (void)arg;
-  while (!force_exit && hThread != 0 && hUSBiface != NULL) {
-    if (libusb_bulk_transfer(hUSBiface, usbTraceEP, buffer, sizeof(buffer), &numread, 0) == 0) {
-      /* add the packet to the queue */
-      if (numread > 0) {
-        int next = (tracequeue_tail + 1) % PACKET_NUM;
-        if (next != tracequeue_head) {
-          memcpy(trace_queue[tracequeue_tail].data, buffer, numread);
-          trace_queue[tracequeue_tail].length = numread;
-          trace_queue[tracequeue_tail].timestamp = get_timestamp();
-          tracequeue_tail = next;
-        } else {
-          tracequeue_overflow += 1; /* notify packet queue overflow */
-        }
-      }
-    }
-  }
-  force_exit = 0;
-  return 0;
-}
-
-static int usb_OpenDevice(libusb_device_handle **hUSB, const char *path)
-{
-  libusb_device **devs;
-  libusb_device_handle *handle;
-  ssize_t cnt;
-  int devidx, i, res;
-
-  /* get list of all devices */
-  cnt = libusb_get_device_list(0, &devs);
-  if (cnt < 0)
-    return TRACESTAT_INIT_FAILED;
-
-  /* find the BMP (this always opens the first device with the matching VID:PID) */
-  devidx = -1;
-  for (i = 0; devs[i] != NULL; i++) {
-    struct libusb_device_descriptor desc;
-    res = libusb_get_device_descriptor(devs[i], &desc);
-    if (res >= 0 && desc.idVendor == BMP_VID && desc.idProduct == BMP_PID) {
-      uint8_t bus = libusb_get_bus_number(devs[i]);
-      uint8_t port = libusb_get_port_number(devs[i]);
-      char *dash;
-      assert(path != NULL);
-      if (bus == strtol(path, &dash, 10) && *dash == '-' && port == strtol(dash + 1, NULL, 10)) {
-        devidx = i;
-        break;
-      }
-    }
-  }
-  if (devidx < 0) {
-    libusb_free_device_list(devs, 1);
-    return TRACESTAT_NO_DEVPATH;
-  }
-
-  res = libusb_open(devs[devidx], &handle);
-  libusb_free_device_list(devs, 1);
-  if (res < 0)
-    return TRACESTAT_NO_ACCESS;
-
-  /* connect to the BMP capture interface */
-  res = libusb_claim_interface(handle, BMP_IF_TRACE);
-  if (res < 0) {
-    libusb_close(handle);
-    return TRACESTAT_NO_INTERFACE;
-  }
-
-  assert(hUSB != NULL);
-  *hUSB = handle;
-  return TRACESTAT_OK;
-}
-
-int trace_init(unsigned short endpoint, const char *ipaddress)
-{
-  int result;
-
-  tracequeue_overflow = 0;
-  usbTraceEP = endpoint;
-
-  if (hThread != 0 && hUSBiface != NULL)
-    return TRACESTAT_OK;            /* double initialization */
-
-  /* if a previous initialization did not succeed completely, clean up before
-     retrying */
-  trace_close();
-
-  if (ipaddress != NULL) {
-    struct sockaddr_in server;
-    if ((TraceSocket = socket(AF_INET, SOCK_STREAM, 0)) == INVALID_SOCKET)
-      return TRACESTAT_NO_INTERFACE;
-
-    server.sin_addr.s_addr = inet_addr(ipaddress);
-    server.sin_family = AF_INET;
-    server.sin_port = htons(endpoint);
-    if (connect(TraceSocket, (struct sockaddr*)&server, sizeof(server)) != 0) {
-      close(TraceSocket);
-      TraceSocket = INVALID_SOCKET;
-      return TRACESTAT_NO_PIPE;
-    }
-  } else {
-    char dev_id[50];
-    if (!find_bmp(0, BMP_IF_TRACE, dev_id, sizearray(dev_id)))
-      return TRACESTAT_NO_INTERFACE;  /* Black Magic Probe not found (trace interface not found) */
-
-    result = libusb_init(0);
-    if (result < 0)
-      return TRACESTAT_INIT_FAILED;
-
-    result = usb_OpenDevice(&hUSBiface, dev_id);
-    if (result != TRACESTAT_OK)
-      return result;
-  }
-
-  force_exit = 0;
-  result = pthread_create(&hThread, NULL, trace_read, NULL);
-  if (result != 0)
-    return TRACESTAT_NO_THREAD;
-
-  return TRACESTAT_OK;
-}
-
-void trace_close(void)
-{
-  if (hThread != 0) {
-    force_exit = 1;
-    while (force_exit)
-      usleep(10*1000);
-    hThread = 0;
-  }
-  if (hUSBiface != NULL) {
-    libusb_close(hUSBiface);
-    hUSBiface = NULL;
-  }
-}
-
-unsigned long trace_errno(int *loc)
-{
-  (void)loc;  /* parameter currently only relevant for Windows */
-  return errno;
-}
-#endif
-
-static TRACESTRING statusmessage_root = { NULL, NULL };
-
-void tracelog_statusmsg(int type, const char *msg, int code)
-{
-  TRACESTRING *item, *tail;
-
-  assert(type == TRACESTATMSG_BMP || type == TRACESTATMSG_CTF);
-  assert(msg != NULL);
-  item = malloc(sizeof(TRACESTRING));
-  if (item != NULL) {
-    memset(item, 0, sizeof(TRACESTRING));
-    item->length = (unsigned short)strlen(msg);
-    item->size = item->length + 1;
-    item->text = malloc(item->size * sizeof(unsigned char));
-    if (item->text != NULL) {
-      strcpy(item->text, msg);
-      item->channel = (unsigned char)type;
-      item->flags = (short)code;
-      /* append to tail */
-      for (tail = &statusmessage_root; tail->next != NULL; tail = tail->next)
-        {}
-      tail->next = item;
-    } else {
-      free((void*)item);
-    }
-  }
-}
-
-void tracelog_statusclear(void)
-{
-  TRACESTRING *item;
-  while (statusmessage_root.next != NULL) {
-    item = statusmessage_root.next;
-    statusmessage_root.next = item->next;
-    assert(item->text!=NULL);
-    free((void*)item->text);
-    free((void*)item);
-  }
-}
-
-const char *tracelog_getstatusmsg(int idx)
-{
-  for (TRACESTRING *item = statusmessage_root.next; item != NULL; item = item->next) {
-    if (idx-- == 0)
-      return item->text;
-  }
-  return NULL;
-}
-
-float tracelog_labelwidth(float rowheight)
-{
-  int idx;
-  float labelwidth = 0;
-  for (idx = 0; idx < NUM_CHANNELS; idx++) {
-    int len = strlen(channels[idx].name);
-    if (labelwidth < len)
-      labelwidth = len;
-  }
-  return labelwidth * (rowheight / 2);
-}
-
-/* tracelog_widget() draws the text in the log window and scrolls to the last line
-   if new text was added */
-void tracelog_widget(struct nk_context *ctx, const char *id, float rowheight, int limitlines,
-                     int markline, const TRACEFILTER *filters, nk_flags widget_flags)
-{
-  TRACESTRING *item;
-  int labelwidth, tstampwidth;
-  struct nk_rect rcwidget = nk_layout_widget_bounds(ctx);
-  struct nk_style_window *stwin = &ctx->style.window;
-  struct nk_style_button stbtn = ctx->style.button;
-  struct nk_user_font const *font = ctx->style.font;
-
-  /* preset common parts of the new button style */
-  stbtn.border = 0;
-  stbtn.rounding = 0;
-  stbtn.padding.x = stbtn.padding.y = 0;
-
-  /* check the length of the longest channel name, and the longest timestamp */
-  labelwidth = (int)tracelog_labelwidth(rowheight) + 10;
-  tstampwidth = 0;
-  for (item = tracestring_root.next; item != NULL; item = item->next)
-    if (tstampwidth < item->timefmt_len)
-      tstampwidth = item->timefmt_len;
-  tstampwidth = (int)((tstampwidth * rowheight) / 2) + 10;
-
-  /* (near) black background on group */
-  nk_style_push_color(ctx, &stwin->fixed_background.data.color, COLOUR_BG0);
-  if (nk_group_begin(ctx, id, widget_flags)) {
-    static int recent_markline = -1;
-    static int scrollpos = 0;
-    static int linecount = 0;
-    static int skiplines = 0;
-    if (limitlines < 0)
-      skiplines = 0;
-    int skip = skiplines;
-    int lines = 0;
-    float lineheight = 0;
-    for (item = tracestring_root.next; item != NULL; item = item->next) {
-      assert(item->text != NULL);
-      if (skip > 0) {
-        skip -= 1;
-        continue;
-      }
-      if (filters != NULL && filters[0].expr != NULL && filters[0].enabled) {
-        /* check filters (first count how many there are) */
-        int idx, match, count_enabled;
-        match = 1;  /* preset to "match all except inverted filters" */
-        for (idx = count_enabled = 0; filters[idx].expr != NULL; idx++) {
-          if (filters[idx].enabled) {
-            count_enabled += 1;
-            if (filters[idx].expr[0] != '~')
-              match = 0;  /* valid non-inverted filter, switch to "match only filters" */
-          }
-        }
-        /* check normal filters */
-        if (!match) {
-          for (idx = 0; filters[idx].expr != NULL && !match; idx++) {
-            if (filters[idx].enabled && filters[idx].expr[0] != '~')
-              match = (strstr(item->text, filters[idx].expr) != NULL);
-          }
-        }
-        /* check inverted filters */
-        if (match) {
-          for (idx = 0; filters[idx].expr != NULL && match; idx++) {
-            if (filters[idx].enabled && filters[idx].expr[0] == '~')
-              match = (strstr(item->text, filters[idx].expr + 1) == NULL);
-          }
-        }
-        if (!match)
-          continue; /* text matches none of the normal filters, or matches one of the inverted filters -> skip it */
-      }
-      nk_layout_row_begin(ctx, NK_STATIC, rowheight, 4);
-      if (lineheight <= 0.1) {
-        struct nk_rect rcline = nk_layout_widget_bounds(ctx);
-        lineheight = rcline.h;
-      }
-      /* marker symbol */
-      nk_layout_row_push(ctx, rowheight); /* width is same as height*/
-      if (lines == markline) {
-        stbtn.normal.data.color = stbtn.hover.data.color
-          = stbtn.active.data.color = stbtn.text_background
-          = COLOUR_BG0;
-        stbtn.text_normal = stbtn.text_active = stbtn.text_hover = COLOUR_FG_YELLOW;
-        nk_button_symbol_styled(ctx, &stbtn, NK_SYMBOL_TRIANGLE_RIGHT);
-      } else {
-        nk_spacing(ctx, 1);
-      }
-      /* channel label */
-      assert(item->channel < NUM_CHANNELS);
-      stbtn.normal.data.color = stbtn.hover.data.color
-        = stbtn.active.data.color = stbtn.text_background
-        = channels[item->channel].color;
-      struct nk_color clrtxt;
-      if (channels[item->channel].color.r + 2 * channels[item->channel].color.g + channels[item->channel].color.b < 700)
-        clrtxt = COLOUR_HIGHLIGHT;
-      else
-        clrtxt = COLOUR_BG0;
-      stbtn.text_normal = stbtn.text_active = stbtn.text_hover = clrtxt;
-      nk_layout_row_push(ctx, labelwidth);
-      nk_button_label_styled(ctx, &stbtn, channels[item->channel].name);
-      /* timestamp (relative time since previous trace) */
-      nk_layout_row_push(ctx, tstampwidth);
-      nk_label_colored(ctx, item->timefmt, NK_TEXT_RIGHT, COLOUR_FG_YELLOW);
-      /* calculate size of the text */
-      assert(font != NULL && font->width != NULL);
-      int textwidth = (int)font->width(font->userdata, font->height, item->text, item->length) + 10;
-      nk_layout_row_push(ctx, textwidth);
-      if (lines == markline)
-        nk_text_colored(ctx, item->text, item->length, NK_TEXT_LEFT, COLOUR_FG_YELLOW);
-      else
-        nk_text(ctx, item->text, item->length, NK_TEXT_LEFT);
-      nk_layout_row_end(ctx);
-      lines++;
-    }
-    if (limitlines > 0)
-      skiplines = (lines > limitlines) ? lines - limitlines : 0;
-    if (lines == 0 && statusmessage_root.next != NULL) {
-      for (item = statusmessage_root.next; item != NULL; item = item->next) {
-        struct nk_color clr;
-        if (item->flags < 0)
-          clr = COLOUR_FG_RED;
-        else if (item->channel == TRACESTATMSG_CTF)
-          clr = COLOUR_FG_AQUA;
-        else
-          clr = COLOUR_FG_YELLOW;
-        nk_layout_row_dynamic(ctx, rowheight, 1);
-        nk_label_colored(ctx, item->text, NK_TEXT_LEFT, clr);
-        lines++;
-      }
-    } else {
-      nk_layout_row_dynamic(ctx, rowheight, 1);
-      nk_spacing(ctx, 1);
-    }
-    nk_group_end(ctx);
-    /* calculate scrolling
-       1) if number of lines change, scroll to the last line
-       2) if line to mark is different than last time (and valid) make that
-          line visible */
-    if (lineheight < 0.1)
-      lineheight = 1; /* only to avoid a division by zero (for the special case of 0 text lines */
-    int ypos = scrollpos;
-    int widgetlines = (int)((rcwidget.h - 2 * stwin->padding.y) / lineheight);
-    if (lines != linecount) {
-      linecount = lines;
-      ypos = (int)((lines - widgetlines + 1) * lineheight);
-    } else if (markline != recent_markline) {
-      recent_markline = markline;
-      if (markline >= 0) {
-        ypos = markline - widgetlines / 2;
-        if (ypos > lines - widgetlines + 1)
-          ypos = lines - widgetlines + 1;
-        ypos = (int)(ypos * lineheight);
-      }
-    }
-    if (ypos < 0)
-      ypos = 0;
-    if (ypos != scrollpos) {
-      nk_group_set_scroll(ctx, id, 0, ypos);
-      scrollpos = ypos;
-    }
-  }
-  nk_style_pop_color(ctx);
-}
-
-
-typedef struct tagTLMARK {
-  float pos;
-  int count;
-} TLMARK;
-typedef struct tagTIMELINE {
-  TLMARK *marks;
-  size_t length, size;  /* number of entries & max. number of entries */
-} TIMELINE;
-
-#define EPSILON     0.001
-#define FLTEQ(a,b)  ((a)-EPSILON<(b) && (a)+EPSILON>(b))  /* test whether floating-point values are equal within a small margin */
-#define MARK_SECOND   1000000
-static float mark_spacing = 100.0;              /* spacing between two mark_deltatime positions */
-static unsigned long mark_scale = MARK_SECOND;  /* 1 -> us, 1000 -> ms, 1000000 -> s, 60000000 -> min, etc. */
-static unsigned long mark_deltatime = 1;        /* in seconds / mark_scale */
-static TRACESTRING *tracestring_tail_prev = NULL;
-static TIMELINE timeline[NUM_CHANNELS];
-static float timeline_maxpos = 0.0;             /* width of the timeline canvas */
-static double timeoffset = 0.0;
-static int timeline_maxcount = 1;               /* count of traces that collapse on the same marker line on the timeline */
-
-void timeline_getconfig(double *spacing, unsigned long *scale, unsigned long *delta)
-{
-  assert(spacing != NULL);
-  *spacing = mark_spacing;
-  assert(scale != NULL);
-  *scale = mark_scale;
-  assert(delta != NULL);
-  *delta = mark_deltatime;
-}
-
-void timeline_setconfig(double spacing, unsigned long scale, unsigned long delta)
-{
-  if (spacing > 10.0 && scale > 0 && delta > 0 && delta <= 100) {
-    mark_spacing = spacing;
-    mark_scale = scale;
-    mark_deltatime = delta;
-  }
-}
-
-void timeline_rebuild(int limitlines)
-{
-  static int skiplines = 0;
-  if (limitlines < 0)
-    skiplines = 0;
-
-  timeline_maxpos = 0.0;  /* this variable is recalculated */
-  timeoffset = 0.0;
-  timeline_maxcount = 1;
-
-  /* marks only get added, until the list is cleared completely */
-  if (tracestring_root.next == NULL) {
-    for (int chan = 0; chan < NUM_CHANNELS; chan++) {
-      if (timeline[chan].marks != NULL) {
-        free((void*)timeline[chan].marks);
-        timeline[chan].marks = NULL;
-        timeline[chan].length = timeline[chan].size = 0;
-      }
-    }
-    skiplines = 0;
-  } else {
-    assert(tracestring_root.next != NULL);
-    timeoffset = tracestring_root.next->timestamp;
-    int chan;
-    for (chan = 0; chan < NUM_CHANNELS; chan++)
-      timeline[chan].length = 0;
-    int skip = skiplines;
-    for (TRACESTRING *item = tracestring_root.next; item != NULL; item = item->next) {
-      int idx;
-      float pos;
-      chan = item->channel;
-      assert(chan >= 0 && chan < NUM_CHANNELS);
-      if (!channels[chan].enabled)
-        continue;
-      if (skip > 0) {
-        skip--;
-        continue;
-      }
-      /* make sure array is big enough for another mark */
-      assert(timeline[chan].length <= timeline[chan].size);
-      if (timeline[chan].length == timeline[chan].size) {
-        size_t newsize;
-        if (timeline[chan].marks == NULL) {
-          assert(timeline[chan].size == 0);
-          newsize = 32;
-          timeline[chan].marks = malloc(newsize * sizeof(TLMARK));
-          if (timeline[chan].marks != NULL)
-            timeline[chan].size = newsize;
-        } else {
-          TLMARK *curptr = timeline[chan].marks; /* save, for special case of realloc fail */
-          newsize = timeline[chan].size * 2;
-          timeline[chan].marks = realloc(timeline[chan].marks, newsize * sizeof(TLMARK));
-          if (timeline[chan].marks != NULL)
-            timeline[chan].size = newsize;
-          else
-            timeline[chan].marks = curptr;  /* restore old pointer on realloc fail */
-        }
-      }
-      if (timeline[chan].length == timeline[chan].size)
-        continue; /* no space for another mark (growing the array failed) */
-      /* convert timestamp to position */
-      pos = (item->timestamp - timeoffset) * mark_spacing * MARK_SECOND / (mark_scale * mark_deltatime);
-      idx = timeline[chan].length;
-      /* check collapsing marks */
-      assert(idx == 0 || pos >= timeline[chan].marks[idx - 1].pos);
-      if (idx > 0 && (pos - timeline[chan].marks[idx - 1].pos) < 0.5) {
-        idx -= 1;
-        timeline[chan].marks[idx].count += 1;
-        if (timeline[chan].marks[idx].count > timeline_maxcount)
-          timeline_maxcount = timeline[chan].marks[idx].count;
-      } else {
-        timeline[chan].marks[idx].pos = pos;
-        timeline[chan].marks[idx].count = 1;
-        timeline[chan].length = idx + 1;
-      }
-      if (pos > timeline_maxpos)
-        timeline_maxpos = pos;
-    }
-    if (limitlines > 0) {
-      /* count all marks, increase the number of traces to skip, if needed */
-      size_t total = 0;
-      for (int chan = 0; chan < NUM_CHANNELS; chan++)
-        total += timeline[chan].length;
-      skiplines = (total > limitlines) ? total - limitlines : 0;
-    }
-  }
-}
-
-double timeline_widget(struct nk_context *ctx, const char *id, float rowheight,
-                       int limitlines, nk_flags widget_flags)
-{
-  int labelwidth;
-  double click_time = -1.0;
-  struct nk_rect rcwidget;
-  struct nk_style_button stbtn;
-
-  assert(ctx != NULL);
-  assert(ctx->current != NULL);
-  assert(ctx->current->layout != NULL);
-  if (ctx == NULL || ctx->current == NULL || ctx->current->layout == NULL)
-    return click_time;
-
-  if (tracestring_tail != tracestring_tail_prev) {
-    timeline_rebuild(limitlines); /* rebuild the "trace marks" data */
-    tracestring_tail_prev = tracestring_tail;
-  }
-
-  /* preset common parts of the new button style */
-  stbtn = ctx->style.button;
-  stbtn.padding.x = stbtn.padding.y = 0;
-
-  /* check the length of the longest channel name */
-  labelwidth = (int)tracelog_labelwidth(rowheight) + 10;
-  rcwidget = nk_layout_widget_bounds(ctx);
-
-  /* no spacing & black background on group */
-  nk_style_push_vec2(ctx, &ctx->style.window.spacing, nk_vec2(0, 0));
-  nk_style_push_color(ctx, &ctx->style.window.fixed_background.data.color, COLOUR_BG0);
-  if (nk_group_begin(ctx, id, widget_flags | NK_WINDOW_NO_SCROLLBAR)) {
-    static float timeline_maxpos_prev = 0.0f;
-    struct nk_window *win = ctx->current;
-    struct nk_user_font const *font = ctx->style.font;
-    char valstr[60];
-    float x1, x2;
-    const char *unit;
-    nk_uint xscroll, yscroll;
-
-    int submark_count = 10;
-    if (mark_spacing / submark_count < 20)
-      submark_count = 5;
-    if (mark_spacing / submark_count < 20)
-      submark_count = 2;
-
-#   define HORPADDING  4
-#   define VERPADDING  1
-
-    /* get the scroll position of the graph, because scrolling is manual */
-    sprintf(valstr, "%s_graph", id);
-    nk_group_get_scroll(ctx, valstr, &xscroll, &yscroll);
-
-    /* first row: timer ticks, may not scroll vertically */
-    switch (mark_scale) {
-      case 1: unit = "\xC2\xB5s"; break; /* us */
-      case 1000: unit = "ms";     break;
-      case 1000000: unit = "s";  break;
-      case 60000000: unit = "min"; break;
-      default: assert(0);
-    }
-    nk_layout_row_begin(ctx, NK_STATIC, rowheight + VERPADDING, 3);
-    nk_layout_row_push(ctx, rcwidget.w - 2 * (1.5f * rowheight));
-    struct nk_rect rc = nk_layout_widget_bounds(ctx);
-    nk_fill_rect(&win->buffer, rc, 0.0f, COLOUR_BG0_S);
-    x2 = rc.x + rc.w;
-    int submark_iter = 0;
-    long mark_stamp = 0;
-    long mark_inv_scale = MARK_SECOND / mark_scale;
-    for (x1 = rc.x + labelwidth + HORPADDING - xscroll; x1 < x2; x1 += mark_spacing / submark_count) {
-      if (submark_iter == 0) {
-        struct nk_color clr;
-        if (mark_stamp % mark_inv_scale == 0) {
-          sprintf(valstr, "%ld s", mark_stamp / mark_inv_scale);
-          clr = COLOUR_FG_YELLOW;
-        } else {
-          sprintf(valstr, "+%ld %s", mark_stamp, unit);
-          clr = COLOUR_TEXT;
-        }
-        nk_stroke_line(&win->buffer, x1, rc.y, x1, rc.y + rowheight - 2, 1, clr);
-        rc.x = x1 + 2;
-        rc.w = x2 - rc.x;
-        nk_draw_text(&win->buffer, rc, valstr, strlen(valstr), font, COLOUR_BG0, clr);
-        mark_stamp += mark_deltatime;
-      } else {
-        nk_stroke_line(&win->buffer, x1, rc.y, x1, rc.y + rowheight / 2 - 2, 1, COLOUR_TEXT);
-      }
-      if (++submark_iter == submark_count)
-        submark_iter = 0;
-    }
-    rc = nk_layout_widget_bounds(ctx);
-    nk_stroke_line(&win->buffer, rc.x, rc.y + rc.h, rc.x + rc.w - HORPADDING, rc.y + rc.h, 1, COLOUR_FG_GRAY);
-    rc.w = labelwidth;
-    rc.h -= 1;
-    nk_fill_rect(&win->buffer, rc, 0.0f, COLOUR_BG0);
-    nk_spacing(ctx, 1);
-    nk_layout_row_push(ctx, 1.5f * rowheight);
-    if (nk_button_symbol_styled(ctx, &stbtn, NK_SYMBOL_PLUS)) {
-      mark_spacing *= 1.5;
-      if (mark_spacing > 700.0 && (mark_deltatime > 1 || mark_scale > 1)) {
-        mark_deltatime /= 10;
-        mark_spacing /= 10.0;
-        if (mark_deltatime == 0 && mark_scale >= 1000) {
-          mark_scale /= 1000;
-          mark_deltatime = 100;
-        }
-      }
-      timeline_rebuild(limitlines);
-    }
-    nk_layout_row_push(ctx, 1.5f * rowheight);
-    if (nk_button_symbol_styled(ctx, &stbtn, NK_SYMBOL_MINUS)) {
-      if (mark_spacing > 45.0 || mark_scale < 60000000 || mark_deltatime == 1)
-        mark_spacing /= 1.5;
-      if (mark_spacing < 70.0) {
-        mark_deltatime *= 10;
-        mark_spacing *= 10.0;
-        if (mark_scale < MARK_SECOND && mark_deltatime >= 1000) {
-          mark_scale *= 1000;
-          mark_deltatime /= 1000;
-        }
-      }
-      timeline_rebuild(limitlines);
-    }
-    nk_layout_row_end(ctx);
-
-    /* extra (small) spacing between timeline and top of the graphs */
-    nk_layout_row_dynamic(ctx, VERPADDING, 1);
-    nk_spacing(ctx, 1);
-
-    /* remaining rows collected in two groups: labels and graph */
-    nk_layout_row_begin(ctx, NK_STATIC, rcwidget.h - rowheight - 2 * VERPADDING, 2);
-    nk_layout_row_push(ctx, labelwidth + HORPADDING);
-    sprintf(valstr, "%s_label", id);
-    if (nk_group_begin(ctx, valstr, NK_WINDOW_NO_SCROLLBAR)) {
-      /* labels */
-      for (int chan = 0; chan < NUM_CHANNELS; chan++) {
-        struct nk_color clrtxt;
-        float textwidth;
-        int len;
-        if (!channels[chan].enabled)
-          continue; /* only draw enabled channels */
-        nk_layout_row_dynamic(ctx, rowheight + VERPADDING, 1);
-        rc = nk_layout_widget_bounds(ctx);
-        rc.x += HORPADDING;
-        rc.y -= yscroll;
-        rc.w -= HORPADDING;
-        rc.h -= 1;
-        nk_fill_rect(&win->buffer, rc, 0.0f, channels[chan].color);
-        if (channels[chan].color.r + 2 * channels[chan].color.g + channels[chan].color.b < 700)
-          clrtxt = COLOUR_HIGHLIGHT;
-        else
-          clrtxt = COLOUR_BG0;
-        /* center the text in the rect */
-        len = strlen(channels[chan].name);
-        textwidth = font->width(font->userdata, font->height, channels[chan].name, len);
-        rc.x += (rc.w - textwidth) / 2;
-        nk_draw_text(&win->buffer, rc, channels[chan].name, len, font, channels[chan].color, clrtxt);
-      }
-      nk_group_end(ctx);
-    }
-    nk_layout_row_push(ctx, rcwidget.w - labelwidth - HORPADDING);
-    sprintf(valstr, "%s_graph", id);
-    if (nk_group_begin(ctx, valstr, 0)) {
-      /* graphs */
-      int row = 0;
-      for (int chan = 0; chan < NUM_CHANNELS; chan++) {
-        int idx;
-        if (!channels[chan].enabled)
-          continue; /* only draw enabled channels */
-        nk_layout_row_begin(ctx, NK_STATIC, rowheight + VERPADDING, 2);
-        nk_layout_row_push(ctx, timeline_maxpos);
-        rc = nk_layout_widget_bounds(ctx);
-        rc.y -= yscroll;
-        if (row & 1)
-          nk_fill_rect(&win->buffer, rc, 0.0f, COLOUR_BG0_S);
-        row++;
-        /* draw marks for each active channel */
-        for (idx = 0; idx < (int)timeline[chan].length; idx++) {
-          float x = timeline[chan].marks[idx].pos + labelwidth + 2 * HORPADDING - xscroll;
-          float y = 0.75f * rowheight * (1 - (float)timeline[chan].marks[idx].count / (float)timeline_maxcount);
-          nk_stroke_line(&win->buffer, x, rc.y + y, x, rc.y + rowheight, 1, COLOUR_TEXT);
-        }
-        nk_spacing(ctx, 1);
-        nk_layout_row_end(ctx);
-        /* handle mouse click in timeline, to scroll the trace view */
-        if (nk_input_mouse_clicked(&ctx->input, NK_BUTTON_LEFT, rc)) {
-          float pos;
-          struct nk_mouse *mouse = &ctx->input.mouse;
-          assert(mouse != NULL);
-          assert(NK_INBOX(mouse->pos.x, mouse->pos.y, rc.x, rc.y, rc.w, rc.h));
-          pos = mouse->pos.x - labelwidth - 2 * HORPADDING + xscroll;
-          if (pos >= 0.0)
-            click_time = pos * (mark_scale * mark_deltatime) / (mark_spacing * MARK_SECOND) + timeoffset;
-        }
-      }
-      nk_group_end(ctx);
-    }
-    nk_layout_row_end(ctx);
-    nk_group_end(ctx);
-    /* scroll to end if more trace message markers have arrived */
-    if (timeline_maxpos != timeline_maxpos_prev) {
-      float x = timeline_maxpos - (rcwidget.w - labelwidth - HORPADDING);
-      xscroll = (x > 0.0f) ? (nk_uint)x : 0;
-      nk_group_set_scroll(ctx, valstr, xscroll, yscroll);
-      timeline_maxpos_prev = timeline_maxpos;
-    }
-  }
-
-  /* restore locally modified styles */
-  nk_style_pop_color(ctx);
-  nk_style_pop_vec2(ctx);
-
-  return click_time;
-}
-
+/*
+ * Shared code for SWO Trace for the bmtrace and bmdebug utilities. It uses
+ * WinUSB or libusbK on Microsoft Windows, and libusb 1.0 on Linux.
+ *
+ * Copyright 2019-2022 CompuPhase
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <assert.h>
+#include <ctype.h>
+#include <float.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined WIN32 || defined _WIN32
+# define STRICT
+# define WIN32_LEAN_AND_MEAN
+# include <windows.h>
+# include <winsock2.h>
+# include <tchar.h>
+# include <initguid.h>
+# include <setupapi.h>
+# include <malloc.h>
+# include "usb-support.h"
+# if defined __MINGW32__ || defined __MINGW64__ || defined _MSC_VER
+#   include "strlcpy.h"
+# endif
+# if defined _MSC_VER
+#   define memicmp(p1,p2,c)  _memicmp((p1),(p2),(c))
+# endif
+#elif defined __linux__
+# include <alloca.h>
+# include <errno.h>
+# include <pthread.h>
+# include <unistd.h>
+# include <bsd/string.h>
+# include <sys/stat.h>
+# include <sys/select.h>
+# include <sys/socket.h>
+# include <arpa/inet.h>
+# include <libusb-1.0/libusb.h>
+  typedef int SOCKET;
+# define INVALID_SOCKET (-1)
+#endif
+
+#include "bmp-scan.h"
+#include "guidriver.h"
+#include "nuklear_listview.h"
+#include "nuklear_style.h"
+#include "parsetsdl.h"
+#include "decodectf.h"
+#include "export.h"
+#include "perfstats.h"
+#include "swotrace.h"
+
+#if defined FORTIFY
+# include <alloc/fortify.h>
+#endif
+
+
+#if defined __linux__ || defined __FreeBSD__ || defined __APPLE__
+# define stricmp(s1,s2)    strcasecmp((s1),(s2))
+  static int memicmp(const unsigned char *p1, const unsigned char *p2, size_t count);
+#elif defined _MSC_VER
+# define stricmp(a,b)      _stricmp((a),(b))
+#endif
+
+#if !defined sizearray
+# define sizearray(e)    (sizeof(e) / sizeof((e)[0]))
+#endif
+
+#if defined __SSE2__ || defined _M_X64 || (defined _M_IX86_FP && _M_IX86_FP >= 2)
+# include <emmintrin.h>
+# define SWO_SSE2
+#elif defined __ARM_NEON || defined __ARM_NEON__
+# include <arm_neon.h>
+# define SWO_NEON
+#endif
+
+
+#define CHANNEL_NAMELENGTH  30
+typedef struct tagCHANNELINFO {
+  bool enabled;
+  struct nk_color color;
+  char name[CHANNEL_NAMELENGTH];
+  unsigned maxlines;      /* retention limit (0 = no limit) */
+} CHANNELINFO;
+static CHANNELINFO channels[NUM_CHANNELS];
+
+static void decoder_stop(void);
+static void chanqueue_clear(void);
+static void channel_enable(int index, bool enabled);
+
+void channel_set(int index, bool enabled, const char *name, struct nk_color color)
+{
+  assert(index >= 0 && index < NUM_CHANNELS);
+  channel_enable(index, enabled);
+  channels[index].color = color;
+  if (name == NULL)
+    sprintf(channels[index].name, "%d", index);
+  else
+    strlcpy(channels[index].name, name, sizearray(channels[index].name));
+}
+
+bool channel_getenabled(int index)
+{
+  assert(index >= 0 && index < NUM_CHANNELS);
+  return channels[index].enabled;
+}
+
+void channel_setenabled(int index, bool enabled)
+{
+  assert(index >= 0 && index < NUM_CHANNELS);
+  channel_enable(index, enabled);
+}
+
+/** channel_getname() returns the name of the channel and optionally copies
+ *  it into the parameter.
+ *  \param index    The channel index, 0 to 32
+ *  \param name     The channel name is copied into this parameter, unless
+ *                  this parameter is NULL.
+ *  \param size     The buffer size reserved for parameter name.
+ *  \return A pointer to the name in the channel structure. If parameter "name"
+ *          is NULL, one can use this pointer. If parameter "name" is not NULL,
+ *          note that the returned pointer to the name in the channel structure
+ *          (so, not to the "name" parameter).
+ */
+const char *channel_getname(int index, char *name, size_t size)
+{
+  assert(index >= 0 && index < NUM_CHANNELS);
+  if (name != NULL && size > 0)
+    strlcpy(name, channels[index].name, size);
+  return channels[index].name;
+}
+
+void channel_setname(int index, const char *name)
+{
+  assert(index >= 0 && index < NUM_CHANNELS);
+  if (name == NULL)
+    sprintf(channels[index].name, "%d", index);
+  else
+    strlcpy(channels[index].name, name, sizearray(channels[index].name));
+}
+
+struct nk_color channel_getcolor(int index)
+{
+  assert(index >= 0 && index < NUM_CHANNELS);
+  return channels[index].color;
+}
+
+void channel_setcolor(int index, struct nk_color color)
+{
+  assert(index >= 0 && index < NUM_CHANNELS);
+  channels[index].color = color;
+}
+
+/** channel_setlimit() sets the maximum number of strings that are kept for
+ *  the channel; when more strings arrive, the oldest strings of the channel
+ *  are dropped. A limit of zero means that the channel has no limit of its
+ *  own (but the global retention limits still apply).
+ */
+void channel_setlimit(int index, unsigned maxlines)
+{
+  assert(index >= 0 && index < NUM_CHANNELS);
+  decoder_stop();   /* the decoder restarts on the next tracestring_process() */
+  channels[index].maxlines = maxlines;
+}
+
+unsigned channel_getlimit(int index)
+{
+  assert(index >= 0 && index < NUM_CHANNELS);
+  return channels[index].maxlines;
+}
+
+
+/* The packet queue is a single-producer/single-consumer ring: the capture
+   thread only writes tracequeue_tail, the GUI thread only writes
+   tracequeue_head. Both are free-running counters; the slot is the counter
+   masked with the queue size (which is a power of 2). */
+#if defined __GNUC__
+# define QUEUE_LOAD(v)        __atomic_load_n(&(v), __ATOMIC_ACQUIRE)
+# define QUEUE_STORE(v,x)     __atomic_store_n(&(v), (x), __ATOMIC_RELEASE)
+# define QUEUE_INCREMENT(v)   __atomic_fetch_add(&(v), 1, __ATOMIC_RELAXED)
+# define QUEUE_EXCHANGE(v,x)  __atomic_exchange_n(&(v), (x), __ATOMIC_ACQ_REL)
+# define QUEUE_FENCE()        __atomic_thread_fence(__ATOMIC_SEQ_CST)
+#elif defined _MSC_VER
+# define QUEUE_LOAD(v)        InterlockedCompareExchange((volatile LONG*)&(v), 0, 0)
+# define QUEUE_STORE(v,x)     InterlockedExchange((volatile LONG*)&(v), (LONG)(x))
+# define QUEUE_INCREMENT(v)   InterlockedIncrement((volatile LONG*)&(v))
+# define QUEUE_EXCHANGE(v,x)  InterlockedExchange((volatile LONG*)&(v), (LONG)(x))
+# define QUEUE_FENCE()        MemoryBarrier()
+#endif
+
+#define PACKET_SIZE 64
+#define QUEUE_DEFAULTSIZE   (4*1024*1024) /* default size of the queue in bytes */
+#define TRACE_TRANSFERS     8   /* number of USB reads kept in flight */
+#define SOCKET_CHUNK        (32*1024) /* size of a single read from a TCP/IP socket */
+typedef struct tagPACKET {
+  unsigned char data[PACKET_SIZE];
+  size_t length;
+  double timestamp;
+} PACKET;
+static PACKET *trace_queue = NULL;
+static unsigned tracequeue_mask = 0;  /* number of packets in the queue - 1 */
+static unsigned tracequeue_head = 0, tracequeue_tail = 0;
+static int tracequeue_overflow = 0;
+static bool trace_running = false;
+
+/* pipeline statistics: the capture counters are only written by the producer
+   (in tracequeue_commit), the decode counters only by the decoder; all are
+   free-running, the rates are calculated from the deltas */
+static unsigned stat_bytes = 0, stat_packets = 0, stat_highwater = 0;
+static unsigned stat_decoded = 0, stat_decode_usec = 0, stat_ctf_events = 0;
+static unsigned stat_pktstamp = 0;    /* reception time of the most recent decoded packet (decoder side) */
+static unsigned stat_latency = 0, stat_latency_max = 0;  /* in us (GUI side) */
+#define STAT_USEC(t)    ((unsigned)(unsigned long long)((t) * 1000000.0))  /* time stamp in us, modulo 2^32 */
+static volatile bool trace_replaying = false;
+
+static unsigned capture_chanmask = 0;   /* copy of the "enabled" flags, for the capture thread */
+static int capture_filtering = 0;   /* whether the capture thread drops packets of disabled channels */
+static unsigned capture_skip = 0, capture_keep = 0; /* bytes of a packet that continues in the next slot (producer side) */
+
+static void record_packet(const PACKET *packet);
+static void capture_filter(PACKET *packet);
+static void trace_replay_stop(void);
+
+/* channel_enable() sets the "enabled" flag of a channel, and updates the copy
+   that the capture thread uses (GUI side) */
+static void channel_enable(int index, bool enabled)
+{
+  channels[index].enabled = enabled;
+  unsigned mask = capture_chanmask;
+  if (enabled)
+    mask |= 1u << index;
+  else
+    mask &= ~(1u << index);
+  QUEUE_STORE(capture_chanmask, mask);
+}
+
+/** trace_setqueuesize() sets the size of the packet queue (in bytes). The
+ *  size is rounded down to a power of 2 number of packets. The size cannot be
+ *  changed while tracing is active; any packets still in the queue are
+ *  discarded.
+ */
+bool trace_setqueuesize(size_t bytes)
+{
+  if (trace_running || trace_replaying)
+    return false;
+  unsigned count = 2;
+  while ((size_t)count * 2 * sizeof(PACKET) <= bytes)
+    count *= 2;
+  if (trace_queue != NULL && count == tracequeue_mask + 1) {
+    tracequeue_head = tracequeue_tail = 0;
+    return true;
+  }
+  PACKET *queue = (PACKET*)malloc(count * sizeof(PACKET));
+  if (queue == NULL)
+    return false;
+  if (trace_queue != NULL)
+    free(trace_queue);
+  trace_queue = queue;
+  tracequeue_mask = count - 1;
+  tracequeue_head = tracequeue_tail = 0;
+  return true;
+}
+
+/* tracequeue_reserveahead() returns a free slot in the queue, or NULL if the
+   queue is full (producer side); the slot is "ahead" positions past the tail,
+   so that multiple reads can be in flight at the same time (these must then
+   complete in order) */
+static PACKET *tracequeue_reserveahead(unsigned ahead)
+{
+  assert(trace_queue != NULL);
+  unsigned head = QUEUE_LOAD(tracequeue_head);
+  if (tracequeue_tail + ahead - head > tracequeue_mask)
+    return NULL;
+  return &trace_queue[(tracequeue_tail + ahead) & tracequeue_mask];
+}
+
+static PACKET *tracequeue_reserve(void)
+{
+  return tracequeue_reserveahead(0);
+}
+
+/* tracequeue_commit() makes the oldest reserved slot visible to the consumer;
+   packets that were reserved but that stay empty must be committed too (with
+   a zero length) if there are reads in flight for later slots; the GUI is
+   woken up only when data arrives in a queue that held no data yet
+   (the consumer drains the queue completely, so it does not need more wake-up
+   calls); the wake-up is "owed" when an empty packet goes into an empty queue
+   and it must then be delivered with the next packet that holds data */
+static void tracequeue_commit(void)
+{
+  static bool wake_owed = false;
+  unsigned tail = tracequeue_tail;
+  PACKET *packet = &trace_queue[tail & tracequeue_mask];
+  record_packet(packet);
+  if (QUEUE_LOAD(capture_filtering))
+    capture_filter(packet);
+  else
+    capture_skip = capture_keep = 0;
+  QUEUE_STORE(stat_bytes, stat_bytes + (unsigned)packet->length);
+  QUEUE_STORE(stat_packets, stat_packets + 1);
+  unsigned used = tracequeue_tail + 1 - QUEUE_LOAD(tracequeue_head);
+  if (used > QUEUE_LOAD(stat_highwater))
+    QUEUE_STORE(stat_highwater, used);
+  QUEUE_STORE(tracequeue_tail, tail + 1);
+  /* the head must be read after the tail is stored, to pair with the fence in
+     tracequeue_release(); otherwise a wake-up may be lost */
+  QUEUE_FENCE();
+  bool was_empty = (QUEUE_LOAD(tracequeue_head) == tail);
+  if (packet->length > 0) {
+    if (was_empty || wake_owed)
+      guidriver_wake();
+    wake_owed = false;
+  } else if (was_empty) {
+    wake_owed = true;
+  }
+}
+
+/* tracequeue_peek() returns the number of packets that are available in a
+   contiguous block, and a pointer to the first packet (consumer side) */
+static unsigned tracequeue_peek(const PACKET **packets)
+{
+  assert(packets != NULL);
+  *packets = NULL;
+  if (trace_queue == NULL)
+    return 0;
+  unsigned tail = QUEUE_LOAD(tracequeue_tail);
+  unsigned count = tail - tracequeue_head;
+  unsigned slot = tracequeue_head & tracequeue_mask;
+  if (count > tracequeue_mask + 1 - slot)
+    count = tracequeue_mask + 1 - slot; /* up to the end of the ring */
+  *packets = &trace_queue[slot];
+  return count;
+}
+
+/* tracequeue_release() drops packets from the head of the queue */
+static void tracequeue_release(unsigned count)
+{
+  QUEUE_STORE(tracequeue_head, tracequeue_head + count);
+  QUEUE_FENCE();  /* tail must be (re-)read after the head is stored */
+}
+
+/* trace_slot() returns a free slot in the packet queue; if the queue is full,
+   it returns the scratch packet (the data must still be read from the probe,
+   but it is then dropped) */
+static PACKET *trace_slot(PACKET *scratch)
+{
+  PACKET *packet = tracequeue_reserve();
+  return (packet != NULL) ? packet : scratch;
+}
+
+/* tracequeue_store() copies a block of received data into consecutive slots
+   of the queue, all with the same time stamp (producer side); the decoder
+   carries partial ITM packets over from one slot to the next, so the split
+   points do not matter; data that does not fit in the queue is dropped */
+static void tracequeue_store(const unsigned char *data, size_t size)
+{
+  double timestamp = get_timestamp();
+  while (size > 0) {
+    PACKET *packet = tracequeue_reserve();
+    if (packet == NULL) {
+      QUEUE_INCREMENT(tracequeue_overflow); /* notify packet queue overflow */
+      PERF_COUNT("swo.overflow", 1);
+      break;
+    }
+    size_t length = (size < PACKET_SIZE) ? size : PACKET_SIZE;
+    memcpy(packet->data, data, length);
+    packet->length = length;
+    packet->timestamp = timestamp;
+    tracequeue_commit();
+    data += length;
+    size -= length;
+  }
+}
+
+typedef struct tagTRACESTRING {
+  struct tagTRACESTRING *next;
+  char *text;
+  double timestamp;       /* in seconds */
+  char timefmt[15];       /* formatted string with time stamp */
+  unsigned short timefmt_len;
+  unsigned short length, size;  /* text length & text buffer size (length <= size, excluding the zero terminator) */
+  unsigned char channel;
+  short flags;            /* used to keep state while decoding plain trace messages */
+  unsigned chain;         /* record number of the next string on the same channel */
+} TRACESTRING;
+
+static SOCKET TraceSocket = INVALID_SOCKET;
+
+/* trace_read_socket() reads SWO data from a TCP/IP connection (producer side);
+   unlike USB, a socket has no packet size, so it is read in large chunks to
+   reduce the number of system calls; the function returns when the
+   connection closes, or when "quit" becomes non-zero */
+static void trace_read_socket(volatile int *quit)
+{
+  static unsigned char buffer[SOCKET_CHUNK]; /* static, because on Windows, the thread is terminated */
+  while (quit == NULL || !*quit) {
+    fd_set fdset;
+    struct timeval tv;
+    FD_ZERO(&fdset);
+    FD_SET(TraceSocket, &fdset);
+    tv.tv_sec = 0;
+    tv.tv_usec = 100*1000;  /* to check the "quit" flag periodically */
+    int ready = select(TraceSocket + 1, &fdset, NULL, NULL, &tv);
+    if (ready < 0)
+      break;
+    if (ready == 0)
+      continue;
+    int result = recv(TraceSocket, (char*)buffer, sizeof buffer, 0);
+    if (result <= 0)
+      break;                /* connection closed, or error */
+    tracequeue_store(buffer, result);
+  }
+}
+
+#define TRACESTRING_MAXLENGTH 256
+#define TRACESTRING_INITSIZE  32
+static TRACESTRING *tracestring_tail = NULL;
+
+static unsigned char itm_cache[5]; /**< we may need to cache an ITM data packet that does
+                                        not fit completely in an USB packet; ITM data
+                                        packets are 5 bytes max. */
+static size_t itm_cachefilled = 0;
+static unsigned short itm_datasize = 1;    /* size in bytes (not bits) */
+static short itm_datasz_auto = 0;
+static unsigned itm_packet_errors = 0;
+
+#define ITM_VALIDHDR(b)   (((b) & 0x07) >= 1 && ((b) & 0x07) <= 3)
+#define ITM_CHANNEL(b)    (unsigned)(((b) >> 3) & 0x1f) /* get channel number from ITM packet header */
+#define ITM_LENGTH(b)     (unsigned)(((b) & 0x07) == 3 ? 4 : (b) & 0x07)
+#define ITM_HWSOURCE(b)   (((b) & 0x07) >= 5)   /* hardware source (DWT) packet */
+#define ITM_HWLENGTH(b)   (unsigned)(((b) & 0x03) == 3 ? 4 : (b) & 0x03)
+#define DWT_DATAVALUE(b)  (((b) & 0xc4) == 0x84)  /* data value packet (discriminator ID 16..23) */
+#define DWT_COMPARATOR(b) (unsigned)(((b) >> 4) & 0x03)
+#define DWT_ISWRITE(b)    (((b) & 0x08) != 0)
+
+/* capture_filter() removes the ITM packets of disabled channels from a packet
+   that was just received (producer side), so that these take no time of the
+   decoder; the packet is compacted in place. Hardware source packets are
+   kept. On a byte that is not a valid packet header, the remainder of the
+   packet is left alone (the decoder reports the error). The raw data has
+   already been recorded at this point, so that a replay can use different
+   channel settings. */
+static void capture_filter(PACKET *packet)
+{
+  unsigned mask = QUEUE_LOAD(capture_chanmask);
+  unsigned char *data = packet->data;
+  size_t length = packet->length;
+  size_t src = 0, dst = 0;
+
+  /* handle the part of a packet that started in the previous slot */
+  if (capture_skip > 0) {
+    src = (capture_skip < length) ? capture_skip : length;
+    capture_skip -= (unsigned)src;
+  } else if (capture_keep > 0) {
+    src = dst = (capture_keep < length) ? capture_keep : length;
+    capture_keep -= (unsigned)src;
+  }
+
+  while (src < length) {
+    unsigned char hdr = data[src];
+    size_t size;
+    bool keep = true;
+    if (ITM_HWSOURCE(hdr)) {
+      size = ITM_HWLENGTH(hdr) + 1;
+    } else if (ITM_VALIDHDR(hdr)) {
+      size = ITM_LENGTH(hdr) + 1;
+      keep = (mask & (1u << ITM_CHANNEL(hdr))) != 0;
+    } else {
+      size = length - src;  /* keep the rest */
+    }
+    if (src + size > length) {
+      /* packet continues in the next slot */
+      if (keep)
+        capture_keep = (unsigned)(src + size - length);
+      else
+        capture_skip = (unsigned)(src + size - length);
+      size = length - src;
+    }
+    if (keep) {
+      if (dst != src)
+        memmove(data + dst, data + src, size);
+      dst += size;
+    }
+    src += size;
+  }
+  if (dst < length)
+    PERF_COUNT("swo.filtered", length - dst);
+  packet->length = dst;
+}
+
+/* Data values from the DWT comparators (data trace), for the live watches.
+   The decoder appends the samples to a ring per comparator (the head is free
+   running); the GUI thread reads the most recent samples, from its own tail
+   onwards. */
+#define DATAWATCH_SAMPLES 1024  /* must be a power of 2 */
+
+typedef struct tagDATAWATCH {
+  WATCHSAMPLE samples[DATAWATCH_SAMPLES];
+  unsigned head;        /* decoder side */
+  unsigned tail;        /* GUI side, samples before the tail were cleared */
+} DATAWATCH;
+
+static DATAWATCH datawatch[DWT_COMPARATORS];
+
+static void datawatch_add(const unsigned char *packet, double timestamp)
+{
+  assert(DWT_DATAVALUE(packet[0]));
+  DATAWATCH *dw = &datawatch[DWT_COMPARATOR(packet[0])];
+  WATCHSAMPLE *sample = &dw->samples[dw->head & (DATAWATCH_SAMPLES - 1)];
+  sample->size = (unsigned char)ITM_HWLENGTH(packet[0]);
+  sample->value = 0;
+  memcpy(&sample->value, packet + 1, sample->size);  /* little endian */
+  sample->write = DWT_ISWRITE(packet[0]);
+  sample->timestamp = timestamp;
+  QUEUE_STORE(dw->head, dw->head + 1);
+}
+
+/** tracewatch_clear() drops the data trace samples that were received for a
+ *  DWT comparator.
+ */
+void tracewatch_clear(unsigned comparator)
+{
+  assert(comparator < DWT_COMPARATORS);
+  datawatch[comparator].tail = QUEUE_LOAD(datawatch[comparator].head);
+}
+
+/** tracewatch_samples() copies the most recent data trace samples for a DWT
+ *  comparator.
+ *
+ *  \param comparator The DWT comparator, 0..3.
+ *  \param samples    [out] The samples, the oldest first.
+ *  \param maxcount   The maximum number of samples to copy.
+ *
+ *  \return The number of samples copied.
+ */
+unsigned tracewatch_samples(unsigned comparator, WATCHSAMPLE *samples, unsigned maxcount)
+{
+  assert(comparator < DWT_COMPARATORS);
+  assert(samples != NULL || maxcount == 0);
+  DATAWATCH *dw = &datawatch[comparator];
+  unsigned head = QUEUE_LOAD(dw->head);
+  unsigned count = head - dw->tail;
+  /* keep a margin, because the decoder may overwrite the oldest samples
+     while these are copied */
+  if (count > DATAWATCH_SAMPLES / 2)
+    count = DATAWATCH_SAMPLES / 2;
+  if (count > maxcount)
+    count = maxcount;
+  for (unsigned idx = 0; idx < count; idx++)
+    samples[idx] = dw->samples[(head - count + idx) & (DATAWATCH_SAMPLES - 1)];
+  return count;
+}
+
+/* The trace strings are allocated from arenas: the fixed-size records are
+   stored in blocks of records, and the text of the strings in (large) text
+   blocks. Records are numbered sequentially (the numbers are free-running),
+   and the block array is a ring on the record number, which doubles as an
+   index on the line number.
+   The strings form a rolling window: when a retention limit is exceeded, the
+   oldest string is evicted (by moving the front of the window). A channel
+   limit unlinks the oldest string of that channel from the per-channel chain;
+   the string then stays in the window (but hidden) until it reaches the
+   front. Blocks whose strings are all evicted go back to a free list.
+   The strings are decoded on a worker thread, which owns the arenas and the
+   most recent (incomplete) string. It publishes the window of completed
+   records (guarded by a sequence count); tracestring_process() copies that
+   into tracestring_base and tracestring_lines, which is the view of the GUI
+   thread (so that the view only changes between frames). The GUI thread
+   hands the front of its view back, so that blocks that it still reads are
+   not reused. The block array has a fixed size, so that the records do not
+   move while the GUI reads them. */
+#define TRACESTRING_BLOCKRECS   4096
+#define TRACESTRING_MAXBLOCKS   16384
+#define TRACESTRING_BLOCKTEXT   (256*1024)
+
+typedef struct tagRECBLOCK {
+  TRACESTRING recs[TRACESTRING_BLOCKRECS];
+} RECBLOCK;
+
+typedef struct tagTEXTBLOCK {
+  struct tagTEXTBLOCK *next;
+  size_t size, used;      /* size of the data buffer & number of bytes in use */
+  unsigned lastrec;       /* record number of the most recent string with text in this block */
+  char data[];
+} TEXTBLOCK;
+
+static RECBLOCK *recblocks[TRACESTRING_MAXBLOCKS];    /* ring, on the record number */
+static RECBLOCK *recblock_free[TRACESTRING_MAXBLOCKS]; /* blocks for reuse */
+static unsigned recblock_freecount = 0;
+static unsigned recblock_oldest = 0;      /* record number at the start of the oldest block in the ring */
+static unsigned tracestring_first = 0;    /* record number of the oldest string (decoder side) */
+static unsigned tracestring_records = 0;  /* record number past the most recent string (decoder side) */
+static unsigned tracestring_hidden_rec = 0; /* strings dropped by a channel limit, but not yet evicted */
+static size_t tracestring_bytes = 0;      /* memory used by the strings in the window */
+static double tracestring_timebase = 0.0; /* time stamp of the first string after a clear */
+static bool tracestring_timebase_set = false;
+static unsigned short tracestring_timefmt_rec = 0;  /* longest formatted timestamp (decoder side) */
+static unsigned tracestring_pubseq = 0;     /* odd while the handoff is updated (handoff) */
+static unsigned tracestring_pubfirst = 0;   /* oldest string (handoff) */
+static unsigned tracestring_published = 0;  /* record number past the last completed string (handoff) */
+static unsigned tracestring_pubhidden = 0;  /* strings dropped by a channel limit (handoff) */
+static unsigned tracestring_pubstamp = 0;   /* reception time of the most recent packet, in us (handoff) */
+static int tracestring_timefmt_pub = 0;     /* longest formatted timestamp (handoff) */
+static unsigned tracestring_viewfirst = 0;  /* oldest string in the view of the GUI (handoff, reverse) */
+static unsigned tracestring_base = 0;   /* record number of the first line in view (GUI side) */
+static unsigned tracestring_lines = 0;  /* number of records in view (GUI side) */
+static unsigned tracestring_hidden = 0; /* number of hidden records in view (GUI side) */
+static unsigned tracestring_generation = 0; /* incremented on every clear */
+static unsigned short tracestring_timefmt_max = 0;  /* longest formatted timestamp (GUI side) */
+static TEXTBLOCK *textblock_root = NULL, *textblock_cur = NULL;
+static unsigned tracestring_chanfirst[NUM_CHANNELS];  /* oldest string in view, per channel (GUI side) */
+
+/* retention limits (0 = no limit) */
+static unsigned retain_lines = 0;
+static size_t retain_bytes = 0;
+static double retain_time = 0.0;
+
+/* per channel: the oldest & the most recent string & the number of strings */
+static unsigned chain_head[NUM_CHANNELS], chain_tail[NUM_CHANNELS], chain_count[NUM_CHANNELS];
+static unsigned chain_pubhead[NUM_CHANNELS];  /* oldest string on each channel (handoff) */
+
+#define TRACESTRING_RECORD(n) (&recblocks[((n) / TRACESTRING_BLOCKRECS) & (TRACESTRING_MAXBLOCKS - 1)]->recs[(n) % TRACESTRING_BLOCKRECS])
+#define TRACESTRING_RECSIZE(item) (sizeof(TRACESTRING) + (item)->size + 1)
+
+static TRACESTRING *tracestring_newrecord(void)
+{
+  if (tracestring_records % TRACESTRING_BLOCKRECS == 0) {
+    /* a new block is needed (if the slot in the ring is still in use, the
+       window is at its maximum size) */
+    unsigned slot = (tracestring_records / TRACESTRING_BLOCKRECS) & (TRACESTRING_MAXBLOCKS - 1);
+    if (recblocks[slot] != NULL)
+      return NULL;
+    if (recblock_freecount > 0)
+      recblocks[slot] = recblock_free[--recblock_freecount];
+    else if ((recblocks[slot] = malloc(sizeof(RECBLOCK))) == NULL)
+      return NULL;
+  }
+  TRACESTRING *item = TRACESTRING_RECORD(tracestring_records);
+  tracestring_records += 1;
+  memset(item, 0, sizeof(TRACESTRING));
+  return item;
+}
+
+/* tracestring_get() returns the record for the line (in the view of the GUI),
+   or NULL if the line is out of range */
+static TRACESTRING *tracestring_get(int line)
+{
+  if (line < 0 || (unsigned)line >= tracestring_lines)
+    return NULL;
+  return TRACESTRING_RECORD(tracestring_base + line);
+}
+
+/* tracestring_alloctext() allocates a text buffer of the given size (plus
+   one byte for the terminating zero) */
+static char *tracestring_alloctext(size_t size)
+{
+  size += 1;  /* for the zero terminator */
+  if (textblock_cur == NULL || textblock_cur->used + size > textblock_cur->size) {
+    TEXTBLOCK *block = (textblock_cur == NULL) ? textblock_root : textblock_cur->next;
+    if (block == NULL || block->size < size) {
+      /* allocate a new block, and insert it after the current block (blocks
+         that follow it are kept for reuse) */
+      size_t blocksize = (size > TRACESTRING_BLOCKTEXT) ? size : TRACESTRING_BLOCKTEXT;
+      TEXTBLOCK *newblock = malloc(sizeof(TEXTBLOCK) + blocksize);
+      if (newblock == NULL)
+        return NULL;
+      newblock->size = blocksize;
+      newblock->next = block;
+      if (textblock_cur == NULL)
+        textblock_root = newblock;
+      else
+        textblock_cur->next = newblock;
+      block = newblock;
+    }
+    block->used = 0;
+    textblock_cur = block;
+  }
+  char *text = textblock_cur->data + textblock_cur->used;
+  textblock_cur->used += size;
+  textblock_cur->lastrec = tracestring_records;
+  *text = '\0';
+  return text;
+}
+
+/* tracestring_growtext() enlarges the text buffer of the most recent string;
+   if the text is at the end of the current text block, it grows in place */
+static bool tracestring_growtext(TRACESTRING *item)
+{
+  assert(item != NULL && item->text != NULL);
+  assert(textblock_cur != NULL);
+  unsigned newsize = item->size * 2;
+  char *end = textblock_cur->data + textblock_cur->used;
+  if (item->text + item->size + 1 == end && textblock_cur->used + (newsize - item->size) <= textblock_cur->size) {
+    textblock_cur->used += newsize - item->size;
+  } else {
+    char *ptr = tracestring_alloctext(newsize);
+    if (ptr == NULL)
+      return false;
+    memcpy(ptr, item->text, item->length + 1);
+    item->text = ptr;
+  }
+  tracestring_bytes += newsize - item->size;
+  item->size = (unsigned short)newsize;
+  return true;
+}
+
+/* tracestring_recycle() returns the record blocks and text blocks that only
+   hold strings that were evicted (and that the GUI no longer views) to the
+   free lists (decoder side) */
+static void tracestring_recycle(void)
+{
+  unsigned limit = QUEUE_LOAD(tracestring_viewfirst);
+  if ((int)(tracestring_first - limit) < 0)
+    limit = tracestring_first;
+  while (limit - recblock_oldest >= TRACESTRING_BLOCKRECS) {
+    unsigned slot = (recblock_oldest / TRACESTRING_BLOCKRECS) & (TRACESTRING_MAXBLOCKS - 1);
+    assert(recblocks[slot] != NULL);
+    recblock_free[recblock_freecount++] = recblocks[slot];
+    recblocks[slot] = NULL;
+    recblock_oldest += TRACESTRING_BLOCKRECS;
+  }
+  /* text blocks are filled in the order of the records; the oldest block
+     moves to the free part of the list (behind the current block) */
+  while (textblock_root != NULL && textblock_root != textblock_cur
+         && (int)(textblock_root->lastrec - limit) < 0)
+  {
+    TEXTBLOCK *block = textblock_root;
+    textblock_root = block->next;
+    block->next = textblock_cur->next;
+    textblock_cur->next = block;
+  }
+}
+
+/* tracestring_evict() drops the oldest string */
+static void tracestring_evict(void)
+{
+  assert(tracestring_records - tracestring_first > 1);  /* the most recent string is never evicted */
+  const TRACESTRING *item = TRACESTRING_RECORD(tracestring_first);
+  if (chain_count[item->channel] > 0 && chain_head[item->channel] == tracestring_first) {
+    chain_head[item->channel] = item->chain;
+    chain_count[item->channel] -= 1;
+  } else {
+    /* strings on a channel are chained in order, so a string that is not
+       at the head of the chain was dropped already */
+    assert(tracestring_hidden_rec > 0);
+    tracestring_hidden_rec -= 1;
+  }
+  tracestring_bytes -= TRACESTRING_RECSIZE(item);
+  tracestring_first += 1;
+}
+
+/* tracestring_retain() applies the retention limits, after a string was
+   added */
+static void tracestring_retain(void)
+{
+  /* channel limit: drop the oldest string of the channel of the new string
+     (it is unlinked from the chain, but stays in the window until it is
+     evicted) */
+  unsigned chan = tracestring_tail->channel;
+  if (channels[chan].maxlines > 0 && chain_count[chan] > channels[chan].maxlines) {
+    chain_head[chan] = TRACESTRING_RECORD(chain_head[chan])->chain;
+    chain_count[chan] -= 1;
+    tracestring_hidden_rec += 1;
+  }
+  /* global limits: drop the oldest strings (dropped strings at the front of
+     the window are evicted right away) */
+  while (tracestring_records - tracestring_first > 1) {
+    const TRACESTRING *item = TRACESTRING_RECORD(tracestring_first);
+    bool dropped = (chain_count[item->channel] == 0 || chain_head[item->channel] != tracestring_first);
+    if (!dropped
+        && (retain_lines == 0 || tracestring_records - tracestring_first <= retain_lines)
+        && (retain_bytes == 0 || tracestring_bytes <= retain_bytes)
+        && (retain_time <= 0.0 || tracestring_tail->timestamp - item->timestamp <= retain_time))
+      break;
+    tracestring_evict();
+  }
+  tracestring_recycle();
+}
+
+static void tracestring_append(TRACESTRING *item)
+{
+  assert(item != NULL);
+  assert(tracestring_records > 0);
+  assert(item == TRACESTRING_RECORD(tracestring_records - 1));
+  unsigned recnum = tracestring_records - 1;
+  if (item->timefmt_len > tracestring_timefmt_rec)
+    tracestring_timefmt_rec = item->timefmt_len;
+  if (chain_count[item->channel] > 0)
+    TRACESTRING_RECORD(chain_tail[item->channel])->chain = recnum;
+  else
+    chain_head[item->channel] = recnum;
+  chain_tail[item->channel] = recnum;
+  chain_count[item->channel] += 1;
+  tracestring_bytes += TRACESTRING_RECSIZE(item);
+  tracestring_tail = item;
+  tracestring_retain();
+}
+
+/* tracestring_publish() hands the completed strings over to the GUI; the
+   most recent string is included if "complete" is true */
+static void tracestring_publish(bool complete)
+{
+  unsigned seq = tracestring_pubseq;  /* only the decoder writes it */
+  QUEUE_STORE(tracestring_pubseq, seq + 1);
+  for (int chan = 0; chan < NUM_CHANNELS; chan++)
+    QUEUE_STORE(chain_pubhead[chan], (chain_count[chan] > 0) ? chain_head[chan] : tracestring_records);
+  QUEUE_STORE(tracestring_timefmt_pub, tracestring_timefmt_rec);
+  QUEUE_STORE(tracestring_pubhidden, tracestring_hidden_rec);
+  QUEUE_STORE(tracestring_pubstamp, stat_pktstamp);
+  QUEUE_STORE(tracestring_pubfirst, tracestring_first);
+  QUEUE_STORE(tracestring_published, (complete || tracestring_records == tracestring_first) ? tracestring_records : tracestring_records - 1);
+  QUEUE_STORE(tracestring_pubseq, seq + 2);
+}
+
+/* tracestring_view() takes over the strings that the decoder published, in
+   the view of the GUI thread; it returns the number of new strings */
+static int tracestring_view(void)
+{
+  unsigned seq, first, end, hidden, timefmt, stamp;
+  unsigned chanfirst[NUM_CHANNELS];
+  do {
+    seq = QUEUE_LOAD(tracestring_pubseq);
+    for (int chan = 0; chan < NUM_CHANNELS; chan++)
+      chanfirst[chan] = QUEUE_LOAD(chain_pubhead[chan]);
+    timefmt = QUEUE_LOAD(tracestring_timefmt_pub);
+    hidden = QUEUE_LOAD(tracestring_pubhidden);
+    stamp = QUEUE_LOAD(tracestring_pubstamp);
+    first = QUEUE_LOAD(tracestring_pubfirst);
+    end = QUEUE_LOAD(tracestring_published);
+  } while ((seq & 1) != 0 || seq != QUEUE_LOAD(tracestring_pubseq));
+  int count = (int)(end - (tracestring_base + tracestring_lines));
+  if (count > 0 && !trace_replaying) {
+    /* the packets of a recording have the time stamps of the recording */
+    stat_latency = STAT_USEC(get_timestamp()) - stamp;
+    if (stat_latency > stat_latency_max)
+      stat_latency_max = stat_latency;
+  }
+  memcpy(tracestring_chanfirst, chanfirst, sizeof tracestring_chanfirst);
+  tracestring_timefmt_max = (unsigned short)timefmt;
+  tracestring_hidden = hidden;
+  tracestring_base = first;
+  tracestring_lines = end - first;
+  QUEUE_STORE(tracestring_viewfirst, first);
+  return count;
+}
+
+/* tracestring_ishidden() returns whether the line (in the view of the GUI
+   thread) was dropped by a channel limit */
+static bool tracestring_ishidden(int line)
+{
+  const TRACESTRING *item = tracestring_get(line);
+  assert(item != NULL);
+  return (int)(tracestring_base + line - tracestring_chanfirst[item->channel]) < 0;
+}
+
+/** tracestring_setlimits() sets the retention limits for the trace strings:
+ *  when a limit is exceeded, the oldest strings are evicted. A limit that is
+ *  zero is not applied.
+ *
+ *  \param maxlines   The maximum number of strings.
+ *  \param maxbytes   The maximum memory for the strings (approximately).
+ *  \param maxtime    The time window, in seconds.
+ */
+void tracestring_setlimits(unsigned maxlines, size_t maxbytes, double maxtime)
+{
+  decoder_stop();   /* the decoder restarts on the next tracestring_process() */
+  retain_lines = maxlines;
+  retain_bytes = maxbytes;
+  retain_time = maxtime;
+}
+
+void tracestring_getlimits(unsigned *maxlines, size_t *maxbytes, double *maxtime)
+{
+  if (maxlines != NULL)
+    *maxlines = retain_lines;
+  if (maxbytes != NULL)
+    *maxbytes = retain_bytes;
+  if (maxtime != NULL)
+    *maxtime = retain_time;
+}
+
+static void tracestring_add(unsigned channel, const unsigned char *buffer, size_t length, double timestamp)
+{
+  assert(channel < NUM_CHANNELS);
+  assert(buffer != NULL);
+  assert(length > 0);
+
+  /* check whether the channel is enabled (in passive mode, the target that
+     sends the trace messages is oblivious of the settings in this viewer,
+     so it may send trace messages for disabled channels) */
+  if (!channels[channel].enabled)
+    return;
+
+  if (stream_isactive(channel)) {
+    /* CTF mode */
+    int count = ctf_decode(buffer, length, channel);
+    if (count > 0) {
+      uint16_t streamid;
+      double tstamp, tstamp_relative;
+      const char *message;
+      size_t len;
+      while (msgstack_peek(&streamid, &tstamp, &message, &len)) {
+        QUEUE_STORE(stat_ctf_events, stat_ctf_events + 1);
+        char *text = tracestring_alloctext(len);
+        TRACESTRING *item = (text != NULL) ? tracestring_newrecord() : NULL;
+        if (item != NULL) {
+          item->text = text;
+          memcpy(item->text, message, len);
+          item->text[len] = '\0';
+          item->length = item->size = (unsigned short)len;
+          item->channel = (unsigned char)streamid;
+          item->flags = 0x01; /* CTF messages are complete */
+          if (tstamp > 0.001)
+            timestamp = tstamp; /* use precision timestamp from remote host */
+          item->timestamp = timestamp;
+          /* create formatted timestamp */
+          if (!tracestring_timebase_set) {
+            tracestring_timebase = timestamp;
+            tracestring_timebase_set = true;
+          }
+          tstamp_relative = timestamp - tracestring_timebase;
+          if (tstamp > 0.001)
+            sprintf(item->timefmt, "%.6f", tstamp_relative);
+          else
+            sprintf(item->timefmt, "%.3f", tstamp_relative);
+          item->timefmt_len = (unsigned short)strlen(item->timefmt);
+          assert(item->timefmt_len < sizearray(item->timefmt));
+          tracestring_append(item);
+        }
+        msgstack_pop(NULL, NULL, NULL, 0);
+      }
+    }
+  } else {
+    /* plain text mode */
+    double tstamp_relative;
+    unsigned idx;
+    while (length > 0 && buffer[length - 1] == '\0')
+      length--; /* this can happen with expansion from zero-compression */
+    for (idx = 0; idx < length; idx++) {
+      /* see whether to append to the recent string, or to add a new string */
+      if (tracestring_tail != NULL) {
+        if (buffer[idx] == '\r' || buffer[idx] == '\n') {
+          tracestring_tail->flags |= 0x01;  /* on newline, create a new string */
+          continue;
+        } else if (tracestring_tail->channel != channel) {
+          tracestring_tail->flags |= 0x01;  /* different channel, terminate previous string */
+        } else if (tracestring_tail->length >= TRACESTRING_MAXLENGTH) {
+          tracestring_tail->flags |= 0x01;  /* line length limit */
+        }
+        /* time criterion: there should not be more that 0.1 seconds between
+           parts of a continued string */
+        if (tracestring_tail != NULL && timestamp - tracestring_tail->timestamp > 0.1)
+          tracestring_tail->flags |= 0x01;  /* interval limit */
+      }
+
+      if (tracestring_tail != NULL && (tracestring_tail->flags & 0x01) == 0) {
+        /* append text to the current string */
+        if (tracestring_tail->length >= tracestring_tail->size)
+          tracestring_growtext(tracestring_tail);
+        if (tracestring_tail->length < tracestring_tail->size) {
+          tracestring_tail->text[tracestring_tail->length++] = buffer[idx];
+          tracestring_tail->text[tracestring_tail->length] = '\0';
+        }
+      } else {
+        /* create a new string */
+        if (tracestring_tail == NULL && (buffer[idx] == '\r' || buffer[idx] == '\n'))
+          continue; /* don't create an empty first string */
+        char *text = tracestring_alloctext(TRACESTRING_INITSIZE);
+        TRACESTRING *item = (text != NULL) ? tracestring_newrecord() : NULL;
+        if (item != NULL) {
+          item->text = text;
+          item->size = TRACESTRING_INITSIZE;
+          item->channel = (unsigned char)channel;
+          item->timestamp = timestamp;
+          /* create formatted timestamp */
+          if (!tracestring_timebase_set) {
+            tracestring_timebase = timestamp;
+            tracestring_timebase_set = true;
+          }
+          tstamp_relative = timestamp - tracestring_timebase;
+          sprintf(item->timefmt, "%.3f", tstamp_relative);
+          item->timefmt_len = (unsigned short)strlen(item->timefmt);
+          assert(item->timefmt_len < sizearray(item->timefmt));
+          tracestring_append(item);
+          tracestring_tail->text[tracestring_tail->length++] = buffer[idx];
+          tracestring_tail->text[tracestring_tail->length] = '\0';
+        }
+      }
+    }
+  }
+}
+
+/** tracestring_clear() removes all strings. The memory is not freed, but
+ *  kept for the strings that are added next. The decoder thread is stopped;
+ *  it restarts on the next call to tracestring_process() (so the decoder
+ *  state, e.g. CTF, may be changed between the two calls).
+ */
+void tracestring_clear(void)
+{
+  decoder_stop();
+  /* move all record blocks to the free list */
+  for (unsigned idx = 0; idx < TRACESTRING_MAXBLOCKS; idx++) {
+    if (recblocks[idx] != NULL) {
+      recblock_free[recblock_freecount++] = recblocks[idx];
+      recblocks[idx] = NULL;
+    }
+  }
+  recblock_oldest = 0;
+  tracestring_tail = NULL;
+  tracestring_first = tracestring_records = 0;
+  tracestring_hidden_rec = 0;
+  tracestring_bytes = 0;
+  tracestring_timebase_set = false;
+  tracestring_timefmt_rec = 0;
+  memset(chain_count, 0, sizeof chain_count);
+  for (int chan = 0; chan < NUM_CHANNELS; chan++)
+    chain_pubhead[chan] = tracestring_chanfirst[chan] = 0;
+  chanqueue_clear();
+  tracestring_pubfirst = tracestring_published = tracestring_pubhidden = 0;
+  tracestring_viewfirst = 0;
+  tracestring_timefmt_pub = 0;
+  tracestring_base = tracestring_lines = tracestring_hidden = 0;
+  tracestring_timefmt_max = 0;
+  tracestring_generation += 1;
+  textblock_cur = NULL;
+}
+
+int tracestring_isempty(void)
+{
+  return (tracestring_lines == 0);
+}
+
+unsigned tracestring_count(void)
+{
+  return tracestring_lines - tracestring_hidden;
+}
+
+/* The decoder frames the ITM packets, and queues the data of each channel in
+   a queue of its own; the trace strings are then built from these queues, in
+   the order of arrival. When building the strings lags behind, a channel that
+   sends a lot of data only fills up (or overflows) its own queue, while the
+   data of the other channels still gets through. Both ends of the queues are
+   on the decoder thread. */
+#define CHANQUEUE_SIZE    8192  /* in chunks, must be a power of 2 */
+#define CHANQUEUE_BUDGET  0.02  /* time in seconds for building strings, per round */
+
+typedef struct tagCHUNK {
+  unsigned char data[PACKET_SIZE];
+  unsigned short length;  /* 0 = framing error (CTF decoder must be reset) */
+  unsigned seq;           /* order of arrival */
+  double timestamp;
+} CHUNK;
+
+typedef struct tagCHANQUEUE {
+  CHUNK *chunks;          /* allocated on first use */
+  unsigned head, tail;
+} CHANQUEUE;
+
+static CHANQUEUE chanqueue[NUM_CHANNELS];
+static unsigned chanqueue_used = 0; /* bit mask of the queues that hold data */
+static unsigned chanqueue_seq = 0;
+static bool chanqueue_nearfull = false; /* a queue may not have room for another packet */
+
+static bool chanqueue_put(unsigned channel, const unsigned char *buffer, size_t length, double timestamp)
+{
+  assert(channel < NUM_CHANNELS);
+  assert(length <= PACKET_SIZE);
+  CHANQUEUE *queue = &chanqueue[channel];
+  if (queue->chunks == NULL) {
+    queue->chunks = malloc(CHANQUEUE_SIZE * sizeof(CHUNK));
+    if (queue->chunks == NULL)
+      return false;
+    queue->head = queue->tail = 0;
+  }
+  if (queue->tail - queue->head >= CHANQUEUE_SIZE) {
+    QUEUE_INCREMENT(tracequeue_overflow); /* notify overflow (of this channel only) */
+    PERF_COUNT("swo.overflow", 1);
+    return false;
+  }
+  CHUNK *chunk = &queue->chunks[queue->tail & (CHANQUEUE_SIZE - 1)];
+  if (length > 0)
+    memcpy(chunk->data, buffer, length);
+  chunk->length = (unsigned short)length;
+  chunk->seq = chanqueue_seq++;
+  chunk->timestamp = timestamp;
+  queue->tail += 1;
+  chanqueue_used |= 1u << channel;
+  if (queue->tail - queue->head >= CHANQUEUE_SIZE - PACKET_SIZE)
+    chanqueue_nearfull = true;
+  return true;
+}
+
+/* chanqueue_error() queues a marker for a framing error, so that the CTF
+   decoder is reset at the same point in the stream (the chunks are handled in
+   the order of arrival, so the channel of the marker does not matter) */
+static void chanqueue_error(unsigned channel)
+{
+  if (!chanqueue_put((channel < NUM_CHANNELS) ? channel : 0, NULL, 0, 0.0))
+    ctf_decode_reset();
+}
+
+static void chanqueue_clear(void)
+{
+  for (unsigned chan = 0; chan < NUM_CHANNELS; chan++)
+    chanqueue[chan].head = chanqueue[chan].tail;
+  chanqueue_used = 0;
+  chanqueue_nearfull = false;
+}
+
+/* chanqueue_drain() builds the trace strings from the queued data, the oldest
+   chunk first; it stops when the time budget has passed (a budget of zero
+   drains the queues completely); it returns the number of chunks handled */
+static int chanqueue_drain(double budget)
+{
+  double starttime = (budget > 0.0) ? get_timestamp() : 0.0;
+  int count = 0;
+  while (chanqueue_used != 0) {
+    unsigned channel = NUM_CHANNELS, oldest = 0;
+    for (unsigned chan = 0; chan < NUM_CHANNELS; chan++) {
+      if ((chanqueue_used & (1u << chan)) == 0)
+        continue;
+      const CHANQUEUE *queue = &chanqueue[chan];
+      unsigned seq = queue->chunks[queue->head & (CHANQUEUE_SIZE - 1)].seq;
+      if (channel == NUM_CHANNELS || (int)(seq - oldest) < 0) {
+        channel = chan;
+        oldest = seq;
+      }
+    }
+    assert(channel < NUM_CHANNELS);
+    CHANQUEUE *queue = &chanqueue[channel];
+    const CHUNK *chunk = &queue->chunks[queue->head & (CHANQUEUE_SIZE - 1)];
+    if (chunk->length > 0)
+      tracestring_add(channel, chunk->data, chunk->length, chunk->timestamp);
+    else
+      ctf_decode_reset();
+    queue->head += 1;
+    if (queue->head == queue->tail)
+      chanqueue_used &= ~(1u << channel);
+    count += 1;
+    if (budget > 0.0 && (count % 64) == 0 && get_timestamp() - starttime >= budget)
+      break;
+  }
+  if (chanqueue_used == 0)
+    chanqueue_nearfull = false;
+  return count;
+}
+
+/* demux_packet() frames the ITM packets in a packet that was received, and
+   queues the data per channel (decoder side); the data of disabled channels
+   is dropped */
+static void demux_packet(const PACKET *packet)
+{
+  const unsigned char *pktdata = packet->data;
+  size_t pktlen = packet->length;
+  unsigned chan = ~0u;
+  unsigned char buffer[PACKET_SIZE];
+  size_t buflen = 0;
+  unsigned len;
+
+  if (pktlen == 0)
+    return;     /* failed or cancelled transfer */
+
+  if (itm_cachefilled>0) {
+    int skip = 0;
+    chan = ITM_CHANNEL(itm_cache[0]);
+    len = ITM_LENGTH(itm_cache[0]);
+    if (len > itm_datasize) {
+      if (itm_datasz_auto) {
+        itm_datasize = len; /* if larger data word is found, datasize must be adjusted */
+      } else {
+        chanqueue_error(chan);
+        itm_packet_errors += 1;
+        PERF_COUNT("swo.itm.errors", 1);
+        return;     /* not a valid ITM packet, ignore it */
+      }
+    }
+    assert(itm_cachefilled <= 4);
+    skip = len - (itm_cachefilled - 1);
+    assert(skip > 0);       /* there must be data left to copy (otherwise nothing would be cached) */
+    if ((size_t)skip > pktlen) {
+      /* cached data plus new data *still* do not make a complete packet (the
+         capture thread may have removed data from this packet) */
+      memcpy(itm_cache + itm_cachefilled, pktdata, pktlen);
+      itm_cachefilled += pktlen;
+      return;
+    }
+    if (itm_cachefilled > 1) {
+      /* copy data bytes still in the cache */
+      memcpy(buffer + buflen, itm_cache + 1, itm_cachefilled - 1);
+      buflen += itm_cachefilled - 1;
+    }
+    memcpy(buffer + buflen, pktdata, skip);
+    buflen += skip;
+    pktdata += skip;
+    pktlen -= skip;
+    itm_cachefilled = 0;
+  } else {
+    assert(pktlen > 0);
+    chan = ITM_CHANNEL(*pktdata);
+  }
+
+  while (pktlen > 0) {
+    if (ITM_HWSOURCE(*pktdata)) {
+      /* hardware source packet: profile packet (PC address), or data
+         trace packet */
+      len = ITM_HWLENGTH(*pktdata);
+      if (pktlen < len + 1)
+        break;              /* truncated, drop it */
+      if (DWT_DATAVALUE(*pktdata))
+        datawatch_add(pktdata, packet->timestamp);
+      pktdata += len + 1;
+      pktlen -= len + 1;
+      continue;
+    } else if (!ITM_VALIDHDR(*pktdata)) {
+      chanqueue_error(chan);
+      itm_packet_errors += 1;
+      PERF_COUNT("swo.itm.errors", 1);
+      return;       /* not a valid ITM packet, ignore it */
+    }
+    /* if the channel changes in the middle of a packet, add a string and
+       restart */
+    if (chan != ITM_CHANNEL(*pktdata)) {
+      if (chan < NUM_CHANNELS && buflen > 0 && channels[chan].enabled)
+        chanqueue_put(chan, buffer, buflen, packet->timestamp);
+      chan = ITM_CHANNEL(*pktdata);
+      buflen = 0;
+    }
+    len = ITM_LENGTH(*pktdata);
+    if (pktlen < len + 1) {
+      /* store remaining data in the packet in the cache and quit */
+      memcpy(itm_cache, pktdata, pktlen);
+      itm_cachefilled = pktlen;
+      break;
+    }
+    if (len > itm_datasize) {
+      if (itm_datasz_auto) {
+        itm_datasize = len; /* if larger data word is found, datasize must be adjusted */
+      } else {
+        chanqueue_error(chan);
+        itm_packet_errors += 1;
+        PERF_COUNT("swo.itm.errors", 1);
+        return;     /* not a valid ITM packet, ignore it */
+      }
+    }
+    memcpy(buffer + buflen, pktdata + 1, len);
+    buflen += len;
+    pktdata += len + 1;
+    pktlen -= len + 1;
+  }
+  if (chan < NUM_CHANNELS && buflen > 0 && channels[chan].enabled)
+    chanqueue_put(chan, buffer, buflen, packet->timestamp);
+}
+
+/* In trigger mode, the decoder does not decode the packets, but keeps them in
+   a ring; only the oldest packets are dropped when the ring is full. The
+   packets are scanned for the trigger condition on a fast path: the ITM
+   packets are framed (but their data is not collected), text is matched per
+   channel, and CTF events are parsed without formatting them. After the
+   trigger, the packets are kept for the post-trigger time (or until the other
+   half of the ring is filled too). Then the ring is frozen and decoded into
+   trace strings in one go; later packets are dropped until the trigger is
+   re-armed. */
+#define TRIGGER_MAXPATTERN  64
+
+static int trigger_type = TRIGGER_NONE;
+static unsigned trigger_channel = 0;
+static char trigger_pattern[TRIGGER_MAXPATTERN];
+static unsigned trigger_patlen = 0;
+static unsigned char trigger_failure[TRIGGER_MAXPATTERN]; /* KMP failure function */
+static double trigger_post = 0.0;         /* capture time after the trigger, in seconds */
+static PACKET *trigger_ring = NULL;
+static unsigned trigger_ringmask = 0;     /* number of packets in the ring - 1 */
+static unsigned trigger_head = 0, trigger_tail = 0; /* free-running packet counters */
+static int trigger_state = TRIGGERSTATE_OFF;  /* decoder side, read by the GUI */
+static double trigger_time = 0.0;         /* time stamp of the packet that fired */
+static unsigned trigger_itmskip = 0;      /* bytes left of the current ITM packet */
+static unsigned trigger_itmchan = ~0u;    /* channel of the current ITM packet (~0 for a hardware packet) */
+static unsigned char trigger_match[NUM_CHANNELS]; /* matched length of the pattern, per channel */
+static CTF_DECODER *trigger_ctf = NULL;
+
+/* trigger_scan() checks the data of an ITM channel for the trigger condition
+   (decoder side) */
+static bool trigger_scan(unsigned channel, const unsigned char *data, size_t length)
+{
+  assert(channel < NUM_CHANNELS);
+  if (!channels[channel].enabled)
+    return false;
+  if (trigger_type == TRIGGER_CTFEVENT) {
+    if (!stream_isactive(channel) || trigger_ctf == NULL)
+      return false;
+    ctf_decoder_select(trigger_ctf);
+    int count = ctf_decode(data, length, channel);
+    ctf_decoder_select(NULL);
+    return count > 0;
+  }
+  assert(trigger_type == TRIGGER_TEXT && trigger_patlen > 0);
+  unsigned matched = trigger_match[channel];
+  for (size_t idx = 0; idx < length; idx++) {
+    while (matched > 0 && (char)data[idx] != trigger_pattern[matched])
+      matched = trigger_failure[matched - 1];
+    if ((char)data[idx] == trigger_pattern[matched] && ++matched == trigger_patlen) {
+      trigger_match[channel] = 0;
+      return true;
+    }
+  }
+  trigger_match[channel] = (unsigned char)matched;
+  return false;
+}
+
+/* trigger_check() frames the ITM packets in a packet from the queue, and
+   returns whether the trigger condition occurs in it (decoder side) */
+static bool trigger_check(const PACKET *packet)
+{
+  const unsigned char *data = packet->data;
+  size_t length = packet->length;
+  unsigned char buffer[PACKET_SIZE];
+  size_t buflen = 0;
+  unsigned bufchan = ~0u;
+  bool fired = false;
+  while (length > 0 && !fired) {
+    if (trigger_itmskip > 0) {
+      unsigned count = (length < trigger_itmskip) ? (unsigned)length : trigger_itmskip;
+      if (trigger_itmchan < NUM_CHANNELS && trigger_type != TRIGGER_CHANNEL) {
+        if (trigger_itmchan != bufchan && buflen > 0) {
+          fired = trigger_scan(bufchan, buffer, buflen);
+          buflen = 0;
+        }
+        bufchan = trigger_itmchan;
+        memcpy(buffer + buflen, data, count);
+        buflen += count;
+      }
+      data += count;
+      length -= count;
+      trigger_itmskip -= count;
+      continue;
+    }
+    unsigned char header = *data++;
+    length--;
+    if (ITM_HWSOURCE(header)) {
+      trigger_itmskip = ITM_HWLENGTH(header);
+      trigger_itmchan = ~0u;
+    } else if (ITM_VALIDHDR(header)) {
+      trigger_itmskip = ITM_LENGTH(header);
+      trigger_itmchan = ITM_CHANNEL(header);
+      if (trigger_type == TRIGGER_CHANNEL && trigger_itmchan == trigger_channel)
+        fired = true;
+    } /* else: synchronization, overflow or time stamp packet, skip the byte */
+  }
+  if (!fired && buflen > 0)
+    fired = trigger_scan(bufchan, buffer, buflen);
+  return fired;
+}
+
+/* trigger_decode() decodes the packets in the ring into trace strings, and
+   freezes the trigger (decoder side) */
+static int trigger_decode(void)
+{
+  int count = 0;
+  itm_cachefilled = 0;
+  ctf_decode_reset();
+  for ( ; trigger_head != trigger_tail; trigger_head++) {
+    demux_packet(&trigger_ring[trigger_head & trigger_ringmask]);
+    count += chanqueue_drain(0.0);
+  }
+  QUEUE_STORE(trigger_state, TRIGGERSTATE_DONE);
+  return count;
+}
+
+/* trigger_store() keeps a packet in the ring and checks it for the trigger
+   condition; it returns the number of packets decoded, which is only
+   non-zero when the capture completes (decoder side) */
+static int trigger_store(const PACKET *packet)
+{
+  assert(trigger_ring != NULL);
+  if (packet->length == 0)
+    return 0;
+  unsigned half = (trigger_ringmask + 1) / 2;
+  if (trigger_state == TRIGGERSTATE_CAPTURING && trigger_tail - trigger_head > trigger_ringmask)
+    return trigger_decode();  /* post-trigger part of the ring is full */
+  trigger_ring[trigger_tail & trigger_ringmask] = *packet;
+  trigger_tail += 1;
+  if (trigger_state == TRIGGERSTATE_ARMED) {
+    if (trigger_tail - trigger_head > half)
+      trigger_head = trigger_tail - half; /* drop the oldest packet */
+    if (trigger_check(packet)) {
+      trigger_time = packet->timestamp;
+      QUEUE_STORE(trigger_state, TRIGGERSTATE_CAPTURING);
+    }
+  } else if (packet->timestamp >= trigger_time + trigger_post) {
+    return trigger_decode();
+  }
+  return 0;
+}
+
+/** trace_trigger() sets the trigger condition, and arms the trigger. In
+ *  trigger mode, the packets are kept (but not decoded) in a ring, until the
+ *  condition occurs; after the post-trigger time, the packets in the ring are
+ *  decoded to trace strings at once. The decoder thread is stopped; it
+ *  restarts on the next call to tracestring_process().
+ *
+ *  \param type      One of TRIGGER_NONE (to leave trigger mode),
+ *                   TRIGGER_CHANNEL, TRIGGER_CTFEVENT or TRIGGER_TEXT.
+ *  \param value     The ITM channel for TRIGGER_CHANNEL, or the event id for
+ *                   TRIGGER_CTFEVENT (ignored otherwise).
+ *  \param text      The text to match for TRIGGER_TEXT (ignored otherwise).
+ *  \param ringsize  The size of the pre-trigger ring, in bytes; it is rounded
+ *                   down to a power of 2 number of packets. The capture after
+ *                   the trigger is limited to the same size.
+ *  \param post      The capture time after the trigger, in seconds.
+ *
+ *  \return true on success, false on failure (invalid parameter, or memory
+ *          allocation failure).
+ */
+bool trace_trigger(int type, int value, const char *text, size_t ringsize, double post)
+{
+  decoder_stop();
+  if (trigger_ctf != NULL) {
+    ctf_decoder_delete(trigger_ctf);
+    trigger_ctf = NULL;
+  }
+  trigger_type = TRIGGER_NONE;
+  QUEUE_STORE(trigger_state, TRIGGERSTATE_OFF);
+  switch (type) {
+  case TRIGGER_NONE:
+    if (trigger_ring != NULL) {
+      free((void*)trigger_ring);
+      trigger_ring = NULL;
+    }
+    return true;
+  case TRIGGER_CHANNEL:
+    if (value < 0 || value >= NUM_CHANNELS)
+      return false;
+    trigger_channel = (unsigned)value;
+    break;
+  case TRIGGER_CTFEVENT:
+    if (value < 0 || (trigger_ctf = ctf_decoder_create(NULL)) == NULL)
+      return false;
+    ctf_decoder_watch(trigger_ctf, value);
+    break;
+  case TRIGGER_TEXT:
+    assert(text != NULL);
+    trigger_patlen = (unsigned)strlen(text);
+    if (trigger_patlen == 0 || trigger_patlen >= TRIGGER_MAXPATTERN)
+      return false;
+    memcpy(trigger_pattern, text, trigger_patlen);
+    /* failure function for the Knuth-Morris-Pratt algorithm */
+    trigger_failure[0] = 0;
+    for (unsigned idx = 1, len = 0; idx < trigger_patlen; idx++) {
+      while (len > 0 && trigger_pattern[idx] != trigger_pattern[len])
+        len = trigger_failure[len - 1];
+      if (trigger_pattern[idx] == trigger_pattern[len])
+        len++;
+      trigger_failure[idx] = (unsigned char)len;
+    }
+    break;
+  default:
+    return false;
+  }
+
+  unsigned count = 2;
+  while ((size_t)count * sizeof(PACKET) <= ringsize)
+    count *= 2;   /* "count" is twice the size of the pre-trigger ring */
+  if (trigger_ring == NULL || count != trigger_ringmask + 1) {
+    PACKET *ring = (PACKET*)malloc(count * sizeof(PACKET));
+    if (ring == NULL)
+      return false;
+    if (trigger_ring != NULL)
+      free((void*)trigger_ring);
+    trigger_ring = ring;
+    trigger_ringmask = count - 1;
+  }
+  trigger_type = type;
+  trigger_post = post;
+  trace_trigger_rearm();
+  return true;
+}
+
+/** trace_trigger_rearm() discards the packets kept for the trigger, and
+ *  waits for the trigger condition again (with the settings of the most
+ *  recent call to trace_trigger()). This has no effect if no trigger is set.
+ *  It must also be called after the TSDL file is (re-)loaded. The decoder
+ *  thread is stopped; it restarts on the next call to tracestring_process().
+ */
+void trace_trigger_rearm(void)
+{
+  if (trigger_type == TRIGGER_NONE)
+    return;
+  decoder_stop();
+  trigger_head = trigger_tail = 0;
+  trigger_itmskip = 0;
+  trigger_itmchan = ~0u;
+  memset(trigger_match, 0, sizeof trigger_match);
+  if (trigger_ctf != NULL) {
+    ctf_decoder_select(trigger_ctf);
+    ctf_decode_cleanup();   /* drop the compiled events, the TSDL may have changed */
+    ctf_decoder_select(NULL);
+  }
+  QUEUE_STORE(trigger_state, TRIGGERSTATE_ARMED);
+}
+
+/** trace_trigger_state() returns the state of the trigger: TRIGGERSTATE_OFF,
+ *  TRIGGERSTATE_ARMED (waiting for the condition), TRIGGERSTATE_CAPTURING
+ *  (collecting the packets after the trigger) or TRIGGERSTATE_DONE (the
+ *  capture is decoded into trace strings).
+ *
+ *  \param timestamp  Set to the time stamp of the trigger, when the state is
+ *                    TRIGGERSTATE_CAPTURING or TRIGGERSTATE_DONE. This
+ *                    parameter may be NULL.
+ */
+int trace_trigger_state(double *timestamp)
+{
+  int state = QUEUE_LOAD(trigger_state);
+  if (timestamp != NULL && state >= TRIGGERSTATE_CAPTURING)
+    *timestamp = trigger_time;
+  return state;
+}
+
+/* tracestring_decode() decodes the packets in the queue into trace strings,
+   or passes them through the trigger (decoder side) */
+static int tracestring_decode(bool enabled)
+{
+  const PACKET *packets;
+  unsigned numpackets, pktidx;
+  int count = 0;
+  bool feeding = trace_running || trace_replaying;  /* read before the queue is drained */
+  while ((numpackets = tracequeue_peek(&packets)) > 0) {
+    double starttime = get_timestamp();
+    PERF_TIMER_BEGIN(tstart);
+    for (pktidx = 0; enabled && pktidx < numpackets; pktidx++) {
+      int state = trigger_state;
+      if (state == TRIGGERSTATE_OFF) {
+        demux_packet(&packets[pktidx]);
+        if (chanqueue_nearfull && !trace_running)
+          count += chanqueue_drain(0.0);  /* a replay must not drop data */
+      } else if (state != TRIGGERSTATE_DONE)
+        count += trigger_store(&packets[pktidx]);
+    }
+    stat_pktstamp = STAT_USEC(packets[numpackets - 1].timestamp);
+    QUEUE_STORE(stat_decode_usec, stat_decode_usec + (STAT_USEC(get_timestamp()) - STAT_USEC(starttime)));
+    QUEUE_STORE(stat_decoded, stat_decoded + numpackets);
+    tracequeue_release(numpackets);
+    PERF_TIMER_END(tstart, "swo.decode");
+    PERF_COUNT("swo.packets", numpackets);
+  }
+  if (chanqueue_used != 0) {
+    double starttime = get_timestamp();
+    count += chanqueue_drain(CHANQUEUE_BUDGET);
+    QUEUE_STORE(stat_decode_usec, stat_decode_usec + (STAT_USEC(get_timestamp()) - STAT_USEC(starttime)));
+  }
+
+  /* a capture also completes when the post-trigger time passes without data,
+     or (for a replay) when no more packets will arrive */
+  if (trigger_state == TRIGGERSTATE_CAPTURING
+      && (!feeding || (trace_running && get_timestamp() >= trigger_time + trigger_post)))
+    count += trigger_decode();
+
+  if (!enabled)
+    QUEUE_EXCHANGE(tracequeue_overflow, 0); /* ignore overflow events if not running/decoding */
+  return count;
+}
+
+/* The search engine scans the strings (in the view of the GUI thread) on a
+   set of worker threads, each of which scans a range of lines. The hits are
+   collected in a list of record numbers, which is sorted, because the ranges
+   are in order. "Find next" is then a lookup in the list. When new strings
+   arrive, only the new strings are scanned (and their hits appended); hits on
+   lines that were evicted are skipped. The strings in view do not change
+   while the search runs, because the view only changes in
+   tracestring_process(). */
+#define SEARCH_MAXTHREADS 8
+#define SEARCH_MINLINES   16384   /* minimum number of lines for every thread */
+
+typedef struct tagSEARCHJOB {
+  unsigned first, last;   /* range of lines (in view) */
+  unsigned *hits;         /* record numbers of the matching lines */
+  size_t count, size;
+} SEARCHJOB;
+
+static char search_text[TRACESTRING_MAXLENGTH + 1];
+static size_t search_len = 0;
+static unsigned *search_hits = NULL;
+static size_t search_count = 0, search_size = 0;
+static size_t search_first = 0;         /* first hit that may be in view (older hits were evicted) */
+static unsigned search_end = 0;         /* record number past the last string that was scanned */
+static unsigned search_generation = ~0u;
+
+#if defined __GNUC__
+# define SEARCH_CTZ(m)    (unsigned)__builtin_ctzll(m)
+#elif defined _MSC_VER
+  static unsigned SEARCH_CTZ(unsigned long long m)
+  {
+    unsigned long idx;
+    _BitScanForward64(&idx, m);
+    return (unsigned)idx;
+  }
+#endif
+
+/* search_match() returns whether the search text occurs in the string (case
+   insensitive); the first character is located with a vector compare (on
+   both cases), and only the candidate positions are compared in full */
+static bool search_match(const char *text, size_t length)
+{
+  assert(text != NULL);
+  assert(search_len > 0);
+  if (length < search_len)
+    return false;
+  size_t last = length - search_len;  /* last position where the text may start */
+  unsigned char lower = (unsigned char)tolower(search_text[0]);
+  unsigned char upper = (unsigned char)toupper(search_text[0]);
+  size_t idx = 0;
+# if defined SWO_SSE2 || defined SWO_NEON
+    /* scan 16 bytes at a time; the loads stay inside the string */
+#   if defined SWO_SSE2
+      const __m128i vlower = _mm_set1_epi8((char)lower);
+      const __m128i vupper = _mm_set1_epi8((char)upper);
+#     define SEARCH_BITS  1   /* bits per byte in the mask */
+#   else
+      const uint8x16_t vlower = vdupq_n_u8(lower);
+      const uint8x16_t vupper = vdupq_n_u8(upper);
+#     define SEARCH_BITS  4
+#   endif
+    for ( ; idx + 16 <= length && idx <= last; idx += 16) {
+#     if defined SWO_SSE2
+        __m128i block = _mm_loadu_si128((const __m128i*)(text + idx));
+        __m128i eq = _mm_or_si128(_mm_cmpeq_epi8(block, vlower), _mm_cmpeq_epi8(block, vupper));
+        unsigned long long mask = (unsigned)_mm_movemask_epi8(eq);
+#     else
+        uint8x16_t block = vld1q_u8((const uint8_t*)text + idx);
+        uint8x16_t eq = vorrq_u8(vceqq_u8(block, vlower), vceqq_u8(block, vupper));
+        /* narrow to 4 bits per byte, keep one bit of each nibble */
+        unsigned long long mask = vget_lane_u64(vreinterpret_u64_u8(vshrn_n_u16(vreinterpretq_u16_u8(eq), 4)), 0)
+                                  & 0x8888888888888888ULL;
+#     endif
+      for ( ; mask != 0; mask &= mask - 1) {
+        size_t pos = idx + SEARCH_CTZ(mask) / SEARCH_BITS;
+        if (pos > last)
+          return false;
+        if (memicmp((const unsigned char*)text + pos + 1, (const unsigned char*)search_text + 1, search_len - 1) == 0)
+          return true;
+      }
+    }
+# endif
+  for ( ; idx <= last; idx++) {
+    unsigned char c = (unsigned char)text[idx];
+    if ((c == lower || c == upper)
+        && memicmp((const unsigned char*)text + idx + 1, (const unsigned char*)search_text + 1, search_len - 1) == 0)
+      return true;
+  }
+  return false;
+}
+
+static void search_scan(SEARCHJOB *job)
+{
+  assert(job != NULL);
+  for (unsigned line = job->first; line < job->last; line++) {
+    const TRACESTRING *item = tracestring_get(line);
+    assert(item != NULL && item->text != NULL);
+    if (search_match(item->text, item->length)) {
+      if (job->count >= job->size) {
+        size_t newsize = (job->size == 0) ? 64 : 2 * job->size;
+        unsigned *list = realloc(job->hits, newsize * sizeof(unsigned));
+        if (list == NULL)
+          break;
+        job->hits = list;
+        job->size = newsize;
+      }
+      job->hits[job->count++] = tracestring_base + line;
+    }
+  }
+}
+
+#if defined WIN32 || defined _WIN32
+  static DWORD __stdcall search_thread(LPVOID arg)
+  {
+    search_scan((SEARCHJOB*)arg);
+    return 0;
+  }
+#else
+  static void *search_thread(void *arg)
+  {
+    search_scan((SEARCHJOB*)arg);
+    return 0;
+  }
+#endif
+
+static int search_cpucount(void)
+{
+# if defined WIN32 || defined _WIN32
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+    return (int)info.dwNumberOfProcessors;
+# else
+    long count = sysconf(_SC_NPROCESSORS_ONLN);
+    return (count > 0) ? (int)count : 1;
+# endif
+}
+
+/* search_run() scans a range of lines (in view), and appends the hits to the
+   list */
+static void search_run(unsigned first, unsigned last)
+{
+  assert(first <= last && last <= tracestring_lines);
+  int numjobs = (int)((last - first) / SEARCH_MINLINES);
+  int cpus = search_cpucount();
+  if (numjobs > cpus)
+    numjobs = cpus;
+  if (numjobs > SEARCH_MAXTHREADS)
+    numjobs = SEARCH_MAXTHREADS;
+  if (numjobs < 1)
+    numjobs = 1;
+
+  SEARCHJOB jobs[SEARCH_MAXTHREADS];
+# if defined WIN32 || defined _WIN32
+    HANDLE threads[SEARCH_MAXTHREADS];
+# else
+    pthread_t threads[SEARCH_MAXTHREADS];
+# endif
+  bool running[SEARCH_MAXTHREADS];
+  unsigned range = (last - first) / numjobs;
+  memset(jobs, 0, sizeof jobs);
+  for (int idx = 0; idx < numjobs; idx++) {
+    jobs[idx].first = first + idx * range;
+    jobs[idx].last = (idx == numjobs - 1) ? last : jobs[idx].first + range;
+  }
+  /* the first range is scanned on the calling thread; a range for which no
+     thread can be created, is scanned on the calling thread too */
+  for (int idx = 1; idx < numjobs; idx++) {
+#   if defined WIN32 || defined _WIN32
+      threads[idx] = CreateThread(NULL, 0, search_thread, &jobs[idx], 0, NULL);
+      running[idx] = (threads[idx] != NULL);
+#   else
+      running[idx] = (pthread_create(&threads[idx], NULL, search_thread, &jobs[idx]) == 0);
+#   endif
+  }
+  search_scan(&jobs[0]);
+  for (int idx = 1; idx < numjobs; idx++) {
+    if (running[idx]) {
+#     if defined WIN32 || defined _WIN32
+        WaitForSingleObject(threads[idx], INFINITE);
+        CloseHandle(threads[idx]);
+#     else
+        pthread_join(threads[idx], NULL);
+#     endif
+    } else {
+      search_scan(&jobs[idx]);
+    }
+  }
+
+  /* append the hits, in the order of the ranges */
+  size_t total = search_count;
+  for (int idx = 0; idx < numjobs; idx++)
+    total += jobs[idx].count;
+  if (total > search_size) {
+    unsigned *list = realloc(search_hits, total * sizeof(unsigned));
+    if (list != NULL) {
+      search_hits = list;
+      search_size = total;
+    }
+  }
+  for (int idx = 0; idx < numjobs; idx++) {
+    size_t count = jobs[idx].count;
+    if (search_count + count > search_size)
+      count = search_size - search_count;
+    if (count > 0)
+      memcpy(search_hits + search_count, jobs[idx].hits, count * sizeof(unsigned));
+    search_count += count;
+    if (jobs[idx].hits != NULL)
+      free((void*)jobs[idx].hits);
+  }
+}
+
+/* search_update() brings the list of hits up to date with the strings in
+   view; it returns false if the search text is invalid */
+static bool search_update(const char *text)
+{
+  assert(text != NULL);
+  size_t len = strlen(text);
+  if (len == 0 || len > TRACESTRING_MAXLENGTH)
+    return false;
+  if (search_generation != tracestring_generation || strcmp(text, search_text) != 0) {
+    strcpy(search_text, text);
+    search_len = len;
+    search_count = search_first = 0;
+    search_end = tracestring_base;
+    search_generation = tracestring_generation;
+  }
+
+  /* skip the hits on the lines that were evicted (and compact the list
+     when it pays off) */
+  while (search_first < search_count && (int)(search_hits[search_first] - tracestring_base) < 0)
+    search_first++;
+  if (search_first > 0 && search_first >= search_count / 2) {
+    memmove(search_hits, search_hits + search_first, (search_count - search_first) * sizeof(unsigned));
+    search_count -= search_first;
+    search_first = 0;
+  }
+
+  /* scan the new strings; the most recent string that was scanned is scanned
+     again, because text may have been appended to it */
+  unsigned end = tracestring_base + tracestring_lines;
+  if ((int)(search_end - tracestring_base) < 0)
+    search_end = tracestring_base;
+  if (search_end != end) {
+    unsigned start = search_end;
+    if (start != tracestring_base) {
+      start -= 1;
+      if (search_count > search_first && search_hits[search_count - 1] == start)
+        search_count -= 1;
+    }
+    search_run(start - tracestring_base, tracestring_lines);
+    search_end = end;
+  }
+  return true;
+}
+
+/** tracestring_find() finds the next line (in view) that contains the text
+ *  (case insensitive), after the current line. The search wraps around at
+ *  the end of the list.
+ *
+ *  \param text     The text to search.
+ *  \param curline  The line to start the search after, or -1 to start at the
+ *                  top.
+ *
+ *  
+eturn The line that contains the text, or -1 if the text is not found.
+ *          If the current line is the only line that contains the text, it
+ *          returns that line.
+ */
+int tracestring_find(const char *text, int curline)
+{
+  assert(curline >= 0 || curline == -1);
+  assert(text != NULL);
+  if (!search_update(text))
+    return -1;
+  size_t count = search_count - search_first;
+  if (count == 0)
+    return -1;
+
+  /* binary search for the first hit after the current line */
+  unsigned from = (curline >= 0) ? tracestring_base + curline + 1 : tracestring_base;
+  size_t low = search_first, high = search_count;
+  while (low < high) {
+    size_t mid = low + (high - low) / 2;
+    if ((int)(search_hits[mid] - from) < 0)
+      low = mid + 1;
+    else
+      high = mid;
+  }
+  /* skip hits on lines that were dropped by a channel limit */
+  for (size_t idx = 0; idx < count; idx++) {
+    size_t hit = low + idx;
+    if (hit >= search_count)
+      hit -= count;
+    int line = (int)(search_hits[hit] - tracestring_base);
+    if (!tracestring_ishidden(line))
+      return line;
+  }
+  return -1;  /* not found */
+}
+
+/** tracestring_findcount() returns the number of lines (in view) that
+ *  contain the text. It shares the list of hits with tracestring_find(), so
+ *  that a next call to tracestring_find() does not need to scan the lines
+ *  again.
+ */
+unsigned tracestring_findcount(const char *text)
+{
+  assert(text != NULL);
+  if (!search_update(text))
+    return 0;
+  unsigned count = 0;
+  for (size_t idx = search_first; idx < search_count; idx++)
+    if (!tracestring_ishidden((int)(search_hits[idx] - tracestring_base)))
+      count++;
+  return count;
+}
+
+/** tracestring_findtimestamp() finds the line closest to the given
+ *  timestamp. Note that it can return -1 when there are not strings in the
+ *  list.
+ */
+int tracestring_findtimestamp(double timestamp)
+{
+  /* binary search for the first line at or after the timestamp (timestamps
+     are in ascending order) */
+  unsigned low = 0, high = tracestring_lines;
+  while (low < high) {
+    unsigned mid = low + (high - low) / 2;
+    if (tracestring_get(mid)->timestamp < timestamp)
+      low = mid + 1;
+    else
+      high = mid;
+  }
+  return (int)low - 1;
+}
+
+/* For saving the strings in the background, the strings in view are copied
+   into a snapshot (a single pool for the text, plus an index), so that the
+   worker thread is independent of the decoder and of the eviction of
+   strings. */
+typedef struct tagEXPORTLINE {
+  double timestamp;
+  size_t offset;          /* offset of the text in the pool */
+  unsigned short length;
+  unsigned char channel;
+} EXPORTLINE;
+
+typedef struct tagTRACESNAPSHOT {
+  EXPORTLINE *lines;
+  char *pool;
+  char names[NUM_CHANNELS][CHANNEL_NAMELENGTH];
+} TRACESNAPSHOT;
+
+static const EXPORTCOLUMN tracestring_columns[] = {
+  { "Number",    EXPCOL_INT,    0 },
+  { "Name",      EXPCOL_STRING, 0 },
+  { "Timestamp", EXPCOL_REAL,   6 },
+  { "Text",      EXPCOL_STRING, 0 },
+};
+
+static bool tracestring_exportrow(void *context, unsigned long row, EXPORTVALUE *values)
+{
+  const TRACESNAPSHOT *snapshot = (const TRACESNAPSHOT*)context;
+  const EXPORTLINE *line = &snapshot->lines[row];
+  values[0].value.i = line->channel;
+  values[1].text = snapshot->names[line->channel];
+  values[1].length = strlen(values[1].text);
+  values[2].value.r = line->timestamp;
+  values[3].text = snapshot->pool + line->offset;
+  values[3].length = line->length;
+  return true;
+}
+
+static void tracestring_exportdone(void *context)
+{
+  TRACESNAPSHOT *snapshot = (TRACESNAPSHOT*)context;
+  free(snapshot->lines);
+  free(snapshot->pool);
+  free(snapshot);
+}
+
+/** tracestring_save() starts saving the strings that are in view, in the
+ *  background.
+ *
+ *  \param filename  The name of the output file.
+ *  \param format    EXPORT_CSV, EXPORT_TEXT or EXPORT_BINARY.
+ *
+ *  \return 1 if the export was started, 0 on failure (including when an
+ *          earlier export is still busy). The progress and the result are
+ *          retrieved with export_poll().
+ */
+int tracestring_save(const char *filename, int format)
+{
+  TRACESTRING *item;
+  unsigned count = 0;
+  size_t poolsize = 0;
+
+  for (unsigned line = 0; (item = tracestring_get(line)) != NULL; line++) {
+    if (!tracestring_ishidden(line)) {
+      count++;
+      poolsize += item->length;
+    }
+  }
+
+  TRACESNAPSHOT *snapshot = malloc(sizeof(TRACESNAPSHOT));
+  if (snapshot == NULL)
+    return 0;
+  snapshot->lines = malloc((count > 0 ? count : 1) * sizeof(EXPORTLINE));
+  snapshot->pool = malloc((poolsize > 0 ? poolsize : 1) * sizeof(char));
+  if (snapshot->lines == NULL || snapshot->pool == NULL) {
+    tracestring_exportdone(snapshot);
+    return 0;
+  }
+  for (int chan = 0; chan < NUM_CHANNELS; chan++)
+    strlcpy(snapshot->names[chan], channels[chan].name, CHANNEL_NAMELENGTH);
+  count = 0;
+  poolsize = 0;
+  for (unsigned line = 0; (item = tracestring_get(line)) != NULL; line++) {
+    if (tracestring_ishidden(line))
+      continue;
+    EXPORTLINE *entry = &snapshot->lines[count++];
+    entry->timestamp = item->timestamp;
+    entry->offset = poolsize;
+    entry->length = item->length;
+    entry->channel = item->channel;
+    memcpy(snapshot->pool + poolsize, item->text, item->length);
+    poolsize += item->length;
+  }
+
+  if (!export_start(filename, format, tracestring_columns, sizearray(tracestring_columns), count,
+                    tracestring_exportrow, tracestring_exportdone, snapshot))
+  {
+    tracestring_exportdone(snapshot);
+    return 0;
+  }
+  return 1;
+}
+
+/** tracestring_stream() writes the strings that were completed since the
+ *  previous call to a file, in the same format as tracestring_save() (but
+ *  without the header line). The strings that are written are dropped from
+ *  the list, so that memory use stays bounded on long captures.
+ *
+ *  \param fp      The output file.
+ *  \param flush   If true, the most recent string is written too, even if
+ *                  text might still be appended to it (text that arrives
+ *                  later then starts a new string).
+ *
+ *  \return The number of strings written.
+ */
+static int tracestring_writelines(FILE *fp, unsigned *streamed)
+{
+  int count = 0;
+  TRACESTRING *item;
+  assert(streamed != NULL);
+  while ((item = tracestring_get(*streamed - tracestring_base)) != NULL) {
+    if (item == tracestring_tail && (item->flags & 0x01) == 0)
+      break;    /* text may still be appended to the most recent string */
+    if (!tracestring_ishidden(*streamed - tracestring_base)) {
+      fprintf(fp, "%d,\"%s\",%.6f,\"%s\"\n", item->channel, channels[item->channel].name,
+              item->timestamp, item->text);
+      count++;
+    }
+    *streamed += 1;
+  }
+  return count;
+}
+
+int tracestring_stream(FILE *fp, bool flush)
+{
+  static unsigned streamed = 0;   /* record number of the next string to write */
+  static unsigned generation = 0;
+  assert(fp != NULL);
+  if (generation != tracestring_generation) {
+    generation = tracestring_generation;
+    streamed = tracestring_base;
+  }
+  if ((int)(streamed - tracestring_base) < 0)
+    streamed = tracestring_base;  /* strings were evicted before they were written */
+
+  if (flush) {
+    /* stop the decoder, so that the most recent string can be taken over */
+    decoder_stop();
+    if (tracestring_tail != NULL)
+      tracestring_tail->flags |= 0x01;
+    tracestring_publish(true);
+    tracestring_view();
+  }
+  int count = tracestring_writelines(fp, &streamed);
+
+  if (streamed - tracestring_base >= TRACESTRING_BLOCKRECS || (flush && streamed != tracestring_base)) {
+    /* evict the strings that were written; the decoder must be stopped for
+       this, and the strings that it completed in the mean time are written
+       first (the most recent string is kept, because the decoder may still
+       append to it) */
+    decoder_stop();
+    tracestring_view();
+    count += tracestring_writelines(fp, &streamed);
+    while (tracestring_first != streamed && tracestring_records - tracestring_first > 1)
+      tracestring_evict();
+    tracestring_publish(tracestring_tail == NULL || (tracestring_tail->flags & 0x01) != 0);
+    tracestring_view();
+    tracestring_recycle();
+  }
+  if (count > 0)
+    fflush(fp);
+  return count;
+}
+
+/** trace_setdatasize() sets the data size in an ITM packet, in bytes. Valid
+ *  values are 1, 2 and 4. For automatic detection, set "size" to 0.
+ */
+void trace_setdatasize(short size)
+{
+  assert(size == 0 || size == 1 || size == 2 || size == 4);
+  itm_datasize = (size == 0) ? 1 : size;
+  itm_datasz_auto = (size == 0);
+  itm_packet_errors = 0;
+}
+
+/** trace_getdatasize() returns the datasize currently set. */
+short trace_getdatasize(void)
+{
+  return itm_datasize;
+}
+
+int trace_getpacketerrors(bool reset)
+{
+  int result = itm_packet_errors;
+  if (reset)
+    itm_packet_errors = 0;
+  return result;
+}
+
+int trace_overflowerrors(bool reset)
+{
+  if (reset)
+    return QUEUE_EXCHANGE(tracequeue_overflow, 0);
+  return QUEUE_LOAD(tracequeue_overflow);
+}
+
+/** trace_getstats() returns the throughput and latency of the SWO pipeline.
+ *  The rates are averaged over intervals of (at least) one second, so this
+ *  function should be called regularly (for example, on every frame).
+ *
+ *  \param stats  The structure that is filled in.
+ *  \param reset  If true, the high-water mark of the queue and the maximum
+ *                latency are reset (after being returned).
+ */
+void trace_getstats(TRACESTATS *stats, bool reset)
+{
+  static TRACESTATS rates;  /* most recent interval */
+  static double prev_time = 0.0;
+  static unsigned prev_bytes, prev_packets, prev_decoded, prev_usec, prev_events;
+  static unsigned long long total_bytes = 0, total_packets = 0;
+
+  assert(stats != NULL);
+  unsigned bytes = QUEUE_LOAD(stat_bytes);
+  unsigned packets = QUEUE_LOAD(stat_packets);
+  double now = get_timestamp();
+  if (prev_time <= 0.0 || now - prev_time >= 1.0) {
+    unsigned decoded = QUEUE_LOAD(stat_decoded);
+    unsigned usec = QUEUE_LOAD(stat_decode_usec);
+    unsigned events = QUEUE_LOAD(stat_ctf_events);
+    if (prev_time > 0.0) {
+      double interval = now - prev_time;
+      rates.bytes_per_sec = (bytes - prev_bytes) / interval;
+      rates.packets_per_sec = (packets - prev_packets) / interval;
+      rates.ctf_events_per_sec = (events - prev_events) / interval;
+      rates.decode_usec = (decoded != prev_decoded) ? (double)(usec - prev_usec) / (decoded - prev_decoded) : 0.0;
+      total_bytes += bytes - prev_bytes;
+      total_packets += packets - prev_packets;
+    }
+    prev_time = now;
+    prev_bytes = bytes;
+    prev_packets = packets;
+    prev_decoded = decoded;
+    prev_usec = usec;
+    prev_events = events;
+  }
+  *stats = rates;
+  stats->bytes = total_bytes + (bytes - prev_bytes);
+  stats->packets = total_packets + (packets - prev_packets);
+  stats->queue_size = (trace_queue != NULL) ? tracequeue_mask + 1 : 0;
+  stats->queue_used = QUEUE_LOAD(tracequeue_tail) - QUEUE_LOAD(tracequeue_head);
+  stats->queue_highwater = reset ? QUEUE_EXCHANGE(stat_highwater, 0) : QUEUE_LOAD(stat_highwater);
+  stats->latency_msec = stat_latency / 1000.0;
+  stats->latency_max_msec = stat_latency_max / 1000.0;
+  if (reset)
+    stat_latency_max = 0;
+}
+
+/* The sample map is a paged histogram: the code range is divided into pages
+   of SAMPLEPAGE_SLOTS slots (one slot per ADDRESS_ALIGN bytes), and a page is
+   only allocated when the first sample falls into it. Memory therefore scales
+   with the code that is actually sampled, not with the address range (which
+   may span multiple Flash banks, or both Flash and RAM). Each page also holds
+   the function index of every slot, so that samples are attributed to
+   functions as they are decoded. */
+#define SAMPLEPAGE_SHIFT  8
+#define SAMPLEPAGE_SLOTS  (1 << SAMPLEPAGE_SHIFT)
+
+typedef struct tagSAMPLEPAGE {
+  unsigned count[SAMPLEPAGE_SLOTS];
+  unsigned func[SAMPLEPAGE_SLOTS];  /* index in func_counts */
+} SAMPLEPAGE;
+
+typedef struct tagSAMPLESLICE {
+  double start;                 /* time stamp of the start of the slice */
+  unsigned total;               /* total number of samples in the slice */
+  unsigned peak;                /* highest count of a single function */
+  unsigned numentries;
+  unsigned *entries;            /* pairs of function index & count (only non-zero counts) */
+} SAMPLESLICE;
+
+typedef struct tagSAMPLETASK {
+  uint32_t id;                  /* task ID, as reported by the task-switch hook */
+  unsigned total;               /* total number of samples of the task */
+  SAMPLEMAP *map;               /* samples of this task (same code range) */
+} SAMPLETASK;
+
+struct tagSAMPLEMAP {
+  uint32_t code_base, code_top;
+  unsigned numslots;
+  unsigned numpages;
+  SAMPLEPAGE **pages;           /* page table, NULL for pages without samples */
+  unsigned unknown;             /* samples outside the code range (or dropped) */
+  const uint32_t *func_ranges;  /* pairs of low & high addresses, sorted on address */
+  unsigned numfuncs;
+  unsigned *func_counts;        /* per function; the entry at "numfuncs" is for unknown samples */
+  /* time slices (a ring of per-interval function histograms) */
+  double slice_interval;        /* duration of a slice in seconds, 0 if not slicing */
+  double slice_origin;          /* time stamp of the start of the first slice */
+  double slice_start;           /* time stamp of the start of the current slice */
+  unsigned *slice_counts;       /* function counts for the current slice */
+  SAMPLESLICE *slices;          /* ring of completed slices */
+  unsigned slice_max;           /* size of the ring */
+  unsigned slice_head;          /* index of the oldest slice in the ring */
+  unsigned slice_count;         /* number of completed slices in the ring */
+  /* per-task histograms (for task switches reported on an ITM channel) */
+  int task_channel;             /* ITM channel for task switches, -1 if off */
+  SAMPLETASK *tasks;            /* table of tasks, in order of first appearance */
+  unsigned task_max;            /* size of the table */
+  unsigned task_count;          /* number of tasks in the table */
+  SAMPLETASK *task_current;     /* the running task, NULL if unknown */
+};
+
+/** samplemap_create() allocates a (sparse) sample map for a code range.
+ *
+ *  \param code_base    The lowest address of the code range.
+ *  \param code_top     The address just above the code range.
+ *
+ *  \return The sample map, or NULL on a memory allocation failure.
+ */
+SAMPLEMAP *samplemap_create(uint32_t code_base, uint32_t code_top)
+{
+  assert(code_top >= code_base);
+  SAMPLEMAP *map = malloc(sizeof(SAMPLEMAP));
+  if (map == NULL)
+    return NULL;
+  memset(map, 0, sizeof(SAMPLEMAP));
+  map->code_base = code_base;
+  map->code_top = code_top;
+  map->numslots = Address2Index(code_top, code_base);
+  map->numpages = (map->numslots + SAMPLEPAGE_SLOTS - 1) >> SAMPLEPAGE_SHIFT;
+  map->pages = malloc((map->numpages + 1) * sizeof(SAMPLEPAGE*));
+  if (map->pages == NULL) {
+    free(map);
+    return NULL;
+  }
+  memset(map->pages, 0, (map->numpages + 1) * sizeof(SAMPLEPAGE*));
+  map->task_channel = -1;
+  return map;
+}
+
+/** samplemap_delete() frees a sample map and all of its pages.
+ */
+void samplemap_delete(SAMPLEMAP *map)
+{
+  if (map != NULL) {
+    samplemap_setslices(map, 0.0, 0);
+    samplemap_settasks(map, -1, 0);
+    for (unsigned idx = 0; idx < map->numpages; idx++)
+      if (map->pages[idx] != NULL)
+        free(map->pages[idx]);
+    free(map->pages);
+    free(map);
+  }
+}
+
+/** samplemap_clear() resets all sample counts (including the per-function
+ *  counts). Only the pages that hold samples are cleared.
+ */
+void samplemap_clear(SAMPLEMAP *map)
+{
+  assert(map != NULL);
+  for (unsigned idx = 0; idx < map->numpages; idx++)
+    if (map->pages[idx] != NULL)
+      memset(map->pages[idx]->count, 0, sizeof(map->pages[idx]->count));
+  map->unknown = 0;
+  if (map->func_counts != NULL)
+    memset(map->func_counts, 0, (map->numfuncs + 1) * sizeof(unsigned));
+  /* the task table is kept (and so is the running task), only the counts of
+     the tasks are cleared */
+  for (unsigned idx = 0; idx < map->task_count; idx++) {
+    map->tasks[idx].total = 0;
+    samplemap_clear(map->tasks[idx].map);
+  }
+}
+
+static void samplepage_functions(const SAMPLEMAP *map, SAMPLEPAGE *page, unsigned pageidx)
+{
+  uint32_t addr = Index2Address(pageidx << SAMPLEPAGE_SHIFT, map->code_base);
+  const uint32_t *ranges = map->func_ranges;
+  unsigned numfuncs = map->numfuncs;
+  /* binary search for the first function that ends above the start of the page */
+  unsigned low = 0, high = numfuncs;
+  while (low < high) {
+    unsigned mid = low + (high - low) / 2;
+    if (ranges[2 * mid + 1] <= addr)
+      low = mid + 1;
+    else
+      high = mid;
+  }
+  unsigned func = low;
+  for (unsigned slot = 0; slot < SAMPLEPAGE_SLOTS; slot++, addr += ADDRESS_ALIGN) {
+    while (func < numfuncs && ranges[2 * func + 1] <= addr)
+      func++;
+    page->func[slot] = (func < numfuncs && ranges[2 * func] <= addr) ? func : numfuncs;
+  }
+}
+
+/* samplemap_taskfunctions() gives the sample map of a task the same function
+   ranges as the main sample map; the task map owns its array of function
+   counts */
+static void samplemap_taskfunctions(const SAMPLEMAP *map, SAMPLEMAP *task)
+{
+  unsigned *counts = task->func_counts;
+  samplemap_setfunctions(task, NULL, 0, NULL);
+  if (counts != NULL)
+    free(counts);
+  if (map->func_ranges != NULL && (counts = malloc((map->numfuncs + 1) * sizeof(unsigned))) != NULL)
+    samplemap_setfunctions(task, map->func_ranges, map->numfuncs, counts);
+}
+
+/** samplemap_setfunctions() sets the address ranges of the functions, so that
+ *  samples are attributed to functions while they are decoded.
+ *
+ *  \param map          The sample map.
+ *  \param ranges       An array with pairs of addresses (low and high limit)
+ *                      for each function, sorted on address. The array must
+ *                      remain valid while it is set in the sample map.
+ *  \param count        The number of functions (so the number of pairs).
+ *  \param func_counts  An array with count + 1 entries, for the sample counts
+ *                      per function; the last entry is for the samples outside
+ *                      any function. This array is cleared.
+ *
+ *  \note Parameters "ranges" and "func_counts" may be NULL, to stop attributing
+ *        samples to functions.
+ */
+void samplemap_setfunctions(SAMPLEMAP *map, const uint32_t *ranges, unsigned count, unsigned *func_counts)
+{
+  assert(map != NULL);
+  assert((ranges == NULL) == (func_counts == NULL));
+  map->func_ranges = ranges;
+  map->numfuncs = (ranges != NULL) ? count : 0;
+  map->func_counts = func_counts;
+  if (func_counts != NULL) {
+    memset(func_counts, 0, (count + 1) * sizeof(unsigned));
+    for (unsigned idx = 0; idx < map->numpages; idx++)
+      if (map->pages[idx] != NULL)
+        samplepage_functions(map, map->pages[idx], idx);
+  }
+  /* the time slices refer to function indices, so they are restarted */
+  if (map->slice_interval > 0.0)
+    samplemap_setslices(map, map->slice_interval, map->slice_max);
+  for (unsigned idx = 0; idx < map->task_count; idx++)
+    samplemap_taskfunctions(map, map->tasks[idx].map);
+}
+
+/** samplemap_setslices() starts (or stops) keeping a ring of time slices,
+ *  each with the histogram of the functions for the samples received in its
+ *  interval. The time stamps of the trace packets are used. Any existing time
+ *  slices are dropped.
+ *
+ *  \param map        The sample map.
+ *  \param interval   The duration of a slice in seconds; 0.0 to stop slicing.
+ *  \param count      The number of slices to keep; 0 to stop slicing.
+ *
+ *  \return true on success, false on a memory allocation failure.
+ *
+ *  \note Samples are attributed to functions only after the functions were
+ *        set with samplemap_setfunctions().
+ */
+bool samplemap_setslices(SAMPLEMAP *map, double interval, unsigned count)
+{
+  assert(map != NULL);
+  if (map->slices != NULL) {
+    for (unsigned idx = 0; idx < map->slice_max; idx++)
+      if (map->slices[idx].entries != NULL)
+        free(map->slices[idx].entries);
+    free(map->slices);
+    map->slices = NULL;
+  }
+  if (map->slice_counts != NULL) {
+    free(map->slice_counts);
+    map->slice_counts = NULL;
+  }
+  map->slice_interval = 0.0;
+  map->slice_origin = map->slice_start = 0.0;
+  map->slice_max = map->slice_head = map->slice_count = 0;
+  if (interval <= 0.0 || count == 0)
+    return true;
+
+  map->slices = malloc(count * sizeof(SAMPLESLICE));
+  map->slice_counts = malloc((map->numfuncs + 1) * sizeof(unsigned));
+  if (map->slices == NULL || map->slice_counts == NULL) {
+    if (map->slices != NULL) {
+      free(map->slices);
+      map->slices = NULL;
+    }
+    if (map->slice_counts != NULL) {
+      free(map->slice_counts);
+      map->slice_counts = NULL;
+    }
+    return false;
+  }
+  memset(map->slices, 0, count * sizeof(SAMPLESLICE));
+  memset(map->slice_counts, 0, (map->numfuncs + 1) * sizeof(unsigned));
+  map->slice_interval = interval;
+  map->slice_max = count;
+  return true;
+}
+
+/* samplemap_closeslice() moves the counts of the current slice into the ring;
+   slices without samples are not stored */
+static void samplemap_closeslice(SAMPLEMAP *map)
+{
+  assert(map != NULL && map->slices != NULL && map->slice_counts != NULL);
+  unsigned numentries = 0, total = 0, peak = 0;
+  for (unsigned idx = 0; idx <= map->numfuncs; idx++) {
+    if (map->slice_counts[idx] != 0) {
+      numentries++;
+      total += map->slice_counts[idx];
+      if (idx < map->numfuncs && map->slice_counts[idx] > peak)
+        peak = map->slice_counts[idx];
+    }
+  }
+  if (numentries == 0)
+    return;
+  SAMPLESLICE *slice;
+  if (map->slice_count < map->slice_max) {
+    slice = &map->slices[(map->slice_head + map->slice_count) % map->slice_max];
+    map->slice_count++;
+  } else {
+    slice = &map->slices[map->slice_head];   /* overwrite the oldest slice */
+    map->slice_head = (map->slice_head + 1) % map->slice_max;
+  }
+  if (slice->entries != NULL)
+    free(slice->entries);
+  slice->start = map->slice_start;
+  slice->total = total;
+  slice->peak = peak;
+  slice->numentries = 0;
+  slice->entries = malloc(2 * numentries * sizeof(unsigned));
+  if (slice->entries != NULL) {
+    for (unsigned idx = 0; idx <= map->numfuncs; idx++) {
+      if (map->slice_counts[idx] != 0) {
+        slice->entries[2 * slice->numentries] = idx;
+        slice->entries[2 * slice->numentries + 1] = map->slice_counts[idx];
+        slice->numentries++;
+      }
+    }
+  }
+  memset(map->slice_counts, 0, (map->numfuncs + 1) * sizeof(unsigned));
+}
+
+/* samplemap_settime() is called with the time stamp of each trace packet; it
+   closes the current slice when the time stamp is past its interval */
+static void samplemap_settime(SAMPLEMAP *map, double timestamp)
+{
+  if (map->slice_interval <= 0.0)
+    return;
+  if (map->slice_origin <= 0.0) {
+    map->slice_origin = map->slice_start = timestamp;
+  } else if (timestamp >= map->slice_start + map->slice_interval) {
+    samplemap_closeslice(map);
+    /* skip over intervals without any packets */
+    double skip = (timestamp - map->slice_start) / map->slice_interval;
+    map->slice_start += (unsigned long)skip * map->slice_interval;
+  }
+}
+
+/** samplemap_slices() returns the number of time slices that are available.
+ */
+unsigned samplemap_slices(const SAMPLEMAP *map)
+{
+  assert(map != NULL);
+  return map->slice_count;
+}
+
+/** samplemap_sliceinfo() returns information on a time slice.
+ *
+ *  \param map      The sample map.
+ *  \param index    The slice index, where 0 is the oldest slice.
+ *  \param start    [out] The start time of the slice, in seconds since the
+ *                  start of the first slice. This parameter may be NULL.
+ *  \param total    [out] The number of samples in the slice. This parameter
+ *                  may be NULL.
+ *  \param peak     [out] The highest number of samples of a single function
+ *                  in the slice. This parameter may be NULL.
+ *
+ *  \return true on success, false if the index is out of range.
+ */
+bool samplemap_sliceinfo(const SAMPLEMAP *map, unsigned index, double *start, unsigned *total, unsigned *peak)
+{
+  assert(map != NULL);
+  if (index >= map->slice_count)
+    return false;
+  const SAMPLESLICE *slice = &map->slices[(map->slice_head + index) % map->slice_max];
+  if (start != NULL)
+    *start = slice->start - map->slice_origin;
+  if (total != NULL)
+    *total = slice->total;
+  if (peak != NULL)
+    *peak = slice->peak;
+  return true;
+}
+
+/** samplemap_slicecounts() returns the function counts of a time slice.
+ *
+ *  \param map          The sample map.
+ *  \param index        The slice index, where 0 is the oldest slice.
+ *  \param func_counts  [out] An array that is filled with the sample counts
+ *                      for each function, in the same layout as the array
+ *                      passed to samplemap_setfunctions().
+ *
+ *  \return true on success, false if the index is out of range.
+ */
+bool samplemap_slicecounts(const SAMPLEMAP *map, unsigned index, unsigned *func_counts)
+{
+  assert(map != NULL && func_counts != NULL);
+  if (index >= map->slice_count)
+    return false;
+  const SAMPLESLICE *slice = &map->slices[(map->slice_head + index) % map->slice_max];
+  memset(func_counts, 0, (map->numfuncs + 1) * sizeof(unsigned));
+  for (unsigned idx = 0; idx < slice->numentries; idx++)
+    func_counts[slice->entries[2 * idx]] = slice->entries[2 * idx + 1];
+  return true;
+}
+
+/** samplemap_settasks() starts (or stops) keeping a histogram per task. The
+ *  firmware reports each task switch by writing the ID of the task that is
+ *  switched in to an ITM stimulus port; the PC samples that follow are added
+ *  to the histogram of that task (as well as to the main histogram). Any
+ *  existing per-task histograms are dropped.
+ *
+ *  \param map        The sample map.
+ *  \param channel    The ITM channel (0..31) for the task switches; -1 to stop
+ *                    keeping per-task histograms.
+ *  \param maxtasks   The maximum number of tasks; samples of the tasks that
+ *                    appear after the table is full are only added to the
+ *                    main histogram.
+ *
+ *  \return true on success, false on a memory allocation failure.
+ */
+bool samplemap_settasks(SAMPLEMAP *map, int channel, unsigned maxtasks)
+{
+  assert(map != NULL);
+  assert(channel < 32);
+  if (map->tasks != NULL) {
+    for (unsigned idx = 0; idx < map->task_count; idx++) {
+      SAMPLEMAP *task = map->tasks[idx].map;
+      if (task->func_counts != NULL)
+        free(task->func_counts);
+      samplemap_delete(task);
+    }
+    free(map->tasks);
+    map->tasks = NULL;
+  }
+  map->task_channel = -1;
+  map->task_max = map->task_count = 0;
+  map->task_current = NULL;
+  if (channel < 0 || maxtasks == 0)
+    return true;
+
+  map->tasks = malloc(maxtasks * sizeof(SAMPLETASK));
+  if (map->tasks == NULL)
+    return false;
+  map->task_channel = channel;
+  map->task_max = maxtasks;
+  return true;
+}
+
+/* samplemap_switchtask() is called on a task-switch packet; it looks up the
+   task (or adds it to the table) and makes it the running task */
+static void samplemap_switchtask(SAMPLEMAP *map, uint32_t id)
+{
+  assert(map != NULL && map->tasks != NULL);
+  for (unsigned idx = 0; idx < map->task_count; idx++) {
+    if (map->tasks[idx].id == id) {
+      map->task_current = &map->tasks[idx];
+      return;
+    }
+  }
+  map->task_current = NULL;
+  if (map->task_count >= map->task_max)
+    return;   /* table is full, samples of this task are not tracked */
+  SAMPLEMAP *task = samplemap_create(map->code_base, map->code_top);
+  if (task == NULL)
+    return;
+  samplemap_taskfunctions(map, task);
+  map->task_current = &map->tasks[map->task_count++];
+  map->task_current->id = id;
+  map->task_current->total = 0;
+  map->task_current->map = task;
+}
+
+/** samplemap_tasks() returns the number of tasks that were seen.
+ */
+unsigned samplemap_tasks(const SAMPLEMAP *map)
+{
+  assert(map != NULL);
+  return map->task_count;
+}
+
+/** samplemap_taskinfo() returns information on a task.
+ *
+ *  \param map      The sample map.
+ *  \param index    The task index, where 0 is the task that was seen first.
+ *  \param id       [out] The task ID. This parameter may be NULL.
+ *  \param total    [out] The number of samples of the task. This parameter
+ *                  may be NULL.
+ *
+ *  \return true on success, false if the index is out of range.
+ */
+bool samplemap_taskinfo(const SAMPLEMAP *map, unsigned index, uint32_t *id, unsigned *total)
+{
+  assert(map != NULL);
+  if (index >= map->task_count)
+    return false;
+  const SAMPLETASK *task = &map->tasks[index];
+  if (id != NULL)
+    *id = task->id;
+  if (total != NULL)
+    *total = task->total;
+  return true;
+}
+
+/** samplemap_taskcounts() returns the function counts of a task.
+ *
+ *  \param map          The sample map.
+ *  \param index        The task index, where 0 is the task that was seen
+ *                      first.
+ *  \param func_counts  [out] An array that is filled with the sample counts
+ *                      for each function, in the same layout as the array
+ *                      passed to samplemap_setfunctions().
+ *
+ *  \return true on success, false if the index is out of range (or if no
+ *          functions were set).
+ */
+bool samplemap_taskcounts(const SAMPLEMAP *map, unsigned index, unsigned *func_counts)
+{
+  assert(map != NULL && func_counts != NULL);
+  if (index >= map->task_count || map->tasks[index].map->func_counts == NULL)
+    return false;
+  memcpy(func_counts, map->tasks[index].map->func_counts, (map->numfuncs + 1) * sizeof(unsigned));
+  return true;
+}
+
+/** samplemap_next() finds the next address with samples.
+ *
+ *  \param map      The sample map.
+ *  \param address  [in/out] The address to start searching at, on output the
+ *                  address of the next slot with samples.
+ *  \param count    [out] The number of samples at that address.
+ *
+ *  \return true if a slot with samples was found, false at the end of the map.
+ */
+bool samplemap_next(const SAMPLEMAP *map, uint32_t *address, unsigned *count)
+{
+  assert(map != NULL && address != NULL && count != NULL);
+  if (*address < map->code_base)
+    *address = map->code_base;
+  if (*address >= map->code_top)
+    return false;
+  for (unsigned slot = Address2Index(*address, map->code_base); slot < map->numslots; ) {
+    const SAMPLEPAGE *page = map->pages[slot >> SAMPLEPAGE_SHIFT];
+    if (page == NULL) {
+      slot = (slot | (SAMPLEPAGE_SLOTS - 1)) + 1; /* skip to the next page */
+      continue;
+    }
+    for ( ; slot < map->numslots; slot++) {
+      if (page->count[slot & (SAMPLEPAGE_SLOTS - 1)] != 0) {
+        *address = Index2Address(slot, map->code_base);
+        *count = page->count[slot & (SAMPLEPAGE_SLOTS - 1)];
+        return true;
+      }
+      if ((slot & (SAMPLEPAGE_SLOTS - 1)) == SAMPLEPAGE_SLOTS - 1) {
+        slot++;
+        break;
+      }
+    }
+  }
+  return false;
+}
+
+/** samplemap_unknown() returns the number of samples that fall outside the
+ *  code range.
+ */
+unsigned samplemap_unknown(const SAMPLEMAP *map)
+{
+  assert(map != NULL);
+  return map->unknown;
+}
+
+static SAMPLEPAGE *samplemap_newpage(SAMPLEMAP *map, unsigned pageidx)
+{
+  assert(pageidx < map->numpages && map->pages[pageidx] == NULL);
+  SAMPLEPAGE *page = malloc(sizeof(SAMPLEPAGE));
+  if (page != NULL) {
+    memset(page->count, 0, sizeof(page->count));
+    if (map->func_ranges != NULL)
+      samplepage_functions(map, page, pageidx);
+    map->pages[pageidx] = page;
+  }
+  return page;
+}
+
+static void samplemap_addslot(SAMPLEMAP *map, unsigned slot)
+{
+  SAMPLEPAGE *page = NULL;
+  if (slot < map->numslots && (page = map->pages[slot >> SAMPLEPAGE_SHIFT]) == NULL)
+    page = samplemap_newpage(map, slot >> SAMPLEPAGE_SHIFT);
+  if (page != NULL) {
+    unsigned idx = slot & (SAMPLEPAGE_SLOTS - 1);
+    page->count[idx] += 1;
+    if (map->func_counts != NULL)
+      map->func_counts[page->func[idx]] += 1;
+    if (map->slice_counts != NULL)
+      map->slice_counts[(map->func_counts != NULL) ? page->func[idx] : map->numfuncs] += 1;
+  } else {
+    map->unknown += 1;  /* out of range, or page allocation failure */
+    if (map->func_counts != NULL)
+      map->func_counts[map->numfuncs] += 1;
+    if (map->slice_counts != NULL)
+      map->slice_counts[map->numfuncs] += 1;
+  }
+  if (map->task_current != NULL) {
+    map->task_current->total += 1;
+    samplemap_addslot(map->task_current->map, slot);
+  }
+}
+
+static void addsample(uint32_t pc, SAMPLEMAP *map)
+{
+  assert(map != NULL);
+  if (pc < map->code_base || pc >= map->code_top)
+    pc = map->code_top;
+  samplemap_addslot(map, Address2Index(pc, map->code_base));
+}
+
+/** addsamples() handles a run of PC sample packets, in groups of four
+ *  packets. It stops at the first group that is not complete or that is not
+ *  made up of PC samples only (the remainder is handled by the generic packet
+ *  decoder). It returns the number of samples handled; the samples are
+ *  histogrammed in the same way as addsample().
+ */
+static unsigned addsamples(const unsigned char *data, size_t length, SAMPLEMAP *map)
+{
+# define SAMPLE_GROUP 4
+# define SAMPLE_BYTES 5
+  unsigned count = 0;
+  assert(data != NULL);
+  assert(map != NULL);
+  uint32_t code_base = map->code_base;
+  uint32_t code_top = map->code_top;
+  assert(code_top >= code_base);
+  while (length >= SAMPLE_GROUP * SAMPLE_BYTES
+         && data[0] == 0x17 && data[5] == 0x17 && data[10] == 0x17 && data[15] == 0x17)
+  {
+    uint32_t pc[SAMPLE_GROUP];
+    for (int i = 0; i < SAMPLE_GROUP; i++)
+      memcpy(&pc[i], data + i * SAMPLE_BYTES + 1, 4);
+#   if defined SWO_SSE2 && ADDRESS_ALIGN == 2
+      /* SSE2 has no unsigned compare: flip the sign bit on both operands */
+      const __m128i bias = _mm_set1_epi32((int)0x80000000);
+      const __m128i span = _mm_set1_epi32((int)(code_top - code_base));
+      __m128i offs = _mm_sub_epi32(_mm_loadu_si128((const __m128i*)pc), _mm_set1_epi32((int)code_base));
+      __m128i inrange = _mm_cmplt_epi32(_mm_xor_si128(offs, bias), _mm_xor_si128(span, bias));
+      offs = _mm_or_si128(_mm_and_si128(inrange, offs), _mm_andnot_si128(inrange, span));
+      _mm_storeu_si128((__m128i*)pc, _mm_srli_epi32(offs, 1));
+#   elif defined SWO_NEON && ADDRESS_ALIGN == 2
+      const uint32x4_t span = vdupq_n_u32(code_top - code_base);
+      uint32x4_t offs = vsubq_u32(vld1q_u32(pc), vdupq_n_u32(code_base));
+      offs = vbslq_u32(vcltq_u32(offs, span), offs, span);
+      vst1q_u32(pc, vshrq_n_u32(offs, 1));
+#   else
+      for (int i = 0; i < SAMPLE_GROUP; i++) {
+        if (pc[i] < code_base || pc[i] >= code_top)
+          pc[i] = code_top;
+        pc[i] = Address2Index(pc[i], code_base);
+      }
+#   endif
+    for (int i = 0; i < SAMPLE_GROUP; i++)
+      samplemap_addslot(map, pc[i]);
+    data += SAMPLE_GROUP * SAMPLE_BYTES;
+    length -= SAMPLE_GROUP * SAMPLE_BYTES;
+    count += SAMPLE_GROUP;
+  }
+  return count;
+# undef SAMPLE_GROUP
+# undef SAMPLE_BYTES
+}
+
+/* itm_packetsize() returns the size of an ITM or DWT packet, including the
+   header; an unsupported packet is assumed to have 4 data bytes */
+static unsigned itm_packetsize(unsigned char header)
+{
+  if (ITM_HWSOURCE(header))
+    return ITM_HWLENGTH(header) + 1;
+  if (ITM_VALIDHDR(header))
+    return ITM_LENGTH(header) + 1;
+  return 5;
+}
+
+/* itm_taskswitch() checks whether a (complete) packet is a task switch, and
+   if so, switches the running task of the sample map */
+static inline void itm_taskswitch(const unsigned char *data, SAMPLEMAP *map)
+{
+  if (ITM_VALIDHDR(data[0]) && (int)ITM_CHANNEL(data[0]) == map->task_channel) {
+    uint32_t id = 0;
+    for (unsigned idx = ITM_LENGTH(data[0]); idx > 0; idx--)
+      id = (id << 8) | data[idx];   /* payload is Little Endian */
+    samplemap_switchtask(map, id);
+  }
+}
+
+int traceprofile_process(bool enabled, SAMPLEMAP *sample_map, unsigned *overflow)
+{
+  const PACKET *packets;
+  unsigned numpackets, pktidx;
+  int count = 0;
+  int overflow_count = 0;
+  QUEUE_STORE(capture_filtering, 0);  /* the task channel may not be "enabled" */
+  while ((numpackets = tracequeue_peek(&packets)) > 0) {
+    for (pktidx = 0; enabled && sample_map != NULL && pktidx < numpackets; pktidx++) {
+      const unsigned char *pktdata = packets[pktidx].data;
+      size_t pktlen = packets[pktidx].length;
+      if (pktlen == 0)
+        continue;   /* failed or cancelled transfer */
+      samplemap_settime(sample_map, packets[pktidx].timestamp);
+
+      /* first handle cached data (that crosses USB packets) */
+      if (itm_cachefilled > 0) {
+        unsigned char buffer[5];
+        memcpy(buffer, itm_cache, itm_cachefilled);
+        size_t needed = itm_packetsize(itm_cache[0]);
+        assert(itm_cachefilled < needed);
+        needed -= itm_cachefilled;
+        if (needed > pktlen) {
+          /* cached data plus new data block *still* do not make a complete packet */
+          memcpy(itm_cache + itm_cachefilled, pktdata, pktlen);
+          itm_cachefilled += pktlen;
+          pktlen = 0; /* avoid dropping into the "while" below */
+        } else {
+          memcpy(buffer + itm_cachefilled, pktdata, needed);
+          pktdata += needed;
+          pktlen -= needed;
+          /* handling the packet is simpler now, because we know that we have
+             a full packet (plus: we don't care about unsupported packets,
+             because we can simply drop the cache, and we don't handle the
+             overflow packet because it is only one byte, so it can never
+             overflow */
+          if (buffer[0] == 0x17) {
+            uint32_t pc;
+            memcpy(&pc, buffer + 1, 4);
+            addsample(pc, sample_map);
+            count += 1;
+          } else if (DWT_DATAVALUE(buffer[0])) {
+            datawatch_add(buffer, packets[pktidx].timestamp);
+          } else if (sample_map->task_channel >= 0) {
+            itm_taskswitch(buffer, sample_map);
+          }
+          itm_cachefilled = 0;
+        }
+      }
+
+      while (pktlen > 0) {
+        if (*pktdata == 0x17) {
+          /* PC sample packet; in the common case, a run of PC samples follows */
+          unsigned run = addsamples(pktdata, pktlen, sample_map);
+          if (run > 0) {
+            pktlen -= 5 * run;
+            pktdata += 5 * run;
+            count += run;
+          } else if (pktlen >= 5) {
+            uint32_t pc;
+            memcpy(&pc, pktdata + 1, 4);
+            addsample(pc, sample_map);
+            pktlen -= 5;
+            pktdata += 5;
+            count += 1;
+          } else {
+            memcpy(itm_cache, pktdata, pktlen);
+            itm_cachefilled = pktlen;
+            pktlen = 0;
+          }
+        } else if (*pktdata == 0x70) {
+          /* overflow packet */
+          pktlen -= 1;
+          pktdata += 1;
+          overflow_count += 1;
+        } else {
+          /* data trace packet, or unknown/unsupported packet */
+          unsigned len = itm_packetsize(*pktdata);
+          if (pktlen >= len) {
+            if (DWT_DATAVALUE(*pktdata))
+              datawatch_add(pktdata, packets[pktidx].timestamp);
+            else if (sample_map->task_channel >= 0)
+              itm_taskswitch(pktdata, sample_map);
+            pktlen -= len;
+            pktdata += len;
+          } else {
+            memcpy(itm_cache, pktdata, pktlen);
+            itm_cachefilled = pktlen;
+            pktlen = 0;
+          }
+        }
+      }
+    }
+    tracequeue_release(numpackets);
+  }
+
+  if (overflow != NULL)
+    *overflow = overflow_count;
+  return count;
+}
+
+/** get_timestamp() returns a precision timestamp; the returned value is in
+ *  seconds. It is the shared monotonic time base (see perf_timestamp()), so
+ *  that SWO packets, serial data and RSP traffic that are stamped when they
+ *  are read from the OS can be put on a single timeline.
+ */
+double get_timestamp(void)
+{
+  return perf_timestamp() / 1000000000.0;
+}
+
+#if defined WIN32 || defined _WIN32
+
+static unsigned long win_errno = 0;
+static int loc_errno = 0;
+static HANDLE hThread = NULL;
+static HANDLE hUSBdev = INVALID_HANDLE_VALUE;
+static USB_INTERFACE_HANDLE hUSBiface = INVALID_HANDLE_VALUE;
+static KLST_DEVINFO *usbk_Device = NULL;
+static unsigned char usbTraceEP = BMP_EP_TRACE;
+
+
+static BOOL MakeGUID(const char *label, GUID *guid)
+{
+  unsigned i;
+  char b[5];
+
+  /* check whether the string has a valid format &*/
+  if (strlen(label) != 38)
+    return FALSE;
+  for (i=0; i<strlen(label); i++) {
+    char c = label[i];
+    if (i == 0) {
+      if (c != '{')
+        return FALSE;
+    } else if (i == 37) {
+      if (c != '}')
+        return FALSE;
+    } else if (i == 9 || i == 14 || i == 19 || i == 24) {
+      if (c != '-')
+        return FALSE;
+    } else {
+      if (!(c >= '0' && c <= '9') && !(c >= 'A' && c <= 'F') && !(c >= 'a' && c <= 'f'))
+        return FALSE;
+    }
+  }
+
+  guid->Data1 = strtoul(label+1, NULL, 16);
+  guid->Data2 = (unsigned short)strtoul(label+10, NULL, 16);
+  guid->Data3 = (unsigned short)strtoul(label+15, NULL, 16);
+  memset(b, 0, sizeof b);
+  for (i = 0; i < 2; i++) {
+    memcpy(&b[0], label+20+i*2, 2*sizeof(b[0]));
+    guid->Data4[i] = (unsigned char)strtoul(&b[0], NULL, 16);
+  }
+  for (i = 0; i < 6; i++) {
+    memcpy(&b[0], label+25+i*2, 2*sizeof(b[0]));
+    guid->Data4[2+i] = (unsigned char)strtoul(&b[0], NULL, 16);
+  }
+
+  return TRUE;
+}
+
+static BOOL usb_GetDevicePath(const TCHAR *guid, TCHAR *path, size_t pathsize)
+{
+  GUID ClsId;
+  HDEVINFO hDevInfo;
+  DWORD dwSize;
+  BOOL result = FALSE;
+
+  /* convert the string to a GUID */
+  MakeGUID(guid, &ClsId);
+
+  /* get the device information set for all USB devices that have a device
+     interface and are currently present on the system (plugged in). */
+  hDevInfo = SetupDiGetClassDevs(&ClsId, NULL, 0, DIGCF_DEVICEINTERFACE | DIGCF_PRESENT);
+  if (hDevInfo != INVALID_HANDLE_VALUE) {
+    SP_DEVICE_INTERFACE_DATA DevIntfData;
+    /* keep calling SetupDiEnumDeviceInterfaces(..) until it fails with code
+       ERROR_NO_MORE_ITEMS (with call the dwMemberIdx value needs to be
+       incremented to retrieve the next device interface information */
+    DevIntfData.cbSize = sizeof(SP_DEVICE_INTERFACE_DATA);
+    loc_errno = 1;
+    result = SetupDiEnumDeviceInterfaces(hDevInfo, NULL, &ClsId, 0, &DevIntfData);
+
+    if (result) {
+      SP_DEVINFO_DATA DevData;
+      PSP_DEVICE_INTERFACE_DETAIL_DATA DevIntfDetailData;
+      /* get more details for each of the interfaces, including the device path
+         (which contains the device's VID/PID */
+      DevData.cbSize = sizeof(DevData);
+
+      /* get the required buffer size, then allocate the memory for it and
+         initialize the cbSize field */
+      SetupDiGetDeviceInterfaceDetail(hDevInfo, &DevIntfData, NULL, 0,&dwSize, NULL);
+      DevIntfDetailData = HeapAlloc(GetProcessHeap(), HEAP_ZERO_MEMORY, dwSize);
+#     if defined _UNICODE
+        DevIntfDetailData->cbSize = sizeof(SP_INTERFACE_DEVICE_DETAIL_DATA);
+#     elif defined _WIN64
+        DevIntfDetailData->cbSize = 8; // sizeof(SP_INTERFACE_DEVICE_DETAIL_DATA);
+#     else
+        DevIntfDetailData->cbSize = 5; // sizeof(SP_INTERFACE_DEVICE_DETAIL_DATA);
+#     endif
+
+      loc_errno = 2;
+      if (SetupDiGetDeviceInterfaceDetail(hDevInfo, &DevIntfData, DevIntfDetailData, dwSize, &dwSize, &DevData)) {
+        assert(path!=NULL);
+        assert(pathsize>0);
+#       if defined _UNICODE
+          memset(path, 0, pathsize*sizeof(TCHAR));
+          _tcsncpy(path, (TCHAR*)DevIntfDetailData->DevicePath, pathsize-1);
+#       else
+          strlcpy(path, DevIntfDetailData->DevicePath, pathsize);
+#       endif
+      } else {
+        result = FALSE;
+      }
+
+      HeapFree(GetProcessHeap(), 0, DevIntfDetailData);
+    }
+
+    SetupDiDestroyDeviceInfoList(hDevInfo);
+  }
+
+  if (!result)
+    win_errno = GetLastError();
+  return result;
+}
+
+static BOOL __stdcall USBK_Enumerate(KLST_HANDLE DeviceList, KLST_DEVINFO *DeviceInfo, PVOID Context)
+{
+  (void)DeviceList;
+  assert(DeviceInfo != NULL);
+  assert(Context != NULL);
+  if (DeviceInfo->DevicePath != NULL && stricmp(DeviceInfo->DevicePath, (TCHAR*)Context) == 0) {
+    usbk_Device = DeviceInfo;
+    return FALSE; /* no need to look further */
+  }
+  return TRUE;
+}
+
+static BOOL usb_OpenDevice(const TCHAR *path, HANDLE *hdevUSB, USB_INTERFACE_HANDLE *hifaceUSB)
+{
+  BOOL result = FALSE;
+
+  assert(hdevUSB != NULL);
+  assert(hifaceUSB != NULL);
+  *hdevUSB = *hifaceUSB = INVALID_HANDLE_VALUE;  /* preset, in case initialization fails */
+
+  /* try WinUSB first */
+  if (WinUsb_Load()) {
+    loc_errno = 3;
+    *hdevUSB = CreateFile(path, GENERIC_WRITE | GENERIC_READ,
+                          FILE_SHARE_WRITE | FILE_SHARE_READ,
+                          NULL, OPEN_EXISTING,
+                          FILE_ATTRIBUTE_NORMAL | FILE_FLAG_OVERLAPPED, NULL);
+    if (*hdevUSB != INVALID_HANDLE_VALUE) {
+      assert(WinUsb_IsActive());
+      loc_errno = 4;
+      result = _WinUsb_Initialize(*hdevUSB, hifaceUSB);
+      if (!result) {
+        win_errno = GetLastError();
+        CloseHandle(*hdevUSB);
+        WinUsb_Unload();
+        *hdevUSB = *hifaceUSB = INVALID_HANDLE_VALUE;
+      }
+    } else {
+      win_errno = GetLastError();
+    }
+  }
+
+  /* try libusbK next */
+  if (!result && UsbK_Load()) {
+    KLST_DEVINFO *DeviceList;
+    uint32_t count;
+    loc_errno = 5;
+    if (_LstK_Init(&DeviceList, 0) && _LstK_Count(DeviceList, &count) && count > 0) {
+      usbk_Device = NULL;
+      _LstK_Enumerate(DeviceList, USBK_Enumerate, (void*)path);
+      if (usbk_Device != NULL) {
+        *hdevUSB = usbk_Device;
+        loc_errno = 6;
+        result = _UsbK_Init(hifaceUSB, usbk_Device);
+        if (!result) {
+          win_errno = GetLastError();
+          _LstK_Free(DeviceList);
+          UsbK_Unload();
+          *hdevUSB = *hifaceUSB = INVALID_HANDLE_VALUE;
+        }
+      }
+      _LstK_Free(DeviceList);
+    }
+  }
+
+  return result;
+}
+
+/* endpoint: use 0x85 for input endpoint #5
+ */
+static BOOL usb_ConfigEndpoint(USB_INTERFACE_HANDLE hUSB, unsigned char endpoint)
+{
+  BOOL result;
+  USB_INTERFACE_DESCRIPTOR ifaceDescriptor;
+
+  assert(hUSB != INVALID_HANDLE_VALUE);
+  usbTraceEP = endpoint;
+
+  if (WinUsb_IsActive()) {
+    loc_errno = 7;
+    if (_WinUsb_QueryInterfaceSettings(hUSB, 0, &ifaceDescriptor)) {
+      USB_PIPE_INFORMATION pipeInfo;
+      int idx;
+      for (idx=0; idx<ifaceDescriptor.bNumEndpoints; idx++) {
+        memset(&pipeInfo, 0, sizeof(pipeInfo));
+        loc_errno = 8;
+        result = _WinUsb_QueryPipe(hUSB, 0, (unsigned char)idx, &pipeInfo);
+        if (result && pipeInfo.PipeId == endpoint)
+          return TRUE;
+      }
+    }
+  } else if (UsbK_IsActive()) {
+    loc_errno = 9;
+    if (_UsbK_QueryInterfaceSettings(hUSB, 0, &ifaceDescriptor)) {
+      USB_PIPE_INFORMATION pipeInfo;
+      int idx;
+      for (idx=0; idx<ifaceDescriptor.bNumEndpoints; idx++) {
+        memset(&pipeInfo, 0, sizeof(pipeInfo));
+        loc_errno = 10;
+        result = _UsbK_QueryPipe(hUSB, 0, (unsigned char)idx, &pipeInfo);
+        if (result && pipeInfo.PipeId == endpoint)
+          return TRUE;
+      }
+    }
+  }
+
+  win_errno = GetLastError();
+  return FALSE;
+}
+
+typedef BOOL (__stdcall *READPIPE)(USB_INTERFACE_HANDLE InterfaceHandle, uint8_t PipeID, uint8_t *Buffer, uint32_t BufferLength, uint32_t *LengthTransferred, LPOVERLAPPED Overlapped);
+typedef BOOL (__stdcall *OVERLAPPEDRESULT)(USB_INTERFACE_HANDLE InterfaceHandle, LPOVERLAPPED Overlapped, uint32_t *LengthTransferred, BOOL Wait);
+
+/* the structures for the overlapped reads must stay valid until the pipe is
+   aborted in trace_close(), which is after the thread has been terminated */
+static OVERLAPPED trace_ovl[TRACE_TRANSFERS];
+static PACKET trace_scratch[TRACE_TRANSFERS];
+static PACKET *trace_slots[TRACE_TRANSFERS];  /* slot in the queue or scratch packet */
+static BOOL trace_submitted[TRACE_TRANSFERS];
+static unsigned trace_pending = 0;            /* number of queue slots with a read in flight */
+
+static void trace_submit(int idx, READPIPE readpipe)
+{
+  assert(idx >= 0 && idx < TRACE_TRANSFERS);
+  PACKET *packet = tracequeue_reserveahead(trace_pending);
+  if (packet != NULL)
+    trace_pending += 1;
+  else
+    packet = &trace_scratch[idx];
+  trace_slots[idx] = packet;
+  ResetEvent(trace_ovl[idx].hEvent);
+  trace_submitted[idx] = readpipe(hUSBiface, usbTraceEP, packet->data, sizearray(packet->data), NULL, &trace_ovl[idx])
+                         || GetLastError() == ERROR_IO_PENDING;
+}
+
+/* trace_read_overlapped() keeps multiple reads in flight, so that the endpoint
+   does not idle while a packet is handled; each read is directly into a slot
+   of the packet queue */
+static void trace_read_overlapped(READPIPE readpipe, OVERLAPPEDRESULT getresult)
+{
+  int idx;
+
+  trace_pending = 0;
+  for (idx = 0; idx < TRACE_TRANSFERS; idx++) {
+    memset(&trace_ovl[idx], 0, sizeof(OVERLAPPED));
+    trace_ovl[idx].hEvent = CreateEvent(NULL, TRUE, FALSE, NULL);
+  }
+  for (idx = 0; idx < TRACE_TRANSFERS; idx++)
+    trace_submit(idx, readpipe);
+
+  /* reads on a single pipe complete in order */
+  for (idx = 0; ; idx = (idx + 1) % TRACE_TRANSFERS) {
+    uint32_t numread = 0;
+    BOOL ok = trace_submitted[idx] && getresult(hUSBiface, &trace_ovl[idx], &numread, TRUE);
+    if (!ok)
+      numread = 0;
+    if (trace_slots[idx] != &trace_scratch[idx]) {
+      /* this packet is at the tail of the queue, commit it even if empty,
+         because later slots may already be filled */
+      assert(trace_pending > 0);
+      trace_slots[idx]->length = numread;
+      trace_slots[idx]->timestamp = get_timestamp();
+      tracequeue_commit();
+      trace_pending -= 1;
+    } else if (numread > 0) {
+      QUEUE_INCREMENT(tracequeue_overflow); /* notify packet queue overflow */
+      PERF_COUNT("swo.overflow", 1);
+    }
+    if (!ok)
+      Sleep(50);
+    trace_submit(idx, readpipe);
+  }
+}
+
+static DWORD __stdcall trace_read(LPVOID arg)
+{
+  (void)arg;
+
+  if (TraceSocket != INVALID_SOCKET) {
+    trace_read_socket(NULL);
+  } else if (WinUsb_IsActive()) {
+    trace_read_overlapped(_WinUsb_ReadPipe, _WinUsb_GetOverlappedResult);
+  } else if (UsbK_IsActive()) {
+    trace_read_overlapped(_UsbK_ReadPipe, _UsbK_GetOverlappedResult);
+  }
+
+  return 0;
+}
+
+/** trace_init() opens the SWO tracing channel. If ipaddress is NULL, the USB
+ *  channel is opened and endpoint is the USB endpoint. If ipaddress is a valid
+ *  IP address, endpoint is the port number.
+ */
+int trace_init(unsigned short endpoint, const char *ipaddress)
+{
+  loc_errno = 0;
+  win_errno = 0;
+  tracequeue_overflow = 0;
+  capture_skip = capture_keep = 0;
+  if (hThread != NULL && hUSBiface != INVALID_HANDLE_VALUE)
+    return TRACESTAT_OK;            /* double initialization */
+
+  /* if a previous initialization did not succeed completely, clean up before
+     retrying */
+  trace_close();
+  if (trace_queue == NULL && !trace_setqueuesize(QUEUE_DEFAULTSIZE))
+    return TRACESTAT_INIT_FAILED;
+
+  if (ipaddress != NULL) {
+    struct sockaddr_in server;
+    if ((TraceSocket = socket(AF_INET, SOCK_STREAM, 0)) == INVALID_SOCKET) {
+      win_errno = WSAGetLastError();
+      return TRACESTAT_NO_INTERFACE;
+    }
+    server.sin_addr.s_addr = inet_addr(ipaddress);
+    server.sin_family = AF_INET;
+    server.sin_port = htons(endpoint);
+    if (connect(TraceSocket, (struct sockaddr*)&server, sizeof(server)) != 0) {
+      win_errno = WSAGetLastError();
+      closesocket(TraceSocket);
+      TraceSocket = INVALID_SOCKET;
+      return TRACESTAT_NO_PIPE;
+    }
+  } else {
+    TCHAR guid[100], path[_MAX_PATH];
+    if (!find_bmp(0, BMP_IF_TRACE, guid, sizearray(guid)))
+      return TRACESTAT_NO_INTERFACE;  /* Black Magic Probe not found (trace interface not found) */
+    if (!usb_GetDevicePath(guid, path, sizearray(path)))
+      return TRACESTAT_NO_DEVPATH;    /* device path to trace interface not found (should not occur) */
+
+    if (!usb_OpenDevice(path, &hUSBdev, &hUSBiface))
+      return TRACESTAT_NO_ACCESS;     /* failure opening the device interface */
+    if (!usb_ConfigEndpoint(hUSBiface, endpoint))
+      return TRACESTAT_NO_PIPE;       /* endpoint pipe could not be found -> not a Black Magic Probe? */
+  }
+
+  trace_running = true;
+  hThread = CreateThread(NULL, 0, trace_read, NULL, 0, NULL);
+  if (hThread == NULL) {
+    trace_running = false;
+    loc_errno = 11;
+    win_errno = GetLastError();
+    return TRACESTAT_NO_THREAD;
+  }
+  SetThreadPriority(hThread, THREAD_PRIORITY_HIGHEST);
+
+  return TRACESTAT_OK;
+}
+
+void trace_close(void)
+{
+  trace_replay_stop();
+  loc_errno = 0;
+  win_errno = 0;
+  if (hThread != NULL) {
+    TerminateThread(hThread, 0);
+    hThread = NULL;
+  }
+  trace_running = false;
+  if (hUSBiface != INVALID_HANDLE_VALUE) {
+    assert(hUSBdev != INVALID_HANDLE_VALUE);  /* if hUSBiface is valid, hUSBdev must be too */
+    /* cancel any reads still in flight */
+    if (WinUsb_IsActive())
+      _WinUsb_AbortPipe(hUSBiface, usbTraceEP);
+    else if (UsbK_IsActive())
+      _UsbK_AbortPipe(hUSBiface, usbTraceEP);
+    if (WinUsb_IsActive()) {
+      CloseHandle(hUSBdev);
+      _WinUsb_Free(hUSBiface);
+      WinUsb_Unload();
+    } else if (UsbK_IsActive()) {
+      _UsbK_Free(hUSBiface);
+      UsbK_Unload();
+    }
+    hUSBdev = hUSBiface = INVALID_HANDLE_VALUE;
+  }
+  int idx;
+  for (idx = 0; idx < TRACE_TRANSFERS; idx++) {
+    if (trace_ovl[idx].hEvent != NULL) {
+      CloseHandle(trace_ovl[idx].hEvent);
+      trace_ovl[idx].hEvent = NULL;
+    }
+  }
+  if (TraceSocket != INVALID_SOCKET) {
+    closesocket(TraceSocket);
+    TraceSocket = INVALID_SOCKET;
+  }
+}
+
+unsigned long trace_errno(int *loc)
+{
+  if (loc != NULL)
+    *loc = loc_errno;
+  return win_errno;
+}
+
+#else
+
+static pthread_t hThread;
+static libusb_device_handle *hUSBiface;
+static unsigned char usbTraceEP = BMP_EP_TRACE;
+static volatile int force_exit;
+
+static int memicmp(const unsigned char *p1, const unsigned char *p2, size_t count)
+{
+  int diff = 0;
+  while (count-- > 0 && diff == 0)
+    diff = toupper(*p1++) - toupper(*p2++);
+  return diff;
+}
+
+typedef struct tagTRANSFER {
+  struct libusb_transfer *xfer;
+  PACKET *packet;       /* slot in the queue, or "scratch" if the queue was full */
+  PACKET scratch;
+  bool active;          /* transfer is submitted */
+} TRANSFER;
+static TRANSFER trace_xfer[TRACE_TRANSFERS];
+static unsigned trace_pending = 0;  /* number of queue slots with a transfer in flight */
+
+static bool trace_submit(TRANSFER *t)
+{
+  assert(t != NULL && t->xfer != NULL);
+  t->packet = tracequeue_reserveahead(trace_pending);
+  if (t->packet != NULL)
+    trace_pending += 1;
+  else
+    t->packet = &t->scratch;
+  t->xfer->buffer = t->packet->data;
+  t->active = (libusb_submit_transfer(t->xfer) == 0);
+  if (!t->active && t->packet != &t->scratch) {
+    /* a failed submission is the most recent slot, so it can be dropped */
+    t->packet = &t->scratch;
+    trace_pending -= 1;
+  }
+  return t->active;
+}
+
+static void LIBUSB_CALL trace_transfer_done(struct libusb_transfer *xfer)
+{
+  TRANSFER *t = (TRANSFER*)xfer->user_data;
+  assert(t != NULL && t->xfer == xfer);
+  t->active = false;
+  int numread = (xfer->status == LIBUSB_TRANSFER_COMPLETED) ? xfer->actual_length : 0;
+  if (t->packet != &t->scratch) {
+    /* transfers on a single endpoint complete in order, so this packet is at
+       the tail of the queue */
+    assert(trace_pending > 0);
+    t->packet->length = numread;
+    t->packet->timestamp = get_timestamp();
+    tracequeue_commit();
+    trace_pending -= 1;
+  } else if (numread > 0) {
+    QUEUE_INCREMENT(tracequeue_overflow); /* notify packet queue overflow */
+    PERF_COUNT("swo.overflow", 1);
+  }
+  if (!force_exit && xfer->status != LIBUSB_TRANSFER_NO_DEVICE && xfer->status != LIBUSB_TRANSFER_CANCELLED)
+    trace_submit(t);
+}
+
+/* trace_read_async() keeps multiple transfers in flight, so that the endpoint
+   does not idle while a packet is handled; each transfer reads directly into
+   a slot of the packet queue */
+static bool trace_read_async(void)
+{
+  int idx, count;
+
+  trace_pending = 0;
+  for (idx = 0; idx < TRACE_TRANSFERS; idx++) {
+    TRANSFER *t = &trace_xfer[idx];
+    memset(t, 0, sizeof(TRANSFER));
+    if ((t->xfer = libusb_alloc_transfer(0)) == NULL)
+      break;
+    libusb_fill_bulk_transfer(t->xfer, hUSBiface, usbTraceEP, t->scratch.data, sizeof(t->scratch.data),
+                              trace_transfer_done, t, 0);
+  }
+  count = idx;
+  for (idx = 0; idx < count; idx++)
+    if (!trace_submit(&trace_xfer[idx]))
+      break;
+  bool result = (idx > 0);  /* at least one transfer must be in flight */
+
+  while (result && !force_exit) {
+    struct timeval tv = { 0, 100*1000 };
+    for (idx = 0; idx < count && !trace_xfer[idx].active; idx++)
+      {}
+    if (idx >= count)
+      break;              /* all transfers ended (e.g. device removed) */
+    libusb_handle_events_timeout(NULL, &tv);
+  }
+
+  /* cancel the transfers that are still in flight, and wait for these to
+     complete */
+  for (idx = 0; idx < count; idx++)
+    if (trace_xfer[idx].active)
+      libusb_cancel_transfer(trace_xfer[idx].xfer);
+  for ( ;; ) {
+    struct timeval tv = { 0, 100*1000 };
+    for (idx = 0; idx < count && !trace_xfer[idx].active; idx++)
+      {}
+    if (idx >= count)
+      break;
+    libusb_handle_events_timeout(NULL, &tv);
+  }
+  for (idx = 0; idx < count; idx++) {
+    libusb_free_transfer(trace_xfer[idx].xfer);
+    trace_xfer[idx].xfer = NULL;
+  }
+  return result;
+}
+
+static void *trace_read(void *arg)
+{
+  PACKET scratch;
+  int numread = 0;
+
+  (void)arg;
+  if (TraceSocket != INVALID_SOCKET) {
+    trace_read_socket(&force_exit);
+  } else if (hUSBiface != NULL && !trace_read_async()) {
+    /* asynchronous transfers failed, fall back to synchronous reads */
+    while (!force_exit && hThread != 0 && hUSBiface != NULL) {
+      /* read directly into a free slot of the queue; if the queue is full,
+         the data is read (to keep the endpoint going) but dropped */
+      PACKET *packet = trace_slot(&scratch);
+      if (libusb_bulk_transfer(hUSBiface, usbTraceEP, packet->data, sizeof(packet->data), &numread, 0) == 0) {
+        /* add the packet to the queue */
+        if (numread > 0) {
+          if (packet != &scratch) {
+            packet->length = numread;
+            packet->timestamp = get_timestamp();
+            tracequeue_commit();
+          } else {
+            QUEUE_INCREMENT(tracequeue_overflow); /* notify packet queue overflow */
+            PERF_COUNT("swo.overflow", 1);
+          }
+        }
+      }
+    }
+  }
+  force_exit = 0;
+  return 0;
+}
+
+static int usb_OpenDevice(libusb_device_handle **hUSB, const char *path)
+{
+  libusb_device **devs;
+  libusb_device_handle *handle;
+  ssize_t cnt;
+  int devidx, i, res;
+
+  /* get list of all devices */
+  cnt = libusb_get_device_list(0, &devs);
+  if (cnt < 0)
+    return TRACESTAT_INIT_FAILED;
+
+  /* find the BMP (this always opens the first device with the matching VID:PID) */
+  devidx = -1;
+  for (i = 0; devs[i] != NULL; i++) {
+    struct libusb_device_descriptor desc;
+    res = libusb_get_device_descriptor(devs[i], &desc);
+    if (res >= 0 && desc.idVendor == BMP_VID && desc.idProduct == BMP_PID) {
+      uint8_t bus = libusb_get_bus_number(devs[i]);
+      uint8_t port = libusb_get_port_number(devs[i]);
+      char *dash;
+      assert(path != NULL);
+      if (bus == strtol(path, &dash, 10) && *dash == '-' && port == strtol(dash + 1, NULL, 10)) {
+        devidx = i;
+        break;
+      }
+    }
+  }
+  if (devidx < 0) {
+    libusb_free_device_list(devs, 1);
+    return TRACESTAT_NO_DEVPATH;
+  }
+
+  res = libusb_open(devs[devidx], &handle);
+  libusb_free_device_list(devs, 1);
+  if (res < 0)
+    return TRACESTAT_NO_ACCESS;
+
+  /* connect to the BMP capture interface */
+  res = libusb_claim_interface(handle, BMP_IF_TRACE);
+  if (res < 0) {
+    libusb_close(handle);
+    return TRACESTAT_NO_INTERFACE;
+  }
+
+  assert(hUSB != NULL);
+  *hUSB = handle;
+  return TRACESTAT_OK;
+}
+
+int trace_init(unsigned short endpoint, const char *ipaddress)
+{
+  int result;
+
+  tracequeue_overflow = 0;
+  capture_skip = capture_keep = 0;
+  usbTraceEP = endpoint;
+
+  if (hThread != 0 && hUSBiface != NULL)
+    return TRACESTAT_OK;            /* double initialization */
+
+  /* if a previous initialization did not succeed completely, clean up before
+     retrying */
+  trace_close();
+  if (trace_queue == NULL && !trace_setqueuesize(QUEUE_DEFAULTSIZE))
+    return TRACESTAT_INIT_FAILED;
+
+  if (ipaddress != NULL) {
+    struct sockaddr_in server;
+    if ((TraceSocket = socket(AF_INET, SOCK_STREAM, 0)) == INVALID_SOCKET)
+      return TRACESTAT_NO_INTERFACE;
+
+    server.sin_addr.s_addr = inet_addr(ipaddress);
+    server.sin_family = AF_INET;
+    server.sin_port = htons(endpoint);
+    if (connect(TraceSocket, (struct sockaddr*)&server, sizeof(server)) != 0) {
+      close(TraceSocket);
+      TraceSocket = INVALID_SOCKET;
+      return TRACESTAT_NO_PIPE;
+    }
+  } else {
+    char dev_id[50];
+    if (!find_bmp(0, BMP_IF_TRACE, dev_id, sizearray(dev_id)))
+      return TRACESTAT_NO_INTERFACE;  /* Black Magic Probe not found (trace interface not found) */
+
+    result = libusb_init(0);
+    if (result < 0)
+      return TRACESTAT_INIT_FAILED;
+
+    result = usb_OpenDevice(&hUSBiface, dev_id);
+    if (result != TRACESTAT_OK)
+      return result;
+  }
+
+  force_exit = 0;
+  trace_running = true;
+  result = pthread_create(&hThread, NULL, trace_read, NULL);
+  if (result != 0) {
+    trace_running = false;
+    return TRACESTAT_NO_THREAD;
+  }
+
+  return TRACESTAT_OK;
+}
+
+void trace_close(void)
+{
+  trace_replay_stop();
+  if (hThread != 0) {
+    /* the thread may already have ended on its own (when the TCP/IP
+       connection closed), so join it rather than waiting for it to clear
+       the flag */
+    force_exit = 1;
+    pthread_join(hThread, NULL);
+    hThread = 0;
+  }
+  trace_running = false;
+  if (hUSBiface != NULL) {
+    libusb_close(hUSBiface);
+    hUSBiface = NULL;
+  }
+  if (TraceSocket != INVALID_SOCKET) {
+    close(TraceSocket);
+    TraceSocket = INVALID_SOCKET;
+  }
+}
+
+unsigned long trace_errno(int *loc)
+{
+  (void)loc;  /* parameter currently only relevant for Windows */
+  return errno;
+}
+#endif
+
+/* Raw recording: the packets are copied into a byte ring when they are
+   committed to the packet queue (on the thread that reads the probe), and a
+   writer thread flushes the ring to the file in large blocks. If the disk
+   cannot keep up, packets are dropped from the recording (but not from the
+   trace view). The file starts with RECORD_MAGIC and a version; each packet
+   is stored as a length byte, the timestamp (a double, in native byte order)
+   and the packet data. */
+#define RECORD_MAGIC    "BMSW"
+#define RECORD_VERSION  1
+#define RECORD_HDRSIZE  (1 + sizeof(double))
+#define RECORD_BUFSIZE  (8*1024*1024)   /* must be a power of 2 */
+#define RECORD_CHUNK    (256*1024)      /* preferred size of a write */
+
+static unsigned char *record_buffer = NULL;
+static unsigned record_head = 0, record_tail = 0; /* free-running byte counters */
+static int record_active = 0;
+static int record_dropped = 0;
+static bool record_error = false;
+static FILE *record_file = NULL;
+
+static FILE *replay_file = NULL;
+static int replay_stop = 0;
+
+#if defined WIN32 || defined _WIN32
+# define thread_sleep(ms)   Sleep(ms)
+  static HANDLE record_thread = NULL;
+  static HANDLE replay_thread = NULL;
+#else
+# define thread_sleep(ms)   usleep((ms) * 1000)
+  static pthread_t record_thread = 0;
+  static pthread_t replay_thread = 0;
+#endif
+
+/* record_packet() copies a packet into the recording ring (producer side) */
+static void record_packet(const PACKET *packet)
+{
+  assert(packet != NULL);
+  if (!QUEUE_LOAD(record_active) || packet->length == 0)
+    return;
+  unsigned char block[RECORD_HDRSIZE + PACKET_SIZE];
+  assert(packet->length <= PACKET_SIZE);
+  block[0] = (unsigned char)packet->length;
+  memcpy(block + 1, &packet->timestamp, sizeof(double));
+  memcpy(block + RECORD_HDRSIZE, packet->data, packet->length);
+  unsigned size = RECORD_HDRSIZE + packet->length;
+  if (record_tail + size - QUEUE_LOAD(record_head) > RECORD_BUFSIZE) {
+    QUEUE_INCREMENT(record_dropped);
+    return;
+  }
+  unsigned slot = record_tail & (RECORD_BUFSIZE - 1);
+  unsigned part = RECORD_BUFSIZE - slot;
+  if (part > size)
+    part = size;
+  memcpy(record_buffer + slot, block, part);
+  memcpy(record_buffer, block + part, size - part);
+  QUEUE_STORE(record_tail, record_tail + size);
+}
+
+/* record_flush() writes the data in the ring to the file (up to the end of
+   the ring), and returns the number of bytes written (consumer side) */
+static unsigned record_flush(unsigned minimum)
+{
+  unsigned avail = QUEUE_LOAD(record_tail) - record_head;
+  if (avail == 0 || avail < minimum)
+    return 0;
+  unsigned slot = record_head & (RECORD_BUFSIZE - 1);
+  if (avail > RECORD_BUFSIZE - slot)
+    avail = RECORD_BUFSIZE - slot;
+  if (fwrite(record_buffer + slot, 1, avail, record_file) != avail)
+    record_error = true;
+  QUEUE_STORE(record_head, record_head + avail);
+  return avail;
+}
+
+static void record_writer_loop(void)
+{
+  int idle = 0;
+  for ( ;; ) {
+    bool stopping = !QUEUE_LOAD(record_active);
+    /* write large blocks, but do not hold data back for long */
+    if (record_flush((stopping || idle >= 10) ? 1 : RECORD_CHUNK) > 0) {
+      idle = 0;
+    } else if (stopping) {
+      break;
+    } else {
+      thread_sleep(10);
+      idle++;
+    }
+  }
+}
+
+/* replay_loop() feeds the packets in the file into the packet queue, as fast
+   as the decoder consumes them */
+static void replay_loop(void)
+{
+  unsigned char header[RECORD_HDRSIZE];
+  while (!QUEUE_LOAD(replay_stop) && fread(header, 1, RECORD_HDRSIZE, replay_file) == RECORD_HDRSIZE) {
+    PACKET *packet;
+    if (header[0] > PACKET_SIZE)
+      break;  /* invalid record */
+    while ((packet = tracequeue_reserve()) == NULL) {
+      if (QUEUE_LOAD(replay_stop))
+        return;
+      thread_sleep(1);
+    }
+    packet->length = header[0];
+    memcpy(&packet->timestamp, header + 1, sizeof(double));
+    if (fread(packet->data, 1, packet->length, replay_file) != packet->length)
+      break;
+    tracequeue_commit();
+  }
+}
+
+#if defined WIN32 || defined _WIN32
+  static DWORD __stdcall record_writer(LPVOID arg)
+  {
+    (void)arg;
+    record_writer_loop();
+    return 0;
+  }
+  static DWORD __stdcall replay_reader(LPVOID arg)
+  {
+    (void)arg;
+    replay_loop();
+    trace_replaying = false;
+    return 0;
+  }
+#else
+  static void *record_writer(void *arg)
+  {
+    (void)arg;
+    record_writer_loop();
+    return 0;
+  }
+  static void *replay_reader(void *arg)
+  {
+    (void)arg;
+    replay_loop();
+    trace_replaying = false;
+    return 0;
+  }
+#endif
+
+/** trace_record_start() starts recording the raw SWO packets to a file. The
+ *  recording runs until trace_record_stop() is called; it is independent of
+ *  trace_init() and trace_close().
+ */
+bool trace_record_start(const char *filename)
+{
+  assert(filename != NULL);
+  if (record_file != NULL)
+    trace_record_stop();
+  if (record_buffer == NULL && (record_buffer = malloc(RECORD_BUFSIZE)) == NULL)
+    return false;
+  if ((record_file = fopen(filename, "wb")) == NULL)
+    return false;
+  unsigned char header[8];
+  memcpy(header, RECORD_MAGIC, 4);
+  header[4] = RECORD_VERSION;
+  memset(header + 5, 0, 3);
+  if (fwrite(header, 1, sizeof header, record_file) != sizeof header) {
+    fclose(record_file);
+    record_file = NULL;
+    remove(filename);
+    return false;
+  }
+  /* there is no writer yet, so drop any stale data in the ring */
+  QUEUE_STORE(record_head, QUEUE_LOAD(record_tail));
+  QUEUE_EXCHANGE(record_dropped, 0);
+  record_error = false;
+  QUEUE_STORE(record_active, 1);
+# if defined WIN32 || defined _WIN32
+    record_thread = CreateThread(NULL, 0, record_writer, NULL, 0, NULL);
+    bool started = (record_thread != NULL);
+# else
+    bool started = (pthread_create(&record_thread, NULL, record_writer, NULL) == 0);
+    if (!started)
+      record_thread = 0;
+# endif
+  if (!started) {
+    QUEUE_STORE(record_active, 0);
+    fclose(record_file);
+    record_file = NULL;
+    return false;
+  }
+  return true;
+}
+
+/** trace_record_stop() stops the recording. It returns false if packets were
+ *  dropped from the recording or if writing to the file failed.
+ */
+bool trace_record_stop(void)
+{
+  if (record_file == NULL)
+    return true;
+  QUEUE_STORE(record_active, 0);
+# if defined WIN32 || defined _WIN32
+    WaitForSingleObject(record_thread, INFINITE);
+    CloseHandle(record_thread);
+    record_thread = NULL;
+# else
+    pthread_join(record_thread, NULL);
+    record_thread = 0;
+# endif
+  if (fclose(record_file) != 0)
+    record_error = true;
+  record_file = NULL;
+  return !record_error && QUEUE_LOAD(record_dropped) == 0;
+}
+
+/** trace_replay() feeds a file made with trace_record_start() through the
+ *  trace decoders, instead of data from the probe. Any capture from the probe
+ *  is closed. The packets are replayed as fast as tracestring_process() (or
+ *  traceprofile_process()) handles them; the time stamps are those of the
+ *  recording.
+ *
+ *  \return TRACESTAT_OK on success, or an error code.
+ */
+int trace_replay(const char *filename)
+{
+  assert(filename != NULL);
+  trace_close();  /* also stops an earlier replay */
+  if (trace_queue == NULL && !trace_setqueuesize(QUEUE_DEFAULTSIZE))
+    return TRACESTAT_INIT_FAILED;
+  if ((replay_file = fopen(filename, "rb")) == NULL)
+    return TRACESTAT_NO_REPLAY;
+  unsigned char header[8];
+  if (fread(header, 1, sizeof header, replay_file) != sizeof header
+      || memcmp(header, RECORD_MAGIC, 4) != 0 || header[4] != RECORD_VERSION)
+  {
+    fclose(replay_file);
+    replay_file = NULL;
+    return TRACESTAT_NO_REPLAY;
+  }
+  setvbuf(replay_file, NULL, _IOFBF, RECORD_CHUNK);
+  itm_cachefilled = 0;
+  capture_skip = capture_keep = 0;
+  QUEUE_STORE(replay_stop, 0);
+  trace_replaying = true;
+# if defined WIN32 || defined _WIN32
+    replay_thread = CreateThread(NULL, 0, replay_reader, NULL, 0, NULL);
+    bool started = (replay_thread != NULL);
+# else
+    bool started = (pthread_create(&replay_thread, NULL, replay_reader, NULL) == 0);
+    if (!started)
+      replay_thread = 0;
+# endif
+  if (!started) {
+    trace_replaying = false;
+    fclose(replay_file);
+    replay_file = NULL;
+    return TRACESTAT_NO_THREAD;
+  }
+  return TRACESTAT_OK;
+}
+
+/** trace_replay_active() returns whether a replay is still feeding packets
+ *  into the queue (there may still be packets in the queue after the replay
+ *  ended).
+ */
+bool trace_replay_active(void)
+{
+  return trace_replaying;
+}
+
+static void trace_replay_stop(void)
+{
+  if (replay_file == NULL)
+    return;
+  QUEUE_STORE(replay_stop, 1);
+# if defined WIN32 || defined _WIN32
+    WaitForSingleObject(replay_thread, INFINITE);
+    CloseHandle(replay_thread);
+    replay_thread = NULL;
+# else
+    pthread_join(replay_thread, NULL);
+    replay_thread = 0;
+# endif
+  fclose(replay_file);
+  replay_file = NULL;
+  trace_replaying = false;
+}
+
+/* The decoder thread drains the packet queue with tracestring_decode(), and
+   publishes the completed strings after every batch. A string that is still
+   open (text may be appended to it) is published when no new packets arrive
+   for DECODE_IDLEFLUSH rounds. */
+#define DECODE_IDLEFLUSH  20    /* in rounds of 5 ms */
+
+static bool decode_threaded = false;
+static int decode_enabled = 0;
+static int decode_quit = 0;
+static bool decode_running = false;
+#if defined WIN32 || defined _WIN32
+  static HANDLE decode_thread = NULL;
+#else
+  static pthread_t decode_thread = 0;
+#endif
+
+static void decoder_loop(void)
+{
+  int idle = 0;
+  while (!QUEUE_LOAD(decode_quit)) {
+    int count = tracestring_decode(QUEUE_LOAD(decode_enabled) != 0);
+    idle = (count > 0) ? 0 : idle + 1;
+    bool complete = true;
+    if (tracestring_tail != NULL && (tracestring_tail->flags & 0x01) == 0) {
+      if (idle >= DECODE_IDLEFLUSH)
+        tracestring_tail->flags |= 0x01;  /* interval limit */
+      else
+        complete = false;
+    }
+    tracestring_publish(complete);
+    if (count == 0)
+      thread_sleep(5);
+  }
+}
+
+#if defined WIN32 || defined _WIN32
+  static DWORD __stdcall decoder_thread(LPVOID arg)
+  {
+    (void)arg;
+    decoder_loop();
+    return 0;
+  }
+#else
+  static void *decoder_thread(void *arg)
+  {
+    (void)arg;
+    decoder_loop();
+    return 0;
+  }
+#endif
+
+static bool decoder_start(void)
+{
+  if (decode_running)
+    return true;
+  QUEUE_STORE(decode_quit, 0);
+# if defined WIN32 || defined _WIN32
+    decode_thread = CreateThread(NULL, 0, decoder_thread, NULL, 0, NULL);
+    decode_running = (decode_thread != NULL);
+# else
+    decode_running = (pthread_create(&decode_thread, NULL, decoder_thread, NULL) == 0);
+# endif
+  return decode_running;
+}
+
+static void decoder_stop(void)
+{
+  if (!decode_running)
+    return;
+  QUEUE_STORE(decode_quit, 1);
+# if defined WIN32 || defined _WIN32
+    WaitForSingleObject(decode_thread, INFINITE);
+    CloseHandle(decode_thread);
+    decode_thread = NULL;
+# else
+    pthread_join(decode_thread, NULL);
+    decode_thread = 0;
+# endif
+  decode_running = false;
+}
+
+/** trace_rawread() copies the raw SWO data from the packet queue, without
+ *  decoding it. This is for programs that pass the SWO stream on (instead of
+ *  decoding it); it must not be combined with tracestring_process() or
+ *  traceprofile_process().
+ *
+ *  \param buffer  Will hold the data.
+ *  \param size    The size of the buffer in bytes; it should be at least the
+ *                  size of a packet (64 bytes).
+ *
+ *  \return The number of bytes stored in the buffer. Packets are copied as a
+ *          whole, so any remaining packets are returned on the next call.
+ */
+size_t trace_rawread(unsigned char *buffer, size_t size)
+{
+  assert(buffer != NULL);
+  const PACKET *packets;
+  unsigned numpackets, pktidx;
+  size_t count = 0;
+  QUEUE_STORE(capture_filtering, 0);  /* pass on all channels */
+  while ((numpackets = tracequeue_peek(&packets)) > 0) {
+    for (pktidx = 0; pktidx < numpackets && count + packets[pktidx].length <= size; pktidx++) {
+      memcpy(buffer + count, packets[pktidx].data, packets[pktidx].length);
+      count += packets[pktidx].length;
+    }
+    tracequeue_release(pktidx);
+    if (pktidx < numpackets)
+      break;  /* buffer is full */
+  }
+  return count;
+}
+
+/** tracestring_threaded() selects whether the trace strings are decoded on a
+ *  worker thread, or inside tracestring_process(). The CTF decoder is shared
+ *  with any other user (like a serial monitor), so a program that uses the
+ *  decoder on its own thread too, must not enable the worker thread.
+ */
+void tracestring_threaded(bool enable)
+{
+  if (!enable)
+    decoder_stop();
+  decode_threaded = enable;
+}
+
+/** tracestring_process() updates the view on the trace strings with the
+ *  strings that the decoder thread completed since the previous call. The
+ *  decoder thread is started if it is not running yet. When no decoder
+ *  thread is used, the packets are decoded by this function.
+ *
+ *  \param enabled  If false, the packets that arrive are dropped (not
+ *                  decoded).
+ *
+ *  \return The number of new strings (or the number of packets decoded when
+ *          no decoder thread is used).
+ */
+int tracestring_process(bool enabled)
+{
+  QUEUE_STORE(capture_filtering, 1);
+  if (!decode_threaded) {
+    int count = tracestring_decode(enabled);
+    tracestring_publish(true);
+    tracestring_view();
+    return count;
+  }
+  QUEUE_STORE(decode_enabled, enabled ? 1 : 0);
+  if (!decode_running && trace_queue != NULL)
+    decoder_start();
+  return tracestring_view();
+}
+
+static TRACESTRING statusmessage_root = { NULL, NULL };
+
+void tracelog_statusmsg(int type, const char *msg, int code)
+{
+  TRACESTRING *item, *tail;
+
+  assert(type == TRACESTATMSG_BMP || type == TRACESTATMSG_CTF);
+  assert(msg != NULL);
+  item = malloc(sizeof(TRACESTRING));
+  if (item != NULL) {
+    memset(item, 0, sizeof(TRACESTRING));
+    item->length = (unsigned short)strlen(msg);
+    item->size = item->length + 1;
+    item->text = malloc(item->size * sizeof(unsigned char));
+    if (item->text != NULL) {
+      strcpy(item->text, msg);
+      item->channel = (unsigned char)type;
+      item->flags = (short)code;
+      /* append to tail */
+      for (tail = &statusmessage_root; tail->next != NULL; tail = tail->next)
+        {}
+      tail->next = item;
+    } else {
+      free((void*)item);
+    }
+  }
+}
+
+void tracelog_statusclear(void)
+{
+  TRACESTRING *item;
+  while (statusmessage_root.next != NULL) {
+    item = statusmessage_root.next;
+    statusmessage_root.next = item->next;
+    assert(item->text!=NULL);
+    free((void*)item->text);
+    free((void*)item);
+  }
+}
+
+const char *tracelog_getstatusmsg(int idx)
+{
+  for (TRACESTRING *item = statusmessage_root.next; item != NULL; item = item->next) {
+    if (idx-- == 0)
+      return item->text;
+  }
+  return NULL;
+}
+
+float tracelog_labelwidth(float rowheight)
+{
+  int idx;
+  float labelwidth = 0;
+  for (idx = 0; idx < NUM_CHANNELS; idx++) {
+    int len = strlen(channels[idx].name);
+    if (labelwidth < len)
+      labelwidth = len;
+  }
+  return labelwidth * (rowheight / 2);
+}
+
+/* tracelog_filtermatch() returns whether the string passes the filters */
+static bool tracelog_filtermatch(const TRACESTRING *item, const TRACEFILTER *filters)
+{
+  int idx, match, count_enabled;
+
+  assert(item != NULL && item->text != NULL);
+  if (filters == NULL || filters[0].expr == NULL || !filters[0].enabled)
+    return true;
+  /* check filters (first count how many there are) */
+  match = 1;  /* preset to "match all except inverted filters" */
+  for (idx = count_enabled = 0; filters[idx].expr != NULL; idx++) {
+    if (filters[idx].enabled) {
+      count_enabled += 1;
+      if (filters[idx].expr[0] != '~')
+        match = 0;  /* valid non-inverted filter, switch to "match only filters" */
+    }
+  }
+  /* check normal filters */
+  if (!match) {
+    for (idx = 0; filters[idx].expr != NULL && !match; idx++) {
+      if (filters[idx].enabled && filters[idx].expr[0] != '~')
+        match = (strstr(item->text, filters[idx].expr) != NULL);
+    }
+  }
+  /* check inverted filters */
+  if (match) {
+    for (idx = 0; filters[idx].expr != NULL && match; idx++) {
+      if (filters[idx].enabled && filters[idx].expr[0] == '~')
+        match = (strstr(item->text, filters[idx].expr + 1) == NULL);
+    }
+  }
+  return match;
+}
+
+static void tracelog_drawline(struct nk_context *ctx, const TRACESTRING *item, bool marked,
+                              float rowheight, int labelwidth, int tstampwidth,
+                              struct nk_style_button *stbtn)
+{
+  struct nk_user_font const *font = ctx->style.font;
+
+  nk_layout_row_begin(ctx, NK_STATIC, rowheight, 4);
+  /* marker symbol */
+  nk_layout_row_push(ctx, rowheight); /* width is same as height*/
+  if (marked) {
+    stbtn->normal.data.color = stbtn->hover.data.color
+      = stbtn->active.data.color = stbtn->text_background
+      = COLOUR_BG0;
+    stbtn->text_normal = stbtn->text_active = stbtn->text_hover = COLOUR_FG_YELLOW;
+    nk_button_symbol_styled(ctx, stbtn, NK_SYMBOL_TRIANGLE_RIGHT);
+  } else {
+    nk_spacing(ctx, 1);
+  }
+  /* channel label */
+  assert(item->channel < NUM_CHANNELS);
+  stbtn->normal.data.color = stbtn->hover.data.color
+    = stbtn->active.data.color = stbtn->text_background
+    = channels[item->channel].color;
+  struct nk_color clrtxt;
+  if (channels[item->channel].color.r + 2 * channels[item->channel].color.g + channels[item->channel].color.b < 700)
+    clrtxt = COLOUR_HIGHLIGHT;
+  else
+    clrtxt = COLOUR_BG0;
+  stbtn->text_normal = stbtn->text_active = stbtn->text_hover = clrtxt;
+  nk_layout_row_push(ctx, labelwidth);
+  nk_button_label_styled(ctx, stbtn, channels[item->channel].name);
+  /* timestamp (relative time since previous trace) */
+  nk_layout_row_push(ctx, tstampwidth);
+  nk_label_colored(ctx, item->timefmt, NK_TEXT_RIGHT, COLOUR_FG_YELLOW);
+  /* calculate size of the text */
+  assert(font != NULL && font->width != NULL);
+  int textwidth = (int)font->width(font->userdata, font->height, item->text, item->length) + 10;
+  nk_layout_row_push(ctx, textwidth);
+  if (marked)
+    nk_text_colored(ctx, item->text, item->length, NK_TEXT_LEFT, COLOUR_FG_YELLOW);
+  else
+    nk_text(ctx, item->text, item->length, NK_TEXT_LEFT);
+  nk_layout_row_end(ctx);
+}
+
+typedef struct tagTRACELOG_VIEW {
+  int skiplines;
+  int markline;
+  float rowheight;
+  int labelwidth;
+  int tstampwidth;
+  struct nk_style_button *stbtn;
+} TRACELOG_VIEW;
+
+/* tracelog_row() is the list view callback for a trace line (when no filters
+   are active) */
+static void tracelog_row(struct nk_context *ctx, int row, void *userdata)
+{
+  TRACELOG_VIEW *view = (TRACELOG_VIEW*)userdata;
+  TRACESTRING *item = tracestring_get(view->skiplines + row);
+  assert(item != NULL && item->text != NULL);
+  tracelog_drawline(ctx, item, row == view->markline, view->rowheight,
+                    view->labelwidth, view->tstampwidth, view->stbtn);
+}
+
+/* tracelog_widget() draws the text in the log window and scrolls to the last line
+   if new text was added */
+void tracelog_widget(struct nk_context *ctx, const char *id, float rowheight, int limitlines,
+                     int markline, const TRACEFILTER *filters, nk_flags widget_flags)
+{
+  TRACESTRING *item;
+  int labelwidth, tstampwidth;
+  struct nk_rect rcwidget = nk_layout_widget_bounds(ctx);
+  struct nk_style_window *stwin = &ctx->style.window;
+  struct nk_style_button stbtn = ctx->style.button;
+
+  /* preset common parts of the new button style */
+  stbtn.border = 0;
+  stbtn.rounding = 0;
+  stbtn.padding.x = stbtn.padding.y = 0;
+
+  /* check the length of the longest channel name, and the longest timestamp */
+  labelwidth = (int)tracelog_labelwidth(rowheight) + 10;
+  tstampwidth = (int)((tracestring_timefmt_max * rowheight) / 2) + 10;
+
+  /* get the current scroll position, to find the top line in view */
+  nk_uint xscroll, yscroll;
+  nk_group_get_scroll(ctx, id, &xscroll, &yscroll);
+
+  /* (near) black background on group */
+  nk_style_push_color(ctx, &stwin->fixed_background.data.color, COLOUR_BG0);
+  if (nk_group_begin(ctx, id, widget_flags)) {
+    static int recent_markline = -1;
+    static int scrollpos = 0;
+    static int linecount = 0;
+    static int skiplines = 0;
+    if (limitlines < 0)
+      skiplines = 0;
+    int lines = 0;
+    float lineheight = 0;
+    if ((filters == NULL || filters[0].expr == NULL || !filters[0].enabled) && tracestring_hidden == 0) {
+      /* without filters (and without lines dropped by a channel limit), the
+         row of every line is known, so only the lines in view need to be
+         laid out */
+      int total = (int)tracestring_lines - skiplines;
+      if (total < 0)
+        total = 0;
+      TRACELOG_VIEW view = { skiplines, markline, rowheight, labelwidth, tstampwidth, &stbtn };
+      nk_listview_rows(ctx, rcwidget.h, yscroll, rowheight, total, tracelog_row, &view);
+      lines = total;
+      lineheight = rowheight;
+    } else {
+      int line;
+      for (line = skiplines; (item = tracestring_get(line)) != NULL; line++) {
+        assert(item->text != NULL);
+        if (tracestring_ishidden(line) || !tracelog_filtermatch(item, filters))
+          continue; /* text matches none of the normal filters, or matches one of the inverted filters -> skip it */
+        if (lineheight <= 0.1) {
+          struct nk_rect rcline = nk_layout_widget_bounds(ctx);
+          lineheight = rcline.h;
+        }
+        tracelog_drawline(ctx, item, lines == markline, rowheight, labelwidth, tstampwidth, &stbtn);
+        lines++;
+      }
+    }
+    if (limitlines > 0)
+      skiplines = (lines > limitlines) ? lines - limitlines : 0;
+    if (lines == 0 && statusmessage_root.next != NULL) {
+      for (item = statusmessage_root.next; item != NULL; item = item->next) {
+        struct nk_color clr;
+        if (item->flags < 0)
+          clr = COLOUR_FG_RED;
+        else if (item->channel == TRACESTATMSG_CTF)
+          clr = COLOUR_FG_AQUA;
+        else
+          clr = COLOUR_FG_YELLOW;
+        nk_layout_row_dynamic(ctx, rowheight, 1);
+        nk_label_colored(ctx, item->text, NK_TEXT_LEFT, clr);
+        lines++;
+      }
+    } else {
+      nk_layout_row_dynamic(ctx, rowheight, 1);
+      nk_spacing(ctx, 1);
+    }
+    nk_group_end(ctx);
+    /* calculate scrolling
+       1) if number of lines change, scroll to the last line
+       2) if line to mark is different than last time (and valid) make that
+          line visible */
+    if (lineheight < 0.1)
+      lineheight = 1; /* only to avoid a division by zero (for the special case of 0 text lines */
+    int ypos = scrollpos;
+    int widgetlines = (int)((rcwidget.h - 2 * stwin->padding.y) / lineheight);
+    if (lines != linecount) {
+      linecount = lines;
+      ypos = (int)((lines - widgetlines + 1) * lineheight);
+    } else if (markline != recent_markline) {
+      recent_markline = markline;
+      if (markline >= 0) {
+        ypos = markline - widgetlines / 2;
+        if (ypos > lines - widgetlines + 1)
+          ypos = lines - widgetlines + 1;
+        ypos = (int)(ypos * lineheight);
+      }
+    }
+    if (ypos < 0)
+      ypos = 0;
+    if (ypos != scrollpos) {
+      nk_group_set_scroll(ctx, id, 0, ypos);
+      scrollpos = ypos;
+    }
+  }
+  nk_style_pop_color(ctx);
+}
+
+
+typedef struct tagTLMARK {
+  float pos;
+  int count;
+} TLMARK;
+typedef struct tagTIMELINE {
+  TLMARK *marks;
+  size_t length, size;  /* number of entries & max. number of entries */
+  size_t consumed;      /* number of pyramid buckets merged into the marks */
+  unsigned lastcount;   /* count of the last merged bucket, at the time it was merged */
+} TIMELINE;
+
+/* The timeline marks are derived from a "pyramid" of buckets per channel.
+   Level 0 collapses traces that are less than TL_QUANTUM apart, each next
+   level collapses the buckets of the level below over a span that is 4 times
+   as long. The marks on the display are built from the level whose span is
+   just below half a pixel at the current zoom factor, so that only the new
+   traces are added on every frame, and zooming only re-scales that level
+   (rather than re-scanning all traces). Levels above level 0 are built on
+   demand, and they are all append-only until the traces are cleared; when
+   the oldest traces are evicted, the buckets before the oldest trace are
+   skipped (and compacted away once they make up half of the level). */
+typedef struct tagTLBUCKET {
+  double time;          /* relative to timeoffset */
+  unsigned count;
+} TLBUCKET;
+typedef struct tagTLLEVEL {
+  TLBUCKET *buckets;
+  size_t length, size;  /* number of entries & max. number of entries */
+  size_t first;         /* first bucket that holds traces that are not evicted */
+  size_t consumed;      /* number of buckets of the level below merged in this level */
+  unsigned lastcount;   /* count of the last merged bucket, at the time it was merged */
+} TLLEVEL;
+
+#define TL_LEVELS   12
+#define TL_QUANTUM  1e-6    /* collapse span of level 0, in seconds */
+
+#define EPSILON     0.001
+#define FLTEQ(a,b)  ((a)-EPSILON<(b) && (a)+EPSILON>(b))  /* test whether floating-point values are equal within a small margin */
+#define MARK_SECOND   1000000
+static float mark_spacing = 100.0;              /* spacing between two mark_deltatime positions */
+static unsigned long mark_scale = MARK_SECOND;  /* 1 -> us, 1000 -> ms, 1000000 -> s, 60000000 -> min, etc. */
+static unsigned long mark_deltatime = 1;        /* in seconds / mark_scale */
+static TIMELINE timeline[NUM_CHANNELS];
+static TLLEVEL tl_pyramid[NUM_CHANNELS][TL_LEVELS];
+static unsigned tl_nextline = 0;                /* record number of the next trace to add to the pyramid */
+static unsigned tl_generation = ~0u;            /* value of tracestring_generation that the pyramid is built for */
+static int tl_level = -1;                       /* pyramid level that the marks are built from (-1 = none) */
+static double tl_pxscale = 0.0;                 /* pixels per second that the marks are built for */
+static double tl_start[NUM_CHANNELS];           /* time of the first trace on the timeline (when lines are limited or evicted) */
+static unsigned long tl_channelmask = 0;        /* enabled channels that the marks are built for */
+static float timeline_maxpos = 0.0;             /* width of the timeline canvas */
+static double timeoffset = 0.0;
+static bool timeoffset_set = false;
+static int timeline_maxcount = 1;               /* count of traces that collapse on the same marker line on the timeline */
+
+void timeline_getconfig(double *spacing, unsigned long *scale, unsigned long *delta)
+{
+  assert(spacing != NULL);
+  *spacing = mark_spacing;
+  assert(scale != NULL);
+  *scale = mark_scale;
+  assert(delta != NULL);
+  *delta = mark_deltatime;
+}
+
+void timeline_setconfig(double spacing, unsigned long scale, unsigned long delta)
+{
+  if (spacing > 10.0 && scale > 0 && delta > 0 && delta <= 100) {
+    mark_spacing = spacing;
+    mark_scale = scale;
+    mark_deltatime = delta;
+  }
+}
+
+/** tl_reserve() makes sure that there is room for one more entry in an array
+ *  that holds "length" entries. It returns the (possibly moved) array, or NULL
+ *  if growing the array failed (in which case the original array is kept).
+ */
+static void *tl_reserve(void *array, size_t *size, size_t length, size_t itemsize)
+{
+  assert(size != NULL);
+  assert(length <= *size);
+  if (length < *size)
+    return array;
+  size_t newsize = (*size == 0) ? 32 : 2 * *size;
+  void *list = realloc(array, newsize * itemsize);
+  if (list != NULL)
+    *size = newsize;
+  return list;
+}
+
+static double tl_span(int level)
+{
+  assert(level >= 0 && level < TL_LEVELS);
+  return TL_QUANTUM * (double)(1UL << (2 * level));
+}
+
+static void tl_addbucket(TLLEVEL *lvl, double time, unsigned count, double span)
+{
+  assert(lvl != NULL);
+  if (lvl->length > 0 && time - lvl->buckets[lvl->length - 1].time < span) {
+    lvl->buckets[lvl->length - 1].count += count;
+  } else {
+    TLBUCKET *list = tl_reserve(lvl->buckets, &lvl->size, lvl->length, sizeof(TLBUCKET));
+    if (list == NULL)
+      return; /* no space for another bucket (growing the array failed) */
+    lvl->buckets = list;
+    lvl->buckets[lvl->length].time = time;
+    lvl->buckets[lvl->length].count = count;
+    lvl->length += 1;
+  }
+}
+
+/** tl_mergelevel() adds the buckets of the level below that were added (or
+ *  that grew) since the previous call.
+ */
+static void tl_mergelevel(TLLEVEL *lvl, const TLLEVEL *below, double span)
+{
+  assert(lvl != NULL && below != NULL);
+  /* the last bucket of the level below may have collected more traces */
+  if (lvl->consumed > 0 && lvl->length > 0) {
+    unsigned count = below->buckets[lvl->consumed - 1].count;
+    assert(count >= lvl->lastcount);
+    lvl->buckets[lvl->length - 1].count += count - lvl->lastcount;
+    lvl->lastcount = count;
+  }
+  while (lvl->consumed < below->length) {
+    const TLBUCKET *bucket = &below->buckets[lvl->consumed++];
+    tl_addbucket(lvl, bucket->time, bucket->count, span);
+    lvl->lastcount = bucket->count;
+  }
+}
+
+/** tl_trimlevels() skips the buckets that only hold evicted traces (that is,
+ *  traces before "front") in all levels of the pyramid of a channel.
+ */
+static void tl_trimlevels(TLLEVEL *pyramid, TIMELINE *tl, double front)
+{
+  assert(pyramid != NULL && tl != NULL);
+  for (int level = 0; level < TL_LEVELS; level++) {
+    TLLEVEL *lvl = &pyramid[level];
+    TLLEVEL *above = (level + 1 < TL_LEVELS) ? &pyramid[level + 1] : NULL;
+    /* all traces in a bucket are before the start of the next bucket */
+    while (lvl->first + 1 < lvl->length && lvl->buckets[lvl->first + 1].time <= front)
+      lvl->first += 1;
+    if (above != NULL && above->consumed < lvl->first) {
+      above->consumed = lvl->first;
+      above->lastcount = lvl->buckets[lvl->first - 1].count;
+    }
+    if (lvl->first >= 1024 && 2 * lvl->first >= lvl->length) {
+      size_t shift = lvl->first;
+      memmove(lvl->buckets, lvl->buckets + shift, (lvl->length - shift) * sizeof(TLBUCKET));
+      lvl->length -= shift;
+      lvl->first = 0;
+      if (above != NULL)
+        above->consumed -= shift;
+      if (level == tl_level)
+        tl->consumed = (tl->consumed > shift) ? tl->consumed - shift : 0;
+    }
+  }
+}
+
+/** tl_mergemarks() converts the buckets of a pyramid level to marks on the
+ *  timeline, collapsing marks that are less than half a pixel apart.
+ */
+static void tl_mergemarks(TIMELINE *tl, const TLLEVEL *lvl, double pxscale)
+{
+  assert(tl != NULL && lvl != NULL);
+  if (tl->consumed > 0 && tl->length > 0) {
+    unsigned count = lvl->buckets[tl->consumed - 1].count;
+    assert(count >= tl->lastcount);
+    tl->marks[tl->length - 1].count += count - tl->lastcount;
+    tl->lastcount = count;
+    if (tl->marks[tl->length - 1].count > timeline_maxcount)
+      timeline_maxcount = tl->marks[tl->length - 1].count;
+  }
+  while (tl->consumed < lvl->length) {
+    const TLBUCKET *bucket = &lvl->buckets[tl->consumed];
+    float pos = (float)(bucket->time * pxscale);
+    size_t idx = tl->length;
+    assert(idx == 0 || pos >= tl->marks[idx - 1].pos);
+    if (idx > 0 && (pos - tl->marks[idx - 1].pos) < 0.5) {
+      idx -= 1;
+      tl->marks[idx].count += bucket->count;
+    } else {
+      TLMARK *list = tl_reserve(tl->marks, &tl->size, tl->length, sizeof(TLMARK));
+      if (list == NULL)
+        break;  /* no space for another mark (growing the array failed) */
+      tl->marks = list;
+      tl->marks[idx].pos = pos;
+      tl->marks[idx].count = bucket->count;
+      tl->length = idx + 1;
+    }
+    if (tl->marks[idx].count > timeline_maxcount)
+      timeline_maxcount = tl->marks[idx].count;
+    if (pos > timeline_maxpos)
+      timeline_maxpos = pos;
+    tl->lastcount = bucket->count;
+    tl->consumed += 1;
+  }
+}
+
+/** timeline_rebuild() updates the "trace marks" for the traces that were
+ *  added since the previous call. The marks are only rebuilt completely (from
+ *  the pyramid) when the zoom factor, the set of enabled channels or the first
+ *  trace in view changes; the pyramid itself is only rebuilt when the traces
+ *  are cleared.
+ *
+ *  \param limitlines   If positive, only the most recent traces (up to this
+ *                      count) are marked.
+ */
+void timeline_rebuild(int limitlines)
+{
+  /* check whether the trace list was cleared */
+  if (tl_generation != tracestring_generation) {
+    for (int chan = 0; chan < NUM_CHANNELS; chan++) {
+      for (int level = 0; level < TL_LEVELS; level++) {
+        TLLEVEL *lvl = &tl_pyramid[chan][level];
+        if (lvl->buckets != NULL)
+          free((void*)lvl->buckets);
+        memset(lvl, 0, sizeof(TLLEVEL));
+      }
+      if (timeline[chan].marks != NULL)
+        free((void*)timeline[chan].marks);
+      memset(&timeline[chan], 0, sizeof(TIMELINE));
+    }
+    tl_nextline = 0;
+    tl_generation = tracestring_generation;
+    tl_level = -1;
+    timeline_maxpos = 0.0;
+    timeline_maxcount = 1;
+    timeoffset = 0.0;
+    timeoffset_set = false;
+  }
+  if (tracestring_lines == 0)
+    return;
+  /* the time offset is fixed at the first trace after a clear, so that the
+     marks stay in place when the oldest traces are evicted */
+  if (!timeoffset_set) {
+    timeoffset = tracestring_get(0)->timestamp;
+    timeoffset_set = true;
+  }
+
+  /* add the new traces to level 0 of the pyramid (traces that were evicted
+     before they were added, are skipped) */
+  if ((int)(tl_nextline - tracestring_base) < 0)
+    tl_nextline = tracestring_base;
+  for (; tl_nextline != tracestring_base + tracestring_lines; tl_nextline++) {
+    const TRACESTRING *item = tracestring_get(tl_nextline - tracestring_base);
+    assert(item != NULL);
+    assert(item->channel >= 0 && item->channel < NUM_CHANNELS);
+    tl_addbucket(&tl_pyramid[item->channel][0], item->timestamp - timeoffset, 1, tl_span(0));
+  }
+  double front = tracestring_get(0)->timestamp - timeoffset;
+  for (int chan = 0; chan < NUM_CHANNELS; chan++)
+    tl_trimlevels(tl_pyramid[chan], &timeline[chan], front);
+
+  /* find the level for the zoom factor, and bring it up to date */
+  double pxscale = mark_spacing * MARK_SECOND / ((double)mark_scale * mark_deltatime);
+  int level = 0;
+  while (level + 1 < TL_LEVELS && tl_span(level + 1) <= 0.5 / pxscale)
+    level++;
+  for (int chan = 0; chan < NUM_CHANNELS; chan++)
+    for (int idx = 1; idx <= level; idx++)
+      tl_mergelevel(&tl_pyramid[chan][idx], &tl_pyramid[chan][idx - 1], tl_span(idx));
+
+  unsigned startline = (limitlines > 0 && tracestring_lines > (unsigned)limitlines) ? tracestring_lines - limitlines : 0;
+  double start[NUM_CHANNELS];
+  bool restart = false;
+  unsigned long mask = 0;
+  for (int chan = 0; chan < NUM_CHANNELS; chan++) {
+    if (channels[chan].enabled)
+      mask |= 1UL << chan;
+    /* the traces of a channel that were dropped by a channel limit are all
+       before the oldest trace that is kept on that channel */
+    unsigned line = tracestring_chanfirst[chan] - tracestring_base;
+    if ((int)line < 0 || line < startline)
+      line = startline;
+    start[chan] = (line < tracestring_lines) ? tracestring_get(line)->timestamp - timeoffset : DBL_MAX;
+    if (start[chan] != tl_start[chan])
+      restart = true;
+  }
+
+  if (restart || level != tl_level || pxscale != tl_pxscale || mask != tl_channelmask) {
+    tl_level = level;
+    tl_pxscale = pxscale;
+    memcpy(tl_start, start, sizeof tl_start);
+    tl_channelmask = mask;
+    timeline_maxpos = 0.0;
+    timeline_maxcount = 1;
+    for (int chan = 0; chan < NUM_CHANNELS; chan++) {
+      /* skip the buckets before the start time (binary search) */
+      const TLLEVEL *lvl = &tl_pyramid[chan][level];
+      size_t low = lvl->first, high = lvl->length;
+      while (low < high) {
+        size_t mid = (low + high) / 2;
+        if (lvl->buckets[mid].time < start[chan])
+          low = mid + 1;
+        else
+          high = mid;
+      }
+      timeline[chan].length = 0;
+      timeline[chan].consumed = low;
+      timeline[chan].lastcount = 0;
+    }
+  }
+  for (int chan = 0; chan < NUM_CHANNELS; chan++)
+    if (channels[chan].enabled)
+      tl_mergemarks(&timeline[chan], &tl_pyramid[chan][level], pxscale);
+}
+
+double timeline_widget(struct nk_context *ctx, const char *id, float rowheight,
+                       int limitlines, nk_flags widget_flags)
+{
+  int labelwidth;
+  double click_time = -1.0;
+  struct nk_rect rcwidget;
+  struct nk_style_button stbtn;
+
+  assert(ctx != NULL);
+  assert(ctx->current != NULL);
+  assert(ctx->current->layout != NULL);
+  if (ctx == NULL || ctx->current == NULL || ctx->current->layout == NULL)
+    return click_time;
+
+  timeline_rebuild(limitlines); /* update the "trace marks" data */
+
+  /* preset common parts of the new button style */
+  stbtn = ctx->style.button;
+  stbtn.padding.x = stbtn.padding.y = 0;
+
+  /* check the length of the longest channel name */
+  labelwidth = (int)tracelog_labelwidth(rowheight) + 10;
+  rcwidget = nk_layout_widget_bounds(ctx);
+
+  /* no spacing & black background on group */
+  nk_style_push_vec2(ctx, &ctx->style.window.spacing, nk_vec2(0, 0));
+  nk_style_push_color(ctx, &ctx->style.window.fixed_background.data.color, COLOUR_BG0);
+  if (nk_group_begin(ctx, id, widget_flags | NK_WINDOW_NO_SCROLLBAR)) {
+    static float timeline_maxpos_prev = 0.0f;
+    struct nk_window *win = ctx->current;
+    struct nk_user_font const *font = ctx->style.font;
+    char valstr[60];
+    float x1, x2;
+    const char *unit;
+    nk_uint xscroll, yscroll;
+
+    int submark_count = 10;
+    if (mark_spacing / submark_count < 20)
+      submark_count = 5;
+    if (mark_spacing / submark_count < 20)
+      submark_count = 2;
+
+#   define HORPADDING  4
+#   define VERPADDING  1
+
+    /* get the scroll position of the graph, because scrolling is manual */
+    sprintf(valstr, "%s_graph", id);
+    nk_group_get_scroll(ctx, valstr, &xscroll, &yscroll);
+
+    /* first row: timer ticks, may not scroll vertically */
+    switch (mark_scale) {
+      case 1: unit = "\xC2\xB5s"; break; /* us */
+      case 1000: unit = "ms";     break;
+      case 1000000: unit = "s";  break;
+      case 60000000: unit = "min"; break;
+      default: assert(0);
+    }
+    nk_layout_row_begin(ctx, NK_STATIC, rowheight + VERPADDING, 3);
+    nk_layout_row_push(ctx, rcwidget.w - 2 * (1.5f * rowheight));
+    struct nk_rect rc = nk_layout_widget_bounds(ctx);
+    nk_fill_rect(&win->buffer, rc, 0.0f, COLOUR_BG0_S);
+    x2 = rc.x + rc.w;
+    int submark_iter = 0;
+    long mark_stamp = 0;
+    long mark_inv_scale = MARK_SECOND / mark_scale;
+    for (x1 = rc.x + labelwidth + HORPADDING - xscroll; x1 < x2; x1 += mark_spacing / submark_count) {
+      if (submark_iter == 0) {
+        struct nk_color clr;
+        if (mark_stamp % mark_inv_scale == 0) {
+          sprintf(valstr, "%ld s", mark_stamp / mark_inv_scale);
+          clr = COLOUR_FG_YELLOW;
+        } else {
+          sprintf(valstr, "+%ld %s", mark_stamp, unit);
+          clr = COLOUR_TEXT;
+        }
+        nk_stroke_line(&win->buffer, x1, rc.y, x1, rc.y + rowheight - 2, 1, clr);
+        rc.x = x1 + 2;
+        rc.w = x2 - rc.x;
+        nk_draw_text(&win->buffer, rc, valstr, strlen(valstr), font, COLOUR_BG0, clr);
+        mark_stamp += mark_deltatime;
+      } else {
+        nk_stroke_line(&win->buffer, x1, rc.y, x1, rc.y + rowheight / 2 - 2, 1, COLOUR_TEXT);
+      }
+      if (++submark_iter == submark_count)
+        submark_iter = 0;
+    }
+    rc = nk_layout_widget_bounds(ctx);
+    nk_stroke_line(&win->buffer, rc.x, rc.y + rc.h, rc.x + rc.w - HORPADDING, rc.y + rc.h, 1, COLOUR_FG_GRAY);
+    rc.w = labelwidth;
+    rc.h -= 1;
+    nk_fill_rect(&win->buffer, rc, 0.0f, COLOUR_BG0);
+    nk_spacing(ctx, 1);
+    nk_layout_row_push(ctx, 1.5f * rowheight);
+    if (nk_button_symbol_styled(ctx, &stbtn, NK_SYMBOL_PLUS)) {
+      mark_spacing *= 1.5;
+      if (mark_spacing > 700.0 && (mark_deltatime > 1 || mark_scale > 1)) {
+        mark_deltatime /= 10;
+        mark_spacing /= 10.0;
+        if (mark_deltatime == 0 && mark_scale >= 1000) {
+          mark_scale /= 1000;
+          mark_deltatime = 100;
+        }
+      }
+      timeline_rebuild(limitlines);
+    }
+    nk_layout_row_push(ctx, 1.5f * rowheight);
+    if (nk_button_symbol_styled(ctx, &stbtn, NK_SYMBOL_MINUS)) {
+      if (mark_spacing > 45.0 || mark_scale < 60000000 || mark_deltatime == 1)
+        mark_spacing /= 1.5;
+      if (mark_spacing < 70.0) {
+        mark_deltatime *= 10;
+        mark_spacing *= 10.0;
+        if (mark_scale < MARK_SECOND && mark_deltatime >= 1000) {
+          mark_scale *= 1000;
+          mark_deltatime /= 1000;
+        }
+      }
+      timeline_rebuild(limitlines);
+    }
+    nk_layout_row_end(ctx);
+
+    /* extra (small) spacing between timeline and top of the graphs */
+    nk_layout_row_dynamic(ctx, VERPADDING, 1);
+    nk_spacing(ctx, 1);
+
+    /* remaining rows collected in two groups: labels and graph */
+    nk_layout_row_begin(ctx, NK_STATIC, rcwidget.h - rowheight - 2 * VERPADDING, 2);
+    nk_layout_row_push(ctx, labelwidth + HORPADDING);
+    sprintf(valstr, "%s_label", id);
+    if (nk_group_begin(ctx, valstr, NK_WINDOW_NO_SCROLLBAR)) {
+      /* labels */
+      for (int chan = 0; chan < NUM_CHANNELS; chan++) {
+        struct nk_color clrtxt;
+        float textwidth;
+        int len;
+        if (!channels[chan].enabled)
+          continue; /* only draw enabled channels */
+        nk_layout_row_dynamic(ctx, rowheight + VERPADDING, 1);
+        rc = nk_layout_widget_bounds(ctx);
+        rc.x += HORPADDING;
+        rc.y -= yscroll;
+        rc.w -= HORPADDING;
+        rc.h -= 1;
+        nk_fill_rect(&win->buffer, rc, 0.0f, channels[chan].color);
+        if (channels[chan].color.r + 2 * channels[chan].color.g + channels[chan].color.b < 700)
+          clrtxt = COLOUR_HIGHLIGHT;
+        else
+          clrtxt = COLOUR_BG0;
+        /* center the text in the rect */
+        len = strlen(channels[chan].name);
+        textwidth = font->width(font->userdata, font->height, channels[chan].name, len);
+        rc.x += (rc.w - textwidth) / 2;
+        nk_draw_text(&win->buffer, rc, channels[chan].name, len, font, channels[chan].color, clrtxt);
+      }
+      nk_group_end(ctx);
+    }
+    nk_layout_row_push(ctx, rcwidget.w - labelwidth - HORPADDING);
+    sprintf(valstr, "%s_graph", id);
+    if (nk_group_begin(ctx, valstr, 0)) {
+      /* graphs */
+      int row = 0;
+      for (int chan = 0; chan < NUM_CHANNELS; chan++) {
+        int idx;
+        if (!channels[chan].enabled)
+          continue; /* only draw enabled channels */
+        nk_layout_row_begin(ctx, NK_STATIC, rowheight + VERPADDING, 2);
+        nk_layout_row_push(ctx, timeline_maxpos);
+        rc = nk_layout_widget_bounds(ctx);
+        rc.y -= yscroll;
+        if (row & 1)
+          nk_fill_rect(&win->buffer, rc, 0.0f, COLOUR_BG0_S);
+        row++;
+        /* draw marks for each active channel */
+        for (idx = 0; idx < (int)timeline[chan].length; idx++) {
+          float x = timeline[chan].marks[idx].pos + labelwidth + 2 * HORPADDING - xscroll;
+          float y = 0.75f * rowheight * (1 - (float)timeline[chan].marks[idx].count / (float)timeline_maxcount);
+          nk_stroke_line(&win->buffer, x, rc.y + y, x, rc.y + rowheight, 1, COLOUR_TEXT);
+        }
+        nk_spacing(ctx, 1);
+        nk_layout_row_end(ctx);
+        /* handle mouse click in timeline, to scroll the trace view */
+        if (nk_input_mouse_clicked(&ctx->input, NK_BUTTON_LEFT, rc)) {
+          float pos;
+          struct nk_mouse *mouse = &ctx->input.mouse;
+          assert(mouse != NULL);
+          assert(NK_INBOX(mouse->pos.x, mouse->pos.y, rc.x, rc.y, rc.w, rc.h));
+          pos = mouse->pos.x - labelwidth - 2 * HORPADDING + xscroll;
+          if (pos >= 0.0)
+            click_time = pos * (mark_scale * mark_deltatime) / (mark_spacing * MARK_SECOND) + timeoffset;
+        }
+      }
+      nk_group_end(ctx);
+    }
+    nk_layout_row_end(ctx);
+    nk_group_end(ctx);
+    /* scroll to end if more trace message markers have arrived */
+    if (timeline_maxpos != timeline_maxpos_prev) {
+      float x = timeline_maxpos - (rcwidget.w - labelwidth - HORPADDING);
+      xscroll = (x > 0.0f) ? (nk_uint)x : 0;
+      nk_group_set_scroll(ctx, valstr, xscroll, yscroll);
+      timeline_maxpos_prev = timeline_maxpos;
+    }
+  }
+
+  /* restore locally modified styles */
+  nk_style_pop_color(ctx);
+  nk_style_pop_vec2(ctx);
+
+  return click_time;
+}
+
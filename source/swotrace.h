@@ -1,94 +1,170 @@
-/*
- * Shared code for SWO Trace for the bmtrace and bmdebug utilities.
- *
- * Copyright 2019-2022 CompuPhase
- *
- * Licensed under the Apache License, Version 2.0 (the "License");
- * you may not use this file except in compliance with the License.
- * You may obtain a copy of the License at
- *
- *     http://www.apache.org/licenses/LICENSE-2.0
- *
- * Unless required by applicable law or agreed to in writing, software
- * distributed under the License is distributed on an "AS IS" BASIS,
- * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
- * See the License for the specific language governing permissions and
- * limitations under the License.
- */
-#ifndef _SWOTRACE_H
-#define _SWOTRACE_H
-
-#include <stdbool.h>
-#include "nuklear.h"
-
-#define NUM_CHANNELS  32  /* number of SWO channels */
-
-enum {
-  TRACESTAT_OK = 0,
-  TRACESTAT_NO_INTERFACE, /* Black Magic Probe not found (trace interface not found) */
-  TRACESTAT_NO_DEVPATH,   /* device path to trace interface not found */
-  TRACESTAT_NO_ACCESS,    /* failure opening the device interface */
-  TRACESTAT_NO_PIPE,      /* endpoint pipe could not be found -> not a Black Magic Probe? */
-  TRACESTAT_BAD_PACKET,   /* invalid trace data packet received */
-  TRACESTAT_NO_THREAD,    /* thread could not be created */
-  TRACESTAT_INIT_FAILED,  /* WunUSB / libusb initialization failed */
-  TRACESTAT_NO_CONNECT,   /* Failed to connect to Black Magic Probe */
-  TRACESTAT_NOT_INIT,     /* not yet initialized */
-};
-
-enum {
-  TRACESTATMSG_BMP,
-  TRACESTATMSG_CTF,
-};
-
-typedef struct tagTRACEFILTER {
-  char *expr;
-  int enabled;
-} TRACEFILTER;
-
-#define ADDRESS_ALIGN   2 /* alignment of an address in bytes (16-bit Thumb) */
-#define Address2Index(address, base)  (((address) - (base)) / ADDRESS_ALIGN)
-#define Index2Address(index, base)    ((index) * ADDRESS_ALIGN + (base))
-
-void channel_set(int index, bool enabled, const char *name, struct nk_color color);
-bool channel_getenabled(int index);
-void channel_setenabled(int index, bool enabled);
-const char *channel_getname(int index, char *name, size_t size);
-void channel_setname(int index, const char *name);
-struct nk_color channel_getcolor(int index);
-void channel_setcolor(int index, struct nk_color color);
-
-int  trace_init(unsigned short endpoint, const char *ipaddress);
-void trace_close(void);
-unsigned long trace_errno(int *loc);
-int  trace_overflowerrors(bool reset);
-
-void trace_setdatasize(short size);
-short trace_getdatasize();
-int  trace_getpacketerrors(bool reset);
-
-void tracestring_clear(void);
-int  tracestring_isempty(void);
-unsigned tracestring_count(void);
-int  tracestring_process(bool enabled);
-int  tracestring_save(const char *filename);
-int  tracestring_find(const char *text, int curline);
-int  tracestring_findtimestamp(double timestamp);
-
-int  traceprofile_process(bool enabled, unsigned *sample_map, uint32_t code_base, uint32_t code_top, unsigned *overflow);
-
-void tracelog_statusmsg(int type, const char *msg, int code);
-void tracelog_statusclear(void);
-const char *tracelog_getstatusmsg(int idx);
-float tracelog_labelwidth(float rowheight);
-void tracelog_widget(struct nk_context *ctx, const char *id, float rowheight, int limitlines,
-                     int markline, const TRACEFILTER *filters, nk_flags widget_flags);
-
-void timeline_getconfig(double *spacing, unsigned long *scale, unsigned long *delta);
-void timeline_setconfig(double spacing, unsigned long scale, unsigned long delta);
-double timeline_widget(struct nk_context *ctx, const char *id, float rowheight,
-                       int limitlines, nk_flags widget_flags);
-
-double get_timestamp(void);
-
-#endif /* _SWOTRACE_H */
+/*
+ * Shared code for SWO Trace for the bmtrace and bmdebug utilities.
+ *
+ * Copyright 2019-2022 CompuPhase
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef _SWOTRACE_H
+#define _SWOTRACE_H
+
+#include <stdbool.h>
+#include <stdio.h>
+#include "nuklear.h"
+
+#define NUM_CHANNELS  32  /* number of SWO channels */
+
+enum {
+  TRACESTAT_OK = 0,
+  TRACESTAT_NO_INTERFACE, /* Black Magic Probe not found (trace interface not found) */
+  TRACESTAT_NO_DEVPATH,   /* device path to trace interface not found */
+  TRACESTAT_NO_ACCESS,    /* failure opening the device interface */
+  TRACESTAT_NO_PIPE,      /* endpoint pipe could not be found -> not a Black Magic Probe? */
+  TRACESTAT_BAD_PACKET,   /* invalid trace data packet received */
+  TRACESTAT_NO_THREAD,    /* thread could not be created */
+  TRACESTAT_INIT_FAILED,  /* WunUSB / libusb initialization failed */
+  TRACESTAT_NO_CONNECT,   /* Failed to connect to Black Magic Probe */
+  TRACESTAT_NOT_INIT,     /* not yet initialized */
+  TRACESTAT_NO_REPLAY,    /* recording could not be opened, or has an invalid format */
+};
+
+enum {
+  TRIGGER_NONE,
+  TRIGGER_CHANNEL,        /* any packet on an ITM channel */
+  TRIGGER_CTFEVENT,       /* a CTF event (by id) */
+  TRIGGER_TEXT,           /* text in the data of a channel */
+};
+
+enum {
+  TRIGGERSTATE_OFF,       /* no trigger set, all packets are decoded */
+  TRIGGERSTATE_ARMED,     /* waiting for the trigger condition */
+  TRIGGERSTATE_CAPTURING, /* trigger fired, capturing the post-trigger packets */
+  TRIGGERSTATE_DONE,      /* capture decoded, further packets are dropped */
+};
+
+enum {
+  TRACESTATMSG_BMP,
+  TRACESTATMSG_CTF,
+};
+
+typedef struct tagTRACESTATS {
+  double bytes_per_sec;       /* capture rate (bytes received) */
+  double packets_per_sec;     /* capture rate (packets received) */
+  unsigned long long bytes;   /* total bytes received */
+  unsigned long long packets; /* total packets received */
+  unsigned queue_size;        /* size of the packet queue (in packets) */
+  unsigned queue_used;        /* packets currently in the queue */
+  unsigned queue_highwater;   /* maximum number of packets in the queue */
+  double decode_usec;         /* average decode time per packet (in us) */
+  double ctf_events_per_sec;  /* CTF events decoded */
+  double latency_msec;        /* time from packet reception to display (most recent) */
+  double latency_max_msec;    /* maximum time from packet reception to display */
+} TRACESTATS;
+
+typedef struct tagTRACEFILTER {
+  char *expr;
+  int enabled;
+} TRACEFILTER;
+
+#define ADDRESS_ALIGN   2 /* alignment of an address in bytes (16-bit Thumb) */
+#define Address2Index(address, base)  (((address) - (base)) / ADDRESS_ALIGN)
+#define Index2Address(index, base)    ((index) * ADDRESS_ALIGN + (base))
+
+typedef struct tagSAMPLEMAP SAMPLEMAP;  /* sparse histogram of PC samples */
+
+#define DWT_COMPARATORS 4 /* maximum number of DWT comparators (ARMv7-M) */
+
+typedef struct tagWATCHSAMPLE { /* data trace sample */
+  double timestamp;
+  uint32_t value;
+  unsigned char size;         /* size of the access in bytes (1, 2 or 4) */
+  bool write;                 /* write access (otherwise a read access) */
+} WATCHSAMPLE;
+
+void channel_set(int index, bool enabled, const char *name, struct nk_color color);
+bool channel_getenabled(int index);
+void channel_setenabled(int index, bool enabled);
+const char *channel_getname(int index, char *name, size_t size);
+void channel_setname(int index, const char *name);
+struct nk_color channel_getcolor(int index);
+void channel_setcolor(int index, struct nk_color color);
+void channel_setlimit(int index, unsigned maxlines);
+unsigned channel_getlimit(int index);
+
+int  trace_init(unsigned short endpoint, const char *ipaddress);
+void trace_close(void);
+unsigned long trace_errno(int *loc);
+int  trace_overflowerrors(bool reset);
+bool trace_setqueuesize(size_t bytes);
+bool trace_record_start(const char *filename);
+bool trace_record_stop(void);
+int  trace_replay(const char *filename);
+bool trace_replay_active(void);
+bool trace_trigger(int type, int value, const char *text, size_t ringsize, double post);
+void trace_trigger_rearm(void);
+int  trace_trigger_state(double *timestamp);
+
+void trace_setdatasize(short size);
+short trace_getdatasize();
+int  trace_getpacketerrors(bool reset);
+void trace_getstats(TRACESTATS *stats, bool reset);
+size_t trace_rawread(unsigned char *buffer, size_t size);
+
+void tracestring_clear(void);
+int  tracestring_isempty(void);
+unsigned tracestring_count(void);
+void tracestring_threaded(bool enable);
+void tracestring_setlimits(unsigned maxlines, size_t maxbytes, double maxtime);
+void tracestring_getlimits(unsigned *maxlines, size_t *maxbytes, double *maxtime);
+int  tracestring_process(bool enabled);
+int  tracestring_save(const char *filename, int format);
+int  tracestring_stream(FILE *fp, bool flush);
+int  tracestring_find(const char *text, int curline);
+unsigned tracestring_findcount(const char *text);
+int  tracestring_findtimestamp(double timestamp);
+
+SAMPLEMAP *samplemap_create(uint32_t code_base, uint32_t code_top);
+void samplemap_delete(SAMPLEMAP *map);
+void samplemap_clear(SAMPLEMAP *map);
+void samplemap_setfunctions(SAMPLEMAP *map, const uint32_t *ranges, unsigned count, unsigned *func_counts);
+bool samplemap_next(const SAMPLEMAP *map, uint32_t *address, unsigned *count);
+unsigned samplemap_unknown(const SAMPLEMAP *map);
+bool samplemap_setslices(SAMPLEMAP *map, double interval, unsigned count);
+unsigned samplemap_slices(const SAMPLEMAP *map);
+bool samplemap_sliceinfo(const SAMPLEMAP *map, unsigned index, double *start, unsigned *total, unsigned *peak);
+bool samplemap_slicecounts(const SAMPLEMAP *map, unsigned index, unsigned *func_counts);
+bool samplemap_settasks(SAMPLEMAP *map, int channel, unsigned maxtasks);
+unsigned samplemap_tasks(const SAMPLEMAP *map);
+bool samplemap_taskinfo(const SAMPLEMAP *map, unsigned index, uint32_t *id, unsigned *total);
+bool samplemap_taskcounts(const SAMPLEMAP *map, unsigned index, unsigned *func_counts);
+
+int  traceprofile_process(bool enabled, SAMPLEMAP *sample_map, unsigned *overflow);
+
+void tracewatch_clear(unsigned comparator);
+unsigned tracewatch_samples(unsigned comparator, WATCHSAMPLE *samples, unsigned maxcount);
+
+void tracelog_statusmsg(int type, const char *msg, int code);
+void tracelog_statusclear(void);
+const char *tracelog_getstatusmsg(int idx);
+float tracelog_labelwidth(float rowheight);
+void tracelog_widget(struct nk_context *ctx, const char *id, float rowheight, int limitlines,
+                     int markline, const TRACEFILTER *filters, nk_flags widget_flags);
+
+void timeline_getconfig(double *spacing, unsigned long *scale, unsigned long *delta);
+void timeline_setconfig(double spacing, unsigned long scale, unsigned long delta);
+double timeline_widget(struct nk_context *ctx, const char *id, float rowheight,
+                       int limitlines, nk_flags widget_flags);
+
+double get_timestamp(void);
+
+#endif /* _SWOTRACE_H */
@@ -30,6 +30,7 @@ SOFTWARE.
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include "crc32.h"
 #include "svnrev.h"
 #include "tcl.h"
 
@@ -473,6 +474,20 @@ static char *tcl_int2string(char *buffer, size_t bufsz, int radix, tcl_int value
 static int tcl_error_result(struct tcl *tcl, int flow, const char *symbol);
 static int tcl_var_index(const char *name, size_t *baselength);
 
+/* Commands and variables are stored in hash tables (with chaining), keyed on
+   the name. Commands with the same name (but different arity) are in the same
+   chain, most recently registered first. */
+#define CMD_BUCKETS 64
+#define VAR_BUCKETS 16
+
+static unsigned tcl_hash(const char *string, size_t length) {
+  unsigned h = 2166136261u; /* FNV-1a */
+  while (length-- > 0) {
+    h = (h ^ (unsigned char)*string++) * 16777619u;
+  }
+  return h;
+}
+
 struct tcl_cmd {
   struct tcl_value *name; /**< function name */
   unsigned short minargs; /**< minimum number of parameters (including function name) */
@@ -480,7 +495,7 @@ struct tcl_cmd {
   tcl_cmd_fn_t fn;        /**< function pointer */
   void *user;             /**< user value, used for the code block for Tcl procs */
   const char *declpos;    /**< position of declaration (Tcl procs) */
-  struct tcl_cmd *next;
+  struct tcl_cmd *next;   /**< next command in the hash chain */
 };
 
 struct tcl_errinfo {
@@ -496,11 +511,11 @@ struct tcl_var {
   struct tcl_value **value; /**< array of values */
   int elements;           /**< for an array, the number of "values" allocated */
   bool global;            /**< this is an alias for a global variable */
-  struct tcl_var *next;
+  struct tcl_var *next;   /**< next variable in the hash chain */
 };
 
 struct tcl_env {
-  struct tcl_var *vars;
+  struct tcl_var *vars[VAR_BUCKETS];
   struct tcl_env *parent;
   struct tcl_errinfo errinfo;
 };
@@ -524,8 +539,9 @@ static struct tcl_var *tcl_env_var(struct tcl_env *env, const char *name) {
     var->value = malloc(var->elements * sizeof(struct tcl_value*));
     if (var->value) {
       var->value[0] = tcl_value("", 0);
-      var->next = env->vars;
-      env->vars = var;
+      unsigned bucket = tcl_hash(name, namesz) % VAR_BUCKETS;
+      var->next = env->vars[bucket];
+      env->vars[bucket] = var;
     } else {
       free(var);
       var = NULL;
@@ -546,12 +562,14 @@ static void tcl_var_free_values(struct tcl_var *var) {
 
 static struct tcl_env *tcl_env_free(struct tcl_env *env) {
   struct tcl_env *parent = env->parent;
-  while (env->vars) {
-    struct tcl_var *var = env->vars;
-    env->vars = env->vars->next;
-    tcl_free(var->name);
-    tcl_var_free_values(var);
-    free(var);
+  for (int i = 0; i < VAR_BUCKETS; i++) {
+    while (env->vars[i]) {
+      struct tcl_var *var = env->vars[i];
+      env->vars[i] = var->next;
+      tcl_free(var->name);
+      tcl_var_free_values(var);
+      free(var);
+    }
   }
   free(env);
   return parent;
@@ -591,11 +609,10 @@ static struct tcl_var *tcl_findvar(struct tcl_env *env, const char *name) {
   struct tcl_var *var;
   size_t namesz;
   tcl_var_index(name, &namesz);
-  for (var = env->vars; var != NULL; var = var->next) {
-    const char *varptr = tcl_data(var->name);
-    size_t varsz;
-    tcl_var_index(tcl_data(var->name), &varsz);
-    if (varsz == namesz && strncmp(varptr, name, varsz) == 0) {
+  unsigned bucket = tcl_hash(name, namesz) % VAR_BUCKETS;
+  for (var = env->vars[bucket]; var != NULL; var = var->next) {
+    /* the name of the variable is stored without the array index */
+    if (tcl_length(var->name) == namesz && strncmp(tcl_data(var->name), name, namesz) == 0) {
       return var;
     }
   }
@@ -643,11 +660,12 @@ struct tcl_value *tcl_var(struct tcl *tcl, const char *name, struct tcl_value *v
 }
 
 static void tcl_var_free(struct tcl_env *env, struct tcl_var *var) {
-  /* unlink from list */
-  if (env->vars == var) {
-    env->vars = var->next;
+  /* unlink from the hash chain */
+  unsigned bucket = tcl_hash(tcl_data(var->name), tcl_length(var->name)) % VAR_BUCKETS;
+  if (env->vars[bucket] == var) {
+    env->vars[bucket] = var->next;
   } else {
-    struct tcl_var *pred = env->vars;
+    struct tcl_var *pred = env->vars[bucket];
     while (pred->next && pred->next != var) {
       pred = pred->next;
     }
@@ -815,7 +833,8 @@ static int tcl_subst(struct tcl *tcl, const char *string, size_t len) {
 
 static struct tcl_cmd *tcl_lookup_cmd(struct tcl *tcl, struct tcl_value *name, unsigned numargs) {
   assert(name);
-  for (struct tcl_cmd *cmd = tcl->cmds; cmd != NULL; cmd = cmd->next) {
+  unsigned bucket = tcl_hash(tcl_data(name), tcl_length(name)) % CMD_BUCKETS;
+  for (struct tcl_cmd *cmd = tcl->cmds[bucket]; cmd != NULL; cmd = cmd->next) {
     if (strcmp(tcl_data(name), tcl_data(cmd->name)) == 0 &&
         (numargs == 0 || (cmd->minargs <= numargs && numargs <= cmd->maxargs))) {
       return cmd;
@@ -824,9 +843,9 @@ static struct tcl_cmd *tcl_lookup_cmd(struct tcl *tcl, struct tcl_value *name, u
   return NULL;
 }
 
-static int tcl_exec_cmd(struct tcl *tcl, struct tcl_value *list) {
+static int tcl_exec_cmd(struct tcl *tcl, struct tcl_value *list, unsigned numargs) {
   struct tcl_value *cmdname = tcl_list_item(list, 0);
-  struct tcl_cmd *cmd = tcl_lookup_cmd(tcl, cmdname, tcl_list_length(list));
+  struct tcl_cmd *cmd = tcl_lookup_cmd(tcl, cmdname, numargs);
   int r;
   if (cmd) {
     r = cmd->fn(tcl, list, cmd->user);
@@ -837,6 +856,120 @@ static int tcl_exec_cmd(struct tcl *tcl, struct tcl_value *list) {
   return r;
 }
 
+/* The token list of a script is cached, so that the bodies of procedures and
+   loops (and scripts that are run repeatedly) are parsed only once. A script
+   is looked up by its contents, so a script that changed is parsed anew. */
+#define CACHE_BUCKETS   64
+#define CACHE_MAXITEMS  256
+
+struct tcl_token {
+  int token;
+  unsigned from, to;      /* offsets relative to the start of the script */
+};
+
+struct tcl_script {
+  struct tcl_script *next;
+  unsigned hash;
+  size_t length;
+  char *source;           /* copy of the script, to match the contents */
+  struct tcl_token *tokens;
+  unsigned count;
+};
+
+struct tcl_parsecache {
+  struct tcl_script *buckets[CACHE_BUCKETS];
+  unsigned count;
+};
+
+/* tcl_tokenize() parses the script into a list of tokens, up to the end of
+   the script or up to (and including) the first syntax error. */
+static struct tcl_token *tcl_tokenize(const char *string, size_t length, unsigned *count) {
+  unsigned size = 16, num = 0;
+  struct tcl_token *list = malloc(size * sizeof(struct tcl_token));
+  if (!list) {
+    return NULL;
+  }
+  tcl_each(string, length, 1) {
+    if (num >= size) {
+      struct tcl_token *newlist = malloc(2 * size * sizeof(struct tcl_token));
+      if (!newlist) {
+        free(list);
+        return NULL;
+      }
+      memcpy(newlist, list, size * sizeof(struct tcl_token));
+      free(list);
+      list = newlist;
+      size *= 2;
+    }
+    list[num].token = p.token;
+    list[num].from = (unsigned)(p.from - string);
+    list[num].to = (p.token == TERROR) ? list[num].from : (unsigned)(p.to - string);
+    num++;
+    if (p.token == TERROR) {
+      break;
+    }
+  }
+  *count = num;
+  return list;
+}
+
+/* tcl_parsed() returns the token list of the script, from the cache if
+   available. If the returned list is not stored in the cache, "cached" is set
+   to false, and the caller must free it. Entries are never dropped from the
+   cache while the interpreter lives, because a nested eval may be iterating
+   over it; when it is full, new scripts are simply not cached. */
+static struct tcl_token *tcl_parsed(struct tcl *tcl, const char *string, size_t length,
+                                    unsigned *count, bool *cached) {
+  struct tcl_parsecache *cache = tcl->cache;
+  unsigned hash = tcl_hash(string, length);
+  if (cache) {
+    for (struct tcl_script *s = cache->buckets[hash % CACHE_BUCKETS]; s; s = s->next) {
+      if (s->hash == hash && s->length == length && memcmp(s->source, string, length) == 0) {
+        *count = s->count;
+        *cached = true;
+        return s->tokens;
+      }
+    }
+  }
+  *cached = false;
+  struct tcl_token *tokens = tcl_tokenize(string, length, count);
+  if (tokens && cache && cache->count < CACHE_MAXITEMS) {
+    struct tcl_script *s = malloc(sizeof(struct tcl_script));
+    char *source = malloc(length + 1);
+    if (s && source) {
+      memcpy(source, string, length);
+      s->hash = hash;
+      s->length = length;
+      s->source = source;
+      s->tokens = tokens;
+      s->count = *count;
+      s->next = cache->buckets[hash % CACHE_BUCKETS];
+      cache->buckets[hash % CACHE_BUCKETS] = s;
+      cache->count++;
+      *cached = true;
+    } else {
+      free(s);
+      free(source);
+    }
+  }
+  return tokens;
+}
+
+static void tcl_parsecache_free(struct tcl_parsecache *cache) {
+  if (cache) {
+    for (int i = 0; i < CACHE_BUCKETS; i++) {
+      while (cache->buckets[i]) {
+        struct tcl_script *s = cache->buckets[i];
+        cache->buckets[i] = s->next;
+        free(s->source);
+        free(s->tokens);
+        free(s);
+      }
+    }
+    free(cache);
+  }
+}
+
 int tcl_eval(struct tcl *tcl, const char *string, size_t length) {
   if (!tcl->env->errinfo.codebase) {
     tcl->env->errinfo.codebase = string;
@@ -846,20 +979,29 @@ int tcl_eval(struct tcl *tcl, const char *string, size_t length) {
   struct tcl_value *cur = NULL;
   int result = tcl_empty_result(tcl);  /* preset to empty result */
   bool markposition = true;
-  tcl_each(string, length, 1) {
+  unsigned numwords = 0;  /* number of words in "list", avoids re-parsing it */
+  unsigned count = 0;
+  bool cached;
+  struct tcl_token *tokens = tcl_parsed(tcl, string, length, &count, &cached);
+  if (!tokens) {
+    result = tcl_error_result(tcl, MARKERROR(TCLERR_MEMORY), NULL);
+  }
+  for (unsigned idx = 0; idx < count; idx++) {
+    const char *from = string + tokens[idx].from;
+    const char *to = string + tokens[idx].to;
     if (markposition) {
       struct tcl_errinfo *info = &tcl->env->errinfo;
-      if (p.from >= info->codebase && p.from < info->codebase + info->codesize) {
-        info->currentpos = p.from;
+      if (from >= info->codebase && from < info->codebase + info->codesize) {
+        info->currentpos = from;
       }
       markposition = false;
     }
-    switch (p.token) {
+    switch (tokens[idx].token) {
     case TERROR:
       result = tcl_error_result(tcl, MARKERROR(TCLERR_SYNTAX), NULL);
       break;
     case TFIELD:
-      result = tcl_subst(tcl, p.from, p.to - p.from);
+      result = tcl_subst(tcl, from, to - from);
       if (cur) {
         tcl_append(cur, tcl_dup(tcl->result));
       } else {
@@ -867,9 +1009,10 @@ int tcl_eval(struct tcl *tcl, const char *string, size_t length) {
       }
       tcl_list_append(list, cur);
       cur = NULL;
+      numwords++;
       break;
     case TPART:
-      result = tcl_subst(tcl, p.from, p.to - p.from);
+      result = tcl_subst(tcl, from, to - from);
       struct tcl_value *part = tcl_dup(tcl->result);
       if (cur) {
         tcl_append(cur, part);
@@ -879,10 +1022,11 @@ int tcl_eval(struct tcl *tcl, const char *string, size_t length) {
       break;
     case TEXECPOINT:
     case TDONE:
-      if (tcl_list_length(list) > 0) {
-        result = tcl_exec_cmd(tcl, list);
+      if (numwords > 0) {
+        result = tcl_exec_cmd(tcl, list, numwords);
         tcl_free(list);
         list = tcl_list_new();
+        numwords = 0;
       } else {
         result = FNORMAL;
       }
@@ -898,13 +1042,17 @@ int tcl_eval(struct tcl *tcl, const char *string, size_t length) {
   }
   /* when arrived at the end of the buffer, if the list is non-empty, run that
      last command */
-  if (result == FNORMAL && tcl_list_length(list) > 0) {
+  if (result == FNORMAL && numwords > 0) {
     if (cur) {
       tcl_list_append(list, cur);
+      numwords++;
     }
-    result = tcl_exec_cmd(tcl, list);
+    result = tcl_exec_cmd(tcl, list, numwords);
   }
   tcl_free(list);
+  if (!cached) {
+    free(tokens);
+  }
   return (tcl->env->errinfo.errorcode > 0) ? FERROR : result;
 }
 
@@ -927,8 +1075,9 @@ struct tcl_cmd *tcl_register(struct tcl *tcl, const char *name, tcl_cmd_fn_t fn,
     cmd->user = user;
     cmd->minargs = minargs;
     cmd->maxargs = (maxargs == 0) ? USHRT_MAX : maxargs;
-    cmd->next = tcl->cmds;
-    tcl->cmds = cmd;
+    unsigned bucket = tcl_hash(name, strlen(name)) % CMD_BUCKETS;
+    cmd->next = tcl->cmds[bucket];
+    tcl->cmds[bucket] = cmd;
   }
   return cmd;
 }
@@ -1397,6 +1546,442 @@ static int tcl_cmd_string(struct tcl *tcl, struct tcl_value *args, void *arg) {
   return r;
 }
 
+/* binary data: the "data" argument is either a value, or "-var name", in
+   which case the contents of the variable are used directly (so that data
+   with unbalanced braces or embedded zero bytes is not passed through the
+   list parser) */
+static const struct tcl_value *tcl_binary_data(struct tcl *tcl, struct tcl_value *args, int *index, struct tcl_value **copy) {
+  assert(index && copy);
+  *copy = tcl_list_item(args, *index);
+  if (!*copy) {
+    return NULL;
+  }
+  *index += 1;
+  if (!SUBCMD(*copy, "-var")) {
+    return *copy;
+  }
+  *copy = tcl_free(*copy);
+  struct tcl_value *name = tcl_list_item(args, *index);
+  if (!name) {
+    return NULL;
+  }
+  *index += 1;
+  const struct tcl_value *data = tcl_var(tcl, tcl_data(name), NULL);
+  tcl_free(name);
+  return data;
+}
+
+#define BINCOUNT_NONE (-1)
+#define BINCOUNT_ALL  (-2)
+
+/* parses a field of the format string of "binary scan" and "binary format";
+   returns a pointer behind the field, or NULL on a syntax error */
+static const char *tcl_binary_field(const char *fptr, char *type, int *size, bool *bigendian, bool *isunsigned, int *count) {
+  *type = *fptr++;
+  *size = 0;
+  *bigendian = false;
+  switch (*type) {
+  case 'c':
+    *size = 1;
+    break;
+  case 'S':
+    *bigendian = true;
+    /* fall through */
+  case 's':
+    *size = 2;
+    break;
+  case 'I':
+    *bigendian = true;
+    /* fall through */
+  case 'i':
+    *size = 4;
+    break;
+  case 'W':
+    *bigendian = true;
+    /* fall through */
+  case 'w':
+    *size = 8;
+    break;
+  case 'a':
+  case 'H':
+  case 'x':
+  case 'X':
+  case '@':
+    break;
+  default:
+    return NULL;
+  }
+  *isunsigned = false;
+  if (*size > 0 && *fptr == 'u') {
+    *isunsigned = true;
+    fptr++;
+  }
+  *count = BINCOUNT_NONE;
+  if (*fptr == '*') {
+    *count = BINCOUNT_ALL;
+    fptr++;
+  } else if (tcl_isdigit(*fptr)) {
+    *count = (int)strtol(fptr, (char**)&fptr, 10);
+  }
+  return fptr;
+}
+
+static tcl_int tcl_binary_get(const unsigned char *data, int size, bool bigendian, bool isunsigned) {
+  unsigned long long v = 0;
+  for (int i = 0; i < size; i++) {
+    v = (v << 8) | data[bigendian ? i : size - 1 - i];
+  }
+  if (!isunsigned && size < 8 && (v & (1ULL << (8 * size - 1))) != 0) {
+    v |= ~0ULL << (8 * size);  /* sign-extend */
+  }
+  return (tcl_int)v;
+}
+
+static void tcl_binary_put(unsigned char *data, int size, bool bigendian, tcl_int value) {
+  unsigned long long v = (unsigned long long)value;
+  for (int i = 0; i < size; i++) {
+    data[bigendian ? size - 1 - i : i] = (unsigned char)(v & 0xff);
+    v >>= 8;
+  }
+}
+
+static int tcl_binary_hexdigit(char c) {
+  if (tcl_isdigit(c)) {
+    return c - '0';
+  }
+  if (tcl_isxdigit(c)) {
+    return toupper(c) - 'A' + 10;
+  }
+  return -1;
+}
+
+/* binary scan data format ?var ...?
+   returns the number of variables that were set */
+static int tcl_binary_scan(struct tcl *tcl, struct tcl_value *args) {
+  int index = 2;
+  struct tcl_value *copy;
+  const struct tcl_value *data = tcl_binary_data(tcl, args, &index, &copy);
+  struct tcl_value *format = tcl_list_item(args, index++);
+  if (!data || !format) {
+    if (copy) {
+      tcl_free(copy);
+    }
+    if (format) {
+      tcl_free(format);
+    }
+    return tcl_error_result(tcl, MARKERROR(TCLERR_PARAM), NULL);
+  }
+  const unsigned char *base = (const unsigned char*)tcl_data(data);
+  size_t length = tcl_length(data);
+  size_t pos = 0;
+  int match = 0;
+  bool ok = true;
+  bool done = false;
+  const char *fptr = tcl_data(format);
+  while (*fptr && !done) {
+    if (tcl_is_space(*fptr)) {
+      fptr++;
+      continue;
+    }
+    char type;
+    int size, count;
+    bool bigendian, isunsigned;
+    fptr = tcl_binary_field(fptr, &type, &size, &bigendian, &isunsigned, &count);
+    if (!fptr) {
+      ok = false;
+      break;
+    }
+    size_t n;
+    switch (type) {
+    case 'x':
+      n = (count == BINCOUNT_ALL) ? length - pos : (count == BINCOUNT_NONE) ? 1 : count;
+      pos = (pos + n < length) ? pos + n : length;
+      break;
+    case 'X':
+      n = (count == BINCOUNT_ALL) ? pos : (count == BINCOUNT_NONE) ? 1 : count;
+      pos = (n < pos) ? pos - n : 0;
+      break;
+    case '@':
+      n = (count == BINCOUNT_ALL) ? length : (count == BINCOUNT_NONE) ? 0 : count;
+      pos = (n < length) ? n : length;
+      break;
+    default: {
+      struct tcl_value *var = tcl_list_item(args, index++);
+      if (!var) {
+        ok = false;
+        done = true;
+        break;
+      }
+      struct tcl_value *result = NULL;
+      if (type == 'a') {
+        n = (count == BINCOUNT_ALL) ? length - pos : (count == BINCOUNT_NONE) ? 1 : count;
+        if (pos + n <= length) {
+          result = tcl_value((const char*)base + pos, n);
+          pos += n;
+        }
+      } else if (type == 'H') {
+        n = (count == BINCOUNT_ALL) ? 2 * (length - pos) : (count == BINCOUNT_NONE) ? 1 : count;
+        if (pos + (n + 1) / 2 <= length) {
+          static const char hexdigits[] = "0123456789abcdef";
+          result = tcl_value("", 0);
+          for (size_t i = 0; i < n && result; i++) {
+            unsigned char b = base[pos + i / 2];
+            char digit = hexdigits[(i & 1) ? (b & 0x0f) : (b >> 4)];
+            if (!tcl_append(result, tcl_value(&digit, 1))) {
+              result = tcl_free(result);
+            }
+          }
+          pos += (n + 1) / 2;
+        }
+      } else {
+        n = (count == BINCOUNT_ALL) ? (length - pos) / size : (count == BINCOUNT_NONE) ? 1 : count;
+        if (pos + n * size <= length) {
+          char buf[32];
+          if (count == BINCOUNT_NONE) {
+            char *p = tcl_int2string(buf, sizeof buf, 10, tcl_binary_get(base + pos, size, bigendian, isunsigned));
+            result = tcl_value(p, strlen(p));
+          } else {
+            result = tcl_list_new();
+            for (size_t i = 0; i < n && result; i++) {
+              char *p = tcl_int2string(buf, sizeof buf, 10, tcl_binary_get(base + pos + i * size, size, bigendian, isunsigned));
+              if (!tcl_list_append(result, tcl_value(p, strlen(p)))) {
+                result = tcl_free(result);
+              }
+            }
+          }
+          pos += n * size;
+        }
+      }
+      if (result) {
+        tcl_var(tcl, tcl_data(var), result);
+        match++;
+      } else {
+        done = true;  /* not enough data left: stop scanning */
+      }
+      tcl_free(var);
+      break;
+    }
+    }
+  }
+  if (copy) {
+    tcl_free(copy);
+  }
+  tcl_free(format);
+  if (!ok) {
+    return tcl_error_result(tcl, MARKERROR(TCLERR_PARAM), NULL);
+  }
+  return tcl_numeric_result(tcl, FNORMAL, match);
+}
+
+static bool tcl_binary_grow(unsigned char **buffer, size_t *bufsize, size_t needed) {
+  if (needed <= *bufsize) {
+    return true;
+  }
+  size_t newsize = 2 * *bufsize;
+  while (newsize < needed) {
+    newsize *= 2;
+  }
+  unsigned char *newbuf = malloc(newsize);
+  if (!newbuf) {
+    return false;
+  }
+  memcpy(newbuf, *buffer, *bufsize);
+  memset(newbuf + *bufsize, 0, newsize - *bufsize);
+  free(*buffer);
+  *buffer = newbuf;
+  *bufsize = newsize;
+  return true;
+}
+
+/* binary format format ?arg ...? */
+static int tcl_binary_format(struct tcl *tcl, struct tcl_value *args) {
+  size_t bufsize = 64;
+  unsigned char *buffer = malloc(bufsize);
+  if (!buffer) {
+    return tcl_error_result(tcl, MARKERROR(TCLERR_MEMORY), NULL);
+  }
+  memset(buffer, 0, bufsize);
+  struct tcl_value *format = tcl_list_item(args, 2);
+  assert(format);
+  size_t buflen = 0;  /* number of bytes in the buffer */
+  size_t pos = 0;     /* write position (may be lower than buflen after 'X' or '@') */
+  int index = 3;
+  int err = 0;
+  const char *fptr = tcl_data(format);
+  while (*fptr && err == 0) {
+    if (tcl_is_space(*fptr)) {
+      fptr++;
+      continue;
+    }
+    char type;
+    int size, count;
+    bool bigendian, isunsigned;
+    fptr = tcl_binary_field(fptr, &type, &size, &bigendian, &isunsigned, &count);
+    if (!fptr) {
+      err = TCLERR_PARAM;
+      break;
+    }
+    if (type == 'X') {
+      size_t n = (count == BINCOUNT_ALL) ? pos : (count == BINCOUNT_NONE) ? 1 : count;
+      pos = (n < pos) ? pos - n : 0;
+      continue;
+    }
+    if (type == '@') {
+      pos = (count == BINCOUNT_ALL) ? buflen : (count == BINCOUNT_NONE) ? 0 : count;
+      if (!tcl_binary_grow(&buffer, &bufsize, pos)) {
+        err = TCLERR_MEMORY;
+      } else if (pos > buflen) {
+        buflen = pos;   /* the buffer is zero-filled, so this pads with zeros */
+      }
+      continue;
+    }
+    if (type == 'x') {
+      size_t n = (count == BINCOUNT_ALL) ? 0 : (count == BINCOUNT_NONE) ? 1 : count;
+      if (!tcl_binary_grow(&buffer, &bufsize, pos + n)) {
+        err = TCLERR_MEMORY;
+      } else {
+        memset(buffer + pos, 0, n);
+        pos += n;
+      }
+    } else {
+      struct tcl_value *arg = tcl_list_item(args, index++);
+      if (!arg) {
+        err = TCLERR_PARAM;
+        break;
+      }
+      size_t n;
+      if (type == 'a') {
+        n = (count == BINCOUNT_ALL) ? tcl_length(arg) : (count == BINCOUNT_NONE) ? 1 : count;
+        if (!tcl_binary_grow(&buffer, &bufsize, pos + n)) {
+          err = TCLERR_MEMORY;
+        } else {
+          size_t len = (tcl_length(arg) < n) ? tcl_length(arg) : n;
+          memcpy(buffer + pos, tcl_data(arg), len);
+          memset(buffer + pos + len, 0, n - len);
+          pos += n;
+        }
+      } else if (type == 'H') {
+        n = (count == BINCOUNT_ALL) ? tcl_length(arg) : (count == BINCOUNT_NONE) ? 1 : count;
+        if (n > tcl_length(arg)) {
+          n = tcl_length(arg);
+        }
+        if (!tcl_binary_grow(&buffer, &bufsize, pos + (n + 1) / 2)) {
+          err = TCLERR_MEMORY;
+        } else {
+          const char *digits = tcl_data(arg);
+          for (size_t i = 0; i < n && err == 0; i++) {
+            int d = tcl_binary_hexdigit(digits[i]);
+            if (d < 0) {
+              err = TCLERR_PARAM;
+            } else if ((i & 1) == 0) {
+              buffer[pos + i / 2] = (unsigned char)(d << 4);
+            } else {
+              buffer[pos + i / 2] |= (unsigned char)d;
+            }
+          }
+          pos += (n + 1) / 2;
+        }
+      } else if (count == BINCOUNT_NONE) {
+        if (!tcl_binary_grow(&buffer, &bufsize, pos + size)) {
+          err = TCLERR_MEMORY;
+        } else {
+          tcl_binary_put(buffer + pos, size, bigendian, tcl_number(arg));
+          pos += size;
+        }
+      } else {
+        /* with a count, the argument is a list of values */
+        n = (count == BINCOUNT_ALL) ? tcl_list_length(arg) : count;
+        if (!tcl_binary_grow(&buffer, &bufsize, pos + n * size)) {
+          err = TCLERR_MEMORY;
+        } else {
+          for (size_t i = 0; i < n; i++) {
+            struct tcl_value *item = tcl_list_item(arg, (int)i);
+            tcl_binary_put(buffer + pos, size, bigendian, item ? tcl_number(item) : 0);
+            if (item) {
+              tcl_free(item);
+            }
+            pos += size;
+          }
+        }
+      }
+      tcl_free(arg);
+    }
+    if (pos > buflen) {
+      buflen = pos;
+    }
+  }
+  tcl_free(format);
+  int r;
+  if (err != 0) {
+    r = tcl_error_result(tcl, MARKERROR(err), NULL);
+  } else {
+    r = tcl_result(tcl, FNORMAL, tcl_value((const char*)buffer, buflen));
+  }
+  free(buffer);
+  return r;
+}
+
+/* binary crc algorithm data ?offset? ?length? */
+static int tcl_binary_crc(struct tcl *tcl, struct tcl_value *args) {
+  struct tcl_value *algorithm = tcl_list_item(args, 2);
+  assert(algorithm);
+  int index = 3;
+  struct tcl_value *copy;
+  const struct tcl_value *data = tcl_binary_data(tcl, args, &index, &copy);
+  if (!data) {
+    tcl_free(algorithm);
+    return tcl_error_result(tcl, MARKERROR(TCLERR_PARAM), NULL);
+  }
+  size_t offset = 0;
+  size_t length = tcl_length(data);
+  struct tcl_value *arg;
+  if ((arg = tcl_list_item(args, index++)) != NULL) {
+    tcl_int v = tcl_number(arg);
+    offset = (v < 0) ? 0 : (v < (tcl_int)length) ? (size_t)v : length;
+    tcl_free(arg);
+  }
+  length -= offset;
+  if ((arg = tcl_list_item(args, index++)) != NULL) {
+    tcl_int v = tcl_number(arg);
+    if (v >= 0 && v < (tcl_int)length) {
+      length = (size_t)v;
+    }
+    tcl_free(arg);
+  }
+  const unsigned char *base = (const unsigned char*)tcl_data(data) + offset;
+  int r;
+  if (SUBCMD(algorithm, "crc32")) {
+    r = tcl_numeric_result(tcl, FNORMAL, crc32_ieee(0, base, (unsigned)length));
+  } else if (SUBCMD(algorithm, "gdb")) {
+    r = tcl_numeric_result(tcl, FNORMAL, gdb_crc32(0xffffffff, base, (unsigned)length));
+  } else {
+    r = tcl_error_result(tcl, MARKERROR(TCLERR_PARAM), NULL);
+  }
+  if (copy) {
+    tcl_free(copy);
+  }
+  tcl_free(algorithm);
+  return r;
+}
+
+static int tcl_cmd_binary(struct tcl *tcl, struct tcl_value *args, void *arg) {
+  (void)arg;
+  struct tcl_value *subcmd = tcl_list_item(args, 1);
+  assert(subcmd);
+  int r;
+  if (SUBCMD(subcmd, "scan")) {
+    r = tcl_binary_scan(tcl, args);
+  } else if (SUBCMD(subcmd, "format")) {
+    r = tcl_binary_format(tcl, args);
+  } else if (SUBCMD(subcmd, "crc")) {
+    r = tcl_binary_crc(tcl, args);
+  } else {
+    r = tcl_error_result(tcl, MARKERROR(TCLERR_PARAM), NULL);
+  }
+  tcl_free(subcmd);
+  return r;
+}
+
 static int tcl_cmd_info(struct tcl *tcl, struct tcl_value *args, void *arg) {
   (void)arg;
   int nargs = tcl_list_length(args);
@@ -2563,8 +3148,12 @@ void tcl_init(struct tcl *tcl) {
   memset(tcl, 0, sizeof(struct tcl));
   tcl->env = tcl_env_alloc(NULL);
   tcl->result = tcl_value("", 0);
+  tcl->cmds = calloc(CMD_BUCKETS, sizeof(struct tcl_cmd*));
+  assert(tcl->cmds);
+  tcl->cache = calloc(1, sizeof(struct tcl_parsecache)); /* on failure, run without cache */
   tcl_register(tcl, "append", tcl_cmd_append, 3, 0, NULL);
   tcl_register(tcl, "array", tcl_cmd_array, 3, 5, NULL);
+  tcl_register(tcl, "binary", tcl_cmd_binary, 3, 0, NULL);
   tcl_register(tcl, "break", tcl_cmd_flow, 1, 1, NULL);
   tcl_register(tcl, "concat", tcl_cmd_concat, 1, 0, NULL);
   tcl_register(tcl, "continue", tcl_cmd_flow, 1, 1, NULL);
@@ -2607,16 +3196,20 @@ void tcl_destroy(struct tcl *tcl) {
   while (tcl->env) {
     tcl->env = tcl_env_free(tcl->env);
   }
-  while (tcl->cmds) {
-    struct tcl_cmd *cmd = tcl->cmds;
-    tcl->cmds = tcl->cmds->next;
-    tcl_free(cmd->name);
-    if (cmd->fn == tcl_user_proc) {
-      tcl_free((struct tcl_value*)cmd->user);
+  for (int i = 0; i < CMD_BUCKETS; i++) {
+    while (tcl->cmds[i]) {
+      struct tcl_cmd *cmd = tcl->cmds[i];
+      tcl->cmds[i] = cmd->next;
+      tcl_free(cmd->name);
+      if (cmd->fn == tcl_user_proc) {
+        tcl_free((struct tcl_value*)cmd->user);
+      }
+      free(cmd);
     }
-    free(cmd);
   }
+  free(tcl->cmds);
   tcl_free(tcl->result);
+  tcl_parsecache_free(tcl->cache);
   memset(tcl, 0, sizeof(struct tcl));
 }
 
@@ -11,10 +11,12 @@ typedef long long tcl_int;
 struct tcl_value;
 struct tcl;
 struct tcl_value;
+struct tcl_parsecache;
 struct tcl {
   struct tcl_env *env;
-  struct tcl_cmd *cmds;
+  struct tcl_cmd **cmds;    /* hash table */
   struct tcl_value *result;
+  struct tcl_parsecache *cache;
 };
 
 
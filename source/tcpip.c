@@ -19,8 +19,10 @@
 #include <assert.h>
 #include <ctype.h>
 #include <errno.h>
+#include <stdbool.h>
 #include <string.h>
 #if defined WIN32 || defined _WIN32
+# include <ws2tcpip.h>
 #else
 # include <stdio.h>
 # include <fcntl.h>
@@ -28,6 +30,8 @@
 # include <netdb.h>
 # include <unistd.h>
 # include <arpa/inet.h>
+# include <netinet/in.h>
+# include <netinet/tcp.h>
 # define SOCKET_ERROR  (-1)
 #endif
 #include "bmp-scan.h"
@@ -38,6 +42,18 @@
 # define sizearray(a)   (sizeof(a) / sizeof((a)[0]))
 #endif
 
+#define CONNECT_TIMEOUT 2000      /* ms */
+#define SEND_TIMEOUT    1000      /* ms, for the socket buffer to drain */
+#define RECV_BUFSIZE    (64*1024) /* minimum size of the socket receive buffer */
+
+#if defined WIN32 || defined _WIN32
+# define WOULDBLOCK()   (WSAGetLastError() == WSAEWOULDBLOCK)
+# define INPROGRESS()   (WSAGetLastError() == WSAEWOULDBLOCK)
+#else
+# define WOULDBLOCK()   (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR)
+# define INPROGRESS()   (errno == EINPROGRESS)
+#endif
+
 
 static SOCKET GdbSocket = INVALID_SOCKET;
 
@@ -47,6 +63,15 @@ static SOCKET GdbSocket = INVALID_SOCKET;
  *  0xffffffff and an empty string.
  */
 unsigned long getlocalip(char *ip_address)
+{
+  return getlocalnet(ip_address, NULL);
+}
+
+/** getlocalnet() is like getlocalip(), but it also returns the netmask of the
+ *  network interface (in network byte order, like the IP address). If the
+ *  netmask cannot be determined, it is set to 255.255.255.0.
+ */
+unsigned long getlocalnet(char *ip_address, unsigned long *netmask)
 {
 # if defined WIN32 || defined _WIN32
     char name[80];
@@ -58,6 +83,8 @@ unsigned long getlocalip(char *ip_address)
 
   assert(ip_address != NULL);
   *ip_address = '\0';
+  if (netmask != NULL)
+    *netmask = htonl(0xffffff00);
 
 # if defined WIN32 || defined _WIN32
     if (gethostname(name, sizeof(name)) == SOCKET_ERROR)
@@ -75,6 +102,20 @@ unsigned long getlocalip(char *ip_address)
       if (strcmp(ptr, "127.0.0.1") == 0 || strcmp(ptr, "::1") == 0)
         continue;   /* ignore loopback addresses */
       strcpy(ip_address, ptr);
+      if (netmask != NULL) {
+        /* look up the interface with this address, for its netmask */
+        SOCKET sock = socket(AF_INET, SOCK_DGRAM, 0);
+        if (sock != INVALID_SOCKET) {
+          INTERFACE_INFO list[32];
+          DWORD size;
+          if (WSAIoctl(sock, SIO_GET_INTERFACE_LIST, NULL, 0, list, sizeof list, &size, NULL, NULL) != SOCKET_ERROR) {
+            for (int j = 0; j < (int)(size / sizeof(INTERFACE_INFO)); j++)
+              if (list[j].iiAddress.AddressIn.sin_addr.s_addr == addr.s_addr)
+                *netmask = list[j].iiNetmask.AddressIn.sin_addr.s_addr;
+          }
+          closesocket(sock);
+        }
+      }
       return addr.s_addr;
     }
 # else
@@ -92,6 +133,8 @@ unsigned long getlocalip(char *ip_address)
               || (strncmp(ifa->ifa_name, "ens", 3) == 0 && isdigit(ifa->ifa_name[3]))
               || (strncmp(ifa->ifa_name, "enp", 3) == 0 && isdigit(ifa->ifa_name[3]))))
       {
+        if (netmask != NULL && ifa->ifa_netmask != NULL)
+          *netmask = ((struct sockaddr_in*)ifa->ifa_netmask)->sin_addr.s_addr;
         freeifaddrs(ifaddr);
         return inet_addr(ip_address);
       }
@@ -185,11 +228,25 @@ int closesocket(SOCKET s)
 
 #endif /* __linux__ */
 
+/* wait_socket() waits until the socket is readable or writable, or until
+   the timeout (in ms) expires; it returns 1 when the socket is ready */
+static int wait_socket(SOCKET sock, bool write, int timeout)
+{
+  fd_set fdset;
+  struct timeval tv;
+  FD_ZERO(&fdset);
+  FD_SET(sock, &fdset);
+  tv.tv_sec = timeout/1000;
+  tv.tv_usec = (timeout%1000)*1000;
+  return select(sock+1, write ? NULL : &fdset, write ? &fdset : NULL, NULL, (timeout >= 0) ? &tv : NULL) == 1;
+}
+
 int tcpip_open(const char *ip_address)
 {
   struct sockaddr_in server;
 # if defined _WIN32 || defined WIN32
     unsigned long mode = 1;
+    typedef int socklen_t;
 # endif
 
   if ((GdbSocket = socket(AF_INET, SOCK_STREAM, 0)) == INVALID_SOCKET) {
@@ -208,19 +265,46 @@ int tcpip_open(const char *ip_address)
 # else
     fcntl(GdbSocket, F_SETFL, O_NONBLOCK);
 # endif
+  /* disable the Nagle algorithm: RSP packets are short and each one waits for
+     a reply, so delaying small packets only adds latency */
+  int nodelay = 1;
+  setsockopt(GdbSocket, IPPROTO_TCP, TCP_NODELAY, (const char*)&nodelay, sizeof nodelay);
+  /* a vFlashWrite or memory read reply may be several kB, and with pipelined
+     commands, several replies are under way; make sure that the receive buffer
+     can hold these (but do not shrink it, which would disable auto-tuning) */
+  int bufsize = 0;
+  socklen_t optlen = sizeof bufsize;
+  if (getsockopt(GdbSocket, SOL_SOCKET, SO_RCVBUF, (char*)&bufsize, &optlen) == 0 && bufsize < RECV_BUFSIZE) {
+    bufsize = RECV_BUFSIZE;
+    setsockopt(GdbSocket, SOL_SOCKET, SO_RCVBUF, (const char*)&bufsize, sizeof bufsize);
+  }
 
   server.sin_addr.s_addr = inet_addr(ip_address);
   server.sin_family = AF_INET;
   server.sin_port = htons(BMP_PORT_GDB);
   if (connect(GdbSocket, (struct sockaddr*)&server, sizeof(server)) == 0)
     return 0;
+  /* on a non-blocking socket, the connection is usually still in progress */
+  if (INPROGRESS() && wait_socket(GdbSocket, true, CONNECT_TIMEOUT)) {
+    int so_error = 0;
+    optlen = sizeof so_error;
+    getsockopt(GdbSocket, SOL_SOCKET, SO_ERROR, (char*)&so_error, &optlen);
+    if (so_error == 0)
+      return 0;
+    closesocket(GdbSocket);
+    GdbSocket = INVALID_SOCKET;
+    return so_error;
+  }
 
   /* connection failed, return an error code */
 # if defined WIN32 || defined _WIN32
-    return WSAGetLastError();
+    int error = WSAGetLastError();
 # else
-    return errno;
+    int error = errno;
 # endif
+  closesocket(GdbSocket);
+  GdbSocket = INVALID_SOCKET;
+  return error;
 }
 
 int tcpip_close(void)
@@ -237,13 +321,25 @@ int tcpip_isopen(void)
   return GdbSocket != INVALID_SOCKET;
 }
 
+/** tcpip_xmit() sends the data in the buffer. The socket is non-blocking, so
+ *  send() may take only part of the data when the socket buffer is full; this
+ *  function then waits for the buffer to drain (up to a timeout).
+ *
+ *  \return The number of bytes sent.
+ */
 size_t tcpip_xmit(const unsigned char *buffer, size_t size)
 {
-  int result;
+  size_t sent = 0;
 
   assert(tcpip_isopen());
-  result = send(GdbSocket, (const char*)buffer, size, 0);
-  return (result >= 0) ? result : 0;
+  while (sent < size) {
+    int result = send(GdbSocket, (const char*)buffer + sent, size - sent, 0);
+    if (result > 0)
+      sent += result;
+    else if (result < 0 && (!WOULDBLOCK() || !wait_socket(GdbSocket, true, SEND_TIMEOUT)))
+      break;
+  }
+  return sent;
 }
 
 size_t tcpip_recv(unsigned char *buffer, size_t size)
@@ -255,3 +351,14 @@ size_t tcpip_recv(unsigned char *buffer, size_t size)
   return (result >= 0) ? result : 0;
 }
 
+/** tcpip_recvwait() is like tcpip_recv(), but it waits for data to arrive, up
+ *  to the timeout (in milliseconds). A negative timeout waits indefinitely.
+ */
+size_t tcpip_recvwait(unsigned char *buffer, size_t size, int timeout)
+{
+  assert(tcpip_isopen());
+  if (timeout != 0 && !wait_socket(GdbSocket, false, timeout))
+    return 0;
+  return tcpip_recv(buffer, size);
+}
+
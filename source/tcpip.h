@@ -44,9 +44,11 @@ int tcpip_close(void);
 int tcpip_isopen(void);
 size_t tcpip_xmit(const unsigned char *buffer, size_t size);
 size_t tcpip_recv(unsigned char *buffer, size_t size);
+size_t tcpip_recvwait(unsigned char *buffer, size_t size, int timeout);
 
 /* general purpose functions */
 unsigned long getlocalip(char *ip_address);
+unsigned long getlocalnet(char *ip_address, unsigned long *netmask);
 int connect_timeout(SOCKET sock, const char *host, short port, int timeout);
 
 #if defined __linux__ || defined __FreeBSD__ || defined __APPLE__
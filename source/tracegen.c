@@ -69,6 +69,8 @@ typedef struct tagPATHLIST {
 #define FLAG_STREAMID   0x0008
 #define FLAG_C99        0x0010
 #define FLAG_NO_INSTR   0x0020
+#define FLAG_ITM        0x0040
+#define FLAG_INLINE     0x0080
 
 
 int ctf_error_notify(int code, int linenr, const char *message)
@@ -183,6 +185,8 @@ static int generate_functionheader(FILE *fp, const CTF_EVENT *evt, unsigned flag
   /* the function name */
   if (flags & FLAG_MACRO)
     fprintf(fp, "#define trace_");
+  else if (flags & FLAG_INLINE)
+    fprintf(fp, "static %s void trace_", (flags & FLAG_C99) ? "inline" : "__inline");
   else
     fprintf(fp, "void trace_");
 
@@ -230,8 +234,202 @@ static int generate_functionheader(FILE *fp, const CTF_EVENT *evt, unsigned flag
   return 1;
 }
 
+static void generate_headerstores(FILE *fp, const unsigned char *header, int size)
+{
+  for (int idx = 0; idx < size; idx++)
+    fprintf(fp, "  buffer[%d] = 0x%02x;\n", idx, header[idx]);
+}
+
+/* generate_funcbody() creates the complete function for the event (both the
+   header and the body) */
+static void generate_funcbody(FILE *fp, const CTF_EVENT *evt, unsigned flags,
+                              const char *trace_func, const char *timestamp_func)
+{
+  const CTF_PACKET_HEADER *pkthdr = packet_header();
+  const CTF_STREAM *stream = stream_by_id(evt->stream_id);
+  const CTF_EVENT_HEADER *evthdr = (stream != NULL) ? &stream->event : NULL;
+  const CTF_EVENT_FIELD *field;
+  int pos, stringcount, headersz, fixedsz;
+  const char *var_totallength, *var_index;
+  unsigned char header[16];
+  char xmit_call[40];
+
+  generate_functionheader(fp, evt, flags);
+  fprintf(fp, "\n{\n");
+
+  if (flags & FLAG_STREAMID)
+    sprintf(xmit_call, "%s(%d, ", trace_func, (stream != NULL) ? stream->stream_id : 0);
+  else
+    sprintf(xmit_call, "%s(", trace_func);
+
+  /* go through the options and arguments to determine the fixed size of the
+     trace message (the size excluding arguments that are variable length
+     strings) */
+  stringcount = 0;
+  fixedsz = 0;
+  assert(pkthdr != NULL);
+  headersz = pkthdr->header.magic_size / 8;
+  if (pkthdr->header.streamid_size > 0)
+    headersz += pkthdr->header.streamid_size / 8;
+  if (evthdr != NULL && evthdr->header.id_size > 0)
+    headersz += evthdr->header.id_size / 8;
+  if (evthdr != NULL && evthdr->header.timestamp_size > 0)
+    fixedsz += evthdr->header.timestamp_size / 8;
+  /* for strings, only add the zero terminator byte, the parameter lengths
+     are added later (by generating a call to strlen) */
+  for (field = evt->field_root.next; field != NULL; field = field->next) {
+    if (field->type.typeclass == CLASS_STRING)
+      stringcount += 1;  /* count the number of string parameters */
+    else
+      fixedsz += field->type.size / 8;
+  }
+
+  /* handle the constant part of the headers */
+  pos = 0;
+  /* check for a packet header (for stream-based protocols, there should be one) */
+  assert(pkthdr != NULL);
+  switch (pkthdr->header.magic_size) {
+  case 32:
+    header[2] = 0xfc;
+    header[3] = 0xc1;
+    /* fall through */
+  case 16:
+    header[1] = 0x1f;
+    /* fall through */
+  case 8:
+    header[0] = 0xc1;
+    break;
+  }
+  pos = pkthdr->header.magic_size / 8;
+  if (pkthdr->header.streamid_size > 0) {
+    unsigned long val = (stream != NULL) ? stream->stream_id : 0;
+    assert(pkthdr->header.streamid_size / 8 <= (int)sizeof(val));
+    memcpy(header + pos, &val, pkthdr->header.streamid_size / 8);
+    pos += pkthdr->header.streamid_size / 8;
+  }
+  /* check for an event header (there really should be one)
+     note that only the id is handled here (because it is constant for the
+     function); the timestamp is dynamic and copied into the array later */
+  if (evthdr != NULL && evthdr->header.id_size > 0) {
+    assert(evthdr->header.id_size / 8 <= (int)sizeof(evt->id));
+    memcpy(header + pos, &evt->id, evthdr->header.id_size / 8);
+    pos += evthdr->header.id_size / 8;
+  }
+  assert(pos <= (int)sizeof(header));
+  /* for inline functions, the header bytes are stored directly into the
+     buffer, so that the compiler can merge these into word stores */
+  if (headersz > 0 && !(flags & FLAG_INLINE)) {
+    fprintf(fp, "  static const unsigned char header[%d] = {", headersz);
+    dumphex(fp, header, headersz);
+    fprintf(fp, " };\n");
+  }
+  assert(pos == headersz);
+  /* check whether the timestamp must be stored (and its type) and create
+     a variable for it */
+  if (evthdr != NULL && evthdr->header.timestamp_size > 0) {
+    char typedesc[64];
+    const CTF_TYPE *clock = stream->clock;
+    assert(clock != NULL);
+    assert(timestamp_func != NULL && strlen(timestamp_func) > 0);
+    /* the clock type must be converted to a standard C type, because the
+       TSDL type is not compatible with C */
+    fprintf(fp, "  %s tstamp = %s();\n", type_to_string(clock, typedesc, sizearray(typedesc)), timestamp_func);
+  }
+  /* if there are string parameters, create variables for their lengths and
+     their positions in the buffer */
+  if (stringcount > 0) {
+    int count = 0;
+    if (stringcount > 1)
+      fprintf(fp, "  unsigned index = 0;\n");
+    for (field = evt->field_root.next; field != NULL; field = field->next)
+      if (field->type.typeclass == CLASS_STRING)
+        fprintf(fp, "  unsigned length%d = strlen(%s);\n", count++, field->name);
+    if (stringcount == 1) {
+      var_totallength = "length0";
+      var_index = "length0";
+    } else {
+      int idx;
+      var_totallength = "totallength";
+      var_index = "index";
+      fprintf(fp, "  unsigned %s = ", var_totallength);
+      for (idx = 0; idx < count; idx++) {
+        if (idx > 0)
+          fprintf(fp, " + ");
+        fprintf(fp, "length%d", idx);
+      }
+      fprintf(fp, ";\n");
+    }
+  }
+
+  if (stringcount == 0 && fixedsz == 0) {
+    /* if there are no parameters and no timestamp, there is no variable part
+       in the message, so the generated code can be very simple */
+    if (flags & FLAG_INLINE) {
+      fprintf(fp, "  unsigned char buffer[%d];\n", headersz);
+      generate_headerstores(fp, header, headersz);
+      fprintf(fp, "  %sbuffer, %d);\n", xmit_call, headersz);
+    } else {
+      fprintf(fp, "  %sheader, %d);\n", xmit_call, headersz);
+    }
+  } else {
+    int seq;
+    /* create a variable for the buffer (the stringcount count is added to the
+       fixed size because the zero byte of each string must be allocated too */
+    if ((flags & FLAG_C99) == 0 || stringcount == 0)
+      fprintf(fp, "  unsigned char buffer[%d", headersz + fixedsz + stringcount);
+    else
+      fprintf(fp, "  unsigned char *buffer = alloca(%d", headersz + fixedsz + stringcount);
+    if (stringcount > 0)
+      fprintf(fp, " + %s", var_totallength);
+    if ((flags & FLAG_C99) == 0 || stringcount == 0)
+      fprintf(fp, "];\n");
+    else
+      fprintf(fp, ");\n");
+    /* copy the fixed header to the buffer */
+    if (headersz > 0 && (flags & FLAG_INLINE))
+      generate_headerstores(fp, header, headersz);
+    else if (headersz > 0)
+      fprintf(fp, "  memcpy(buffer, header, %d);\n", headersz);
+    /* copy the timestamp */
+    if (evthdr != NULL && evthdr->header.timestamp_size > 0) {
+      fprintf(fp, "  memcpy(buffer + %d, &tstamp, %d);\n", headersz, evthdr->header.timestamp_size / 8);
+      pos += evthdr->header.timestamp_size / 8;
+    }
+    /* the parameters */
+    seq = 0;
+    for (field = evt->field_root.next; field != NULL; field = field->next) {
+      if (seq == 0)
+        fprintf(fp, "  memcpy(buffer + %d, ", pos);
+      else
+        fprintf(fp, "  memcpy(buffer + %d + %s, ", pos, var_index);
+      if (field->type.typeclass == CLASS_INTEGER || field->type.typeclass == CLASS_FLOAT
+          || field->type.typeclass == CLASS_ENUM || field->type.typeclass == CLASS_STRUCT)
+        fprintf(fp, "&");
+      fprintf(fp, "%s, ", field->name);
+      if (field->type.typeclass == CLASS_STRING) {
+        fprintf(fp, "length%d + 1);\n", seq);
+        if (stringcount == 1)
+          pos += 1; /* for the zero byte */
+        else
+          fprintf(fp, "  index += length%d + 1;\n", seq);
+        seq++;
+      } else {
+        fprintf(fp, "%u);\n", field->type.size / 8);
+        pos += field->type.size / 8;
+      }
+    }
+
+    fprintf(fp, "  %sbuffer, %d", xmit_call, headersz + fixedsz + stringcount);
+    if (stringcount > 0)
+      fprintf(fp, " + %s", var_totallength);
+    fprintf(fp, ");\n");
+  }
+  fprintf(fp, "}\n\n");
+}
+
 void generate_prototypes(FILE *fp, unsigned flags, const char *trace_func,
-                         const char *timestamp_func, const PATHLIST *includepaths)
+                         const char *timestamp_func, const PATHLIST *includepaths,
+                         unsigned ringsize)
 {
   const CTF_EVENT *evt;
   const CTF_STREAM *stream;
@@ -246,6 +444,9 @@ void generate_prototypes(FILE *fp, unsigned flags, const char *trace_func,
 
   if (flags & FLAG_C99)
     fprintf(fp, "#include <stdint.h>\n");
+  if (flags & FLAG_INLINE)
+    fprintf(fp, "#include <alloca.h>\n"
+                "#include <string.h>\n");
   if (includepaths != NULL) {
     const PATHLIST *path;
     for (path = includepaths->next; path != NULL; path = path->next) {
@@ -261,6 +462,8 @@ void generate_prototypes(FILE *fp, unsigned flags, const char *trace_func,
     fprintf(fp, "void %s(int stream_id, const unsigned char *data, unsigned size);\n", trace_func);
   else
     fprintf(fp, "void %s(const unsigned char *data, unsigned size);\n", trace_func);
+  if (ringsize > 0)
+    fprintf(fp, "void %s_flush(void);\n", trace_func);
   /* assume all all streams to have compatible clocks, so get only the first clock */
   for (seqnr = 0; (stream = stream_by_seqnr(seqnr)) != NULL && stream->clock == NULL; seqnr++)
     {}
@@ -274,24 +477,168 @@ void generate_prototypes(FILE *fp, unsigned flags, const char *trace_func,
   }
   fprintf(fp, "\n");
 
-  flags &= ~FLAG_NO_INSTR;  /* set the attribute only on the implementation */
   for (evt = event_next(NULL); evt != NULL; evt = event_next(evt)) {
     /* #ifdef NTRACE wrapper */
     fprintf(fp, "#ifdef NTRACE\n");
-    generate_functionheader(fp, evt, flags | FLAG_INDENT | FLAG_MACRO);
+    generate_functionheader(fp, evt, (flags & ~FLAG_NO_INSTR) | FLAG_INDENT | FLAG_MACRO);
     fprintf(fp, "\n#else\n");
-    generate_functionheader(fp, evt, flags | FLAG_INDENT);
-    fprintf(fp, ";\n#endif\n\n");
+    if (flags & FLAG_INLINE) {
+      /* the implementation is in the header, so that the compiler can fold
+         the constant parts (the attribute is set on the implementation) */
+      generate_funcbody(fp, evt, flags, trace_func, timestamp_func);
+      fprintf(fp, "#endif\n\n");
+    } else {
+      /* set the attribute only on the implementation */
+      generate_functionheader(fp, evt, (flags & ~FLAG_NO_INSTR) | FLAG_INDENT);
+      fprintf(fp, ";\n#endif\n\n");
+    }
   }
 
   /* file trailer */
   fprintf(fp, "#endif /* TRACEGEN_PROTOTYPE_FUNCTIONS */\n");
 }
 
+/* generate_transport() creates the implementation of the trace transmit
+   function, for direct output on the ITM stimulus ports. The ITM is written
+   with 32-bit writes where possible (each write polls the FIFO, so four times
+   fewer polls than with byte writes). With a ring buffer, the transmit
+   function only queues the event and a flush function must drain the ring
+   (for example, from an idle hook). */
+static void generate_transport(FILE *fp, unsigned flags, const char *trace_func, unsigned ringsize)
+{
+  const char *word = (flags & FLAG_C99) ? "uint32_t" : "unsigned long";
+  const char *halfword = (flags & FLAG_C99) ? "uint16_t" : "unsigned short";
+  const char *port = (flags & FLAG_STREAMID) ? "stream_id" : "0";
+
+  assert(fp != NULL);
+  assert(trace_func != NULL && strlen(trace_func) > 0);
+  assert(ringsize == 0 || (ringsize & (ringsize - 1)) == 0);
+
+  fprintf(fp, "#define TRACE_ITM_STIM(n)     (*(volatile %s*)(0xE0000000u + 4u * (n)))\n"
+              "#define TRACE_ITM_STIM16(n)   (*(volatile %s*)(0xE0000000u + 4u * (n)))\n"
+              "#define TRACE_ITM_STIM8(n)    (*(volatile unsigned char*)(0xE0000000u + 4u * (n)))\n"
+              "#define TRACE_ITM_TER         (*(volatile %s*)0xE0000E00u)\n"
+              "#define TRACE_ITM_TCR         (*(volatile %s*)0xE0000E80u)\n\n",
+          word, halfword, word, word);
+  fprintf(fp, "/* the critical section must be redefined for cores without PRIMASK */\n"
+              "#if !defined TRACE_ENTER_CRITICAL\n"
+              "  #define TRACE_ENTER_CRITICAL(s) __asm volatile (\"mrs %%0, primask\\n\\tcpsid i\" : \"=r\" (s) : : \"memory\")\n"
+              "  #define TRACE_EXIT_CRITICAL(s)  __asm volatile (\"msr primask, %%0\" : : \"r\" (s) : \"memory\")\n"
+              "#endif\n\n");
+
+  /* the function that writes a block to a stimulus port */
+  if (flags & FLAG_NO_INSTR)
+    fprintf(fp, "__attribute__((no_instrument_function))\n");
+  fprintf(fp, "static void trace_itm_write(unsigned port, const unsigned char *data, unsigned size)\n"
+              "{\n"
+              "  if ((TRACE_ITM_TCR & 1) == 0 || (TRACE_ITM_TER & (1ul << port)) == 0)\n"
+              "    return;\n"
+              "  for ( ; size >= 4; data += 4, size -= 4) {\n"
+              "    %s value;\n"
+              "    memcpy(&value, data, 4);\n"
+              "    while ((TRACE_ITM_STIM(port) & 1) == 0)\n"
+              "      {}\n"
+              "    TRACE_ITM_STIM(port) = value;\n"
+              "  }\n"
+              "  if (size >= 2) {\n"
+              "    %s value;\n"
+              "    memcpy(&value, data, 2);\n"
+              "    while ((TRACE_ITM_STIM(port) & 1) == 0)\n"
+              "      {}\n"
+              "    TRACE_ITM_STIM16(port) = value;\n"
+              "    data += 2;\n"
+              "    size -= 2;\n"
+              "  }\n"
+              "  if (size > 0) {\n"
+              "    while ((TRACE_ITM_STIM(port) & 1) == 0)\n"
+              "      {}\n"
+              "    TRACE_ITM_STIM8(port) = *data;\n"
+              "  }\n"
+              "}\n\n",
+          word, halfword);
+
+  if (ringsize == 0) {
+    /* direct transmission, the critical section avoids that events from
+       interrupts get interleaved (on the same port) */
+    if (flags & FLAG_NO_INSTR)
+      fprintf(fp, "__attribute__((no_instrument_function))\n");
+    if (flags & FLAG_STREAMID)
+      fprintf(fp, "void %s(int stream_id, const unsigned char *data, unsigned size)\n", trace_func);
+    else
+      fprintf(fp, "void %s(const unsigned char *data, unsigned size)\n", trace_func);
+    fprintf(fp, "{\n"
+                "  %s state;\n"
+                "  TRACE_ENTER_CRITICAL(state);\n"
+                "  trace_itm_write(%s, data, size);\n"
+                "  TRACE_EXIT_CRITICAL(state);\n"
+                "}\n\n",
+            word, port);
+    return;
+  }
+
+  /* ring buffer: each event is stored as a 3-byte header (port & length)
+     followed by the event data; events that do not fit are dropped */
+  fprintf(fp, "#define TRACE_RING_SIZE  %uu\n"
+              "static unsigned char trace_ring[TRACE_RING_SIZE];\n"
+              "static volatile unsigned trace_ring_head = 0;\n"
+              "static volatile unsigned trace_ring_tail = 0;\n\n",
+          ringsize);
+  if (flags & FLAG_NO_INSTR)
+    fprintf(fp, "__attribute__((no_instrument_function))\n");
+  if (flags & FLAG_STREAMID)
+    fprintf(fp, "void %s(int stream_id, const unsigned char *data, unsigned size)\n", trace_func);
+  else
+    fprintf(fp, "void %s(const unsigned char *data, unsigned size)\n", trace_func);
+  fprintf(fp, "{\n"
+              "  %s state;\n"
+              "  unsigned head, part;\n"
+              "  if (size > 0xffffu)\n"
+              "    return;\n"
+              "  TRACE_ENTER_CRITICAL(state);\n"
+              "  head = trace_ring_head;\n"
+              "  if (size + 3 <= TRACE_RING_SIZE - (head - trace_ring_tail)) {\n"
+              "    trace_ring[head++ & (TRACE_RING_SIZE - 1)] = (unsigned char)%s;\n"
+              "    trace_ring[head++ & (TRACE_RING_SIZE - 1)] = (unsigned char)(size & 0xff);\n"
+              "    trace_ring[head++ & (TRACE_RING_SIZE - 1)] = (unsigned char)(size >> 8);\n"
+              "    part = TRACE_RING_SIZE - (head & (TRACE_RING_SIZE - 1));\n"
+              "    if (part > size)\n"
+              "      part = size;\n"
+              "    memcpy(trace_ring + (head & (TRACE_RING_SIZE - 1)), data, part);\n"
+              "    memcpy(trace_ring, data + part, size - part);\n"
+              "    trace_ring_head = head + size;\n"
+              "  }\n"
+              "  TRACE_EXIT_CRITICAL(state);\n"
+              "}\n\n",
+          word, port);
+
+  /* the flush function, it is the only reader of the ring buffer, so it
+     does not need to lock out interrupts */
+  if (flags & FLAG_NO_INSTR)
+    fprintf(fp, "__attribute__((no_instrument_function))\n");
+  fprintf(fp, "void %s_flush(void)\n"
+              "{\n"
+              "  unsigned tail = trace_ring_tail;\n"
+              "  while (tail != trace_ring_head) {\n"
+              "    unsigned port = trace_ring[tail++ & (TRACE_RING_SIZE - 1)];\n"
+              "    unsigned size = trace_ring[tail++ & (TRACE_RING_SIZE - 1)];\n"
+              "    unsigned part;\n"
+              "    size |= (unsigned)trace_ring[tail++ & (TRACE_RING_SIZE - 1)] << 8;\n"
+              "    part = TRACE_RING_SIZE - (tail & (TRACE_RING_SIZE - 1));\n"
+              "    if (part > size)\n"
+              "      part = size;\n"
+              "    trace_itm_write(port, trace_ring + (tail & (TRACE_RING_SIZE - 1)), part);\n"
+              "    trace_itm_write(port, trace_ring, size - part);\n"
+              "    tail += size;\n"
+              "    trace_ring_tail = tail;\n"
+              "  }\n"
+              "}\n\n",
+          trace_func);
+}
+
 void generate_funcstubs(FILE *fp, unsigned flags, const char *trace_func,
-                        const char *timestamp_func, const char *headerfile)
+                        const char *timestamp_func, const char *headerfile,
+                        unsigned ringsize)
 {
-  char xmit_call[40];
   const CTF_EVENT *evt;
 
   /* file header */
@@ -308,176 +655,13 @@ void generate_funcstubs(FILE *fp, unsigned flags, const char *trace_func,
   assert(headerfile != NULL && strlen(headerfile) > 0);
   fprintf(fp, "#include \"%s\"\n\n", headerfile);
 
-  for (evt = event_next(NULL); evt != NULL; evt = event_next(evt)) {
-    const CTF_PACKET_HEADER *pkthdr = packet_header();
-    const CTF_STREAM *stream = stream_by_id(evt->stream_id);
-    const CTF_EVENT_HEADER *evthdr = (stream != NULL) ? &stream->event : NULL;
-    const CTF_EVENT_FIELD *field;
-    int pos, stringcount, headersz, fixedsz;
-    const char *var_totallength, *var_index;
-
-    generate_functionheader(fp, evt, flags);
-    fprintf(fp, "\n{\n");
+  if (flags & FLAG_ITM)
+    generate_transport(fp, flags, trace_func, ringsize);
 
-    if (flags & FLAG_STREAMID)
-      sprintf(xmit_call, "%s(%d, ", trace_func, (stream != NULL) ? stream->stream_id : 0);
-    else
-      sprintf(xmit_call, "%s(", trace_func);
-
-    /* go through the options and arguments to determine the fixed size of the
-       trace message (the size excluding arguments that are variable length
-       strings) */
-    stringcount = 0;
-    fixedsz = 0;
-    assert(pkthdr != NULL);
-    headersz = pkthdr->header.magic_size / 8;
-    if (pkthdr->header.streamid_size > 0)
-      headersz += pkthdr->header.streamid_size / 8;
-    if (evthdr != NULL && evthdr->header.id_size > 0)
-      headersz += evthdr->header.id_size / 8;
-    if (evthdr != NULL && evthdr->header.timestamp_size > 0)
-      fixedsz += evthdr->header.timestamp_size / 8;
-    /* for strings, only add the zero terminator byte, the parameter lengths
-       are added later (by generating a call to strlen) */
-    for (field = evt->field_root.next; field != NULL; field = field->next) {
-      if (field->type.typeclass == CLASS_STRING)
-        stringcount += 1;  /* count the number of string parameters */
-      else
-        fixedsz += field->type.size / 8;
-    }
-
-    /* handle the constant part of the headers */
-    pos = 0;
-    if (headersz > 0) {
-      fprintf(fp, "  static const unsigned char header[%d] = {", headersz);
-      /* check for a packet header (for stream-based protocols, there should be one) */
-      assert(pkthdr != NULL);
-      switch (pkthdr->header.magic_size) {
-      case 8:
-        fprintf(fp, "0xc1");
-        break;
-      case 16:
-        fprintf(fp, "0xc1, 0x1f");
-        break;
-      case 32:
-        fprintf(fp, "0xc1, 0x1f, 0xfc, 0xc1");
-        break;
-      }
-      pos = pkthdr->header.magic_size / 8;
-      if (pkthdr->header.streamid_size > 0) {
-        unsigned long val;
-        if (pos > 0)
-          fprintf(fp, ", ");
-        val = (stream != NULL) ? stream->stream_id : 0;
-        dumphex(fp, (unsigned char*)&val, pkthdr->header.streamid_size / 8);
-        pos += pkthdr->header.streamid_size / 8;
-      }
-      /* check for an event header (there really should be one)
-         note that only the id is handled here (because it is constant for the
-         function); the timestamp is dynamic and copied into the array later */
-      if (evthdr != NULL && evthdr->header.id_size > 0) {
-        if (pos > 0)
-          fprintf(fp, ", ");
-        dumphex(fp, (unsigned char*)&evt->id, evthdr->header.id_size / 8);
-        pos += evthdr->header.id_size / 8;
-      }
-      fprintf(fp, " };\n");
-    }
-    assert(pos == headersz);
-    /* check whether the timestamp must be stored (and its type) and create
-       a variable for it */
-    if (evthdr != NULL && evthdr->header.timestamp_size > 0) {
-      char typedesc[64];
-      const CTF_TYPE *clock = stream->clock;
-      assert(clock != NULL);
-      assert(timestamp_func != NULL && strlen(timestamp_func) > 0);
-      /* the clock type must be converted to a standard C type, because the
-         TSDL type is not compatible with C */
-      fprintf(fp, "  %s tstamp = %s();\n", type_to_string(clock, typedesc, sizearray(typedesc)), timestamp_func);
-    }
-    /* if there are string parameters, create variables for their lengths and
-       their positions in the buffer */
-    if (stringcount > 0) {
-      int count = 0;
-      if (stringcount > 1)
-        fprintf(fp, "  unsigned index = 0;\n");
-      for (field = evt->field_root.next; field != NULL; field = field->next)
-        if (field->type.typeclass == CLASS_STRING)
-          fprintf(fp, "  unsigned length%d = strlen(%s);\n", count++, field->name);
-      if (stringcount == 1) {
-        var_totallength = "length0";
-        var_index = "length0";
-      } else {
-        int idx;
-        var_totallength = "totallength";
-        var_index = "index";
-        fprintf(fp, "  unsigned %s = ", var_totallength);
-        for (idx = 0; idx < count; idx++) {
-          if (idx > 0)
-            fprintf(fp, " + ");
-          fprintf(fp, "length%d", idx);
-        }
-        fprintf(fp, ";\n");
-      }
-    }
-
-    if (stringcount == 0 && fixedsz == 0) {
-      /* if there are no parameters and no timestamp, there is no variable part
-         in the message, so the generated code can be very simple */
-      fprintf(fp, "  %sheader, %d);\n", xmit_call, headersz);
-    } else {
-      int seq;
-      /* create a variable for the buffer (the stringcount count is added to the
-         fixed size because the zero byte of each string must be allocated too */
-      if ((flags & FLAG_C99) == 0 || stringcount == 0)
-        fprintf(fp, "  unsigned char buffer[%d", headersz + fixedsz + stringcount);
-      else
-        fprintf(fp, "  unsigned char *buffer = alloca(%d", headersz + fixedsz + stringcount);
-      if (stringcount > 0)
-        fprintf(fp, " + %s", var_totallength);
-      if ((flags & FLAG_C99) == 0 || stringcount == 0)
-        fprintf(fp, "];\n");
-      else
-        fprintf(fp, ");\n");
-      /* copy the fixed header to the buffer */
-      if (headersz > 0)
-        fprintf(fp, "  memcpy(buffer, header, %d);\n", headersz);
-      /* copy the timestamp */
-      if (evthdr != NULL && evthdr->header.timestamp_size > 0) {
-        fprintf(fp, "  memcpy(buffer + %d, &tstamp, %d);\n", headersz, evthdr->header.timestamp_size / 8);
-        pos += evthdr->header.timestamp_size / 8;
-      }
-      /* the parameters */
-      seq = 0;
-      for (field = evt->field_root.next; field != NULL; field = field->next) {
-        if (seq == 0)
-          fprintf(fp, "  memcpy(buffer + %d, ", pos);
-        else
-          fprintf(fp, "  memcpy(buffer + %d + %s, ", pos, var_index);
-        if (field->type.typeclass == CLASS_INTEGER || field->type.typeclass == CLASS_FLOAT
-            || field->type.typeclass == CLASS_ENUM || field->type.typeclass == CLASS_STRUCT)
-          fprintf(fp, "&");
-        fprintf(fp, "%s, ", field->name);
-        if (field->type.typeclass == CLASS_STRING) {
-          fprintf(fp, "length%d + 1);\n", seq);
-          if (stringcount == 1)
-            pos += 1; /* for the zero byte */
-          else
-            fprintf(fp, "  index += length%d + 1;\n", seq);
-          seq++;
-        } else {
-          fprintf(fp, "%u);\n", field->type.size / 8);
-          pos += field->type.size / 8;
-        }
-      }
-
-      fprintf(fp, "  %sbuffer, %d", xmit_call, headersz + fixedsz + stringcount);
-      if (stringcount > 0)
-        fprintf(fp, " + %s", var_totallength);
-      fprintf(fp, ");\n");
-    }
-    fprintf(fp, "}\n\n");
-  }
+  /* for inline functions, the event functions are in the header file */
+  if (!(flags & FLAG_INLINE))
+    for (evt = event_next(NULL); evt != NULL; evt = event_next(evt))
+      generate_funcbody(fp, evt, flags, trace_func, timestamp_func);
 
   /* file trailer */
   fprintf(fp, "#endif /* NTRACE */\n");
@@ -495,8 +679,15 @@ static void usage(int status)
          "-i=path   Generate an #include <...> directive with this path.\n"
          "-I=path   Generate an #include \"...\" directive with this path.\n"
          "          The -i and -I options may appear multiple times.\n"
+         "-inline   Generate the trace functions as static inline functions in the\n"
+         "          header file.\n"
+         "-itm      Generate the trace transmit function, for output on the ITM\n"
+         "          stimulus ports (with 32-bit writes).\n"
          "-no-instr Add a \"no_instrument_function\" attribute to all generated functions.\n"
          "-o=name   Base output filename; a .c and .h suffix is added to this name.\n"
+         "-r=size   Like -itm, but queue the events in a ring buffer of the given size\n"
+         "          (a power of 2); the ring is drained by calling the transmit\n"
+         "          function name with the suffix \"_flush\" (e.g. trace_xmit_flush).\n"
          "-s        SWO tracing: use channels for stream ids.\n"
          "-t        Force basic C types on arguments, if available.\n"
          "-v        Show version information.\n");
@@ -522,7 +713,7 @@ int main(int argc, char *argv[])
   char infile[_MAX_PATH], outfile[_MAX_PATH];
   char trace_func[64], timestamp_func[64];
   char *ptr;
-  unsigned opt_flags;
+  unsigned opt_flags, opt_ringsize;
 
   if (argc <= 1)
     usage(EXIT_FAILURE);
@@ -533,6 +724,7 @@ int main(int argc, char *argv[])
   strcpy(trace_func, "trace_xmit");
   strcpy(timestamp_func, "trace_timestamp");
   opt_flags = 0;
+  opt_ringsize = 0;
   for (int idx = 1; idx < argc; idx++) {
     if (IS_OPTION(argv[idx])) {
       switch (argv[idx][1]) {
@@ -566,6 +758,14 @@ int main(int argc, char *argv[])
         break;
       case 'I':
       case 'i':
+        if (strcmp(argv[idx]+1, "itm") == 0) {
+          opt_flags |= FLAG_ITM;
+          break;
+        }
+        if (strcmp(argv[idx]+1, "inline") == 0) {
+          opt_flags |= FLAG_INLINE;
+          break;
+        }
         ptr = &argv[idx][2];
         if (*ptr == '=' || *ptr == ':')
           ptr++;
@@ -596,6 +796,17 @@ int main(int argc, char *argv[])
           ptr++;
         strlcpy(outfile, ptr, sizearray(outfile));
         break;
+      case 'r':
+        ptr = &argv[idx][2];
+        if (*ptr == '=' || *ptr == ':')
+          ptr++;
+        opt_ringsize = (unsigned)strtoul(ptr, NULL, 0);
+        if (opt_ringsize < 64 || (opt_ringsize & (opt_ringsize - 1)) != 0) {
+          fprintf(stderr, "Invalid ring buffer size \"%s\", it must be a power of 2 (64 or higher).\n", ptr);
+          return EXIT_FAILURE;
+        }
+        opt_flags |= FLAG_ITM;
+        break;
       case 's':
         opt_flags |= FLAG_STREAMID;
         break;
@@ -642,7 +853,7 @@ int main(int argc, char *argv[])
     strlcat(outfile, ".h", sizearray(outfile));
     fp = fopen(outfile, "wt");
     if (fp != NULL) {
-      generate_prototypes(fp, opt_flags, trace_func, timestamp_func, &includepaths);
+      generate_prototypes(fp, opt_flags, trace_func, timestamp_func, &includepaths, opt_ringsize);
       fclose(fp);
     } else {
       fprintf(stderr, "Error writing file \"%s\", error %d.\n", outfile, errno);
@@ -657,7 +868,7 @@ int main(int argc, char *argv[])
       /* temporarily rename the extension back to .h */
       assert(ptr != NULL && *(ptr + 1) == 'c');
       *(ptr + 1) = 'h';
-      generate_funcstubs(fp, opt_flags, trace_func, timestamp_func, outfile);
+      generate_funcstubs(fp, opt_flags, trace_func, timestamp_func, outfile, opt_ringsize);
       assert(ptr != NULL && *(ptr + 1) == 'h');
       *(ptr + 1) = 'c';
       fclose(fp);
@@ -31,6 +31,8 @@ BOOL (__stdcall *_WinUsb_Free)(USB_INTERFACE_HANDLE InterfaceHandle) = NULL;
 BOOL (__stdcall *_WinUsb_QueryInterfaceSettings)(USB_INTERFACE_HANDLE InterfaceHandle, uint8_t AlternateInterfaceNumber, USB_INTERFACE_DESCRIPTOR *UsbAltInterfaceDescriptor) = NULL;
 BOOL (__stdcall *_WinUsb_QueryPipe)(USB_INTERFACE_HANDLE InterfaceHandle, uint8_t AlternateInterfaceNumber, uint8_t PipeIndex, USB_PIPE_INFORMATION *PipeInformation) = NULL;
 BOOL (__stdcall *_WinUsb_ReadPipe)(USB_INTERFACE_HANDLE InterfaceHandle, uint8_t PipeID, uint8_t *Buffer, uint32_t BufferLength, uint32_t *LengthTransferred, LPOVERLAPPED Overlapped) = NULL;
+BOOL (__stdcall *_WinUsb_GetOverlappedResult)(USB_INTERFACE_HANDLE InterfaceHandle, LPOVERLAPPED Overlapped, uint32_t *LengthTransferred, BOOL Wait) = NULL;
+BOOL (__stdcall *_WinUsb_AbortPipe)(USB_INTERFACE_HANDLE InterfaceHandle, uint8_t PipeID) = NULL;
 
 static HMODULE hinstWinUSB = NULL;
 
@@ -48,8 +50,11 @@ BOOL WinUsb_Load(void)
   _WinUsb_QueryInterfaceSettings = (void*)GetProcAddress(hinstWinUSB, "WinUsb_QueryInterfaceSettings");
   _WinUsb_QueryPipe = (void*)GetProcAddress(hinstWinUSB, "WinUsb_QueryPipe");
   _WinUsb_ReadPipe = (void*)GetProcAddress(hinstWinUSB, "WinUsb_ReadPipe");
+  _WinUsb_GetOverlappedResult = (void*)GetProcAddress(hinstWinUSB, "WinUsb_GetOverlappedResult");
+  _WinUsb_AbortPipe = (void*)GetProcAddress(hinstWinUSB, "WinUsb_AbortPipe");
   assert(_WinUsb_Initialize != NULL && _WinUsb_Free != NULL && _WinUsb_QueryInterfaceSettings != NULL
-         && _WinUsb_QueryPipe != NULL && _WinUsb_ReadPipe != NULL);
+         && _WinUsb_QueryPipe != NULL && _WinUsb_ReadPipe != NULL
+         && _WinUsb_GetOverlappedResult != NULL && _WinUsb_AbortPipe != NULL);
   return TRUE;
 }
 
@@ -64,6 +69,8 @@ BOOL WinUsb_Unload(void)
   _WinUsb_QueryInterfaceSettings = NULL;
   _WinUsb_QueryPipe = NULL;
   _WinUsb_ReadPipe = NULL;
+  _WinUsb_GetOverlappedResult = NULL;
+  _WinUsb_AbortPipe = NULL;
 
   return TRUE;
 }
@@ -83,6 +90,8 @@ BOOL (__stdcall *_UsbK_Free)(USB_INTERFACE_HANDLE InterfaceHandle) = NULL;
 BOOL (__stdcall *_UsbK_QueryInterfaceSettings)(USB_INTERFACE_HANDLE InterfaceHandle, uint8_t AlternateInterfaceNumber, USB_INTERFACE_DESCRIPTOR *UsbAltInterfaceDescriptor) = NULL;
 BOOL (__stdcall *_UsbK_QueryPipe)(USB_INTERFACE_HANDLE InterfaceHandle, uint8_t AlternateInterfaceNumber, uint8_t PipeIndex, USB_PIPE_INFORMATION *PipeInformation) = NULL;
 BOOL (__stdcall *_UsbK_ReadPipe)(USB_INTERFACE_HANDLE InterfaceHandle, uint8_t PipeID, uint8_t *Buffer, uint32_t BufferLength, uint32_t *LengthTransferred, LPOVERLAPPED Overlapped) = NULL;
+BOOL (__stdcall *_UsbK_GetOverlappedResult)(USB_INTERFACE_HANDLE InterfaceHandle, LPOVERLAPPED Overlapped, uint32_t *LengthTransferred, BOOL Wait) = NULL;
+BOOL (__stdcall *_UsbK_AbortPipe)(USB_INTERFACE_HANDLE InterfaceHandle, uint8_t PipeID) = NULL;
 
 BOOL (__stdcall *_LstK_Init)(KLST_DEVINFO **DeviceList, int Flags) = NULL;
 BOOL (__stdcall *_LstK_Free)(KLST_DEVINFO *DeviceList) = NULL;
@@ -105,12 +114,15 @@ BOOL UsbK_Load(void)
   _UsbK_QueryInterfaceSettings = (void*)GetProcAddress(hinstUsbK, "UsbK_QueryInterfaceSettings");
   _UsbK_QueryPipe = (void*)GetProcAddress(hinstUsbK, "UsbK_QueryPipe");
   _UsbK_ReadPipe = (void*)GetProcAddress(hinstUsbK, "UsbK_ReadPipe");
+  _UsbK_GetOverlappedResult = (void*)GetProcAddress(hinstUsbK, "UsbK_GetOverlappedResult");
+  _UsbK_AbortPipe = (void*)GetProcAddress(hinstUsbK, "UsbK_AbortPipe");
   _LstK_Init = (void*)GetProcAddress(hinstUsbK, "LstK_Init");
   _LstK_Free = (void*)GetProcAddress(hinstUsbK, "LstK_Free");
   _LstK_Count = (void*)GetProcAddress(hinstUsbK, "LstK_Count");
   _LstK_Enumerate = (void*)GetProcAddress(hinstUsbK, "LstK_Enumerate");
   assert(_UsbK_Init != NULL && _UsbK_Free != NULL && _UsbK_QueryInterfaceSettings != NULL
-         && _UsbK_QueryPipe != NULL && _UsbK_ReadPipe != NULL && _LstK_Init != NULL
+         && _UsbK_QueryPipe != NULL && _UsbK_ReadPipe != NULL
+         && _UsbK_GetOverlappedResult != NULL && _UsbK_AbortPipe != NULL && _LstK_Init != NULL
          && _LstK_Free != NULL  && _LstK_Count != NULL  && _LstK_Enumerate != NULL);
   return TRUE;
 }
@@ -126,6 +138,8 @@ BOOL UsbK_Unload(void)
   _UsbK_QueryInterfaceSettings = NULL;
   _UsbK_QueryPipe = NULL;
   _UsbK_ReadPipe = NULL;
+  _UsbK_GetOverlappedResult = NULL;
+  _UsbK_AbortPipe = NULL;
   _LstK_Init = NULL;
   _LstK_Free = NULL;
   _LstK_Count = NULL;
@@ -68,6 +68,8 @@ extern BOOL (__stdcall *_WinUsb_Free)(USB_INTERFACE_HANDLE InterfaceHandle);
 extern BOOL (__stdcall *_WinUsb_QueryInterfaceSettings)(USB_INTERFACE_HANDLE InterfaceHandle, uint8_t AlternateInterfaceNumber, USB_INTERFACE_DESCRIPTOR *UsbAltInterfaceDescriptor);
 extern BOOL (__stdcall *_WinUsb_QueryPipe)(USB_INTERFACE_HANDLE InterfaceHandle, uint8_t AlternateInterfaceNumber, uint8_t PipeIndex, USB_PIPE_INFORMATION *PipeInformation);
 extern BOOL (__stdcall *_WinUsb_ReadPipe)(USB_INTERFACE_HANDLE InterfaceHandle, uint8_t PipeID, uint8_t *Buffer, uint32_t BufferLength, uint32_t *LengthTransferred, LPOVERLAPPED Overlapped);
+extern BOOL (__stdcall *_WinUsb_GetOverlappedResult)(USB_INTERFACE_HANDLE InterfaceHandle, LPOVERLAPPED Overlapped, uint32_t *LengthTransferred, BOOL Wait);
+extern BOOL (__stdcall *_WinUsb_AbortPipe)(USB_INTERFACE_HANDLE InterfaceHandle, uint8_t PipeID);
 
 /* WinUSB loading & unloading functions */
 BOOL WinUsb_Load(void);
@@ -113,6 +115,8 @@ extern BOOL (__stdcall *_UsbK_Free)(USB_INTERFACE_HANDLE InterfaceHandle);
 extern BOOL (__stdcall *_UsbK_QueryInterfaceSettings)(USB_INTERFACE_HANDLE InterfaceHandle, uint8_t AlternateInterfaceNumber, USB_INTERFACE_DESCRIPTOR *UsbAltInterfaceDescriptor);
 extern BOOL (__stdcall *_UsbK_QueryPipe)(USB_INTERFACE_HANDLE InterfaceHandle, uint8_t AlternateInterfaceNumber, uint8_t PipeIndex, USB_PIPE_INFORMATION *PipeInformation);
 extern BOOL (__stdcall *_UsbK_ReadPipe)(USB_INTERFACE_HANDLE InterfaceHandle, uint8_t PipeID, uint8_t *Buffer, uint32_t BufferLength, uint32_t *LengthTransferred, LPOVERLAPPED Overlapped);
+extern BOOL (__stdcall *_UsbK_GetOverlappedResult)(USB_INTERFACE_HANDLE InterfaceHandle, LPOVERLAPPED Overlapped, uint32_t *LengthTransferred, BOOL Wait);
+extern BOOL (__stdcall *_UsbK_AbortPipe)(USB_INTERFACE_HANDLE InterfaceHandle, uint8_t PipeID);
 
 extern BOOL (__stdcall *_LstK_Init)(KLST_DEVINFO **DeviceList, int Flags);
 extern BOOL (__stdcall *_LstK_Free)(KLST_DEVINFO *DeviceList);
@@ -21,6 +21,8 @@
 
 #define WHITESPACE " \t\n\r"
 
+#define XT_MAXATTRIBS 16	/* attributes beyond this count are ignored in callback mode */
+
 
 /*  S t r i n g   h a n d l i n g  */
 
@@ -329,6 +331,166 @@ xt_Node* xt_parse( const char* data )
 }
 
 
+/*  C a l l b a c k   p a r s e r  */
+
+typedef struct xt_Callbacks
+{
+	xt_StartFunc	start;
+	xt_EndFunc		end;
+	void*			userdata;
+}
+xt_Callbacks;
+
+/* same as xt_parse_node(), but instead of building a node, it calls the
+   start & end functions; memory use is bounded by the nesting depth */
+static
+int xt_parse_node_cb( char** data, const xt_Callbacks* cb )
+{
+	xt_Attrib attribs[ XT_MAXATTRIBS ];
+	int numattribs = 0;
+	char* name;
+	int szname;
+	char* content;
+	char* S = *data;
+
+	xt_skip_wsc( &S );
+	if( *S != '<' )
+		return 0;
+	S++;
+
+	/* name */
+	xt_skip_ws( &S );
+	name = S;
+	if( !xt_skip_until( &S, WHITESPACE "/>" ) )
+		return 0;
+	szname = S - name;
+
+	/* attributes */
+	xt_skip_ws( &S );
+	while( *S != '>' && *S != '/' )
+	{
+		xt_Attrib attrib = { 0 };
+		attrib.name = S;
+
+		if( !xt_skip_until( &S, WHITESPACE "=/>" ) )
+			return 0;
+
+		attrib.szname = S - attrib.name;
+		xt_skip_ws( &S );
+
+		/* value */
+		if( *S == '=' )
+		{
+			S++;
+			xt_skip_ws( &S );
+			if( *S == '\"' || *S == '\'' )
+			{
+				char qch = *S;
+				S++;
+				attrib.value = S;
+				if( !xt_skip_string( &S, qch ) )
+					return 0;
+			}
+			else return 0;
+
+			attrib.szvalue = S++ - attrib.value;
+			xt_skip_ws( &S );
+		}
+
+		if( numattribs < XT_MAXATTRIBS )
+			attribs[ numattribs++ ] = attrib;
+	}
+
+	if( *S == '/' )
+	{
+		if( S[ 1 ] != '>' )
+			return 0;
+		S += 2;
+		if( cb->start ) cb->start( cb->userdata, name, szname, attribs, numattribs );
+		if( cb->end ) cb->end( cb->userdata, name, szname, NULL, 0 );
+		*data = S;
+		return 1;
+	}
+
+	S++;
+	content = S;
+	if( cb->start ) cb->start( cb->userdata, name, szname, attribs, numattribs );
+
+	xt_skip_wsc( &S );
+	while( *S )
+	{
+		if( *S == '<' )
+		{
+			char* RB = S;
+
+			if( S[ 1 ] == '/' )
+			{
+				char* EP;
+				int len;
+
+				S += 2;
+				xt_skip_ws( &S );
+				EP = S;
+				if( !xt_skip_until( &S, WHITESPACE ">" ) )
+					break;
+
+				len = S - EP;
+				if( len != szname || strncmp( name, EP, len ) != 0 )
+				{
+					/* mismatched end tag: close this element, let the parent
+					   check the tag */
+					S = RB;
+					break;
+				}
+
+				if( cb->end ) cb->end( cb->userdata, name, szname, content, RB - content );
+				*data = S + 1;
+				return 1;
+			}
+			else
+			if( S[ 1 ] == '!' ) {
+				if( !xt_skip_until( &S, WHITESPACE "/>" ) )
+					break;
+			}
+
+			if( xt_parse_node_cb( &S, cb ) )
+				continue;
+		}
+		S++;
+	}
+
+	/* end of data or malformed end tag: close the element anyway, so that
+	   each start has a matching end */
+	if( cb->end ) cb->end( cb->userdata, name, szname, content, S - content );
+	*data = S;
+	return 1;
+}
+
+int xt_parse_callback( const char* data, xt_StartFunc start, xt_EndFunc end, void* userdata )
+{
+	xt_Callbacks cb;
+	char* S = (char*) data;
+
+	cb.start = start;
+	cb.end = end;
+	cb.userdata = userdata;
+
+	if( (unsigned char) S[0] == 0xEF &&
+		(unsigned char) S[1] == 0xBB &&
+		(unsigned char) S[2] == 0xBF )
+	{
+		/* skip UTF-8 BOM */
+		S += 3;
+	}
+
+	xt_skip_wsc( &S );
+	xt_skip_hint( &S );
+	xt_skip_wsc( &S );
+
+	return xt_parse_node_cb( &S, &cb );
+}
+
+
 /*  U t i l i t i e s  */
 
 xt_Node* xt_find_child( xt_Node* node, const char* name )
@@ -43,6 +43,15 @@ struct xt_Node
 xt_Node* xt_parse( const char* data );
 void xt_destroy_node( xt_Node* root );
 
+/* callback mode: no tree is built, instead a function is called at the start
+   and at the end of every element (the content passed to the end function
+   is the raw text between the tags) */
+typedef void (*xt_StartFunc)( void* userdata, const char* name, int szname,
+                              const xt_Attrib* attribs, int numattribs );
+typedef void (*xt_EndFunc)( void* userdata, const char* name, int szname,
+                            const char* content, int szcontent );
+int xt_parse_callback( const char* data, xt_StartFunc start, xt_EndFunc end, void* userdata );
+
 xt_Node* xt_find_child( xt_Node* node, const char* name );
 xt_Node* xt_find_sibling( xt_Node* node, const char* name );
 xt_Attrib* xt_find_attrib( xt_Node* node, const char* name );